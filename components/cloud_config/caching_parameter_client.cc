@@ -0,0 +1,144 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/cloud_config/caching_parameter_client.h"
+
+#include <utility>
+
+#include "absl/log/log.h"
+#include "absl/status/status.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_format.h"
+
+namespace kv_server {
+
+CachingParameterClient::CachingParameterClient(
+    std::unique_ptr<ParameterClient> client)
+    : client_(std::move(client)) {}
+
+void CachingParameterClient::Prefetch(
+    const std::vector<std::string>& parameter_names) const {
+  const auto parameters = client_->GetParameters(parameter_names);
+  int num_prefetched = 0;
+  for (const auto& [name, value] : parameters) {
+    num_prefetched += value.ok();
+  }
+  LOG(INFO) << "Prefetched " << num_prefetched << " of "
+            << parameter_names.size() << " parameters";
+  Store(parameters);
+}
+
+void CachingParameterClient::Store(
+    const absl::flat_hash_map<std::string, absl::StatusOr<std::string>>&
+        parameters) const {
+  absl::MutexLock lock(&mutex_);
+  for (const auto& [name, value] : parameters) {
+    parameters_.insert_or_assign(name, value);
+  }
+}
+
+std::optional<absl::StatusOr<std::string>> CachingParameterClient::Lookup(
+    std::string_view parameter_name) const {
+  absl::MutexLock lock(&mutex_);
+  const auto it = parameters_.find(parameter_name);
+  if (it == parameters_.end()) {
+    return std::nullopt;
+  }
+  return it->second;
+}
+
+absl::StatusOr<std::string> CachingParameterClient::GetParameter(
+    std::string_view parameter_name,
+    std::optional<std::string> default_value) const {
+  if (auto parameter = Lookup(parameter_name); parameter.has_value()) {
+    if (parameter->ok()) {
+      return *std::move(*parameter);
+    }
+    if (default_value.has_value()) {
+      LOG(WARNING) << "Unable to get parameter: " << parameter_name
+                   << " with error: " << parameter->status()
+                   << ", returning default value: " << *default_value;
+      return *default_value;
+    }
+  }
+  auto parameter = client_->GetParameter(parameter_name, default_value);
+  // Defaults aren't kept, a later caller may have none.
+  if (parameter.ok() && !default_value.has_value()) {
+    absl::MutexLock lock(&mutex_);
+    parameters_.insert_or_assign(std::string(parameter_name), *parameter);
+  }
+  return parameter;
+}
+
+absl::StatusOr<int32_t> CachingParameterClient::GetInt32Parameter(
+    std::string_view parameter_name) const {
+  const auto parameter = Lookup(parameter_name);
+  if (!parameter.has_value() || !parameter->ok()) {
+    return client_->GetInt32Parameter(parameter_name);
+  }
+  int32_t parameter_int32;
+  if (!absl::SimpleAtoi(**parameter, &parameter_int32)) {
+    const std::string error =
+        absl::StrFormat("Failed converting %s parameter: %s to int32.",
+                        parameter_name, **parameter);
+    LOG(ERROR) << error;
+    return absl::InvalidArgumentError(error);
+  }
+  return parameter_int32;
+}
+
+absl::StatusOr<bool> CachingParameterClient::GetBoolParameter(
+    std::string_view parameter_name) const {
+  const auto parameter = Lookup(parameter_name);
+  if (!parameter.has_value() || !parameter->ok()) {
+    return client_->GetBoolParameter(parameter_name);
+  }
+  bool parameter_bool;
+  if (!absl::SimpleAtob(**parameter, &parameter_bool)) {
+    const std::string error =
+        absl::StrFormat("Failed converting %s parameter: %s to bool.",
+                        parameter_name, **parameter);
+    LOG(ERROR) << error;
+    return absl::InvalidArgumentError(error);
+  }
+  return parameter_bool;
+}
+
+absl::flat_hash_map<std::string, absl::StatusOr<std::string>>
+CachingParameterClient::GetParameters(
+    const std::vector<std::string>& parameter_names) const {
+  absl::flat_hash_map<std::string, absl::StatusOr<std::string>> parameters;
+  std::vector<std::string> missing_names;
+  for (const auto& parameter_name : parameter_names) {
+    if (auto parameter = Lookup(parameter_name);
+        parameter.has_value() && parameter->ok()) {
+      parameters.insert_or_assign(parameter_name, *std::move(parameter));
+    } else {
+      missing_names.push_back(parameter_name);
+    }
+  }
+  if (missing_names.empty()) {
+    return parameters;
+  }
+  const auto fetched = client_->GetParameters(missing_names);
+  Store(fetched);
+  for (const auto& [name, value] : fetched) {
+    parameters.insert_or_assign(name, value);
+  }
+  return parameters;
+}
+
+}  // namespace kv_server
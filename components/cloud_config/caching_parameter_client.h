@@ -0,0 +1,84 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_CLOUD_CONFIG_CACHING_PARAMETER_CLIENT_H_
+#define COMPONENTS_CLOUD_CONFIG_CACHING_PARAMETER_CLIENT_H_
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
+#include "components/cloud_config/parameter_client.h"
+
+namespace kv_server {
+
+// Serves parameters from a snapshot that `Prefetch` gets in as few round trips
+// as the wrapped client allows, so that startup doesn't wait for a round trip
+// per parameter. Parameters are read once: values got from the wrapped client
+// are kept for the life of the client.
+//
+// A parameter that failed to prefetch is got again, unless the caller has a
+// default for it, which is returned as the wrapped client would have.
+//
+// Thread-safe.
+class CachingParameterClient : public ParameterClient {
+ public:
+  explicit CachingParameterClient(std::unique_ptr<ParameterClient> client);
+
+  // Gets `parameter_names` from the wrapped client into the snapshot.
+  void Prefetch(const std::vector<std::string>& parameter_names) const
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  absl::StatusOr<std::string> GetParameter(
+      std::string_view parameter_name,
+      std::optional<std::string> default_value = std::nullopt) const override
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  absl::StatusOr<int32_t> GetInt32Parameter(
+      std::string_view parameter_name) const override
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  absl::StatusOr<bool> GetBoolParameter(
+      std::string_view parameter_name) const override
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  absl::flat_hash_map<std::string, absl::StatusOr<std::string>> GetParameters(
+      const std::vector<std::string>& parameter_names) const override
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  // Returns the snapshot value of `parameter_name`, if any.
+  std::optional<absl::StatusOr<std::string>> Lookup(
+      std::string_view parameter_name) const ABSL_LOCKS_EXCLUDED(mutex_);
+  void Store(const absl::flat_hash_map<std::string,
+                                       absl::StatusOr<std::string>>& parameters)
+      const ABSL_LOCKS_EXCLUDED(mutex_);
+
+  std::unique_ptr<ParameterClient> client_;
+  mutable absl::Mutex mutex_;
+  mutable absl::flat_hash_map<std::string, absl::StatusOr<std::string>>
+      parameters_ ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_CLOUD_CONFIG_CACHING_PARAMETER_CLIENT_H_
@@ -0,0 +1,154 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/cloud_config/caching_parameter_client.h"
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+using testing::_;
+using testing::ElementsAre;
+using testing::Eq;
+using testing::Return;
+
+class MockParameterClient : public ParameterClient {
+ public:
+  MOCK_METHOD(absl::StatusOr<std::string>, GetParameter,
+              (std::string_view parameter_name,
+               std::optional<std::string> default_value),
+              (const, override));
+  MOCK_METHOD(absl::StatusOr<int32_t>, GetInt32Parameter,
+              (std::string_view parameter_name), (const, override));
+  MOCK_METHOD(absl::StatusOr<bool>, GetBoolParameter,
+              (std::string_view parameter_name), (const, override));
+  MOCK_METHOD((absl::flat_hash_map<std::string, absl::StatusOr<std::string>>),
+              GetParameters, (const std::vector<std::string>& parameter_names),
+              (const, override));
+};
+
+absl::flat_hash_map<std::string, absl::StatusOr<std::string>>
+PrefetchedParameters() {
+  return {{"string", "value"},
+          {"int32", "2024"},
+          {"bool", "true"},
+          {"missing", absl::NotFoundError("missing")}};
+}
+
+class CachingParameterClientTest : public ::testing::Test {
+ protected:
+  CachingParameterClientTest() {
+    auto client = std::make_unique<MockParameterClient>();
+    client_ = client.get();
+    caching_client_ =
+        std::make_unique<CachingParameterClient>(std::move(client));
+  }
+
+  void Prefetch() {
+    EXPECT_CALL(*client_, GetParameters(ElementsAre("string", "int32", "bool",
+                                                    "missing")))
+        .WillOnce(Return(PrefetchedParameters()));
+    caching_client_->Prefetch({"string", "int32", "bool", "missing"});
+  }
+
+  MockParameterClient* client_;
+  std::unique_ptr<CachingParameterClient> caching_client_;
+};
+
+TEST_F(CachingParameterClientTest, ServesPrefetchedParameters) {
+  Prefetch();
+  EXPECT_CALL(*client_, GetParameter).Times(0);
+  EXPECT_CALL(*client_, GetInt32Parameter).Times(0);
+  EXPECT_CALL(*client_, GetBoolParameter).Times(0);
+  const auto string_parameter = caching_client_->GetParameter("string");
+  ASSERT_TRUE(string_parameter.ok());
+  EXPECT_EQ(*string_parameter, "value");
+  const auto int32_parameter = caching_client_->GetInt32Parameter("int32");
+  ASSERT_TRUE(int32_parameter.ok());
+  EXPECT_EQ(*int32_parameter, 2024);
+  const auto bool_parameter = caching_client_->GetBoolParameter("bool");
+  ASSERT_TRUE(bool_parameter.ok());
+  EXPECT_TRUE(*bool_parameter);
+}
+
+TEST_F(CachingParameterClientTest, ReturnsDefaultOfFailedPrefetch) {
+  Prefetch();
+  EXPECT_CALL(*client_, GetParameter).Times(0);
+  const auto parameter = caching_client_->GetParameter("missing", "default");
+  ASSERT_TRUE(parameter.ok());
+  EXPECT_EQ(*parameter, "default");
+}
+
+TEST_F(CachingParameterClientTest, GetsFailedPrefetchAgainWithoutDefault) {
+  Prefetch();
+  EXPECT_CALL(*client_, GetParameter("missing", Eq(std::nullopt)))
+      .WillOnce(Return("value"));
+  const auto parameter = caching_client_->GetParameter("missing");
+  ASSERT_TRUE(parameter.ok());
+  EXPECT_EQ(*parameter, "value");
+  // Kept once got.
+  EXPECT_TRUE(caching_client_->GetParameter("missing").ok());
+}
+
+TEST_F(CachingParameterClientTest, GetsParametersThatWerentPrefetched) {
+  EXPECT_CALL(*client_, GetParameter("string", Eq(std::nullopt)))
+      .WillOnce(Return("value"));
+  EXPECT_CALL(*client_, GetInt32Parameter("int32")).WillOnce(Return(2024));
+  EXPECT_EQ(*caching_client_->GetParameter("string"), "value");
+  EXPECT_EQ(*caching_client_->GetParameter("string"), "value");
+  EXPECT_EQ(*caching_client_->GetInt32Parameter("int32"), 2024);
+}
+
+TEST_F(CachingParameterClientTest, DefaultIsNotKept) {
+  EXPECT_CALL(*client_, GetParameter("string", _))
+      .WillOnce(Return("default"))
+      .WillOnce(Return(absl::NotFoundError("string")));
+  EXPECT_EQ(*caching_client_->GetParameter("string", "default"), "default");
+  EXPECT_FALSE(caching_client_->GetParameter("string").ok());
+}
+
+TEST_F(CachingParameterClientTest, PrefetchedValueOfWrongTypeIsAnError) {
+  Prefetch();
+  EXPECT_CALL(*client_, GetInt32Parameter).Times(0);
+  EXPECT_EQ(caching_client_->GetInt32Parameter("string").status().code(),
+            absl::StatusCode::kInvalidArgument);
+}
+
+TEST_F(CachingParameterClientTest, GetParametersOnlyGetsMissingParameters) {
+  Prefetch();
+  EXPECT_CALL(*client_, GetParameters(ElementsAre("missing", "other")))
+      .WillOnce(Return(
+          absl::flat_hash_map<std::string, absl::StatusOr<std::string>>{
+              {"missing", "value"}, {"other", "other_value"}}));
+  const auto parameters =
+      caching_client_->GetParameters({"string", "missing", "other"});
+  ASSERT_EQ(parameters.size(), 3);
+  EXPECT_EQ(*parameters.at("string"), "value");
+  EXPECT_EQ(*parameters.at("missing"), "value");
+  EXPECT_EQ(*parameters.at("other"), "other_value");
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -18,6 +18,7 @@
 #include <string_view>
 #include <vector>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/status/statusor.h"
 
 // TODO: Replace config cpio client once ready
@@ -45,6 +46,18 @@ class ParameterClient {
 
   virtual absl::StatusOr<bool> GetBoolParameter(
       std::string_view parameter_name) const = 0;
+
+  // Gets the values of `parameter_names`, with as few round trips to the
+  // parameter storage as the platform allows. Parameters that can't be got
+  // map to their error.
+  virtual absl::flat_hash_map<std::string, absl::StatusOr<std::string>>
+  GetParameters(const std::vector<std::string>& parameter_names) const {
+    absl::flat_hash_map<std::string, absl::StatusOr<std::string>> parameters;
+    for (const auto& parameter_name : parameter_names) {
+      parameters.emplace(parameter_name, GetParameter(parameter_name));
+    }
+    return parameters;
+  }
 };
 }  // namespace kv_server
 
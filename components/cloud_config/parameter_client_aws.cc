@@ -15,10 +15,12 @@
 // TODO(b/299623229): Swich to CPIO implementation once it supports fetching
 // cloud params from local instances
 
+#include <algorithm>
 #include <memory>
 #include <string>
 #include <string_view>
 #include <thread>
+#include <vector>
 
 #include "absl/log/log.h"
 #include "absl/status/status.h"
@@ -30,12 +32,17 @@
 #include "aws/ssm/SSMClient.h"
 #include "aws/ssm/model/GetParameterRequest.h"
 #include "aws/ssm/model/GetParameterResult.h"
+#include "aws/ssm/model/GetParametersRequest.h"
+#include "aws/ssm/model/GetParametersResult.h"
 #include "components/cloud_config/parameter_client.h"
 #include "components/errors/error_util_aws.h"
 
 namespace kv_server {
 namespace {
 
+// The most parameters that SSM GetParameters returns per call.
+constexpr int kMaxParametersPerRequest = 10;
+
 class AwsParameterClient : public ParameterClient {
  public:
   absl::StatusOr<std::string> GetParameter(
@@ -109,6 +116,40 @@ class AwsParameterClient : public ParameterClient {
     return parameter_bool;
   };
 
+  absl::flat_hash_map<std::string, absl::StatusOr<std::string>> GetParameters(
+      const std::vector<std::string>& parameter_names) const override {
+    absl::flat_hash_map<std::string, absl::StatusOr<std::string>> parameters;
+    for (size_t begin = 0; begin < parameter_names.size();
+         begin += kMaxParametersPerRequest) {
+      const size_t end = std::min(parameter_names.size(),
+                                  begin + kMaxParametersPerRequest);
+      Aws::SSM::Model::GetParametersRequest request;
+      for (size_t i = begin; i < end; ++i) {
+        request.AddNames(parameter_names[i]);
+      }
+      const auto outcome = ssm_client_->GetParameters(request);
+      if (!outcome.IsSuccess()) {
+        LOG(ERROR) << "Unable to get parameters with error: "
+                   << outcome.GetError();
+        const absl::Status status = AwsErrorToStatus(outcome.GetError());
+        for (size_t i = begin; i < end; ++i) {
+          parameters.emplace(parameter_names[i], status);
+        }
+        continue;
+      }
+      for (const auto& parameter : outcome.GetResult().GetParameters()) {
+        LOG(INFO) << "Got parameter: " << parameter.GetName()
+                  << " with value: " << parameter.GetValue();
+        parameters.emplace(parameter.GetName(), parameter.GetValue());
+      }
+      for (const auto& name : outcome.GetResult().GetInvalidParameters()) {
+        parameters.emplace(name, absl::NotFoundError(absl::StrFormat(
+                                     "Parameter %s not found.", name)));
+      }
+    }
+    return parameters;
+  }
+
   explicit AwsParameterClient(ParameterClient::ClientOptions client_options)
       : client_options_(std::move(client_options)) {
     if (client_options.client_for_unit_testing_ != nullptr) {
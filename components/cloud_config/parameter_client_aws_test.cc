@@ -14,10 +14,13 @@
 #include <memory>
 #include <string>
 #include <thread>
+#include <vector>
 
+#include "absl/strings/str_cat.h"
 #include "aws/ssm/SSMClient.h"
 #include "aws/ssm/SSMErrors.h"
 #include "aws/ssm/model/GetParameterRequest.h"
+#include "aws/ssm/model/GetParametersRequest.h"
 #include "components/cloud_config/parameter_client.h"
 #include "components/util/platform_initializer.h"
 #include "gmock/gmock.h"
@@ -28,12 +31,16 @@ namespace {
 
 using testing::_;
 using testing::Return;
+using testing::SizeIs;
 
 class MockSsmClient : public ::Aws::SSM::SSMClient {
  public:
   MOCK_METHOD(Aws::SSM::Model::GetParameterOutcome, GetParameter,
               (const Aws::SSM::Model::GetParameterRequest& request),
               (const, override));
+  MOCK_METHOD(Aws::SSM::Model::GetParametersOutcome, GetParameters,
+              (const Aws::SSM::Model::GetParametersRequest& request),
+              (const, override));
 };
 
 class ParameterClientAwsTest : public ::testing::Test {
@@ -135,6 +142,60 @@ TEST_F(ParameterClientAwsTest, GetBoolParameterNotBoolReturnsError) {
   EXPECT_FALSE(result_or_status.ok());
 }
 
+TEST_F(ParameterClientAwsTest, GetParametersBatchesRequests) {
+  auto ssm_client = std::make_unique<MockSsmClient>();
+  std::vector<std::string> names;
+  for (int i = 0; i < 12; ++i) {
+    names.push_back(absl::StrCat("param_", i));
+  }
+  EXPECT_CALL(*ssm_client, GetParameters(_))
+      .Times(2)
+      .WillRepeatedly(
+          [](const Aws::SSM::Model::GetParametersRequest& request) {
+            Aws::SSM::Model::GetParametersResult result;
+            for (const auto& name : request.GetNames()) {
+              if (name == "param_11") {
+                result.AddInvalidParameters(name);
+                continue;
+              }
+              Aws::SSM::Model::Parameter parameter;
+              parameter.SetName(name);
+              parameter.SetValue(absl::StrCat(name, "_value"));
+              result.AddParameters(std::move(parameter));
+            }
+            return Aws::SSM::Model::GetParametersOutcome(std::move(result));
+          });
+
+  ParameterClient::ClientOptions options;
+  options.client_for_unit_testing_ = ssm_client.release();
+
+  auto parameter_client = ParameterClient::Create(options);
+  const auto parameters = parameter_client->GetParameters(names);
+  ASSERT_THAT(parameters, SizeIs(12));
+  ASSERT_TRUE(parameters.at("param_0").ok());
+  EXPECT_EQ(*parameters.at("param_0"), "param_0_value");
+  ASSERT_TRUE(parameters.at("param_10").ok());
+  EXPECT_EQ(*parameters.at("param_10"), "param_10_value");
+  EXPECT_EQ(parameters.at("param_11").status().code(),
+            absl::StatusCode::kNotFound);
+}
+
+TEST_F(ParameterClientAwsTest, GetParametersSSMClientFailsReturnsErrors) {
+  auto ssm_client = std::make_unique<MockSsmClient>();
+  Aws::SSM::SSMError ssm_error;
+  Aws::SSM::Model::GetParametersOutcome outcome(ssm_error);
+  EXPECT_CALL(*ssm_client, GetParameters(_)).WillOnce(Return(outcome));
+
+  ParameterClient::ClientOptions options;
+  options.client_for_unit_testing_ = ssm_client.release();
+
+  auto parameter_client = ParameterClient::Create(options);
+  const auto parameters = parameter_client->GetParameters({"a", "b"});
+  ASSERT_THAT(parameters, SizeIs(2));
+  EXPECT_FALSE(parameters.at("a").ok());
+  EXPECT_FALSE(parameters.at("b").ok());
+}
+
 }  // namespace
 
 }  // namespace kv_server
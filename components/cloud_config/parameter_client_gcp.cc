@@ -17,8 +17,10 @@
 #include <memory>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/flags/flag.h"
 #include "absl/log/check.h"
 #include "absl/log/log.h"
@@ -27,6 +29,7 @@
 #include "absl/strings/str_format.h"
 #include "absl/strings/string_view.h"
 #include "absl/synchronization/blocking_counter.h"
+#include "absl/synchronization/mutex.h"
 #include "components/cloud_config/parameter_client.h"
 #include "src/public/core/interface/errors.h"
 #include "src/public/core/interface/execution_result.h"
@@ -150,7 +153,70 @@ class GcpParameterClient : public ParameterClient {
     return parameter_bool;
   }
 
+  // Sends every request before waiting for any, so that the parameters are
+  // got concurrently.
+  absl::flat_hash_map<std::string, absl::StatusOr<std::string>> GetParameters(
+      const std::vector<std::string>& parameter_names) const override {
+    absl::flat_hash_set<std::string> unique_names(parameter_names.begin(),
+                                                  parameter_names.end());
+    // Shared with the callbacks, which may run after a failed send returns.
+    auto batch = std::make_shared<ParameterBatch>(unique_names.size());
+    for (const auto& parameter_name : unique_names) {
+      GetParameterRequest request;
+      request.set_parameter_name(parameter_name);
+      auto execution_result = parameter_client_->GetParameter(
+          std::move(request),
+          [batch, parameter_name](const ExecutionResult result,
+                                  GetParameterResponse response) {
+            if (!result.Successful()) {
+              batch->Complete(parameter_name,
+                              absl::UnavailableError(
+                                  GetErrorMessage(result.status_code)));
+              return;
+            }
+            // GCP secret manager does not support empty string natively.
+            batch->Complete(parameter_name,
+                            response.parameter_value() != "EMPTY_STRING"
+                                ? response.parameter_value()
+                                : "");
+          });
+      if (!execution_result.Successful()) {
+        batch->Complete(parameter_name,
+                        absl::UnavailableError(GetErrorMessage(
+                            execution_result.status_code)));
+      }
+    }
+    batch->counter.Wait();
+    absl::MutexLock lock(&batch->mutex);
+    for (const auto& [name, value] : batch->parameters) {
+      if (value.ok()) {
+        LOG(INFO) << "Got parameter: " << name << " with value: " << *value;
+      } else {
+        LOG(WARNING) << "Unable to get parameter: " << name
+                     << " with error: " << value.status();
+      }
+    }
+    return batch->parameters;
+  }
+
  private:
+  struct ParameterBatch {
+    explicit ParameterBatch(int64_t size) : counter(size) {}
+
+    // Keeps the first result of each parameter.
+    void Complete(const std::string& name, absl::StatusOr<std::string> value) {
+      absl::MutexLock lock(&mutex);
+      if (parameters.emplace(name, std::move(value)).second) {
+        counter.DecrementCount();
+      }
+    }
+
+    absl::BlockingCounter counter;
+    absl::Mutex mutex;
+    absl::flat_hash_map<std::string, absl::StatusOr<std::string>> parameters
+        ABSL_GUARDED_BY(mutex);
+  };
+
   std::unique_ptr<ParameterClientInterface> parameter_client_;
 };
 
@@ -143,5 +143,19 @@ TEST_F(ParameterClientGcpTest, GetInt32ParameterInvalidReturn) {
   EXPECT_FALSE(int32_param.ok());
 }
 
+TEST_F(ParameterClientGcpTest, GetParametersBatchSuccess) {
+  const auto parameters = gcp_parameter_client_->GetParameters(
+      {"string_test_flag", "empty_string_flag", "invalid_test_flag"});
+  ASSERT_EQ(parameters.size(), 3);
+  ASSERT_TRUE(parameters.at("string_test_flag").ok());
+  EXPECT_EQ(*parameters.at("string_test_flag"), "string_test_val");
+  ASSERT_TRUE(parameters.at("empty_string_flag").ok());
+  EXPECT_TRUE(parameters.at("empty_string_flag")->empty());
+  EXPECT_FALSE(parameters.at("invalid_test_flag").ok());
+  for (auto& each : f_) {
+    each.get();
+  }
+}
+
 }  // namespace
 }  // namespace kv_server
@@ -20,6 +20,7 @@
 #include "absl/flags/marshalling.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "components/cloud_config/parameter_client.h"
 #include "public/constants.h"
@@ -67,6 +68,322 @@ ABSL_FLAG(std::string, data_loading_prefix_allowlist, "",
           "Allowlist for blob prefixes.");
 ABSL_FLAG(bool, add_missing_keys_v1, false,
           "Whether to add missing keys for v1.");
+ABSL_FLAG(int32_t, cache_num_shards, 1,
+          "Number of hash partitions of the in-memory cache. 0 uses one "
+          "partition per hardware thread.");
+ABSL_FLAG(std::string, cache_type, "lock_based",
+          "Implementation of the in-memory cache partitions: lock_based, "
+          "rcu, arena, tiered or dictionary.");
+ABSL_FLAG(std::string, cache_huge_pages, "none",
+          "Pages backing the storage of the arena cache: none, transparent or "
+          "explicit (hugetlbfs).");
+ABSL_FLAG(std::string, cache_set_storage, "strings",
+          "Storage of key-value set members in the in-memory cache: strings "
+          "or interned.");
+ABSL_FLAG(int32_t, cache_cleanup_slice_millis, 0,
+          "Duration of the slices in which deleted values are removed from "
+          "the in-memory cache on a background thread. 0 removes them after "
+          "each file is loaded instead.");
+ABSL_FLAG(int32_t, cache_snapshot_reload_interval_seconds, 0,
+          "Interval at which the data loader checks for new snapshots and "
+          "rebuilds the in-memory cache from them. 0 only loads snapshots at "
+          "startup.");
+ABSL_FLAG(int32_t, cache_value_compression_min_bytes, 0,
+          "Size from which values are compressed in the in-memory cache. 0 "
+          "stores values uncompressed.");
+ABSL_FLAG(std::string, cache_cold_tier_directory, "/tmp",
+          "Local directory where the tiered cache keeps the values that "
+          "aren't looked up.");
+ABSL_FLAG(int32_t, cache_hot_tier_max_mb, 1024,
+          "Megabytes of values that the tiered cache keeps in memory.");
+ABSL_FLAG(std::string, cache_image_path, "",
+          "Local file the cache is periodically written to, and loaded from "
+          "on start. Empty disables cache images.");
+ABSL_FLAG(int32_t, cache_image_interval_minutes, 30,
+          "Interval at which the cache image is rewritten.");
+ABSL_FLAG(std::string, cache_numa_mode, "off",
+          "\"replicated\" keeps a replica of the cache on every NUMA node and "
+          "pins the threads that look it up to the nodes, \"off\" keeps one "
+          "cache.");
+ABSL_FLAG(int32_t, hot_key_cache_max_keys, 0,
+          "Maximum number of hot keys of other shards that a sharded server "
+          "keeps copies of. 0 disables the hot key cache.");
+ABSL_FLAG(int32_t, hot_key_cache_ttl_millis, 10000,
+          "Milliseconds for which a copy of a hot key is served.");
+ABSL_FLAG(int32_t, query_parallel_num_threads, 0,
+          "Number of threads that run the operands of queries in parallel. 0 "
+          "runs queries on the request thread.");
+ABSL_FLAG(int32_t, query_parallel_min_set_size, 10000,
+          "Minimum number of members of the sets of a query operand for it to "
+          "be run in parallel.");
+ABSL_FLAG(int32_t, query_result_cache_max_queries, 1000,
+          "Maximum number of queries whose results are kept until one of "
+          "their sets changes. 0 disables the query result cache.");
+ABSL_FLAG(int32_t, set_sketch_cache_max_sets, 1000,
+          "Maximum number of sets whose sketches, of about 4KB each, are kept "
+          "for approxCardinality until the set changes. 0 disables the set "
+          "sketch cache.");
+ABSL_FLAG(int32_t, shared_thread_pool_num_threads, 0,
+          "Number of threads of the pool shared by data loading and sharded "
+          "lookups. 0 uses one thread per hardware thread.");
+ABSL_FLAG(int32_t, data_loading_max_concurrent_files, 4,
+          "Maximum number of snapshot and delta files loaded at once.");
+ABSL_FLAG(int32_t, data_loading_max_queued_files, 1000,
+          "Maximum number of new delta files waiting to be loaded before the "
+          "bucket stops being watched for more. 0 is unlimited.");
+ABSL_FLAG(int32_t, data_loading_snapshot_check_backlog, 10,
+          "Number of new delta files waiting to be loaded from which newer "
+          "snapshots are looked for right away, so that the delta files "
+          "included in them are skipped. 0 disables it.");
+ABSL_FLAG(int32_t, data_loading_catch_up_min_files, 20,
+          "Number of delta files of a prefix to load on start from which they "
+          "are merged in memory, so that each key is loaded once. 0 disables "
+          "it.");
+ABSL_FLAG(int32_t, data_loading_trusted_file_verification_interval, 1,
+          "Verify the flatbuffer of one of every this many records of data "
+          "files whose metadata marks their records as trusted. 1 verifies "
+          "all records, 0 none.");
+ABSL_FLAG(int32_t, data_loading_serving_p99_target_millis, 0,
+          "p99 latency of the latest served requests over which the cache "
+          "writes of data files are delayed. 0 disables it.");
+ABSL_FLAG(int32_t, data_loading_throttle_delay_millis, 5,
+          "How long each batch of cache writes of data files waits while "
+          "request serving is over its latency target.");
+ABSL_FLAG(int32_t, allocator_release_interval_seconds, 0,
+          "Minimum interval between the releases of free memory to the OS "
+          "after cleanups of deleted values. 0 disables the releases.");
+ABSL_FLAG(int32_t, allocator_background_release_mb_per_second, 0,
+          "Rate at which tcmalloc releases free memory in the background. 0 "
+          "keeps the default.");
+ABSL_FLAG(int32_t, allocator_max_per_cpu_cache_kb, 0,
+          "Size of the per-CPU caches of tcmalloc. 0 keeps the default.");
+ABSL_FLAG(int32_t, data_loading_thread_nice_increment, 0,
+          "Added to the nice value of the threads that load new data files.");
+ABSL_FLAG(int32_t, realtime_updater_min_threads, 0,
+          "Number of realtime updater threads that apply updates at once when "
+          "the updates don't wait, raised up to the number of realtime "
+          "updater threads when they do. 0 always uses all of them.");
+ABSL_FLAG(int32_t, realtime_updater_batch_window_millis, 0,
+          "Window, in milliseconds, over which the realtime updates received "
+          "are applied together, keeping the latest update of each key. 0 "
+          "applies each batch of messages as it is received.");
+ABSL_FLAG(std::string, blob_cache_directory, "",
+          "Local directory that keeps a copy of the data files read from the "
+          "bucket, also across restarts. Empty disables the copies.");
+ABSL_FLAG(int32_t, blob_cache_max_mb, 10240,
+          "Megabytes of data file copies kept in the blob cache directory.");
+ABSL_FLAG(int32_t, max_concurrent_partitions_per_request, 8,
+          "Number of partitions of a request whose UDF executions run at "
+          "once.");
+ABSL_FLAG(int32_t, data_loading_snapshot_publish_interval_minutes, 0,
+          "Interval at which this server publishes its cache as snapshots to "
+          "the data bucket. Set on one server per shard. 0 disables it.");
+ABSL_FLAG(std::string, data_loading_snapshot_publish_directory, "/tmp",
+          "Local directory the published snapshots are written to before "
+          "they are uploaded.");
+ABSL_FLAG(std::string, data_loading_shard_copy_directory, "",
+          "Directory mounted by all the replicas of a shard, through which "
+          "they share the records of the shard in each data file. Empty "
+          "disables it.");
+ABSL_FLAG(int32_t, data_loading_shard_copy_wait_millis, 300000,
+          "How long a replica waits for the shard copy of a file that "
+          "another replica is writing before it loads the file itself.");
+ABSL_FLAG(int32_t, compression_brotli_quality, 11,
+          "Brotli quality, from 0 to 11, of the compression groups of v2 "
+          "responses.");
+ABSL_FLAG(int32_t, compression_gzip_level, 6,
+          "gzip level, from 0 to 9, of the compression groups of v2 "
+          "responses.");
+ABSL_FLAG(int32_t, compression_zstd_level, 3,
+          "zstd level of the compression groups of v2 responses.");
+ABSL_FLAG(std::string, compression_zstd_dictionary_path, "",
+          "Local file with a zstd dictionary that the compression groups of v2 "
+          "responses are compressed with. Clients must decompress with the "
+          "same dictionary. Empty compresses without dictionary.");
+ABSL_FLAG(int32_t, admission_max_concurrent_requests, 0,
+          "Most requests served at once, more are rejected with UNAVAILABLE. "
+          "0 disables the limit.");
+ABSL_FLAG(int32_t, admission_latency_target_millis, 0,
+          "Latency that the concurrency limit of served requests is adapted "
+          "to. 0 keeps the limit fixed.");
+ABSL_FLAG(int32_t, admission_min_remaining_deadline_millis, 0,
+          "Requests with less time left before their deadline are rejected "
+          "with UNAVAILABLE. 0 disables it.");
+ABSL_FLAG(int32_t, v1_value_cache_max_keys, 0,
+          "Number of keys whose values parsed for v1 responses are kept until "
+          "the values change. 0 parses them on every request.");
+ABSL_FLAG(bool, coalesce_v1_requests, false,
+          "Whether concurrent v1 requests for the same keys share one "
+          "response.");
+ABSL_FLAG(bool, coalesce_internal_lookups, false,
+          "Whether concurrent internal lookups of the same keys share one "
+          "lookup.");
+ABSL_FLAG(bool, coalesce_deterministic_udf_executions, false,
+          "Whether concurrent partitions with the same UDF input share one UDF "
+          "execution. Only correct for a deterministic UDF.");
+ABSL_FLAG(bool, fast_v2_json_codec, false,
+          "Whether v2 JSON requests and responses are converted without "
+          "protobuf reflection.");
+ABSL_FLAG(int32_t, native_http_port, 0,
+          "Port that the HTTP routes of the v2 API are served on in process, "
+          "instead of through Envoy. 0 disables the in-process listener.");
+ABSL_FLAG(int32_t, udf_max_partitions_per_execution, 1,
+          "Maximum number of partitions of a request that share one UDF "
+          "execution once every concurrent partition slot is busy.");
+ABSL_FLAG(int32_t, udf_output_cache_max_entries, 0,
+          "Number of UDF outputs kept for the code objects that allow it. 0 "
+          "disables the cache.");
+ABSL_FLAG(int32_t, udf_output_cache_ttl_millis, 10000,
+          "How long a UDF output is kept at most. Outputs are dropped earlier "
+          "when the data of the server changes.");
+ABSL_FLAG(std::string, udf_worker_cpus, "",
+          "CPUs that Roma workers run on, such as \"0-3,8\". Empty runs them "
+          "on any CPU.");
+ABSL_FLAG(std::string, grpc_server_cpus, "",
+          "CPUs that the threads of the gRPC server run on, such as "
+          "\"4-7\". Empty runs them on any CPU.");
+ABSL_FLAG(int32_t, udf_warm_up_rounds, 0,
+          "Rounds of synthetic executions, one per Roma worker each, that a "
+          "new UDF code object runs before it serves requests. 0 disables "
+          "warm-up.");
+ABSL_FLAG(std::string, udf_warm_up_argument, "",
+          "JSON of the UDFArgument that warm-up executions pass to the UDF, "
+          "such as {\"data\":[\"key1\"]}.");
+ABSL_FLAG(bool, remote_lookup_callback_api, false,
+          "Whether the remote lookup server serves lookups from other shards "
+          "with the gRPC callback API instead of the synchronous one.");
+ABSL_FLAG(int32_t, remote_lookup_num_cqs, 0,
+          "Completion queues of the synchronous remote lookup server. 0 keeps "
+          "gRPC's default.");
+ABSL_FLAG(int32_t, remote_lookup_min_pollers, 0,
+          "Minimum threads polling each completion queue of the synchronous "
+          "remote lookup server. 0 keeps gRPC's default.");
+ABSL_FLAG(int32_t, remote_lookup_max_pollers, 0,
+          "Maximum threads polling each completion queue of the synchronous "
+          "remote lookup server. 0 keeps gRPC's default.");
+ABSL_FLAG(int32_t, remote_lookup_response_compression_min_bytes, 0,
+          "Responses to lookups from other shards of at least this many bytes "
+          "are compressed before they're encrypted. 0 disables compression.");
+ABSL_FLAG(int32_t, remote_lookup_stream_chunk_max_values, 10'000,
+          "Set members and other results per chunk of a streamed response to "
+          "a lookup from another shard.");
+ABSL_FLAG(int32_t, remote_lookup_response_cache_max_entries, 0,
+          "Number of responses to lookups from other shards that are kept "
+          "until the data changes. 0 disables the cache.");
+ABSL_FLAG(bool, remote_lookup_stream_key_sets, false,
+          "Whether the set lookups sent to other shards stream their "
+          "responses in chunks. Requires servers that serve streamed "
+          "lookups.");
+ABSL_FLAG(int32_t, sharding_hash_version, 0,
+          "Version of the hash that keys are sharded with. 0 for SHA-256, 1 "
+          "for HighwayHash. Must be the same on all servers and match the "
+          "files sharded by the data CLI.");
+ABSL_FLAG(int32_t, num_logical_shards, 0,
+          "Number of logical shards that keys are hashed into, mapped onto the "
+          "physical shards by shard mapping records in the data files. 0 "
+          "hashes keys into the physical shards directly.");
+ABSL_FLAG(bool, separate_udf_servers, false,
+          "Whether the servers of shards [0, num_shards) only hold data and "
+          "don't run UDFs, while the servers of shard num_shards only run "
+          "UDFs and look up every key from the data servers.");
+ABSL_FLAG(int32_t, sharded_lookup_max_batches_in_flight, 0,
+          "Key lookups of concurrent requests are sent to the other shards in "
+          "batches, at most this many at a time. 0 sends the lookups of each "
+          "request on their own, unless batches have a window.");
+ABSL_FLAG(int32_t, sharded_lookup_batch_window_micros, 0,
+          "How long a batch of key lookups waits for the lookups of other "
+          "requests to join it before it's sent to the shards.");
+ABSL_FLAG(int32_t, sharded_lookup_batch_max_keys, 0,
+          "A batch of key lookups with this many keys is sent without waiting "
+          "for the rest of its window. 0 for no limit.");
+ABSL_FLAG(int32_t, sharded_lookup_padding_min_size_class_bytes, 0,
+          "Pads each request to other shards to the next size class, this "
+          "many bytes times a power of two, instead of to the largest request "
+          "of its lookup. 0 pads to the largest request.");
+ABSL_FLAG(bool, sharded_lookup_partial_key_sets, false,
+          "Whether set lookups succeed with the sets of the shards that "
+          "answered, and a status for each key of the shards that didn't, "
+          "instead of failing.");
+ABSL_FLAG(int32_t, shard_circuit_breaker_failure_threshold, 0,
+          "Consecutive failed lookups after which the lookups of a shard fail "
+          "without being sent, until the breaker is open for long enough. 0 "
+          "disables the circuit breakers.");
+ABSL_FLAG(int32_t, shard_circuit_breaker_open_millis, 1000,
+          "How long the lookups of a shard fail without being sent after its "
+          "circuit breaker trips, before a single lookup probes the shard.");
+ABSL_FLAG(int32_t, remote_lookup_timeout_millis, 0,
+          "Lookups sent to other shards fail after this long, even if their "
+          "request has more time left. 0 for the deadline of the request.");
+ABSL_FLAG(int32_t, remote_lookup_hedge_percentile, 0,
+          "A remote lookup that isn't answered within this percentile of the "
+          "recent latencies of its shard is also sent to another replica. 0 "
+          "disables hedging.");
+ABSL_FLAG(int32_t, remote_lookup_num_channels, 1,
+          "Channels, each with its own connection, that the lookups sent to "
+          "a replica of another shard are spread over.");
+ABSL_FLAG(int32_t, remote_lookup_keepalive_time_millis, 0,
+          "How long a connection to another shard is idle before it's "
+          "pinged. 0 for gRPC's default.");
+ABSL_FLAG(int32_t, remote_lookup_keepalive_timeout_millis, 0,
+          "How long a keepalive ping waits for its acknowledgement before the "
+          "connection is dropped. 0 for gRPC's default.");
+ABSL_FLAG(int32_t, remote_lookup_initial_window_size_bytes, 0,
+          "The initial HTTP/2 flow control window of the lookups sent to "
+          "other shards. 0 for gRPC's default, which adapts to the "
+          "bandwidth-delay product.");
+
+ABSL_FLAG(int32_t, request_warm_up_num_requests, 0,
+          "Sample requests that the server serves before it reports healthy, "
+          "to warm up the serving path. 0 disables warm-up.");
+ABSL_FLAG(int32_t, request_warm_up_concurrency, 4,
+          "Warm-up requests in flight at once.");
+ABSL_FLAG(int32_t, request_warm_up_timeout_millis, 30000,
+          "How long the server sends warm-up requests at most.");
+ABSL_FLAG(std::string, request_warm_up_requests_file, "",
+          "Local Riegeli file of recorded requests, as replayed by the "
+          "request simulation, sent as warm-up requests. Empty sends "
+          "requests for random keys.");
+ABSL_FLAG(std::string, profiling_bucket, "",
+          "Directory that nonprod servers write profiles to periodically. "
+          "Empty disables profiles.");
+ABSL_FLAG(int32_t, profiling_interval_millis, 600000,
+          "Time between two dumps of profiles.");
+ABSL_FLAG(int32_t, profiling_cpu_duration_millis, 10000,
+          "CPU time sampled by each dump of profiles. 0 skips CPU profiles.");
+ABSL_FLAG(int32_t, profiling_contention_sample_interval, 0,
+          "One in this many waits for contended mutexes is recorded. 0 skips "
+          "contention profiles.");
+ABSL_FLAG(int32_t, request_trace_sample_interval, 0,
+          "One in this many requests, picked at random, is traced. 0 traces "
+          "none.");
+ABSL_FLAG(bool, cache_lock_metrics_enabled, false,
+          "Whether the cache records the contention of its mutexes.");
+ABSL_FLAG(int32_t, cache_lock_long_hold_threshold_micros, 1000,
+          "Exclusive sections of cache mutexes held longer are counted.");
+ABSL_FLAG(bool, logical_commit_time_is_epoch_micros, false,
+          "Whether the logical commit times of the data are microseconds "
+          "since the epoch, to record the freshness of the loaded data.");
+ABSL_FLAG(bool, delta_file_notifications_trusted, false,
+          "Whether delta files named by change notifications are loaded "
+          "without listing the bucket.");
+ABSL_FLAG(bool, data_loading_serve_before_delta_catch_up, false,
+          "Whether the server reports ready once the snapshots are loaded, "
+          "and loads the delta files after them in the background.");
+ABSL_FLAG(int32_t, cache_set_lock_stripes, 0,
+          "Number of locks shared by the key-value sets of the lock_based "
+          "cache, stored in its key table. 0 gives every set its own lock.");
+ABSL_FLAG(std::string, cache_indexed_key_prefixes, "",
+          "Comma separated key prefixes whose keys the cache indexes in order, "
+          "for getValuesByPrefix.");
+ABSL_FLAG(std::string, cache_membership_index_key_prefixes, "",
+          "Comma separated key prefixes of the key-value sets that the "
+          "interned set storage indexes by member, for getSetsContaining.");
+ABSL_FLAG(int32_t, cache_membership_index_max_entries, 10000000,
+          "Maximum number of member and set key pairs in the membership index "
+          "of the key-value sets, past which the index is dropped.");
+ABSL_FLAG(std::string, cache_fixed_width_key_prefixes, "",
+          "Comma separated <key prefix>=<uint64|hash128> pairs whose keys the "
+          "cache stores as integers or hashes, e.g. uid:=uint64.");
 
 namespace kv_server {
 namespace {
@@ -95,6 +412,337 @@ class LocalParameterClient : public ParameterClient {
     string_flag_values_.insert(
         {"kv-server-local-data-loading-blob-prefix-allowlist",
          absl::GetFlag(FLAGS_data_loading_prefix_allowlist)});
+    string_flag_values_.insert(
+        {"kv-server-local-cache-num-shards",
+         absl::StrCat(absl::GetFlag(FLAGS_cache_num_shards))});
+    string_flag_values_.insert({"kv-server-local-cache-type",
+                                absl::GetFlag(FLAGS_cache_type)});
+    string_flag_values_.insert({"kv-server-local-cache-huge-pages",
+                                absl::GetFlag(FLAGS_cache_huge_pages)});
+    string_flag_values_.insert({"kv-server-local-cache-set-storage",
+                                absl::GetFlag(FLAGS_cache_set_storage)});
+    string_flag_values_.insert(
+        {"kv-server-local-cache-cleanup-slice-millis",
+         absl::StrCat(absl::GetFlag(FLAGS_cache_cleanup_slice_millis))});
+    string_flag_values_.insert(
+        {"kv-server-local-cache-snapshot-reload-interval-seconds",
+         absl::StrCat(
+             absl::GetFlag(FLAGS_cache_snapshot_reload_interval_seconds))});
+    string_flag_values_.insert(
+        {"kv-server-local-cache-value-compression-min-bytes",
+         absl::StrCat(absl::GetFlag(FLAGS_cache_value_compression_min_bytes))});
+    string_flag_values_.insert(
+        {"kv-server-local-cache-cold-tier-directory",
+         absl::GetFlag(FLAGS_cache_cold_tier_directory)});
+    string_flag_values_.insert(
+        {"kv-server-local-cache-hot-tier-max-mb",
+         absl::StrCat(absl::GetFlag(FLAGS_cache_hot_tier_max_mb))});
+    string_flag_values_.insert({"kv-server-local-cache-image-path",
+                                absl::GetFlag(FLAGS_cache_image_path)});
+    string_flag_values_.insert(
+        {"kv-server-local-cache-image-interval-minutes",
+         absl::StrCat(absl::GetFlag(FLAGS_cache_image_interval_minutes))});
+    string_flag_values_.insert({"kv-server-local-cache-numa-mode",
+                                absl::GetFlag(FLAGS_cache_numa_mode)});
+    string_flag_values_.insert(
+        {"kv-server-local-hot-key-cache-max-keys",
+         absl::StrCat(absl::GetFlag(FLAGS_hot_key_cache_max_keys))});
+    string_flag_values_.insert(
+        {"kv-server-local-hot-key-cache-ttl-millis",
+         absl::StrCat(absl::GetFlag(FLAGS_hot_key_cache_ttl_millis))});
+    string_flag_values_.insert(
+        {"kv-server-local-query-parallel-num-threads",
+         absl::StrCat(absl::GetFlag(FLAGS_query_parallel_num_threads))});
+    string_flag_values_.insert(
+        {"kv-server-local-query-parallel-min-set-size",
+         absl::StrCat(absl::GetFlag(FLAGS_query_parallel_min_set_size))});
+    string_flag_values_.insert(
+        {"kv-server-local-query-result-cache-max-queries",
+         absl::StrCat(absl::GetFlag(FLAGS_query_result_cache_max_queries))});
+    string_flag_values_.insert(
+        {"kv-server-local-set-sketch-cache-max-sets",
+         absl::StrCat(absl::GetFlag(FLAGS_set_sketch_cache_max_sets))});
+    string_flag_values_.insert(
+        {"kv-server-local-shared-thread-pool-num-threads",
+         absl::StrCat(absl::GetFlag(FLAGS_shared_thread_pool_num_threads))});
+    string_flag_values_.insert(
+        {"kv-server-local-data-loading-max-concurrent-files",
+         absl::StrCat(absl::GetFlag(FLAGS_data_loading_max_concurrent_files))});
+    string_flag_values_.insert(
+        {"kv-server-local-data-loading-max-queued-files",
+         absl::StrCat(absl::GetFlag(FLAGS_data_loading_max_queued_files))});
+    string_flag_values_.insert(
+        {"kv-server-local-data-loading-snapshot-check-backlog",
+         absl::StrCat(
+             absl::GetFlag(FLAGS_data_loading_snapshot_check_backlog))});
+    string_flag_values_.insert(
+        {"kv-server-local-data-loading-catch-up-min-files",
+         absl::StrCat(absl::GetFlag(FLAGS_data_loading_catch_up_min_files))});
+    string_flag_values_.insert(
+        {"kv-server-local-data-loading-trusted-file-verification-interval",
+         absl::StrCat(absl::GetFlag(
+             FLAGS_data_loading_trusted_file_verification_interval))});
+    string_flag_values_.insert(
+        {"kv-server-local-data-loading-serving-p99-target-millis",
+         absl::StrCat(
+             absl::GetFlag(FLAGS_data_loading_serving_p99_target_millis))});
+    string_flag_values_.insert(
+        {"kv-server-local-data-loading-throttle-delay-millis",
+         absl::StrCat(
+             absl::GetFlag(FLAGS_data_loading_throttle_delay_millis))});
+    string_flag_values_.insert(
+        {"kv-server-local-allocator-release-interval-seconds",
+         absl::StrCat(
+             absl::GetFlag(FLAGS_allocator_release_interval_seconds))});
+    string_flag_values_.insert(
+        {"kv-server-local-allocator-background-release-mb-per-second",
+         absl::StrCat(
+             absl::GetFlag(FLAGS_allocator_background_release_mb_per_second))});
+    string_flag_values_.insert(
+        {"kv-server-local-allocator-max-per-cpu-cache-kb",
+         absl::StrCat(absl::GetFlag(FLAGS_allocator_max_per_cpu_cache_kb))});
+    string_flag_values_.insert(
+        {"kv-server-local-data-loading-thread-nice-increment",
+         absl::StrCat(
+             absl::GetFlag(FLAGS_data_loading_thread_nice_increment))});
+    string_flag_values_.insert(
+        {"kv-server-local-realtime-updater-min-threads",
+         absl::StrCat(absl::GetFlag(FLAGS_realtime_updater_min_threads))});
+    string_flag_values_.insert(
+        {"kv-server-local-realtime-updater-batch-window-millis",
+         absl::StrCat(
+             absl::GetFlag(FLAGS_realtime_updater_batch_window_millis))});
+    string_flag_values_.insert({"kv-server-local-blob-cache-directory",
+                                absl::GetFlag(FLAGS_blob_cache_directory)});
+    string_flag_values_.insert(
+        {"kv-server-local-blob-cache-max-mb",
+         absl::StrCat(absl::GetFlag(FLAGS_blob_cache_max_mb))});
+    string_flag_values_.insert(
+        {"kv-server-local-max-concurrent-partitions-per-request",
+         absl::StrCat(
+             absl::GetFlag(FLAGS_max_concurrent_partitions_per_request))});
+    string_flag_values_.insert(
+        {"kv-server-local-data-loading-snapshot-publish-interval-minutes",
+         absl::StrCat(absl::GetFlag(
+             FLAGS_data_loading_snapshot_publish_interval_minutes))});
+    string_flag_values_.insert(
+        {"kv-server-local-data-loading-snapshot-publish-directory",
+         absl::GetFlag(FLAGS_data_loading_snapshot_publish_directory)});
+    string_flag_values_.insert(
+        {"kv-server-local-data-loading-shard-copy-directory",
+         absl::GetFlag(FLAGS_data_loading_shard_copy_directory)});
+    string_flag_values_.insert(
+        {"kv-server-local-data-loading-shard-copy-wait-millis",
+         absl::StrCat(
+             absl::GetFlag(FLAGS_data_loading_shard_copy_wait_millis))});
+    string_flag_values_.insert(
+        {"kv-server-local-v1-value-cache-max-keys",
+         absl::StrCat(absl::GetFlag(FLAGS_v1_value_cache_max_keys))});
+    string_flag_values_.insert(
+        {"kv-server-local-compression-brotli-quality",
+         absl::StrCat(absl::GetFlag(FLAGS_compression_brotli_quality))});
+    string_flag_values_.insert(
+        {"kv-server-local-compression-gzip-level",
+         absl::StrCat(absl::GetFlag(FLAGS_compression_gzip_level))});
+    string_flag_values_.insert(
+        {"kv-server-local-compression-zstd-level",
+         absl::StrCat(absl::GetFlag(FLAGS_compression_zstd_level))});
+    string_flag_values_.insert(
+        {"kv-server-local-compression-zstd-dictionary-path",
+         absl::GetFlag(FLAGS_compression_zstd_dictionary_path)});
+    string_flag_values_.insert(
+        {"kv-server-local-admission-max-concurrent-requests",
+         absl::StrCat(
+             absl::GetFlag(FLAGS_admission_max_concurrent_requests))});
+    string_flag_values_.insert(
+        {"kv-server-local-admission-latency-target-millis",
+         absl::StrCat(absl::GetFlag(FLAGS_admission_latency_target_millis))});
+    string_flag_values_.insert(
+        {"kv-server-local-admission-min-remaining-deadline-millis",
+         absl::StrCat(
+             absl::GetFlag(FLAGS_admission_min_remaining_deadline_millis))});
+    string_flag_values_.insert(
+        {"kv-server-local-coalesce-v1-requests",
+         absl::GetFlag(FLAGS_coalesce_v1_requests) ? "true" : "false"});
+    string_flag_values_.insert(
+        {"kv-server-local-coalesce-internal-lookups",
+         absl::GetFlag(FLAGS_coalesce_internal_lookups) ? "true" : "false"});
+    string_flag_values_.insert(
+        {"kv-server-local-coalesce-deterministic-udf-executions",
+         absl::GetFlag(FLAGS_coalesce_deterministic_udf_executions)
+             ? "true"
+             : "false"});
+    string_flag_values_.insert(
+        {"kv-server-local-fast-v2-json-codec",
+         absl::GetFlag(FLAGS_fast_v2_json_codec) ? "true" : "false"});
+    string_flag_values_.insert(
+        {"kv-server-local-native-http-port",
+         absl::StrCat(absl::GetFlag(FLAGS_native_http_port))});
+    string_flag_values_.insert(
+        {"kv-server-local-udf-max-partitions-per-execution",
+         absl::StrCat(absl::GetFlag(FLAGS_udf_max_partitions_per_execution))});
+    string_flag_values_.insert(
+        {"kv-server-local-udf-output-cache-max-entries",
+         absl::StrCat(absl::GetFlag(FLAGS_udf_output_cache_max_entries))});
+    string_flag_values_.insert(
+        {"kv-server-local-udf-output-cache-ttl-millis",
+         absl::StrCat(absl::GetFlag(FLAGS_udf_output_cache_ttl_millis))});
+    string_flag_values_.insert({"kv-server-local-udf-worker-cpus",
+                                absl::GetFlag(FLAGS_udf_worker_cpus)});
+    string_flag_values_.insert({"kv-server-local-grpc-server-cpus",
+                                absl::GetFlag(FLAGS_grpc_server_cpus)});
+    string_flag_values_.insert(
+        {"kv-server-local-udf-warm-up-rounds",
+         absl::StrCat(absl::GetFlag(FLAGS_udf_warm_up_rounds))});
+    string_flag_values_.insert({"kv-server-local-udf-warm-up-argument",
+                                absl::GetFlag(FLAGS_udf_warm_up_argument)});
+    string_flag_values_.insert(
+        {"kv-server-local-remote-lookup-callback-api",
+         absl::GetFlag(FLAGS_remote_lookup_callback_api) ? "true" : "false"});
+    string_flag_values_.insert(
+        {"kv-server-local-remote-lookup-num-cqs",
+         absl::StrCat(absl::GetFlag(FLAGS_remote_lookup_num_cqs))});
+    string_flag_values_.insert(
+        {"kv-server-local-remote-lookup-min-pollers",
+         absl::StrCat(absl::GetFlag(FLAGS_remote_lookup_min_pollers))});
+    string_flag_values_.insert(
+        {"kv-server-local-remote-lookup-max-pollers",
+         absl::StrCat(absl::GetFlag(FLAGS_remote_lookup_max_pollers))});
+    string_flag_values_.insert(
+        {"kv-server-local-remote-lookup-response-compression-min-bytes",
+         absl::StrCat(absl::GetFlag(
+             FLAGS_remote_lookup_response_compression_min_bytes))});
+    string_flag_values_.insert(
+        {"kv-server-local-remote-lookup-stream-chunk-max-values",
+         absl::StrCat(
+             absl::GetFlag(FLAGS_remote_lookup_stream_chunk_max_values))});
+    string_flag_values_.insert(
+        {"kv-server-local-remote-lookup-response-cache-max-entries",
+         absl::StrCat(
+             absl::GetFlag(FLAGS_remote_lookup_response_cache_max_entries))});
+    string_flag_values_.insert(
+        {"kv-server-local-sharding-hash-version",
+         absl::StrCat(absl::GetFlag(FLAGS_sharding_hash_version))});
+    string_flag_values_.insert(
+        {"kv-server-local-num-logical-shards",
+         absl::StrCat(absl::GetFlag(FLAGS_num_logical_shards))});
+    string_flag_values_.insert(
+        {"kv-server-local-separate-udf-servers",
+         absl::GetFlag(FLAGS_separate_udf_servers) ? "true" : "false"});
+    string_flag_values_.insert(
+        {"kv-server-local-remote-lookup-stream-key-sets",
+         absl::GetFlag(FLAGS_remote_lookup_stream_key_sets) ? "true"
+                                                            : "false"});
+    string_flag_values_.insert(
+        {"kv-server-local-sharded-lookup-max-batches-in-flight",
+         absl::StrCat(
+             absl::GetFlag(FLAGS_sharded_lookup_max_batches_in_flight))});
+    string_flag_values_.insert(
+        {"kv-server-local-sharded-lookup-batch-window-micros",
+         absl::StrCat(
+             absl::GetFlag(FLAGS_sharded_lookup_batch_window_micros))});
+    string_flag_values_.insert(
+        {"kv-server-local-sharded-lookup-batch-max-keys",
+         absl::StrCat(absl::GetFlag(FLAGS_sharded_lookup_batch_max_keys))});
+    string_flag_values_.insert(
+        {"kv-server-local-sharded-lookup-padding-min-size-class-bytes",
+         absl::StrCat(absl::GetFlag(
+             FLAGS_sharded_lookup_padding_min_size_class_bytes))});
+    string_flag_values_.insert(
+        {"kv-server-local-sharded-lookup-partial-key-sets",
+         absl::GetFlag(FLAGS_sharded_lookup_partial_key_sets) ? "true"
+                                                              : "false"});
+    string_flag_values_.insert(
+        {"kv-server-local-shard-circuit-breaker-failure-threshold",
+         absl::StrCat(
+             absl::GetFlag(FLAGS_shard_circuit_breaker_failure_threshold))});
+    string_flag_values_.insert(
+        {"kv-server-local-shard-circuit-breaker-open-millis",
+         absl::StrCat(absl::GetFlag(FLAGS_shard_circuit_breaker_open_millis))});
+    string_flag_values_.insert(
+        {"kv-server-local-remote-lookup-timeout-millis",
+         absl::StrCat(absl::GetFlag(FLAGS_remote_lookup_timeout_millis))});
+    string_flag_values_.insert(
+        {"kv-server-local-remote-lookup-hedge-percentile",
+         absl::StrCat(absl::GetFlag(FLAGS_remote_lookup_hedge_percentile))});
+    string_flag_values_.insert(
+        {"kv-server-local-remote-lookup-num-channels",
+         absl::StrCat(absl::GetFlag(FLAGS_remote_lookup_num_channels))});
+    string_flag_values_.insert(
+        {"kv-server-local-remote-lookup-keepalive-time-millis",
+         absl::StrCat(
+             absl::GetFlag(FLAGS_remote_lookup_keepalive_time_millis))});
+    string_flag_values_.insert(
+        {"kv-server-local-remote-lookup-keepalive-timeout-millis",
+         absl::StrCat(
+             absl::GetFlag(FLAGS_remote_lookup_keepalive_timeout_millis))});
+    string_flag_values_.insert(
+        {"kv-server-local-remote-lookup-initial-window-size-bytes",
+         absl::StrCat(
+             absl::GetFlag(FLAGS_remote_lookup_initial_window_size_bytes))});
+    string_flag_values_.insert(
+        {"kv-server-local-request-warm-up-num-requests",
+         absl::StrCat(absl::GetFlag(FLAGS_request_warm_up_num_requests))});
+    string_flag_values_.insert(
+        {"kv-server-local-request-warm-up-concurrency",
+         absl::StrCat(absl::GetFlag(FLAGS_request_warm_up_concurrency))});
+    string_flag_values_.insert(
+        {"kv-server-local-request-warm-up-timeout-millis",
+         absl::StrCat(absl::GetFlag(FLAGS_request_warm_up_timeout_millis))});
+    string_flag_values_.insert(
+        {"kv-server-local-request-warm-up-requests-file",
+         absl::GetFlag(FLAGS_request_warm_up_requests_file)});
+    string_flag_values_.insert({"kv-server-local-profiling-bucket",
+                                absl::GetFlag(FLAGS_profiling_bucket)});
+    string_flag_values_.insert(
+        {"kv-server-local-profiling-interval-millis",
+         absl::StrCat(absl::GetFlag(FLAGS_profiling_interval_millis))});
+    string_flag_values_.insert(
+        {"kv-server-local-profiling-cpu-duration-millis",
+         absl::StrCat(absl::GetFlag(FLAGS_profiling_cpu_duration_millis))});
+    string_flag_values_.insert(
+        {"kv-server-local-profiling-contention-sample-interval",
+         absl::StrCat(
+             absl::GetFlag(FLAGS_profiling_contention_sample_interval))});
+    string_flag_values_.insert(
+        {"kv-server-local-request-trace-sample-interval",
+         absl::StrCat(absl::GetFlag(FLAGS_request_trace_sample_interval))});
+    string_flag_values_.insert(
+        {"kv-server-local-cache-lock-metrics-enabled",
+         absl::GetFlag(FLAGS_cache_lock_metrics_enabled) ? "true" : "false"});
+    string_flag_values_.insert(
+        {"kv-server-local-cache-lock-long-hold-threshold-micros",
+         absl::StrCat(
+             absl::GetFlag(FLAGS_cache_lock_long_hold_threshold_micros))});
+    string_flag_values_.insert(
+        {"kv-server-local-logical-commit-time-is-epoch-micros",
+         absl::GetFlag(FLAGS_logical_commit_time_is_epoch_micros) ? "true"
+                                                                  : "false"});
+    string_flag_values_.insert(
+        {"kv-server-local-delta-file-notifications-trusted",
+         absl::GetFlag(FLAGS_delta_file_notifications_trusted) ? "true"
+                                                               : "false"});
+    string_flag_values_.insert(
+        {"kv-server-local-data-loading-serve-before-delta-catch-up",
+         absl::GetFlag(FLAGS_data_loading_serve_before_delta_catch_up)
+             ? "true"
+             : "false"});
+    string_flag_values_.insert(
+        {"kv-server-local-cache-set-lock-stripes",
+         absl::StrCat(absl::GetFlag(FLAGS_cache_set_lock_stripes))});
+    string_flag_values_.insert(
+        {"kv-server-local-cache-indexed-key-prefixes",
+         absl::GetFlag(FLAGS_cache_indexed_key_prefixes)});
+    string_flag_values_.insert(
+        {"kv-server-local-cache-membership-index-key-prefixes",
+         absl::GetFlag(FLAGS_cache_membership_index_key_prefixes)});
+    string_flag_values_.insert(
+        {"kv-server-local-cache-membership-index-max-entries",
+         absl::StrCat(
+             absl::GetFlag(FLAGS_cache_membership_index_max_entries))});
+    string_flag_values_.insert(
+        {"kv-server-local-cache-fixed-width-key-prefixes",
+         absl::GetFlag(FLAGS_cache_fixed_width_key_prefixes)});
     // Insert more string flag values here.
 
     int32_t_flag_values_.insert(
@@ -149,6 +797,8 @@ class LocalParameterClient : public ParameterClient {
     const auto& it = string_flag_values_.find(parameter_name);
     if (it != string_flag_values_.end()) {
       return it->second;
+    } else if (default_value.has_value()) {
+      return *default_value;
     } else {
       return absl::InvalidArgumentError(
           absl::StrCat("Unknown local string parameter: ", parameter_name));
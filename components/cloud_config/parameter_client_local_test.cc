@@ -146,6 +146,627 @@ TEST(ParameterClientLocal, ExpectedFlagDefaultsArePresent) {
     ASSERT_TRUE(statusor.ok());
     EXPECT_EQ("mode: EXPERIMENT", *statusor);
   }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-cache-num-shards");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("1", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter("kv-server-local-cache-type");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("lock_based", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-cache-huge-pages");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("none", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-cache-set-storage");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("strings", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-cache-cleanup-slice-millis");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("0", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-cache-snapshot-reload-interval-seconds");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("0", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-cache-value-compression-min-bytes");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("0", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-cache-cold-tier-directory");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("/tmp", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-cache-hot-tier-max-mb");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("1024", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-cache-image-path");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-cache-image-interval-minutes");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("30", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-cache-numa-mode");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("off", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-hot-key-cache-max-keys");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("0", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-hot-key-cache-ttl-millis");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("10000", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-query-parallel-num-threads");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("0", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-query-parallel-min-set-size");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("10000", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-query-result-cache-max-queries");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("1000", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-set-sketch-cache-max-sets");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("1000", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-shared-thread-pool-num-threads");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("0", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-data-loading-max-concurrent-files");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("4", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-data-loading-max-queued-files");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("1000", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-data-loading-snapshot-check-backlog");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("10", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-data-loading-catch-up-min-files");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("20", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-data-loading-trusted-file-verification-interval");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("1", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-data-loading-serving-p99-target-millis");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("0", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-data-loading-throttle-delay-millis");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("5", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-allocator-release-interval-seconds");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("0", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-allocator-background-release-mb-per-second");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("0", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-allocator-max-per-cpu-cache-kb");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("0", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-data-loading-thread-nice-increment");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("0", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-realtime-updater-min-threads");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("0", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-realtime-updater-batch-window-millis");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("0", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-blob-cache-directory");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-blob-cache-max-mb");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("10240", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-max-concurrent-partitions-per-request");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("8", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-data-loading-snapshot-publish-interval-minutes");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("0", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-data-loading-snapshot-publish-directory");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("/tmp", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-data-loading-shard-copy-directory");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-data-loading-shard-copy-wait-millis");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("300000", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-v1-value-cache-max-keys");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("0", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-compression-brotli-quality");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("11", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-compression-gzip-level");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("6", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-compression-zstd-level");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("3", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-compression-zstd-dictionary-path");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-admission-max-concurrent-requests");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("0", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-admission-latency-target-millis");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("0", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-admission-min-remaining-deadline-millis");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("0", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-coalesce-v1-requests");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("false", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-coalesce-internal-lookups");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("false", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-coalesce-deterministic-udf-executions");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("false", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-fast-v2-json-codec");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("false", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-native-http-port");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("0", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-udf-max-partitions-per-execution");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("1", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-udf-output-cache-max-entries");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("0", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-udf-output-cache-ttl-millis");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("10000", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-udf-worker-cpus");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-grpc-server-cpus");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-udf-warm-up-rounds");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("0", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-udf-warm-up-argument");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-remote-lookup-callback-api");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("false", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-remote-lookup-num-cqs");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("0", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-remote-lookup-min-pollers");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("0", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-remote-lookup-max-pollers");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("0", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-remote-lookup-response-compression-min-bytes");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("0", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-remote-lookup-stream-chunk-max-values");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("10000", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-remote-lookup-response-cache-max-entries");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("0", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-sharding-hash-version");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("0", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-num-logical-shards");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("0", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-separate-udf-servers");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("false", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-remote-lookup-stream-key-sets");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("false", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-sharded-lookup-max-batches-in-flight");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("0", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-sharded-lookup-batch-window-micros");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("0", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-sharded-lookup-batch-max-keys");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("0", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-sharded-lookup-padding-min-size-class-bytes");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("0", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-sharded-lookup-partial-key-sets");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("false", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-shard-circuit-breaker-failure-threshold");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("0", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-shard-circuit-breaker-open-millis");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("1000", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-remote-lookup-timeout-millis");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("0", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-remote-lookup-hedge-percentile");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("0", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-remote-lookup-num-channels");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("1", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-remote-lookup-keepalive-time-millis");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("0", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-remote-lookup-keepalive-timeout-millis");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("0", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-remote-lookup-initial-window-size-bytes");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("0", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-request-warm-up-num-requests");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("0", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-request-warm-up-concurrency");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("4", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-request-warm-up-timeout-millis");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("30000", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-request-warm-up-requests-file");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-profiling-bucket");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-profiling-interval-millis");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("600000", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-profiling-cpu-duration-millis");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("10000", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-profiling-contention-sample-interval");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("0", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-request-trace-sample-interval");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("0", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-cache-lock-metrics-enabled");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("false", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-cache-lock-long-hold-threshold-micros");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("1000", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-logical-commit-time-is-epoch-micros");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("false", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-delta-file-notifications-trusted");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("false", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-data-loading-serve-before-delta-catch-up");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("false", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-cache-set-lock-stripes");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("0", *statusor);
+  }
+  {
+    const auto statusor =
+        client->GetParameter("kv-server-local-cache-indexed-key-prefixes");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-cache-membership-index-key-prefixes");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-cache-membership-index-max-entries");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("10000000", *statusor);
+  }
+  {
+    const auto statusor = client->GetParameter(
+        "kv-server-local-cache-fixed-width-key-prefixes");
+    ASSERT_TRUE(statusor.ok());
+    EXPECT_EQ("", *statusor);
+  }
+}
+
+TEST(ParameterClientLocal, UnknownParameterReturnsDefaultValue) {
+  std::unique_ptr<ParameterClient> client = ParameterClient::Create();
+  ASSERT_TRUE(client != nullptr);
+  EXPECT_FALSE(client->GetParameter("kv-server-local-unknown").ok());
+  const auto statusor =
+      client->GetParameter("kv-server-local-unknown", "default");
+  ASSERT_TRUE(statusor.ok());
+  EXPECT_EQ("default", *statusor);
 }
 
 }  // namespace
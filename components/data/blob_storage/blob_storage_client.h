@@ -20,7 +20,9 @@
 #include <functional>
 #include <iostream>
 #include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <vector>
 
@@ -37,6 +39,9 @@ class BlobReader {
   virtual std::istream& Stream() = 0;
   // True if the istream returned by `Stream` supports `seek`.
   virtual bool CanSeek() const = 0;
+  // The whole blob, if it is in memory, e.g. memory-mapped, so that readers
+  // can read it in place instead of through `Stream`.
+  virtual std::optional<std::string_view> Contents() { return std::nullopt; }
 };
 
 // Abstraction to interact with cloud file storage.
@@ -62,6 +67,15 @@ class BlobStorageClient {
     ClientOptions() = default;
     int64_t max_connections = std::thread::hardware_concurrency();
     int64_t max_range_bytes = 8 * 1024 * 1024;  // 8MB
+    // Number of byte ranges of a blob downloaded concurrently ahead of its
+    // reader. 0 downloads a range once the previous one is read.
+    int64_t read_ahead_chunks = 4;
+    // Sizes of the socket buffers of the client connections, so that
+    // connections with a large bandwidth-delay product aren't bound by the
+    // TCP window. 0 keeps the system defaults. Only honored by clients that
+    // expose the sockets.
+    int64_t socket_receive_buffer_bytes = 0;
+    int64_t socket_send_buffer_bytes = 0;
   };
 
   virtual ~BlobStorageClient() = default;
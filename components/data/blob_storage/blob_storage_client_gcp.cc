@@ -34,6 +34,7 @@
 #include "components/data/blob_storage/blob_storage_client.h"
 #include "components/data/blob_storage/seeking_input_streambuf.h"
 #include "components/errors/error_util_gcp.h"
+#include "components/telemetry/server_definition.h"
 #include "google/cloud/storage/client.h"
 
 namespace kv_server {
@@ -52,6 +53,7 @@ class GcpBlobInputStreamBuf : public SeekingInputStreambuf {
         client_(client),
         location_(std::move(location)) {}
 
+  ~GcpBlobInputStreamBuf() override { StopReadAhead(); }
   GcpBlobInputStreamBuf(const GcpBlobInputStreamBuf&) = delete;
   GcpBlobInputStreamBuf& operator=(const GcpBlobInputStreamBuf&) = delete;
 
@@ -87,15 +89,18 @@ class GcpBlobInputStreamBuf : public SeekingInputStreambuf {
 class GcpBlobReader : public BlobReader {
  public:
   GcpBlobReader(google::cloud::storage::Client& client,
-                BlobStorageClient::DataLocation location)
+                BlobStorageClient::DataLocation location,
+                const BlobStorageClient::ClientOptions& client_options)
       : BlobReader(),
         streambuf_(client, location,
-                   GetOptions([this, location](absl::Status status) {
-                     LOG(ERROR) << "Blob "
-                                << AppendPrefix(location.key, location.prefix)
-                                << " failed stream with: " << status;
-                     is_.setstate(std::ios_base::badbit);
-                   })),
+                   GetOptions(client_options,
+                              [this, location](absl::Status status) {
+                                LOG(ERROR) << "Blob "
+                                           << AppendPrefix(location.key,
+                                                           location.prefix)
+                                           << " failed stream with: " << status;
+                                is_.setstate(std::ios_base::badbit);
+                              })),
         is_(&streambuf_) {}
 
   std::istream& Stream() { return is_; }
@@ -103,9 +108,13 @@ class GcpBlobReader : public BlobReader {
 
  private:
   static SeekingInputStreambuf::Options GetOptions(
+      const BlobStorageClient::ClientOptions& client_options,
       std::function<void(absl::Status)> error_callback) {
     SeekingInputStreambuf::Options options;
+    options.read_ahead_chunks = client_options.read_ahead_chunks;
+    options.buffer_size = client_options.max_range_bytes;
     options.error_callback = std::move(error_callback);
+    options.client_name = kBlobStorageClientGcs;
     return options;
   }
 
@@ -115,12 +124,14 @@ class GcpBlobReader : public BlobReader {
 }  // namespace
 
 GcpBlobStorageClient::GcpBlobStorageClient(
-    std::unique_ptr<google::cloud::storage::Client> client)
-    : client_(std::move(client)) {}
+    std::unique_ptr<google::cloud::storage::Client> client,
+    ClientOptions client_options)
+    : client_(std::move(client)), client_options_(std::move(client_options)) {}
 
 std::unique_ptr<BlobReader> GcpBlobStorageClient::GetBlobReader(
     DataLocation location) {
-  return std::make_unique<GcpBlobReader>(*client_, std::move(location));
+  return std::make_unique<GcpBlobReader>(*client_, std::move(location),
+                                         client_options_);
 }
 
 absl::Status GcpBlobStorageClient::PutBlob(BlobReader& blob_reader,
@@ -178,9 +189,21 @@ class GcpBlobStorageClientFactory : public BlobStorageClientFactory {
  public:
   ~GcpBlobStorageClientFactory() = default;
   std::unique_ptr<BlobStorageClient> CreateBlobStorageClient(
-      BlobStorageClient::ClientOptions /*client_options*/) override {
+      BlobStorageClient::ClientOptions client_options) override {
+    auto options = google::cloud::Options{}.set<
+        google::cloud::storage::ConnectionPoolSizeOption>(
+        static_cast<std::size_t>(client_options.max_connections));
+    if (client_options.socket_receive_buffer_bytes > 0) {
+      options.set<google::cloud::storage::MaximumCurlSocketRecvSizeOption>(
+          static_cast<std::size_t>(client_options.socket_receive_buffer_bytes));
+    }
+    if (client_options.socket_send_buffer_bytes > 0) {
+      options.set<google::cloud::storage::MaximumCurlSocketSendSizeOption>(
+          static_cast<std::size_t>(client_options.socket_send_buffer_bytes));
+    }
     return std::make_unique<GcpBlobStorageClient>(
-        std::make_unique<google::cloud::storage::Client>());
+        std::make_unique<google::cloud::storage::Client>(std::move(options)),
+        std::move(client_options));
   }
 };
 }  // namespace
@@ -28,7 +28,8 @@ namespace kv_server {
 class GcpBlobStorageClient : public BlobStorageClient {
  public:
   explicit GcpBlobStorageClient(
-      std::unique_ptr<google::cloud::storage::Client> client);
+      std::unique_ptr<google::cloud::storage::Client> client,
+      ClientOptions client_options = ClientOptions());
 
   ~GcpBlobStorageClient() = default;
 
@@ -43,5 +44,6 @@ class GcpBlobStorageClient : public BlobStorageClient {
 
  private:
   std::unique_ptr<google::cloud::storage::Client> client_;
+  const ClientOptions client_options_;
 };
 }  // namespace kv_server
@@ -26,6 +26,7 @@
 #include "absl/strings/match.h"
 #include "absl/strings/str_cat.h"
 #include "components/data/blob_storage/blob_storage_client.h"
+#include "components/data/blob_storage/mapped_blob_reader.h"
 #include "components/data/blob_storage/seeking_input_streambuf.h"
 
 namespace kv_server {
@@ -46,6 +47,13 @@ class FileBlobReader : public BlobReader {
 
 std::unique_ptr<BlobReader> FileBlobStorageClient::GetBlobReader(
     DataLocation location) {
+  // Mapped files are read straight from the page cache.
+  if (auto mapped_reader =
+          MappedBlobReader::Open(GetFullPath(location).string());
+      mapped_reader.ok()) {
+    return *std::move(mapped_reader);
+  }
+  // Files that can't be mapped, such as pipes, are read as streams.
   std::unique_ptr<BlobReader> reader =
       std::make_unique<FileBlobReader>(GetFullPath(location));
 
@@ -39,6 +39,7 @@
 #include "components/data/blob_storage/blob_storage_client.h"
 #include "components/data/blob_storage/seeking_input_streambuf.h"
 #include "components/errors/error_util_aws.h"
+#include "components/telemetry/server_definition.h"
 
 namespace kv_server {
 namespace {
@@ -47,7 +48,8 @@ std::string AppendPrefix(const std::string& value, const std::string& prefix) {
   return prefix.empty() ? value : absl::StrCat(prefix, "/", value);
 }
 
-// Sequentially load byte range data with a fixed amount of memory usage.
+// Loads byte ranges, a few of them ahead of the reader, with a bounded amount
+// of memory.
 class S3BlobInputStreamBuf : public SeekingInputStreambuf {
  public:
   S3BlobInputStreamBuf(Aws::S3::S3Client& client,
@@ -57,6 +59,7 @@ class S3BlobInputStreamBuf : public SeekingInputStreambuf {
         client_(client),
         location_(std::move(location)) {}
 
+  ~S3BlobInputStreamBuf() override { StopReadAhead(); }
   S3BlobInputStreamBuf(const S3BlobInputStreamBuf&) = delete;
   S3BlobInputStreamBuf& operator=(const S3BlobInputStreamBuf&) = delete;
 
@@ -107,10 +110,10 @@ class S3BlobReader : public BlobReader {
  public:
   S3BlobReader(Aws::S3::S3Client& client,
                BlobStorageClient::DataLocation location,
-               int64_t max_range_bytes)
+               const BlobStorageClient::ClientOptions& client_options)
       : BlobReader(),
         streambuf_(client, location,
-                   GetOptions(max_range_bytes,
+                   GetOptions(client_options,
                               [this, location](absl::Status status) {
                                 LOG(ERROR) << "Blob " << location.key
                                            << " failed stream with: " << status;
@@ -123,10 +126,13 @@ class S3BlobReader : public BlobReader {
 
  private:
   static SeekingInputStreambuf::Options GetOptions(
-      int64_t buffer_size, std::function<void(absl::Status)> error_callback) {
+      const BlobStorageClient::ClientOptions& client_options,
+      std::function<void(absl::Status)> error_callback) {
     SeekingInputStreambuf::Options options;
-    options.buffer_size = buffer_size;
+    options.read_ahead_chunks = client_options.read_ahead_chunks;
+    options.buffer_size = client_options.max_range_bytes;
     options.error_callback = std::move(error_callback);
+    options.client_name = kBlobStorageClientS3;
     return options;
   }
 
@@ -136,8 +142,8 @@ class S3BlobReader : public BlobReader {
 }  // namespace
 
 S3BlobStorageClient::S3BlobStorageClient(
-    std::shared_ptr<Aws::S3::S3Client> client, int64_t max_range_bytes)
-    : client_(client), max_range_bytes_(max_range_bytes) {
+    std::shared_ptr<Aws::S3::S3Client> client, ClientOptions client_options)
+    : client_(client), client_options_(std::move(client_options)) {
   executor_ = std::make_unique<Aws::Utils::Threading::PooledThreadExecutor>(
       std::thread::hardware_concurrency());
   Aws::Transfer::TransferManagerConfiguration transfer_config(executor_.get());
@@ -148,7 +154,7 @@ S3BlobStorageClient::S3BlobStorageClient(
 std::unique_ptr<BlobReader> S3BlobStorageClient::GetBlobReader(
     DataLocation location) {
   return std::make_unique<S3BlobReader>(*client_, std::move(location),
-                                        max_range_bytes_);
+                                        client_options_);
 }
 
 absl::Status S3BlobStorageClient::PutBlob(BlobReader& reader,
@@ -227,11 +233,13 @@ class S3BlobStorageClientFactory : public BlobStorageClientFactory {
       BlobStorageClient::ClientOptions client_options) override {
     Aws::Client::ClientConfiguration config;
     config.maxConnections = client_options.max_connections;
+    // The AWS SDK doesn't expose the sockets of the default HTTP client, so
+    // the socket buffer sizes are left to the system.
     std::shared_ptr<Aws::S3::S3Client> client =
         std::make_shared<Aws::S3::S3Client>(config);
 
-    return std::make_unique<S3BlobStorageClient>(
-        client, client_options.max_range_bytes);
+    return std::make_unique<S3BlobStorageClient>(client,
+                                                 std::move(client_options));
   }
 };
 }  // namespace
@@ -30,8 +30,8 @@ namespace kv_server {
 
 class S3BlobStorageClient : public BlobStorageClient {
  public:
-  explicit S3BlobStorageClient(std::shared_ptr<Aws::S3::S3Client> client,
-                               int64_t max_range_bytes);
+  S3BlobStorageClient(std::shared_ptr<Aws::S3::S3Client> client,
+                      ClientOptions client_options);
 
   ~S3BlobStorageClient() = default;
 
@@ -50,6 +50,6 @@ class S3BlobStorageClient : public BlobStorageClient {
   std::unique_ptr<Aws::Utils::Threading::PooledThreadExecutor> executor_;
   std::shared_ptr<Aws::S3::S3Client> client_;
   std::shared_ptr<Aws::Transfer::TransferManager> transfer_manager_;
-  int64_t max_range_bytes_;
+  const ClientOptions client_options_;
 };
 }  // namespace kv_server
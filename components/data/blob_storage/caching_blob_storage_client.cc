@@ -0,0 +1,269 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data/blob_storage/caching_blob_storage_client.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <fstream>
+#include <istream>
+#include <utility>
+#include <vector>
+
+#include "absl/log/log.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "components/data/blob_storage/mapped_blob_reader.h"
+
+namespace kv_server {
+namespace {
+
+// Extension of the copies being written.
+constexpr std::string_view kPartialCopyExtension = ".partial";
+constexpr int64_t kCopyBufferSize = 1024 * 1024;
+
+std::filesystem::path PartialCopyPath(const std::filesystem::path& path) {
+  std::filesystem::path partial_path = path;
+  partial_path += kPartialCopyExtension;
+  return partial_path;
+}
+
+}  // namespace
+
+CachingBlobStorageClient::CachingBlobStorageClient(
+    std::unique_ptr<BlobStorageClient> client, Options options)
+    : client_(std::move(client)), options_(std::move(options)) {}
+
+absl::StatusOr<std::unique_ptr<CachingBlobStorageClient>>
+CachingBlobStorageClient::Create(std::unique_ptr<BlobStorageClient> client,
+                                 Options options) {
+  std::error_code error;
+  std::filesystem::create_directories(options.directory, error);
+  if (error) {
+    return absl::InternalError(absl::StrCat(
+        "Failed to create ", options.directory, ": ", error.message()));
+  }
+  // Copies left from before a restart are read again, the most recently read
+  // ones, which have the latest write times, last to be evicted.
+  std::vector<std::pair<std::filesystem::file_time_type, std::filesystem::path>>
+      files;
+  for (auto entry =
+           std::filesystem::recursive_directory_iterator(options.directory,
+                                                         error);
+       !error && entry != std::filesystem::recursive_directory_iterator();
+       entry.increment(error)) {
+    if (!entry->is_regular_file()) {
+      continue;
+    }
+    if (entry->path().extension() == kPartialCopyExtension) {
+      std::error_code remove_error;
+      std::filesystem::remove(entry->path(), remove_error);
+      continue;
+    }
+    files.emplace_back(entry->last_write_time(), entry->path());
+  }
+  if (error) {
+    return absl::InternalError(absl::StrCat(
+        "Failed to list ", options.directory, ": ", error.message()));
+  }
+  std::sort(files.begin(), files.end());
+  auto caching_client = absl::WrapUnique(
+      new CachingBlobStorageClient(std::move(client), std::move(options)));
+  absl::MutexLock lock(&caching_client->mutex_);
+  for (const auto& [write_time, path] : files) {
+    if (const auto size = std::filesystem::file_size(path, error); !error) {
+      caching_client->AddCopy(path.string(), size);
+    }
+  }
+  caching_client->EvictCopies();
+  LOG(INFO) << "Found " << caching_client->copies_.size() << " blob copies, "
+            << caching_client->cached_bytes_ << " bytes, in "
+            << caching_client->options_.directory;
+  return caching_client;
+}
+
+std::unique_ptr<BlobReader> CachingBlobStorageClient::GetBlobReader(
+    DataLocation location) {
+  const std::filesystem::path path = CopyPath(location);
+  const std::string path_string = path.string();
+  bool has_copy = false;
+  bool downloads = false;
+  std::shared_ptr<absl::Notification> download;
+  {
+    absl::MutexLock lock(&mutex_);
+    if (const auto copy = copies_.find(path_string); copy != copies_.end()) {
+      lru_.splice(lru_.end(), lru_, copy->second.lru_position);
+      has_copy = true;
+    } else if (const auto it = downloads_.find(path_string);
+               it != downloads_.end()) {
+      download = it->second;
+    } else {
+      download = std::make_shared<absl::Notification>();
+      downloads_.emplace(path_string, download);
+      downloads = true;
+    }
+  }
+  if (downloads) {
+    const absl::StatusOr<int64_t> size = DownloadCopy(location, path);
+    {
+      absl::MutexLock lock(&mutex_);
+      downloads_.erase(path_string);
+      if (size.ok()) {
+        AddCopy(path_string, *size);
+        EvictCopies();
+      }
+    }
+    download->Notify();
+    if (!size.ok()) {
+      LOG(ERROR) << "Failed to copy blob " << location << ": "
+                 << size.status();
+      return client_->GetBlobReader(std::move(location));
+    }
+  } else if (!has_copy) {
+    download->WaitForNotification();
+  }
+  auto reader = MappedBlobReader::Open(path_string);
+  if (!reader.ok()) {
+    // The copy failed, or was evicted since.
+    LOG(WARNING) << "Reading blob " << location
+                 << " without a copy: " << reader.status();
+    return client_->GetBlobReader(std::move(location));
+  }
+  if (has_copy) {
+    // Keeps the order of the copies across restarts.
+    std::error_code error;
+    std::filesystem::last_write_time(
+        path, std::filesystem::file_time_type::clock::now(), error);
+  }
+  return *std::move(reader);
+}
+
+absl::Status CachingBlobStorageClient::PutBlob(BlobReader& blob_reader,
+                                               DataLocation location) {
+  const std::string path = CopyPath(location).string();
+  const absl::Status status = client_->PutBlob(blob_reader, location);
+  absl::MutexLock lock(&mutex_);
+  DropCopy(path);
+  return status;
+}
+
+absl::Status CachingBlobStorageClient::DeleteBlob(DataLocation location) {
+  const std::string path = CopyPath(location).string();
+  const absl::Status status = client_->DeleteBlob(std::move(location));
+  absl::MutexLock lock(&mutex_);
+  DropCopy(path);
+  return status;
+}
+
+absl::StatusOr<std::vector<std::string>> CachingBlobStorageClient::ListBlobs(
+    DataLocation location, ListOptions options) {
+  return client_->ListBlobs(std::move(location), std::move(options));
+}
+
+int64_t CachingBlobStorageClient::cached_bytes() const {
+  absl::MutexLock lock(&mutex_);
+  return cached_bytes_;
+}
+
+std::filesystem::path CachingBlobStorageClient::CopyPath(
+    const DataLocation& location) const {
+  // Buckets of the local platform are absolute directories.
+  std::filesystem::path path = std::filesystem::path(options_.directory) /
+                               std::filesystem::path(location.bucket)
+                                   .relative_path();
+  if (!location.prefix.empty()) {
+    path /= location.prefix;
+  }
+  return path / location.key;
+}
+
+absl::StatusOr<int64_t> CachingBlobStorageClient::DownloadCopy(
+    const DataLocation& location, const std::filesystem::path& path) {
+  std::unique_ptr<BlobReader> reader = client_->GetBlobReader(location);
+  if (reader == nullptr) {
+    return absl::UnavailableError("Failed to open the blob");
+  }
+  std::error_code error;
+  std::filesystem::create_directories(path.parent_path(), error);
+  if (error) {
+    return absl::InternalError(absl::StrCat(
+        "Failed to create ", path.parent_path().string(), ": ",
+        error.message()));
+  }
+  const std::filesystem::path partial_path = PartialCopyPath(path);
+  std::ofstream copy(partial_path, std::ios_base::binary);
+  if (!copy) {
+    return absl::ErrnoToStatus(
+        errno, absl::StrCat("Unable to open file: ", partial_path.string()));
+  }
+  std::istream& stream = reader->Stream();
+  std::vector<char> buffer(kCopyBufferSize);
+  int64_t size = 0;
+  while (stream.read(buffer.data(), buffer.size()) || stream.gcount() > 0) {
+    copy.write(buffer.data(), stream.gcount());
+    size += stream.gcount();
+  }
+  copy.close();
+  if (stream.bad() || !copy) {
+    std::filesystem::remove(partial_path, error);
+    return absl::InternalError(
+        absl::StrCat("Failed to write ", partial_path.string()));
+  }
+  std::filesystem::rename(partial_path, path, error);
+  if (error) {
+    std::filesystem::remove(partial_path, error);
+    return absl::InternalError(absl::StrCat(
+        "Failed to rename ", partial_path.string(), ": ", error.message()));
+  }
+  LOG(INFO) << "Copied " << size << " bytes of blob " << location << " to "
+            << path;
+  return size;
+}
+
+void CachingBlobStorageClient::AddCopy(const std::string& path, int64_t size) {
+  if (const auto copy = copies_.find(path); copy != copies_.end()) {
+    cached_bytes_ -= copy->second.size;
+    lru_.erase(copy->second.lru_position);
+    copies_.erase(copy);
+  }
+  lru_.push_back(path);
+  copies_.emplace(path, Copy{.size = size, .lru_position = --lru_.end()});
+  cached_bytes_ += size;
+}
+
+void CachingBlobStorageClient::DropCopy(const std::string& path) {
+  const auto copy = copies_.find(path);
+  if (copy == copies_.end()) {
+    return;
+  }
+  cached_bytes_ -= copy->second.size;
+  lru_.erase(copy->second.lru_position);
+  copies_.erase(copy);
+  std::error_code error;
+  std::filesystem::remove(path, error);
+}
+
+void CachingBlobStorageClient::EvictCopies() {
+  // The most recently read copy is kept even if it is larger than the limit,
+  // it is being read.
+  while (cached_bytes_ > options_.max_bytes && lru_.size() > 1) {
+    const std::string path = lru_.front();
+    VLOG(2) << "Evicting blob copy " << path;
+    DropCopy(path);
+  }
+}
+
+}  // namespace kv_server
@@ -0,0 +1,114 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_BLOB_STORAGE_CACHING_BLOB_STORAGE_CLIENT_H_
+#define COMPONENTS_DATA_BLOB_STORAGE_CACHING_BLOB_STORAGE_CLIENT_H_
+
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "components/data/blob_storage/blob_storage_client.h"
+
+namespace kv_server {
+
+// Keeps a copy of the blobs read through another client in a local
+// directory, so that a server reads the snapshot and delta files that it
+// already downloaded, before a restart too, from local disk. Readers of
+// copied blobs read a memory mapping of the local file.
+//
+// Data files aren't modified once they are written, a new version of a file
+// gets a new name, so copies are keyed by bucket, prefix and key. Blobs put
+// or deleted through this client drop their copy.
+class CachingBlobStorageClient : public BlobStorageClient {
+ public:
+  struct Options {
+    // Directory of the copies, created if missing.
+    std::string directory;
+    // Once the copies take more than this, the least recently read ones are
+    // deleted.
+    int64_t max_bytes = 10LL * 1024 * 1024 * 1024;  // 10GB
+  };
+
+  // Indexes the copies already in `options.directory`.
+  static absl::StatusOr<std::unique_ptr<CachingBlobStorageClient>> Create(
+      std::unique_ptr<BlobStorageClient> client, Options options);
+
+  CachingBlobStorageClient(const CachingBlobStorageClient&) = delete;
+  CachingBlobStorageClient& operator=(const CachingBlobStorageClient&) =
+      delete;
+
+  // Copies the blob if it has no copy yet, concurrent readers of a blob wait
+  // for a single copy. Falls back to a reader of `client` if the copy fails.
+  std::unique_ptr<BlobReader> GetBlobReader(DataLocation location) override
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  absl::Status PutBlob(BlobReader& blob_reader, DataLocation location) override
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  absl::Status DeleteBlob(DataLocation location) override
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  absl::StatusOr<std::vector<std::string>> ListBlobs(
+      DataLocation location, ListOptions options) override;
+
+  // Total size of the copies.
+  int64_t cached_bytes() const ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  struct Copy {
+    int64_t size;
+    // Position in `lru_`.
+    std::list<std::string>::iterator lru_position;
+  };
+
+  CachingBlobStorageClient(std::unique_ptr<BlobStorageClient> client,
+                           Options options);
+
+  std::filesystem::path CopyPath(const DataLocation& location) const;
+  // Writes the blob to `path`, through a temporary file so that a partial
+  // copy is never read.
+  absl::StatusOr<int64_t> DownloadCopy(const DataLocation& location,
+                                       const std::filesystem::path& path);
+  void AddCopy(const std::string& path, int64_t size)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void DropCopy(const std::string& path) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void EvictCopies() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  std::unique_ptr<BlobStorageClient> client_;
+  const Options options_;
+  mutable absl::Mutex mutex_;
+  // Copies by path, and their paths from least to most recently read.
+  absl::flat_hash_map<std::string, Copy> copies_ ABSL_GUARDED_BY(mutex_);
+  std::list<std::string> lru_ ABSL_GUARDED_BY(mutex_);
+  int64_t cached_bytes_ ABSL_GUARDED_BY(mutex_) = 0;
+  // Copies being downloaded, notified once they are done.
+  absl::flat_hash_map<std::string, std::shared_ptr<absl::Notification>>
+      downloads_ ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_BLOB_STORAGE_CACHING_BLOB_STORAGE_CLIENT_H_
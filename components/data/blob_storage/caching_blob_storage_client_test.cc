@@ -0,0 +1,198 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data/blob_storage/caching_blob_storage_client.h"
+
+#include <filesystem>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "components/data/common/mocks.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+using testing::ByMove;
+using testing::Return;
+
+class StringBlobReader : public BlobReader {
+ public:
+  explicit StringBlobReader(std::string contents) : stream_(contents) {}
+  std::istream& Stream() override { return stream_; }
+  bool CanSeek() const override { return true; }
+
+ private:
+  std::istringstream stream_;
+};
+
+std::unique_ptr<BlobReader> StringReader(std::string contents) {
+  return std::make_unique<StringBlobReader>(std::move(contents));
+}
+
+std::string ReadAll(BlobReader& reader) {
+  std::stringstream ss;
+  ss << reader.Stream().rdbuf();
+  return ss.str();
+}
+
+BlobStorageClient::DataLocation Location(std::string key) {
+  return {.bucket = "bucket", .prefix = "prefix", .key = std::move(key)};
+}
+
+class CachingBlobStorageClientTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    directory_ = std::filesystem::path(testing::TempDir()) /
+                 testing::UnitTest::GetInstance()->current_test_info()->name();
+    std::filesystem::remove_all(directory_);
+  }
+
+  std::unique_ptr<CachingBlobStorageClient> CreateClient(
+      std::unique_ptr<BlobStorageClient> client, int64_t max_bytes = 1 << 20) {
+    auto caching_client = CachingBlobStorageClient::Create(
+        std::move(client),
+        {.directory = directory_.string(), .max_bytes = max_bytes});
+    EXPECT_TRUE(caching_client.ok()) << caching_client.status();
+    return *std::move(caching_client);
+  }
+
+  std::filesystem::path directory_;
+};
+
+TEST_F(CachingBlobStorageClientTest, ReadsCopyOfBlob) {
+  auto client = std::make_unique<MockBlobStorageClient>();
+  EXPECT_CALL(*client, GetBlobReader(Location("a")))
+      .WillOnce(Return(ByMove(StringReader("contents of a"))));
+  auto caching_client = CreateClient(std::move(client));
+  for (int i = 0; i < 2; ++i) {
+    auto reader = caching_client->GetBlobReader(Location("a"));
+    ASSERT_NE(reader, nullptr);
+    EXPECT_TRUE(reader->CanSeek());
+    EXPECT_EQ(ReadAll(*reader), "contents of a");
+  }
+  EXPECT_EQ(caching_client->cached_bytes(), 13);
+}
+
+TEST_F(CachingBlobStorageClientTest, SeeksInCopy) {
+  auto client = std::make_unique<MockBlobStorageClient>();
+  EXPECT_CALL(*client, GetBlobReader(Location("a")))
+      .WillOnce(Return(ByMove(StringReader("0123456789"))));
+  auto caching_client = CreateClient(std::move(client));
+  auto reader = caching_client->GetBlobReader(Location("a"));
+  ASSERT_NE(reader, nullptr);
+  std::istream& stream = reader->Stream();
+  stream.seekg(0, std::ios_base::end);
+  EXPECT_EQ(stream.tellg(), 10);
+  stream.seekg(7);
+  EXPECT_EQ(ReadAll(*reader), "789");
+  stream.clear();
+  stream.seekg(-4, std::ios_base::end);
+  stream.seekg(-2, std::ios_base::cur);
+  EXPECT_EQ(ReadAll(*reader), "456789");
+}
+
+TEST_F(CachingBlobStorageClientTest, ReadsCopiesAfterRestart) {
+  {
+    auto client = std::make_unique<MockBlobStorageClient>();
+    EXPECT_CALL(*client, GetBlobReader(Location("a")))
+        .WillOnce(Return(ByMove(StringReader("contents of a"))));
+    auto caching_client = CreateClient(std::move(client));
+    ASSERT_NE(caching_client->GetBlobReader(Location("a")), nullptr);
+  }
+  auto client = std::make_unique<MockBlobStorageClient>();
+  EXPECT_CALL(*client, GetBlobReader).Times(0);
+  auto caching_client = CreateClient(std::move(client));
+  EXPECT_EQ(caching_client->cached_bytes(), 13);
+  auto reader = caching_client->GetBlobReader(Location("a"));
+  ASSERT_NE(reader, nullptr);
+  EXPECT_EQ(ReadAll(*reader), "contents of a");
+}
+
+TEST_F(CachingBlobStorageClientTest, EvictsLeastRecentlyReadCopies) {
+  auto client = std::make_unique<MockBlobStorageClient>();
+  EXPECT_CALL(*client, GetBlobReader(Location("a")))
+      .WillOnce(Return(ByMove(StringReader("aaaa"))));
+  EXPECT_CALL(*client, GetBlobReader(Location("b")))
+      .WillOnce(Return(ByMove(StringReader("bbbb"))))
+      .WillOnce(Return(ByMove(StringReader("bbbb"))));
+  EXPECT_CALL(*client, GetBlobReader(Location("c")))
+      .WillOnce(Return(ByMove(StringReader("cccc"))));
+  auto caching_client = CreateClient(std::move(client), /*max_bytes=*/10);
+  ASSERT_NE(caching_client->GetBlobReader(Location("a")), nullptr);
+  ASSERT_NE(caching_client->GetBlobReader(Location("b")), nullptr);
+  ASSERT_NE(caching_client->GetBlobReader(Location("a")), nullptr);
+  // Evicts b, read before a last was.
+  ASSERT_NE(caching_client->GetBlobReader(Location("c")), nullptr);
+  EXPECT_EQ(caching_client->cached_bytes(), 8);
+  auto reader = caching_client->GetBlobReader(Location("b"));
+  ASSERT_NE(reader, nullptr);
+  EXPECT_EQ(ReadAll(*reader), "bbbb");
+}
+
+TEST_F(CachingBlobStorageClientTest, DeleteBlobDropsCopy) {
+  auto client = std::make_unique<MockBlobStorageClient>();
+  EXPECT_CALL(*client, GetBlobReader(Location("a")))
+      .WillOnce(Return(ByMove(StringReader("old"))))
+      .WillOnce(Return(ByMove(StringReader("new"))));
+  EXPECT_CALL(*client, DeleteBlob(Location("a")))
+      .WillOnce(Return(absl::OkStatus()));
+  auto caching_client = CreateClient(std::move(client));
+  ASSERT_NE(caching_client->GetBlobReader(Location("a")), nullptr);
+  ASSERT_TRUE(caching_client->DeleteBlob(Location("a")).ok());
+  EXPECT_EQ(caching_client->cached_bytes(), 0);
+  auto reader = caching_client->GetBlobReader(Location("a"));
+  ASSERT_NE(reader, nullptr);
+  EXPECT_EQ(ReadAll(*reader), "new");
+}
+
+TEST_F(CachingBlobStorageClientTest, ReadsBlobWithoutCopyIfCopyFails) {
+  auto client = std::make_unique<MockBlobStorageClient>();
+  EXPECT_CALL(*client, GetBlobReader(Location("a")))
+      .WillOnce(Return(ByMove(nullptr)))
+      .WillOnce(Return(ByMove(StringReader("contents of a"))));
+  auto caching_client = CreateClient(std::move(client));
+  auto reader = caching_client->GetBlobReader(Location("a"));
+  ASSERT_NE(reader, nullptr);
+  EXPECT_EQ(ReadAll(*reader), "contents of a");
+  EXPECT_EQ(caching_client->cached_bytes(), 0);
+}
+
+TEST_F(CachingBlobStorageClientTest, ConcurrentReadersShareOneCopy) {
+  auto client = std::make_unique<MockBlobStorageClient>();
+  EXPECT_CALL(*client, GetBlobReader(Location("a")))
+      .WillOnce(Return(ByMove(StringReader("contents of a"))));
+  auto caching_client = CreateClient(std::move(client));
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 8; ++i) {
+    threads.emplace_back([&caching_client] {
+      auto reader = caching_client->GetBlobReader(Location("a"));
+      ASSERT_NE(reader, nullptr);
+      EXPECT_EQ(ReadAll(*reader), "contents of a");
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -41,13 +41,15 @@ class DeltaFileNotifierImpl : public DeltaFileNotifier {
                                  const absl::Duration poll_frequency,
                                  std::unique_ptr<SleepFor> sleep_for,
                                  SteadyClock& clock,
-                                 BlobPrefixAllowlist blob_prefix_allowlist)
+                                 BlobPrefixAllowlist blob_prefix_allowlist,
+                                 bool trust_notifications)
       : thread_manager_(ThreadManager::Create("Delta file notifier")),
         client_(client),
         poll_frequency_(poll_frequency),
         sleep_for_(std::move(sleep_for)),
         clock_(clock),
-        blob_prefix_allowlist_(std::move(blob_prefix_allowlist)) {}
+        blob_prefix_allowlist_(std::move(blob_prefix_allowlist)),
+        trust_notifications_(trust_notifications) {}
 
   absl::Status Start(
       BlobStorageChangeNotifier& change_notifier,
@@ -82,6 +84,19 @@ class DeltaFileNotifierImpl : public DeltaFileNotifier {
       BlobStorageChangeNotifier& change_notifier, ExpiringFlag& expiring_flag,
       const absl::flat_hash_map<std::string, std::string>&
           prefix_start_after_map);
+  // Passes the new delta files named by the next notification to `callback`,
+  // in the order of their names, and records them in `prefix_notified_map`.
+  // Files up to the listed file of their prefix in `prefix_start_after_map`,
+  // and files already notified, are skipped. Returns true if the bucket
+  // needs to be listed to reconcile the notified files. Returns the error on
+  // failure.
+  absl::StatusOr<bool> ForwardNotifiedFiles(
+      BlobStorageChangeNotifier& change_notifier, ExpiringFlag& expiring_flag,
+      const absl::flat_hash_map<std::string, std::string>&
+          prefix_start_after_map,
+      absl::flat_hash_map<std::string, absl::flat_hash_set<std::string>>&
+          prefix_notified_map,
+      const std::function<void(const std::string& key)>& callback);
   void Watch(
       BlobStorageChangeNotifier& change_notifier,
       BlobStorageClient::DataLocation location,
@@ -94,6 +109,7 @@ class DeltaFileNotifierImpl : public DeltaFileNotifier {
   std::unique_ptr<SleepFor> sleep_for_;
   SteadyClock& clock_;
   BlobPrefixAllowlist blob_prefix_allowlist_;
+  const bool trust_notifications_;
 };
 
 absl::StatusOr<std::string> DeltaFileNotifierImpl::WaitForNotification(
@@ -148,6 +164,51 @@ absl::StatusOr<bool> DeltaFileNotifierImpl::ShouldListBlobs(
          IsDeltaFilename(notification_blob.key);
 }
 
+absl::StatusOr<bool> DeltaFileNotifierImpl::ForwardNotifiedFiles(
+    BlobStorageChangeNotifier& change_notifier, ExpiringFlag& expiring_flag,
+    const absl::flat_hash_map<std::string, std::string>& prefix_start_after_map,
+    absl::flat_hash_map<std::string, absl::flat_hash_set<std::string>>&
+        prefix_notified_map,
+    const std::function<void(const std::string& key)>& callback) {
+  if (!expiring_flag.Get()) {
+    VLOG(5) << "Reconciliation poll";
+    return true;
+  }
+  absl::StatusOr<std::vector<std::string>> changes =
+      change_notifier.GetNotifications(
+          expiring_flag.GetTimeRemaining(),
+          [this]() { return thread_manager_->ShouldStop(); });
+  if (absl::IsDeadlineExceeded(changes.status())) {
+    VLOG(5) << "Reconciliation poll";
+    return true;
+  }
+  if (!changes.ok()) {
+    return changes.status();
+  }
+  // Notifications may be duplicated, and hold several files of a prefix.
+  std::sort(changes->begin(), changes->end());
+  for (const auto& change : *changes) {
+    const auto blob = ParseBlobName(change);
+    if (!blob_prefix_allowlist_.Contains(blob.prefix) ||
+        !IsDeltaFilename(blob.key)) {
+      continue;
+    }
+    if (auto iter = prefix_start_after_map.find(blob.prefix);
+        iter != prefix_start_after_map.end() && blob.key <= iter->second) {
+      // Ignore notifications for keys we've already listed.
+      continue;
+    }
+    // The listing watermark isn't moved: a file notified late, or whose
+    // notification was lost, is still found by the next listing.
+    if (!prefix_notified_map[blob.prefix].emplace(blob.key).second) {
+      continue;
+    }
+    callback(blob.prefix.empty() ? blob.key
+                                 : absl::StrCat(blob.prefix, "/", blob.key));
+  }
+  return false;
+}
+
 absl::flat_hash_map<std::string, std::vector<std::string>> ListPrefixDeltaFiles(
     BlobStorageClient::DataLocation location,
     const BlobPrefixAllowlist& prefix_allowlist,
@@ -186,10 +247,19 @@ void DeltaFileNotifierImpl::Watch(
   LOG(INFO) << "Started to watch " << location;
   // Flag starts expired, and forces an initial poll.
   ExpiringFlag expiring_flag(clock_);
+  // Files passed to the callback from trusted notifications and not listed
+  // yet, by prefix.
+  absl::flat_hash_map<std::string, absl::flat_hash_set<std::string>>
+      prefix_notified_map;
   uint32_t sequential_failures = 0;
   while (!thread_manager_->ShouldStop()) {
     const absl::StatusOr<bool> should_list_blobs =
-        ShouldListBlobs(change_notifier, expiring_flag, prefix_start_after_map);
+        trust_notifications_
+            ? ForwardNotifiedFiles(change_notifier, expiring_flag,
+                                   prefix_start_after_map, prefix_notified_map,
+                                   callback)
+            : ShouldListBlobs(change_notifier, expiring_flag,
+                              prefix_start_after_map);
     if (!should_list_blobs.ok()) {
       ++sequential_failures;
       const absl::Duration backoff_time =
@@ -215,14 +285,28 @@ void DeltaFileNotifierImpl::Watch(
     auto prefix_blobs_map = ListPrefixDeltaFiles(
         location, blob_prefix_allowlist_, prefix_start_after_map, client_);
     for (const auto& [prefix, prefix_blobs] : prefix_blobs_map) {
+      auto notified_iter = prefix_notified_map.find(prefix);
       for (const auto& blob : prefix_blobs) {
         if (!IsDeltaFilename(blob)) {
           continue;
         }
-        callback(prefix.empty() ? blob : absl::StrCat(prefix, "/", blob));
         prefix_start_after_map[prefix] = blob;
+        if (notified_iter != prefix_notified_map.end() &&
+            notified_iter->second.erase(blob) > 0) {
+          // Already passed to the callback when it was notified.
+          continue;
+        }
+        callback(prefix.empty() ? blob : absl::StrCat(prefix, "/", blob));
         delta_file_count++;
       }
+      if (notified_iter != prefix_notified_map.end()) {
+        // Notified files the listing has gone past are never listed again.
+        const std::string& start_after = prefix_start_after_map[prefix];
+        absl::erase_if(notified_iter->second,
+                       [&start_after](const std::string& notified_blob) {
+                         return notified_blob <= start_after;
+                       });
+      }
     }
     if (delta_file_count == 0) {
       VLOG(2) << "No new file found";
@@ -234,20 +318,21 @@ void DeltaFileNotifierImpl::Watch(
 
 std::unique_ptr<DeltaFileNotifier> DeltaFileNotifier::Create(
     BlobStorageClient& client, const absl::Duration poll_frequency,
-    BlobPrefixAllowlist blob_prefix_allowlist) {
+    BlobPrefixAllowlist blob_prefix_allowlist, bool trust_notifications) {
   return std::make_unique<DeltaFileNotifierImpl>(
       client, poll_frequency, std::make_unique<SleepFor>(),
-      SteadyClock::RealClock(), std::move(blob_prefix_allowlist));
+      SteadyClock::RealClock(), std::move(blob_prefix_allowlist),
+      trust_notifications);
 }
 
 // For test only
 std::unique_ptr<DeltaFileNotifier> DeltaFileNotifier::Create(
     BlobStorageClient& client, const absl::Duration poll_frequency,
     std::unique_ptr<SleepFor> sleep_for, SteadyClock& clock,
-    BlobPrefixAllowlist blob_prefix_allowlist) {
+    BlobPrefixAllowlist blob_prefix_allowlist, bool trust_notifications) {
   return std::make_unique<DeltaFileNotifierImpl>(
       client, poll_frequency, std::move(sleep_for), clock,
-      std::move(blob_prefix_allowlist));
+      std::move(blob_prefix_allowlist), trust_notifications);
 }
 
 }  // namespace kv_server
@@ -59,17 +59,28 @@ class DeltaFileNotifier {
   // successful.
   virtual bool IsRunning() const = 0;
 
+  // New files are found by listing the bucket after each change notification
+  // of a delta file, and every `poll_frequency` without notifications.
+  //
+  // If `trust_notifications` is set, the delta files named by the change
+  // notifications are passed to the callback as they are notified, without
+  // listing the bucket, and the bucket is only listed every `poll_frequency`
+  // to reconcile the files whose notification was lost or late. Each listing
+  // starts after the last listed file of the prefix, and skips the files
+  // already passed from notifications.
   static std::unique_ptr<DeltaFileNotifier> Create(
       BlobStorageClient& client,
       const absl::Duration poll_frequency = absl::Minutes(5),
-      BlobPrefixAllowlist blob_prefix_allowlist = BlobPrefixAllowlist(""));
+      BlobPrefixAllowlist blob_prefix_allowlist = BlobPrefixAllowlist(""),
+      bool trust_notifications = false);
 
   // Used for test
   static std::unique_ptr<DeltaFileNotifier> Create(
       BlobStorageClient& client, const absl::Duration poll_frequency,
       std::unique_ptr<SleepFor> sleep_for,
       privacy_sandbox::server_common::SteadyClock& clock,
-      BlobPrefixAllowlist blob_prefix_allowlist = BlobPrefixAllowlist(""));
+      BlobPrefixAllowlist blob_prefix_allowlist = BlobPrefixAllowlist(""),
+      bool trust_notifications = false);
 };
 
 }  // namespace kv_server
@@ -365,5 +365,104 @@ TEST_F(DeltaFileNotifierTest, NotifiesWithNewPrefixedFiles) {
   EXPECT_FALSE(notifier_->IsRunning());
 }
 
+TEST_F(DeltaFileNotifierTest, TrustedNotificationsAreNotListed) {
+  notifier_ = DeltaFileNotifier::Create(
+      client_, poll_frequency_, std::make_unique<MockSleepFor>(), sim_clock_,
+      BlobPrefixAllowlist(kBlobPrefix1), /*trust_notifications=*/true);
+  EXPECT_CALL(change_notifier_, GetNotifications(_, _))
+      .WillOnce(Return(std::vector<std::string>(
+          {ToDeltaFileName(3).value(), ToDeltaFileName(2).value()})))
+      .WillOnce(Return(std::vector<std::string>(
+          {ToDeltaFileName(4).value(), ToDeltaFileName(3).value(),
+           "DELTA_5",
+           absl::StrCat(kBlobPrefix1, "/", ToDeltaFileName(11).value())})))
+      .WillRepeatedly(Return(std::vector<std::string>()));
+  // Only the initial listing, the clock doesn't move to the reconciliation.
+  EXPECT_CALL(
+      client_,
+      ListBlobs(Field(&BlobStorageClient::DataLocation::bucket, "testbucket"),
+                Field(&BlobStorageClient::ListOptions::start_after,
+                      ToDeltaFileName(1).value())))
+      .WillOnce(Return(std::vector<std::string>({})));
+  EXPECT_CALL(
+      client_,
+      ListBlobs(
+          AllOf(Field(&BlobStorageClient::DataLocation::bucket, "testbucket"),
+                Field(&BlobStorageClient::DataLocation::prefix, kBlobPrefix1)),
+          Field(&BlobStorageClient::ListOptions::start_after, "")))
+      .WillOnce(Return(std::vector<std::string>()));
+
+  absl::Notification finished;
+  testing::MockFunction<void(const std::string& record)> callback;
+  {
+    testing::InSequence in_sequence;
+    EXPECT_CALL(callback, Call(ToDeltaFileName(2).value()));
+    EXPECT_CALL(callback, Call(ToDeltaFileName(3).value()));
+    EXPECT_CALL(callback, Call(ToDeltaFileName(4).value()));
+    EXPECT_CALL(callback, Call(absl::StrCat(kBlobPrefix1, "/",
+                                            ToDeltaFileName(11).value())))
+        .WillOnce([&]() { finished.Notify(); });
+  }
+
+  absl::Status status = notifier_->Start(
+      change_notifier_, {.bucket = "testbucket"},
+      {std::make_pair("", initial_key_)}, callback.AsStdFunction());
+  ASSERT_TRUE(status.ok());
+  finished.WaitForNotification();
+  status = notifier_->Stop();
+  ASSERT_TRUE(status.ok());
+  EXPECT_FALSE(notifier_->IsRunning());
+}
+
+TEST_F(DeltaFileNotifierTest, TrustedNotificationsLostAreListed) {
+  notifier_ = DeltaFileNotifier::Create(
+      client_, poll_frequency_, std::make_unique<MockSleepFor>(), sim_clock_,
+      BlobPrefixAllowlist(kBlobPrefix1), /*trust_notifications=*/true);
+  // The notification of 2 is lost, and only arrives after it was listed.
+  EXPECT_CALL(change_notifier_, GetNotifications(_, _))
+      .WillOnce(Return(std::vector<std::string>({ToDeltaFileName(3).value()})))
+      .WillOnce(Return(std::vector<std::string>(
+          {ToDeltaFileName(4).value(), ToDeltaFileName(2).value()})))
+      .WillRepeatedly(Return(std::vector<std::string>()));
+  // The reconciliation lists after the last listed file, not after 3.
+  EXPECT_CALL(
+      client_,
+      ListBlobs(Field(&BlobStorageClient::DataLocation::bucket, "testbucket"),
+                Field(&BlobStorageClient::ListOptions::start_after,
+                      ToDeltaFileName(1).value())))
+      .WillOnce(Return(std::vector<std::string>({})))
+      .WillOnce(Return(std::vector<std::string>(
+          {ToDeltaFileName(2).value(), ToDeltaFileName(3).value()})));
+  EXPECT_CALL(
+      client_,
+      ListBlobs(
+          AllOf(Field(&BlobStorageClient::DataLocation::bucket, "testbucket"),
+                Field(&BlobStorageClient::DataLocation::prefix, kBlobPrefix1)),
+          Field(&BlobStorageClient::ListOptions::start_after, "")))
+      .WillRepeatedly(Return(std::vector<std::string>()));
+
+  absl::Notification finished;
+  testing::MockFunction<void(const std::string& record)> callback;
+  {
+    testing::InSequence in_sequence;
+    EXPECT_CALL(callback, Call(ToDeltaFileName(3).value())).WillOnce([&]() {
+      sim_clock_.AdvanceTime(poll_frequency_ + absl::Seconds(1));
+    });
+    EXPECT_CALL(callback, Call(ToDeltaFileName(2).value()));
+    EXPECT_CALL(callback, Call(ToDeltaFileName(4).value())).WillOnce([&]() {
+      finished.Notify();
+    });
+  }
+
+  absl::Status status = notifier_->Start(
+      change_notifier_, {.bucket = "testbucket"},
+      {std::make_pair("", initial_key_)}, callback.AsStdFunction());
+  ASSERT_TRUE(status.ok());
+  finished.WaitForNotification();
+  status = notifier_->Stop();
+  ASSERT_TRUE(status.ok());
+  EXPECT_FALSE(notifier_->IsRunning());
+}
+
 }  // namespace
 }  // namespace kv_server
@@ -0,0 +1,107 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data/blob_storage/mapped_blob_reader.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+#include "absl/memory/memory.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+
+namespace kv_server {
+
+absl::StatusOr<std::unique_ptr<MappedBlobReader>> MappedBlobReader::Open(
+    const std::string& path) {
+  const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return absl::ErrnoToStatus(errno, absl::StrCat("Failed to open ", path));
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0) {
+    const int error = errno;
+    close(fd);
+    return absl::ErrnoToStatus(error, absl::StrCat("Failed to stat ", path));
+  }
+  if (!S_ISREG(file_stat.st_mode)) {
+    close(fd);
+    return absl::FailedPreconditionError(
+        absl::StrCat(path, " is not a regular file"));
+  }
+  if (file_stat.st_size == 0) {
+    // Empty files can't be mapped.
+    close(fd);
+    return absl::WrapUnique(new MappedBlobReader(nullptr, 0));
+  }
+  void* data = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_SHARED, fd,
+                    /*offset=*/0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    return absl::InternalError(
+        absl::StrCat("Failed to map ", path, ": ", std::strerror(errno)));
+  }
+  // Blobs are mostly read front to back, a range per reader.
+  madvise(data, file_stat.st_size, MADV_SEQUENTIAL);
+  return absl::WrapUnique(
+      new MappedBlobReader(static_cast<char*>(data), file_stat.st_size));
+}
+
+MappedBlobReader::MappedBlobReader(char* data, size_t size)
+    : data_(data), size_(size), streambuf_(data, size), is_(&streambuf_) {}
+
+MappedBlobReader::~MappedBlobReader() {
+  if (data_ != nullptr) {
+    munmap(data_, size_);
+  }
+}
+
+std::streampos MappedBlobReader::MemoryStreambuf::seekoff(
+    std::streamoff off, std::ios_base::seekdir dir,
+    std::ios_base::openmode which) {
+  std::streamoff position;
+  switch (dir) {
+    case std::ios_base::beg:
+      position = off;
+      break;
+    case std::ios_base::cur:
+      position = (gptr() - eback()) + off;
+      break;
+    case std::ios_base::end:
+      position = (egptr() - eback()) + off;
+      break;
+    default:
+      return std::streampos(std::streamoff(-1));
+  }
+  if (position < 0 || position > egptr() - eback()) {
+    return std::streampos(std::streamoff(-1));
+  }
+  setg(eback(), eback() + position, egptr());
+  return std::streampos(position);
+}
+
+std::streampos MappedBlobReader::MemoryStreambuf::seekpos(
+    std::streampos pos, std::ios_base::openmode which) {
+  return seekoff(std::streamoff(pos), std::ios_base::beg, which);
+}
+
+}  // namespace kv_server
@@ -0,0 +1,73 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_BLOB_STORAGE_MAPPED_BLOB_READER_H_
+#define COMPONENTS_DATA_BLOB_STORAGE_MAPPED_BLOB_READER_H_
+
+#include <istream>
+#include <memory>
+#include <optional>
+#include <streambuf>
+#include <string>
+#include <string_view>
+
+#include "absl/status/statusor.h"
+#include "components/data/blob_storage/blob_storage_client.h"
+
+namespace kv_server {
+
+// Reads a local file through a memory mapping of it. Readers that can read
+// memory get the mapping from `Contents()`, and read the file straight from
+// the page cache. `Stream()` reads the mapping without buffering it again.
+class MappedBlobReader : public BlobReader {
+ public:
+  static absl::StatusOr<std::unique_ptr<MappedBlobReader>> Open(
+      const std::string& path);
+
+  ~MappedBlobReader() override;
+  MappedBlobReader(const MappedBlobReader&) = delete;
+  MappedBlobReader& operator=(const MappedBlobReader&) = delete;
+
+  std::istream& Stream() override { return is_; }
+  bool CanSeek() const override { return true; }
+  std::optional<std::string_view> Contents() override {
+    return std::string_view(data_, size_);
+  }
+
+ private:
+  // Reads, and seeks in, a range of memory.
+  class MemoryStreambuf : public std::streambuf {
+   public:
+    MemoryStreambuf(char* data, size_t size) { setg(data, data, data + size); }
+
+   protected:
+    std::streampos seekoff(std::streamoff off, std::ios_base::seekdir dir,
+                           std::ios_base::openmode which) override;
+    std::streampos seekpos(std::streampos pos,
+                           std::ios_base::openmode which) override;
+  };
+
+  MappedBlobReader(char* data, size_t size);
+
+  char* data_;
+  size_t size_;
+  MemoryStreambuf streambuf_;
+  std::istream is_;
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_BLOB_STORAGE_MAPPED_BLOB_READER_H_
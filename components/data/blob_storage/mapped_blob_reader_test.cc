@@ -0,0 +1,81 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data/blob_storage/mapped_blob_reader.h"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+std::string WriteFile(std::string_view name, std::string_view contents) {
+  const std::string path =
+      (std::filesystem::path(testing::TempDir()) / name).string();
+  std::ofstream file(path);
+  file << contents;
+  return path;
+}
+
+TEST(MappedBlobReaderTest, ReadsFile) {
+  auto reader = MappedBlobReader::Open(WriteFile("file", "0123456789"));
+  ASSERT_TRUE(reader.ok()) << reader.status();
+  EXPECT_EQ((*reader)->Contents(), "0123456789");
+  std::stringstream ss;
+  ss << (*reader)->Stream().rdbuf();
+  EXPECT_EQ(ss.str(), "0123456789");
+}
+
+TEST(MappedBlobReaderTest, SeeksInFile) {
+  auto reader = MappedBlobReader::Open(WriteFile("file", "0123456789"));
+  ASSERT_TRUE(reader.ok()) << reader.status();
+  ASSERT_TRUE((*reader)->CanSeek());
+  std::istream& stream = (*reader)->Stream();
+  stream.seekg(0, std::ios_base::end);
+  EXPECT_EQ(stream.tellg(), 10);
+  stream.seekg(-4, std::ios_base::end);
+  stream.seekg(-2, std::ios_base::cur);
+  std::stringstream ss;
+  ss << stream.rdbuf();
+  EXPECT_EQ(ss.str(), "456789");
+  stream.seekg(11);
+  EXPECT_EQ(stream.tellg(), -1);
+}
+
+TEST(MappedBlobReaderTest, ReadsEmptyFile) {
+  auto reader = MappedBlobReader::Open(WriteFile("empty", ""));
+  ASSERT_TRUE(reader.ok()) << reader.status();
+  EXPECT_EQ((*reader)->Contents(), "");
+  EXPECT_EQ((*reader)->Stream().get(), std::char_traits<char>::eof());
+}
+
+TEST(MappedBlobReaderTest, FailsOnMissingFile) {
+  EXPECT_FALSE(MappedBlobReader::Open(
+                   (std::filesystem::path(testing::TempDir()) / "missing")
+                       .string())
+                   .ok());
+}
+
+TEST(MappedBlobReaderTest, FailsOnDirectory) {
+  EXPECT_FALSE(MappedBlobReader::Open(testing::TempDir()).ok());
+}
+
+}  // namespace
+}  // namespace kv_server
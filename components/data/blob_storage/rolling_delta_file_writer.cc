@@ -0,0 +1,212 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data/blob_storage/rolling_delta_file_writer.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <utility>
+
+#include "absl/log/log.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "public/data_loading/filename_utils.h"
+
+namespace kv_server {
+namespace {
+
+using privacy_sandbox::server_common::SteadyClock;
+
+class FileBlobReader : public BlobReader {
+ public:
+  explicit FileBlobReader(const std::string& path)
+      : stream_(path, std::ios::binary) {}
+  std::istream& Stream() override { return stream_; }
+  bool CanSeek() const override { return true; }
+
+ private:
+  std::ifstream stream_;
+};
+
+}  // namespace
+
+RollingDeltaFileWriter::RollingDeltaFileWriter(BlobStorageClient& client,
+                                               FileOptions file_options,
+                                               Options options,
+                                               SteadyClock& clock)
+    : client_(client),
+      file_options_(std::move(file_options)),
+      options_(std::move(options)),
+      clock_(clock),
+      uploader_(std::make_unique<ThreadPool>(1)) {}
+
+absl::StatusOr<std::unique_ptr<RollingDeltaFileWriter>>
+RollingDeltaFileWriter::Create(BlobStorageClient& client,
+                               FileOptions file_options, Options options,
+                               SteadyClock& clock) {
+  if (file_options.max_file_size_bytes <= 0) {
+    return absl::InvalidArgumentError(
+        "max_file_size_bytes must be positive.");
+  }
+  if (file_options.max_file_age <= absl::ZeroDuration()) {
+    return absl::InvalidArgumentError("max_file_age must be positive.");
+  }
+  if (!std::filesystem::is_directory(file_options.local_directory)) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Not a directory: ", file_options.local_directory));
+  }
+  return absl::WrapUnique(new RollingDeltaFileWriter(
+      client, std::move(file_options), std::move(options), clock));
+}
+
+absl::Status RollingDeltaFileWriter::StartFile() {
+  last_file_micros_ =
+      std::max(absl::ToUnixMicros(absl::Now()), last_file_micros_ + 1);
+  auto file_name = ToDeltaFileName(last_file_micros_);
+  if (!file_name.ok()) {
+    return file_name.status();
+  }
+  file_name_ = *std::move(file_name);
+  // Records are counted, so the file never reaches its own limit.
+  auto file_writer = DeltaRecordLimitingFileWriter::Create(
+      (std::filesystem::path(file_options_.local_directory) / file_name_)
+          .string(),
+      options_);
+  if (!file_writer.ok()) {
+    return file_writer.status();
+  }
+  file_writer_ = std::move(*file_writer);
+  file_bytes_ = 0;
+  file_start_ = clock_.Now();
+  return absl::OkStatus();
+}
+
+absl::Status RollingDeltaFileWriter::CompleteFile() {
+  if (file_writer_ == nullptr) {
+    return absl::OkStatus();
+  }
+  file_writer_->Close();
+  absl::Status status = file_writer_->Status();
+  file_writer_.reset();
+  if (!status.ok()) {
+    return status;
+  }
+  uploader_->Schedule([this, file_name = file_name_] { Upload(file_name); });
+  return absl::OkStatus();
+}
+
+absl::Status RollingDeltaFileWriter::CompleteFileIfOld() {
+  if (file_writer_ != nullptr &&
+      clock_.Now() - file_start_ >= file_options_.max_file_age) {
+    return CompleteFile();
+  }
+  return absl::OkStatus();
+}
+
+void RollingDeltaFileWriter::Upload(const std::string& file_name) {
+  const std::string path =
+      (std::filesystem::path(file_options_.local_directory) / file_name)
+          .string();
+  absl::Status status;
+  {
+    absl::MutexLock lock(&mutex_);
+    status = upload_status_;
+  }
+  // Later files aren't uploaded once one fails, so that none is skipped.
+  if (status.ok()) {
+    FileBlobReader reader(path);
+    BlobStorageClient::DataLocation location = file_options_.location;
+    location.key = file_name;
+    status = client_.PutBlob(reader, std::move(location));
+  }
+  std::error_code error;
+  std::filesystem::remove(path, error);
+  absl::MutexLock lock(&mutex_);
+  if (!status.ok()) {
+    LOG(ERROR) << "Failed to upload " << file_name << ": " << status;
+    upload_status_.Update(status);
+    return;
+  }
+  uploaded_files_.push_back(file_name);
+}
+
+absl::Status RollingDeltaFileWriter::WriteRecord(
+    const DataRecordStruct& data_record) {
+  if (closed_) {
+    return absl::FailedPreconditionError("The writer is closed.");
+  }
+  if (absl::Status status = Status(); !status.ok()) {
+    return status;
+  }
+  write_status_ = CompleteFileIfOld();
+  if (write_status_.ok() && file_writer_ == nullptr) {
+    write_status_ = StartFile();
+  }
+  if (!write_status_.ok()) {
+    return write_status_;
+  }
+  const std::string_view record = SerializeDataRecord(data_record, builder_);
+  write_status_ = file_writer_->WriteSerializedRecord(record);
+  if (!write_status_.ok()) {
+    return write_status_;
+  }
+  file_bytes_ += record.size();
+  if (file_bytes_ >= file_options_.max_file_size_bytes) {
+    write_status_ = CompleteFile();
+  }
+  return write_status_;
+}
+
+absl::Status RollingDeltaFileWriter::Flush() {
+  if (absl::Status status = Status(); !status.ok()) {
+    return status;
+  }
+  if (file_writer_ != nullptr) {
+    write_status_ = file_writer_->Flush();
+  }
+  if (write_status_.ok()) {
+    write_status_ = CompleteFileIfOld();
+  }
+  return write_status_;
+}
+
+void RollingDeltaFileWriter::Close() {
+  if (closed_) {
+    return;
+  }
+  closed_ = true;
+  if (absl::Status status = CompleteFile(); !status.ok()) {
+    write_status_ = std::move(status);
+  }
+  // Waits for the uploads.
+  uploader_.reset();
+}
+
+absl::Status RollingDeltaFileWriter::Status() {
+  if (!write_status_.ok()) {
+    return write_status_;
+  }
+  absl::MutexLock lock(&mutex_);
+  return upload_status_;
+}
+
+std::vector<std::string> RollingDeltaFileWriter::UploadedFiles() {
+  absl::MutexLock lock(&mutex_);
+  return uploaded_files_;
+}
+
+}  // namespace kv_server
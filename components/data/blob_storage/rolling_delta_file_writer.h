@@ -0,0 +1,120 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_BLOB_STORAGE_ROLLING_DELTA_FILE_WRITER_H_
+#define COMPONENTS_DATA_BLOB_STORAGE_ROLLING_DELTA_FILE_WRITER_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "components/data/blob_storage/blob_storage_client.h"
+#include "components/util/thread_pool.h"
+#include "public/data_loading/writers/delta_record_limiting_file_writer.h"
+#include "public/data_loading/writers/delta_record_writer.h"
+#include "src/util/duration.h"
+
+namespace kv_server {
+
+// Writes delta records to a sequence of delta files, and uploads each file
+// to blob storage once it's complete, in the background, while the records
+// that follow are written to the next file.
+//
+// A file is complete once `max_file_size_bytes` of records were written to
+// it, or once it's `max_file_age` old when a record is written or the writer
+// is flushed, and when the writer is closed. Files are named with
+// `ToDeltaFileName` from the time they're started, and uploaded one at a time
+// in that order, so that servers listing the delta files after the last one
+// they loaded don't skip any. Once an upload fails, no later file is uploaded
+// and writing fails.
+//
+// Not thread-safe.
+class RollingDeltaFileWriter : public DeltaRecordWriter {
+ public:
+  struct FileOptions {
+    // The bucket, and prefix, to upload the files to.
+    BlobStorageClient::DataLocation location;
+    // Where the files are written before they're uploaded, and deleted after.
+    std::string local_directory = "/tmp";
+    // Bytes of serialized records per file, before compression.
+    int64_t max_file_size_bytes = 64 * 1024 * 1024;
+    absl::Duration max_file_age = absl::InfiniteDuration();
+  };
+
+  ~RollingDeltaFileWriter() override { Close(); }
+  RollingDeltaFileWriter(const RollingDeltaFileWriter&) = delete;
+  RollingDeltaFileWriter& operator=(const RollingDeltaFileWriter&) = delete;
+
+  static absl::StatusOr<std::unique_ptr<RollingDeltaFileWriter>> Create(
+      BlobStorageClient& client, FileOptions file_options, Options options,
+      privacy_sandbox::server_common::SteadyClock& clock =
+          privacy_sandbox::server_common::SteadyClock::RealClock());
+
+  absl::Status WriteRecord(const DataRecordStruct& data_record) override;
+  // Flushes the records of the current file to the local file, and completes
+  // it if it's `max_file_age` old.
+  absl::Status Flush() override;
+  const Options& GetOptions() const override { return options_; }
+  // Completes the current file and waits for the uploads.
+  void Close() override;
+  bool IsOpen() override { return !closed_; }
+  absl::Status Status() override;
+
+  // Names of the files uploaded so far, in order.
+  std::vector<std::string> UploadedFiles() ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  RollingDeltaFileWriter(BlobStorageClient& client, FileOptions file_options,
+                         Options options,
+                         privacy_sandbox::server_common::SteadyClock& clock);
+
+  absl::Status StartFile();
+  // Closes the current file and schedules its upload.
+  absl::Status CompleteFile();
+  absl::Status CompleteFileIfOld();
+  void Upload(const std::string& file_name) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  BlobStorageClient& client_;
+  const FileOptions file_options_;
+  const Options options_;
+  privacy_sandbox::server_common::SteadyClock& clock_;
+  bool closed_ = false;
+  // The file being written, if any.
+  std::unique_ptr<DeltaRecordLimitingFileWriter> file_writer_;
+  flatbuffers::FlatBufferBuilder builder_;
+  std::string file_name_;
+  int64_t file_bytes_ = 0;
+  privacy_sandbox::server_common::SteadyTime file_start_;
+  // Of the last file name, file names increase even if the time doesn't.
+  int64_t last_file_micros_ = 0;
+  absl::Status write_status_;
+  absl::Mutex mutex_;
+  absl::Status upload_status_ ABSL_GUARDED_BY(mutex_);
+  std::vector<std::string> uploaded_files_ ABSL_GUARDED_BY(mutex_);
+  // One thread, so that files are uploaded in order. Destroyed first, its
+  // destructor waits for the uploads.
+  std::unique_ptr<ThreadPool> uploader_;
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_BLOB_STORAGE_ROLLING_DELTA_FILE_WRITER_H_
@@ -0,0 +1,163 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data/blob_storage/rolling_delta_file_writer.h"
+
+#include <filesystem>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "components/data/common/mocks.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "public/data_loading/filename_utils.h"
+#include "public/data_loading/readers/delta_record_stream_reader.h"
+
+namespace kv_server {
+namespace {
+
+using privacy_sandbox::server_common::SimulatedSteadyClock;
+using testing::_;
+using testing::ElementsAre;
+using testing::Return;
+
+DataRecordStruct GetRecord(std::string_view key) {
+  return DataRecordStruct{.record = KeyValueMutationRecordStruct{
+                              .mutation_type = KeyValueMutationType::Update,
+                              .logical_commit_time = 1,
+                              .key = key,
+                              .value = "value",
+                          }};
+}
+
+int CountRecords(const std::string& blob) {
+  std::stringstream stream(blob);
+  DeltaRecordStreamReader<std::stringstream> reader(stream);
+  int num_records = 0;
+  EXPECT_TRUE(reader
+                  .ReadRecords([&num_records](const DataRecord&) {
+                    ++num_records;
+                    return absl::OkStatus();
+                  })
+                  .ok());
+  return num_records;
+}
+
+class RollingDeltaFileWriterTest : public ::testing::Test {
+ protected:
+  RollingDeltaFileWriterTest() {
+    ON_CALL(client_, PutBlob)
+        .WillByDefault([this](BlobReader& reader,
+                              BlobStorageClient::DataLocation location) {
+          std::stringstream blob;
+          blob << reader.Stream().rdbuf();
+          absl::MutexLock lock(&mutex_);
+          EXPECT_EQ(location.bucket, "bucket");
+          blobs_.emplace_back(std::move(location.key), blob.str());
+          return absl::OkStatus();
+        });
+  }
+
+  std::unique_ptr<RollingDeltaFileWriter> CreateWriter(
+      RollingDeltaFileWriter::FileOptions file_options) {
+    file_options.location = {.bucket = "bucket"};
+    file_options.local_directory = ::testing::TempDir();
+    auto writer = RollingDeltaFileWriter::Create(
+        client_, std::move(file_options), {}, clock_);
+    EXPECT_TRUE(writer.ok()) << writer.status();
+    return *std::move(writer);
+  }
+
+  // The number of records of each uploaded blob, in order.
+  std::vector<int> UploadedRecordCounts() {
+    absl::MutexLock lock(&mutex_);
+    std::vector<int> counts;
+    for (const auto& [key, blob] : blobs_) {
+      EXPECT_TRUE(IsDeltaFilename(key)) << key;
+      EXPECT_FALSE(std::filesystem::exists(
+          std::filesystem::path(::testing::TempDir()) / key));
+      counts.push_back(CountRecords(blob));
+    }
+    return counts;
+  }
+
+  testing::NiceMock<MockBlobStorageClient> client_;
+  SimulatedSteadyClock clock_;
+  absl::Mutex mutex_;
+  std::vector<std::pair<std::string, std::string>> blobs_
+      ABSL_GUARDED_BY(mutex_);
+};
+
+TEST_F(RollingDeltaFileWriterTest, RollsFilesBySize) {
+  auto writer = CreateWriter({.max_file_size_bytes = 1});
+  for (const auto key : {"key1", "key2", "key3"}) {
+    ASSERT_TRUE(writer->WriteRecord(GetRecord(key)).ok());
+  }
+  writer->Close();
+  EXPECT_FALSE(writer->IsOpen());
+  EXPECT_THAT(UploadedRecordCounts(), ElementsAre(1, 1, 1));
+  const std::vector<std::string> files = writer->UploadedFiles();
+  ASSERT_EQ(files.size(), 3);
+  EXPECT_LT(files[0], files[1]);
+  EXPECT_LT(files[1], files[2]);
+}
+
+TEST_F(RollingDeltaFileWriterTest, RollsFilesByAge) {
+  auto writer = CreateWriter({.max_file_age = absl::Minutes(1)});
+  ASSERT_TRUE(writer->WriteRecord(GetRecord("key1")).ok());
+  ASSERT_TRUE(writer->WriteRecord(GetRecord("key2")).ok());
+  clock_.AdvanceTime(absl::Minutes(1));
+  ASSERT_TRUE(writer->WriteRecord(GetRecord("key3")).ok());
+  writer->Close();
+  EXPECT_THAT(UploadedRecordCounts(), ElementsAre(2, 1));
+}
+
+TEST_F(RollingDeltaFileWriterTest, FlushCompletesOldFile) {
+  auto writer = CreateWriter({.max_file_age = absl::Minutes(1)});
+  ASSERT_TRUE(writer->WriteRecord(GetRecord("key1")).ok());
+  ASSERT_TRUE(writer->Flush().ok());
+  clock_.AdvanceTime(absl::Minutes(1));
+  ASSERT_TRUE(writer->Flush().ok());
+  // Nothing left to upload.
+  writer->Close();
+  EXPECT_THAT(UploadedRecordCounts(), ElementsAre(1));
+}
+
+TEST_F(RollingDeltaFileWriterTest, FailedUploadStopsUploading) {
+  EXPECT_CALL(client_, PutBlob(_, _))
+      .WillOnce(Return(absl::UnavailableError("unavailable")));
+  auto writer = CreateWriter({.max_file_size_bytes = 1});
+  ASSERT_TRUE(writer->WriteRecord(GetRecord("key1")).ok());
+  writer->Close();
+  EXPECT_TRUE(absl::IsUnavailable(writer->Status()));
+  EXPECT_TRUE(writer->UploadedFiles().empty());
+  EXPECT_FALSE(writer->WriteRecord(GetRecord("key2")).ok());
+}
+
+TEST_F(RollingDeltaFileWriterTest, NonPositiveLimitsFail) {
+  EXPECT_FALSE(RollingDeltaFileWriter::Create(
+                   client_, {.max_file_size_bytes = 0}, {}, clock_)
+                   .ok());
+  EXPECT_FALSE(RollingDeltaFileWriter::Create(
+                   client_, {.max_file_age = absl::ZeroDuration()}, {}, clock_)
+                   .ok());
+}
+
+}  // namespace
+}  // namespace kv_server
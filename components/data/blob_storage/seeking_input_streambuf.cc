@@ -18,6 +18,7 @@
 
 #include <algorithm>
 #include <streambuf>
+#include <string>
 #include <utility>
 
 #include "absl/base/optimization.h"
@@ -25,6 +26,7 @@
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/str_format.h"
+#include "absl/time/clock.h"
 #include "components/telemetry/server_definition.h"
 
 namespace kv_server {
@@ -34,6 +36,9 @@ constexpr std::string_view kSizeEventName = "SeekingInputStreambuf::Size";
 constexpr std::string_view kUnderflowEventName =
     "SeekingInputStreambuf::underflow";
 constexpr std::string_view kSeekoffEventName = "SeekingInputStreambuf::seekoff";
+// Chunks downloaded ahead keep doubling while doubling them speeds up their
+// downloads by at least this factor.
+constexpr double kMinReadAheadThroughputGain = 1.1;
 
 void MaybeVerboseLogLatency(std::string_view event_name, absl::Duration latency,
                             double sampling_threshold = 0.05) {
@@ -42,6 +47,23 @@ void MaybeVerboseLogLatency(std::string_view event_name, absl::Duration latency,
             << " ms.";
   }
 }
+
+void LogFetchThroughput(std::string_view client_name, int64_t bytes_read,
+                        absl::Duration latency) {
+  if (bytes_read <= 0 || latency <= absl::ZeroDuration()) {
+    return;
+  }
+  if (!client_name.empty()) {
+    LogIfError(KVServerContextMap()
+                   ->SafeMetric()
+                   .LogUpDownCounter<kBlobFetchBytes>(
+                       {{std::string(client_name), bytes_read}}));
+  }
+  LogIfError(KVServerContextMap()
+                 ->SafeMetric()
+                 .LogHistogram<kBlobFetchBytesPerSecond>(
+                     bytes_read / absl::ToDoubleSeconds(latency)));
+}
 }  // namespace
 
 SeekingInputStreambuf::SeekingInputStreambuf(Options options)
@@ -123,17 +145,30 @@ std::streambuf::int_type SeekingInputStreambuf::underflow() {
   if (src_limit_position_ >= *size) {
     return traits_type::eof();
   }
+  const bool filled = options_.read_ahead_chunks > 0
+                            ? FillBufferFromReadAhead(*size)
+                            : FillBuffer(*size);
+  if (!filled) {
+    return traits_type::eof();
+  }
+  setg(buffer_.data(), buffer_.data(), buffer_.data() + buffer_.length());
+  MaybeVerboseLogLatency(kUnderflowEventName, latency_recorder.GetLatency());
+  return traits_type::to_int_type(buffer_[0]);
+}
+
+bool SeekingInputStreambuf::FillBuffer(int64_t size) {
   const int64_t total_bytes_to_read =
-      std::max(std::min(*size - src_limit_position_, options_.buffer_size), 1l);
+      std::max(std::min(size - src_limit_position_, options_.buffer_size), 1l);
   int64_t total_bytes_read = 0;
   buffer_.resize(total_bytes_to_read);
+  const absl::Time start = absl::Now();
   while (total_bytes_read < total_bytes_to_read) {
     int64_t chunk_size = total_bytes_to_read - total_bytes_read;
     auto actual_bytes_read =
         ReadChunk(src_limit_position_, chunk_size, buffer_.data());
     if (ABSL_PREDICT_FALSE(!actual_bytes_read.ok())) {
       MaybeReportError(actual_bytes_read.status());
-      return traits_type::eof();
+      return false;
     }
     if (ABSL_PREDICT_FALSE(*actual_bytes_read < 0)) {
       break;
@@ -141,15 +176,120 @@ std::streambuf::int_type SeekingInputStreambuf::underflow() {
     src_limit_position_ += *actual_bytes_read;
     total_bytes_read += *actual_bytes_read;
   }
+  LogFetchThroughput(options_.client_name, total_bytes_read,
+                     absl::Now() - start);
   if (total_bytes_read == 0) {
-    return traits_type::eof();
+    return false;
   }
   if (ABSL_PREDICT_FALSE(total_bytes_read < total_bytes_to_read)) {
     buffer_.resize(total_bytes_read);
   }
+  return true;
+}
+
+bool SeekingInputStreambuf::FillBufferFromReadAhead(int64_t size) {
+  if (!read_ahead_.empty() &&
+      read_ahead_.front().offset != src_limit_position_) {
+    // The reader seeked away from the chunks downloaded ahead.
+    StopReadAhead();
+  }
+  if (read_ahead_.empty()) {
+    read_ahead_position_ = src_limit_position_;
+  }
+  ScheduleReadAhead(size);
+  ReadAheadChunk chunk = std::move(read_ahead_.front());
+  read_ahead_.pop_front();
+  FetchedChunk fetched = chunk.fetched.Get();
+  if (ABSL_PREDICT_FALSE(!fetched.bytes.ok())) {
+    StopReadAhead();
+    MaybeReportError(fetched.bytes.status());
+    return false;
+  }
+  AdaptReadAheadChunkSize(chunk.size, fetched.latency);
+  buffer_ = std::move(*fetched.bytes);
+  src_limit_position_ += buffer_.length();
   setg(buffer_.data(), buffer_.data(), buffer_.data() + buffer_.length());
-  MaybeVerboseLogLatency(kUnderflowEventName, latency_recorder.GetLatency());
-  return traits_type::to_int_type(buffer_[0]);
+  if (ABSL_PREDICT_FALSE(static_cast<int64_t>(buffer_.length()) <
+                         chunk.size)) {
+    // The next chunks start at the wrong offsets.
+    StopReadAhead();
+  } else {
+    ScheduleReadAhead(size);
+  }
+  return !buffer_.empty();
+}
+
+void SeekingInputStreambuf::ScheduleReadAhead(int64_t size) {
+  if (read_ahead_chunk_size_ <= 0) {
+    read_ahead_chunk_size_ = std::clamp(options_.min_read_ahead_chunk_size,
+                                        int64_t{1}, MaxReadAheadChunkSize());
+  }
+  while (read_ahead_position_ < size &&
+         static_cast<int>(read_ahead_.size()) < options_.read_ahead_chunks) {
+    const int64_t offset = read_ahead_position_;
+    const int64_t chunk_size =
+        std::min(read_ahead_chunk_size_, size - read_ahead_position_);
+    read_ahead_.push_back(ReadAheadChunk{
+        .offset = offset,
+        .size = chunk_size,
+        .fetched = SharedThreadPool().Async([this, offset, chunk_size] {
+          return FetchChunk(offset, chunk_size);
+        }),
+    });
+    read_ahead_position_ += chunk_size;
+  }
+}
+
+SeekingInputStreambuf::FetchedChunk SeekingInputStreambuf::FetchChunk(
+    int64_t offset, int64_t chunk_size) {
+  const absl::Time start = absl::Now();
+  std::string bytes(chunk_size, '\0');
+  int64_t bytes_read = 0;
+  while (bytes_read < chunk_size) {
+    auto actual_bytes_read = ReadChunk(offset + bytes_read,
+                                       chunk_size - bytes_read,
+                                       bytes.data() + bytes_read);
+    if (ABSL_PREDICT_FALSE(!actual_bytes_read.ok())) {
+      return {.bytes = actual_bytes_read.status(),
+              .latency = absl::Now() - start};
+    }
+    if (ABSL_PREDICT_FALSE(*actual_bytes_read <= 0)) {
+      break;
+    }
+    bytes_read += *actual_bytes_read;
+  }
+  bytes.resize(bytes_read);
+  const absl::Duration latency = absl::Now() - start;
+  LogFetchThroughput(options_.client_name, bytes_read, latency);
+  return {.bytes = std::move(bytes), .latency = latency};
+}
+
+void SeekingInputStreambuf::AdaptReadAheadChunkSize(int64_t chunk_size,
+                                                    absl::Duration latency) {
+  // Each chunk size is measured once, on its first chunk.
+  if (chunk_size != read_ahead_chunk_size_ ||
+      chunk_size <= measured_chunk_size_ || latency <= absl::ZeroDuration()) {
+    return;
+  }
+  const double bytes_per_second = chunk_size / absl::ToDoubleSeconds(latency);
+  measured_chunk_size_ = chunk_size;
+  // Larger chunks pay off as long as round trips, rather than bandwidth,
+  // bound their downloads.
+  if (bytes_per_second >
+      kMinReadAheadThroughputGain * measured_bytes_per_second_) {
+    measured_bytes_per_second_ = bytes_per_second;
+    read_ahead_chunk_size_ =
+        std::min(2 * read_ahead_chunk_size_, MaxReadAheadChunkSize());
+  }
+}
+
+int64_t SeekingInputStreambuf::MaxReadAheadChunkSize() const {
+  return std::max(options_.buffer_size, int64_t{1});
+}
+
+void SeekingInputStreambuf::StopReadAhead() {
+  // Destroying the futures waits for their downloads.
+  read_ahead_.clear();
 }
 
 std::streamsize SeekingInputStreambuf::showmanyc() {
@@ -14,12 +14,16 @@
  * limitations under the License.
  */
 
+#include <deque>
 #include <memory>
 #include <streambuf>
 #include <string>
+#include <string_view>
 
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/time/time.h"
+#include "components/util/thread_pool.h"
 #include "src/telemetry/telemetry_provider.h"
 
 #ifndef COMPONENTS_DATA_BLOB_STORAGE_SEEKING_INPUT_STREAMBUF_H_
@@ -69,6 +73,18 @@ class SeekingInputStreambuf : public std::streambuf {
     // underlying source which can be painfully slow and expensive.
     std::int64_t buffer_size = 8 * 1024 * 1024;  // 8MB
     std::function<void(absl::Status)> error_callback = [](absl::Status) {};
+    // Number of chunks downloaded ahead of the reader, concurrently, on the
+    // shared thread pool. With 0, a chunk is downloaded when the buffer runs
+    // out. With read-ahead, `ReadChunk` is called from several threads at
+    // once and child streambufs must call `StopReadAhead()` in their
+    // destructor.
+    int read_ahead_chunks = 0;
+    // Chunks downloaded ahead start at this size and double, up to
+    // `buffer_size`, as long as the larger chunks download faster.
+    std::int64_t min_read_ahead_chunk_size = 1024 * 1024;  // 1MB
+    // Blob storage client that the fetched bytes are counted for, one of
+    // `kBlobStorageClients`. Not counted if empty.
+    std::string_view client_name;
   };
 
   explicit SeekingInputStreambuf(Options options = Options());
@@ -103,8 +119,29 @@ class SeekingInputStreambuf : public std::streambuf {
   //  when `!ok()` - An error status with error description.
   virtual absl::StatusOr<int64_t> ReadChunk(int64_t offset, int64_t chunk_size,
                                             char* dest_buffer) = 0;
+  // Waits for the chunks being downloaded ahead and drops them.
+  void StopReadAhead();
 
  private:
+  struct FetchedChunk {
+    absl::StatusOr<std::string> bytes;
+    absl::Duration latency;
+  };
+  struct ReadAheadChunk {
+    int64_t offset;
+    int64_t size;
+    TaskFuture<FetchedChunk> fetched;
+  };
+
+  // Fills the buffer with the bytes at `src_limit_position_`, returns false
+  // at the end of the blob or on errors.
+  bool FillBuffer(int64_t size);
+  bool FillBufferFromReadAhead(int64_t size);
+  // Schedules downloads until `read_ahead_chunks` are in flight.
+  void ScheduleReadAhead(int64_t size);
+  FetchedChunk FetchChunk(int64_t offset, int64_t chunk_size);
+  void AdaptReadAheadChunkSize(int64_t chunk_size, absl::Duration latency);
+  int64_t MaxReadAheadChunkSize() const;
   int64_t BufferAvailableChars();
   int64_t BufferStartPosition();
   int64_t BufferCursorPosition();
@@ -117,6 +154,15 @@ class SeekingInputStreambuf : public std::streambuf {
   // already.
   int64_t src_limit_position_ = 0;
   int64_t src_cached_size_ = -1;
+  // Chunks being downloaded ahead, in blob order, ending at
+  // `read_ahead_position_`.
+  std::deque<ReadAheadChunk> read_ahead_;
+  int64_t read_ahead_position_ = 0;
+  int64_t read_ahead_chunk_size_ = 0;
+  // The largest chunk size whose download throughput was measured, and that
+  // throughput.
+  int64_t measured_chunk_size_ = 0;
+  double measured_bytes_per_second_ = 0;
 };
 
 }  // namespace kv_server
@@ -33,9 +33,13 @@ namespace {
 
 using privacy_sandbox::server_common::TelemetryProvider;
 
-SeekingInputStreambuf::Options GetOptions(int64_t buffer_size) {
+SeekingInputStreambuf::Options GetOptions(int64_t buffer_size,
+                                          int read_ahead_chunks = 0,
+                                          int64_t min_chunk_size = 1) {
   SeekingInputStreambuf::Options options;
   options.buffer_size = buffer_size;
+  options.read_ahead_chunks = read_ahead_chunks;
+  options.min_read_ahead_chunk_size = min_chunk_size;
   return options;
 }
 
@@ -44,6 +48,7 @@ class StringBlobInputStreambuf : public SeekingInputStreambuf {
   StringBlobInputStreambuf(std::string_view blob,
                            SeekingInputStreambuf::Options options)
       : SeekingInputStreambuf(std::move(options)), blob_(blob) {}
+  ~StringBlobInputStreambuf() override { StopReadAhead(); }
 
  protected:
   absl::StatusOr<int64_t> ReadChunk(int64_t offset, int64_t chunk_size,
@@ -84,7 +89,10 @@ INSTANTIATE_TEST_SUITE_P(
     BufferSize, SeekingInputStreambufTest,
     testing::Values(
         GetOptions(/*buffer_size=*/0), GetOptions(/*buffer_size=*/1 << 4),
-        GetOptions(/*buffer_size=*/std::numeric_limits<int64_t>::max())));
+        GetOptions(/*buffer_size=*/std::numeric_limits<int64_t>::max()),
+        GetOptions(/*buffer_size=*/1 << 4, /*read_ahead_chunks=*/3,
+                   /*min_chunk_size=*/3),
+        GetOptions(/*buffer_size=*/1 << 20, /*read_ahead_chunks=*/2)));
 
 TEST_P(SeekingInputStreambufTest, VerifyCanReadEntireBlob) {
   constexpr std::string_view blob =
@@ -97,6 +105,18 @@ TEST_P(SeekingInputStreambufTest, VerifyCanReadEntireBlob) {
   EXPECT_EQ(std::string(blob), ss.str());
 }
 
+TEST_P(SeekingInputStreambufTest, VerifyCanReadEntireLargeBlob) {
+  std::string blob;
+  for (int i = 0; blob.size() < 100000; ++i) {
+    blob.append(absl::StrFormat("%d,", i));
+  }
+  auto streambuf = SeekingInputStreambufTest::CreateStringBlobStreambuf(blob);
+  std::istream blob_stream(&streambuf);
+  std::stringstream ss;
+  ss << blob_stream.rdbuf();
+  EXPECT_EQ(blob, ss.str());
+}
+
 TEST_P(SeekingInputStreambufTest, VerifySeekingByOffsetFromDirection) {
   constexpr std::string_view blob =
       "I am a very random blob with random bits of data.";
@@ -70,11 +70,8 @@ class MockBlobReader : public BlobReader {
 class MockRealtimeNotifier : public RealtimeNotifier {
  public:
   MockRealtimeNotifier() : RealtimeNotifier() {}
-  MOCK_METHOD(
-      absl::Status, Start,
-      (std::function<absl::StatusOr<DataLoadingStats>(const std::string& key)>
-           callback),
-      (override));
+  MOCK_METHOD(absl::Status, Start, (RealtimeUpdatesCallback callback),
+              (override));
   MOCK_METHOD(absl::Status, Stop, (), (override));
   MOCK_METHOD(bool, IsRunning, (), (const, override));
 };
@@ -91,11 +88,8 @@ class MockChangeNotifier : public ChangeNotifier {
 class MockRealtimeThreadPoolManager : public RealtimeThreadPoolManager {
  public:
   MockRealtimeThreadPoolManager() : RealtimeThreadPoolManager() {}
-  MOCK_METHOD(
-      absl::Status, Start,
-      (std::function<absl::StatusOr<DataLoadingStats>(const std::string& key)>
-           callback),
-      (override));
+  MOCK_METHOD(absl::Status, Start, (RealtimeUpdatesCallback callback),
+              (override));
   MOCK_METHOD(absl::Status, Stop, (), (override));
 };
 
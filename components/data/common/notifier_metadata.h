@@ -55,6 +55,10 @@ struct GcpNotifierMetadata {
   int32_t num_threads = 1;
   int32_t num_shards = 1;
   int32_t shard_num;
+  // Flow control of the streaming pull. Non-positive values keep the client
+  // library defaults.
+  int64_t max_outstanding_messages = 0;
+  int64_t max_outstanding_bytes = 0;
 };
 using NotifierMetadata =
     std::variant<AwsNotifierMetadata, LocalNotifierMetadata,
@@ -0,0 +1,131 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data/realtime/adaptive_concurrency_limit.h"
+
+#include <algorithm>
+#include <memory>
+#include <utility>
+
+#include "absl/log/log.h"
+#include "components/telemetry/server_definition.h"
+
+namespace kv_server {
+namespace {
+using privacy_sandbox::server_common::SteadyClock;
+using privacy_sandbox::server_common::SteadyTime;
+
+void LogLimitChange(int delta) {
+  LogIfError(KVServerContextMap()
+                 ->SafeMetric()
+                 .LogUpDownCounter<kRealtimeUpdaterConcurrencyLimit>(delta));
+}
+
+class AdaptiveRealtimeThreadPoolManager : public RealtimeThreadPoolManager {
+ public:
+  AdaptiveRealtimeThreadPoolManager(
+      std::unique_ptr<RealtimeThreadPoolManager> manager,
+      AdaptiveConcurrencyLimit::Options options)
+      : limit_(std::move(options)), manager_(std::move(manager)) {}
+
+  absl::Status Start(RealtimeUpdatesCallback callback) override {
+    return manager_->Start(limit_.Wrap(std::move(callback)));
+  }
+
+  absl::Status Stop() override { return manager_->Stop(); }
+
+ private:
+  // Outlives `manager_`, whose notifiers run the callbacks that use it.
+  AdaptiveConcurrencyLimit limit_;
+  std::unique_ptr<RealtimeThreadPoolManager> manager_;
+};
+}  // namespace
+
+AdaptiveConcurrencyLimit::AdaptiveConcurrencyLimit(Options options,
+                                                   SteadyClock& clock)
+    : options_(std::move(options)),
+      clock_(clock),
+      limit_(std::clamp(options_.min_concurrency, 1,
+                        std::max(options_.max_concurrency, 1))),
+      interval_start_(clock_.Now()) {
+  LogLimitChange(limit_);
+}
+
+void AdaptiveConcurrencyLimit::Acquire() {
+  const SteadyTime wait_start = clock_.Now();
+  absl::MutexLock lock(&mutex_);
+  mutex_.Await(absl::Condition(this, &AdaptiveConcurrencyLimit::HasFreeSlot));
+  ++in_use_;
+  peak_in_use_ = std::max(peak_in_use_, in_use_);
+  max_wait_ = std::max(max_wait_, clock_.Now() - wait_start);
+  MaybeAdjust();
+}
+
+void AdaptiveConcurrencyLimit::Release() {
+  absl::MutexLock lock(&mutex_);
+  --in_use_;
+  MaybeAdjust();
+}
+
+int AdaptiveConcurrencyLimit::limit() const {
+  absl::MutexLock lock(&mutex_);
+  return limit_;
+}
+
+bool AdaptiveConcurrencyLimit::HasFreeSlot() const { return in_use_ < limit_; }
+
+void AdaptiveConcurrencyLimit::MaybeAdjust() {
+  const SteadyTime now = clock_.Now();
+  if (now - interval_start_ < options_.adjustment_interval) {
+    return;
+  }
+  int new_limit = limit_;
+  if (max_wait_ > options_.max_queue_delay) {
+    new_limit = std::min(limit_ + 1, options_.max_concurrency);
+  } else if (peak_in_use_ < limit_) {
+    new_limit = std::max(limit_ - 1, options_.min_concurrency);
+  }
+  if (new_limit != limit_) {
+    LOG(INFO) << "Realtime concurrency limit moves from " << limit_ << " to "
+              << new_limit << ", longest wait for a slot: " << max_wait_
+              << ", most slots in use: " << peak_in_use_;
+    LogLimitChange(new_limit - limit_);
+    limit_ = new_limit;
+  }
+  interval_start_ = now;
+  peak_in_use_ = in_use_;
+  max_wait_ = absl::ZeroDuration();
+}
+
+RealtimeUpdatesCallback AdaptiveConcurrencyLimit::Wrap(
+    RealtimeUpdatesCallback callback) {
+  return [this, callback = std::move(callback)](
+             absl::Span<const std::string> updates) {
+    Acquire();
+    auto result = callback(updates);
+    Release();
+    return result;
+  };
+}
+
+std::unique_ptr<RealtimeThreadPoolManager> WithAdaptiveConcurrencyLimit(
+    std::unique_ptr<RealtimeThreadPoolManager> manager,
+    AdaptiveConcurrencyLimit::Options options) {
+  return std::make_unique<AdaptiveRealtimeThreadPoolManager>(
+      std::move(manager), std::move(options));
+}
+
+}  // namespace kv_server
@@ -0,0 +1,90 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_REALTIME_ADAPTIVE_CONCURRENCY_LIMIT_H_
+#define COMPONENTS_DATA_REALTIME_ADAPTIVE_CONCURRENCY_LIMIT_H_
+
+#include <memory>
+
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "components/data/realtime/realtime_notifier.h"
+#include "components/data/realtime/realtime_thread_pool_manager.h"
+#include "src/util/duration.h"
+
+namespace kv_server {
+
+// Limits the number of realtime update batches that are applied at once.
+// The limit starts at `min_concurrency` and moves by one every
+// `adjustment_interval`: up, to at most `max_concurrency`, if updates waited
+// longer than `max_queue_delay` to be applied, and down if some of the slots
+// were left unused. The time updates wait here adds to their end to end
+// latency, while slots that are never used only cost threads that compete
+// with request serving.
+//
+// Thread safe.
+class AdaptiveConcurrencyLimit {
+ public:
+  struct Options {
+    int min_concurrency = 1;
+    // The CPU budget of realtime updates, never exceeded.
+    int max_concurrency = 1;
+    absl::Duration adjustment_interval = absl::Seconds(10);
+    absl::Duration max_queue_delay = absl::Milliseconds(50);
+  };
+
+  explicit AdaptiveConcurrencyLimit(
+      Options options, privacy_sandbox::server_common::SteadyClock& clock =
+                           privacy_sandbox::server_common::SteadyClock::
+                               RealClock());
+
+  // Waits until fewer than `limit()` callers hold a slot, then takes one.
+  void Acquire() ABSL_LOCKS_EXCLUDED(mutex_);
+  // Releases a slot taken by `Acquire`.
+  void Release() ABSL_LOCKS_EXCLUDED(mutex_);
+
+  int limit() const ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Returns a callback that calls `callback` while holding a slot.
+  RealtimeUpdatesCallback Wrap(RealtimeUpdatesCallback callback);
+
+ private:
+  bool HasFreeSlot() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Moves the limit if the adjustment interval is over.
+  void MaybeAdjust() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  const Options options_;
+  privacy_sandbox::server_common::SteadyClock& clock_;
+  mutable absl::Mutex mutex_;
+  int limit_ ABSL_GUARDED_BY(mutex_);
+  int in_use_ ABSL_GUARDED_BY(mutex_) = 0;
+  // Most slots in use at once, and longest wait for a slot, in the current
+  // adjustment interval.
+  int peak_in_use_ ABSL_GUARDED_BY(mutex_) = 0;
+  absl::Duration max_wait_ ABSL_GUARDED_BY(mutex_) = absl::ZeroDuration();
+  privacy_sandbox::server_common::SteadyTime interval_start_
+      ABSL_GUARDED_BY(mutex_);
+};
+
+// Returns a manager that starts `manager` with callbacks that are applied
+// under an `AdaptiveConcurrencyLimit` with `options`.
+std::unique_ptr<RealtimeThreadPoolManager> WithAdaptiveConcurrencyLimit(
+    std::unique_ptr<RealtimeThreadPoolManager> manager,
+    AdaptiveConcurrencyLimit::Options options);
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_REALTIME_ADAPTIVE_CONCURRENCY_LIMIT_H_
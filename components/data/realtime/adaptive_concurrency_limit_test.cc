@@ -0,0 +1,123 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data/realtime/adaptive_concurrency_limit.h"
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/time/clock.h"
+#include "components/data/common/mocks.h"
+#include "components/telemetry/server_definition.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+using privacy_sandbox::server_common::SimulatedSteadyClock;
+using testing::ElementsAre;
+
+class AdaptiveConcurrencyLimitTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    privacy_sandbox::server_common::telemetry::TelemetryConfig config_proto;
+    config_proto.set_mode(
+        privacy_sandbox::server_common::telemetry::TelemetryConfig::PROD);
+    kv_server::KVServerContextMap(
+        privacy_sandbox::server_common::telemetry::BuildDependentConfig(
+            config_proto));
+  }
+  SimulatedSteadyClock clock_;
+};
+
+TEST_F(AdaptiveConcurrencyLimitTest, StartsAtMinConcurrency) {
+  AdaptiveConcurrencyLimit limit({.min_concurrency = 2, .max_concurrency = 4},
+                                 clock_);
+  EXPECT_EQ(limit.limit(), 2);
+}
+
+TEST_F(AdaptiveConcurrencyLimitTest, MovesLimitWithQueueDelay) {
+  AdaptiveConcurrencyLimit limit({.min_concurrency = 1,
+                                  .max_concurrency = 2,
+                                  .adjustment_interval = absl::Seconds(10),
+                                  .max_queue_delay = absl::Milliseconds(50)},
+                                 clock_);
+  limit.Acquire();
+  std::thread waiter([&limit] { limit.Acquire(); });
+  // Lets the waiter start waiting for the slot.
+  absl::SleepFor(absl::Milliseconds(100));
+  clock_.AdvanceTime(absl::Seconds(11));
+  limit.Release();
+  waiter.join();
+  EXPECT_EQ(limit.limit(), 1);
+
+  // The waiter waited longer than the max queue delay.
+  clock_.AdvanceTime(absl::Seconds(11));
+  limit.Release();
+  EXPECT_EQ(limit.limit(), 2);
+
+  // Never above the max concurrency.
+  limit.Acquire();
+  limit.Acquire();
+  std::thread other_waiter([&limit] { limit.Acquire(); });
+  absl::SleepFor(absl::Milliseconds(100));
+  clock_.AdvanceTime(absl::Seconds(11));
+  limit.Release();
+  other_waiter.join();
+  clock_.AdvanceTime(absl::Seconds(11));
+  limit.Release();
+  EXPECT_EQ(limit.limit(), 2);
+
+  // Only one of the two slots was used in the interval.
+  clock_.AdvanceTime(absl::Seconds(11));
+  limit.Release();
+  EXPECT_EQ(limit.limit(), 1);
+}
+
+TEST_F(AdaptiveConcurrencyLimitTest, StartsManagerWithLimitedCallback) {
+  auto manager = std::make_unique<MockRealtimeThreadPoolManager>();
+  RealtimeUpdatesCallback started_callback;
+  EXPECT_CALL(*manager, Start)
+      .WillOnce([&started_callback](RealtimeUpdatesCallback callback) {
+        started_callback = std::move(callback);
+        return absl::OkStatus();
+      });
+  EXPECT_CALL(*manager, Stop).WillOnce(testing::Return(absl::OkStatus()));
+  auto limited_manager = WithAdaptiveConcurrencyLimit(
+      std::move(manager), {.min_concurrency = 1, .max_concurrency = 2});
+
+  std::vector<std::string> received;
+  ASSERT_TRUE(limited_manager
+                  ->Start([&received](absl::Span<const std::string> updates)
+                              -> absl::StatusOr<DataLoadingStats> {
+                    received.assign(updates.begin(), updates.end());
+                    return DataLoadingStats{.total_updated_records = 1};
+                  })
+                  .ok());
+  ASSERT_TRUE(started_callback);
+  const std::vector<std::string> updates = {"update"};
+  auto stats = started_callback(updates);
+  ASSERT_TRUE(stats.ok());
+  EXPECT_EQ(stats->total_updated_records, 1);
+  EXPECT_THAT(received, ElementsAre("update"));
+  EXPECT_TRUE(limited_manager->Stop().ok());
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -89,12 +89,13 @@ class AwsDeltaFileRecordChangeNotifier : public DeltaFileRecordChangeNotifier {
       return absl::InvalidArgumentError("Message is not a string");
     }
 
-    std::string string_decoded;
-    if (!absl::Base64Unescape(message.AsString(), &string_decoded)) {
+    // SNS messages are text, so even realtime envelopes are base64 encoded.
+    // The body is decoded in place of the parsed message.
+    ParsedBody pb;
+    if (!absl::Base64Unescape(message.AsString(), &pb.message)) {
       return absl::InvalidArgumentError(
           "The body of the message is not a base64 encoded string.");
     }
-    ParsedBody pb = {.message = string_decoded};
     const auto message_attributes = view.GetObject("MessageAttributes");
     const auto sns_time_stamp = view.GetObject("Timestamp").AsString();
 
@@ -17,9 +17,12 @@
 #ifndef COMPONENTS_DATA_REALTIME_NOTIFIER_H_
 #define COMPONENTS_DATA_REALTIME_NOTIFIER_H_
 
+#include <functional>
 #include <memory>
 #include <string>
 
+#include "absl/status/statusor.h"
+#include "absl/types/span.h"
 #include "components/data/common/notifier_metadata.h"
 #include "components/data/common/thread_manager.h"
 #include "components/data/realtime/realtime_notifier_metadata.h"
@@ -33,19 +36,22 @@ struct DataLoadingStats {
   int64_t total_dropped_records = 0;
 };
 
+// Loads high priority updates, each a serialized delta stream. Called with all
+// the updates received together, so that they are applied as one batch.
+using RealtimeUpdatesCallback = std::function<absl::StatusOr<DataLoadingStats>(
+    absl::Span<const std::string> updates)>;
+
 class RealtimeNotifier {
  public:
   virtual ~RealtimeNotifier() = default;
 
   // Starts to monitor high priority updates.
-  // Calls `callback` on every high priority update.
+  // Calls `callback` with the high priority updates received together.
   // `callback` blocks this object's operations so it should
   // return as soon as possible.
   // Start and Stop should be called on the same thread as
   // the constructor.
-  virtual absl::Status Start(
-      std::function<absl::StatusOr<DataLoadingStats>(const std::string& key)>
-          callback) = 0;
+  virtual absl::Status Start(RealtimeUpdatesCallback callback) = 0;
 
   // Blocks until `IsRunning` is False.
   virtual absl::Status Stop() = 0;
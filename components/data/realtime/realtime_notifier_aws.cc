@@ -14,6 +14,7 @@
 
 #include <algorithm>
 #include <cstddef>
+#include <string>
 #include <thread>
 #include <utility>
 #include <vector>
@@ -40,9 +41,7 @@ class RealtimeNotifierImpl : public RealtimeNotifier {
         sleep_for_(std::move(sleep_for)),
         change_notifier_(std::move(change_notifier)) {}
 
-  absl::Status Start(
-      std::function<absl::StatusOr<DataLoadingStats>(const std::string& key)>
-          callback) override {
+  absl::Status Start(RealtimeUpdatesCallback callback) override {
     return thread_manager_->Start([this, &change_notifier = *change_notifier_,
                                    callback = std::move(callback)]() mutable {
       Watch(change_notifier, std::move(callback));
@@ -58,10 +57,8 @@ class RealtimeNotifierImpl : public RealtimeNotifier {
   bool IsRunning() const override { return thread_manager_->IsRunning(); }
 
  private:
-  void Watch(
-      DeltaFileRecordChangeNotifier& change_notifier,
-      std::function<absl::StatusOr<DataLoadingStats>(const std::string& key)>
-          callback) {
+  void Watch(DeltaFileRecordChangeNotifier& change_notifier,
+             RealtimeUpdatesCallback callback) {
     // Starts with zero wait to force an initial short poll.
     // Later polls are long polls.
     auto max_wait = absl::ZeroDuration();
@@ -92,12 +89,19 @@ class RealtimeNotifierImpl : public RealtimeNotifier {
       }
       sequential_failures = 0;
 
-      for (const auto& realtime_message : updates->realtime_messages) {
-        if (auto count = callback(realtime_message.parsed_notification);
-            !count.ok()) {
+      // The messages received together are applied as one batch.
+      std::vector<std::string> messages;
+      messages.reserve(updates->realtime_messages.size());
+      for (auto& realtime_message : updates->realtime_messages) {
+        messages.push_back(std::move(realtime_message.parsed_notification));
+      }
+      if (!messages.empty()) {
+        if (auto count = callback(messages); !count.ok()) {
           LOG(ERROR) << "Data loading callback failed: " << count.status();
           LogServerErrorMetric(kRealtimeMessageApplicationFailure);
         }
+      }
+      for (const auto& realtime_message : updates->realtime_messages) {
         auto e2e_cloud_provided_latency = absl::ToDoubleMicroseconds(
             absl::Now() - realtime_message.notifications_sns_inserted);
         // we're getting this value based on two different clocks. Opentelemetry
@@ -26,6 +26,7 @@
 #include "public/data_loading/filename_utils.h"
 
 using testing::_;
+using testing::ElementsAre;
 using testing::Field;
 using testing::Return;
 
@@ -71,11 +72,12 @@ TEST_F(RealtimeNotifierAwsTest, ConsecutiveStartsWork) {
       .change_notifier_for_unit_testing = change_notifier_.release(),
   };
   auto maybe_notifier = RealtimeNotifier::Create({}, std::move(options));
-  absl::Status status = (*maybe_notifier)->Start([](const std::string&) {
-    return absl::OkStatus();
-  });
+  absl::Status status =
+      (*maybe_notifier)->Start([](absl::Span<const std::string>) {
+        return absl::OkStatus();
+      });
   ASSERT_TRUE(status.ok());
-  status = (*maybe_notifier)->Start([](const std::string&) {
+  status = (*maybe_notifier)->Start([](absl::Span<const std::string>) {
     return absl::OkStatus();
   });
   ASSERT_FALSE(status.ok());
@@ -87,9 +89,10 @@ TEST_F(RealtimeNotifierAwsTest, StartsAndStops) {
       .change_notifier_for_unit_testing = change_notifier_.release(),
   };
   auto maybe_notifier = RealtimeNotifier::Create({}, std::move(options));
-  absl::Status status = (*maybe_notifier)->Start([](const std::string&) {
-    return absl::OkStatus();
-  });
+  absl::Status status =
+      (*maybe_notifier)->Start([](absl::Span<const std::string>) {
+        return absl::OkStatus();
+      });
   ASSERT_TRUE(status.ok());
   EXPECT_TRUE((*maybe_notifier)->IsRunning());
   status = (*maybe_notifier)->Stop();
@@ -122,17 +125,17 @@ TEST_F(RealtimeNotifierAwsTest, NotifiesWithHighPriorityUpdates) {
 
   absl::Notification finished;
   testing::MockFunction<absl::StatusOr<DataLoadingStats>(
-      const std::string& record)>
+      absl::Span<const std::string> records)>
       callback;
   // will match the above
   EXPECT_CALL(callback, Call)
       .Times(2)
-      .WillOnce([&](const std::string& key) {
-        EXPECT_EQ(key, high_priority_update_1);
+      .WillOnce([&](absl::Span<const std::string> keys) {
+        EXPECT_THAT(keys, ElementsAre(high_priority_update_1));
         return DataLoadingStats{};
       })
-      .WillOnce([&](const std::string& key) {
-        EXPECT_EQ(key, high_priority_update_2);
+      .WillOnce([&](absl::Span<const std::string> keys) {
+        EXPECT_THAT(keys, ElementsAre(high_priority_update_2));
         finished.Notify();
         return DataLoadingStats{};
       });
@@ -150,6 +153,43 @@ TEST_F(RealtimeNotifierAwsTest, NotifiesWithHighPriorityUpdates) {
   EXPECT_FALSE((*maybe_notifier)->IsRunning());
 }
 
+TEST_F(RealtimeNotifierAwsTest, NotifiesWithUpdatesReceivedTogetherAtOnce) {
+  std::string high_priority_update_1 = "high_priority_update_1";
+  std::string high_priority_update_2 = "high_priority_update_2";
+  EXPECT_CALL(*change_notifier_, GetNotifications(_, _))
+      .WillOnce([&]() {
+        NotificationsContext nc = GetNotificationsContext();
+        nc.realtime_messages = std::vector<RealtimeMessage>(
+            {RealtimeMessage{.parsed_notification = high_priority_update_1},
+             RealtimeMessage{.parsed_notification = high_priority_update_2}});
+        return nc;
+      })
+      .WillRepeatedly([]() { return GetNotificationsContext(); });
+
+  absl::Notification finished;
+  testing::MockFunction<absl::StatusOr<DataLoadingStats>(
+      absl::Span<const std::string> records)>
+      callback;
+  EXPECT_CALL(callback, Call)
+      .Times(1)
+      .WillOnce([&](absl::Span<const std::string> keys) {
+        EXPECT_THAT(keys, ElementsAre(high_priority_update_1,
+                                      high_priority_update_2));
+        finished.Notify();
+        return DataLoadingStats{};
+      });
+  AwsRealtimeNotifierMetadata options = {
+      .maybe_sleep_for = std::move(mock_sleep_for_),
+      .change_notifier_for_unit_testing = change_notifier_.release(),
+  };
+  auto maybe_notifier = RealtimeNotifier::Create({}, std::move(options));
+  absl::Status status = (*maybe_notifier)->Start(callback.AsStdFunction());
+  ASSERT_TRUE(status.ok());
+  finished.WaitForNotification();
+  status = (*maybe_notifier)->Stop();
+  ASSERT_TRUE(status.ok());
+}
+
 TEST_F(RealtimeNotifierAwsTest, GetChangesFailure) {
   std::string high_priority_update_1 = "high_priority_update_1";
   EXPECT_CALL(*change_notifier_, GetNotifications(_, _))
@@ -166,13 +206,15 @@ TEST_F(RealtimeNotifierAwsTest, GetChangesFailure) {
 
   absl::Notification finished;
   testing::MockFunction<absl::StatusOr<DataLoadingStats>(
-      const std::string& record)>
+      absl::Span<const std::string> records)>
       callback;
-  EXPECT_CALL(callback, Call).Times(1).WillOnce([&](const std::string& key) {
-    EXPECT_EQ(key, high_priority_update_1);
-    finished.Notify();
-    return DataLoadingStats{};
-  });
+  EXPECT_CALL(callback, Call)
+      .Times(1)
+      .WillOnce([&](absl::Span<const std::string> keys) {
+        EXPECT_THAT(keys, ElementsAre(high_priority_update_1));
+        finished.Notify();
+        return DataLoadingStats{};
+      });
   EXPECT_CALL(*mock_sleep_for_, Duration(absl::Seconds(2)))
       .Times(1)
       .WillOnce(Return(true));
@@ -21,7 +21,9 @@
 #include "components/data/common/thread_manager.h"
 #include "components/data/realtime/realtime_notifier.h"
 #include "google/cloud/pubsub/message.h"
+#include "google/cloud/pubsub/options.h"
 #include "google/cloud/pubsub/subscriber.h"
+#include "public/data_loading/readers/realtime_envelope.h"
 #include "src/telemetry/telemetry.h"
 
 namespace kv_server {
@@ -47,9 +49,7 @@ class RealtimeNotifierGcp : public RealtimeNotifier {
     }
   }
 
-  absl::Status Start(
-      std::function<absl::StatusOr<DataLoadingStats>(const std::string& key)>
-          callback) override {
+  absl::Status Start(RealtimeUpdatesCallback callback) override {
     return thread_manager_->Start(
         [this, callback = std::move(callback)]() mutable {
           Watch(std::move(callback));
@@ -106,34 +106,49 @@ class RealtimeNotifierGcp : public RealtimeNotifier {
                        absl::ToDoubleMicroseconds(e2eDuration)));
   }
 
-  void OnMessageReceived(
-      pubsub::Message const& m, pubsub::AckHandler h,
-      std::function<absl::StatusOr<DataLoadingStats>(const std::string& key)>&
-          callback) {
+  static void LogOutstandingMessages(int delta) {
+    LogIfError(KVServerContextMap()
+                   ->SafeMetric()
+                   .LogUpDownCounter<kRealtimeOutstandingMessages>(delta));
+  }
+
+  void OnMessageReceived(pubsub::Message const& m, pubsub::AckHandler h,
+                         RealtimeUpdatesCallback& callback) {
     auto start = absl::Now();
+    LogOutstandingMessages(1);
+    // Pub/Sub carries raw bytes, so envelopes are published as is and passed
+    // on from the buffer of the message.
     std::string string_decoded;
-    if (!absl::Base64Unescape(m.data(), &string_decoded)) {
-      LogServerErrorMetric(kRealtimeDecodeMessageFailure);
-      LOG(ERROR) << "The body of the message is not a base64 encoded string.";
-      std::move(h).ack();
-      return;
+    const std::string* update = &m.data();
+    if (!IsRealtimeEnvelope(m.data())) {
+      if (!absl::Base64Unescape(m.data(), &string_decoded)) {
+        LogServerErrorMetric(kRealtimeDecodeMessageFailure);
+        LOG(ERROR)
+            << "The body of the message is not a base64 encoded string.";
+        std::move(h).ack();
+        LogOutstandingMessages(-1);
+        return;
+      }
+      update = &string_decoded;
     }
-    if (auto count = callback(string_decoded); !count.ok()) {
+    // The subscriber delivers messages one at a time.
+    if (auto count = callback(absl::MakeConstSpan(update, 1)); !count.ok()) {
       LOG(ERROR) << "Data loading callback failed: " << count.status();
       LogServerErrorMetric(kRealtimeMessageApplicationFailure);
     }
     RecordGcpSuppliedE2ELatency(m);
     RecordProducerSuppliedE2ELatency(m);
+    // Acks are not sent one by one: the subscriber session coalesces them
+    // into the writes of its streaming pull.
     std::move(h).ack();
+    LogOutstandingMessages(-1);
     LogIfError(KVServerContextMap()
                    ->SafeMetric()
                    .LogHistogram<kReceivedLowLatencyNotifications>(
                        absl::ToDoubleMicroseconds(absl::Now() - start)));
   }
 
-  void Watch(
-      std::function<absl::StatusOr<DataLoadingStats>(const std::string& key)>
-          callback) {
+  void Watch(RealtimeUpdatesCallback callback) {
     {
       absl::MutexLock lock(&mutex_);
       session_ = gcp_subscriber_->Subscribe(
@@ -172,13 +187,30 @@ absl::StatusOr<std::unique_ptr<Subscriber>> CreateSubscriber(
   LOG(INFO) << "Listening to queue_id " << queue_metadata.queue_id
             << " project id " << notifier_metadata.project_id << " with "
             << notifier_metadata.num_threads << " threads.";
-  return std::make_unique<Subscriber>(pubsub::MakeSubscriberConnection(
-      pubsub::Subscription(notifier_metadata.project_id,
-                           queue_metadata.queue_id),
+  // The subscriber keeps one long-lived streaming pull open and runs the
+  // message callbacks on a pool of `num_threads` threads.
+  auto options =
       Options{}
           .set<pubsub::MaxConcurrencyOption>(notifier_metadata.num_threads)
           .set<GrpcBackgroundThreadPoolSizeOption>(
-              notifier_metadata.num_threads)));
+              notifier_metadata.num_threads);
+  if (notifier_metadata.max_outstanding_messages > 0) {
+    options.set<pubsub::MaxOutstandingMessagesOption>(
+        notifier_metadata.max_outstanding_messages);
+  }
+  if (notifier_metadata.max_outstanding_bytes > 0) {
+    options.set<pubsub::MaxOutstandingBytesOption>(
+        notifier_metadata.max_outstanding_bytes);
+  }
+  LOG(INFO) << "Max outstanding messages "
+            << notifier_metadata.max_outstanding_messages
+            << ", max outstanding bytes "
+            << notifier_metadata.max_outstanding_bytes
+            << " (non-positive means the client library default).";
+  return std::make_unique<Subscriber>(pubsub::MakeSubscriberConnection(
+      pubsub::Subscription(notifier_metadata.project_id,
+                           queue_metadata.queue_id),
+      std::move(options)));
 }
 }  // namespace
 
@@ -29,6 +29,7 @@
 #include "google/cloud/pubsub/subscriber.h"
 #include "gtest/gtest.h"
 #include "public/data_loading/filename_utils.h"
+#include "public/data_loading/readers/realtime_envelope.h"
 
 namespace kv_server {
 namespace {
@@ -41,6 +42,7 @@ using ::google::cloud::pubsub_mocks::MockAckHandler;
 using ::google::cloud::pubsub_mocks::MockSubscriberConnection;
 using privacy_sandbox::server_common::GetTracer;
 using testing::_;
+using testing::ElementsAre;
 using testing::Field;
 using testing::Return;
 
@@ -83,11 +85,12 @@ TEST_F(RealtimeNotifierGcpTest, ConsecutiveStartsWork) {
       .gcp_subscriber_for_unit_testing = subscriber.release(),
   };
   auto maybe_notifier = RealtimeNotifier::Create({}, std::move(options));
-  absl::Status status = (*maybe_notifier)->Start([](const std::string&) {
-    return absl::OkStatus();
-  });
+  absl::Status status =
+      (*maybe_notifier)->Start([](absl::Span<const std::string>) {
+        return absl::OkStatus();
+      });
   ASSERT_TRUE(status.ok());
-  status = (*maybe_notifier)->Start([](const std::string&) {
+  status = (*maybe_notifier)->Start([](absl::Span<const std::string>) {
     return absl::OkStatus();
   });
   ASSERT_FALSE(status.ok());
@@ -107,9 +110,10 @@ TEST_F(RealtimeNotifierGcpTest, StartsAndStops) {
   };
 
   auto maybe_notifier = RealtimeNotifier::Create({}, std::move(options));
-  absl::Status status = (*maybe_notifier)->Start([](const std::string&) {
-    return absl::OkStatus();
-  });
+  absl::Status status =
+      (*maybe_notifier)->Start([](absl::Span<const std::string>) {
+        return absl::OkStatus();
+      });
   ASSERT_TRUE(status.ok());
   EXPECT_TRUE((*maybe_notifier)->IsRunning());
   status = (*maybe_notifier)->Stop();
@@ -141,17 +145,17 @@ TEST_F(RealtimeNotifierGcpTest, NotifiesWithHighPriorityUpdates) {
 
   absl::Notification finished;
   testing::MockFunction<absl::StatusOr<DataLoadingStats>(
-      const std::string& record)>
+      absl::Span<const std::string> records)>
       callback;
   // will match the above
   EXPECT_CALL(callback, Call)
       .Times(2)
-      .WillOnce([&](const std::string& key) {
-        EXPECT_EQ(key, high_priority_update_1);
+      .WillOnce([&](absl::Span<const std::string> keys) {
+        EXPECT_THAT(keys, ElementsAre(high_priority_update_1));
         return DataLoadingStats{};
       })
-      .WillOnce([&](const std::string& key) {
-        EXPECT_EQ(key, high_priority_update_2);
+      .WillOnce([&](absl::Span<const std::string> keys) {
+        EXPECT_THAT(keys, ElementsAre(high_priority_update_2));
         finished.Notify();
         return DataLoadingStats{};
       });
@@ -172,5 +176,40 @@ TEST_F(RealtimeNotifierGcpTest, NotifiesWithHighPriorityUpdates) {
   EXPECT_FALSE((*maybe_notifier)->IsRunning());
 }
 
+TEST_F(RealtimeNotifierGcpTest, PassesRawEnvelopesOnUndecoded) {
+  const std::vector<std::string_view> records = {"record1", "record2"};
+  const std::string envelope = EncodeRealtimeEnvelope(records);
+  EXPECT_CALL(*mock_, options);
+  EXPECT_CALL(*mock_, Subscribe)
+      .WillOnce([&](SubscriberConnection::SubscribeParams const& p) {
+        auto ack = std::make_unique<MockAckHandler>();
+        EXPECT_CALL(*ack, ack()).Times(1);
+        p.callback(MessageBuilder{}.SetData(envelope).Build(),
+                   AckHandler(std::move(ack)));
+        return make_ready_future(google::cloud::Status{});
+      });
+
+  absl::Notification finished;
+  testing::MockFunction<absl::StatusOr<DataLoadingStats>(
+      absl::Span<const std::string> records)>
+      callback;
+  EXPECT_CALL(callback, Call)
+      .WillOnce([&](absl::Span<const std::string> updates) {
+        EXPECT_THAT(updates, ElementsAre(envelope));
+        finished.Notify();
+        return DataLoadingStats{};
+      });
+  auto subscriber = std::make_unique<Subscriber>(Subscriber(mock_));
+  GcpRealtimeNotifierMetadata options = {
+      .gcp_subscriber_for_unit_testing = subscriber.release(),
+      .maybe_sleep_for = std::move(mock_sleep_for_),
+  };
+  auto maybe_notifier = RealtimeNotifier::Create({}, std::move(options));
+  ASSERT_TRUE(maybe_notifier.ok());
+  ASSERT_TRUE((*maybe_notifier)->Start(callback.AsStdFunction()).ok());
+  finished.WaitForNotification();
+  ASSERT_TRUE((*maybe_notifier)->Stop().ok());
+}
+
 }  // namespace
 }  // namespace kv_server
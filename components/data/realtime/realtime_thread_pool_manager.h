@@ -38,9 +38,7 @@ class RealtimeThreadPoolManager {
  public:
   virtual ~RealtimeThreadPoolManager() = default;
   // Start realtime notifiers
-  virtual absl::Status Start(
-      std::function<absl::StatusOr<DataLoadingStats>(const std::string& key)>
-          callback) = 0;
+  virtual absl::Status Start(RealtimeUpdatesCallback callback) = 0;
   // Stop realtime notifiers
   virtual absl::Status Stop() = 0;
   // Create a realtime thread pool manager that will use the specified
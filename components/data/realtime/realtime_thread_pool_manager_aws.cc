@@ -30,9 +30,7 @@ class RealtimeThreadPoolManagerAws : public RealtimeThreadPoolManager {
 
   ~RealtimeThreadPoolManagerAws() override { Stop(); }
 
-  absl::Status Start(
-      std::function<absl::StatusOr<DataLoadingStats>(const std::string& key)>
-          callback) override {
+  absl::Status Start(RealtimeUpdatesCallback callback) override {
     for (auto& realtime_notifier : realtime_notifiers_) {
       if (realtime_notifier == nullptr) {
         std::string error_message =
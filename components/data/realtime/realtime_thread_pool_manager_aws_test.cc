@@ -77,9 +77,10 @@ TEST_F(RealtimeThreadPoolNotifierAwsTest, SuccesfullyStartsAndStops) {
   auto maybe_pool_manager = RealtimeThreadPoolManager::Create(
       metadata, thread_number_, std::move(test_metadata));
   ASSERT_TRUE(maybe_pool_manager.ok());
-  absl::Status status = (*maybe_pool_manager)->Start([](const std::string&) {
-    return absl::OkStatus();
-  });
+  absl::Status status =
+      (*maybe_pool_manager)->Start([](absl::Span<const std::string>) {
+        return absl::OkStatus();
+      });
   ASSERT_TRUE(status.ok());
   status = (*maybe_pool_manager)->Stop();
   ASSERT_TRUE(status.ok());
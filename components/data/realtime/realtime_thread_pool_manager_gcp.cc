@@ -30,9 +30,7 @@ class RealtimeThreadPoolManagerGCP : public RealtimeThreadPoolManager {
       : realtime_notifier_(std::move(realtime_notifier)) {}
   ~RealtimeThreadPoolManagerGCP() override { Stop(); }
 
-  absl::Status Start(
-      std::function<absl::StatusOr<DataLoadingStats>(const std::string& key)>
-          callback) override {
+  absl::Status Start(RealtimeUpdatesCallback callback) override {
     return realtime_notifier_->Start(std::move(callback));
   }
 
@@ -85,9 +85,10 @@ TEST_F(RealtimeThreadPoolNotifierGcpTest, SuccessfullyStartsAndStops) {
   NotifierMetadata metadata = GcpNotifierMetadata{};
   auto maybe_pool_manager = RealtimeThreadPoolManager::Create(
       metadata, thread_number_, std::move(options));
-  absl::Status status = (*maybe_pool_manager)->Start([](const std::string&) {
-    return absl::OkStatus();
-  });
+  absl::Status status =
+      (*maybe_pool_manager)->Start([](absl::Span<const std::string>) {
+        return absl::OkStatus();
+      });
   ASSERT_TRUE(status.ok());
   status = (*maybe_pool_manager)->Stop();
   ASSERT_TRUE(status.ok());
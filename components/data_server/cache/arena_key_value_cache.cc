@@ -0,0 +1,267 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/data_server/cache/arena_key_value_cache.h"
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "absl/log/log.h"
+#include "absl/memory/memory.h"
+#include "absl/synchronization/mutex.h"
+#include "components/data_server/cache/key_value_cache.h"
+
+namespace kv_server {
+
+ArenaKeyValueCache::ArenaKeyValueCache(uint32_t slab_size,
+                                       HugePageMode huge_pages)
+    : slab_size_(slab_size),
+      huge_pages_(huge_pages),
+      arena_(std::make_unique<SlabArena>(slab_size, huge_pages)),
+      map_(KeyValueMap::allocator_type(huge_pages)),
+      set_cache_(KeyValueCache::Create()) {}
+
+absl::flat_hash_map<std::string, std::string>
+ArenaKeyValueCache::GetKeyValuePairs(
+    const RequestContext& request_context,
+    const absl::flat_hash_set<std::string_view>& key_set) const {
+  ScopeLatencyMetricsRecorder<InternalLookupMetricsContext,
+                              kGetValuePairsLatencyInMicros>
+      latency_recorder(request_context.GetInternalLookupMetricsContext());
+  absl::flat_hash_map<std::string, std::string> kv_pairs;
+  {
+    absl::ReaderMutexLock lock(&mutex_);
+    for (std::string_view key : key_set) {
+      const auto key_iter = map_.find(key);
+      if (key_iter == map_.end() || key_iter->second.is_deleted) {
+        continue;
+      }
+      std::string_view value = arena_->Get(key_iter->second.value);
+      VLOG(9) << "Get called for " << key << ". returning value: " << value;
+      kv_pairs.insert_or_assign(key, value);
+    }
+  }
+  if (kv_pairs.empty()) {
+    LogCacheAccessMetrics(request_context, kKeyValueCacheMiss);
+  } else {
+    LogCacheAccessMetrics(request_context, kKeyValueCacheHit);
+  }
+  return kv_pairs;
+}
+
+std::unique_ptr<GetKeyValueSetResult> ArenaKeyValueCache::GetKeyValueSet(
+    const RequestContext& request_context,
+    const absl::flat_hash_set<std::string_view>& key_set) const {
+  return set_cache_->GetKeyValueSet(request_context, key_set);
+}
+
+void ArenaKeyValueCache::UpdateKeyValue(std::string_view key,
+                                        std::string_view value,
+                                        int64_t logical_commit_time,
+                                        std::string_view prefix) {
+  SampledScopeLatencyMetricsRecorder<kUpdateKeyValueLatency> latency_recorder;
+  VLOG(9) << "Received update for [" << key << "] at " << logical_commit_time
+          << ". value will be set to: " << value;
+  absl::MutexLock lock(&mutex_);
+
+  auto max_cleanup_logical_commit_time =
+      max_cleanup_logical_commit_time_map_[prefix];
+  if (logical_commit_time <= max_cleanup_logical_commit_time) {
+    VLOG(1) << "Skipping the update as its logical_commit_time: "
+            << logical_commit_time
+            << " is not newer than the current cutoff time:"
+            << max_cleanup_logical_commit_time;
+    return;
+  }
+
+  const auto key_iter = map_.find(key);
+  if (key_iter == map_.end()) {
+    const SlabArena::Handle key_handle = arena_->Allocate(key);
+    map_.emplace(arena_->Get(key_handle),
+                 CacheValue{.key = key_handle,
+                            .value = arena_->Allocate(value),
+                            .last_logical_commit_time = logical_commit_time,
+                            .is_deleted = false});
+    return;
+  }
+
+  CacheValue& cache_value = key_iter->second;
+  if (cache_value.last_logical_commit_time >= logical_commit_time) {
+    VLOG(1) << "Skipping the update as its logical_commit_time: "
+            << logical_commit_time
+            << " is not newer than the current value's time:"
+            << cache_value.last_logical_commit_time;
+    return;
+  }
+  if (cache_value.is_deleted) {
+    if (auto prefix_deleted_nodes_iter = deleted_nodes_map_.find(prefix);
+        prefix_deleted_nodes_iter != deleted_nodes_map_.end()) {
+      auto dl_key_iter = prefix_deleted_nodes_iter->second.find(
+          cache_value.last_logical_commit_time);
+      if (dl_key_iter != prefix_deleted_nodes_iter->second.end() &&
+          dl_key_iter->second == key) {
+        prefix_deleted_nodes_iter->second.erase(dl_key_iter);
+      }
+    }
+  }
+  arena_->Free(cache_value.value);
+  cache_value.value = arena_->Allocate(value);
+  cache_value.last_logical_commit_time = logical_commit_time;
+  cache_value.is_deleted = false;
+}
+
+void ArenaKeyValueCache::UpdateKeyValueSet(
+    std::string_view key, absl::Span<std::string_view> input_value_set,
+    int64_t logical_commit_time, std::string_view prefix) {
+  set_cache_->UpdateKeyValueSet(key, input_value_set, logical_commit_time,
+                                prefix);
+}
+
+void ArenaKeyValueCache::DeleteKey(std::string_view key,
+                                   int64_t logical_commit_time,
+                                   std::string_view prefix) {
+  SampledScopeLatencyMetricsRecorder<kDeleteKeyLatency> latency_recorder;
+  absl::MutexLock lock(&mutex_);
+  auto max_cleanup_logical_commit_time =
+      max_cleanup_logical_commit_time_map_[prefix];
+  if (logical_commit_time <= max_cleanup_logical_commit_time) {
+    return;
+  }
+  const auto key_iter = map_.find(key);
+  if (key_iter == map_.end()) {
+    // If key is missing, we still need to add a tombstone to avoid the late
+    // coming update with smaller logical commit time inserting value for the
+    // given key
+    const SlabArena::Handle key_handle = arena_->Allocate(key);
+    map_.emplace(arena_->Get(key_handle),
+                 CacheValue{.key = key_handle,
+                            .value = {},
+                            .last_logical_commit_time = logical_commit_time,
+                            .is_deleted = true});
+  } else if (key_iter->second.last_logical_commit_time < logical_commit_time) {
+    CacheValue& cache_value = key_iter->second;
+    arena_->Free(cache_value.value);
+    cache_value.value = {};
+    cache_value.last_logical_commit_time = logical_commit_time;
+    cache_value.is_deleted = true;
+  } else {
+    return;
+  }
+  deleted_nodes_map_[prefix].emplace(logical_commit_time, key);
+}
+
+void ArenaKeyValueCache::DeleteValuesInSet(
+    std::string_view key, absl::Span<std::string_view> value_set,
+    int64_t logical_commit_time, std::string_view prefix) {
+  set_cache_->DeleteValuesInSet(key, value_set, logical_commit_time, prefix);
+}
+
+void ArenaKeyValueCache::RemoveDeletedKeys(int64_t logical_commit_time,
+                                           std::string_view prefix) {
+  ScopeLatencyMetricsRecorder<ServerSafeMetricsContext,
+                              kRemoveDeletedKeyLatency>
+      latency_recorder(KVServerContextMap()->SafeMetric());
+  CleanUpKeyValueMap(logical_commit_time, prefix);
+  set_cache_->RemoveDeletedKeys(logical_commit_time, prefix);
+}
+
+void ArenaKeyValueCache::CleanUpKeyValueMap(int64_t logical_commit_time,
+                                            std::string_view prefix) {
+  ScopeLatencyMetricsRecorder<ServerSafeMetricsContext,
+                              kCleanUpKeyValueMapLatency>
+      latency_recorder(KVServerContextMap()->SafeMetric());
+  absl::MutexLock lock(&mutex_);
+  if (max_cleanup_logical_commit_time_map_[prefix] < logical_commit_time) {
+    max_cleanup_logical_commit_time_map_[prefix] = logical_commit_time;
+  }
+  if (auto deleted_nodes_per_prefix = deleted_nodes_map_.find(prefix);
+      deleted_nodes_per_prefix != deleted_nodes_map_.end()) {
+    auto it = deleted_nodes_per_prefix->second.begin();
+    while (it != deleted_nodes_per_prefix->second.end() &&
+           it->first <= logical_commit_time) {
+      // should always have this, but checking just in case
+      auto key_iter = map_.find(it->second);
+      if (key_iter != map_.end() && key_iter->second.is_deleted &&
+          key_iter->second.last_logical_commit_time <= logical_commit_time) {
+        const CacheValue cache_value = key_iter->second;
+        // The map key points into the arena, so it has to go first.
+        map_.erase(key_iter);
+        arena_->Free(cache_value.key);
+        arena_->Free(cache_value.value);
+      }
+      ++it;
+    }
+    deleted_nodes_per_prefix->second.erase(
+        deleted_nodes_per_prefix->second.begin(), it);
+    if (deleted_nodes_per_prefix->second.empty()) {
+      deleted_nodes_map_.erase(prefix);
+    }
+  }
+  MaybeCompactLocked();
+  LogSlabFragmentationLocked();
+}
+
+void ArenaKeyValueCache::MaybeCompactLocked() {
+  // Compacting a single partly used slab would not release anything.
+  if (arena_->used_bytes() <= slab_size_ ||
+      arena_->dead_bytes() * 2 <= arena_->used_bytes()) {
+    return;
+  }
+  VLOG(1) << "Compacting cache arena with " << arena_->dead_bytes()
+          << " dead bytes out of " << arena_->used_bytes();
+  auto new_arena = std::make_unique<SlabArena>(slab_size_, huge_pages_);
+  KeyValueMap new_map(map_.get_allocator());
+  new_map.reserve(map_.size());
+  for (const auto& [key, cache_value] : map_) {
+    const SlabArena::Handle key_handle = new_arena->Allocate(key);
+    new_map.emplace(
+        new_arena->Get(key_handle),
+        CacheValue{
+            .key = key_handle,
+            .value = new_arena->Allocate(arena_->Get(cache_value.value)),
+            .last_logical_commit_time = cache_value.last_logical_commit_time,
+            .is_deleted = cache_value.is_deleted});
+  }
+  map_ = std::move(new_map);
+  arena_ = std::move(new_arena);
+}
+
+void ArenaKeyValueCache::LogSlabFragmentationLocked() const {
+  for (const SlabArena::SlabStats& stats : arena_->GetSlabStats()) {
+    if (stats.used_bytes == 0) {
+      continue;
+    }
+    LogIfError(KVServerContextMap()
+                   ->SafeMetric()
+                   .LogHistogram<kCacheSlabFragmentationPercent>(
+                       100.0 * stats.dead_bytes / stats.used_bytes));
+  }
+}
+
+void ArenaKeyValueCache::LogCacheAccessMetrics(
+    const RequestContext& request_context,
+    std::string_view cache_access_event) const {
+  LogIfError(
+      request_context.GetInternalLookupMetricsContext()
+          .AccumulateMetric<kCacheAccessEventCount>(1, cache_access_event));
+}
+
+std::unique_ptr<Cache> ArenaKeyValueCache::Create(uint32_t slab_size,
+                                                  HugePageMode huge_pages) {
+  return absl::WrapUnique(new ArenaKeyValueCache(slab_size, huge_pages));
+}
+
+}  // namespace kv_server
@@ -0,0 +1,140 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_CACHE_ARENA_KEY_VALUE_CACHE_H_
+#define COMPONENTS_DATA_SERVER_CACHE_ARENA_KEY_VALUE_CACHE_H_
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/hash/hash.h"
+#include "absl/synchronization/mutex.h"
+#include "components/data_server/cache/cache.h"
+#include "components/data_server/cache/get_key_value_set_result.h"
+#include "components/data_server/cache/huge_pages.h"
+#include "components/data_server/cache/slab_arena.h"
+
+namespace kv_server {
+
+// In-memory datastore that keeps the bytes of keys and values in a
+// `SlabArena` instead of individually allocated strings.
+//
+// Map entries only hold arena handles, so an update costs no heap allocation
+// besides the occasional new slab. Slabs are released in bulk once cleanup has
+// dropped every tombstone in them, and the arena is compacted when too much of
+// it is dead. The slabs and the slots of the key-value map can be backed by
+// huge pages, which saves TLB misses on large caches.
+//
+// Key-value sets are kept in a `KeyValueCache`.
+// One cache object is only for keys in one namespace.
+class ArenaKeyValueCache : public Cache {
+ public:
+  // Looks up and returns key-value pairs for the given keys.
+  absl::flat_hash_map<std::string, std::string> GetKeyValuePairs(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override;
+
+  // Looks up and returns key-value set result for the given key set.
+  std::unique_ptr<GetKeyValueSetResult> GetKeyValueSet(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override;
+
+  // Inserts or updates the key with the new value for a given prefix
+  void UpdateKeyValue(std::string_view key, std::string_view value,
+                      int64_t logical_commit_time,
+                      std::string_view prefix = "") override;
+
+  // Inserts or updates values in the set for a given key and prefix, if a value
+  // exists, updates its timestamp to the latest logical commit time.
+  void UpdateKeyValueSet(std::string_view key,
+                         absl::Span<std::string_view> input_value_set,
+                         int64_t logical_commit_time,
+                         std::string_view prefix = "") override;
+
+  // Deletes a particular (key, value) pair for a given prefix.
+  void DeleteKey(std::string_view key, int64_t logical_commit_time,
+                 std::string_view prefix = "") override;
+
+  // Deletes values in the set for a given key and prefix.
+  void DeleteValuesInSet(std::string_view key,
+                         absl::Span<std::string_view> value_set,
+                         int64_t logical_commit_time,
+                         std::string_view prefix = "") override;
+
+  // Removes the values that were deleted before the specified
+  // logical_commit_time for a given prefix, and reports the fragmentation of
+  // the storage slabs.
+  void RemoveDeletedKeys(int64_t logical_commit_time,
+                         std::string_view prefix = "") override;
+
+  static std::unique_ptr<Cache> Create(
+      uint32_t slab_size = SlabArena::kDefaultSlabSize,
+      HugePageMode huge_pages = HugePageMode::kNone);
+
+ private:
+  struct CacheValue {
+    SlabArena::Handle key;
+    SlabArena::Handle value;
+    int64_t last_logical_commit_time;
+    // Deleted keys are kept until cleanup, see `KeyValueCache::CacheValue`.
+    bool is_deleted;
+  };
+
+  using KeyValueMap = absl::flat_hash_map<
+      std::string_view, CacheValue, absl::Hash<std::string_view>,
+      std::equal_to<std::string_view>,
+      HugePageAllocator<std::pair<const std::string_view, CacheValue>>>;
+
+  ArenaKeyValueCache(uint32_t slab_size, HugePageMode huge_pages);
+
+  // Removes deleted keys from key-value map for a given prefix
+  void CleanUpKeyValueMap(int64_t logical_commit_time, std::string_view prefix);
+  // Copies the live entries into a fresh arena if more than half of the
+  // current one is dead.
+  void MaybeCompactLocked() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void LogSlabFragmentationLocked() const ABSL_SHARED_LOCKS_REQUIRED(mutex_);
+  // Logs cache access metrics for cache hit or miss counts. The cache access
+  // event name is defined in server_definition.h file
+  void LogCacheAccessMetrics(const RequestContext& request_context,
+                             std::string_view cache_access_event) const;
+
+  const uint32_t slab_size_;
+  const HugePageMode huge_pages_;
+  mutable absl::Mutex mutex_;
+  std::unique_ptr<SlabArena> arena_ ABSL_GUARDED_BY(mutex_);
+  // The keys point into `arena_`.
+  KeyValueMap map_ ABSL_GUARDED_BY(mutex_);
+  // Same bookkeeping as `KeyValueCache::deleted_nodes_map_`.
+  absl::flat_hash_map<std::string, std::multimap<int64_t, std::string>>
+      deleted_nodes_map_ ABSL_GUARDED_BY(mutex_);
+  // The key is the prefix and the value is the
+  // maximum timestamp that was passed to RemoveDeletedKeys.
+  absl::flat_hash_map<std::string, int64_t> max_cleanup_logical_commit_time_map_
+      ABSL_GUARDED_BY(mutex_);
+
+  // Holds the key-value sets.
+  std::unique_ptr<Cache> set_cache_;
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_CACHE_ARENA_KEY_VALUE_CACHE_H_
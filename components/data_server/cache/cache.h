@@ -17,6 +17,7 @@
 #ifndef COMPONENTS_DATA_SERVER_CACHE_CACHE_H_
 #define COMPONENTS_DATA_SERVER_CACHE_CACHE_H_
 
+#include <cstdint>
 #include <iostream>
 #include <memory>
 #include <string>
@@ -26,7 +27,14 @@
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
+#include "absl/functional/function_ref.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "components/data_server/cache/get_key_value_pairs_result.h"
 #include "components/data_server/cache/get_key_value_set_result.h"
+#include "components/util/hashed_key.h"
 #include "components/util/request_context.h"
 
 namespace kv_server {
@@ -35,6 +43,27 @@ namespace kv_server {
 // One cache object is only for keys in one namespace.
 class Cache {
  public:
+  // A change to one key, see `ApplyMutations`.
+  struct Mutation {
+    enum class Type {
+      kUpdateKeyValue,
+      kUpdateKeyValueSet,
+      kDeleteKey,
+      kDeleteValuesInSet,
+      kUpdateUInt32Set,
+      kDeleteValuesInUInt32Set,
+    };
+    Type type;
+    std::string_view key;
+    // Value of a `kUpdateKeyValue` mutation.
+    std::string_view value;
+    // Values of a `kUpdateKeyValueSet` or `kDeleteValuesInSet` mutation.
+    absl::Span<std::string_view> value_set;
+    int64_t logical_commit_time = 0;
+    // Values of a `kUpdateUInt32Set` or `kDeleteValuesInUInt32Set` mutation.
+    absl::Span<const uint32_t> uint32_value_set;
+  };
+
   virtual ~Cache() = default;
 
   // Looks up and returns key-value pairs for the given keys.
@@ -42,6 +71,54 @@ class Cache {
       const RequestContext& request_context,
       const absl::flat_hash_set<std::string_view>& key_list) const = 0;
 
+  // Looks up the given keys and returns views of their values, which stay
+  // valid for the lifetime of the result even if the keys are updated or
+  // deleted. `key_list` must outlive the result. Caches that can't pin their
+  // values return copies.
+  virtual GetKeyValuePairsResult GetKeyValuePairViews(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_list) const {
+    GetKeyValuePairsResult result;
+    for (auto& [key, value] : GetKeyValuePairs(request_context, key_list)) {
+      result.AddValue(*key_list.find(key), std::move(value));
+    }
+    return result;
+  }
+
+  // Same as `GetKeyValuePairViews`, for keys that were hashed once for the
+  // request, so that the cache looks them up without hashing them again.
+  // `keys` must not repeat a key. By default, the keys are looked up as a
+  // set.
+  virtual GetKeyValuePairsResult GetHashedKeyValuePairViews(
+      const RequestContext& request_context,
+      absl::Span<const HashedKey> keys) const {
+    absl::flat_hash_set<std::string_view> key_set;
+    key_set.reserve(keys.size());
+    for (const HashedKey& key : keys) {
+      key_set.insert(key.key);
+    }
+    return GetKeyValuePairViews(request_context, key_set);
+  }
+
+  // Returns, in order, up to `limit` keys that start with `key_prefix` and
+  // may have a value. Keys deleted recently may still be returned, so their
+  // values are to be looked up. Caches without an ordered index of the
+  // keys under `key_prefix` return an unimplemented error.
+  virtual absl::StatusOr<std::vector<std::string>> GetKeysByPrefix(
+      std::string_view key_prefix, int limit) const {
+    return absl::UnimplementedError("The cache has no index of key prefixes");
+  }
+
+  // Returns, in order, the keys of the key-value sets that `member` is a live
+  // member of. Deleted members may still be found until the deletion is
+  // applied. Caches without a reverse membership index of the sets return an
+  // unimplemented error.
+  virtual absl::StatusOr<std::vector<std::string>> GetSetsContaining(
+      std::string_view member) const {
+    return absl::UnimplementedError(
+        "The cache has no reverse membership index of key-value sets");
+  }
+
   // Looks up and returns key-value set result for the given key set.
   virtual std::unique_ptr<GetKeyValueSetResult> GetKeyValueSet(
       const RequestContext& request_context,
@@ -71,10 +148,152 @@ class Cache {
                                  int64_t logical_commit_time,
                                  std::string_view prefix = "") = 0;
 
+  // Same as `UpdateKeyValueSet` and `DeleteValuesInSet`, for a set of 32 bit
+  // unsigned integers. Caches without native integer sets store the members
+  // as decimal strings, which is also how lookups return them.
+  virtual void UpdateKeyValueUInt32Set(std::string_view key,
+                                       absl::Span<const uint32_t> value_set,
+                                       int64_t logical_commit_time,
+                                       std::string_view prefix = "") {
+    std::vector<std::string> strings = ToDecimalStrings(value_set);
+    std::vector<std::string_view> values(strings.begin(), strings.end());
+    UpdateKeyValueSet(key, absl::MakeSpan(values), logical_commit_time,
+                      prefix);
+  }
+  virtual void DeleteValuesInUInt32Set(std::string_view key,
+                                       absl::Span<const uint32_t> value_set,
+                                       int64_t logical_commit_time,
+                                       std::string_view prefix = "") {
+    std::vector<std::string> strings = ToDecimalStrings(value_set);
+    std::vector<std::string_view> values(strings.begin(), strings.end());
+    DeleteValuesInSet(key, absl::MakeSpan(values), logical_commit_time,
+                      prefix);
+  }
+
   // Removes the values that were deleted before the specified
   // logical_commit_time for a given prefix.
   virtual void RemoveDeletedKeys(int64_t logical_commit_time,
                                  std::string_view prefix = "") = 0;
+
+  // Applies `mutations` for a given prefix, in order, as if by the methods
+  // above. Caches override it to take their locks and record their metrics
+  // once for the whole batch.
+  virtual void ApplyMutations(absl::Span<const Mutation> mutations,
+                              std::string_view prefix = "") {
+    for (const Mutation& mutation : mutations) {
+      switch (mutation.type) {
+        case Mutation::Type::kUpdateKeyValue:
+          UpdateKeyValue(mutation.key, mutation.value,
+                         mutation.logical_commit_time, prefix);
+          break;
+        case Mutation::Type::kUpdateKeyValueSet:
+          UpdateKeyValueSet(mutation.key, mutation.value_set,
+                            mutation.logical_commit_time, prefix);
+          break;
+        case Mutation::Type::kDeleteKey:
+          DeleteKey(mutation.key, mutation.logical_commit_time, prefix);
+          break;
+        case Mutation::Type::kDeleteValuesInSet:
+          DeleteValuesInSet(mutation.key, mutation.value_set,
+                            mutation.logical_commit_time, prefix);
+          break;
+        case Mutation::Type::kUpdateUInt32Set:
+          UpdateKeyValueUInt32Set(mutation.key, mutation.uint32_value_set,
+                                  mutation.logical_commit_time, prefix);
+          break;
+        case Mutation::Type::kDeleteValuesInUInt32Set:
+          DeleteValuesInUInt32Set(mutation.key, mutation.uint32_value_set,
+                                  mutation.logical_commit_time, prefix);
+          break;
+      }
+    }
+  }
+
+  // Progress of `RemoveDeletedKeysSlice`.
+  struct CleanupProgress {
+    // Whether every value deleted up to the logical commit time is removed.
+    bool done = true;
+    // Number of deleted values still kept by the cache, for all prefixes.
+    int64_t remaining_deleted_values = 0;
+  };
+
+  // Like `RemoveDeletedKeys`, but stops once `deadline` has passed and
+  // releases its locks, so that lookups aren't blocked for the whole cleanup.
+  // Call it again with the same arguments until it is done. Caches that can't
+  // clean up incrementally remove everything at once.
+  virtual CleanupProgress RemoveDeletedKeysSlice(int64_t logical_commit_time,
+                                                 std::string_view prefix,
+                                                 absl::Time deadline) {
+    RemoveDeletedKeys(logical_commit_time, prefix);
+    return CleanupProgress();
+  }
+
+  // Calls `fn` with batches of mutations that recreate the key-value pairs,
+  // deleted keys included, and the live key-value set values of the cache,
+  // with the prefix of each batch. The mutations are only valid during the
+  // call. Mutations applied concurrently may or may not be exported. Caches
+  // that can't enumerate their contents return an unimplemented error.
+  virtual absl::Status ExportMutations(
+      absl::FunctionRef<void(std::string_view prefix,
+                             absl::Span<const Mutation> mutations)>
+          fn) const {
+    return absl::UnimplementedError("The cache can't export its contents");
+  }
+
+  // Estimated bytes used by the structures of a cache.
+  struct MemoryUsage {
+    // Keys of the key-value pairs, including deleted keys.
+    int64_t key_bytes = 0;
+    // Values of the key-value pairs, as stored, e.g. compressed.
+    int64_t value_bytes = 0;
+    // Keys of the key-value sets.
+    int64_t set_key_bytes = 0;
+    // Strings of the set members, live or deleted.
+    int64_t set_value_bytes = 0;
+    // Records of the deletions that are kept until they are cleaned up.
+    int64_t tombstone_bytes = 0;
+    // Slots and control bytes of the hash tables, key filters and key
+    // indexes.
+    int64_t hash_table_bytes = 0;
+
+    int64_t total_bytes() const {
+      return key_bytes + value_bytes + set_key_bytes + set_value_bytes +
+             tombstone_bytes + hash_table_bytes;
+    }
+    MemoryUsage& operator+=(const MemoryUsage& other) {
+      key_bytes += other.key_bytes;
+      value_bytes += other.value_bytes;
+      set_key_bytes += other.set_key_bytes;
+      set_value_bytes += other.set_value_bytes;
+      tombstone_bytes += other.tombstone_bytes;
+      hash_table_bytes += other.hash_table_bytes;
+      return *this;
+    }
+  };
+
+  // Returns the memory used by the cache, by prefix. The counters are
+  // maintained as the cache is updated, so this doesn't scan the cache.
+  // Caches that don't keep track of their memory return an empty map.
+  virtual absl::flat_hash_map<std::string, MemoryUsage> GetMemoryUsage()
+      const {
+    return {};
+  }
+
+  // Returns a human readable report of the memory used by the cache, with
+  // the `num_largest` largest key-value pairs and key-value sets. Scans the
+  // whole cache, for debugging only.
+  virtual std::string DebugMemoryReport(int num_largest) const { return ""; }
+
+ protected:
+  static std::vector<std::string> ToDecimalStrings(
+      absl::Span<const uint32_t> values) {
+    std::vector<std::string> strings;
+    strings.reserve(values.size());
+    for (const uint32_t value : values) {
+      strings.push_back(std::to_string(value));
+    }
+    return strings;
+  }
 };
 
 }  // namespace kv_server
@@ -0,0 +1,144 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data_server/cache/cache_mutex_lock.h"
+
+#include <atomic>
+#include <cstdint>
+
+#include "absl/time/clock.h"
+#include "components/telemetry/server_definition.h"
+
+namespace kv_server {
+namespace {
+
+std::atomic<bool> metrics_enabled = false;
+std::atomic<int64_t> long_hold_threshold_nanos =
+    absl::ToInt64Nanoseconds(CacheLockMetricsOptions().long_hold_threshold);
+
+void LogWait(CacheMutex mutex, absl::Duration wait) {
+  const double micros = absl::ToDoubleMicroseconds(wait);
+  auto& metrics = KVServerContextMap()->SafeMetric();
+  switch (mutex) {
+    case CacheMutex::kPartitionMap:
+      LogIfError(
+          metrics.LogHistogram<kCachePartitionMapLockWaitLatency>(micros));
+      break;
+    case CacheMutex::kPartition:
+      LogIfError(metrics.LogHistogram<kCachePartitionLockWaitLatency>(micros));
+      break;
+    case CacheMutex::kSetMap:
+      LogIfError(metrics.LogHistogram<kCacheSetMapLockWaitLatency>(micros));
+      break;
+    case CacheMutex::kValueSet:
+      LogIfError(metrics.LogHistogram<kCacheValueSetLockWaitLatency>(micros));
+      break;
+  }
+}
+
+void LogHold(CacheMutex mutex, CacheLockOperation operation,
+             absl::Duration hold) {
+  const double micros = absl::ToDoubleMicroseconds(hold);
+  auto& metrics = KVServerContextMap()->SafeMetric();
+  switch (mutex) {
+    case CacheMutex::kPartitionMap:
+      // Only held to add a partition, which the long hold count covers.
+      break;
+    case CacheMutex::kPartition:
+      LogIfError(metrics.LogHistogram<kCachePartitionLockHoldLatency>(micros));
+      break;
+    case CacheMutex::kSetMap:
+      LogIfError(metrics.LogHistogram<kCacheSetMapLockHoldLatency>(micros));
+      break;
+    case CacheMutex::kValueSet:
+      LogIfError(metrics.LogHistogram<kCacheValueSetLockHoldLatency>(micros));
+      break;
+  }
+  if (absl::ToInt64Nanoseconds(hold) > long_hold_threshold_nanos.load()) {
+    LogIfError(metrics.AccumulateMetric<kCacheLongLockHoldCount>(
+        1, CacheLongLockHoldPartition(mutex, operation)));
+  }
+}
+
+}  // namespace
+
+void SetCacheLockMetricsOptions(CacheLockMetricsOptions options) {
+  long_hold_threshold_nanos =
+      absl::ToInt64Nanoseconds(options.long_hold_threshold);
+  metrics_enabled = options.enabled;
+}
+
+std::string_view CacheLongLockHoldPartition(CacheMutex mutex,
+                                            CacheLockOperation operation) {
+  // Laid out as the mutexes and operations are declared.
+  return kCacheLongLockHolds[static_cast<int>(mutex) * 3 +
+                             static_cast<int>(operation)];
+}
+
+CacheMutexLock::CacheMutexLock(absl::Mutex* mu, CacheMutex mutex,
+                               CacheLockOperation operation)
+    : mu_(mu), mutex_(mutex), operation_(operation) {
+  if (!metrics_enabled.load(std::memory_order_relaxed)) {
+    mu_->Lock();
+    return;
+  }
+  // The clock is only read before locking if the mutex is contended.
+  if (mu_->TryLock()) {
+    acquired_ = absl::Now();
+    wait_ = absl::ZeroDuration();
+    return;
+  }
+  const absl::Time start = absl::Now();
+  mu_->Lock();
+  acquired_ = absl::Now();
+  wait_ = *acquired_ - start;
+}
+
+CacheMutexLock::~CacheMutexLock() {
+  if (!acquired_.has_value()) {
+    mu_->Unlock();
+    return;
+  }
+  // Logged once unlocked, so that logging doesn't hold the mutex.
+  const absl::Duration hold = absl::Now() - *acquired_;
+  mu_->Unlock();
+  LogWait(mutex_, *wait_);
+  LogHold(mutex_, operation_, hold);
+}
+
+CacheReaderMutexLock::CacheReaderMutexLock(absl::Mutex* mu, CacheMutex mutex)
+    : mu_(mu), mutex_(mutex) {
+  if (!metrics_enabled.load(std::memory_order_relaxed)) {
+    mu_->ReaderLock();
+    return;
+  }
+  if (mu_->ReaderTryLock()) {
+    wait_ = absl::ZeroDuration();
+    return;
+  }
+  const absl::Time start = absl::Now();
+  mu_->ReaderLock();
+  wait_ = absl::Now() - start;
+}
+
+CacheReaderMutexLock::~CacheReaderMutexLock() {
+  mu_->ReaderUnlock();
+  if (wait_.has_value()) {
+    LogWait(mutex_, *wait_);
+  }
+}
+
+}  // namespace kv_server
@@ -0,0 +1,98 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_CACHE_CACHE_MUTEX_LOCK_H_
+#define COMPONENTS_DATA_SERVER_CACHE_CACHE_MUTEX_LOCK_H_
+
+#include <optional>
+#include <string_view>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+
+namespace kv_server {
+
+// The mutexes of the key-value cache that contention is recorded for.
+enum class CacheMutex {
+  kPartitionMap,
+  kPartition,
+  kSetMap,
+  kValueSet,
+};
+
+// The operation that holds a cache mutex exclusively.
+enum class CacheLockOperation {
+  kUpdate,
+  kDelete,
+  kCleanup,
+};
+
+struct CacheLockMetricsOptions {
+  // Disabled, the locks below only lock their mutex.
+  bool enabled = false;
+  // Exclusive sections held longer are counted, by mutex and operation.
+  absl::Duration long_hold_threshold = absl::Milliseconds(1);
+};
+
+// Applies to the locks taken after the call, by every cache of the process.
+void SetCacheLockMetricsOptions(CacheLockMetricsOptions options);
+
+// Returns the partition of `kCacheLongLockHoldCount` of `mutex` held by
+// `operation`, e.g. "SetMap:Cleanup".
+std::string_view CacheLongLockHoldPartition(CacheMutex mutex,
+                                            CacheLockOperation operation);
+
+// Like `absl::MutexLock`, and records the time waited for `mu` and the time
+// it was held when cache lock metrics are enabled.
+class ABSL_SCOPED_LOCKABLE CacheMutexLock {
+ public:
+  CacheMutexLock(absl::Mutex* mu, CacheMutex mutex,
+                 CacheLockOperation operation) ABSL_EXCLUSIVE_LOCK_FUNCTION(mu);
+  CacheMutexLock(const CacheMutexLock&) = delete;
+  CacheMutexLock& operator=(const CacheMutexLock&) = delete;
+  ~CacheMutexLock() ABSL_UNLOCK_FUNCTION();
+
+ private:
+  absl::Mutex* const mu_;
+  const CacheMutex mutex_;
+  const CacheLockOperation operation_;
+  // Set when the metrics are enabled.
+  std::optional<absl::Time> acquired_;
+  std::optional<absl::Duration> wait_;
+};
+
+// Like `absl::ReaderMutexLock`, and records the time waited for `mu` when
+// cache lock metrics are enabled. Shared sections are short and many, so
+// their hold time isn't recorded.
+class ABSL_SCOPED_LOCKABLE CacheReaderMutexLock {
+ public:
+  CacheReaderMutexLock(absl::Mutex* mu, CacheMutex mutex)
+      ABSL_SHARED_LOCK_FUNCTION(mu);
+  CacheReaderMutexLock(const CacheReaderMutexLock&) = delete;
+  CacheReaderMutexLock& operator=(const CacheReaderMutexLock&) = delete;
+  ~CacheReaderMutexLock() ABSL_UNLOCK_FUNCTION();
+
+ private:
+  absl::Mutex* const mu_;
+  const CacheMutex mutex_;
+  // Set when the metrics are enabled.
+  std::optional<absl::Duration> wait_;
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_CACHE_CACHE_MUTEX_LOCK_H_
@@ -0,0 +1,94 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data_server/cache/cache_mutex_lock.h"
+
+#include <thread>
+
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
+#include "components/telemetry/server_definition.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+class CacheMutexLockTest : public ::testing::Test {
+ protected:
+  CacheMutexLockTest() { InitMetricsContextMap(); }
+  ~CacheMutexLockTest() override { SetCacheLockMetricsOptions({}); }
+};
+
+TEST_F(CacheMutexLockTest, NamesLongHoldPartitions) {
+  EXPECT_EQ(CacheLongLockHoldPartition(CacheMutex::kPartitionMap,
+                                       CacheLockOperation::kUpdate),
+            "PartitionMap:Update");
+  EXPECT_EQ(CacheLongLockHoldPartition(CacheMutex::kPartition,
+                                       CacheLockOperation::kDelete),
+            "Partition:Delete");
+  EXPECT_EQ(CacheLongLockHoldPartition(CacheMutex::kSetMap,
+                                       CacheLockOperation::kCleanup),
+            "SetMap:Cleanup");
+  EXPECT_EQ(CacheLongLockHoldPartition(CacheMutex::kValueSet,
+                                       CacheLockOperation::kCleanup),
+            "ValueSet:Cleanup");
+}
+
+TEST_F(CacheMutexLockTest, LocksWithMetricsDisabled) {
+  absl::Mutex mu;
+  {
+    CacheMutexLock lock(&mu, CacheMutex::kPartition,
+                        CacheLockOperation::kUpdate);
+    mu.AssertHeld();
+  }
+  {
+    CacheReaderMutexLock lock(&mu, CacheMutex::kPartition);
+    mu.AssertReaderHeld();
+  }
+  EXPECT_TRUE(mu.TryLock());
+  mu.Unlock();
+}
+
+TEST_F(CacheMutexLockTest, ContendedLocksWaitWithMetricsEnabled) {
+  SetCacheLockMetricsOptions(
+      {.enabled = true, .long_hold_threshold = absl::ZeroDuration()});
+  absl::Mutex mu;
+  absl::Notification writer_locked;
+  bool written = false;
+  std::thread writer([&] {
+    CacheMutexLock lock(&mu, CacheMutex::kSetMap,
+                        CacheLockOperation::kCleanup);
+    writer_locked.Notify();
+    absl::SleepFor(absl::Milliseconds(10));
+    written = true;
+  });
+  writer_locked.WaitForNotification();
+  {
+    CacheReaderMutexLock lock(&mu, CacheMutex::kSetMap);
+    EXPECT_TRUE(written);
+  }
+  {
+    CacheMutexLock lock(&mu, CacheMutex::kValueSet,
+                        CacheLockOperation::kUpdate);
+    mu.AssertHeld();
+  }
+  writer.join();
+  EXPECT_TRUE(mu.TryLock());
+  mu.Unlock();
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -0,0 +1,219 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/data_server/cache/cold_tier_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+
+namespace kv_server {
+namespace {
+
+constexpr std::string_view kMagic = "KVCOLD01";
+
+template <typename T>
+T ReadInteger(const char* data) {
+  T value;
+  std::memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+template <typename T>
+void WriteInteger(std::ofstream& stream, T value) {
+  stream.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+}  // namespace
+
+ColdTierFile::Writer::Writer(std::string path)
+    : path_(std::move(path)),
+      temporary_path_(absl::StrCat(path_, ".tmp")),
+      stream_(temporary_path_, std::ios::binary | std::ios::trunc) {}
+
+absl::StatusOr<std::unique_ptr<ColdTierFile::Writer>>
+ColdTierFile::Writer::Create(std::string path) {
+  auto writer = absl::WrapUnique(new Writer(std::move(path)));
+  if (!writer->stream_) {
+    return absl::InternalError(
+        absl::StrCat("Failed to create ", writer->temporary_path_));
+  }
+  writer->stream_.write(kMagic.data(), kMagic.size());
+  // The number of entries is filled in by `Finish`.
+  WriteInteger<uint64_t>(writer->stream_, 0);
+  return writer;
+}
+
+bool ColdTierFile::Writer::Add(std::string_view key, std::string_view value,
+                               int64_t logical_commit_time) {
+  if (num_entries_ > 0 && key <= last_key_) {
+    return false;
+  }
+  if (key.size() > std::numeric_limits<uint32_t>::max() ||
+      value.size() > std::numeric_limits<uint32_t>::max()) {
+    return false;
+  }
+  WriteInteger<uint32_t>(stream_, key.size());
+  WriteInteger<uint32_t>(stream_, value.size());
+  WriteInteger<int64_t>(stream_, logical_commit_time);
+  stream_.write(key.data(), key.size());
+  stream_.write(value.data(), value.size());
+  last_key_ = key;
+  ++num_entries_;
+  return true;
+}
+
+absl::Status ColdTierFile::Writer::Finish() {
+  stream_.seekp(kMagic.size());
+  WriteInteger<uint64_t>(stream_, num_entries_);
+  stream_.close();
+  if (!stream_) {
+    return absl::InternalError(
+        absl::StrCat("Failed to write ", temporary_path_));
+  }
+  if (std::rename(temporary_path_.c_str(), path_.c_str()) != 0) {
+    return absl::InternalError(absl::StrCat("Failed to rename ",
+                                            temporary_path_, " to ", path_,
+                                            ": ", std::strerror(errno)));
+  }
+  return absl::OkStatus();
+}
+
+ColdTierFile::ColdTierFile(const char* data, uint64_t size)
+    : data_(data), size_(size) {}
+
+ColdTierFile::~ColdTierFile() {
+  munmap(const_cast<char*>(data_), size_);
+}
+
+absl::StatusOr<std::unique_ptr<ColdTierFile>> ColdTierFile::Open(
+    const std::string& path) {
+  const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return absl::NotFoundError(
+        absl::StrCat("Failed to open ", path, ": ", std::strerror(errno)));
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 ||
+      static_cast<uint64_t>(file_stat.st_size) < kHeaderSize) {
+    close(fd);
+    return absl::InvalidArgumentError(
+        absl::StrCat(path, " is not a cold tier file"));
+  }
+  void* data =
+      mmap(nullptr, file_stat.st_size, PROT_READ, MAP_SHARED, fd, /*offset=*/0);
+  // The mapping stays valid after the descriptor is closed.
+  close(fd);
+  if (data == MAP_FAILED) {
+    return absl::InternalError(
+        absl::StrCat("Failed to map ", path, ": ", std::strerror(errno)));
+  }
+  // Lookups read a few entries each, read ahead would mostly load pages that
+  // aren't needed.
+  madvise(data, file_stat.st_size, MADV_RANDOM);
+  auto file = absl::WrapUnique(
+      new ColdTierFile(static_cast<const char*>(data), file_stat.st_size));
+  if (const auto status = file->BuildIndex(); !status.ok()) {
+    return absl::InvalidArgumentError(
+        absl::StrCat(path, " is not a cold tier file: ", status.message()));
+  }
+  return file;
+}
+
+absl::Status ColdTierFile::BuildIndex() {
+  if (std::string_view(data_, kMagic.size()) != kMagic) {
+    return absl::InvalidArgumentError("Wrong magic");
+  }
+  const auto num_entries = ReadInteger<uint64_t>(data_ + kMagic.size());
+  uint64_t offset = kHeaderSize;
+  for (; num_entries_ < num_entries; ++num_entries_) {
+    if (size_ - offset < kEntryHeaderSize) {
+      return absl::InvalidArgumentError("Truncated entry");
+    }
+    const uint64_t entry_size =
+        kEntryHeaderSize + uint64_t{ReadInteger<uint32_t>(data_ + offset)} +
+        ReadInteger<uint32_t>(data_ + offset + sizeof(uint32_t));
+    if (size_ - offset < entry_size) {
+      return absl::InvalidArgumentError("Truncated entry");
+    }
+    if (num_entries_ % kIndexInterval == 0) {
+      index_.push_back({std::string(ReadEntry(offset).key), offset});
+    }
+    offset += entry_size;
+  }
+  if (offset != size_) {
+    return absl::InvalidArgumentError("Unexpected data after the entries");
+  }
+  index_.shrink_to_fit();
+  return absl::OkStatus();
+}
+
+ColdTierFile::Entry ColdTierFile::ReadEntry(uint64_t offset) const {
+  const char* entry = data_ + offset;
+  const auto key_size = ReadInteger<uint32_t>(entry);
+  const auto value_size = ReadInteger<uint32_t>(entry + sizeof(uint32_t));
+  const char* key = entry + kEntryHeaderSize;
+  return Entry{
+      .key = std::string_view(key, key_size),
+      .value = std::string_view(key + key_size, value_size),
+      .logical_commit_time =
+          ReadInteger<int64_t>(entry + 2 * sizeof(uint32_t)),
+  };
+}
+
+std::optional<ColdTierFile::Entry> ColdTierFile::Find(
+    std::string_view key) const {
+  // The last indexed entry at or before `key`.
+  auto it = std::upper_bound(
+      index_.begin(), index_.end(), key,
+      [](std::string_view key, const IndexEntry& entry) {
+        return key < entry.key;
+      });
+  if (it == index_.begin()) {
+    return std::nullopt;
+  }
+  uint64_t offset = std::prev(it)->offset;
+  for (int i = 0; i < kIndexInterval && offset < size_; ++i) {
+    const Entry entry = ReadEntry(offset);
+    if (entry.key == key) {
+      return entry;
+    }
+    if (entry.key > key) {
+      break;
+    }
+    offset = EntryEnd(offset, entry);
+  }
+  return std::nullopt;
+}
+
+int64_t ColdTierFile::index_bytes() const {
+  int64_t bytes = index_.capacity() * sizeof(IndexEntry);
+  for (const IndexEntry& entry : index_) {
+    bytes += entry.key.capacity();
+  }
+  return bytes;
+}
+
+}  // namespace kv_server
@@ -0,0 +1,127 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_CACHE_COLD_TIER_FILE_H_
+#define COMPONENTS_DATA_SERVER_CACHE_COLD_TIER_FILE_H_
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+
+namespace kv_server {
+
+// Immutable file of key-value pairs sorted by key, memory-mapped for lookups.
+//
+// Entries are stored back to back after a header:
+//   key size (4 bytes), value size (4 bytes), logical commit time (8 bytes),
+//   key, value.
+// Only every `kIndexInterval`th key is kept in memory, with the offset of its
+// entry. A lookup binary searches that index and reads at most
+// `kIndexInterval` entries of the file, through the page cache.
+//
+// Thread safe.
+class ColdTierFile {
+ public:
+  static constexpr int kIndexInterval = 32;
+
+  struct Entry {
+    // Views into the mapped file.
+    std::string_view key;
+    std::string_view value;
+    int64_t logical_commit_time = 0;
+  };
+
+  // Writes a file, with the entries added in increasing key order.
+  class Writer {
+   public:
+    // Returns false if `key` isn't greater than the previous key.
+    bool Add(std::string_view key, std::string_view value,
+             int64_t logical_commit_time);
+    // Completes the file at the path passed to `Create`.
+    absl::Status Finish();
+
+    // The file is written to a temporary path until `Finish`, so that a
+    // file mapped at `path` stays valid.
+    static absl::StatusOr<std::unique_ptr<Writer>> Create(std::string path);
+
+   private:
+    explicit Writer(std::string path);
+
+    std::string path_;
+    std::string temporary_path_;
+    std::ofstream stream_;
+    std::string last_key_;
+    uint64_t num_entries_ = 0;
+  };
+
+  ~ColdTierFile();
+  ColdTierFile(const ColdTierFile&) = delete;
+  ColdTierFile& operator=(const ColdTierFile&) = delete;
+
+  std::optional<Entry> Find(std::string_view key) const;
+
+  // Calls `fn` with every entry, in increasing key order.
+  template <typename Fn>
+  void ForEach(Fn&& fn) const {
+    for (uint64_t offset = kHeaderSize; offset < size_;) {
+      const Entry entry = ReadEntry(offset);
+      fn(entry);
+      offset = EntryEnd(offset, entry);
+    }
+  }
+
+  uint64_t num_entries() const { return num_entries_; }
+  // Bytes held in memory by the index.
+  int64_t index_bytes() const;
+
+  // Maps the file at `path` and builds its index.
+  static absl::StatusOr<std::unique_ptr<ColdTierFile>> Open(
+      const std::string& path);
+
+ private:
+  static constexpr uint64_t kHeaderSize = 16;
+  static constexpr uint64_t kEntryHeaderSize = 16;
+
+  struct IndexEntry {
+    std::string key;
+    uint64_t offset;
+  };
+
+  ColdTierFile(const char* data, uint64_t size);
+
+  // Checks the entries and builds `index_`.
+  absl::Status BuildIndex();
+  Entry ReadEntry(uint64_t offset) const;
+  static uint64_t EntryEnd(uint64_t offset, const Entry& entry) {
+    return offset + kEntryHeaderSize + entry.key.size() + entry.value.size();
+  }
+
+  const char* data_;
+  uint64_t size_;
+  uint64_t num_entries_ = 0;
+  std::vector<IndexEntry> index_;
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_CACHE_COLD_TIER_FILE_H_
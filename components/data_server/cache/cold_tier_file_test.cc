@@ -0,0 +1,120 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/data_server/cache/cold_tier_file.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+using testing::Pair;
+
+std::string TestPath(std::string_view name) {
+  return absl::StrCat(testing::TempDir(), "/", name);
+}
+
+TEST(ColdTierFileTest, FindsEveryEntry) {
+  const std::string path = TestPath("find");
+  auto writer = ColdTierFile::Writer::Create(path);
+  ASSERT_TRUE(writer.ok()) << writer.status();
+  constexpr int kNumEntries = 10 * ColdTierFile::kIndexInterval + 3;
+  for (int i = 0; i < kNumEntries; ++i) {
+    ASSERT_TRUE((*writer)->Add(absl::StrCat("key", 1000 + i),
+                               absl::StrCat("value", i),
+                               /*logical_commit_time=*/i));
+  }
+  ASSERT_TRUE((*writer)->Finish().ok());
+
+  auto file = ColdTierFile::Open(path);
+  ASSERT_TRUE(file.ok()) << file.status();
+  EXPECT_EQ((*file)->num_entries(), kNumEntries);
+  for (int i = 0; i < kNumEntries; ++i) {
+    auto entry = (*file)->Find(absl::StrCat("key", 1000 + i));
+    ASSERT_TRUE(entry.has_value()) << i;
+    EXPECT_EQ(entry->value, absl::StrCat("value", i));
+    EXPECT_EQ(entry->logical_commit_time, i);
+  }
+  EXPECT_FALSE((*file)->Find("key").has_value());
+  EXPECT_FALSE((*file)->Find("key1000a").has_value());
+  EXPECT_FALSE((*file)->Find("zzz").has_value());
+  std::remove(path.c_str());
+}
+
+TEST(ColdTierFileTest, IteratesInKeyOrder) {
+  const std::string path = TestPath("iterate");
+  auto writer = ColdTierFile::Writer::Create(path);
+  ASSERT_TRUE(writer.ok()) << writer.status();
+  ASSERT_TRUE((*writer)->Add("a", "1", 1));
+  ASSERT_TRUE((*writer)->Add("b", "", 2));
+  EXPECT_FALSE((*writer)->Add("b", "3", 3));
+  EXPECT_FALSE((*writer)->Add("a", "3", 3));
+  ASSERT_TRUE((*writer)->Finish().ok());
+
+  auto file = ColdTierFile::Open(path);
+  ASSERT_TRUE(file.ok()) << file.status();
+  std::vector<std::pair<std::string, std::string>> entries;
+  (*file)->ForEach([&entries](const ColdTierFile::Entry& entry) {
+    entries.emplace_back(entry.key, entry.value);
+  });
+  EXPECT_THAT(entries, testing::ElementsAre(Pair("a", "1"), Pair("b", "")));
+  std::remove(path.c_str());
+}
+
+TEST(ColdTierFileTest, EmptyFile) {
+  const std::string path = TestPath("empty");
+  auto writer = ColdTierFile::Writer::Create(path);
+  ASSERT_TRUE(writer.ok()) << writer.status();
+  ASSERT_TRUE((*writer)->Finish().ok());
+
+  auto file = ColdTierFile::Open(path);
+  ASSERT_TRUE(file.ok()) << file.status();
+  EXPECT_EQ((*file)->num_entries(), 0);
+  EXPECT_FALSE((*file)->Find("a").has_value());
+  std::remove(path.c_str());
+}
+
+TEST(ColdTierFileTest, RejectsInvalidFiles) {
+  EXPECT_FALSE(ColdTierFile::Open(TestPath("missing")).ok());
+
+  const std::string path = TestPath("invalid");
+  std::ofstream(path) << "not a cold tier file";
+  EXPECT_FALSE(ColdTierFile::Open(path).ok());
+
+  auto writer = ColdTierFile::Writer::Create(path);
+  ASSERT_TRUE(writer.ok()) << writer.status();
+  ASSERT_TRUE((*writer)->Add("key", "value", 1));
+  ASSERT_TRUE((*writer)->Finish().ok());
+  std::string contents;
+  {
+    std::ifstream stream(path, std::ios::binary);
+    contents.assign(std::istreambuf_iterator<char>(stream), {});
+  }
+  std::ofstream(path, std::ios::binary | std::ios::trunc)
+      << contents.substr(0, contents.size() - 1);
+  EXPECT_FALSE(ColdTierFile::Open(path).ok());
+  std::remove(path.c_str());
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -0,0 +1,99 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/data_server/cache/compact_value.h"
+
+#include <cstring>
+#include <utility>
+
+namespace kv_server {
+
+CompactValue CompactValue::Deleted(int64_t logical_commit_time) {
+  CompactValue deleted(logical_commit_time);
+  deleted.flags_ = kDeleted;
+  return deleted;
+}
+
+CompactValue CompactValue::Create(std::string_view value,
+                                  int64_t logical_commit_time,
+                                  bool is_compressed) {
+  CompactValue compact_value(logical_commit_time);
+  if (is_compressed) {
+    compact_value.flags_ |= kCompressed;
+  }
+  if (value.size() <= kMaxInlineSize) {
+    std::memcpy(compact_value.storage_, value.data(), value.size());
+    compact_value.inline_size_ = value.size();
+  } else {
+    new (compact_value.storage_)
+        SharedString(std::make_shared<const std::string>(value));
+    compact_value.flags_ |= kShared;
+  }
+  return compact_value;
+}
+
+CompactValue::CompactValue(const CompactValue& other)
+    : inline_size_(other.inline_size_),
+      flags_(other.flags_),
+      last_logical_commit_time_(other.last_logical_commit_time_) {
+  if (other.is_inline()) {
+    std::memcpy(storage_, other.storage_, inline_size_);
+  } else {
+    new (storage_) SharedString(other.shared());
+  }
+}
+
+CompactValue::CompactValue(CompactValue&& other) noexcept
+    : inline_size_(other.inline_size_),
+      flags_(other.flags_),
+      last_logical_commit_time_(other.last_logical_commit_time_) {
+  if (other.is_inline()) {
+    std::memcpy(storage_, other.storage_, inline_size_);
+  } else {
+    new (storage_) SharedString(std::move(other.shared()));
+  }
+}
+
+CompactValue& CompactValue::operator=(const CompactValue& other) {
+  if (this != &other) {
+    *this = CompactValue(other);
+  }
+  return *this;
+}
+
+CompactValue& CompactValue::operator=(CompactValue&& other) noexcept {
+  if (this == &other) {
+    return *this;
+  }
+  Reset();
+  inline_size_ = other.inline_size_;
+  flags_ = other.flags_;
+  last_logical_commit_time_ = other.last_logical_commit_time_;
+  if (other.is_inline()) {
+    std::memcpy(storage_, other.storage_, inline_size_);
+  } else {
+    new (storage_) SharedString(std::move(other.shared()));
+  }
+  return *this;
+}
+
+void CompactValue::Reset() {
+  if (!is_inline()) {
+    shared().~SharedString();
+    flags_ &= ~kShared;
+    inline_size_ = 0;
+  }
+}
+
+}  // namespace kv_server
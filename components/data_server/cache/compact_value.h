@@ -0,0 +1,102 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_CACHE_COMPACT_VALUE_H_
+#define COMPONENTS_DATA_SERVER_CACHE_COMPACT_VALUE_H_
+
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <string>
+#include <string_view>
+
+namespace kv_server {
+
+// Value of a key in a hash table slot: the logical commit time of the last
+// update or deletion of the key, whether it was deleted, and the value.
+//
+// Values of up to `kMaxInlineSize` bytes are stored inline, so looking them up
+// doesn't leave the slot and they take no heap allocation. Longer values are
+// kept in a shared string that lookup results can hold on to. The flags share
+// the slot with the inline bytes, which keeps the whole value at 32 bytes.
+class CompactValue {
+ public:
+  static constexpr size_t kMaxInlineSize = 22;
+
+  // Returns a value deleted at `logical_commit_time`.
+  static CompactValue Deleted(int64_t logical_commit_time);
+  // Returns `value`, which is compressed if `is_compressed`.
+  static CompactValue Create(std::string_view value,
+                             int64_t logical_commit_time,
+                             bool is_compressed = false);
+
+  CompactValue(const CompactValue& other);
+  CompactValue(CompactValue&& other) noexcept;
+  CompactValue& operator=(const CompactValue& other);
+  CompactValue& operator=(CompactValue&& other) noexcept;
+  ~CompactValue() { Reset(); }
+
+  int64_t last_logical_commit_time() const {
+    return last_logical_commit_time_;
+  }
+  bool is_deleted() const { return flags_ & kDeleted; }
+  bool is_compressed() const { return flags_ & kCompressed; }
+  bool is_inline() const { return !(flags_ & kShared); }
+
+  // Returns the value, empty if it was deleted. Valid until this object is
+  // changed or destroyed.
+  std::string_view value() const {
+    return is_inline() ? std::string_view(storage_, inline_size_)
+                       : std::string_view(*shared());
+  }
+  // Returns the shared string of a value that isn't inline, null otherwise.
+  std::shared_ptr<const std::string> shared_value() const {
+    return is_inline() ? nullptr : shared();
+  }
+
+ private:
+  using SharedString = std::shared_ptr<const std::string>;
+
+  enum Flags : uint8_t {
+    kDeleted = 1,
+    kCompressed = 2,
+    // `storage_` holds a `SharedString` instead of the bytes of the value.
+    kShared = 4,
+  };
+
+  explicit CompactValue(int64_t logical_commit_time)
+      : last_logical_commit_time_(logical_commit_time) {}
+
+  SharedString& shared() {
+    return *std::launder(reinterpret_cast<SharedString*>(storage_));
+  }
+  const SharedString& shared() const {
+    return *std::launder(reinterpret_cast<const SharedString*>(storage_));
+  }
+  // Destroys the shared string, if any.
+  void Reset();
+
+  alignas(SharedString) char storage_[kMaxInlineSize];
+  uint8_t inline_size_ = 0;
+  uint8_t flags_ = 0;
+  int64_t last_logical_commit_time_;
+};
+
+static_assert(sizeof(CompactValue) == 32);
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_CACHE_COMPACT_VALUE_H_
@@ -0,0 +1,87 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/data_server/cache/compact_value.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+TEST(CompactValueTest, ShortValuesAreInline) {
+  const std::string value(CompactValue::kMaxInlineSize, 'a');
+  const auto compact_value = CompactValue::Create(value, 5);
+  EXPECT_TRUE(compact_value.is_inline());
+  EXPECT_EQ(compact_value.shared_value(), nullptr);
+  EXPECT_EQ(compact_value.value(), value);
+  EXPECT_EQ(compact_value.last_logical_commit_time(), 5);
+  EXPECT_FALSE(compact_value.is_deleted());
+  EXPECT_FALSE(compact_value.is_compressed());
+}
+
+TEST(CompactValueTest, LongValuesAreShared) {
+  const std::string value(CompactValue::kMaxInlineSize + 1, 'a');
+  const auto compact_value =
+      CompactValue::Create(value, 5, /*is_compressed=*/true);
+  EXPECT_FALSE(compact_value.is_inline());
+  ASSERT_NE(compact_value.shared_value(), nullptr);
+  EXPECT_EQ(*compact_value.shared_value(), value);
+  EXPECT_EQ(compact_value.value(), value);
+  EXPECT_TRUE(compact_value.is_compressed());
+}
+
+TEST(CompactValueTest, EmptyValueIsNotDeleted) {
+  const auto empty = CompactValue::Create("", 1);
+  EXPECT_FALSE(empty.is_deleted());
+  EXPECT_EQ(empty.value(), "");
+  const auto deleted = CompactValue::Deleted(2);
+  EXPECT_TRUE(deleted.is_deleted());
+  EXPECT_EQ(deleted.value(), "");
+  EXPECT_EQ(deleted.last_logical_commit_time(), 2);
+}
+
+TEST(CompactValueTest, CopiesShareLongValues) {
+  auto original = CompactValue::Create(std::string(100, 'a'), 1);
+  CompactValue copy = original;
+  const auto shared = original.shared_value();
+  EXPECT_EQ(copy.shared_value(), shared);
+  // Held by `original`, `copy` and `shared`.
+  EXPECT_EQ(shared.use_count(), 3);
+
+  original = CompactValue::Create("short", 2);
+  EXPECT_EQ(original.value(), "short");
+  EXPECT_EQ(copy.value(), std::string(100, 'a'));
+  copy = std::move(original);
+  EXPECT_EQ(copy.value(), "short");
+  EXPECT_EQ(copy.last_logical_commit_time(), 2);
+  EXPECT_EQ(shared.use_count(), 1);
+}
+
+TEST(CompactValueTest, SurvivesRelocation) {
+  std::vector<CompactValue> values;
+  for (int i = 0; i < 100; ++i) {
+    values.push_back(CompactValue::Create(std::string(i, 'a'), i));
+  }
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(values[i].value(), std::string(i, 'a'));
+    EXPECT_EQ(values[i].last_logical_commit_time(), i);
+  }
+}
+
+}  // namespace
+}  // namespace kv_server
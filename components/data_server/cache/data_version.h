@@ -0,0 +1,47 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_CACHE_DATA_VERSION_H_
+#define COMPONENTS_DATA_SERVER_CACHE_DATA_VERSION_H_
+
+#include <atomic>
+#include <cstdint>
+
+namespace kv_server {
+
+// Counts the changes to the data served by the process, so that results
+// computed from the data can be kept for as long as it doesn't change.
+//
+// Writers advance the version once their mutations are visible to lookups.
+// Readers read the version before they read the data, so that a result is
+// never attributed to a version later than the data it was computed from.
+//
+// Thread-safe.
+class DataVersion {
+ public:
+  uint64_t current() const { return version_.load(std::memory_order_acquire); }
+  void Advance() { version_.fetch_add(1, std::memory_order_acq_rel); }
+
+ private:
+  std::atomic<uint64_t> version_ = 0;
+};
+
+// Returns the version of the data served by the process.
+DataVersion& ServedDataVersion();
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_CACHE_DATA_VERSION_H_
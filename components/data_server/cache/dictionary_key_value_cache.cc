@@ -0,0 +1,291 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data_server/cache/dictionary_key_value_cache.h"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/log/log.h"
+#include "absl/memory/memory.h"
+#include "absl/synchronization/mutex.h"
+#include "components/data_server/cache/key_value_cache.h"
+
+namespace kv_server {
+
+DictionaryKeyValueCache::DictionaryKeyValueCache(Options options)
+    : options_(std::move(options)), set_cache_(KeyValueCache::Create()) {}
+
+absl::flat_hash_map<std::string, std::string>
+DictionaryKeyValueCache::GetKeyValuePairs(
+    const RequestContext& request_context,
+    const absl::flat_hash_set<std::string_view>& key_set) const {
+  ScopeLatencyMetricsRecorder<InternalLookupMetricsContext,
+                              kGetValuePairsLatencyInMicros>
+      latency_recorder(request_context.GetInternalLookupMetricsContext());
+  absl::flat_hash_map<std::string, std::string> kv_pairs;
+  {
+    absl::ReaderMutexLock lock(&mutex_);
+    for (std::string_view key : key_set) {
+      const CompactValue* cache_value = FindValue(key);
+      if (cache_value == nullptr || cache_value->is_deleted()) {
+        continue;
+      }
+      VLOG(9) << "Get called for " << key
+              << ". returning value: " << cache_value->value();
+      kv_pairs.insert_or_assign(key, cache_value->value());
+    }
+  }
+  if (kv_pairs.empty()) {
+    LogCacheAccessMetrics(request_context, kKeyValueCacheMiss);
+  } else {
+    LogCacheAccessMetrics(request_context, kKeyValueCacheHit);
+  }
+  return kv_pairs;
+}
+
+std::unique_ptr<GetKeyValueSetResult> DictionaryKeyValueCache::GetKeyValueSet(
+    const RequestContext& request_context,
+    const absl::flat_hash_set<std::string_view>& key_set) const {
+  return set_cache_->GetKeyValueSet(request_context, key_set);
+}
+
+CompactValue* DictionaryKeyValueCache::FindValue(std::string_view key) {
+  if (const auto id = keys_.Find(key); id.has_value()) {
+    return &values_[*id];
+  }
+  const auto key_iter = new_keys_.find(key);
+  return key_iter == new_keys_.end() ? nullptr : &key_iter->second;
+}
+
+const CompactValue* DictionaryKeyValueCache::FindValue(
+    std::string_view key) const {
+  if (const auto id = keys_.Find(key); id.has_value()) {
+    return &values_[*id];
+  }
+  const auto key_iter = new_keys_.find(key);
+  return key_iter == new_keys_.end() ? nullptr : &key_iter->second;
+}
+
+void DictionaryKeyValueCache::SetValue(std::string_view key,
+                                       CompactValue value) {
+  value_bytes_ += value.value().size();
+  if (CompactValue* cache_value = FindValue(key); cache_value != nullptr) {
+    value_bytes_ -= cache_value->value().size();
+    *cache_value = std::move(value);
+    return;
+  }
+  new_key_bytes_ += key.size();
+  new_keys_.emplace(key, std::move(value));
+  MaybeMergeNewKeysLocked();
+}
+
+void DictionaryKeyValueCache::UpdateKeyValue(std::string_view key,
+                                             std::string_view value,
+                                             int64_t logical_commit_time,
+                                             std::string_view prefix) {
+  SampledScopeLatencyMetricsRecorder<kUpdateKeyValueLatency> latency_recorder;
+  VLOG(9) << "Received update for [" << key << "] at " << logical_commit_time
+          << ". value will be set to: " << value;
+  absl::MutexLock lock(&mutex_);
+
+  auto max_cleanup_logical_commit_time =
+      max_cleanup_logical_commit_time_map_[prefix];
+  if (logical_commit_time <= max_cleanup_logical_commit_time) {
+    VLOG(1) << "Skipping the update as its logical_commit_time: "
+            << logical_commit_time
+            << " is not newer than the current cutoff time:"
+            << max_cleanup_logical_commit_time;
+    return;
+  }
+
+  if (const CompactValue* cache_value = FindValue(key);
+      cache_value != nullptr) {
+    if (cache_value->last_logical_commit_time() >= logical_commit_time) {
+      VLOG(1) << "Skipping the update as its logical_commit_time: "
+              << logical_commit_time
+              << " is not newer than the current value's time:"
+              << cache_value->last_logical_commit_time();
+      return;
+    }
+    if (cache_value->is_deleted()) {
+      if (auto prefix_deleted_nodes_iter = deleted_nodes_map_.find(prefix);
+          prefix_deleted_nodes_iter != deleted_nodes_map_.end()) {
+        auto dl_key_iter = prefix_deleted_nodes_iter->second.find(
+            cache_value->last_logical_commit_time());
+        if (dl_key_iter != prefix_deleted_nodes_iter->second.end() &&
+            dl_key_iter->second == key) {
+          prefix_deleted_nodes_iter->second.erase(dl_key_iter);
+        }
+      }
+    }
+  }
+  SetValue(key, CompactValue::Create(value, logical_commit_time));
+}
+
+void DictionaryKeyValueCache::UpdateKeyValueSet(
+    std::string_view key, absl::Span<std::string_view> input_value_set,
+    int64_t logical_commit_time, std::string_view prefix) {
+  set_cache_->UpdateKeyValueSet(key, input_value_set, logical_commit_time,
+                                prefix);
+}
+
+void DictionaryKeyValueCache::DeleteKey(std::string_view key,
+                                        int64_t logical_commit_time,
+                                        std::string_view prefix) {
+  SampledScopeLatencyMetricsRecorder<kDeleteKeyLatency> latency_recorder;
+  absl::MutexLock lock(&mutex_);
+  auto max_cleanup_logical_commit_time =
+      max_cleanup_logical_commit_time_map_[prefix];
+  if (logical_commit_time <= max_cleanup_logical_commit_time) {
+    return;
+  }
+  // If key is missing, we still need to add a tombstone to avoid the late
+  // coming update with smaller logical commit time inserting value for the
+  // given key
+  if (const CompactValue* cache_value = FindValue(key);
+      cache_value != nullptr &&
+      cache_value->last_logical_commit_time() >= logical_commit_time) {
+    return;
+  }
+  SetValue(key, CompactValue::Deleted(logical_commit_time));
+  deleted_nodes_map_[prefix].emplace(logical_commit_time, key);
+}
+
+void DictionaryKeyValueCache::DeleteValuesInSet(
+    std::string_view key, absl::Span<std::string_view> value_set,
+    int64_t logical_commit_time, std::string_view prefix) {
+  set_cache_->DeleteValuesInSet(key, value_set, logical_commit_time, prefix);
+}
+
+void DictionaryKeyValueCache::RemoveDeletedKeys(int64_t logical_commit_time,
+                                                std::string_view prefix) {
+  ScopeLatencyMetricsRecorder<ServerSafeMetricsContext,
+                              kRemoveDeletedKeyLatency>
+      latency_recorder(KVServerContextMap()->SafeMetric());
+  {
+    absl::MutexLock lock(&mutex_);
+    if (max_cleanup_logical_commit_time_map_[prefix] < logical_commit_time) {
+      max_cleanup_logical_commit_time_map_[prefix] = logical_commit_time;
+    }
+    if (auto deleted_nodes_per_prefix = deleted_nodes_map_.find(prefix);
+        deleted_nodes_per_prefix != deleted_nodes_map_.end()) {
+      auto it = deleted_nodes_per_prefix->second.begin();
+      while (it != deleted_nodes_per_prefix->second.end() &&
+             it->first <= logical_commit_time) {
+        if (const auto key_iter = new_keys_.find(it->second);
+            key_iter != new_keys_.end()) {
+          if (key_iter->second.is_deleted() &&
+              key_iter->second.last_logical_commit_time() <=
+                  logical_commit_time) {
+            new_key_bytes_ -= key_iter->first.size();
+            new_keys_.erase(key_iter);
+          }
+        } else if (CompactValue* cache_value = FindValue(it->second);
+                   cache_value != nullptr && cache_value->is_deleted() &&
+                   cache_value->last_logical_commit_time() <=
+                       logical_commit_time) {
+          // The key stays in the dictionary until the next merge. Updates
+          // aren't older than the cutoff, so they replace it like a missing
+          // key.
+          *cache_value = CompactValue::Deleted(0);
+        }
+        ++it;
+      }
+      deleted_nodes_per_prefix->second.erase(
+          deleted_nodes_per_prefix->second.begin(), it);
+      if (deleted_nodes_per_prefix->second.empty()) {
+        deleted_nodes_map_.erase(prefix);
+      }
+    }
+  }
+  set_cache_->RemoveDeletedKeys(logical_commit_time, prefix);
+}
+
+void DictionaryKeyValueCache::MaybeMergeNewKeysLocked() {
+  if (static_cast<int64_t>(new_keys_.size()) <
+      std::max(options_.min_merge_keys, keys_.size() / 4)) {
+    return;
+  }
+  VLOG(1) << "Merging " << new_keys_.size()
+          << " new keys into a dictionary of " << keys_.size() << " keys";
+  std::vector<std::pair<std::string_view, CompactValue*>> new_keys;
+  new_keys.reserve(new_keys_.size());
+  for (auto& [key, cache_value] : new_keys_) {
+    new_keys.emplace_back(key, &cache_value);
+  }
+  std::sort(new_keys.begin(), new_keys.end());
+  FrontCodedKeys::Builder builder;
+  std::vector<CompactValue> values;
+  values.reserve(keys_.size() + new_keys.size());
+  auto add = [&builder, &values](std::string_view key,
+                                 CompactValue& cache_value) {
+    // Deleted keys that cleanup passed.
+    if (cache_value.is_deleted() &&
+        cache_value.last_logical_commit_time() == 0) {
+      return;
+    }
+    builder.Add(key);
+    values.push_back(std::move(cache_value));
+  };
+  auto new_key = new_keys.begin();
+  keys_.ForEach([&](int64_t id, std::string_view key) {
+    for (; new_key != new_keys.end() && new_key->first < key; ++new_key) {
+      add(new_key->first, *new_key->second);
+    }
+    add(key, values_[id]);
+  });
+  for (; new_key != new_keys.end(); ++new_key) {
+    add(new_key->first, *new_key->second);
+  }
+  keys_ = std::move(builder).Build();
+  values.shrink_to_fit();
+  values_ = std::move(values);
+  new_keys_.clear();
+  new_key_bytes_ = 0;
+}
+
+absl::flat_hash_map<std::string, Cache::MemoryUsage>
+DictionaryKeyValueCache::GetMemoryUsage() const {
+  auto memory_usage = set_cache_->GetMemoryUsage();
+  absl::ReaderMutexLock lock(&mutex_);
+  MemoryUsage& usage = memory_usage[""];
+  usage.key_bytes += keys_.memory_bytes() + new_key_bytes_;
+  usage.value_bytes += value_bytes_;
+  usage.hash_table_bytes +=
+      values_.capacity() * sizeof(CompactValue) +
+      new_keys_.capacity() *
+          (sizeof(std::pair<const std::string, CompactValue>) + 1);
+  return memory_usage;
+}
+
+void DictionaryKeyValueCache::LogCacheAccessMetrics(
+    const RequestContext& request_context,
+    std::string_view cache_access_event) const {
+  LogIfError(
+      request_context.GetInternalLookupMetricsContext()
+          .AccumulateMetric<kCacheAccessEventCount>(1, cache_access_event));
+}
+
+std::unique_ptr<Cache> DictionaryKeyValueCache::Create(Options options) {
+  return absl::WrapUnique(new DictionaryKeyValueCache(std::move(options)));
+}
+
+}  // namespace kv_server
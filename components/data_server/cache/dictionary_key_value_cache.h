@@ -0,0 +1,149 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_CACHE_DICTIONARY_KEY_VALUE_CACHE_H_
+#define COMPONENTS_DATA_SERVER_CACHE_DICTIONARY_KEY_VALUE_CACHE_H_
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/synchronization/mutex.h"
+#include "components/data_server/cache/cache.h"
+#include "components/data_server/cache/compact_value.h"
+#include "components/data_server/cache/front_coded_keys.h"
+#include "components/data_server/cache/get_key_value_set_result.h"
+
+namespace kv_server {
+
+// In-memory datastore for large key spaces with long shared key prefixes,
+// e.g. URLs, that keeps most keys in an immutable `FrontCodedKeys` dictionary
+// instead of one string per key.
+//
+// The values of the dictionary keys are in an array indexed by the id of the
+// key, and are updated in place. Keys that aren't in the dictionary, e.g.
+// every key while a snapshot is loaded, go to a hash map that is merged into
+// a new dictionary once it holds enough keys, see `Options`. Deleted keys
+// are dropped by the next merge once cleanup passed them. Lookups and updates
+// wait for a merge.
+//
+// Key-value sets are kept in a `KeyValueCache`.
+// One cache object is only for keys in one namespace.
+class DictionaryKeyValueCache : public Cache {
+ public:
+  struct Options {
+    // The hash map of new keys is merged into the dictionary once it holds at
+    // least this many keys, and a quarter as many as the dictionary, so that
+    // the keys are merged a few times each.
+    int64_t min_merge_keys = 64 * 1024;
+  };
+
+  // Looks up and returns key-value pairs for the given keys.
+  absl::flat_hash_map<std::string, std::string> GetKeyValuePairs(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override;
+
+  // Looks up and returns key-value set result for the given key set.
+  std::unique_ptr<GetKeyValueSetResult> GetKeyValueSet(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override;
+
+  // Inserts or updates the key with the new value for a given prefix
+  void UpdateKeyValue(std::string_view key, std::string_view value,
+                      int64_t logical_commit_time,
+                      std::string_view prefix = "") override;
+
+  // Inserts or updates values in the set for a given key and prefix, if a value
+  // exists, updates its timestamp to the latest logical commit time.
+  void UpdateKeyValueSet(std::string_view key,
+                         absl::Span<std::string_view> input_value_set,
+                         int64_t logical_commit_time,
+                         std::string_view prefix = "") override;
+
+  // Deletes a particular (key, value) pair for a given prefix.
+  void DeleteKey(std::string_view key, int64_t logical_commit_time,
+                 std::string_view prefix = "") override;
+
+  // Deletes values in the set for a given key and prefix.
+  void DeleteValuesInSet(std::string_view key,
+                         absl::Span<std::string_view> value_set,
+                         int64_t logical_commit_time,
+                         std::string_view prefix = "") override;
+
+  // Removes the values that were deleted before the specified
+  // logical_commit_time for a given prefix.
+  void RemoveDeletedKeys(int64_t logical_commit_time,
+                         std::string_view prefix = "") override;
+
+  // Counts the dictionary as key bytes, and the value array as hash table
+  // bytes.
+  absl::flat_hash_map<std::string, MemoryUsage> GetMemoryUsage()
+      const override;
+
+  static std::unique_ptr<Cache> Create(Options options = Options());
+
+ private:
+  explicit DictionaryKeyValueCache(Options options);
+
+  // Returns the value of `key`, or null if the key is missing.
+  CompactValue* FindValue(std::string_view key)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  const CompactValue* FindValue(std::string_view key) const
+      ABSL_SHARED_LOCKS_REQUIRED(mutex_);
+  // Sets the value of `key`, adding the key to `new_keys_` if it is missing.
+  void SetValue(std::string_view key, CompactValue value)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Builds a new dictionary with the keys of `keys_` and `new_keys_`, if
+  // `new_keys_` holds enough keys.
+  void MaybeMergeNewKeysLocked() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Logs cache access metrics for cache hit or miss counts. The cache access
+  // event name is defined in server_definition.h file
+  void LogCacheAccessMetrics(const RequestContext& request_context,
+                             std::string_view cache_access_event) const;
+
+  const Options options_;
+  mutable absl::Mutex mutex_;
+  FrontCodedKeys keys_ ABSL_GUARDED_BY(mutex_);
+  // The values of `keys_`, by id. A deleted key that cleanup passed is marked
+  // with a zero timestamp, which updates can't have, to be dropped by the
+  // next merge.
+  std::vector<CompactValue> values_ ABSL_GUARDED_BY(mutex_);
+  // Keys that aren't in `keys_`.
+  absl::flat_hash_map<std::string, CompactValue> new_keys_
+      ABSL_GUARDED_BY(mutex_);
+  int64_t new_key_bytes_ ABSL_GUARDED_BY(mutex_) = 0;
+  // Bytes of the values that aren't deleted.
+  int64_t value_bytes_ ABSL_GUARDED_BY(mutex_) = 0;
+  // Same bookkeeping as `ArenaKeyValueCache::deleted_nodes_map_`.
+  absl::flat_hash_map<std::string, std::multimap<int64_t, std::string>>
+      deleted_nodes_map_ ABSL_GUARDED_BY(mutex_);
+  // The key is the prefix and the value is the
+  // maximum timestamp that was passed to RemoveDeletedKeys.
+  absl::flat_hash_map<std::string, int64_t> max_cleanup_logical_commit_time_map_
+      ABSL_GUARDED_BY(mutex_);
+
+  // Holds the key-value sets.
+  std::unique_ptr<Cache> set_cache_;
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_CACHE_DICTIONARY_KEY_VALUE_CACHE_H_
@@ -0,0 +1,165 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data_server/cache/dictionary_key_value_cache.h"
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/str_cat.h"
+#include "components/data_server/cache/cache.h"
+#include "components/data_server/cache/mocks.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+using testing::IsEmpty;
+using testing::UnorderedElementsAre;
+
+class DictionaryCacheTest : public ::testing::Test {
+ protected:
+  DictionaryCacheTest() {
+    InitMetricsContextMap();
+    scope_metrics_context_ = std::make_unique<ScopeMetricsContext>();
+    request_context_ =
+        std::make_unique<RequestContext>(*scope_metrics_context_);
+  }
+  RequestContext& GetRequestContext() { return *request_context_; }
+  std::unique_ptr<ScopeMetricsContext> scope_metrics_context_;
+  std::unique_ptr<RequestContext> request_context_;
+};
+
+// Merges the new keys into the dictionary every other key.
+std::unique_ptr<Cache> CreateCache() {
+  return DictionaryKeyValueCache::Create({.min_merge_keys = 2});
+}
+
+TEST_F(DictionaryCacheTest, RetrievesMatchingEntry) {
+  std::unique_ptr<Cache> cache = CreateCache();
+  for (int i = 0; i < 10; ++i) {
+    cache->UpdateKeyValue(absl::StrCat("key", i), absl::StrCat("value", i), 1);
+  }
+  auto kv_pairs = cache->GetKeyValuePairs(GetRequestContext(),
+                                          {"key0", "key5", "key9", "key10"});
+  EXPECT_THAT(kv_pairs, UnorderedElementsAre(KVPairEq("key0", "value0"),
+                                             KVPairEq("key5", "value5"),
+                                             KVPairEq("key9", "value9")));
+}
+
+TEST_F(DictionaryCacheTest, DictionaryKeysAreUpdatedInPlace) {
+  std::unique_ptr<Cache> cache = CreateCache();
+  cache->UpdateKeyValue("my_key", "old_value", 2);
+  cache->UpdateKeyValue("other_key", "other_value", 2);
+  cache->UpdateKeyValue("my_key", "older_value", 1);
+  EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(), {"my_key"}),
+              UnorderedElementsAre(KVPairEq("my_key", "old_value")));
+  cache->UpdateKeyValue("my_key", "a value too long to be stored inline", 3);
+  EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(), {"my_key"}),
+              UnorderedElementsAre(KVPairEq(
+                  "my_key", "a value too long to be stored inline")));
+}
+
+TEST_F(DictionaryCacheTest, DeleteThenOutOfOrderUpdateIsIgnored) {
+  std::unique_ptr<Cache> cache = CreateCache();
+  cache->UpdateKeyValue("my_key", "my_value", 1);
+  cache->UpdateKeyValue("other_key", "other_value", 1);
+  cache->DeleteKey("my_key", 3);
+  cache->DeleteKey("new_key", 3);
+  cache->UpdateKeyValue("my_key", "late_value", 2);
+  cache->UpdateKeyValue("new_key", "late_value", 2);
+  EXPECT_THAT(
+      cache->GetKeyValuePairs(GetRequestContext(), {"my_key", "new_key"}),
+      IsEmpty());
+  cache->UpdateKeyValue("my_key", "new_value", 4);
+  EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(), {"my_key"}),
+              UnorderedElementsAre(KVPairEq("my_key", "new_value")));
+}
+
+TEST_F(DictionaryCacheTest, RemoveDeletedKeysDropsTombstones) {
+  std::unique_ptr<Cache> cache = CreateCache();
+  cache->UpdateKeyValue("dictionary_key", "value", 1);
+  cache->UpdateKeyValue("kept_key", "value", 1);
+  cache->DeleteKey("dictionary_key", 2);
+  cache->DeleteKey("new_key", 2);
+  cache->RemoveDeletedKeys(5);
+  cache->UpdateKeyValue("dictionary_key", "late_value", 4);
+  cache->UpdateKeyValue("new_key", "late_value", 4);
+  EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(),
+                                      {"dictionary_key", "new_key"}),
+              IsEmpty());
+  cache->UpdateKeyValue("dictionary_key", "new_value", 6);
+  cache->UpdateKeyValue("new_key", "new_value", 6);
+  EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(),
+                                      {"dictionary_key", "kept_key", "new_key"}),
+              UnorderedElementsAre(KVPairEq("dictionary_key", "new_value"),
+                                   KVPairEq("kept_key", "value"),
+                                   KVPairEq("new_key", "new_value")));
+}
+
+TEST_F(DictionaryCacheTest, MergeDropsCleanedUpKeys) {
+  std::unique_ptr<Cache> cache =
+      DictionaryKeyValueCache::Create({.min_merge_keys = 10});
+  for (int i = 0; i < 10; ++i) {
+    cache->UpdateKeyValue(absl::StrCat("key", i), "value", 1);
+  }
+  const int64_t key_bytes = cache->GetMemoryUsage()[""].key_bytes;
+  for (int i = 0; i < 9; ++i) {
+    cache->DeleteKey(absl::StrCat("key", i), 2);
+  }
+  cache->RemoveDeletedKeys(2);
+  for (int i = 0; i < 10; ++i) {
+    cache->UpdateKeyValue(absl::StrCat("new_key", i), "value", 3);
+  }
+  EXPECT_LT(cache->GetMemoryUsage()[""].key_bytes, 2 * key_bytes);
+  EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(),
+                                      {"key0", "key9", "new_key0"}),
+              UnorderedElementsAre(KVPairEq("key9", "value"),
+                                   KVPairEq("new_key0", "value")));
+}
+
+TEST_F(DictionaryCacheTest, SharedKeyPrefixesAreStoredOnce) {
+  std::unique_ptr<Cache> cache = DictionaryKeyValueCache::Create();
+  int64_t key_bytes = 0;
+  for (int i = 0; i < 100000; ++i) {
+    const std::string key =
+        absl::StrCat("https://ads.example.com/creative/", i);
+    key_bytes += key.size();
+    cache->UpdateKeyValue(key, "value", 1);
+  }
+  EXPECT_LT(cache->GetMemoryUsage()[""].key_bytes, key_bytes / 2);
+  EXPECT_THAT(
+      cache->GetKeyValuePairs(GetRequestContext(),
+                              {"https://ads.example.com/creative/12345"}),
+      UnorderedElementsAre(
+          KVPairEq("https://ads.example.com/creative/12345", "value")));
+}
+
+TEST_F(DictionaryCacheTest, KeyValueSetsAreKept) {
+  std::unique_ptr<Cache> cache = CreateCache();
+  std::vector<std::string_view> values = {"v1", "v2"};
+  cache->UpdateKeyValueSet("my_set", absl::MakeSpan(values), 1);
+  EXPECT_THAT(cache->GetKeyValueSet(GetRequestContext(), {"my_set"})
+                  ->GetValueSet("my_set"),
+              UnorderedElementsAre("v1", "v2"));
+}
+
+}  // namespace
+}  // namespace kv_server
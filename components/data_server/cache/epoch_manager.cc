@@ -0,0 +1,101 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/data_server/cache/epoch_manager.h"
+
+#include <algorithm>
+
+namespace kv_server {
+namespace {
+
+// Releases the thread's record when the thread exits so that it can be reused.
+struct ThreadRecordHolder {
+  EpochManager::ThreadRecord* record = nullptr;
+  ~ThreadRecordHolder() {
+    if (record != nullptr) {
+      record->epoch.store(EpochManager::kInactive, std::memory_order_release);
+      record->in_use.store(false, std::memory_order_release);
+    }
+  }
+};
+
+}  // namespace
+
+EpochManager::ReadLock::ReadLock(EpochManager& epoch_manager)
+    : record_(epoch_manager.GetThreadRecord()) {
+  if (record_->nesting_depth++ > 0) {
+    return;
+  }
+  record_->epoch.store(
+      epoch_manager.global_epoch_.load(std::memory_order_seq_cst),
+      std::memory_order_relaxed);
+  // The announcement has to be visible to writers before any shared pointer is
+  // loaded. Pairs with the fence in `AdvanceAndGetMinActiveEpoch`.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+EpochManager::ReadLock::~ReadLock() {
+  if (--record_->nesting_depth > 0) {
+    return;
+  }
+  record_->epoch.store(kInactive, std::memory_order_release);
+}
+
+EpochManager& EpochManager::GetInstance() {
+  static EpochManager* const instance = new EpochManager();
+  return *instance;
+}
+
+EpochManager::ThreadRecord* EpochManager::GetThreadRecord() {
+  thread_local ThreadRecordHolder holder;
+  if (holder.record != nullptr) {
+    return holder.record;
+  }
+  for (ThreadRecord* record = records_.load(std::memory_order_acquire);
+       record != nullptr; record = record->next) {
+    bool expected = false;
+    if (!record->in_use.load(std::memory_order_relaxed) &&
+        record->in_use.compare_exchange_strong(expected, true,
+                                               std::memory_order_acq_rel)) {
+      record->nesting_depth = 0;
+      holder.record = record;
+      return record;
+    }
+  }
+  auto* record = new ThreadRecord();
+  record->in_use.store(true, std::memory_order_relaxed);
+  ThreadRecord* head = records_.load(std::memory_order_relaxed);
+  do {
+    record->next = head;
+  } while (!records_.compare_exchange_weak(head, record,
+                                           std::memory_order_acq_rel,
+                                           std::memory_order_relaxed));
+  holder.record = record;
+  return record;
+}
+
+uint64_t EpochManager::AdvanceAndGetMinActiveEpoch() {
+  // Orders the writer's unlinking stores before the scan of the records.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  uint64_t min_epoch =
+      global_epoch_.fetch_add(1, std::memory_order_seq_cst) + 1;
+  for (ThreadRecord* record = records_.load(std::memory_order_acquire);
+       record != nullptr; record = record->next) {
+    min_epoch =
+        std::min(min_epoch, record->epoch.load(std::memory_order_acquire));
+  }
+  return min_epoch;
+}
+
+}  // namespace kv_server
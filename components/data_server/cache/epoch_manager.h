@@ -0,0 +1,89 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_CACHE_EPOCH_MANAGER_H_
+#define COMPONENTS_DATA_SERVER_CACHE_EPOCH_MANAGER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+
+namespace kv_server {
+
+// Process wide epoch based reclamation domain.
+//
+// Readers wrap every access to shared, lock-free data in a `ReadLock`, which
+// announces the epoch the reader started in. Writers unlink objects from the
+// shared data, tag them with `GetRetireEpoch()` and free them only once the
+// tag is smaller than `AdvanceAndGetMinActiveEpoch()`, i.e. once every reader
+// that could still hold a reference to the object has left its critical
+// section.
+//
+// Entering and leaving a critical section only touches a per thread record, so
+// readers never write to a cache line shared with other threads.
+class EpochManager {
+ public:
+  static constexpr uint64_t kInactive = std::numeric_limits<uint64_t>::max();
+
+  // Per thread announcement of the epoch that the thread is reading in.
+  struct alignas(64) ThreadRecord {
+    std::atomic<uint64_t> epoch{kInactive};
+    std::atomic<bool> in_use{false};
+    // Only touched by the owning thread.
+    int nesting_depth = 0;
+    ThreadRecord* next = nullptr;
+  };
+
+  // RAII critical section for readers. Nesting is allowed.
+  class ReadLock {
+   public:
+    explicit ReadLock(EpochManager& epoch_manager);
+    ~ReadLock();
+
+    ReadLock(const ReadLock&) = delete;
+    ReadLock& operator=(const ReadLock&) = delete;
+
+   private:
+    ThreadRecord* record_;
+  };
+
+  static EpochManager& GetInstance();
+
+  // Returns the tag for an object that was just unlinked from shared data.
+  uint64_t GetRetireEpoch() const {
+    return global_epoch_.load(std::memory_order_seq_cst);
+  }
+
+  // Advances the global epoch and returns the oldest epoch that an active
+  // reader is still in. Objects retired with a tag strictly smaller than the
+  // returned epoch can be freed.
+  uint64_t AdvanceAndGetMinActiveEpoch();
+
+ private:
+  EpochManager() = default;
+
+  // Returns the record of the calling thread, registering one if needed.
+  ThreadRecord* GetThreadRecord();
+
+  std::atomic<uint64_t> global_epoch_{1};
+  // Lock-free list of all records ever registered. Records are never freed,
+  // they are released on thread exit and reused by new threads.
+  std::atomic<ThreadRecord*> records_{nullptr};
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_CACHE_EPOCH_MANAGER_H_
@@ -0,0 +1,75 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/data_server/cache/epoch_manager.h"
+
+#include <thread>
+
+#include "absl/synchronization/notification.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+TEST(EpochManagerTest, ObjectRetiredWithoutReadersCanBeFreed) {
+  EpochManager& epoch_manager = EpochManager::GetInstance();
+  const uint64_t retire_epoch = epoch_manager.GetRetireEpoch();
+  EXPECT_LT(retire_epoch, epoch_manager.AdvanceAndGetMinActiveEpoch());
+}
+
+TEST(EpochManagerTest, ActiveReaderBlocksReclamation) {
+  EpochManager& epoch_manager = EpochManager::GetInstance();
+  absl::Notification reader_entered;
+  absl::Notification reader_can_exit;
+  std::thread reader([&]() {
+    EpochManager::ReadLock lock(epoch_manager);
+    reader_entered.Notify();
+    reader_can_exit.WaitForNotification();
+  });
+  reader_entered.WaitForNotification();
+  const uint64_t retire_epoch = epoch_manager.GetRetireEpoch();
+  EXPECT_GE(retire_epoch, epoch_manager.AdvanceAndGetMinActiveEpoch());
+  EXPECT_GE(retire_epoch, epoch_manager.AdvanceAndGetMinActiveEpoch());
+  reader_can_exit.Notify();
+  reader.join();
+  EXPECT_LT(retire_epoch, epoch_manager.AdvanceAndGetMinActiveEpoch());
+}
+
+TEST(EpochManagerTest, NestedReadLockKeepsOuterEpoch) {
+  EpochManager& epoch_manager = EpochManager::GetInstance();
+  uint64_t retire_epoch;
+  {
+    EpochManager::ReadLock outer(epoch_manager);
+    retire_epoch = epoch_manager.GetRetireEpoch();
+    {
+      EpochManager::ReadLock inner(epoch_manager);
+    }
+    EXPECT_GE(retire_epoch, epoch_manager.AdvanceAndGetMinActiveEpoch());
+  }
+  EXPECT_LT(retire_epoch, epoch_manager.AdvanceAndGetMinActiveEpoch());
+}
+
+TEST(EpochManagerTest, RecordsAreReusedAcrossThreads) {
+  EpochManager& epoch_manager = EpochManager::GetInstance();
+  for (int i = 0; i < 100; i++) {
+    std::thread([&epoch_manager]() {
+      EpochManager::ReadLock lock(epoch_manager);
+    }).join();
+  }
+  const uint64_t retire_epoch = epoch_manager.GetRetireEpoch();
+  EXPECT_LT(retire_epoch, epoch_manager.AdvanceAndGetMinActiveEpoch());
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -0,0 +1,306 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data_server/cache/fixed_width_key_cache.h"
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/status/status.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/strip.h"
+
+namespace kv_server {
+
+FixedWidthKeyCache::FixedWidthKeyCache(std::unique_ptr<Cache> cache,
+                                       Options options)
+    : cache_(std::move(cache)) {
+  namespaces_.reserve(options.namespaces.size());
+  for (KeyNamespace& key_namespace : options.namespaces) {
+    namespaces_.push_back(
+        {.key_prefix = std::move(key_namespace.key_prefix),
+         .table = FixedWidthKeyTable::Create(key_namespace.key_type)});
+  }
+}
+
+absl::flat_hash_map<std::string, std::string>
+FixedWidthKeyCache::GetKeyValuePairs(
+    const RequestContext& request_context,
+    const absl::flat_hash_set<std::string_view>& key_set) const {
+  if (namespaces_.empty()) {
+    return cache_->GetKeyValuePairs(request_context, key_set);
+  }
+  absl::flat_hash_map<std::string, std::string> kv_pairs;
+  absl::flat_hash_set<std::string_view> other_keys;
+  for (std::string_view key : key_set) {
+    std::shared_ptr<const std::string> value;
+    if (!GetFromTable(key, value)) {
+      other_keys.insert(key);
+    } else if (value != nullptr) {
+      kv_pairs.emplace(key, *value);
+    }
+  }
+  if (!other_keys.empty()) {
+    kv_pairs.merge(cache_->GetKeyValuePairs(request_context, other_keys));
+  }
+  return kv_pairs;
+}
+
+GetKeyValuePairsResult FixedWidthKeyCache::GetKeyValuePairViews(
+    const RequestContext& request_context,
+    const absl::flat_hash_set<std::string_view>& key_set) const {
+  if (namespaces_.empty()) {
+    return cache_->GetKeyValuePairViews(request_context, key_set);
+  }
+  GetKeyValuePairsResult result;
+  // Views of the same keys as `key_set`, so the result can view them too.
+  absl::flat_hash_set<std::string_view> other_keys;
+  for (std::string_view key : key_set) {
+    std::shared_ptr<const std::string> value;
+    if (!GetFromTable(key, value)) {
+      other_keys.insert(key);
+    } else if (value != nullptr) {
+      result.AddValue(key, std::move(value));
+    }
+  }
+  if (!other_keys.empty()) {
+    result.Merge(cache_->GetKeyValuePairViews(request_context, other_keys));
+  }
+  return result;
+}
+
+GetKeyValuePairsResult FixedWidthKeyCache::GetHashedKeyValuePairViews(
+    const RequestContext& request_context,
+    absl::Span<const HashedKey> keys) const {
+  if (namespaces_.empty()) {
+    return cache_->GetHashedKeyValuePairViews(request_context, keys);
+  }
+  GetKeyValuePairsResult result;
+  std::vector<HashedKey> other_keys;
+  for (const HashedKey& key : keys) {
+    std::shared_ptr<const std::string> value;
+    if (!GetFromTable(key.key, value)) {
+      other_keys.push_back(key);
+    } else if (value != nullptr) {
+      result.AddValue(key, std::move(value));
+    }
+  }
+  if (!other_keys.empty()) {
+    result.Merge(
+        cache_->GetHashedKeyValuePairViews(request_context, other_keys));
+  }
+  return result;
+}
+
+absl::StatusOr<std::vector<std::string>> FixedWidthKeyCache::GetKeysByPrefix(
+    std::string_view key_prefix, int limit) const {
+  return cache_->GetKeysByPrefix(key_prefix, limit);
+}
+
+absl::StatusOr<std::vector<std::string>> FixedWidthKeyCache::GetSetsContaining(
+    std::string_view member) const {
+  return cache_->GetSetsContaining(member);
+}
+
+std::unique_ptr<GetKeyValueSetResult> FixedWidthKeyCache::GetKeyValueSet(
+    const RequestContext& request_context,
+    const absl::flat_hash_set<std::string_view>& key_set) const {
+  return cache_->GetKeyValueSet(request_context, key_set);
+}
+
+void FixedWidthKeyCache::UpdateKeyValue(std::string_view key,
+                                        std::string_view value,
+                                        int64_t logical_commit_time,
+                                        std::string_view prefix) {
+  std::string_view native_key;
+  if (const Namespace* key_namespace = FindNamespace(key, native_key);
+      key_namespace != nullptr &&
+      key_namespace->table->Update(native_key, value, logical_commit_time,
+                                   prefix)) {
+    return;
+  }
+  cache_->UpdateKeyValue(key, value, logical_commit_time, prefix);
+}
+
+void FixedWidthKeyCache::UpdateKeyValueSet(
+    std::string_view key, absl::Span<std::string_view> value_set,
+    int64_t logical_commit_time, std::string_view prefix) {
+  cache_->UpdateKeyValueSet(key, value_set, logical_commit_time, prefix);
+}
+
+void FixedWidthKeyCache::DeleteKey(std::string_view key,
+                                   int64_t logical_commit_time,
+                                   std::string_view prefix) {
+  std::string_view native_key;
+  if (const Namespace* key_namespace = FindNamespace(key, native_key);
+      key_namespace != nullptr &&
+      key_namespace->table->Delete(native_key, logical_commit_time, prefix)) {
+    return;
+  }
+  cache_->DeleteKey(key, logical_commit_time, prefix);
+}
+
+void FixedWidthKeyCache::DeleteValuesInSet(
+    std::string_view key, absl::Span<std::string_view> value_set,
+    int64_t logical_commit_time, std::string_view prefix) {
+  cache_->DeleteValuesInSet(key, value_set, logical_commit_time, prefix);
+}
+
+void FixedWidthKeyCache::UpdateKeyValueUInt32Set(
+    std::string_view key, absl::Span<const uint32_t> value_set,
+    int64_t logical_commit_time, std::string_view prefix) {
+  cache_->UpdateKeyValueUInt32Set(key, value_set, logical_commit_time, prefix);
+}
+
+void FixedWidthKeyCache::DeleteValuesInUInt32Set(
+    std::string_view key, absl::Span<const uint32_t> value_set,
+    int64_t logical_commit_time, std::string_view prefix) {
+  cache_->DeleteValuesInUInt32Set(key, value_set, logical_commit_time, prefix);
+}
+
+void FixedWidthKeyCache::ApplyMutations(absl::Span<const Mutation> mutations,
+                                        std::string_view prefix) {
+  if (namespaces_.empty()) {
+    cache_->ApplyMutations(mutations, prefix);
+    return;
+  }
+  std::vector<Mutation> other_mutations;
+  other_mutations.reserve(mutations.size());
+  for (const Mutation& mutation : mutations) {
+    std::string_view native_key;
+    const Namespace* key_namespace = nullptr;
+    if (mutation.type == Mutation::Type::kUpdateKeyValue ||
+        mutation.type == Mutation::Type::kDeleteKey) {
+      key_namespace = FindNamespace(mutation.key, native_key);
+    }
+    if (key_namespace != nullptr &&
+        (mutation.type == Mutation::Type::kUpdateKeyValue
+             ? key_namespace->table->Update(native_key, mutation.value,
+                                            mutation.logical_commit_time,
+                                            prefix)
+             : key_namespace->table->Delete(
+                   native_key, mutation.logical_commit_time, prefix))) {
+      continue;
+    }
+    other_mutations.push_back(mutation);
+  }
+  if (!other_mutations.empty()) {
+    cache_->ApplyMutations(other_mutations, prefix);
+  }
+}
+
+void FixedWidthKeyCache::RemoveDeletedKeys(int64_t logical_commit_time,
+                                           std::string_view prefix) {
+  cache_->RemoveDeletedKeys(logical_commit_time, prefix);
+  for (const Namespace& key_namespace : namespaces_) {
+    key_namespace.table->RemoveDeleted(logical_commit_time, prefix);
+  }
+}
+
+Cache::CleanupProgress FixedWidthKeyCache::RemoveDeletedKeysSlice(
+    int64_t logical_commit_time, std::string_view prefix,
+    absl::Time deadline) {
+  const CleanupProgress progress =
+      cache_->RemoveDeletedKeysSlice(logical_commit_time, prefix, deadline);
+  if (progress.done) {
+    for (const Namespace& key_namespace : namespaces_) {
+      key_namespace.table->RemoveDeleted(logical_commit_time, prefix);
+    }
+  }
+  return progress;
+}
+
+absl::Status FixedWidthKeyCache::ExportMutations(
+    absl::FunctionRef<void(std::string_view prefix,
+                           absl::Span<const Mutation> mutations)>
+        fn) const {
+  for (const Namespace& key_namespace : namespaces_) {
+    key_namespace.table->Export(key_namespace.key_prefix, fn);
+  }
+  return cache_->ExportMutations(fn);
+}
+
+absl::flat_hash_map<std::string, Cache::MemoryUsage>
+FixedWidthKeyCache::GetMemoryUsage() const {
+  auto memory_usage = cache_->GetMemoryUsage();
+  for (const Namespace& key_namespace : namespaces_) {
+    key_namespace.table->AddMemoryUsage(memory_usage);
+  }
+  return memory_usage;
+}
+
+std::string FixedWidthKeyCache::DebugMemoryReport(int num_largest) const {
+  return cache_->DebugMemoryReport(num_largest);
+}
+
+const FixedWidthKeyCache::Namespace* FixedWidthKeyCache::FindNamespace(
+    std::string_view key, std::string_view& native_key) const {
+  for (const Namespace& key_namespace : namespaces_) {
+    if (absl::StartsWith(key, key_namespace.key_prefix)) {
+      native_key = key.substr(key_namespace.key_prefix.size());
+      return &key_namespace;
+    }
+  }
+  return nullptr;
+}
+
+bool FixedWidthKeyCache::GetFromTable(
+    std::string_view key, std::shared_ptr<const std::string>& value) const {
+  std::string_view native_key;
+  const Namespace* key_namespace = FindNamespace(key, native_key);
+  return key_namespace != nullptr &&
+         key_namespace->table->Get(native_key, value);
+}
+
+std::unique_ptr<Cache> FixedWidthKeyCache::Create(std::unique_ptr<Cache> cache,
+                                                  Options options) {
+  return absl::WrapUnique(
+      new FixedWidthKeyCache(std::move(cache), std::move(options)));
+}
+
+absl::StatusOr<std::vector<FixedWidthKeyCache::KeyNamespace>>
+ParseFixedWidthKeyNamespaces(std::string_view namespaces) {
+  std::vector<FixedWidthKeyCache::KeyNamespace> key_namespaces;
+  for (std::string_view key_namespace :
+       absl::StrSplit(namespaces, ',', absl::SkipWhitespace())) {
+    const std::vector<std::string_view> parts = absl::StrSplit(
+        absl::StripAsciiWhitespace(key_namespace), absl::MaxSplits('=', 1));
+    if (parts.size() != 2) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Expected <key prefix>=<type>: ", key_namespace));
+    }
+    FixedWidthKeyType key_type;
+    if (parts[1] == "uint64") {
+      key_type = FixedWidthKeyType::kUInt64;
+    } else if (parts[1] == "hash128") {
+      key_type = FixedWidthKeyType::kHash128;
+    } else {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Unknown fixed width key type: ", parts[1]));
+    }
+    key_namespaces.push_back(
+        {.key_prefix = std::string(parts[0]), .key_type = key_type});
+  }
+  return key_namespaces;
+}
+
+}  // namespace kv_server
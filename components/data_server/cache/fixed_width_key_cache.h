@@ -0,0 +1,154 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_CACHE_FIXED_WIDTH_KEY_CACHE_H_
+#define COMPONENTS_DATA_SERVER_CACHE_FIXED_WIDTH_KEY_CACHE_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/status/statusor.h"
+#include "components/data_server/cache/cache.h"
+#include "components/data_server/cache/fixed_width_key_table.h"
+
+namespace kv_server {
+
+// Cache that keeps the key-value pairs of numeric ids and hashes, e.g.
+// "uid:12345" or "h:<32 hex digits>", in tables keyed by the native form of
+// the keys, which are decoded once as they are loaded.
+//
+// A key belongs to the first namespace whose key prefix it starts with, if
+// the rest of it is the canonical text of a key of the namespace's type.
+// Everything else, including all key-value sets, is delegated to `cache`.
+// `GetKeysByPrefix` doesn't find the keys of the namespaces.
+class FixedWidthKeyCache : public Cache {
+ public:
+  struct KeyNamespace {
+    std::string key_prefix;
+    FixedWidthKeyType key_type;
+  };
+
+  struct Options {
+    std::vector<KeyNamespace> namespaces;
+  };
+
+  absl::flat_hash_map<std::string, std::string> GetKeyValuePairs(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override;
+
+  GetKeyValuePairsResult GetKeyValuePairViews(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override;
+
+  GetKeyValuePairsResult GetHashedKeyValuePairViews(
+      const RequestContext& request_context,
+      absl::Span<const HashedKey> keys) const override;
+
+  absl::StatusOr<std::vector<std::string>> GetKeysByPrefix(
+      std::string_view key_prefix, int limit) const override;
+
+  absl::StatusOr<std::vector<std::string>> GetSetsContaining(
+      std::string_view member) const override;
+
+  std::unique_ptr<GetKeyValueSetResult> GetKeyValueSet(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override;
+
+  void UpdateKeyValue(std::string_view key, std::string_view value,
+                      int64_t logical_commit_time,
+                      std::string_view prefix = "") override;
+
+  void UpdateKeyValueSet(std::string_view key,
+                         absl::Span<std::string_view> value_set,
+                         int64_t logical_commit_time,
+                         std::string_view prefix = "") override;
+
+  void DeleteKey(std::string_view key, int64_t logical_commit_time,
+                 std::string_view prefix = "") override;
+
+  void DeleteValuesInSet(std::string_view key,
+                         absl::Span<std::string_view> value_set,
+                         int64_t logical_commit_time,
+                         std::string_view prefix = "") override;
+
+  void UpdateKeyValueUInt32Set(std::string_view key,
+                               absl::Span<const uint32_t> value_set,
+                               int64_t logical_commit_time,
+                               std::string_view prefix = "") override;
+
+  void DeleteValuesInUInt32Set(std::string_view key,
+                               absl::Span<const uint32_t> value_set,
+                               int64_t logical_commit_time,
+                               std::string_view prefix = "") override;
+
+  // Delegates the mutations of other keys to `cache` as one batch.
+  void ApplyMutations(absl::Span<const Mutation> mutations,
+                      std::string_view prefix = "") override;
+
+  void RemoveDeletedKeys(int64_t logical_commit_time,
+                         std::string_view prefix = "") override;
+
+  // The tables are cleaned up at once when `cache` is done.
+  CleanupProgress RemoveDeletedKeysSlice(int64_t logical_commit_time,
+                                         std::string_view prefix,
+                                         absl::Time deadline) override;
+
+  absl::Status ExportMutations(
+      absl::FunctionRef<void(std::string_view prefix,
+                             absl::Span<const Mutation> mutations)>
+          fn) const override;
+
+  // The tables are counted with prefix "".
+  absl::flat_hash_map<std::string, MemoryUsage> GetMemoryUsage()
+      const override;
+  std::string DebugMemoryReport(int num_largest) const override;
+
+  static std::unique_ptr<Cache> Create(std::unique_ptr<Cache> cache,
+                                       Options options);
+
+ private:
+  struct Namespace {
+    std::string key_prefix;
+    std::unique_ptr<FixedWidthKeyTable> table;
+  };
+
+  FixedWidthKeyCache(std::unique_ptr<Cache> cache, Options options);
+
+  // Returns the namespace that `key` starts with, and sets `native_key` to
+  // the rest of the key, or returns null.
+  const Namespace* FindNamespace(std::string_view key,
+                                 std::string_view& native_key) const;
+  // Looks up `key` in its table. Returns false if it belongs to `cache_`.
+  bool GetFromTable(std::string_view key,
+                    std::shared_ptr<const std::string>& value) const;
+
+  std::unique_ptr<Cache> cache_;
+  std::vector<Namespace> namespaces_;
+};
+
+// Parses namespaces listed as "<key prefix>=<type>" separated by commas,
+// where the type is "uint64" or "hash128", e.g. "uid:=uint64,h:=hash128".
+absl::StatusOr<std::vector<FixedWidthKeyCache::KeyNamespace>>
+ParseFixedWidthKeyNamespaces(std::string_view namespaces);
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_CACHE_FIXED_WIDTH_KEY_CACHE_H_
@@ -0,0 +1,166 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data_server/cache/fixed_width_key_cache.h"
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/str_cat.h"
+#include "components/data_server/cache/key_value_cache.h"
+#include "components/data_server/cache/mocks.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+using testing::ElementsAre;
+using testing::IsEmpty;
+using testing::UnorderedElementsAre;
+
+constexpr std::string_view kHash = "000102030405060708090a0b0c0d0e0f";
+
+class FixedWidthKeyCacheTest : public ::testing::Test {
+ protected:
+  FixedWidthKeyCacheTest() {
+    InitMetricsContextMap();
+    scope_metrics_context_ = std::make_unique<ScopeMetricsContext>();
+    request_context_ =
+        std::make_unique<RequestContext>(*scope_metrics_context_);
+    auto inner_cache = KeyValueCache::Create();
+    inner_cache_ = inner_cache.get();
+    cache_ = FixedWidthKeyCache::Create(
+        std::move(inner_cache),
+        {.namespaces = {{.key_prefix = "uid:",
+                         .key_type = FixedWidthKeyType::kUInt64},
+                        {.key_prefix = "h:",
+                         .key_type = FixedWidthKeyType::kHash128}}});
+  }
+
+  RequestContext& GetRequestContext() { return *request_context_; }
+
+  std::unique_ptr<ScopeMetricsContext> scope_metrics_context_;
+  std::unique_ptr<RequestContext> request_context_;
+  Cache* inner_cache_;
+  std::unique_ptr<Cache> cache_;
+};
+
+TEST_F(FixedWidthKeyCacheTest, KeepsNumericKeysInTables) {
+  const std::string hash_key = absl::StrCat("h:", kHash);
+  cache_->UpdateKeyValue("uid:12345", "v1", 1);
+  cache_->UpdateKeyValue(hash_key, "v2", 1);
+  cache_->UpdateKeyValue("other", "v3", 1);
+  absl::flat_hash_set<std::string_view> keys = {"uid:12345", hash_key,
+                                                "other", "uid:1"};
+  EXPECT_THAT(cache_->GetKeyValuePairs(GetRequestContext(), keys),
+              UnorderedElementsAre(KVPairEq("uid:12345", "v1"),
+                                   KVPairEq(hash_key, "v2"),
+                                   KVPairEq("other", "v3")));
+  // Only the other key reached the inner cache.
+  EXPECT_THAT(inner_cache_->GetKeyValuePairs(GetRequestContext(), keys),
+              UnorderedElementsAre(KVPairEq("other", "v3")));
+  const auto views = cache_->GetKeyValuePairViews(GetRequestContext(), keys);
+  EXPECT_EQ(views.size(), 3);
+}
+
+TEST_F(FixedWidthKeyCacheTest, NonCanonicalKeysAreKeptAsText) {
+  cache_->UpdateKeyValue("uid:0123", "v1", 1);
+  cache_->UpdateKeyValue("h:ABC", "v2", 1);
+  absl::flat_hash_set<std::string_view> keys = {"uid:0123", "uid:123",
+                                                "h:ABC"};
+  EXPECT_THAT(inner_cache_->GetKeyValuePairs(GetRequestContext(), keys),
+              UnorderedElementsAre(KVPairEq("uid:0123", "v1"),
+                                   KVPairEq("h:ABC", "v2")));
+  EXPECT_THAT(cache_->GetKeyValuePairs(GetRequestContext(), keys),
+              UnorderedElementsAre(KVPairEq("uid:0123", "v1"),
+                                   KVPairEq("h:ABC", "v2")));
+}
+
+TEST_F(FixedWidthKeyCacheTest, AppliesMutationsToTables) {
+  const std::vector<Cache::Mutation> mutations = {
+      {.type = Cache::Mutation::Type::kUpdateKeyValue,
+       .key = "uid:1",
+       .value = "v1",
+       .logical_commit_time = 1},
+      {.type = Cache::Mutation::Type::kUpdateKeyValue,
+       .key = "other",
+       .value = "v2",
+       .logical_commit_time = 1},
+      {.type = Cache::Mutation::Type::kDeleteKey,
+       .key = "uid:1",
+       .logical_commit_time = 2},
+  };
+  cache_->ApplyMutations(mutations);
+  absl::flat_hash_set<std::string_view> keys = {"uid:1", "other"};
+  EXPECT_THAT(cache_->GetKeyValuePairs(GetRequestContext(), keys),
+              UnorderedElementsAre(KVPairEq("other", "v2")));
+  // Older than the deletion.
+  cache_->UpdateKeyValue("uid:1", "v0", 1);
+  EXPECT_THAT(cache_->GetKeyValuePairs(GetRequestContext(), keys),
+              UnorderedElementsAre(KVPairEq("other", "v2")));
+  cache_->RemoveDeletedKeys(2);
+  cache_->UpdateKeyValue("uid:1", "v3", 3);
+  EXPECT_THAT(cache_->GetKeyValuePairs(GetRequestContext(), keys),
+              UnorderedElementsAre(KVPairEq("uid:1", "v3"),
+                                   KVPairEq("other", "v2")));
+}
+
+TEST_F(FixedWidthKeyCacheTest, SetsAreDelegated) {
+  std::vector<std::string_view> values = {"a", "b"};
+  cache_->UpdateKeyValueSet("uid:1", absl::MakeSpan(values), 1);
+  absl::flat_hash_set<std::string_view> keys = {"uid:1"};
+  EXPECT_THAT(cache_->GetKeyValueSet(GetRequestContext(), keys)
+                  ->GetValueSet("uid:1"),
+              UnorderedElementsAre("a", "b"));
+  EXPECT_THAT(cache_->GetKeyValuePairs(GetRequestContext(), keys), IsEmpty());
+}
+
+TEST_F(FixedWidthKeyCacheTest, ExportsTablesWithKeyPrefix) {
+  cache_->UpdateKeyValue("uid:7", "v1", 1);
+  std::vector<std::string> keys;
+  ASSERT_TRUE(cache_
+                  ->ExportMutations([&](std::string_view prefix,
+                                        absl::Span<const Cache::Mutation>
+                                            mutations) {
+                    for (const Cache::Mutation& mutation : mutations) {
+                      keys.emplace_back(mutation.key);
+                    }
+                  })
+                  .ok());
+  EXPECT_THAT(keys, ElementsAre("uid:7"));
+}
+
+TEST(ParseFixedWidthKeyNamespacesTest, ParsesNamespaces) {
+  const auto namespaces =
+      ParseFixedWidthKeyNamespaces("uid:=uint64, h:=hash128");
+  ASSERT_TRUE(namespaces.ok());
+  ASSERT_EQ(namespaces->size(), 2);
+  EXPECT_EQ((*namespaces)[0].key_prefix, "uid:");
+  EXPECT_EQ((*namespaces)[0].key_type, FixedWidthKeyType::kUInt64);
+  EXPECT_EQ((*namespaces)[1].key_prefix, "h:");
+  EXPECT_EQ((*namespaces)[1].key_type, FixedWidthKeyType::kHash128);
+  EXPECT_TRUE(ParseFixedWidthKeyNamespaces("")->empty());
+  EXPECT_FALSE(ParseFixedWidthKeyNamespaces("uid:").ok());
+  EXPECT_FALSE(ParseFixedWidthKeyNamespaces("uid:=int").ok());
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -0,0 +1,116 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data_server/cache/fixed_width_key_table.h"
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "absl/hash/hash.h"
+
+namespace kv_server {
+namespace {
+
+// Returns the value of a lowercase hexadecimal digit, or -1.
+int HexDigitValue(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  return -1;
+}
+
+}  // namespace
+
+std::optional<uint64_t> FixedWidthKeyTraits<uint64_t>::Decode(
+    std::string_view text) {
+  if (text.empty() || (text.size() > 1 && text[0] == '0')) {
+    return std::nullopt;
+  }
+  uint64_t value = 0;
+  for (const char c : text) {
+    if (c < '0' || c > '9') {
+      return std::nullopt;
+    }
+    const uint64_t digit = c - '0';
+    if (value > (std::numeric_limits<uint64_t>::max() - digit) / 10) {
+      return std::nullopt;
+    }
+    value = value * 10 + digit;
+  }
+  return value;
+}
+
+std::string FixedWidthKeyTraits<uint64_t>::Encode(uint64_t key) {
+  return std::to_string(key);
+}
+
+size_t FixedWidthKeyTraits<Hash128Key>::Hash::operator()(
+    const Hash128Key& key) const {
+  uint64_t high;
+  uint64_t low;
+  std::memcpy(&high, key.data(), sizeof(high));
+  std::memcpy(&low, key.data() + sizeof(high), sizeof(low));
+  return absl::Hash<std::pair<uint64_t, uint64_t>>()({high, low});
+}
+
+std::optional<Hash128Key> FixedWidthKeyTraits<Hash128Key>::Decode(
+    std::string_view text) {
+  Hash128Key key;
+  if (text.size() != 2 * key.size()) {
+    return std::nullopt;
+  }
+  for (size_t i = 0; i < key.size(); ++i) {
+    const int high = HexDigitValue(text[2 * i]);
+    const int low = HexDigitValue(text[2 * i + 1]);
+    if (high < 0 || low < 0) {
+      return std::nullopt;
+    }
+    key[i] = static_cast<uint8_t>(high << 4 | low);
+  }
+  return key;
+}
+
+std::string FixedWidthKeyTraits<Hash128Key>::Encode(const Hash128Key& key) {
+  static constexpr char kHexDigits[] = "0123456789abcdef";
+  std::string text(2 * key.size(), '0');
+  for (size_t i = 0; i < key.size(); ++i) {
+    text[2 * i] = kHexDigits[key[i] >> 4];
+    text[2 * i + 1] = kHexDigits[key[i] & 0xf];
+  }
+  return text;
+}
+
+std::unique_ptr<FixedWidthKeyTable> FixedWidthKeyTable::Create(
+    FixedWidthKeyType type) {
+  switch (type) {
+    case FixedWidthKeyType::kUInt64:
+      return std::make_unique<TypedFixedWidthKeyTable<uint64_t>>();
+    case FixedWidthKeyType::kHash128:
+      return std::make_unique<TypedFixedWidthKeyTable<Hash128Key>>();
+  }
+  return nullptr;
+}
+
+}  // namespace kv_server
@@ -0,0 +1,315 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_CACHE_FIXED_WIDTH_KEY_TABLE_H_
+#define COMPONENTS_DATA_SERVER_CACHE_FIXED_WIDTH_KEY_TABLE_H_
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/functional/function_ref.h"
+#include "absl/hash/hash.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+#include "components/data_server/cache/cache.h"
+
+namespace kv_server {
+
+// Native key types of the fixed width key tables.
+enum class FixedWidthKeyType {
+  // 64 bit unsigned integers, e.g. numeric ids.
+  kUInt64,
+  // 128 bit hashes.
+  kHash128,
+};
+
+using Hash128Key = std::array<uint8_t, 16>;
+
+// Native form of the keys of a `TypedFixedWidthKeyTable`, and their text form
+// in data files and lookups. Only canonical text decodes, so that every key
+// has a single text form.
+template <typename Key>
+struct FixedWidthKeyTraits;
+
+// Decimal, without leading zeros.
+template <>
+struct FixedWidthKeyTraits<uint64_t> {
+  using Hash = absl::Hash<uint64_t>;
+  static std::optional<uint64_t> Decode(std::string_view text);
+  static std::string Encode(uint64_t key);
+};
+
+// 32 lowercase hexadecimal digits.
+template <>
+struct FixedWidthKeyTraits<Hash128Key> {
+  // Hashes the key as two integers rather than as 16 bytes.
+  struct Hash {
+    size_t operator()(const Hash128Key& key) const;
+  };
+  static std::optional<Hash128Key> Decode(std::string_view text);
+  static std::string Encode(const Hash128Key& key);
+};
+
+// Key-value pairs whose keys decode to a fixed width native type, with the
+// ordering rules and tombstones of `KeyValueCache`. The keys are stored
+// inline in the hash table and hashed as integers, without string
+// allocations.
+//
+// Every method that takes a key returns false, without doing anything, if
+// the key isn't the canonical text of a native key. The caller keeps such
+// keys elsewhere.
+//
+// Thread safe.
+class FixedWidthKeyTable {
+ public:
+  virtual ~FixedWidthKeyTable() = default;
+
+  // Sets `value` to the value of `key`, or to null if the key has none.
+  virtual bool Get(std::string_view key,
+                   std::shared_ptr<const std::string>& value) const = 0;
+  virtual bool Update(std::string_view key, std::string_view value,
+                      int64_t logical_commit_time, std::string_view prefix) = 0;
+  virtual bool Delete(std::string_view key, int64_t logical_commit_time,
+                      std::string_view prefix) = 0;
+  // Removes the keys deleted at or before `logical_commit_time` for `prefix`.
+  virtual void RemoveDeleted(int64_t logical_commit_time,
+                             std::string_view prefix) = 0;
+
+  // Same as `Cache::ExportMutations`, with `key_prefix` prepended to the
+  // keys. The live keys are exported with prefix "".
+  virtual void Export(
+      std::string_view key_prefix,
+      absl::FunctionRef<void(std::string_view prefix,
+                             absl::Span<const Cache::Mutation> mutations)>
+          fn) const = 0;
+
+  // Adds the memory of the table to prefix "" of `memory_usage`.
+  virtual void AddMemoryUsage(
+      absl::flat_hash_map<std::string, Cache::MemoryUsage>& memory_usage)
+      const = 0;
+
+  static std::unique_ptr<FixedWidthKeyTable> Create(FixedWidthKeyType type);
+};
+
+template <typename Key>
+class TypedFixedWidthKeyTable final : public FixedWidthKeyTable {
+ public:
+  using Traits = FixedWidthKeyTraits<Key>;
+
+  bool Get(std::string_view key,
+           std::shared_ptr<const std::string>& value) const override {
+    const std::optional<Key> native_key = Traits::Decode(key);
+    if (!native_key.has_value()) {
+      return false;
+    }
+    absl::ReaderMutexLock lock(&mutex_);
+    const auto it = map_.find(*native_key);
+    value = it == map_.end() ? nullptr : it->second.value;
+    return true;
+  }
+
+  bool Update(std::string_view key, std::string_view value,
+              int64_t logical_commit_time, std::string_view prefix) override {
+    const std::optional<Key> native_key = Traits::Decode(key);
+    if (!native_key.has_value()) {
+      return false;
+    }
+    auto shared_value = std::make_shared<const std::string>(value);
+    absl::MutexLock lock(&mutex_);
+    WriteLocked(*native_key, std::move(shared_value), logical_commit_time,
+                prefix);
+    return true;
+  }
+
+  bool Delete(std::string_view key, int64_t logical_commit_time,
+              std::string_view prefix) override {
+    const std::optional<Key> native_key = Traits::Decode(key);
+    if (!native_key.has_value()) {
+      return false;
+    }
+    absl::MutexLock lock(&mutex_);
+    WriteLocked(*native_key, nullptr, logical_commit_time, prefix);
+    return true;
+  }
+
+  void RemoveDeleted(int64_t logical_commit_time,
+                     std::string_view prefix) override {
+    absl::MutexLock lock(&mutex_);
+    int64_t& max_cleanup_logical_commit_time =
+        max_cleanup_logical_commit_time_map_[prefix];
+    max_cleanup_logical_commit_time =
+        std::max(max_cleanup_logical_commit_time, logical_commit_time);
+    const auto deleted_keys = deleted_keys_map_.find(prefix);
+    if (deleted_keys == deleted_keys_map_.end()) {
+      return;
+    }
+    auto& keys_by_time = deleted_keys->second;
+    const auto end = keys_by_time.upper_bound(logical_commit_time);
+    for (auto it = keys_by_time.begin(); it != end; ++it) {
+      // Skips keys updated again after their deletion.
+      if (const auto map_it = map_.find(it->second);
+          map_it != map_.end() && map_it->second.value == nullptr &&
+          map_it->second.logical_commit_time == it->first) {
+        map_.erase(map_it);
+      }
+    }
+    num_tombstones_ -= std::distance(keys_by_time.begin(), end);
+    keys_by_time.erase(keys_by_time.begin(), end);
+  }
+
+  void Export(
+      std::string_view key_prefix,
+      absl::FunctionRef<void(std::string_view prefix,
+                             absl::Span<const Cache::Mutation> mutations)>
+          fn) const override {
+    // Copied under the lock, the values are shared.
+    std::vector<std::pair<Key, Entry>> live_entries;
+    std::vector<std::pair<std::string, std::vector<std::pair<Key, int64_t>>>>
+        deleted_keys;
+    {
+      absl::ReaderMutexLock lock(&mutex_);
+      live_entries.reserve(map_.size());
+      for (const auto& [key, entry] : map_) {
+        if (entry.value != nullptr) {
+          live_entries.emplace_back(key, entry);
+        }
+      }
+      for (const auto& [prefix, keys_by_time] : deleted_keys_map_) {
+        deleted_keys.emplace_back().first = prefix;
+        auto& keys = deleted_keys.back().second;
+        for (const auto& [logical_commit_time, key] : keys_by_time) {
+          if (const auto it = map_.find(key);
+              it != map_.end() && it->second.value == nullptr &&
+              it->second.logical_commit_time == logical_commit_time) {
+            keys.emplace_back(key, logical_commit_time);
+          }
+        }
+      }
+    }
+    // Reserved once, so that the mutations can view the keys of a batch.
+    std::vector<std::string> keys;
+    keys.reserve(kExportBatchSize);
+    std::vector<Cache::Mutation> mutations;
+    mutations.reserve(kExportBatchSize);
+    const auto flush = [&](std::string_view prefix) {
+      if (!mutations.empty()) {
+        fn(prefix, mutations);
+      }
+      keys.clear();
+      mutations.clear();
+    };
+    for (const auto& [key, entry] : live_entries) {
+      keys.push_back(absl::StrCat(key_prefix, Traits::Encode(key)));
+      mutations.push_back({.type = Cache::Mutation::Type::kUpdateKeyValue,
+                           .key = keys.back(),
+                           .value = *entry.value,
+                           .logical_commit_time = entry.logical_commit_time});
+      if (static_cast<int>(mutations.size()) == kExportBatchSize) {
+        flush("");
+      }
+    }
+    flush("");
+    for (const auto& [prefix, prefix_keys] : deleted_keys) {
+      for (const auto& [key, logical_commit_time] : prefix_keys) {
+        keys.push_back(absl::StrCat(key_prefix, Traits::Encode(key)));
+        mutations.push_back({.type = Cache::Mutation::Type::kDeleteKey,
+                             .key = keys.back(),
+                             .logical_commit_time = logical_commit_time});
+        if (static_cast<int>(mutations.size()) == kExportBatchSize) {
+          flush(prefix);
+        }
+      }
+      flush(prefix);
+    }
+  }
+
+  void AddMemoryUsage(absl::flat_hash_map<std::string, Cache::MemoryUsage>&
+                          memory_usage) const override {
+    absl::ReaderMutexLock lock(&mutex_);
+    Cache::MemoryUsage& usage = memory_usage[""];
+    usage.key_bytes += map_.size() * sizeof(Key);
+    usage.value_bytes += value_bytes_;
+    usage.tombstone_bytes +=
+        num_tombstones_ * (sizeof(Key) + sizeof(int64_t));
+    usage.hash_table_bytes +=
+        map_.capacity() * (sizeof(std::pair<const Key, Entry>) + 1);
+  }
+
+ private:
+  // Number of mutations passed at once by `Export`.
+  static constexpr int kExportBatchSize = 1024;
+
+  struct Entry {
+    // Null for deleted keys.
+    std::shared_ptr<const std::string> value;
+    int64_t logical_commit_time = 0;
+  };
+
+  void WriteLocked(const Key& key, std::shared_ptr<const std::string> value,
+                   int64_t logical_commit_time, std::string_view prefix)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    if (logical_commit_time <= max_cleanup_logical_commit_time_map_[prefix]) {
+      return;
+    }
+    auto [it, inserted] = map_.try_emplace(key);
+    Entry& entry = it->second;
+    if (!inserted) {
+      if (entry.logical_commit_time >= logical_commit_time) {
+        return;
+      }
+      if (entry.value != nullptr) {
+        value_bytes_ -= entry.value->size();
+      }
+    }
+    if (value == nullptr) {
+      // Keeps late updates from adding the key again until it is cleaned up.
+      deleted_keys_map_[prefix].emplace(logical_commit_time, key);
+      ++num_tombstones_;
+    } else {
+      value_bytes_ += value->size();
+    }
+    entry = Entry{.value = std::move(value),
+                  .logical_commit_time = logical_commit_time};
+  }
+
+  mutable absl::Mutex mutex_;
+  absl::flat_hash_map<Key, Entry, typename Traits::Hash> map_
+      ABSL_GUARDED_BY(mutex_);
+  // Deleted keys by prefix and time of deletion, for `RemoveDeleted`.
+  absl::flat_hash_map<std::string, std::multimap<int64_t, Key>>
+      deleted_keys_map_ ABSL_GUARDED_BY(mutex_);
+  absl::flat_hash_map<std::string, int64_t> max_cleanup_logical_commit_time_map_
+      ABSL_GUARDED_BY(mutex_);
+  int64_t value_bytes_ ABSL_GUARDED_BY(mutex_) = 0;
+  int64_t num_tombstones_ ABSL_GUARDED_BY(mutex_) = 0;
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_CACHE_FIXED_WIDTH_KEY_TABLE_H_
@@ -0,0 +1,170 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data_server/cache/fixed_width_key_table.h"
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+using testing::ElementsAre;
+using testing::Pair;
+
+TEST(FixedWidthKeyTraitsTest, UInt64DecodesCanonicalDecimal) {
+  using Traits = FixedWidthKeyTraits<uint64_t>;
+  EXPECT_EQ(Traits::Decode("0"), 0);
+  EXPECT_EQ(Traits::Decode("12345"), 12345);
+  EXPECT_EQ(Traits::Decode("18446744073709551615"), UINT64_MAX);
+  EXPECT_EQ(Traits::Decode(""), std::nullopt);
+  EXPECT_EQ(Traits::Decode("012"), std::nullopt);
+  EXPECT_EQ(Traits::Decode("+12"), std::nullopt);
+  EXPECT_EQ(Traits::Decode("-1"), std::nullopt);
+  EXPECT_EQ(Traits::Decode("12a"), std::nullopt);
+  EXPECT_EQ(Traits::Decode("18446744073709551616"), std::nullopt);
+  EXPECT_EQ(Traits::Encode(12345), "12345");
+}
+
+TEST(FixedWidthKeyTraitsTest, Hash128DecodesLowercaseHex) {
+  using Traits = FixedWidthKeyTraits<Hash128Key>;
+  const std::string text = "000102030405060708090a0b0c0d0eff";
+  const auto key = Traits::Decode(text);
+  ASSERT_TRUE(key.has_value());
+  EXPECT_EQ((*key)[0], 0x00);
+  EXPECT_EQ((*key)[10], 0x0a);
+  EXPECT_EQ((*key)[15], 0xff);
+  EXPECT_EQ(Traits::Encode(*key), text);
+  EXPECT_EQ(Traits::Decode("000102030405060708090A0B0C0D0EFF"), std::nullopt);
+  EXPECT_EQ(Traits::Decode("000102030405060708090a0b0c0d0e"), std::nullopt);
+  EXPECT_EQ(Traits::Decode("000102030405060708090a0b0c0d0eg0"), std::nullopt);
+}
+
+template <typename Key>
+class FixedWidthKeyTableTest : public ::testing::Test {
+ protected:
+  // Canonical text of the `i`th key.
+  static std::string KeyText(int i) {
+    if constexpr (std::is_same_v<Key, uint64_t>) {
+      return std::to_string(i);
+    } else {
+      Hash128Key key = {};
+      key[14] = static_cast<uint8_t>(i >> 8);
+      key[15] = static_cast<uint8_t>(i);
+      return FixedWidthKeyTraits<Hash128Key>::Encode(key);
+    }
+  }
+
+  static std::string Get(const FixedWidthKeyTable& table,
+                         std::string_view key) {
+    std::shared_ptr<const std::string> value;
+    EXPECT_TRUE(table.Get(key, value));
+    return value == nullptr ? "<none>" : *value;
+  }
+
+  TypedFixedWidthKeyTable<Key> table_;
+};
+
+using KeyTypes = ::testing::Types<uint64_t, Hash128Key>;
+TYPED_TEST_SUITE(FixedWidthKeyTableTest, KeyTypes);
+
+TYPED_TEST(FixedWidthKeyTableTest, NonCanonicalKeysAreRejected) {
+  std::shared_ptr<const std::string> value;
+  EXPECT_FALSE(this->table_.Update("x" + this->KeyText(1), "v", 1, ""));
+  EXPECT_FALSE(this->table_.Delete("x" + this->KeyText(1), 1, ""));
+  EXPECT_FALSE(this->table_.Get("x" + this->KeyText(1), value));
+}
+
+TYPED_TEST(FixedWidthKeyTableTest, KeepsNewestValue) {
+  const std::string key = this->KeyText(1);
+  EXPECT_EQ(this->Get(this->table_, key), "<none>");
+  EXPECT_TRUE(this->table_.Update(key, "v2", 2, ""));
+  EXPECT_TRUE(this->table_.Update(key, "v1", 1, ""));
+  EXPECT_EQ(this->Get(this->table_, key), "v2");
+  EXPECT_TRUE(this->table_.Update(key, "v3", 3, ""));
+  EXPECT_EQ(this->Get(this->table_, key), "v3");
+}
+
+TYPED_TEST(FixedWidthKeyTableTest, DeletionBlocksOlderUpdatesUntilCleanup) {
+  const std::string key = this->KeyText(1);
+  this->table_.Update(key, "v1", 1, "");
+  this->table_.Delete(key, 3, "");
+  this->table_.Update(key, "v2", 2, "");
+  EXPECT_EQ(this->Get(this->table_, key), "<none>");
+  this->table_.RemoveDeleted(3, "");
+  // Older than the cleanup.
+  this->table_.Update(key, "v2", 2, "");
+  EXPECT_EQ(this->Get(this->table_, key), "<none>");
+  this->table_.Update(key, "v4", 4, "");
+  EXPECT_EQ(this->Get(this->table_, key), "v4");
+}
+
+TYPED_TEST(FixedWidthKeyTableTest, CleanupIsPerPrefix) {
+  const std::string key = this->KeyText(1);
+  this->table_.Delete(key, 2, "a");
+  this->table_.RemoveDeleted(2, "b");
+  absl::flat_hash_map<std::string, Cache::MemoryUsage> memory_usage;
+  this->table_.AddMemoryUsage(memory_usage);
+  EXPECT_GT(memory_usage[""].tombstone_bytes, 0);
+  this->table_.RemoveDeleted(2, "a");
+  memory_usage.clear();
+  this->table_.AddMemoryUsage(memory_usage);
+  EXPECT_EQ(memory_usage[""].tombstone_bytes, 0);
+  EXPECT_EQ(memory_usage[""].key_bytes, 0);
+}
+
+TYPED_TEST(FixedWidthKeyTableTest, ExportsLiveAndDeletedKeys) {
+  this->table_.Update(this->KeyText(1), "v1", 1, "");
+  this->table_.Update(this->KeyText(2), "v2", 2, "");
+  this->table_.Delete(this->KeyText(2), 3, "a");
+  std::vector<std::pair<std::string, std::string>> updates;
+  std::vector<std::pair<std::string, std::string>> deletions;
+  this->table_.Export(
+      "k:", [&](std::string_view prefix,
+                absl::Span<const Cache::Mutation> mutations) {
+        for (const Cache::Mutation& mutation : mutations) {
+          if (mutation.type == Cache::Mutation::Type::kUpdateKeyValue) {
+            EXPECT_EQ(prefix, "");
+            updates.emplace_back(mutation.key, mutation.value);
+          } else {
+            deletions.emplace_back(prefix, mutation.key);
+          }
+        }
+      });
+  EXPECT_THAT(updates, ElementsAre(Pair("k:" + this->KeyText(1), "v1")));
+  EXPECT_THAT(deletions, ElementsAre(Pair("a", "k:" + this->KeyText(2))));
+}
+
+TYPED_TEST(FixedWidthKeyTableTest, ExportsLargeTablesInBatches) {
+  for (int i = 0; i < 2000; ++i) {
+    this->table_.Update(this->KeyText(i), "v", 1, "");
+  }
+  std::vector<int> batch_sizes;
+  this->table_.Export("", [&](std::string_view prefix,
+                              absl::Span<const Cache::Mutation> mutations) {
+    batch_sizes.push_back(mutations.size());
+  });
+  EXPECT_THAT(batch_sizes, ElementsAre(1024, 976));
+}
+
+}  // namespace
+}  // namespace kv_server
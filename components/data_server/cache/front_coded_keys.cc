@@ -0,0 +1,172 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data_server/cache/front_coded_keys.h"
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/log/check.h"
+
+namespace kv_server {
+namespace {
+
+void PutVarint(uint64_t value, std::string& out) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<char>(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+// Reads a varint at `pos` of `data`, and moves `pos` past it.
+uint64_t GetVarint(std::string_view data, size_t& pos) {
+  uint64_t value = 0;
+  for (int shift = 0;; shift += 7) {
+    const uint8_t byte = static_cast<uint8_t>(data[pos++]);
+    value |= uint64_t{byte & 0x7fu} << shift;
+    if (byte < 0x80) {
+      return value;
+    }
+  }
+}
+
+size_t CommonPrefixLength(std::string_view a, std::string_view b) {
+  const size_t size = std::min(a.size(), b.size());
+  size_t i = 0;
+  while (i < size && a[i] == b[i]) {
+    ++i;
+  }
+  return i;
+}
+
+}  // namespace
+
+void FrontCodedKeys::Builder::Add(std::string_view key) {
+  DCHECK(size_ == 0 || key > previous_key_)
+      << "Keys must be added in increasing order";
+  if (size_ % kBlockSize == 0) {
+    block_offsets_.push_back(data_.size());
+    PutVarint(key.size(), data_);
+    data_.append(key);
+  } else {
+    const size_t shared = CommonPrefixLength(previous_key_, key);
+    PutVarint(shared, data_);
+    PutVarint(key.size() - shared, data_);
+    data_.append(key.substr(shared));
+  }
+  previous_key_.assign(key);
+  ++size_;
+}
+
+FrontCodedKeys FrontCodedKeys::Builder::Build() && {
+  data_.shrink_to_fit();
+  block_offsets_.shrink_to_fit();
+  return FrontCodedKeys(std::move(data_), std::move(block_offsets_), size_);
+}
+
+FrontCodedKeys::FrontCodedKeys(std::string data,
+                               std::vector<uint64_t> block_offsets,
+                               int64_t size)
+    : data_(std::move(data)),
+      block_offsets_(std::move(block_offsets)),
+      size_(size) {}
+
+std::string_view FrontCodedKeys::FirstKey(int64_t block) const {
+  size_t pos = block_offsets_[block];
+  const uint64_t size = GetVarint(data_, pos);
+  return std::string_view(data_).substr(pos, size);
+}
+
+std::optional<int64_t> FrontCodedKeys::Find(std::string_view key) const {
+  // The last block whose first key isn't greater than `key`.
+  int64_t low = 0;
+  int64_t high = block_offsets_.size();
+  while (low < high) {
+    const int64_t middle = low + (high - low) / 2;
+    if (FirstKey(middle) <= key) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  if (low == 0) {
+    return std::nullopt;
+  }
+  const int64_t block = low - 1;
+  const std::string_view data(data_);
+  size_t pos = block_offsets_[block];
+  const uint64_t first_key_size = GetVarint(data, pos);
+  const std::string_view first_key = data.substr(pos, first_key_size);
+  pos += first_key_size;
+  if (first_key == key) {
+    return block * kBlockSize;
+  }
+  // Length of the prefix that the previous key shares with `key`, which is
+  // greater than the previous key. Keys are compared without decoding them:
+  // a key that shares less of the previous key is greater than `key`, and one
+  // that shares more is still less than it.
+  size_t matched = CommonPrefixLength(first_key, key);
+  const int64_t block_end = std::min<int64_t>((block + 1) * kBlockSize, size_);
+  for (int64_t id = block * kBlockSize + 1; id < block_end; ++id) {
+    const uint64_t shared = GetVarint(data, pos);
+    const uint64_t suffix_size = GetVarint(data, pos);
+    const std::string_view suffix = data.substr(pos, suffix_size);
+    pos += suffix_size;
+    if (shared > matched) {
+      continue;
+    }
+    if (shared < matched) {
+      return std::nullopt;
+    }
+    const std::string_view rest = key.substr(matched);
+    const size_t common = CommonPrefixLength(suffix, rest);
+    if (common == suffix.size() && common == rest.size()) {
+      return id;
+    }
+    if (common == rest.size() ||
+        (common < suffix.size() && suffix[common] > rest[common])) {
+      return std::nullopt;
+    }
+    matched += common;
+  }
+  return std::nullopt;
+}
+
+void FrontCodedKeys::ForEach(
+    absl::FunctionRef<void(int64_t id, std::string_view key)> fn) const {
+  const std::string_view data(data_);
+  std::string key;
+  size_t pos = 0;
+  for (int64_t id = 0; id < size_; ++id) {
+    if (id % kBlockSize == 0) {
+      const uint64_t size = GetVarint(data, pos);
+      key.assign(data.substr(pos, size));
+      pos += size;
+    } else {
+      const uint64_t shared = GetVarint(data, pos);
+      const uint64_t suffix_size = GetVarint(data, pos);
+      key.resize(shared);
+      key.append(data.substr(pos, suffix_size));
+      pos += suffix_size;
+    }
+    fn(id, key);
+  }
+}
+
+}  // namespace kv_server
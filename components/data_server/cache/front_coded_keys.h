@@ -0,0 +1,90 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_CACHE_FRONT_CODED_KEYS_H_
+#define COMPONENTS_DATA_SERVER_CACHE_FRONT_CODED_KEYS_H_
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/functional/function_ref.h"
+
+namespace kv_server {
+
+// Immutable dictionary of sorted, distinct keys, which maps every key to its
+// rank, a dense id.
+//
+// Keys are front coded in blocks of `kBlockSize`: the first key of a block is
+// stored whole, and every other key as the length of the prefix it shares
+// with the previous key followed by the rest of it. Keys with long shared
+// prefixes, like URLs of the same site, take a fraction of their size. A
+// lookup binary searches the first keys of the blocks, then scans one block
+// without decoding its keys.
+//
+// Thread-safe once built.
+class FrontCodedKeys {
+ public:
+  static constexpr int kBlockSize = 16;
+
+  // Adds keys in increasing order.
+  class Builder {
+   public:
+    // `key` must be greater than the keys added before.
+    void Add(std::string_view key);
+    FrontCodedKeys Build() &&;
+
+   private:
+    std::string data_;
+    std::vector<uint64_t> block_offsets_;
+    std::string previous_key_;
+    int64_t size_ = 0;
+  };
+
+  FrontCodedKeys() = default;
+
+  // Returns the id of `key`, or nothing if it is missing.
+  std::optional<int64_t> Find(std::string_view key) const;
+
+  // Calls `fn` with the id and key of every key, in order. The key is only
+  // valid during the call.
+  void ForEach(absl::FunctionRef<void(int64_t id, std::string_view key)> fn)
+      const;
+
+  int64_t size() const { return size_; }
+  // Bytes of the encoded keys and of the block index.
+  int64_t memory_bytes() const {
+    return data_.capacity() + block_offsets_.capacity() * sizeof(uint64_t);
+  }
+
+ private:
+  FrontCodedKeys(std::string data, std::vector<uint64_t> block_offsets,
+                 int64_t size);
+
+  // Returns the first key of `block`.
+  std::string_view FirstKey(int64_t block) const;
+
+  std::string data_;
+  // Offset of every block in `data_`.
+  std::vector<uint64_t> block_offsets_;
+  int64_t size_ = 0;
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_CACHE_FRONT_CODED_KEYS_H_
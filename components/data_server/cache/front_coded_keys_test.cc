@@ -0,0 +1,129 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data_server/cache/front_coded_keys.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+using testing::ElementsAreArray;
+using testing::Optional;
+
+FrontCodedKeys Build(const std::vector<std::string>& keys) {
+  FrontCodedKeys::Builder builder;
+  for (const auto& key : keys) {
+    builder.Add(key);
+  }
+  return std::move(builder).Build();
+}
+
+TEST(FrontCodedKeysTest, EmptyDictionaryHasNoKeys) {
+  const FrontCodedKeys keys = Build({});
+  EXPECT_EQ(keys.size(), 0);
+  EXPECT_EQ(keys.Find(""), std::nullopt);
+  EXPECT_EQ(keys.Find("key"), std::nullopt);
+}
+
+TEST(FrontCodedKeysTest, FindsEveryKeyByRank) {
+  // Keys that are prefixes of others, and keys around the added ones.
+  std::vector<std::string> sorted_keys = {"", "a", "ab", "abc", "abd", "b"};
+  for (int i = 0; i < 100; ++i) {
+    sorted_keys.push_back(absl::StrCat("https://ads.example.com/creative/", i));
+    sorted_keys.push_back(
+        absl::StrCat("https://ads.example.com/creative/", i, "/"));
+  }
+  std::sort(sorted_keys.begin(), sorted_keys.end());
+  const FrontCodedKeys keys = Build(sorted_keys);
+  EXPECT_EQ(keys.size(), sorted_keys.size());
+  for (int i = 0; i < static_cast<int>(sorted_keys.size()); ++i) {
+    EXPECT_THAT(keys.Find(sorted_keys[i]), Optional(i)) << sorted_keys[i];
+  }
+  for (std::string_view missing :
+       {"aa", "abcd", "ac", "c", "https://ads.example.com/creative/",
+        "https://ads.example.com/creative/1/0",
+        "https://ads.example.com/creative/100", "https://ads.example.com/c"}) {
+    EXPECT_EQ(keys.Find(missing), std::nullopt) << missing;
+  }
+}
+
+TEST(FrontCodedKeysTest, FindsRandomKeys) {
+  std::mt19937 random(42);
+  std::vector<std::string> sorted_keys;
+  for (int i = 0; i < 1000; ++i) {
+    std::string key = "prefix/";
+    const int size = random() % 8;
+    for (int j = 0; j < size; ++j) {
+      key.push_back('a' + random() % 3);
+    }
+    sorted_keys.push_back(std::move(key));
+  }
+  std::sort(sorted_keys.begin(), sorted_keys.end());
+  sorted_keys.erase(std::unique(sorted_keys.begin(), sorted_keys.end()),
+                    sorted_keys.end());
+  // Every other key is left out, to be looked up as missing.
+  std::vector<std::string> added_keys;
+  for (int i = 0; i < static_cast<int>(sorted_keys.size()); i += 2) {
+    added_keys.push_back(sorted_keys[i]);
+  }
+  const FrontCodedKeys keys = Build(added_keys);
+  for (int i = 0; i < static_cast<int>(sorted_keys.size()); ++i) {
+    if (i % 2 == 0) {
+      EXPECT_THAT(keys.Find(sorted_keys[i]), Optional(i / 2));
+    } else {
+      EXPECT_EQ(keys.Find(sorted_keys[i]), std::nullopt);
+    }
+  }
+}
+
+TEST(FrontCodedKeysTest, ForEachDecodesKeysInOrder) {
+  std::vector<std::string> sorted_keys;
+  for (int i = 0; i < 40; ++i) {
+    sorted_keys.push_back(absl::StrCat("key", 100 + i));
+  }
+  const FrontCodedKeys keys = Build(sorted_keys);
+  std::vector<std::string> decoded_keys;
+  keys.ForEach([&decoded_keys](int64_t id, std::string_view key) {
+    EXPECT_EQ(id, decoded_keys.size());
+    decoded_keys.emplace_back(key);
+  });
+  EXPECT_THAT(decoded_keys, ElementsAreArray(sorted_keys));
+}
+
+TEST(FrontCodedKeysTest, SharedPrefixesAreStoredOnce) {
+  std::vector<std::string> sorted_keys;
+  int64_t key_bytes = 0;
+  for (int i = 0; i < 1000; ++i) {
+    sorted_keys.push_back(
+        absl::StrCat("https://ads.example.com/creative/", 1000 + i));
+    key_bytes += sorted_keys.back().size();
+  }
+  const FrontCodedKeys keys = Build(sorted_keys);
+  EXPECT_LT(keys.memory_bytes(), key_bytes / 4);
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -0,0 +1,286 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/data_server/cache/generational_cache.h"
+
+#include <cstdint>
+#include <optional>
+#include <utility>
+
+#include "absl/log/log.h"
+#include "absl/memory/memory.h"
+#include "absl/time/clock.h"
+#include "components/telemetry/server_definition.h"
+
+namespace kv_server {
+namespace {
+
+// How often `SwapGenerations` checks whether the previous generation is
+// still referenced by lookup results.
+constexpr absl::Duration kReleasePollInterval = absl::Milliseconds(10);
+
+// Result that keeps the generation it was read from alive.
+class GenerationResult : public GetKeyValueSetResult {
+ public:
+  GenerationResult(std::shared_ptr<const Cache> generation,
+                   std::unique_ptr<GetKeyValueSetResult> result)
+      : generation_(std::move(generation)), result_(std::move(result)) {}
+
+  absl::flat_hash_set<std::string_view> GetValueSet(
+      std::string_view key) const override {
+    return result_->GetValueSet(key);
+  }
+  std::shared_ptr<const absl::flat_hash_set<std::string_view>>
+  GetValueSetSnapshot(std::string_view key) const override {
+    return result_->GetValueSetSnapshot(key);
+  }
+  bool HasValueBitmaps() const override { return result_->HasValueBitmaps(); }
+  IdBitmap GetValueBitmap(std::string_view key) const override {
+    return result_->GetValueBitmap(key);
+  }
+  std::string_view GetValueForId(uint32_t id) const override {
+    return result_->GetValueForId(id);
+  }
+  std::optional<uint64_t> GetValueSetVersion(
+      std::string_view key) const override {
+    return result_->GetValueSetVersion(key);
+  }
+
+ private:
+  // The wrapped result is complete, nothing is added to this one.
+  void AddKeyValueSet(
+      std::string_view key, absl::flat_hash_set<std::string_view> value_set,
+      std::unique_ptr<absl::ReaderMutexLock> key_lock) override {}
+  void AddKeyValueSetSnapshot(
+      std::string_view key,
+      std::shared_ptr<const absl::flat_hash_set<std::string_view>> value_set)
+      override {}
+
+  // Declared first so that it outlives the result.
+  std::shared_ptr<const Cache> generation_;
+  std::unique_ptr<GetKeyValueSetResult> result_;
+};
+
+}  // namespace
+
+GenerationalCache::GenerationalCache(
+    absl::AnyInvocable<std::unique_ptr<Cache>()> cache_factory)
+    : cache_factory_(std::move(cache_factory)), current_(cache_factory_()) {}
+
+std::shared_ptr<const Cache> GenerationalCache::GetCurrentGeneration() const {
+  absl::ReaderMutexLock lock(&mutex_);
+  return current_;
+}
+
+absl::flat_hash_map<std::string, std::string>
+GenerationalCache::GetKeyValuePairs(
+    const RequestContext& request_context,
+    const absl::flat_hash_set<std::string_view>& key_set) const {
+  return GetCurrentGeneration()->GetKeyValuePairs(request_context, key_set);
+}
+
+GetKeyValuePairsResult GenerationalCache::GetKeyValuePairViews(
+    const RequestContext& request_context,
+    const absl::flat_hash_set<std::string_view>& key_set) const {
+  // Views share ownership of their values, not of the generation.
+  return GetCurrentGeneration()->GetKeyValuePairViews(request_context,
+                                                      key_set);
+}
+
+GetKeyValuePairsResult GenerationalCache::GetHashedKeyValuePairViews(
+    const RequestContext& request_context,
+    absl::Span<const HashedKey> keys) const {
+  return GetCurrentGeneration()->GetHashedKeyValuePairViews(request_context,
+                                                            keys);
+}
+
+std::unique_ptr<GetKeyValueSetResult> GenerationalCache::GetKeyValueSet(
+    const RequestContext& request_context,
+    const absl::flat_hash_set<std::string_view>& key_set) const {
+  std::shared_ptr<const Cache> generation = GetCurrentGeneration();
+  auto result = generation->GetKeyValueSet(request_context, key_set);
+  return std::make_unique<GenerationResult>(std::move(generation),
+                                            std::move(result));
+}
+
+absl::StatusOr<std::vector<std::string>> GenerationalCache::GetKeysByPrefix(
+    std::string_view key_prefix, int limit) const {
+  return GetCurrentGeneration()->GetKeysByPrefix(key_prefix, limit);
+}
+
+absl::StatusOr<std::vector<std::string>> GenerationalCache::GetSetsContaining(
+    std::string_view member) const {
+  return GetCurrentGeneration()->GetSetsContaining(member);
+}
+
+void GenerationalCache::UpdateKeyValue(std::string_view key,
+                                       std::string_view value,
+                                       int64_t logical_commit_time,
+                                       std::string_view prefix) {
+  absl::ReaderMutexLock lock(&mutex_);
+  current_->UpdateKeyValue(key, value, logical_commit_time, prefix);
+  if (next_ != nullptr) {
+    next_->UpdateKeyValue(key, value, logical_commit_time, prefix);
+  }
+}
+
+void GenerationalCache::UpdateKeyValueSet(
+    std::string_view key, absl::Span<std::string_view> value_set,
+    int64_t logical_commit_time, std::string_view prefix) {
+  absl::ReaderMutexLock lock(&mutex_);
+  current_->UpdateKeyValueSet(key, value_set, logical_commit_time, prefix);
+  if (next_ != nullptr) {
+    next_->UpdateKeyValueSet(key, value_set, logical_commit_time, prefix);
+  }
+}
+
+void GenerationalCache::DeleteKey(std::string_view key,
+                                  int64_t logical_commit_time,
+                                  std::string_view prefix) {
+  absl::ReaderMutexLock lock(&mutex_);
+  current_->DeleteKey(key, logical_commit_time, prefix);
+  if (next_ != nullptr) {
+    next_->DeleteKey(key, logical_commit_time, prefix);
+  }
+}
+
+void GenerationalCache::DeleteValuesInSet(
+    std::string_view key, absl::Span<std::string_view> value_set,
+    int64_t logical_commit_time, std::string_view prefix) {
+  absl::ReaderMutexLock lock(&mutex_);
+  current_->DeleteValuesInSet(key, value_set, logical_commit_time, prefix);
+  if (next_ != nullptr) {
+    next_->DeleteValuesInSet(key, value_set, logical_commit_time, prefix);
+  }
+}
+
+void GenerationalCache::UpdateKeyValueUInt32Set(
+    std::string_view key, absl::Span<const uint32_t> value_set,
+    int64_t logical_commit_time, std::string_view prefix) {
+  absl::ReaderMutexLock lock(&mutex_);
+  current_->UpdateKeyValueUInt32Set(key, value_set, logical_commit_time,
+                                    prefix);
+  if (next_ != nullptr) {
+    next_->UpdateKeyValueUInt32Set(key, value_set, logical_commit_time,
+                                   prefix);
+  }
+}
+
+void GenerationalCache::DeleteValuesInUInt32Set(
+    std::string_view key, absl::Span<const uint32_t> value_set,
+    int64_t logical_commit_time, std::string_view prefix) {
+  absl::ReaderMutexLock lock(&mutex_);
+  current_->DeleteValuesInUInt32Set(key, value_set, logical_commit_time,
+                                    prefix);
+  if (next_ != nullptr) {
+    next_->DeleteValuesInUInt32Set(key, value_set, logical_commit_time,
+                                   prefix);
+  }
+}
+
+void GenerationalCache::ApplyMutations(absl::Span<const Mutation> mutations,
+                                       std::string_view prefix) {
+  absl::ReaderMutexLock lock(&mutex_);
+  current_->ApplyMutations(mutations, prefix);
+  if (next_ != nullptr) {
+    next_->ApplyMutations(mutations, prefix);
+  }
+}
+
+void GenerationalCache::RemoveDeletedKeys(int64_t logical_commit_time,
+                                          std::string_view prefix) {
+  absl::ReaderMutexLock lock(&mutex_);
+  current_->RemoveDeletedKeys(logical_commit_time, prefix);
+  if (next_ != nullptr) {
+    next_->RemoveDeletedKeys(logical_commit_time, prefix);
+  }
+}
+
+Cache::CleanupProgress GenerationalCache::RemoveDeletedKeysSlice(
+    int64_t logical_commit_time, std::string_view prefix,
+    absl::Time deadline) {
+  absl::ReaderMutexLock lock(&mutex_);
+  CleanupProgress progress =
+      current_->RemoveDeletedKeysSlice(logical_commit_time, prefix, deadline);
+  if (next_ != nullptr) {
+    const CleanupProgress next_progress =
+        next_->RemoveDeletedKeysSlice(logical_commit_time, prefix, deadline);
+    progress.done = progress.done && next_progress.done;
+    progress.remaining_deleted_values += next_progress.remaining_deleted_values;
+  }
+  return progress;
+}
+
+absl::Status GenerationalCache::ExportMutations(
+    absl::FunctionRef<void(std::string_view prefix,
+                           absl::Span<const Mutation> mutations)>
+        fn) const {
+  return GetCurrentGeneration()->ExportMutations(fn);
+}
+
+absl::flat_hash_map<std::string, Cache::MemoryUsage>
+GenerationalCache::GetMemoryUsage() const {
+  return GetCurrentGeneration()->GetMemoryUsage();
+}
+
+std::string GenerationalCache::DebugMemoryReport(int num_largest) const {
+  return GetCurrentGeneration()->DebugMemoryReport(num_largest);
+}
+
+Cache& GenerationalCache::StartNextGeneration() {
+  std::shared_ptr<Cache> next = cache_factory_();
+  Cache& next_ref = *next;
+  std::shared_ptr<Cache> abandoned;
+  {
+    absl::MutexLock lock(&mutex_);
+    abandoned = std::exchange(next_, std::move(next));
+  }
+  return next_ref;
+}
+
+void GenerationalCache::SwapGenerations() {
+  std::shared_ptr<Cache> previous;
+  {
+    // Waits for the mutations in flight, which are applied to both
+    // generations.
+    ScopeLatencyMetricsRecorder<ServerSafeMetricsContext,
+                                kCacheGenerationSwapLatency>
+        latency_recorder(KVServerContextMap()->SafeMetric());
+    absl::MutexLock lock(&mutex_);
+    if (next_ == nullptr) {
+      return;
+    }
+    previous = std::exchange(current_, std::move(next_));
+  }
+  LOG(INFO) << "Swapped in the next cache generation";
+  while (previous.use_count() > 1) {
+    absl::SleepFor(kReleasePollInterval);
+  }
+  previous.reset();
+  LOG(INFO) << "Destroyed the previous cache generation";
+}
+
+void GenerationalCache::AbandonNextGeneration() {
+  std::shared_ptr<Cache> abandoned;
+  absl::MutexLock lock(&mutex_);
+  abandoned = std::move(next_);
+  next_ = nullptr;
+}
+
+std::unique_ptr<GenerationalCache> GenerationalCache::Create(
+    absl::AnyInvocable<std::unique_ptr<Cache>()> cache_factory) {
+  return absl::WrapUnique(new GenerationalCache(std::move(cache_factory)));
+}
+
+}  // namespace kv_server
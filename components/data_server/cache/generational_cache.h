@@ -0,0 +1,148 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_CACHE_GENERATIONAL_CACHE_H_
+#define COMPONENTS_DATA_SERVER_CACHE_GENERATIONAL_CACHE_H_
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/functional/any_invocable.h"
+#include "absl/synchronization/mutex.h"
+#include "components/data_server/cache/cache.h"
+
+namespace kv_server {
+
+// Cache that serves lookups from its current generation, while a next
+// generation can be built from scratch, e.g. from a new snapshot, and then
+// swapped in. Rebuilding drops the tombstones and fragmentation that the
+// current generation accumulated.
+//
+// While the next generation is built, every mutation is applied to both
+// generations, so the next one only has to be loaded with the data that the
+// current one got before. Lookup results keep the generation they were read
+// from alive.
+class GenerationalCache : public Cache {
+ public:
+  absl::flat_hash_map<std::string, std::string> GetKeyValuePairs(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override;
+
+  GetKeyValuePairsResult GetKeyValuePairViews(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override;
+
+  GetKeyValuePairsResult GetHashedKeyValuePairViews(
+      const RequestContext& request_context,
+      absl::Span<const HashedKey> keys) const override;
+
+  std::unique_ptr<GetKeyValueSetResult> GetKeyValueSet(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override;
+
+  absl::StatusOr<std::vector<std::string>> GetKeysByPrefix(
+      std::string_view key_prefix, int limit) const override;
+
+  absl::StatusOr<std::vector<std::string>> GetSetsContaining(
+      std::string_view member) const override;
+
+  void UpdateKeyValue(std::string_view key, std::string_view value,
+                      int64_t logical_commit_time,
+                      std::string_view prefix = "") override;
+
+  void UpdateKeyValueSet(std::string_view key,
+                         absl::Span<std::string_view> value_set,
+                         int64_t logical_commit_time,
+                         std::string_view prefix = "") override;
+
+  void DeleteKey(std::string_view key, int64_t logical_commit_time,
+                 std::string_view prefix = "") override;
+
+  void DeleteValuesInSet(std::string_view key,
+                         absl::Span<std::string_view> value_set,
+                         int64_t logical_commit_time,
+                         std::string_view prefix = "") override;
+
+  void UpdateKeyValueUInt32Set(std::string_view key,
+                               absl::Span<const uint32_t> value_set,
+                               int64_t logical_commit_time,
+                               std::string_view prefix = "") override;
+
+  void DeleteValuesInUInt32Set(std::string_view key,
+                               absl::Span<const uint32_t> value_set,
+                               int64_t logical_commit_time,
+                               std::string_view prefix = "") override;
+
+  void ApplyMutations(absl::Span<const Mutation> mutations,
+                      std::string_view prefix = "") override;
+
+  void RemoveDeletedKeys(int64_t logical_commit_time,
+                         std::string_view prefix = "") override;
+
+  // Cleans up both generations, the result is done once both are.
+  CleanupProgress RemoveDeletedKeysSlice(int64_t logical_commit_time,
+                                         std::string_view prefix,
+                                         absl::Time deadline) override;
+
+  // Exports the current generation.
+  absl::Status ExportMutations(
+      absl::FunctionRef<void(std::string_view prefix,
+                             absl::Span<const Mutation> mutations)>
+          fn) const override;
+
+  // Returns the memory usage of the current generation.
+  absl::flat_hash_map<std::string, MemoryUsage> GetMemoryUsage()
+      const override;
+  std::string DebugMemoryReport(int num_largest) const override;
+
+  // Starts a new, empty next generation, replacing the one that was being
+  // built if any. Returns it to be loaded. It stays valid until
+  // `SwapGenerations` or `AbandonNextGeneration`.
+  Cache& StartNextGeneration() ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Makes the next generation current. Blocks until the lookup results of the
+  // previous generation are released, and destroys it on the calling thread.
+  // No-op if no next generation was started.
+  void SwapGenerations() ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Drops the next generation, e.g. because it failed to load.
+  void AbandonNextGeneration() ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // `cache_factory` creates the generations.
+  static std::unique_ptr<GenerationalCache> Create(
+      absl::AnyInvocable<std::unique_ptr<Cache>()> cache_factory);
+
+ private:
+  explicit GenerationalCache(
+      absl::AnyInvocable<std::unique_ptr<Cache>()> cache_factory);
+
+  std::shared_ptr<const Cache> GetCurrentGeneration() const
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  absl::AnyInvocable<std::unique_ptr<Cache>()> cache_factory_;
+  // Mutations hold a reader lock while they are applied, so that a started
+  // next generation doesn't miss any of them. Lookups only hold it to take a
+  // reference to the current generation.
+  mutable absl::Mutex mutex_;
+  std::shared_ptr<Cache> current_ ABSL_GUARDED_BY(mutex_);
+  std::shared_ptr<Cache> next_ ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_CACHE_GENERATIONAL_CACHE_H_
@@ -0,0 +1,135 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/data_server/cache/generational_cache.h"
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "absl/synchronization/notification.h"
+#include "components/data_server/cache/key_value_cache.h"
+#include "components/data_server/cache/mocks.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+using testing::UnorderedElementsAre;
+
+class GenerationalCacheTest : public ::testing::Test {
+ protected:
+  GenerationalCacheTest() {
+    InitMetricsContextMap();
+    scope_metrics_context_ = std::make_unique<ScopeMetricsContext>();
+    request_context_ =
+        std::make_unique<RequestContext>(*scope_metrics_context_);
+  }
+  std::unique_ptr<GenerationalCache> CreateCache() {
+    return GenerationalCache::Create([] { return KeyValueCache::Create(); });
+  }
+  RequestContext& GetRequestContext() { return *request_context_; }
+  std::unique_ptr<ScopeMetricsContext> scope_metrics_context_;
+  std::unique_ptr<RequestContext> request_context_;
+};
+
+TEST_F(GenerationalCacheTest, NextGenerationServesLookupsAfterSwap) {
+  auto cache = CreateCache();
+  cache->UpdateKeyValue("old_key", "old_value", 1);
+  Cache& next = cache->StartNextGeneration();
+  next.UpdateKeyValue("new_key", "new_value", 1);
+  // The next generation isn't served before the swap.
+  EXPECT_THAT(
+      cache->GetKeyValuePairs(GetRequestContext(), {"old_key", "new_key"}),
+      UnorderedElementsAre(KVPairEq("old_key", "old_value")));
+  cache->SwapGenerations();
+  EXPECT_THAT(
+      cache->GetKeyValuePairs(GetRequestContext(), {"old_key", "new_key"}),
+      UnorderedElementsAre(KVPairEq("new_key", "new_value")));
+}
+
+TEST_F(GenerationalCacheTest, MutationsReachBothGenerationsWhileBuilding) {
+  auto cache = CreateCache();
+  cache->StartNextGeneration();
+  std::vector<std::string_view> values = {"v1", "v2"};
+  cache->UpdateKeyValue("key1", "value1", 1);
+  cache->UpdateKeyValueSet("key2", absl::MakeSpan(values), 1);
+  cache->DeleteKey("key3", 2);
+  const std::vector<Cache::Mutation> mutations = {
+      {.type = Cache::Mutation::Type::kUpdateKeyValue,
+       .key = "key4",
+       .value = "value4",
+       .logical_commit_time = 1}};
+  cache->ApplyMutations(mutations);
+  cache->SwapGenerations();
+  EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(),
+                                      {"key1", "key3", "key4"}),
+              UnorderedElementsAre(KVPairEq("key1", "value1"),
+                                   KVPairEq("key4", "value4")));
+  EXPECT_THAT(cache->GetKeyValueSet(GetRequestContext(), {"key2"})
+                  ->GetValueSet("key2"),
+              UnorderedElementsAre("v1", "v2"));
+  // The tombstone made it to the new generation.
+  cache->UpdateKeyValue("key3", "value3", 1);
+  EXPECT_TRUE(cache->GetKeyValuePairs(GetRequestContext(), {"key3"}).empty());
+}
+
+TEST_F(GenerationalCacheTest, AbandonedGenerationIsNotSwappedIn) {
+  auto cache = CreateCache();
+  cache->UpdateKeyValue("key1", "value1", 1);
+  cache->StartNextGeneration().UpdateKeyValue("key2", "value2", 1);
+  cache->AbandonNextGeneration();
+  cache->SwapGenerations();
+  EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(), {"key1", "key2"}),
+              UnorderedElementsAre(KVPairEq("key1", "value1")));
+}
+
+TEST_F(GenerationalCacheTest, ResultsKeepTheirGeneration) {
+  auto cache = CreateCache();
+  std::vector<std::string_view> values = {"v1", "v2"};
+  cache->UpdateKeyValueSet("key", absl::MakeSpan(values), 1);
+  auto result = cache->GetKeyValueSet(GetRequestContext(), {"key"});
+  cache->StartNextGeneration();
+  absl::Notification swapped;
+  std::thread swapper([&cache, &swapped] {
+    cache->SwapGenerations();
+    swapped.Notify();
+  });
+  // Waits for the result before destroying the previous generation.
+  EXPECT_FALSE(swapped.WaitForNotificationWithTimeout(absl::Milliseconds(50)));
+  EXPECT_THAT(result->GetValueSet("key"), UnorderedElementsAre("v1", "v2"));
+  result.reset();
+  swapper.join();
+  EXPECT_TRUE(cache->GetKeyValueSet(GetRequestContext(), {"key"})
+                  ->GetValueSet("key")
+                  .empty());
+}
+
+TEST_F(GenerationalCacheTest, CleanupCoversBothGenerations) {
+  auto cache = CreateCache();
+  cache->StartNextGeneration();
+  cache->DeleteKey("key", 2);
+  Cache::CleanupProgress progress =
+      cache->RemoveDeletedKeysSlice(1, "", absl::InfiniteFuture());
+  EXPECT_TRUE(progress.done);
+  EXPECT_EQ(progress.remaining_deleted_values, 2);
+  progress = cache->RemoveDeletedKeysSlice(2, "", absl::InfiniteFuture());
+  EXPECT_EQ(progress.remaining_deleted_values, 0);
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -0,0 +1,66 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/data_server/cache/get_key_value_pairs_result.h"
+
+#include <iterator>
+#include <utility>
+
+namespace kv_server {
+
+std::optional<std::string_view> GetKeyValuePairsResult::GetValue(
+    std::string_view key) const {
+  return GetValue(HashedKey(key));
+}
+
+std::optional<std::string_view> GetKeyValuePairsResult::GetValue(
+    const HashedKey& key) const {
+  if (const auto it = values_.find(key); it != values_.end()) {
+    return it->second;
+  }
+  return std::nullopt;
+}
+
+void GetKeyValuePairsResult::AddValue(
+    std::string_view key, std::shared_ptr<const std::string> value) {
+  AddValue(HashedKey(key), std::move(value));
+}
+
+void GetKeyValuePairsResult::AddValue(
+    const HashedKey& key, std::shared_ptr<const std::string> value) {
+  // Finds or adds the key without hashing it again.
+  const auto it = values_.lazy_emplace(
+      key, [&key](const auto& ctor) { ctor(key.key, std::string_view()); });
+  it->second = *value;
+  owners_.push_back(std::move(value));
+}
+
+void GetKeyValuePairsResult::AddValue(std::string_view key,
+                                      std::string value) {
+  AddValue(key, std::make_shared<const std::string>(std::move(value)));
+}
+
+void GetKeyValuePairsResult::AddValue(const HashedKey& key,
+                                      std::string value) {
+  AddValue(key, std::make_shared<const std::string>(std::move(value)));
+}
+
+void GetKeyValuePairsResult::Merge(GetKeyValuePairsResult other) {
+  // The views stay valid, moving the owners doesn't move the strings.
+  values_.insert(other.values_.begin(), other.values_.end());
+  owners_.insert(owners_.end(), std::make_move_iterator(other.owners_.begin()),
+                 std::make_move_iterator(other.owners_.end()));
+}
+
+}  // namespace kv_server
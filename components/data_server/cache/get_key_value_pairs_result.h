@@ -0,0 +1,71 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_CACHE_GET_KEY_VALUE_PAIRS_RESULT_H_
+#define COMPONENTS_DATA_SERVER_CACHE_GET_KEY_VALUE_PAIRS_RESULT_H_
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "components/util/hashed_key.h"
+
+namespace kv_server {
+
+// Key-value pairs returned by `Cache::GetKeyValuePairViews`.
+//
+// Values are views into strings owned by the cache. The result keeps a
+// reference to each of them, so they stay valid after the cache updates or
+// deletes the key, without copying the value. Keys are views into the key set
+// passed to the lookup, which has to outlive the result.
+class GetKeyValuePairsResult {
+ public:
+  GetKeyValuePairsResult() = default;
+  // Not copyable, the values are pinned once.
+  GetKeyValuePairsResult(const GetKeyValuePairsResult&) = delete;
+  GetKeyValuePairsResult& operator=(const GetKeyValuePairsResult&) = delete;
+  GetKeyValuePairsResult(GetKeyValuePairsResult&&) = default;
+  GetKeyValuePairsResult& operator=(GetKeyValuePairsResult&&) = default;
+
+  // Returns the value for `key`, or nullopt if the key was not found.
+  std::optional<std::string_view> GetValue(std::string_view key) const;
+  // Same as above, without hashing the key again.
+  std::optional<std::string_view> GetValue(const HashedKey& key) const;
+  size_t size() const { return values_.size(); }
+  bool empty() const { return values_.empty(); }
+
+  // Adds a view of `value` and keeps `value` alive with the result.
+  void AddValue(std::string_view key, std::shared_ptr<const std::string> value);
+  void AddValue(const HashedKey& key, std::shared_ptr<const std::string> value);
+  // Adds a copy of `value`, for caches that can't pin their values.
+  void AddValue(std::string_view key, std::string value);
+  void AddValue(const HashedKey& key, std::string value);
+  // Moves the values of `other` into this result.
+  void Merge(GetKeyValuePairsResult other);
+
+ private:
+  absl::flat_hash_map<std::string_view, std::string_view, HashedKeyHash,
+                      HashedKeyEq>
+      values_;
+  std::vector<std::shared_ptr<const std::string>> owners_;
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_CACHE_GET_KEY_VALUE_PAIRS_RESULT_H_
@@ -17,11 +17,14 @@
 #ifndef COMPONENTS_DATA_SERVER_CACHE_GET_KEY_VALUE_SET_RESULT_H_
 #define COMPONENTS_DATA_SERVER_CACHE_GET_KEY_VALUE_SET_RESULT_H_
 
+#include <cstdint>
 #include <memory>
+#include <optional>
 #include <utility>
 #include <vector>
 
 #include "absl/container/flat_hash_set.h"
+#include "components/query/id_bitmap.h"
 
 namespace kv_server {
 // Class that holds the data retrieved from cache lookup and read locks for
@@ -34,6 +37,36 @@ class GetKeyValueSetResult {
   virtual absl::flat_hash_set<std::string_view> GetValueSet(
       std::string_view key) const = 0;
 
+  // Returns the set for the given key as an immutable snapshot, which stays
+  // valid for as long as it is referenced. Missing keys have an empty set.
+  virtual std::shared_ptr<const absl::flat_hash_set<std::string_view>>
+  GetValueSetSnapshot(std::string_view key) const {
+    return std::make_shared<const absl::flat_hash_set<std::string_view>>(
+        GetValueSet(key));
+  }
+
+  // Returns true if the sets of this result are also available as member id
+  // bitmaps, which the query engine can combine without hashing the members.
+  virtual bool HasValueBitmaps() const { return false; }
+
+  // Returns the ids of the members of the set for the given key, or an empty
+  // bitmap if the key is missing. Only for results with `HasValueBitmaps()`.
+  virtual IdBitmap GetValueBitmap(std::string_view key) const {
+    return IdBitmap();
+  }
+
+  // Returns the member for an id returned by `GetValueBitmap`.
+  virtual std::string_view GetValueForId(uint32_t id) const { return ""; }
+
+  // Returns the version of the set for the given key, which changes whenever
+  // the members of the set change, or nullopt if the sets of this result are
+  // not versioned. Missing keys have version 0. Results computed from sets of
+  // the same versions are the same.
+  virtual std::optional<uint64_t> GetValueSetVersion(
+      std::string_view key) const {
+    return std::nullopt;
+  }
+
  private:
   // Adds key, value_set to the result data map, mantains the lock on `key`
   // until this object goes out of scope.
@@ -41,9 +74,23 @@ class GetKeyValueSetResult {
       std::string_view key, absl::flat_hash_set<std::string_view> value_set,
       std::unique_ptr<absl::ReaderMutexLock> key_lock) = 0;
 
+  // Adds key, value_set to the result data map. The snapshot owns the data it
+  // refers to, so no lock is needed.
+  virtual void AddKeyValueSetSnapshot(
+      std::string_view key,
+      std::shared_ptr<const absl::flat_hash_set<std::string_view>>
+          value_set) = 0;
+
+  // Sets the version of the set added for `key`, only for results created by
+  // `CreateVersioned`.
+  virtual void AddValueSetVersion(std::string_view key, uint64_t version) {}
+
   static std::unique_ptr<GetKeyValueSetResult> Create();
+  // Same as `Create`, for sets whose versions are all added.
+  static std::unique_ptr<GetKeyValueSetResult> CreateVersioned();
 
   friend class KeyValueCache;
+  friend class InternedKeyValueSetCache;
 };
 
 }  // namespace kv_server
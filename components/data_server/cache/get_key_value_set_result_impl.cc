@@ -14,7 +14,9 @@
  * limitations under the License.
  */
 
+#include <cstdint>
 #include <memory>
+#include <optional>
 #include <utility>
 #include <vector>
 
@@ -29,18 +31,33 @@ namespace {
 // the lookup keys
 class GetKeyValueSetResultImpl : public GetKeyValueSetResult {
  public:
-  GetKeyValueSetResultImpl() {}
+  explicit GetKeyValueSetResultImpl(bool versioned) : versioned_(versioned) {}
 
   // Looks up the key in the data map and returns value set. If the value_set
   // for the key is missing, returns empty set.
   absl::flat_hash_set<std::string_view> GetValueSet(
       std::string_view key) const override {
-    static const absl::flat_hash_set<std::string_view>* kEmptySet =
-        new absl::flat_hash_set<std::string_view>();
+    return *GetValueSetSnapshot(key);
+  }
+
+  std::shared_ptr<const absl::flat_hash_set<std::string_view>>
+  GetValueSetSnapshot(std::string_view key) const override {
+    static const auto* kEmptySet =
+        new std::shared_ptr<const absl::flat_hash_set<std::string_view>>(
+            std::make_shared<const absl::flat_hash_set<std::string_view>>());
     auto key_itr = data_map_.find(key);
     return key_itr == data_map_.end() ? *kEmptySet : key_itr->second;
   }
 
+  std::optional<uint64_t> GetValueSetVersion(
+      std::string_view key) const override {
+    if (!versioned_) {
+      return std::nullopt;
+    }
+    auto key_itr = versions_.find(key);
+    return key_itr == versions_.end() ? 0 : key_itr->second;
+  }
+
   GetKeyValueSetResultImpl(const GetKeyValueSetResultImpl&) = delete;
   GetKeyValueSetResultImpl& operator=(const GetKeyValueSetResultImpl&) = delete;
   GetKeyValueSetResultImpl(GetKeyValueSetResultImpl&& other) = default;
@@ -49,8 +66,12 @@ class GetKeyValueSetResultImpl : public GetKeyValueSetResult {
 
  private:
   std::vector<std::unique_ptr<absl::ReaderMutexLock>> read_locks_;
-  absl::flat_hash_map<std::string_view, absl::flat_hash_set<std::string_view>>
+  absl::flat_hash_map<
+      std::string_view,
+      std::shared_ptr<const absl::flat_hash_set<std::string_view>>>
       data_map_;
+  bool versioned_;
+  absl::flat_hash_map<std::string_view, uint64_t> versions_;
 
   // Adds key, value_set to the result data map, creates a read lock for
   // the key mutex
@@ -58,13 +79,32 @@ class GetKeyValueSetResultImpl : public GetKeyValueSetResult {
       std::string_view key, absl::flat_hash_set<std::string_view> value_set,
       std::unique_ptr<absl::ReaderMutexLock> key_lock) override {
     read_locks_.push_back(std::move(key_lock));
+    data_map_.emplace(
+        key, std::make_shared<const absl::flat_hash_set<std::string_view>>(
+                 std::move(value_set)));
+  }
+
+  // Adds key, value_set to the result data map
+  void AddKeyValueSetSnapshot(
+      std::string_view key,
+      std::shared_ptr<const absl::flat_hash_set<std::string_view>> value_set)
+      override {
     data_map_.emplace(key, std::move(value_set));
   }
+
+  void AddValueSetVersion(std::string_view key, uint64_t version) override {
+    versions_.emplace(key, version);
+  }
 };
 }  // namespace
 
 std::unique_ptr<GetKeyValueSetResult> GetKeyValueSetResult::Create() {
-  return std::make_unique<GetKeyValueSetResultImpl>();
+  return std::make_unique<GetKeyValueSetResultImpl>(/*versioned=*/false);
+}
+
+std::unique_ptr<GetKeyValueSetResult>
+GetKeyValueSetResult::CreateVersioned() {
+  return std::make_unique<GetKeyValueSetResultImpl>(/*versioned=*/true);
 }
 
 }  // namespace kv_server
@@ -0,0 +1,238 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data_server/cache/huge_pages.h"
+
+#include <sys/mman.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string_view>
+
+#include "absl/log/check.h"
+#include "absl/log/log.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+
+// Older headers lack the flag that selects 2MB pages of the hugetlbfs pool
+// rather than the default size.
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << 26)
+#endif
+
+namespace kv_server {
+namespace {
+
+std::atomic<int64_t> explicit_bytes = 0;
+std::atomic<int64_t> transparent_bytes = 0;
+std::atomic<int64_t> fallback_bytes = 0;
+
+size_t RoundUpToHugePages(size_t size) {
+  return (size + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+}
+
+char* MapExplicitHugePages(size_t size) {
+  void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_HUGE_2MB, -1,
+                 0);
+  return p == MAP_FAILED ? nullptr : static_cast<char*>(p);
+}
+
+// Maps `size` bytes, a multiple of `kHugePageSize`, at an address aligned to
+// `kHugePageSize`, so that the kernel can back all of them with huge pages.
+char* MapAligned(size_t size) {
+  const size_t mapped_size = size + kHugePageSize;
+  void* p = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED) {
+    return nullptr;
+  }
+  const auto start = reinterpret_cast<uintptr_t>(p);
+  const uintptr_t aligned_start =
+      (start + kHugePageSize - 1) & ~(uintptr_t{kHugePageSize} - 1);
+  const uintptr_t end = start + mapped_size;
+  const uintptr_t aligned_end = aligned_start + size;
+  if (aligned_start > start) {
+    munmap(p, aligned_start - start);
+  }
+  if (end > aligned_end) {
+    munmap(reinterpret_cast<void*>(aligned_end), end - aligned_end);
+  }
+  return reinterpret_cast<char*>(aligned_start);
+}
+
+void AdviseHugePages(char* data, size_t size) {
+  if (madvise(data, size, MADV_HUGEPAGE) != 0) {
+    LOG_FIRST_N(WARNING, 1) << "madvise(MADV_HUGEPAGE) failed: "
+                            << std::strerror(errno);
+  }
+}
+
+// Whether the kernel supports transparent huge pages, probed once, so that
+// every allocation of the process falls back the same way.
+bool TransparentHugePagesAvailable() {
+  static const bool available = [] {
+    char* probe = MapAligned(kHugePageSize);
+    if (probe == nullptr) {
+      return false;
+    }
+    const bool advised = madvise(probe, kHugePageSize, MADV_HUGEPAGE) == 0;
+    munmap(probe, kHugePageSize);
+    if (!advised) {
+      LOG(WARNING) << "Transparent huge pages are not available, cache "
+                      "storage falls back to regular pages";
+    }
+    return advised;
+  }();
+  return available;
+}
+
+}  // namespace
+
+absl::StatusOr<HugePageMode> ParseHugePageMode(std::string_view mode) {
+  if (mode == "none") {
+    return HugePageMode::kNone;
+  }
+  if (mode == "transparent") {
+    return HugePageMode::kTransparent;
+  }
+  if (mode == "explicit") {
+    return HugePageMode::kExplicit;
+  }
+  return absl::InvalidArgumentError(
+      absl::StrCat("Unknown huge page mode: ", mode));
+}
+
+HugePageBuffer::~HugePageBuffer() { Release(); }
+
+HugePageBuffer::HugePageBuffer(HugePageBuffer&& other) noexcept
+    : data_(other.data_),
+      size_(other.size_),
+      backing_(other.backing_),
+      mapped_(other.mapped_),
+      fallback_(other.fallback_) {
+  other.data_ = nullptr;
+  other.size_ = 0;
+}
+
+HugePageBuffer& HugePageBuffer::operator=(HugePageBuffer&& other) noexcept {
+  if (this != &other) {
+    Release();
+    data_ = other.data_;
+    size_ = other.size_;
+    backing_ = other.backing_;
+    mapped_ = other.mapped_;
+    fallback_ = other.fallback_;
+    other.data_ = nullptr;
+    other.size_ = 0;
+  }
+  return *this;
+}
+
+HugePageBuffer HugePageBuffer::Allocate(size_t size, HugePageMode mode) {
+  if (mode == HugePageMode::kNone) {
+    return HugePageBuffer(new char[size], size, HugePageMode::kNone,
+                          /*mapped=*/false, /*fallback=*/false);
+  }
+  const size_t mapped_size = RoundUpToHugePages(size);
+  if (mode == HugePageMode::kExplicit) {
+    if (char* data = MapExplicitHugePages(mapped_size); data != nullptr) {
+      explicit_bytes += mapped_size;
+      return HugePageBuffer(data, mapped_size, HugePageMode::kExplicit,
+                            /*mapped=*/true, /*fallback=*/false);
+    }
+    LOG_FIRST_N(WARNING, 1)
+        << "Not enough hugetlbfs pages for " << mapped_size
+        << " bytes, falling back to transparent huge pages. The pool is "
+           "sized with vm.nr_hugepages";
+  }
+  if (TransparentHugePagesAvailable()) {
+    if (char* data = MapAligned(mapped_size); data != nullptr) {
+      AdviseHugePages(data, mapped_size);
+      transparent_bytes += mapped_size;
+      return HugePageBuffer(data, mapped_size, HugePageMode::kTransparent,
+                            /*mapped=*/true, /*fallback=*/false);
+    }
+  }
+  fallback_bytes += size;
+  return HugePageBuffer(new char[size], size, HugePageMode::kNone,
+                        /*mapped=*/false, /*fallback=*/true);
+}
+
+void HugePageBuffer::Release() {
+  if (data_ == nullptr) {
+    return;
+  }
+  if (mapped_) {
+    munmap(data_, size_);
+    (backing_ == HugePageMode::kExplicit ? explicit_bytes : transparent_bytes)
+        -= size_;
+  } else {
+    delete[] data_;
+    if (fallback_) {
+      fallback_bytes -= size_;
+    }
+  }
+  data_ = nullptr;
+  size_ = 0;
+}
+
+void* AllocateHugePageAdvised(size_t size, size_t alignment,
+                              HugePageMode mode) {
+  if (mode == HugePageMode::kNone || size < kHugePageSize) {
+    return ::operator new(size, std::align_val_t(alignment));
+  }
+  if (!TransparentHugePagesAvailable()) {
+    fallback_bytes += size;
+    return ::operator new(size, std::align_val_t(alignment));
+  }
+  const size_t mapped_size = RoundUpToHugePages(size);
+  char* data = MapAligned(mapped_size);
+  // Out of memory, as `operator new` would be.
+  CHECK(data != nullptr) << "Mapping " << mapped_size
+                         << " bytes failed: " << std::strerror(errno);
+  AdviseHugePages(data, mapped_size);
+  transparent_bytes += mapped_size;
+  return data;
+}
+
+void DeallocateHugePageAdvised(void* p, size_t size, size_t alignment,
+                               HugePageMode mode) {
+  if (mode == HugePageMode::kNone || size < kHugePageSize) {
+    ::operator delete(p, size, std::align_val_t(alignment));
+    return;
+  }
+  if (!TransparentHugePagesAvailable()) {
+    fallback_bytes -= size;
+    ::operator delete(p, size, std::align_val_t(alignment));
+    return;
+  }
+  const size_t mapped_size = RoundUpToHugePages(size);
+  munmap(p, mapped_size);
+  transparent_bytes -= mapped_size;
+}
+
+HugePageStats GetHugePageStats() {
+  return HugePageStats{.explicit_bytes = explicit_bytes,
+                       .transparent_bytes = transparent_bytes,
+                       .fallback_bytes = fallback_bytes};
+}
+
+}  // namespace kv_server
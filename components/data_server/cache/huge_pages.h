@@ -0,0 +1,151 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_CACHE_HUGE_PAGES_H_
+#define COMPONENTS_DATA_SERVER_CACHE_HUGE_PAGES_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "absl/status/statusor.h"
+
+namespace kv_server {
+
+// Pages that back the memory of the cache storage. Huge pages cut the TLB
+// misses of lookups spread over a large cache.
+enum class HugePageMode {
+  // Regular pages.
+  kNone,
+  // Regions aligned to `kHugePageSize` and advised with
+  // `madvise(MADV_HUGEPAGE)`, that the kernel backs with transparent huge
+  // pages as it can.
+  kTransparent,
+  // Huge pages reserved in the hugetlbfs pool (`MAP_HUGETLB`). Falls back to
+  // `kTransparent` once the pool is exhausted.
+  kExplicit,
+};
+
+inline constexpr size_t kHugePageSize = size_t{2} << 20;
+
+// Parses "none", "transparent" or "explicit".
+absl::StatusOr<HugePageMode> ParseHugePageMode(std::string_view mode);
+
+// Uninitialized memory, backed by huge pages if they are requested and
+// available, and by regular pages otherwise. Move-only.
+class HugePageBuffer {
+ public:
+  HugePageBuffer() = default;
+  ~HugePageBuffer();
+  HugePageBuffer(HugePageBuffer&& other) noexcept;
+  HugePageBuffer& operator=(HugePageBuffer&& other) noexcept;
+  HugePageBuffer(const HugePageBuffer&) = delete;
+  HugePageBuffer& operator=(const HugePageBuffer&) = delete;
+
+  // Allocates at least `size` bytes. With huge pages, the size is rounded up
+  // to a multiple of `kHugePageSize`, so callers should use `size()` rather
+  // than waste the rest.
+  static HugePageBuffer Allocate(size_t size, HugePageMode mode);
+
+  char* data() const { return data_; }
+  size_t size() const { return size_; }
+  // The pages that the buffer got, which may be fewer than requested.
+  HugePageMode backing() const { return backing_; }
+
+ private:
+  HugePageBuffer(char* data, size_t size, HugePageMode backing, bool mapped,
+                 bool fallback)
+      : data_(data),
+        size_(size),
+        backing_(backing),
+        mapped_(mapped),
+        fallback_(fallback) {}
+
+  void Release();
+
+  char* data_ = nullptr;
+  size_t size_ = 0;
+  HugePageMode backing_ = HugePageMode::kNone;
+  // Whether `data_` comes from `mmap` rather than `new[]`.
+  bool mapped_ = false;
+  // Whether huge pages were requested but not available.
+  bool fallback_ = false;
+};
+
+// Memory for the allocator below. Blocks of at least `kHugePageSize` bytes
+// are mapped and advised for transparent huge pages, unless `mode` is
+// `kNone`. Smaller blocks come from `operator new`.
+void* AllocateHugePageAdvised(size_t size, size_t alignment, HugePageMode mode);
+void DeallocateHugePageAdvised(void* p, size_t size, size_t alignment,
+                               HugePageMode mode);
+
+// Allocator for the large arrays of containers, e.g. the slots of the hash
+// tables of the caches. Explicit huge pages are only used for slabs, as
+// tables reallocate as they grow and would strand pages of the pool, so
+// `kExplicit` advises transparent huge pages too.
+template <typename T>
+class HugePageAllocator {
+ public:
+  using value_type = T;
+
+  explicit HugePageAllocator(HugePageMode mode = HugePageMode::kNone)
+      : mode_(mode) {}
+  template <typename U>
+  HugePageAllocator(const HugePageAllocator<U>& other)  // NOLINT
+      : mode_(other.mode()) {}
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(
+        AllocateHugePageAdvised(n * sizeof(T), alignof(T), mode_));
+  }
+  void deallocate(T* p, size_t n) {
+    DeallocateHugePageAdvised(p, n * sizeof(T), alignof(T), mode_);
+  }
+
+  HugePageMode mode() const { return mode_; }
+
+  template <typename U>
+  friend bool operator==(const HugePageAllocator& a,
+                         const HugePageAllocator<U>& b) {
+    return a.mode() == b.mode();
+  }
+  template <typename U>
+  friend bool operator!=(const HugePageAllocator& a,
+                         const HugePageAllocator<U>& b) {
+    return !(a == b);
+  }
+
+ private:
+  HugePageMode mode_;
+};
+
+// Memory currently allocated with huge pages requested, by the pages it got.
+struct HugePageStats {
+  // Backed by hugetlbfs pages.
+  int64_t explicit_bytes = 0;
+  // Advised for transparent huge pages. How much of it the kernel backs with
+  // huge pages shows as `AnonHugePages` in /proc/meminfo.
+  int64_t transparent_bytes = 0;
+  // Regular pages, because huge pages were not available.
+  int64_t fallback_bytes = 0;
+};
+
+// Returns the stats of the process.
+HugePageStats GetHugePageStats();
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_CACHE_HUGE_PAGES_H_
@@ -0,0 +1,124 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data_server/cache/huge_pages.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/hash/hash.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+// The sandbox may or may not provide huge pages, so the tests only check
+// what holds either way.
+
+TEST(HugePagesTest, ParsesModes) {
+  EXPECT_EQ(*ParseHugePageMode("none"), HugePageMode::kNone);
+  EXPECT_EQ(*ParseHugePageMode("transparent"), HugePageMode::kTransparent);
+  EXPECT_EQ(*ParseHugePageMode("explicit"), HugePageMode::kExplicit);
+  EXPECT_FALSE(ParseHugePageMode("1g").ok());
+}
+
+TEST(HugePagesTest, RegularBufferIsNotCounted) {
+  const HugePageStats before = GetHugePageStats();
+  HugePageBuffer buffer = HugePageBuffer::Allocate(100, HugePageMode::kNone);
+  ASSERT_NE(buffer.data(), nullptr);
+  EXPECT_EQ(buffer.size(), 100);
+  EXPECT_EQ(buffer.backing(), HugePageMode::kNone);
+  const HugePageStats after = GetHugePageStats();
+  EXPECT_EQ(after.explicit_bytes, before.explicit_bytes);
+  EXPECT_EQ(after.transparent_bytes, before.transparent_bytes);
+  EXPECT_EQ(after.fallback_bytes, before.fallback_bytes);
+}
+
+TEST(HugePagesTest, HugePageBufferIsAlignedAndCounted) {
+  for (const HugePageMode mode :
+       {HugePageMode::kTransparent, HugePageMode::kExplicit}) {
+    const HugePageStats before = GetHugePageStats();
+    {
+      HugePageBuffer buffer = HugePageBuffer::Allocate(100, mode);
+      ASSERT_NE(buffer.data(), nullptr);
+      std::memset(buffer.data(), 'x', buffer.size());
+      const HugePageStats during = GetHugePageStats();
+      switch (buffer.backing()) {
+        case HugePageMode::kExplicit:
+          EXPECT_EQ(during.explicit_bytes - before.explicit_bytes,
+                    kHugePageSize);
+          break;
+        case HugePageMode::kTransparent:
+          EXPECT_EQ(during.transparent_bytes - before.transparent_bytes,
+                    kHugePageSize);
+          break;
+        case HugePageMode::kNone:
+          EXPECT_EQ(during.fallback_bytes - before.fallback_bytes, 100);
+          break;
+      }
+      if (buffer.backing() != HugePageMode::kNone) {
+        EXPECT_EQ(buffer.size(), kHugePageSize);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(buffer.data()) % kHugePageSize,
+                  0);
+      }
+      // Moving keeps the memory counted once.
+      HugePageBuffer moved = std::move(buffer);
+      EXPECT_EQ(buffer.data(), nullptr);  // NOLINT
+      EXPECT_NE(moved.data(), nullptr);
+    }
+    const HugePageStats after = GetHugePageStats();
+    EXPECT_EQ(after.explicit_bytes, before.explicit_bytes);
+    EXPECT_EQ(after.transparent_bytes, before.transparent_bytes);
+    EXPECT_EQ(after.fallback_bytes, before.fallback_bytes);
+  }
+}
+
+TEST(HugePagesTest, ExplicitModeNeverFailsWithoutPool) {
+  // Far more than hugetlbfs pools are usually sized for.
+  HugePageBuffer buffer =
+      HugePageBuffer::Allocate(64 * kHugePageSize, HugePageMode::kExplicit);
+  ASSERT_NE(buffer.data(), nullptr);
+  buffer.data()[buffer.size() - 1] = 'x';
+}
+
+TEST(HugePagesTest, AllocatorBacksLargeTables) {
+  const HugePageStats before = GetHugePageStats();
+  {
+    absl::flat_hash_map<
+        int, std::string, absl::Hash<int>, std::equal_to<int>,
+        HugePageAllocator<std::pair<const int, std::string>>>
+        map((HugePageAllocator<std::pair<const int, std::string>>(
+            HugePageMode::kTransparent)));
+    for (int i = 0; i < 200000; i++) {
+      map.emplace(i, std::to_string(i));
+    }
+    for (int i = 0; i < 200000; i += 1000) {
+      ASSERT_EQ(map.at(i), std::to_string(i));
+    }
+    const HugePageStats during = GetHugePageStats();
+    EXPECT_GT(during.transparent_bytes + during.fallback_bytes,
+              before.transparent_bytes + before.fallback_bytes);
+  }
+  const HugePageStats after = GetHugePageStats();
+  EXPECT_EQ(after.transparent_bytes, before.transparent_bytes);
+  EXPECT_EQ(after.fallback_bytes, before.fallback_bytes);
+}
+
+}  // namespace
+}  // namespace kv_server
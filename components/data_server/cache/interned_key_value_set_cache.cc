@@ -0,0 +1,630 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/data_server/cache/interned_key_value_set_cache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/log/log.h"
+#include "absl/memory/memory.h"
+#include "absl/status/status.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+
+namespace kv_server {
+namespace {
+
+// Estimated bytes of a member of a reverse membership index, without its key
+// ids: the slot and control byte of its hash table entry.
+constexpr int64_t kMembershipIndexMemberBytes =
+    sizeof(std::pair<const uint32_t, std::vector<uint32_t>>) + 1;
+
+// Totals of the reverse membership indexes of the process, for
+// `GetMembershipIndexStatsOfAllCaches`.
+std::atomic<int64_t> total_membership_index_entries = 0;
+std::atomic<int64_t> total_membership_index_members = 0;
+std::atomic<int64_t> total_membership_index_overflows = 0;
+
+void AddToMembershipIndexTotals(int64_t num_entries, int64_t num_members) {
+  total_membership_index_entries.fetch_add(num_entries,
+                                           std::memory_order_relaxed);
+  total_membership_index_members.fetch_add(num_members,
+                                           std::memory_order_relaxed);
+}
+
+// Result that resolves member ids only when asked for, so that queries can run
+// over the id bitmaps of the sets.
+class InternedKeyValueSetResult : public GetKeyValueSetResult {
+ public:
+  explicit InternedKeyValueSetResult(const ValueDictionary& dictionary)
+      : dictionary_(dictionary) {}
+
+  absl::flat_hash_set<std::string_view> GetValueSet(
+      std::string_view key) const override {
+    if (auto set_itr = value_sets_.find(key); set_itr != value_sets_.end()) {
+      return *set_itr->second;
+    }
+    absl::flat_hash_set<std::string_view> value_set;
+    auto key_itr = live_ids_map_.find(key);
+    if (key_itr == live_ids_map_.end()) {
+      return value_set;
+    }
+    value_set.reserve(key_itr->second->Cardinality());
+    key_itr->second->ForEach([this, &value_set](uint32_t id) {
+      value_set.emplace(dictionary_.Get(id));
+    });
+    return value_set;
+  }
+
+  bool HasValueBitmaps() const override { return true; }
+
+  IdBitmap GetValueBitmap(std::string_view key) const override {
+    auto key_itr = live_ids_map_.find(key);
+    return key_itr == live_ids_map_.end() ? IdBitmap() : *key_itr->second;
+  }
+
+  std::string_view GetValueForId(uint32_t id) const override {
+    return dictionary_.Get(id);
+  }
+
+  // Adds the live ids of `key`. `live_ids` must stay valid while `key_lock` is
+  // held, which keeps the references of the ids as well.
+  void AddKeyValueBitmap(std::string_view key, const IdBitmap* live_ids,
+                         std::unique_ptr<absl::ReaderMutexLock> key_lock) {
+    read_locks_.push_back(std::move(key_lock));
+    live_ids_map_.emplace(key, live_ids);
+  }
+
+ private:
+  void AddKeyValueSet(
+      std::string_view key, absl::flat_hash_set<std::string_view> value_set,
+      std::unique_ptr<absl::ReaderMutexLock> key_lock) override {
+    read_locks_.push_back(std::move(key_lock));
+    value_sets_.emplace(
+        key, std::make_shared<const absl::flat_hash_set<std::string_view>>(
+                 std::move(value_set)));
+  }
+  void AddKeyValueSetSnapshot(
+      std::string_view key,
+      std::shared_ptr<const absl::flat_hash_set<std::string_view>> value_set)
+      override {
+    value_sets_.emplace(key, std::move(value_set));
+  }
+
+  const ValueDictionary& dictionary_;
+  std::vector<std::unique_ptr<absl::ReaderMutexLock>> read_locks_;
+  absl::flat_hash_map<std::string_view, const IdBitmap*> live_ids_map_;
+  absl::flat_hash_map<
+      std::string_view,
+      std::shared_ptr<const absl::flat_hash_set<std::string_view>>>
+      value_sets_;
+};
+
+}  // namespace
+
+InternedKeyValueSetCache::InternedKeyValueSetCache(
+    std::unique_ptr<Cache> key_value_cache, Options options)
+    : key_value_cache_(std::move(key_value_cache)),
+      membership_index_key_prefixes_(
+          std::move(options.membership_index_key_prefixes)),
+      membership_index_max_entries_(options.membership_index_max_entries) {}
+
+InternedKeyValueSetCache::~InternedKeyValueSetCache() {
+  absl::MutexLock lock(&membership_index_mutex_);
+  AddToMembershipIndexTotals(
+      -num_membership_index_entries_,
+      -static_cast<int64_t>(sets_by_member_.size()));
+}
+
+absl::flat_hash_map<std::string, std::string>
+InternedKeyValueSetCache::GetKeyValuePairs(
+    const RequestContext& request_context,
+    const absl::flat_hash_set<std::string_view>& key_set) const {
+  return key_value_cache_->GetKeyValuePairs(request_context, key_set);
+}
+
+GetKeyValuePairsResult InternedKeyValueSetCache::GetKeyValuePairViews(
+    const RequestContext& request_context,
+    const absl::flat_hash_set<std::string_view>& key_set) const {
+  return key_value_cache_->GetKeyValuePairViews(request_context, key_set);
+}
+
+GetKeyValuePairsResult InternedKeyValueSetCache::GetHashedKeyValuePairViews(
+    const RequestContext& request_context,
+    absl::Span<const HashedKey> keys) const {
+  return key_value_cache_->GetHashedKeyValuePairViews(request_context, keys);
+}
+
+std::unique_ptr<GetKeyValueSetResult> InternedKeyValueSetCache::GetKeyValueSet(
+    const RequestContext& request_context,
+    const absl::flat_hash_set<std::string_view>& key_set) const {
+  ScopeLatencyMetricsRecorder<InternalLookupMetricsContext,
+                              kGetKeyValueSetLatencyInMicros>
+      latency_recorder(request_context.GetInternalLookupMetricsContext());
+  absl::ReaderMutexLock lock(&set_map_mutex_);
+  auto result = std::make_unique<InternedKeyValueSetResult>(dictionary_);
+  bool cache_hit = false;
+  for (const auto& key : key_set) {
+    VLOG(8) << "Getting key: " << key;
+    const auto key_itr = key_to_value_set_map_.find(key);
+    if (key_itr == key_to_value_set_map_.end()) {
+      continue;
+    }
+    // Holding the key lock keeps the references of the ids, so the strings
+    // stay alive as long as the result.
+    auto set_lock =
+        std::make_unique<absl::ReaderMutexLock>(&key_itr->second->mutex);
+    result->AddKeyValueBitmap(key, &key_itr->second->live_ids,
+                              std::move(set_lock));
+    cache_hit = true;
+  }
+  if (cache_hit) {
+    LogCacheAccessMetrics(request_context, kKeyValueSetCacheHit);
+  } else {
+    LogCacheAccessMetrics(request_context, kKeyValueSetCacheMiss);
+  }
+  return result;
+}
+
+absl::StatusOr<std::vector<std::string>>
+InternedKeyValueSetCache::GetSetsContaining(std::string_view member) const {
+  if (membership_index_key_prefixes_.empty()) {
+    return absl::UnimplementedError(
+        "The key-value sets have no reverse membership index");
+  }
+  std::vector<std::string> keys;
+  {
+    absl::ReaderMutexLock lock(&membership_index_mutex_);
+    if (membership_index_overflowed_) {
+      return absl::ResourceExhaustedError(absl::StrCat(
+          "The reverse membership index grew past ",
+          membership_index_max_entries_, " entries and was dropped"));
+    }
+    // The member's id can't be reused while the lock is held if it has
+    // pairs, which hold references to their key ids as well.
+    const std::optional<uint32_t> member_id = dictionary_.Find(member);
+    if (!member_id.has_value()) {
+      return keys;
+    }
+    const auto member_itr = sets_by_member_.find(*member_id);
+    if (member_itr == sets_by_member_.end()) {
+      return keys;
+    }
+    keys.reserve(member_itr->second.size());
+    for (const uint32_t key_id : member_itr->second) {
+      keys.emplace_back(dictionary_.Get(key_id));
+    }
+  }
+  std::sort(keys.begin(), keys.end());
+  return keys;
+}
+
+void InternedKeyValueSetCache::UpdateKeyValue(std::string_view key,
+                                              std::string_view value,
+                                              int64_t logical_commit_time,
+                                              std::string_view prefix) {
+  key_value_cache_->UpdateKeyValue(key, value, logical_commit_time, prefix);
+}
+
+void InternedKeyValueSetCache::UpdateKeyValueSet(
+    std::string_view key, absl::Span<std::string_view> input_value_set,
+    int64_t logical_commit_time, std::string_view prefix) {
+  SampledScopeLatencyMetricsRecorder<kUpdateKeyValueSetLatency>
+      latency_recorder;
+  VLOG(9) << "Received update for [" << key << "] at " << logical_commit_time;
+  std::unique_ptr<absl::MutexLock> key_lock;
+  ValueSetEntry* existing_entry;
+  // The max cleanup time needs to be locked before doing this comparison
+  {
+    absl::MutexLock lock_map(&set_map_mutex_);
+    auto max_cleanup_logical_commit_time =
+        max_cleanup_logical_commit_time_map_[prefix];
+    if (logical_commit_time <= max_cleanup_logical_commit_time) {
+      VLOG(1) << "Skipping the update as its logical_commit_time: "
+              << logical_commit_time
+              << " is older than the current cutoff time:"
+              << max_cleanup_logical_commit_time;
+      return;
+    } else if (input_value_set.empty()) {
+      VLOG(1) << "Skipping the update as it has no value in the set.";
+      return;
+    }
+    auto key_itr = key_to_value_set_map_.find(key);
+    if (key_itr == key_to_value_set_map_.end()) {
+      VLOG(9) << key << " is a new key. Adding it";
+      auto entry = std::make_unique<ValueSetEntry>();
+      std::vector<uint32_t> live_ids;
+      for (const auto& value : input_value_set) {
+        const uint32_t id = dictionary_.Intern(value);
+        if (!entry->value_set
+                 .try_emplace(id, SetValueMeta{logical_commit_time,
+                                               /*is_deleted=*/false})
+                 .second) {
+          dictionary_.Release(id);
+          continue;
+        }
+        entry->live_ids.Add(id);
+        live_ids.push_back(id);
+      }
+      if (IsMembershipIndexed(key)) {
+        AddToMembershipIndex(GetOrInternKeyId(*entry, key), live_ids);
+      }
+      key_to_value_set_map_.emplace(key, std::move(entry));
+      return;
+    }
+    key_lock = std::make_unique<absl::MutexLock>(&key_itr->second->mutex);
+    existing_entry = key_itr->second.get();
+  }  // end locking map;
+
+  // Members that were missing or deleted, to add to the index.
+  std::vector<uint32_t> revived_ids;
+  for (const auto& value : input_value_set) {
+    const uint32_t id = dictionary_.Intern(value);
+    auto [value_itr, inserted] = existing_entry->value_set.try_emplace(id);
+    if (!inserted) {
+      // The existing entry already holds a reference.
+      dictionary_.Release(id);
+    }
+    SetValueMeta& current_value_state = value_itr->second;
+    if (current_value_state.last_logical_commit_time >= logical_commit_time) {
+      // no need to update
+      continue;
+    }
+    if (inserted || current_value_state.is_deleted) {
+      revived_ids.push_back(id);
+    }
+    current_value_state.is_deleted = false;
+    current_value_state.last_logical_commit_time = logical_commit_time;
+    existing_entry->live_ids.Add(id);
+  }
+  if (!revived_ids.empty() && IsMembershipIndexed(key)) {
+    AddToMembershipIndex(GetOrInternKeyId(*existing_entry, key), revived_ids);
+  }
+  // end locking key
+}
+
+void InternedKeyValueSetCache::DeleteKey(std::string_view key,
+                                         int64_t logical_commit_time,
+                                         std::string_view prefix) {
+  key_value_cache_->DeleteKey(key, logical_commit_time, prefix);
+}
+
+void InternedKeyValueSetCache::DeleteValuesInSet(
+    std::string_view key, absl::Span<std::string_view> value_set,
+    int64_t logical_commit_time, std::string_view prefix) {
+  SampledScopeLatencyMetricsRecorder<kDeleteValuesInSetLatency>
+      latency_recorder;
+  std::unique_ptr<absl::MutexLock> key_lock;
+  ValueSetEntry* existing_entry;
+  // The max cleanup time needs to be locked before doing this comparison
+  {
+    absl::MutexLock lock_map(&set_map_mutex_);
+    auto max_cleanup_logical_commit_time =
+        max_cleanup_logical_commit_time_map_[prefix];
+    if (logical_commit_time <= max_cleanup_logical_commit_time ||
+        value_set.empty()) {
+      return;
+    }
+    auto key_itr = key_to_value_set_map_.find(key);
+    if (key_itr == key_to_value_set_map_.end()) {
+      // If the key is missing, still need to add all the deleted values to the
+      // map to avoid late arriving update with smaller logical commit time
+      // inserting values same as the deleted ones for the key
+      auto entry = std::make_unique<ValueSetEntry>();
+      auto& deleted_ids = deleted_set_nodes_map_[prefix][logical_commit_time]
+                                                [std::string(key)];
+      for (const auto& value : value_set) {
+        const uint32_t id = dictionary_.Intern(value);
+        if (!entry->value_set
+                 .try_emplace(id, SetValueMeta{logical_commit_time,
+                                               /*is_deleted=*/true})
+                 .second) {
+          dictionary_.Release(id);
+          continue;
+        }
+        // The deleted set node holds its own reference.
+        if (deleted_ids.insert(id).second) {
+          dictionary_.AddReference(id);
+        }
+      }
+      key_to_value_set_map_.emplace(key, std::move(entry));
+      return;
+    }
+    // Lock the key
+    key_lock = std::make_unique<absl::MutexLock>(&key_itr->second->mutex);
+    existing_entry = key_itr->second.get();
+  }  // end locking map
+  // Keep track of the values to be added to the deleted set nodes, each one
+  // with a reference of its own.
+  std::vector<uint32_t> ids_to_delete;
+  // Members that were live, to remove from the index.
+  std::vector<uint32_t> unlinked_ids;
+  for (const auto& value : value_set) {
+    const uint32_t id = dictionary_.Intern(value);
+    auto [value_itr, inserted] = existing_entry->value_set.try_emplace(id);
+    if (!inserted) {
+      // The existing entry already holds a reference.
+      dictionary_.Release(id);
+    }
+    SetValueMeta& current_value_state = value_itr->second;
+    if (current_value_state.last_logical_commit_time >= logical_commit_time) {
+      // No need to delete
+      continue;
+    }
+    if (!inserted && !current_value_state.is_deleted) {
+      unlinked_ids.push_back(id);
+    }
+    current_value_state.last_logical_commit_time = logical_commit_time;
+    current_value_state.is_deleted = true;
+    existing_entry->live_ids.Remove(id);
+    // Taken while the key is locked, so that cleanup can't free the id before
+    // it is added to the deleted set nodes.
+    dictionary_.AddReference(id);
+    ids_to_delete.push_back(id);
+  }
+  if (!unlinked_ids.empty() && existing_entry->key_id.has_value()) {
+    RemoveFromMembershipIndex(*existing_entry->key_id, unlinked_ids);
+  }
+  if (!ids_to_delete.empty()) {
+    // Release key lock before locking the map to avoid potential deadlock
+    // caused by cycle in the ordering of lock acquisitions
+    key_lock.reset();
+    absl::MutexLock lock_map(&set_map_mutex_);
+    auto& deleted_ids =
+        deleted_set_nodes_map_[prefix][logical_commit_time][std::string(key)];
+    for (const uint32_t id : ids_to_delete) {
+      if (!deleted_ids.insert(id).second) {
+        dictionary_.Release(id);
+      }
+    }
+  }
+}
+
+void InternedKeyValueSetCache::ApplyMutations(
+    absl::Span<const Mutation> mutations, std::string_view prefix) {
+  std::vector<Mutation> key_value_mutations;
+  key_value_mutations.reserve(mutations.size());
+  for (const Mutation& mutation : mutations) {
+    switch (mutation.type) {
+      case Mutation::Type::kUpdateKeyValue:
+      case Mutation::Type::kDeleteKey:
+        key_value_mutations.push_back(mutation);
+        break;
+      case Mutation::Type::kUpdateKeyValueSet:
+        UpdateKeyValueSet(mutation.key, mutation.value_set,
+                          mutation.logical_commit_time, prefix);
+        break;
+      case Mutation::Type::kDeleteValuesInSet:
+        DeleteValuesInSet(mutation.key, mutation.value_set,
+                          mutation.logical_commit_time, prefix);
+        break;
+      case Mutation::Type::kUpdateUInt32Set:
+        UpdateKeyValueUInt32Set(mutation.key, mutation.uint32_value_set,
+                                mutation.logical_commit_time, prefix);
+        break;
+      case Mutation::Type::kDeleteValuesInUInt32Set:
+        DeleteValuesInUInt32Set(mutation.key, mutation.uint32_value_set,
+                                mutation.logical_commit_time, prefix);
+        break;
+    }
+  }
+  key_value_cache_->ApplyMutations(key_value_mutations, prefix);
+}
+
+void InternedKeyValueSetCache::RemoveDeletedKeys(int64_t logical_commit_time,
+                                                 std::string_view prefix) {
+  ScopeLatencyMetricsRecorder<ServerSafeMetricsContext,
+                              kRemoveDeletedKeyLatency>
+      latency_recorder(KVServerContextMap()->SafeMetric());
+  key_value_cache_->RemoveDeletedKeys(logical_commit_time, prefix);
+  CleanUpKeyValueSetMap(logical_commit_time, prefix);
+}
+
+Cache::CleanupProgress InternedKeyValueSetCache::RemoveDeletedKeysSlice(
+    int64_t logical_commit_time, std::string_view prefix,
+    absl::Time deadline) {
+  CleanupProgress progress = key_value_cache_->RemoveDeletedKeysSlice(
+      logical_commit_time, prefix, deadline);
+  if (progress.done) {
+    CleanUpKeyValueSetMap(logical_commit_time, prefix);
+  }
+  return progress;
+}
+
+void InternedKeyValueSetCache::CleanUpKeyValueSetMap(
+    int64_t logical_commit_time, std::string_view prefix) {
+  ScopeLatencyMetricsRecorder<ServerSafeMetricsContext,
+                              kCleanUpKeyValueSetMapLatency>
+      latency_recorder(KVServerContextMap()->SafeMetric());
+  absl::MutexLock lock_set_map(&set_map_mutex_);
+  if (max_cleanup_logical_commit_time_map_[prefix] < logical_commit_time) {
+    max_cleanup_logical_commit_time_map_[prefix] = logical_commit_time;
+  }
+  auto deleted_nodes_per_prefix = deleted_set_nodes_map_.find(prefix);
+  if (deleted_nodes_per_prefix == deleted_set_nodes_map_.end()) {
+    return;
+  }
+  auto delete_itr = deleted_nodes_per_prefix->second.begin();
+  while (delete_itr != deleted_nodes_per_prefix->second.end() &&
+         delete_itr->first <= logical_commit_time) {
+    for (const auto& [key, ids] : delete_itr->second) {
+      if (auto key_itr = key_to_value_set_map_.find(key);
+          key_itr != key_to_value_set_map_.end()) {
+        {
+          absl::MutexLock key_lock(&key_itr->second->mutex);
+          ValueSet& value_set = key_itr->second->value_set;
+          for (const uint32_t id : ids) {
+            auto existing_value_itr = value_set.find(id);
+            if (existing_value_itr != value_set.end() &&
+                existing_value_itr->second.is_deleted &&
+                existing_value_itr->second.last_logical_commit_time <=
+                    logical_commit_time) {
+              value_set.erase(existing_value_itr);
+              dictionary_.Release(id);
+            }
+          }
+        }
+        if (key_itr->second->value_set.empty()) {
+          // If the value set is empty, erase the key-value_set from cache map
+          if (key_itr->second->key_id.has_value()) {
+            dictionary_.Release(*key_itr->second->key_id);
+          }
+          key_to_value_set_map_.erase(key_itr);
+        }
+      }
+      for (const uint32_t id : ids) {
+        dictionary_.Release(id);
+      }
+    }
+    ++delete_itr;
+  }
+  deleted_nodes_per_prefix->second.erase(
+      deleted_nodes_per_prefix->second.begin(), delete_itr);
+  if (deleted_nodes_per_prefix->second.empty()) {
+    deleted_set_nodes_map_.erase(deleted_nodes_per_prefix);
+  }
+}
+
+void InternedKeyValueSetCache::LogCacheAccessMetrics(
+    const RequestContext& request_context,
+    std::string_view cache_access_event) const {
+  LogIfError(
+      request_context.GetInternalLookupMetricsContext()
+          .AccumulateMetric<kCacheAccessEventCount>(1, cache_access_event));
+}
+
+bool InternedKeyValueSetCache::IsMembershipIndexed(
+    std::string_view key) const {
+  return std::any_of(membership_index_key_prefixes_.begin(),
+                     membership_index_key_prefixes_.end(),
+                     [key](const std::string& key_prefix) {
+                       return absl::StartsWith(key, key_prefix);
+                     });
+}
+
+uint32_t InternedKeyValueSetCache::GetOrInternKeyId(ValueSetEntry& entry,
+                                                    std::string_view key) {
+  if (!entry.key_id.has_value()) {
+    entry.key_id = dictionary_.Intern(key);
+  }
+  return *entry.key_id;
+}
+
+void InternedKeyValueSetCache::AddToMembershipIndex(
+    uint32_t key_id, absl::Span<const uint32_t> member_ids) {
+  absl::MutexLock lock(&membership_index_mutex_);
+  if (membership_index_overflowed_) {
+    return;
+  }
+  const int64_t num_entries = num_membership_index_entries_;
+  const int64_t num_members = sets_by_member_.size();
+  for (const uint32_t member_id : member_ids) {
+    std::vector<uint32_t>& key_ids = sets_by_member_[member_id];
+    const auto key_itr =
+        std::lower_bound(key_ids.begin(), key_ids.end(), key_id);
+    if (key_itr == key_ids.end() || *key_itr != key_id) {
+      key_ids.insert(key_itr, key_id);
+      ++num_membership_index_entries_;
+    }
+  }
+  if (num_membership_index_entries_ > membership_index_max_entries_) {
+    LOG(ERROR) << "The reverse membership index of the key-value sets grew "
+                  "past "
+               << membership_index_max_entries_
+               << " entries, dropping it until the cache is rebuilt";
+    membership_index_overflowed_ = true;
+    total_membership_index_overflows.fetch_add(1, std::memory_order_relaxed);
+    AddToMembershipIndexTotals(-num_entries, -num_members);
+    absl::flat_hash_map<uint32_t, std::vector<uint32_t>>().swap(
+        sets_by_member_);
+    num_membership_index_entries_ = 0;
+    return;
+  }
+  AddToMembershipIndexTotals(
+      num_membership_index_entries_ - num_entries,
+      static_cast<int64_t>(sets_by_member_.size()) - num_members);
+}
+
+void InternedKeyValueSetCache::RemoveFromMembershipIndex(
+    uint32_t key_id, absl::Span<const uint32_t> member_ids) {
+  absl::MutexLock lock(&membership_index_mutex_);
+  if (membership_index_overflowed_) {
+    return;
+  }
+  const int64_t num_entries = num_membership_index_entries_;
+  const int64_t num_members = sets_by_member_.size();
+  for (const uint32_t member_id : member_ids) {
+    const auto member_itr = sets_by_member_.find(member_id);
+    if (member_itr == sets_by_member_.end()) {
+      continue;
+    }
+    std::vector<uint32_t>& key_ids = member_itr->second;
+    const auto key_itr =
+        std::lower_bound(key_ids.begin(), key_ids.end(), key_id);
+    if (key_itr == key_ids.end() || *key_itr != key_id) {
+      continue;
+    }
+    key_ids.erase(key_itr);
+    --num_membership_index_entries_;
+    if (key_ids.empty()) {
+      sets_by_member_.erase(member_itr);
+    }
+  }
+  AddToMembershipIndexTotals(
+      num_membership_index_entries_ - num_entries,
+      static_cast<int64_t>(sets_by_member_.size()) - num_members);
+}
+
+std::unique_ptr<Cache> InternedKeyValueSetCache::Create(
+    std::unique_ptr<Cache> key_value_cache) {
+  return Create(std::move(key_value_cache), Options());
+}
+
+std::unique_ptr<Cache> InternedKeyValueSetCache::Create(
+    std::unique_ptr<Cache> key_value_cache, Options options) {
+  return absl::WrapUnique(new InternedKeyValueSetCache(
+      std::move(key_value_cache), std::move(options)));
+}
+
+absl::flat_hash_map<std::string, double>
+InternedKeyValueSetCache::GetMembershipIndexStatsOfAllCaches() {
+  const int64_t num_entries =
+      total_membership_index_entries.load(std::memory_order_relaxed);
+  const int64_t num_members =
+      total_membership_index_members.load(std::memory_order_relaxed);
+  return {
+      {std::string(kSetMembershipIndexEntries),
+       static_cast<double>(num_entries)},
+      {std::string(kSetMembershipIndexMembers),
+       static_cast<double>(num_members)},
+      {std::string(kSetMembershipIndexBytes),
+       static_cast<double>(num_members * kMembershipIndexMemberBytes +
+                           num_entries * int64_t{sizeof(uint32_t)})},
+      {std::string(kSetMembershipIndexOverflows),
+       static_cast<double>(total_membership_index_overflows.load(
+           std::memory_order_relaxed))},
+  };
+}
+
+}  // namespace kv_server
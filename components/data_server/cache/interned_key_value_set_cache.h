@@ -0,0 +1,232 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_CACHE_INTERNED_KEY_VALUE_SET_CACHE_H_
+#define COMPONENTS_DATA_SERVER_CACHE_INTERNED_KEY_VALUE_SET_CACHE_H_
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/container/btree_map.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
+#include "components/data_server/cache/cache.h"
+#include "components/data_server/cache/get_key_value_set_result.h"
+#include "components/data_server/cache/value_dictionary.h"
+#include "components/query/id_bitmap.h"
+
+namespace kv_server {
+
+// In-memory datastore that stores key-value sets as 32 bit member ids.
+//
+// Set members are interned in a `ValueDictionary` shared by all the keys of
+// the cache, so a member that appears in many sets is stored once. Each set
+// only keeps the ids together with their timestamps and deleted state, and a
+// bitmap of the ids of its live members that lookup results hand out to the
+// query engine.
+//
+// The sets whose keys start with one of the `membership_index_key_prefixes` are
+// also kept in a reverse membership index, from the id of each live member to
+// the sorted ids of the keys of the sets that contain it, so that
+// `GetSetsContaining` doesn't scan the sets. The keys are interned in the same
+// dictionary as the members. The index is maintained as the sets are updated,
+// and is dropped for good if it grows past `membership_index_max_entries`
+// pairs, until the cache is rebuilt.
+//
+// Key-value pairs are delegated to `key_value_cache`.
+// One cache object is only for keys in one namespace.
+class InternedKeyValueSetCache : public Cache {
+ public:
+  struct Options {
+    // Key prefixes of the sets to keep in the reverse membership index, e.g.
+    // "audience:". Empty disables the index.
+    std::vector<std::string> membership_index_key_prefixes;
+    // Maximum number of (member, set key) pairs in the index.
+    int64_t membership_index_max_entries = 10'000'000;
+  };
+
+  ~InternedKeyValueSetCache() override;
+
+  // Looks up and returns key-value pairs for the given keys.
+  absl::flat_hash_map<std::string, std::string> GetKeyValuePairs(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override;
+
+  // Looks up the given keys and returns views of their values.
+  GetKeyValuePairsResult GetKeyValuePairViews(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override;
+
+  GetKeyValuePairsResult GetHashedKeyValuePairViews(
+      const RequestContext& request_context,
+      absl::Span<const HashedKey> keys) const override;
+
+  // Looks up and returns key-value set result for the given key set.
+  std::unique_ptr<GetKeyValueSetResult> GetKeyValueSet(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override;
+
+  // Returns the indexed sets that `member` is a live member of. Fails with
+  // resource exhausted once the index has grown past its limit.
+  absl::StatusOr<std::vector<std::string>> GetSetsContaining(
+      std::string_view member) const override;
+
+  // Inserts or updates the key with the new value for a given prefix
+  void UpdateKeyValue(std::string_view key, std::string_view value,
+                      int64_t logical_commit_time,
+                      std::string_view prefix = "") override;
+
+  // Inserts or updates values in the set for a given key and prefix, if a value
+  // exists, updates its timestamp to the latest logical commit time.
+  void UpdateKeyValueSet(std::string_view key,
+                         absl::Span<std::string_view> input_value_set,
+                         int64_t logical_commit_time,
+                         std::string_view prefix = "") override;
+
+  // Deletes a particular (key, value) pair for a given prefix.
+  void DeleteKey(std::string_view key, int64_t logical_commit_time,
+                 std::string_view prefix = "") override;
+
+  // Deletes values in the set for a given key and prefix. The deleted values
+  // are kept and marked "deleted", in case there are late-arriving updates to
+  // them.
+  void DeleteValuesInSet(std::string_view key,
+                         absl::Span<std::string_view> value_set,
+                         int64_t logical_commit_time,
+                         std::string_view prefix = "") override;
+
+  // Applies the key-value pair mutations to `key_value_cache` as one batch.
+  void ApplyMutations(absl::Span<const Mutation> mutations,
+                      std::string_view prefix = "") override;
+
+  // Removes the values that were deleted before the specified
+  // logical_commit_time for a given prefix.
+  void RemoveDeletedKeys(int64_t logical_commit_time,
+                         std::string_view prefix = "") override;
+
+  // Cleans up the key-value pairs until `deadline`, and the key-value sets at
+  // once after the pairs are done.
+  CleanupProgress RemoveDeletedKeysSlice(int64_t logical_commit_time,
+                                         std::string_view prefix,
+                                         absl::Time deadline) override;
+
+  static std::unique_ptr<Cache> Create(
+      std::unique_ptr<Cache> key_value_cache);
+  static std::unique_ptr<Cache> Create(std::unique_ptr<Cache> key_value_cache,
+                                       Options options);
+
+  // Returns the pairs, members, estimated bytes and overflows of the reverse
+  // membership indexes of all the caches of the process, see
+  // `kSetMembershipIndexStatNames`. Exported as the `kSetMembershipIndexStats`
+  // gauge.
+  static absl::flat_hash_map<std::string, double>
+  GetMembershipIndexStatsOfAllCaches();
+
+ private:
+  struct SetValueMeta {
+    // Last logical commit time for a value
+    int64_t last_logical_commit_time = 0;
+    // Deleted values are kept until cleanup, see
+    // `KeyValueCache::SetValueMeta`.
+    bool is_deleted = false;
+  };
+  using ValueSet = absl::flat_hash_map<uint32_t, SetValueMeta>;
+  // Guarded by `mutex`.
+  struct ValueSetEntry {
+    absl::Mutex mutex;
+    ValueSet value_set;
+    // Ids of the members of `value_set` that are not deleted.
+    IdBitmap live_ids;
+    // Id of the key, interned once the set has live members if the key is
+    // indexed. Holds one reference.
+    std::optional<uint32_t> key_id;
+  };
+
+  InternedKeyValueSetCache(std::unique_ptr<Cache> key_value_cache,
+                           Options options);
+
+  bool IsMembershipIndexed(std::string_view key) const;
+  // Returns the id of the key of `entry`, interning it on first use.
+  uint32_t GetOrInternKeyId(ValueSetEntry& entry, std::string_view key);
+  // Adds or removes the pairs of `key_id` and each of `member_ids`.
+  void AddToMembershipIndex(uint32_t key_id,
+                            absl::Span<const uint32_t> member_ids)
+      ABSL_LOCKS_EXCLUDED(membership_index_mutex_);
+  void RemoveFromMembershipIndex(uint32_t key_id,
+                                 absl::Span<const uint32_t> member_ids)
+      ABSL_LOCKS_EXCLUDED(membership_index_mutex_);
+
+  // Removes deleted key-values from key-value_set map for a given prefix
+  void CleanUpKeyValueSetMap(int64_t logical_commit_time,
+                             std::string_view prefix);
+  // Logs cache access metrics for cache hit or miss counts. The cache access
+  // event name is defined in server_definition.h file
+  void LogCacheAccessMetrics(const RequestContext& request_context,
+                             std::string_view cache_access_event) const;
+
+  // Every id stored in the maps below holds one reference in the dictionary.
+  // Declared first so that it outlives them.
+  ValueDictionary dictionary_;
+  std::unique_ptr<Cache> key_value_cache_;
+
+  // mutex for key value set map;
+  mutable absl::Mutex set_map_mutex_;
+  // The key is the prefix and the value is the
+  // maximum timestamp that was passed to RemoveDeletedKeys.
+  absl::flat_hash_map<std::string, int64_t> max_cleanup_logical_commit_time_map_
+      ABSL_GUARDED_BY(set_map_mutex_);
+  // Mapping from a key to its member ids, see
+  // `KeyValueCache::key_to_value_set_map_`.
+  absl::flat_hash_map<std::string, std::unique_ptr<ValueSetEntry>>
+      key_to_value_set_map_ ABSL_GUARDED_BY(set_map_mutex_);
+  // Per prefix, sorted mapping from logical timestamp to the keys and member
+  // ids that were deleted at that time.
+  absl::flat_hash_map<
+      std::string,
+      absl::btree_map<int64_t,
+                      absl::flat_hash_map<std::string,
+                                          absl::flat_hash_set<uint32_t>>>>
+      deleted_set_nodes_map_ ABSL_GUARDED_BY(set_map_mutex_);
+
+  const std::vector<std::string> membership_index_key_prefixes_;
+  const int64_t membership_index_max_entries_;
+  // Locked after `set_map_mutex_` and the key mutexes. The pairs hold no
+  // references: a member only has pairs while it is live in a set, whose
+  // value set holds its reference, and a key only while its set has live
+  // members.
+  mutable absl::Mutex membership_index_mutex_;
+  // From member id to the sorted ids of the keys of the sets it is live in.
+  absl::flat_hash_map<uint32_t, std::vector<uint32_t>> sets_by_member_
+      ABSL_GUARDED_BY(membership_index_mutex_);
+  int64_t num_membership_index_entries_
+      ABSL_GUARDED_BY(membership_index_mutex_) = 0;
+  // Set once the index grew past its limit, after which it is kept empty.
+  bool membership_index_overflowed_ ABSL_GUARDED_BY(membership_index_mutex_) =
+      false;
+
+  friend class InternedKeyValueSetCacheTestPeer;
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_CACHE_INTERNED_KEY_VALUE_SET_CACHE_H_
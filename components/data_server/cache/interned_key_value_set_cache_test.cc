@@ -0,0 +1,314 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/data_server/cache/interned_key_value_set_cache.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/notification.h"
+#include "components/data_server/cache/cache.h"
+#include "components/data_server/cache/key_value_cache.h"
+#include "components/data_server/cache/mocks.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+
+class InternedKeyValueSetCacheTestPeer {
+ public:
+  InternedKeyValueSetCacheTestPeer() = delete;
+  static size_t GetDictionarySize(const Cache& c) {
+    return static_cast<const InternedKeyValueSetCache&>(c).dictionary_.size();
+  }
+  static int GetDeletedSetNodesMapSize(const Cache& c,
+                                       std::string prefix = "") {
+    const auto& cache = static_cast<const InternedKeyValueSetCache&>(c);
+    absl::MutexLock lock(&cache.set_map_mutex_);
+    auto map_itr = cache.deleted_set_nodes_map_.find(prefix);
+    return map_itr == cache.deleted_set_nodes_map_.end()
+               ? 0
+               : map_itr->second.size();
+  }
+};
+
+namespace {
+
+using testing::ElementsAre;
+using testing::IsEmpty;
+using testing::UnorderedElementsAre;
+
+class InternedSetCacheTest : public ::testing::Test {
+ protected:
+  InternedSetCacheTest() {
+    InitMetricsContextMap();
+    scope_metrics_context_ = std::make_unique<ScopeMetricsContext>();
+    request_context_ =
+        std::make_unique<RequestContext>(*scope_metrics_context_);
+  }
+  std::unique_ptr<Cache> CreateCache() {
+    return InternedKeyValueSetCache::Create(KeyValueCache::Create());
+  }
+  std::unique_ptr<Cache> CreateIndexedCache(int64_t max_entries = 100) {
+    return InternedKeyValueSetCache::Create(
+        KeyValueCache::Create(),
+        {.membership_index_key_prefixes = {"audience:"},
+         .membership_index_max_entries = max_entries});
+  }
+  RequestContext& GetRequestContext() { return *request_context_; }
+  std::unique_ptr<ScopeMetricsContext> scope_metrics_context_;
+  std::unique_ptr<RequestContext> request_context_;
+};
+
+TEST_F(InternedSetCacheTest, KeyValuePairsAreDelegated) {
+  std::unique_ptr<Cache> cache = CreateCache();
+  cache->UpdateKeyValue("my_key", "my_value", 1);
+  cache->DeleteKey("other_key", 1);
+  EXPECT_THAT(
+      cache->GetKeyValuePairs(GetRequestContext(), {"my_key", "other_key"}),
+      UnorderedElementsAre(KVPairEq("my_key", "my_value")));
+}
+
+TEST_F(InternedSetCacheTest, SharedMembersAreStoredOnce) {
+  std::unique_ptr<Cache> cache = CreateCache();
+  std::vector<std::string_view> values1 = {"v1", "v2", "v3"};
+  std::vector<std::string_view> values2 = {"v2", "v3", "v4"};
+  cache->UpdateKeyValueSet("key1", absl::MakeSpan(values1), 1);
+  cache->UpdateKeyValueSet("key2", absl::MakeSpan(values2), 1);
+  EXPECT_EQ(InternedKeyValueSetCacheTestPeer::GetDictionarySize(*cache), 4);
+  auto result = cache->GetKeyValueSet(GetRequestContext(),
+                                      {"key1", "key2", "missing_key"});
+  EXPECT_THAT(result->GetValueSet("key1"),
+              UnorderedElementsAre("v1", "v2", "v3"));
+  EXPECT_THAT(result->GetValueSet("key2"),
+              UnorderedElementsAre("v2", "v3", "v4"));
+  EXPECT_TRUE(result->GetValueSet("missing_key").empty());
+}
+
+TEST_F(InternedSetCacheTest, DeletedValuesAreHidden) {
+  std::unique_ptr<Cache> cache = CreateCache();
+  std::vector<std::string_view> values = {"v1", "v2", "v3"};
+  std::vector<std::string_view> values_to_delete = {"v1", "v2"};
+  cache->UpdateKeyValueSet("my_key", absl::MakeSpan(values), 1);
+  cache->DeleteValuesInSet("my_key", absl::MakeSpan(values_to_delete), 2);
+  EXPECT_THAT(cache->GetKeyValueSet(GetRequestContext(), {"my_key"})
+                  ->GetValueSet("my_key"),
+              UnorderedElementsAre("v3"));
+  EXPECT_EQ(
+      InternedKeyValueSetCacheTestPeer::GetDeletedSetNodesMapSize(*cache), 1);
+}
+
+TEST_F(InternedSetCacheTest, ResultHasBitmapsOfLiveMembers) {
+  std::unique_ptr<Cache> cache = CreateCache();
+  std::vector<std::string_view> values1 = {"v1", "v2", "v3"};
+  std::vector<std::string_view> values2 = {"v2", "v3", "v4"};
+  std::vector<std::string_view> values_to_delete = {"v3"};
+  cache->UpdateKeyValueSet("key1", absl::MakeSpan(values1), 1);
+  cache->UpdateKeyValueSet("key2", absl::MakeSpan(values2), 1);
+  cache->DeleteValuesInSet("key2", absl::MakeSpan(values_to_delete), 2);
+  auto result = cache->GetKeyValueSet(GetRequestContext(),
+                                      {"key1", "key2", "missing_key"});
+  ASSERT_TRUE(result->HasValueBitmaps());
+  IdBitmap key1_ids = result->GetValueBitmap("key1");
+  IdBitmap key2_ids = result->GetValueBitmap("key2");
+  EXPECT_EQ(key1_ids.Cardinality(), 3);
+  EXPECT_TRUE(result->GetValueBitmap("missing_key").IsEmpty());
+  key1_ids &= key2_ids;
+  std::vector<std::string_view> shared_values;
+  key1_ids.ForEach([&result, &shared_values](uint32_t id) {
+    shared_values.push_back(result->GetValueForId(id));
+  });
+  EXPECT_THAT(shared_values, UnorderedElementsAre("v2"));
+  EXPECT_THAT(result->GetValueSet("key2"), UnorderedElementsAre("v2", "v4"));
+}
+
+TEST_F(InternedSetCacheTest, OutOfOrderUpdatesAreIgnored) {
+  std::unique_ptr<Cache> cache = CreateCache();
+  std::vector<std::string_view> values = {"v1", "v2"};
+  std::vector<std::string_view> late_values = {"v1", "v3"};
+  cache->DeleteValuesInSet("my_key", absl::MakeSpan(values), 3);
+  cache->UpdateKeyValueSet("my_key", absl::MakeSpan(late_values), 2);
+  EXPECT_THAT(cache->GetKeyValueSet(GetRequestContext(), {"my_key"})
+                  ->GetValueSet("my_key"),
+              UnorderedElementsAre("v3"));
+  cache->UpdateKeyValueSet("my_key", absl::MakeSpan(values), 4);
+  EXPECT_THAT(cache->GetKeyValueSet(GetRequestContext(), {"my_key"})
+                  ->GetValueSet("my_key"),
+              UnorderedElementsAre("v1", "v2", "v3"));
+}
+
+TEST_F(InternedSetCacheTest, CleanupReleasesDictionaryEntries) {
+  std::unique_ptr<Cache> cache = CreateCache();
+  std::vector<std::string_view> values = {"v1", "v2"};
+  cache->UpdateKeyValueSet("key1", absl::MakeSpan(values), 1);
+  cache->UpdateKeyValueSet("key2", absl::MakeSpan(values), 1);
+  cache->DeleteValuesInSet("key1", absl::MakeSpan(values), 2);
+  cache->DeleteValuesInSet("key2", absl::MakeSpan(values), 3);
+  cache->DeleteValuesInSet("key2", absl::MakeSpan(values), 4);
+  cache->RemoveDeletedKeys(3);
+  // `key2` was deleted again after the cutoff, so its tombstones survive.
+  EXPECT_EQ(InternedKeyValueSetCacheTestPeer::GetDictionarySize(*cache), 2);
+  cache->RemoveDeletedKeys(4);
+  EXPECT_EQ(InternedKeyValueSetCacheTestPeer::GetDictionarySize(*cache), 0);
+  EXPECT_EQ(
+      InternedKeyValueSetCacheTestPeer::GetDeletedSetNodesMapSize(*cache), 0);
+  // Updates older than the cutoff are dropped.
+  cache->UpdateKeyValueSet("key1", absl::MakeSpan(values), 4);
+  EXPECT_TRUE(cache->GetKeyValueSet(GetRequestContext(), {"key1"})
+                  ->GetValueSet("key1")
+                  .empty());
+}
+
+TEST_F(InternedSetCacheTest, CleanupPerPrefix) {
+  std::unique_ptr<Cache> cache = CreateCache();
+  std::vector<std::string_view> values = {"v1"};
+  cache->DeleteValuesInSet("key1", absl::MakeSpan(values), 2, "prefix1");
+  cache->DeleteValuesInSet("key2", absl::MakeSpan(values), 2, "prefix2");
+  cache->RemoveDeletedKeys(3, "prefix1");
+  EXPECT_EQ(InternedKeyValueSetCacheTestPeer::GetDeletedSetNodesMapSize(
+                *cache, "prefix1"),
+            0);
+  EXPECT_EQ(InternedKeyValueSetCacheTestPeer::GetDeletedSetNodesMapSize(
+                *cache, "prefix2"),
+            1);
+  EXPECT_EQ(InternedKeyValueSetCacheTestPeer::GetDictionarySize(*cache), 1);
+}
+
+TEST_F(InternedSetCacheTest, ApplyMutationsUpdatesPairsAndSets) {
+  std::unique_ptr<Cache> cache = CreateCache();
+  std::vector<std::string_view> values = {"v1", "v2"};
+  std::vector<std::string_view> values_to_delete = {"v1"};
+  const std::vector<Cache::Mutation> mutations = {
+      {.type = Cache::Mutation::Type::kUpdateKeyValue,
+       .key = "key1",
+       .value = "value1",
+       .logical_commit_time = 1},
+      {.type = Cache::Mutation::Type::kUpdateKeyValueSet,
+       .key = "key2",
+       .value_set = absl::MakeSpan(values),
+       .logical_commit_time = 1},
+      {.type = Cache::Mutation::Type::kDeleteValuesInSet,
+       .key = "key2",
+       .value_set = absl::MakeSpan(values_to_delete),
+       .logical_commit_time = 2},
+  };
+  cache->ApplyMutations(mutations);
+  EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(), {"key1"}),
+              UnorderedElementsAre(KVPairEq("key1", "value1")));
+  EXPECT_THAT(cache->GetKeyValueSet(GetRequestContext(), {"key2"})
+                  ->GetValueSet("key2"),
+              UnorderedElementsAre("v2"));
+}
+
+TEST_F(InternedSetCacheTest, MembershipIndexIsDisabledByDefault) {
+  std::unique_ptr<Cache> cache = CreateCache();
+  EXPECT_EQ(cache->GetSetsContaining("v1").status().code(),
+            absl::StatusCode::kUnimplemented);
+}
+
+TEST_F(InternedSetCacheTest, MembershipIndexFindsIndexedSets) {
+  std::unique_ptr<Cache> cache = CreateIndexedCache();
+  std::vector<std::string_view> values1 = {"ad1", "ad2"};
+  std::vector<std::string_view> values2 = {"ad2", "ad3"};
+  cache->UpdateKeyValueSet("audience:b", absl::MakeSpan(values1), 1);
+  cache->UpdateKeyValueSet("audience:a", absl::MakeSpan(values2), 1);
+  cache->UpdateKeyValueSet("other", absl::MakeSpan(values1), 1);
+  EXPECT_THAT(*cache->GetSetsContaining("ad2"),
+              ElementsAre("audience:a", "audience:b"));
+  EXPECT_THAT(*cache->GetSetsContaining("ad1"), ElementsAre("audience:b"));
+  EXPECT_THAT(*cache->GetSetsContaining("missing"), IsEmpty());
+  const auto stats =
+      InternedKeyValueSetCache::GetMembershipIndexStatsOfAllCaches();
+  EXPECT_EQ(stats.at(std::string(kSetMembershipIndexEntries)), 4);
+  EXPECT_EQ(stats.at(std::string(kSetMembershipIndexMembers)), 3);
+}
+
+TEST_F(InternedSetCacheTest, MembershipIndexFollowsDeletesAndCleanup) {
+  std::unique_ptr<Cache> cache = CreateIndexedCache();
+  std::vector<std::string_view> values = {"ad1", "ad2"};
+  std::vector<std::string_view> values_to_delete = {"ad1"};
+  cache->UpdateKeyValueSet("audience:a", absl::MakeSpan(values), 1);
+  cache->DeleteValuesInSet("audience:a", absl::MakeSpan(values_to_delete), 2);
+  EXPECT_THAT(*cache->GetSetsContaining("ad1"), IsEmpty());
+  EXPECT_THAT(*cache->GetSetsContaining("ad2"), ElementsAre("audience:a"));
+  // A later update adds the member back.
+  cache->UpdateKeyValueSet("audience:a", absl::MakeSpan(values_to_delete), 3);
+  EXPECT_THAT(*cache->GetSetsContaining("ad1"), ElementsAre("audience:a"));
+  cache->DeleteValuesInSet("audience:a", absl::MakeSpan(values), 4);
+  cache->RemoveDeletedKeys(4);
+  EXPECT_THAT(*cache->GetSetsContaining("ad1"), IsEmpty());
+  // The key was released with its set.
+  EXPECT_EQ(InternedKeyValueSetCacheTestPeer::GetDictionarySize(*cache), 0);
+}
+
+TEST_F(InternedSetCacheTest, MembershipIndexIsDroppedPastItsLimit) {
+  std::unique_ptr<Cache> cache = CreateIndexedCache(/*max_entries=*/2);
+  std::vector<std::string_view> values = {"ad1", "ad2", "ad3"};
+  cache->UpdateKeyValueSet("audience:a", absl::MakeSpan(values), 1);
+  EXPECT_EQ(cache->GetSetsContaining("ad1").status().code(),
+            absl::StatusCode::kResourceExhausted);
+  // The sets themselves are still served.
+  EXPECT_THAT(cache->GetKeyValueSet(GetRequestContext(), {"audience:a"})
+                  ->GetValueSet("audience:a"),
+              UnorderedElementsAre("ad1", "ad2", "ad3"));
+}
+
+TEST_F(InternedSetCacheTest, ConcurrentUpdatesAndReads) {
+  std::unique_ptr<Cache> cache = CreateCache();
+  absl::Notification start;
+  auto writer = [&cache, &start](int offset) {
+    start.WaitForNotification();
+    for (int i = 0; i < 500; i++) {
+      std::string value = absl::StrCat("value", i % 20);
+      std::vector<std::string_view> values = {value};
+      cache->UpdateKeyValueSet(absl::StrCat("key", i % 10),
+                               absl::MakeSpan(values), offset + i * 3);
+      cache->DeleteValuesInSet(absl::StrCat("key", (i + 1) % 10),
+                               absl::MakeSpan(values), offset + i * 3);
+      if (i % 50 == 0) {
+        cache->RemoveDeletedKeys(offset + i * 3 - 300);
+      }
+    }
+  };
+  auto reader = [this, &cache, &start]() {
+    start.WaitForNotification();
+    for (int i = 0; i < 500; i++) {
+      const std::string key = absl::StrCat("key", i % 10);
+      auto result =
+          cache->GetKeyValueSet(GetRequestContext(), {std::string_view(key)});
+      for (std::string_view value : result->GetValueSet(key)) {
+        EXPECT_TRUE(absl::StartsWith(value, "value"));
+      }
+    }
+  };
+  std::vector<std::thread> threads;
+  threads.emplace_back(writer, 1);
+  threads.emplace_back(writer, 2);
+  threads.emplace_back(reader);
+  threads.emplace_back(reader);
+  start.Notify();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+}  // namespace
+}  // namespace kv_server
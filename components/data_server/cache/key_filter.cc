@@ -0,0 +1,72 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/data_server/cache/key_filter.h"
+
+#include <algorithm>
+
+#include "absl/hash/hash.h"
+
+namespace kv_server {
+namespace {
+
+// Remixes the key hash for the bit positions, which are taken from its lower
+// bits while the block comes from its upper bits.
+constexpr uint64_t kProbeMultiplier = 0x9e3779b97f4a7c15;
+// Each probe takes 9 bits of the remixed hash to address 512 bits.
+constexpr int kBitsPerProbe = 9;
+
+}  // namespace
+
+KeyFilter::KeyFilter(int64_t capacity)
+    : capacity_(std::max(capacity, kMinCapacity)),
+      num_blocks_(
+          (capacity_ * kBitsPerKey + kWordsPerBlock * 64 - 1) /
+          (kWordsPerBlock * 64)),
+      words_(num_blocks_ * kWordsPerBlock, 0) {}
+
+size_t KeyFilter::BlockIndex(uint64_t hash) const {
+  // Maps the upper 32 bits to [0, num_blocks_) without a division.
+  return (((hash >> 32) * num_blocks_) >> 32) * kWordsPerBlock;
+}
+
+void KeyFilter::Add(std::string_view key) {
+  const uint64_t hash = absl::Hash<std::string_view>{}(key);
+  uint64_t* block = &words_[BlockIndex(hash)];
+  uint64_t probes = hash * kProbeMultiplier;
+  for (int i = 0; i < kNumProbes; ++i, probes >>= kBitsPerProbe) {
+    const uint64_t bit = probes & ((1 << kBitsPerProbe) - 1);
+    block[bit / 64] |= uint64_t{1} << (bit % 64);
+  }
+  ++size_;
+}
+
+bool KeyFilter::MayContain(std::string_view key) const {
+  return MayContain(HashedKey(key));
+}
+
+bool KeyFilter::MayContain(const HashedKey& key) const {
+  const uint64_t hash = key.hash;
+  const uint64_t* block = &words_[BlockIndex(hash)];
+  uint64_t probes = hash * kProbeMultiplier;
+  for (int i = 0; i < kNumProbes; ++i, probes >>= kBitsPerProbe) {
+    const uint64_t bit = probes & ((1 << kBitsPerProbe) - 1);
+    if (!(block[bit / 64] & (uint64_t{1} << (bit % 64)))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace kv_server
@@ -0,0 +1,77 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_CACHE_KEY_FILTER_H_
+#define COMPONENTS_DATA_SERVER_CACHE_KEY_FILTER_H_
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "components/util/hashed_key.h"
+
+namespace kv_server {
+
+// Blocked Bloom filter over keys, used to skip lookups of keys that are
+// definitely not in a cache.
+//
+// Each key sets `kNumProbes` bits of one 512 bit block, so that a probe
+// touches a single cache line. With `kBitsPerKey` bits per key the false
+// positive rate stays around 1% until `capacity` keys were added. Keys can't
+// be removed: the owner rebuilds the filter from its live keys instead.
+//
+// Not thread safe.
+class KeyFilter {
+ public:
+  static constexpr int64_t kMinCapacity = 1024;
+  static constexpr int kBitsPerKey = 10;
+  static constexpr int kNumProbes = 7;
+
+  explicit KeyFilter(int64_t capacity = kMinCapacity);
+
+  void Add(std::string_view key);
+  // Returns false if `key` was definitely not added.
+  bool MayContain(std::string_view key) const;
+  // Same as above, with the hash that the key was looked up with.
+  bool MayContain(const HashedKey& key) const;
+  // Prefetches the block of `key`, so that probing a batch of keys overlaps
+  // their cache misses.
+  void Prefetch(const HashedKey& key) const {
+    __builtin_prefetch(&words_[BlockIndex(key.hash)]);
+  }
+
+  // Number of `Add` calls since the filter was built.
+  int64_t size() const { return size_; }
+  // Number of keys the filter was sized for.
+  int64_t capacity() const { return capacity_; }
+  // Bytes of the bits of the filter.
+  int64_t memory_bytes() const { return words_.size() * sizeof(uint64_t); }
+
+ private:
+  static constexpr int kWordsPerBlock = 8;
+
+  // Returns the index of the first word of the block of `hash`.
+  size_t BlockIndex(uint64_t hash) const;
+
+  int64_t capacity_;
+  int64_t size_ = 0;
+  size_t num_blocks_;
+  std::vector<uint64_t> words_;
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_CACHE_KEY_FILTER_H_
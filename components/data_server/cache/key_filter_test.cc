@@ -0,0 +1,72 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/data_server/cache/key_filter.h"
+
+#include <string>
+
+#include "absl/strings/str_cat.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+TEST(KeyFilterTest, AddedKeysMayBeContained) {
+  KeyFilter filter(10000);
+  for (int i = 0; i < 10000; i++) {
+    filter.Add(absl::StrCat("key", i));
+  }
+  for (int i = 0; i < 10000; i++) {
+    EXPECT_TRUE(filter.MayContain(absl::StrCat("key", i))) << i;
+  }
+  EXPECT_EQ(filter.size(), 10000);
+  EXPECT_EQ(filter.capacity(), 10000);
+}
+
+TEST(KeyFilterTest, EmptyFilterContainsNothing) {
+  KeyFilter filter;
+  EXPECT_EQ(filter.capacity(), KeyFilter::kMinCapacity);
+  EXPECT_FALSE(filter.MayContain(""));
+  EXPECT_FALSE(filter.MayContain("key"));
+}
+
+TEST(KeyFilterTest, HashedKeysMatchKeys) {
+  KeyFilter filter;
+  for (int i = 0; i < 1000; i++) {
+    filter.Add(absl::StrCat("key", i));
+  }
+  for (int i = 0; i < 1000; i++) {
+    const std::string key = absl::StrCat("key", i);
+    EXPECT_TRUE(filter.MayContain(HashedKey(key))) << i;
+    const std::string missing_key = absl::StrCat("missing_key", i);
+    EXPECT_EQ(filter.MayContain(HashedKey(missing_key)),
+              filter.MayContain(missing_key))
+        << i;
+  }
+}
+
+TEST(KeyFilterTest, FalsePositiveRateAtCapacity) {
+  KeyFilter filter(100000);
+  for (int i = 0; i < 100000; i++) {
+    filter.Add(absl::StrCat("key", i));
+  }
+  int false_positives = 0;
+  for (int i = 0; i < 100000; i++) {
+    false_positives += filter.MayContain(absl::StrCat("missing_key", i));
+  }
+  EXPECT_LT(false_positives, 2000);
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -14,18 +14,490 @@
 #include "components/data_server/cache/key_value_cache.h"
 
 #include <algorithm>
+#include <atomic>
+#include <functional>
 #include <memory>
+#include <optional>
+#include <queue>
 #include <string_view>
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/container/inlined_vector.h"
 #include "absl/log/log.h"
 #include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "components/data_server/cache/cache.h"
 #include "components/data_server/cache/get_key_value_set_result.h"
 
 namespace kv_server {
+namespace {
+
+// Number of deleted entries removed between two checks of the cleanup
+// deadline, so that the clock isn't read for every entry.
+constexpr int kDeadlineCheckInterval = 64;
+
+// Number of mutations passed at once by `ExportMutations`.
+constexpr int kExportBatchSize = 1024;
+
+// Live values of a key-value set, copied by `ExportMutations`.
+struct ExportedValueSet {
+  std::string key;
+  std::vector<std::pair<std::string, int64_t>> values;
+};
+
+// zstd recommends about 100 times as many sample bytes as dictionary bytes.
+constexpr int64_t kDictionarySamplesPerByte = 100;
+
+// Compressed values found by a lookup, decompressed once the partition locks
+// are released.
+using CompressedValues = std::vector<std::pair<HashedKey, CompactValue>>;
+
+// Returns a version that no key-value set of any cache had before, so that a
+// version also tells apart the sets of different caches.
+uint64_t NextValueSetVersion() {
+  static std::atomic<uint64_t> next_version = 1;
+  return next_version.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Keys longer than this are truncated in the memory report.
+constexpr int kMaxReportedKeySize = 100;
+
+// Bytes of a slot of a hash table of `T`, with its control byte.
+template <typename T>
+constexpr int64_t SlotBytes() {
+  return sizeof(T) + 1;
+}
+
+// Bytes of the hash of a deleted key in the deleted nodes of a partition.
+constexpr int64_t kTombstoneBytes = sizeof(size_t);
+
+// Bytes of the hash of a deleted value in the deleted set nodes.
+constexpr int64_t kSetTombstoneBytes = SlotBytes<size_t>();
+
+// The caches of the process, for `GetMemoryBytesOfAllCaches`.
+struct CacheRegistry {
+  absl::Mutex mutex;
+  absl::flat_hash_set<const KeyValueCache*> caches ABSL_GUARDED_BY(mutex);
+};
+
+CacheRegistry& GetCacheRegistry() {
+  static auto* const registry = new CacheRegistry();
+  return *registry;
+}
+
+// Keeps the `max_size` largest of the items that are added.
+class LargestItems {
+ public:
+  explicit LargestItems(int max_size) : max_size_(max_size) {}
+
+  // Adds an item of `bytes`, described by `describe` if it is kept.
+  template <typename Describe>
+  void Add(int64_t bytes, Describe&& describe) {
+    if (max_size_ <= 0 || (static_cast<int>(items_.size()) == max_size_ &&
+                           bytes <= items_.top().first)) {
+      return;
+    }
+    items_.emplace(bytes, describe());
+    if (static_cast<int>(items_.size()) > max_size_) {
+      items_.pop();
+    }
+  }
+
+  // Appends a line per item to `report`, largest first.
+  void AppendTo(std::string& report) && {
+    std::vector<std::pair<int64_t, std::string>> items;
+    while (!items_.empty()) {
+      items.push_back(items_.top());
+      items_.pop();
+    }
+    for (auto item = items.rbegin(); item != items.rend(); ++item) {
+      absl::StrAppend(&report, "  ", item->first, " bytes: ", item->second,
+                      "\n");
+    }
+  }
+
+ private:
+  const int max_size_;
+  std::priority_queue<std::pair<int64_t, std::string>,
+                      std::vector<std::pair<int64_t, std::string>>,
+                      std::greater<>>
+      items_;
+};
+
+}  // namespace
+
+KeyValueCache::KeyValueCache()
+    : KeyValueCache(CompressionOptions(), SetLockOptions(), LookupOptions()) {}
+
+KeyValueCache::~KeyValueCache() {
+  CacheRegistry& registry = GetCacheRegistry();
+  absl::MutexLock lock(&registry.mutex);
+  registry.caches.erase(this);
+}
+
+KeyValueCache::KeyValueCache(CompressionOptions compression_options,
+                             SetLockOptions set_lock_options,
+                             LookupOptions lookup_options)
+    : compression_options_(std::move(compression_options)),
+      set_lock_stripes_(std::max(set_lock_options.num_stripes, 0)),
+      probe_batch_size_(std::max(lookup_options.probe_batch_size, 1)) {
+  {
+    CacheRegistry& registry = GetCacheRegistry();
+    absl::MutexLock lock(&registry.mutex);
+    registry.caches.insert(this);
+  }
+  if (compression_options_.min_value_size <= 0) {
+    return;
+  }
+  auto codec = ValueCodec::Create(compression_options_.dictionary,
+                                  compression_options_.level);
+  if (!codec.ok()) {
+    LOG(ERROR) << "Failed to load the value compression dictionary, "
+                  "compressing without dictionary: "
+               << codec.status();
+    codec = ValueCodec::Create(/*dictionary=*/"", compression_options_.level);
+  }
+  absl::MutexLock lock(&codec_mutex_);
+  codec_ = *std::move(codec);
+  codecs_.emplace(codec_->dictionary_id(), codec_);
+  collects_dictionary_samples_ = codec_->dictionary_id() == 0 &&
+                                 compression_options_.trained_dictionary_size >
+                                     0;
+}
+
+KeyValueCache::ValueSetEntry::ValueSetEntry()
+    : pool(std::make_shared<ValuePool>()),
+      live_values(std::make_shared<LiveValueSet>()) {
+  live_values->pool = pool;
+}
+
+std::pair<std::string_view, KeyValueCache::SetValueMeta&>
+KeyValueCache::ValueSetEntry::GetOrAddValue(std::string_view value) {
+  if (const auto [member, meta] = values.FindEntry(value); meta != nullptr) {
+    return {*member, *meta};
+  }
+  pool_bytes += value.size();
+  const std::string_view member = pool->emplace_back(value);
+  return {member, values.Add(member)};
+}
+
+Cache::MemoryUsage KeyValueCache::ValueSetEntry::GetMemoryUsage() const {
+  return {
+      .set_value_bytes = pool_bytes + static_cast<int64_t>(
+                                          pool->size() * sizeof(std::string)),
+      .hash_table_bytes =
+          static_cast<int64_t>(
+              sizeof(ValueSetEntry) + sizeof(ValuePool) +
+              sizeof(LiveValueSet) + values.memory_bytes() +
+              live_values->values.capacity() * SlotBytes<std::string_view>()),
+  };
+}
+
+KeyValueCache::LiveValueSet& KeyValueCache::ValueSetEntry::MutableLiveValues() {
+  // Results only take references while the lock of the set is held, so the
+  // count can't go up concurrently.
+  if (live_values.use_count() > 1) {
+    live_values = std::make_shared<LiveValueSet>(*live_values);
+  } else {
+    // Pairs with the release of the last reference held by a result.
+    std::atomic_thread_fence(std::memory_order_acquire);
+  }
+  version = NextValueSetVersion();
+  return *live_values;
+}
+
+void KeyValueCache::ValueSetEntry::MaybeCompactPool() {
+  if (values.empty() || pool->size() <= 2 * values.size()) {
+    return;
+  }
+  // Results that still reference the old pool keep it alive.
+  auto new_pool = std::make_shared<ValuePool>();
+  // Rebuilt from scratch, so sets that shrank go back to the small form.
+  ValueMetaMap new_values;
+  new_values.Reserve(values.size());
+  auto new_live_values = std::make_shared<LiveValueSet>();
+  new_live_values->pool = new_pool;
+  new_live_values->values.reserve(live_values->values.size());
+  int64_t new_pool_bytes = 0;
+  values.ForEach([&](std::string_view value, const SetValueMeta& meta) {
+    std::string_view new_value = new_pool->emplace_back(value);
+    new_pool_bytes += new_value.size();
+    new_values.Add(new_value) = meta;
+    if (!meta.is_deleted) {
+      new_live_values->values.insert(new_value);
+    }
+  });
+  pool = std::move(new_pool);
+  pool_bytes = new_pool_bytes;
+  values = std::move(new_values);
+  live_values = std::move(new_live_values);
+}
+
+template <typename Key>
+KeyValueCache::SetEntryRef KeyValueCache::FindSetEntry(const Key& key) {
+  if (set_lock_stripes_.empty()) {
+    const auto it = key_to_value_set_map_.find(key);
+    if (it == key_to_value_set_map_.end()) {
+      return {};
+    }
+    return {.entry = &it->second->entry, .mutex = &it->second->mutex};
+  }
+  const auto it = key_to_inline_value_set_map_.find(key);
+  if (it == key_to_inline_value_set_map_.end()) {
+    return {};
+  }
+  return {.entry = &it->second,
+          .mutex = &set_lock_stripes_[StringHash()(key) %
+                                      set_lock_stripes_.size()]};
+}
+
+template <typename Key>
+KeyValueCache::ConstSetEntryRef KeyValueCache::FindSetEntry(
+    const Key& key) const {
+  if (set_lock_stripes_.empty()) {
+    const auto it = key_to_value_set_map_.find(key);
+    if (it == key_to_value_set_map_.end()) {
+      return {};
+    }
+    return {.entry = &it->second->entry, .mutex = &it->second->mutex};
+  }
+  const auto it = key_to_inline_value_set_map_.find(key);
+  if (it == key_to_inline_value_set_map_.end()) {
+    return {};
+  }
+  return {.entry = &it->second,
+          .mutex = &set_lock_stripes_[StringHash()(key) %
+                                      set_lock_stripes_.size()]};
+}
+
+void KeyValueCache::AddSetEntry(std::string_view key, ValueSetEntry entry) {
+  set_key_bytes_ += key.size();
+  AddSetEntryMemoryUsage({}, entry.GetMemoryUsage());
+  if (set_lock_stripes_.empty()) {
+    auto owned_entry = std::make_unique<OwnedValueSetEntry>();
+    owned_entry->entry = std::move(entry);
+    key_to_value_set_map_.emplace(key, std::move(owned_entry));
+    return;
+  }
+  key_to_inline_value_set_map_.emplace(key, std::move(entry));
+}
+
+void KeyValueCache::EraseSetEntry(HashedString key) {
+  if (set_lock_stripes_.empty()) {
+    if (const auto it = key_to_value_set_map_.find(key);
+        it != key_to_value_set_map_.end()) {
+      set_key_bytes_ -= it->first.size();
+      key_to_value_set_map_.erase(it);
+    }
+    return;
+  }
+  if (const auto it = key_to_inline_value_set_map_.find(key);
+      it != key_to_inline_value_set_map_.end()) {
+    set_key_bytes_ -= it->first.size();
+    key_to_inline_value_set_map_.erase(it);
+  }
+}
+
+template <typename Fn>
+void KeyValueCache::ForEachSetEntry(Fn&& fn) const {
+  for (const auto& [key, owned_entry] : key_to_value_set_map_) {
+    fn(key, owned_entry->entry, owned_entry->mutex);
+  }
+  for (const auto& [key, entry] : key_to_inline_value_set_map_) {
+    fn(key, entry,
+       set_lock_stripes_[StringHash()(key) % set_lock_stripes_.size()]);
+  }
+}
+
+int64_t KeyValueCache::NumSetKeys() const {
+  return key_to_value_set_map_.size() + key_to_inline_value_set_map_.size();
+}
+
+bool KeyValueCache::IsBeforeSetCleanupCutoff(
+    std::string_view prefix, int64_t logical_commit_time) const {
+  const auto& cutoffs = max_cleanup_logical_commit_time_map_for_set_cache_;
+  const auto it = cutoffs.find(prefix);
+  const int64_t max_cleanup_logical_commit_time =
+      it == cutoffs.end() ? 0 : it->second;
+  if (logical_commit_time <= max_cleanup_logical_commit_time) {
+    VLOG(1) << "Skipping the update as its logical_commit_time: "
+            << logical_commit_time << " is older than the current cutoff time:"
+            << max_cleanup_logical_commit_time;
+    return true;
+  }
+  return false;
+}
+
+template <typename Fn>
+void KeyValueCache::MutateSetEntry(std::string_view key,
+                                   std::string_view prefix,
+                                   int64_t logical_commit_time,
+                                   CacheLockOperation operation, Fn&& fn) {
+  if (!set_lock_stripes_.empty()) {
+    // Sets of existing keys are changed under a shared lock of the map, held
+    // until the change is done since adding a key can move the sets.
+    CacheReaderMutexLock lock_map(&set_map_mutex_, CacheMutex::kSetMap);
+    if (IsBeforeSetCleanupCutoff(prefix, logical_commit_time)) {
+      return;
+    }
+    if (const SetEntryRef entry = FindSetEntry(key); entry.entry != nullptr) {
+      CacheMutexLock key_lock(entry.mutex, CacheMutex::kValueSet, operation);
+      fn(*entry.entry);
+      return;
+    }
+  }
+  std::unique_ptr<CacheMutexLock> key_lock;
+  ValueSetEntry* existing_entry;
+  // The max cleanup time needs to be locked before doing this comparison
+  {
+    CacheMutexLock lock_map(&set_map_mutex_, CacheMutex::kSetMap, operation);
+    if (IsBeforeSetCleanupCutoff(prefix, logical_commit_time)) {
+      return;
+    }
+    SetEntryRef entry = FindSetEntry(key);
+    if (entry.entry == nullptr || !set_lock_stripes_.empty()) {
+      // New sets are filled before lookups can see them. Sets in the table
+      // don't need their stripe either, no other change can run.
+      if (entry.entry == nullptr) {
+        VLOG(9) << key << " is a new key. Adding it";
+        AddSetEntry(key, ValueSetEntry());
+        entry = FindSetEntry(key);
+      }
+      fn(*entry.entry);
+      return;
+    }
+    // Lock the key
+    key_lock = std::make_unique<CacheMutexLock>(entry.mutex,
+                                                CacheMutex::kValueSet,
+                                                operation);
+    existing_entry = entry.entry;
+  }  // end locking map
+  fn(*existing_entry);
+  // end locking key
+}
+
+KeyValueCache::Partition& KeyValueCache::GetPartition(
+    std::string_view prefix, CacheLockOperation operation) {
+  {
+    CacheReaderMutexLock lock(&mutex_, CacheMutex::kPartitionMap);
+    if (const auto it = partitions_.find(prefix); it != partitions_.end()) {
+      return *it->second;
+    }
+  }
+  CacheMutexLock lock(&mutex_, CacheMutex::kPartitionMap, operation);
+  auto& partition = partitions_[prefix];
+  if (partition == nullptr) {
+    partition = std::make_unique<Partition>();
+  }
+  return *partition;
+}
+
+template <typename Fn>
+void KeyValueCache::ForEachKeyValuePair(
+    const RequestContext& request_context,
+    absl::Span<const HashedKey> keys, Fn&& fn) const {
+  int num_filtered_keys = 0;
+  int num_false_positives = 0;
+  CacheReaderMutexLock lock(&mutex_, CacheMutex::kPartitionMap);
+  if (partitions_.size() == 1) {
+    const Partition& partition = *partitions_.begin()->second;
+    CacheReaderMutexLock partition_lock(&partition.mutex,
+                                        CacheMutex::kPartition);
+    int num_probed_keys = 0;
+    ProbePartition(partition, keys,
+                   [&](size_t index, const CacheValue* cache_value) {
+                     ++num_probed_keys;
+                     if (cache_value == nullptr || cache_value->is_deleted()) {
+                       ++num_false_positives;
+                       return;
+                     }
+                     fn(keys[index], *cache_value);
+                   });
+    num_filtered_keys = keys.size() - num_probed_keys;
+    LogKeyFilterMetrics(request_context, num_filtered_keys,
+                        num_false_positives);
+    return;
+  }
+  // The entry of every key, in the order of `keys`, from the partition that
+  // has the most recent one.
+  struct Candidate {
+    std::optional<CacheValue> value;
+    bool may_contain = false;
+  };
+  std::vector<Candidate> candidates(keys.size());
+  for (const auto& [prefix, partition] : partitions_) {
+    CacheReaderMutexLock partition_lock(&partition->mutex,
+                                        CacheMutex::kPartition);
+    ProbePartition(*partition, keys,
+                   [&candidates](size_t index, const CacheValue* cache_value) {
+                     Candidate& current = candidates[index];
+                     current.may_contain = true;
+                     if (cache_value == nullptr ||
+                         (current.value.has_value() &&
+                          cache_value->last_logical_commit_time() <=
+                              current.value->last_logical_commit_time())) {
+                       return;
+                     }
+                     current.value = *cache_value;
+                   });
+  }
+  auto candidate = candidates.begin();
+  for (const HashedKey& key : keys) {
+    const Candidate& current = *candidate++;
+    if (!current.may_contain) {
+      ++num_filtered_keys;
+    } else if (!current.value.has_value() || current.value->is_deleted()) {
+      ++num_false_positives;
+    } else {
+      fn(key, *current.value);
+    }
+  }
+  LogKeyFilterMetrics(request_context, num_filtered_keys, num_false_positives);
+}
+
+template <typename Fn>
+void KeyValueCache::ProbePartition(const Partition& partition,
+                                   absl::Span<const HashedKey> keys,
+                                   Fn&& fn) const {
+  const auto probe = [&partition, &fn](size_t index, const HashedKey& key)
+      ABSL_SHARED_LOCKS_REQUIRED(partition.mutex) {
+        const auto key_iter = partition.map.find(key);
+        fn(index,
+           key_iter == partition.map.end() ? nullptr : &key_iter->second);
+      };
+  if (probe_batch_size_ == 1 || keys.size() == 1) {
+    for (size_t i = 0; i < keys.size(); ++i) {
+      if (partition.key_filter.MayContain(keys[i])) {
+        probe(i, keys[i]);
+      }
+    }
+    return;
+  }
+  // Indexes in the batch of the keys that the filter doesn't rule out.
+  absl::InlinedVector<size_t, 16> candidates;
+  for (size_t begin = 0; begin < keys.size(); begin += probe_batch_size_) {
+    const absl::Span<const HashedKey> batch =
+        keys.subspan(begin, probe_batch_size_);
+    for (const HashedKey& key : batch) {
+      partition.key_filter.Prefetch(key);
+    }
+    candidates.clear();
+    for (size_t i = 0; i < batch.size(); ++i) {
+      if (partition.key_filter.MayContain(batch[i])) {
+        partition.map.prefetch(batch[i]);
+        candidates.push_back(i);
+      }
+    }
+    for (size_t i : candidates) {
+      probe(begin + i, batch[i]);
+    }
+  }
+}
 
 absl::flat_hash_map<std::string, std::string> KeyValueCache::GetKeyValuePairs(
     const RequestContext& request_context,
@@ -34,15 +506,22 @@ absl::flat_hash_map<std::string, std::string> KeyValueCache::GetKeyValuePairs(
                               kGetValuePairsLatencyInMicros>
       latency_recorder(request_context.GetInternalLookupMetricsContext());
   absl::flat_hash_map<std::string, std::string> kv_pairs;
-  absl::ReaderMutexLock lock(&mutex_);
-  for (std::string_view key : key_set) {
-    const auto key_iter = map_.find(key);
-    if (key_iter == map_.end() || key_iter->second.value == nullptr) {
-      continue;
-    } else {
-      VLOG(9) << "Get called for " << key
-              << ". returning value: " << *(key_iter->second.value);
-      kv_pairs.insert_or_assign(key, *(key_iter->second.value));
+  CompressedValues compressed_values;
+  ForEachKeyValuePair(
+      request_context, HashKeys(key_set),
+      [&kv_pairs, &compressed_values](const HashedKey& key,
+                                      const CacheValue& cache_value) {
+        if (cache_value.is_compressed()) {
+          compressed_values.emplace_back(key, cache_value);
+          return;
+        }
+        VLOG(9) << "Get called for " << key.key
+                << ". returning value: " << cache_value.value();
+        kv_pairs.insert_or_assign(key.key, cache_value.value());
+      });
+  for (const auto& [key, compressed] : compressed_values) {
+    if (auto value = DecodeValue(compressed.value()); value.ok()) {
+      kv_pairs.insert_or_assign(key.key, *std::move(value));
     }
   }
   if (kv_pairs.empty()) {
@@ -53,6 +532,51 @@ absl::flat_hash_map<std::string, std::string> KeyValueCache::GetKeyValuePairs(
   return kv_pairs;
 }
 
+GetKeyValuePairsResult KeyValueCache::GetKeyValuePairViews(
+    const RequestContext& request_context,
+    const absl::flat_hash_set<std::string_view>& key_set) const {
+  return GetHashedKeyValuePairViews(request_context, HashKeys(key_set));
+}
+
+GetKeyValuePairsResult KeyValueCache::GetHashedKeyValuePairViews(
+    const RequestContext& request_context,
+    absl::Span<const HashedKey> keys) const {
+  ScopeLatencyMetricsRecorder<InternalLookupMetricsContext,
+                              kGetValuePairsLatencyInMicros>
+      latency_recorder(request_context.GetInternalLookupMetricsContext());
+  GetKeyValuePairsResult result;
+  CompressedValues compressed_values;
+  ForEachKeyValuePair(
+      request_context, keys,
+      [&result, &compressed_values](const HashedKey& key,
+                                    const CacheValue& cache_value) {
+        if (cache_value.is_compressed()) {
+          compressed_values.emplace_back(key, cache_value);
+          return;
+        }
+        VLOG(9) << "Get called for " << key.key
+                << ". returning value: " << cache_value.value();
+        // Inline values are short, they are copied instead of pinned.
+        if (cache_value.is_inline()) {
+          result.AddValue(key, std::string(cache_value.value()));
+        } else {
+          result.AddValue(key, cache_value.shared_value());
+        }
+      });
+  // The result owns the decompressed values.
+  for (const auto& [key, compressed] : compressed_values) {
+    if (auto value = DecodeValue(compressed.value()); value.ok()) {
+      result.AddValue(key, *std::move(value));
+    }
+  }
+  if (result.empty()) {
+    LogCacheAccessMetrics(request_context, kKeyValueCacheMiss);
+  } else {
+    LogCacheAccessMetrics(request_context, kKeyValueCacheHit);
+  }
+  return result;
+}
+
 std::unique_ptr<GetKeyValueSetResult> KeyValueCache::GetKeyValueSet(
     const RequestContext& request_context,
     const absl::flat_hash_set<std::string_view>& key_set) const {
@@ -60,23 +584,25 @@ std::unique_ptr<GetKeyValueSetResult> KeyValueCache::GetKeyValueSet(
                               kGetKeyValueSetLatencyInMicros>
       latency_recorder(request_context.GetInternalLookupMetricsContext());
   // lock the cache map
-  absl::ReaderMutexLock lock(&set_map_mutex_);
-  auto result = GetKeyValueSetResult::Create();
+  CacheReaderMutexLock lock(&set_map_mutex_, CacheMutex::kSetMap);
+  auto result = GetKeyValueSetResult::CreateVersioned();
   bool cache_hit = false;
   for (const auto& key : key_set) {
     VLOG(8) << "Getting key: " << key;
-    const auto key_itr = key_to_value_set_map_.find(key);
-    if (key_itr != key_to_value_set_map_.end()) {
-      absl::flat_hash_set<std::string_view> value_set;
-      auto set_lock =
-          std::make_unique<absl::ReaderMutexLock>(&key_itr->second->first);
-      for (const auto& v : key_itr->second->second) {
-        if (!v.second.is_deleted) {
-          value_set.emplace(v.first);
-        }
+    if (const ConstSetEntryRef entry = FindSetEntry(key);
+        entry.entry != nullptr) {
+      std::shared_ptr<const LiveValueSet> live_values;
+      {
+        CacheReaderMutexLock set_lock(entry.mutex, CacheMutex::kValueSet);
+        live_values = entry.entry->live_values;
+        result->AddValueSetVersion(key, entry.entry->version);
       }
-      // Add key value set to the result
-      result->AddKeyValueSet(key, std::move(value_set), std::move(set_lock));
+      // Add key value set to the result. The snapshot shares ownership of the
+      // live values, so no lock is kept.
+      const auto* value_set = &live_values->values;
+      result->AddKeyValueSetSnapshot(
+          key, std::shared_ptr<const absl::flat_hash_set<std::string_view>>(
+                   std::move(live_values), value_set));
       cache_hit = true;
     }
   }
@@ -92,107 +618,199 @@ std::unique_ptr<GetKeyValueSetResult> KeyValueCache::GetKeyValueSet(
 void KeyValueCache::UpdateKeyValue(std::string_view key, std::string_view value,
                                    int64_t logical_commit_time,
                                    std::string_view prefix) {
-  ScopeLatencyMetricsRecorder<ServerSafeMetricsContext, kUpdateKeyValueLatency>
-      latency_recorder(KVServerContextMap()->SafeMetric());
+  SampledScopeLatencyMetricsRecorder<kUpdateKeyValueLatency> latency_recorder;
   VLOG(9) << "Received update for [" << key << "] at " << logical_commit_time
           << ". value will be set to: " << value;
-  absl::MutexLock lock(&mutex_);
+  // Compressed before locking the partition.
+  CacheValue cache_value = EncodeValue(value, logical_commit_time);
+  Partition& partition = GetPartition(prefix, CacheLockOperation::kUpdate);
+  CacheMutexLock lock(&partition.mutex, CacheMutex::kPartition,
+                      CacheLockOperation::kUpdate);
+  partition.UpdateKeyValue(key, std::move(cache_value));
+}
+
+KeyValueCache::CacheValue KeyValueCache::EncodeValue(
+    std::string_view value, int64_t logical_commit_time) {
+  if (compression_options_.min_value_size <= 0 ||
+      static_cast<int64_t>(value.size()) <
+          compression_options_.min_value_size) {
+    return CacheValue::Create(value, logical_commit_time);
+  }
+  auto compressed = GetCodecForValue(value)->Compress(value);
+  if (!compressed.ok() || compressed->size() >= value.size()) {
+    if (!compressed.ok()) {
+      LOG(ERROR) << compressed.status();
+    }
+    return CacheValue::Create(value, logical_commit_time);
+  }
+  if (ShouldSampleMetric<kCacheValueCompressionPercent>()) {
+    LogIfError(KVServerContextMap()
+                   ->SafeMetric()
+                   .LogHistogram<kCacheValueCompressionPercent>(
+                       100.0 * compressed->size() / value.size()));
+  }
+  return CacheValue::Create(*compressed, logical_commit_time,
+                            /*is_compressed=*/true);
+}
+
+std::shared_ptr<const ValueCodec> KeyValueCache::GetCodecForValue(
+    std::string_view value) {
+  {
+    absl::ReaderMutexLock lock(&codec_mutex_);
+    if (!collects_dictionary_samples_) {
+      return codec_;
+    }
+  }
+  std::vector<std::string> samples;
+  {
+    absl::MutexLock lock(&codec_mutex_);
+    if (!collects_dictionary_samples_) {
+      return codec_;
+    }
+    dictionary_samples_.emplace_back(value);
+    dictionary_sample_bytes_ += value.size();
+    if (dictionary_sample_bytes_ <
+        kDictionarySamplesPerByte *
+            compression_options_.trained_dictionary_size) {
+      return codec_;
+    }
+    collects_dictionary_samples_ = false;
+    samples = std::move(dictionary_samples_);
+    dictionary_samples_.clear();
+    dictionary_sample_bytes_ = 0;
+  }
+  // Trained without the lock, so that lookups keep decompressing values
+  // meanwhile. `value` is compressed with the new dictionary.
+  TrainDictionary(std::move(samples));
+  absl::MutexLock lock(&codec_mutex_);
+  return codec_;
+}
+
+void KeyValueCache::TrainDictionary(std::vector<std::string> samples) {
+  LOG(INFO) << "Training a value compression dictionary on " << samples.size()
+            << " values";
+  auto dictionary = ValueCodec::TrainDictionary(
+      samples, compression_options_.trained_dictionary_size);
+  if (!dictionary.ok()) {
+    LOG(ERROR) << "Failed to train the value compression dictionary, "
+                  "compressing without dictionary: "
+               << dictionary.status();
+    return;
+  }
+  auto codec = ValueCodec::Create(*dictionary, compression_options_.level);
+  if (!codec.ok()) {
+    LOG(ERROR) << "Failed to load the trained dictionary: " << codec.status();
+    return;
+  }
+  LOG(INFO) << "Trained a value compression dictionary of "
+            << dictionary->size() << " bytes";
+  absl::MutexLock lock(&codec_mutex_);
+  codec_ = *std::move(codec);
+  codecs_.emplace(codec_->dictionary_id(), codec_);
+}
 
-  auto max_cleanup_logical_commit_time =
-      max_cleanup_logical_commit_time_map_[prefix];
+absl::StatusOr<std::string> KeyValueCache::DecodeValue(
+    std::string_view compressed) const {
+  SampledScopeLatencyMetricsRecorder<kCacheValueDecompressionLatency>
+      latency_recorder;
+  std::shared_ptr<const ValueCodec> codec;
+  {
+    absl::ReaderMutexLock lock(&codec_mutex_);
+    if (const auto it = codecs_.find(ValueCodec::DictionaryIdOf(compressed));
+        it != codecs_.end()) {
+      codec = it->second;
+    }
+  }
+  if (codec == nullptr) {
+    LOG(ERROR) << "No codec for the dictionary of a compressed value";
+    return absl::InternalError("No codec for the dictionary of the value");
+  }
+  auto value = codec->Decompress(compressed);
+  if (!value.ok()) {
+    LOG(ERROR) << value.status();
+  }
+  return value;
+}
 
+void KeyValueCache::Partition::UpdateKeyValue(std::string_view key,
+                                              CacheValue cache_value) {
+  const int64_t logical_commit_time = cache_value.last_logical_commit_time();
   if (logical_commit_time <= max_cleanup_logical_commit_time) {
     VLOG(1) << "Skipping the update as its logical_commit_time: "
             << logical_commit_time
             << " is not newer than the current cutoff time:"
             << max_cleanup_logical_commit_time;
-
     return;
   }
+  const auto key_iter = map.find(key);
 
-  const auto key_iter = map_.find(key);
-
-  if (key_iter != map_.end() &&
-      key_iter->second.last_logical_commit_time >= logical_commit_time) {
+  if (key_iter != map.end() &&
+      key_iter->second.last_logical_commit_time() >= logical_commit_time) {
     VLOG(1) << "Skipping the update as its logical_commit_time: "
             << logical_commit_time
             << " is not newer than the current value's time:"
-            << key_iter->second.last_logical_commit_time;
+            << key_iter->second.last_logical_commit_time();
     return;
   }
 
-  if (key_iter != map_.end() &&
-      key_iter->second.last_logical_commit_time < logical_commit_time &&
-      key_iter->second.value == nullptr) {
-    // should always have this, but checking just in case
+  // A deleted key stays in `deleted_nodes` until cleanup reaches the time of
+  // its deletion, which then skips it since it isn't deleted anymore.
+  const bool had_value =
+      key_iter != map.end() && !key_iter->second.is_deleted();
+  if (key_iter == map.end()) {
+    memory_usage.key_bytes += key.size();
+  } else if (had_value) {
+    memory_usage.value_bytes -= key_iter->second.value().size();
+  }
+  memory_usage.value_bytes += cache_value.value().size();
+  const bool is_new_key = key_iter == map.end();
+  map.insert_or_assign(key, std::move(cache_value));
+  if (is_new_key) {
+    AddToKeyFilter(key);
+  }
+}
 
-    if (auto prefix_deleted_nodes_iter = deleted_nodes_map_.find(prefix);
-        prefix_deleted_nodes_iter != deleted_nodes_map_.end()) {
-      auto dl_key_iter = prefix_deleted_nodes_iter->second.find(
-          key_iter->second.last_logical_commit_time);
-      if (dl_key_iter != prefix_deleted_nodes_iter->second.end() &&
-          dl_key_iter->second == key) {
-        prefix_deleted_nodes_iter->second.erase(dl_key_iter);
-      }
-    }
+void KeyValueCache::Partition::AddToKeyFilter(std::string_view key) {
+  if (key_filter.size() >= key_filter.capacity()) {
+    // `map` already has the key.
+    RebuildKeyFilter();
+    return;
   }
+  key_filter.Add(key);
+}
 
-  map_.insert_or_assign(key, {.value = std::make_unique<std::string>(value),
-                              .last_logical_commit_time = logical_commit_time});
+void KeyValueCache::Partition::RebuildKeyFilter() {
+  // Leaves room to grow, so that rebuilds are amortized over the updates.
+  KeyFilter new_key_filter(2 * static_cast<int64_t>(map.size()));
+  for (const auto& [key, unused_cache_value] : map) {
+    new_key_filter.Add(key);
+  }
+  key_filter = std::move(new_key_filter);
 }
 
 void KeyValueCache::UpdateKeyValueSet(
     std::string_view key, absl::Span<std::string_view> input_value_set,
     int64_t logical_commit_time, std::string_view prefix) {
-  ScopeLatencyMetricsRecorder<ServerSafeMetricsContext,
-                              kUpdateKeyValueSetLatency>
-      latency_recorder(KVServerContextMap()->SafeMetric());
+  SampledScopeLatencyMetricsRecorder<kUpdateKeyValueSetLatency>
+      latency_recorder;
   VLOG(9) << "Received update for [" << key << "] at " << logical_commit_time;
-  std::unique_ptr<absl::MutexLock> key_lock;
-  absl::flat_hash_map<std::string, SetValueMeta>* existing_value_set;
-  // The max cleanup time needs to be locked before doing this comparison
-  {
-    absl::MutexLock lock_map(&set_map_mutex_);
-
-    auto max_cleanup_logical_commit_time =
-        max_cleanup_logical_commit_time_map_for_set_cache_[prefix];
-
-    if (logical_commit_time <= max_cleanup_logical_commit_time) {
-      VLOG(1) << "Skipping the update as its logical_commit_time: "
-              << logical_commit_time
-              << " is older than the current cutoff time:"
-              << max_cleanup_logical_commit_time;
-      return;
-    } else if (input_value_set.empty()) {
-      VLOG(1) << "Skipping the update as it has no value in the set.";
-      return;
-    }
-    auto key_itr = key_to_value_set_map_.find(key);
-    if (key_itr == key_to_value_set_map_.end()) {
-      VLOG(9) << key << " is a new key. Adding it";
-      // There is no existing value set for the given key,
-      // simply insert the key value set to the map, no need to update deleted
-      // set nodes
-      auto mutex_value_map_pair = std::make_unique<std::pair<
-          absl::Mutex, absl::flat_hash_map<std::string, SetValueMeta>>>();
-
-      for (const auto& value : input_value_set) {
-        mutex_value_map_pair->second.emplace(
-            value, SetValueMeta{logical_commit_time, /*is_deleted=*/false});
-      }
-      key_to_value_set_map_.emplace(key, std::move(mutex_value_map_pair));
-      return;
-    }
-    // The given key has an existing value set, then
-    // update the existing value if update is suggested by the comparison result
-    // on the logical commit times.
-    // Lock the key
-    key_lock = std::make_unique<absl::MutexLock>(&key_itr->second->first);
-    existing_value_set = &key_itr->second->second;
-  }  // end locking map;
+  if (input_value_set.empty()) {
+    VLOG(1) << "Skipping the update as it has no value in the set.";
+    return;
+  }
+  MutateSetEntry(key, prefix, logical_commit_time, CacheLockOperation::kUpdate,
+                 [&](ValueSetEntry& entry) {
+                   const MemoryUsage memory_usage = entry.GetMemoryUsage();
+                   entry.UpdateValues(input_value_set, logical_commit_time);
+                   AddSetEntryMemoryUsage(memory_usage,
+                                          entry.GetMemoryUsage());
+                 });
+}
 
+void KeyValueCache::ValueSetEntry::UpdateValues(
+    absl::Span<std::string_view> input_value_set, int64_t logical_commit_time) {
   for (const auto& value : input_value_set) {
-    auto& current_value_state = (*existing_value_set)[value];
+    auto [member, current_value_state] = GetOrAddValue(value);
     if (current_value_state.last_logical_commit_time >= logical_commit_time) {
       // no need to update
       continue;
@@ -202,31 +820,49 @@ void KeyValueCache::UpdateKeyValueSet(
     // deleted, update is_deleted boolean to false
     current_value_state.is_deleted = false;
     current_value_state.last_logical_commit_time = logical_commit_time;
+    if (!live_values->values.contains(member)) {
+      MutableLiveValues().values.insert(member);
+    }
   }
-  // end locking key
 }
 
 void KeyValueCache::DeleteKey(std::string_view key, int64_t logical_commit_time,
                               std::string_view prefix) {
-  ScopeLatencyMetricsRecorder<ServerSafeMetricsContext, kDeleteKeyLatency>
-      latency_recorder(KVServerContextMap()->SafeMetric());
-  absl::MutexLock lock(&mutex_);
-  auto max_cleanup_logical_commit_time =
-      max_cleanup_logical_commit_time_map_[prefix];
+  SampledScopeLatencyMetricsRecorder<kDeleteKeyLatency> latency_recorder;
+  Partition& partition = GetPartition(prefix, CacheLockOperation::kDelete);
+  CacheMutexLock lock(&partition.mutex, CacheMutex::kPartition,
+                      CacheLockOperation::kDelete);
+  partition.DeleteKey(key, logical_commit_time);
+}
+
+void KeyValueCache::Partition::DeleteKey(std::string_view key,
+                                         int64_t logical_commit_time) {
   if (logical_commit_time <= max_cleanup_logical_commit_time) {
     return;
   }
-  const auto key_iter = map_.find(key);
-  if ((key_iter != map_.end() &&
-       key_iter->second.last_logical_commit_time < logical_commit_time) ||
-      key_iter == map_.end()) {
+  const auto key_iter = map.find(key);
+  if ((key_iter != map.end() &&
+       key_iter->second.last_logical_commit_time() < logical_commit_time) ||
+      key_iter == map.end()) {
     // If key is missing, we still need to add a null value to the map to
     // avoid the late coming update with smaller logical commit time
     // inserting value to the map for the given key
-    map_.insert_or_assign(
-        key,
-        {.value = nullptr, .last_logical_commit_time = logical_commit_time});
-    auto result = deleted_nodes_map_[prefix].emplace(logical_commit_time, key);
+    const bool is_new_key = key_iter == map.end();
+    if (is_new_key) {
+      memory_usage.key_bytes += key.size();
+    } else if (!key_iter->second.is_deleted()) {
+      memory_usage.value_bytes -= key_iter->second.value().size();
+    }
+    memory_usage.tombstone_bytes += kTombstoneBytes;
+    map.insert_or_assign(key, CacheValue::Deleted(logical_commit_time));
+    if (is_new_key) {
+      // Lookups find the deletion, which shadows the values of the key in
+      // the other partitions.
+      AddToKeyFilter(key);
+    }
+    deleted_nodes[logical_commit_time].push_back(
+        HashedString{StringHash()(key)});
+    ++num_deleted_nodes;
   }
 }
 
@@ -234,47 +870,31 @@ void KeyValueCache::DeleteValuesInSet(std::string_view key,
                                       absl::Span<std::string_view> value_set,
                                       int64_t logical_commit_time,
                                       std::string_view prefix) {
-  ScopeLatencyMetricsRecorder<ServerSafeMetricsContext,
-                              kDeleteValuesInSetLatency>
-      latency_recorder(KVServerContextMap()->SafeMetric());
-  std::unique_ptr<absl::MutexLock> key_lock;
-  absl::flat_hash_map<std::string, SetValueMeta>* existing_value_set;
-  // The max cleanup time needs to be locked before doing this comparison
-  {
-    absl::MutexLock lock_map(&set_map_mutex_);
-    auto max_cleanup_logical_commit_time =
-        max_cleanup_logical_commit_time_map_for_set_cache_[prefix];
-    if (logical_commit_time <= max_cleanup_logical_commit_time ||
-        value_set.empty()) {
-      return;
-    }
-    auto key_itr = key_to_value_set_map_.find(key);
-    if (key_itr == key_to_value_set_map_.end()) {
-      // If the key is missing, still need to add all the deleted values to the
-      // map to avoid late arriving update with smaller logical commit time
-      // inserting values same as the deleted ones for the key
-      auto mutex_value_map_pair = std::make_unique<std::pair<
-          absl::Mutex, absl::flat_hash_map<std::string, SetValueMeta>>>();
-
-      for (const auto& value : value_set) {
-        mutex_value_map_pair->second.emplace(
-            value, SetValueMeta{logical_commit_time, /*is_deleted=*/true});
-      }
-      key_to_value_set_map_.emplace(key, std::move(mutex_value_map_pair));
-      // Add to deleted set nodes
-      for (const std::string_view value : value_set) {
-        deleted_set_nodes_map_[prefix][logical_commit_time][key].emplace(value);
-      }
-      return;
-    }
-    // Lock the key
-    key_lock = std::make_unique<absl::MutexLock>(&key_itr->second->first);
-    existing_value_set = &key_itr->second->second;
-  }  // end locking map
-  // Keep track of the values to be added to the deleted set nodes
-  std::vector<std::string_view> values_to_delete;
+  SampledScopeLatencyMetricsRecorder<kDeleteValuesInSetLatency>
+      latency_recorder;
+  if (value_set.empty()) {
+    return;
+  }
+  MutateSetEntry(
+      key, prefix, logical_commit_time, CacheLockOperation::kDelete,
+      [&](ValueSetEntry& entry) {
+        // If the key is missing, its deleted values are still added, to avoid
+        // late arriving updates with smaller logical commit times inserting
+        // them again.
+        const MemoryUsage memory_usage = entry.GetMemoryUsage();
+        const std::vector<std::string_view> deleted_values =
+            entry.DeleteValues(value_set, logical_commit_time);
+        AddSetEntryMemoryUsage(memory_usage, entry.GetMemoryUsage());
+        // Recorded under the key lock, the log lock is taken after it.
+        LogDeletedSetValues(prefix, key, deleted_values, logical_commit_time);
+      });
+}
+
+std::vector<std::string_view> KeyValueCache::ValueSetEntry::DeleteValues(
+    absl::Span<std::string_view> value_set, int64_t logical_commit_time) {
+  std::vector<std::string_view> deleted_values;
   for (const auto& value : value_set) {
-    auto& current_value_state = (*existing_value_set)[value];
+    auto [member, current_value_state] = GetOrAddValue(value);
     if (current_value_state.last_logical_commit_time >= logical_commit_time) {
       // No need to delete
       continue;
@@ -285,111 +905,558 @@ void KeyValueCache::DeleteValuesInSet(std::string_view key,
     // inserting the same value
     current_value_state.last_logical_commit_time = logical_commit_time;
     current_value_state.is_deleted = true;
-    values_to_delete.push_back(value);
+    if (live_values->values.contains(member)) {
+      MutableLiveValues().values.erase(member);
+    }
+    deleted_values.push_back(value);
+  }
+  return deleted_values;
+}
+
+void KeyValueCache::LogDeletedSetValues(
+    std::string_view prefix, std::string_view key,
+    absl::Span<const std::string_view> values, int64_t logical_commit_time) {
+  if (values.empty()) {
+    return;
   }
-  if (!values_to_delete.empty()) {
-    // Release key lock before locking the map to avoid potential deadlock
-    // caused by cycle in the ordering of lock acquisitions
-    key_lock.reset();
-    absl::MutexLock lock_map(&set_map_mutex_);
-    for (const std::string_view value : values_to_delete) {
-      deleted_set_nodes_map_[prefix][logical_commit_time][key].emplace(value);
+  DeletedSetValues deleted_values{.prefix = std::string(prefix),
+                                  .key_hash = StringHash()(key),
+                                  .logical_commit_time = logical_commit_time};
+  deleted_values.value_hashes.reserve(values.size());
+  for (const std::string_view value : values) {
+    deleted_values.value_hashes.push_back(StringHash()(value));
+  }
+  num_deleted_set_values_ += values.size();
+  set_tombstone_bytes_ += values.size() * kSetTombstoneBytes;
+  absl::MutexLock lock(&deleted_set_log_mutex_);
+  deleted_set_log_.push_back(std::move(deleted_values));
+}
+
+void KeyValueCache::DrainDeletedSetLog() {
+  std::vector<DeletedSetValues> deleted_set_log;
+  {
+    absl::MutexLock lock(&deleted_set_log_mutex_);
+    deleted_set_log.swap(deleted_set_log_);
+  }
+  for (DeletedSetValues& deleted_values : deleted_set_log) {
+    auto& value_hashes =
+        deleted_set_nodes_map_[deleted_values.prefix]
+                              [deleted_values.logical_commit_time]
+                              [deleted_values.key_hash];
+    for (const size_t value_hash : deleted_values.value_hashes) {
+      // A value that is already recorded at the same time is only counted
+      // once.
+      if (!value_hashes.insert(value_hash).second) {
+        --num_deleted_set_values_;
+        set_tombstone_bytes_ -= kSetTombstoneBytes;
+      }
     }
   }
 }
 
+void KeyValueCache::AddSetEntryMemoryUsage(const MemoryUsage& before,
+                                           const MemoryUsage& after) {
+  set_value_bytes_ += after.set_value_bytes - before.set_value_bytes;
+  set_entry_table_bytes_ += after.hash_table_bytes - before.hash_table_bytes;
+}
+
+void KeyValueCache::ApplyMutations(absl::Span<const Mutation> mutations,
+                                   std::string_view prefix) {
+  ScopeLatencyMetricsRecorder<ServerSafeMetricsContext, kApplyMutationsLatency>
+      latency_recorder(KVServerContextMap()->SafeMetric());
+  bool has_set_mutations = false;
+  {
+    // Compressed before locking the partition.
+    std::vector<CacheValue> values;
+    for (const Mutation& mutation : mutations) {
+      if (mutation.type == Mutation::Type::kUpdateKeyValue) {
+        values.push_back(
+            EncodeValue(mutation.value, mutation.logical_commit_time));
+      }
+    }
+    auto value = values.begin();
+    Partition& partition = GetPartition(prefix, CacheLockOperation::kUpdate);
+    CacheMutexLock lock(&partition.mutex, CacheMutex::kPartition,
+                        CacheLockOperation::kUpdate);
+    for (const Mutation& mutation : mutations) {
+      if (mutation.type == Mutation::Type::kUpdateKeyValue) {
+        partition.UpdateKeyValue(mutation.key, std::move(*value++));
+      } else if (mutation.type == Mutation::Type::kDeleteKey) {
+        partition.DeleteKey(mutation.key, mutation.logical_commit_time);
+      } else {
+        has_set_mutations = true;
+      }
+    }
+  }
+  if (!has_set_mutations) {
+    return;
+  }
+  // Integer sets are stored as string sets, see `UpdateKeyValueUInt32Set`,
+  // which takes the locks on its own.
+  for (const Mutation& mutation : mutations) {
+    if (mutation.type == Mutation::Type::kUpdateUInt32Set) {
+      UpdateKeyValueUInt32Set(mutation.key, mutation.uint32_value_set,
+                              mutation.logical_commit_time, prefix);
+    } else if (mutation.type == Mutation::Type::kDeleteValuesInUInt32Set) {
+      DeleteValuesInUInt32Set(mutation.key, mutation.uint32_value_set,
+                              mutation.logical_commit_time, prefix);
+    }
+  }
+  // Lookups of key-value sets are blocked while the batch is applied, unlike
+  // with single updates that only hold the lock of the key.
+  CacheMutexLock lock_map(&set_map_mutex_, CacheMutex::kSetMap,
+                          CacheLockOperation::kUpdate);
+  const int64_t max_cleanup_logical_commit_time =
+      max_cleanup_logical_commit_time_map_for_set_cache_[prefix];
+  for (const Mutation& mutation : mutations) {
+    if ((mutation.type != Mutation::Type::kUpdateKeyValueSet &&
+         mutation.type != Mutation::Type::kDeleteValuesInSet) ||
+        mutation.logical_commit_time <= max_cleanup_logical_commit_time ||
+        mutation.value_set.empty()) {
+      continue;
+    }
+    SetEntryRef entry_ref = FindSetEntry(mutation.key);
+    if (entry_ref.entry == nullptr) {
+      AddSetEntry(mutation.key, ValueSetEntry());
+      entry_ref = FindSetEntry(mutation.key);
+    }
+    ValueSetEntry& entry = *entry_ref.entry;
+    CacheMutexLock key_lock(entry_ref.mutex, CacheMutex::kValueSet,
+                            mutation.type == Mutation::Type::kUpdateKeyValueSet
+                                ? CacheLockOperation::kUpdate
+                                : CacheLockOperation::kDelete);
+    const MemoryUsage memory_usage = entry.GetMemoryUsage();
+    if (mutation.type == Mutation::Type::kUpdateKeyValueSet) {
+      entry.UpdateValues(mutation.value_set, mutation.logical_commit_time);
+      AddSetEntryMemoryUsage(memory_usage, entry.GetMemoryUsage());
+      continue;
+    }
+    const std::vector<std::string_view> deleted_values =
+        entry.DeleteValues(mutation.value_set, mutation.logical_commit_time);
+    AddSetEntryMemoryUsage(memory_usage, entry.GetMemoryUsage());
+    LogDeletedSetValues(prefix, mutation.key, deleted_values,
+                        mutation.logical_commit_time);
+  }
+}
+
 void KeyValueCache::RemoveDeletedKeys(int64_t logical_commit_time,
                                       std::string_view prefix) {
   ScopeLatencyMetricsRecorder<ServerSafeMetricsContext,
                               kRemoveDeletedKeyLatency>
       latency_recorder(KVServerContextMap()->SafeMetric());
-  CleanUpKeyValueMap(logical_commit_time, prefix);
-  CleanUpKeyValueSetMap(logical_commit_time, prefix);
+  CleanUpKeyValueMap(logical_commit_time, prefix, absl::InfiniteFuture());
+  CleanUpKeyValueSetMap(logical_commit_time, prefix, absl::InfiniteFuture());
 }
 
-void KeyValueCache::CleanUpKeyValueMap(int64_t logical_commit_time,
-                                       std::string_view prefix) {
+Cache::CleanupProgress KeyValueCache::RemoveDeletedKeysSlice(
+    int64_t logical_commit_time, std::string_view prefix,
+    absl::Time deadline) {
   ScopeLatencyMetricsRecorder<ServerSafeMetricsContext,
-                              kCleanUpKeyValueMapLatency>
+                              kRemoveDeletedKeyLatency>
       latency_recorder(KVServerContextMap()->SafeMetric());
-  absl::MutexLock lock(&mutex_);
-  if (max_cleanup_logical_commit_time_map_[prefix] < logical_commit_time) {
-    max_cleanup_logical_commit_time_map_[prefix] = logical_commit_time;
-  }
-  auto deleted_nodes_per_prefix = deleted_nodes_map_.find(prefix);
-  if (deleted_nodes_per_prefix == deleted_nodes_map_.end()) {
-    return;
+  CleanupProgress progress;
+  // The set map is only cleaned up in slices that have time left after the
+  // key-value map.
+  progress.done =
+      CleanUpKeyValueMap(logical_commit_time, prefix, deadline) &&
+      CleanUpKeyValueSetMap(logical_commit_time, prefix, deadline);
+  {
+    CacheReaderMutexLock lock(&mutex_, CacheMutex::kPartitionMap);
+    for (const auto& [unused_prefix, partition] : partitions_) {
+      CacheReaderMutexLock partition_lock(&partition->mutex,
+                                          CacheMutex::kPartition);
+      progress.remaining_deleted_values += partition->num_deleted_nodes;
+    }
   }
-  auto it = deleted_nodes_per_prefix->second.begin();
+  progress.remaining_deleted_values += num_deleted_set_values_;
+  return progress;
+}
 
-  while (it != deleted_nodes_per_prefix->second.end()) {
-    if (it->first > logical_commit_time) {
-      break;
+bool KeyValueCache::CleanUpKeyValueMap(int64_t logical_commit_time,
+                                       std::string_view prefix,
+                                       absl::Time deadline) {
+  ScopeLatencyMetricsRecorder<ServerSafeMetricsContext,
+                              kCleanUpKeyValueMapLatency>
+      latency_recorder(KVServerContextMap()->SafeMetric());
+  Partition& partition = GetPartition(prefix, CacheLockOperation::kCleanup);
+  std::vector<Partition*> other_partitions;
+  {
+    CacheReaderMutexLock lock(&mutex_, CacheMutex::kPartitionMap);
+    for (const auto& [unused_prefix, other_partition] : partitions_) {
+      if (other_partition.get() != &partition) {
+        other_partitions.push_back(other_partition.get());
+      }
     }
+  }
+  absl::MutexLockMaybe cleanup_lock(other_partitions.empty()
+                                        ? nullptr
+                                        : &cross_partition_cleanup_mutex_);
+  CacheMutexLock lock(&partition.mutex, CacheMutex::kPartition,
+                      CacheLockOperation::kCleanup);
+  // Other partitions may hold older values of a deleted key, which its
+  // deletion shadows. They go with the deletion, so that the key stays
+  // deleted.
+  return partition.CleanUp(
+      logical_commit_time, deadline,
+      [&other_partitions](std::string_view key, int64_t deletion_time) {
+        for (Partition* other_partition : other_partitions) {
+          CacheMutexLock other_lock(&other_partition->mutex,
+                                    CacheMutex::kPartition,
+                                    CacheLockOperation::kCleanup);
+          other_partition->EraseValueUpTo(key, deletion_time);
+        }
+      });
+}
 
-    // should always have this, but checking just in case
-    auto key_iter = map_.find(it->second);
-    if (key_iter != map_.end() && key_iter->second.value == nullptr &&
-        key_iter->second.last_logical_commit_time <= logical_commit_time) {
-      map_.erase(key_iter);
+bool KeyValueCache::Partition::CleanUp(
+    int64_t logical_commit_time, absl::Time deadline,
+    absl::FunctionRef<void(std::string_view key, int64_t deletion_time)>
+        on_remove) {
+  if (max_cleanup_logical_commit_time < logical_commit_time) {
+    max_cleanup_logical_commit_time = logical_commit_time;
+  }
+  bool done = true;
+  int num_visited = 0;
+  while (done && !deleted_nodes.empty() &&
+         deleted_nodes.begin()->first <= logical_commit_time) {
+    // Keys are removed as they are cleaned up, so that a slice that stops in
+    // the middle of a timestamp resumes where it stopped.
+    auto& keys = deleted_nodes.begin()->second;
+    while (!keys.empty()) {
+      if (++num_visited % kDeadlineCheckInterval == 0 &&
+          absl::Now() > deadline) {
+        done = false;
+        break;
+      }
+      // The key is missing or live if it was written again since.
+      auto key_iter = map.find(keys.back());
+      if (key_iter != map.end() && key_iter->second.is_deleted() &&
+          key_iter->second.last_logical_commit_time() <= logical_commit_time) {
+        on_remove(key_iter->first,
+                  key_iter->second.last_logical_commit_time());
+        memory_usage.key_bytes -= key_iter->first.size();
+        map.erase(key_iter);
+      }
+      keys.pop_back();
+      --num_deleted_nodes;
+      memory_usage.tombstone_bytes -= kTombstoneBytes;
     }
+    if (keys.empty()) {
+      deleted_nodes.erase(deleted_nodes.begin());
+    }
+  }
+  // The removed keys are still in the filter. Rebuild it once they make up
+  // most of it, e.g. after a snapshot replaced the previous data.
+  if (done && key_filter.size() > KeyFilter::kMinCapacity &&
+      key_filter.size() > 2 * static_cast<int64_t>(map.size())) {
+    RebuildKeyFilter();
+  }
+  return done;
+}
 
-    ++it;
+void KeyValueCache::Partition::EraseValueUpTo(std::string_view key,
+                                              int64_t logical_commit_time) {
+  if (!key_filter.MayContain(key)) {
+    return;
   }
-  deleted_nodes_per_prefix->second.erase(
-      deleted_nodes_per_prefix->second.begin(), it);
-  if (deleted_nodes_per_prefix->second.empty()) {
-    deleted_nodes_map_.erase(prefix);
+  // Deleted keys are left to their own cleanup.
+  const auto key_iter = map.find(key);
+  if (key_iter == map.end() || key_iter->second.is_deleted() ||
+      key_iter->second.last_logical_commit_time() > logical_commit_time) {
+    return;
   }
+  memory_usage.key_bytes -= key_iter->first.size();
+  memory_usage.value_bytes -= key_iter->second.value().size();
+  map.erase(key_iter);
 }
 
-void KeyValueCache::CleanUpKeyValueSetMap(int64_t logical_commit_time,
-                                          std::string_view prefix) {
+bool KeyValueCache::CleanUpKeyValueSetMap(int64_t logical_commit_time,
+                                          std::string_view prefix,
+                                          absl::Time deadline) {
   ScopeLatencyMetricsRecorder<ServerSafeMetricsContext,
                               kCleanUpKeyValueSetMapLatency>
       latency_recorder(KVServerContextMap()->SafeMetric());
-  absl::MutexLock lock_set_map(&set_map_mutex_);
+  CacheMutexLock lock_set_map(&set_map_mutex_, CacheMutex::kSetMap,
+                              CacheLockOperation::kCleanup);
   if (max_cleanup_logical_commit_time_map_for_set_cache_[prefix] <
       logical_commit_time) {
     max_cleanup_logical_commit_time_map_for_set_cache_[prefix] =
         logical_commit_time;
   }
+  DrainDeletedSetLog();
   auto deleted_nodes_per_prefix = deleted_set_nodes_map_.find(prefix);
   if (deleted_nodes_per_prefix == deleted_set_nodes_map_.end()) {
-    return;
+    return true;
   }
-  auto delete_itr = deleted_nodes_per_prefix->second.begin();
-  while (delete_itr != deleted_nodes_per_prefix->second.end()) {
-    if (delete_itr->first > logical_commit_time) {
-      break;
-    }
-    for (const auto& [key, values] : delete_itr->second) {
-      if (auto key_itr = key_to_value_set_map_.find(key);
-          key_itr != key_to_value_set_map_.end()) {
-        absl::MutexLock(&key_itr->second->first);
-        for (const auto& v_to_delete : values) {
-          auto existing_value_itr = key_itr->second->second.find(v_to_delete);
-          if (existing_value_itr != key_itr->second->second.end() &&
-              existing_value_itr->second.is_deleted &&
-              existing_value_itr->second.last_logical_commit_time <=
-                  logical_commit_time) {
-            // Delete the existing value that is marked deleted from set
-            key_itr->second->second.erase(existing_value_itr);
+  auto& deleted_nodes = deleted_nodes_per_prefix->second;
+  bool done = true;
+  int num_visited = 0;
+  while (done && !deleted_nodes.empty() &&
+         deleted_nodes.begin()->first <= logical_commit_time) {
+    auto& deleted_values_by_key = deleted_nodes.begin()->second;
+    // Keys are erased as they are cleaned up, so that a slice that stops in
+    // the middle of a timestamp resumes where it stopped.
+    for (auto delete_itr = deleted_values_by_key.begin();
+         delete_itr != deleted_values_by_key.end();) {
+      if (++num_visited % kDeadlineCheckInterval == 0 &&
+          absl::Now() > deadline) {
+        done = false;
+        break;
+      }
+      const auto& [key_hash, value_hashes] = *delete_itr;
+      if (const SetEntryRef entry_ref = FindSetEntry(HashedString{key_hash});
+          entry_ref.entry != nullptr) {
+        ValueSetEntry& entry = *entry_ref.entry;
+        {
+          CacheMutexLock key_lock(entry_ref.mutex, CacheMutex::kValueSet,
+                                  CacheLockOperation::kCleanup);
+          const MemoryUsage memory_usage = entry.GetMemoryUsage();
+          for (const size_t value_hash : value_hashes) {
+            const SetValueMeta* existing_value =
+                entry.values.Find(HashedString{value_hash});
+            if (existing_value != nullptr && existing_value->is_deleted &&
+                existing_value->last_logical_commit_time <=
+                    logical_commit_time) {
+              // Delete the existing value that is marked deleted from set. Its
+              // string stays in the pool until the pool is compacted.
+              entry.values.Erase(HashedString{value_hash});
+            }
           }
+          entry.MaybeCompactPool();
+          AddSetEntryMemoryUsage(memory_usage, entry.GetMemoryUsage());
         }
-        if (key_itr->second->second.empty()) {
+        if (entry.values.empty()) {
           // If the value set is empty, erase the key-value_set from cache map
-          key_to_value_set_map_.erase(key);
+          AddSetEntryMemoryUsage(entry.GetMemoryUsage(), {});
+          EraseSetEntry(HashedString{key_hash});
         }
       }
+      num_deleted_set_values_ -= value_hashes.size();
+      set_tombstone_bytes_ -= value_hashes.size() * kSetTombstoneBytes;
+      deleted_values_by_key.erase(delete_itr++);
+    }
+    if (deleted_values_by_key.empty()) {
+      deleted_nodes.erase(deleted_nodes.begin());
     }
-    ++delete_itr;
   }
-  deleted_nodes_per_prefix->second.erase(
-      deleted_nodes_per_prefix->second.begin(), delete_itr);
-  if (deleted_nodes_per_prefix->second.empty()) {
-    deleted_set_nodes_map_.erase(prefix);
+  if (deleted_nodes.empty()) {
+    deleted_set_nodes_map_.erase(deleted_nodes_per_prefix);
   }
+  return done;
+}
+
+absl::Status KeyValueCache::ExportMutations(
+    absl::FunctionRef<void(std::string_view prefix,
+                           absl::Span<const Mutation> mutations)>
+        fn) const {
+  std::vector<std::pair<std::string, const Partition*>> partitions;
+  {
+    absl::ReaderMutexLock lock(&mutex_);
+    for (const auto& [prefix, partition] : partitions_) {
+      partitions.emplace_back(prefix, partition.get());
+    }
+  }
+  std::vector<Mutation> mutations;
+  mutations.reserve(kExportBatchSize);
+  for (const auto& [prefix, partition] : partitions) {
+    std::vector<std::pair<std::string, CacheValue>> entries;
+    {
+      absl::ReaderMutexLock lock(&partition->mutex);
+      entries.reserve(partition->map.size());
+      for (const auto& [key, value] : partition->map) {
+        entries.emplace_back(key, value);
+      }
+    }
+    // Owns the decompressed values of the batch.
+    std::vector<std::string> decoded_values;
+    decoded_values.reserve(kExportBatchSize);
+    for (const auto& [key, cache_value] : entries) {
+      Mutation& mutation = mutations.emplace_back(Mutation{
+          .type = Mutation::Type::kDeleteKey,
+          .key = key,
+          .logical_commit_time = cache_value.last_logical_commit_time()});
+      if (!cache_value.is_deleted()) {
+        mutation.type = Mutation::Type::kUpdateKeyValue;
+        if (!cache_value.is_compressed()) {
+          mutation.value = cache_value.value();
+        } else if (auto value = DecodeValue(cache_value.value()); value.ok()) {
+          mutation.value = decoded_values.emplace_back(*std::move(value));
+        } else {
+          return value.status();
+        }
+      }
+      if (mutations.size() == kExportBatchSize) {
+        fn(prefix, mutations);
+        mutations.clear();
+        decoded_values.clear();
+      }
+    }
+    if (!mutations.empty()) {
+      fn(prefix, mutations);
+      mutations.clear();
+    }
+  }
+  // Set values are copied, since the pools of the sets can be compacted once
+  // the locks are released.
+  std::vector<ExportedValueSet> value_sets;
+  {
+    absl::ReaderMutexLock lock(&set_map_mutex_);
+    value_sets.reserve(NumSetKeys());
+    ForEachSetEntry([&](const std::string& key, const ValueSetEntry& entry,
+                        absl::Mutex& mutex) {
+      auto& values = value_sets.emplace_back(ExportedValueSet{key, {}}).values;
+      absl::ReaderMutexLock entry_lock(&mutex);
+      entry.values.ForEach(
+          [&values](std::string_view value, const SetValueMeta& meta) {
+            if (!meta.is_deleted) {
+              values.emplace_back(value, meta.last_logical_commit_time);
+            }
+          });
+    });
+  }
+  // One mutation per value, they can have different logical commit times.
+  std::vector<std::string_view> value_views;
+  for (const auto& [key, values] : value_sets) {
+    for (const auto& [value, logical_commit_time] : values) {
+      value_views.push_back(value);
+    }
+  }
+  size_t value_index = 0;
+  for (const auto& [key, values] : value_sets) {
+    for (const auto& [value, logical_commit_time] : values) {
+      mutations.push_back(Mutation{
+          .type = Mutation::Type::kUpdateKeyValueSet,
+          .key = key,
+          .value_set = absl::MakeSpan(&value_views[value_index++], 1),
+          .logical_commit_time = logical_commit_time});
+      if (mutations.size() == kExportBatchSize) {
+        fn(/*prefix=*/"", mutations);
+        mutations.clear();
+      }
+    }
+  }
+  if (!mutations.empty()) {
+    fn(/*prefix=*/"", mutations);
+  }
+  return absl::OkStatus();
+}
+
+absl::flat_hash_map<std::string, Cache::MemoryUsage>
+KeyValueCache::GetMemoryUsage() const {
+  absl::flat_hash_map<std::string, MemoryUsage> memory_usage;
+  {
+    absl::ReaderMutexLock lock(&mutex_);
+    for (const auto& [prefix, partition] : partitions_) {
+      absl::ReaderMutexLock partition_lock(&partition->mutex);
+      MemoryUsage& prefix_usage = memory_usage[prefix];
+      prefix_usage += partition->memory_usage;
+      prefix_usage.hash_table_bytes +=
+          partition->map.capacity() *
+              SlotBytes<std::pair<const std::string, CacheValue>>() +
+          partition->key_filter.memory_bytes();
+    }
+  }
+  absl::ReaderMutexLock lock(&set_map_mutex_);
+  if (NumSetKeys() == 0 && set_tombstone_bytes_ == 0) {
+    return memory_usage;
+  }
+  MemoryUsage& set_usage = memory_usage[""];
+  set_usage.set_key_bytes += set_key_bytes_;
+  set_usage.set_value_bytes += set_value_bytes_;
+  set_usage.tombstone_bytes += set_tombstone_bytes_;
+  // The entries count their own size, which is part of the slots of the
+  // table when they are stored in it.
+  set_usage.hash_table_bytes += set_entry_table_bytes_;
+  set_usage.hash_table_bytes += static_cast<int64_t>(
+      key_to_value_set_map_.capacity() *
+          SlotBytes<std::pair<const std::string,
+                              std::unique_ptr<OwnedValueSetEntry>>>() +
+      key_to_value_set_map_.size() * sizeof(absl::Mutex) +
+      set_lock_stripes_.size() * sizeof(absl::Mutex));
+  set_usage.hash_table_bytes += static_cast<int64_t>(
+      key_to_inline_value_set_map_.capacity() *
+          SlotBytes<std::pair<const std::string, ValueSetEntry>>() -
+      key_to_inline_value_set_map_.size() * sizeof(ValueSetEntry));
+  return memory_usage;
+}
+
+std::string KeyValueCache::DebugMemoryReport(int num_largest) const {
+  const auto memory_usage = GetMemoryUsage();
+  std::vector<std::string_view> prefixes;
+  for (const auto& [prefix, unused_usage] : memory_usage) {
+    prefixes.push_back(prefix);
+  }
+  std::sort(prefixes.begin(), prefixes.end());
+  std::string report;
+  for (std::string_view prefix : prefixes) {
+    const MemoryUsage& usage = memory_usage.at(prefix);
+    absl::StrAppend(&report, "Prefix \"", prefix, "\": ", usage.total_bytes(),
+                    " bytes (keys: ", usage.key_bytes,
+                    ", values: ", usage.value_bytes,
+                    ", set keys: ", usage.set_key_bytes,
+                    ", set values: ", usage.set_value_bytes,
+                    ", tombstones: ", usage.tombstone_bytes,
+                    ", hash tables: ", usage.hash_table_bytes, ")\n");
+  }
+  LargestItems largest_pairs(num_largest);
+  {
+    absl::ReaderMutexLock lock(&mutex_);
+    for (const auto& [prefix, partition] : partitions_) {
+      absl::ReaderMutexLock partition_lock(&partition->mutex);
+      for (const auto& [key, cache_value] : partition->map) {
+        if (cache_value.is_deleted()) {
+          continue;
+        }
+        largest_pairs.Add(key.size() + cache_value.value().size(),
+                          [&key = key, &prefix = prefix] {
+                            return absl::StrCat(
+                                key.substr(0, kMaxReportedKeySize),
+                                " (prefix \"", prefix, "\")");
+                          });
+      }
+    }
+  }
+  LargestItems largest_sets(num_largest);
+  {
+    absl::ReaderMutexLock lock(&set_map_mutex_);
+    ForEachSetEntry([&](const std::string& key, const ValueSetEntry& entry,
+                        absl::Mutex& mutex) {
+      absl::ReaderMutexLock entry_lock(&mutex);
+      largest_sets.Add(key.size() + entry.GetMemoryUsage().total_bytes(),
+                       [&key, &entry] {
+                         return absl::StrCat(
+                             key.substr(0, kMaxReportedKeySize), " (",
+                             entry.live_values->values.size(), " values)");
+                       });
+    });
+  }
+  absl::StrAppend(&report, "Largest key-value pairs:\n");
+  std::move(largest_pairs).AppendTo(report);
+  absl::StrAppend(&report, "Largest key-value sets:\n");
+  std::move(largest_sets).AppendTo(report);
+  return report;
+}
+
+absl::flat_hash_map<std::string, double>
+KeyValueCache::GetMemoryBytesOfAllCaches() {
+  MemoryUsage total;
+  {
+    CacheRegistry& registry = GetCacheRegistry();
+    absl::MutexLock lock(&registry.mutex);
+    for (const KeyValueCache* cache : registry.caches) {
+      for (const auto& [prefix, memory_usage] : cache->GetMemoryUsage()) {
+        total += memory_usage;
+      }
+    }
+  }
+  return {
+      {std::string(kCacheKeyBytes), total.key_bytes},
+      {std::string(kCacheValueBytes), total.value_bytes},
+      {std::string(kCacheSetKeyBytes), total.set_key_bytes},
+      {std::string(kCacheSetValueBytes), total.set_value_bytes},
+      {std::string(kCacheTombstoneBytes), total.tombstone_bytes},
+      {std::string(kCacheHashTableBytes), total.hash_table_bytes},
+  };
 }
 
 void KeyValueCache::LogCacheAccessMetrics(
@@ -400,7 +1467,29 @@ void KeyValueCache::LogCacheAccessMetrics(
           .AccumulateMetric<kCacheAccessEventCount>(1, cache_access_event));
 }
 
+void KeyValueCache::LogKeyFilterMetrics(const RequestContext& request_context,
+                                        int num_filtered_keys,
+                                        int num_false_positives) const {
+  if (num_filtered_keys > 0) {
+    LogIfError(request_context.GetInternalLookupMetricsContext()
+                   .AccumulateMetric<kCacheAccessEventCount>(
+                       num_filtered_keys, kKeyFilterNegative));
+  }
+  if (num_false_positives > 0) {
+    LogIfError(request_context.GetInternalLookupMetricsContext()
+                   .AccumulateMetric<kCacheAccessEventCount>(
+                       num_false_positives, kKeyFilterFalsePositive));
+  }
+}
+
 std::unique_ptr<Cache> KeyValueCache::Create() {
-  return absl::WrapUnique(new KeyValueCache());
+  return Create(CompressionOptions());
+}
+
+std::unique_ptr<Cache> KeyValueCache::Create(
+    CompressionOptions compression_options, SetLockOptions set_lock_options,
+    LookupOptions lookup_options) {
+  return absl::WrapUnique(new KeyValueCache(
+      std::move(compression_options), set_lock_options, lookup_options));
 }
 }  // namespace kv_server
@@ -17,6 +17,8 @@
 #ifndef COMPONENTS_DATA_SERVER_CACHE_KEY_VALUE_CACHE_H_
 #define COMPONENTS_DATA_SERVER_CACHE_KEY_VALUE_CACHE_H_
 
+#include <atomic>
+#include <deque>
 #include <iostream>
 #include <map>
 #include <memory>
@@ -29,20 +31,71 @@
 #include "absl/container/btree_map.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
+#include "absl/functional/function_ref.h"
+#include "absl/hash/hash.h"
+#include "absl/status/statusor.h"
+#include "absl/types/span.h"
 #include "components/data_server/cache/cache.h"
+#include "components/data_server/cache/cache_mutex_lock.h"
+#include "components/data_server/cache/compact_value.h"
 #include "components/data_server/cache/get_key_value_set_result.h"
+#include "components/data_server/cache/key_filter.h"
+#include "components/data_server/cache/small_flat_map.h"
+#include "components/data_server/cache/value_codec.h"
+#include "components/util/hashed_key.h"
 #include "public/base_types.pb.h"
 
 namespace kv_server {
 // In-memory datastore.
-// One cache object is only for keys in one namespace.
+// One cache object is only for keys in one namespace. Key-value pairs are
+// partitioned by the prefix they were loaded from. Large values can be stored
+// compressed, and are decompressed by the lookups that return them.
 class KeyValueCache : public Cache {
  public:
+  // Values of at least `min_value_size` bytes are compressed at zstd `level`,
+  // if `min_value_size` is positive. They are compressed with `dictionary` if
+  // set. Otherwise, if `trained_dictionary_size` is positive, with a
+  // dictionary trained on the first values that are large enough, e.g. the
+  // ones of the first snapshot, and without dictionary until then.
+  struct CompressionOptions {
+    int64_t min_value_size = 0;
+    int level = 3;
+    std::string dictionary;
+    int64_t trained_dictionary_size = 0;
+  };
+  // If `num_stripes` is positive, key-value sets are stored in the slots of
+  // the key table, and guarded by one of `num_stripes` locks picked by the
+  // hash of the key, instead of being allocated along with a lock of their
+  // own. Keys of the same stripe are updated one at a time, and adding a key
+  // waits for the updates in progress, since it can move the other sets.
+  struct SetLockOptions {
+    int num_stripes = 0;
+  };
+  // The keys of a lookup are probed in batches of `probe_batch_size`: the key
+  // filter blocks and the table slots of a batch are prefetched before any
+  // of its keys is probed, so that their cache misses overlap instead of
+  // adding up. 1 probes the keys one at a time, without prefetching.
+  struct LookupOptions {
+    int probe_batch_size = 16;
+  };
+
   // Looks up and returns key-value pairs for the given keys.
   absl::flat_hash_map<std::string, std::string> GetKeyValuePairs(
       const RequestContext& request_context,
       const absl::flat_hash_set<std::string_view>& key_set) const override;
 
+  // Looks up the given keys and returns views of their values. The result
+  // shares ownership of the values, so no value is copied.
+  GetKeyValuePairsResult GetKeyValuePairViews(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override;
+
+  // Same as `GetKeyValuePairViews`, with each key hashed once for the key
+  // filters and the key tables of every partition.
+  GetKeyValuePairsResult GetHashedKeyValuePairViews(
+      const RequestContext& request_context,
+      absl::Span<const HashedKey> keys) const override;
+
   // Looks up and returns key-value set result for the given key set.
   std::unique_ptr<GetKeyValueSetResult> GetKeyValueSet(
       const RequestContext& request_context,
@@ -72,26 +125,93 @@ class KeyValueCache : public Cache {
                          int64_t logical_commit_time,
                          std::string_view prefix = "") override;
 
+  // Applies `mutations` for a given prefix with one lock of each map.
+  void ApplyMutations(absl::Span<const Mutation> mutations,
+                      std::string_view prefix = "") override;
+
   // Removes the values that were deleted before the specified
   // logical_commit_time for a given prefix.
-  // TODO: b/267182790 -- Cache cleanup should be done periodically from a
-  // background thread
   void RemoveDeletedKeys(int64_t logical_commit_time,
                          std::string_view prefix = "") override;
 
+  // Removes the values that were deleted before the specified
+  // logical_commit_time for a given prefix, until `deadline`.
+  CleanupProgress RemoveDeletedKeysSlice(int64_t logical_commit_time,
+                                         std::string_view prefix,
+                                         absl::Time deadline) override;
+
+  // Exports the key-value pairs partition by partition, decompressed, and
+  // the key-value sets with the "" prefix. Only holds each lock to copy
+  // references to the entries.
+  absl::Status ExportMutations(
+      absl::FunctionRef<void(std::string_view prefix,
+                             absl::Span<const Mutation> mutations)>
+          fn) const override;
+
+  // Returns the memory used by the key-value pairs of every prefix. The
+  // key-value sets are accounted to the "" prefix.
+  absl::flat_hash_map<std::string, MemoryUsage> GetMemoryUsage()
+      const override;
+
+  // Lists the memory used by every prefix, then the largest key-value pairs
+  // and key-value sets.
+  std::string DebugMemoryReport(int num_largest) const override;
+
+  // Returns the bytes used by all the caches of the process, by structure,
+  // see `kCacheMemoryStructures`. Exported as the `kCacheMemoryBytes` gauge.
+  static absl::flat_hash_map<std::string, double> GetMemoryBytesOfAllCaches();
+
+  KeyValueCache();
+  ~KeyValueCache() override;
+
   static std::unique_ptr<Cache> Create();
+  static std::unique_ptr<Cache> Create(CompressionOptions compression_options,
+                                       SetLockOptions set_lock_options = {},
+                                       LookupOptions lookup_options = {});
 
  private:
-  struct CacheValue {
-    // We need to be able to set the value to null. For deletion we're keeping
-    // the timestamp of the key (to prevent a specific type of out of order
-    // delete-update messages issue) until it is later cleaned up.
-    // We've also considered using optional, but it takes more space.
-    // sizeof(string) + sizeof(bool) -- for optional
-    // sizeof(string*) when null, sizeof(string*) + sizeof(string) otherwise
-    // -- for the unique pointer
-    std::unique_ptr<std::string> value;
-    int64_t last_logical_commit_time;
+  // For deletion we're keeping the timestamp of the key (to prevent a
+  // specific type of out of order delete-update messages issue) until it is
+  // later cleaned up. Short values are kept in the slot of the key, and
+  // compressed values are compressed by one of `codecs_`.
+  using CacheValue = CompactValue;
+  // Refers to a key of `Partition::map` or `key_to_value_set_map_`, or to a
+  // value of `ValueSetEntry::values`, by the hash of the string, so that
+  // tombstones don't keep copies of the strings. Tables of these strings use
+  // `StringHash` and `StringEq` to find the string of a hash.
+  //
+  // A hash can find another string of the table with the same hash. Cleanup
+  // only removes strings that are deleted before the cutoff, which is correct
+  // for any string it finds, so a collision at worst keeps a deleted string
+  // until it is written again. With 64-bit hashes, this is negligible.
+  struct HashedString {
+    size_t hash;
+  };
+  struct StringHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view s) const {
+      return absl::Hash<std::string_view>()(s);
+    }
+    size_t operator()(HashedString s) const { return s.hash; }
+    size_t operator()(const HashedKey& key) const { return key.hash; }
+  };
+  struct StringEq {
+    using is_transparent = void;
+    bool operator()(std::string_view a, std::string_view b) const {
+      return a == b;
+    }
+    bool operator()(std::string_view a, HashedString b) const {
+      return StringHash()(a) == b.hash;
+    }
+    bool operator()(HashedString a, std::string_view b) const {
+      return a.hash == StringHash()(b);
+    }
+    bool operator()(std::string_view a, const HashedKey& b) const {
+      return a == b.key;
+    }
+    bool operator()(const HashedKey& a, std::string_view b) const {
+      return a.key == b;
+    }
   };
   struct SetValueMeta {
     // Last logical commit time for a value
@@ -105,24 +225,165 @@ class KeyValueCache : public Cache {
     SetValueMeta(int64_t logical_commit_time, bool deleted)
         : last_logical_commit_time(logical_commit_time), is_deleted(deleted) {}
   };
-  // mutex for key value map;
-  mutable absl::Mutex mutex_;
-  // mutex for key value set map;
-  mutable absl::Mutex set_map_mutex_;
-  // Mapping from a key to its value
-  absl::flat_hash_map<std::string, CacheValue> map_ ABSL_GUARDED_BY(mutex_);
+  // Owns the member strings of a key-value set. It is only ever appended to,
+  // so the views into it stay valid for as long as it is alive.
+  using ValuePool = std::deque<std::string>;
+  // Most sets have a few members, which are scanned instead of hashed.
+  using ValueMetaMap =
+      SmallFlatMap<std::string_view, SetValueMeta, StringHash, StringEq>;
+  // Immutable once shared with a lookup result. Keeps the pool that its views
+  // point into alive.
+  struct LiveValueSet {
+    std::shared_ptr<const ValuePool> pool;
+    absl::flat_hash_set<std::string_view> values;
+  };
+  // A key-value set, guarded by the lock of its key, see `SetEntryRef`.
+  struct ValueSetEntry {
+    ValueSetEntry();
+    // Returns the member string of `value` and its entry, adding a live entry
+    // with a zero timestamp if the value is missing.
+    std::pair<std::string_view, SetValueMeta&> GetOrAddValue(
+        std::string_view value);
+    // Returns the live values for writing. Results can't observe the change:
+    // the live values are copied first if a result shares them.
+    LiveValueSet& MutableLiveValues();
+    // Drops the strings of the values that were removed from `values`, once
+    // they take more than half of the pool.
+    void MaybeCompactPool();
+    // Marks `input_value_set` live, except the values that were updated or
+    // deleted at or after `logical_commit_time`.
+    void UpdateValues(absl::Span<std::string_view> input_value_set,
+                      int64_t logical_commit_time);
+    // Returns the bytes of the member strings, and of the entry and its hash
+    // tables.
+    MemoryUsage GetMemoryUsage() const;
+    // Marks `value_set` deleted, except the values that were updated or
+    // deleted at or after `logical_commit_time`. Returns the values that were
+    // marked.
+    std::vector<std::string_view> DeleteValues(
+        absl::Span<std::string_view> value_set, int64_t logical_commit_time);
+
+    std::shared_ptr<ValuePool> pool;
+    // Bytes of the strings in `pool`.
+    int64_t pool_bytes = 0;
+    // Live and deleted values, as views into `pool`, with their meta data.
+    ValueMetaMap values;
+    // The values that are not deleted. Maintained along with `values` so that
+    // lookups only take a reference to it.
+    std::shared_ptr<LiveValueSet> live_values;
+    // Changed by `MutableLiveValues`, so it changes whenever the live values
+    // do. 0 until the set first had live values, like a missing key. Cleanup
+    // only drops deleted values, so it leaves the version as it is.
+    uint64_t version = 0;
+  };
+  // A key-value set allocated with its own lock.
+  struct OwnedValueSetEntry {
+    mutable absl::Mutex mutex;
+    ValueSetEntry entry;
+  };
+  // The set of a key and the lock that guards it, or a null entry if the key
+  // has no set.
+  struct SetEntryRef {
+    ValueSetEntry* entry = nullptr;
+    absl::Mutex* mutex = nullptr;
+  };
+  struct ConstSetEntryRef {
+    const ValueSetEntry* entry = nullptr;
+    absl::Mutex* mutex = nullptr;
+  };
+  // Key-value pairs of one prefix, with their own lock and cleanup state, so
+  // that loading or cleaning up a prefix doesn't block the other prefixes.
+  struct Partition {
+    // Applies an update, unless it isn't newer than the cleanup cutoff or the
+    // current value of the key.
+    void UpdateKeyValue(std::string_view key, CacheValue cache_value)
+        ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex);
+    // Applies a deletion, unless it isn't newer than the cleanup cutoff or
+    // the current value of the key.
+    void DeleteKey(std::string_view key, int64_t logical_commit_time)
+        ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex);
+    // Removes the keys that were deleted before `logical_commit_time`, after
+    // calling `on_remove` with each key and the time of its deletion.
+    // Returns false if it stopped at `deadline` before removing all of them.
+    bool CleanUp(int64_t logical_commit_time, absl::Time deadline,
+                 absl::FunctionRef<void(std::string_view key,
+                                        int64_t deletion_time)>
+                     on_remove) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex);
+    // Removes the value of `key` if it was written at or before
+    // `logical_commit_time`.
+    void EraseValueUpTo(std::string_view key, int64_t logical_commit_time)
+        ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex);
+    // Adds `key` to `key_filter`, rebuilding the filter with more capacity if
+    // it is full.
+    void AddToKeyFilter(std::string_view key)
+        ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex);
+    // Rebuilds `key_filter` from the keys of `map`.
+    void RebuildKeyFilter() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex);
+
+    mutable absl::Mutex mutex;
+    // Mapping from a key to its value
+    absl::flat_hash_map<std::string, CacheValue, StringHash, StringEq> map
+        ABSL_GUARDED_BY(mutex);
+    // Filter over the keys of `map`, deleted ones included, so that lookups
+    // of missing keys skip the map and deletions shadow the other
+    // partitions. Rebuilt when it gets full or stale.
+    KeyFilter key_filter ABSL_GUARDED_BY(mutex);
+    // The keys of `map` that were deleted, by the logical timestamp of the
+    // deletion, so that cleanup visits the deleted keys only. A key that was
+    // written again since stays until cleanup reaches its timestamp, and is
+    // skipped then.
+    absl::btree_map<int64_t, std::vector<HashedString>> deleted_nodes
+        ABSL_GUARDED_BY(mutex);
+    // Number of keys in `deleted_nodes`.
+    int64_t num_deleted_nodes ABSL_GUARDED_BY(mutex) = 0;
+    // The maximum timestamp that was passed to RemoveDeletedKeys.
+    int64_t max_cleanup_logical_commit_time ABSL_GUARDED_BY(mutex) = 0;
+    // Bytes of the keys and values of `map`, and of `deleted_nodes`. The
+    // bytes of the hash table are computed from its capacity.
+    MemoryUsage memory_usage ABSL_GUARDED_BY(mutex);
+  };
+
+  KeyValueCache(CompressionOptions compression_options,
+                SetLockOptions set_lock_options, LookupOptions lookup_options);
 
-  // Sorted mapping from the logical timestamp to a key, for nodes that were
-  // deleted We keep this to do proper and efficient clean up in map_.
-  // The key in the inner map is the prefix and the value is the keys of key
-  // value pairs deleted from that prefix
+  // Returns the value to store for an update, compressed if it is large
+  // enough.
+  CacheValue EncodeValue(std::string_view value, int64_t logical_commit_time)
+      ABSL_LOCKS_EXCLUDED(codec_mutex_);
+  // Returns the codec that compresses new values, after keeping `value` as a
+  // dictionary sample if the dictionary isn't trained yet.
+  std::shared_ptr<const ValueCodec> GetCodecForValue(std::string_view value)
+      ABSL_LOCKS_EXCLUDED(codec_mutex_);
+  // Trains a dictionary on `samples`, and compresses new values with it.
+  void TrainDictionary(std::vector<std::string> samples)
+      ABSL_LOCKS_EXCLUDED(codec_mutex_);
+  absl::StatusOr<std::string> DecodeValue(std::string_view compressed) const
+      ABSL_LOCKS_EXCLUDED(codec_mutex_);
 
-  absl::flat_hash_map<std::string, std::multimap<int64_t, std::string>>
-      deleted_nodes_map_ ABSL_GUARDED_BY(mutex_);
+  const CompressionOptions compression_options_;
+  mutable absl::Mutex codec_mutex_;
+  // Compresses new values.
+  std::shared_ptr<const ValueCodec> codec_ ABSL_GUARDED_BY(codec_mutex_);
+  // Every codec that compressed a stored value, by dictionary id.
+  absl::flat_hash_map<uint32_t, std::shared_ptr<const ValueCodec>> codecs_
+      ABSL_GUARDED_BY(codec_mutex_);
+  // Values kept to train a dictionary, until they reach
+  // `kDictionarySamplesPerByte` times the dictionary size.
+  bool collects_dictionary_samples_ ABSL_GUARDED_BY(codec_mutex_) = false;
+  std::vector<std::string> dictionary_samples_ ABSL_GUARDED_BY(codec_mutex_);
+  int64_t dictionary_sample_bytes_ ABSL_GUARDED_BY(codec_mutex_) = 0;
 
-  // The key is the prefix and the value is the
-  // maximum timestamp that was passed to RemoveDeletedKeys.
-  absl::flat_hash_map<std::string, int64_t> max_cleanup_logical_commit_time_map_
+  // mutex for the partition map;
+  mutable absl::Mutex mutex_;
+  // Held by cleanups that remove values from other partitions than their
+  // own, which hold two partition locks at once, so that they run one at a
+  // time.
+  absl::Mutex cross_partition_cleanup_mutex_;
+  // mutex for key value set map;
+  mutable absl::Mutex set_map_mutex_;
+  // Mapping from a prefix to its key-value pairs. Partitions are never
+  // removed, so references to them stay valid without `mutex_`.
+  absl::flat_hash_map<std::string, std::unique_ptr<Partition>> partitions_
       ABSL_GUARDED_BY(mutex_);
 
   // The key is the prefix and the value is the maximum
@@ -134,38 +395,139 @@ class KeyValueCache : public Cache {
       max_cleanup_logical_commit_time_map_for_set_cache_
           ABSL_GUARDED_BY(set_map_mutex_);
 
-  // Mapping from a key to its value map. The key in the inner map is the
-  // value string, and value is the ValueMeta. The inner map allows value
-  // look up to check the meta data to determine to state of the value
+  // Mapping from a key to its value set. The value map of the entry allows
+  // value look up to check the meta data to determine to state of the value
   // in the cache, like logical commit time and whether the value
-  // is deleted or not.
-  absl::flat_hash_map<
-      std::string,
-      std::unique_ptr<std::pair<
-          absl::Mutex, absl::flat_hash_map<std::string, SetValueMeta>>>>
+  // is deleted or not. Only used without lock stripes.
+  absl::flat_hash_map<std::string, std::unique_ptr<OwnedValueSetEntry>,
+                      StringHash, StringEq>
       key_to_value_set_map_ ABSL_GUARDED_BY(set_map_mutex_);
+  // Same, with the sets in the table, when there are lock stripes. The sets
+  // move when the table grows, so their references are only valid while
+  // `set_map_mutex_` is held.
+  absl::flat_hash_map<std::string, ValueSetEntry, StringHash, StringEq>
+      key_to_inline_value_set_map_ ABSL_GUARDED_BY(set_map_mutex_);
+  // Guard the sets of `key_to_inline_value_set_map_`, by hash of the key.
+  mutable std::vector<absl::Mutex> set_lock_stripes_;
+  const size_t probe_batch_size_;
   // The key of outer map is the prefix, and value is the sorted mapping
   // from logical timestamp to key-value_set map to keep track of
-  // deleted key-values to handle out of order update case. In the inner map,
-  // the key string is the key for the values, and the string
-  // in the flat_hash_set is the value
-  absl::flat_hash_map<
-      std::string,
-      absl::btree_map<
-          int64_t,
-          absl::flat_hash_map<std::string, absl::flat_hash_set<std::string>>>>
-      deleted_set_nodes_map_ ABSL_GUARDED_BY(set_map_mutex_);
-
-  // Removes deleted keys from key-value map for a given prefix
-  void CleanUpKeyValueMap(int64_t logical_commit_time, std::string_view prefix);
-
-  // Removes deleted key-values from key-value_set map for a given prefix
-  void CleanUpKeyValueSetMap(int64_t logical_commit_time,
-                             std::string_view prefix);
+  // deleted key-values to handle out of order update case. The inner map is
+  // from the hash of the key to the hashes of its deleted values, see
+  // `HashedString`.
+  using DeletedSetNodes = absl::btree_map<
+      int64_t, absl::flat_hash_map<size_t, absl::flat_hash_set<size_t>>>;
+  absl::flat_hash_map<std::string, DeletedSetNodes> deleted_set_nodes_map_
+      ABSL_GUARDED_BY(set_map_mutex_);
+  // Values deleted from a key-value set, recorded under the lock of the key.
+  struct DeletedSetValues {
+    std::string prefix;
+    size_t key_hash;
+    std::vector<size_t> value_hashes;
+    int64_t logical_commit_time;
+  };
+  // Deletions that are not in `deleted_set_nodes_map_` yet. Its lock is only
+  // ever the last one taken, so set mutations record their deletions without
+  // taking `set_map_mutex_` again, and cleanup moves them to
+  // `deleted_set_nodes_map_`.
+  absl::Mutex deleted_set_log_mutex_ ABSL_ACQUIRED_AFTER(set_map_mutex_);
+  std::vector<DeletedSetValues> deleted_set_log_
+      ABSL_GUARDED_BY(deleted_set_log_mutex_);
+  // Number of deleted values in `deleted_set_nodes_map_` and
+  // `deleted_set_log_`, for all prefixes.
+  std::atomic<int64_t> num_deleted_set_values_ = 0;
+  // Bytes of the keys of `key_to_value_set_map_`, and of the deleted values.
+  int64_t set_key_bytes_ ABSL_GUARDED_BY(set_map_mutex_) = 0;
+  std::atomic<int64_t> set_tombstone_bytes_ = 0;
+  // Sum of the memory usage of the entries of `key_to_value_set_map_`. Kept
+  // outside of `set_map_mutex_`, since entries change under their own lock.
+  std::atomic<int64_t> set_value_bytes_ = 0;
+  std::atomic<int64_t> set_entry_table_bytes_ = 0;
+
+  // Returns the partition of `prefix`, adding it if it is missing for
+  // `operation`.
+  Partition& GetPartition(
+      std::string_view prefix,
+      CacheLockOperation operation = CacheLockOperation::kUpdate)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+  // Calls `fn` with the key and value of every one of `keys` that has a
+  // value. If partitions have the same key, the most recent update or
+  // deletion of the key wins. The hash of each key is reused for the key
+  // filter and the key table of every partition.
+  template <typename Fn>
+  void ForEachKeyValuePair(const RequestContext& request_context,
+                           absl::Span<const HashedKey> keys, Fn&& fn) const
+      ABSL_LOCKS_EXCLUDED(mutex_);
+  // Calls `fn` with the index of every one of `keys` that may be in the key
+  // table of `partition`, and the iterator of the key in the table, the end
+  // if it isn't there. The keys are probed in batches, see `LookupOptions`.
+  template <typename Fn>
+  void ProbePartition(const Partition& partition,
+                      absl::Span<const HashedKey> keys, Fn&& fn) const
+      ABSL_SHARED_LOCKS_REQUIRED(partition.mutex);
+  // Returns the set of `key`, a string or a `HashedString`.
+  template <typename Key>
+  SetEntryRef FindSetEntry(const Key& key)
+      ABSL_SHARED_LOCKS_REQUIRED(set_map_mutex_);
+  template <typename Key>
+  ConstSetEntryRef FindSetEntry(const Key& key) const
+      ABSL_SHARED_LOCKS_REQUIRED(set_map_mutex_);
+  // Adds `entry` as the set of `key`, which has none.
+  void AddSetEntry(std::string_view key, ValueSetEntry entry)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(set_map_mutex_);
+  // Removes the set of `key`.
+  void EraseSetEntry(HashedString key)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(set_map_mutex_);
+  // Calls `fn` with every key, its set and the lock of the set.
+  template <typename Fn>
+  void ForEachSetEntry(Fn&& fn) const
+      ABSL_SHARED_LOCKS_REQUIRED(set_map_mutex_);
+  int64_t NumSetKeys() const ABSL_SHARED_LOCKS_REQUIRED(set_map_mutex_);
+  // Returns true if set changes at `logical_commit_time` are older than the
+  // cleanup cutoff of `prefix`, and are skipped.
+  bool IsBeforeSetCleanupCutoff(std::string_view prefix,
+                                int64_t logical_commit_time) const
+      ABSL_SHARED_LOCKS_REQUIRED(set_map_mutex_);
+  // Calls `fn` with the set of `key` locked for `operation`, adding an empty
+  // set if the key has none, unless the change is older than the cleanup
+  // cutoff of `prefix`.
+  template <typename Fn>
+  void MutateSetEntry(std::string_view key, std::string_view prefix,
+                      int64_t logical_commit_time,
+                      CacheLockOperation operation, Fn&& fn)
+      ABSL_LOCKS_EXCLUDED(set_map_mutex_);
+  // Adds the change of the memory used by a key-value set entry, from `before`
+  // to `after`, to the set counters.
+  void AddSetEntryMemoryUsage(const MemoryUsage& before,
+                              const MemoryUsage& after);
+  // Records the deletion of `values` from the set of `key` in
+  // `deleted_set_log_`.
+  void LogDeletedSetValues(std::string_view prefix, std::string_view key,
+                           absl::Span<const std::string_view> values,
+                           int64_t logical_commit_time)
+      ABSL_LOCKS_EXCLUDED(deleted_set_log_mutex_);
+  // Moves the deletions of `deleted_set_log_` to `deleted_set_nodes_map_`.
+  void DrainDeletedSetLog() ABSL_EXCLUSIVE_LOCKS_REQUIRED(set_map_mutex_)
+      ABSL_LOCKS_EXCLUDED(deleted_set_log_mutex_);
+
+  // Removes deleted keys from key-value map for a given prefix. Returns false
+  // if it stopped at `deadline` before removing all of them.
+  bool CleanUpKeyValueMap(int64_t logical_commit_time, std::string_view prefix,
+                          absl::Time deadline);
+
+  // Removes deleted key-values from key-value_set map for a given prefix.
+  // Returns false if it stopped at `deadline` before removing all of them.
+  bool CleanUpKeyValueSetMap(int64_t logical_commit_time,
+                             std::string_view prefix, absl::Time deadline);
   // Logs cache access metrics for cache hit or miss counts. The cache access
   // event name is defined in server_definition.h file
   void LogCacheAccessMetrics(const RequestContext& request_context,
                              std::string_view cache_access_event) const;
+  // Logs how many looked up keys the key filters ruled out, and how many they
+  // let through that were missing.
+  void LogKeyFilterMetrics(const RequestContext& request_context,
+                           int num_filtered_keys,
+                           int num_false_positives) const;
 
   friend class KeyValueCacheTestPeer;
 };
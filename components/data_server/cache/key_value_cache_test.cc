@@ -23,6 +23,7 @@
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/strings/str_cat.h"
 #include "absl/synchronization/notification.h"
 #include "components/data_server/cache/cache.h"
 #include "components/data_server/cache/get_key_value_set_result.h"
@@ -37,56 +38,80 @@ namespace kv_server {
 class KeyValueCacheTestPeer {
  public:
   KeyValueCacheTestPeer() = delete;
+  static const KeyFilter& ReadKeyFilter(KeyValueCache& c,
+                                        std::string_view prefix = "") {
+    auto& partition = c.GetPartition(prefix);
+    absl::MutexLock lock(&partition.mutex);
+    return partition.key_filter;
+  }
+  // Returns the keys that are still deleted, by the time of their deletion.
   static std::multimap<int64_t, std::string> ReadDeletedNodes(
-      const KeyValueCache& c, std::string_view prefix = "") {
-    absl::MutexLock lock(&c.mutex_);
-    auto map_itr = c.deleted_nodes_map_.find(prefix);
-    return map_itr == c.deleted_nodes_map_.end()
-               ? std::multimap<int64_t, std::string>()
-               : c.deleted_nodes_map_.find(prefix)->second;
+      KeyValueCache& c, std::string_view prefix = "") {
+    auto& partition = c.GetPartition(prefix);
+    absl::MutexLock lock(&partition.mutex);
+    std::multimap<int64_t, std::string> deleted_nodes;
+    for (const auto& [logical_commit_time, keys] : partition.deleted_nodes) {
+      for (const auto key : keys) {
+        const auto it = partition.map.find(key);
+        if (it != partition.map.end() && it->second.is_deleted() &&
+            it->second.last_logical_commit_time() == logical_commit_time) {
+          deleted_nodes.emplace(logical_commit_time, it->first);
+        }
+      }
+    }
+    return deleted_nodes;
+  }
+  static auto& ReadNodes(KeyValueCache& c, std::string_view prefix = "") {
+    auto& partition = c.GetPartition(prefix);
+    absl::MutexLock lock(&partition.mutex);
+    return partition.map;
   }
-  static absl::flat_hash_map<std::string, kv_server::KeyValueCache::CacheValue>&
-  ReadNodes(KeyValueCache& c) {
+  static int GetNumCodecs(const KeyValueCache& c) {
+    absl::MutexLock lock(&c.codec_mutex_);
+    return c.codecs_.size();
+  }
+  static int GetNumPartitions(const KeyValueCache& c) {
     absl::MutexLock lock(&c.mutex_);
-    return c.map_;
+    return c.partitions_.size();
   }
 
-  static int GetDeletedSetNodesMapSize(const KeyValueCache& c,
+  static int GetDeletedSetNodesMapSize(KeyValueCache& c,
                                        std::string prefix = "") {
     absl::MutexLock lock(&c.set_map_mutex_);
+    c.DrainDeletedSetLog();
     auto map_itr = c.deleted_set_nodes_map_.find(prefix);
     return map_itr == c.deleted_set_nodes_map_.end() ? 0
                                                      : map_itr->second.size();
   }
 
-  static absl::flat_hash_set<std::string> ReadDeletedSetNodesForTimestamp(
-      const KeyValueCache& c, int64_t logical_commit_time, std::string_view key,
+  // Returns the hashes of the deleted values of `key`.
+  static absl::flat_hash_set<size_t> ReadDeletedSetNodesForTimestamp(
+      KeyValueCache& c, int64_t logical_commit_time, std::string_view key,
       std::string_view prefix = "") {
     absl::MutexLock lock(&c.set_map_mutex_);
+    c.DrainDeletedSetLog();
     auto map_itr = c.deleted_set_nodes_map_.find(prefix);
     return map_itr == c.deleted_set_nodes_map_.end()
-               ? absl::flat_hash_set<std::string>()
+               ? absl::flat_hash_set<size_t>()
                : map_itr->second.find(logical_commit_time)
-                     ->second.find(key)
+                     ->second.find(KeyValueCache::StringHash()(key))
                      ->second;
   }
 
   static int GetCacheKeyValueSetMapSize(KeyValueCache& c) {
     absl::MutexLock lock(&c.set_map_mutex_);
-    return c.key_to_value_set_map_.size();
+    return c.NumSetKeys();
   }
 
   static KeyValueCache::SetValueMeta GetSetValueMeta(const KeyValueCache& c,
                                                      std::string_view key,
                                                      std::string_view value) {
     absl::MutexLock lock(&c.set_map_mutex_);
-    auto iter = c.key_to_value_set_map_.find(key);
-    return iter->second->second.find(value)->second;
+    return *c.FindSetEntry(key).entry->values.Find(value);
   }
   static int GetSetValueSize(const KeyValueCache& c, std::string_view key) {
     absl::MutexLock lock(&c.set_map_mutex_);
-    auto iter = c.key_to_value_set_map_.find(key);
-    return iter->second->second.size();
+    return c.FindSetEntry(key).entry->values.size();
   }
 
   static void CallCacheCleanup(KeyValueCache& c, int64_t logical_commit_time) {
@@ -198,6 +223,35 @@ TEST_F(CacheTest, GetForCacheMissingKeyReturnsEmptySet) {
               UnorderedElementsAre("v1", "v2"));
 }
 
+TEST_F(CacheTest, ValueSetVersionChangesWithTheSet) {
+  std::unique_ptr<Cache> cache = KeyValueCache::Create();
+  auto get_version = [this, &cache](std::string_view key) {
+    return cache->GetKeyValueSet(GetRequestContext(), {key})
+        ->GetValueSetVersion(key);
+  };
+  EXPECT_EQ(get_version("my_key"), 0);
+  std::vector<std::string_view> values = {"v1", "v2"};
+  cache->UpdateKeyValueSet("my_key", absl::Span<std::string_view>(values), 1);
+  const auto version = get_version("my_key");
+  ASSERT_TRUE(version.has_value());
+  EXPECT_NE(*version, 0);
+
+  // Updates that leave the set as it is keep its version.
+  cache->UpdateKeyValueSet("my_key", absl::Span<std::string_view>(values), 2);
+  EXPECT_EQ(get_version("my_key"), version);
+  cache->RemoveDeletedKeys(3);
+  EXPECT_EQ(get_version("my_key"), version);
+
+  std::vector<std::string_view> deleted = {"v1"};
+  cache->DeleteValuesInSet("my_key", absl::Span<std::string_view>(deleted), 4);
+  const auto version_after_delete = get_version("my_key");
+  EXPECT_NE(version_after_delete, version);
+  std::vector<std::string_view> added = {"v3"};
+  cache->UpdateKeyValueSet("my_key", absl::Span<std::string_view>(added), 5);
+  EXPECT_NE(get_version("my_key"), version_after_delete);
+  EXPECT_NE(get_version("my_key"), version);
+}
+
 TEST_F(CacheTest, DeleteKeyTestRemovesKeyEntry) {
   std::unique_ptr<Cache> cache = KeyValueCache::Create();
   cache->UpdateKeyValue("my_key", "my_value", 1);
@@ -1017,6 +1071,44 @@ TEST_F(CacheTest, ConcurrentDeleteAndCleanUp) {
   }
 }
 
+TEST_F(CacheTest, ConcurrentDeleteValuesInSetAndCleanUpRemovesAllValues) {
+  auto cache = std::make_unique<KeyValueCache>();
+  std::vector<std::string> keys;
+  for (int i = 0; i < 10; ++i) {
+    keys.push_back(absl::StrCat("key", i));
+  }
+  absl::Notification start;
+  auto delete_fn = [&cache, &keys, &start](int64_t logical_commit_time) {
+    start.WaitForNotification();
+    for (const std::string& key : keys) {
+      std::vector<std::string_view> values = {"v1", "v2"};
+      cache->UpdateKeyValueSet(key, absl::MakeSpan(values),
+                               logical_commit_time);
+      cache->DeleteValuesInSet(key, absl::MakeSpan(values),
+                               logical_commit_time + 1);
+    }
+  };
+  auto cleanup_fn = [&cache, &start]() {
+    start.WaitForNotification();
+    cache->RemoveDeletedKeysSlice(1, "", absl::InfiniteFuture());
+  };
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 10; i++) {
+    threads.emplace_back(delete_fn, 10 + 2 * i);
+    threads.emplace_back(cleanup_fn);
+  }
+  start.Notify();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  const Cache::CleanupProgress progress =
+      cache->RemoveDeletedKeysSlice(100, "", absl::InfiniteFuture());
+  EXPECT_TRUE(progress.done);
+  EXPECT_EQ(progress.remaining_deleted_values, 0);
+  EXPECT_EQ(KeyValueCacheTestPeer::GetDeletedSetNodesMapSize(*cache), 0);
+  EXPECT_EQ(KeyValueCacheTestPeer::GetCacheKeyValueSetMapSize(*cache), 0);
+}
+
 TEST_F(CacheTest, ConcurrentGetUpdateDeleteCleanUp) {
   auto cache = std::make_unique<KeyValueCache>();
   absl::flat_hash_set<std::string_view> keys = {"key1", "key2"};
@@ -1276,5 +1368,604 @@ TEST_F(CacheTest, MultiplePrefixTimestampKeyValueSetCleanUps) {
   EXPECT_EQ(KeyValueCacheTestPeer::GetDeletedSetNodesMapSize(*cache, "prefix2"),
             1);
 }
+
+TEST_F(CacheTest, KeyValueSetSnapshotIsNotAffectedByLaterUpdates) {
+  std::unique_ptr<Cache> cache = KeyValueCache::Create();
+  std::vector<std::string_view> values = {"v1", "v2"};
+  std::vector<std::string_view> new_values = {"v3"};
+  cache->UpdateKeyValueSet("my_key", absl::Span<std::string_view>(values), 1);
+  auto result = cache->GetKeyValueSet(GetRequestContext(), {"my_key"});
+  auto snapshot = result->GetValueSetSnapshot("my_key");
+  // The result doesn't hold the key lock, so writers are not blocked.
+  cache->UpdateKeyValueSet("my_key", absl::Span<std::string_view>(new_values),
+                           2);
+  cache->DeleteValuesInSet("my_key", absl::Span<std::string_view>(values), 3);
+  EXPECT_THAT(*snapshot, UnorderedElementsAre("v1", "v2"));
+  EXPECT_THAT(result->GetValueSet("my_key"), UnorderedElementsAre("v1", "v2"));
+  EXPECT_TRUE(result->GetValueSetSnapshot("missing_key")->empty());
+  EXPECT_THAT(cache->GetKeyValueSet(GetRequestContext(), {"my_key"})
+                  ->GetValueSet("my_key"),
+              UnorderedElementsAre("v3"));
+}
+
+TEST_F(CacheTest, KeyValueSetSnapshotOutlivesCleanup) {
+  std::unique_ptr<Cache> cache = KeyValueCache::Create();
+  std::vector<std::string> value_strings;
+  for (int i = 0; i < 100; i++) {
+    value_strings.push_back(absl::StrCat("value_long_enough_for_the_heap_", i));
+  }
+  std::vector<std::string_view> values(value_strings.begin(),
+                                       value_strings.end());
+  std::vector<std::string_view> kept_values = {"kept"};
+  cache->UpdateKeyValueSet("my_key", absl::Span<std::string_view>(values), 1);
+  cache->UpdateKeyValueSet("my_key", absl::Span<std::string_view>(kept_values),
+                           1);
+  auto snapshot = cache->GetKeyValueSet(GetRequestContext(), {"my_key"})
+                      ->GetValueSetSnapshot("my_key");
+  cache->DeleteValuesInSet("my_key", absl::Span<std::string_view>(values), 2);
+  // Drops the deleted values and compacts the storage of the set.
+  cache->RemoveDeletedKeys(3);
+  EXPECT_EQ(KeyValueCacheTestPeer::GetSetValueSize(
+                static_cast<KeyValueCache&>(*cache), "my_key"),
+            1);
+  EXPECT_EQ(snapshot->size(), 101);
+  for (const auto& value : value_strings) {
+    EXPECT_TRUE(snapshot->contains(value));
+  }
+  EXPECT_THAT(cache->GetKeyValueSet(GetRequestContext(), {"my_key"})
+                  ->GetValueSet("my_key"),
+              UnorderedElementsAre("kept"));
+}
+
+TEST_F(CacheTest, KeyValuePairViewsReturnMatchingValues) {
+  std::unique_ptr<Cache> cache = KeyValueCache::Create();
+  cache->UpdateKeyValue("key1", "value1", 1);
+  cache->UpdateKeyValue("key2", "value2", 1);
+  cache->DeleteKey("key2", 2);
+  absl::flat_hash_set<std::string_view> keys = {"key1", "key2", "key3"};
+  const auto result = cache->GetKeyValuePairViews(GetRequestContext(), keys);
+  EXPECT_EQ(result.size(), 1);
+  EXPECT_EQ(result.GetValue("key1"), "value1");
+  EXPECT_FALSE(result.GetValue("key2").has_value());
+  EXPECT_FALSE(result.GetValue("key3").has_value());
+}
+
+TEST_F(CacheTest, HashedKeyValuePairViewsReturnMostRecentValues) {
+  std::unique_ptr<Cache> cache = KeyValueCache::Create();
+  cache->UpdateKeyValue("key1", "value1", 1);
+  cache->UpdateKeyValue("key1", "prefix_value1", 2, "prefix");
+  cache->UpdateKeyValue("key2", "value2", 2);
+  cache->UpdateKeyValue("key2", "prefix_value2", 1, "prefix");
+  cache->UpdateKeyValue("key3", "value3", 1);
+  cache->DeleteKey("key3", 2, "prefix");
+  const std::vector<HashedKey> keys = {HashedKey("key1"), HashedKey("key2"),
+                                       HashedKey("key3"), HashedKey("key4")};
+  const auto result =
+      cache->GetHashedKeyValuePairViews(GetRequestContext(), keys);
+  EXPECT_EQ(result.size(), 2);
+  EXPECT_EQ(result.GetValue(keys[0]), "prefix_value1");
+  EXPECT_EQ(result.GetValue("key2"), "value2");
+  EXPECT_FALSE(result.GetValue(keys[2]).has_value());
+  EXPECT_FALSE(result.GetValue(keys[3]).has_value());
+}
+
+TEST_F(CacheTest, ProbeBatchesReturnTheValuesOfEveryKey) {
+  std::vector<std::string> keys;
+  for (int i = 0; i < 100; i++) {
+    keys.push_back(absl::StrCat("key", i));
+  }
+  const absl::flat_hash_set<std::string_view> key_set(keys.begin(),
+                                                      keys.end());
+  for (int probe_batch_size : {1, 3, 16}) {
+    std::unique_ptr<Cache> cache = KeyValueCache::Create(
+        KeyValueCache::CompressionOptions(), {},
+        {.probe_batch_size = probe_batch_size});
+    for (int i = 0; i < 100; i += 2) {
+      cache->UpdateKeyValue(keys[i], absl::StrCat("value", i), 1);
+    }
+    EXPECT_EQ(cache->GetKeyValuePairViews(GetRequestContext(), key_set).size(),
+              50)
+        << probe_batch_size;
+    // Deletions in another partition win over the older values.
+    cache->DeleteKey("key10", 2, "prefix");
+    const auto result =
+        cache->GetKeyValuePairViews(GetRequestContext(), key_set);
+    EXPECT_EQ(result.size(), 49) << probe_batch_size;
+    for (int i = 0; i < 100; i++) {
+      if (i % 2 == 0 && i != 10) {
+        EXPECT_EQ(result.GetValue(keys[i]), absl::StrCat("value", i))
+            << probe_batch_size;
+      } else {
+        EXPECT_FALSE(result.GetValue(keys[i]).has_value()) << probe_batch_size;
+      }
+    }
+  }
+}
+
+TEST_F(CacheTest, KeyValuePairViewsOutliveUpdatesAndCleanup) {
+  std::unique_ptr<Cache> cache = KeyValueCache::Create();
+  const std::string value(100, 'v');
+  cache->UpdateKeyValue("key1", value, 1);
+  cache->UpdateKeyValue("key2", value, 1);
+  absl::flat_hash_set<std::string_view> keys = {"key1", "key2"};
+  const auto result = cache->GetKeyValuePairViews(GetRequestContext(), keys);
+  cache->UpdateKeyValue("key1", "new_value", 2);
+  cache->DeleteKey("key2", 2);
+  cache->RemoveDeletedKeys(3);
+  EXPECT_EQ(result.GetValue("key1"), value);
+  EXPECT_EQ(result.GetValue("key2"), value);
+  EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(), keys),
+              UnorderedElementsAre(KVPairEq("key1", "new_value")));
+}
+
+TEST_F(CacheTest, RemoveDeletedKeysSliceStopsAtDeadline) {
+  std::unique_ptr<Cache> cache = KeyValueCache::Create();
+  std::vector<std::string_view> values = {"v1"};
+  for (int i = 0; i < 1000; i++) {
+    const std::string key = absl::StrCat("key", i);
+    cache->DeleteKey(key, 1);
+    cache->DeleteValuesInSet(key, absl::MakeSpan(values), 1);
+  }
+  // Tombstones after the cutoff are counted, but not removed.
+  cache->DeleteKey("later_key", 5);
+  Cache::CleanupProgress progress =
+      cache->RemoveDeletedKeysSlice(2, "", absl::InfinitePast());
+  EXPECT_FALSE(progress.done);
+  EXPECT_LT(progress.remaining_deleted_values, 2001);
+  EXPECT_GT(progress.remaining_deleted_values, 1);
+  int num_slices = 1;
+  while (!progress.done) {
+    const int64_t previous_remaining = progress.remaining_deleted_values;
+    progress = cache->RemoveDeletedKeysSlice(2, "", absl::InfinitePast());
+    EXPECT_LT(progress.remaining_deleted_values, previous_remaining);
+    ++num_slices;
+  }
+  EXPECT_GT(num_slices, 2);
+  EXPECT_EQ(progress.remaining_deleted_values, 1);
+  auto& nodes =
+      KeyValueCacheTestPeer::ReadNodes(static_cast<KeyValueCache&>(*cache));
+  EXPECT_EQ(nodes.size(), 1);
+  EXPECT_EQ(KeyValueCacheTestPeer::GetDeletedSetNodesMapSize(
+                static_cast<KeyValueCache&>(*cache)),
+            0);
+  // The cutoff moved with the first slice.
+  cache->UpdateKeyValue("key1", "late_value", 2);
+  EXPECT_TRUE(cache->GetKeyValuePairs(GetRequestContext(), {"key1"}).empty());
+}
+
+TEST_F(CacheTest, ApplyMutationsMatchesSingleMutations) {
+  std::unique_ptr<Cache> single_cache = KeyValueCache::Create();
+  std::unique_ptr<Cache> batch_cache = KeyValueCache::Create();
+  std::vector<std::string> keys;
+  for (int i = 0; i < 5; i++) {
+    keys.push_back(absl::StrCat("key", i));
+  }
+  std::vector<std::string_view> values = {"v1", "v2", "v3"};
+  std::vector<Cache::Mutation> mutations;
+  // Out of order times, so that some of the mutations are dropped.
+  for (int i = 0; i < 100; i++) {
+    const int64_t logical_commit_time = 10 + (i * 7) % 13;
+    const std::string_view key = keys[i % keys.size()];
+    const auto value_set = absl::MakeSpan(values).subspan(i % 3, 1 + i % 2);
+    switch (i % 4) {
+      case 0:
+        mutations.push_back({.type = Cache::Mutation::Type::kUpdateKeyValue,
+                             .key = key,
+                             .value = values[i % 3],
+                             .logical_commit_time = logical_commit_time});
+        break;
+      case 1:
+        mutations.push_back({.type = Cache::Mutation::Type::kDeleteKey,
+                             .key = key,
+                             .logical_commit_time = logical_commit_time});
+        break;
+      case 2:
+        mutations.push_back({.type = Cache::Mutation::Type::kUpdateKeyValueSet,
+                             .key = key,
+                             .value_set = value_set,
+                             .logical_commit_time = logical_commit_time});
+        break;
+      case 3:
+        mutations.push_back({.type = Cache::Mutation::Type::kDeleteValuesInSet,
+                             .key = key,
+                             .value_set = value_set,
+                             .logical_commit_time = logical_commit_time});
+        break;
+    }
+  }
+  // Mutations older than the cutoff are dropped by both.
+  single_cache->RemoveDeletedKeys(11);
+  batch_cache->RemoveDeletedKeys(11);
+  for (const Cache::Mutation& mutation : mutations) {
+    static_cast<Cache*>(single_cache.get())
+        ->Cache::ApplyMutations(absl::MakeConstSpan(&mutation, 1));
+  }
+  batch_cache->ApplyMutations(absl::MakeConstSpan(mutations).first(50));
+  batch_cache->ApplyMutations(absl::MakeConstSpan(mutations).subspan(50));
+
+  absl::flat_hash_set<std::string_view> key_set(keys.begin(), keys.end());
+  EXPECT_EQ(single_cache->GetKeyValuePairs(GetRequestContext(), key_set),
+            batch_cache->GetKeyValuePairs(GetRequestContext(), key_set));
+  auto single_sets = single_cache->GetKeyValueSet(GetRequestContext(), key_set);
+  auto batch_sets = batch_cache->GetKeyValueSet(GetRequestContext(), key_set);
+  for (std::string_view key : keys) {
+    EXPECT_EQ(single_sets->GetValueSet(key), batch_sets->GetValueSet(key))
+        << key;
+  }
+  auto& single_kv_cache = static_cast<KeyValueCache&>(*single_cache);
+  auto& batch_kv_cache = static_cast<KeyValueCache&>(*batch_cache);
+  EXPECT_EQ(KeyValueCacheTestPeer::ReadDeletedNodes(single_kv_cache),
+            KeyValueCacheTestPeer::ReadDeletedNodes(batch_kv_cache));
+  EXPECT_EQ(KeyValueCacheTestPeer::GetDeletedSetNodesMapSize(single_kv_cache),
+            KeyValueCacheTestPeer::GetDeletedSetNodesMapSize(batch_kv_cache));
+  EXPECT_EQ(single_cache->RemoveDeletedKeysSlice(11, "", absl::InfiniteFuture())
+                .remaining_deleted_values,
+            batch_cache->RemoveDeletedKeysSlice(11, "", absl::InfiniteFuture())
+                .remaining_deleted_values);
+}
+
+TEST_F(CacheTest, ApplyMutationsPerPrefix) {
+  std::unique_ptr<Cache> cache = KeyValueCache::Create();
+  std::vector<std::string_view> values = {"v1", "v2"};
+  cache->RemoveDeletedKeys(5, "prefix1");
+  const std::vector<Cache::Mutation> mutations = {
+      {.type = Cache::Mutation::Type::kUpdateKeyValue,
+       .key = "key1",
+       .value = "value1",
+       .logical_commit_time = 3},
+      {.type = Cache::Mutation::Type::kUpdateKeyValueSet,
+       .key = "key2",
+       .value_set = absl::MakeSpan(values),
+       .logical_commit_time = 3},
+      {.type = Cache::Mutation::Type::kDeleteKey,
+       .key = "key3",
+       .logical_commit_time = 6},
+  };
+  cache->ApplyMutations(mutations, "prefix1");
+  EXPECT_TRUE(
+      cache->GetKeyValuePairs(GetRequestContext(), {"key1", "key3"}).empty());
+  EXPECT_TRUE(cache->GetKeyValueSet(GetRequestContext(), {"key2"})
+                  ->GetValueSet("key2")
+                  .empty());
+  EXPECT_EQ(KeyValueCacheTestPeer::ReadDeletedNodes(
+                static_cast<KeyValueCache&>(*cache), "prefix1")
+                .size(),
+            1);
+  cache->ApplyMutations(mutations, "prefix2");
+  EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(), {"key1", "key3"}),
+              UnorderedElementsAre(KVPairEq("key1", "value1")));
+  EXPECT_THAT(cache->GetKeyValueSet(GetRequestContext(), {"key2"})
+                  ->GetValueSet("key2"),
+              UnorderedElementsAre("v1", "v2"));
+}
+
+TEST_F(CacheTest, KeyFilterGrowsWithTheKeys) {
+  std::unique_ptr<Cache> cache = KeyValueCache::Create();
+  for (int i = 0; i < 5000; i++) {
+    cache->UpdateKeyValue(absl::StrCat("key", i), absl::StrCat("value", i), 1);
+  }
+  const KeyFilter& key_filter = KeyValueCacheTestPeer::ReadKeyFilter(
+      static_cast<KeyValueCache&>(*cache));
+  EXPECT_GE(key_filter.capacity(), 5000);
+  EXPECT_EQ(key_filter.size(), 5000);
+  for (int i = 0; i < 5000; i++) {
+    const std::string key = absl::StrCat("key", i);
+    EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(), {key}),
+                UnorderedElementsAre(KVPairEq(key, absl::StrCat("value", i))));
+  }
+  EXPECT_TRUE(cache->GetKeyValuePairViews(GetRequestContext(), {"missing_key"})
+                  .empty());
+}
+
+TEST_F(CacheTest, KeyFilterIsRebuiltAfterCleanup) {
+  std::unique_ptr<Cache> cache = KeyValueCache::Create();
+  for (int i = 0; i < 3000; i++) {
+    cache->UpdateKeyValue(absl::StrCat("key", i), "value", 1);
+  }
+  // Tombstones of updated keys stay in the filter until cleanup.
+  for (int i = 0; i < 3000; i++) {
+    cache->DeleteKey(absl::StrCat("key", i), 2);
+  }
+  const KeyFilter& key_filter = KeyValueCacheTestPeer::ReadKeyFilter(
+      static_cast<KeyValueCache&>(*cache));
+  EXPECT_EQ(key_filter.size(), 3000);
+  cache->RemoveDeletedKeys(2);
+  EXPECT_EQ(key_filter.size(), 0);
+  EXPECT_EQ(key_filter.capacity(), KeyFilter::kMinCapacity);
+  cache->UpdateKeyValue("key1", "new_value", 3);
+  EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(), {"key1", "key2"}),
+              UnorderedElementsAre(KVPairEq("key1", "new_value")));
+}
+
+TEST_F(CacheTest, KeyValuePairsArePartitionedByPrefix) {
+  std::unique_ptr<Cache> cache = KeyValueCache::Create();
+  cache->UpdateKeyValue("key1", "value1", 1, "prefix1");
+  cache->UpdateKeyValue("key2", "value2", 1, "prefix2");
+  auto& kv_cache = static_cast<KeyValueCache&>(*cache);
+  EXPECT_EQ(KeyValueCacheTestPeer::GetNumPartitions(kv_cache), 2);
+  EXPECT_EQ(KeyValueCacheTestPeer::ReadNodes(kv_cache, "prefix1").size(), 1);
+  EXPECT_EQ(KeyValueCacheTestPeer::ReadNodes(kv_cache, "prefix2").size(), 1);
+  EXPECT_THAT(
+      cache->GetKeyValuePairs(GetRequestContext(), {"key1", "key2", "key3"}),
+      UnorderedElementsAre(KVPairEq("key1", "value1"),
+                           KVPairEq("key2", "value2")));
+}
+
+TEST_F(CacheTest, MostRecentMutationAcrossPrefixesWins) {
+  std::unique_ptr<Cache> cache = KeyValueCache::Create();
+  cache->UpdateKeyValue("my_key", "value1", 1, "prefix1");
+  cache->UpdateKeyValue("my_key", "value2", 2, "prefix2");
+  EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(), {"my_key"}),
+              UnorderedElementsAre(KVPairEq("my_key", "value2")));
+  auto views = cache->GetKeyValuePairViews(GetRequestContext(), {"my_key"});
+  EXPECT_EQ(views.GetValue("my_key"), "value2");
+  cache->DeleteKey("my_key", 3, "prefix1");
+  EXPECT_TRUE(cache->GetKeyValuePairs(GetRequestContext(), {"my_key"}).empty());
+  cache->UpdateKeyValue("my_key", "value4", 4, "prefix2");
+  EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(), {"my_key"}),
+              UnorderedElementsAre(KVPairEq("my_key", "value4")));
+}
+
+TEST_F(CacheTest, KeyDeletedFromOtherPrefixStaysDeletedAfterCleanup) {
+  std::unique_ptr<Cache> cache = KeyValueCache::Create();
+  cache->UpdateKeyValue("my_key", "value1", 1, "prefix1");
+  cache->UpdateKeyValue("other_key", "value1", 1, "prefix1");
+  cache->DeleteKey("my_key", 3, "prefix2");
+  // Late, but newer than the cleanup cutoff of its prefix.
+  cache->UpdateKeyValue("my_key", "value2", 2, "prefix1");
+  cache->UpdateKeyValue("other_key", "value4", 4, "prefix1");
+  cache->DeleteKey("other_key", 3, "prefix2");
+  EXPECT_THAT(
+      cache->GetKeyValuePairs(GetRequestContext(), {"my_key", "other_key"}),
+      UnorderedElementsAre(KVPairEq("other_key", "value4")));
+  cache->RemoveDeletedKeys(3, "prefix2");
+  // The older value of the deleted key goes with its deletion, and the newer
+  // value of the other key stays.
+  EXPECT_THAT(
+      cache->GetKeyValuePairs(GetRequestContext(), {"my_key", "other_key"}),
+      UnorderedElementsAre(KVPairEq("other_key", "value4")));
+  auto& kv_cache = static_cast<KeyValueCache&>(*cache);
+  EXPECT_EQ(KeyValueCacheTestPeer::ReadNodes(kv_cache, "prefix1").size(), 1);
+  EXPECT_TRUE(KeyValueCacheTestPeer::ReadNodes(kv_cache, "prefix2").empty());
+}
+
+TEST_F(CacheTest, LargeValuesAreStoredCompressed) {
+  std::unique_ptr<Cache> cache =
+      KeyValueCache::Create({.min_value_size = 100});
+  const std::string large_value(1000, 'a');
+  cache->UpdateKeyValue("small", "small value", 1);
+  cache->UpdateKeyValue("large", large_value, 1);
+  cache->ApplyMutations(
+      std::vector<Cache::Mutation>{
+          {.type = Cache::Mutation::Type::kUpdateKeyValue,
+           .key = "batched",
+           .value = large_value,
+           .logical_commit_time = 1}},
+      "");
+  auto& kv_cache = static_cast<KeyValueCache&>(*cache);
+  auto& nodes = KeyValueCacheTestPeer::ReadNodes(kv_cache);
+  EXPECT_FALSE(nodes.at("small").is_compressed());
+  EXPECT_TRUE(nodes.at("large").is_compressed());
+  EXPECT_LT(nodes.at("large").value().size(), large_value.size());
+  EXPECT_TRUE(nodes.at("batched").is_compressed());
+  EXPECT_THAT(
+      cache->GetKeyValuePairs(GetRequestContext(),
+                              {"small", "large", "batched"}),
+      UnorderedElementsAre(KVPairEq("small", "small value"),
+                           KVPairEq("large", large_value),
+                           KVPairEq("batched", large_value)));
+  auto views =
+      cache->GetKeyValuePairViews(GetRequestContext(), {"small", "large"});
+  EXPECT_EQ(views.GetValue("small"), "small value");
+  EXPECT_EQ(views.GetValue("large"), large_value);
+}
+
+TEST_F(CacheTest, DictionaryIsTrainedOnTheFirstLargeValues) {
+  std::unique_ptr<Cache> cache = KeyValueCache::Create(
+      {.min_value_size = 100, .trained_dictionary_size = 1024});
+  auto value_of = [](int i) {
+    return absl::StrCat(R"({"renderUrl": "https://ads.example/creative/)", i,
+                        R"(", "metadata": {"campaignId": )", i * 7,
+                        R"(, "sizes": ["300x250", "728x90"], "bid": )",
+                        i % 97, "}}");
+  };
+  // Enough samples for the dictionary, and values compressed with it.
+  constexpr int kNumValues = 2000;
+  for (int i = 0; i < kNumValues; ++i) {
+    cache->UpdateKeyValue(absl::StrCat("key", i), value_of(i), 1);
+  }
+  EXPECT_EQ(KeyValueCacheTestPeer::GetNumCodecs(
+                static_cast<KeyValueCache&>(*cache)),
+            2);
+  for (int i : {0, kNumValues - 1}) {
+    const std::string key = absl::StrCat("key", i);
+    EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(), {key}),
+                UnorderedElementsAre(KVPairEq(key, value_of(i))));
+  }
+}
+
+TEST_F(CacheTest, MemoryUsageFollowsUpdatesAndCleanups) {
+  std::unique_ptr<Cache> cache = KeyValueCache::Create();
+  cache->UpdateKeyValue("key1", "value1", 1);
+  cache->UpdateKeyValue("key2", "value2", 1, "prefix");
+  cache->UpdateKeyValue("key1", "new_value1", 2);
+  auto memory_usage = cache->GetMemoryUsage();
+  EXPECT_EQ(memory_usage[""].key_bytes, 4);
+  EXPECT_EQ(memory_usage[""].value_bytes, 10);
+  EXPECT_EQ(memory_usage[""].tombstone_bytes, 0);
+  EXPECT_GT(memory_usage[""].hash_table_bytes, 0);
+  EXPECT_EQ(memory_usage["prefix"].key_bytes, 4);
+  EXPECT_EQ(memory_usage["prefix"].value_bytes, 6);
+
+  cache->DeleteKey("key1", 3);
+  memory_usage = cache->GetMemoryUsage();
+  EXPECT_EQ(memory_usage[""].key_bytes, 4);
+  EXPECT_EQ(memory_usage[""].value_bytes, 0);
+  EXPECT_GT(memory_usage[""].tombstone_bytes, 0);
+  cache->RemoveDeletedKeys(3);
+  memory_usage = cache->GetMemoryUsage();
+  EXPECT_EQ(memory_usage[""].key_bytes, 0);
+  EXPECT_EQ(memory_usage[""].tombstone_bytes, 0);
+
+  std::vector<std::string_view> values = {"v1", "v2"};
+  cache->UpdateKeyValueSet("set", absl::MakeSpan(values), 4);
+  memory_usage = cache->GetMemoryUsage();
+  EXPECT_EQ(memory_usage[""].set_key_bytes, 3);
+  EXPECT_GT(memory_usage[""].set_value_bytes, 4);
+  cache->DeleteValuesInSet("set", absl::MakeSpan(values), 5);
+  EXPECT_GT(cache->GetMemoryUsage()[""].tombstone_bytes, 0);
+  cache->RemoveDeletedKeys(5);
+  memory_usage = cache->GetMemoryUsage();
+  EXPECT_EQ(memory_usage[""].set_key_bytes, 0);
+  EXPECT_EQ(memory_usage[""].set_value_bytes, 0);
+  EXPECT_EQ(memory_usage[""].tombstone_bytes, 0);
+}
+
+TEST_F(CacheTest, TombstonesDontCopyKeysAndValues) {
+  std::unique_ptr<Cache> short_cache = KeyValueCache::Create();
+  std::unique_ptr<Cache> long_cache = KeyValueCache::Create();
+  const std::string long_string(1000, 'a');
+  std::vector<std::string_view> short_values = {"v"};
+  std::vector<std::string_view> long_values = {long_string};
+  short_cache->DeleteKey("k", 1);
+  short_cache->DeleteValuesInSet("k", absl::MakeSpan(short_values), 1);
+  long_cache->DeleteKey(long_string, 1);
+  long_cache->DeleteValuesInSet(long_string, absl::MakeSpan(long_values), 1);
+  EXPECT_EQ(short_cache->GetMemoryUsage()[""].tombstone_bytes,
+            long_cache->GetMemoryUsage()[""].tombstone_bytes);
+}
+
+TEST_F(CacheTest, CleanupKeepsDeletedKeysWrittenAgain) {
+  std::unique_ptr<KeyValueCache> cache = std::make_unique<KeyValueCache>();
+  cache->UpdateKeyValue("key", "value", 1);
+  cache->DeleteKey("key", 2);
+  cache->UpdateKeyValue("key", "new_value", 3);
+  EXPECT_EQ(KeyValueCacheTestPeer::ReadDeletedNodes(*cache).size(), 0);
+  const auto progress =
+      cache->RemoveDeletedKeysSlice(4, "", absl::InfiniteFuture());
+  EXPECT_TRUE(progress.done);
+  EXPECT_EQ(progress.remaining_deleted_values, 0);
+  EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(), {"key"}),
+              UnorderedElementsAre(KVPairEq("key", "new_value")));
+  EXPECT_EQ(cache->GetMemoryUsage()[""].tombstone_bytes, 0);
+}
+
+TEST_F(CacheTest, LargeSetShrinksBackAfterCleanup) {
+  std::unique_ptr<KeyValueCache> cache = std::make_unique<KeyValueCache>();
+  std::vector<std::string> value_strings;
+  for (int i = 0; i < 20; ++i) {
+    value_strings.push_back(absl::StrCat("value", i));
+  }
+  std::vector<std::string_view> values(value_strings.begin(),
+                                       value_strings.end());
+  cache->UpdateKeyValueSet("key", absl::MakeSpan(values), 1);
+  const int64_t large_set_bytes =
+      cache->GetMemoryUsage()[""].hash_table_bytes;
+  cache->DeleteValuesInSet("key", absl::MakeSpan(values).subspan(2), 2);
+  cache->RemoveDeletedKeys(2);
+  EXPECT_EQ(KeyValueCacheTestPeer::GetSetValueSize(*cache, "key"), 2);
+  EXPECT_LT(cache->GetMemoryUsage()[""].hash_table_bytes, large_set_bytes);
+  auto result = cache->GetKeyValueSet(GetRequestContext(), {"key"});
+  EXPECT_THAT(result->GetValueSet("key"),
+              UnorderedElementsAre("value0", "value1"));
+  // Values are still found in the small form.
+  cache->DeleteValuesInSet("key", absl::MakeSpan(values).subspan(0, 1), 3);
+  result = cache->GetKeyValueSet(GetRequestContext(), {"key"});
+  EXPECT_THAT(result->GetValueSet("key"), UnorderedElementsAre("value1"));
+  EXPECT_TRUE(
+      KeyValueCacheTestPeer::GetSetValueMeta(*cache, "key", "value0")
+          .is_deleted);
+}
+
+TEST_F(CacheTest, StripedSetLocksKeepSetsInTheTable) {
+  std::unique_ptr<Cache> cache =
+      KeyValueCache::Create({}, {.num_stripes = 4});
+  std::vector<std::string_view> values = {"v1", "v2"};
+  std::vector<std::string_view> deleted_values = {"v1"};
+  for (int i = 0; i < 100; ++i) {
+    cache->UpdateKeyValueSet(absl::StrCat("key", i), absl::MakeSpan(values),
+                             1);
+  }
+  cache->DeleteValuesInSet("key1", absl::MakeSpan(deleted_values), 2);
+  // Deleted values of missing keys are kept, so older updates don't add them.
+  cache->DeleteValuesInSet("key100", absl::MakeSpan(deleted_values), 2);
+  cache->UpdateKeyValueSet("key100", absl::MakeSpan(values), 1);
+  auto result = cache->GetKeyValueSet(GetRequestContext(),
+                                      {"key0", "key1", "key99", "key100"});
+  EXPECT_THAT(result->GetValueSet("key0"), UnorderedElementsAre("v1", "v2"));
+  EXPECT_THAT(result->GetValueSet("key1"), UnorderedElementsAre("v2"));
+  EXPECT_THAT(result->GetValueSet("key99"), UnorderedElementsAre("v1", "v2"));
+  EXPECT_THAT(result->GetValueSet("key100"), UnorderedElementsAre("v2"));
+  EXPECT_GT(cache->GetMemoryUsage()[""].hash_table_bytes, 0);
+
+  cache->DeleteValuesInSet("key0", absl::MakeSpan(values), 3);
+  cache->RemoveDeletedKeys(3);
+  auto& key_value_cache = static_cast<KeyValueCache&>(*cache);
+  EXPECT_EQ(KeyValueCacheTestPeer::GetCacheKeyValueSetMapSize(key_value_cache),
+            100);
+  EXPECT_EQ(KeyValueCacheTestPeer::GetSetValueSize(key_value_cache, "key1"),
+            1);
+}
+
+TEST_F(CacheTest, ConcurrentUpdatesWithStripedSetLocks) {
+  std::unique_ptr<Cache> cache =
+      KeyValueCache::Create({}, {.num_stripes = 2});
+  absl::Notification start;
+  auto update_keys = [&cache, &start](int thread_index) {
+    start.WaitForNotification();
+    for (int i = 0; i < 100; ++i) {
+      // Adds keys, which moves the sets, while other threads update them.
+      const std::string key = absl::StrCat("key", i % 10 + thread_index * 10);
+      const std::string value = absl::StrCat("v", i);
+      std::vector<std::string_view> values = {value};
+      cache->UpdateKeyValueSet(key, absl::MakeSpan(values), i + 1);
+      cache->DeleteValuesInSet(absl::StrCat("key", i % 10),
+                               absl::MakeSpan(values), i + 1);
+    }
+  };
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back(update_keys, i);
+  }
+  start.Notify();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  auto result = cache->GetKeyValueSet(GetRequestContext(), {"key39"});
+  EXPECT_THAT(result->GetValueSet("key39"),
+              UnorderedElementsAre("v9", "v19", "v29", "v39", "v49", "v59",
+                                   "v69", "v79", "v89", "v99"));
+}
+
+TEST_F(CacheTest, MemoryReportListsTheLargestEntries) {
+  std::unique_ptr<Cache> cache = KeyValueCache::Create();
+  cache->UpdateKeyValue("small", "v", 1);
+  cache->UpdateKeyValue("large", std::string(1000, 'a'), 1, "prefix");
+  cache->UpdateKeyValue("medium", std::string(100, 'a'), 1);
+  std::vector<std::string_view> values = {"v1", "v2", "v3"};
+  cache->UpdateKeyValueSet("set", absl::MakeSpan(values), 1);
+  const std::string report = cache->DebugMemoryReport(/*num_largest=*/2);
+  EXPECT_THAT(report, testing::HasSubstr("Prefix \"prefix\": "));
+  EXPECT_THAT(report, testing::HasSubstr("set (3 values)"));
+  EXPECT_THAT(report, testing::Not(testing::HasSubstr("small")));
+  EXPECT_LT(report.find("large (prefix \"prefix\")"),
+            report.find("medium (prefix \"\")"));
+}
+
+TEST_F(CacheTest, MemoryOfAllCachesIsExported) {
+  const double value_bytes = KeyValueCache::GetMemoryBytesOfAllCaches().at(
+      std::string(kCacheValueBytes));
+  {
+    std::unique_ptr<Cache> cache = KeyValueCache::Create();
+    cache->UpdateKeyValue("key", std::string(1000, 'a'), 1);
+    EXPECT_EQ(KeyValueCache::GetMemoryBytesOfAllCaches().at(
+                  std::string(kCacheValueBytes)),
+              value_bytes + 1000);
+  }
+  EXPECT_EQ(KeyValueCache::GetMemoryBytesOfAllCaches().at(
+                std::string(kCacheValueBytes)),
+            value_bytes);
+}
+
 }  // namespace
 }  // namespace kv_server
@@ -15,7 +15,9 @@
 #ifndef COMPONENTS_DATA_SERVER_CACHE_MOCKS_H_
 #define COMPONENTS_DATA_SERVER_CACHE_MOCKS_H_
 
+#include <cstdint>
 #include <memory>
+#include <optional>
 #include <string>
 #include <utility>
 #include <vector>
@@ -40,6 +42,10 @@ class MockCache : public Cache {
               (const RequestContext& request_context,
                const absl::flat_hash_set<std::string_view>&),
               (const, override));
+  MOCK_METHOD((absl::StatusOr<std::vector<std::string>>), GetKeysByPrefix,
+              (std::string_view key_prefix, int limit), (const, override));
+  MOCK_METHOD((absl::StatusOr<std::vector<std::string>>), GetSetsContaining,
+              (std::string_view member), (const, override));
   MOCK_METHOD(void, UpdateKeyValue,
               (std::string_view key, std::string_view value, int64_t ts,
                std::string_view prefix),
@@ -57,16 +63,28 @@ class MockCache : public Cache {
               (override));
   MOCK_METHOD(void, RemoveDeletedKeys, (int64_t ts, std::string_view prefix),
               (override));
+  MOCK_METHOD(CleanupProgress, RemoveDeletedKeysSlice,
+              (int64_t ts, std::string_view prefix, absl::Time deadline),
+              (override));
 };
 
 class MockGetKeyValueSetResult : public GetKeyValueSetResult {
  public:
   MOCK_METHOD((absl::flat_hash_set<std::string_view>), GetValueSet,
               (std::string_view), (const, override));
+  MOCK_METHOD(bool, HasValueBitmaps, (), (const, override));
+  MOCK_METHOD(IdBitmap, GetValueBitmap, (std::string_view), (const, override));
+  MOCK_METHOD(std::string_view, GetValueForId, (uint32_t), (const, override));
+  MOCK_METHOD(std::optional<uint64_t>, GetValueSetVersion, (std::string_view),
+              (const, override));
   MOCK_METHOD(void, AddKeyValueSet,
               (std::string_view, absl::flat_hash_set<std::string_view>,
                std::unique_ptr<absl::ReaderMutexLock>),
               (override));
+  MOCK_METHOD(void, AddKeyValueSetSnapshot,
+              (std::string_view,
+               (std::shared_ptr<const absl::flat_hash_set<std::string_view>>)),
+              (override));
 };
 
 }  // namespace kv_server
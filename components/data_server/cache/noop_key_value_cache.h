@@ -63,6 +63,10 @@ class NoOpKeyValueCache : public Cache {
     void AddKeyValueSet(
         std::string_view key, absl::flat_hash_set<std::string_view> value_set,
         std::unique_ptr<absl::ReaderMutexLock> key_lock) override {}
+    void AddKeyValueSetSnapshot(
+        std::string_view key,
+        std::shared_ptr<const absl::flat_hash_set<std::string_view>> value_set)
+        override {}
   };
 };
 
@@ -0,0 +1,303 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/data_server/cache/numa_key_value_cache.h"
+
+#include <algorithm>
+#include <deque>
+#include <thread>
+#include <utility>
+
+#include "absl/log/log.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/blocking_counter.h"
+#include "absl/synchronization/notification.h"
+
+namespace kv_server {
+namespace {
+
+// Id of the node that the calling thread was pinned to as a reader, -1 if it
+// wasn't.
+thread_local int reader_node_id = -1;
+
+}  // namespace
+
+// A replica and the writer thread that owns it.
+class NumaKeyValueCache::Replica {
+ public:
+  Replica(NumaNode node,
+          absl::AnyInvocable<std::unique_ptr<Cache>()>& replica_factory)
+      : node_(std::move(node)) {
+    absl::Notification created;
+    thread_ = std::thread([this, &replica_factory, &created] {
+      if (const auto status = PinCurrentThread(node_.cpus); !status.ok()) {
+        LOG(ERROR) << "Failed to pin the writer thread of NUMA node "
+                   << node_.id << ": " << status;
+      }
+      cache_ = replica_factory();
+      created.Notify();
+      Run();
+    });
+    created.WaitForNotification();
+  }
+
+  ~Replica() {
+    {
+      absl::MutexLock lock(&mutex_);
+      stopped_ = true;
+    }
+    thread_.join();
+  }
+
+  const NumaNode& node() const { return node_; }
+  Cache& cache() { return *cache_; }
+  const Cache& cache() const { return *cache_; }
+
+  // Queues `task` to run on the writer thread.
+  void Post(absl::AnyInvocable<void()> task) ABSL_LOCKS_EXCLUDED(mutex_) {
+    absl::MutexLock lock(&mutex_);
+    tasks_.push_back(std::move(task));
+  }
+
+ private:
+  void Run() ABSL_LOCKS_EXCLUDED(mutex_) {
+    while (true) {
+      absl::AnyInvocable<void()> task;
+      {
+        absl::MutexLock lock(&mutex_);
+        mutex_.Await(absl::Condition(this, &Replica::HasTaskOrStopped));
+        if (tasks_.empty()) {
+          break;
+        }
+        task = std::move(tasks_.front());
+        tasks_.pop_front();
+      }
+      task();
+    }
+    // The memory of the replica is released on its node too.
+    cache_.reset();
+  }
+
+  bool HasTaskOrStopped() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    return stopped_ || !tasks_.empty();
+  }
+
+  const NumaNode node_;
+  // Only written by the writer thread, before `Replica` is constructed and
+  // after it starts being destroyed.
+  std::unique_ptr<Cache> cache_;
+  absl::Mutex mutex_;
+  std::deque<absl::AnyInvocable<void()>> tasks_ ABSL_GUARDED_BY(mutex_);
+  bool stopped_ ABSL_GUARDED_BY(mutex_) = false;
+  std::thread thread_;
+};
+
+NumaKeyValueCache::NumaKeyValueCache(
+    std::vector<NumaNode> nodes,
+    absl::AnyInvocable<std::unique_ptr<Cache>()>& replica_factory,
+    Options options)
+    : options_(options) {
+  replicas_.reserve(nodes.size());
+  for (auto& node : nodes) {
+    for (int cpu : node.cpus) {
+      if (cpu >= replica_by_cpu_.size()) {
+        replica_by_cpu_.resize(cpu + 1, -1);
+      }
+      replica_by_cpu_[cpu] = replicas_.size();
+    }
+    replicas_.push_back(
+        std::make_unique<Replica>(std::move(node), replica_factory));
+  }
+}
+
+NumaKeyValueCache::~NumaKeyValueCache() = default;
+
+const Cache& NumaKeyValueCache::GetReaderReplica() const {
+  if (options_.pin_readers) {
+    if (reader_node_id < 0) {
+      const Replica& replica =
+          *replicas_[next_reader_replica_.fetch_add(1) % replicas_.size()];
+      if (const auto status = PinCurrentThread(replica.node().cpus);
+          !status.ok()) {
+        LOG(ERROR) << "Failed to pin a reader thread to NUMA node "
+                   << replica.node().id << ": " << status;
+      }
+      reader_node_id = replica.node().id;
+    }
+    for (const auto& replica : replicas_) {
+      if (replica->node().id == reader_node_id) {
+        return replica->cache();
+      }
+    }
+  } else if (const int cpu = GetCurrentCpu();
+             cpu >= 0 && cpu < replica_by_cpu_.size() &&
+             replica_by_cpu_[cpu] >= 0) {
+    return replicas_[replica_by_cpu_[cpu]]->cache();
+  }
+  return replicas_.front()->cache();
+}
+
+void NumaKeyValueCache::ForEachReplica(
+    absl::FunctionRef<void(int index, Cache& replica)> fn) {
+  absl::BlockingCounter done(replicas_.size());
+  {
+    absl::MutexLock lock(&write_mutex_);
+    for (int i = 0; i < replicas_.size(); ++i) {
+      replicas_[i]->Post([fn, i, &replica = *replicas_[i], &done]() {
+        fn(i, replica.cache());
+        done.DecrementCount();
+      });
+    }
+  }
+  done.Wait();
+}
+
+absl::flat_hash_map<std::string, std::string>
+NumaKeyValueCache::GetKeyValuePairs(
+    const RequestContext& request_context,
+    const absl::flat_hash_set<std::string_view>& key_set) const {
+  return GetReaderReplica().GetKeyValuePairs(request_context, key_set);
+}
+
+GetKeyValuePairsResult NumaKeyValueCache::GetKeyValuePairViews(
+    const RequestContext& request_context,
+    const absl::flat_hash_set<std::string_view>& key_set) const {
+  return GetReaderReplica().GetKeyValuePairViews(request_context, key_set);
+}
+
+GetKeyValuePairsResult NumaKeyValueCache::GetHashedKeyValuePairViews(
+    const RequestContext& request_context,
+    absl::Span<const HashedKey> keys) const {
+  return GetReaderReplica().GetHashedKeyValuePairViews(request_context, keys);
+}
+
+std::unique_ptr<GetKeyValueSetResult> NumaKeyValueCache::GetKeyValueSet(
+    const RequestContext& request_context,
+    const absl::flat_hash_set<std::string_view>& key_set) const {
+  return GetReaderReplica().GetKeyValueSet(request_context, key_set);
+}
+
+absl::StatusOr<std::vector<std::string>> NumaKeyValueCache::GetSetsContaining(
+    std::string_view member) const {
+  return GetReaderReplica().GetSetsContaining(member);
+}
+
+void NumaKeyValueCache::UpdateKeyValue(std::string_view key,
+                                       std::string_view value,
+                                       int64_t logical_commit_time,
+                                       std::string_view prefix) {
+  ForEachReplica([&](int, Cache& replica) {
+    replica.UpdateKeyValue(key, value, logical_commit_time, prefix);
+  });
+}
+
+void NumaKeyValueCache::UpdateKeyValueSet(
+    std::string_view key, absl::Span<std::string_view> value_set,
+    int64_t logical_commit_time, std::string_view prefix) {
+  ForEachReplica([&](int, Cache& replica) {
+    replica.UpdateKeyValueSet(key, value_set, logical_commit_time, prefix);
+  });
+}
+
+void NumaKeyValueCache::DeleteKey(std::string_view key,
+                                  int64_t logical_commit_time,
+                                  std::string_view prefix) {
+  ForEachReplica([&](int, Cache& replica) {
+    replica.DeleteKey(key, logical_commit_time, prefix);
+  });
+}
+
+void NumaKeyValueCache::DeleteValuesInSet(
+    std::string_view key, absl::Span<std::string_view> value_set,
+    int64_t logical_commit_time, std::string_view prefix) {
+  ForEachReplica([&](int, Cache& replica) {
+    replica.DeleteValuesInSet(key, value_set, logical_commit_time, prefix);
+  });
+}
+
+void NumaKeyValueCache::ApplyMutations(absl::Span<const Mutation> mutations,
+                                       std::string_view prefix) {
+  ForEachReplica([&](int, Cache& replica) {
+    replica.ApplyMutations(mutations, prefix);
+  });
+}
+
+void NumaKeyValueCache::RemoveDeletedKeys(int64_t logical_commit_time,
+                                          std::string_view prefix) {
+  ForEachReplica([&](int, Cache& replica) {
+    replica.RemoveDeletedKeys(logical_commit_time, prefix);
+  });
+}
+
+Cache::CleanupProgress NumaKeyValueCache::RemoveDeletedKeysSlice(
+    int64_t logical_commit_time, std::string_view prefix,
+    absl::Time deadline) {
+  std::vector<CleanupProgress> progress_by_replica(replicas_.size());
+  ForEachReplica([&](int index, Cache& replica) {
+    progress_by_replica[index] =
+        replica.RemoveDeletedKeysSlice(logical_commit_time, prefix, deadline);
+  });
+  CleanupProgress progress;
+  for (const CleanupProgress& replica_progress : progress_by_replica) {
+    progress.done = progress.done && replica_progress.done;
+    progress.remaining_deleted_values +=
+        replica_progress.remaining_deleted_values;
+  }
+  return progress;
+}
+
+absl::Status NumaKeyValueCache::ExportMutations(
+    absl::FunctionRef<void(std::string_view prefix,
+                           absl::Span<const Mutation> mutations)>
+        fn) const {
+  return replicas_.front()->cache().ExportMutations(fn);
+}
+
+absl::flat_hash_map<std::string, Cache::MemoryUsage>
+NumaKeyValueCache::GetMemoryUsage() const {
+  absl::flat_hash_map<std::string, MemoryUsage> memory_usage;
+  for (const auto& replica : replicas_) {
+    for (const auto& [prefix, replica_usage] :
+         replica->cache().GetMemoryUsage()) {
+      memory_usage[prefix] += replica_usage;
+    }
+  }
+  return memory_usage;
+}
+
+std::string NumaKeyValueCache::DebugMemoryReport(int num_largest) const {
+  std::string report;
+  for (const auto& replica : replicas_) {
+    absl::StrAppend(&report, "NUMA node ", replica->node().id, ":\n",
+                    replica->cache().DebugMemoryReport(num_largest));
+  }
+  return report;
+}
+
+std::unique_ptr<Cache> NumaKeyValueCache::Create(
+    std::vector<NumaNode> nodes,
+    absl::AnyInvocable<std::unique_ptr<Cache>()> replica_factory,
+    Options options) {
+  if (nodes.empty()) {
+    LOG(WARNING) << "No NUMA node, creating a single cache";
+    return replica_factory();
+  }
+  LOG(INFO) << "Creating a cache replica on each of " << nodes.size()
+            << " NUMA nodes";
+  return absl::WrapUnique(
+      new NumaKeyValueCache(std::move(nodes), replica_factory, options));
+}
+
+}  // namespace kv_server
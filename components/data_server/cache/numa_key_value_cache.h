@@ -0,0 +1,154 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_CACHE_NUMA_KEY_VALUE_CACHE_H_
+#define COMPONENTS_DATA_SERVER_CACHE_NUMA_KEY_VALUE_CACHE_H_
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/functional/any_invocable.h"
+#include "absl/functional/function_ref.h"
+#include "absl/synchronization/mutex.h"
+#include "components/data_server/cache/cache.h"
+#include "components/data_server/cache/numa_topology.h"
+
+namespace kv_server {
+
+// Cache that keeps one replica of the data per NUMA node, so that lookups
+// only read memory of the node they run on.
+//
+// Every replica has a writer thread pinned to the CPUs of its node, which
+// creates the replica and applies every mutation to it, so the kernel
+// allocates the replica's memory on that node. Mutations block until every
+// replica has applied them, and are applied in the same order to all of them.
+//
+// Lookups read the replica of the node the calling thread runs on. With
+// `pin_readers`, each thread that looks up the cache is pinned to the CPUs of
+// a node on its first lookup, the nodes taking turns, so that it doesn't
+// migrate away from the replica it reads.
+//
+// Memory usage grows with the number of nodes.
+class NumaKeyValueCache : public Cache {
+ public:
+  struct Options {
+    bool pin_readers = true;
+  };
+
+  // Stops the writer threads, which destroy their replicas.
+  ~NumaKeyValueCache() override;
+
+  absl::flat_hash_map<std::string, std::string> GetKeyValuePairs(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override;
+
+  GetKeyValuePairsResult GetKeyValuePairViews(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override;
+
+  GetKeyValuePairsResult GetHashedKeyValuePairViews(
+      const RequestContext& request_context,
+      absl::Span<const HashedKey> keys) const override;
+
+  std::unique_ptr<GetKeyValueSetResult> GetKeyValueSet(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override;
+
+  absl::StatusOr<std::vector<std::string>> GetSetsContaining(
+      std::string_view member) const override;
+
+  void UpdateKeyValue(std::string_view key, std::string_view value,
+                      int64_t logical_commit_time,
+                      std::string_view prefix = "") override;
+
+  void UpdateKeyValueSet(std::string_view key,
+                         absl::Span<std::string_view> value_set,
+                         int64_t logical_commit_time,
+                         std::string_view prefix = "") override;
+
+  void DeleteKey(std::string_view key, int64_t logical_commit_time,
+                 std::string_view prefix = "") override;
+
+  void DeleteValuesInSet(std::string_view key,
+                         absl::Span<std::string_view> value_set,
+                         int64_t logical_commit_time,
+                         std::string_view prefix = "") override;
+
+  void ApplyMutations(absl::Span<const Mutation> mutations,
+                      std::string_view prefix = "") override;
+
+  void RemoveDeletedKeys(int64_t logical_commit_time,
+                         std::string_view prefix = "") override;
+
+  // Cleans up the replicas in parallel, the result is done once all are.
+  CleanupProgress RemoveDeletedKeysSlice(int64_t logical_commit_time,
+                                         std::string_view prefix,
+                                         absl::Time deadline) override;
+
+  // Exports the first replica, they all have the same data.
+  absl::Status ExportMutations(
+      absl::FunctionRef<void(std::string_view prefix,
+                             absl::Span<const Mutation> mutations)>
+          fn) const override;
+
+  // Sums the memory usage of the replicas.
+  absl::flat_hash_map<std::string, MemoryUsage> GetMemoryUsage()
+      const override;
+
+  // Concatenates the reports of the replicas.
+  std::string DebugMemoryReport(int num_largest) const override;
+
+  // Creates one replica per node in `nodes` with `replica_factory`, which is
+  // called on the writer thread of the node. Returns a single replica if
+  // `nodes` is empty.
+  static std::unique_ptr<Cache> Create(
+      std::vector<NumaNode> nodes,
+      absl::AnyInvocable<std::unique_ptr<Cache>()> replica_factory,
+      Options options);
+
+ private:
+  class Replica;
+
+  NumaKeyValueCache(
+      std::vector<NumaNode> nodes,
+      absl::AnyInvocable<std::unique_ptr<Cache>()>& replica_factory,
+      Options options);
+
+  // Returns the replica that the calling thread should read.
+  const Cache& GetReaderReplica() const;
+
+  // Runs `fn` on the writer thread of every replica, and waits for all of
+  // them to finish.
+  void ForEachReplica(absl::FunctionRef<void(int index, Cache& replica)> fn)
+      ABSL_LOCKS_EXCLUDED(write_mutex_);
+
+  const Options options_;
+  std::vector<std::unique_ptr<Replica>> replicas_;
+  // Index of the replica of each CPU's node, -1 for CPUs of no node.
+  std::vector<int> replica_by_cpu_;
+  // Held while a mutation is queued on every replica, so that they all apply
+  // mutations in the same order.
+  absl::Mutex write_mutex_;
+  // Replica whose node the next pinned reader thread is pinned to.
+  mutable std::atomic<int> next_reader_replica_ = 0;
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_CACHE_NUMA_KEY_VALUE_CACHE_H_
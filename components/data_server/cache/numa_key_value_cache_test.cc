@@ -0,0 +1,159 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/data_server/cache/numa_key_value_cache.h"
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "components/data_server/cache/key_value_cache.h"
+#include "components/data_server/cache/mocks.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+using testing::UnorderedElementsAre;
+
+class NumaKeyValueCacheTest : public ::testing::Test {
+ protected:
+  NumaKeyValueCacheTest() {
+    InitMetricsContextMap();
+    scope_metrics_context_ = std::make_unique<ScopeMetricsContext>();
+    request_context_ =
+        std::make_unique<RequestContext>(*scope_metrics_context_);
+  }
+  RequestContext& GetRequestContext() { return *request_context_; }
+
+  // Two nodes on the CPU that the test runs on, so that pinning succeeds.
+  static std::vector<NumaNode> TwoNodes() {
+    const int cpu = GetCurrentCpu();
+    return {{.id = 0, .cpus = {cpu}}, {.id = 1, .cpus = {cpu}}};
+  }
+
+  // Creates replicas that know their index under the key "replica".
+  static absl::AnyInvocable<std::unique_ptr<Cache>()> NumberedReplicas() {
+    return [num_replicas = 0]() mutable {
+      auto replica = KeyValueCache::Create();
+      replica->UpdateKeyValue("replica", absl::StrCat(num_replicas++), 1);
+      return replica;
+    };
+  }
+
+  std::unique_ptr<ScopeMetricsContext> scope_metrics_context_;
+  std::unique_ptr<RequestContext> request_context_;
+};
+
+TEST_F(NumaKeyValueCacheTest, MutationsReachEveryReplica) {
+  auto cache = NumaKeyValueCache::Create(
+      TwoNodes(), [] { return KeyValueCache::Create(); },
+      {.pin_readers = false});
+  cache->UpdateKeyValue("key1", "value1", 1);
+  cache->UpdateKeyValue("key2", "value2", 2);
+  cache->DeleteKey("key2", 3);
+  std::vector<std::string_view> values = {"v1", "v2"};
+  cache->UpdateKeyValueSet("set", absl::MakeSpan(values), 4);
+  std::vector<Cache::Mutation> mutations = {{
+      .type = Cache::Mutation::Type::kUpdateKeyValue,
+      .key = "key3",
+      .value = "value3",
+      .logical_commit_time = 5,
+  }};
+  cache->ApplyMutations(mutations);
+  cache->RemoveDeletedKeys(3);
+
+  // The memory usage adds up the replicas.
+  absl::flat_hash_map<std::string, Cache::MemoryUsage> single_usage;
+  {
+    auto single = KeyValueCache::Create();
+    single->UpdateKeyValue("key1", "value1", 1);
+    single->UpdateKeyValue("key2", "value2", 2);
+    single->DeleteKey("key2", 3);
+    single->UpdateKeyValueSet("set", absl::MakeSpan(values), 4);
+    single->ApplyMutations(mutations);
+    single->RemoveDeletedKeys(3);
+    single_usage = single->GetMemoryUsage();
+  }
+  EXPECT_EQ(cache->GetMemoryUsage()[""].value_bytes,
+            2 * single_usage[""].value_bytes);
+  EXPECT_THAT(
+      cache->GetKeyValuePairs(GetRequestContext(), {"key1", "key2", "key3"}),
+      UnorderedElementsAre(KVPairEq("key1", "value1"),
+                           KVPairEq("key3", "value3")));
+  EXPECT_THAT(
+      cache->GetKeyValueSet(GetRequestContext(), {"set"})->GetValueSet("set"),
+      UnorderedElementsAre("v1", "v2"));
+}
+
+TEST_F(NumaKeyValueCacheTest, PinnedReadersTakeTurns) {
+  auto cache = NumaKeyValueCache::Create(TwoNodes(), NumberedReplicas(),
+                                         {.pin_readers = true});
+  std::vector<std::string> replicas_read;
+  for (int i = 0; i < 3; ++i) {
+    // Each new thread is pinned to the next node, and keeps reading its
+    // replica.
+    std::thread reader([&] {
+      for (int j = 0; j < 2; ++j) {
+        for (const auto& [key, value] :
+             cache->GetKeyValuePairs(GetRequestContext(), {"replica"})) {
+          replicas_read.push_back(value);
+        }
+      }
+    });
+    reader.join();
+  }
+  EXPECT_THAT(replicas_read,
+              testing::ElementsAre("0", "0", "1", "1", "0", "0"));
+}
+
+TEST_F(NumaKeyValueCacheTest, UnpinnedReadersReadReplicaOfTheirCpu) {
+  const int cpu = GetCurrentCpu();
+  ASSERT_GE(cpu, 0);
+  ASSERT_TRUE(PinCurrentThread({cpu}).ok());
+  // Only the second node has the CPU of the test.
+  auto cache = NumaKeyValueCache::Create(
+      {{.id = 0, .cpus = {cpu + 1}}, {.id = 1, .cpus = {cpu}}},
+      NumberedReplicas(), {.pin_readers = false});
+  EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(), {"replica"}),
+              UnorderedElementsAre(KVPairEq("replica", "1")));
+}
+
+TEST_F(NumaKeyValueCacheTest, SlicesCleanUpEveryReplica) {
+  auto cache = NumaKeyValueCache::Create(
+      TwoNodes(), [] { return KeyValueCache::Create(); },
+      {.pin_readers = false});
+  for (int i = 0; i < 10; ++i) {
+    cache->DeleteKey(absl::StrCat("key", i), 1);
+  }
+  Cache::CleanupProgress progress;
+  do {
+    progress = cache->RemoveDeletedKeysSlice(1, "", absl::InfiniteFuture());
+  } while (!progress.done);
+  EXPECT_EQ(progress.remaining_deleted_values, 0);
+  EXPECT_EQ(cache->GetMemoryUsage()[""].tombstone_bytes, 0);
+}
+
+TEST_F(NumaKeyValueCacheTest, NoNodesCreatesSingleCache) {
+  auto cache = NumaKeyValueCache::Create({}, NumberedReplicas(), {});
+  EXPECT_EQ(dynamic_cast<NumaKeyValueCache*>(cache.get()), nullptr);
+  EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(), {"replica"}),
+              UnorderedElementsAre(KVPairEq("replica", "0")));
+}
+
+}  // namespace
+}  // namespace kv_server
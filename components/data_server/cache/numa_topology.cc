@@ -0,0 +1,140 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/data_server/cache/numa_topology.h"
+
+#include <sched.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/strip.h"
+
+namespace kv_server {
+
+absl::StatusOr<std::vector<int>> ParseCpuList(std::string_view cpu_list) {
+  std::vector<int> cpus;
+  cpu_list = absl::StripAsciiWhitespace(cpu_list);
+  if (cpu_list.empty()) {
+    return cpus;
+  }
+  for (std::string_view range : absl::StrSplit(cpu_list, ',')) {
+    std::pair<std::string_view, std::string_view> bounds =
+        absl::StrSplit(range, absl::MaxSplits('-', 1));
+    int first;
+    int last;
+    if (!absl::SimpleAtoi(bounds.first, &first) ||
+        !absl::SimpleAtoi(bounds.second.empty() ? bounds.first : bounds.second,
+                          &last) ||
+        first < 0 || last < first) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Invalid CPU list: ", cpu_list));
+    }
+    for (int cpu = first; cpu <= last; ++cpu) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+std::vector<NumaNode> GetNumaNodes(std::string_view sysfs_node_directory) {
+  std::vector<NumaNode> nodes;
+  std::error_code error;
+  for (const auto& entry : std::filesystem::directory_iterator(
+           std::filesystem::path(sysfs_node_directory), error)) {
+    const std::string filename = entry.path().filename().native();
+    std::string_view name = filename;
+    int id;
+    if (!absl::ConsumePrefix(&name, "node") || !absl::SimpleAtoi(name, &id)) {
+      continue;
+    }
+    std::ifstream stream(entry.path() / "cpulist");
+    std::string cpu_list;
+    if (!std::getline(stream, cpu_list)) {
+      continue;
+    }
+    auto cpus = ParseCpuList(cpu_list);
+    if (!cpus.ok() || cpus->empty()) {
+      continue;
+    }
+    nodes.push_back({.id = id, .cpus = *std::move(cpus)});
+  }
+  std::sort(nodes.begin(), nodes.end(),
+            [](const NumaNode& a, const NumaNode& b) { return a.id < b.id; });
+  return nodes;
+}
+
+absl::Status PinCurrentThread(const std::vector<int>& cpus) {
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for (int cpu : cpus) {
+    if (cpu < CPU_SETSIZE) {
+      CPU_SET(cpu, &cpu_set);
+    }
+  }
+  if (CPU_COUNT(&cpu_set) == 0) {
+    return absl::InvalidArgumentError("No CPU to pin the thread to");
+  }
+  if (sched_setaffinity(/*pid=*/0, sizeof(cpu_set), &cpu_set) != 0) {
+    return absl::InternalError(
+        absl::StrCat("sched_setaffinity failed: ", std::strerror(errno)));
+  }
+  return absl::OkStatus();
+}
+
+int GetCurrentCpu() { return sched_getcpu(); }
+
+absl::StatusOr<std::vector<int>> GetCurrentThreadCpus() {
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  if (sched_getaffinity(/*pid=*/0, sizeof(cpu_set), &cpu_set) != 0) {
+    return absl::InternalError(
+        absl::StrCat("sched_getaffinity failed: ", std::strerror(errno)));
+  }
+  std::vector<int> cpus;
+  for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+    if (CPU_ISSET(cpu, &cpu_set)) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+absl::Status CallPinnedTo(const std::vector<int>& cpus,
+                          absl::FunctionRef<void()> fn) {
+  if (cpus.empty()) {
+    fn();
+    return absl::OkStatus();
+  }
+  const auto previous_cpus = GetCurrentThreadCpus();
+  if (!previous_cpus.ok()) {
+    return previous_cpus.status();
+  }
+  if (auto status = PinCurrentThread(cpus); !status.ok()) {
+    return status;
+  }
+  fn();
+  return PinCurrentThread(*previous_cpus);
+}
+
+}  // namespace kv_server
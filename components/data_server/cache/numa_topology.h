@@ -0,0 +1,62 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_CACHE_NUMA_TOPOLOGY_H_
+#define COMPONENTS_DATA_SERVER_CACHE_NUMA_TOPOLOGY_H_
+
+#include <string_view>
+#include <vector>
+
+#include "absl/functional/function_ref.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+
+namespace kv_server {
+
+// A NUMA node and the CPUs that are local to it.
+struct NumaNode {
+  int id;
+  std::vector<int> cpus;
+};
+
+// Parses a Linux CPU list, e.g. "0-3,8,10-11".
+absl::StatusOr<std::vector<int>> ParseCpuList(std::string_view cpu_list);
+
+// Returns the NUMA nodes that have CPUs, sorted by id, as listed in
+// `sysfs_node_directory`. Returns no nodes if the directory can't be read.
+std::vector<NumaNode> GetNumaNodes(
+    std::string_view sysfs_node_directory = "/sys/devices/system/node");
+
+// Restricts the calling thread to run on `cpus`. Memory that the thread
+// touches first is then allocated on their node by the kernel.
+absl::Status PinCurrentThread(const std::vector<int>& cpus);
+
+// Returns the CPU that the calling thread runs on, or -1 if it is unknown.
+int GetCurrentCpu();
+
+// Returns the CPUs that the calling thread is allowed to run on.
+absl::StatusOr<std::vector<int>> GetCurrentThreadCpus();
+
+// Calls `fn` with the calling thread restricted to `cpus`, then lifts the
+// restriction. The threads and processes that `fn` starts keep running on
+// `cpus`, as they inherit the affinity of the thread that starts them. With
+// no `cpus`, only calls `fn`.
+absl::Status CallPinnedTo(const std::vector<int>& cpus,
+                          absl::FunctionRef<void()> fn);
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_CACHE_NUMA_TOPOLOGY_H_
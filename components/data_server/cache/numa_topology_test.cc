@@ -0,0 +1,93 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/data_server/cache/numa_topology.h"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+using testing::ElementsAre;
+using testing::IsEmpty;
+using testing::Not;
+
+TEST(NumaTopologyTest, ParsesCpuLists) {
+  EXPECT_THAT(*ParseCpuList("0-3,8,10-11\n"),
+              ElementsAre(0, 1, 2, 3, 8, 10, 11));
+  EXPECT_THAT(*ParseCpuList("5"), ElementsAre(5));
+  EXPECT_THAT(*ParseCpuList(""), IsEmpty());
+  EXPECT_FALSE(ParseCpuList("3-1").ok());
+  EXPECT_FALSE(ParseCpuList("a").ok());
+  EXPECT_FALSE(ParseCpuList("1,,2").ok());
+}
+
+TEST(NumaTopologyTest, ReadsNodesWithCpus) {
+  const std::filesystem::path directory =
+      std::filesystem::path(testing::TempDir()) / "numa_nodes";
+  std::filesystem::remove_all(directory);
+  for (const auto& [node, cpu_list] :
+       {std::pair{"node1", "4-5,7\n"}, std::pair{"node0", "0-3\n"},
+        std::pair{"node2", "\n"}}) {
+    std::filesystem::create_directories(directory / node);
+    std::ofstream(directory / node / "cpulist") << cpu_list;
+  }
+  std::ofstream(directory / "possible") << "0-2\n";
+
+  const auto nodes = GetNumaNodes(directory.native());
+  ASSERT_EQ(nodes.size(), 2);
+  EXPECT_EQ(nodes[0].id, 0);
+  EXPECT_THAT(nodes[0].cpus, ElementsAre(0, 1, 2, 3));
+  EXPECT_EQ(nodes[1].id, 1);
+  EXPECT_THAT(nodes[1].cpus, ElementsAre(4, 5, 7));
+}
+
+TEST(NumaTopologyTest, MissingDirectoryHasNoNodes) {
+  EXPECT_THAT(GetNumaNodes("/nonexistent/node"), IsEmpty());
+}
+
+TEST(NumaTopologyTest, PinsToCurrentCpu) {
+  const int cpu = GetCurrentCpu();
+  ASSERT_GE(cpu, 0);
+  EXPECT_TRUE(PinCurrentThread({cpu}).ok());
+  EXPECT_EQ(GetCurrentCpu(), cpu);
+  EXPECT_FALSE(PinCurrentThread({}).ok());
+}
+
+TEST(NumaTopologyTest, StartedThreadsKeepPinning) {
+  const auto all_cpus = GetCurrentThreadCpus();
+  ASSERT_TRUE(all_cpus.ok()) << all_cpus.status();
+  ASSERT_THAT(*all_cpus, Not(IsEmpty()));
+  const std::vector<int> cpus = {all_cpus->front()};
+  std::vector<int> thread_cpus;
+  std::thread thread;
+  ASSERT_TRUE(CallPinnedTo(cpus, [&] {
+                EXPECT_EQ(*GetCurrentThreadCpus(), cpus);
+                thread = std::thread(
+                    [&thread_cpus] { thread_cpus = *GetCurrentThreadCpus(); });
+              }).ok());
+  thread.join();
+  EXPECT_EQ(thread_cpus, cpus);
+  EXPECT_EQ(*GetCurrentThreadCpus(), *all_cpus);
+}
+
+}  // namespace
+}  // namespace kv_server
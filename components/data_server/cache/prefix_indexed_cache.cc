@@ -0,0 +1,255 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data_server/cache/prefix_indexed_cache.h"
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/log/log.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+
+namespace kv_server {
+
+PrefixIndexedCache::PrefixIndexedCache(std::unique_ptr<Cache> cache,
+                                       Options options)
+    : cache_(std::move(cache)),
+      key_prefixes_(std::move(options.key_prefixes)) {}
+
+absl::flat_hash_map<std::string, std::string>
+PrefixIndexedCache::GetKeyValuePairs(
+    const RequestContext& request_context,
+    const absl::flat_hash_set<std::string_view>& key_set) const {
+  return cache_->GetKeyValuePairs(request_context, key_set);
+}
+
+GetKeyValuePairsResult PrefixIndexedCache::GetKeyValuePairViews(
+    const RequestContext& request_context,
+    const absl::flat_hash_set<std::string_view>& key_set) const {
+  return cache_->GetKeyValuePairViews(request_context, key_set);
+}
+
+GetKeyValuePairsResult PrefixIndexedCache::GetHashedKeyValuePairViews(
+    const RequestContext& request_context,
+    absl::Span<const HashedKey> keys) const {
+  return cache_->GetHashedKeyValuePairViews(request_context, keys);
+}
+
+absl::StatusOr<std::vector<std::string>> PrefixIndexedCache::GetKeysByPrefix(
+    std::string_view key_prefix, int limit) const {
+  if (!IsIndexed(key_prefix)) {
+    return absl::UnimplementedError(
+        absl::StrCat("Keys starting with ", key_prefix, " are not indexed"));
+  }
+  std::vector<std::string> keys;
+  absl::ReaderMutexLock lock(&mutex_);
+  for (auto it = index_.lower_bound(key_prefix);
+       it != index_.end() && static_cast<int>(keys.size()) < limit &&
+       absl::StartsWith(it->first, key_prefix);
+       ++it) {
+    if (!it->second.is_deleted) {
+      keys.push_back(it->first);
+    }
+  }
+  return keys;
+}
+
+absl::StatusOr<std::vector<std::string>> PrefixIndexedCache::GetSetsContaining(
+    std::string_view member) const {
+  return cache_->GetSetsContaining(member);
+}
+
+std::unique_ptr<GetKeyValueSetResult> PrefixIndexedCache::GetKeyValueSet(
+    const RequestContext& request_context,
+    const absl::flat_hash_set<std::string_view>& key_set) const {
+  return cache_->GetKeyValueSet(request_context, key_set);
+}
+
+void PrefixIndexedCache::UpdateKeyValue(std::string_view key,
+                                        std::string_view value,
+                                        int64_t logical_commit_time,
+                                        std::string_view prefix) {
+  cache_->UpdateKeyValue(key, value, logical_commit_time, prefix);
+  if (IsIndexed(key)) {
+    absl::MutexLock lock(&mutex_);
+    IndexKey(key, logical_commit_time, /*is_deleted=*/false, prefix);
+  }
+}
+
+void PrefixIndexedCache::UpdateKeyValueSet(
+    std::string_view key, absl::Span<std::string_view> value_set,
+    int64_t logical_commit_time, std::string_view prefix) {
+  cache_->UpdateKeyValueSet(key, value_set, logical_commit_time, prefix);
+}
+
+void PrefixIndexedCache::DeleteKey(std::string_view key,
+                                   int64_t logical_commit_time,
+                                   std::string_view prefix) {
+  cache_->DeleteKey(key, logical_commit_time, prefix);
+  if (IsIndexed(key)) {
+    absl::MutexLock lock(&mutex_);
+    IndexKey(key, logical_commit_time, /*is_deleted=*/true, prefix);
+  }
+}
+
+void PrefixIndexedCache::DeleteValuesInSet(
+    std::string_view key, absl::Span<std::string_view> value_set,
+    int64_t logical_commit_time, std::string_view prefix) {
+  cache_->DeleteValuesInSet(key, value_set, logical_commit_time, prefix);
+}
+
+void PrefixIndexedCache::UpdateKeyValueUInt32Set(
+    std::string_view key, absl::Span<const uint32_t> value_set,
+    int64_t logical_commit_time, std::string_view prefix) {
+  cache_->UpdateKeyValueUInt32Set(key, value_set, logical_commit_time, prefix);
+}
+
+void PrefixIndexedCache::DeleteValuesInUInt32Set(
+    std::string_view key, absl::Span<const uint32_t> value_set,
+    int64_t logical_commit_time, std::string_view prefix) {
+  cache_->DeleteValuesInUInt32Set(key, value_set, logical_commit_time, prefix);
+}
+
+void PrefixIndexedCache::ApplyMutations(absl::Span<const Mutation> mutations,
+                                        std::string_view prefix) {
+  cache_->ApplyMutations(mutations, prefix);
+  if (key_prefixes_.empty()) {
+    return;
+  }
+  absl::MutexLock lock(&mutex_);
+  for (const Mutation& mutation : mutations) {
+    if ((mutation.type != Mutation::Type::kUpdateKeyValue &&
+         mutation.type != Mutation::Type::kDeleteKey) ||
+        !IsIndexed(mutation.key)) {
+      continue;
+    }
+    IndexKey(mutation.key, mutation.logical_commit_time,
+             /*is_deleted=*/mutation.type == Mutation::Type::kDeleteKey,
+             prefix);
+  }
+}
+
+void PrefixIndexedCache::RemoveDeletedKeys(int64_t logical_commit_time,
+                                           std::string_view prefix) {
+  cache_->RemoveDeletedKeys(logical_commit_time, prefix);
+  CleanUpIndex(logical_commit_time, prefix);
+}
+
+Cache::CleanupProgress PrefixIndexedCache::RemoveDeletedKeysSlice(
+    int64_t logical_commit_time, std::string_view prefix,
+    absl::Time deadline) {
+  const CleanupProgress progress =
+      cache_->RemoveDeletedKeysSlice(logical_commit_time, prefix, deadline);
+  if (progress.done) {
+    CleanUpIndex(logical_commit_time, prefix);
+  }
+  return progress;
+}
+
+absl::Status PrefixIndexedCache::ExportMutations(
+    absl::FunctionRef<void(std::string_view prefix,
+                           absl::Span<const Mutation> mutations)>
+        fn) const {
+  return cache_->ExportMutations(fn);
+}
+
+absl::flat_hash_map<std::string, Cache::MemoryUsage>
+PrefixIndexedCache::GetMemoryUsage() const {
+  auto memory_usage = cache_->GetMemoryUsage();
+  absl::ReaderMutexLock lock(&mutex_);
+  if (!index_.empty()) {
+    memory_usage[""].hash_table_bytes +=
+        index_key_bytes_ +
+        index_.size() * (sizeof(std::string) + sizeof(IndexEntry));
+  }
+  return memory_usage;
+}
+
+std::string PrefixIndexedCache::DebugMemoryReport(int num_largest) const {
+  return cache_->DebugMemoryReport(num_largest);
+}
+
+bool PrefixIndexedCache::IsIndexed(std::string_view key) const {
+  return std::any_of(key_prefixes_.begin(), key_prefixes_.end(),
+                     [key](const std::string& key_prefix) {
+                       return absl::StartsWith(key, key_prefix);
+                     });
+}
+
+void PrefixIndexedCache::IndexKey(std::string_view key,
+                                  int64_t logical_commit_time, bool is_deleted,
+                                  std::string_view prefix) {
+  if (const auto it = max_cleanup_logical_commit_time_map_.find(prefix);
+      it != max_cleanup_logical_commit_time_map_.end() &&
+      logical_commit_time <= it->second) {
+    return;
+  }
+  auto it = index_.find(key);
+  if (it == index_.end()) {
+    it = index_.emplace(std::string(key), IndexEntry()).first;
+    index_key_bytes_ += key.size();
+  } else if (it->second.last_logical_commit_time >= logical_commit_time) {
+    VLOG(1) << "Not indexing [" << key << "] at " << logical_commit_time
+            << ", it changed at " << it->second.last_logical_commit_time;
+    return;
+  }
+  it->second = IndexEntry{.last_logical_commit_time = logical_commit_time,
+                          .is_deleted = is_deleted};
+  if (is_deleted) {
+    // Keeps late updates from indexing the key again until it is cleaned up.
+    deleted_keys_map_[prefix].emplace(logical_commit_time, key);
+  }
+}
+
+void PrefixIndexedCache::CleanUpIndex(int64_t logical_commit_time,
+                                      std::string_view prefix) {
+  if (key_prefixes_.empty()) {
+    return;
+  }
+  absl::MutexLock lock(&mutex_);
+  int64_t& max_cleanup_logical_commit_time =
+      max_cleanup_logical_commit_time_map_[prefix];
+  max_cleanup_logical_commit_time =
+      std::max(max_cleanup_logical_commit_time, logical_commit_time);
+  const auto deleted_keys = deleted_keys_map_.find(prefix);
+  if (deleted_keys == deleted_keys_map_.end()) {
+    return;
+  }
+  auto& keys_by_time = deleted_keys->second;
+  const auto end = keys_by_time.upper_bound(logical_commit_time);
+  for (auto it = keys_by_time.begin(); it != end; ++it) {
+    // Skips keys updated again after their deletion.
+    if (const auto index_it = index_.find(it->second);
+        index_it != index_.end() && index_it->second.is_deleted &&
+        index_it->second.last_logical_commit_time == it->first) {
+      index_key_bytes_ -= index_it->first.size();
+      index_.erase(index_it);
+    }
+  }
+  keys_by_time.erase(keys_by_time.begin(), end);
+}
+
+std::unique_ptr<Cache> PrefixIndexedCache::Create(std::unique_ptr<Cache> cache,
+                                                  Options options) {
+  return absl::WrapUnique(
+      new PrefixIndexedCache(std::move(cache), std::move(options)));
+}
+
+}  // namespace kv_server
@@ -0,0 +1,158 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_CACHE_PREFIX_INDEXED_CACHE_H_
+#define COMPONENTS_DATA_SERVER_CACHE_PREFIX_INDEXED_CACHE_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/btree_map.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "components/data_server/cache/cache.h"
+
+namespace kv_server {
+
+// Cache that keeps the keys of the key-value pairs under selected key prefixes,
+// such as "creative:", in an ordered index, so that `GetKeysByPrefix` finds all
+// the keys under a prefix without a key-value set listing them.
+//
+// Everything else is delegated to `cache`. The index records the time of the
+// last update or deletion of each key, with the same ordering rules as
+// `KeyValueCache`, and keeps deleted keys until they are cleaned up.
+class PrefixIndexedCache : public Cache {
+ public:
+  struct Options {
+    // The keys that start with one of these are indexed.
+    std::vector<std::string> key_prefixes;
+  };
+
+  absl::flat_hash_map<std::string, std::string> GetKeyValuePairs(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override;
+
+  GetKeyValuePairsResult GetKeyValuePairViews(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override;
+
+  GetKeyValuePairsResult GetHashedKeyValuePairViews(
+      const RequestContext& request_context,
+      absl::Span<const HashedKey> keys) const override;
+
+  // Only serves the `key_prefix`es that start with one of the indexed ones.
+  absl::StatusOr<std::vector<std::string>> GetKeysByPrefix(
+      std::string_view key_prefix, int limit) const override;
+
+  absl::StatusOr<std::vector<std::string>> GetSetsContaining(
+      std::string_view member) const override;
+
+  std::unique_ptr<GetKeyValueSetResult> GetKeyValueSet(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override;
+
+  void UpdateKeyValue(std::string_view key, std::string_view value,
+                      int64_t logical_commit_time,
+                      std::string_view prefix = "") override;
+
+  void UpdateKeyValueSet(std::string_view key,
+                         absl::Span<std::string_view> value_set,
+                         int64_t logical_commit_time,
+                         std::string_view prefix = "") override;
+
+  void DeleteKey(std::string_view key, int64_t logical_commit_time,
+                 std::string_view prefix = "") override;
+
+  void DeleteValuesInSet(std::string_view key,
+                         absl::Span<std::string_view> value_set,
+                         int64_t logical_commit_time,
+                         std::string_view prefix = "") override;
+
+  void UpdateKeyValueUInt32Set(std::string_view key,
+                               absl::Span<const uint32_t> value_set,
+                               int64_t logical_commit_time,
+                               std::string_view prefix = "") override;
+
+  void DeleteValuesInUInt32Set(std::string_view key,
+                               absl::Span<const uint32_t> value_set,
+                               int64_t logical_commit_time,
+                               std::string_view prefix = "") override;
+
+  // Indexes the key-value pair mutations under one lock.
+  void ApplyMutations(absl::Span<const Mutation> mutations,
+                      std::string_view prefix = "") override;
+
+  void RemoveDeletedKeys(int64_t logical_commit_time,
+                         std::string_view prefix = "") override;
+
+  // The index is cleaned up at once when `cache` is done.
+  CleanupProgress RemoveDeletedKeysSlice(int64_t logical_commit_time,
+                                         std::string_view prefix,
+                                         absl::Time deadline) override;
+
+  absl::Status ExportMutations(
+      absl::FunctionRef<void(std::string_view prefix,
+                             absl::Span<const Mutation> mutations)>
+          fn) const override;
+
+  // The keys of the index are counted with the hash tables of prefix "".
+  absl::flat_hash_map<std::string, MemoryUsage> GetMemoryUsage()
+      const override;
+  std::string DebugMemoryReport(int num_largest) const override;
+
+  static std::unique_ptr<Cache> Create(std::unique_ptr<Cache> cache,
+                                       Options options);
+
+ private:
+  struct IndexEntry {
+    int64_t last_logical_commit_time = 0;
+    bool is_deleted = false;
+  };
+
+  PrefixIndexedCache(std::unique_ptr<Cache> cache, Options options);
+
+  bool IsIndexed(std::string_view key) const;
+  void IndexKey(std::string_view key, int64_t logical_commit_time,
+                bool is_deleted, std::string_view prefix)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void CleanUpIndex(int64_t logical_commit_time, std::string_view prefix)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  std::unique_ptr<Cache> cache_;
+  const std::vector<std::string> key_prefixes_;
+
+  mutable absl::Mutex mutex_;
+  absl::btree_map<std::string, IndexEntry, std::less<>> index_
+      ABSL_GUARDED_BY(mutex_);
+  // Bytes of the keys in `index_`.
+  int64_t index_key_bytes_ ABSL_GUARDED_BY(mutex_) = 0;
+  // The key is the prefix and the value is the maximum timestamp that was
+  // passed to RemoveDeletedKeys.
+  absl::flat_hash_map<std::string, int64_t> max_cleanup_logical_commit_time_map_
+      ABSL_GUARDED_BY(mutex_);
+  // Per prefix, the keys deleted at each logical timestamp.
+  absl::flat_hash_map<std::string, absl::btree_multimap<int64_t, std::string>>
+      deleted_keys_map_ ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_CACHE_PREFIX_INDEXED_CACHE_H_
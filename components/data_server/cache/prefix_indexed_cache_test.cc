@@ -0,0 +1,123 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data_server/cache/prefix_indexed_cache.h"
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "components/data_server/cache/key_value_cache.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+using testing::ElementsAre;
+using testing::IsEmpty;
+
+std::unique_ptr<Cache> CreateCache() {
+  return PrefixIndexedCache::Create(KeyValueCache::Create(),
+                                    {.key_prefixes = {"creative:", "ad:"}});
+}
+
+TEST(PrefixIndexedCacheTest, ReturnsKeysUnderPrefixInOrder) {
+  auto cache = CreateCache();
+  cache->UpdateKeyValue("creative:2:large", "v", 1);
+  cache->UpdateKeyValue("creative:1:small", "v", 1);
+  cache->UpdateKeyValue("creative:1:large", "v", 1);
+  cache->UpdateKeyValue("creative:10:small", "v", 1);
+  cache->UpdateKeyValue("ad:1", "v", 1);
+  EXPECT_THAT(*cache->GetKeysByPrefix("creative:1:", 10),
+              ElementsAre("creative:1:large", "creative:1:small"));
+  EXPECT_THAT(*cache->GetKeysByPrefix("creative:", 10),
+              ElementsAre("creative:10:small", "creative:1:large",
+                          "creative:1:small", "creative:2:large"));
+  EXPECT_THAT(*cache->GetKeysByPrefix("creative:3", 10), IsEmpty());
+}
+
+TEST(PrefixIndexedCacheTest, StopsAtLimit) {
+  auto cache = CreateCache();
+  cache->UpdateKeyValue("ad:1", "v", 1);
+  cache->UpdateKeyValue("ad:2", "v", 1);
+  cache->UpdateKeyValue("ad:3", "v", 1);
+  EXPECT_THAT(*cache->GetKeysByPrefix("ad:", 2), ElementsAre("ad:1", "ad:2"));
+  EXPECT_THAT(*cache->GetKeysByPrefix("ad:", 0), IsEmpty());
+}
+
+TEST(PrefixIndexedCacheTest, OtherPrefixesAreNotIndexed) {
+  auto cache = CreateCache();
+  cache->UpdateKeyValue("other:1", "v", 1);
+  EXPECT_EQ(cache->GetKeysByPrefix("other:", 10).status().code(),
+            absl::StatusCode::kUnimplemented);
+  // Shorter than the indexed prefix.
+  EXPECT_EQ(cache->GetKeysByPrefix("creat", 10).status().code(),
+            absl::StatusCode::kUnimplemented);
+}
+
+TEST(PrefixIndexedCacheTest, DeletedKeysAreNotReturned) {
+  auto cache = CreateCache();
+  cache->UpdateKeyValue("ad:1", "v", 1);
+  cache->UpdateKeyValue("ad:2", "v", 1);
+  cache->DeleteKey("ad:1", 2);
+  EXPECT_THAT(*cache->GetKeysByPrefix("ad:", 10), ElementsAre("ad:2"));
+  // Older than the deletion.
+  cache->UpdateKeyValue("ad:1", "v", 1);
+  EXPECT_THAT(*cache->GetKeysByPrefix("ad:", 10), ElementsAre("ad:2"));
+  cache->UpdateKeyValue("ad:1", "v", 3);
+  EXPECT_THAT(*cache->GetKeysByPrefix("ad:", 10), ElementsAre("ad:1", "ad:2"));
+}
+
+TEST(PrefixIndexedCacheTest, CleanupDropsDeletedKeys) {
+  auto cache = CreateCache();
+  cache->UpdateKeyValue("ad:1", "v", 1);
+  cache->DeleteKey("ad:1", 2);
+  // Deleted, and later updated again.
+  cache->UpdateKeyValue("ad:2", "v", 1);
+  cache->DeleteKey("ad:2", 2);
+  cache->UpdateKeyValue("ad:2", "v", 3);
+  const auto bytes_before = cache->GetMemoryUsage()[""].hash_table_bytes;
+  cache->RemoveDeletedKeys(2);
+  EXPECT_LT(cache->GetMemoryUsage()[""].hash_table_bytes, bytes_before);
+  EXPECT_THAT(*cache->GetKeysByPrefix("ad:", 10), ElementsAre("ad:2"));
+  // Not newer than the cleanup.
+  cache->UpdateKeyValue("ad:1", "v", 2);
+  EXPECT_THAT(*cache->GetKeysByPrefix("ad:", 10), ElementsAre("ad:2"));
+}
+
+TEST(PrefixIndexedCacheTest, IndexesAppliedMutations) {
+  auto cache = CreateCache();
+  std::vector<Cache::Mutation> mutations = {
+      {.type = Cache::Mutation::Type::kUpdateKeyValue,
+       .key = "ad:1",
+       .value = "v",
+       .logical_commit_time = 1},
+      {.type = Cache::Mutation::Type::kUpdateKeyValue,
+       .key = "ad:2",
+       .value = "v",
+       .logical_commit_time = 1},
+      {.type = Cache::Mutation::Type::kDeleteKey,
+       .key = "ad:1",
+       .logical_commit_time = 2},
+  };
+  cache->ApplyMutations(mutations);
+  EXPECT_THAT(*cache->GetKeysByPrefix("ad:", 10), ElementsAre("ad:2"));
+}
+
+}  // namespace
+}  // namespace kv_server
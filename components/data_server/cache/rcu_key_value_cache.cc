@@ -0,0 +1,346 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/data_server/cache/rcu_key_value_cache.h"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "absl/hash/hash.h"
+#include "absl/log/log.h"
+#include "absl/memory/memory.h"
+#include "absl/numeric/bits.h"
+#include "absl/synchronization/mutex.h"
+#include "components/data_server/cache/key_value_cache.h"
+
+namespace kv_server {
+namespace {
+
+// Number of retired nodes after which writers try to free them.
+constexpr size_t kReclaimThreshold = 1024;
+
+size_t HashKey(std::string_view key) {
+  return absl::Hash<std::string_view>{}(key);
+}
+
+}  // namespace
+
+RcuKeyValueCache::Table::Table(size_t num_buckets)
+    : mask(num_buckets - 1),
+      buckets(std::make_unique<std::atomic<Node*>[]>(num_buckets)) {}
+
+void RcuKeyValueCache::Table::DeleteWithNodes() {
+  for (size_t i = 0; i <= mask; i++) {
+    Node* node = buckets[i].load(std::memory_order_relaxed);
+    while (node != nullptr) {
+      Node* next = node->next.load(std::memory_order_relaxed);
+      delete node;
+      node = next;
+    }
+  }
+  delete this;
+}
+
+RcuKeyValueCache::RcuKeyValueCache(size_t num_buckets)
+    : epoch_manager_(EpochManager::GetInstance()),
+      table_(new Table(num_buckets)),
+      set_cache_(KeyValueCache::Create()) {}
+
+RcuKeyValueCache::~RcuKeyValueCache() {
+  // No reader can hold a reference to the cache while it is being destroyed.
+  absl::MutexLock lock(&mutex_);
+  table_.load(std::memory_order_relaxed)->DeleteWithNodes();
+  for (auto& [epoch, node] : retired_nodes_) {
+    delete node;
+  }
+  for (auto& [epoch, table] : retired_tables_) {
+    table->DeleteWithNodes();
+  }
+}
+
+absl::flat_hash_map<std::string, std::string>
+RcuKeyValueCache::GetKeyValuePairs(
+    const RequestContext& request_context,
+    const absl::flat_hash_set<std::string_view>& key_set) const {
+  ScopeLatencyMetricsRecorder<InternalLookupMetricsContext,
+                              kGetValuePairsLatencyInMicros>
+      latency_recorder(request_context.GetInternalLookupMetricsContext());
+  absl::flat_hash_map<std::string, std::string> kv_pairs;
+  {
+    EpochManager::ReadLock lock(epoch_manager_);
+    const Table* table = table_.load(std::memory_order_acquire);
+    for (std::string_view key : key_set) {
+      const size_t hash = HashKey(key);
+      const Node* node =
+          table->buckets[hash & table->mask].load(std::memory_order_acquire);
+      while (node != nullptr && (node->hash != hash || node->key != key)) {
+        node = node->next.load(std::memory_order_acquire);
+      }
+      if (node == nullptr || node->value == nullptr) {
+        continue;
+      }
+      VLOG(9) << "Get called for " << key
+              << ". returning value: " << *node->value;
+      kv_pairs.insert_or_assign(key, *node->value);
+    }
+  }
+  if (kv_pairs.empty()) {
+    LogCacheAccessMetrics(request_context, kKeyValueCacheMiss);
+  } else {
+    LogCacheAccessMetrics(request_context, kKeyValueCacheHit);
+  }
+  return kv_pairs;
+}
+
+std::unique_ptr<GetKeyValueSetResult> RcuKeyValueCache::GetKeyValueSet(
+    const RequestContext& request_context,
+    const absl::flat_hash_set<std::string_view>& key_set) const {
+  return set_cache_->GetKeyValueSet(request_context, key_set);
+}
+
+void RcuKeyValueCache::UpdateKeyValue(std::string_view key,
+                                      std::string_view value,
+                                      int64_t logical_commit_time,
+                                      std::string_view prefix) {
+  SampledScopeLatencyMetricsRecorder<kUpdateKeyValueLatency> latency_recorder;
+  VLOG(9) << "Received update for [" << key << "] at " << logical_commit_time
+          << ". value will be set to: " << value;
+  absl::MutexLock lock(&mutex_);
+
+  auto max_cleanup_logical_commit_time =
+      max_cleanup_logical_commit_time_map_[prefix];
+  if (logical_commit_time <= max_cleanup_logical_commit_time) {
+    VLOG(1) << "Skipping the update as its logical_commit_time: "
+            << logical_commit_time
+            << " is not newer than the current cutoff time:"
+            << max_cleanup_logical_commit_time;
+    return;
+  }
+
+  const size_t hash = HashKey(key);
+  NodeLocation location = FindLocked(key, hash);
+  if (location.node != nullptr &&
+      location.node->last_logical_commit_time >= logical_commit_time) {
+    VLOG(1) << "Skipping the update as its logical_commit_time: "
+            << logical_commit_time
+            << " is not newer than the current value's time:"
+            << location.node->last_logical_commit_time;
+    return;
+  }
+
+  if (location.node != nullptr && location.node->value == nullptr) {
+    if (auto prefix_deleted_nodes_iter = deleted_nodes_map_.find(prefix);
+        prefix_deleted_nodes_iter != deleted_nodes_map_.end()) {
+      auto dl_key_iter = prefix_deleted_nodes_iter->second.find(
+          location.node->last_logical_commit_time);
+      if (dl_key_iter != prefix_deleted_nodes_iter->second.end() &&
+          dl_key_iter->second == key) {
+        prefix_deleted_nodes_iter->second.erase(dl_key_iter);
+      }
+    }
+  }
+
+  auto new_node = std::make_unique<Node>();
+  new_node->hash = hash;
+  new_node->key = std::string(key);
+  new_node->value = std::make_unique<std::string>(value);
+  new_node->last_logical_commit_time = logical_commit_time;
+  PublishLocked(location, std::move(new_node));
+}
+
+void RcuKeyValueCache::UpdateKeyValueSet(
+    std::string_view key, absl::Span<std::string_view> input_value_set,
+    int64_t logical_commit_time, std::string_view prefix) {
+  set_cache_->UpdateKeyValueSet(key, input_value_set, logical_commit_time,
+                                prefix);
+}
+
+void RcuKeyValueCache::DeleteKey(std::string_view key,
+                                 int64_t logical_commit_time,
+                                 std::string_view prefix) {
+  SampledScopeLatencyMetricsRecorder<kDeleteKeyLatency> latency_recorder;
+  absl::MutexLock lock(&mutex_);
+  auto max_cleanup_logical_commit_time =
+      max_cleanup_logical_commit_time_map_[prefix];
+  if (logical_commit_time <= max_cleanup_logical_commit_time) {
+    return;
+  }
+  const size_t hash = HashKey(key);
+  NodeLocation location = FindLocked(key, hash);
+  if (location.node != nullptr &&
+      location.node->last_logical_commit_time >= logical_commit_time) {
+    return;
+  }
+  // If key is missing, we still need to add a tombstone to avoid the late
+  // coming update with smaller logical commit time inserting value for the
+  // given key
+  auto new_node = std::make_unique<Node>();
+  new_node->hash = hash;
+  new_node->key = std::string(key);
+  new_node->last_logical_commit_time = logical_commit_time;
+  PublishLocked(location, std::move(new_node));
+  deleted_nodes_map_[prefix].emplace(logical_commit_time, key);
+}
+
+void RcuKeyValueCache::DeleteValuesInSet(std::string_view key,
+                                         absl::Span<std::string_view> value_set,
+                                         int64_t logical_commit_time,
+                                         std::string_view prefix) {
+  set_cache_->DeleteValuesInSet(key, value_set, logical_commit_time, prefix);
+}
+
+void RcuKeyValueCache::RemoveDeletedKeys(int64_t logical_commit_time,
+                                         std::string_view prefix) {
+  ScopeLatencyMetricsRecorder<ServerSafeMetricsContext,
+                              kRemoveDeletedKeyLatency>
+      latency_recorder(KVServerContextMap()->SafeMetric());
+  CleanUpKeyValueMap(logical_commit_time, prefix);
+  set_cache_->RemoveDeletedKeys(logical_commit_time, prefix);
+}
+
+void RcuKeyValueCache::CleanUpKeyValueMap(int64_t logical_commit_time,
+                                          std::string_view prefix) {
+  ScopeLatencyMetricsRecorder<ServerSafeMetricsContext,
+                              kCleanUpKeyValueMapLatency>
+      latency_recorder(KVServerContextMap()->SafeMetric());
+  absl::MutexLock lock(&mutex_);
+  if (max_cleanup_logical_commit_time_map_[prefix] < logical_commit_time) {
+    max_cleanup_logical_commit_time_map_[prefix] = logical_commit_time;
+  }
+  auto deleted_nodes_per_prefix = deleted_nodes_map_.find(prefix);
+  if (deleted_nodes_per_prefix != deleted_nodes_map_.end()) {
+    auto it = deleted_nodes_per_prefix->second.begin();
+    while (it != deleted_nodes_per_prefix->second.end() &&
+           it->first <= logical_commit_time) {
+      NodeLocation location = FindLocked(it->second, HashKey(it->second));
+      if (location.node != nullptr && location.node->value == nullptr &&
+          location.node->last_logical_commit_time <= logical_commit_time) {
+        UnlinkLocked(location);
+      }
+      ++it;
+    }
+    deleted_nodes_per_prefix->second.erase(
+        deleted_nodes_per_prefix->second.begin(), it);
+    if (deleted_nodes_per_prefix->second.empty()) {
+      deleted_nodes_map_.erase(prefix);
+    }
+  }
+  ReclaimLocked();
+}
+
+RcuKeyValueCache::NodeLocation RcuKeyValueCache::FindLocked(
+    std::string_view key, size_t hash) {
+  Table* table = table_.load(std::memory_order_relaxed);
+  std::atomic<Node*>* link = &table->buckets[hash & table->mask];
+  Node* node = link->load(std::memory_order_relaxed);
+  while (node != nullptr && (node->hash != hash || node->key != key)) {
+    link = &node->next;
+    node = link->load(std::memory_order_relaxed);
+  }
+  return {.link = link, .node = node};
+}
+
+void RcuKeyValueCache::PublishLocked(NodeLocation location,
+                                     std::unique_ptr<Node> new_node) {
+  if (location.node == nullptr) {
+    location.link->store(new_node.release(), std::memory_order_release);
+    ++num_nodes_;
+    MaybeGrowLocked();
+    return;
+  }
+  new_node->next.store(location.node->next.load(std::memory_order_relaxed),
+                       std::memory_order_relaxed);
+  location.link->store(new_node.release(), std::memory_order_release);
+  retired_nodes_.emplace_back(epoch_manager_.GetRetireEpoch(), location.node);
+  if (retired_nodes_.size() >= kReclaimThreshold) {
+    ReclaimLocked();
+  }
+}
+
+void RcuKeyValueCache::UnlinkLocked(NodeLocation location) {
+  location.link->store(location.node->next.load(std::memory_order_relaxed),
+                       std::memory_order_release);
+  --num_nodes_;
+  retired_nodes_.emplace_back(epoch_manager_.GetRetireEpoch(), location.node);
+}
+
+void RcuKeyValueCache::MaybeGrowLocked() {
+  Table* old_table = table_.load(std::memory_order_relaxed);
+  const size_t old_num_buckets = old_table->mask + 1;
+  if (num_nodes_ <= old_num_buckets) {
+    return;
+  }
+  // Readers may still walk the old chains, so the nodes are copied rather than
+  // relinked. The old table is freed together with its nodes once it is safe.
+  auto* new_table = new Table(old_num_buckets * 2);
+  for (size_t i = 0; i < old_num_buckets; i++) {
+    for (const Node* node =
+             old_table->buckets[i].load(std::memory_order_relaxed);
+         node != nullptr; node = node->next.load(std::memory_order_relaxed)) {
+      auto* copy = new Node();
+      copy->hash = node->hash;
+      copy->key = node->key;
+      if (node->value != nullptr) {
+        copy->value = std::make_unique<std::string>(*node->value);
+      }
+      copy->last_logical_commit_time = node->last_logical_commit_time;
+      std::atomic<Node*>& bucket =
+          new_table->buckets[node->hash & new_table->mask];
+      copy->next.store(bucket.load(std::memory_order_relaxed),
+                       std::memory_order_relaxed);
+      bucket.store(copy, std::memory_order_relaxed);
+    }
+  }
+  table_.store(new_table, std::memory_order_release);
+  retired_tables_.emplace_back(epoch_manager_.GetRetireEpoch(), old_table);
+  VLOG(1) << "Grew the cache table to " << old_num_buckets * 2 << " buckets";
+  ReclaimLocked();
+}
+
+void RcuKeyValueCache::ReclaimLocked() {
+  if (retired_nodes_.empty() && retired_tables_.empty()) {
+    return;
+  }
+  const uint64_t min_active_epoch =
+      epoch_manager_.AdvanceAndGetMinActiveEpoch();
+  while (!retired_nodes_.empty() &&
+         retired_nodes_.front().first < min_active_epoch) {
+    delete retired_nodes_.front().second;
+    retired_nodes_.pop_front();
+  }
+  while (!retired_tables_.empty() &&
+         retired_tables_.front().first < min_active_epoch) {
+    retired_tables_.front().second->DeleteWithNodes();
+    retired_tables_.pop_front();
+  }
+}
+
+void RcuKeyValueCache::LogCacheAccessMetrics(
+    const RequestContext& request_context,
+    std::string_view cache_access_event) const {
+  LogIfError(
+      request_context.GetInternalLookupMetricsContext()
+          .AccumulateMetric<kCacheAccessEventCount>(1, cache_access_event));
+}
+
+std::unique_ptr<Cache> RcuKeyValueCache::Create(int64_t initial_num_buckets) {
+  const size_t num_buckets = absl::bit_ceil(
+      static_cast<uint64_t>(std::max<int64_t>(initial_num_buckets, 1)));
+  return absl::WrapUnique(new RcuKeyValueCache(num_buckets));
+}
+
+}  // namespace kv_server
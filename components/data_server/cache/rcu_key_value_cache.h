@@ -0,0 +1,168 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_CACHE_RCU_KEY_VALUE_CACHE_H_
+#define COMPONENTS_DATA_SERVER_CACHE_RCU_KEY_VALUE_CACHE_H_
+
+#include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/synchronization/mutex.h"
+#include "components/data_server/cache/cache.h"
+#include "components/data_server/cache/epoch_manager.h"
+#include "components/data_server/cache/get_key_value_set_result.h"
+
+namespace kv_server {
+
+// In-memory datastore with a lock-free read path for key-value pairs.
+//
+// Key-value pairs live in immutable nodes hanging off a fixed size bucket
+// array. Readers enter an epoch and walk the buckets without taking any mutex.
+// Writers are serialized by a mutex, publish replacement nodes with a single
+// atomic store and hand the replaced nodes to epoch based reclamation, so that
+// a node is only freed once no reader can still be looking at it. When the
+// table becomes too full, writers build a bigger copy of it and publish it the
+// same way.
+//
+// Key-value sets are kept in a `KeyValueCache` and keep its locking scheme.
+// One cache object is only for keys in one namespace.
+class RcuKeyValueCache : public Cache {
+ public:
+  ~RcuKeyValueCache() override;
+
+  // Looks up and returns key-value pairs for the given keys.
+  absl::flat_hash_map<std::string, std::string> GetKeyValuePairs(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override;
+
+  // Looks up and returns key-value set result for the given key set.
+  std::unique_ptr<GetKeyValueSetResult> GetKeyValueSet(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override;
+
+  // Inserts or updates the key with the new value for a given prefix
+  void UpdateKeyValue(std::string_view key, std::string_view value,
+                      int64_t logical_commit_time,
+                      std::string_view prefix = "") override;
+
+  // Inserts or updates values in the set for a given key and prefix, if a value
+  // exists, updates its timestamp to the latest logical commit time.
+  void UpdateKeyValueSet(std::string_view key,
+                         absl::Span<std::string_view> input_value_set,
+                         int64_t logical_commit_time,
+                         std::string_view prefix = "") override;
+
+  // Deletes a particular (key, value) pair for a given prefix.
+  void DeleteKey(std::string_view key, int64_t logical_commit_time,
+                 std::string_view prefix = "") override;
+
+  // Deletes values in the set for a given key and prefix.
+  void DeleteValuesInSet(std::string_view key,
+                         absl::Span<std::string_view> value_set,
+                         int64_t logical_commit_time,
+                         std::string_view prefix = "") override;
+
+  // Removes the values that were deleted before the specified
+  // logical_commit_time for a given prefix. Removed nodes are freed once all
+  // readers that could observe them are done.
+  void RemoveDeletedKeys(int64_t logical_commit_time,
+                         std::string_view prefix = "") override;
+
+  // `initial_num_buckets` is rounded up to a power of two.
+  static std::unique_ptr<Cache> Create(int64_t initial_num_buckets = 1 << 16);
+
+ private:
+  struct Node {
+    // Immutable once the node is published.
+    size_t hash;
+    std::string key;
+    // nullptr marks a deleted key that is kept until cleanup, see
+    // `KeyValueCache::CacheValue`.
+    std::unique_ptr<std::string> value;
+    int64_t last_logical_commit_time;
+    // The only field that changes after publishing, always under `mutex_`.
+    std::atomic<Node*> next{nullptr};
+  };
+  struct Table {
+    explicit Table(size_t num_buckets);
+    // Deletes the table and all the nodes that are still linked to it.
+    void DeleteWithNodes();
+
+    size_t mask;
+    std::unique_ptr<std::atomic<Node*>[]> buckets;
+  };
+  // Location of a node in the current table: `link` is the pointer that
+  // points to `node`, or to the end of the bucket chain if `node` is null.
+  struct NodeLocation {
+    std::atomic<Node*>* link;
+    Node* node;
+  };
+
+  explicit RcuKeyValueCache(size_t num_buckets);
+
+  NodeLocation FindLocked(std::string_view key, size_t hash)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Publishes `new_node` in place of `location.node`, or at the end of the
+  // bucket chain if the key is new.
+  void PublishLocked(NodeLocation location, std::unique_ptr<Node> new_node)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void UnlinkLocked(NodeLocation location)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void MaybeGrowLocked() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Frees retired nodes and tables that no reader can reference anymore.
+  void ReclaimLocked() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Removes deleted keys from key-value map for a given prefix
+  void CleanUpKeyValueMap(int64_t logical_commit_time, std::string_view prefix);
+  // Logs cache access metrics for cache hit or miss counts. The cache access
+  // event name is defined in server_definition.h file
+  void LogCacheAccessMetrics(const RequestContext& request_context,
+                             std::string_view cache_access_event) const;
+
+  EpochManager& epoch_manager_;
+  // Serializes writers. Readers never take it.
+  absl::Mutex mutex_;
+  std::atomic<Table*> table_;
+  size_t num_nodes_ ABSL_GUARDED_BY(mutex_) = 0;
+
+  // Nodes and tables that were unlinked, tagged with their retire epoch, in
+  // increasing order of tags.
+  std::deque<std::pair<uint64_t, Node*>> retired_nodes_ ABSL_GUARDED_BY(mutex_);
+  std::deque<std::pair<uint64_t, Table*>> retired_tables_
+      ABSL_GUARDED_BY(mutex_);
+
+  // Same bookkeeping as `KeyValueCache::deleted_nodes_map_`.
+  absl::flat_hash_map<std::string, std::multimap<int64_t, std::string>>
+      deleted_nodes_map_ ABSL_GUARDED_BY(mutex_);
+  // The key is the prefix and the value is the
+  // maximum timestamp that was passed to RemoveDeletedKeys.
+  absl::flat_hash_map<std::string, int64_t> max_cleanup_logical_commit_time_map_
+      ABSL_GUARDED_BY(mutex_);
+
+  // Holds the key-value sets.
+  std::unique_ptr<Cache> set_cache_;
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_CACHE_RCU_KEY_VALUE_CACHE_H_
@@ -0,0 +1,170 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/data_server/cache/rcu_key_value_cache.h"
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/notification.h"
+#include "components/data_server/cache/cache.h"
+#include "components/data_server/cache/mocks.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+using testing::UnorderedElementsAre;
+
+class RcuCacheTest : public ::testing::Test {
+ protected:
+  RcuCacheTest() {
+    InitMetricsContextMap();
+    scope_metrics_context_ = std::make_unique<ScopeMetricsContext>();
+    request_context_ =
+        std::make_unique<RequestContext>(*scope_metrics_context_);
+  }
+  RequestContext& GetRequestContext() { return *request_context_; }
+  std::unique_ptr<ScopeMetricsContext> scope_metrics_context_;
+  std::unique_ptr<RequestContext> request_context_;
+};
+
+TEST_F(RcuCacheTest, RetrievesMatchingEntry) {
+  std::unique_ptr<Cache> cache = RcuKeyValueCache::Create();
+  cache->UpdateKeyValue("my_key", "my_value", 1);
+  cache->UpdateKeyValue("other_key", "other_value", 1);
+  auto kv_pairs =
+      cache->GetKeyValuePairs(GetRequestContext(), {"my_key", "missing_key"});
+  EXPECT_THAT(kv_pairs, UnorderedElementsAre(KVPairEq("my_key", "my_value")));
+}
+
+TEST_F(RcuCacheTest, OlderUpdateIsIgnored) {
+  std::unique_ptr<Cache> cache = RcuKeyValueCache::Create();
+  cache->UpdateKeyValue("my_key", "new_value", 2);
+  cache->UpdateKeyValue("my_key", "old_value", 1);
+  EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(), {"my_key"}),
+              UnorderedElementsAre(KVPairEq("my_key", "new_value")));
+  cache->UpdateKeyValue("my_key", "newest_value", 3);
+  EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(), {"my_key"}),
+              UnorderedElementsAre(KVPairEq("my_key", "newest_value")));
+}
+
+TEST_F(RcuCacheTest, DeleteThenOutOfOrderUpdateIsIgnored) {
+  std::unique_ptr<Cache> cache = RcuKeyValueCache::Create();
+  cache->UpdateKeyValue("my_key", "my_value", 1);
+  cache->DeleteKey("my_key", 3);
+  cache->UpdateKeyValue("my_key", "late_value", 2);
+  EXPECT_TRUE(
+      cache->GetKeyValuePairs(GetRequestContext(), {"my_key"}).empty());
+  cache->UpdateKeyValue("my_key", "new_value", 4);
+  EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(), {"my_key"}),
+              UnorderedElementsAre(KVPairEq("my_key", "new_value")));
+}
+
+TEST_F(RcuCacheTest, RemoveDeletedKeysDropsTombstonesAndAdvancesCutoff) {
+  std::unique_ptr<Cache> cache = RcuKeyValueCache::Create();
+  cache->DeleteKey("deleted_key", 2);
+  cache->UpdateKeyValue("kept_key", "value", 2);
+  cache->RemoveDeletedKeys(5);
+  cache->UpdateKeyValue("deleted_key", "late_value", 4);
+  cache->UpdateKeyValue("kept_key", "late_value", 4);
+  EXPECT_THAT(
+      cache->GetKeyValuePairs(GetRequestContext(), {"deleted_key", "kept_key"}),
+      UnorderedElementsAre(KVPairEq("kept_key", "value")));
+  cache->UpdateKeyValue("deleted_key", "value", 6);
+  EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(), {"deleted_key"}),
+              UnorderedElementsAre(KVPairEq("deleted_key", "value")));
+}
+
+TEST_F(RcuCacheTest, RemoveDeletedKeysPerPrefix) {
+  std::unique_ptr<Cache> cache = RcuKeyValueCache::Create();
+  cache->DeleteKey("key1", 2, "prefix1");
+  cache->RemoveDeletedKeys(5, "prefix1");
+  cache->UpdateKeyValue("key1", "value1", 3, "prefix1");
+  cache->UpdateKeyValue("key2", "value2", 3, "prefix2");
+  EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(), {"key1", "key2"}),
+              UnorderedElementsAre(KVPairEq("key2", "value2")));
+}
+
+TEST_F(RcuCacheTest, TableGrowsPastInitialBuckets) {
+  std::unique_ptr<Cache> cache = RcuKeyValueCache::Create(2);
+  for (int i = 0; i < 1000; i++) {
+    cache->UpdateKeyValue(absl::StrCat("key", i), absl::StrCat("value", i), 1);
+  }
+  cache->DeleteKey("key7", 2);
+  absl::flat_hash_set<std::string_view> keys = {"key0", "key7", "key500",
+                                                "key999"};
+  EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(), keys),
+              UnorderedElementsAre(KVPairEq("key0", "value0"),
+                                   KVPairEq("key500", "value500"),
+                                   KVPairEq("key999", "value999")));
+}
+
+TEST_F(RcuCacheTest, KeyValueSetsAreSupported) {
+  std::unique_ptr<Cache> cache = RcuKeyValueCache::Create();
+  std::vector<std::string_view> values = {"v1", "v2"};
+  std::vector<std::string_view> values_to_delete = {"v2"};
+  cache->UpdateKeyValueSet("key1", absl::MakeSpan(values), 1);
+  cache->DeleteValuesInSet("key1", absl::MakeSpan(values_to_delete), 2);
+  auto result = cache->GetKeyValueSet(GetRequestContext(), {"key1", "key2"});
+  EXPECT_THAT(result->GetValueSet("key1"), UnorderedElementsAre("v1"));
+  EXPECT_TRUE(result->GetValueSet("key2").empty());
+}
+
+TEST_F(RcuCacheTest, ConcurrentReadsDuringUpdatesAndGrowth) {
+  std::unique_ptr<Cache> cache = RcuKeyValueCache::Create(4);
+  absl::Notification start;
+  auto writer = [&cache, &start](int offset) {
+    start.WaitForNotification();
+    for (int i = 0; i < 5000; i++) {
+      cache->UpdateKeyValue(absl::StrCat("key", i % 500),
+                            absl::StrCat("value", i), offset + i * 2);
+      if (i % 100 == 0) {
+        cache->DeleteKey(absl::StrCat("key", (i + 1) % 500), offset + i * 2);
+        cache->RemoveDeletedKeys(0);
+      }
+    }
+  };
+  auto reader = [this, &cache, &start]() {
+    start.WaitForNotification();
+    for (int i = 0; i < 5000; i++) {
+      auto kv_pairs = cache->GetKeyValuePairs(GetRequestContext(),
+                                              {absl::StrCat("key", i % 500)});
+      for (const auto& [key, value] : kv_pairs) {
+        EXPECT_TRUE(absl::StartsWith(value, "value"));
+      }
+    }
+  };
+  std::vector<std::thread> threads;
+  threads.emplace_back(writer, 1);
+  threads.emplace_back(writer, 2);
+  threads.emplace_back(reader);
+  threads.emplace_back(reader);
+  start.Notify();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  auto kv_pairs = cache->GetKeyValuePairs(GetRequestContext(), {"key499"});
+  EXPECT_THAT(kv_pairs, UnorderedElementsAre(KVPairEq("key499", "value4999")));
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -0,0 +1,309 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/data_server/cache/sharded_key_value_cache.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/log/log.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "components/data_server/cache/key_value_cache.h"
+
+namespace kv_server {
+namespace {
+
+// Maps a key to its partition. `std::hash` is used on purpose instead of
+// `absl::Hash`, so that the partition index is not correlated with the slot
+// the key lands in inside the partition's `absl::flat_hash_map`.
+int GetShardIndex(std::string_view key, int num_shards) {
+  return std::hash<std::string_view>{}(key) % num_shards;
+}
+
+// Holds the per partition results of a GetKeyValueSet call. Each partition
+// result keeps the read locks for the keys that it owns until this object goes
+// out of scope.
+class ShardedGetKeyValueSetResult : public GetKeyValueSetResult {
+ public:
+  explicit ShardedGetKeyValueSetResult(int num_shards)
+      : shard_results_(num_shards) {}
+
+  absl::flat_hash_set<std::string_view> GetValueSet(
+      std::string_view key) const override {
+    const auto& shard_result =
+        shard_results_[GetShardIndex(key, shard_results_.size())];
+    if (shard_result == nullptr) {
+      return {};
+    }
+    return shard_result->GetValueSet(key);
+  }
+
+  std::shared_ptr<const absl::flat_hash_set<std::string_view>>
+  GetValueSetSnapshot(std::string_view key) const override {
+    const auto& shard_result =
+        shard_results_[GetShardIndex(key, shard_results_.size())];
+    if (shard_result == nullptr) {
+      return std::make_shared<const absl::flat_hash_set<std::string_view>>();
+    }
+    return shard_result->GetValueSetSnapshot(key);
+  }
+
+  std::optional<uint64_t> GetValueSetVersion(
+      std::string_view key) const override {
+    const auto& shard_result =
+        shard_results_[GetShardIndex(key, shard_results_.size())];
+    if (shard_result == nullptr) {
+      return std::nullopt;
+    }
+    return shard_result->GetValueSetVersion(key);
+  }
+
+  void SetShardResult(int shard_index,
+                      std::unique_ptr<GetKeyValueSetResult> result) {
+    shard_results_[shard_index] = std::move(result);
+  }
+
+ private:
+  // Results are only ever added per partition through `SetShardResult`.
+  void AddKeyValueSet(
+      std::string_view key, absl::flat_hash_set<std::string_view> value_set,
+      std::unique_ptr<absl::ReaderMutexLock> key_lock) override {
+    LOG(ERROR) << "AddKeyValueSet is not supported on sharded results";
+  }
+  void AddKeyValueSetSnapshot(
+      std::string_view key,
+      std::shared_ptr<const absl::flat_hash_set<std::string_view>> value_set)
+      override {
+    LOG(ERROR) << "AddKeyValueSetSnapshot is not supported on sharded results";
+  }
+
+  std::vector<std::unique_ptr<GetKeyValueSetResult>> shard_results_;
+};
+
+}  // namespace
+
+ShardedKeyValueCache::ShardedKeyValueCache(
+    int num_shards,
+    absl::AnyInvocable<std::unique_ptr<Cache>()>& shard_factory) {
+  shards_.reserve(num_shards);
+  for (int i = 0; i < num_shards; i++) {
+    shards_.push_back(shard_factory());
+  }
+}
+
+int ShardedKeyValueCache::ShardIndex(std::string_view key) const {
+  return GetShardIndex(key, shards_.size());
+}
+
+absl::flat_hash_map<std::string, std::string>
+ShardedKeyValueCache::GetKeyValuePairs(
+    const RequestContext& request_context,
+    const absl::flat_hash_set<std::string_view>& key_set) const {
+  std::vector<absl::flat_hash_set<std::string_view>> keys_by_shard(
+      shards_.size());
+  for (std::string_view key : key_set) {
+    keys_by_shard[ShardIndex(key)].insert(key);
+  }
+  absl::flat_hash_map<std::string, std::string> kv_pairs;
+  for (int i = 0; i < shards_.size(); i++) {
+    if (keys_by_shard[i].empty()) {
+      continue;
+    }
+    auto shard_kv_pairs =
+        shards_[i]->GetKeyValuePairs(request_context, keys_by_shard[i]);
+    kv_pairs.merge(shard_kv_pairs);
+  }
+  return kv_pairs;
+}
+
+GetKeyValuePairsResult ShardedKeyValueCache::GetKeyValuePairViews(
+    const RequestContext& request_context,
+    const absl::flat_hash_set<std::string_view>& key_set) const {
+  std::vector<absl::flat_hash_set<std::string_view>> keys_by_shard(
+      shards_.size());
+  for (std::string_view key : key_set) {
+    keys_by_shard[ShardIndex(key)].insert(key);
+  }
+  GetKeyValuePairsResult result;
+  for (int i = 0; i < shards_.size(); i++) {
+    if (keys_by_shard[i].empty()) {
+      continue;
+    }
+    // The shard sets hold the views of `key_set`, so the keys of the shard
+    // results stay valid after the sets are gone.
+    result.Merge(
+        shards_[i]->GetKeyValuePairViews(request_context, keys_by_shard[i]));
+  }
+  return result;
+}
+
+GetKeyValuePairsResult ShardedKeyValueCache::GetHashedKeyValuePairViews(
+    const RequestContext& request_context,
+    absl::Span<const HashedKey> keys) const {
+  std::vector<std::vector<HashedKey>> keys_by_shard(shards_.size());
+  for (const HashedKey& key : keys) {
+    keys_by_shard[ShardIndex(key.key)].push_back(key);
+  }
+  GetKeyValuePairsResult result;
+  for (int i = 0; i < shards_.size(); i++) {
+    if (keys_by_shard[i].empty()) {
+      continue;
+    }
+    result.Merge(shards_[i]->GetHashedKeyValuePairViews(request_context,
+                                                        keys_by_shard[i]));
+  }
+  return result;
+}
+
+std::unique_ptr<GetKeyValueSetResult> ShardedKeyValueCache::GetKeyValueSet(
+    const RequestContext& request_context,
+    const absl::flat_hash_set<std::string_view>& key_set) const {
+  std::vector<absl::flat_hash_set<std::string_view>> keys_by_shard(
+      shards_.size());
+  for (std::string_view key : key_set) {
+    keys_by_shard[ShardIndex(key)].insert(key);
+  }
+  auto result = std::make_unique<ShardedGetKeyValueSetResult>(shards_.size());
+  for (int i = 0; i < shards_.size(); i++) {
+    if (keys_by_shard[i].empty()) {
+      continue;
+    }
+    result->SetShardResult(
+        i, shards_[i]->GetKeyValueSet(request_context, keys_by_shard[i]));
+  }
+  return result;
+}
+
+void ShardedKeyValueCache::UpdateKeyValue(std::string_view key,
+                                          std::string_view value,
+                                          int64_t logical_commit_time,
+                                          std::string_view prefix) {
+  shards_[ShardIndex(key)]->UpdateKeyValue(key, value, logical_commit_time,
+                                           prefix);
+}
+
+void ShardedKeyValueCache::UpdateKeyValueSet(
+    std::string_view key, absl::Span<std::string_view> input_value_set,
+    int64_t logical_commit_time, std::string_view prefix) {
+  shards_[ShardIndex(key)]->UpdateKeyValueSet(key, input_value_set,
+                                              logical_commit_time, prefix);
+}
+
+void ShardedKeyValueCache::DeleteKey(std::string_view key,
+                                     int64_t logical_commit_time,
+                                     std::string_view prefix) {
+  shards_[ShardIndex(key)]->DeleteKey(key, logical_commit_time, prefix);
+}
+
+void ShardedKeyValueCache::DeleteValuesInSet(
+    std::string_view key, absl::Span<std::string_view> value_set,
+    int64_t logical_commit_time, std::string_view prefix) {
+  shards_[ShardIndex(key)]->DeleteValuesInSet(key, value_set,
+                                              logical_commit_time, prefix);
+}
+
+void ShardedKeyValueCache::ApplyMutations(
+    absl::Span<const Mutation> mutations, std::string_view prefix) {
+  std::vector<std::vector<Mutation>> mutations_by_shard(shards_.size());
+  for (const Mutation& mutation : mutations) {
+    mutations_by_shard[ShardIndex(mutation.key)].push_back(mutation);
+  }
+  for (int i = 0; i < shards_.size(); i++) {
+    if (!mutations_by_shard[i].empty()) {
+      shards_[i]->ApplyMutations(mutations_by_shard[i], prefix);
+    }
+  }
+}
+
+void ShardedKeyValueCache::RemoveDeletedKeys(int64_t logical_commit_time,
+                                             std::string_view prefix) {
+  // Every partition has to move its cutoff time forward, even the ones without
+  // deleted nodes, so that late arriving updates are dropped consistently.
+  for (auto& shard : shards_) {
+    shard->RemoveDeletedKeys(logical_commit_time, prefix);
+  }
+}
+
+Cache::CleanupProgress ShardedKeyValueCache::RemoveDeletedKeysSlice(
+    int64_t logical_commit_time, std::string_view prefix,
+    absl::Time deadline) {
+  // Partitions after the deadline still make a bit of progress, and move their
+  // cutoff time forward.
+  CleanupProgress progress;
+  for (auto& shard : shards_) {
+    const CleanupProgress shard_progress =
+        shard->RemoveDeletedKeysSlice(logical_commit_time, prefix, deadline);
+    progress.done = progress.done && shard_progress.done;
+    progress.remaining_deleted_values +=
+        shard_progress.remaining_deleted_values;
+  }
+  return progress;
+}
+
+absl::Status ShardedKeyValueCache::ExportMutations(
+    absl::FunctionRef<void(std::string_view prefix,
+                           absl::Span<const Mutation> mutations)>
+        fn) const {
+  for (const auto& shard : shards_) {
+    if (const auto status = shard->ExportMutations(fn); !status.ok()) {
+      return status;
+    }
+  }
+  return absl::OkStatus();
+}
+
+absl::flat_hash_map<std::string, Cache::MemoryUsage>
+ShardedKeyValueCache::GetMemoryUsage() const {
+  absl::flat_hash_map<std::string, MemoryUsage> memory_usage;
+  for (const auto& shard : shards_) {
+    for (const auto& [prefix, shard_usage] : shard->GetMemoryUsage()) {
+      memory_usage[prefix] += shard_usage;
+    }
+  }
+  return memory_usage;
+}
+
+std::string ShardedKeyValueCache::DebugMemoryReport(int num_largest) const {
+  std::string report;
+  for (size_t i = 0; i < shards_.size(); ++i) {
+    absl::StrAppend(&report, "Partition ", i, ":\n",
+                    shards_[i]->DebugMemoryReport(num_largest));
+  }
+  return report;
+}
+
+std::unique_ptr<Cache> ShardedKeyValueCache::Create(int num_shards) {
+  return Create(num_shards, [] { return KeyValueCache::Create(); });
+}
+
+std::unique_ptr<Cache> ShardedKeyValueCache::Create(
+    int num_shards,
+    absl::AnyInvocable<std::unique_ptr<Cache>()> shard_factory) {
+  if (num_shards <= 0) {
+    num_shards = std::max(1u, std::thread::hardware_concurrency());
+  }
+  LOG(INFO) << "Creating sharded key value cache with " << num_shards
+            << " shards";
+  return absl::WrapUnique(new ShardedKeyValueCache(num_shards, shard_factory));
+}
+
+}  // namespace kv_server
@@ -0,0 +1,131 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_CACHE_SHARDED_KEY_VALUE_CACHE_H_
+#define COMPONENTS_DATA_SERVER_CACHE_SHARDED_KEY_VALUE_CACHE_H_
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/functional/any_invocable.h"
+#include "components/data_server/cache/cache.h"
+#include "components/data_server/cache/get_key_value_set_result.h"
+
+namespace kv_server {
+
+// In-memory datastore that splits the key space into `num_shards` hash
+// partitioned caches, `KeyValueCache`s by default. Each partition has its own
+// locks and its own deleted nodes bookkeeping, so writes to one partition do
+// not block reads from the others.
+// One cache object is only for keys in one namespace.
+class ShardedKeyValueCache : public Cache {
+ public:
+  // Looks up and returns key-value pairs for the given keys.
+  absl::flat_hash_map<std::string, std::string> GetKeyValuePairs(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override;
+
+  // Looks up the given keys and returns views of their values.
+  GetKeyValuePairsResult GetKeyValuePairViews(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override;
+
+  // Buckets the keys by shard without hashing them again for the shards.
+  GetKeyValuePairsResult GetHashedKeyValuePairViews(
+      const RequestContext& request_context,
+      absl::Span<const HashedKey> keys) const override;
+
+  // Looks up and returns key-value set result for the given key set.
+  std::unique_ptr<GetKeyValueSetResult> GetKeyValueSet(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override;
+
+  // Inserts or updates the key with the new value for a given prefix
+  void UpdateKeyValue(std::string_view key, std::string_view value,
+                      int64_t logical_commit_time,
+                      std::string_view prefix = "") override;
+
+  // Inserts or updates values in the set for a given key and prefix, if a value
+  // exists, updates its timestamp to the latest logical commit time.
+  void UpdateKeyValueSet(std::string_view key,
+                         absl::Span<std::string_view> input_value_set,
+                         int64_t logical_commit_time,
+                         std::string_view prefix = "") override;
+
+  // Deletes a particular (key, value) pair for a given prefix.
+  void DeleteKey(std::string_view key, int64_t logical_commit_time,
+                 std::string_view prefix = "") override;
+
+  // Deletes values in the set for a given key and prefix.
+  void DeleteValuesInSet(std::string_view key,
+                         absl::Span<std::string_view> value_set,
+                         int64_t logical_commit_time,
+                         std::string_view prefix = "") override;
+
+  // Applies the mutations of every partition as one batch.
+  void ApplyMutations(absl::Span<const Mutation> mutations,
+                      std::string_view prefix = "") override;
+
+  // Removes the values that were deleted before the specified
+  // logical_commit_time for a given prefix from every shard.
+  void RemoveDeletedKeys(int64_t logical_commit_time,
+                         std::string_view prefix = "") override;
+
+  // Cleans up every partition until `deadline`.
+  CleanupProgress RemoveDeletedKeysSlice(int64_t logical_commit_time,
+                                         std::string_view prefix,
+                                         absl::Time deadline) override;
+
+  // Exports every partition in turn.
+  absl::Status ExportMutations(
+      absl::FunctionRef<void(std::string_view prefix,
+                             absl::Span<const Mutation> mutations)>
+          fn) const override;
+
+  // Sums the memory usage of the partitions.
+  absl::flat_hash_map<std::string, MemoryUsage> GetMemoryUsage()
+      const override;
+
+  // Concatenates the reports of the partitions.
+  std::string DebugMemoryReport(int num_largest) const override;
+
+  // Creates a cache with `num_shards` partitions. If `num_shards` is not
+  // positive, one partition per hardware thread is used.
+  static std::unique_ptr<Cache> Create(int num_shards = 0);
+
+  // Same as above, but every partition is created by `shard_factory`.
+  static std::unique_ptr<Cache> Create(
+      int num_shards,
+      absl::AnyInvocable<std::unique_ptr<Cache>()> shard_factory);
+
+ private:
+  ShardedKeyValueCache(
+      int num_shards,
+      absl::AnyInvocable<std::unique_ptr<Cache>()>& shard_factory);
+
+  // Returns the index of the partition that owns `key`.
+  int ShardIndex(std::string_view key) const;
+
+  std::vector<std::unique_ptr<Cache>> shards_;
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_CACHE_SHARDED_KEY_VALUE_CACHE_H_
@@ -0,0 +1,225 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/data_server/cache/sharded_key_value_cache.h"
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/notification.h"
+#include "components/data_server/cache/cache.h"
+#include "components/data_server/cache/mocks.h"
+#include "components/data_server/cache/rcu_key_value_cache.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+using testing::UnorderedElementsAre;
+
+class ShardedCacheTest : public ::testing::Test {
+ protected:
+  ShardedCacheTest() {
+    InitMetricsContextMap();
+    scope_metrics_context_ = std::make_unique<ScopeMetricsContext>();
+    request_context_ =
+        std::make_unique<RequestContext>(*scope_metrics_context_);
+  }
+  RequestContext& GetRequestContext() { return *request_context_; }
+  std::unique_ptr<ScopeMetricsContext> scope_metrics_context_;
+  std::unique_ptr<RequestContext> request_context_;
+};
+
+TEST_F(ShardedCacheTest, GetWithMultipleKeysReturnsMatchingValues) {
+  std::unique_ptr<Cache> cache = ShardedKeyValueCache::Create(4);
+  for (int i = 0; i < 100; i++) {
+    cache->UpdateKeyValue(absl::StrCat("key", i), absl::StrCat("value", i), 1);
+  }
+  absl::flat_hash_set<std::string_view> keys = {"key1", "key42", "key99",
+                                                "missing_key"};
+  auto kv_pairs = cache->GetKeyValuePairs(GetRequestContext(), keys);
+  EXPECT_THAT(kv_pairs, UnorderedElementsAre(KVPairEq("key1", "value1"),
+                                             KVPairEq("key42", "value42"),
+                                             KVPairEq("key99", "value99")));
+}
+
+TEST_F(ShardedCacheTest, KeyValuePairViewsAcrossShards) {
+  std::unique_ptr<Cache> cache = ShardedKeyValueCache::Create(4);
+  for (int i = 0; i < 100; i++) {
+    cache->UpdateKeyValue(absl::StrCat("key", i), absl::StrCat("value", i), 1);
+  }
+  absl::flat_hash_set<std::string_view> keys = {"key1", "key42", "key99",
+                                                "missing_key"};
+  const auto result = cache->GetKeyValuePairViews(GetRequestContext(), keys);
+  EXPECT_EQ(result.size(), 3);
+  EXPECT_EQ(result.GetValue("key1"), "value1");
+  EXPECT_EQ(result.GetValue("key42"), "value42");
+  EXPECT_EQ(result.GetValue("key99"), "value99");
+  EXPECT_FALSE(result.GetValue("missing_key").has_value());
+}
+
+TEST_F(ShardedCacheTest, ApplyMutationsAcrossShards) {
+  std::unique_ptr<Cache> cache = ShardedKeyValueCache::Create(4);
+  std::vector<std::string> keys;
+  std::vector<std::string> values;
+  std::vector<Cache::Mutation> mutations;
+  for (int i = 0; i < 100; i++) {
+    keys.push_back(absl::StrCat("key", i));
+    values.push_back(absl::StrCat("value", i));
+  }
+  for (int i = 0; i < 100; i++) {
+    mutations.push_back({.type = Cache::Mutation::Type::kUpdateKeyValue,
+                         .key = keys[i],
+                         .value = values[i],
+                         .logical_commit_time = 1});
+  }
+  mutations.push_back({.type = Cache::Mutation::Type::kDeleteKey,
+                       .key = keys[42],
+                       .logical_commit_time = 2});
+  cache->ApplyMutations(mutations);
+  auto kv_pairs =
+      cache->GetKeyValuePairs(GetRequestContext(), {"key1", "key42", "key99"});
+  EXPECT_THAT(kv_pairs, UnorderedElementsAre(KVPairEq("key1", "value1"),
+                                             KVPairEq("key99", "value99")));
+}
+
+TEST_F(ShardedCacheTest, DefaultShardCountRetrievesMatchingEntry) {
+  std::unique_ptr<Cache> cache = ShardedKeyValueCache::Create();
+  cache->UpdateKeyValue("my_key", "my_value", 1);
+  auto kv_pairs = cache->GetKeyValuePairs(GetRequestContext(), {"my_key"});
+  EXPECT_THAT(kv_pairs, UnorderedElementsAre(KVPairEq("my_key", "my_value")));
+}
+
+TEST_F(ShardedCacheTest, ShardFactoryIsUsedForEveryShard) {
+  int num_created_shards = 0;
+  std::unique_ptr<Cache> cache =
+      ShardedKeyValueCache::Create(4, [&num_created_shards] {
+        num_created_shards++;
+        return RcuKeyValueCache::Create();
+      });
+  EXPECT_EQ(num_created_shards, 4);
+  cache->UpdateKeyValue("my_key", "my_value", 1);
+  EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(), {"my_key"}),
+              UnorderedElementsAre(KVPairEq("my_key", "my_value")));
+}
+
+TEST_F(ShardedCacheTest, DeleteThenOutOfOrderUpdateIsIgnored) {
+  std::unique_ptr<Cache> cache = ShardedKeyValueCache::Create(4);
+  cache->UpdateKeyValue("my_key", "my_value", 1);
+  cache->DeleteKey("my_key", 3);
+  cache->UpdateKeyValue("my_key", "late_value", 2);
+  EXPECT_TRUE(
+      cache->GetKeyValuePairs(GetRequestContext(), {"my_key"}).empty());
+  cache->UpdateKeyValue("my_key", "new_value", 4);
+  EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(), {"my_key"}),
+              UnorderedElementsAre(KVPairEq("my_key", "new_value")));
+}
+
+TEST_F(ShardedCacheTest, RemoveDeletedKeysAdvancesCutoffForAllShards) {
+  std::unique_ptr<Cache> cache = ShardedKeyValueCache::Create(8);
+  cache->DeleteKey("deleted_key", 2);
+  cache->RemoveDeletedKeys(5);
+  // Updates that are not newer than the cleanup cutoff are dropped regardless
+  // of which shard owns the key.
+  for (int i = 0; i < 50; i++) {
+    cache->UpdateKeyValue(absl::StrCat("key", i), "value", 5);
+  }
+  std::vector<std::string> keys;
+  for (int i = 0; i < 50; i++) {
+    keys.push_back(absl::StrCat("key", i));
+  }
+  absl::flat_hash_set<std::string_view> key_set(keys.begin(), keys.end());
+  EXPECT_TRUE(cache->GetKeyValuePairs(GetRequestContext(), key_set).empty());
+  cache->UpdateKeyValue("deleted_key", "value", 6);
+  EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(), {"deleted_key"}),
+              UnorderedElementsAre(KVPairEq("deleted_key", "value")));
+}
+
+TEST_F(ShardedCacheTest, RemoveDeletedKeysPerPrefix) {
+  std::unique_ptr<Cache> cache = ShardedKeyValueCache::Create(4);
+  cache->DeleteKey("key1", 2, "prefix1");
+  cache->RemoveDeletedKeys(5, "prefix1");
+  cache->UpdateKeyValue("key1", "value1", 3, "prefix1");
+  cache->UpdateKeyValue("key2", "value2", 3, "prefix2");
+  EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(), {"key1", "key2"}),
+              UnorderedElementsAre(KVPairEq("key2", "value2")));
+}
+
+TEST_F(ShardedCacheTest, GetKeyValueSetAcrossShards) {
+  std::unique_ptr<Cache> cache = ShardedKeyValueCache::Create(4);
+  std::vector<std::string_view> values1 = {"v1", "v2"};
+  std::vector<std::string_view> values2 = {"v3"};
+  std::vector<std::string_view> values_to_delete = {"v2"};
+  cache->UpdateKeyValueSet("key1", absl::MakeSpan(values1), 1);
+  cache->UpdateKeyValueSet("key2", absl::MakeSpan(values2), 1);
+  cache->DeleteValuesInSet("key1", absl::MakeSpan(values_to_delete), 2);
+  auto result =
+      cache->GetKeyValueSet(GetRequestContext(), {"key1", "key2", "key3"});
+  EXPECT_THAT(result->GetValueSet("key1"), UnorderedElementsAre("v1"));
+  EXPECT_THAT(result->GetValueSet("key2"), UnorderedElementsAre("v3"));
+  EXPECT_TRUE(result->GetValueSet("key3").empty());
+  EXPECT_TRUE(result->GetValueSet("not_queried_key").empty());
+}
+
+TEST_F(ShardedCacheTest, DeletedSetValuesAreCleanedUp) {
+  std::unique_ptr<Cache> cache = ShardedKeyValueCache::Create(4);
+  std::vector<std::string_view> values = {"v1", "v2"};
+  cache->UpdateKeyValueSet("key1", absl::MakeSpan(values), 1);
+  cache->DeleteValuesInSet("key1", absl::MakeSpan(values), 2);
+  cache->RemoveDeletedKeys(3);
+  // The late update is older than the cleanup cutoff.
+  cache->UpdateKeyValueSet("key1", absl::MakeSpan(values), 3);
+  EXPECT_TRUE(cache->GetKeyValueSet(GetRequestContext(), {"key1"})
+                  ->GetValueSet("key1")
+                  .empty());
+}
+
+TEST_F(ShardedCacheTest, ConcurrentReadsAndWrites) {
+  std::unique_ptr<Cache> cache = ShardedKeyValueCache::Create(4);
+  absl::Notification start;
+  auto writer = [&cache, &start](int offset) {
+    start.WaitForNotification();
+    for (int i = 0; i < 1000; i++) {
+      cache->UpdateKeyValue(absl::StrCat("key", i % 100),
+                            absl::StrCat("value", i), offset + i * 2);
+    }
+  };
+  auto reader = [this, &cache, &start]() {
+    start.WaitForNotification();
+    for (int i = 0; i < 1000; i++) {
+      cache->GetKeyValuePairs(GetRequestContext(),
+                              {absl::StrCat("key", i % 100)});
+    }
+  };
+  std::vector<std::thread> threads;
+  threads.emplace_back(writer, 1);
+  threads.emplace_back(writer, 2);
+  threads.emplace_back(reader);
+  threads.emplace_back(reader);
+  start.Notify();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  auto kv_pairs = cache->GetKeyValuePairs(GetRequestContext(), {"key99"});
+  EXPECT_THAT(kv_pairs, UnorderedElementsAre(KVPairEq("key99", "value999")));
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -0,0 +1,136 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/data_server/cache/slab_arena.h"
+
+#include <cstring>
+#include <limits>
+#include <string_view>
+#include <vector>
+
+#include "absl/log/check.h"
+
+namespace kv_server {
+
+SlabArena::SlabArena(uint32_t slab_size, HugePageMode huge_pages)
+    : huge_pages_(huge_pages),
+      slab_size_(huge_pages == HugePageMode::kNone
+                     ? slab_size
+                     : static_cast<uint32_t>(
+                           (uint64_t{slab_size} + kHugePageSize - 1) /
+                           kHugePageSize * kHugePageSize)) {
+  CHECK_GT(slab_size_, 0u);
+}
+
+SlabArena::Handle SlabArena::Allocate(std::string_view data) {
+  if (data.empty()) {
+    return Handle{};
+  }
+  CHECK_LE(data.size(), std::numeric_limits<uint32_t>::max());
+  const auto length = static_cast<uint32_t>(data.size());
+  uint32_t index;
+  if (length > slab_size_) {
+    index = NewSlab(length, HugePageMode::kNone);
+  } else {
+    if (current_slab_ == kNoSlab ||
+        slabs_[current_slab_].capacity - slabs_[current_slab_].used_bytes <
+            length) {
+      const uint32_t previous_slab = current_slab_;
+      current_slab_ = NewSlab(slab_size_, huge_pages_);
+      // The previous slab may have been waiting only for new allocations to
+      // move elsewhere.
+      if (previous_slab != kNoSlab &&
+          slabs_[previous_slab].dead_bytes ==
+              slabs_[previous_slab].used_bytes) {
+        ReleaseSlab(previous_slab);
+      }
+    }
+    index = current_slab_;
+  }
+  Slab& slab = slabs_[index];
+  const Handle handle{
+      .slab = index, .offset = slab.used_bytes, .length = length};
+  std::memcpy(slab.data.data() + slab.used_bytes, data.data(), length);
+  slab.used_bytes += length;
+  used_bytes_ += length;
+  return handle;
+}
+
+std::string_view SlabArena::Get(Handle handle) const {
+  if (handle.slab == kNoSlab) {
+    return {};
+  }
+  return std::string_view(slabs_[handle.slab].data.data() + handle.offset,
+                          handle.length);
+}
+
+void SlabArena::Free(Handle handle) {
+  if (handle.slab == kNoSlab) {
+    return;
+  }
+  Slab& slab = slabs_[handle.slab];
+  slab.dead_bytes += handle.length;
+  dead_bytes_ += handle.length;
+  if (slab.dead_bytes < slab.used_bytes) {
+    return;
+  }
+  if (handle.slab == current_slab_) {
+    // Nothing references the current slab anymore, start over at its
+    // beginning instead of releasing it.
+    used_bytes_ -= slab.used_bytes;
+    dead_bytes_ -= slab.dead_bytes;
+    slab.used_bytes = 0;
+    slab.dead_bytes = 0;
+    return;
+  }
+  ReleaseSlab(handle.slab);
+}
+
+std::vector<SlabArena::SlabStats> SlabArena::GetSlabStats() const {
+  std::vector<SlabStats> stats;
+  stats.reserve(slabs_.size() - free_slab_indices_.size());
+  for (const Slab& slab : slabs_) {
+    if (slab.data.data() != nullptr) {
+      stats.push_back(
+          {.used_bytes = slab.used_bytes, .dead_bytes = slab.dead_bytes});
+    }
+  }
+  return stats;
+}
+
+uint32_t SlabArena::NewSlab(uint32_t capacity, HugePageMode huge_pages) {
+  uint32_t index;
+  if (free_slab_indices_.empty()) {
+    index = slabs_.size();
+    slabs_.emplace_back();
+  } else {
+    index = free_slab_indices_.back();
+    free_slab_indices_.pop_back();
+  }
+  Slab& slab = slabs_[index];
+  // Uninitialized on purpose, every byte is written before it is read.
+  slab.data = HugePageBuffer::Allocate(capacity, huge_pages);
+  slab.capacity = capacity;
+  return index;
+}
+
+void SlabArena::ReleaseSlab(uint32_t index) {
+  Slab& slab = slabs_[index];
+  used_bytes_ -= slab.used_bytes;
+  dead_bytes_ -= slab.dead_bytes;
+  slab = Slab{};
+  free_slab_indices_.push_back(index);
+}
+
+}  // namespace kv_server
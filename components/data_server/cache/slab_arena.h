@@ -0,0 +1,109 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_CACHE_SLAB_ARENA_H_
+#define COMPONENTS_DATA_SERVER_CACHE_SLAB_ARENA_H_
+
+#include <cstdint>
+#include <limits>
+#include <string_view>
+#include <vector>
+
+#include "components/data_server/cache/huge_pages.h"
+
+namespace kv_server {
+
+// Bump allocator for byte strings that carves them out of large slabs.
+//
+// Every string is copied into the current slab and addressed by a compact
+// `Handle`. Freeing a string only accounts its bytes as dead; once all the
+// bytes of a slab are dead, the whole slab is released at once.
+//
+// Slabs may be backed by huge pages, see `HugePageMode`.
+//
+// Not thread safe, callers are expected to hold their own lock.
+class SlabArena {
+ public:
+  static constexpr uint32_t kDefaultSlabSize = 1 << 20;
+
+  struct Handle {
+    uint32_t slab = kNoSlab;
+    uint32_t offset = 0;
+    uint32_t length = 0;
+  };
+
+  struct SlabStats {
+    // Bytes handed out from the slab since it was last reset.
+    uint32_t used_bytes;
+    // Bytes of `used_bytes` that were freed.
+    uint32_t dead_bytes;
+  };
+
+  // Strings longer than `slab_size` get a dedicated slab. With huge pages,
+  // `slab_size` is rounded up to a multiple of `kHugePageSize`, and dedicated
+  // slabs keep regular pages so that rounding them up wastes nothing.
+  explicit SlabArena(uint32_t slab_size = kDefaultSlabSize,
+                     HugePageMode huge_pages = HugePageMode::kNone);
+
+  SlabArena(const SlabArena&) = delete;
+  SlabArena& operator=(const SlabArena&) = delete;
+
+  // Copies `data` into the arena.
+  Handle Allocate(std::string_view data);
+
+  // Returns the bytes referenced by `handle`. Stays valid until the handle is
+  // freed.
+  std::string_view Get(Handle handle) const;
+
+  // Marks the bytes referenced by `handle` as dead and releases the slab if
+  // nothing in it is alive anymore.
+  void Free(Handle handle);
+
+  // Returns the stats of the slabs that currently hold memory.
+  std::vector<SlabStats> GetSlabStats() const;
+
+  // Total bytes handed out and total dead bytes across all slabs.
+  uint64_t used_bytes() const { return used_bytes_; }
+  uint64_t dead_bytes() const { return dead_bytes_; }
+
+ private:
+  static constexpr uint32_t kNoSlab = std::numeric_limits<uint32_t>::max();
+
+  struct Slab {
+    HugePageBuffer data;
+    uint32_t capacity = 0;
+    uint32_t used_bytes = 0;
+    uint32_t dead_bytes = 0;
+  };
+
+  // Returns the index of a slab with at least `capacity` bytes, reusing
+  // released slab slots.
+  uint32_t NewSlab(uint32_t capacity, HugePageMode huge_pages);
+  void ReleaseSlab(uint32_t index);
+
+  const HugePageMode huge_pages_;
+  const uint32_t slab_size_;
+  std::vector<Slab> slabs_;
+  // Indices of released entries in `slabs_`.
+  std::vector<uint32_t> free_slab_indices_;
+  uint32_t current_slab_ = kNoSlab;
+  uint64_t used_bytes_ = 0;
+  uint64_t dead_bytes_ = 0;
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_CACHE_SLAB_ARENA_H_
@@ -0,0 +1,122 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/data_server/cache/slab_arena.h"
+
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+using testing::SizeIs;
+
+TEST(SlabArenaTest, AllocatedBytesAreReturned) {
+  SlabArena arena(/*slab_size=*/16);
+  const auto handle1 = arena.Allocate("hello");
+  const auto handle2 = arena.Allocate("world");
+  const auto empty = arena.Allocate("");
+  EXPECT_EQ(arena.Get(handle1), "hello");
+  EXPECT_EQ(arena.Get(handle2), "world");
+  EXPECT_EQ(arena.Get(empty), "");
+  EXPECT_EQ(arena.used_bytes(), 10);
+  EXPECT_THAT(arena.GetSlabStats(), SizeIs(1));
+}
+
+TEST(SlabArenaTest, FullSlabStartsANewOne) {
+  SlabArena arena(/*slab_size=*/8);
+  const auto handle1 = arena.Allocate("12345");
+  const auto handle2 = arena.Allocate("67890");
+  EXPECT_NE(handle1.slab, handle2.slab);
+  EXPECT_EQ(arena.Get(handle1), "12345");
+  EXPECT_EQ(arena.Get(handle2), "67890");
+  EXPECT_THAT(arena.GetSlabStats(), SizeIs(2));
+}
+
+TEST(SlabArenaTest, LargeStringGetsDedicatedSlab) {
+  SlabArena arena(/*slab_size=*/8);
+  const std::string large(100, 'x');
+  const auto small = arena.Allocate("abc");
+  const auto handle = arena.Allocate(large);
+  EXPECT_EQ(arena.Get(handle), large);
+  // The current slab keeps being used for small strings.
+  EXPECT_EQ(arena.Allocate("def").slab, small.slab);
+  arena.Free(handle);
+  EXPECT_THAT(arena.GetSlabStats(), SizeIs(1));
+}
+
+TEST(SlabArenaTest, SlabIsReleasedOnceAllBytesAreDead) {
+  SlabArena arena(/*slab_size=*/8);
+  const auto handle1 = arena.Allocate("1234");
+  const auto handle2 = arena.Allocate("5678");
+  const auto handle3 = arena.Allocate("9");
+  EXPECT_THAT(arena.GetSlabStats(), SizeIs(2));
+  arena.Free(handle1);
+  auto stats = arena.GetSlabStats();
+  ASSERT_THAT(stats, SizeIs(2));
+  EXPECT_EQ(stats[0].used_bytes, 8);
+  EXPECT_EQ(stats[0].dead_bytes, 4);
+  arena.Free(handle2);
+  EXPECT_THAT(arena.GetSlabStats(), SizeIs(1));
+  EXPECT_EQ(arena.Get(handle3), "9");
+  EXPECT_EQ(arena.used_bytes(), 1);
+  EXPECT_EQ(arena.dead_bytes(), 0);
+}
+
+TEST(SlabArenaTest, CurrentSlabIsReusedWhenEmpty) {
+  SlabArena arena(/*slab_size=*/8);
+  const auto handle = arena.Allocate("1234");
+  arena.Free(handle);
+  EXPECT_EQ(arena.used_bytes(), 0);
+  const auto new_handle = arena.Allocate("12345678");
+  EXPECT_EQ(new_handle.slab, handle.slab);
+  EXPECT_EQ(new_handle.offset, 0);
+  EXPECT_THAT(arena.GetSlabStats(), SizeIs(1));
+}
+
+TEST(SlabArenaTest, ReleasedSlabSlotsAreReused) {
+  SlabArena arena(/*slab_size=*/4);
+  std::vector<SlabArena::Handle> handles;
+  for (int i = 0; i < 4; i++) {
+    handles.push_back(arena.Allocate("abcd"));
+  }
+  for (int i = 0; i < 3; i++) {
+    arena.Free(handles[i]);
+  }
+  EXPECT_THAT(arena.GetSlabStats(), SizeIs(1));
+  for (int i = 0; i < 3; i++) {
+    EXPECT_LT(arena.Allocate("efgh").slab, 4);
+  }
+  EXPECT_THAT(arena.GetSlabStats(), SizeIs(4));
+}
+
+TEST(SlabArenaTest, HugePageSlabsFillWholeHugePages) {
+  SlabArena arena(/*slab_size=*/16, HugePageMode::kTransparent);
+  // Whether or not huge pages are available, the slab is a huge page big.
+  const std::string value(kHugePageSize / 2, 'x');
+  const auto handle1 = arena.Allocate(value);
+  const auto handle2 = arena.Allocate(value);
+  EXPECT_EQ(handle1.slab, handle2.slab);
+  EXPECT_EQ(arena.Get(handle1), value);
+  EXPECT_EQ(arena.Get(handle2), value);
+  arena.Free(handle1);
+  arena.Free(handle2);
+  EXPECT_THAT(arena.GetSlabStats(), SizeIs(1));
+}
+
+}  // namespace
+}  // namespace kv_server
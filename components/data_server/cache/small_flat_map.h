@@ -0,0 +1,171 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_CACHE_SMALL_FLAT_MAP_H_
+#define COMPONENTS_DATA_SERVER_CACHE_SMALL_FLAT_MAP_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/inlined_vector.h"
+#include "absl/hash/hash.h"
+
+namespace kv_server {
+
+// Map for the members of key-value sets, most of which have a few members.
+// Up to `kMaxSmallSize` entries are kept in a vector that holds the first one
+// inline, and are looked up by linear scan. A map that grows larger moves its
+// entries to a hash table, and keeps it until the map is rebuilt, e.g. by
+// adding its entries to a new map.
+//
+// Lookups can use any key type that `Hash` and `Eq` accept, in both forms.
+//
+// Not thread safe.
+template <typename K, typename V, typename Hash = absl::Hash<K>,
+          typename Eq = std::equal_to<K>, int kMaxSmallSize = 8>
+class SmallFlatMap {
+ public:
+  // Returns the stored key and the value of `key`, or nulls if it is missing.
+  template <typename Key>
+  std::pair<const K*, V*> FindEntry(const Key& key) {
+    if (large_ != nullptr) {
+      const auto it = large_->find(key);
+      if (it == large_->end()) {
+        return {nullptr, nullptr};
+      }
+      return {&it->first, &it->second};
+    }
+    for (auto& [entry_key, value] : small_) {
+      if (Eq()(entry_key, key)) {
+        return {&entry_key, &value};
+      }
+    }
+    return {nullptr, nullptr};
+  }
+
+  // Returns the value of `key`, or null if it is missing.
+  template <typename Key>
+  V* Find(const Key& key) {
+    return FindEntry(key).second;
+  }
+  template <typename Key>
+  const V* Find(const Key& key) const {
+    return const_cast<SmallFlatMap*>(this)->FindEntry(key).second;
+  }
+
+  // Adds `key`, which must be missing, with a default value. Returns the
+  // value.
+  V& Add(const K& key) {
+    if (large_ == nullptr && static_cast<int>(small_.size()) < kMaxSmallSize) {
+      return small_.emplace_back(key, V()).second;
+    }
+    MakeLarge();
+    return (*large_)[key];
+  }
+
+  // Removes `key`. Returns false if it is missing.
+  template <typename Key>
+  bool Erase(const Key& key) {
+    if (large_ != nullptr) {
+      const auto it = large_->find(key);
+      if (it == large_->end()) {
+        return false;
+      }
+      large_->erase(it);
+      return true;
+    }
+    for (auto it = small_.begin(); it != small_.end(); ++it) {
+      if (Eq()(it->first, key)) {
+        // The order of the entries doesn't matter, the last one takes the
+        // place of the removed one.
+        if (it != small_.end() - 1) {
+          *it = std::move(small_.back());
+        }
+        small_.pop_back();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Calls `fn` with the key and value of every entry.
+  template <typename Fn>
+  void ForEach(Fn&& fn) const {
+    if (large_ != nullptr) {
+      for (const auto& [key, value] : *large_) {
+        fn(key, value);
+      }
+      return;
+    }
+    for (const auto& [key, value] : small_) {
+      fn(key, value);
+    }
+  }
+
+  // Makes room for `size` entries, in the form that fits them.
+  void Reserve(size_t size) {
+    if (large_ == nullptr && size <= static_cast<size_t>(kMaxSmallSize)) {
+      small_.reserve(size);
+      return;
+    }
+    MakeLarge();
+    large_->reserve(size);
+  }
+
+  size_t size() const {
+    return large_ != nullptr ? large_->size() : small_.size();
+  }
+  bool empty() const { return size() == 0; }
+  bool is_large() const { return large_ != nullptr; }
+
+  // Returns the bytes allocated for the entries, besides the map itself.
+  int64_t memory_bytes() const {
+    if (large_ != nullptr) {
+      return sizeof(LargeMap) +
+             large_->capacity() *
+                 (sizeof(typename LargeMap::value_type) + /*control byte*/ 1);
+    }
+    return small_.capacity() > 1 ? small_.capacity() * sizeof(small_[0]) : 0;
+  }
+
+ private:
+  using LargeMap = absl::flat_hash_map<K, V, Hash, Eq>;
+
+  // Moves the entries to the hash table, if they aren't in it yet.
+  void MakeLarge() {
+    if (large_ != nullptr) {
+      return;
+    }
+    large_ = std::make_unique<LargeMap>();
+    large_->reserve(small_.size() + 1);
+    for (auto& [key, value] : small_) {
+      large_->emplace(std::move(key), std::move(value));
+    }
+    small_.clear();
+    small_.shrink_to_fit();
+  }
+
+  absl::InlinedVector<std::pair<K, V>, 1> small_;
+  // Null until the map grows larger than `kMaxSmallSize`.
+  std::unique_ptr<LargeMap> large_;
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_CACHE_SMALL_FLAT_MAP_H_
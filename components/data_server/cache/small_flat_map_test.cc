@@ -0,0 +1,110 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data_server/cache/small_flat_map.h"
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+using testing::Pair;
+using testing::UnorderedElementsAreArray;
+
+using Map = SmallFlatMap<std::string, int, absl::Hash<std::string>,
+                         std::equal_to<std::string>, /*kMaxSmallSize=*/4>;
+
+std::vector<std::pair<std::string, int>> Entries(const Map& map) {
+  std::vector<std::pair<std::string, int>> entries;
+  map.ForEach([&entries](const std::string& key, int value) {
+    entries.emplace_back(key, value);
+  });
+  return entries;
+}
+
+TEST(SmallFlatMapTest, FindsAddedKeys) {
+  Map map;
+  EXPECT_TRUE(map.empty());
+  map.Add("a") = 1;
+  map.Add("b") = 2;
+  ASSERT_NE(map.Find("a"), nullptr);
+  EXPECT_EQ(*map.Find("a"), 1);
+  EXPECT_EQ(*map.Find("b"), 2);
+  EXPECT_EQ(map.Find("c"), nullptr);
+  const auto [key, value] = map.FindEntry("b");
+  ASSERT_NE(key, nullptr);
+  EXPECT_EQ(*key, "b");
+  EXPECT_EQ(map.size(), 2);
+  EXPECT_FALSE(map.is_large());
+}
+
+TEST(SmallFlatMapTest, MovesLargeMapsToHashTable) {
+  Map map;
+  std::vector<std::pair<std::string, int>> expected;
+  for (int i = 0; i < 10; ++i) {
+    map.Add(absl::StrCat("key", i)) = i;
+    expected.emplace_back(absl::StrCat("key", i), i);
+    EXPECT_EQ(map.is_large(), i >= 4);
+  }
+  EXPECT_EQ(map.size(), 10);
+  for (int i = 0; i < 10; ++i) {
+    ASSERT_NE(map.Find(absl::StrCat("key", i)), nullptr);
+    EXPECT_EQ(*map.Find(absl::StrCat("key", i)), i);
+  }
+  EXPECT_THAT(Entries(map), UnorderedElementsAreArray(expected));
+  EXPECT_GT(map.memory_bytes(), 10 * sizeof(std::pair<std::string, int>));
+}
+
+TEST(SmallFlatMapTest, ErasesKeysInBothForms) {
+  for (int size : {3, 10}) {
+    Map map;
+    for (int i = 0; i < size; ++i) {
+      map.Add(absl::StrCat("key", i)) = i;
+    }
+    EXPECT_TRUE(map.Erase("key0"));
+    EXPECT_FALSE(map.Erase("key0"));
+    EXPECT_EQ(map.Find("key0"), nullptr);
+    EXPECT_EQ(map.size(), size - 1);
+    ASSERT_NE(map.Find(absl::StrCat("key", size - 1)), nullptr);
+    EXPECT_EQ(*map.Find(absl::StrCat("key", size - 1)), size - 1);
+  }
+}
+
+TEST(SmallFlatMapTest, SingleEntryIsInline) {
+  Map map;
+  map.Add("a") = 1;
+  EXPECT_EQ(map.memory_bytes(), 0);
+  map.Add("b") = 2;
+  EXPECT_GT(map.memory_bytes(), 0);
+}
+
+TEST(SmallFlatMapTest, ReserveKeepsEntries) {
+  Map map;
+  map.Add("a") = 1;
+  map.Reserve(100);
+  EXPECT_TRUE(map.is_large());
+  EXPECT_THAT(Entries(map), UnorderedElementsAreArray({Pair("a", 1)}));
+}
+
+}  // namespace
+}  // namespace kv_server
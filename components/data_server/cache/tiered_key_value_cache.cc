@@ -0,0 +1,444 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/data_server/cache/tiered_key_value_cache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/log/log.h"
+#include "absl/memory/memory.h"
+#include "components/data_server/cache/key_value_cache.h"
+#include "components/telemetry/server_definition.h"
+
+namespace kv_server {
+namespace {
+
+// A live hot tier entry to move to the cold tier.
+struct DemotedEntry {
+  std::string key;
+  std::shared_ptr<const std::string> value;
+  int64_t logical_commit_time;
+};
+
+int64_t EntryBytes(std::string_view key,
+                   const std::shared_ptr<const std::string>& value) {
+  return key.size() + (value == nullptr ? 0 : value->size());
+}
+
+}  // namespace
+
+TieredKeyValueCache::TieredKeyValueCache(Options options)
+    : options_(std::move(options)),
+      key_value_set_cache_(KeyValueCache::Create()) {}
+
+TieredKeyValueCache::~TieredKeyValueCache() {
+  std::remove(options_.cold_tier_path.c_str());
+}
+
+template <typename Fn>
+void TieredKeyValueCache::ForEachKeyValuePair(
+    const RequestContext& request_context,
+    const absl::flat_hash_set<std::string_view>& key_set, Fn&& fn) const {
+  std::vector<std::string_view> cold_keys;
+  std::shared_ptr<const ColdTierFile> cold_tier;
+  int num_hot_hits = 0;
+  {
+    absl::ReaderMutexLock lock(&mutex_);
+    for (std::string_view key : key_set) {
+      const auto key_iter = hot_tier_.find(key);
+      if (key_iter == hot_tier_.end()) {
+        cold_keys.push_back(key);
+        continue;
+      }
+      // A deleted key hides its cold value.
+      if (key_iter->second.value != nullptr) {
+        key_iter->second.accessed.store(true, std::memory_order_relaxed);
+        fn(key, key_iter->second.value);
+        ++num_hot_hits;
+      }
+    }
+    cold_tier = cold_tier_;
+  }
+  if (cold_tier == nullptr || cold_keys.empty()) {
+    LogTierHitMetrics(request_context, num_hot_hits, /*num_cold_hits=*/0);
+    return;
+  }
+  std::vector<DemotedEntry> cold_entries;
+  for (std::string_view key : cold_keys) {
+    if (const auto entry = cold_tier->Find(key); entry.has_value()) {
+      auto value = std::make_shared<const std::string>(entry->value);
+      fn(key, value);
+      cold_entries.push_back({std::string(key), std::move(value),
+                              entry->logical_commit_time});
+    }
+  }
+  LogTierHitMetrics(request_context, num_hot_hits,
+                    static_cast<int>(cold_entries.size()));
+  if (cold_entries.empty()) {
+    return;
+  }
+  // Keys that were looked up are kept in memory until they stop being looked
+  // up, unless they changed in the meantime.
+  absl::MutexLock lock(&mutex_);
+  if (cold_tier_ != cold_tier) {
+    return;
+  }
+  for (DemotedEntry& cold_entry : cold_entries) {
+    const auto [key_iter, inserted] = hot_tier_.try_emplace(cold_entry.key);
+    if (!inserted) {
+      continue;
+    }
+    hot_tier_bytes_ += EntryBytes(cold_entry.key, cold_entry.value);
+    key_iter->second.value = std::move(cold_entry.value);
+    key_iter->second.last_logical_commit_time = cold_entry.logical_commit_time;
+    key_iter->second.accessed.store(true, std::memory_order_relaxed);
+  }
+}
+
+absl::flat_hash_map<std::string, std::string>
+TieredKeyValueCache::GetKeyValuePairs(
+    const RequestContext& request_context,
+    const absl::flat_hash_set<std::string_view>& key_set) const {
+  ScopeLatencyMetricsRecorder<InternalLookupMetricsContext,
+                              kGetValuePairsLatencyInMicros>
+      latency_recorder(request_context.GetInternalLookupMetricsContext());
+  absl::flat_hash_map<std::string, std::string> kv_pairs;
+  ForEachKeyValuePair(
+      request_context, key_set,
+      [&kv_pairs](std::string_view key,
+                  const std::shared_ptr<const std::string>& value) {
+        kv_pairs.insert_or_assign(key, *value);
+      });
+  if (kv_pairs.empty()) {
+    LogCacheAccessMetrics(request_context, kKeyValueCacheMiss);
+  } else {
+    LogCacheAccessMetrics(request_context, kKeyValueCacheHit);
+  }
+  return kv_pairs;
+}
+
+GetKeyValuePairsResult TieredKeyValueCache::GetKeyValuePairViews(
+    const RequestContext& request_context,
+    const absl::flat_hash_set<std::string_view>& key_set) const {
+  ScopeLatencyMetricsRecorder<InternalLookupMetricsContext,
+                              kGetValuePairsLatencyInMicros>
+      latency_recorder(request_context.GetInternalLookupMetricsContext());
+  GetKeyValuePairsResult result;
+  ForEachKeyValuePair(request_context, key_set,
+                      [&result](std::string_view key,
+                                std::shared_ptr<const std::string> value) {
+                        result.AddValue(key, std::move(value));
+                      });
+  if (result.empty()) {
+    LogCacheAccessMetrics(request_context, kKeyValueCacheMiss);
+  } else {
+    LogCacheAccessMetrics(request_context, kKeyValueCacheHit);
+  }
+  return result;
+}
+
+std::unique_ptr<GetKeyValueSetResult> TieredKeyValueCache::GetKeyValueSet(
+    const RequestContext& request_context,
+    const absl::flat_hash_set<std::string_view>& key_set) const {
+  return key_value_set_cache_->GetKeyValueSet(request_context, key_set);
+}
+
+void TieredKeyValueCache::UpdateKeyValue(std::string_view key,
+                                         std::string_view value,
+                                         int64_t logical_commit_time,
+                                         std::string_view prefix) {
+  SampledScopeLatencyMetricsRecorder<kUpdateKeyValueLatency> latency_recorder;
+  auto shared_value = std::make_shared<const std::string>(value);
+  absl::MutexLock lock(&mutex_);
+  SetHotEntry(key, std::move(shared_value), logical_commit_time, prefix);
+}
+
+void TieredKeyValueCache::DeleteKey(std::string_view key,
+                                    int64_t logical_commit_time,
+                                    std::string_view prefix) {
+  SampledScopeLatencyMetricsRecorder<kDeleteKeyLatency> latency_recorder;
+  absl::MutexLock lock(&mutex_);
+  SetHotEntry(key, /*value=*/nullptr, logical_commit_time, prefix);
+}
+
+void TieredKeyValueCache::SetHotEntry(std::string_view key,
+                                      std::shared_ptr<const std::string> value,
+                                      int64_t logical_commit_time,
+                                      std::string_view prefix) {
+  if (const auto it = max_cleanup_logical_commit_time_map_.find(prefix);
+      it != max_cleanup_logical_commit_time_map_.end() &&
+      logical_commit_time <= it->second) {
+    VLOG(1) << "Skipping the update as its logical_commit_time: "
+            << logical_commit_time
+            << " is not newer than the current cutoff time:" << it->second;
+    return;
+  }
+  auto key_iter = hot_tier_.find(key);
+  if (key_iter != hot_tier_.end()) {
+    HotEntry& entry = key_iter->second;
+    if (entry.last_logical_commit_time >= logical_commit_time) {
+      return;
+    }
+    if (entry.value == nullptr) {
+      // should always have this, but checking just in case
+      auto& deleted_nodes = deleted_nodes_map_[prefix];
+      auto [begin, end] =
+          deleted_nodes.equal_range(entry.last_logical_commit_time);
+      const auto is_key = [key](const auto& node) {
+        return node.second == key;
+      };
+      if (const auto dl_key_iter = std::find_if(begin, end, is_key);
+          dl_key_iter != end) {
+        deleted_nodes.erase(dl_key_iter);
+      }
+    }
+    hot_tier_bytes_ -= EntryBytes(key, entry.value);
+  } else {
+    if (cold_tier_ != nullptr) {
+      if (const auto entry = cold_tier_->Find(key);
+          entry.has_value() &&
+          entry->logical_commit_time >= logical_commit_time) {
+        return;
+      }
+    }
+    key_iter = hot_tier_.try_emplace(key).first;
+  }
+  // The entry changed, it doesn't hide a cleaned up deletion anymore.
+  cold_tombstones_.erase(key);
+  hot_tier_bytes_ += EntryBytes(key, value);
+  if (value == nullptr) {
+    // Kept until cleanup, so that late updates with a smaller logical commit
+    // time don't bring the key back.
+    deleted_nodes_map_[prefix].emplace(logical_commit_time, key);
+  }
+  key_iter->second.value = std::move(value);
+  key_iter->second.last_logical_commit_time = logical_commit_time;
+}
+
+void TieredKeyValueCache::UpdateKeyValueSet(
+    std::string_view key, absl::Span<std::string_view> input_value_set,
+    int64_t logical_commit_time, std::string_view prefix) {
+  key_value_set_cache_->UpdateKeyValueSet(key, input_value_set,
+                                          logical_commit_time, prefix);
+}
+
+void TieredKeyValueCache::DeleteValuesInSet(
+    std::string_view key, absl::Span<std::string_view> value_set,
+    int64_t logical_commit_time, std::string_view prefix) {
+  key_value_set_cache_->DeleteValuesInSet(key, value_set, logical_commit_time,
+                                          prefix);
+}
+
+void TieredKeyValueCache::RemoveDeletedKeys(int64_t logical_commit_time,
+                                            std::string_view prefix) {
+  ScopeLatencyMetricsRecorder<ServerSafeMetricsContext,
+                              kRemoveDeletedKeyLatency>
+      latency_recorder(KVServerContextMap()->SafeMetric());
+  CleanUpKeyValueMap(logical_commit_time, prefix);
+  key_value_set_cache_->RemoveDeletedKeys(logical_commit_time, prefix);
+  MaybeRebuildColdTier();
+}
+
+Cache::CleanupProgress TieredKeyValueCache::RemoveDeletedKeysSlice(
+    int64_t logical_commit_time, std::string_view prefix,
+    absl::Time deadline) {
+  ScopeLatencyMetricsRecorder<ServerSafeMetricsContext,
+                              kRemoveDeletedKeyLatency>
+      latency_recorder(KVServerContextMap()->SafeMetric());
+  CleanUpKeyValueMap(logical_commit_time, prefix);
+  CleanupProgress progress = key_value_set_cache_->RemoveDeletedKeysSlice(
+      logical_commit_time, prefix, deadline);
+  {
+    absl::ReaderMutexLock lock(&mutex_);
+    for (const auto& [unused_prefix, deleted_nodes] : deleted_nodes_map_) {
+      progress.remaining_deleted_values += deleted_nodes.size();
+    }
+  }
+  if (progress.done) {
+    MaybeRebuildColdTier();
+  }
+  return progress;
+}
+
+void TieredKeyValueCache::CleanUpKeyValueMap(int64_t logical_commit_time,
+                                             std::string_view prefix) {
+  ScopeLatencyMetricsRecorder<ServerSafeMetricsContext,
+                              kCleanUpKeyValueMapLatency>
+      latency_recorder(KVServerContextMap()->SafeMetric());
+  // Waits for a rebuild in progress. Otherwise it could remove the deletion of
+  // a key that the rebuild is moving to the cold tier, and the value would
+  // come back with the new file.
+  absl::MutexLock rebuild_lock(&rebuild_mutex_);
+  absl::MutexLock lock(&mutex_);
+  int64_t& max_cleanup_logical_commit_time =
+      max_cleanup_logical_commit_time_map_[prefix];
+  if (max_cleanup_logical_commit_time < logical_commit_time) {
+    max_cleanup_logical_commit_time = logical_commit_time;
+  }
+  const auto deleted_nodes_iter = deleted_nodes_map_.find(prefix);
+  if (deleted_nodes_iter == deleted_nodes_map_.end()) {
+    return;
+  }
+  auto& deleted_nodes = deleted_nodes_iter->second;
+  auto it = deleted_nodes.begin();
+  for (; it != deleted_nodes.end() && it->first <= logical_commit_time; ++it) {
+    const auto key_iter = hot_tier_.find(it->second);
+    if (key_iter == hot_tier_.end() || key_iter->second.value != nullptr ||
+        key_iter->second.last_logical_commit_time > logical_commit_time) {
+      continue;
+    }
+    if (cold_tier_ != nullptr && cold_tier_->Find(it->second).has_value()) {
+      cold_tombstones_.insert(it->second);
+      continue;
+    }
+    hot_tier_bytes_ -= EntryBytes(it->second, nullptr);
+    hot_tier_.erase(key_iter);
+  }
+  deleted_nodes.erase(deleted_nodes.begin(), it);
+}
+
+void TieredKeyValueCache::MaybeRebuildColdTier() {
+  absl::MutexLock rebuild_lock(&rebuild_mutex_);
+  std::vector<DemotedEntry> demoted_entries;
+  absl::flat_hash_set<std::string> dropped_keys;
+  std::shared_ptr<const ColdTierFile> cold_tier;
+  {
+    absl::ReaderMutexLock lock(&mutex_);
+    if (hot_tier_bytes_ <= options_.max_hot_tier_bytes) {
+      return;
+    }
+    // Values that are looked up from now on stay hot.
+    for (const auto& [key, entry] : hot_tier_) {
+      if (!entry.accessed.exchange(false, std::memory_order_relaxed) &&
+          entry.value != nullptr) {
+        demoted_entries.push_back(
+            {key, entry.value, entry.last_logical_commit_time});
+      }
+    }
+    dropped_keys = cold_tombstones_;
+    cold_tier = cold_tier_;
+  }
+  if (demoted_entries.empty() && dropped_keys.empty()) {
+    return;
+  }
+  ScopeLatencyMetricsRecorder<ServerSafeMetricsContext,
+                              kColdTierRebuildLatency>
+      latency_recorder(KVServerContextMap()->SafeMetric());
+  std::sort(demoted_entries.begin(), demoted_entries.end(),
+            [](const DemotedEntry& a, const DemotedEntry& b) {
+              return a.key < b.key;
+            });
+  auto writer = ColdTierFile::Writer::Create(options_.cold_tier_path);
+  if (!writer.ok()) {
+    LOG(ERROR) << "Failed to rebuild the cold tier: " << writer.status();
+    return;
+  }
+  // Merges the demoted entries into the previous file. Demoted values are
+  // at least as recent as the cold values of the same keys.
+  bool added_all = true;
+  auto demoted_iter = demoted_entries.begin();
+  const auto add_demoted_entries_before = [&](std::string_view key) {
+    for (; demoted_iter != demoted_entries.end() && demoted_iter->key < key;
+         ++demoted_iter) {
+      added_all &= (*writer)->Add(demoted_iter->key, *demoted_iter->value,
+                                  demoted_iter->logical_commit_time);
+    }
+  };
+  if (cold_tier != nullptr) {
+    cold_tier->ForEach([&](const ColdTierFile::Entry& entry) {
+      add_demoted_entries_before(entry.key);
+      if ((demoted_iter != demoted_entries.end() &&
+           demoted_iter->key == entry.key) ||
+          dropped_keys.contains(entry.key)) {
+        return;
+      }
+      added_all &=
+          (*writer)->Add(entry.key, entry.value, entry.logical_commit_time);
+    });
+  }
+  for (; demoted_iter != demoted_entries.end(); ++demoted_iter) {
+    added_all &= (*writer)->Add(demoted_iter->key, *demoted_iter->value,
+                                demoted_iter->logical_commit_time);
+  }
+  if (!added_all) {
+    LOG(ERROR) << "Failed to rebuild the cold tier: entries out of order";
+    return;
+  }
+  if (const auto status = (*writer)->Finish(); !status.ok()) {
+    LOG(ERROR) << "Failed to rebuild the cold tier: " << status;
+    return;
+  }
+  // Lookups that hold the previous file keep it mapped, its pages stay valid
+  // after the new file replaced it.
+  auto new_cold_tier = ColdTierFile::Open(options_.cold_tier_path);
+  if (!new_cold_tier.ok()) {
+    LOG(ERROR) << "Failed to rebuild the cold tier: "
+               << new_cold_tier.status();
+    return;
+  }
+  absl::MutexLock lock(&mutex_);
+  cold_tier_ = *std::move(new_cold_tier);
+  for (const DemotedEntry& demoted_entry : demoted_entries) {
+    const auto key_iter = hot_tier_.find(demoted_entry.key);
+    // Entries that changed or were looked up since stay hot.
+    if (key_iter != hot_tier_.end() &&
+        key_iter->second.value == demoted_entry.value &&
+        !key_iter->second.accessed.load(std::memory_order_relaxed)) {
+      hot_tier_bytes_ -= EntryBytes(demoted_entry.key, demoted_entry.value);
+      hot_tier_.erase(key_iter);
+    }
+  }
+  for (const std::string& key : dropped_keys) {
+    // Keys that changed since aren't in `cold_tombstones_` anymore.
+    if (cold_tombstones_.erase(key) > 0) {
+      hot_tier_bytes_ -= EntryBytes(key, nullptr);
+      hot_tier_.erase(key);
+    }
+  }
+}
+
+void TieredKeyValueCache::LogCacheAccessMetrics(
+    const RequestContext& request_context,
+    std::string_view cache_access_event) const {
+  LogIfError(
+      request_context.GetInternalLookupMetricsContext()
+          .AccumulateMetric<kCacheAccessEventCount>(1, cache_access_event));
+}
+
+void TieredKeyValueCache::LogTierHitMetrics(
+    const RequestContext& request_context, int num_hot_hits,
+    int num_cold_hits) const {
+  if (num_hot_hits > 0) {
+    LogIfError(request_context.GetInternalLookupMetricsContext()
+                   .AccumulateMetric<kCacheAccessEventCount>(num_hot_hits,
+                                                             kHotTierHit));
+  }
+  if (num_cold_hits > 0) {
+    LogIfError(request_context.GetInternalLookupMetricsContext()
+                   .AccumulateMetric<kCacheAccessEventCount>(num_cold_hits,
+                                                             kColdTierHit));
+  }
+}
+
+std::unique_ptr<Cache> TieredKeyValueCache::Create(Options options) {
+  return absl::WrapUnique(new TieredKeyValueCache(std::move(options)));
+}
+
+}  // namespace kv_server
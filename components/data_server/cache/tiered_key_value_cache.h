@@ -0,0 +1,190 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_CACHE_TIERED_KEY_VALUE_CACHE_H_
+#define COMPONENTS_DATA_SERVER_CACHE_TIERED_KEY_VALUE_CACHE_H_
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/container/node_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "components/data_server/cache/cache.h"
+#include "components/data_server/cache/cold_tier_file.h"
+#include "components/data_server/cache/get_key_value_set_result.h"
+
+namespace kv_server {
+
+// Datastore that keeps the key-value pairs that are looked up in memory, and
+// the others in a `ColdTierFile` on local disk.
+//
+// Updates go to the hot tier in memory. Once it holds more than
+// `max_hot_tier_bytes`, cleanups move the values that weren't looked up since
+// the previous move to a new cold tier file, merged with the previous one.
+// After a snapshot is loaded, the first move leaves only the values that were
+// looked up in memory. Lookups of cold values read them from the mapped file,
+// through the page cache, and copy them.
+//
+// Key-value sets are delegated to a `KeyValueCache`.
+// One cache object is only for keys in one namespace.
+class TieredKeyValueCache : public Cache {
+ public:
+  struct Options {
+    // The cold tier file, removed with the cache.
+    std::string cold_tier_path;
+    int64_t max_hot_tier_bytes = 0;
+  };
+
+  ~TieredKeyValueCache() override;
+
+  // Looks up and returns key-value pairs for the given keys.
+  absl::flat_hash_map<std::string, std::string> GetKeyValuePairs(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override;
+
+  // Looks up the given keys and returns views of their values. Only the cold
+  // values are copied.
+  GetKeyValuePairsResult GetKeyValuePairViews(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override;
+
+  // Looks up and returns key-value set result for the given key set.
+  std::unique_ptr<GetKeyValueSetResult> GetKeyValueSet(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override;
+
+  // Inserts or updates the key with the new value for a given prefix
+  void UpdateKeyValue(std::string_view key, std::string_view value,
+                      int64_t logical_commit_time,
+                      std::string_view prefix = "") override;
+
+  // Inserts or updates values in the set for a given key and prefix, if a value
+  // exists, updates its timestamp to the latest logical commit time.
+  void UpdateKeyValueSet(std::string_view key,
+                         absl::Span<std::string_view> input_value_set,
+                         int64_t logical_commit_time,
+                         std::string_view prefix = "") override;
+
+  // Deletes a particular (key, value) pair for a given prefix.
+  void DeleteKey(std::string_view key, int64_t logical_commit_time,
+                 std::string_view prefix = "") override;
+
+  // Deletes values in the set for a given key and prefix. The deleted values
+  // are kept and marked "deleted", in case there are late-arriving updates to
+  // them.
+  void DeleteValuesInSet(std::string_view key,
+                         absl::Span<std::string_view> value_set,
+                         int64_t logical_commit_time,
+                         std::string_view prefix = "") override;
+
+  // Removes the values that were deleted before the specified
+  // logical_commit_time for a given prefix, then moves values to the cold
+  // tier if the hot tier is full.
+  void RemoveDeletedKeys(int64_t logical_commit_time,
+                         std::string_view prefix = "") override;
+
+  // Cleans up the key-value pairs at once and the key-value sets until
+  // `deadline`. Moves values to the cold tier if the hot tier is full once
+  // the cleanup is done.
+  CleanupProgress RemoveDeletedKeysSlice(int64_t logical_commit_time,
+                                         std::string_view prefix,
+                                         absl::Time deadline) override;
+
+  static std::unique_ptr<Cache> Create(Options options);
+
+ private:
+  struct HotEntry {
+    // Null for deleted keys, which are kept until they are cleaned up, see
+    // `KeyValueCache::CacheValue`.
+    std::shared_ptr<const std::string> value;
+    int64_t last_logical_commit_time = 0;
+    // Set by lookups, which only hold a reader lock, and reset by cold tier
+    // rebuilds. Values that weren't looked up in between are moved to the
+    // cold tier.
+    mutable std::atomic<bool> accessed = false;
+  };
+
+  explicit TieredKeyValueCache(Options options);
+
+  // Calls `fn` with the key and value of every key of `key_set` that has a
+  // value, from the hot tier or else the cold tier. Cold values are read
+  // without the lock, and added to the hot tier afterwards.
+  template <typename Fn>
+  void ForEachKeyValuePair(const RequestContext& request_context,
+                           const absl::flat_hash_set<std::string_view>& key_set,
+                           Fn&& fn) const ABSL_LOCKS_EXCLUDED(mutex_);
+  // Sets the hot tier entry of `key` to `value`, or a deletion if null,
+  // unless it isn't newer than the cleanup cutoff of `prefix` or the current
+  // value of the key in either tier.
+  void SetHotEntry(std::string_view key,
+                   std::shared_ptr<const std::string> value,
+                   int64_t logical_commit_time, std::string_view prefix)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Removes the keys of `prefix` that were deleted before
+  // `logical_commit_time`, except the ones that hide a cold value.
+  void CleanUpKeyValueMap(int64_t logical_commit_time, std::string_view prefix)
+      ABSL_LOCKS_EXCLUDED(mutex_, rebuild_mutex_);
+  // Moves the values that weren't looked up since the previous rebuild to a
+  // new cold tier file, if the hot tier holds more than `max_hot_tier_bytes`.
+  void MaybeRebuildColdTier() ABSL_LOCKS_EXCLUDED(mutex_, rebuild_mutex_);
+  // Logs cache access metrics for cache hit or miss counts. The cache access
+  // event name is defined in server_definition.h file
+  void LogCacheAccessMetrics(const RequestContext& request_context,
+                             std::string_view cache_access_event) const;
+  // Logs how many looked up keys were found in each tier.
+  void LogTierHitMetrics(const RequestContext& request_context,
+                         int num_hot_hits, int num_cold_hits) const;
+
+  const Options options_;
+  std::unique_ptr<Cache> key_value_set_cache_;
+
+  // Held by cold tier rebuilds, so that only one rebuild writes the file, and
+  // by cleanups.
+  absl::Mutex rebuild_mutex_ ABSL_ACQUIRED_BEFORE(mutex_);
+  mutable absl::Mutex mutex_;
+  // Mapping from a key to its value in memory. A node map, since the entries
+  // hold an atomic. Lookups add the cold values they return.
+  mutable absl::node_hash_map<std::string, HotEntry> hot_tier_
+      ABSL_GUARDED_BY(mutex_);
+  // Bytes of the keys and values of `hot_tier_`.
+  mutable int64_t hot_tier_bytes_ ABSL_GUARDED_BY(mutex_) = 0;
+  // Values that aren't in `hot_tier_`, null until the first rebuild. Lookups
+  // hold a reference, so that a rebuild doesn't unmap the file under them.
+  std::shared_ptr<const ColdTierFile> cold_tier_ ABSL_GUARDED_BY(mutex_);
+  // Deleted keys of `hot_tier_` that were cleaned up, but still have a value
+  // in `cold_tier_`. They are kept in the hot tier to hide the cold value
+  // until the next rebuild drops it.
+  absl::flat_hash_set<std::string> cold_tombstones_ ABSL_GUARDED_BY(mutex_);
+  // The key is the prefix and the value is the maximum timestamp that was
+  // passed to RemoveDeletedKeys.
+  absl::flat_hash_map<std::string, int64_t> max_cleanup_logical_commit_time_map_
+      ABSL_GUARDED_BY(mutex_);
+  // Per prefix, sorted mapping from the logical timestamp to a key, for keys
+  // that were deleted.
+  absl::flat_hash_map<std::string, std::multimap<int64_t, std::string>>
+      deleted_nodes_map_ ABSL_GUARDED_BY(mutex_);
+
+  friend class TieredKeyValueCacheTestPeer;
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_CACHE_TIERED_KEY_VALUE_CACHE_H_
@@ -0,0 +1,213 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/data_server/cache/tiered_key_value_cache.h"
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/notification.h"
+#include "components/data_server/cache/cache.h"
+#include "components/data_server/cache/mocks.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+
+class TieredKeyValueCacheTestPeer {
+ public:
+  TieredKeyValueCacheTestPeer() = delete;
+  static int GetHotTierSize(const Cache& c) {
+    const auto& cache = static_cast<const TieredKeyValueCache&>(c);
+    absl::MutexLock lock(&cache.mutex_);
+    return cache.hot_tier_.size();
+  }
+  static int GetColdTierSize(const Cache& c) {
+    const auto& cache = static_cast<const TieredKeyValueCache&>(c);
+    absl::MutexLock lock(&cache.mutex_);
+    return cache.cold_tier_ == nullptr ? 0 : cache.cold_tier_->num_entries();
+  }
+};
+
+namespace {
+
+using testing::UnorderedElementsAre;
+
+class TieredCacheTest : public ::testing::Test {
+ protected:
+  TieredCacheTest() {
+    InitMetricsContextMap();
+    scope_metrics_context_ = std::make_unique<ScopeMetricsContext>();
+    request_context_ =
+        std::make_unique<RequestContext>(*scope_metrics_context_);
+  }
+  // Every cleanup moves the values that weren't looked up to the cold tier.
+  std::unique_ptr<Cache> CreateCache(int64_t max_hot_tier_bytes = 0) {
+    return TieredKeyValueCache::Create({
+        .cold_tier_path = absl::StrCat(
+            testing::TempDir(), "/",
+            testing::UnitTest::GetInstance()->current_test_info()->name()),
+        .max_hot_tier_bytes = max_hot_tier_bytes,
+    });
+  }
+  RequestContext& GetRequestContext() { return *request_context_; }
+  std::unique_ptr<ScopeMetricsContext> scope_metrics_context_;
+  std::unique_ptr<RequestContext> request_context_;
+};
+
+TEST_F(TieredCacheTest, ValuesStayHotUntilTheHotTierIsFull) {
+  std::unique_ptr<Cache> cache = CreateCache(/*max_hot_tier_bytes=*/1000);
+  cache->UpdateKeyValue("key1", "value1", 1);
+  cache->UpdateKeyValue("key2", "value2", 1);
+  cache->DeleteKey("key3", 1);
+  cache->RemoveDeletedKeys(1);
+  EXPECT_THAT(
+      cache->GetKeyValuePairs(GetRequestContext(), {"key1", "key2", "key3"}),
+      UnorderedElementsAre(KVPairEq("key1", "value1"),
+                           KVPairEq("key2", "value2")));
+  EXPECT_EQ(TieredKeyValueCacheTestPeer::GetHotTierSize(*cache), 2);
+  EXPECT_EQ(TieredKeyValueCacheTestPeer::GetColdTierSize(*cache), 0);
+}
+
+TEST_F(TieredCacheTest, ValuesThatArentLookedUpMoveToTheColdTier) {
+  std::unique_ptr<Cache> cache = CreateCache();
+  for (int i = 0; i < 100; ++i) {
+    cache->UpdateKeyValue(absl::StrCat("key", i), absl::StrCat("value", i), 2);
+  }
+  EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(), {"key0"}),
+              UnorderedElementsAre(KVPairEq("key0", "value0")));
+  cache->RemoveDeletedKeys(1);
+  EXPECT_EQ(TieredKeyValueCacheTestPeer::GetHotTierSize(*cache), 1);
+  EXPECT_EQ(TieredKeyValueCacheTestPeer::GetColdTierSize(*cache), 99);
+
+  EXPECT_THAT(
+      cache->GetKeyValuePairs(GetRequestContext(), {"key0", "key5", "key99"}),
+      UnorderedElementsAre(KVPairEq("key0", "value0"),
+                           KVPairEq("key5", "value5"),
+                           KVPairEq("key99", "value99")));
+  // Cold values that are looked up come back to the hot tier.
+  EXPECT_EQ(TieredKeyValueCacheTestPeer::GetHotTierSize(*cache), 3);
+  cache->RemoveDeletedKeys(1);
+  EXPECT_EQ(TieredKeyValueCacheTestPeer::GetHotTierSize(*cache), 3);
+
+  // The next rebuild keeps the values that were looked up since the previous.
+  cache->GetKeyValuePairs(GetRequestContext(), {"key5"});
+  cache->RemoveDeletedKeys(1);
+  EXPECT_EQ(TieredKeyValueCacheTestPeer::GetHotTierSize(*cache), 1);
+  EXPECT_EQ(TieredKeyValueCacheTestPeer::GetColdTierSize(*cache), 100);
+  EXPECT_EQ(cache->GetKeyValuePairs(GetRequestContext(), {"key0"}).size(), 1);
+}
+
+TEST_F(TieredCacheTest, UpdatesOfColdKeysNeedNewerTimestamps) {
+  std::unique_ptr<Cache> cache = CreateCache();
+  cache->UpdateKeyValue("key1", "value1", 5);
+  cache->UpdateKeyValue("key2", "value2", 5);
+  cache->RemoveDeletedKeys(1);
+  ASSERT_EQ(TieredKeyValueCacheTestPeer::GetHotTierSize(*cache), 0);
+
+  cache->UpdateKeyValue("key1", "old_value1", 4);
+  cache->DeleteKey("key2", 4);
+  EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(), {"key1", "key2"}),
+              UnorderedElementsAre(KVPairEq("key1", "value1"),
+                                   KVPairEq("key2", "value2")));
+
+  cache->UpdateKeyValue("key1", "new_value1", 6);
+  cache->DeleteKey("key2", 6);
+  EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(), {"key1", "key2"}),
+              UnorderedElementsAre(KVPairEq("key1", "new_value1")));
+}
+
+TEST_F(TieredCacheTest, DeletionsOfColdKeysAreCleanedUpByRebuilds) {
+  std::unique_ptr<Cache> cache = CreateCache();
+  cache->UpdateKeyValue("key1", "value1", 2);
+  cache->UpdateKeyValue("key2", "value2", 2);
+  cache->RemoveDeletedKeys(1);
+  ASSERT_EQ(TieredKeyValueCacheTestPeer::GetColdTierSize(*cache), 2);
+
+  cache->DeleteKey("key1", 3);
+  // The deletion hides the cold value until a rebuild drops it.
+  cache->RemoveDeletedKeys(3);
+  EXPECT_EQ(TieredKeyValueCacheTestPeer::GetColdTierSize(*cache), 1);
+  EXPECT_EQ(TieredKeyValueCacheTestPeer::GetHotTierSize(*cache), 0);
+  EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(), {"key1", "key2"}),
+              UnorderedElementsAre(KVPairEq("key2", "value2")));
+
+  // Updates that aren't newer than the cleanup are still skipped.
+  cache->UpdateKeyValue("key1", "value1", 3);
+  EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(), {"key1"}),
+              testing::IsEmpty());
+}
+
+TEST_F(TieredCacheTest, ViewsOfColdValuesOutliveRebuilds) {
+  std::unique_ptr<Cache> cache = CreateCache();
+  cache->UpdateKeyValue("key1", "value1", 2);
+  cache->RemoveDeletedKeys(1);
+  const absl::flat_hash_set<std::string_view> keys = {"key1"};
+  GetKeyValuePairsResult result =
+      cache->GetKeyValuePairViews(GetRequestContext(), keys);
+  cache->UpdateKeyValue("key1", "value2", 3);
+  cache->UpdateKeyValue("key2", "value2", 3);
+  cache->RemoveDeletedKeys(1);
+  cache->RemoveDeletedKeys(1);
+  EXPECT_EQ(result.GetValue("key1"), "value1");
+  EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(), {"key1", "key2"}),
+              UnorderedElementsAre(KVPairEq("key1", "value2"),
+                                   KVPairEq("key2", "value2")));
+}
+
+TEST_F(TieredCacheTest, KeyValueSetsAreDelegated) {
+  std::unique_ptr<Cache> cache = CreateCache();
+  std::vector<std::string_view> values = {"v1", "v2"};
+  cache->UpdateKeyValueSet("my_key", absl::MakeSpan(values), 1);
+  std::vector<std::string_view> deleted_values = {"v1"};
+  cache->DeleteValuesInSet("my_key", absl::MakeSpan(deleted_values), 2);
+  auto result = cache->GetKeyValueSet(GetRequestContext(), {"my_key"});
+  EXPECT_THAT(result->GetValueSet("my_key"), UnorderedElementsAre("v2"));
+}
+
+TEST_F(TieredCacheTest, ConcurrentLookupsAndRebuilds) {
+  std::unique_ptr<Cache> cache = CreateCache();
+  for (int i = 0; i < 1000; ++i) {
+    cache->UpdateKeyValue(absl::StrCat("key", i), absl::StrCat("value", i), 2);
+  }
+  absl::Notification done;
+  std::vector<std::thread> lookups;
+  for (int i = 0; i < 4; ++i) {
+    lookups.emplace_back([&cache, &done, i, this]() {
+      const std::string key = absl::StrCat("key", i);
+      const std::string value = absl::StrCat("value", i);
+      while (!done.HasBeenNotified()) {
+        auto kv_pairs = cache->GetKeyValuePairs(GetRequestContext(), {key});
+        ASSERT_THAT(kv_pairs, UnorderedElementsAre(KVPairEq(key, value)));
+      }
+    });
+  }
+  for (int i = 0; i < 20; ++i) {
+    cache->UpdateKeyValue(absl::StrCat("key", 100 + i), "new_value", 3 + i);
+    cache->RemoveDeletedKeys(1);
+  }
+  done.Notify();
+  for (auto& lookup : lookups) {
+    lookup.join();
+  }
+  EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(), {"key119"}),
+              UnorderedElementsAre(KVPairEq("key119", "new_value")));
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -0,0 +1,129 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/data_server/cache/tombstone_cleaner.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "absl/log/log.h"
+#include "absl/memory/memory.h"
+#include "absl/time/clock.h"
+#include "components/telemetry/server_definition.h"
+#include "components/util/memory_releaser.h"
+
+namespace kv_server {
+
+TombstoneCleaner::TombstoneCleaner(Cache& cache, Options options)
+    : cache_(cache), options_(std::move(options)) {}
+
+TombstoneCleaner::~TombstoneCleaner() {
+  {
+    absl::MutexLock lock(&mutex_);
+    stopped_ = true;
+  }
+  thread_.join();
+}
+
+void TombstoneCleaner::ScheduleCleanup(int64_t logical_commit_time,
+                                       std::string_view prefix) {
+  absl::MutexLock lock(&mutex_);
+  auto [it, inserted] = pending_cleanups_.try_emplace(
+      prefix, PendingCleanup{.logical_commit_time = logical_commit_time,
+                             .requested_at = absl::Now()});
+  if (!inserted) {
+    it->second.logical_commit_time =
+        std::max(it->second.logical_commit_time, logical_commit_time);
+  }
+}
+
+void TombstoneCleaner::WaitUntilDone() {
+  absl::MutexLock lock(&mutex_);
+  mutex_.Await(absl::Condition(this, &TombstoneCleaner::IsDone));
+}
+
+bool TombstoneCleaner::HasWorkOrStopped() const {
+  return stopped_ || !pending_cleanups_.empty();
+}
+
+bool TombstoneCleaner::IsDone() const {
+  return stopped_ || (pending_cleanups_.empty() && !in_slice_);
+}
+
+void TombstoneCleaner::Run() {
+  while (true) {
+    std::string prefix;
+    PendingCleanup cleanup;
+    {
+      absl::MutexLock lock(&mutex_);
+      mutex_.Await(absl::Condition(this, &TombstoneCleaner::HasWorkOrStopped));
+      if (stopped_) {
+        return;
+      }
+      // Takes the prefixes in turns, so that a prefix that keeps getting new
+      // cleanups doesn't hold back the others.
+      auto it = pending_cleanups_.upper_bound(last_prefix_);
+      if (it == pending_cleanups_.end()) {
+        it = pending_cleanups_.begin();
+      }
+      prefix = it->first;
+      cleanup = it->second;
+      last_prefix_ = prefix;
+      in_slice_ = true;
+    }
+    const Cache::CleanupProgress progress = cache_.RemoveDeletedKeysSlice(
+        cleanup.logical_commit_time, prefix,
+        absl::Now() + options_.slice_duration);
+    LogIfError(KVServerContextMap()->SafeMetric().LogHistogram<
+               kCacheCleanupBacklog>(
+        static_cast<double>(progress.remaining_deleted_values)));
+    LogIfError(KVServerContextMap()->SafeMetric().LogHistogram<
+               kCacheCleanupLagInMicros>(absl::ToDoubleMicroseconds(
+        absl::Now() - cleanup.requested_at)));
+    bool all_done;
+    {
+      absl::MutexLock lock(&mutex_);
+      in_slice_ = false;
+      if (progress.done) {
+        VLOG(2) << "Removed deleted values up to "
+                << cleanup.logical_commit_time << " for prefix " << prefix;
+        // A cleanup requested during the slice has a later time, and stays.
+        if (auto it = pending_cleanups_.find(prefix);
+            it != pending_cleanups_.end() &&
+            it->second.logical_commit_time == cleanup.logical_commit_time) {
+          pending_cleanups_.erase(it);
+        }
+      }
+      all_done = pending_cleanups_.empty();
+      if (!all_done) {
+        mutex_.AwaitWithTimeout(absl::Condition(&stopped_),
+                                options_.pause_between_slices);
+      }
+    }
+    if (all_done) {
+      // The removed values are free, but still held by the allocator.
+      ServerMemoryReleaser().MaybeRelease();
+    }
+  }
+}
+
+std::unique_ptr<TombstoneCleaner> TombstoneCleaner::Create(Cache& cache,
+                                                           Options options) {
+  auto cleaner =
+      absl::WrapUnique(new TombstoneCleaner(cache, std::move(options)));
+  cleaner->thread_ = std::thread(&TombstoneCleaner::Run, cleaner.get());
+  return cleaner;
+}
+
+}  // namespace kv_server
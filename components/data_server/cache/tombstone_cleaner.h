@@ -0,0 +1,92 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_CACHE_TOMBSTONE_CLEANER_H_
+#define COMPONENTS_DATA_SERVER_CACHE_TOMBSTONE_CLEANER_H_
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "absl/container/btree_map.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "components/data_server/cache/cache.h"
+
+namespace kv_server {
+
+// Removes the values deleted from a cache on a background thread.
+//
+// Cleanups are requested per prefix and run in slices of `slice_duration`
+// through `Cache::RemoveDeletedKeysSlice`. The cleaner waits
+// `pause_between_slices` after each slice, so lookups and updates that queue
+// on the cache locks get to run between slices instead of waiting for the whole
+// cleanup.
+class TombstoneCleaner {
+ public:
+  struct Options {
+    absl::Duration slice_duration = absl::Milliseconds(5);
+    absl::Duration pause_between_slices = absl::Milliseconds(5);
+  };
+
+  // Stops the background thread. Scheduled cleanups that aren't done are
+  // dropped.
+  ~TombstoneCleaner();
+
+  // Requests the removal of the values deleted at or before
+  // `logical_commit_time` for `prefix`. Replaces a pending request for the
+  // same prefix with an older time.
+  void ScheduleCleanup(int64_t logical_commit_time, std::string_view prefix)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Blocks until every scheduled cleanup is done.
+  void WaitUntilDone() ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Starts the background thread. `cache` must outlive the cleaner.
+  static std::unique_ptr<TombstoneCleaner> Create(Cache& cache,
+                                                  Options options);
+
+ private:
+  struct PendingCleanup {
+    int64_t logical_commit_time;
+    // When the first cleanup that isn't done yet was requested.
+    absl::Time requested_at;
+  };
+
+  TombstoneCleaner(Cache& cache, Options options);
+
+  void Run() ABSL_LOCKS_EXCLUDED(mutex_);
+  bool HasWorkOrStopped() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  bool IsDone() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  Cache& cache_;
+  const Options options_;
+  absl::Mutex mutex_;
+  // Keyed by prefix. Sorted, so that prefixes are cleaned up in turns.
+  absl::btree_map<std::string, PendingCleanup> pending_cleanups_
+      ABSL_GUARDED_BY(mutex_);
+  // Prefix of the last slice.
+  std::string last_prefix_ ABSL_GUARDED_BY(mutex_);
+  // Whether a slice is running.
+  bool in_slice_ ABSL_GUARDED_BY(mutex_) = false;
+  bool stopped_ ABSL_GUARDED_BY(mutex_) = false;
+  std::thread thread_;
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_CACHE_TOMBSTONE_CLEANER_H_
@@ -0,0 +1,100 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/data_server/cache/tombstone_cleaner.h"
+
+#include <memory>
+#include <string>
+
+#include "absl/strings/str_cat.h"
+#include "components/data_server/cache/key_value_cache.h"
+#include "components/data_server/cache/mocks.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+using testing::_;
+using testing::Return;
+using testing::UnorderedElementsAre;
+
+class TombstoneCleanerTest : public ::testing::Test {
+ protected:
+  TombstoneCleanerTest() {
+    InitMetricsContextMap();
+    scope_metrics_context_ = std::make_unique<ScopeMetricsContext>();
+    request_context_ =
+        std::make_unique<RequestContext>(*scope_metrics_context_);
+  }
+  RequestContext& GetRequestContext() { return *request_context_; }
+  std::unique_ptr<ScopeMetricsContext> scope_metrics_context_;
+  std::unique_ptr<RequestContext> request_context_;
+};
+
+TEST_F(TombstoneCleanerTest, RunsSlicesUntilDone) {
+  MockCache cache;
+  EXPECT_CALL(cache, RemoveDeletedKeysSlice(5, "prefix", _))
+      .WillOnce(Return(
+          Cache::CleanupProgress{.done = false, .remaining_deleted_values = 2}))
+      .WillOnce(Return(Cache::CleanupProgress{.done = true}));
+  auto cleaner = TombstoneCleaner::Create(
+      cache, {.slice_duration = absl::Milliseconds(1),
+              .pause_between_slices = absl::Milliseconds(1)});
+  cleaner->ScheduleCleanup(5, "prefix");
+  cleaner->WaitUntilDone();
+}
+
+TEST_F(TombstoneCleanerTest, KeepsLatestTimeForPrefix) {
+  MockCache cache;
+  EXPECT_CALL(cache, RemoveDeletedKeysSlice(5, "", _))
+      .WillOnce(Return(Cache::CleanupProgress{.done = true}));
+  EXPECT_CALL(cache, RemoveDeletedKeysSlice(7, "other_prefix", _))
+      .WillOnce(Return(Cache::CleanupProgress{.done = true}));
+  auto cleaner = TombstoneCleaner::Create(cache, {});
+  cleaner->ScheduleCleanup(5, "");
+  cleaner->ScheduleCleanup(3, "");
+  cleaner->ScheduleCleanup(7, "other_prefix");
+  cleaner->WaitUntilDone();
+}
+
+TEST_F(TombstoneCleanerTest, RemovesDeletedValuesFromCache) {
+  std::unique_ptr<Cache> cache = KeyValueCache::Create();
+  std::vector<std::string_view> values = {"v1", "v2"};
+  for (int i = 0; i < 1000; i++) {
+    const std::string key = absl::StrCat("key", i);
+    cache->UpdateKeyValue(key, "value", 1);
+    cache->DeleteKey(key, 2);
+    cache->UpdateKeyValueSet(key, absl::MakeSpan(values), 1);
+    cache->DeleteValuesInSet(key, absl::MakeSpan(values), 2);
+  }
+  cache->UpdateKeyValue("kept_key", "value", 3);
+  auto cleaner = TombstoneCleaner::Create(
+      *cache, {.slice_duration = absl::ZeroDuration(),
+               .pause_between_slices = absl::ZeroDuration()});
+  cleaner->ScheduleCleanup(2, "");
+  cleaner->WaitUntilDone();
+  EXPECT_EQ(cache
+                ->RemoveDeletedKeysSlice(2, "", absl::InfiniteFuture())
+                .remaining_deleted_values,
+            0);
+  // Updates older than the cleanup are dropped.
+  cache->UpdateKeyValue("key1", "late_value", 2);
+  EXPECT_THAT(
+      cache->GetKeyValuePairs(GetRequestContext(), {"key1", "kept_key"}),
+      UnorderedElementsAre(KVPairEq("kept_key", "value")));
+}
+
+}  // namespace
+}  // namespace kv_server
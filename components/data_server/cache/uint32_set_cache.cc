@@ -0,0 +1,507 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data_server/cache/uint32_set_cache.h"
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/node_hash_map.h"
+#include "absl/log/log.h"
+#include "absl/memory/memory.h"
+
+namespace kv_server {
+namespace {
+
+// Number of mutations passed at once by `ExportMutations`.
+constexpr int kExportBatchSize = 1024;
+
+// Live members of an integer set updated at the same time, copied by
+// `ExportMutations`.
+struct ExportedUInt32Set {
+  std::string key;
+  int64_t logical_commit_time = 0;
+  std::vector<uint32_t> values;
+};
+
+// Result that serves the keys with an integer set from their bitmaps, and the
+// other keys from the result of the wrapped cache.
+class UInt32SetResult : public GetKeyValueSetResult {
+ public:
+  explicit UInt32SetResult(std::unique_ptr<GetKeyValueSetResult> result)
+      : result_(std::move(result)) {}
+
+  absl::flat_hash_set<std::string_view> GetValueSet(
+      std::string_view key) const override {
+    const IdBitmap* ids = FindIds(key);
+    if (ids == nullptr) {
+      return result_->GetValueSet(key);
+    }
+    absl::flat_hash_set<std::string_view> value_set;
+    value_set.reserve(ids->Cardinality());
+    absl::MutexLock lock(&mutex_);
+    ids->ForEach([this, &value_set](uint32_t id) {
+      value_set.emplace(DecimalLocked(id));
+    });
+    return value_set;
+  }
+
+  std::shared_ptr<const absl::flat_hash_set<std::string_view>>
+  GetValueSetSnapshot(std::string_view key) const override {
+    const IdBitmap* ids = FindIds(key);
+    if (ids == nullptr) {
+      return result_->GetValueSetSnapshot(key);
+    }
+    // The snapshot owns the strings of the members, since it may outlive the
+    // result.
+    struct Snapshot {
+      std::vector<std::string> members;
+      absl::flat_hash_set<std::string_view> value_set;
+    };
+    auto snapshot = std::make_shared<Snapshot>();
+    snapshot->members.reserve(ids->Cardinality());
+    ids->ForEach([&snapshot](uint32_t id) {
+      snapshot->members.push_back(std::to_string(id));
+    });
+    snapshot->value_set.reserve(snapshot->members.size());
+    for (const std::string& member : snapshot->members) {
+      snapshot->value_set.emplace(member);
+    }
+    const absl::flat_hash_set<std::string_view>* value_set =
+        &snapshot->value_set;
+    return std::shared_ptr<const absl::flat_hash_set<std::string_view>>(
+        std::move(snapshot), value_set);
+  }
+
+  // The ids of the bitmaps of integer sets are their members, which can't be
+  // combined with the ids of another cache.
+  bool HasValueBitmaps() const override {
+    if (live_ids_map_.empty()) {
+      return result_->HasValueBitmaps();
+    }
+    return all_keys_have_bitmaps_;
+  }
+
+  IdBitmap GetValueBitmap(std::string_view key) const override {
+    if (live_ids_map_.empty()) {
+      return result_->GetValueBitmap(key);
+    }
+    const IdBitmap* ids = FindIds(key);
+    return ids == nullptr ? IdBitmap() : *ids;
+  }
+
+  std::string_view GetValueForId(uint32_t id) const override {
+    if (live_ids_map_.empty()) {
+      return result_->GetValueForId(id);
+    }
+    absl::MutexLock lock(&mutex_);
+    return DecimalLocked(id);
+  }
+
+  std::optional<uint64_t> GetValueSetVersion(
+      std::string_view key) const override {
+    if (FindIds(key) != nullptr) {
+      return std::nullopt;
+    }
+    return result_->GetValueSetVersion(key);
+  }
+
+  // Adds the live members of `key`. `live_ids` must stay valid while
+  // `key_lock` is held.
+  void AddKeyValueBitmap(std::string_view key, const IdBitmap* live_ids,
+                         std::unique_ptr<absl::ReaderMutexLock> key_lock) {
+    read_locks_.push_back(std::move(key_lock));
+    live_ids_map_.emplace(key, live_ids);
+  }
+
+  void set_all_keys_have_bitmaps(bool all_keys_have_bitmaps) {
+    all_keys_have_bitmaps_ = all_keys_have_bitmaps;
+  }
+
+ private:
+  // Sets are only added by `UInt32SetCache` and `result_`.
+  void AddKeyValueSet(
+      std::string_view key, absl::flat_hash_set<std::string_view> value_set,
+      std::unique_ptr<absl::ReaderMutexLock> key_lock) override {}
+  void AddKeyValueSetSnapshot(
+      std::string_view key,
+      std::shared_ptr<const absl::flat_hash_set<std::string_view>> value_set)
+      override {}
+
+  const IdBitmap* FindIds(std::string_view key) const {
+    const auto it = live_ids_map_.find(key);
+    return it == live_ids_map_.end() ? nullptr : it->second;
+  }
+
+  // Returns the decimal string of `id`, which stays valid for the lifetime of
+  // the result.
+  std::string_view DecimalLocked(uint32_t id) const
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    auto [it, inserted] = decimals_.try_emplace(id);
+    if (inserted) {
+      it->second = std::to_string(id);
+    }
+    return it->second;
+  }
+
+  std::unique_ptr<GetKeyValueSetResult> result_;
+  std::vector<std::unique_ptr<absl::ReaderMutexLock>> read_locks_;
+  absl::flat_hash_map<std::string_view, const IdBitmap*> live_ids_map_;
+  bool all_keys_have_bitmaps_ = false;
+  // Nodes, so that the strings don't move when more are added.
+  mutable absl::Mutex mutex_;
+  mutable absl::node_hash_map<uint32_t, std::string> decimals_
+      ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace
+
+UInt32SetCache::UInt32SetCache(std::unique_ptr<Cache> cache)
+    : cache_(std::move(cache)) {}
+
+absl::flat_hash_map<std::string, std::string> UInt32SetCache::GetKeyValuePairs(
+    const RequestContext& request_context,
+    const absl::flat_hash_set<std::string_view>& key_set) const {
+  return cache_->GetKeyValuePairs(request_context, key_set);
+}
+
+GetKeyValuePairsResult UInt32SetCache::GetKeyValuePairViews(
+    const RequestContext& request_context,
+    const absl::flat_hash_set<std::string_view>& key_set) const {
+  return cache_->GetKeyValuePairViews(request_context, key_set);
+}
+
+GetKeyValuePairsResult UInt32SetCache::GetHashedKeyValuePairViews(
+    const RequestContext& request_context,
+    absl::Span<const HashedKey> keys) const {
+  return cache_->GetHashedKeyValuePairViews(request_context, keys);
+}
+
+absl::StatusOr<std::vector<std::string>> UInt32SetCache::GetKeysByPrefix(
+    std::string_view key_prefix, int limit) const {
+  return cache_->GetKeysByPrefix(key_prefix, limit);
+}
+
+absl::StatusOr<std::vector<std::string>> UInt32SetCache::GetSetsContaining(
+    std::string_view member) const {
+  return cache_->GetSetsContaining(member);
+}
+
+std::unique_ptr<GetKeyValueSetResult> UInt32SetCache::GetKeyValueSet(
+    const RequestContext& request_context,
+    const absl::flat_hash_set<std::string_view>& key_set) const {
+  std::unique_ptr<GetKeyValueSetResult> result =
+      cache_->GetKeyValueSet(request_context, key_set);
+  if (!has_sets_.load(std::memory_order_acquire)) {
+    return result;
+  }
+  auto uint32_result = std::make_unique<UInt32SetResult>(std::move(result));
+  absl::ReaderMutexLock lock(&set_map_mutex_);
+  size_t num_found = 0;
+  for (const auto& key : key_set) {
+    const auto key_itr = key_to_value_set_map_.find(key);
+    if (key_itr == key_to_value_set_map_.end()) {
+      continue;
+    }
+    auto set_lock =
+        std::make_unique<absl::ReaderMutexLock>(&key_itr->second->mutex);
+    uint32_result->AddKeyValueBitmap(key, &key_itr->second->live_ids,
+                                     std::move(set_lock));
+    ++num_found;
+  }
+  uint32_result->set_all_keys_have_bitmaps(num_found > 0 &&
+                                           num_found == key_set.size());
+  return uint32_result;
+}
+
+void UInt32SetCache::UpdateKeyValue(std::string_view key,
+                                    std::string_view value,
+                                    int64_t logical_commit_time,
+                                    std::string_view prefix) {
+  cache_->UpdateKeyValue(key, value, logical_commit_time, prefix);
+}
+
+void UInt32SetCache::UpdateKeyValueSet(std::string_view key,
+                                       absl::Span<std::string_view> value_set,
+                                       int64_t logical_commit_time,
+                                       std::string_view prefix) {
+  cache_->UpdateKeyValueSet(key, value_set, logical_commit_time, prefix);
+}
+
+void UInt32SetCache::DeleteKey(std::string_view key,
+                               int64_t logical_commit_time,
+                               std::string_view prefix) {
+  cache_->DeleteKey(key, logical_commit_time, prefix);
+}
+
+void UInt32SetCache::DeleteValuesInSet(std::string_view key,
+                                       absl::Span<std::string_view> value_set,
+                                       int64_t logical_commit_time,
+                                       std::string_view prefix) {
+  cache_->DeleteValuesInSet(key, value_set, logical_commit_time, prefix);
+}
+
+void UInt32SetCache::UpdateKeyValueUInt32Set(
+    std::string_view key, absl::Span<const uint32_t> value_set,
+    int64_t logical_commit_time, std::string_view prefix) {
+  std::unique_ptr<absl::MutexLock> key_lock;
+  ValueSetEntry* entry;
+  {
+    absl::MutexLock lock_map(&set_map_mutex_);
+    if (logical_commit_time <= max_cleanup_logical_commit_time_map_[prefix] ||
+        value_set.empty()) {
+      VLOG(1) << "Skipping the update of [" << key << "] at "
+              << logical_commit_time;
+      return;
+    }
+    auto key_itr = key_to_value_set_map_.find(key);
+    if (key_itr == key_to_value_set_map_.end()) {
+      key_itr = key_to_value_set_map_
+                    .emplace(key, std::make_unique<ValueSetEntry>())
+                    .first;
+      key_bytes_ += key.size();
+      has_sets_.store(true, std::memory_order_release);
+    }
+    key_lock = std::make_unique<absl::MutexLock>(&key_itr->second->mutex);
+    entry = key_itr->second.get();
+  }  // end locking map
+  for (const uint32_t value : value_set) {
+    auto [value_itr, inserted] = entry->value_set.try_emplace(value);
+    if (inserted) {
+      num_values_.fetch_add(1, std::memory_order_relaxed);
+    } else if (value_itr->second.last_logical_commit_time >=
+               logical_commit_time) {
+      continue;
+    }
+    value_itr->second = SetValueMeta{logical_commit_time,
+                                     /*is_deleted=*/false};
+    entry->live_ids.Add(value);
+  }
+}
+
+void UInt32SetCache::DeleteValuesInUInt32Set(
+    std::string_view key, absl::Span<const uint32_t> value_set,
+    int64_t logical_commit_time, std::string_view prefix) {
+  std::unique_ptr<absl::MutexLock> key_lock;
+  ValueSetEntry* entry;
+  {
+    absl::MutexLock lock_map(&set_map_mutex_);
+    if (logical_commit_time <= max_cleanup_logical_commit_time_map_[prefix] ||
+        value_set.empty()) {
+      return;
+    }
+    auto key_itr = key_to_value_set_map_.find(key);
+    if (key_itr == key_to_value_set_map_.end()) {
+      // The deleted members of a missing key are still added, so that late
+      // updates with smaller logical commit times don't add them back.
+      key_itr = key_to_value_set_map_
+                    .emplace(key, std::make_unique<ValueSetEntry>())
+                    .first;
+      key_bytes_ += key.size();
+      has_sets_.store(true, std::memory_order_release);
+    }
+    key_lock = std::make_unique<absl::MutexLock>(&key_itr->second->mutex);
+    entry = key_itr->second.get();
+  }  // end locking map
+  std::vector<uint32_t> deleted_values;
+  for (const uint32_t value : value_set) {
+    auto [value_itr, inserted] = entry->value_set.try_emplace(value);
+    if (inserted) {
+      num_values_.fetch_add(1, std::memory_order_relaxed);
+    } else if (value_itr->second.last_logical_commit_time >=
+               logical_commit_time) {
+      continue;
+    }
+    value_itr->second = SetValueMeta{logical_commit_time,
+                                     /*is_deleted=*/true};
+    entry->live_ids.Remove(value);
+    deleted_values.push_back(value);
+  }
+  if (deleted_values.empty()) {
+    return;
+  }
+  // Release key lock before locking the map to avoid potential deadlock
+  // caused by cycle in the ordering of lock acquisitions
+  key_lock.reset();
+  absl::MutexLock lock_map(&set_map_mutex_);
+  deleted_set_nodes_map_[prefix][logical_commit_time][std::string(key)].insert(
+      deleted_values.begin(), deleted_values.end());
+}
+
+void UInt32SetCache::ApplyMutations(absl::Span<const Mutation> mutations,
+                                    std::string_view prefix) {
+  std::vector<Mutation> other_mutations;
+  other_mutations.reserve(mutations.size());
+  for (const Mutation& mutation : mutations) {
+    switch (mutation.type) {
+      case Mutation::Type::kUpdateUInt32Set:
+        UpdateKeyValueUInt32Set(mutation.key, mutation.uint32_value_set,
+                                mutation.logical_commit_time, prefix);
+        break;
+      case Mutation::Type::kDeleteValuesInUInt32Set:
+        DeleteValuesInUInt32Set(mutation.key, mutation.uint32_value_set,
+                                mutation.logical_commit_time, prefix);
+        break;
+      default:
+        other_mutations.push_back(mutation);
+        break;
+    }
+  }
+  if (other_mutations.size() == mutations.size()) {
+    cache_->ApplyMutations(mutations, prefix);
+  } else if (!other_mutations.empty()) {
+    cache_->ApplyMutations(other_mutations, prefix);
+  }
+}
+
+void UInt32SetCache::RemoveDeletedKeys(int64_t logical_commit_time,
+                                       std::string_view prefix) {
+  cache_->RemoveDeletedKeys(logical_commit_time, prefix);
+  CleanUpValueSetMap(logical_commit_time, prefix);
+}
+
+Cache::CleanupProgress UInt32SetCache::RemoveDeletedKeysSlice(
+    int64_t logical_commit_time, std::string_view prefix,
+    absl::Time deadline) {
+  const CleanupProgress progress =
+      cache_->RemoveDeletedKeysSlice(logical_commit_time, prefix, deadline);
+  if (progress.done) {
+    CleanUpValueSetMap(logical_commit_time, prefix);
+  }
+  return progress;
+}
+
+void UInt32SetCache::CleanUpValueSetMap(int64_t logical_commit_time,
+                                        std::string_view prefix) {
+  absl::MutexLock lock_set_map(&set_map_mutex_);
+  int64_t& max_cleanup_logical_commit_time =
+      max_cleanup_logical_commit_time_map_[prefix];
+  max_cleanup_logical_commit_time =
+      std::max(max_cleanup_logical_commit_time, logical_commit_time);
+  auto deleted_nodes_per_prefix = deleted_set_nodes_map_.find(prefix);
+  if (deleted_nodes_per_prefix == deleted_set_nodes_map_.end()) {
+    return;
+  }
+  auto& nodes_by_time = deleted_nodes_per_prefix->second;
+  const auto end = nodes_by_time.upper_bound(logical_commit_time);
+  for (auto delete_itr = nodes_by_time.begin(); delete_itr != end;
+       ++delete_itr) {
+    for (const auto& [key, values] : delete_itr->second) {
+      auto key_itr = key_to_value_set_map_.find(key);
+      if (key_itr == key_to_value_set_map_.end()) {
+        continue;
+      }
+      {
+        absl::MutexLock key_lock(&key_itr->second->mutex);
+        ValueSet& value_set = key_itr->second->value_set;
+        for (const uint32_t value : values) {
+          // Skips members updated again after their deletion.
+          if (auto value_itr = value_set.find(value);
+              value_itr != value_set.end() && value_itr->second.is_deleted &&
+              value_itr->second.last_logical_commit_time <=
+                  logical_commit_time) {
+            value_set.erase(value_itr);
+            num_values_.fetch_sub(1, std::memory_order_relaxed);
+          }
+        }
+      }
+      if (key_itr->second->value_set.empty()) {
+        key_bytes_ -= key_itr->first.size();
+        key_to_value_set_map_.erase(key_itr);
+      }
+    }
+  }
+  nodes_by_time.erase(nodes_by_time.begin(), end);
+  if (nodes_by_time.empty()) {
+    deleted_set_nodes_map_.erase(deleted_nodes_per_prefix);
+  }
+}
+
+absl::Status UInt32SetCache::ExportMutations(
+    absl::FunctionRef<void(std::string_view prefix,
+                           absl::Span<const Mutation> mutations)>
+        fn) const {
+  if (absl::Status status = cache_->ExportMutations(fn); !status.ok()) {
+    return status;
+  }
+  std::vector<ExportedUInt32Set> sets;
+  {
+    absl::ReaderMutexLock lock(&set_map_mutex_);
+    for (const auto& [key, entry] : key_to_value_set_map_) {
+      absl::ReaderMutexLock key_lock(&entry->mutex);
+      // The members updated at the same time are exported together.
+      absl::btree_map<int64_t, std::vector<uint32_t>> values_by_time;
+      for (const auto& [value, meta] : entry->value_set) {
+        if (!meta.is_deleted) {
+          values_by_time[meta.last_logical_commit_time].push_back(value);
+        }
+      }
+      for (auto& [logical_commit_time, values] : values_by_time) {
+        sets.push_back(
+            ExportedUInt32Set{.key = key,
+                              .logical_commit_time = logical_commit_time,
+                              .values = std::move(values)});
+      }
+    }
+  }
+  std::vector<Mutation> mutations;
+  mutations.reserve(std::min<size_t>(sets.size(), kExportBatchSize));
+  for (const ExportedUInt32Set& set : sets) {
+    mutations.push_back(
+        Mutation{.type = Mutation::Type::kUpdateUInt32Set,
+                 .key = set.key,
+                 .logical_commit_time = set.logical_commit_time,
+                 .uint32_value_set = set.values});
+    if (mutations.size() == kExportBatchSize) {
+      fn("", mutations);
+      mutations.clear();
+    }
+  }
+  if (!mutations.empty()) {
+    fn("", mutations);
+  }
+  return absl::OkStatus();
+}
+
+absl::flat_hash_map<std::string, Cache::MemoryUsage>
+UInt32SetCache::GetMemoryUsage() const {
+  auto memory_usage = cache_->GetMemoryUsage();
+  absl::ReaderMutexLock lock(&set_map_mutex_);
+  if (key_to_value_set_map_.empty()) {
+    return memory_usage;
+  }
+  MemoryUsage& usage = memory_usage[""];
+  usage.set_key_bytes += key_bytes_;
+  usage.set_value_bytes += num_values_.load(std::memory_order_relaxed) *
+                           (sizeof(uint32_t) + sizeof(SetValueMeta));
+  usage.hash_table_bytes +=
+      key_to_value_set_map_.size() *
+      (sizeof(std::string) + sizeof(std::unique_ptr<ValueSetEntry>) +
+       sizeof(ValueSetEntry));
+  return memory_usage;
+}
+
+std::string UInt32SetCache::DebugMemoryReport(int num_largest) const {
+  return cache_->DebugMemoryReport(num_largest);
+}
+
+std::unique_ptr<Cache> UInt32SetCache::Create(std::unique_ptr<Cache> cache) {
+  return absl::WrapUnique(new UInt32SetCache(std::move(cache)));
+}
+
+}  // namespace kv_server
@@ -0,0 +1,181 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_CACHE_UINT32_SET_CACHE_H_
+#define COMPONENTS_DATA_SERVER_CACHE_UINT32_SET_CACHE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/btree_map.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/synchronization/mutex.h"
+#include "components/data_server/cache/cache.h"
+#include "components/query/id_bitmap.h"
+
+namespace kv_server {
+
+// Cache that stores the sets of 32 bit unsigned integers natively, as the
+// members themselves and a bitmap of the live ones, instead of as decimal
+// strings. The bitmaps are handed out to the query engine as they are, so
+// queries over integer sets neither parse nor hash strings.
+//
+// Lookup results serve the keys with an integer set from this cache and the
+// other keys from `cache`, which everything else is delegated to. The members
+// of integer sets are only turned into decimal strings when a caller asks for
+// the strings. A key is expected to hold either a string set or an integer
+// set; if it holds both, lookups return the integer set.
+class UInt32SetCache : public Cache {
+ public:
+  absl::flat_hash_map<std::string, std::string> GetKeyValuePairs(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override;
+
+  GetKeyValuePairsResult GetKeyValuePairViews(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override;
+
+  GetKeyValuePairsResult GetHashedKeyValuePairViews(
+      const RequestContext& request_context,
+      absl::Span<const HashedKey> keys) const override;
+
+  absl::StatusOr<std::vector<std::string>> GetKeysByPrefix(
+      std::string_view key_prefix, int limit) const override;
+
+  absl::StatusOr<std::vector<std::string>> GetSetsContaining(
+      std::string_view member) const override;
+
+  // The result has value bitmaps if every key of `key_set` has an integer
+  // set, whose members are then the ids of the bitmaps.
+  std::unique_ptr<GetKeyValueSetResult> GetKeyValueSet(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override;
+
+  void UpdateKeyValue(std::string_view key, std::string_view value,
+                      int64_t logical_commit_time,
+                      std::string_view prefix = "") override;
+
+  void UpdateKeyValueSet(std::string_view key,
+                         absl::Span<std::string_view> value_set,
+                         int64_t logical_commit_time,
+                         std::string_view prefix = "") override;
+
+  void DeleteKey(std::string_view key, int64_t logical_commit_time,
+                 std::string_view prefix = "") override;
+
+  void DeleteValuesInSet(std::string_view key,
+                         absl::Span<std::string_view> value_set,
+                         int64_t logical_commit_time,
+                         std::string_view prefix = "") override;
+
+  // Same ordering rules as `KeyValueCache::UpdateKeyValueSet`.
+  void UpdateKeyValueUInt32Set(std::string_view key,
+                               absl::Span<const uint32_t> value_set,
+                               int64_t logical_commit_time,
+                               std::string_view prefix = "") override;
+
+  // The deleted members are kept until they are cleaned up, in case there
+  // are late-arriving updates to them.
+  void DeleteValuesInUInt32Set(std::string_view key,
+                               absl::Span<const uint32_t> value_set,
+                               int64_t logical_commit_time,
+                               std::string_view prefix = "") override;
+
+  // Applies the integer set mutations and passes the others to `cache` as one
+  // batch.
+  void ApplyMutations(absl::Span<const Mutation> mutations,
+                      std::string_view prefix = "") override;
+
+  void RemoveDeletedKeys(int64_t logical_commit_time,
+                         std::string_view prefix = "") override;
+
+  // The integer sets are cleaned up at once when `cache` is done.
+  CleanupProgress RemoveDeletedKeysSlice(int64_t logical_commit_time,
+                                         std::string_view prefix,
+                                         absl::Time deadline) override;
+
+  // Exports the live members of the integer sets after the mutations of
+  // `cache`, with prefix "".
+  absl::Status ExportMutations(
+      absl::FunctionRef<void(std::string_view prefix,
+                             absl::Span<const Mutation> mutations)>
+          fn) const override;
+
+  // The integer sets are counted with the key-value sets of prefix "".
+  absl::flat_hash_map<std::string, MemoryUsage> GetMemoryUsage()
+      const override;
+  std::string DebugMemoryReport(int num_largest) const override;
+
+  static std::unique_ptr<Cache> Create(std::unique_ptr<Cache> cache);
+
+ private:
+  struct SetValueMeta {
+    // Last logical commit time for a value
+    int64_t last_logical_commit_time = 0;
+    // Deleted values are kept until cleanup, see
+    // `KeyValueCache::SetValueMeta`.
+    bool is_deleted = false;
+  };
+  using ValueSet = absl::flat_hash_map<uint32_t, SetValueMeta>;
+  // Guarded by `mutex`.
+  struct ValueSetEntry {
+    absl::Mutex mutex;
+    ValueSet value_set;
+    // Members of `value_set` that are not deleted.
+    IdBitmap live_ids;
+  };
+
+  explicit UInt32SetCache(std::unique_ptr<Cache> cache);
+
+  void CleanUpValueSetMap(int64_t logical_commit_time, std::string_view prefix)
+      ABSL_LOCKS_EXCLUDED(set_map_mutex_);
+
+  std::unique_ptr<Cache> cache_;
+
+  mutable absl::Mutex set_map_mutex_;
+  // Read without the lock, so that lookups skip this cache until an integer
+  // set is added.
+  std::atomic<bool> has_sets_ = false;
+  // The key is the prefix and the value is the maximum timestamp that was
+  // passed to RemoveDeletedKeys.
+  absl::flat_hash_map<std::string, int64_t> max_cleanup_logical_commit_time_map_
+      ABSL_GUARDED_BY(set_map_mutex_);
+  absl::flat_hash_map<std::string, std::unique_ptr<ValueSetEntry>>
+      key_to_value_set_map_ ABSL_GUARDED_BY(set_map_mutex_);
+  // Bytes of the keys of `key_to_value_set_map_`.
+  int64_t key_bytes_ ABSL_GUARDED_BY(set_map_mutex_) = 0;
+  // Members of the sets, live or deleted, which are updated under the locks
+  // of their sets only.
+  std::atomic<int64_t> num_values_ = 0;
+  // Per prefix, sorted mapping from logical timestamp to the keys and members
+  // that were deleted at that time.
+  absl::flat_hash_map<
+      std::string,
+      absl::btree_map<int64_t,
+                      absl::flat_hash_map<std::string,
+                                          absl::flat_hash_set<uint32_t>>>>
+      deleted_set_nodes_map_ ABSL_GUARDED_BY(set_map_mutex_);
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_CACHE_UINT32_SET_CACHE_H_
@@ -0,0 +1,170 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data_server/cache/uint32_set_cache.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "components/data_server/cache/key_value_cache.h"
+#include "components/data_server/cache/mocks.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+using testing::ElementsAre;
+using testing::IsEmpty;
+using testing::UnorderedElementsAre;
+
+class UInt32SetCacheTest : public ::testing::Test {
+ protected:
+  UInt32SetCacheTest() {
+    InitMetricsContextMap();
+    scope_metrics_context_ = std::make_unique<ScopeMetricsContext>();
+    request_context_ =
+        std::make_unique<RequestContext>(*scope_metrics_context_);
+  }
+  std::unique_ptr<Cache> CreateCache() {
+    return UInt32SetCache::Create(KeyValueCache::Create());
+  }
+  RequestContext& GetRequestContext() { return *request_context_; }
+  std::unique_ptr<ScopeMetricsContext> scope_metrics_context_;
+  std::unique_ptr<RequestContext> request_context_;
+};
+
+TEST_F(UInt32SetCacheTest, ReturnsMembersAsBitmapsAndDecimalStrings) {
+  std::unique_ptr<Cache> cache = CreateCache();
+  std::vector<uint32_t> values = {7, 42, 100000};
+  cache->UpdateKeyValueUInt32Set("my_key", values, 1);
+  auto result = cache->GetKeyValueSet(GetRequestContext(), {"my_key"});
+  ASSERT_TRUE(result->HasValueBitmaps());
+  EXPECT_THAT(result->GetValueBitmap("my_key").ToVector(),
+              ElementsAre(7, 42, 100000));
+  EXPECT_EQ(result->GetValueForId(42), "42");
+  EXPECT_THAT(result->GetValueSet("my_key"),
+              UnorderedElementsAre("7", "42", "100000"));
+  EXPECT_THAT(*result->GetValueSetSnapshot("my_key"),
+              UnorderedElementsAre("7", "42", "100000"));
+}
+
+TEST_F(UInt32SetCacheTest, StringSetsAreDelegated) {
+  std::unique_ptr<Cache> cache = CreateCache();
+  std::vector<uint32_t> values = {1, 2};
+  cache->UpdateKeyValueUInt32Set("numbers", values, 1);
+  std::vector<std::string_view> strings = {"a", "b"};
+  cache->UpdateKeyValueSet("strings", absl::MakeSpan(strings), 1);
+  cache->UpdateKeyValue("pair", "value", 1);
+  auto result =
+      cache->GetKeyValueSet(GetRequestContext(), {"numbers", "strings"});
+  // The ids of the two caches can't be combined.
+  EXPECT_FALSE(result->HasValueBitmaps());
+  EXPECT_THAT(result->GetValueSet("numbers"), UnorderedElementsAre("1", "2"));
+  EXPECT_THAT(result->GetValueSet("strings"), UnorderedElementsAre("a", "b"));
+  EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(), {"pair"}),
+              UnorderedElementsAre(testing::Pair("pair", "value")));
+}
+
+TEST_F(UInt32SetCacheTest, DeletedMembersAreNotReturned) {
+  std::unique_ptr<Cache> cache = CreateCache();
+  std::vector<uint32_t> values = {1, 2, 3};
+  cache->UpdateKeyValueUInt32Set("my_key", values, 1);
+  std::vector<uint32_t> deleted = {2};
+  cache->DeleteValuesInUInt32Set("my_key", deleted, 2);
+  // Older than the deletion.
+  cache->UpdateKeyValueUInt32Set("my_key", deleted, 1);
+  EXPECT_THAT(cache->GetKeyValueSet(GetRequestContext(), {"my_key"})
+                  ->GetValueBitmap("my_key")
+                  .ToVector(),
+              ElementsAre(1, 3));
+  // Newer than the deletion.
+  cache->UpdateKeyValueUInt32Set("my_key", deleted, 3);
+  EXPECT_THAT(cache->GetKeyValueSet(GetRequestContext(), {"my_key"})
+                  ->GetValueBitmap("my_key")
+                  .ToVector(),
+              ElementsAre(1, 2, 3));
+}
+
+TEST_F(UInt32SetCacheTest, CleanupRemovesDeletedMembers) {
+  std::unique_ptr<Cache> cache = CreateCache();
+  std::vector<uint32_t> values = {1, 2};
+  cache->UpdateKeyValueUInt32Set("my_key", values, 1);
+  cache->DeleteValuesInUInt32Set("my_key", values, 2);
+  const int64_t bytes = cache->GetMemoryUsage()[""].set_value_bytes;
+  EXPECT_GT(bytes, 0);
+  cache->RemoveDeletedKeys(2);
+  EXPECT_EQ(cache->GetMemoryUsage()[""].set_value_bytes, 0);
+  // Older than the cleanup.
+  cache->UpdateKeyValueUInt32Set("my_key", values, 2);
+  EXPECT_THAT(cache->GetKeyValueSet(GetRequestContext(), {"my_key"})
+                  ->GetValueSet("my_key"),
+              IsEmpty());
+}
+
+TEST_F(UInt32SetCacheTest, ApplyMutationsAppliesIntegerSets) {
+  std::unique_ptr<Cache> cache = CreateCache();
+  std::vector<uint32_t> values = {5, 6};
+  std::vector<uint32_t> deleted = {6};
+  std::vector<Cache::Mutation> mutations = {
+      {.type = Cache::Mutation::Type::kUpdateKeyValue,
+       .key = "pair",
+       .value = "value",
+       .logical_commit_time = 1},
+      {.type = Cache::Mutation::Type::kUpdateUInt32Set,
+       .key = "my_key",
+       .logical_commit_time = 1,
+       .uint32_value_set = values},
+      {.type = Cache::Mutation::Type::kDeleteValuesInUInt32Set,
+       .key = "my_key",
+       .logical_commit_time = 2,
+       .uint32_value_set = deleted},
+  };
+  cache->ApplyMutations(mutations);
+  EXPECT_THAT(cache->GetKeyValueSet(GetRequestContext(), {"my_key"})
+                  ->GetValueSet("my_key"),
+              UnorderedElementsAre("5"));
+  EXPECT_THAT(cache->GetKeyValuePairs(GetRequestContext(), {"pair"}),
+              UnorderedElementsAre(testing::Pair("pair", "value")));
+}
+
+TEST_F(UInt32SetCacheTest, ExportsLiveMembers) {
+  std::unique_ptr<Cache> cache = CreateCache();
+  std::vector<uint32_t> values = {1, 2, 3};
+  cache->UpdateKeyValueUInt32Set("my_key", values, 1);
+  std::vector<uint32_t> deleted = {2};
+  cache->DeleteValuesInUInt32Set("my_key", deleted, 2);
+  std::vector<uint32_t> exported;
+  auto export_fn = [&exported](std::string_view prefix,
+                               absl::Span<const Cache::Mutation> mutations) {
+    for (const Cache::Mutation& mutation : mutations) {
+      if (mutation.type == Cache::Mutation::Type::kUpdateUInt32Set) {
+        EXPECT_EQ(mutation.key, "my_key");
+        EXPECT_EQ(mutation.logical_commit_time, 1);
+        exported.insert(exported.end(), mutation.uint32_value_set.begin(),
+                        mutation.uint32_value_set.end());
+      }
+    }
+  };
+  ASSERT_TRUE(cache->ExportMutations(export_fn).ok());
+  EXPECT_THAT(exported, UnorderedElementsAre(1, 3));
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -0,0 +1,159 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/data_server/cache/value_codec.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "zdict.h"
+#include "zstd.h"
+
+namespace kv_server {
+namespace {
+
+// Contexts hold the working memory of zstd. They are reused by the calls of
+// the same thread, and can't be shared between threads.
+ZSTD_CCtx* ThreadCompressionContext() {
+  thread_local std::unique_ptr<ZSTD_CCtx, decltype(&ZSTD_freeCCtx)> context(
+      ZSTD_createCCtx(), &ZSTD_freeCCtx);
+  return context.get();
+}
+
+ZSTD_DCtx* ThreadDecompressionContext() {
+  thread_local std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)> context(
+      ZSTD_createDCtx(), &ZSTD_freeDCtx);
+  return context.get();
+}
+
+}  // namespace
+
+ValueCodec::ValueCodec(ZSTD_CDict* compression_dictionary,
+                       ZSTD_DDict* decompression_dictionary,
+                       uint32_t dictionary_id, int level)
+    : compression_dictionary_(compression_dictionary),
+      decompression_dictionary_(decompression_dictionary),
+      dictionary_id_(dictionary_id),
+      level_(level) {}
+
+ValueCodec::~ValueCodec() {
+  ZSTD_freeCDict(compression_dictionary_);
+  ZSTD_freeDDict(decompression_dictionary_);
+}
+
+absl::StatusOr<std::string> ValueCodec::Compress(std::string_view value) const {
+  std::string compressed(ZSTD_compressBound(value.size()), '\0');
+  const size_t size =
+      compression_dictionary_ == nullptr
+          ? ZSTD_compressCCtx(ThreadCompressionContext(), compressed.data(),
+                              compressed.size(), value.data(), value.size(),
+                              level_)
+          : ZSTD_compress_usingCDict(ThreadCompressionContext(),
+                                     compressed.data(), compressed.size(),
+                                     value.data(), value.size(),
+                                     compression_dictionary_);
+  if (ZSTD_isError(size)) {
+    return absl::InternalError(
+        absl::StrCat("Failed to compress value: ", ZSTD_getErrorName(size)));
+  }
+  compressed.resize(size);
+  compressed.shrink_to_fit();
+  return compressed;
+}
+
+absl::StatusOr<std::string> ValueCodec::Decompress(
+    std::string_view compressed) const {
+  const unsigned long long content_size =
+      ZSTD_getFrameContentSize(compressed.data(), compressed.size());
+  if (content_size == ZSTD_CONTENTSIZE_ERROR ||
+      content_size == ZSTD_CONTENTSIZE_UNKNOWN) {
+    return absl::InvalidArgumentError("Value is not a zstd frame");
+  }
+  std::string value(content_size, '\0');
+  const size_t size =
+      decompression_dictionary_ == nullptr
+          ? ZSTD_decompressDCtx(ThreadDecompressionContext(), value.data(),
+                                value.size(), compressed.data(),
+                                compressed.size())
+          : ZSTD_decompress_usingDDict(
+                ThreadDecompressionContext(), value.data(), value.size(),
+                compressed.data(), compressed.size(),
+                decompression_dictionary_);
+  if (ZSTD_isError(size)) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Failed to decompress value: ", ZSTD_getErrorName(size)));
+  }
+  value.resize(size);
+  return value;
+}
+
+uint32_t ValueCodec::DictionaryIdOf(std::string_view compressed) {
+  return ZSTD_getDictID_fromFrame(compressed.data(), compressed.size());
+}
+
+absl::StatusOr<std::string> ValueCodec::TrainDictionary(
+    absl::Span<const std::string> samples, int64_t max_size) {
+  std::string buffer;
+  std::vector<size_t> sample_sizes;
+  sample_sizes.reserve(samples.size());
+  for (const std::string& sample : samples) {
+    buffer.append(sample);
+    sample_sizes.push_back(sample.size());
+  }
+  std::string dictionary(max_size, '\0');
+  const size_t size = ZDICT_trainFromBuffer(
+      dictionary.data(), dictionary.size(), buffer.data(), sample_sizes.data(),
+      static_cast<unsigned>(sample_sizes.size()));
+  if (ZDICT_isError(size)) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Failed to train dictionary: ", ZDICT_getErrorName(size)));
+  }
+  dictionary.resize(size);
+  return dictionary;
+}
+
+absl::StatusOr<std::unique_ptr<ValueCodec>> ValueCodec::Create(
+    std::string_view dictionary, int level) {
+  if (dictionary.empty()) {
+    return absl::WrapUnique(new ValueCodec(nullptr, nullptr, 0, level));
+  }
+  // Raw content dictionaries have no id, their values couldn't be told apart
+  // from values compressed without dictionary.
+  const uint32_t dictionary_id =
+      ZSTD_getDictID_fromDict(dictionary.data(), dictionary.size());
+  if (dictionary_id == 0) {
+    return absl::InvalidArgumentError("Dictionary is not a zstd dictionary");
+  }
+  // Both dictionaries copy `dictionary`.
+  ZSTD_CDict* compression_dictionary =
+      ZSTD_createCDict(dictionary.data(), dictionary.size(), level);
+  ZSTD_DDict* decompression_dictionary =
+      ZSTD_createDDict(dictionary.data(), dictionary.size());
+  if (compression_dictionary == nullptr ||
+      decompression_dictionary == nullptr) {
+    ZSTD_freeCDict(compression_dictionary);
+    ZSTD_freeDDict(decompression_dictionary);
+    return absl::InvalidArgumentError("Failed to load dictionary");
+  }
+  return absl::WrapUnique(new ValueCodec(compression_dictionary,
+                                         decompression_dictionary,
+                                         dictionary_id, level));
+}
+
+}  // namespace kv_server
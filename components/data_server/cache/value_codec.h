@@ -0,0 +1,83 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_CACHE_VALUE_CODEC_H_
+#define COMPONENTS_DATA_SERVER_CACHE_VALUE_CODEC_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "absl/status/statusor.h"
+#include "absl/types/span.h"
+
+struct ZSTD_CDict_s;
+struct ZSTD_DDict_s;
+
+namespace kv_server {
+
+// Compresses cache values with zstd, optionally with a dictionary trained on
+// values like the ones to compress. Small values that share most of their
+// structure, e.g. JSON objects with the same fields, compress a lot better
+// with a dictionary than on their own.
+//
+// Compressed values carry the id of their dictionary, see
+// `DictionaryIdOf`, so that the owner can keep the codecs of older
+// dictionaries to decompress them.
+//
+// Thread safe.
+class ValueCodec {
+ public:
+  ~ValueCodec();
+  ValueCodec(const ValueCodec&) = delete;
+  ValueCodec& operator=(const ValueCodec&) = delete;
+
+  absl::StatusOr<std::string> Compress(std::string_view value) const;
+  absl::StatusOr<std::string> Decompress(std::string_view compressed) const;
+
+  // 0 if the codec has no dictionary.
+  uint32_t dictionary_id() const { return dictionary_id_; }
+
+  // Returns the id of the dictionary that `compressed` was compressed with, 0
+  // if none.
+  static uint32_t DictionaryIdOf(std::string_view compressed);
+
+  // Trains a dictionary of at most `max_size` bytes on `samples`.
+  static absl::StatusOr<std::string> TrainDictionary(
+      absl::Span<const std::string> samples, int64_t max_size);
+
+  // Compresses at zstd `level`, with `dictionary` unless it is empty.
+  // `dictionary` must be in the zstd dictionary format, e.g. trained by
+  // `TrainDictionary`.
+  static absl::StatusOr<std::unique_ptr<ValueCodec>> Create(
+      std::string_view dictionary, int level);
+
+ private:
+  ValueCodec(ZSTD_CDict_s* compression_dictionary,
+             ZSTD_DDict_s* decompression_dictionary, uint32_t dictionary_id,
+             int level);
+
+  // Both null if the codec has no dictionary.
+  ZSTD_CDict_s* compression_dictionary_;
+  ZSTD_DDict_s* decompression_dictionary_;
+  uint32_t dictionary_id_;
+  int level_;
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_CACHE_VALUE_CODEC_H_
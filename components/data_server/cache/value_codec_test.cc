@@ -0,0 +1,85 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/data_server/cache/value_codec.h"
+
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+// JSON objects with the same fields and different values.
+std::vector<std::string> JsonValues(int num_values) {
+  std::vector<std::string> values;
+  for (int i = 0; i < num_values; ++i) {
+    values.push_back(absl::StrCat(
+        R"({"renderUrl": "https://ads.example/creative/)", i,
+        R"(", "metadata": {"campaignId": )", i * 7,
+        R"(, "advertiser": "advertiser)", i % 13,
+        R"(", "sizes": ["300x250", "728x90"], "bid": )", i % 97, "}}"));
+  }
+  return values;
+}
+
+TEST(ValueCodecTest, CompressesWithoutDictionary) {
+  auto codec = ValueCodec::Create(/*dictionary=*/"", /*level=*/3);
+  ASSERT_TRUE(codec.ok()) << codec.status();
+  EXPECT_EQ((*codec)->dictionary_id(), 0);
+  const std::string value(10000, 'a');
+  auto compressed = (*codec)->Compress(value);
+  ASSERT_TRUE(compressed.ok()) << compressed.status();
+  EXPECT_LT(compressed->size(), value.size());
+  EXPECT_EQ(ValueCodec::DictionaryIdOf(*compressed), 0);
+  auto decompressed = (*codec)->Decompress(*compressed);
+  ASSERT_TRUE(decompressed.ok()) << decompressed.status();
+  EXPECT_EQ(*decompressed, value);
+}
+
+TEST(ValueCodecTest, TrainedDictionaryCompressesSmallValuesBetter) {
+  const std::vector<std::string> samples = JsonValues(2000);
+  auto dictionary = ValueCodec::TrainDictionary(samples, /*max_size=*/4096);
+  ASSERT_TRUE(dictionary.ok()) << dictionary.status();
+  auto codec = ValueCodec::Create(*dictionary, /*level=*/3);
+  ASSERT_TRUE(codec.ok()) << codec.status();
+  EXPECT_NE((*codec)->dictionary_id(), 0);
+  auto plain_codec = ValueCodec::Create(/*dictionary=*/"", /*level=*/3);
+  ASSERT_TRUE(plain_codec.ok()) << plain_codec.status();
+
+  const std::string value = JsonValues(3000).back();
+  auto compressed = (*codec)->Compress(value);
+  ASSERT_TRUE(compressed.ok()) << compressed.status();
+  auto plain_compressed = (*plain_codec)->Compress(value);
+  ASSERT_TRUE(plain_compressed.ok()) << plain_compressed.status();
+  EXPECT_LT(compressed->size(), plain_compressed->size());
+  EXPECT_EQ(ValueCodec::DictionaryIdOf(*compressed),
+            (*codec)->dictionary_id());
+  auto decompressed = (*codec)->Decompress(*compressed);
+  ASSERT_TRUE(decompressed.ok()) << decompressed.status();
+  EXPECT_EQ(*decompressed, value);
+}
+
+TEST(ValueCodecTest, RejectsInvalidInput) {
+  EXPECT_FALSE(ValueCodec::Create("not a dictionary", /*level=*/3).ok());
+  auto codec = ValueCodec::Create(/*dictionary=*/"", /*level=*/3);
+  ASSERT_TRUE(codec.ok()) << codec.status();
+  EXPECT_FALSE((*codec)->Decompress("not compressed").ok());
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -0,0 +1,100 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/data_server/cache/value_dictionary.h"
+
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "absl/log/check.h"
+#include "absl/synchronization/mutex.h"
+
+namespace kv_server {
+
+ValueDictionary::ValueDictionary()
+    : chunks_(std::make_unique<std::atomic<std::string*>[]>(kNumChunks)) {}
+
+ValueDictionary::~ValueDictionary() {
+  for (uint32_t i = 0; i < kNumChunks; i++) {
+    delete[] chunks_[i].load(std::memory_order_relaxed);
+  }
+}
+
+std::string& ValueDictionary::Slot(uint32_t id) const {
+  return chunks_[id >> kChunkBits].load(
+      std::memory_order_acquire)[id & (kChunkSize - 1)];
+}
+
+uint32_t ValueDictionary::Intern(std::string_view value) {
+  absl::MutexLock lock(&mutex_);
+  if (const auto it = ids_.find(value); it != ids_.end()) {
+    ref_counts_[it->second]++;
+    return it->second;
+  }
+  uint32_t id;
+  if (free_ids_.empty()) {
+    CHECK_LT(ref_counts_.size(), uint64_t{kNumChunks} * kChunkSize)
+        << "Too many distinct values";
+    id = ref_counts_.size();
+    ref_counts_.push_back(0);
+    std::atomic<std::string*>& chunk = chunks_[id >> kChunkBits];
+    if (chunk.load(std::memory_order_relaxed) == nullptr) {
+      chunk.store(new std::string[kChunkSize], std::memory_order_release);
+    }
+  } else {
+    id = free_ids_.back();
+    free_ids_.pop_back();
+  }
+  std::string& slot = Slot(id);
+  slot.assign(value);
+  ref_counts_[id] = 1;
+  ids_.emplace(slot, id);
+  return id;
+}
+
+void ValueDictionary::AddReference(uint32_t id) {
+  absl::MutexLock lock(&mutex_);
+  DCHECK_GT(ref_counts_[id], 0u);
+  ref_counts_[id]++;
+}
+
+void ValueDictionary::Release(uint32_t id) {
+  absl::MutexLock lock(&mutex_);
+  DCHECK_GT(ref_counts_[id], 0u);
+  if (--ref_counts_[id] > 0) {
+    return;
+  }
+  std::string& slot = Slot(id);
+  ids_.erase(slot);
+  std::string().swap(slot);
+  free_ids_.push_back(id);
+}
+
+std::optional<uint32_t> ValueDictionary::Find(std::string_view value) const {
+  absl::MutexLock lock(&mutex_);
+  if (const auto it = ids_.find(value); it != ids_.end()) {
+    return it->second;
+  }
+  return std::nullopt;
+}
+
+std::string_view ValueDictionary::Get(uint32_t id) const { return Slot(id); }
+
+size_t ValueDictionary::size() const {
+  absl::MutexLock lock(&mutex_);
+  return ids_.size();
+}
+
+}  // namespace kv_server
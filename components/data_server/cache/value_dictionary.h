@@ -0,0 +1,92 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_CACHE_VALUE_DICTIONARY_H_
+#define COMPONENTS_DATA_SERVER_CACHE_VALUE_DICTIONARY_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+
+namespace kv_server {
+
+// Reference counted dictionary that maps strings to dense 32 bit ids.
+//
+// Every distinct string is stored once, no matter how many holders interned
+// it. Ids of strings whose reference count drops to zero are reused.
+//
+// `Intern` and `Release` are thread safe. `Get` takes no lock. It may be
+// called concurrently with other calls as long as the caller holds a
+// reference to `id` that was acquired before, e.g. because the caller reads
+// the id from a data structure whose writer interned it under the same lock.
+class ValueDictionary {
+ public:
+  ValueDictionary();
+  ~ValueDictionary();
+
+  ValueDictionary(const ValueDictionary&) = delete;
+  ValueDictionary& operator=(const ValueDictionary&) = delete;
+
+  // Returns the id of `value` and adds one reference to it.
+  uint32_t Intern(std::string_view value) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Adds one reference to `id`, which must already hold one.
+  void AddReference(uint32_t id) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Drops one reference to `id`. The id may be reused once no references are
+  // left.
+  void Release(uint32_t id) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Returns the id of `value` if it is stored, without adding a reference.
+  // The id is only meaningful while the caller otherwise knows that a
+  // reference to it is held.
+  std::optional<uint32_t> Find(std::string_view value) const
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Returns the string with the given `id`.
+  std::string_view Get(uint32_t id) const;
+
+  // Number of distinct strings currently stored.
+  size_t size() const ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  static constexpr int kChunkBits = 16;
+  static constexpr uint32_t kChunkSize = 1 << kChunkBits;
+  static constexpr uint32_t kNumChunks = 1 << (32 - kChunkBits);
+
+  // Strings never move once stored, so that `ids_` and `Get` can hand out
+  // views of them.
+  std::string& Slot(uint32_t id) const;
+
+  mutable absl::Mutex mutex_;
+  // Chunks are allocated on demand and only freed by the destructor.
+  std::unique_ptr<std::atomic<std::string*>[]> chunks_;
+  // Keys point into the chunks.
+  absl::flat_hash_map<std::string_view, uint32_t> ids_ ABSL_GUARDED_BY(mutex_);
+  std::vector<uint32_t> ref_counts_ ABSL_GUARDED_BY(mutex_);
+  std::vector<uint32_t> free_ids_ ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_CACHE_VALUE_DICTIONARY_H_
@@ -0,0 +1,105 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/data_server/cache/value_dictionary.h"
+
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+TEST(ValueDictionaryTest, SameValueGetsSameId) {
+  ValueDictionary dictionary;
+  const uint32_t id1 = dictionary.Intern("value1");
+  const uint32_t id2 = dictionary.Intern("value2");
+  EXPECT_NE(id1, id2);
+  EXPECT_EQ(dictionary.Intern("value1"), id1);
+  EXPECT_EQ(dictionary.Get(id1), "value1");
+  EXPECT_EQ(dictionary.Get(id2), "value2");
+  EXPECT_EQ(dictionary.size(), 2);
+}
+
+TEST(ValueDictionaryTest, ValueIsKeptUntilLastReferenceIsReleased) {
+  ValueDictionary dictionary;
+  const uint32_t id = dictionary.Intern("value");
+  dictionary.Intern("value");
+  dictionary.AddReference(id);
+  dictionary.Release(id);
+  dictionary.Release(id);
+  EXPECT_EQ(dictionary.Get(id), "value");
+  EXPECT_EQ(dictionary.size(), 1);
+  dictionary.Release(id);
+  EXPECT_EQ(dictionary.size(), 0);
+}
+
+TEST(ValueDictionaryTest, ReleasedIdsAreReused) {
+  ValueDictionary dictionary;
+  const uint32_t id = dictionary.Intern("old_value");
+  dictionary.Release(id);
+  EXPECT_EQ(dictionary.Intern("new_value"), id);
+  EXPECT_EQ(dictionary.Get(id), "new_value");
+  // The old value gets a new id when it comes back.
+  EXPECT_NE(dictionary.Intern("old_value"), id);
+}
+
+TEST(ValueDictionaryTest, FindDoesNotAddReference) {
+  ValueDictionary dictionary;
+  EXPECT_EQ(dictionary.Find("value"), std::nullopt);
+  const uint32_t id = dictionary.Intern("value");
+  EXPECT_EQ(dictionary.Find("value"), id);
+  dictionary.Release(id);
+  EXPECT_EQ(dictionary.Find("value"), std::nullopt);
+  EXPECT_EQ(dictionary.size(), 0);
+}
+
+TEST(ValueDictionaryTest, ValuesSpanMultipleChunks) {
+  ValueDictionary dictionary;
+  std::vector<uint32_t> ids;
+  for (int i = 0; i < 70000; i++) {
+    ids.push_back(dictionary.Intern(absl::StrCat("value", i)));
+  }
+  for (int i = 0; i < 70000; i += 7919) {
+    EXPECT_EQ(dictionary.Get(ids[i]), absl::StrCat("value", i));
+  }
+  EXPECT_EQ(dictionary.Get(ids.back()), "value69999");
+}
+
+TEST(ValueDictionaryTest, ConcurrentInternAndRelease) {
+  ValueDictionary dictionary;
+  auto worker = [&dictionary]() {
+    for (int i = 0; i < 1000; i++) {
+      const std::string value = absl::StrCat("value", i % 10);
+      const uint32_t id = dictionary.Intern(value);
+      EXPECT_EQ(dictionary.Get(id), value);
+      dictionary.Release(id);
+    }
+  };
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; i++) {
+    threads.emplace_back(worker);
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(dictionary.size(), 0);
+}
+
+}  // namespace
+}  // namespace kv_server
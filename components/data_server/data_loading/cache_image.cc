@@ -0,0 +1,460 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/data_server/data_loading/cache_image.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/log/log.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+
+namespace kv_server {
+namespace {
+
+using Mutation = Cache::Mutation;
+
+constexpr std::string_view kMagic = "KVIMAGE1";
+
+template <typename T>
+void AppendInteger(std::string& buffer, T value) {
+  buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void AppendString(std::string& buffer, std::string_view value) {
+  AppendInteger<uint32_t>(buffer, value.size());
+  buffer.append(value);
+}
+
+void AppendMap(std::string& buffer,
+               const absl::flat_hash_map<std::string, std::string>& map) {
+  AppendInteger<uint32_t>(buffer, map.size());
+  for (const auto& [key, value] : map) {
+    AppendString(buffer, key);
+    AppendString(buffer, value);
+  }
+}
+
+// Encodes a mutation as its type, logical commit time, key, and value or
+// values.
+void AppendMutation(std::string& buffer, const Mutation& mutation) {
+  AppendInteger<uint8_t>(buffer, static_cast<uint8_t>(mutation.type));
+  AppendInteger<int64_t>(buffer, mutation.logical_commit_time);
+  AppendString(buffer, mutation.key);
+  switch (mutation.type) {
+    case Mutation::Type::kUpdateKeyValue:
+      AppendString(buffer, mutation.value);
+      break;
+    case Mutation::Type::kUpdateKeyValueSet:
+    case Mutation::Type::kDeleteValuesInSet:
+      AppendInteger<uint32_t>(buffer, mutation.value_set.size());
+      for (std::string_view value : mutation.value_set) {
+        AppendString(buffer, value);
+      }
+      break;
+    case Mutation::Type::kUpdateUInt32Set:
+    case Mutation::Type::kDeleteValuesInUInt32Set:
+      AppendInteger<uint32_t>(buffer, mutation.uint32_value_set.size());
+      for (const uint32_t value : mutation.uint32_value_set) {
+        AppendInteger<uint32_t>(buffer, value);
+      }
+      break;
+    case Mutation::Type::kDeleteKey:
+      break;
+  }
+}
+
+// Reads the fields of an image, and fails once a field goes past the end.
+class ImageReader {
+ public:
+  explicit ImageReader(std::string_view data) : data_(data) {}
+
+  template <typename T>
+  std::optional<T> ReadInteger() {
+    if (data_.size() < sizeof(T)) {
+      return std::nullopt;
+    }
+    T value;
+    std::memcpy(&value, data_.data(), sizeof(T));
+    data_.remove_prefix(sizeof(T));
+    return value;
+  }
+
+  std::optional<std::string_view> ReadBytes(uint64_t size) {
+    if (data_.size() < size) {
+      return std::nullopt;
+    }
+    std::string_view bytes = data_.substr(0, size);
+    data_.remove_prefix(size);
+    return bytes;
+  }
+
+  std::optional<std::string_view> ReadString() {
+    const auto size = ReadInteger<uint32_t>();
+    if (!size.has_value()) {
+      return std::nullopt;
+    }
+    return ReadBytes(*size);
+  }
+
+  std::optional<absl::flat_hash_map<std::string, std::string>> ReadMap() {
+    const auto size = ReadInteger<uint32_t>();
+    if (!size.has_value()) {
+      return std::nullopt;
+    }
+    absl::flat_hash_map<std::string, std::string> map;
+    for (uint32_t i = 0; i < *size; ++i) {
+      const auto key = ReadString();
+      const auto value = ReadString();
+      if (!key.has_value() || !value.has_value()) {
+        return std::nullopt;
+      }
+      map.emplace(*key, *value);
+    }
+    return map;
+  }
+
+  bool empty() const { return data_.empty(); }
+
+ private:
+  std::string_view data_;
+};
+
+// Mutations of one prefix, as written by one call of the export function.
+struct Batch {
+  std::string_view prefix;
+  uint32_t num_mutations;
+  std::string_view payload;
+};
+
+// Mutations of a batch, with the storage of their value sets. Reused for the
+// batches of a thread.
+struct DecodedBatch {
+  std::vector<Mutation> mutations;
+  std::vector<std::string_view> value_sets;
+  // Copied out of the image, which doesn't align them.
+  std::vector<uint32_t> uint32_values;
+};
+
+// Decodes the mutations of `batch`. Their value sets are views into
+// `decoded.value_sets` and `decoded.uint32_values`.
+absl::Status DecodeBatch(const Batch& batch, DecodedBatch& decoded) {
+  std::vector<Mutation>& mutations = decoded.mutations;
+  std::vector<std::string_view>& value_sets = decoded.value_sets;
+  std::vector<uint32_t>& uint32_values = decoded.uint32_values;
+  mutations.clear();
+  value_sets.clear();
+  uint32_values.clear();
+  // Offset in `value_sets` or `uint32_values` and size of the value set of
+  // every mutation, made into spans once they are complete.
+  std::vector<std::pair<size_t, uint32_t>> value_set_ranges;
+  ImageReader reader(batch.payload);
+  const auto invalid = [&batch] {
+    return absl::DataLossError(
+        absl::StrCat("Invalid batch in the cache image for prefix ",
+                     batch.prefix));
+  };
+  for (uint32_t i = 0; i < batch.num_mutations; ++i) {
+    const auto type = reader.ReadInteger<uint8_t>();
+    const auto logical_commit_time = reader.ReadInteger<int64_t>();
+    const auto key = reader.ReadString();
+    if (!type.has_value() || !logical_commit_time.has_value() ||
+        !key.has_value() ||
+        *type >
+            static_cast<uint8_t>(Mutation::Type::kDeleteValuesInUInt32Set)) {
+      return invalid();
+    }
+    Mutation& mutation = mutations.emplace_back(
+        Mutation{.type = static_cast<Mutation::Type>(*type),
+                 .key = *key,
+                 .logical_commit_time = *logical_commit_time});
+    size_t value_set_offset = value_sets.size();
+    uint32_t value_set_size = 0;
+    switch (mutation.type) {
+      case Mutation::Type::kUpdateKeyValue: {
+        const auto value = reader.ReadString();
+        if (!value.has_value()) {
+          return invalid();
+        }
+        mutation.value = *value;
+        break;
+      }
+      case Mutation::Type::kUpdateKeyValueSet:
+      case Mutation::Type::kDeleteValuesInSet: {
+        const auto size = reader.ReadInteger<uint32_t>();
+        if (!size.has_value()) {
+          return invalid();
+        }
+        for (uint32_t j = 0; j < *size; ++j) {
+          const auto value = reader.ReadString();
+          if (!value.has_value()) {
+            return invalid();
+          }
+          value_sets.push_back(*value);
+        }
+        value_set_size = *size;
+        break;
+      }
+      case Mutation::Type::kUpdateUInt32Set:
+      case Mutation::Type::kDeleteValuesInUInt32Set: {
+        const auto size = reader.ReadInteger<uint32_t>();
+        if (!size.has_value()) {
+          return invalid();
+        }
+        value_set_offset = uint32_values.size();
+        for (uint32_t j = 0; j < *size; ++j) {
+          const auto value = reader.ReadInteger<uint32_t>();
+          if (!value.has_value()) {
+            return invalid();
+          }
+          uint32_values.push_back(*value);
+        }
+        value_set_size = *size;
+        break;
+      }
+      case Mutation::Type::kDeleteKey:
+        break;
+    }
+    value_set_ranges.emplace_back(value_set_offset, value_set_size);
+  }
+  if (!reader.empty()) {
+    return invalid();
+  }
+  for (size_t i = 0; i < mutations.size(); ++i) {
+    const auto [offset, size] = value_set_ranges[i];
+    if (size == 0) {
+      continue;
+    }
+    if (mutations[i].type == Mutation::Type::kUpdateUInt32Set ||
+        mutations[i].type == Mutation::Type::kDeleteValuesInUInt32Set) {
+      mutations[i].uint32_value_set =
+          absl::MakeConstSpan(&uint32_values[offset], size);
+    } else {
+      mutations[i].value_set = absl::MakeSpan(&value_sets[offset], size);
+    }
+  }
+  return absl::OkStatus();
+}
+
+// Calls `fn` with every batch on `num_threads` threads. Returns the first
+// error of `fn`, once every thread is done.
+template <typename Fn>
+absl::Status ForEachBatchInParallel(const std::vector<Batch>& batches,
+                                    int num_threads, Fn&& fn) {
+  std::atomic<size_t> next_batch = 0;
+  absl::Mutex mutex;
+  absl::Status status;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < std::max(num_threads, 1); ++i) {
+    threads.emplace_back([&] {
+      DecodedBatch decoded;
+      for (size_t batch = next_batch++; batch < batches.size();
+           batch = next_batch++) {
+        if (auto batch_status = fn(batches[batch], decoded);
+            !batch_status.ok()) {
+          absl::MutexLock lock(&mutex);
+          status.Update(std::move(batch_status));
+          // Makes the other threads stop after their current batch.
+          next_batch = batches.size();
+          return;
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  return status;
+}
+
+// Memory-maps a file for reading, and unmaps it on destruction.
+class MappedFile {
+ public:
+  ~MappedFile() {
+    if (data_ != nullptr) {
+      munmap(data_, size_);
+    }
+  }
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  std::string_view contents() const {
+    return std::string_view(static_cast<const char*>(data_), size_);
+  }
+
+  static absl::StatusOr<std::unique_ptr<MappedFile>> Open(
+      const std::string& path) {
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      if (errno == ENOENT) {
+        return absl::NotFoundError(absl::StrCat("No cache image at ", path));
+      }
+      return absl::InternalError(
+          absl::StrCat("Failed to open ", path, ": ", std::strerror(errno)));
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+      close(fd);
+      return absl::DataLossError(absl::StrCat(path, " is empty"));
+    }
+    void* data = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_SHARED, fd,
+                      /*offset=*/0);
+    close(fd);
+    if (data == MAP_FAILED) {
+      return absl::InternalError(
+          absl::StrCat("Failed to map ", path, ": ", std::strerror(errno)));
+    }
+    return absl::WrapUnique(new MappedFile(data, file_stat.st_size));
+  }
+
+ private:
+  MappedFile(void* data, size_t size) : data_(data), size_(size) {}
+
+  void* data_;
+  size_t size_;
+};
+
+}  // namespace
+
+absl::Status WriteCacheImage(const Cache& cache,
+                             const CacheImageWatermark& watermark,
+                             const std::string& path) {
+  const std::string temporary_path = absl::StrCat(path, ".tmp");
+  std::ofstream stream(temporary_path, std::ios::binary | std::ios::trunc);
+  if (!stream) {
+    return absl::InternalError(
+        absl::StrCat("Failed to create ", temporary_path));
+  }
+  std::string buffer(kMagic);
+  AppendMap(buffer, watermark.last_delta_basenames);
+  AppendMap(buffer, watermark.snapshot_basenames);
+  stream.write(buffer.data(), buffer.size());
+  int64_t num_mutations = 0;
+  std::string payload;
+  const absl::Status status = cache.ExportMutations(
+      [&stream, &buffer, &payload, &num_mutations](
+          std::string_view prefix, absl::Span<const Mutation> mutations) {
+        payload.clear();
+        for (const Mutation& mutation : mutations) {
+          AppendMutation(payload, mutation);
+        }
+        buffer.clear();
+        AppendString(buffer, prefix);
+        AppendInteger<uint32_t>(buffer, mutations.size());
+        AppendInteger<uint64_t>(buffer, payload.size());
+        stream.write(buffer.data(), buffer.size());
+        stream.write(payload.data(), payload.size());
+        num_mutations += mutations.size();
+      });
+  stream.close();
+  if (!status.ok() || !stream) {
+    std::remove(temporary_path.c_str());
+    return status.ok() ? absl::InternalError(absl::StrCat(
+                             "Failed to write ", temporary_path))
+                       : status;
+  }
+  if (std::rename(temporary_path.c_str(), path.c_str()) != 0) {
+    return absl::InternalError(absl::StrCat("Failed to rename ",
+                                            temporary_path, " to ", path, ": ",
+                                            std::strerror(errno)));
+  }
+  LOG(INFO) << "Wrote " << num_mutations << " mutations to cache image "
+            << path;
+  return absl::OkStatus();
+}
+
+absl::StatusOr<CacheImageWatermark> LoadCacheImage(const std::string& path,
+                                                   Cache& cache,
+                                                   int num_threads) {
+  auto file = MappedFile::Open(path);
+  if (!file.ok()) {
+    return file.status();
+  }
+  ImageReader reader((*file)->contents());
+  const auto invalid = [&path] {
+    return absl::DataLossError(
+        absl::StrCat(path, " is not a complete cache image"));
+  };
+  if (reader.ReadBytes(kMagic.size()) != kMagic) {
+    return invalid();
+  }
+  CacheImageWatermark watermark;
+  auto last_delta_basenames = reader.ReadMap();
+  auto snapshot_basenames = reader.ReadMap();
+  if (!last_delta_basenames.has_value() || !snapshot_basenames.has_value()) {
+    return invalid();
+  }
+  watermark.last_delta_basenames = *std::move(last_delta_basenames);
+  watermark.snapshot_basenames = *std::move(snapshot_basenames);
+  std::vector<Batch> batches;
+  int64_t num_mutations = 0;
+  while (!reader.empty()) {
+    const auto prefix = reader.ReadString();
+    const auto batch_size = reader.ReadInteger<uint32_t>();
+    const auto payload_size = reader.ReadInteger<uint64_t>();
+    if (!prefix.has_value() || !batch_size.has_value() ||
+        !payload_size.has_value()) {
+      return invalid();
+    }
+    const auto payload = reader.ReadBytes(*payload_size);
+    if (!payload.has_value()) {
+      return invalid();
+    }
+    batches.push_back({*prefix, *batch_size, *payload});
+    num_mutations += *batch_size;
+  }
+  LOG(INFO) << "Loading " << num_mutations << " mutations in "
+            << batches.size() << " batches from cache image " << path;
+  // Checks every batch first, so that a damaged image isn't half applied.
+  if (auto status = ForEachBatchInParallel(
+          batches, num_threads,
+          [](const Batch& batch, DecodedBatch& decoded) {
+            return DecodeBatch(batch, decoded);
+          });
+      !status.ok()) {
+    return status;
+  }
+  if (auto status = ForEachBatchInParallel(
+          batches, num_threads,
+          [&cache](const Batch& batch, DecodedBatch& decoded) {
+            if (auto status = DecodeBatch(batch, decoded); !status.ok()) {
+              return status;
+            }
+            cache.ApplyMutations(decoded.mutations, batch.prefix);
+            return absl::OkStatus();
+          });
+      !status.ok()) {
+    return status;
+  }
+  return watermark;
+}
+
+}  // namespace kv_server
@@ -0,0 +1,60 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_DATA_LOADING_CACHE_IMAGE_H_
+#define COMPONENTS_DATA_SERVER_DATA_LOADING_CACHE_IMAGE_H_
+
+#include <string>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "components/data_server/cache/cache.h"
+
+namespace kv_server {
+
+// Files that the data in a cache image was loaded from, so that a server
+// started from the image resumes loading after them.
+struct CacheImageWatermark {
+  // Last delta file loaded, per prefix.
+  absl::flat_hash_map<std::string, std::string> last_delta_basenames;
+  // Snapshot group loaded, per prefix.
+  absl::flat_hash_map<std::string, std::string> snapshot_basenames;
+};
+
+// Writes the contents of `cache`, see `Cache::ExportMutations`, and
+// `watermark` to a local file at `path`.
+//
+// The image is a sequence of batches of mutations, in a binary format that
+// loads without parsing records. It is written to a temporary file that is
+// renamed to `path` once complete, so a crash never leaves a partial image.
+absl::Status WriteCacheImage(const Cache& cache,
+                             const CacheImageWatermark& watermark,
+                             const std::string& path);
+
+// Applies the image at `path` to `cache`, which should be empty, with
+// `num_threads` threads applying batches in parallel. Returns the watermark
+// of the image.
+//
+// The whole image is checked before anything is applied, so `cache` is left
+// untouched if the image can't be read.
+absl::StatusOr<CacheImageWatermark> LoadCacheImage(const std::string& path,
+                                                   Cache& cache,
+                                                   int num_threads);
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_DATA_LOADING_CACHE_IMAGE_H_
@@ -0,0 +1,153 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/data_server/data_loading/cache_image.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "components/data_server/cache/key_value_cache.h"
+#include "components/data_server/cache/mocks.h"
+#include "components/data_server/cache/sharded_key_value_cache.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+using testing::Pair;
+using testing::UnorderedElementsAre;
+
+class CacheImageTest : public ::testing::Test {
+ protected:
+  CacheImageTest() {
+    InitMetricsContextMap();
+    scope_metrics_context_ = std::make_unique<ScopeMetricsContext>();
+    request_context_ =
+        std::make_unique<RequestContext>(*scope_metrics_context_);
+    path_ = absl::StrCat(
+        testing::TempDir(), "/",
+        testing::UnitTest::GetInstance()->current_test_info()->name());
+  }
+  ~CacheImageTest() override { std::remove(path_.c_str()); }
+
+  RequestContext& GetRequestContext() { return *request_context_; }
+  std::unique_ptr<ScopeMetricsContext> scope_metrics_context_;
+  std::unique_ptr<RequestContext> request_context_;
+  std::string path_;
+};
+
+TEST_F(CacheImageTest, LoadsWrittenImage) {
+  auto cache = KeyValueCache::Create(
+      {.min_value_size = 100, .trained_dictionary_size = 0});
+  cache->UpdateKeyValue("key1", "value1", 1);
+  cache->UpdateKeyValue("key2", std::string(1000, 'a'), 2, "prefix");
+  cache->DeleteKey("key3", 3);
+  std::vector<std::string_view> values = {"v1", "v2", "v3"};
+  cache->UpdateKeyValueSet("set", absl::MakeSpan(values), 4);
+  std::vector<std::string_view> deleted_values = {"v2"};
+  cache->DeleteValuesInSet("set", absl::MakeSpan(deleted_values), 5);
+  const CacheImageWatermark watermark{
+      .last_delta_basenames = {{"", "DELTA_2"}, {"prefix", "DELTA_3"}},
+      .snapshot_basenames = {{"", "SNAPSHOT_1"}},
+  };
+  ASSERT_TRUE(WriteCacheImage(*cache, watermark, path_).ok());
+
+  auto loaded_cache = ShardedKeyValueCache::Create(/*num_shards=*/4);
+  auto loaded_watermark =
+      LoadCacheImage(path_, *loaded_cache, /*num_threads=*/3);
+  ASSERT_TRUE(loaded_watermark.ok()) << loaded_watermark.status();
+  EXPECT_THAT(loaded_watermark->last_delta_basenames,
+              UnorderedElementsAre(Pair("", "DELTA_2"),
+                                   Pair("prefix", "DELTA_3")));
+  EXPECT_THAT(loaded_watermark->snapshot_basenames,
+              UnorderedElementsAre(Pair("", "SNAPSHOT_1")));
+  EXPECT_THAT(loaded_cache->GetKeyValuePairs(GetRequestContext(),
+                                             {"key1", "key2", "key3"}),
+              UnorderedElementsAre(KVPairEq("key1", "value1"),
+                                   KVPairEq("key2", std::string(1000, 'a'))));
+  EXPECT_THAT(
+      loaded_cache->GetKeyValueSet(GetRequestContext(), {"set"})
+          ->GetValueSet("set"),
+      UnorderedElementsAre("v1", "v3"));
+  // Deleted keys are kept, so that older updates are still skipped.
+  loaded_cache->UpdateKeyValue("key3", "old_value3", 2);
+  EXPECT_TRUE(
+      loaded_cache->GetKeyValuePairs(GetRequestContext(), {"key3"}).empty());
+}
+
+TEST_F(CacheImageTest, LoadsManyBatches) {
+  auto cache = KeyValueCache::Create();
+  for (int i = 0; i < 10000; ++i) {
+    cache->UpdateKeyValue(absl::StrCat("key", i), absl::StrCat("value", i), 1);
+  }
+  ASSERT_TRUE(WriteCacheImage(*cache, {}, path_).ok());
+  auto loaded_cache = KeyValueCache::Create();
+  ASSERT_TRUE(LoadCacheImage(path_, *loaded_cache, /*num_threads=*/4).ok());
+  for (int i = 0; i < 10000; ++i) {
+    const std::string key = absl::StrCat("key", i);
+    EXPECT_THAT(loaded_cache->GetKeyValuePairs(GetRequestContext(), {key}),
+                UnorderedElementsAre(KVPairEq(key, absl::StrCat("value", i))));
+  }
+}
+
+TEST_F(CacheImageTest, MissingImage) {
+  auto cache = KeyValueCache::Create();
+  EXPECT_EQ(LoadCacheImage(path_, *cache, /*num_threads=*/1).status().code(),
+            absl::StatusCode::kNotFound);
+}
+
+TEST_F(CacheImageTest, DamagedImageIsNotApplied) {
+  auto cache = KeyValueCache::Create();
+  for (int i = 0; i < 5000; ++i) {
+    cache->UpdateKeyValue(absl::StrCat("key", i), "value", 1);
+  }
+  ASSERT_TRUE(WriteCacheImage(*cache, {}, path_).ok());
+  std::string contents;
+  {
+    std::ifstream stream(path_, std::ios::binary);
+    contents.assign(std::istreambuf_iterator<char>(stream), {});
+  }
+  // Makes the key size of the first mutation larger than its batch.
+  const size_t first_key = contents.find("key");
+  ASSERT_NE(first_key, std::string::npos);
+  contents[first_key - sizeof(uint32_t) + 3] = '\x7f';
+  std::ofstream(path_, std::ios::binary | std::ios::trunc) << contents;
+
+  auto loaded_cache = KeyValueCache::Create();
+  EXPECT_EQ(
+      LoadCacheImage(path_, *loaded_cache, /*num_threads=*/2).status().code(),
+      absl::StatusCode::kDataLoss);
+  for (int i = 0; i < 5000; ++i) {
+    EXPECT_TRUE(loaded_cache
+                    ->GetKeyValuePairs(GetRequestContext(),
+                                       {absl::StrCat("key", i)})
+                    .empty());
+  }
+}
+
+TEST_F(CacheImageTest, CachesThatCantExportAreNotWritten) {
+  MockCache cache;
+  EXPECT_FALSE(WriteCacheImage(cache, {}, path_).ok());
+  EXPECT_FALSE(std::ifstream(path_).good());
+}
+
+}  // namespace
+}  // namespace kv_server
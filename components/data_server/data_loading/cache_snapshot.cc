@@ -0,0 +1,201 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "components/data_server/data_loading/cache_snapshot.h"
+
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/log/log.h"
+#include "absl/status/status.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "components/data/blob_storage/mapped_blob_reader.h"
+#include "public/constants.h"
+#include "public/data_loading/filename_utils.h"
+#include "public/data_loading/records_utils.h"
+#include "public/data_loading/writers/delta_record_stream_writer.h"
+#include "src/util/status_macro/status_macros.h"
+
+namespace kv_server {
+namespace {
+
+// Snapshot file of one prefix, written locally while the cache is exported.
+struct SnapshotFile {
+  const SnapshotMetadata* snapshot = nullptr;
+  std::string filename;
+  std::string path;
+  std::ofstream stream;
+  std::unique_ptr<DeltaRecordStreamWriter<std::ofstream>> writer;
+};
+
+absl::StatusOr<uint64_t> LogicalCommitTime(std::string_view filename) {
+  std::vector<std::string_view> name_parts =
+      absl::StrSplit(filename, kFileComponentDelimiter);
+  if (uint64_t logical_commit_time;
+      name_parts.size() > 1 &&
+      absl::SimpleAtoi(name_parts[1], &logical_commit_time)) {
+    return logical_commit_time;
+  }
+  return absl::InvalidArgumentError(
+      absl::StrCat("No logical commit time in file name: ", filename));
+}
+
+KeyValueMutationRecordStruct ToRecord(const Cache::Mutation& mutation) {
+  KeyValueMutationRecordStruct record{
+      .mutation_type = KeyValueMutationType::Update,
+      .logical_commit_time = mutation.logical_commit_time,
+      .key = mutation.key,
+  };
+  switch (mutation.type) {
+    case Cache::Mutation::Type::kUpdateKeyValue:
+      record.value = mutation.value;
+      break;
+    case Cache::Mutation::Type::kUpdateKeyValueSet:
+      record.value = std::vector<std::string_view>(mutation.value_set.begin(),
+                                                   mutation.value_set.end());
+      break;
+    case Cache::Mutation::Type::kDeleteKey:
+      record.mutation_type = KeyValueMutationType::Delete;
+      record.value = std::string_view();
+      break;
+    case Cache::Mutation::Type::kDeleteValuesInSet:
+      record.mutation_type = KeyValueMutationType::Delete;
+      record.value = std::vector<std::string_view>(mutation.value_set.begin(),
+                                                   mutation.value_set.end());
+      break;
+    case Cache::Mutation::Type::kUpdateUInt32Set:
+      record.value = std::vector<uint32_t>(mutation.uint32_value_set.begin(),
+                                           mutation.uint32_value_set.end());
+      break;
+    case Cache::Mutation::Type::kDeleteValuesInUInt32Set:
+      record.mutation_type = KeyValueMutationType::Delete;
+      record.value = std::vector<uint32_t>(mutation.uint32_value_set.begin(),
+                                           mutation.uint32_value_set.end());
+      break;
+  }
+  return record;
+}
+
+}  // namespace
+
+absl::StatusOr<absl::flat_hash_map<std::string, std::string>>
+WriteCacheSnapshots(
+    const Cache& cache,
+    const absl::flat_hash_map<std::string, SnapshotMetadata>& snapshots,
+    BlobStorageClient& blob_client, const CacheSnapshotOptions& options) {
+  // The writers keep a pointer to their stream, so the files don't move.
+  absl::flat_hash_map<std::string, std::unique_ptr<SnapshotFile>> files;
+  absl::flat_hash_map<std::string, std::string> basenames;
+  for (const auto& [prefix, snapshot] : snapshots) {
+    PS_ASSIGN_OR_RETURN(const uint64_t logical_commit_time,
+                        LogicalCommitTime(snapshot.ending_delta_file()));
+    auto file = std::make_unique<SnapshotFile>();
+    file->snapshot = &snapshot;
+    PS_ASSIGN_OR_RETURN(
+        file->filename,
+        ToFileGroupFileName(FileType::SNAPSHOT, logical_commit_time,
+                            options.shard_num, options.num_shards));
+    PS_ASSIGN_OR_RETURN(basenames[prefix],
+                        ToSnapshotFileName(logical_commit_time));
+    files[prefix] = std::move(file);
+  }
+  absl::Status status;
+  for (auto& [prefix, file] : files) {
+    file->path = absl::StrCat(options.local_directory, "/",
+                              std::hash<std::string>{}(prefix), "_",
+                              file->filename, ".tmp");
+    file->stream.open(file->path, std::ios::binary | std::ios::trunc);
+    if (!file->stream) {
+      status = absl::InternalError(absl::StrCat("Failed to open ", file->path));
+      break;
+    }
+    KVFileMetadata metadata;
+    *metadata.mutable_snapshot() = *file->snapshot;
+    metadata.mutable_sharding_metadata()->set_shard_num(options.shard_num);
+    auto writer = DeltaRecordStreamWriter<std::ofstream>::Create(
+        file->stream, {.enable_compression = options.enable_compression,
+                       .metadata = std::move(metadata)});
+    if (!writer.ok()) {
+      status = writer.status();
+      break;
+    }
+    file->writer = *std::move(writer);
+  }
+  if (status.ok()) {
+    status = cache.ExportMutations(
+        [&files, &status](std::string_view prefix,
+                          absl::Span<const Cache::Mutation> mutations) {
+          auto iter = files.find(prefix);
+          if (!status.ok() || iter == files.end()) {
+            return;
+          }
+          for (const Cache::Mutation& mutation : mutations) {
+            status = iter->second->writer->WriteRecord(
+                DataRecordStruct{.record = ToRecord(mutation)});
+            if (!status.ok()) {
+              return;
+            }
+          }
+        });
+  }
+  // A prefix without data still gets an empty snapshot, so that loaders
+  // skip its delta files up to the ending one.
+  for (auto& [prefix, file] : files) {
+    if (!status.ok()) {
+      break;
+    }
+    file->writer->Close();
+    file->stream.close();
+    if (status = file->writer->Status(); status.ok() && !file->stream) {
+      status =
+          absl::InternalError(absl::StrCat("Failed to write ", file->path));
+    }
+  }
+  for (const auto& [prefix, file] : files) {
+    if (!status.ok()) {
+      break;
+    }
+    auto reader = MappedBlobReader::Open(file->path);
+    if (!reader.ok()) {
+      status = reader.status();
+      break;
+    }
+    const BlobStorageClient::DataLocation location{
+        .bucket = options.bucket, .prefix = prefix, .key = file->filename};
+    status = blob_client.PutBlob(**reader, location);
+    if (status.ok()) {
+      LOG(INFO) << "Published cache snapshot " << location;
+    }
+  }
+  for (const auto& [prefix, file] : files) {
+    file->writer.reset();
+    file->stream.close();
+    std::remove(file->path.c_str());
+  }
+  if (!status.ok()) {
+    return status;
+  }
+  return basenames;
+}
+
+}  // namespace kv_server
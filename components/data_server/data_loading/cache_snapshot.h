@@ -0,0 +1,62 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef COMPONENTS_DATA_SERVER_DATA_LOADING_CACHE_SNAPSHOT_H_
+#define COMPONENTS_DATA_SERVER_DATA_LOADING_CACHE_SNAPSHOT_H_
+
+#include <cstdint>
+#include <string>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/statusor.h"
+#include "components/data/blob_storage/blob_storage_client.h"
+#include "components/data_server/cache/cache.h"
+#include "public/data_loading/riegeli_metadata.pb.h"
+
+namespace kv_server {
+
+struct CacheSnapshotOptions {
+  // Bucket the snapshots are published to.
+  std::string bucket;
+  // Shard of the cache. Each shard writes its own file of the snapshot group
+  // of a prefix, so a group is complete once every shard wrote it for the
+  // same ending delta file.
+  int32_t shard_num = 0;
+  int32_t num_shards = 1;
+  // Local directory the snapshot files are written to before they are
+  // uploaded.
+  std::string local_directory;
+  bool enable_compression = true;
+};
+
+// Writes the contents of `cache`, see `Cache::ExportMutations`, as a snapshot
+// file of each prefix of `snapshots`, with the prefix's `SnapshotMetadata`,
+// and uploads it to `options.bucket`. The snapshot of a prefix is named after
+// the logical commit time of its `ending_delta_file`, so that loaders pick
+// it up like a snapshot written offline. Prefixes of the cache that aren't in
+// `snapshots` are skipped. Returns the basename of the snapshot group written
+// per prefix.
+//
+// Updates applied to the cache concurrently may be included, which is safe
+// since the delta files after the snapshot apply them again.
+absl::StatusOr<absl::flat_hash_map<std::string, std::string>>
+WriteCacheSnapshots(
+    const Cache& cache,
+    const absl::flat_hash_map<std::string, SnapshotMetadata>& snapshots,
+    BlobStorageClient& blob_client, const CacheSnapshotOptions& options);
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_DATA_LOADING_CACHE_SNAPSHOT_H_
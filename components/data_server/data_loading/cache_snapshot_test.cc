@@ -0,0 +1,202 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "components/data_server/data_loading/cache_snapshot.h"
+
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "components/data/common/mocks.h"
+#include "components/data_server/cache/key_value_cache.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "public/data_loading/readers/delta_record_stream_reader.h"
+
+namespace kv_server {
+namespace {
+
+using testing::_;
+using testing::ElementsAre;
+using testing::Field;
+using testing::NiceMock;
+using testing::Pair;
+using testing::Return;
+using testing::UnorderedElementsAre;
+
+// Mutation type, logical commit time, key and values of a snapshot record.
+using RecordTuple = std::tuple<KeyValueMutationType, int64_t, std::string,
+                               std::vector<std::string>>;
+
+class CacheSnapshotTest : public ::testing::Test {
+ protected:
+  CacheSnapshotTest() {
+    ON_CALL(blob_client_, PutBlob)
+        .WillByDefault(
+            [this](BlobReader& reader,
+                   BlobStorageClient::DataLocation location) {
+              std::stringstream contents;
+              contents << reader.Stream().rdbuf();
+              blobs_.emplace_back(std::move(location), contents.str());
+              return absl::OkStatus();
+            });
+  }
+
+  static SnapshotMetadata Snapshot(std::string starting_file,
+                                   std::string ending_delta_file) {
+    SnapshotMetadata snapshot;
+    snapshot.set_starting_file(std::move(starting_file));
+    snapshot.set_ending_delta_file(std::move(ending_delta_file));
+    return snapshot;
+  }
+
+  static std::vector<RecordTuple> ReadRecords(const std::string& blob,
+                                              KVFileMetadata& metadata) {
+    std::stringstream stream(blob);
+    DeltaRecordStreamReader reader(stream);
+    auto read_metadata = reader.ReadMetadata();
+    EXPECT_TRUE(read_metadata.ok()) << read_metadata.status();
+    metadata = *read_metadata;
+    std::vector<RecordTuple> records;
+    EXPECT_TRUE(reader
+                    .ReadRecords([&records](DataRecordStruct data_record) {
+                      const auto& record =
+                          std::get<KeyValueMutationRecordStruct>(
+                              data_record.record);
+                      std::vector<std::string> values;
+                      if (const auto* value =
+                              std::get_if<std::string_view>(&record.value)) {
+                        values.emplace_back(*value);
+                      } else if (const auto* set = std::get_if<
+                                     std::vector<std::string_view>>(
+                                     &record.value)) {
+                        values.assign(set->begin(), set->end());
+                      }
+                      records.emplace_back(record.mutation_type,
+                                           record.logical_commit_time,
+                                           std::string(record.key), values);
+                      return absl::OkStatus();
+                    })
+                    .ok());
+    return records;
+  }
+
+  CacheSnapshotOptions Options() const {
+    return {.bucket = "bucket",
+            .shard_num = 1,
+            .num_shards = 2,
+            .local_directory = testing::TempDir()};
+  }
+
+  NiceMock<MockBlobStorageClient> blob_client_;
+  std::vector<std::pair<BlobStorageClient::DataLocation, std::string>> blobs_;
+};
+
+TEST_F(CacheSnapshotTest, PublishesSnapshotOfEachPrefix) {
+  auto cache = KeyValueCache::Create();
+  cache->UpdateKeyValue("key1", "value1", 1);
+  cache->DeleteKey("key2", 2);
+  std::vector<std::string_view> values = {"v1", "v2"};
+  cache->UpdateKeyValueSet("set", absl::MakeSpan(values), 3);
+  cache->UpdateKeyValue("key3", "value3", 4, "prefix");
+  cache->UpdateKeyValue("key4", "value4", 5, "other");
+
+  auto basenames = WriteCacheSnapshots(
+      *cache,
+      {{"", Snapshot("DELTA_0000000000000001", "DELTA_0000000000000003")},
+       {"prefix",
+        Snapshot("SNAPSHOT_0000000000000002", "DELTA_0000000000000004")}},
+      blob_client_, Options());
+  ASSERT_TRUE(basenames.ok()) << basenames.status();
+  EXPECT_THAT(*basenames,
+              UnorderedElementsAre(
+                  Pair("", "SNAPSHOT_0000000000000003"),
+                  Pair("prefix", "SNAPSHOT_0000000000000004")));
+  ASSERT_EQ(blobs_.size(), 2);
+  for (const auto& [location, blob] : blobs_) {
+    EXPECT_EQ(location.bucket, "bucket");
+    KVFileMetadata metadata;
+    const auto records = ReadRecords(blob, metadata);
+    EXPECT_EQ(metadata.sharding_metadata().shard_num(), 1);
+    if (location.prefix.empty()) {
+      EXPECT_EQ(location.key, "SNAPSHOT_0000000000000003_00001_OF_000002");
+      EXPECT_EQ(metadata.snapshot().starting_file(), "DELTA_0000000000000001");
+      EXPECT_EQ(metadata.snapshot().ending_delta_file(),
+                "DELTA_0000000000000003");
+      EXPECT_THAT(
+          records,
+          UnorderedElementsAre(
+              RecordTuple(KeyValueMutationType::Update, 1, "key1", {"value1"}),
+              RecordTuple(KeyValueMutationType::Delete, 2, "key2", {""}),
+              RecordTuple(KeyValueMutationType::Update, 3, "set",
+                          {"v1", "v2"})));
+    } else {
+      EXPECT_EQ(location.prefix, "prefix");
+      EXPECT_EQ(location.key, "SNAPSHOT_0000000000000004_00001_OF_000002");
+      EXPECT_THAT(records,
+                  ElementsAre(RecordTuple(KeyValueMutationType::Update, 4,
+                                          "key3", {"value3"})));
+    }
+  }
+}
+
+TEST_F(CacheSnapshotTest, PublishesEmptySnapshotOfPrefixWithoutData) {
+  auto cache = KeyValueCache::Create();
+  auto basenames = WriteCacheSnapshots(
+      *cache,
+      {{"empty",
+        Snapshot("DELTA_0000000000000001", "DELTA_0000000000000002")}},
+      blob_client_, Options());
+  ASSERT_TRUE(basenames.ok()) << basenames.status();
+  ASSERT_EQ(blobs_.size(), 1);
+  EXPECT_EQ(blobs_[0].first.prefix, "empty");
+  KVFileMetadata metadata;
+  EXPECT_THAT(ReadRecords(blobs_[0].second, metadata), ElementsAre());
+  EXPECT_EQ(metadata.snapshot().ending_delta_file(), "DELTA_0000000000000002");
+}
+
+TEST_F(CacheSnapshotTest, ReturnsUploadError) {
+  auto cache = KeyValueCache::Create();
+  cache->UpdateKeyValue("key1", "value1", 1);
+  EXPECT_CALL(blob_client_,
+              PutBlob(_, Field(&BlobStorageClient::DataLocation::key,
+                               "SNAPSHOT_0000000000000001_00001_OF_000002")))
+      .WillOnce(Return(absl::UnavailableError("upload failed")));
+  EXPECT_EQ(WriteCacheSnapshots(
+                *cache,
+                {{"", Snapshot("DELTA_0000000000000001",
+                               "DELTA_0000000000000001")}},
+                blob_client_, Options())
+                .status()
+                .code(),
+            absl::StatusCode::kUnavailable);
+}
+
+TEST_F(CacheSnapshotTest, RejectsEndingDeltaFileWithoutTime) {
+  auto cache = KeyValueCache::Create();
+  EXPECT_EQ(WriteCacheSnapshots(*cache, {{"", Snapshot("DELTA", "DELTA")}},
+                                blob_client_, Options())
+                .status()
+                .code(),
+            absl::StatusCode::kInvalidArgument);
+  EXPECT_TRUE(blobs_.empty());
+}
+
+}  // namespace
+}  // namespace kv_server
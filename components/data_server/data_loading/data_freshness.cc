@@ -0,0 +1,109 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data_server/data_loading/data_freshness.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <utility>
+
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "components/telemetry/server_definition.h"
+
+namespace kv_server {
+namespace {
+
+std::atomic<bool> logical_commit_times_are_epoch_micros = false;
+
+struct MaxLags {
+  absl::Mutex mutex;
+  absl::flat_hash_map<std::string, double> by_source_prefix
+      ABSL_GUARDED_BY(mutex);
+};
+
+MaxLags& GetMaxLags() {
+  // Never destroyed, data may be loaded at exit.
+  static MaxLags* const max_lags = new MaxLags();
+  return *max_lags;
+}
+
+std::string_view SourceName(DataFreshnessSource source) {
+  switch (source) {
+    case DataFreshnessSource::kSnapshot:
+      return "snapshot";
+    case DataFreshnessSource::kDelta:
+      return "delta";
+    case DataFreshnessSource::kRealtime:
+      return "realtime";
+  }
+  return "unknown";
+}
+
+template <const auto& definition>
+void LogLag(double lag_micros) {
+  if (ShouldSampleMetric<definition>()) {
+    LogIfError(KVServerContextMap()->SafeMetric().LogHistogram<definition>(
+        lag_micros));
+  }
+}
+
+}  // namespace
+
+void SetLogicalCommitTimesAreEpochMicros(bool epoch_micros) {
+  logical_commit_times_are_epoch_micros = epoch_micros;
+}
+
+void RecordDataFreshness(DataFreshnessSource source, std::string_view prefix,
+                         absl::Span<const Cache::Mutation> mutations,
+                         absl::Time applied_at) {
+  if (mutations.empty() ||
+      !logical_commit_times_are_epoch_micros.load(std::memory_order_relaxed)) {
+    return;
+  }
+  const int64_t applied_at_micros = absl::ToUnixMicros(applied_at);
+  double max_lag_micros = 0;
+  for (const Cache::Mutation& mutation : mutations) {
+    const double lag_micros = static_cast<double>(
+        std::max<int64_t>(applied_at_micros - mutation.logical_commit_time, 0));
+    max_lag_micros = std::max(max_lag_micros, lag_micros);
+    switch (source) {
+      case DataFreshnessSource::kSnapshot:
+        LogLag<kSnapshotFreshnessLagInMicros>(lag_micros);
+        break;
+      case DataFreshnessSource::kDelta:
+        LogLag<kDeltaFreshnessLagInMicros>(lag_micros);
+        break;
+      case DataFreshnessSource::kRealtime:
+        LogLag<kRealtimeFreshnessLagInMicros>(lag_micros);
+        break;
+    }
+  }
+  MaxLags& max_lags = GetMaxLags();
+  absl::MutexLock lock(&max_lags.mutex);
+  double& max_lag = max_lags.by_source_prefix[absl::StrCat(
+      SourceName(source), ":", prefix)];
+  max_lag = std::max(max_lag, max_lag_micros);
+}
+
+absl::flat_hash_map<std::string, double> TakeMaxDataFreshnessLagsInMicros() {
+  MaxLags& max_lags = GetMaxLags();
+  absl::MutexLock lock(&max_lags.mutex);
+  return std::exchange(max_lags.by_source_prefix, {});
+}
+
+}  // namespace kv_server
@@ -0,0 +1,59 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_DATA_LOADING_DATA_FRESHNESS_H_
+#define COMPONENTS_DATA_SERVER_DATA_LOADING_DATA_FRESHNESS_H_
+
+#include <string>
+#include <string_view>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "components/data_server/cache/cache.h"
+
+namespace kv_server {
+
+// The kind of data that mutations were loaded from.
+enum class DataFreshnessSource {
+  kSnapshot,
+  kDelta,
+  kRealtime,
+};
+
+// Whether the logical commit times of the data are microseconds since the
+// epoch, so that the freshness of the applied mutations can be measured.
+// Nothing is recorded until this is set.
+void SetLogicalCommitTimesAreEpochMicros(bool epoch_micros);
+
+// Records the time from the logical commit time of each of `mutations` to
+// `applied_at`, the time they were applied to the cache under `prefix`, in
+// the freshness lag histogram of `source`, and keeps the largest lag for
+// `TakeMaxDataFreshnessLagsInMicros`. Commit times after `applied_at` count
+// as no lag. Thread-safe.
+void RecordDataFreshness(DataFreshnessSource source, std::string_view prefix,
+                         absl::Span<const Cache::Mutation> mutations,
+                         absl::Time applied_at);
+
+// Returns the largest freshness lag of the mutations recorded since the
+// previous call, in microseconds, by source and prefix, e.g. "delta:" for the
+// delta files of the main prefix. Exported as the
+// `kMaxDataFreshnessLagInMicros` gauge.
+absl::flat_hash_map<std::string, double> TakeMaxDataFreshnessLagsInMicros();
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_DATA_LOADING_DATA_FRESHNESS_H_
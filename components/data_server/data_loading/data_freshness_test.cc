@@ -0,0 +1,90 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data_server/data_loading/data_freshness.h"
+
+#include <vector>
+
+#include "absl/time/time.h"
+#include "components/telemetry/server_definition.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+using testing::IsEmpty;
+using testing::Pair;
+using testing::UnorderedElementsAre;
+
+class DataFreshnessTest : public ::testing::Test {
+ protected:
+  DataFreshnessTest() {
+    InitMetricsContextMap();
+    TakeMaxDataFreshnessLagsInMicros();
+  }
+  ~DataFreshnessTest() override { SetLogicalCommitTimesAreEpochMicros(false); }
+
+  static Cache::Mutation Update(int64_t logical_commit_time) {
+    return Cache::Mutation{.type = Cache::Mutation::Type::kUpdateKeyValue,
+                           .key = "key",
+                           .value = "value",
+                           .logical_commit_time = logical_commit_time};
+  }
+};
+
+TEST_F(DataFreshnessTest, RecordsNothingUnlessCommitTimesAreEpochMicros) {
+  const absl::Time now = absl::Now();
+  const std::vector<Cache::Mutation> mutations = {
+      Update(absl::ToUnixMicros(now - absl::Seconds(1)))};
+  RecordDataFreshness(DataFreshnessSource::kDelta, "", mutations, now);
+  EXPECT_THAT(TakeMaxDataFreshnessLagsInMicros(), IsEmpty());
+}
+
+TEST_F(DataFreshnessTest, KeepsMaxLagBySourceAndPrefix) {
+  SetLogicalCommitTimesAreEpochMicros(true);
+  const absl::Time now = absl::FromUnixSeconds(1'700'000'000);
+  const std::vector<Cache::Mutation> delta = {
+      Update(absl::ToUnixMicros(now - absl::Seconds(2))),
+      Update(absl::ToUnixMicros(now - absl::Seconds(5)))};
+  const std::vector<Cache::Mutation> later_delta = {
+      Update(absl::ToUnixMicros(now - absl::Seconds(1)))};
+  const std::vector<Cache::Mutation> realtime = {
+      Update(absl::ToUnixMicros(now - absl::Milliseconds(20)))};
+  RecordDataFreshness(DataFreshnessSource::kDelta, "", delta, now);
+  RecordDataFreshness(DataFreshnessSource::kDelta, "", later_delta, now);
+  RecordDataFreshness(DataFreshnessSource::kDelta, "prefix", later_delta, now);
+  RecordDataFreshness(DataFreshnessSource::kRealtime, "", realtime, now);
+  EXPECT_THAT(TakeMaxDataFreshnessLagsInMicros(),
+              UnorderedElementsAre(Pair("delta:", 5'000'000),
+                                   Pair("delta:prefix", 1'000'000),
+                                   Pair("realtime:", 20'000)));
+  // Taken once.
+  EXPECT_THAT(TakeMaxDataFreshnessLagsInMicros(), IsEmpty());
+}
+
+TEST_F(DataFreshnessTest, CommitTimesInTheFutureHaveNoLag) {
+  SetLogicalCommitTimesAreEpochMicros(true);
+  const absl::Time now = absl::FromUnixSeconds(1'700'000'000);
+  const std::vector<Cache::Mutation> mutations = {
+      Update(absl::ToUnixMicros(now + absl::Seconds(1)))};
+  RecordDataFreshness(DataFreshnessSource::kSnapshot, "", mutations, now);
+  EXPECT_THAT(TakeMaxDataFreshnessLagsInMicros(),
+              UnorderedElementsAre(Pair("snapshot:", 0)));
+}
+
+}  // namespace
+}  // namespace kv_server
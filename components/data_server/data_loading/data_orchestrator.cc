@@ -14,20 +14,48 @@
 
 #include "components/data_server/data_loading/data_orchestrator.h"
 
+#include <unistd.h>
+
 #include <algorithm>
+#include <atomic>
 #include <deque>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
 #include <utility>
+#include <variant>
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/functional/any_invocable.h"
 #include "absl/functional/bind_front.h"
+#include "absl/hash/hash.h"
 #include "absl/log/log.h"
 #include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/types/span.h"
+#include "components/data/blob_storage/mapped_blob_reader.h"
 #include "components/data/file_group/file_group_search_utils.h"
+#include "components/data_server/cache/data_version.h"
+#include "components/data_server/data_loading/cache_image.h"
+#include "components/data_server/data_loading/cache_snapshot.h"
+#include "components/data_server/data_loading/data_freshness.h"
 #include "components/errors/retry.h"
+#include "components/util/load_governor.h"
+#include "components/util/memory_releaser.h"
+#include "components/util/startup_report.h"
+#include "components/util/thread_pool.h"
 #include "public/constants.h"
 #include "public/data_loading/data_loading_generated.h"
 #include "public/data_loading/filename_utils.h"
+#include "public/data_loading/readers/realtime_envelope.h"
 #include "public/data_loading/records_utils.h"
 #include "public/sharding/sharding_function.h"
 #include "src/telemetry/tracing.h"
@@ -49,11 +77,39 @@ class BlobRecordStream : public RecordStream {
   explicit BlobRecordStream(std::unique_ptr<BlobReader> blob_reader)
       : blob_reader_(std::move(blob_reader)) {}
   std::istream& Stream() { return blob_reader_->Stream(); }
+  std::optional<std::string_view> Contents() override {
+    return blob_reader_->Contents();
+  }
 
  private:
   std::unique_ptr<BlobReader> blob_reader_;
 };
 
+// Holds a stream of the shard copy of a file. The stream fails if the copy
+// can't be read, so that the file is loaded from the bucket instead.
+class ShardCopyRecordStream : public RecordStream {
+ public:
+  explicit ShardCopyRecordStream(const std::string& path) {
+    if (auto reader = MappedBlobReader::Open(path); reader.ok()) {
+      reader_ = *std::move(reader);
+    } else {
+      LOG(ERROR) << "Failed to read shard copy " << path << ": "
+                 << reader.status();
+      failed_stream_.setstate(std::ios::badbit);
+    }
+  }
+  std::istream& Stream() override {
+    return reader_ != nullptr ? reader_->Stream() : failed_stream_;
+  }
+  std::optional<std::string_view> Contents() override {
+    return reader_ != nullptr ? reader_->Contents() : std::nullopt;
+  }
+
+ private:
+  std::unique_ptr<MappedBlobReader> reader_;
+  std::istringstream failed_stream_;
+};
+
 void LogDataLoadingMetrics(std::string_view source,
                            const DataLoadingStats& data_loading_stats) {
   LogIfError(KVServerContextMap()
@@ -76,158 +132,743 @@ void LogDataLoadingMetrics(std::string_view source,
                            data_loading_stats.total_dropped_records)}}));
 }
 
-absl::Status ApplyUpdateMutation(std::string_view prefix,
-                                 const KeyValueMutationRecord& record,
-                                 Cache& cache) {
-  if (record.value_type() == Value::StringValue) {
-    cache.UpdateKeyValue(record.key()->string_view(),
-                         GetRecordValue<std::string_view>(record),
-                         record.logical_commit_time(), prefix);
-    return absl::OkStatus();
+// Logs the time the stages of one data load took, summed over the reader
+// threads. The histograms aggregate all data loads, so the breakdown of each
+// one is logged as well.
+void LogDataLoadingLatencies(std::string_view source,
+                             absl::Duration deserialize_latency,
+                             absl::Duration cache_apply_latency,
+                             absl::Duration lock_wait_latency) {
+  LogIfError(KVServerContextMap()
+                 ->SafeMetric()
+                 .LogHistogram<kDataLoadingDeserializeLatency>(
+                     absl::ToDoubleMicroseconds(deserialize_latency)));
+  LogIfError(KVServerContextMap()
+                 ->SafeMetric()
+                 .LogHistogram<kDataLoadingCacheApplyLatency>(
+                     absl::ToDoubleMicroseconds(cache_apply_latency)));
+  LogIfError(KVServerContextMap()
+                 ->SafeMetric()
+                 .LogHistogram<kDataLoadingLockWaitLatency>(
+                     absl::ToDoubleMicroseconds(lock_wait_latency)));
+  VLOG(1) << "Data load of " << source
+          << " spent deserializing: " << deserialize_latency
+          << ", applying to the cache: " << cache_apply_latency
+          << ", waiting for locks: " << lock_wait_latency;
+}
+
+// Number of record mutations that are applied to the cache at once.
+constexpr size_t kMutationBatchSize = 1000;
+// Number of partitions, by key hash, that the mutations of one data load are
+// split into. The batches of different partitions are applied concurrently.
+constexpr int kNumMutationPartitions = 8;
+// Number of full batches of a partition that may wait to be applied before
+// the record callbacks that add to the partition wait for them.
+constexpr size_t kMaxPendingBatchesPerPartition = 4;
+
+// Merges the key-value mutations of several data loads, keeping the latest
+// mutation of each key, so that keys that are overwritten many times are
+// applied to the cache once. Set mutations aren't merged, since the cache
+// keeps a commit time per set value.
+//
+// Thread safe, the record callbacks may run concurrently.
+class LastWriterWinsMerge {
+ public:
+  explicit LastWriterWinsMerge(DataFreshnessSource source) : source_(source) {}
+
+  void Add(Cache::Mutation::Type type, const KeyValueMutationRecord& record) {
+    Add(type, record.key()->string_view(),
+        type == Cache::Mutation::Type::kUpdateKeyValue
+            ? GetRecordValue<std::string_view>(record)
+            : std::string_view(),
+        record.logical_commit_time());
   }
-  if (record.value_type() == Value::StringSet) {
-    auto values = GetRecordValue<std::vector<std::string_view>>(record);
-    cache.UpdateKeyValueSet(record.key()->string_view(), absl::MakeSpan(values),
-                            record.logical_commit_time(), prefix);
-    return absl::OkStatus();
+
+  // `value` is ignored unless `type` is `kUpdateKeyValue`.
+  void Add(Cache::Mutation::Type type, std::string_view key,
+           std::string_view value, int64_t logical_commit_time) {
+    Partition& partition = partitions_[absl::Hash<std::string_view>{}(key) %
+                                       kNumMutationPartitions];
+    absl::MutexLock lock(&partition.mutex);
+    auto [iter, inserted] = partition.latest.try_emplace(key);
+    // Like the cache, keeps the first of mutations with the same time.
+    if (!inserted &&
+        iter->second.logical_commit_time >= logical_commit_time) {
+      return;
+    }
+    iter->second.type = type;
+    iter->second.logical_commit_time = logical_commit_time;
+    if (type == Cache::Mutation::Type::kUpdateKeyValue) {
+      iter->second.value = value;
+    } else {
+      iter->second.value.clear();
+    }
   }
-  return absl::InvalidArgumentError(
-      absl::StrCat("Record with key: ", record.key()->string_view(),
-                   " has unsupported value type: ", record.value_type()));
-}
 
-absl::Status ApplyDeleteMutation(std::string_view prefix,
-                                 const KeyValueMutationRecord& record,
-                                 Cache& cache) {
-  if (record.value_type() == Value::StringValue) {
-    cache.DeleteKey(record.key()->string_view(), record.logical_commit_time(),
-                    prefix);
+  void UpdateMaxTimestamp(int64_t timestamp) {
+    int64_t max_timestamp = max_timestamp_;
+    while (max_timestamp < timestamp &&
+           !max_timestamp_.compare_exchange_weak(max_timestamp, timestamp)) {
+    }
+  }
+  // The latest logical commit time of the merged data loads.
+  int64_t max_timestamp() const { return max_timestamp_; }
+
+  // Applies the merged mutations to `cache` in batches. Returns the number of
+  // mutations applied.
+  int64_t Apply(Cache& cache, std::string_view prefix) {
+    ScopeLatencyMetricsRecorder<ServerSafeMetricsContext,
+                                kDataLoadingCacheApplyLatency>
+        latency_recorder(KVServerContextMap()->SafeMetric());
+    int64_t num_applied = 0;
+    std::vector<Cache::Mutation> batch;
+    batch.reserve(kMutationBatchSize);
+    for (Partition& partition : partitions_) {
+      absl::MutexLock lock(&partition.mutex);
+      for (const auto& [key, latest] : partition.latest) {
+        batch.push_back(Cache::Mutation{
+            .type = latest.type,
+            .key = key,
+            .value = latest.value,
+            .logical_commit_time = latest.logical_commit_time});
+        if (batch.size() == kMutationBatchSize) {
+          cache.ApplyMutations(batch, prefix);
+          RecordDataFreshness(source_, prefix, batch, absl::Now());
+          num_applied += batch.size();
+          batch.clear();
+        }
+      }
+    }
+    if (!batch.empty()) {
+      cache.ApplyMutations(batch, prefix);
+      RecordDataFreshness(source_, prefix, batch, absl::Now());
+      num_applied += batch.size();
+    }
+    ServedDataVersion().Advance();
+    return num_applied;
+  }
+
+ private:
+  struct Latest {
+    Cache::Mutation::Type type = Cache::Mutation::Type::kUpdateKeyValue;
+    int64_t logical_commit_time = 0;
+    std::string value;
+  };
+  struct Partition {
+    absl::Mutex mutex;
+    absl::flat_hash_map<std::string, Latest> latest ABSL_GUARDED_BY(mutex);
+  };
+
+  const DataFreshnessSource source_;
+  Partition partitions_[kNumMutationPartitions];
+  std::atomic<int64_t> max_timestamp_ = 0;
+};
+
+// Collects the mutations of the records of one data load and applies them to
+// the cache in batches, so that the cache locks and metrics once per batch
+// instead of once per record.
+//
+// Loading is a pipeline: the reader threads read, parse and filter records,
+// and add their mutations to the batch of the partition of their key. A full
+// batch is queued and applied by whichever thread that added to the partition
+// is free, one batch of the partition at a time, while the other threads go
+// on reading and parsing. Mutations of the same key are applied in the order
+// they were added, and each partition queues a bounded number of batches, so
+// that reading doesn't run ahead of the cache.
+//
+// Record bytes only live for the duration of the record callback, so the
+// batches keep their own copy of the keys and values. Thread safe, the record
+// callbacks may run concurrently.
+//
+// If `merge` is set, the key-value mutations are added to it instead, and
+// applied when the merge is.
+class CacheMutationPipeline {
+ public:
+  // If `governor` is set, each batch waits for it before it is applied. The
+  // freshness of the applied mutations is recorded as that of `source`.
+  CacheMutationPipeline(Cache& cache, std::string_view prefix,
+                        DataFreshnessSource source,
+                        LastWriterWinsMerge* merge = nullptr,
+                        LoadGovernor* governor = nullptr)
+      : cache_(cache),
+        prefix_(prefix),
+        source_(source),
+        merge_(merge),
+        governor_(governor) {}
+
+  absl::Status AddMutation(const KeyValueMutationRecord& record) {
+    std::optional<Cache::Mutation::Type> type;
+    switch (record.mutation_type()) {
+      case KeyValueMutationType::Update:
+        type = MutationType(record, Cache::Mutation::Type::kUpdateKeyValue,
+                            Cache::Mutation::Type::kUpdateKeyValueSet,
+                            Cache::Mutation::Type::kUpdateUInt32Set);
+        break;
+      case KeyValueMutationType::Delete:
+        type = MutationType(record, Cache::Mutation::Type::kDeleteKey,
+                            Cache::Mutation::Type::kDeleteValuesInSet,
+                            Cache::Mutation::Type::kDeleteValuesInUInt32Set);
+        break;
+      default:
+        return absl::InvalidArgumentError(
+            absl::StrCat("Invalid mutation type: ",
+                         EnumNameKeyValueMutationType(record.mutation_type())));
+    }
+    if (!type.has_value()) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Record with key: ", record.key()->string_view(),
+                       " has unsupported value type: ", record.value_type()));
+    }
+    if (merge_ != nullptr &&
+        (*type == Cache::Mutation::Type::kUpdateKeyValue ||
+         *type == Cache::Mutation::Type::kDeleteKey)) {
+      merge_->Add(*type, record);
+    } else {
+      AddMutation(*type, record);
+    }
+    CountMutation(record.mutation_type(), record.logical_commit_time());
     return absl::OkStatus();
   }
-  if (record.value_type() == Value::StringSet) {
-    auto values = GetRecordValue<std::vector<std::string_view>>(record);
-    cache.DeleteValuesInSet(record.key()->string_view(), absl::MakeSpan(values),
-                            record.logical_commit_time(), prefix);
+
+  // Adds an entry of a `KeyValueMutationBatch`, whose values are strings.
+  absl::Status AddMutation(const KeyValueMutationRecordStruct& record) {
+    Cache::Mutation::Type type;
+    switch (record.mutation_type) {
+      case KeyValueMutationType::Update:
+        type = Cache::Mutation::Type::kUpdateKeyValue;
+        break;
+      case KeyValueMutationType::Delete:
+        type = Cache::Mutation::Type::kDeleteKey;
+        break;
+      default:
+        return absl::InvalidArgumentError(
+            absl::StrCat("Invalid mutation type: ",
+                         EnumNameKeyValueMutationType(record.mutation_type)));
+    }
+    const std::string_view value = std::get<std::string_view>(record.value);
+    if (merge_ != nullptr) {
+      merge_->Add(type, record.key, value, record.logical_commit_time);
+    } else {
+      StageMutation(type, record.key, record.logical_commit_time,
+                    [value](Batch& batch, StagedMutation& mutation) {
+                      mutation.value = batch.Append(value);
+                    });
+    }
+    CountMutation(record.mutation_type, record.logical_commit_time);
     return absl::OkStatus();
   }
-  return absl::InvalidArgumentError(
-      absl::StrCat("Record with key: ", record.key()->string_view(),
-                   " has unsupported value type: ", record.value_type()));
+
+  // Counts a record of another shard.
+  void AddDroppedRecord() { ++total_dropped_records_; }
+
+  // Applies the mutations that are still pending. Called once the record
+  // callbacks are done.
+  void Flush() {
+    for (Partition& partition : partitions_) {
+      absl::MutexLock lock(&partition.mutex);
+      QueueStagedBatch(partition);
+      const absl::Time wait_start = absl::Now();
+      partition.mutex.Await(absl::Condition(&partition, &Partition::IsIdle));
+      AddLatency(lock_wait_nanos_, absl::Now() - wait_start);
+      ApplyPendingBatches(partition);
+    }
+  }
+
+  DataLoadingStats stats() const {
+    return DataLoadingStats{
+        .total_updated_records = total_updated_records_,
+        .total_deleted_records = total_deleted_records_,
+        .total_dropped_records = total_dropped_records_,
+    };
+  }
+  // The latest logical commit time of the added mutations.
+  int64_t max_timestamp() const { return max_timestamp_; }
+  // Time spent applying batches to the cache, summed over the threads.
+  absl::Duration cache_apply_latency() const {
+    return absl::Nanoseconds(cache_apply_nanos_);
+  }
+  // Time the threads waited for the batches of a partition to be applied,
+  // or for its lock once they were, summed over the threads.
+  absl::Duration lock_wait_latency() const {
+    return absl::Nanoseconds(lock_wait_nanos_);
+  }
+
+ private:
+  // Range of `Batch::bytes`.
+  struct ByteRange {
+    size_t offset = 0;
+    size_t size = 0;
+  };
+  struct StagedMutation {
+    Cache::Mutation::Type type;
+    ByteRange key;
+    ByteRange value;
+    // Range of `Batch::value_ranges`, or of `Batch::uint32_values` for an
+    // integer set, holding the values of a set mutation.
+    size_t values_begin = 0;
+    size_t values_end = 0;
+    int64_t logical_commit_time = 0;
+  };
+  // The record bytes are copied into one buffer per batch, and the mutations
+  // only point into it once the batch is sealed and no longer grows, so that
+  // adding a mutation doesn't allocate per record. Vectors keep their storage
+  // when moved, unlike short strings.
+  struct Batch {
+    std::vector<char> bytes;
+    std::vector<ByteRange> value_ranges;
+    std::vector<uint32_t> uint32_values;
+    std::vector<StagedMutation> entries;
+    // Set by `Seal()`.
+    std::vector<std::string_view> set_values;
+    std::vector<Cache::Mutation> mutations;
+
+    ByteRange Append(std::string_view data) {
+      ByteRange range{.offset = bytes.size(), .size = data.size()};
+      bytes.insert(bytes.end(), data.begin(), data.end());
+      return range;
+    }
+    std::string_view View(ByteRange range) const {
+      return std::string_view(bytes.data() + range.offset, range.size);
+    }
+    void Seal() {
+      set_values.reserve(value_ranges.size());
+      for (const ByteRange& range : value_ranges) {
+        set_values.push_back(View(range));
+      }
+      mutations.reserve(entries.size());
+      for (const StagedMutation& mutation : entries) {
+        const size_t num_values = mutation.values_end - mutation.values_begin;
+        if (IsUInt32SetMutation(mutation.type)) {
+          mutations.push_back(Cache::Mutation{
+              .type = mutation.type,
+              .key = View(mutation.key),
+              .logical_commit_time = mutation.logical_commit_time,
+              .uint32_value_set = absl::MakeConstSpan(
+                  uint32_values.data() + mutation.values_begin,
+                  num_values)});
+          continue;
+        }
+        mutations.push_back(Cache::Mutation{
+            .type = mutation.type,
+            .key = View(mutation.key),
+            .value = View(mutation.value),
+            .value_set = absl::MakeSpan(
+                set_values.data() + mutation.values_begin, num_values),
+            .logical_commit_time = mutation.logical_commit_time});
+      }
+    }
+  };
+  struct Partition {
+    absl::Mutex mutex;
+    Batch staged ABSL_GUARDED_BY(mutex);
+    std::deque<Batch> pending ABSL_GUARDED_BY(mutex);
+    // Whether a thread is applying the pending batches.
+    bool applying ABSL_GUARDED_BY(mutex) = false;
+
+    bool IsIdle() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex) {
+      return !applying;
+    }
+    bool IsIdleOrHasRoom() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex) {
+      return !applying || pending.size() < kMaxPendingBatchesPerPartition;
+    }
+  };
+
+  static std::optional<Cache::Mutation::Type> MutationType(
+      const KeyValueMutationRecord& record, Cache::Mutation::Type value_type,
+      Cache::Mutation::Type set_type, Cache::Mutation::Type uint32_set_type) {
+    if (record.value_type() == Value::StringValue) {
+      return value_type;
+    }
+    if (record.value_type() == Value::StringSet) {
+      return set_type;
+    }
+    if (record.value_type() == Value::UInt32Set) {
+      return uint32_set_type;
+    }
+    return std::nullopt;
+  }
+  static bool IsUInt32SetMutation(Cache::Mutation::Type type) {
+    return type == Cache::Mutation::Type::kUpdateUInt32Set ||
+           type == Cache::Mutation::Type::kDeleteValuesInUInt32Set;
+  }
+
+  void AddMutation(Cache::Mutation::Type type,
+                   const KeyValueMutationRecord& record) {
+    StageMutation(
+        type, record.key()->string_view(), record.logical_commit_time(),
+        [&record](Batch& batch, StagedMutation& mutation) {
+          if (record.value_type() == Value::StringValue) {
+            mutation.value =
+                batch.Append(GetRecordValue<std::string_view>(record));
+          } else if (record.value_type() == Value::UInt32Set) {
+            const auto values =
+                GetRecordValue<absl::Span<const uint32_t>>(record);
+            mutation.values_begin = batch.uint32_values.size();
+            batch.uint32_values.insert(batch.uint32_values.end(),
+                                       values.begin(), values.end());
+            mutation.values_end = batch.uint32_values.size();
+          } else {
+            mutation.values_begin = batch.value_ranges.size();
+            for (std::string_view value :
+                 GetRecordValue<StringSetView>(record)) {
+              batch.value_ranges.push_back(batch.Append(value));
+            }
+            mutation.values_end = batch.value_ranges.size();
+          }
+        });
+  }
+
+  // Adds a mutation of `key` to the staged batch of its partition, with its
+  // value appended to the batch by `append_value(batch, mutation)`.
+  template <typename AppendValueFn>
+  void StageMutation(Cache::Mutation::Type type, std::string_view key,
+                     int64_t logical_commit_time, AppendValueFn append_value) {
+    Partition& partition = partitions_[absl::Hash<std::string_view>{}(key) %
+                                       kNumMutationPartitions];
+    absl::MutexLock lock(&partition.mutex);
+    Batch& batch = partition.staged;
+    if (batch.entries.empty()) {
+      batch.entries.reserve(kMutationBatchSize);
+    }
+    StagedMutation mutation{.type = type,
+                            .key = batch.Append(key),
+                            .logical_commit_time = logical_commit_time};
+    append_value(batch, mutation);
+    batch.entries.push_back(mutation);
+    if (batch.entries.size() < kMutationBatchSize) {
+      return;
+    }
+    // Waits for the queue to have room, unless this thread is the one to
+    // drain it.
+    const absl::Time wait_start = absl::Now();
+    partition.mutex.Await(
+        absl::Condition(&partition, &Partition::IsIdleOrHasRoom));
+    AddLatency(lock_wait_nanos_, absl::Now() - wait_start);
+    QueueStagedBatch(partition);
+    if (!partition.applying) {
+      ApplyPendingBatches(partition);
+    }
+  }
+
+  void QueueStagedBatch(Partition& partition)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(partition.mutex) {
+    if (!partition.staged.entries.empty()) {
+      partition.staged.Seal();
+      partition.pending.push_back(std::move(partition.staged));
+      partition.staged = Batch();
+    }
+  }
+
+  // Applies the pending batches of `partition` in order, without holding its
+  // lock while the cache applies them, until there are none left.
+  void ApplyPendingBatches(Partition& partition)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(partition.mutex) {
+    partition.applying = true;
+    while (!partition.pending.empty()) {
+      Batch batch = std::move(partition.pending.front());
+      partition.pending.pop_front();
+      partition.mutex.Unlock();
+      if (governor_ != nullptr) {
+        governor_->MaybeThrottle();
+      }
+      const absl::Time apply_start = absl::Now();
+      cache_.ApplyMutations(batch.mutations, prefix_);
+      ServedDataVersion().Advance();
+      const absl::Time applied = absl::Now();
+      RecordDataFreshness(source_, prefix_, batch.mutations, applied);
+      const absl::Time lock_start = absl::Now();
+      partition.mutex.Lock();
+      AddLatency(cache_apply_nanos_, applied - apply_start);
+      AddLatency(lock_wait_nanos_, absl::Now() - lock_start);
+    }
+    partition.applying = false;
+  }
+
+  static void AddLatency(std::atomic<int64_t>& total_nanos,
+                         absl::Duration latency) {
+    total_nanos.fetch_add(absl::ToInt64Nanoseconds(latency),
+                          std::memory_order_relaxed);
+  }
+
+  void UpdateMaxTimestamp(int64_t timestamp) {
+    int64_t max_timestamp = max_timestamp_;
+    while (max_timestamp < timestamp &&
+           !max_timestamp_.compare_exchange_weak(max_timestamp, timestamp)) {
+    }
+  }
+
+  void CountMutation(KeyValueMutationType mutation_type,
+                     int64_t logical_commit_time) {
+    UpdateMaxTimestamp(logical_commit_time);
+    if (mutation_type == KeyValueMutationType::Update) {
+      ++total_updated_records_;
+    } else {
+      ++total_deleted_records_;
+    }
+  }
+
+  Cache& cache_;
+  const std::string_view prefix_;
+  const DataFreshnessSource source_;
+  LastWriterWinsMerge* const merge_;
+  LoadGovernor* const governor_;
+  Partition partitions_[kNumMutationPartitions];
+  std::atomic<int64_t> total_updated_records_ = 0;
+  std::atomic<int64_t> total_deleted_records_ = 0;
+  std::atomic<int64_t> total_dropped_records_ = 0;
+  std::atomic<int64_t> max_timestamp_ = 0;
+  std::atomic<int64_t> cache_apply_nanos_ = 0;
+  std::atomic<int64_t> lock_wait_nanos_ = 0;
+};
+
+// Name of `blob` in the startup report.
+std::string BlobName(const BlobStorageClient::DataLocation& blob) {
+  return blob.prefix.empty() ? blob.key
+                             : absl::StrCat(blob.prefix, "/", blob.key);
+}
+
+// Whether a file holds only the records of another shard than the server's.
+// Files sharded with another hash than the server's, or while keys are hashed
+// into logical shards, don't say which of their records are the server's, so
+// they're read and filtered record by record.
+bool BelongsToOtherShard(const KVFileMetadata& metadata,
+                         const DataOrchestrator::Options& options) {
+  return metadata.has_sharding_metadata() &&
+         !options.key_sharder.HasLogicalShards() &&
+         metadata.sharding_metadata().sharding_hash_version() ==
+             static_cast<int32_t>(options.key_sharder.hash_version()) &&
+         metadata.sharding_metadata().shard_num() != options.shard_num;
 }
 
-bool ShouldProcessRecord(const KeyValueMutationRecord& record,
-                         int64_t num_shards, int64_t server_shard_num,
-                         const KeySharder& key_sharder,
-                         DataLoadingStats& data_loading_stats) {
+// Whether the replicas of the shard share its records in a file through the
+// shard file store. Sharded files, and files with a shard index, already
+// hold the records of the shard together.
+bool SharesShardCopy(const KVFileMetadata& metadata,
+                     const DataOrchestrator::Options& options) {
+  return options.shard_file_store != nullptr && options.num_shards > 1 &&
+         !options.key_sharder.HasLogicalShards() &&
+         !metadata.has_sharding_metadata() && !metadata.has_shard_index();
+}
+
+bool ShouldProcessRecord(std::string_view key, int64_t num_shards,
+                         int64_t server_shard_num,
+                         const KeySharder& key_sharder) {
   if (num_shards <= 1) {
     return true;
   }
-  auto sharding_result =
-      key_sharder.GetShardNumForKey(record.key()->string_view(), num_shards);
-  if (sharding_result.shard_num == server_shard_num) {
+  if (key_sharder.IsKeyLoadedByShard(key, num_shards, server_shard_num)) {
     return true;
   }
-  data_loading_stats.total_dropped_records++;
+  auto sharding_result = key_sharder.GetShardNumForKey(key, num_shards);
   LOG_EVERY_N(ERROR, 100000) << absl::StrFormat(
       "Data does not belong to this shard replica. Key: %s, Sharding key (if "
       "regex matched): %s, Actual "
       "shard id: %d, Server's shard id: %d.",
-      record.key()->string_view(), sharding_result.sharding_key,
+      key, sharding_result.sharding_key,
       sharding_result.shard_num, server_shard_num);
   return false;
 }
 
-absl::Status ApplyKeyValueMutationToCache(
-    std::string_view prefix, const KeyValueMutationRecord& record, Cache& cache,
-    int64_t& max_timestamp, DataLoadingStats& data_loading_stats) {
-  switch (record.mutation_type()) {
-    case KeyValueMutationType::Update: {
-      if (auto status = ApplyUpdateMutation(prefix, record, cache);
-          !status.ok()) {
-        return status;
-      }
-      max_timestamp = std::max(max_timestamp, record.logical_commit_time());
-      data_loading_stats.total_updated_records++;
-      break;
-    }
-    case KeyValueMutationType::Delete: {
-      if (auto status = ApplyDeleteMutation(prefix, record, cache);
-          !status.ok()) {
-        return status;
-      }
-      max_timestamp = std::max(max_timestamp, record.logical_commit_time());
-      data_loading_stats.total_deleted_records++;
-      break;
-    }
-    default:
-      return absl::InvalidArgumentError(
-          absl::StrCat("Invalid mutation type: ",
-                       EnumNameKeyValueMutationType(record.mutation_type())));
+// Returns whether to verify the next record that this thread reads, one of
+// every `interval` records. 0 verifies none.
+bool SampleRecordVerification(int interval) {
+  if (interval == 1) {
+    return true;
+  }
+  if (interval <= 0) {
+    return false;
   }
-  return absl::OkStatus();
+  thread_local uint32_t num_records = 0;
+  return num_records++ % static_cast<uint32_t>(interval) == 0;
 }
 
+// Reads the records of `record_readers` one reader after another, applying
+// their mutations to `cache` as one batch. Verifies the flatbuffer of one of
+// every `verification_interval` records. Once a record fails, all the
+// remaining records are verified. The records that are kept are written to
+// `shard_copy` if set.
 absl::StatusOr<DataLoadingStats> LoadCacheWithData(
     std::string_view data_source, std::string_view prefix,
-    StreamRecordReader& record_reader, Cache& cache, int64_t& max_timestamp,
+    DataFreshnessSource freshness_source,
+    absl::Span<StreamRecordReader* const> record_readers, Cache& cache,
+    int64_t& max_timestamp,
     const int32_t server_shard_num, const int32_t num_shards,
-    UdfClient& udf_client, const KeySharder& key_sharder) {
-  DataLoadingStats data_loading_stats;
+    UdfClient& udf_client, const KeySharder& key_sharder,
+    int verification_interval = 1, LastWriterWinsMerge* merge = nullptr,
+    ShardFileStore::CopyWriter* shard_copy = nullptr) {
+  // Realtime updates are few and latency sensitive, only the files give way
+  // to request serving.
+  CacheMutationPipeline pipeline(
+      cache, prefix, freshness_source, merge,
+      data_source == kDefaultDataSourceForRealtimeUpdates
+          ? nullptr
+          : &DataLoadingGovernor());
   const auto process_data_record_fn =
-      [prefix, &cache, &max_timestamp, &data_loading_stats, server_shard_num,
-       num_shards, &udf_client, &key_sharder](const DataRecord& data_record) {
+      [&pipeline, server_shard_num, num_shards, &udf_client,
+       &key_sharder](const DataRecord& data_record, bool& dropped) {
         if (data_record.record_type() == Record::KeyValueMutationRecord) {
           const auto* record = data_record.record_as_KeyValueMutationRecord();
-          if (!ShouldProcessRecord(*record, num_shards, server_shard_num,
-                                   key_sharder, data_loading_stats)) {
+          if (!ShouldProcessRecord(record->key()->string_view(), num_shards,
+                                   server_shard_num, key_sharder)) {
+            pipeline.AddDroppedRecord();
+            dropped = true;
             // NOTE: currently upstream logic retries on non-ok status
             // this will get us in a loop
             return absl::OkStatus();
           }
-          return ApplyKeyValueMutationToCache(
-              prefix, *record, cache, max_timestamp, data_loading_stats);
+          return pipeline.AddMutation(*record);
+        } else if (data_record.record_type() ==
+                   Record::KeyValueMutationBatch) {
+          // The record only counts as dropped if all of its entries are.
+          bool all_dropped = true;
+          PS_RETURN_IF_ERROR(ForEachKeyValueMutation(
+              *data_record.record_as_KeyValueMutationBatch(),
+              [&](const KeyValueMutationRecordStruct& record) {
+                if (!ShouldProcessRecord(record.key, num_shards,
+                                         server_shard_num, key_sharder)) {
+                  pipeline.AddDroppedRecord();
+                  return absl::OkStatus();
+                }
+                all_dropped = false;
+                return pipeline.AddMutation(record);
+              }));
+          dropped = all_dropped;
+          return absl::OkStatus();
         } else if (data_record.record_type() ==
                    Record::UserDefinedFunctionsConfig) {
           const auto* udf_config =
               data_record.record_as_UserDefinedFunctionsConfig();
           VLOG(3) << "Setting UDF code snippet for version: "
                   << udf_config->version();
-          return udf_client.SetCodeObject(CodeConfig{
+          // Compiled in the background, so the records after it don't wait.
+          return udf_client.SetCodeObjectAsync(CodeConfig{
               .js = udf_config->code_snippet()->str(),
               .udf_handler_name = udf_config->handler_name()->str(),
               .logical_commit_time = udf_config->logical_commit_time(),
-              .version = udf_config->version()});
+              .version = udf_config->version(),
+              .argument_format =
+                  udf_config->argument_format() ==
+                          UserDefinedFunctionsArgumentFormat::SerializedProto
+                      ? CodeConfig::ArgumentFormat::kSerializedProto
+                      : CodeConfig::ArgumentFormat::kJson,
+              .cache_outputs = udf_config->cache_outputs()});
+        } else if (data_record.record_type() == Record::ShardMappingRecord) {
+          const auto* shard_mapping =
+              data_record.record_as_ShardMappingRecord();
+          LogicalShardMapping* mapping = key_sharder.logical_shard_mapping();
+          if (mapping == nullptr) {
+            LOG_EVERY_N(WARNING, 1000)
+                << "Ignoring shard mapping record of logical shard "
+                << shard_mapping->logical_shard()
+                << ", the server has no logical shards";
+            return absl::OkStatus();
+          }
+          // Like dropped records, failures aren't returned to not be retried.
+          if (absl::Status status =
+                  mapping->Apply(shard_mapping->logical_shard(),
+                                 shard_mapping->physical_shard(),
+                                 shard_mapping->state() ==
+                                     ShardMappingState::Staged);
+              !status.ok()) {
+            LOG(ERROR) << "Ignoring shard mapping record: " << status;
+          }
+          return absl::OkStatus();
         }
         return absl::InvalidArgumentError("Received unsupported record.");
       };
   // TODO(b/314302953): ReadStreamRecords will skip over individual records that
   // have errors. We should pass the file name to the function so that it will
   // appear in error logs.
-  PS_RETURN_IF_ERROR(record_reader.ReadStreamRecords(
-      [&process_data_record_fn](std::string_view raw) {
-        return DeserializeDataRecord(raw, process_data_record_fn);
-      }));
+  std::atomic<int64_t> deserialize_nanos = 0;
+  std::atomic<bool> verify_all = verification_interval == 1;
+  std::atomic<int64_t> num_unverified = 0;
+  const auto read_record_fn = [&](std::string_view raw) {
+    const bool verify = verify_all.load(std::memory_order_relaxed) ||
+                        SampleRecordVerification(verification_interval);
+    if (!verify) {
+      num_unverified.fetch_add(1, std::memory_order_relaxed);
+    }
+    const absl::Time start = absl::Now();
+    bool dropped = false;
+    absl::Status status = DeserializeDataRecord(
+        raw,
+        [&process_data_record_fn, &deserialize_nanos, &dropped,
+         start](const DataRecord& data_record) {
+          deserialize_nanos.fetch_add(
+              absl::ToInt64Nanoseconds(absl::Now() - start),
+              std::memory_order_relaxed);
+          return process_data_record_fn(data_record, dropped);
+        },
+        {.verify = verify});
+    if (shard_copy != nullptr && status.ok() && !dropped) {
+      shard_copy->WriteRecord(raw);
+    }
+    if (!status.ok() && !verify_all.exchange(true)) {
+      LOG(WARNING) << "Verifying all the remaining records of " << data_source
+                   << " after a record failed: " << status;
+    }
+    return status;
+  };
+  // Shard indexes are written by sharding the whole key into physical shards,
+  // so they can only be used to skip the records of other shards when the
+  // server does the same.
+  absl::Status status;
+  for (StreamRecordReader* record_reader : record_readers) {
+    status.Update(
+        key_sharder.HasShardKeyRegex() || key_sharder.HasLogicalShards()
+            ? record_reader->ReadStreamRecords(read_record_fn)
+            : record_reader->ReadShardStreamRecords(
+                  server_shard_num, num_shards,
+                  static_cast<int32_t>(key_sharder.hash_version()),
+                  read_record_fn));
+  }
+  // The mutations added before a failure are applied, as they were before
+  // batching.
+  pipeline.Flush();
+  max_timestamp = std::max(max_timestamp, pipeline.max_timestamp());
+  PS_RETURN_IF_ERROR(status);
+  const DataLoadingStats data_loading_stats = pipeline.stats();
   LogDataLoadingMetrics(data_source, data_loading_stats);
+  if (num_unverified > 0) {
+    LogIfError(KVServerContextMap()
+                   ->SafeMetric()
+                   .LogUpDownCounter<kTotalRowsNotVerifiedInDataLoading>(
+                       {{std::string(data_source),
+                         static_cast<double>(num_unverified)}}));
+  }
+  LogDataLoadingLatencies(data_source, absl::Nanoseconds(deserialize_nanos),
+                          pipeline.cache_apply_latency(),
+                          pipeline.lock_wait_latency());
   return data_loading_stats;
 }
 
-// Reads the file from `location` and updates the cache based on the delta read.
+// Reads the file from `location` and updates `cache` based on the delta read.
+// The deleted values are removed by `tombstone_cleaner` if set. If `merge` is
+// set, the key-value mutations are added to it, and the deleted values are
+// left for the caller to remove once it applied the merge. If
+// `prefetched_metadata` is set, it is used instead of reading the metadata of
+// the file again.
 absl::StatusOr<DataLoadingStats> LoadCacheWithDataFromFile(
     const BlobStorageClient::DataLocation& location,
-    const DataOrchestrator::Options& options) {
+    const DataOrchestrator::Options& options, Cache& cache,
+    TombstoneCleaner* tombstone_cleaner, LastWriterWinsMerge* merge,
+    const KVFileMetadata* prefetched_metadata) {
   LOG(INFO) << "Loading " << location;
   int64_t max_timestamp = 0;
-  auto& cache = options.cache;
   auto record_reader =
       options.delta_stream_reader_factory.CreateConcurrentReader(
           /*stream_factory=*/[&location, &options]() {
             return std::make_unique<BlobRecordStream>(
                 options.blob_client.GetBlobReader(location));
           });
-  PS_ASSIGN_OR_RETURN(auto metadata, record_reader->GetKVFileMetadata(),
-                      _ << "Blob " << location);
-  if (metadata.has_sharding_metadata() &&
-      metadata.sharding_metadata().shard_num() != options.shard_num) {
+  KVFileMetadata read_metadata;
+  if (prefetched_metadata == nullptr) {
+    PS_ASSIGN_OR_RETURN(read_metadata, record_reader->GetKVFileMetadata(),
+                        _ << "Blob " << location);
+  }
+  const KVFileMetadata& metadata =
+      prefetched_metadata != nullptr ? *prefetched_metadata : read_metadata;
+  if (BelongsToOtherShard(metadata, options)) {
     LOG(INFO) << "Blob " << location << " belongs to shard num "
               << metadata.sharding_metadata().shard_num()
               << " but server shard num is " << options.shard_num
@@ -242,22 +883,81 @@ absl::StatusOr<DataLoadingStats> LoadCacheWithDataFromFile(
       location.prefix.empty()
           ? location.key
           : absl::StrCat(location.prefix, "/", location.key);
-  PS_ASSIGN_OR_RETURN(
-      auto data_loading_stats,
-      LoadCacheWithData(file_name, location.prefix, *record_reader, cache,
-                        max_timestamp, options.shard_num, options.num_shards,
-                        options.udf_client, options.key_sharder),
-      _ << "Blob: " << location);
-  cache.RemoveDeletedKeys(max_timestamp, location.prefix);
+  const int verification_interval =
+      metadata.trusted_records() ? options.trusted_file_verification_interval
+                                 : 1;
+  const DataFreshnessSource freshness_source =
+      IsSnapshotFilename(location.key) ? DataFreshnessSource::kSnapshot
+                                       : DataFreshnessSource::kDelta;
+  ShardFileStore::Copy shard_copy;
+  if (SharesShardCopy(metadata, options)) {
+    shard_copy = options.shard_file_store->Acquire(location);
+  }
+  absl::StatusOr<DataLoadingStats> loaded_stats;
+  if (!shard_copy.path.empty()) {
+    LOG(INFO) << "Loading " << location << " from its shard copy "
+              << shard_copy.path;
+    auto copy_reader =
+        options.delta_stream_reader_factory.CreateConcurrentReader(
+            /*stream_factory=*/[&shard_copy]() {
+              return std::make_unique<ShardCopyRecordStream>(shard_copy.path);
+            });
+    loaded_stats = LoadCacheWithData(
+        file_name, location.prefix, freshness_source, {copy_reader.get()},
+        cache, max_timestamp, options.shard_num, options.num_shards,
+        options.udf_client, options.key_sharder, verification_interval,
+        merge);
+    // Mutations are applied by timestamp, so the ones already applied from
+    // the copy are applied again from the bucket without effect.
+    LOG_IF(WARNING, !loaded_stats.ok())
+        << "Loading " << location << " from the bucket after its shard copy "
+        << "failed: " << loaded_stats.status();
+  }
+  if (shard_copy.path.empty() || !loaded_stats.ok()) {
+    if (shard_copy.writer != nullptr) {
+      if (const absl::Status status = shard_copy.writer->Open(metadata);
+          !status.ok()) {
+        LOG(WARNING) << "Loading " << location
+                     << " without writing its shard copy: " << status;
+        shard_copy.writer.reset();
+      }
+    }
+    loaded_stats = LoadCacheWithData(
+        file_name, location.prefix, freshness_source, {record_reader.get()},
+        cache, max_timestamp, options.shard_num, options.num_shards,
+        options.udf_client, options.key_sharder, verification_interval, merge,
+        shard_copy.writer.get());
+    if (loaded_stats.ok() && shard_copy.writer != nullptr) {
+      const absl::Status status = shard_copy.writer->Commit();
+      LOG_IF(WARNING, !status.ok())
+          << "Failed to share the shard copy of " << location << ": "
+          << status;
+    }
+  }
+  PS_ASSIGN_OR_RETURN(auto data_loading_stats, std::move(loaded_stats),
+                      _ << "Blob: " << location);
+  if (merge != nullptr) {
+    merge->UpdateMaxTimestamp(max_timestamp);
+  } else if (tombstone_cleaner != nullptr) {
+    tombstone_cleaner->ScheduleCleanup(max_timestamp, location.prefix);
+  } else {
+    cache.RemoveDeletedKeys(max_timestamp, location.prefix);
+    ServerMemoryReleaser().MaybeRelease();
+  }
   return data_loading_stats;
 }
 
 absl::StatusOr<DataLoadingStats> TraceLoadCacheWithDataFromFile(
     BlobStorageClient::DataLocation location,
-    const DataOrchestrator::Options& options) {
+    const DataOrchestrator::Options& options, Cache& cache,
+    TombstoneCleaner* tombstone_cleaner, LastWriterWinsMerge* merge = nullptr,
+    const KVFileMetadata* prefetched_metadata = nullptr) {
   return TraceWithStatusOr(
-      [location, &options] {
-        return LoadCacheWithDataFromFile(std::move(location), options);
+      [location, &options, &cache, tombstone_cleaner, merge,
+       prefetched_metadata] {
+        return LoadCacheWithDataFromFile(std::move(location), options, cache,
+                                         tombstone_cleaner, merge,
+                                         prefetched_metadata);
       },
       "LoadCacheWithDataFromFile",
       {{"bucket", std::move(location.bucket)},
@@ -265,18 +965,120 @@ absl::StatusOr<DataLoadingStats> TraceLoadCacheWithDataFromFile(
        {"key", std::move(location.key)}});
 }
 
+// Runs `tasks` with at most `max_concurrency` of them running at once, this
+// thread being one of them, and returns the first error. Tasks that didn't
+// start yet when a task fails aren't run.
+absl::Status RunConcurrently(
+    std::vector<absl::AnyInvocable<absl::Status()>> tasks,
+    int max_concurrency) {
+  std::atomic<size_t> next_task = 0;
+  absl::Mutex mutex;
+  absl::Status status;
+  const auto run_tasks = [&tasks, &next_task, &mutex, &status]() {
+    for (size_t i = next_task++; i < tasks.size(); i = next_task++) {
+      if (auto task_status = tasks[i](); !task_status.ok()) {
+        next_task = tasks.size();
+        absl::MutexLock lock(&mutex);
+        status.Update(std::move(task_status));
+      }
+    }
+    return true;
+  };
+  const int num_runners =
+      std::min<int>(std::max(max_concurrency, 1), tasks.size());
+  std::vector<TaskFuture<bool>> runners;
+  for (int i = 1; i < num_runners; ++i) {
+    runners.push_back(SharedThreadPool().Async(run_tasks));
+  }
+  run_tasks();
+  for (auto& runner : runners) {
+    runner.Get();
+  }
+  return status;
+}
+
+// Returns true if the machine has enough available memory to build a second
+// cache generation next to the current one. The process size is an upper
+// bound on the size of the current generation.
+bool HasMemoryHeadroomForNextGeneration() {
+  std::ifstream statm("/proc/self/statm");
+  int64_t total_pages = 0;
+  int64_t resident_pages = 0;
+  if (!(statm >> total_pages >> resident_pages)) {
+    LOG(WARNING) << "Failed to read the resident memory of the process";
+    return false;
+  }
+  const int64_t resident_bytes = resident_pages * sysconf(_SC_PAGESIZE);
+  std::ifstream meminfo("/proc/meminfo");
+  std::string name;
+  int64_t available_kbytes = -1;
+  std::string line;
+  while (std::getline(meminfo, line)) {
+    std::istringstream fields(line);
+    if (fields >> name && name == "MemAvailable:") {
+      fields >> available_kbytes;
+      break;
+    }
+  }
+  if (available_kbytes < 0) {
+    LOG(WARNING) << "Failed to read the available memory";
+    return false;
+  }
+  LOG(INFO) << "Resident memory: " << resident_bytes
+            << " bytes, available memory: " << available_kbytes * 1024
+            << " bytes";
+  return available_kbytes * 1024 > resident_bytes;
+}
+
+class DataOrchestratorImpl;
+
+// The delta files of a prefix found on start, that are loaded in the
+// background with `serve_before_delta_catch_up`.
+struct DeltaCatchUp {
+  // The last of the files. The prefix is caught up once it is loaded.
+  std::string last_key;
+  // The files not loaded yet.
+  int64_t num_files = 0;
+};
+
+// The started orchestrators of the process, for `GetFreshnessLagsInMicros`
+// and `GetDeltaCatchUpBacklogs`.
+struct OrchestratorRegistry {
+  absl::Mutex mutex;
+  absl::flat_hash_set<const DataOrchestratorImpl*> orchestrators
+      ABSL_GUARDED_BY(mutex);
+};
+
+OrchestratorRegistry& GetOrchestratorRegistry() {
+  static auto* const registry = new OrchestratorRegistry();
+  return *registry;
+}
+
 class DataOrchestratorImpl : public DataOrchestrator {
  public:
   // `last_basename` is the last file seen during init. The cache is up to
   // date until this file.
+  // `snapshot_basenames` are the snapshot groups loaded during init.
+  // `delta_catch_ups` are the delta files found during init that are loaded
+  // once started.
   DataOrchestratorImpl(
       Options options,
-      absl::flat_hash_map<std::string, std::string> prefix_last_basenames)
+      absl::flat_hash_map<std::string, std::string> prefix_last_basenames,
+      absl::flat_hash_map<std::string, std::string> snapshot_basenames,
+      absl::flat_hash_map<std::string, DeltaCatchUp> delta_catch_ups)
       : options_(std::move(options)),
-        prefix_last_basenames_(std::move(prefix_last_basenames)) {}
+        delta_catch_ups_(std::move(delta_catch_ups)),
+        prefix_last_basenames_(std::move(prefix_last_basenames)),
+        last_loaded_deltas_(prefix_last_basenames_),
+        snapshot_basenames_(std::move(snapshot_basenames)) {}
 
   ~DataOrchestratorImpl() override {
     if (!data_loader_thread_) return;
+    {
+      OrchestratorRegistry& registry = GetOrchestratorRegistry();
+      absl::MutexLock lock(&registry.mutex);
+      registry.orchestrators.erase(this);
+    }
     {
       absl::MutexLock l(&mu_);
       stop_ = true;
@@ -290,15 +1092,40 @@ class DataOrchestratorImpl : public DataOrchestrator {
     }
     LOG(INFO) << "Delta notifier stopped";
     data_loader_thread_->join();
+    for (auto& loader_thread : file_loader_threads_) {
+      loader_thread.join();
+    }
     LOG(INFO) << "Stopped loading new data";
   }
 
+  // Sets `snapshot_basenames` to the snapshot groups it loaded. With
+  // `serve_before_delta_catch_up`, the delta files after the snapshots are
+  // not loaded, but set in `delta_catch_ups`.
   static absl::StatusOr<absl::flat_hash_map<std::string, std::string>> Init(
-      Options& options) {
-    auto ending_delta_files = LoadSnapshotFiles(options);
+      Options& options,
+      absl::flat_hash_map<std::string, std::string>& snapshot_basenames,
+      absl::flat_hash_map<std::string, DeltaCatchUp>& delta_catch_ups) {
+    absl::StatusOr<absl::flat_hash_map<std::string, std::string>>
+        ending_delta_files;
+    {
+      StartupReport::ScopedPhase startup_phase(ServerStartupReport(),
+                                               kStartupCacheImageLoadPhase);
+      ending_delta_files = LoadCacheImageFile(options, snapshot_basenames);
+    }
+    if (!ending_delta_files.ok()) {
+      ending_delta_files =
+          LoadSnapshotFiles(options, options.cache, options.tombstone_cleaner,
+                            snapshot_basenames);
+    }
     if (!ending_delta_files.ok()) {
       return ending_delta_files.status();
     }
+    StartupReport::ScopedPhase startup_phase(ServerStartupReport(),
+                                             kStartupDeltaCatchUpPhase);
+    // Prefixes are independent, their delta files are loaded concurrently,
+    // in order within each prefix.
+    absl::Mutex mutex;
+    std::vector<absl::AnyInvocable<absl::Status()>> prefix_tasks;
     for (const auto& prefix : options.blob_prefix_allowlist.Prefixes()) {
       auto location = BlobStorageClient::DataLocation{
           .bucket = options.data_bucket, .prefix = prefix};
@@ -311,24 +1138,77 @@ class DataOrchestratorImpl : public DataOrchestrator {
       if (!maybe_filenames.ok()) {
         return maybe_filenames.status();
       }
+      if (options.serve_before_delta_catch_up) {
+        // The delta notifier finds the same files once started, since it
+        // starts after the snapshots too.
+        DeltaCatchUp catch_up;
+        for (const auto& basename : *maybe_filenames) {
+          if (IsDeltaFilename(basename)) {
+            catch_up.last_key = basename;
+            ++catch_up.num_files;
+          }
+        }
+        if (catch_up.num_files > 0) {
+          LOG(INFO) << "Loading " << catch_up.num_files << " delta files from "
+                    << location << " once started";
+          delta_catch_ups[prefix] = std::move(catch_up);
+        }
+        continue;
+      }
       LOG(INFO) << "Initializing cache with " << maybe_filenames->size()
                 << " delta files from " << location;
-      for (auto&& basename : std::move(*maybe_filenames)) {
-        auto blob = BlobStorageClient::DataLocation{
-            .bucket = options.data_bucket, .prefix = prefix, .key = basename};
-        if (!IsDeltaFilename(blob.key)) {
-          LOG(WARNING) << "Saw a file " << blob
-                       << " not in delta file format. Skipping it.";
-          continue;
+      prefix_tasks.push_back([&options, &mutex, &ending_delta_files, prefix,
+                              filenames = std::move(*maybe_filenames)]()
+                                 -> absl::Status {
+        // A long chain of delta files is merged, so that keys that the files
+        // overwrite many times are applied once.
+        std::optional<LastWriterWinsMerge> merge;
+        if (options.catch_up_min_files > 0 &&
+            filenames.size() >=
+                static_cast<size_t>(options.catch_up_min_files)) {
+          LOG(INFO) << "Merging the " << filenames.size()
+                    << " delta files of prefix " << prefix;
+          merge.emplace(DataFreshnessSource::kDelta);
+        }
+        for (const auto& basename : filenames) {
+          auto blob = BlobStorageClient::DataLocation{
+              .bucket = options.data_bucket, .prefix = prefix, .key = basename};
+          if (!IsDeltaFilename(blob.key)) {
+            LOG(WARNING) << "Saw a file " << blob
+                         << " not in delta file format. Skipping it.";
+            continue;
+          }
+          {
+            absl::MutexLock lock(&mutex);
+            (*ending_delta_files)[prefix] = blob.key;
+          }
+          const absl::Time load_start = absl::Now();
+          if (const auto s = TraceLoadCacheWithDataFromFile(
+                  blob, options, options.cache, options.tombstone_cleaner,
+                  merge.has_value() ? &*merge : nullptr);
+              !s.ok()) {
+            return s.status();
+          }
+          ServerStartupReport().AddFileLoad(BlobName(blob),
+                                            absl::Now() - load_start);
+          LOG(INFO) << "Done loading " << blob;
         }
-        (*ending_delta_files)[prefix] = blob.key;
-        if (const auto s = TraceLoadCacheWithDataFromFile(blob, options);
-            !s.ok()) {
-          return s.status();
+        if (merge.has_value()) {
+          const int64_t num_applied = merge->Apply(options.cache, prefix);
+          LOG(INFO) << "Applied " << num_applied
+                    << " merged mutations of prefix " << prefix;
+          if (options.tombstone_cleaner != nullptr) {
+            options.tombstone_cleaner->ScheduleCleanup(merge->max_timestamp(),
+                                                       prefix);
+          } else {
+            options.cache.RemoveDeletedKeys(merge->max_timestamp(), prefix);
+          }
         }
-        LOG(INFO) << "Done loading " << blob;
-      }
+        return absl::OkStatus();
+      });
     }
+    PS_RETURN_IF_ERROR(RunConcurrently(std::move(prefix_tasks),
+                                       options.max_concurrent_file_loads));
     return ending_delta_files;
   }
 
@@ -346,162 +1226,839 @@ class DataOrchestratorImpl : public DataOrchestrator {
     if (!status.ok()) {
       return status;
     }
+    // Checked before the file loaders start, which report the end of the
+    // catch-up otherwise.
+    bool is_caught_up;
+    {
+      absl::MutexLock l(&mu_);
+      is_caught_up = delta_catch_ups_.empty();
+    }
+    if (is_caught_up) {
+      NotifyDeltaCatchUpDone();
+    }
+    const int num_file_loaders =
+        std::clamp<int>(options_.max_concurrent_file_loads, 1,
+                        options_.blob_prefix_allowlist.Prefixes().size());
+    for (int i = 0; i < num_file_loaders; ++i) {
+      file_loader_threads_.emplace_back(
+          absl::bind_front(&DataOrchestratorImpl::LoadQueuedFiles, this));
+    }
     data_loader_thread_ = std::make_unique<std::thread>(
         absl::bind_front(&DataOrchestratorImpl::ProcessNewFiles, this));
+    {
+      OrchestratorRegistry& registry = GetOrchestratorRegistry();
+      absl::MutexLock lock(&registry.mutex);
+      registry.orchestrators.insert(this);
+    }
 
     return options_.realtime_thread_pool_manager.Start(
         [this, &cache = options_.cache,
          &delta_stream_reader_factory = options_.delta_stream_reader_factory](
-            const std::string& message_body) {
+            absl::Span<const std::string> message_bodies) {
+          if (options_.realtime_batch_window > absl::ZeroDuration()) {
+            return LoadRealtimeUpdatesInBatchWindow(message_bodies);
+          }
           return LoadCacheWithHighPriorityUpdates(
               kDefaultDataSourceForRealtimeUpdates,
               kDefaultPrefixForRealTimeUpdates, delta_stream_reader_factory,
-              message_body, cache);
+              message_bodies, cache);
         });
   }
 
+  // Sets the freshness lag of every prefix, see `GetFreshnessLagsInMicros`.
+  void AddFreshnessLags(absl::Time now,
+                        absl::flat_hash_map<std::string, double>& lags) const
+      ABSL_LOCKS_EXCLUDED(mu_) {
+    absl::MutexLock l(&mu_);
+    for (const auto& prefix : options_.blob_prefix_allowlist.Prefixes()) {
+      double& lag = lags[prefix];
+      if (auto iter = prefix_queues_.find(prefix);
+          iter != prefix_queues_.end() && !iter->second.files.empty()) {
+        lag = std::max(lag, absl::ToDoubleMicroseconds(
+                                now - iter->second.files.front().queued_at));
+      }
+    }
+  }
+
+  // Adds the catch-up backlog of every prefix, see `GetDeltaCatchUpBacklogs`.
+  void AddDeltaCatchUpBacklogs(
+      absl::flat_hash_map<std::string, double>& backlogs) const
+      ABSL_LOCKS_EXCLUDED(mu_) {
+    absl::MutexLock l(&mu_);
+    for (const auto& prefix : options_.blob_prefix_allowlist.Prefixes()) {
+      double& backlog = backlogs[prefix];
+      if (auto iter = delta_catch_ups_.find(prefix);
+          iter != delta_catch_ups_.end()) {
+        backlog += iter->second.num_files;
+      }
+    }
+  }
+
  private:
+  // A new file waiting to be loaded.
+  struct QueuedFile {
+    std::string basename;
+    absl::Time queued_at;
+  };
+  // A new delta file of a prefix waiting to be loaded.
+  struct PrefixFile {
+    std::string key;
+    absl::Time queued_at;
+  };
+  // The new delta files of a prefix, in the order they are loaded. The front
+  // file stays queued while it is loaded.
+  struct PrefixQueue {
+    std::deque<PrefixFile> files;
+    bool is_loading = false;
+  };
+
   bool HasNewEventToProcess() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
-    return !unprocessed_basenames_.empty() || stop_ == true;
+    return !unprocessed_files_.empty() || stop_ == true;
   }
-  // Reads new files, if any, from the `unprocessed_basenames_` queue and
-  // processes them one by one.
-  //
-  // On failure, puts the file back to the end of the queue and retry at a
-  // later point.
+  bool CanQueueFile() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    return NumQueuedFiles() < static_cast<size_t>(options_.max_queued_files) ||
+           stop_ == true;
+  }
+  bool CanLoadQueuedFile() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    return (!loaders_paused_ && NextPrefixToLoad() != nullptr) ||
+           stop_ == true;
+  }
+  bool IsNoFileLoading() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    return num_loading_files_ == 0;
+  }
+  // Returns the number of new files not loaded yet.
+  size_t NumQueuedFiles() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    size_t num_files = unprocessed_files_.size();
+    for (const auto& [prefix, queue] : prefix_queues_) {
+      num_files += queue.files.size();
+    }
+    return num_files;
+  }
+  // Returns the prefix whose next file has been queued the longest, among the
+  // prefixes with no file being loaded, or null if there is none.
+  const std::string* NextPrefixToLoad() const
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    const std::string* next_prefix = nullptr;
+    absl::Time next_queued_at = absl::InfiniteFuture();
+    for (const auto& [prefix, queue] : prefix_queues_) {
+      if (queue.is_loading || queue.files.empty() ||
+          queue.files.front().queued_at >= next_queued_at) {
+        continue;
+      }
+      next_prefix = &prefix;
+      next_queued_at = queue.files.front().queued_at;
+    }
+    return next_prefix;
+  }
+  // Reads new files, if any, from the `unprocessed_files_` queue and queues
+  // them by prefix for the file loader threads. Checks for new snapshots and
+  // writes the cache image meanwhile, with the file loaders paused, and
+  // publishes the cache snapshots.
   void ProcessNewFiles() {
     LOG(INFO) << "Thread for new file processing started";
+    LowerCurrentThreadPriority(options_.loader_thread_nice_increment);
     absl::Condition has_new_event(this,
                                   &DataOrchestratorImpl::HasNewEventToProcess);
+    absl::Time next_snapshot_check = NextSnapshotCheck();
+    absl::Time next_cache_image_write = NextCacheImageWrite();
+    absl::Time next_snapshot_publish = NextSnapshotPublish();
     while (true) {
-      std::string basename;
+      std::vector<QueuedFile> files;
+      size_t num_queued_files;
       {
-        absl::MutexLock l(&mu_, has_new_event);
+        absl::MutexLock l(&mu_);
+        mu_.AwaitWithDeadline(
+            has_new_event, std::min({next_snapshot_check,
+                                     next_cache_image_write,
+                                     next_snapshot_publish}));
         if (stop_) {
           LOG(INFO) << "Thread for new file processing stopped";
           return;
         }
-        basename = std::move(unprocessed_basenames_.back());
-        unprocessed_basenames_.pop_back();
+        num_queued_files = NumQueuedFiles();
+        files.assign(std::make_move_iterator(unprocessed_files_.begin()),
+                     std::make_move_iterator(unprocessed_files_.end()));
+        unprocessed_files_.clear();
       }
-      LOG(INFO) << "Loading " << basename;
-      auto blob = ParseBlobName(basename);
+      if (!files.empty()) {
+        LogIfError(KVServerContextMap()
+                       ->SafeMetric()
+                       .LogHistogram<kDeltaFileQueueDepth>(
+                           static_cast<double>(num_queued_files)));
+        LogIfError(KVServerContextMap()
+                       ->SafeMetric()
+                       .LogHistogram<kDeltaFileQueueLagInMicros>(
+                           absl::ToDoubleMicroseconds(
+                               absl::Now() - files.front().queued_at)));
+      }
+      const bool is_backlogged =
+          options_.snapshot_check_backlog > 0 &&
+          num_queued_files >=
+              static_cast<size_t>(options_.snapshot_check_backlog);
+      if (const absl::Time now = absl::Now();
+          now >= next_snapshot_check ||
+          (is_backlogged && options_.generational_cache != nullptr)) {
+        PauseFileLoaders();
+        MaybeReloadSnapshots();
+        ResumeFileLoaders();
+        next_snapshot_check = NextSnapshotCheck();
+      } else if (now >= next_cache_image_write) {
+        PauseFileLoaders();
+        WriteCacheImageFile();
+        ResumeFileLoaders();
+        next_cache_image_write = NextCacheImageWrite();
+      } else if (now >= next_snapshot_publish) {
+        PublishSnapshots();
+        next_snapshot_publish = NextSnapshotPublish();
+      }
+      QueueNewFiles(files);
+    }
+  }
+
+  // Waits for the files being loaded, and keeps the file loader threads from
+  // loading more until `ResumeFileLoaders`.
+  void PauseFileLoaders() ABSL_LOCKS_EXCLUDED(mu_) {
+    absl::MutexLock l(&mu_);
+    loaders_paused_ = true;
+    mu_.Await(absl::Condition(this, &DataOrchestratorImpl::IsNoFileLoading));
+  }
+
+  void ResumeFileLoaders() ABSL_LOCKS_EXCLUDED(mu_) {
+    absl::MutexLock l(&mu_);
+    loaders_paused_ = false;
+  }
+
+  // Queues the delta files of `files` by prefix, in order, for the file
+  // loader threads.
+  void QueueNewFiles(const std::vector<QueuedFile>& files)
+      ABSL_LOCKS_EXCLUDED(mu_) {
+    if (files.empty()) {
+      return;
+    }
+    absl::MutexLock l(&mu_);
+    for (const auto& file : files) {
+      LOG(INFO) << "Loading " << file.basename;
+      auto blob = ParseBlobName(file.basename);
       if (!IsDeltaFilename(blob.key)) {
-        LOG(WARNING) << "Received file with invalid name: " << basename;
+        LOG(WARNING) << "Received file with invalid name: " << file.basename;
         continue;
       }
       if (!options_.blob_prefix_allowlist.Contains(blob.prefix)) {
         LOG(WARNING) << "Received file with prefix not allowlisted: "
-                     << basename;
+                     << file.basename;
         continue;
       }
-      RetryUntilOk(
-          [this, &basename, &blob] {
-            // TODO: distinguish status. Some can be retried while others
-            // are fatal.
-            return TraceLoadCacheWithDataFromFile(
-                {.bucket = options_.data_bucket,
-                 .prefix = blob.prefix,
-                 .key = blob.key},
-                options_);
-          },
-          "LoadNewFile", LogStatusSafeMetricsFn<kLoadNewFilesStatus>());
+      prefix_queues_[blob.prefix].files.push_back(
+          PrefixFile{.key = std::move(blob.key), .queued_at = file.queued_at});
+    }
+  }
+
+  // Runs on each file loader thread. Loads the next queued file of the prefix
+  // that has been waiting the longest, until stopped. A prefix only has one
+  // file loaded at a time, in the order its files were queued.
+  //
+  // On failure, retries loading the file until it succeeds.
+  void LoadQueuedFiles() {
+    LowerCurrentThreadPriority(options_.loader_thread_nice_increment);
+    absl::Condition can_load(this, &DataOrchestratorImpl::CanLoadQueuedFile);
+    while (true) {
+      std::string prefix;
+      PrefixFile file;
+      {
+        absl::MutexLock l(&mu_);
+        mu_.Await(can_load);
+        if (stop_) {
+          return;
+        }
+        prefix = *NextPrefixToLoad();
+        PrefixQueue& queue = prefix_queues_[prefix];
+        queue.is_loading = true;
+        file = queue.files.front();
+        ++num_loading_files_;
+      }
+      // Snapshots are only reloaded while no file is loading.
+      const bool is_in_snapshot = [this, &prefix, &file] {
+        auto iter = snapshot_ending_deltas_.find(prefix);
+        return iter != snapshot_ending_deltas_.end() &&
+               file.key <= iter->second;
+      }();
+      if (is_in_snapshot) {
+        LOG(INFO) << "Skipping " << file.key << " of prefix '" << prefix
+                  << "', it is included in the loaded snapshot of its prefix";
+      } else {
+        RetryUntilOk(
+            [this, &prefix, &file] {
+              // TODO: distinguish status. Some can be retried while
+              // others are fatal.
+              return TraceLoadCacheWithDataFromFile(
+                  {.bucket = options_.data_bucket,
+                   .prefix = prefix,
+                   .key = file.key},
+                  options_, options_.cache, options_.tombstone_cleaner);
+            },
+            "LoadNewFile", LogStatusSafeMetricsFn<kLoadNewFilesStatus>());
+        const absl::Duration lag = absl::Now() - file.queued_at;
+        LogIfError(KVServerContextMap()
+                       ->SafeMetric()
+                       .LogHistogram<kDeltaFileLoadLagInMicros>(
+                           absl::ToDoubleMicroseconds(lag)));
+        VLOG(1) << "Loaded " << file.key << " of prefix '" << prefix << "' "
+                << lag << " after it was queued";
+      }
+      bool is_catch_up_done = false;
+      {
+        absl::MutexLock l(&mu_);
+        PrefixQueue& queue = prefix_queues_[prefix];
+        queue.files.pop_front();
+        queue.is_loading = false;
+        --num_loading_files_;
+        if (!is_in_snapshot) {
+          auto& last_loaded = last_loaded_deltas_[prefix];
+          last_loaded = std::max(last_loaded, file.key);
+        }
+        // Files skipped because a reloaded snapshot includes them count as
+        // caught up too.
+        if (auto iter = delta_catch_ups_.find(prefix);
+            iter != delta_catch_ups_.end() &&
+            file.key <= iter->second.last_key) {
+          --iter->second.num_files;
+          if (file.key == iter->second.last_key) {
+            delta_catch_ups_.erase(iter);
+            is_catch_up_done = delta_catch_ups_.empty();
+          }
+        }
+      }
+      if (is_catch_up_done) {
+        NotifyDeltaCatchUpDone();
+      }
+    }
+  }
+
+  // Runs once the delta files found on start are loaded.
+  void NotifyDeltaCatchUpDone() const {
+    LOG(INFO) << "Caught up with the delta files found on start";
+    if (options_.on_delta_catch_up_done) {
+      options_.on_delta_catch_up_done();
+    }
+  }
+
+  absl::Time NextSnapshotCheck() const {
+    if (options_.generational_cache == nullptr) {
+      return absl::InfiniteFuture();
+    }
+    return absl::Now() + options_.snapshot_check_interval;
+  }
+
+  absl::Time NextCacheImageWrite() const {
+    if (options_.cache_image_path.empty()) {
+      return absl::InfiniteFuture();
+    }
+    return absl::Now() + options_.cache_image_interval;
+  }
+
+  // Writes the cache to `cache_image_path`, with the files loaded so far as
+  // its watermark. The image is complete, since the file loaders are paused.
+  void WriteCacheImageFile() const {
+    if (const auto status = WriteCacheImage(
+            options_.cache,
+            {.last_delta_basenames = last_loaded_deltas_,
+             .snapshot_basenames = snapshot_basenames_},
+            options_.cache_image_path);
+        !status.ok()) {
+      LOG(ERROR) << "Failed to write the cache image: " << status;
     }
   }
 
-  // Puts newly found file names into `unprocessed_basenames_`.
+  absl::Time NextSnapshotPublish() const {
+    if (options_.snapshot_publish_interval <= absl::ZeroDuration()) {
+      return absl::InfiniteFuture();
+    }
+    return absl::Now() + options_.snapshot_publish_interval;
+  }
+
+  // Publishes the cache as a snapshot of each prefix that loaded delta files
+  // since its last snapshot. The file loaders keep loading meanwhile: the
+  // mutations of the files after the ending delta file that make it into the
+  // snapshot are applied again, with no effect, by loaders of the snapshot.
+  // The snapshot loaded or published last is the starting file of the next.
+  void PublishSnapshots() {
+    absl::flat_hash_map<std::string, SnapshotMetadata> snapshots;
+    {
+      absl::MutexLock l(&mu_);
+      for (const auto& [prefix, last_loaded] : last_loaded_deltas_) {
+        if (last_loaded.empty() || !IsDeltaFilename(last_loaded)) {
+          continue;
+        }
+        if (auto iter = published_ending_deltas_.find(prefix);
+            iter != published_ending_deltas_.end() &&
+            iter->second == last_loaded) {
+          continue;
+        }
+        SnapshotMetadata& snapshot = snapshots[prefix];
+        auto iter = snapshot_basenames_.find(prefix);
+        snapshot.set_starting_file(iter != snapshot_basenames_.end()
+                                       ? iter->second
+                                       : last_loaded);
+        snapshot.set_ending_delta_file(last_loaded);
+      }
+    }
+    if (snapshots.empty()) {
+      return;
+    }
+    auto basenames = WriteCacheSnapshots(
+        options_.cache, snapshots, options_.blob_client,
+        {.bucket = options_.data_bucket,
+         .shard_num = options_.shard_num,
+         .num_shards = options_.num_shards,
+         .local_directory = options_.snapshot_publish_directory});
+    if (!basenames.ok()) {
+      LOG(ERROR) << "Failed to publish the cache snapshots: "
+                 << basenames.status();
+      return;
+    }
+    for (auto& [prefix, basename] : *basenames) {
+      published_ending_deltas_[prefix] =
+          snapshots[prefix].ending_delta_file();
+      // This replica already has the data of its own snapshot.
+      snapshot_basenames_[prefix] = std::move(basename);
+    }
+  }
+
+  // Loads the cache from the image at `cache_image_path`, and sets
+  // `snapshot_basenames` to the snapshot groups of the image. Returns the last
+  // delta file loaded into the image, per prefix.
+  static absl::StatusOr<absl::flat_hash_map<std::string, std::string>>
+  LoadCacheImageFile(
+      const Options& options,
+      absl::flat_hash_map<std::string, std::string>& snapshot_basenames) {
+    if (options.cache_image_path.empty()) {
+      return absl::NotFoundError("No cache image path");
+    }
+    auto watermark =
+        LoadCacheImage(options.cache_image_path, options.cache,
+                       std::max<int>(std::thread::hardware_concurrency(), 1));
+    if (!watermark.ok()) {
+      LOG(WARNING) << "Not loading the cache from its image: "
+                   << watermark.status();
+      return watermark.status();
+    }
+    LOG(INFO) << "Loaded the cache from " << options.cache_image_path;
+    snapshot_basenames = std::move(watermark->snapshot_basenames);
+    return std::move(watermark->last_delta_basenames);
+  }
+
+  // Builds the next cache generation if a prefix has a snapshot that is more
+  // recent than the one loaded, and swaps it in once it caught up with the
+  // delta files loaded so far. Mutations keep being applied to the current
+  // generation meanwhile.
+  void MaybeReloadSnapshots() {
+    bool has_new_snapshot = false;
+    for (const auto& prefix : options_.blob_prefix_allowlist.Prefixes()) {
+      auto snapshot_group = FindMostRecentFileGroup(
+          {.bucket = options_.data_bucket, .prefix = prefix},
+          FileGroupFilter{.file_type = FileType::SNAPSHOT,
+                          .status = FileGroup::FileStatus::kComplete},
+          options_.blob_client);
+      if (!snapshot_group.ok()) {
+        LOG(ERROR) << "Failed to look up snapshots in prefix " << prefix
+                   << ": " << snapshot_group.status();
+        return;
+      }
+      if (!snapshot_group->has_value()) {
+        continue;
+      }
+      if (auto iter = snapshot_basenames_.find(prefix);
+          iter == snapshot_basenames_.end() ||
+          (*snapshot_group)->Basename() > iter->second) {
+        has_new_snapshot = true;
+      }
+    }
+    if (!has_new_snapshot) {
+      return;
+    }
+    if (!HasMemoryHeadroomForNextGeneration()) {
+      LOG(WARNING) << "Not enough memory to reload the cache from the new "
+                      "snapshots. Skipping it.";
+      return;
+    }
+    LOG(INFO) << "Reloading the cache from new snapshots";
+    Cache& next = options_.generational_cache->StartNextGeneration();
+    absl::flat_hash_map<std::string, std::string> snapshot_basenames;
+    absl::flat_hash_map<std::string, std::string> ending_delta_files;
+    if (auto status =
+            LoadNextGeneration(next, snapshot_basenames, ending_delta_files);
+        !status.ok()) {
+      LOG(ERROR) << "Failed to reload the cache from new snapshots: "
+                 << status;
+      options_.generational_cache->AbandonNextGeneration();
+      return;
+    }
+    options_.generational_cache->SwapGenerations();
+    ServedDataVersion().Advance();
+    snapshot_basenames_ = std::move(snapshot_basenames);
+    snapshot_ending_deltas_ = std::move(ending_delta_files);
+    LOG(INFO) << "Done reloading the cache from new snapshots";
+  }
+
+  // Loads the most recent snapshots into `next`, then the delta files after
+  // them up to the last delta file loaded into the current generation. Sets
+  // `ending_delta_files` to the last delta file included in the snapshots.
+  absl::Status LoadNextGeneration(
+      Cache& next,
+      absl::flat_hash_map<std::string, std::string>& snapshot_basenames,
+      absl::flat_hash_map<std::string, std::string>& ending_delta_files) {
+    // Deleted values are cleaned up at once: the tombstone cleaner only knows
+    // about the current generation.
+    PS_ASSIGN_OR_RETURN(ending_delta_files,
+                        LoadSnapshotFiles(options_, next,
+                                          /*tombstone_cleaner=*/nullptr,
+                                          snapshot_basenames));
+    std::vector<absl::AnyInvocable<absl::Status()>> prefix_tasks;
+    for (const auto& prefix : options_.blob_prefix_allowlist.Prefixes()) {
+      const auto last_loaded = last_loaded_deltas_.find(prefix);
+      std::string start_after;
+      if (auto iter = ending_delta_files.find(prefix);
+          iter != ending_delta_files.end()) {
+        start_after = iter->second;
+      }
+      if (last_loaded == last_loaded_deltas_.end() ||
+          last_loaded->second <= start_after) {
+        continue;
+      }
+      PS_ASSIGN_OR_RETURN(
+          auto basenames,
+          options_.blob_client.ListBlobs(
+              {.bucket = options_.data_bucket, .prefix = prefix},
+              {.prefix = std::string(FilePrefix<FileType::DELTA>()),
+               .start_after = start_after}));
+      prefix_tasks.push_back([this, &next, prefix,
+                              last_loaded_basename = last_loaded->second,
+                              basenames = std::move(basenames)]()
+                                 -> absl::Status {
+        for (const auto& basename : basenames) {
+          if (!IsDeltaFilename(basename) || basename > last_loaded_basename) {
+            continue;
+          }
+          PS_RETURN_IF_ERROR(
+              TraceLoadCacheWithDataFromFile({.bucket = options_.data_bucket,
+                                              .prefix = prefix,
+                                              .key = basename},
+                                             options_, next,
+                                             /*tombstone_cleaner=*/nullptr)
+                  .status());
+        }
+        return absl::OkStatus();
+      });
+    }
+    return RunConcurrently(std::move(prefix_tasks),
+                           options_.max_concurrent_file_loads);
+  }
+
+  // Puts newly found file names into `unprocessed_files_`. Blocks while the
+  // queue is full.
   void EnqueueNewFilesToProcess(const std::string& basename) {
     absl::MutexLock l(&mu_);
-    unprocessed_basenames_.push_front(basename);
+    if (options_.max_queued_files > 0) {
+      mu_.Await(absl::Condition(this, &DataOrchestratorImpl::CanQueueFile));
+    }
+    if (stop_) {
+      return;
+    }
+    unprocessed_files_.push_back(
+        QueuedFile{.basename = basename, .queued_at = absl::Now()});
     LOG(INFO) << "queued " << basename << " for loading";
-    // TODO: block if the queue is too large: consumption is too slow.
   }
 
-  // Loads snapshot files if there are any.
+  // Loads snapshot files into `cache` if there are any, and sets
+  // `snapshot_basenames` to the basenames of the loaded snapshot groups.
   // Returns the latest delta file to be included in a snapshot.
   static absl::StatusOr<absl::flat_hash_map<std::string, std::string>>
-  LoadSnapshotFiles(const Options& options) {
-    absl::flat_hash_map<std::string, std::string> ending_delta_files;
-    for (const auto& prefix : options.blob_prefix_allowlist.Prefixes()) {
-      auto location = BlobStorageClient::DataLocation{
-          .bucket = options.data_bucket, .prefix = prefix};
-      LOG(INFO) << "Initializing cache with snapshot file(s) from: "
-                << location;
-      PS_ASSIGN_OR_RETURN(
-          auto snapshot_group,
-          FindMostRecentFileGroup(
-              location,
-              FileGroupFilter{.file_type = FileType::SNAPSHOT,
-                              .status = FileGroup::FileStatus::kComplete},
-              options.blob_client));
+  LoadSnapshotFiles(
+      const Options& options, Cache& cache, TombstoneCleaner* tombstone_cleaner,
+      absl::flat_hash_map<std::string, std::string>& snapshot_basenames) {
+    // A snapshot file of the most recent snapshot group of a prefix.
+    struct SnapshotFile {
+      BlobStorageClient::DataLocation location;
+      KVFileMetadata metadata;
+    };
+    absl::Mutex mutex;
+    // The snapshot groups of the prefixes are listed concurrently.
+    absl::flat_hash_map<std::string, std::optional<FileGroup>> snapshot_groups;
+    {
+      StartupReport::ScopedPhase startup_phase(ServerStartupReport(),
+                                               kStartupSnapshotListingPhase);
+      std::vector<absl::AnyInvocable<absl::Status()>> listing_tasks;
+      for (const auto& prefix : options.blob_prefix_allowlist.Prefixes()) {
+        listing_tasks.push_back([&options, &mutex, &snapshot_groups,
+                                 prefix]() -> absl::Status {
+          auto location = BlobStorageClient::DataLocation{
+              .bucket = options.data_bucket, .prefix = prefix};
+          LOG(INFO) << "Initializing cache with snapshot file(s) from: "
+                    << location;
+          PS_ASSIGN_OR_RETURN(
+              auto snapshot_group,
+              FindMostRecentFileGroup(
+                  location,
+                  FileGroupFilter{.file_type = FileType::SNAPSHOT,
+                                  .status = FileGroup::FileStatus::kComplete},
+                  options.blob_client));
+          if (!snapshot_group.has_value()) {
+            LOG(INFO) << "No snapshot files found in: " << location;
+          }
+          absl::MutexLock lock(&mutex);
+          snapshot_groups[prefix] = std::move(snapshot_group);
+          return absl::OkStatus();
+        });
+      }
+      PS_RETURN_IF_ERROR(RunConcurrently(std::move(listing_tasks),
+                                         options.max_concurrent_file_loads));
+    }
+    std::vector<SnapshotFile> snapshot_files;
+    for (const auto& [prefix, snapshot_group] : snapshot_groups) {
       if (!snapshot_group.has_value()) {
-        LOG(INFO) << "No snapshot files found in: " << location;
         continue;
       }
+      snapshot_basenames[prefix] = snapshot_group->Basename();
       for (const auto& snapshot : snapshot_group->Filenames()) {
-        auto snapshot_blob = BlobStorageClient::DataLocation{
-            .bucket = options.data_bucket, .prefix = prefix, .key = snapshot};
+        snapshot_files.push_back(
+            {.location = {.bucket = options.data_bucket,
+                          .prefix = prefix,
+                          .key = std::string(snapshot)}});
+      }
+    }
+    // The metadata of every file is read before any file is loaded, so that
+    // the loads aren't held up by the files of other shards, and is passed
+    // to the loads so that it isn't read twice.
+    std::vector<absl::AnyInvocable<absl::Status()>> metadata_tasks;
+    for (SnapshotFile& snapshot_file : snapshot_files) {
+      metadata_tasks.push_back([&options, &snapshot_file]() -> absl::Status {
         auto record_reader =
             options.delta_stream_reader_factory.CreateConcurrentReader(
-                /*stream_factory=*/[&snapshot_blob, &options]() {
+                /*stream_factory=*/[&snapshot_file, &options]() {
                   return std::make_unique<BlobRecordStream>(
-                      options.blob_client.GetBlobReader(snapshot_blob));
+                      options.blob_client.GetBlobReader(
+                          snapshot_file.location));
                 });
-        PS_ASSIGN_OR_RETURN(auto metadata, record_reader->GetKVFileMetadata());
-        if (metadata.has_sharding_metadata() &&
-            metadata.sharding_metadata().shard_num() != options.shard_num) {
-          LOG(INFO) << "Snapshot " << snapshot_blob << " belongs to shard num "
-                    << metadata.sharding_metadata().shard_num()
-                    << " but server shard num is " << options.shard_num
-                    << ". Skipping it.";
-          continue;
-        }
+        PS_ASSIGN_OR_RETURN(snapshot_file.metadata,
+                            record_reader->GetKVFileMetadata(),
+                            _ << "Snapshot " << snapshot_file.location);
+        return absl::OkStatus();
+      });
+    }
+    PS_RETURN_IF_ERROR(RunConcurrently(std::move(metadata_tasks),
+                                       options.max_concurrent_file_loads));
+    // The files of the snapshot groups of all prefixes are independent, they
+    // are loaded concurrently.
+    absl::flat_hash_map<std::string, std::string> ending_delta_files;
+    std::vector<absl::AnyInvocable<absl::Status()>> snapshot_tasks;
+    for (const SnapshotFile& snapshot_file : snapshot_files) {
+      const BlobStorageClient::DataLocation& snapshot_blob =
+          snapshot_file.location;
+      const KVFileMetadata& metadata = snapshot_file.metadata;
+      if (BelongsToOtherShard(metadata, options)) {
+        LOG(INFO) << "Snapshot " << snapshot_blob << " belongs to shard num "
+                  << metadata.sharding_metadata().shard_num()
+                  << " but server shard num is " << options.shard_num
+                  << ". Skipping it.";
+        continue;
+      }
+      if (auto iter = ending_delta_files.find(snapshot_blob.prefix);
+          iter == ending_delta_files.end() ||
+          metadata.snapshot().ending_delta_file() > iter->second) {
+        ending_delta_files[snapshot_blob.prefix] =
+            metadata.snapshot().ending_delta_file();
+      }
+      snapshot_tasks.push_back([&options, &cache, tombstone_cleaner,
+                                &snapshot_blob, &metadata]() -> absl::Status {
         LOG(INFO) << "Loading snapshot file: " << snapshot_blob;
+        const absl::Time load_start = absl::Now();
         PS_ASSIGN_OR_RETURN(
-            auto stats, TraceLoadCacheWithDataFromFile(snapshot_blob, options));
-        if (auto iter = ending_delta_files.find(prefix);
-            iter == ending_delta_files.end() ||
-            metadata.snapshot().ending_delta_file() > iter->second) {
-          ending_delta_files[prefix] = metadata.snapshot().ending_delta_file();
-        }
+            auto stats,
+            TraceLoadCacheWithDataFromFile(snapshot_blob, options, cache,
+                                           tombstone_cleaner,
+                                           /*merge=*/nullptr, &metadata));
+        ServerStartupReport().AddFileLoad(BlobName(snapshot_blob),
+                                          absl::Now() - load_start);
         LOG(INFO) << "Done loading snapshot file: " << snapshot_blob;
-      }
+        return absl::OkStatus();
+      });
     }
+    StartupReport::ScopedPhase startup_phase(ServerStartupReport(),
+                                             kStartupSnapshotLoadPhase);
+    PS_RETURN_IF_ERROR(RunConcurrently(std::move(snapshot_tasks),
+                                       options.max_concurrent_file_loads));
     return ending_delta_files;
   }
 
+  // Realtime updates received within the batch window, applied by the
+  // caller that opened the batch once the window is over.
+  struct RealtimeBatch {
+    std::vector<std::string> updates;
+    bool applied = false;
+    absl::StatusOr<DataLoadingStats> result;
+  };
+
+  // Adds `updates` to the open realtime batch, opening one if there is none,
+  // and returns once the batch is applied. The stats of the batch are
+  // returned to the caller that opened it, the other callers get empty stats.
+  absl::StatusOr<DataLoadingStats> LoadRealtimeUpdatesInBatchWindow(
+      absl::Span<const std::string> updates)
+      ABSL_LOCKS_EXCLUDED(realtime_batch_mu_) {
+    std::shared_ptr<RealtimeBatch> batch;
+    {
+      absl::MutexLock lock(&realtime_batch_mu_);
+      const bool opens_batch = open_realtime_batch_ == nullptr;
+      if (opens_batch) {
+        open_realtime_batch_ = std::make_shared<RealtimeBatch>();
+      }
+      batch = open_realtime_batch_;
+      batch->updates.insert(batch->updates.end(), updates.begin(),
+                            updates.end());
+      if (!opens_batch) {
+        realtime_batch_mu_.Await(absl::Condition(&batch->applied));
+        if (!batch->result.ok()) {
+          return batch->result.status();
+        }
+        return DataLoadingStats{};
+      }
+    }
+    absl::SleepFor(options_.realtime_batch_window);
+    {
+      absl::MutexLock lock(&realtime_batch_mu_);
+      open_realtime_batch_ = nullptr;
+    }
+    // The batch is closed, so its updates are no longer written to.
+    absl::StatusOr<DataLoadingStats> result = LoadCacheWithHighPriorityUpdates(
+        kDefaultDataSourceForRealtimeUpdates, kDefaultPrefixForRealTimeUpdates,
+        options_.delta_stream_reader_factory, batch->updates, options_.cache,
+        /*merge_updates=*/true);
+    absl::MutexLock lock(&realtime_batch_mu_);
+    batch->result = result;
+    batch->applied = true;
+    return result;
+  }
+
+  // Loads the high priority updates received together as one batch, each
+  // message a serialized delta stream or a realtime envelope. If
+  // `merge_updates` is set, only the latest mutation of each key of the batch
+  // is applied.
   absl::StatusOr<DataLoadingStats> LoadCacheWithHighPriorityUpdates(
       std::string_view data_source, std::string_view prefix,
       StreamRecordReaderFactory& delta_stream_reader_factory,
-      const std::string& record_string, Cache& cache) {
-    std::istringstream is(record_string);
+      absl::Span<const std::string> record_strings, Cache& cache,
+      bool merge_updates = false) {
+    std::vector<std::unique_ptr<std::istringstream>> streams;
+    std::vector<std::unique_ptr<StreamRecordReader>> record_readers;
+    std::vector<StreamRecordReader*> readers;
+    streams.reserve(record_strings.size());
+    record_readers.reserve(record_strings.size());
+    readers.reserve(record_strings.size());
+    for (const std::string& record_string : record_strings) {
+      // Envelopes are read in place, without a stream nor a delta file
+      // reader.
+      if (IsRealtimeEnvelope(record_string)) {
+        record_readers.push_back(
+            std::make_unique<RealtimeEnvelopeRecordReader>(record_string));
+      } else {
+        streams.push_back(std::make_unique<std::istringstream>(record_string));
+        record_readers.push_back(
+            delta_stream_reader_factory.CreateReader(*streams.back()));
+      }
+      readers.push_back(record_readers.back().get());
+    }
     int64_t max_timestamp = 0;
-    auto record_reader = delta_stream_reader_factory.CreateReader(is);
-    return LoadCacheWithData(data_source, prefix, *record_reader, cache,
-                             max_timestamp, options_.shard_num,
-                             options_.num_shards, options_.udf_client,
-                             options_.key_sharder);
+    if (!merge_updates) {
+      return LoadCacheWithData(
+          data_source, prefix, DataFreshnessSource::kRealtime, readers, cache,
+          max_timestamp, options_.shard_num, options_.num_shards,
+          options_.udf_client, options_.key_sharder);
+    }
+    LastWriterWinsMerge merge(DataFreshnessSource::kRealtime);
+    absl::StatusOr<DataLoadingStats> stats = LoadCacheWithData(
+        data_source, prefix, DataFreshnessSource::kRealtime, readers, cache,
+        max_timestamp, options_.shard_num, options_.num_shards,
+        options_.udf_client, options_.key_sharder,
+        /*verification_interval=*/1, &merge);
+    // Like the unmerged path, the mutations read before a failure are
+    // applied.
+    const int64_t num_applied = merge.Apply(cache, prefix);
+    VLOG(2) << "Applied " << num_applied << " merged mutations of "
+            << record_strings.size() << " realtime updates";
+    return stats;
   }
 
   const Options options_;
-  absl::Mutex mu_;
-  std::deque<std::string> unprocessed_basenames_ ABSL_GUARDED_BY(mu_);
+  absl::Mutex realtime_batch_mu_;
+  std::shared_ptr<RealtimeBatch> open_realtime_batch_
+      ABSL_GUARDED_BY(realtime_batch_mu_);
+  mutable absl::Mutex mu_;
+  std::deque<QueuedFile> unprocessed_files_ ABSL_GUARDED_BY(mu_);
+  // New delta files waiting to be loaded by the file loader threads.
+  absl::flat_hash_map<std::string, PrefixQueue> prefix_queues_
+      ABSL_GUARDED_BY(mu_);
+  int num_loading_files_ ABSL_GUARDED_BY(mu_) = 0;
+  // The delta files found on start not loaded yet, by prefix. A prefix is
+  // removed once it is caught up.
+  absl::flat_hash_map<std::string, DeltaCatchUp> delta_catch_ups_
+      ABSL_GUARDED_BY(mu_);
+  bool loaders_paused_ ABSL_GUARDED_BY(mu_) = false;
   std::unique_ptr<std::thread> data_loader_thread_;
+  std::vector<std::thread> file_loader_threads_;
   bool stop_ ABSL_GUARDED_BY(mu_) = false;
   // last basename of file in initialization.
   absl::flat_hash_map<std::string, std::string> prefix_last_basenames_;
+  // Last delta file loaded per prefix. Updated by the file loader threads
+  // under `mu_`, read by the data loader thread while they are paused.
+  absl::flat_hash_map<std::string, std::string> last_loaded_deltas_;
+  // Basename of the snapshot group loaded per prefix. Only used by the data
+  // loader thread.
+  absl::flat_hash_map<std::string, std::string> snapshot_basenames_;
+  // Last delta file included in the snapshot group reloaded per prefix.
+  // Updated by the data loader thread while the file loader threads are
+  // paused.
+  absl::flat_hash_map<std::string, std::string> snapshot_ending_deltas_;
+  // Ending delta file of the snapshot published last per prefix. Only used by
+  // the data loader thread.
+  absl::flat_hash_map<std::string, std::string> published_ending_deltas_;
 };
 
 }  // namespace
 
+absl::flat_hash_map<std::string, double>
+DataOrchestrator::GetFreshnessLagsInMicros() {
+  absl::flat_hash_map<std::string, double> lags;
+  const absl::Time now = absl::Now();
+  OrchestratorRegistry& registry = GetOrchestratorRegistry();
+  absl::MutexLock lock(&registry.mutex);
+  for (const DataOrchestratorImpl* orchestrator : registry.orchestrators) {
+    orchestrator->AddFreshnessLags(now, lags);
+  }
+  return lags;
+}
+
+absl::flat_hash_map<std::string, double>
+DataOrchestrator::GetDeltaCatchUpBacklogs() {
+  absl::flat_hash_map<std::string, double> backlogs;
+  OrchestratorRegistry& registry = GetOrchestratorRegistry();
+  absl::MutexLock lock(&registry.mutex);
+  for (const DataOrchestratorImpl* orchestrator : registry.orchestrators) {
+    orchestrator->AddDeltaCatchUpBacklogs(backlogs);
+  }
+  return backlogs;
+}
+
 absl::StatusOr<std::unique_ptr<DataOrchestrator>> DataOrchestrator::TryCreate(
     Options options) {
-  const auto prefix_last_basenames = DataOrchestratorImpl::Init(options);
+  absl::flat_hash_map<std::string, std::string> snapshot_basenames;
+  absl::flat_hash_map<std::string, DeltaCatchUp> delta_catch_ups;
+  const auto prefix_last_basenames = DataOrchestratorImpl::Init(
+      options, snapshot_basenames, delta_catch_ups);
   if (!prefix_last_basenames.ok()) {
     return prefix_last_basenames.status();
   }
   auto orchestrator = std::make_unique<DataOrchestratorImpl>(
-      std::move(options), std::move(prefix_last_basenames.value()));
+      std::move(options), std::move(prefix_last_basenames.value()),
+      std::move(snapshot_basenames), std::move(delta_catch_ups));
   return orchestrator;
 }
 }  // namespace kv_server
@@ -15,13 +15,16 @@
 #ifndef COMPONENTS_DATA_SERVER_DATA_LOADING_DATA_ORCHESTRATOR_H_
 #define COMPONENTS_DATA_SERVER_DATA_LOADING_DATA_ORCHESTRATOR_H_
 
+#include <functional>
 #include <memory>
 #include <string>
 #include <thread>
 #include <vector>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/functional/any_invocable.h"
 #include "absl/status/status.h"
+#include "absl/time/time.h"
 #include "components/data/blob_storage/blob_prefix_allowlist.h"
 #include "components/data/blob_storage/blob_storage_change_notifier.h"
 #include "components/data/blob_storage/blob_storage_client.h"
@@ -29,6 +32,9 @@
 #include "components/data/realtime/realtime_notifier.h"
 #include "components/data/realtime/realtime_thread_pool_manager.h"
 #include "components/data_server/cache/cache.h"
+#include "components/data_server/cache/generational_cache.h"
+#include "components/data_server/cache/tombstone_cleaner.h"
+#include "components/data_server/data_loading/shard_file_store.h"
 #include "components/udf/udf_client.h"
 #include "public/data_loading/readers/riegeli_stream_io.h"
 #include "public/data_loading/readers/stream_record_reader_factory.h"
@@ -58,6 +64,73 @@ class DataOrchestrator {
     const int32_t num_shards = 1;
     const KeySharder key_sharder;
     BlobPrefixAllowlist blob_prefix_allowlist;
+    // If set, the values deleted by a file are removed in the background
+    // after the file is loaded, instead of before the next file is loaded.
+    TombstoneCleaner* tombstone_cleaner = nullptr;
+    // If set, `cache` must be this cache. Every `snapshot_check_interval`,
+    // the cache is rebuilt in a new generation if there are new snapshots,
+    // and the new generation is swapped in once it is up to date.
+    GenerationalCache* generational_cache = nullptr;
+    absl::Duration snapshot_check_interval = absl::Minutes(10);
+    // If set, the cache is loaded from the image at this local path on start,
+    // if there is one, instead of from the snapshots, and only the delta files
+    // after the image are loaded. The image is rewritten every
+    // `cache_image_interval`.
+    std::string cache_image_path;
+    absl::Duration cache_image_interval = absl::Minutes(30);
+    // Maximum number of files loaded at once. The files of a snapshot group
+    // and the prefixes are loaded concurrently, the delta files of a prefix
+    // one after another once the snapshots are loaded. New delta files are
+    // loaded by this many workers, each loading the file of a different
+    // prefix, so that a large file only delays the files of its own prefix.
+    int max_concurrent_file_loads = 1;
+    // If positive, the delta notifier is blocked while this many new files
+    // are waiting to be loaded, so that a backlog waits in the bucket.
+    int max_queued_files = 0;
+    // If positive and `generational_cache` is set, the snapshots are checked
+    // as soon as this many new files are waiting, instead of at the next
+    // `snapshot_check_interval`. Waiting delta files that are included in a
+    // reloaded snapshot are skipped.
+    int snapshot_check_backlog = 0;
+    // If positive, a prefix with at least this many delta files to load on
+    // start loads them through one in-memory merge that keeps the latest
+    // mutation of each key, so that each key is applied to the cache once.
+    // The merge holds a copy of the latest value of every key of the files.
+    int catch_up_min_files = 0;
+    // The flatbuffer of one of every this many records of files whose
+    // metadata marks their records as trusted is verified, the others are
+    // only checked by the Riegeli chunk checksums. 1 verifies all records,
+    // 0 none. Once a record of a file fails, the rest of it is verified.
+    int trusted_file_verification_interval = 1;
+    // If positive, the realtime updates received within this window of each
+    // other are applied together through a merge that keeps the latest
+    // mutation of each key, so that a burst of updates to the same keys takes
+    // the cache locks once. Updates wait up to the window to be applied.
+    absl::Duration realtime_batch_window = absl::ZeroDuration();
+    // Added to the nice value of the threads that load new files, so that
+    // the scheduler favors the threads that serve requests. The batches of
+    // cache writes of the files also wait for `DataLoadingGovernor()` while
+    // serving is over its latency target.
+    int loader_thread_nice_increment = 0;
+    // If positive, the cache is published as a snapshot of each prefix every
+    // this often, ending at the last delta file loaded of the prefix, so that
+    // other replicas start from it instead of replaying the delta files. Set
+    // on one replica per shard. The snapshot files are written to
+    // `snapshot_publish_directory` before they are uploaded to `data_bucket`.
+    absl::Duration snapshot_publish_interval = absl::ZeroDuration();
+    std::string snapshot_publish_directory = "/tmp";
+    // If set, the replicas of the shard share the records of the shard in
+    // each file that has the records of every shard, so that one of them
+    // downloads and filters the file. Not used with logical shards.
+    ShardFileStore* shard_file_store = nullptr;
+    // If set, the orchestrator is created once the snapshots are loaded, and
+    // the delta files after them are loaded in the background once started,
+    // like new delta files, so that the server serves the data of the
+    // snapshots while it catches up.
+    bool serve_before_delta_catch_up = false;
+    // Called once, from a file loader thread or `Start`, when the delta files
+    // found on start are loaded.
+    std::function<void()> on_delta_catch_up_done;
   };
 
   // Creates initial state. Scans the bucket and initializes the cache with data
@@ -69,6 +142,17 @@ class DataOrchestrator {
   // this object is destructed.
   // Returns immediately without blocking.
   virtual absl::Status Start() = 0;
+
+  // Returns how long the oldest new delta file of each prefix has been
+  // waiting to be loaded, in microseconds, over the started orchestrators of
+  // the process. Exported as the `kDeltaFileFreshnessLagInMicros` gauge.
+  static absl::flat_hash_map<std::string, double> GetFreshnessLagsInMicros();
+
+  // Returns the number of delta files found on start that are not loaded yet,
+  // by prefix, over the started orchestrators of the process. Only delta
+  // files loaded in the background with `serve_before_delta_catch_up` are
+  // counted. Exported as the `kDeltaCatchUpBacklogFiles` gauge.
+  static absl::flat_hash_map<std::string, double> GetDeltaCatchUpBacklogs();
 };
 }  // namespace kv_server
 
@@ -15,14 +15,19 @@
 #include "components/data_server/data_loading/data_orchestrator.h"
 
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/log/log.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/synchronization/notification.h"
 #include "components/data/common/mocks.h"
 #include "components/data/realtime/realtime_notifier.h"
 #include "components/data_server/cache/cache.h"
+#include "components/data_server/cache/generational_cache.h"
 #include "components/data_server/cache/mocks.h"
 #include "components/udf/code_config.h"
 #include "components/udf/mocks.h"
@@ -31,6 +36,7 @@
 #include "gtest/gtest.h"
 #include "public/constants.h"
 #include "public/data_loading/filename_utils.h"
+#include "public/data_loading/readers/realtime_envelope.h"
 #include "public/data_loading/records_utils.h"
 #include "public/sharding/key_sharder.h"
 #include "public/sharding/sharding_function.h"
@@ -45,6 +51,7 @@ using kv_server::DataOrchestrator;
 using kv_server::DataRecordStruct;
 using kv_server::FilePrefix;
 using kv_server::FileType;
+using kv_server::GenerationalCache;
 using kv_server::KeyValueMutationRecordStruct;
 using kv_server::KeyValueMutationType;
 using kv_server::KVFileMetadata;
@@ -70,6 +77,7 @@ using testing::_;
 using testing::AllOf;
 using testing::ByMove;
 using testing::Field;
+using testing::Gt;
 using testing::Pair;
 using testing::Return;
 using testing::ReturnRef;
@@ -217,10 +225,9 @@ TEST_F(DataOrchestratorTest, InitCacheFiltersDeltasUsingSnapshotEndingFile) {
   EXPECT_CALL(*record_reader1, GetKVFileMetadata)
       .Times(1)
       .WillOnce(Return(metadata));
+  // The metadata read first is reused to load the snapshot.
   auto record_reader2 = std::make_unique<MockStreamRecordReader>();
-  EXPECT_CALL(*record_reader2, GetKVFileMetadata)
-      .Times(1)
-      .WillOnce(Return(metadata));
+  EXPECT_CALL(*record_reader2, GetKVFileMetadata).Times(0);
   EXPECT_CALL(delta_stream_reader_factory_, CreateConcurrentReader)
       .Times(2)
       .WillOnce(Return(ByMove(std::move(record_reader1))))
@@ -372,6 +379,284 @@ TEST_F(DataOrchestratorTest, InitCacheSuccess) {
   EXPECT_FALSE((*maybe_orchestrator)->Start().ok());
 }
 
+TEST_F(DataOrchestratorTest, InitCacheMergesLongDeltaChains) {
+  DataOrchestrator::Options options{
+      .data_bucket = GetTestLocation().bucket,
+      .cache = cache_,
+      .blob_client = blob_client_,
+      .delta_notifier = notifier_,
+      .change_notifier = change_notifier_,
+      .udf_client = udf_client_,
+      .delta_stream_reader_factory = delta_stream_reader_factory_,
+      .realtime_thread_pool_manager = realtime_thread_pool_manager_,
+      .key_sharder =
+          kv_server::KeySharder(kv_server::ShardingFunction{/*seed=*/""}),
+      .blob_prefix_allowlist = kv_server::BlobPrefixAllowlist(""),
+      .catch_up_min_files = 2,
+  };
+  EXPECT_CALL(blob_client_,
+              ListBlobs(_, Field(&BlobStorageClient::ListOptions::prefix,
+                                 FilePrefix<FileType::SNAPSHOT>())))
+      .WillOnce(Return(std::vector<std::string>()));
+  EXPECT_CALL(blob_client_,
+              ListBlobs(_, Field(&BlobStorageClient::ListOptions::prefix,
+                                 FilePrefix<FileType::DELTA>())))
+      .WillOnce(Return(std::vector<std::string>(
+          {ToDeltaFileName(1).value(), ToDeltaFileName(2).value()})));
+  const auto create_reader =
+      [](std::vector<KeyValueMutationRecordStruct> records) {
+        auto reader = std::make_unique<MockStreamRecordReader>();
+        EXPECT_CALL(*reader, GetKVFileMetadata)
+            .WillOnce(Return(KVFileMetadata()));
+        EXPECT_CALL(*reader, ReadStreamRecords)
+            .WillOnce([records = std::move(records)](
+                          const std::function<absl::Status(std::string_view)>&
+                              callback) {
+              for (const auto& record : records) {
+                callback(ToStringView(ToFlatBufferBuilder(
+                             DataRecordStruct{.record = record})))
+                    .IgnoreError();
+              }
+              return absl::OkStatus();
+            });
+        return reader;
+      };
+  EXPECT_CALL(delta_stream_reader_factory_, CreateConcurrentReader)
+      .WillOnce(Return(ByMove(create_reader({
+          {KeyValueMutationType::Update, 3, "bar", "old bar value"},
+          {KeyValueMutationType::Update, 3, "foo", "foo value"},
+      }))))
+      .WillOnce(Return(ByMove(create_reader({
+          {KeyValueMutationType::Update, 5, "bar", "bar value"},
+          {KeyValueMutationType::Delete, 4, "foo", ""},
+      }))));
+
+  // Only the latest mutation of each key is applied, and the deleted values
+  // are removed once, after both files.
+  EXPECT_CALL(cache_, UpdateKeyValue("bar", "bar value", 5, _)).Times(1);
+  EXPECT_CALL(cache_, DeleteKey("foo", 4, _)).Times(1);
+  EXPECT_CALL(cache_, RemoveDeletedKeys(5, _)).Times(1);
+
+  auto maybe_orchestrator = DataOrchestrator::TryCreate(options);
+  ASSERT_TRUE(maybe_orchestrator.ok()) << maybe_orchestrator.status();
+}
+
+TEST_F(DataOrchestratorTest, InitCacheAppliesAllRecordsOfPartialBatches) {
+  const std::vector<std::string> fnames({ToDeltaFileName(1).value()});
+  EXPECT_CALL(
+      blob_client_,
+      ListBlobs(GetTestLocation(),
+                AllOf(Field(&BlobStorageClient::ListOptions::start_after, ""),
+                      Field(&BlobStorageClient::ListOptions::prefix,
+                            FilePrefix<FileType::SNAPSHOT>()))))
+      .WillOnce(Return(std::vector<std::string>()));
+  EXPECT_CALL(
+      blob_client_,
+      ListBlobs(GetTestLocation(),
+                AllOf(Field(&BlobStorageClient::ListOptions::start_after, ""),
+                      Field(&BlobStorageClient::ListOptions::prefix,
+                            FilePrefix<FileType::DELTA>()))))
+      .WillOnce(Return(fnames));
+
+  KVFileMetadata metadata;
+  auto update_reader = std::make_unique<MockStreamRecordReader>();
+  EXPECT_CALL(*update_reader, GetKVFileMetadata)
+      .Times(1)
+      .WillOnce(Return(metadata));
+  EXPECT_CALL(*update_reader, ReadStreamRecords)
+      .Times(1)
+      .WillOnce(
+          [](const std::function<absl::Status(std::string_view)>& callback) {
+            // More than one batch, the record bytes are released after each
+            // callback.
+            for (int i = 0; i < 1500; i++) {
+              const std::string key = absl::StrCat("key", i);
+              const KeyValueMutationRecordStruct record{
+                  KeyValueMutationType::Update, i, key, "value"};
+              const DataRecordStruct data_record{.record = record};
+              callback(ToStringView(ToFlatBufferBuilder(data_record)))
+                  .IgnoreError();
+            }
+            return absl::OkStatus();
+          });
+  EXPECT_CALL(delta_stream_reader_factory_, CreateConcurrentReader)
+      .WillOnce(Return(ByMove(std::move(update_reader))));
+
+  EXPECT_CALL(cache_, UpdateKeyValue(_, "value", _, _)).Times(1499);
+  EXPECT_CALL(cache_, UpdateKeyValue("key1499", "value", 1499, _)).Times(1);
+  EXPECT_CALL(cache_, RemoveDeletedKeys(1499, _)).Times(1);
+
+  auto maybe_orchestrator = DataOrchestrator::TryCreate(options_);
+  ASSERT_TRUE(maybe_orchestrator.ok());
+}
+
+TEST_F(DataOrchestratorTest, InitCacheLoadsTrustedFilesWithoutVerifying) {
+  const std::vector<std::string> fnames({ToDeltaFileName(1).value()});
+  EXPECT_CALL(
+      blob_client_,
+      ListBlobs(GetTestLocation(),
+                AllOf(Field(&BlobStorageClient::ListOptions::start_after, ""),
+                      Field(&BlobStorageClient::ListOptions::prefix,
+                            FilePrefix<FileType::SNAPSHOT>()))))
+      .WillOnce(Return(std::vector<std::string>()));
+  EXPECT_CALL(
+      blob_client_,
+      ListBlobs(GetTestLocation(),
+                AllOf(Field(&BlobStorageClient::ListOptions::start_after, ""),
+                      Field(&BlobStorageClient::ListOptions::prefix,
+                            FilePrefix<FileType::DELTA>()))))
+      .WillOnce(Return(fnames));
+
+  KVFileMetadata metadata;
+  metadata.set_trusted_records(true);
+  auto update_reader = std::make_unique<MockStreamRecordReader>();
+  EXPECT_CALL(*update_reader, GetKVFileMetadata).WillOnce(Return(metadata));
+  EXPECT_CALL(*update_reader, ReadStreamRecords)
+      .WillOnce(
+          [](const std::function<absl::Status(std::string_view)>& callback) {
+            const DataRecordStruct bar{
+                .record = KeyValueMutationRecordStruct{
+                    KeyValueMutationType::Update, 3, "bar", "bar value"}};
+            callback(ToStringView(ToFlatBufferBuilder(bar))).IgnoreError();
+            // Records that aren't verified are still validated.
+            flatbuffers::FlatBufferBuilder empty_record;
+            empty_record.Finish(CreateDataRecord(empty_record));
+            EXPECT_FALSE(callback(ToStringView(empty_record)).ok());
+            const DataRecordStruct foo{
+                .record = KeyValueMutationRecordStruct{
+                    KeyValueMutationType::Update, 4, "foo", "foo value"}};
+            callback(ToStringView(ToFlatBufferBuilder(foo))).IgnoreError();
+            return absl::OkStatus();
+          });
+  EXPECT_CALL(delta_stream_reader_factory_, CreateConcurrentReader)
+      .WillOnce(Return(ByMove(std::move(update_reader))));
+
+  EXPECT_CALL(cache_, UpdateKeyValue("bar", "bar value", 3, _)).Times(1);
+  EXPECT_CALL(cache_, UpdateKeyValue("foo", "foo value", 4, _)).Times(1);
+  EXPECT_CALL(cache_, RemoveDeletedKeys(4, _)).Times(1);
+
+  options_.trusted_file_verification_interval = 0;
+  auto maybe_orchestrator = DataOrchestrator::TryCreate(options_);
+  ASSERT_TRUE(maybe_orchestrator.ok());
+}
+
+TEST_F(DataOrchestratorTest, InitCacheAppliesConcurrentRecordsOfAKeyInOrder) {
+  const std::vector<std::string> fnames({ToDeltaFileName(1).value()});
+  EXPECT_CALL(
+      blob_client_,
+      ListBlobs(GetTestLocation(),
+                AllOf(Field(&BlobStorageClient::ListOptions::start_after, ""),
+                      Field(&BlobStorageClient::ListOptions::prefix,
+                            FilePrefix<FileType::SNAPSHOT>()))))
+      .WillOnce(Return(std::vector<std::string>()));
+  EXPECT_CALL(
+      blob_client_,
+      ListBlobs(GetTestLocation(),
+                AllOf(Field(&BlobStorageClient::ListOptions::start_after, ""),
+                      Field(&BlobStorageClient::ListOptions::prefix,
+                            FilePrefix<FileType::DELTA>()))))
+      .WillOnce(Return(fnames));
+
+  KVFileMetadata metadata;
+  auto update_reader = std::make_unique<MockStreamRecordReader>();
+  EXPECT_CALL(*update_reader, GetKVFileMetadata)
+      .Times(1)
+      .WillOnce(Return(metadata));
+  EXPECT_CALL(*update_reader, ReadStreamRecords)
+      .Times(1)
+      .WillOnce(
+          [](const std::function<absl::Status(std::string_view)>& callback) {
+            // Two readers of different keys, as for two shards of a file.
+            std::vector<std::thread> readers;
+            for (const std::string_view reader : {"a", "b"}) {
+              readers.emplace_back([&callback, reader]() {
+                for (int i = 1; i <= 5000; i++) {
+                  const std::string key = absl::StrCat(reader, i % 10);
+                  const KeyValueMutationRecordStruct record{
+                      KeyValueMutationType::Update, i, key, "value"};
+                  const DataRecordStruct data_record{.record = record};
+                  callback(ToStringView(ToFlatBufferBuilder(data_record)))
+                      .IgnoreError();
+                }
+              });
+            }
+            for (auto& reader : readers) {
+              reader.join();
+            }
+            return absl::OkStatus();
+          });
+  EXPECT_CALL(delta_stream_reader_factory_, CreateConcurrentReader)
+      .WillOnce(Return(ByMove(std::move(update_reader))));
+
+  absl::Mutex mutex;
+  absl::flat_hash_map<std::string, int64_t> last_timestamps;
+  bool in_order = true;
+  EXPECT_CALL(cache_, UpdateKeyValue(_, "value", _, _))
+      .Times(10000)
+      .WillRepeatedly([&](std::string_view key, std::string_view value,
+                          int64_t logical_commit_time, std::string_view) {
+        absl::MutexLock lock(&mutex);
+        int64_t& last_timestamp = last_timestamps[key];
+        in_order = in_order && last_timestamp < logical_commit_time;
+        last_timestamp = logical_commit_time;
+      });
+  EXPECT_CALL(cache_, RemoveDeletedKeys(5000, _)).Times(1);
+
+  auto maybe_orchestrator = DataOrchestrator::TryCreate(options_);
+  ASSERT_TRUE(maybe_orchestrator.ok());
+  EXPECT_TRUE(in_order);
+}
+
+TEST_F(DataOrchestratorTest, InitCacheSchedulesBackgroundCleanup) {
+  const std::vector<std::string> fnames({ToDeltaFileName(1).value()});
+  EXPECT_CALL(
+      blob_client_,
+      ListBlobs(GetTestLocation(),
+                AllOf(Field(&BlobStorageClient::ListOptions::start_after, ""),
+                      Field(&BlobStorageClient::ListOptions::prefix,
+                            FilePrefix<FileType::SNAPSHOT>()))))
+      .WillOnce(Return(std::vector<std::string>()));
+  EXPECT_CALL(
+      blob_client_,
+      ListBlobs(GetTestLocation(),
+                AllOf(Field(&BlobStorageClient::ListOptions::start_after, ""),
+                      Field(&BlobStorageClient::ListOptions::prefix,
+                            FilePrefix<FileType::DELTA>()))))
+      .WillOnce(Return(fnames));
+
+  KVFileMetadata metadata;
+  auto delete_reader = std::make_unique<MockStreamRecordReader>();
+  EXPECT_CALL(*delete_reader, GetKVFileMetadata)
+      .Times(1)
+      .WillOnce(Return(metadata));
+  EXPECT_CALL(*delete_reader, ReadStreamRecords)
+      .Times(1)
+      .WillOnce(
+          [](const std::function<absl::Status(std::string_view)>& callback) {
+            callback(ToStringView(ToFlatBufferBuilder(
+                         DataRecordStruct{.record =
+                                              KeyValueMutationRecordStruct{
+                                                  KeyValueMutationType::Delete,
+                                                  3, "bar", "bar value"}})))
+                .IgnoreError();
+            return absl::OkStatus();
+          });
+  EXPECT_CALL(delta_stream_reader_factory_, CreateConcurrentReader)
+      .WillOnce(Return(ByMove(std::move(delete_reader))));
+
+  EXPECT_CALL(cache_, DeleteKey("bar", 3, _)).Times(1);
+  EXPECT_CALL(cache_, RemoveDeletedKeys).Times(0);
+  EXPECT_CALL(cache_, RemoveDeletedKeysSlice(3, "", _))
+      .WillOnce(Return(Cache::CleanupProgress{.done = true}));
+
+  auto tombstone_cleaner = TombstoneCleaner::Create(cache_, {});
+  DataOrchestrator::Options options = options_;
+  options.tombstone_cleaner = tombstone_cleaner.get();
+  auto maybe_orchestrator = DataOrchestrator::TryCreate(options);
+  ASSERT_TRUE(maybe_orchestrator.ok());
+  tombstone_cleaner->WaitUntilDone();
+}
+
 TEST_F(DataOrchestratorTest, UpdateUdfCodeSuccess) {
   const std::vector<std::string> fnames({ToDeltaFileName(1).value()});
   EXPECT_CALL(
@@ -409,9 +694,10 @@ TEST_F(DataOrchestratorTest, UpdateUdfCodeSuccess) {
   EXPECT_CALL(delta_stream_reader_factory_, CreateConcurrentReader)
       .WillOnce(Return(ByMove(std::move(reader))));
 
-  EXPECT_CALL(udf_client_, SetCodeObject(CodeConfig{.js = "function hello(){}",
-                                                    .udf_handler_name = "hello",
-                                                    .logical_commit_time = 1}))
+  EXPECT_CALL(udf_client_,
+              SetCodeObjectAsync(CodeConfig{.js = "function hello(){}",
+                                            .udf_handler_name = "hello",
+                                            .logical_commit_time = 1}))
       .WillOnce(Return(absl::OkStatus()));
   auto maybe_orchestrator = DataOrchestrator::TryCreate(options_);
   ASSERT_TRUE(maybe_orchestrator.ok());
@@ -461,9 +747,10 @@ TEST_F(DataOrchestratorTest, UpdateUdfCodeFails_OrchestratorContinues) {
   EXPECT_CALL(delta_stream_reader_factory_, CreateConcurrentReader)
       .WillOnce(Return(ByMove(std::move(reader))));
 
-  EXPECT_CALL(udf_client_, SetCodeObject(CodeConfig{.js = "function hello(){}",
-                                                    .udf_handler_name = "hello",
-                                                    .logical_commit_time = 1}))
+  EXPECT_CALL(udf_client_,
+              SetCodeObjectAsync(CodeConfig{.js = "function hello(){}",
+                                            .udf_handler_name = "hello",
+                                            .logical_commit_time = 1}))
       .WillOnce(Return(absl::UnknownError("Some error.")));
   auto maybe_orchestrator = DataOrchestrator::TryCreate(options_);
   ASSERT_TRUE(maybe_orchestrator.ok());
@@ -549,6 +836,151 @@ TEST_F(DataOrchestratorTest, StartLoading) {
   all_records_loaded.WaitForNotificationWithTimeout(absl::Seconds(10));
 }
 
+TEST_F(DataOrchestratorTest, LoadsRealtimeUpdatesReceivedTogetherAsOneBatch) {
+  ON_CALL(blob_client_, ListBlobs)
+      .WillByDefault(Return(std::vector<std::string>({})));
+  auto maybe_orchestrator = DataOrchestrator::TryCreate(options_);
+  ASSERT_TRUE(maybe_orchestrator.ok());
+  auto orchestrator = std::move(maybe_orchestrator.value());
+
+  EXPECT_CALL(notifier_, Start).WillOnce(Return(absl::OkStatus()));
+  EXPECT_CALL(notifier_, IsRunning).WillOnce(Return(false));
+  kv_server::RealtimeUpdatesCallback realtime_callback;
+  EXPECT_CALL(realtime_thread_pool_manager_, Start)
+      .WillOnce([&realtime_callback](kv_server::RealtimeUpdatesCallback cb) {
+        realtime_callback = std::move(cb);
+        return absl::OkStatus();
+      });
+  const auto create_reader = [](KeyValueMutationRecordStruct record) {
+    auto reader = std::make_unique<MockStreamRecordReader>();
+    EXPECT_CALL(*reader, ReadStreamRecords)
+        .WillOnce([record](const std::function<absl::Status(std::string_view)>&
+                               callback) {
+          return callback(ToStringView(
+              ToFlatBufferBuilder(DataRecordStruct{.record = record})));
+        });
+    return reader;
+  };
+  EXPECT_CALL(delta_stream_reader_factory_, CreateReader)
+      .WillOnce(Return(ByMove(create_reader(KeyValueMutationRecordStruct{
+          KeyValueMutationType::Update, 3, "foo", "foo value"}))))
+      .WillOnce(Return(ByMove(create_reader(KeyValueMutationRecordStruct{
+          KeyValueMutationType::Update, 4, "bar", "bar value"}))));
+  EXPECT_CALL(cache_, UpdateKeyValue("foo", "foo value", 3, _));
+  EXPECT_CALL(cache_, UpdateKeyValue("bar", "bar value", 4, _));
+
+  ASSERT_TRUE(orchestrator->Start().ok());
+  ASSERT_TRUE(realtime_callback);
+  const std::vector<std::string> updates = {"update1", "update2"};
+  auto stats = realtime_callback(updates);
+  ASSERT_TRUE(stats.ok()) << stats.status();
+  EXPECT_EQ(stats->total_updated_records, 2);
+}
+
+TEST_F(DataOrchestratorTest, LoadsRealtimeEnvelopesWithoutDeltaReader) {
+  ON_CALL(blob_client_, ListBlobs)
+      .WillByDefault(Return(std::vector<std::string>({})));
+  auto maybe_orchestrator = DataOrchestrator::TryCreate(options_);
+  ASSERT_TRUE(maybe_orchestrator.ok());
+  auto orchestrator = std::move(maybe_orchestrator.value());
+
+  EXPECT_CALL(notifier_, Start).WillOnce(Return(absl::OkStatus()));
+  EXPECT_CALL(notifier_, IsRunning).WillOnce(Return(false));
+  kv_server::RealtimeUpdatesCallback realtime_callback;
+  EXPECT_CALL(realtime_thread_pool_manager_, Start)
+      .WillOnce([&realtime_callback](kv_server::RealtimeUpdatesCallback cb) {
+        realtime_callback = std::move(cb);
+        return absl::OkStatus();
+      });
+  EXPECT_CALL(delta_stream_reader_factory_, CreateReader).Times(0);
+  EXPECT_CALL(cache_, UpdateKeyValue("foo", "foo value", 3, _));
+  EXPECT_CALL(cache_, UpdateKeyValue("bar", "bar value", 4, _));
+
+  ASSERT_TRUE(orchestrator->Start().ok());
+  ASSERT_TRUE(realtime_callback);
+  const auto foo_record = ToFlatBufferBuilder(
+      DataRecordStruct{.record = KeyValueMutationRecordStruct{
+                           KeyValueMutationType::Update, 3, "foo",
+                           "foo value"}});
+  const auto bar_record = ToFlatBufferBuilder(
+      DataRecordStruct{.record = KeyValueMutationRecordStruct{
+                           KeyValueMutationType::Update, 4, "bar",
+                           "bar value"}});
+  const std::vector<std::string_view> records = {ToStringView(foo_record),
+                                                 ToStringView(bar_record)};
+  const std::vector<std::string> updates = {
+      kv_server::EncodeRealtimeEnvelope(records)};
+  auto stats = realtime_callback(updates);
+  ASSERT_TRUE(stats.ok()) << stats.status();
+  EXPECT_EQ(stats->total_updated_records, 2);
+}
+
+TEST_F(DataOrchestratorTest, MergesRealtimeUpdatesReceivedInBatchWindow) {
+  DataOrchestrator::Options options{
+      .data_bucket = GetTestLocation().bucket,
+      .cache = cache_,
+      .blob_client = blob_client_,
+      .delta_notifier = notifier_,
+      .change_notifier = change_notifier_,
+      .udf_client = udf_client_,
+      .delta_stream_reader_factory = delta_stream_reader_factory_,
+      .realtime_thread_pool_manager = realtime_thread_pool_manager_,
+      .key_sharder =
+          kv_server::KeySharder(kv_server::ShardingFunction{/*seed=*/""}),
+      .blob_prefix_allowlist = kv_server::BlobPrefixAllowlist(""),
+      .realtime_batch_window = absl::Seconds(1),
+  };
+  ON_CALL(blob_client_, ListBlobs)
+      .WillByDefault(Return(std::vector<std::string>({})));
+  auto maybe_orchestrator = DataOrchestrator::TryCreate(options);
+  ASSERT_TRUE(maybe_orchestrator.ok());
+  auto orchestrator = std::move(maybe_orchestrator.value());
+
+  EXPECT_CALL(notifier_, Start).WillOnce(Return(absl::OkStatus()));
+  EXPECT_CALL(notifier_, IsRunning).WillOnce(Return(false));
+  kv_server::RealtimeUpdatesCallback realtime_callback;
+  EXPECT_CALL(realtime_thread_pool_manager_, Start)
+      .WillOnce([&realtime_callback](kv_server::RealtimeUpdatesCallback cb) {
+        realtime_callback = std::move(cb);
+        return absl::OkStatus();
+      });
+  const auto create_reader = [](KeyValueMutationRecordStruct record) {
+    auto reader = std::make_unique<MockStreamRecordReader>();
+    EXPECT_CALL(*reader, ReadStreamRecords)
+        .WillOnce([record](const std::function<absl::Status(std::string_view)>&
+                               callback) {
+          return callback(ToStringView(
+              ToFlatBufferBuilder(DataRecordStruct{.record = record})));
+        });
+    return reader;
+  };
+  EXPECT_CALL(delta_stream_reader_factory_, CreateReader)
+      .WillOnce(Return(ByMove(create_reader(KeyValueMutationRecordStruct{
+          KeyValueMutationType::Update, 3, "foo", "old foo value"}))))
+      .WillOnce(Return(ByMove(create_reader(KeyValueMutationRecordStruct{
+          KeyValueMutationType::Update, 5, "foo", "foo value"}))));
+  // Only the latest update of the key is applied.
+  EXPECT_CALL(cache_, UpdateKeyValue("foo", "old foo value", _, _)).Times(0);
+  EXPECT_CALL(cache_, UpdateKeyValue("foo", "foo value", 5, _)).Times(1);
+
+  ASSERT_TRUE(orchestrator->Start().ok());
+  ASSERT_TRUE(realtime_callback);
+  absl::StatusOr<DataLoadingStats> first_stats;
+  std::thread first_update([&realtime_callback, &first_stats] {
+    const std::vector<std::string> updates = {"update1"};
+    first_stats = realtime_callback(updates);
+  });
+  const std::vector<std::string> updates = {"update2"};
+  auto second_stats = realtime_callback(updates);
+  first_update.join();
+  ASSERT_TRUE(first_stats.ok()) << first_stats.status();
+  ASSERT_TRUE(second_stats.ok()) << second_stats.status();
+  // The stats of the batch are returned to the caller that opened it.
+  EXPECT_EQ(first_stats->total_updated_records +
+                second_stats->total_updated_records,
+            2);
+}
+
 TEST_F(DataOrchestratorTest, CreateOrchestratorWithRealtimeDisabled) {
   ON_CALL(blob_client_, ListBlobs)
       .WillByDefault(Return(std::vector<std::string>({})));
@@ -692,4 +1124,358 @@ TEST_F(DataOrchestratorTest, VerifyLoadingDataFromPrefixes) {
   ASSERT_TRUE(maybe_orchestrator.ok());
 }
 
+TEST_F(DataOrchestratorTest, InitCacheLoadsPrefixesConcurrently) {
+  const std::string delta_basename = ToDeltaFileName(1).value();
+  for (auto prefix : {"", "prefix1", "prefix2"}) {
+    const BlobStorageClient::DataLocation location{.bucket = "testbucket",
+                                                   .prefix = prefix};
+    EXPECT_CALL(blob_client_,
+                ListBlobs(location,
+                          Field(&BlobStorageClient::ListOptions::prefix,
+                                FilePrefix<FileType::SNAPSHOT>())))
+        .WillOnce(Return(std::vector<std::string>({})));
+    EXPECT_CALL(blob_client_,
+                ListBlobs(location,
+                          Field(&BlobStorageClient::ListOptions::prefix,
+                                FilePrefix<FileType::DELTA>())))
+        .WillOnce(Return(std::vector<std::string>({delta_basename})));
+  }
+  EXPECT_CALL(delta_stream_reader_factory_, CreateConcurrentReader)
+      .Times(3)
+      .WillRepeatedly([](auto) -> std::unique_ptr<StreamRecordReader> {
+        auto reader = std::make_unique<MockStreamRecordReader>();
+        EXPECT_CALL(*reader, GetKVFileMetadata)
+            .WillOnce(Return(KVFileMetadata()));
+        EXPECT_CALL(*reader, ReadStreamRecords)
+            .WillOnce([](const std::function<absl::Status(std::string_view)>&
+                             callback) {
+              return callback(ToStringView(ToFlatBufferBuilder(
+                  DataRecordStruct{.record = KeyValueMutationRecordStruct{
+                                       KeyValueMutationType::Update, 3, "bar",
+                                       "bar value"}})));
+            });
+        return reader;
+      });
+  EXPECT_CALL(cache_, UpdateKeyValue("bar", "bar value", 3, _)).Times(3);
+  EXPECT_CALL(cache_, RemoveDeletedKeys(3, _)).Times(3);
+
+  auto options = options_;
+  options.blob_prefix_allowlist = BlobPrefixAllowlist("prefix1,prefix2");
+  options.max_concurrent_file_loads = 3;
+  auto maybe_orchestrator = DataOrchestrator::TryCreate(options);
+  ASSERT_TRUE(maybe_orchestrator.ok());
+
+  EXPECT_CALL(notifier_,
+              Start(_, GetTestLocation(),
+                    UnorderedElementsAre(Pair("", delta_basename),
+                                         Pair("prefix1", delta_basename),
+                                         Pair("prefix2", delta_basename)),
+                    _))
+      .WillOnce(Return(absl::UnknownError("")));
+  EXPECT_FALSE((*maybe_orchestrator)->Start().ok());
+}
+
+TEST_F(DataOrchestratorTest, ReloadsNewSnapshotsIntoNextGeneration) {
+  std::vector<testing::NiceMock<MockCache>*> generations;
+  auto generational_cache = GenerationalCache::Create([&generations] {
+    auto generation = std::make_unique<testing::NiceMock<MockCache>>();
+    if (!generations.empty()) {
+      // Only the next generation is loaded from the new snapshot.
+      EXPECT_CALL(*generation, UpdateKeyValue("foo", "foo value", 3, _));
+    }
+    generations.push_back(generation.get());
+    return generation;
+  });
+  DataOrchestrator::Options options{
+      .data_bucket = GetTestLocation().bucket,
+      .cache = *generational_cache,
+      .blob_client = blob_client_,
+      .delta_notifier = notifier_,
+      .change_notifier = change_notifier_,
+      .udf_client = udf_client_,
+      .delta_stream_reader_factory = delta_stream_reader_factory_,
+      .realtime_thread_pool_manager = realtime_thread_pool_manager_,
+      .key_sharder =
+          kv_server::KeySharder(kv_server::ShardingFunction{/*seed=*/""}),
+      .blob_prefix_allowlist = kv_server::BlobPrefixAllowlist(""),
+      .generational_cache = generational_cache.get(),
+      .snapshot_check_interval = absl::Milliseconds(1),
+  };
+  const std::vector<std::string> snapshots = {*ToSnapshotFileName(1)};
+  absl::Notification reloaded;
+  EXPECT_CALL(blob_client_,
+              ListBlobs(_, Field(&BlobStorageClient::ListOptions::prefix,
+                                 FilePrefix<FileType::DELTA>())))
+      .WillRepeatedly(Return(std::vector<std::string>()));
+  EXPECT_CALL(blob_client_,
+              ListBlobs(_, Field(&BlobStorageClient::ListOptions::prefix,
+                                 FilePrefix<FileType::SNAPSHOT>())))
+      .WillOnce(Return(std::vector<std::string>()))
+      .WillOnce(Return(snapshots))
+      .WillOnce([&reloaded, &snapshots] {
+        reloaded.Notify();
+        return snapshots;
+      })
+      .WillRepeatedly(Return(snapshots));
+  auto maybe_orchestrator = DataOrchestrator::TryCreate(options);
+  ASSERT_TRUE(maybe_orchestrator.ok());
+  auto orchestrator = std::move(maybe_orchestrator.value());
+  ASSERT_EQ(generations.size(), 1);
+
+  KVFileMetadata metadata;
+  *metadata.mutable_snapshot()->mutable_ending_delta_file() =
+      ToDeltaFileName(5).value();
+  auto metadata_reader = std::make_unique<MockStreamRecordReader>();
+  EXPECT_CALL(*metadata_reader, GetKVFileMetadata).WillOnce(Return(metadata));
+  // The metadata read first is reused to load the snapshot.
+  auto snapshot_reader = std::make_unique<MockStreamRecordReader>();
+  EXPECT_CALL(*snapshot_reader, GetKVFileMetadata).Times(0);
+  EXPECT_CALL(*snapshot_reader, ReadStreamRecords)
+      .WillOnce(
+          [](const std::function<absl::Status(std::string_view)>& callback) {
+            return callback(ToStringView(ToFlatBufferBuilder(
+                DataRecordStruct{.record = KeyValueMutationRecordStruct{
+                                     KeyValueMutationType::Update, 3, "foo",
+                                     "foo value"}})));
+          });
+  EXPECT_CALL(delta_stream_reader_factory_, CreateConcurrentReader)
+      .WillOnce(Return(ByMove(std::move(metadata_reader))))
+      .WillOnce(Return(ByMove(std::move(snapshot_reader))));
+  EXPECT_CALL(notifier_, Start).WillOnce(Return(absl::OkStatus()));
+  EXPECT_CALL(notifier_, IsRunning).WillOnce(Return(false));
+
+  EXPECT_TRUE(orchestrator->Start().ok());
+  ASSERT_TRUE(reloaded.WaitForNotificationWithTimeout(absl::Seconds(10)));
+  EXPECT_EQ(generations.size(), 2);
+}
+
+TEST_F(DataOrchestratorTest, SkipsQueuedDeltasIncludedInReloadedSnapshots) {
+  std::vector<testing::NiceMock<MockCache>*> generations;
+  auto generational_cache = GenerationalCache::Create([&generations] {
+    auto generation = std::make_unique<testing::NiceMock<MockCache>>();
+    if (!generations.empty()) {
+      // Only the delta file after the snapshot is loaded, after the swap.
+      EXPECT_CALL(*generation, UpdateKeyValue("foo", "foo value", 3, _));
+      EXPECT_CALL(*generation, UpdateKeyValue("bar", "bar value", 6, _));
+    }
+    generations.push_back(generation.get());
+    return generation;
+  });
+  DataOrchestrator::Options options{
+      .data_bucket = GetTestLocation().bucket,
+      .cache = *generational_cache,
+      .blob_client = blob_client_,
+      .delta_notifier = notifier_,
+      .change_notifier = change_notifier_,
+      .udf_client = udf_client_,
+      .delta_stream_reader_factory = delta_stream_reader_factory_,
+      .realtime_thread_pool_manager = realtime_thread_pool_manager_,
+      .key_sharder =
+          kv_server::KeySharder(kv_server::ShardingFunction{/*seed=*/""}),
+      .blob_prefix_allowlist = kv_server::BlobPrefixAllowlist(""),
+      .generational_cache = generational_cache.get(),
+      .snapshot_check_interval = absl::Hours(1),
+      .snapshot_check_backlog = 2,
+  };
+  const std::vector<std::string> snapshots = {*ToSnapshotFileName(1)};
+  EXPECT_CALL(blob_client_,
+              ListBlobs(_, Field(&BlobStorageClient::ListOptions::prefix,
+                                 FilePrefix<FileType::DELTA>())))
+      .WillRepeatedly(Return(std::vector<std::string>()));
+  EXPECT_CALL(blob_client_,
+              ListBlobs(_, Field(&BlobStorageClient::ListOptions::prefix,
+                                 FilePrefix<FileType::SNAPSHOT>())))
+      .WillOnce(Return(std::vector<std::string>()))
+      .WillRepeatedly(Return(snapshots));
+  auto maybe_orchestrator = DataOrchestrator::TryCreate(options);
+  ASSERT_TRUE(maybe_orchestrator.ok());
+  auto orchestrator = std::move(maybe_orchestrator.value());
+
+  KVFileMetadata metadata;
+  *metadata.mutable_snapshot()->mutable_ending_delta_file() =
+      ToDeltaFileName(5).value();
+  auto metadata_reader = std::make_unique<MockStreamRecordReader>();
+  EXPECT_CALL(*metadata_reader, GetKVFileMetadata).WillOnce(Return(metadata));
+  // The metadata read first is reused to load the snapshot.
+  auto snapshot_reader = std::make_unique<MockStreamRecordReader>();
+  EXPECT_CALL(*snapshot_reader, GetKVFileMetadata).Times(0);
+  EXPECT_CALL(*snapshot_reader, ReadStreamRecords)
+      .WillOnce(
+          [](const std::function<absl::Status(std::string_view)>& callback) {
+            return callback(ToStringView(ToFlatBufferBuilder(
+                DataRecordStruct{.record = KeyValueMutationRecordStruct{
+                                     KeyValueMutationType::Update, 3, "foo",
+                                     "foo value"}})));
+          });
+  absl::Notification delta_loaded;
+  auto delta_reader = std::make_unique<MockStreamRecordReader>();
+  EXPECT_CALL(*delta_reader, GetKVFileMetadata)
+      .WillOnce(Return(KVFileMetadata()));
+  EXPECT_CALL(*delta_reader, ReadStreamRecords)
+      .WillOnce([&delta_loaded](const std::function<absl::Status(
+                                    std::string_view)>& callback) {
+        auto status = callback(ToStringView(ToFlatBufferBuilder(
+            DataRecordStruct{.record = KeyValueMutationRecordStruct{
+                                 KeyValueMutationType::Update, 6, "bar",
+                                 "bar value"}})));
+        delta_loaded.Notify();
+        return status;
+      });
+  EXPECT_CALL(delta_stream_reader_factory_, CreateConcurrentReader)
+      .WillOnce(Return(ByMove(std::move(metadata_reader))))
+      .WillOnce(Return(ByMove(std::move(snapshot_reader))))
+      .WillOnce(Return(ByMove(std::move(delta_reader))));
+  EXPECT_CALL(notifier_, Start)
+      .WillOnce([](BlobStorageChangeNotifier&, BlobStorageClient::DataLocation,
+                   absl::flat_hash_map<std::string, std::string>,
+                   std::function<void(const std::string& key)> callback) {
+        // Deltas 4 and 5 are included in the snapshot.
+        callback(ToDeltaFileName(4).value());
+        callback(ToDeltaFileName(5).value());
+        callback(ToDeltaFileName(6).value());
+        return absl::OkStatus();
+      });
+  EXPECT_CALL(notifier_, IsRunning).WillOnce(Return(false));
+
+  EXPECT_TRUE(orchestrator->Start().ok());
+  ASSERT_TRUE(delta_loaded.WaitForNotificationWithTimeout(absl::Seconds(10)));
+  EXPECT_EQ(generations.size(), 2);
+}
+
+TEST_F(DataOrchestratorTest, LoadsNewFilesOfPrefixesIndependently) {
+  ON_CALL(blob_client_, ListBlobs)
+      .WillByDefault(Return(std::vector<std::string>({})));
+  auto options = options_;
+  options.blob_prefix_allowlist = BlobPrefixAllowlist("prefix1");
+  options.max_concurrent_file_loads = 2;
+  auto maybe_orchestrator = DataOrchestrator::TryCreate(options);
+  ASSERT_TRUE(maybe_orchestrator.ok());
+  auto orchestrator = std::move(maybe_orchestrator.value());
+
+  EXPECT_CALL(notifier_, Start)
+      .WillOnce([](BlobStorageChangeNotifier&, BlobStorageClient::DataLocation,
+                   absl::flat_hash_map<std::string, std::string>,
+                   std::function<void(const std::string& key)> callback) {
+        callback(absl::StrCat("prefix1/", ToDeltaFileName(1).value()));
+        callback(ToDeltaFileName(2).value());
+        return absl::OkStatus();
+      });
+  EXPECT_CALL(notifier_, IsRunning).WillOnce(Return(false));
+
+  // The file loaded first blocks its prefix until the other prefix's file is
+  // loaded.
+  absl::Notification other_prefix_loaded;
+  absl::Notification slow_file_released;
+  auto slow_reader = std::make_unique<MockStreamRecordReader>();
+  EXPECT_CALL(*slow_reader, GetKVFileMetadata)
+      .WillOnce(Return(KVFileMetadata()));
+  EXPECT_CALL(*slow_reader, ReadStreamRecords)
+      .WillOnce([&slow_file_released](auto) {
+        slow_file_released.WaitForNotificationWithTimeout(absl::Seconds(10));
+        return absl::OkStatus();
+      });
+  auto fast_reader = std::make_unique<MockStreamRecordReader>();
+  EXPECT_CALL(*fast_reader, GetKVFileMetadata)
+      .WillOnce(Return(KVFileMetadata()));
+  EXPECT_CALL(*fast_reader, ReadStreamRecords)
+      .WillOnce([&other_prefix_loaded](auto) {
+        other_prefix_loaded.Notify();
+        return absl::OkStatus();
+      });
+  EXPECT_CALL(delta_stream_reader_factory_, CreateConcurrentReader)
+      .WillOnce(Return(ByMove(std::move(slow_reader))))
+      .WillOnce(Return(ByMove(std::move(fast_reader))));
+  EXPECT_CALL(cache_, RemoveDeletedKeys(0, _)).Times(2);
+
+  EXPECT_TRUE(orchestrator->Start().ok());
+  ASSERT_TRUE(
+      other_prefix_loaded.WaitForNotificationWithTimeout(absl::Seconds(10)));
+  // The slow file is still waiting to be loaded.
+  EXPECT_THAT(DataOrchestrator::GetFreshnessLagsInMicros(),
+              AllOf(testing::SizeIs(2), testing::Contains(Pair(_, Gt(0)))));
+  slow_file_released.Notify();
+}
+
+TEST_F(DataOrchestratorTest, CatchesUpWithDeltaFilesAfterStart) {
+  EXPECT_CALL(blob_client_,
+              ListBlobs(GetTestLocation(),
+                        Field(&BlobStorageClient::ListOptions::prefix,
+                              FilePrefix<FileType::SNAPSHOT>())))
+      .WillOnce(Return(std::vector<std::string>()));
+  EXPECT_CALL(blob_client_,
+              ListBlobs(GetTestLocation(),
+                        Field(&BlobStorageClient::ListOptions::prefix,
+                              FilePrefix<FileType::DELTA>())))
+      .WillOnce(Return(std::vector<std::string>(
+          {ToDeltaFileName(1).value(), ToDeltaFileName(2).value()})));
+  // The delta files aren't loaded before the orchestrator is created.
+  EXPECT_CALL(delta_stream_reader_factory_, CreateConcurrentReader).Times(0);
+  absl::Notification caught_up;
+  auto options = options_;
+  options.serve_before_delta_catch_up = true;
+  options.on_delta_catch_up_done = [&caught_up] { caught_up.Notify(); };
+  auto maybe_orchestrator = DataOrchestrator::TryCreate(options);
+  ASSERT_TRUE(maybe_orchestrator.ok());
+  auto orchestrator = std::move(maybe_orchestrator.value());
+
+  absl::Notification second_file_released;
+  EXPECT_CALL(notifier_,
+              Start(_, GetTestLocation(),
+                    absl::flat_hash_map<std::string, std::string>(), _))
+      .WillOnce([](BlobStorageChangeNotifier&, BlobStorageClient::DataLocation,
+                   absl::flat_hash_map<std::string, std::string>,
+                   std::function<void(const std::string& key)> callback) {
+        callback(ToDeltaFileName(1).value());
+        callback(ToDeltaFileName(2).value());
+        return absl::OkStatus();
+      });
+  EXPECT_CALL(notifier_, IsRunning).WillOnce(Return(false));
+  absl::Notification first_file_loaded;
+  auto first_reader = std::make_unique<MockStreamRecordReader>();
+  EXPECT_CALL(*first_reader, GetKVFileMetadata)
+      .WillOnce(Return(KVFileMetadata()));
+  EXPECT_CALL(*first_reader, ReadStreamRecords)
+      .WillOnce([&first_file_loaded](auto) {
+        first_file_loaded.Notify();
+        return absl::OkStatus();
+      });
+  auto second_reader = std::make_unique<MockStreamRecordReader>();
+  EXPECT_CALL(*second_reader, GetKVFileMetadata)
+      .WillOnce(Return(KVFileMetadata()));
+  EXPECT_CALL(*second_reader, ReadStreamRecords)
+      .WillOnce([&second_file_released](auto) {
+        second_file_released.WaitForNotificationWithTimeout(absl::Seconds(10));
+        return absl::OkStatus();
+      });
+  EXPECT_CALL(delta_stream_reader_factory_, CreateConcurrentReader)
+      .WillOnce(Return(ByMove(std::move(first_reader))))
+      .WillOnce(Return(ByMove(std::move(second_reader))));
+  EXPECT_CALL(cache_, RemoveDeletedKeys(0, _)).Times(2);
+
+  EXPECT_TRUE(orchestrator->Start().ok());
+  ASSERT_TRUE(
+      first_file_loaded.WaitForNotificationWithTimeout(absl::Seconds(10)));
+  EXPECT_FALSE(caught_up.HasBeenNotified());
+  second_file_released.Notify();
+  ASSERT_TRUE(caught_up.WaitForNotificationWithTimeout(absl::Seconds(10)));
+  EXPECT_THAT(DataOrchestrator::GetDeltaCatchUpBacklogs(),
+              UnorderedElementsAre(Pair("", 0)));
+}
+
+TEST_F(DataOrchestratorTest, IsCaughtUpOnStartWithoutDeltaFilesToLoad) {
+  ON_CALL(blob_client_, ListBlobs)
+      .WillByDefault(Return(std::vector<std::string>({})));
+  absl::Notification caught_up;
+  auto options = options_;
+  options.serve_before_delta_catch_up = true;
+  options.on_delta_catch_up_done = [&caught_up] { caught_up.Notify(); };
+  auto maybe_orchestrator = DataOrchestrator::TryCreate(options);
+  ASSERT_TRUE(maybe_orchestrator.ok());
+  EXPECT_CALL(notifier_, Start).WillOnce(Return(absl::OkStatus()));
+  EXPECT_CALL(notifier_, IsRunning).WillOnce(Return(false));
+
+  EXPECT_TRUE((*maybe_orchestrator)->Start().ok());
+  EXPECT_TRUE(caught_up.HasBeenNotified());
+}
+
 }  // namespace
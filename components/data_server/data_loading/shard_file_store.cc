@@ -0,0 +1,211 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "components/data_server/data_loading/shard_file_store.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <system_error>
+#include <utility>
+
+#include "absl/log/log.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "public/data_loading/writers/delta_record_writer.h"
+#include "public/data_loading/writers/record_writer_options.h"
+
+namespace kv_server {
+namespace {
+
+constexpr std::string_view kClaimExtension = ".claim";
+constexpr std::string_view kPartialCopyExtension = ".partial";
+
+std::filesystem::path WithExtension(const std::filesystem::path& path,
+                                    std::string_view extension) {
+  std::filesystem::path extended_path = path;
+  extended_path += extension;
+  return extended_path;
+}
+
+// Creates the claim file at `path`, unless it exists. Creating it fails for
+// all but one of the replicas that try at once.
+bool TryClaim(const std::filesystem::path& path) {
+  const int fd = open(path.c_str(), O_CREAT | O_EXCL | O_WRONLY, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  close(fd);
+  return true;
+}
+
+bool IsOlderThan(const std::filesystem::path& path, absl::Duration age) {
+  std::error_code error;
+  const auto write_time = std::filesystem::last_write_time(path, error);
+  if (error) {
+    return false;
+  }
+  return std::filesystem::file_time_type::clock::now() - write_time >
+         std::chrono::nanoseconds(absl::ToInt64Nanoseconds(age));
+}
+
+}  // namespace
+
+ShardFileStore::CopyWriter::CopyWriter(const ShardFileStore& store,
+                                       std::filesystem::path path)
+    : store_(store), path_(std::move(path)) {}
+
+ShardFileStore::CopyWriter::~CopyWriter() {
+  {
+    absl::MutexLock lock(&mutex_);
+    writer_.reset();
+  }
+  stream_.close();
+  std::error_code error;
+  if (!committed_) {
+    std::filesystem::remove(WithExtension(path_, kPartialCopyExtension),
+                            error);
+  }
+  std::filesystem::remove(WithExtension(path_, kClaimExtension), error);
+}
+
+absl::Status ShardFileStore::CopyWriter::Open(KVFileMetadata metadata) {
+  const std::filesystem::path partial_path =
+      WithExtension(path_, kPartialCopyExtension);
+  stream_.open(partial_path, std::ios::binary | std::ios::trunc);
+  if (!stream_) {
+    return absl::InternalError(
+        absl::StrCat("Failed to open ", partial_path.string()));
+  }
+  // Copies are read soon after by replicas in the same zone, so they aren't
+  // compressed, to spare the replicas the CPU.
+  const DeltaRecordWriter::Options options = {
+      .enable_compression = false, .metadata = std::move(metadata)};
+  absl::MutexLock lock(&mutex_);
+  writer_ = std::make_unique<
+      riegeli::RecordWriter<riegeli::OStreamWriter<std::ofstream*>>>(
+      riegeli::OStreamWriter(&stream_), GetRecordWriterOptions(options));
+  return writer_->status();
+}
+
+void ShardFileStore::CopyWriter::WriteRecord(std::string_view record) {
+  absl::MutexLock lock(&mutex_);
+  if (writer_ != nullptr && writer_->ok()) {
+    writer_->WriteRecord(record);
+  }
+}
+
+absl::Status ShardFileStore::CopyWriter::Commit() {
+  {
+    absl::MutexLock lock(&mutex_);
+    if (writer_ == nullptr) {
+      return absl::FailedPreconditionError("The copy was not opened");
+    }
+    if (!writer_->Close()) {
+      return writer_->status();
+    }
+  }
+  stream_.close();
+  const std::filesystem::path partial_path =
+      WithExtension(path_, kPartialCopyExtension);
+  if (!stream_) {
+    return absl::InternalError(
+        absl::StrCat("Failed to write ", partial_path.string()));
+  }
+  std::error_code error;
+  std::filesystem::rename(partial_path, path_, error);
+  if (error) {
+    return absl::InternalError(absl::StrCat("Failed to rename ",
+                                            partial_path.string(), ": ",
+                                            error.message()));
+  }
+  committed_ = true;
+  store_.RemoveExpiredCopies();
+  return absl::OkStatus();
+}
+
+ShardFileStore::ShardFileStore(Options options)
+    : options_(std::move(options)) {}
+
+ShardFileStore::Copy ShardFileStore::Acquire(
+    const BlobStorageClient::DataLocation& location) const {
+  const std::filesystem::path path = CopyPath(location);
+  const std::filesystem::path claim_path = WithExtension(path, kClaimExtension);
+  std::error_code error;
+  std::filesystem::create_directories(path.parent_path(), error);
+  if (error) {
+    LOG(ERROR) << "Loading " << location << " without a shard copy: "
+               << error.message();
+    return {};
+  }
+  const absl::Time deadline = absl::Now() + options_.wait_timeout;
+  while (true) {
+    if (std::filesystem::exists(path, error)) {
+      return {.path = path.string()};
+    }
+    if (TryClaim(claim_path)) {
+      // The replica that held the claim before may have just committed.
+      if (std::filesystem::exists(path, error)) {
+        std::filesystem::remove(claim_path, error);
+        return {.path = path.string()};
+      }
+      return {.writer = absl::WrapUnique(new CopyWriter(*this, path))};
+    }
+    if (IsOlderThan(claim_path, options_.wait_timeout)) {
+      // The replica that claimed the file is gone. Replicas that take over
+      // the same claim at once write the same copy.
+      std::filesystem::remove(claim_path, error);
+      continue;
+    }
+    if (absl::Now() >= deadline) {
+      LOG(WARNING) << "Loading " << location
+                   << " without waiting any longer for its shard copy";
+      return {};
+    }
+    absl::SleepFor(options_.poll_interval);
+  }
+}
+
+std::filesystem::path ShardFileStore::CopyPath(
+    const BlobStorageClient::DataLocation& location) const {
+  std::filesystem::path path =
+      std::filesystem::path(options_.directory) /
+      std::filesystem::path(location.bucket).relative_path();
+  if (!location.prefix.empty()) {
+    path /= location.prefix;
+  }
+  return path / absl::StrCat(location.key, ".shard-", options_.shard_num,
+                             "-of-", options_.num_shards, "-hash-",
+                             options_.sharding_hash_version);
+}
+
+void ShardFileStore::RemoveExpiredCopies() const {
+  std::error_code error;
+  for (auto it = std::filesystem::recursive_directory_iterator(
+           options_.directory, error);
+       !error && it != std::filesystem::recursive_directory_iterator();
+       it.increment(error)) {
+    if (it->is_regular_file(error) &&
+        IsOlderThan(it->path(), options_.retention)) {
+      std::error_code remove_error;
+      std::filesystem::remove(it->path(), remove_error);
+    }
+  }
+}
+
+}  // namespace kv_server
@@ -0,0 +1,122 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_DATA_LOADING_SHARD_FILE_STORE_H_
+#define COMPONENTS_DATA_SERVER_DATA_LOADING_SHARD_FILE_STORE_H_
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/status/status.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "components/data/blob_storage/blob_storage_client.h"
+#include "public/data_loading/riegeli_metadata.pb.h"
+#include "riegeli/bytes/ostream_writer.h"
+#include "riegeli/records/record_writer.h"
+
+namespace kv_server {
+
+// Shares the records of each data file that belong to a shard between the
+// replicas of the shard, through a directory that all of them mount, such as
+// a file share in their zone. The first replica to load a file claims it, and
+// writes the records that it keeps to a shard copy in the directory while it
+// loads the file from the bucket. The other replicas wait for the copy and
+// load it instead of downloading and filtering the whole file.
+//
+// Copies are named after the shard and the way keys are sharded, so servers
+// that shard keys differently don't share them. Copies older than
+// `retention` are removed by the replicas that write new ones.
+//
+// Thread-safe.
+class ShardFileStore {
+ public:
+  struct Options {
+    std::string directory;
+    int32_t shard_num = 0;
+    int32_t num_shards = 1;
+    int32_t sharding_hash_version = 0;
+    // How long a replica waits for the copy of a file that another replica
+    // claimed before it loads the file from the bucket itself. A claim that
+    // is older than this is taken over.
+    absl::Duration wait_timeout = absl::Minutes(5);
+    absl::Duration poll_interval = absl::Milliseconds(200);
+    absl::Duration retention = absl::Hours(24);
+  };
+
+  // Writes the shard copy of a file that this replica claimed. The copy is
+  // dropped, and the claim released, unless it is committed.
+  class CopyWriter {
+   public:
+    ~CopyWriter();
+    CopyWriter(const CopyWriter&) = delete;
+    CopyWriter& operator=(const CopyWriter&) = delete;
+
+    // Must be called once, before any record is written.
+    absl::Status Open(KVFileMetadata metadata);
+    // Thread-safe.
+    void WriteRecord(std::string_view record) ABSL_LOCKS_EXCLUDED(mutex_);
+    // Makes the copy available to the other replicas.
+    absl::Status Commit() ABSL_LOCKS_EXCLUDED(mutex_);
+
+   private:
+    friend class ShardFileStore;
+    CopyWriter(const ShardFileStore& store, std::filesystem::path path);
+
+    const ShardFileStore& store_;
+    const std::filesystem::path path_;
+    absl::Mutex mutex_;
+    std::ofstream stream_;
+    std::unique_ptr<
+        riegeli::RecordWriter<riegeli::OStreamWriter<std::ofstream*>>>
+        writer_ ABSL_GUARDED_BY(mutex_);
+    bool committed_ = false;
+  };
+
+  struct Copy {
+    // Path of the shard copy of the file, if one is ready.
+    std::string path;
+    // Set instead if this replica claimed the file, to write its copy while
+    // it loads the file.
+    std::unique_ptr<CopyWriter> writer;
+  };
+
+  explicit ShardFileStore(Options options);
+
+  // Returns the copy of the records of the shard in the file at `location`,
+  // if another replica wrote it, waiting for the replica that claimed the
+  // file, if any. Otherwise claims the file for this replica. Neither is
+  // returned if the wait timed out, and the file is then loaded without a
+  // copy.
+  Copy Acquire(const BlobStorageClient::DataLocation& location) const;
+
+ private:
+  std::filesystem::path CopyPath(
+      const BlobStorageClient::DataLocation& location) const;
+  // Removes the copies and claims older than `retention`.
+  void RemoveExpiredCopies() const;
+
+  const Options options_;
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_DATA_LOADING_SHARD_FILE_STORE_H_
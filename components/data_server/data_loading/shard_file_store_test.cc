@@ -0,0 +1,130 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "components/data_server/data_loading/shard_file_store.h"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "public/data_loading/readers/riegeli_stream_io.h"
+
+namespace kv_server {
+namespace {
+
+ShardFileStore::Options StoreOptions(std::string_view name) {
+  const std::filesystem::path directory =
+      std::filesystem::path(testing::TempDir()) / name;
+  std::filesystem::remove_all(directory);
+  return {.directory = directory.string(),
+          .shard_num = 1,
+          .num_shards = 2,
+          .wait_timeout = absl::Milliseconds(100),
+          .poll_interval = absl::Milliseconds(10)};
+}
+
+const BlobStorageClient::DataLocation kLocation = {
+    .bucket = "bucket", .key = "DELTA_1700000000000001"};
+
+TEST(ShardFileStoreTest, PeerLoadsCommittedCopy) {
+  const ShardFileStore::Options options = StoreOptions("committed");
+  ShardFileStore writing_replica(options);
+  ShardFileStore reading_replica(options);
+  ShardFileStore::Copy claim = writing_replica.Acquire(kLocation);
+  ASSERT_NE(claim.writer, nullptr);
+  EXPECT_TRUE(claim.path.empty());
+  KVFileMetadata metadata;
+  metadata.mutable_sharding_metadata()->set_shard_num(1);
+  ASSERT_TRUE(claim.writer->Open(metadata).ok());
+  claim.writer->WriteRecord("record1");
+  claim.writer->WriteRecord("record2");
+  ASSERT_TRUE(claim.writer->Commit().ok());
+  claim.writer.reset();
+
+  const ShardFileStore::Copy copy = reading_replica.Acquire(kLocation);
+  EXPECT_EQ(copy.writer, nullptr);
+  ASSERT_FALSE(copy.path.empty());
+  std::ifstream stream(copy.path);
+  RiegeliStreamReader<std::string_view> reader(
+      stream, [](const riegeli::SkippedRegion&) { return false; });
+  const auto copy_metadata = reader.GetKVFileMetadata();
+  ASSERT_TRUE(copy_metadata.ok());
+  EXPECT_EQ(copy_metadata->sharding_metadata().shard_num(), 1);
+  std::vector<std::string> records;
+  ASSERT_TRUE(reader
+                  .ReadStreamRecords([&records](std::string_view record) {
+                    records.emplace_back(record);
+                    return absl::OkStatus();
+                  })
+                  .ok());
+  EXPECT_EQ(records, (std::vector<std::string>{"record1", "record2"}));
+}
+
+TEST(ShardFileStoreTest, UncommittedCopyReleasesClaim) {
+  ShardFileStore store(StoreOptions("uncommitted"));
+  {
+    ShardFileStore::Copy claim = store.Acquire(kLocation);
+    ASSERT_NE(claim.writer, nullptr);
+    ASSERT_TRUE(claim.writer->Open(KVFileMetadata()).ok());
+    claim.writer->WriteRecord("record1");
+  }
+  const ShardFileStore::Copy claim = store.Acquire(kLocation);
+  EXPECT_NE(claim.writer, nullptr);
+  EXPECT_TRUE(claim.path.empty());
+}
+
+TEST(ShardFileStoreTest, WaitForClaimedCopyTimesOut) {
+  ShardFileStore store(StoreOptions("timeout"));
+  const ShardFileStore::Copy claim = store.Acquire(kLocation);
+  ASSERT_NE(claim.writer, nullptr);
+  const ShardFileStore::Copy copy = store.Acquire(kLocation);
+  EXPECT_EQ(copy.writer, nullptr);
+  EXPECT_TRUE(copy.path.empty());
+}
+
+TEST(ShardFileStoreTest, StaleClaimIsTakenOver) {
+  const ShardFileStore::Options options = StoreOptions("stale");
+  ShardFileStore store(options);
+  std::filesystem::create_directories(
+      std::filesystem::path(options.directory) / "bucket");
+  const std::filesystem::path claim_path =
+      std::filesystem::path(options.directory) / "bucket" /
+      "DELTA_1700000000000001.shard-1-of-2-hash-0.claim";
+  std::ofstream(claim_path).close();
+  std::filesystem::last_write_time(
+      claim_path,
+      std::filesystem::file_time_type::clock::now() - std::chrono::hours(1));
+  const ShardFileStore::Copy claim = store.Acquire(kLocation);
+  EXPECT_NE(claim.writer, nullptr);
+}
+
+TEST(ShardFileStoreTest, ShardsDontShareCopies) {
+  ShardFileStore::Options options = StoreOptions("shards");
+  ShardFileStore store(options);
+  ShardFileStore::Copy claim = store.Acquire(kLocation);
+  ASSERT_NE(claim.writer, nullptr);
+  ASSERT_TRUE(claim.writer->Open(KVFileMetadata()).ok());
+  ASSERT_TRUE(claim.writer->Commit().ok());
+  options.shard_num = 0;
+  EXPECT_NE(ShardFileStore(options).Acquire(kLocation).writer, nullptr);
+}
+
+}  // namespace
+}  // namespace kv_server
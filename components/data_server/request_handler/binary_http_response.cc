@@ -0,0 +1,105 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data_server/request_handler/binary_http_response.h"
+
+#include <string_view>
+
+#include "absl/status/status.h"
+
+namespace kv_server {
+namespace {
+
+// Framing indicator of a known-length response.
+constexpr uint8_t kKnownLengthResponseFraming = 1;
+// Largest value of a variable-length integer, see RFC 9000, section 16.
+constexpr uint64_t kMaxVarInt = (uint64_t{1} << 62) - 1;
+
+size_t VarIntSize(uint64_t value) {
+  if (value < (uint64_t{1} << 6)) {
+    return 1;
+  }
+  if (value < (uint64_t{1} << 14)) {
+    return 2;
+  }
+  if (value < (uint64_t{1} << 30)) {
+    return 4;
+  }
+  return 8;
+}
+
+// Writes `value` at `out`, most significant byte first, with its length in
+// the 2 most significant bits, and advances `out` past it.
+void WriteVarInt(uint64_t value, char*& out) {
+  const size_t size = VarIntSize(value);
+  const uint8_t length_bits = size == 1 ? 0 : size == 2 ? 1 : size == 4 ? 2 : 3;
+  for (size_t i = 0; i < size; ++i) {
+    out[size - 1 - i] = static_cast<char>(value & 0xff);
+    value >>= 8;
+  }
+  out[0] =
+      static_cast<char>(static_cast<uint8_t>(out[0]) | (length_bits << 6));
+  out += size;
+}
+
+void WriteBytes(std::string_view bytes, char*& out) {
+  WriteVarInt(bytes.size(), out);
+  bytes.copy(out, bytes.size());
+  out += bytes.size();
+}
+
+}  // namespace
+
+absl::StatusOr<std::string> SerializeBinaryHttpResponse(
+    uint16_t status_code,
+    const std::vector<quiche::BinaryHttpMessage::Field>& header_fields,
+    size_t body_size, absl::FunctionRef<bool(char* body)> write_body) {
+  if (status_code < 200 || status_code > 599) {
+    return absl::InvalidArgumentError(
+        "Status code of a final response must be from 200 to 599.");
+  }
+  if (body_size > kMaxVarInt) {
+    return absl::InvalidArgumentError("Body is too large.");
+  }
+  size_t header_fields_size = 0;
+  for (const auto& field : header_fields) {
+    header_fields_size += VarIntSize(field.name.size()) + field.name.size() +
+                          VarIntSize(field.value.size()) + field.value.size();
+  }
+  const size_t size = 1 + VarIntSize(status_code) +
+                      VarIntSize(header_fields_size) + header_fields_size +
+                      VarIntSize(body_size) + body_size +
+                      // No trailer fields.
+                      VarIntSize(0);
+  std::string serialized(size, '\0');
+  char* out = serialized.data();
+  *out++ = static_cast<char>(kKnownLengthResponseFraming);
+  WriteVarInt(status_code, out);
+  WriteVarInt(header_fields_size, out);
+  for (const auto& field : header_fields) {
+    WriteBytes(field.name, out);
+    WriteBytes(field.value, out);
+  }
+  WriteVarInt(body_size, out);
+  if (!write_body(out)) {
+    return absl::InternalError("Failed writing the body of the response.");
+  }
+  out += body_size;
+  WriteVarInt(0, out);
+  return serialized;
+}
+
+}  // namespace kv_server
@@ -0,0 +1,43 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_REQUEST_HANDLER_BINARY_HTTP_RESPONSE_H_
+#define COMPONENTS_DATA_SERVER_REQUEST_HANDLER_BINARY_HTTP_RESPONSE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "absl/functional/function_ref.h"
+#include "absl/status/statusor.h"
+#include "quiche/binary_http/binary_http_message.h"
+
+namespace kv_server {
+
+// Serializes a known-length Binary HTTP response, see RFC 9292, the same way
+// as `quiche::BinaryHttpResponse::Serialize`. Unlike it, the body isn't
+// passed in its own buffer that is then copied: `write_body` writes the
+// `body_size` bytes of the body right into the serialized response. Returns
+// an error if `write_body` returns false.
+absl::StatusOr<std::string> SerializeBinaryHttpResponse(
+    uint16_t status_code,
+    const std::vector<quiche::BinaryHttpMessage::Field>& header_fields,
+    size_t body_size, absl::FunctionRef<bool(char* body)> write_body);
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_REQUEST_HANDLER_BINARY_HTTP_RESPONSE_H_
@@ -0,0 +1,93 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data_server/request_handler/binary_http_response.h"
+
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+using quiche::BinaryHttpMessage;
+using testing::ElementsAre;
+
+absl::StatusOr<std::string> SerializeWithBody(
+    const std::vector<BinaryHttpMessage::Field>& header_fields,
+    const std::string& body) {
+  return SerializeBinaryHttpResponse(
+      200, header_fields, body.size(), [&body](char* out) {
+        body.copy(out, body.size());
+        return true;
+      });
+}
+
+TEST(BinaryHttpResponseTest, SerializesResponseThatQuicheParses) {
+  const std::vector<BinaryHttpMessage::Field> header_fields = {
+      {.name = "content-type", .value = "application/protobuf"},
+      {.name = "content-encoding", .value = "gzip"}};
+  const auto serialized = SerializeWithBody(header_fields, "body");
+  ASSERT_TRUE(serialized.ok()) << serialized.status();
+
+  const auto response = quiche::BinaryHttpResponse::Create(*serialized);
+  ASSERT_TRUE(response.ok()) << response.status();
+  EXPECT_EQ(response->status_code(), 200);
+  EXPECT_THAT(response->GetHeaderFields(),
+              ElementsAre(header_fields[0], header_fields[1]));
+  EXPECT_EQ(response->body(), "body");
+}
+
+TEST(BinaryHttpResponseTest, ParsesAsTheSameResponseAsQuiche) {
+  quiche::BinaryHttpResponse expected(200);
+  expected.AddHeaderField(
+      {.name = "content-type", .value = "application/json"});
+  expected.set_body("{}");
+
+  const auto serialized = SerializeWithBody(
+      {{.name = "content-type", .value = "application/json"}}, "{}");
+  ASSERT_TRUE(serialized.ok()) << serialized.status();
+  const auto response = quiche::BinaryHttpResponse::Create(*serialized);
+  ASSERT_TRUE(response.ok()) << response.status();
+  EXPECT_EQ(*response, expected);
+}
+
+TEST(BinaryHttpResponseTest, SerializesLargeBody) {
+  const std::string body(100'000, 'a');
+  const auto serialized = SerializeWithBody({}, body);
+  ASSERT_TRUE(serialized.ok()) << serialized.status();
+
+  const auto response = quiche::BinaryHttpResponse::Create(*serialized);
+  ASSERT_TRUE(response.ok()) << response.status();
+  EXPECT_EQ(response->body(), body);
+}
+
+TEST(BinaryHttpResponseTest, FailsIfBodyIsNotWritten) {
+  EXPECT_FALSE(SerializeBinaryHttpResponse(
+                   200, {}, 1, [](char*) { return false; })
+                   .ok());
+}
+
+TEST(BinaryHttpResponseTest, RejectsInformationalStatusCode) {
+  EXPECT_FALSE(SerializeBinaryHttpResponse(
+                   100, {}, 0, [](char*) { return true; })
+                   .ok());
+}
+
+}  // namespace
+}  // namespace kv_server
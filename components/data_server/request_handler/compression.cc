@@ -13,9 +13,19 @@
 // limitations under the License.
 #include "components/data_server/request_handler/compression.h"
 
+#include <algorithm>
+#include <atomic>
+#include <utility>
+
 #include "absl/log/log.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "components/data_server/request_handler/compression_brotli.h"
+#include "components/data_server/request_handler/compression_gzip.h"
+#include "components/data_server/request_handler/compression_zstd.h"
 #include "components/data_server/request_handler/uncompressed.h"
+#include "components/telemetry/server_definition.h"
+#include "components/util/thread_pool.h"
 #include "quiche/common/quiche_data_writer.h"
 
 namespace kv_server {
@@ -23,25 +33,102 @@ namespace kv_server {
 void CompressionGroupConcatenator::AddCompressionGroup(
     std::string plaintext_compression_group) {
   VLOG(9) << "Adding compression group: " << plaintext_compression_group;
-  partitions_.push_back(plaintext_compression_group);
+  partitions_.push_back(std::move(plaintext_compression_group));
 }
 
 std::unique_ptr<CompressionGroupConcatenator>
 CompressionGroupConcatenator::Create(CompressionType type) {
-  if (type == CompressionType::kUncompressed) {
-    return std::make_unique<UncompressedConcatenator>();
-  } else {
-    return std::make_unique<BrotliCompressionGroupConcatenator>();
+  return CreateWithOptions(type, CompressionOptions());
+}
+
+std::unique_ptr<CompressionGroupConcatenator>
+CompressionGroupConcatenator::CreateWithOptions(
+    CompressionType type, const CompressionOptions& options) {
+  switch (type) {
+    case CompressionType::kUncompressed:
+      return std::make_unique<UncompressedConcatenator>();
+    case CompressionType::kGzip:
+      return std::make_unique<GzipCompressionGroupConcatenator>(
+          options.gzip_level);
+    case CompressionType::kZstd:
+      return std::make_unique<ZstdCompressionGroupConcatenator>(
+          options.zstd_codec);
+    case CompressionType::kBrotli:
+    default:
+      return std::make_unique<BrotliCompressionGroupConcatenator>(
+          options.brotli_quality);
+  }
+}
+
+absl::StatusOr<std::vector<std::string>> CompressGroups(
+    std::vector<std::string> compression_groups,
+    CompressionGroupConcatenator::CompressionType type,
+    const std::function<CompressionGroupConcatenator::FactoryFunctionType>&
+        create_concatenator,
+    int max_concurrency) {
+  using CompressionType = CompressionGroupConcatenator::CompressionType;
+  const int num_groups = compression_groups.size();
+  std::vector<absl::StatusOr<std::string>> blobs(num_groups);
+  // Each worker compresses the next group that no worker took yet.
+  std::atomic<int> next_group = 0;
+  auto compress_groups = [&compression_groups, type, &create_concatenator,
+                          &blobs, &next_group, num_groups] {
+    for (int i = next_group++; i < num_groups; i = next_group++) {
+      auto concatenator = create_concatenator(type);
+      const double group_size = compression_groups[i].size();
+      concatenator->AddCompressionGroup(std::move(compression_groups[i]));
+      const absl::Time start = absl::Now();
+      blobs[i] = concatenator->Build();
+      if (!blobs[i].ok() || type == CompressionType::kUncompressed) continue;
+      LogIfError(KVServerContextMap()
+                     ->SafeMetric()
+                     .LogHistogram<kResponseCompressionLatency>(
+                         absl::ToDoubleMicroseconds(absl::Now() - start)));
+      LogIfError(KVServerContextMap()
+                     ->SafeMetric()
+                     .LogHistogram<kResponseCompressionPercent>(
+                         100 * blobs[i]->size() / std::max(group_size, 1.0)));
+    }
+    return true;
+  };
+  // Uncompressed groups are only copied, which isn't worth scheduling.
+  const int num_workers = type == CompressionType::kUncompressed
+                              ? 1
+                              : std::min(max_concurrency, num_groups);
+  std::vector<TaskFuture<bool>> workers;
+  for (int i = 1; i < num_workers; ++i) {
+    workers.push_back(SharedThreadPool().Async(compress_groups));
+  }
+  compress_groups();
+  for (auto& worker : workers) {
+    worker.Get();
+  }
+  std::vector<std::string> result;
+  result.reserve(num_groups);
+  for (auto& blob : blobs) {
+    if (!blob.ok()) {
+      return blob.status();
+    }
+    result.push_back(*std::move(blob));
   }
+  return result;
 }
 
 std::unique_ptr<CompressedBlobReader> CompressedBlobReader::Create(
     CompressionGroupConcatenator::CompressionType type,
-    std::string_view compressed) {
-  if (type == CompressionGroupConcatenator::CompressionType::kUncompressed) {
-    return std::make_unique<UncompressedBlobReader>(compressed);
-  } else {
-    return std::make_unique<BrotliCompressionBlobReader>(compressed);
+    std::string_view compressed, const CompressionOptions& options) {
+  using CompressionType = CompressionGroupConcatenator::CompressionType;
+  switch (type) {
+    case CompressionType::kUncompressed:
+      return std::make_unique<UncompressedBlobReader>(compressed);
+    case CompressionType::kGzip:
+      return std::make_unique<GzipCompressionBlobReader>(compressed);
+    case CompressionType::kZstd:
+      return std::make_unique<ZstdCompressionBlobReader>(compressed,
+                                                         options.zstd_codec);
+    case CompressionType::kBrotli:
+    default:
+      return std::make_unique<BrotliCompressionBlobReader>(compressed);
   }
 }
 
@@ -17,16 +17,30 @@
 #ifndef COMPONENTS_DATA_SERVER_REQUEST_HANDLER_COMPRESSION_H_
 #define COMPONENTS_DATA_SERVER_REQUEST_HANDLER_COMPRESSION_H_
 
+#include <functional>
 #include <memory>
 #include <string>
 #include <string_view>
 #include <vector>
 
 #include "absl/status/statusor.h"
+#include "components/data_server/cache/value_codec.h"
 #include "quiche/common/quiche_data_reader.h"
 
 namespace kv_server {
 
+// Tunes the CPU spent against the bytes saved by each compression algorithm.
+struct CompressionOptions {
+  // Brotli quality, from 0 to 11.
+  int brotli_quality = 11;
+  // zlib level of gzip, from 0 to 9.
+  int gzip_level = 6;
+  // Compresses and decompresses zstd groups at its level, with its dictionary
+  // if it has one. Clients must decompress with the same dictionary. Null
+  // compresses at zstd's default level without dictionary.
+  std::shared_ptr<const ValueCodec> zstd_codec;
+};
+
 // Responsible for concatenating compression groups according to the compression
 // specification
 // https://github.com/WICG/turtledove/blob/main/FLEDGE_Key_Value_Server_API.md#response-version-20
@@ -41,12 +55,15 @@ class CompressionGroupConcatenator {
  public:
   virtual ~CompressionGroupConcatenator() = default;
 
-  enum class CompressionType { kUncompressed = 0, kBrotli /* TODO: kGzip */ };
+  enum class CompressionType { kUncompressed = 0, kBrotli, kGzip, kZstd };
 
   static std::unique_ptr<CompressionGroupConcatenator> Create(
       CompressionType type);
   using FactoryFunctionType = decltype(Create);
 
+  static std::unique_ptr<CompressionGroupConcatenator> CreateWithOptions(
+      CompressionType type, const CompressionOptions& options);
+
   // Adds the JSON representation of plaintext (uncompressed) to be
   // concatenated.
   void AddCompressionGroup(std::string plaintext_partition);
@@ -62,6 +79,16 @@ class CompressionGroupConcatenator {
   std::vector<std::string> partitions_;
 };
 
+// Builds one blob of each of `compression_groups`, with its own concatenator
+// from `create_concatenator`. Up to `max_concurrency` groups are compressed at
+// once on the shared thread pool, the calling thread being one of them.
+absl::StatusOr<std::vector<std::string>> CompressGroups(
+    std::vector<std::string> compression_groups,
+    CompressionGroupConcatenator::CompressionType type,
+    const std::function<CompressionGroupConcatenator::FactoryFunctionType>&
+        create_concatenator,
+    int max_concurrency);
+
 // Responsible for parsing a compression blob generated by the
 // CompressionGroupConcatenator. Should not be reused across requests. Not
 // intended to be used by multiple threads. Not thread-safe.
@@ -70,9 +97,10 @@ class CompressedBlobReader {
   explicit CompressedBlobReader(std::string_view compressed)
       : data_reader_(compressed) {}
 
+  // `options` must have the zstd dictionary the blob was compressed with.
   static std::unique_ptr<CompressedBlobReader> Create(
       CompressionGroupConcatenator::CompressionType type,
-      std::string_view compressed);
+      std::string_view compressed, const CompressionOptions& options = {});
 
   virtual ~CompressedBlobReader() = default;
 
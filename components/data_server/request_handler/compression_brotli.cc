@@ -13,6 +13,7 @@
 // limitations under the License.
 #include "components/data_server/request_handler/compression_brotli.h"
 
+#include <algorithm>
 #include <memory>
 #include <string>
 #include <utility>
@@ -29,7 +30,8 @@ namespace kv_server {
 namespace {
 
 // Responsible for compressing one compression group.
-absl::StatusOr<std::string> CompressOnePartition(std::string_view partition) {
+absl::StatusOr<std::string> CompressOnePartition(std::string_view partition,
+                                                 int quality) {
   VLOG(5) << "Compressing " << partition;
   size_t buffer_size = BrotliEncoderMaxCompressedSize(partition.size());
   // The output consists of the size of the compressed data and the compressed
@@ -37,7 +39,8 @@ absl::StatusOr<std::string> CompressOnePartition(std::string_view partition) {
   std::string partition_output(sizeof(uint32_t) + buffer_size, '\0');
 
   if (auto rc = BrotliEncoderCompress(
-          /*quality=*/BROTLI_DEFAULT_QUALITY,
+          /*quality=*/std::clamp(quality, BROTLI_MIN_QUALITY,
+                                 BROTLI_MAX_QUALITY),
           /*lgwin=*/BROTLI_DEFAULT_WINDOW,
           /*mode=*/BROTLI_DEFAULT_MODE,
           /*input_size=*/partition.size(),
@@ -169,7 +172,7 @@ absl::StatusOr<std::string> BrotliCompressionGroupConcatenator::Build() const {
   std::vector<std::string> compression_groups;
   // Go through every partition to compress them one by one.
   for (const auto& partition : Partitions()) {
-    if (auto maybe_partition_output = CompressOnePartition(partition);
+    if (auto maybe_partition_output = CompressOnePartition(partition, quality_);
         !maybe_partition_output.ok()) {
       return maybe_partition_output.status();
     } else {
@@ -21,7 +21,14 @@ namespace kv_server {
 // Builds compression groups that are compressed by Brotli.
 class BrotliCompressionGroupConcatenator : public CompressionGroupConcatenator {
  public:
+  // `quality` is clamped to Brotli's range, 0 to 11.
+  explicit BrotliCompressionGroupConcatenator(int quality = 11)
+      : quality_(quality) {}
+
   absl::StatusOr<std::string> Build() const override;
+
+ private:
+  const int quality_;
 };
 
 // Reads compression groups built with BrotliCompressionGroupConcatenator.
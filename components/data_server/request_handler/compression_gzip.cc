@@ -0,0 +1,161 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data_server/request_handler/compression_gzip.h"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "absl/log/log.h"
+#include "absl/strings/str_cat.h"
+#include "quiche/common/quiche_data_writer.h"
+#include "zlib.h"
+
+namespace kv_server {
+
+namespace {
+
+// Adding 16 to the window bits makes zlib write and read gzip headers instead
+// of zlib ones.
+constexpr int kGzipWindowBits = 15 + 16;
+constexpr int kMemLevel = 8;
+
+struct DeflateStreamDeleter {
+  void operator()(z_stream* stream) const {
+    deflateEnd(stream);
+    delete stream;
+  }
+};
+
+// Returns the deflate state of the calling thread, reset to compress at
+// `level`, so that groups don't allocate their own. Null if zlib fails to
+// initialize it.
+z_stream* ThreadDeflateStream(int level) {
+  thread_local std::unique_ptr<z_stream, DeflateStreamDeleter> stream;
+  thread_local int stream_level = 0;
+  if (stream == nullptr) {
+    auto new_stream = std::make_unique<z_stream>();
+    if (deflateInit2(new_stream.get(), level, Z_DEFLATED, kGzipWindowBits,
+                     kMemLevel, Z_DEFAULT_STRATEGY) != Z_OK) {
+      return nullptr;
+    }
+    stream.reset(new_stream.release());
+    stream_level = level;
+    return stream.get();
+  }
+  if (deflateReset(stream.get()) != Z_OK) {
+    return nullptr;
+  }
+  if (level != stream_level) {
+    if (deflateParams(stream.get(), level, Z_DEFAULT_STRATEGY) != Z_OK) {
+      return nullptr;
+    }
+    stream_level = level;
+  }
+  return stream.get();
+}
+
+// Compresses one compression group, prefixed with its compressed size.
+absl::StatusOr<std::string> CompressOnePartition(std::string_view partition,
+                                                 int level) {
+  z_stream* stream = ThreadDeflateStream(std::clamp(level, 0, 9));
+  if (stream == nullptr) {
+    return absl::InternalError("gzip failed to initialize");
+  }
+  const uLong buffer_size = deflateBound(stream, partition.size());
+  std::string partition_output(sizeof(uint32_t) + buffer_size, '\0');
+  stream->next_in =
+      reinterpret_cast<Bytef*>(const_cast<char*>(partition.data()));
+  stream->avail_in = partition.size();
+  stream->next_out =
+      reinterpret_cast<Bytef*>(&partition_output.at(sizeof(uint32_t)));
+  stream->avail_out = buffer_size;
+  const int rc = deflate(stream, Z_FINISH);
+  const uLong compressed_size = stream->total_out;
+  if (rc != Z_STREAM_END) {
+    return absl::InternalError(absl::StrCat("gzip failed to compress: ", rc));
+  }
+  partition_output.resize(sizeof(uint32_t) + compressed_size);
+  quiche::QuicheDataWriter data_writer(sizeof(uint32_t),
+                                       partition_output.data());
+  data_writer.WriteUInt32(compressed_size);
+  VLOG(5) << "partition output size: " << partition_output.size();
+  return partition_output;
+}
+
+absl::StatusOr<std::string> DecompressOneGroup(std::string_view compressed) {
+  z_stream stream = {};
+  if (const int rc = inflateInit2(&stream, kGzipWindowBits); rc != Z_OK) {
+    return absl::InternalError(absl::StrCat("gzip failed to initialize: ", rc));
+  }
+  stream.next_in =
+      reinterpret_cast<Bytef*>(const_cast<char*>(compressed.data()));
+  stream.avail_in = compressed.size();
+  // JSON compresses well, start with room for a few times the input.
+  std::string output(std::max<size_t>(4 * compressed.size(), 64), '\0');
+  int rc = Z_OK;
+  while (rc == Z_OK) {
+    if (stream.total_out == output.size()) {
+      output.resize(2 * output.size());
+    }
+    stream.next_out = reinterpret_cast<Bytef*>(&output[stream.total_out]);
+    stream.avail_out = output.size() - stream.total_out;
+    rc = inflate(&stream, Z_NO_FLUSH);
+  }
+  const uLong decompressed_size = stream.total_out;
+  const bool consumed_input = stream.avail_in == 0;
+  inflateEnd(&stream);
+  if (rc != Z_STREAM_END) {
+    return absl::DataLossError(absl::StrCat("gzip failed to decompress: ", rc));
+  }
+  if (!consumed_input) {
+    return absl::DataLossError("corrupted (exuberant) input");
+  }
+  output.resize(decompressed_size);
+  return output;
+}
+
+}  // namespace
+
+absl::StatusOr<std::string> GzipCompressionGroupConcatenator::Build() const {
+  std::string output;
+  for (const auto& partition : Partitions()) {
+    auto partition_output = CompressOnePartition(partition, level_);
+    if (!partition_output.ok()) {
+      return partition_output.status();
+    }
+    output.append(*partition_output);
+  }
+  return output;
+}
+
+absl::StatusOr<std::string>
+GzipCompressionBlobReader::ExtractOneCompressionGroup() {
+  uint32_t compression_group_size = 0;
+  if (!data_reader_.ReadUInt32(&compression_group_size)) {
+    return absl::InvalidArgumentError("Failed to read compression group size");
+  }
+  VLOG(9) << "compression_group_size: " << compression_group_size;
+  std::string_view compressed_data;
+  if (!data_reader_.ReadStringPiece(&compressed_data, compression_group_size)) {
+    return absl::InvalidArgumentError("Failed to read compression group");
+  }
+  return DecompressOneGroup(compressed_data);
+}
+
+}  // namespace kv_server
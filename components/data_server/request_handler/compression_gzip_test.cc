@@ -0,0 +1,93 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data_server/request_handler/compression_gzip.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "components/data_server/request_handler/uncompressed.h"
+#include "components/telemetry/server_definition.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+const std::string_view kTestString = "large message";
+const std::string_view kTestString2 = "large message 2";
+
+TEST(GzipCompressionGroupConcatenatorTest, Success) {
+  for (const int level : {0, 1, 6, 9}) {
+    GzipCompressionGroupConcatenator concatenator(level);
+    concatenator.AddCompressionGroup(std::string(kTestString));
+    concatenator.AddCompressionGroup(std::string(kTestString2));
+    const std::string large_message(5000, 'a');
+    concatenator.AddCompressionGroup(large_message);
+
+    auto maybe_output = concatenator.Build();
+    ASSERT_TRUE(maybe_output.ok()) << maybe_output.status();
+    if (level > 0) {
+      EXPECT_LT(maybe_output->size(), large_message.size());
+    }
+
+    GzipCompressionBlobReader blob_reader(*maybe_output);
+    auto maybe_compression_group = blob_reader.ExtractOneCompressionGroup();
+    ASSERT_TRUE(maybe_compression_group.ok());
+    EXPECT_EQ(*maybe_compression_group, kTestString);
+    maybe_compression_group = blob_reader.ExtractOneCompressionGroup();
+    ASSERT_TRUE(maybe_compression_group.ok());
+    EXPECT_EQ(*maybe_compression_group, kTestString2);
+    maybe_compression_group = blob_reader.ExtractOneCompressionGroup();
+    ASSERT_TRUE(maybe_compression_group.ok());
+    EXPECT_EQ(*maybe_compression_group, large_message);
+    EXPECT_TRUE(blob_reader.IsDoneReading());
+  }
+}
+
+TEST(CompressGroupsTest, CompressesGroupsConcurrentlyInOrder) {
+  InitMetricsContextMap();
+  std::vector<std::string> groups;
+  for (int i = 0; i < 20; ++i) {
+    groups.push_back(absl::StrCat("group ", i, std::string(i * 100, 'x')));
+  }
+  auto blobs = CompressGroups(
+      groups, CompressionGroupConcatenator::CompressionType::kGzip,
+      &CompressionGroupConcatenator::Create, /*max_concurrency=*/4);
+  ASSERT_TRUE(blobs.ok()) << blobs.status();
+  ASSERT_EQ(blobs->size(), groups.size());
+  for (size_t i = 0; i < groups.size(); ++i) {
+    GzipCompressionBlobReader blob_reader((*blobs)[i]);
+    auto group = blob_reader.ExtractOneCompressionGroup();
+    ASSERT_TRUE(group.ok()) << group.status();
+    EXPECT_EQ(*group, groups[i]);
+    EXPECT_TRUE(blob_reader.IsDoneReading());
+  }
+}
+
+TEST(GzipCompressionBlobReaderTest, CorruptedGroupFails) {
+  UncompressedConcatenator concatenator;
+  concatenator.AddCompressionGroup("not gzip");
+  auto maybe_blob = concatenator.Build();
+  ASSERT_TRUE(maybe_blob.ok());
+
+  GzipCompressionBlobReader blob_reader(*maybe_blob);
+  EXPECT_FALSE(blob_reader.ExtractOneCompressionGroup().ok());
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -0,0 +1,86 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data_server/request_handler/compression_zstd.h"
+
+#include <string>
+#include <utility>
+
+#include "absl/log/log.h"
+#include "absl/strings/str_cat.h"
+#include "quiche/common/quiche_data_writer.h"
+
+namespace kv_server {
+
+namespace {
+
+// zstd's default compression level.
+constexpr int kDefaultZstdLevel = 3;
+
+std::shared_ptr<const ValueCodec> CodecOrDefault(
+    std::shared_ptr<const ValueCodec> codec) {
+  if (codec != nullptr) {
+    return codec;
+  }
+  // Creating a codec without dictionary can't fail.
+  static const auto* const kDefaultCodec =
+      new std::shared_ptr<const ValueCodec>(
+          *ValueCodec::Create(/*dictionary=*/"", kDefaultZstdLevel));
+  return *kDefaultCodec;
+}
+
+}  // namespace
+
+ZstdCompressionGroupConcatenator::ZstdCompressionGroupConcatenator(
+    std::shared_ptr<const ValueCodec> codec)
+    : codec_(CodecOrDefault(std::move(codec))) {}
+
+absl::StatusOr<std::string> ZstdCompressionGroupConcatenator::Build() const {
+  std::string output;
+  for (const auto& partition : Partitions()) {
+    auto compressed = codec_->Compress(partition);
+    if (!compressed.ok()) {
+      return compressed.status();
+    }
+    std::string size(sizeof(uint32_t), '\0');
+    quiche::QuicheDataWriter data_writer(size.size(), size.data());
+    data_writer.WriteUInt32(compressed->size());
+    absl::StrAppend(&output, size, *compressed);
+  }
+  VLOG(5) << "zstd output size: " << output.size();
+  return output;
+}
+
+ZstdCompressionBlobReader::ZstdCompressionBlobReader(
+    std::string_view compressed, std::shared_ptr<const ValueCodec> codec)
+    : CompressedBlobReader(compressed),
+      codec_(CodecOrDefault(std::move(codec))) {}
+
+absl::StatusOr<std::string>
+ZstdCompressionBlobReader::ExtractOneCompressionGroup() {
+  uint32_t compression_group_size = 0;
+  if (!data_reader_.ReadUInt32(&compression_group_size)) {
+    return absl::InvalidArgumentError("Failed to read compression group size");
+  }
+  VLOG(9) << "compression_group_size: " << compression_group_size;
+  std::string_view compressed_data;
+  if (!data_reader_.ReadStringPiece(&compressed_data, compression_group_size)) {
+    return absl::InvalidArgumentError("Failed to read compression group");
+  }
+  return codec_->Decompress(compressed_data);
+}
+
+}  // namespace kv_server
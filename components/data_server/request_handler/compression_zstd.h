@@ -0,0 +1,59 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_REQUEST_HANDLER_COMPRESSION_ZSTD_H_
+#define COMPONENTS_DATA_SERVER_REQUEST_HANDLER_COMPRESSION_ZSTD_H_
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "absl/status/statusor.h"
+#include "components/data_server/cache/value_codec.h"
+#include "components/data_server/request_handler/compression.h"
+
+namespace kv_server {
+
+// Builds compression groups that are compressed by zstd with `codec`, or at
+// zstd's default level without dictionary if `codec` is null.
+class ZstdCompressionGroupConcatenator : public CompressionGroupConcatenator {
+ public:
+  explicit ZstdCompressionGroupConcatenator(
+      std::shared_ptr<const ValueCodec> codec = nullptr);
+
+  absl::StatusOr<std::string> Build() const override;
+
+ private:
+  const std::shared_ptr<const ValueCodec> codec_;
+};
+
+// Reads compression groups built with ZstdCompressionGroupConcatenator.
+// `codec` must have the dictionary that the groups were compressed with.
+class ZstdCompressionBlobReader : public CompressedBlobReader {
+ public:
+  explicit ZstdCompressionBlobReader(
+      std::string_view compressed,
+      std::shared_ptr<const ValueCodec> codec = nullptr);
+
+  absl::StatusOr<std::string> ExtractOneCompressionGroup() override;
+
+ private:
+  const std::shared_ptr<const ValueCodec> codec_;
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_REQUEST_HANDLER_COMPRESSION_ZSTD_H_
@@ -0,0 +1,85 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data_server/request_handler/compression_zstd.h"
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "components/data_server/cache/value_codec.h"
+#include "components/data_server/request_handler/uncompressed.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+const std::string_view kTestString = "large message";
+const std::string_view kTestString2 = "large message 2";
+const std::string_view kJsonString = R"([{"key": "value"}, {"key": "value"}])";
+
+TEST(ZstdCompressionGroupConcatenatorTest, Success) {
+  ZstdCompressionGroupConcatenator concatenator;
+  concatenator.AddCompressionGroup(std::string(kTestString));
+  concatenator.AddCompressionGroup(std::string(kTestString2));
+  const std::string large_message(5000, 'a');
+  concatenator.AddCompressionGroup(large_message);
+
+  auto maybe_output = concatenator.Build();
+  ASSERT_TRUE(maybe_output.ok()) << maybe_output.status();
+  EXPECT_LT(maybe_output->size(), large_message.size());
+
+  ZstdCompressionBlobReader blob_reader(*maybe_output);
+  auto maybe_compression_group = blob_reader.ExtractOneCompressionGroup();
+  ASSERT_TRUE(maybe_compression_group.ok());
+  EXPECT_EQ(*maybe_compression_group, kTestString);
+  maybe_compression_group = blob_reader.ExtractOneCompressionGroup();
+  ASSERT_TRUE(maybe_compression_group.ok());
+  EXPECT_EQ(*maybe_compression_group, kTestString2);
+  maybe_compression_group = blob_reader.ExtractOneCompressionGroup();
+  ASSERT_TRUE(maybe_compression_group.ok());
+  EXPECT_EQ(*maybe_compression_group, large_message);
+  EXPECT_TRUE(blob_reader.IsDoneReading());
+}
+
+TEST(ZstdCompressionGroupConcatenatorTest, UsesCodecLevel) {
+  auto codec = ValueCodec::Create(/*dictionary=*/"", /*level=*/19);
+  ASSERT_TRUE(codec.ok()) << codec.status();
+  std::shared_ptr<const ValueCodec> shared_codec = *std::move(codec);
+  ZstdCompressionGroupConcatenator concatenator(shared_codec);
+  concatenator.AddCompressionGroup(std::string(kJsonString));
+
+  auto maybe_output = concatenator.Build();
+  ASSERT_TRUE(maybe_output.ok()) << maybe_output.status();
+  ZstdCompressionBlobReader blob_reader(*maybe_output, shared_codec);
+  auto maybe_compression_group = blob_reader.ExtractOneCompressionGroup();
+  ASSERT_TRUE(maybe_compression_group.ok());
+  EXPECT_EQ(*maybe_compression_group, kJsonString);
+}
+
+TEST(ZstdCompressionBlobReaderTest, CorruptedGroupFails) {
+  UncompressedConcatenator concatenator;
+  concatenator.AddCompressionGroup("not zstd");
+  auto maybe_blob = concatenator.Build();
+  ASSERT_TRUE(maybe_blob.ok());
+
+  ZstdCompressionBlobReader blob_reader(*maybe_blob);
+  EXPECT_FALSE(blob_reader.ExtractOneCompressionGroup().ok());
+}
+
+}  // namespace
+}  // namespace kv_server
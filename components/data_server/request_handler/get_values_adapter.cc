@@ -16,14 +16,18 @@
 
 #include "components/data_server/request_handler/get_values_adapter.h"
 
+#include <algorithm>
+#include <initializer_list>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
 #include "absl/log/log.h"
 #include "components/data_server/request_handler/v2_response_data.pb.h"
 #include "google/protobuf/util/json_util.h"
+#include "nlohmann/json.hpp"
 #include "public/api_schema.pb.h"
 #include "public/applications/pa/api_overlay.pb.h"
 #include "public/applications/pa/response_utils.h"
@@ -154,23 +158,199 @@ void ProcessKeyGroupOutput(application_pa::KeyGroupOutput key_group_output,
   }
 }
 
-// Converts a v2 response into v1 response.
-absl::Status ConvertToV1Response(const v2::GetValuesResponse& v2_response,
+// Sets `value` to the JSON value `json`.
+void ToValue(const nlohmann::json& json, Value& value) {
+  switch (json.type()) {
+    case nlohmann::json::value_t::null:
+      value.set_null_value(google::protobuf::NULL_VALUE);
+      break;
+    case nlohmann::json::value_t::boolean:
+      value.set_bool_value(json.get<bool>());
+      break;
+    case nlohmann::json::value_t::number_integer:
+    case nlohmann::json::value_t::number_unsigned:
+    case nlohmann::json::value_t::number_float:
+      value.set_number_value(json.get<double>());
+      break;
+    case nlohmann::json::value_t::string:
+      value.set_string_value(json.get_ref<const std::string&>());
+      break;
+    case nlohmann::json::value_t::array: {
+      auto* list = value.mutable_list_value();
+      for (const auto& element : json) {
+        ToValue(element, *list->add_values());
+      }
+      break;
+    }
+    case nlohmann::json::value_t::object: {
+      auto& fields = *value.mutable_struct_value()->mutable_fields();
+      for (const auto& [key, field] : json.items()) {
+        ToValue(field, fields[key]);
+      }
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+// Same as `ProcessKeyValues`, over the parsed UDF output: string values that
+// are JSON are returned parsed, others as they are.
+void ProcessJsonKeyValues(
+    const nlohmann::json& key_values,
+    google::protobuf::Map<std::string, v1::V1SingleLookupResult>&
+        result_struct) {
+  for (const auto& [key, value_object] : key_values.items()) {
+    v1::V1SingleLookupResult result;
+    Value& value = *result.mutable_value();
+    if (const auto it = value_object.find("value"); it != value_object.end()) {
+      if (it->is_string()) {
+        const auto parsed = nlohmann::json::parse(
+            it->get_ref<const std::string&>(), /*cb=*/nullptr,
+            /*allow_exceptions=*/false);
+        ToValue(parsed.is_discarded() ? *it : parsed, value);
+      } else {
+        ToValue(*it, value);
+      }
+    }
+    result_struct[key] = std::move(result);
+  }
+}
+
+// Returns the field `name` of `object`, under its JSON or its proto name.
+const nlohmann::json* FindField(const nlohmann::json& object,
+                                const char* json_name, const char* proto_name) {
+  for (const char* name : {json_name, proto_name}) {
+    if (const auto it = object.find(name); it != object.end()) {
+      return &*it;
+    }
+  }
+  return nullptr;
+}
+
+// Whether the field `name` of `object` is absent or an integer.
+bool IsIntegerOrAbsent(const nlohmann::json& object, const char* json_name,
+                       const char* proto_name) {
+  const nlohmann::json* field = FindField(object, json_name, proto_name);
+  return field == nullptr || field->is_number_integer();
+}
+
+// Whether every field of `object` is one of `names`.
+bool HasOnlyFields(const nlohmann::json& object,
+                   std::initializer_list<std::string_view> names) {
+  for (const auto& [key, _] : object.items()) {
+    if (std::find(names.begin(), names.end(), key) == names.end()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Whether `output` is a well-formed UDF output, of the shape of
+// `KeyGroupOutputs`, that `ProcessJsonOutput` can convert.
+bool IsWellFormedOutput(const nlohmann::json& output) {
+  if (!output.is_object() ||
+      !HasOnlyFields(output, {"keyGroupOutputs", "key_group_outputs",
+                              "udfOutputApiVersion",
+                              "udf_output_api_version"}) ||
+      !IsIntegerOrAbsent(output, "udfOutputApiVersion",
+                         "udf_output_api_version")) {
+    return false;
+  }
+  const nlohmann::json* key_group_outputs =
+      FindField(output, "keyGroupOutputs", "key_group_outputs");
+  if (key_group_outputs == nullptr) {
+    return true;
+  }
+  if (!key_group_outputs->is_array()) {
+    return false;
+  }
+  for (const auto& key_group_output : *key_group_outputs) {
+    if (!key_group_output.is_object() ||
+        !HasOnlyFields(key_group_output,
+                       {"tags", "keyValues", "key_values"})) {
+      return false;
+    }
+    if (const nlohmann::json* tags =
+            FindField(key_group_output, "tags", "tags");
+        tags != nullptr) {
+      if (!tags->is_array()) {
+        return false;
+      }
+      for (const auto& tag : *tags) {
+        if (!tag.is_string()) return false;
+      }
+    }
+    const nlohmann::json* key_values =
+        FindField(key_group_output, "keyValues", "key_values");
+    if (key_values == nullptr) continue;
+    if (!key_values->is_object()) {
+      return false;
+    }
+    for (const auto& [_, value_object] : key_values->items()) {
+      if (!value_object.is_object() ||
+          !HasOnlyFields(value_object,
+                         {"value", "globalTtlSec", "global_ttl_sec",
+                          "dedicatedTtlSec", "dedicated_ttl_sec"}) ||
+          !IsIntegerOrAbsent(value_object, "globalTtlSec", "global_ttl_sec") ||
+          !IsIntegerOrAbsent(value_object, "dedicatedTtlSec",
+                             "dedicated_ttl_sec")) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Adds the key values of the well-formed UDF `output` to `v1_response`, in
+// one pass over the parsed JSON, with the same result as
+// `ProcessKeyGroupOutput` over the outputs parsed into `KeyGroupOutputs`.
+void ProcessJsonOutput(const nlohmann::json& output,
+                       v1::GetValuesResponse& v1_response) {
+  const nlohmann::json* key_group_outputs =
+      FindField(output, "keyGroupOutputs", "key_group_outputs");
+  if (key_group_outputs == nullptr) {
+    return;
+  }
+  for (const auto& key_group_output : *key_group_outputs) {
+    const nlohmann::json* tags = FindField(key_group_output, "tags", "tags");
+    const nlohmann::json* key_values =
+        FindField(key_group_output, "keyValues", "key_values");
+    // Ignore if no valid namespace tag that is paired with a 'custom' tag
+    if (tags == nullptr || key_values == nullptr || tags->size() != 2) {
+      continue;
+    }
+    const auto& first = (*tags)[0].get_ref<const std::string&>();
+    const auto& second = (*tags)[1].get_ref<const std::string&>();
+    if (first != kCustomTag && second != kCustomTag) {
+      continue;
+    }
+    const std::string& tag_namespace = second == kCustomTag ? first : second;
+    if (tag_namespace == kKeysTag) {
+      ProcessJsonKeyValues(*key_values, *v1_response.mutable_keys());
+    } else if (tag_namespace == kRenderUrlsTag) {
+      ProcessJsonKeyValues(*key_values, *v1_response.mutable_render_urls());
+    } else if (tag_namespace == kAdComponentRenderUrlsTag) {
+      ProcessJsonKeyValues(*key_values,
+                           *v1_response.mutable_ad_component_render_urls());
+    } else if (tag_namespace == kKvInternalTag) {
+      ProcessJsonKeyValues(*key_values, *v1_response.mutable_kv_internal());
+    }
+  }
+}
+
+// Converts the output of the UDF for a v1 request into the v1 response. The
+// output is parsed once and converted straight into the response, unless it
+// is not well-formed, in which case it's parsed into `KeyGroupOutputs` for
+// the same errors and leniency as v2 responses.
+absl::Status ConvertToV1Response(std::string_view string_output,
                                  v1::GetValuesResponse& v1_response) {
-  if (!v2_response.has_single_partition()) {
-    // This should not happen. V1 request always maps to 1 partition so the
-    // output should always have 1 partition.
-    return absl::InternalError(
-        "Bug in KV server! response does not have single_partition set for V1 "
-        "response.");
-  }
-  if (v2_response.single_partition().has_status()) {
-    return absl::Status(static_cast<absl::StatusCode>(
-                            v2_response.single_partition().status().code()),
-                        v2_response.single_partition().status().message());
-  }
-  const std::string& string_output =
-      v2_response.single_partition().string_output();
+  const auto output = nlohmann::json::parse(string_output, /*cb=*/nullptr,
+                                            /*allow_exceptions=*/false);
+  if (!output.is_discarded() && IsWellFormedOutput(output)) {
+    ProcessJsonOutput(output, v1_response);
+    return absl::OkStatus();
+  }
   // string_output should be a JSON object
   PS_ASSIGN_OR_RETURN(application_pa::KeyGroupOutputs outputs,
                       application_pa::KeyGroupOutputsFromJson(string_output));
@@ -193,14 +373,15 @@ class GetValuesAdapterImpl : public GetValuesAdapter {
     v2::GetValuesRequest v2_request = BuildV2Request(v1_request);
     VLOG(7) << "Converting V1 request " << v1_request.DebugString()
             << " to v2 request " << v2_request.DebugString();
-    v2::GetValuesResponse v2_response;
-    if (auto status = v2_handler_->GetValues(v2_request, &v2_response);
-        !status.ok()) {
-      return status;
+    // The UDF output is converted straight into the v1 response, without a
+    // v2 response in between.
+    const auto output = v2_handler_->GetSinglePartitionOutput(
+        v2_request.metadata(), v2_request.partitions(0));
+    if (!output.ok()) {
+      return privacy_sandbox::server_common::FromAbslStatus(output.status());
     }
-    VLOG(7) << "Received v2 response: " << v2_response.DebugString();
     return privacy_sandbox::server_common::FromAbslStatus(
-        ConvertToV1Response(v2_response, v1_response));
+        ConvertToV1Response(*output, v1_response));
   }
 
  private:
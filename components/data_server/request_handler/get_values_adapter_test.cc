@@ -472,6 +472,52 @@ TEST_F(GetValuesAdapterTest, KeyGroupOutputHasDifferentValueTypesReturnsOk) {
   EXPECT_THAT(v1_response, EqualsProto(v1_expected));
 }
 
+TEST_F(GetValuesAdapterTest, OutputWithProtoFieldNamesReturnsOk) {
+  nlohmann::json output = R"({
+    "key_group_outputs": [{
+        "key_values": {
+          "key1": { "value": "not json" },
+          "key2": { "value": "[\"v\"]", "global_ttl_sec": 10 }
+        },
+        "tags": ["keys", "custom"]
+    }],
+    "udf_output_api_version": 1
+  })"_json;
+  EXPECT_CALL(mock_udf_client_, ExecuteCode(_, _, _))
+      .WillOnce(Return(output.dump()));
+
+  v1::GetValuesRequest v1_request;
+  v1_request.add_keys("key1");
+  v1::GetValuesResponse v1_response;
+  auto status = get_values_adapter_->CallV2Handler(v1_request, v1_response);
+  EXPECT_TRUE(status.ok());
+  v1::GetValuesResponse v1_expected;
+  TextFormat::ParseFromString(
+      R"pb(
+        keys {
+          key: "key1"
+          value { value { string_value: "not json" } }
+        }
+        keys {
+          key: "key2"
+          value { value { list_value { values { string_value: "v" } } } }
+        })pb",
+      &v1_expected);
+  EXPECT_THAT(v1_response, EqualsProto(v1_expected));
+}
+
+TEST_F(GetValuesAdapterTest, UdfErrorReturnsError) {
+  EXPECT_CALL(mock_udf_client_, ExecuteCode(_, _, _))
+      .WillOnce(Return(absl::InternalError("UDF failed")));
+
+  v1::GetValuesRequest v1_request;
+  v1_request.add_keys("key1");
+  v1::GetValuesResponse v1_response;
+  auto status = get_values_adapter_->CallV2Handler(v1_request, v1_response);
+  EXPECT_EQ(status.error_code(), grpc::StatusCode::INTERNAL);
+  EXPECT_EQ(status.error_message(), "UDF failed");
+}
+
 TEST_F(GetValuesAdapterTest, ValueWithStatusSuccess) {
   nlohmann::json output = R"({
     "keyGroupOutputs": [{
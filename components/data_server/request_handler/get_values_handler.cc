@@ -14,6 +14,7 @@
 
 #include "components/data_server/request_handler/get_values_handler.h"
 
+#include <algorithm>
 #include <iterator>
 #include <string>
 #include <utility>
@@ -23,6 +24,8 @@
 #include "absl/strings/str_replace.h"
 #include "absl/strings/str_split.h"
 #include "components/data_server/request_handler/get_values_adapter.h"
+#include "components/data_server/request_handler/v1_value_cache.h"
+#include "components/telemetry/server_definition.h"
 #include "grpcpp/grpcpp.h"
 #include "public/constants.h"
 #include "public/query/get_values.grpc.pb.h"
@@ -34,7 +37,6 @@ namespace kv_server {
 namespace {
 using google::protobuf::RepeatedPtrField;
 using google::protobuf::Struct;
-using google::protobuf::Value;
 using grpc::StatusCode;
 using v1::GetValuesRequest;
 using v1::GetValuesResponse;
@@ -56,15 +58,16 @@ void ProcessKeys(
     const RequestContext& request_context,
     const RepeatedPtrField<std::string>& keys, const Cache& cache,
     google::protobuf::Map<std::string, v1::V1SingleLookupResult>& result_struct,
-    bool add_missing_keys_v1) {
+    bool add_missing_keys_v1, V1ValueCache* value_cache) {
   if (keys.empty()) return;
   auto actual_keys = GetKeys(keys);
-  auto kv_pairs = cache.GetKeyValuePairs(request_context, actual_keys);
+  const auto kv_pairs =
+      cache.GetKeyValuePairViews(request_context, actual_keys);
   // TODO(b/326118416): Record cache hit and miss metrics
   for (const auto& key : actual_keys) {
     v1::V1SingleLookupResult result;
-    const auto key_iter = kv_pairs.find(key);
-    if (key_iter == kv_pairs.end()) {
+    const auto cached_value = kv_pairs.GetValue(key);
+    if (!cached_value.has_value()) {
       if (add_missing_keys_v1) {
         auto status = result.mutable_status();
         status->set_code(static_cast<int>(absl::StatusCode::kNotFound));
@@ -72,28 +75,56 @@ void ProcessKeys(
         result_struct[key] = std::move(result);
       }
     } else {
-      Value value_proto;
-      absl::Status status = google::protobuf::util::JsonStringToMessage(
-          key_iter->second, &value_proto);
-      if (status.ok()) {
-        *result.mutable_value() = value_proto;
+      if (value_cache != nullptr) {
+        *result.mutable_value() = *value_cache->Parse(key, *cached_value);
       } else {
-        // If string is not a Json string that can be parsed into Value
-        // proto, simply set it as pure string value to the response.
-        google::protobuf::Value value;
-        value.set_string_value(std::move(key_iter->second));
-        *result.mutable_value() = std::move(value);
+        *result.mutable_value() = ParseV1Value(*cached_value);
       }
       result_struct[key] = std::move(result);
     }
   }
 }
 
+// Returns a key that is the same for the requests that get the same
+// response, whatever the order of their keys.
+std::string GetCoalescingKey(const GetValuesRequest& request) {
+  GetValuesRequest normalized = request;
+  for (auto* keys :
+       {normalized.mutable_keys(), normalized.mutable_render_urls(),
+        normalized.mutable_ad_component_render_urls(),
+        normalized.mutable_kv_internal()}) {
+    std::sort(keys->begin(), keys->end());
+  }
+  return normalized.SerializeAsString();
+}
+
 }  // namespace
 
 grpc::Status GetValuesHandler::GetValues(const RequestContext& request_context,
                                          const GetValuesRequest& request,
                                          GetValuesResponse* response) const {
+  if (single_flight_ == nullptr) {
+    return ProcessRequest(request_context, request, response);
+  }
+  bool collapsed = false;
+  const auto result = single_flight_->Do(
+      GetCoalescingKey(request),
+      [this, &request_context, &request] {
+        Result result;
+        result.status =
+            ProcessRequest(request_context, request, &result.response);
+        return result;
+      },
+      &collapsed);
+  LogSingleFlightEvent(collapsed ? kSingleFlightV1Collapsed
+                                 : kSingleFlightV1Executed);
+  *response = result->response;
+  return result->status;
+}
+
+grpc::Status GetValuesHandler::ProcessRequest(
+    const RequestContext& request_context, const GetValuesRequest& request,
+    GetValuesResponse* response) const {
   if (use_v2_) {
     VLOG(5) << "Using V2 adapter for " << request.DebugString();
     return adapter_.CallV2Handler(request, *response);
@@ -101,24 +132,27 @@ grpc::Status GetValuesHandler::GetValues(const RequestContext& request_context,
   if (!request.kv_internal().empty()) {
     VLOG(5) << "Processing kv_internal for " << request.DebugString();
     ProcessKeys(request_context, request.kv_internal(), cache_,
-                *response->mutable_kv_internal(), add_missing_keys_v1_);
+                *response->mutable_kv_internal(), add_missing_keys_v1_,
+                value_cache_);
   }
   if (!request.keys().empty()) {
     VLOG(5) << "Processing keys for " << request.DebugString();
     ProcessKeys(request_context, request.keys(), cache_,
-                *response->mutable_keys(), add_missing_keys_v1_);
+                *response->mutable_keys(), add_missing_keys_v1_,
+                value_cache_);
   }
   if (!request.render_urls().empty()) {
     VLOG(5) << "Processing render_urls for " << request.DebugString();
     ProcessKeys(request_context, request.render_urls(), cache_,
-                *response->mutable_render_urls(), add_missing_keys_v1_);
+                *response->mutable_render_urls(), add_missing_keys_v1_,
+                value_cache_);
   }
   if (!request.ad_component_render_urls().empty()) {
     VLOG(5) << "Processing ad_component_render_urls for "
             << request.DebugString();
     ProcessKeys(request_context, request.ad_component_render_urls(), cache_,
                 *response->mutable_ad_component_render_urls(),
-                add_missing_keys_v1_);
+                add_missing_keys_v1_, value_cache_);
   }
   return grpc::Status::OK;
 }
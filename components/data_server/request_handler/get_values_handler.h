@@ -22,6 +22,8 @@
 #include <utility>
 
 #include "components/data_server/request_handler/get_values_adapter.h"
+#include "components/data_server/request_handler/v1_value_cache.h"
+#include "components/util/single_flight.h"
 #include "grpcpp/grpcpp.h"
 #include "public/query/get_values.grpc.pb.h"
 #include "src/google/protobuf/struct.pb.h"
@@ -32,12 +34,21 @@ namespace kv_server {
 // See the Service proto definition for details.
 class GetValuesHandler {
  public:
+  // Values are parsed with `value_cache`, if any, which must outlive the
+  // handler. With `coalesce_requests`, concurrent requests for the same keys
+  // share the response of the first one instead of each being processed.
   explicit GetValuesHandler(const Cache& cache, const GetValuesAdapter& adapter,
-                            bool use_v2, bool add_missing_keys_v1 = true)
+                            bool use_v2, bool add_missing_keys_v1 = true,
+                            V1ValueCache* value_cache = nullptr,
+                            bool coalesce_requests = false)
       : cache_(std::move(cache)),
         adapter_(std::move(adapter)),
         use_v2_(use_v2),
-        add_missing_keys_v1_(add_missing_keys_v1) {}
+        add_missing_keys_v1_(add_missing_keys_v1),
+        value_cache_(value_cache),
+        single_flight_(coalesce_requests
+                           ? std::make_unique<SingleFlight<Result>>()
+                           : nullptr) {}
 
   // TODO: Implement hostname, ad/render url lookups.
   grpc::Status GetValues(const RequestContext& request_context,
@@ -45,11 +56,23 @@ class GetValuesHandler {
                          v1::GetValuesResponse* response) const;
 
  private:
+  struct Result {
+    grpc::Status status;
+    v1::GetValuesResponse response;
+  };
+
+  grpc::Status ProcessRequest(const RequestContext& request_context,
+                              const v1::GetValuesRequest& request,
+                              v1::GetValuesResponse* response) const;
+
   const Cache& cache_;
   const GetValuesAdapter& adapter_;
   // If true, routes requests through V2 (UDF). Otherwise, calls cache.
   const bool use_v2_;
   const bool add_missing_keys_v1_;
+  V1ValueCache* const value_cache_;
+  // Null unless requests are coalesced.
+  std::unique_ptr<SingleFlight<Result>> single_flight_;
 };
 
 }  // namespace kv_server
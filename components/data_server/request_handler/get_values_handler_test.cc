@@ -16,13 +16,17 @@
 
 #include <memory>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
 #include "components/data_server/cache/cache.h"
 #include "components/data_server/cache/key_value_cache.h"
 #include "components/data_server/cache/mocks.h"
 #include "components/data_server/request_handler/mocks.h"
+#include "components/data_server/request_handler/v1_value_cache.h"
 #include "gmock/gmock.h"
 #include "google/protobuf/text_format.h"
 #include "grpcpp/grpcpp.h"
@@ -301,6 +305,99 @@ TEST_F(GetValuesHandlerTest, TestResponseOnDifferentValueFormats) {
   EXPECT_THAT(response, EqualsProto(expected_from_json));
 }
 
+TEST_F(GetValuesHandlerTest, ValueCacheReparsesUpdatedValues) {
+  EXPECT_CALL(mock_cache_, GetKeyValuePairs(_, UnorderedElementsAre("key1")))
+      .WillOnce(Return(absl::flat_hash_map<std::string, std::string>{
+          {"key1", "[1]"}}))
+      .WillOnce(Return(absl::flat_hash_map<std::string, std::string>{
+          {"key1", "[1]"}}))
+      .WillOnce(Return(absl::flat_hash_map<std::string, std::string>{
+          {"key1", R"({"k": "v"})"}}));
+
+  V1ValueCache value_cache(/*max_keys=*/10);
+  GetValuesHandler handler(mock_cache_, mock_get_values_adapter_,
+                           /*use_v2=*/false, /*add_missing_keys_v1=*/true,
+                           &value_cache);
+  GetValuesRequest request;
+  request.add_keys("key1");
+  GetValuesResponse expected;
+  TextFormat::ParseFromString(
+      R"pb(keys {
+             key: "key1"
+             value { value { list_value { values { number_value: 1 } } } }
+           })pb",
+      &expected);
+  for (int i = 0; i < 2; ++i) {
+    GetValuesResponse response;
+    ASSERT_TRUE(
+        handler.GetValues(GetRequestContext(), request, &response).ok());
+    EXPECT_THAT(response, EqualsProto(expected));
+  }
+  GetValuesResponse response;
+  ASSERT_TRUE(handler.GetValues(GetRequestContext(), request, &response).ok());
+  TextFormat::ParseFromString(
+      R"pb(keys {
+             key: "key1"
+             value {
+               value {
+                 struct_value {
+                   fields {
+                     key: "k"
+                     value { string_value: "v" }
+                   }
+                 }
+               }
+             }
+           })pb",
+      &expected);
+  EXPECT_THAT(response, EqualsProto(expected));
+}
+
+TEST_F(GetValuesHandlerTest, CoalescesConcurrentIdenticalRequests) {
+  absl::Notification lookup_started;
+  absl::Notification release_lookup;
+  EXPECT_CALL(mock_cache_, GetKeyValuePairs(_, _))
+      .Times(1)
+      .WillOnce([&](const RequestContext&,
+                    const absl::flat_hash_set<std::string_view>&) {
+        lookup_started.Notify();
+        release_lookup.WaitForNotification();
+        return absl::flat_hash_map<std::string, std::string>{
+            {"key1", "value1"}, {"key2", "value2"}};
+      });
+  GetValuesHandler handler(mock_cache_, mock_get_values_adapter_,
+                           /*use_v2=*/false, /*add_missing_keys_v1=*/true,
+                           /*value_cache=*/nullptr,
+                           /*coalesce_requests=*/true);
+  GetValuesRequest request;
+  request.add_keys("key1");
+  request.add_keys("key2");
+  // Lists the same keys in another order.
+  GetValuesRequest duplicate;
+  duplicate.add_keys("key2");
+  duplicate.add_keys("key1");
+  GetValuesResponse response;
+  GetValuesResponse duplicate_response;
+  std::thread leader([&] {
+    EXPECT_TRUE(
+        handler.GetValues(GetRequestContext(), request, &response).ok());
+  });
+  lookup_started.WaitForNotification();
+  std::thread follower([&] {
+    EXPECT_TRUE(handler
+                    .GetValues(GetRequestContext(), duplicate,
+                               &duplicate_response)
+                    .ok());
+  });
+  // Give the follower time to join the request in flight.
+  absl::SleepFor(absl::Milliseconds(50));
+  release_lookup.Notify();
+  leader.join();
+  follower.join();
+  EXPECT_THAT(duplicate_response, EqualsProto(response));
+  EXPECT_EQ(response.keys().size(), 2);
+}
+
 TEST_F(GetValuesHandlerTest, CallsV2Adapter) {
   GetValuesResponse adapter_response;
   TextFormat::ParseFromString(R"pb(keys {
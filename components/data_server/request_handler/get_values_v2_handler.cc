@@ -14,18 +14,37 @@
 
 #include "components/data_server/request_handler/get_values_v2_handler.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
 #include <memory>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <utility>
 #include <vector>
 
 #include "absl/algorithm/container.h"
+#include "absl/cleanup/cleanup.h"
+#include "absl/container/flat_hash_map.h"
 #include "absl/log/log.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/ascii.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "components/data_server/request_handler/binary_http_response.h"
 #include "components/data_server/request_handler/ohttp_server_encryptor.h"
+#include "components/data_server/request_handler/v2_cbor_codec.h"
+#include "components/data_server/request_handler/v2_json_codec.h"
 #include "components/telemetry/server_definition.h"
+#include "components/util/request_tracing.h"
+#include "components/util/thread_pool.h"
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
 #include "google/protobuf/util/json_util.h"
 #include "grpcpp/grpcpp.h"
 #include "public/base_types.pb.h"
@@ -50,36 +69,189 @@ using v2::ObliviousGetValuesRequest;
 const std::string_view kOHTTPResponseContentType = "message/ohttp-res";
 constexpr std::string_view kAcceptEncodingHeader = "accept-encoding";
 constexpr std::string_view kContentEncodingHeader = "content-encoding";
-constexpr std::string_view kBrotliAlgorithmHeader = "br";
 
-CompressionGroupConcatenator::CompressionType GetResponseCompressionType(
+using CompressionType = CompressionGroupConcatenator::CompressionType;
+
+// Compressions that the server can respond with, in the order it prefers them
+// when the client accepts several of them equally. zstd compresses about as
+// well as brotli for a fraction of its CPU.
+constexpr std::pair<std::string_view, CompressionType> kEncodings[] = {
+    {"zstd", CompressionType::kZstd},
+    {"br", CompressionType::kBrotli},
+    {"gzip", CompressionType::kGzip},
+};
+
+std::string_view EncodingName(CompressionType type) {
+  for (const auto& [name, encoding_type] : kEncodings) {
+    if (encoding_type == type) return name;
+  }
+  return "identity";
+}
+
+// Returns the quality value of one element of an accept-encoding header, 1 if
+// it has none.
+double GetQualityValue(std::string_view element) {
+  for (std::string_view parameter :
+       absl::StrSplit(element, ';', absl::SkipWhitespace())) {
+    parameter = absl::StripAsciiWhitespace(parameter);
+    double quality;
+    if (absl::ConsumePrefix(&parameter, "q=") &&
+        absl::SimpleAtod(parameter, &quality)) {
+      return quality;
+    }
+  }
+  return 1;
+}
+
+// Picks the compression that the client accepts with the highest quality
+// value, see https://www.rfc-editor.org/rfc/rfc9110#field.accept-encoding.
+CompressionType GetResponseCompressionType(
     const std::vector<quiche::BinaryHttpMessage::Field>& headers) {
+  // Quality values of `kEncodings`, negative until the client lists them.
+  double qualities[std::size(kEncodings)] = {-1, -1, -1};
+  double wildcard_quality = 0;
   for (const quiche::BinaryHttpMessage::Field& header : headers) {
     if (absl::AsciiStrToLower(header.name) != kAcceptEncodingHeader) continue;
-    // TODO(b/278271389): Right now for simplicity we support Accept-Encoding:
-    // br
-    if (absl::AsciiStrToLower(header.value) == kBrotliAlgorithmHeader) {
-      return CompressionGroupConcatenator::CompressionType::kBrotli;
+    for (std::string_view element :
+         absl::StrSplit(header.value, ',', absl::SkipWhitespace())) {
+      const std::string coding = absl::AsciiStrToLower(
+          absl::StripAsciiWhitespace(element.substr(0, element.find(';'))));
+      const double quality = GetQualityValue(element);
+      if (coding == "*") {
+        wildcard_quality = quality;
+        continue;
+      }
+      for (size_t i = 0; i < std::size(kEncodings); ++i) {
+        if (coding == kEncodings[i].first) qualities[i] = quality;
+      }
+    }
+  }
+  CompressionType type = CompressionType::kUncompressed;
+  double best_quality = 0;
+  for (size_t i = 0; i < std::size(kEncodings); ++i) {
+    const double quality = qualities[i] < 0 ? wildcard_quality : qualities[i];
+    if (quality > best_quality) {
+      type = kEncodings[i].second;
+      best_quality = quality;
     }
   }
-  return CompressionGroupConcatenator::CompressionType::kUncompressed;
+  return type;
+}
+
+// Serializes `message` with its map entries in a stable order, so that equal
+// messages have equal serializations.
+std::string SerializeDeterministically(
+    const google::protobuf::Message& message) {
+  std::string serialized;
+  {
+    google::protobuf::io::StringOutputStream stream(&serialized);
+    google::protobuf::io::CodedOutputStream coded_stream(&stream);
+    coded_stream.SetSerializationDeterministic(true);
+    message.SerializeToCodedStream(&coded_stream);
+  }
+  return serialized;
+}
+
+// Returns a key that is the same for the partitions that get the same UDF
+// output, whatever their ids.
+std::string GetCoalescingKey(const UDFExecutionMetadata& udf_metadata,
+                             const v2::RequestPartition& req_partition) {
+  v2::RequestPartition udf_input;
+  *udf_input.mutable_arguments() = req_partition.arguments();
+  const std::string serialized_metadata =
+      SerializeDeterministically(udf_metadata);
+  return absl::StrCat(serialized_metadata.size(), ":", serialized_metadata,
+                      SerializeDeterministically(udf_input));
+}
+
+// Logs the bytes of the buffers that held a response at the same time, which
+// is most of the memory that serving it took.
+void LogResponseBufferBytes(size_t bytes) {
+  LogIfError(KVServerContextMap()
+                 ->SafeMetric()
+                 .LogHistogram<kV2ResponseBufferBytes>(
+                     static_cast<double>(bytes)));
+}
+
+void SetPartitionOutput(absl::StatusOr<std::string> maybe_output_string,
+                        v2::ResponsePartition& resp_partition) {
+  if (!maybe_output_string.ok()) {
+    resp_partition.mutable_status()->set_code(
+        static_cast<int>(maybe_output_string.status().code()));
+    resp_partition.mutable_status()->set_message(
+        maybe_output_string.status().message());
+  } else {
+    VLOG(5) << "UDF output: " << maybe_output_string.value();
+    resp_partition.set_string_output(std::move(maybe_output_string).value());
+  }
 }
 }  // namespace
 
+struct GetValuesV2Handler::AsyncGetValuesCall {
+  AsyncGetValuesCall(const v2::GetValuesRequest& request,
+                     v2::GetValuesResponse& response,
+                     absl::AnyInvocable<void(grpc::Status)> on_done,
+                     const RequestDeadline& deadline)
+      : request(request),
+        response(response),
+        on_done(std::move(on_done)),
+        resp_partitions(request.partitions().size()),
+        pending_partitions(request.partitions().size()) {
+    request_context.SetDeadline(deadline);
+    request_context.SetTraceContext(span.context());
+  }
+
+  const v2::GetValuesRequest& request;
+  v2::GetValuesResponse& response;
+  absl::AnyInvocable<void(grpc::Status)> on_done;
+  std::unique_ptr<ScopeMetricsContext> scope_metrics_context =
+      std::make_unique<ScopeMetricsContext>();
+  RequestContext request_context{*scope_metrics_context};
+  std::vector<v2::ResponsePartition> resp_partitions;
+  std::atomic<int> next_partition = 0;
+  std::atomic<int> pending_partitions;
+  // Ended by the thread of the last partition, it's never active.
+  RequestSpan span = RequestSpan::StartRoot("GetValuesAsync");
+};
+
 grpc::Status GetValuesV2Handler::GetValuesHttp(
-    const GetValuesHttpRequest& request,
-    google::api::HttpBody* response) const {
-  return FromAbslStatus(
-      GetValuesHttp(request.raw_body().data(), *response->mutable_data()));
+    const GetValuesHttpRequest& request, google::api::HttpBody* response,
+    const RequestDeadline& deadline) const {
+  RequestSpan span = RequestSpan::StartRoot("GetValuesHttp");
+  span.Activate();
+  const absl::Status status = GetValuesHttp(
+      request.raw_body().data(), *response->mutable_data(), deadline);
+  span.SetStatus(status);
+  return FromAbslStatus(status);
 }
 
-absl::Status GetValuesV2Handler::GetValuesHttp(std::string_view request,
-                                               std::string& response,
-                                               ContentType content_type) const {
+absl::Status GetValuesV2Handler::GetValuesHttp(
+    std::string_view request, std::string& response,
+    const RequestDeadline& deadline) const {
+  v2::GetValuesResponse response_proto;
+  PS_RETURN_IF_ERROR(ParseAndGetValues(request, ContentType::kJson,
+                                       CompressionType::kUncompressed,
+                                       deadline, response_proto));
+  PS_RETURN_IF_ERROR(use_fast_json_codec_
+                         ? GetValuesResponseToJson(response_proto, response)
+                         : MessageToJsonString(response_proto, &response));
+  LogResponseBufferBytes(response_proto.ByteSizeLong() + response.size());
+  return absl::OkStatus();
+}
+
+absl::Status GetValuesV2Handler::ParseAndGetValues(
+    std::string_view request, ContentType content_type,
+    CompressionType compression_type, const RequestDeadline& deadline,
+    v2::GetValuesResponse& response) const {
   v2::GetValuesRequest request_proto;
+  RequestSpan parse_span = RequestSpan::StartChild("ParseRequest");
   if (content_type == ContentType::kJson) {
     PS_RETURN_IF_ERROR(
-        google::protobuf::util::JsonStringToMessage(request, &request_proto));
+        use_fast_json_codec_
+            ? ParseGetValuesRequestJson(request, request_proto)
+            : JsonStringToMessage(request, &request_proto));
+  } else if (content_type == ContentType::kCbor) {
+    PS_RETURN_IF_ERROR(ParseGetValuesRequestCbor(request, request_proto));
   } else {  // proto
     if (!request_proto.ParseFromString(request)) {
       auto error_message =
@@ -88,106 +260,176 @@ absl::Status GetValuesV2Handler::GetValuesHttp(std::string_view request,
       return absl::InvalidArgumentError(error_message);
     }
   }
+  parse_span.End();
   VLOG(9) << "Converted the http request to proto: "
           << request_proto.DebugString();
-  v2::GetValuesResponse response_proto;
-  PS_RETURN_IF_ERROR(GetValues(request_proto, &response_proto));
-  if (content_type == ContentType::kJson) {
-    return MessageToJsonString(response_proto, &response);
-  }
-  // content_type == proto
-  if (!response_proto.SerializeToString(&response)) {
-    auto error_message = "Cannot serialize the response as a proto.";
-    VLOG(4) << error_message;
-    return absl::InvalidArgumentError(error_message);
-  }
+  PS_RETURN_IF_ERROR(
+      GetValues(request_proto, &response, compression_type, content_type,
+                deadline));
   return absl::OkStatus();
 }
 
 grpc::Status GetValuesV2Handler::BinaryHttpGetValues(
     const v2::BinaryHttpGetValuesRequest& bhttp_request,
-    google::api::HttpBody* response) const {
-  return FromAbslStatus(BinaryHttpGetValues(bhttp_request.raw_body().data(),
-                                            *response->mutable_data()));
+    google::api::HttpBody* response, const RequestDeadline& deadline) const {
+  RequestSpan span = RequestSpan::StartRoot("BinaryHttpGetValues");
+  span.Activate();
+  size_t buffer_bytes = 0;
+  const absl::Status status =
+      BinaryHttpGetValues(bhttp_request.raw_body().data(),
+                          *response->mutable_data(), deadline, buffer_bytes);
+  LogResponseBufferBytes(buffer_bytes);
+  return FromAbslStatus(status);
 }
 
 GetValuesV2Handler::ContentType GetValuesV2Handler::GetContentType(
     const quiche::BinaryHttpRequest& deserialized_req) const {
   for (const auto& header : deserialized_req.GetHeaderFields()) {
-    if (absl::AsciiStrToLower(header.name) == kContentTypeHeader &&
-        absl::AsciiStrToLower(header.value) ==
-            kContentEncodingProtoHeaderValue) {
+    if (absl::AsciiStrToLower(header.name) != kContentTypeHeader) {
+      continue;
+    }
+    const std::string value = absl::AsciiStrToLower(header.value);
+    if (value == kContentEncodingProtoHeaderValue) {
       return ContentType::kProto;
     }
+    if (value == kContentEncodingCborHeaderValue) {
+      return ContentType::kCbor;
+    }
   }
   return ContentType::kJson;
 }
 
-absl::StatusOr<quiche::BinaryHttpResponse>
-GetValuesV2Handler::BuildSuccessfulGetValuesBhttpResponse(
-    std::string_view bhttp_request_body) const {
+absl::StatusOr<std::string>
+GetValuesV2Handler::SerializeSuccessfulGetValuesBhttpResponse(
+    std::string_view bhttp_request_body, const RequestDeadline& deadline,
+    size_t& buffer_bytes) const {
   VLOG(9) << "Handling the binary http layer";
   PS_ASSIGN_OR_RETURN(quiche::BinaryHttpRequest deserialized_req,
                       quiche::BinaryHttpRequest::Create(bhttp_request_body),
                       _ << "Failed to deserialize binary http request");
   VLOG(3) << "BinaryHttpGetValues request: " << deserialized_req.DebugString();
-  std::string response;
   auto content_type = GetContentType(deserialized_req);
-  PS_RETURN_IF_ERROR(
-      GetValuesHttp(deserialized_req.body(), response, content_type));
-  quiche::BinaryHttpResponse bhttp_response(200);
+  const CompressionType compression_type =
+      GetResponseCompressionType(deserialized_req.GetHeaderFields());
+  v2::GetValuesResponse response_proto;
+  PS_RETURN_IF_ERROR(ParseAndGetValues(deserialized_req.body(), content_type,
+                                       compression_type, deadline,
+                                       response_proto));
+  std::vector<quiche::BinaryHttpMessage::Field> header_fields;
+  // Tells the client how the compression groups of the response, if it has
+  // any, are compressed.
+  if (compression_type != CompressionType::kUncompressed) {
+    header_fields.push_back({
+        .name = std::string(kContentEncodingHeader),
+        .value = std::string(EncodingName(compression_type)),
+    });
+  }
+  const absl::Time encode_start = absl::Now();
+  const size_t proto_bytes = response_proto.ByteSizeLong();
   if (content_type == ContentType::kProto) {
-    bhttp_response.AddHeaderField({
+    header_fields.push_back({
         .name = std::string(kContentTypeHeader),
         .value = std::string(kContentEncodingProtoHeaderValue),
     });
+    if (proto_bytes > static_cast<size_t>(std::numeric_limits<int>::max())) {
+      auto error_message = "Cannot serialize the response as a proto.";
+      VLOG(4) << error_message;
+      return absl::InvalidArgumentError(error_message);
+    }
+    // Uses the sizes cached by `ByteSizeLong`.
+    PS_ASSIGN_OR_RETURN(
+        std::string response,
+        SerializeBinaryHttpResponse(
+            200, header_fields, proto_bytes, [&response_proto](char* body) {
+              response_proto.SerializeWithCachedSizesToArray(
+                  reinterpret_cast<uint8_t*>(body));
+              return true;
+            }));
+    LogV2ResponseEncoding(kV2ContentTypeProto, proto_bytes,
+                          absl::Now() - encode_start);
+    buffer_bytes = proto_bytes + response.size();
+    return response;
+  }
+  std::string body;
+  if (content_type == ContentType::kCbor) {
+    header_fields.push_back({
+        .name = std::string(kContentTypeHeader),
+        .value = std::string(kContentEncodingCborHeaderValue),
+    });
+    PS_RETURN_IF_ERROR(GetValuesResponseToCbor(response_proto, body));
+  } else {
+    PS_RETURN_IF_ERROR(use_fast_json_codec_
+                           ? GetValuesResponseToJson(response_proto, body)
+                           : MessageToJsonString(response_proto, &body));
   }
-  bhttp_response.set_body(std::move(response));
-  return bhttp_response;
+  LogV2ResponseEncoding(content_type == ContentType::kCbor ? kV2ContentTypeCbor
+                                                           : kV2ContentTypeJson,
+                        body.size(), absl::Now() - encode_start);
+  PS_ASSIGN_OR_RETURN(std::string response,
+                      SerializeBinaryHttpResponse(
+                          200, header_fields, body.size(), [&body](char* out) {
+                            body.copy(out, body.size());
+                            return true;
+                          }));
+  buffer_bytes = proto_bytes + body.size() + response.size();
+  return response;
 }
 
 absl::Status GetValuesV2Handler::BinaryHttpGetValues(
-    std::string_view bhttp_request_body, std::string& response) const {
-  static quiche::BinaryHttpResponse const* kDefaultBhttpResponse =
-      new quiche::BinaryHttpResponse(500);
-  const quiche::BinaryHttpResponse* bhttp_response = kDefaultBhttpResponse;
-  absl::StatusOr<quiche::BinaryHttpResponse> maybe_successful_bhttp_response =
-      BuildSuccessfulGetValuesBhttpResponse(bhttp_request_body);
+    std::string_view bhttp_request_body, std::string& response,
+    const RequestDeadline& deadline, size_t& buffer_bytes) const {
+  absl::StatusOr<std::string> maybe_successful_bhttp_response =
+      SerializeSuccessfulGetValuesBhttpResponse(bhttp_request_body, deadline,
+                                                buffer_bytes);
   if (maybe_successful_bhttp_response.ok()) {
-    bhttp_response = &(maybe_successful_bhttp_response.value());
+    response = *std::move(maybe_successful_bhttp_response);
+    VLOG(9) << "BinaryHttpGetValues finished successfully";
+    return absl::OkStatus();
   }
-  PS_ASSIGN_OR_RETURN(auto serialized_bhttp_response,
-                      bhttp_response->Serialize());
-
-  response = std::move(serialized_bhttp_response);
-  VLOG(9) << "BinaryHttpGetValues finished successfully";
+  static quiche::BinaryHttpResponse const* kDefaultBhttpResponse =
+      new quiche::BinaryHttpResponse(500);
+  PS_ASSIGN_OR_RETURN(response, kDefaultBhttpResponse->Serialize());
+  buffer_bytes = response.size();
   return absl::OkStatus();
 }
 
 grpc::Status GetValuesV2Handler::ObliviousGetValues(
     const ObliviousGetValuesRequest& oblivious_request,
-    google::api::HttpBody* oblivious_response) const {
+    google::api::HttpBody* oblivious_response,
+    const RequestDeadline& deadline) const {
   VLOG(9) << "Received ObliviousGetValues request. ";
+  RequestSpan span = RequestSpan::StartRoot("ObliviousGetValues");
+  span.Activate();
   OhttpServerEncryptor encryptor(key_fetcher_manager_);
+  RequestSpan decrypt_span = RequestSpan::StartChild("DecryptRequest");
   auto maybe_plain_text =
       encryptor.DecryptRequest(oblivious_request.raw_body().data());
+  decrypt_span.End();
   if (!maybe_plain_text.ok()) {
+    span.SetStatus(maybe_plain_text.status());
     return FromAbslStatus(maybe_plain_text.status());
   }
   // Now process the binary http request
   std::string response;
-  if (const auto s = BinaryHttpGetValues(*maybe_plain_text, response);
+  size_t buffer_bytes = 0;
+  if (const auto s = BinaryHttpGetValues(*maybe_plain_text, response, deadline,
+                                         buffer_bytes);
       !s.ok()) {
     return FromAbslStatus(s);
   }
+  const size_t bhttp_bytes = response.size();
+  RequestSpan encrypt_span = RequestSpan::StartChild("EncryptResponse");
   auto encrypted_response = encryptor.EncryptResponse(std::move(response));
+  encrypt_span.End();
   if (!encrypted_response.ok()) {
     return grpc::Status(grpc::StatusCode::INTERNAL,
                         absl::StrCat(encrypted_response.status().code(), " : ",
                                      encrypted_response.status().message()));
   }
+  LogResponseBufferBytes(
+      std::max(buffer_bytes, bhttp_bytes + encrypted_response->size()));
   oblivious_response->set_content_type(std::string(kOHTTPResponseContentType));
-  oblivious_response->set_data(*encrypted_response);
+  oblivious_response->set_data(*std::move(encrypted_response));
   return grpc::Status::OK;
 }
 
@@ -199,27 +441,221 @@ void GetValuesV2Handler::ProcessOnePartition(
   resp_partition.set_id(req_partition.id());
   UDFExecutionMetadata udf_metadata;
   *udf_metadata.mutable_request_metadata() = req_metadata;
-  const auto maybe_output_string = udf_client_.ExecuteCode(
-      std::move(request_context), std::move(udf_metadata),
-      req_partition.arguments());
-  if (!maybe_output_string.ok()) {
-    resp_partition.mutable_status()->set_code(
-        static_cast<int>(maybe_output_string.status().code()));
-    resp_partition.mutable_status()->set_message(
-        maybe_output_string.status().message());
+  SetPartitionOutput(ExecuteUdf(std::move(request_context),
+                                std::move(udf_metadata), req_partition),
+                     resp_partition);
+}
+
+absl::StatusOr<std::string> GetValuesV2Handler::ExecuteUdf(
+    RequestContext request_context, UDFExecutionMetadata udf_metadata,
+    const v2::RequestPartition& req_partition) const {
+  const std::optional<int64_t> code_object_id =
+      udf_output_cache_ != nullptr && udf_output_cache_->enabled()
+          ? udf_client_.GetCacheableCodeObjectId()
+          : std::nullopt;
+  if (single_flight_ == nullptr && !code_object_id.has_value()) {
+    return udf_client_.ExecuteCode(std::move(request_context),
+                                   std::move(udf_metadata),
+                                   req_partition.arguments());
+  }
+  const std::string input = GetCoalescingKey(udf_metadata, req_partition);
+  uint64_t data_version = 0;
+  if (code_object_id.has_value()) {
+    if (auto output = udf_output_cache_->Lookup(*code_object_id, input);
+        output.has_value()) {
+      return *std::move(output);
+    }
+    // Read before the UDF reads the data.
+    data_version = udf_output_cache_->data_version();
+  }
+  absl::StatusOr<std::string> output;
+  if (single_flight_ == nullptr) {
+    output = udf_client_.ExecuteCode(std::move(request_context),
+                                     std::move(udf_metadata),
+                                     req_partition.arguments());
   } else {
-    VLOG(5) << "UDF output: " << maybe_output_string.value();
-    resp_partition.set_string_output(std::move(maybe_output_string).value());
+    bool collapsed = false;
+    output = *single_flight_->Do(
+        input,
+        [this, &request_context, &udf_metadata, &req_partition] {
+          return udf_client_.ExecuteCode(std::move(request_context),
+                                         std::move(udf_metadata),
+                                         req_partition.arguments());
+        },
+        &collapsed);
+    LogSingleFlightEvent(collapsed ? kSingleFlightUdfCollapsed
+                                   : kSingleFlightUdfExecuted);
+  }
+  // Errors, e.g. timeouts, are not kept.
+  if (code_object_id.has_value() && output.ok()) {
+    udf_output_cache_->Add(*code_object_id, input, data_version, *output);
   }
+  return output;
 }
 
-grpc::Status GetValuesV2Handler::GetValues(
+void GetValuesV2Handler::ProcessPartitionBatch(
+    RequestContext request_context, const v2::GetValuesRequest& request,
+    int begin, int end,
+    std::vector<v2::ResponsePartition>& resp_partitions) const {
+  std::vector<UdfClient::Invocation> invocations(end - begin);
+  for (int i = begin; i < end; ++i) {
+    resp_partitions[i].set_id(request.partitions(i).id());
+    UdfClient::Invocation& invocation = invocations[i - begin];
+    *invocation.execution_metadata.mutable_request_metadata() =
+        request.metadata();
+    invocation.arguments = &request.partitions(i).arguments();
+  }
+  auto outputs = udf_client_.ExecuteCodeBatch(std::move(request_context),
+                                              std::move(invocations));
+  for (int i = begin; i < end; ++i) {
+    SetPartitionOutput(std::move(outputs[i - begin]), resp_partitions[i]);
+  }
+}
+
+int GetValuesV2Handler::GetPartitionsPerUdfExecution(int num_partitions) const {
+  // Coalesced and cached executions are looked up by the input of a single
+  // partition.
+  if (max_partitions_per_udf_execution_ == 1 || single_flight_ != nullptr ||
+      (udf_output_cache_ != nullptr && udf_output_cache_->enabled() &&
+       udf_client_.GetCacheableCodeObjectId().has_value())) {
+    return 1;
+  }
+  // Only as many partitions share an execution as it takes to keep every
+  // worker busy with one execution, which shares out the partitions evenly.
+  const int num_workers = std::min(max_concurrent_partitions_, num_partitions);
+  return std::min((num_partitions + num_workers - 1) / num_workers,
+                  max_partitions_per_udf_execution_);
+}
+
+grpc::Status GetValuesV2Handler::ProcessMultiplePartitions(
+    RequestContext request_context, const v2::GetValuesRequest& request,
+    CompressionGroupConcatenator::CompressionType compression_type,
+    ContentType content_type, v2::GetValuesResponse& response) const {
+  const int num_partitions = request.partitions().size();
+  std::vector<v2::ResponsePartition> resp_partitions(num_partitions);
+  const int batch_size = GetPartitionsPerUdfExecution(num_partitions);
+  const int num_batches = (num_partitions + batch_size - 1) / batch_size;
+  // Each worker processes the next batch of partitions that no worker took
+  // yet, so that at most `max_concurrent_partitions_` UDF executions of the
+  // request run at once. The calling thread is one of the workers.
+  std::atomic<int> next_partition = 0;
+  auto process_partitions = [this, &request_context, &request,
+                             &resp_partitions, &next_partition, num_partitions,
+                             batch_size] {
+    for (int i = next_partition.fetch_add(batch_size); i < num_partitions;
+         i = next_partition.fetch_add(batch_size)) {
+      const int end = std::min(i + batch_size, num_partitions);
+      if (end - i == 1) {
+        ProcessOnePartition(request_context, request.metadata(),
+                            request.partitions(i), resp_partitions[i]);
+      } else {
+        ProcessPartitionBatch(request_context, request, i, end,
+                              resp_partitions);
+      }
+    }
+    return true;
+  };
+  std::vector<TaskFuture<bool>> workers;
+  for (int i = 1; i < std::min(max_concurrent_partitions_, num_batches); ++i) {
+    workers.push_back(SharedThreadPool().Async(process_partitions));
+  }
+  process_partitions();
+  for (auto& worker : workers) {
+    worker.Get();
+  }
+  return BuildCompressionGroups(request, compression_type, content_type,
+                                resp_partitions, response);
+}
+
+absl::Status GetValuesV2Handler::AppendJsonPartitions(
+    absl::Span<const v2::ResponsePartition* const> partitions,
+    std::string& json) const {
+  json.push_back('[');
+  for (size_t i = 0; i < partitions.size(); ++i) {
+    if (i > 0) {
+      json.push_back(',');
+    }
+    std::string json_partition;
+    PS_RETURN_IF_ERROR(
+        use_fast_json_codec_
+            ? ResponsePartitionToJson(*partitions[i], json_partition)
+            : MessageToJsonString(*partitions[i], &json_partition));
+    json.append(json_partition);
+  }
+  json.push_back(']');
+  return absl::OkStatus();
+}
+
+grpc::Status GetValuesV2Handler::BuildCompressionGroups(
     const v2::GetValuesRequest& request,
-    v2::GetValuesResponse* response) const {
+    CompressionGroupConcatenator::CompressionType compression_type,
+    ContentType content_type,
+    const std::vector<v2::ResponsePartition>& resp_partitions,
+    v2::GetValuesResponse& response) const {
+  const int num_partitions = resp_partitions.size();
+  std::vector<std::vector<const v2::ResponsePartition*>> group_partitions;
+  absl::flat_hash_map<int32_t, int> compression_group_indexes;
+  for (int i = 0; i < num_partitions; ++i) {
+    const auto [iter, inserted] = compression_group_indexes.try_emplace(
+        request.partitions(i).compression_group_id(),
+        group_partitions.size());
+    if (inserted) {
+      group_partitions.emplace_back();
+    }
+    group_partitions[iter->second].push_back(&resp_partitions[i]);
+  }
+  std::vector<std::string> compression_groups(group_partitions.size());
+  for (size_t i = 0; i < group_partitions.size(); ++i) {
+    if (const auto status =
+            content_type == ContentType::kCbor
+                ? AppendResponsePartitionsCbor(group_partitions[i],
+                                               compression_groups[i])
+                : AppendJsonPartitions(group_partitions[i],
+                                       compression_groups[i]);
+        !status.ok()) {
+      return FromAbslStatus(status);
+    }
+  }
+  RequestSpan compress_span = RequestSpan::StartChild("CompressResponse");
+  auto compressed_groups = CompressGroups(
+      std::move(compression_groups), compression_type,
+      create_compression_group_concatenator_, max_concurrent_partitions_);
+  compress_span.End();
+  if (!compressed_groups.ok()) {
+    return FromAbslStatus(compressed_groups.status());
+  }
+  auto* compressed_partition_groups =
+      response.mutable_compressed_partition_groups();
+  for (auto& compressed_group : *compressed_groups) {
+    compressed_partition_groups->add_compressed_partition_groups(
+        std::move(compressed_group));
+  }
+  return grpc::Status::OK;
+}
+
+grpc::Status GetValuesV2Handler::GetValues(
+    const v2::GetValuesRequest& request, v2::GetValuesResponse* response,
+    const RequestDeadline& deadline) const {
+  RequestSpan span = RequestSpan::StartRoot("GetValues");
+  span.Activate();
+  return GetValues(request, response,
+                   CompressionGroupConcatenator::CompressionType::kUncompressed,
+                   ContentType::kJson, deadline);
+}
+
+grpc::Status GetValuesV2Handler::GetValues(
+    const v2::GetValuesRequest& request, v2::GetValuesResponse* response,
+    CompressionGroupConcatenator::CompressionType compression_type,
+    ContentType content_type, const RequestDeadline& deadline) const {
   auto scope_metrics_context = std::make_unique<ScopeMetricsContext>();
   RequestContext request_context(*scope_metrics_context);
+  request_context.SetDeadline(deadline);
+  // The UDF executions run on other threads, under the span of the request.
+  request_context.SetTraceContext(RequestSpan::ActiveContext());
+  // UDF executions that timed out may still use copies of the context.
+  absl::Cleanup end_call = [&request_context] { request_context.EndCall(); };
   if (request.partitions().size() == 1) {
-    ProcessOnePartition(std::move(request_context), request.metadata(),
+    ProcessOnePartition(request_context, request.metadata(),
                         request.partitions(0),
                         *response->mutable_single_partition());
     return grpc::Status::OK;
@@ -228,8 +664,94 @@ grpc::Status GetValuesV2Handler::GetValues(
     return grpc::Status(StatusCode::INTERNAL,
                         "At least 1 partition is required");
   }
-  return grpc::Status(StatusCode::UNIMPLEMENTED,
-                      "Multiple partition support is not implemented");
+  return ProcessMultiplePartitions(request_context, request, compression_type,
+                                   content_type, *response);
+}
+
+absl::StatusOr<std::string> GetValuesV2Handler::GetSinglePartitionOutput(
+    const google::protobuf::Struct& metadata,
+    const v2::RequestPartition& partition,
+    const RequestDeadline& deadline) const {
+  RequestSpan span = RequestSpan::StartRoot("GetValues");
+  span.Activate();
+  auto scope_metrics_context = std::make_unique<ScopeMetricsContext>();
+  RequestContext request_context(*scope_metrics_context);
+  request_context.SetDeadline(deadline);
+  request_context.SetTraceContext(RequestSpan::ActiveContext());
+  // UDF executions that timed out may still use copies of the context.
+  absl::Cleanup end_call = [&request_context] { request_context.EndCall(); };
+  UDFExecutionMetadata udf_metadata;
+  *udf_metadata.mutable_request_metadata() = metadata;
+  auto output =
+      ExecuteUdf(request_context, std::move(udf_metadata), partition);
+  if (output.ok()) {
+    VLOG(5) << "UDF output: " << *output;
+  }
+  return output;
+}
+
+void GetValuesV2Handler::GetValuesAsync(
+    const v2::GetValuesRequest& request, v2::GetValuesResponse* response,
+    absl::AnyInvocable<void(grpc::Status)> on_done,
+    const RequestDeadline& deadline) const {
+  const int num_partitions = request.partitions().size();
+  if (num_partitions == 0) {
+    on_done(grpc::Status(StatusCode::INTERNAL,
+                         "At least 1 partition is required"));
+    return;
+  }
+  auto call = std::make_shared<AsyncGetValuesCall>(
+      request, *response, std::move(on_done), deadline);
+  // At most `max_concurrent_partitions_` UDF executions of the request run at
+  // once. Each one that finishes starts the next partition.
+  const int num_started = std::min(max_concurrent_partitions_, num_partitions);
+  call->next_partition = num_started;
+  for (int i = 0; i < num_started; ++i) {
+    ProcessPartitionAsync(call, i);
+  }
+}
+
+void GetValuesV2Handler::ProcessPartitionAsync(
+    std::shared_ptr<AsyncGetValuesCall> call, int index) const {
+  const v2::RequestPartition& req_partition = call->request.partitions(index);
+  call->resp_partitions[index].set_id(req_partition.id());
+  UDFExecutionMetadata udf_metadata;
+  *udf_metadata.mutable_request_metadata() = call->request.metadata();
+  const auto status = udf_client_.ExecuteCodeAsync(
+      call->request_context, std::move(udf_metadata), req_partition.arguments(),
+      [this, call, index](absl::StatusOr<std::string> maybe_output_string) {
+        SetPartitionOutput(std::move(maybe_output_string),
+                           call->resp_partitions[index]);
+        OnPartitionDone(call);
+      });
+  if (!status.ok()) {
+    SetPartitionOutput(status, call->resp_partitions[index]);
+    OnPartitionDone(std::move(call));
+  }
+}
+
+void GetValuesV2Handler::OnPartitionDone(
+    std::shared_ptr<AsyncGetValuesCall> call) const {
+  const int num_partitions = call->resp_partitions.size();
+  if (const int next = call->next_partition++; next < num_partitions) {
+    ProcessPartitionAsync(call, next);
+  }
+  if (--call->pending_partitions > 0) {
+    return;
+  }
+  grpc::Status status = grpc::Status::OK;
+  if (num_partitions == 1) {
+    *call->response.mutable_single_partition() =
+        std::move(call->resp_partitions[0]);
+  } else {
+    status = BuildCompressionGroups(
+        call->request,
+        CompressionGroupConcatenator::CompressionType::kUncompressed,
+        ContentType::kJson, call->resp_partitions, call->response);
+  }
+  call->request_context.EndCall();
+  call->span.End();
+  call->on_done(std::move(status));
 }
 
 }  // namespace kv_server
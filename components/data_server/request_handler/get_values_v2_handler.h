@@ -17,18 +17,24 @@
 #ifndef COMPONENTS_DATA_SERVER_REQUEST_HANDLER_GET_VALUES_V2_HANDLER_H_
 #define COMPONENTS_DATA_SERVER_REQUEST_HANDLER_GET_VALUES_V2_HANDLER_H_
 
+#include <algorithm>
+#include <memory>
 #include <string>
 #include <string_view>
 #include <utility>
 #include <vector>
 
+#include "absl/functional/any_invocable.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/escaping.h"
+#include "absl/types/span.h"
 #include "components/data_server/cache/cache.h"
 #include "components/data_server/request_handler/compression.h"
+#include "components/data_server/request_handler/udf_output_cache.h"
 #include "components/telemetry/server_definition.h"
 #include "components/udf/udf_client.h"
 #include "components/util/request_context.h"
+#include "components/util/single_flight.h"
 #include "grpcpp/grpcpp.h"
 #include "public/query/v2/get_values_v2.grpc.pb.h"
 #include "quiche/binary_http/binary_http_message.h"
@@ -45,33 +51,85 @@ inline constexpr std::string_view kContentEncodingProtoHeaderValue =
 // Json Content Type Header Value.
 inline constexpr std::string_view kContentEncodingJsonHeaderValue =
     "application/json";
+// CBOR Content Type Header Value. The compression groups of CBOR responses
+// are CBOR arrays of partitions, instead of JSON arrays.
+inline constexpr std::string_view kContentEncodingCborHeaderValue =
+    "application/cbor";
 
 // Handles the request family of *GetValues.
 // See the Service proto definition for details.
 class GetValuesV2Handler {
  public:
   // Accepts a functor to create compression blob builder for testing purposes.
+  // The partitions of a request are processed concurrently, up to
+  // `max_concurrent_partitions` at once. With `coalesce_udf_executions`, which
+  // is only correct for a deterministic UDF, concurrent partitions with the
+  // same input share the output of one UDF execution. The outputs of the code
+  // objects that allow it are kept in `udf_output_cache`, if any, which must
+  // outlive the handler. With `use_fast_json_codec`, JSON requests and
+  // responses are converted by the codec of v2_json_codec.h instead of
+  // protobuf's JSON utilities. Partitions beyond `max_concurrent_partitions`
+  // share UDF executions, up to `max_partitions_per_udf_execution` per
+  // execution, unless executions are coalesced or cached.
   explicit GetValuesV2Handler(
       const UdfClient& udf_client,
       privacy_sandbox::server_common::KeyFetcherManagerInterface&
           key_fetcher_manager,
       std::function<CompressionGroupConcatenator::FactoryFunctionType>
           create_compression_group_concatenator =
-              &CompressionGroupConcatenator::Create)
+              &CompressionGroupConcatenator::Create,
+      int max_concurrent_partitions = kDefaultMaxConcurrentPartitions,
+      bool coalesce_udf_executions = false,
+      UdfOutputCache* udf_output_cache = nullptr,
+      bool use_fast_json_codec = false,
+      int max_partitions_per_udf_execution = 1)
       : udf_client_(udf_client),
         create_compression_group_concatenator_(
             std::move(create_compression_group_concatenator)),
-        key_fetcher_manager_(key_fetcher_manager) {}
+        key_fetcher_manager_(key_fetcher_manager),
+        max_concurrent_partitions_(std::max(max_concurrent_partitions, 1)),
+        single_flight_(
+            coalesce_udf_executions
+                ? std::make_unique<SingleFlight<absl::StatusOr<std::string>>>()
+                : nullptr),
+        udf_output_cache_(udf_output_cache),
+        use_fast_json_codec_(use_fast_json_codec),
+        max_partitions_per_udf_execution_(
+            std::max(max_partitions_per_udf_execution, 1)) {}
 
+  static constexpr int kDefaultMaxConcurrentPartitions = 8;
+
+  // The UDF executions and the remote lookups of a request are given no more
+  // time than is left before `deadline`, and the ones not started yet are
+  // skipped once the client cancels the request.
   grpc::Status GetValuesHttp(const v2::GetValuesHttpRequest& request,
-                             google::api::HttpBody* response) const;
+                             google::api::HttpBody* response,
+                             const RequestDeadline& deadline = {}) const;
 
   grpc::Status GetValues(const v2::GetValuesRequest& request,
-                         v2::GetValuesResponse* response) const;
+                         v2::GetValuesResponse* response,
+                         const RequestDeadline& deadline = {}) const;
+
+  // Same as `GetValues`, but does not block on UDF executions. `on_done` is
+  // called once `response` is complete, from the thread of the last UDF
+  // execution to finish. `request` and `response` must outlive the call.
+  void GetValuesAsync(const v2::GetValuesRequest& request,
+                      v2::GetValuesResponse* response,
+                      absl::AnyInvocable<void(grpc::Status)> on_done,
+                      const RequestDeadline& deadline = {}) const;
+
+  // Returns the output of the UDF for `partition`, the single partition of a
+  // request with `metadata`, without building a response, so that callers
+  // can convert the output straight into their own response.
+  absl::StatusOr<std::string> GetSinglePartitionOutput(
+      const google::protobuf::Struct& metadata,
+      const v2::RequestPartition& partition,
+      const RequestDeadline& deadline = {}) const;
 
   grpc::Status BinaryHttpGetValues(
       const v2::BinaryHttpGetValuesRequest& request,
-      google::api::HttpBody* response) const;
+      google::api::HttpBody* response,
+      const RequestDeadline& deadline = {}) const;
 
   // Supports requests encrypted with a fixed key for debugging/demoing.
   // X25519 Secret key (priv key).
@@ -87,33 +145,55 @@ class GetValuesV2Handler {
   // AEAD: AES-128-GCM 0X0001
   // (https://github.com/WICG/turtledove/blob/main/FLEDGE_Key_Value_Server_API.md#encryption)
   grpc::Status ObliviousGetValues(const v2::ObliviousGetValuesRequest& request,
-                                  google::api::HttpBody* response) const;
+                                  google::api::HttpBody* response,
+                                  const RequestDeadline& deadline = {}) const;
 
  private:
   enum class ContentType {
     kJson = 0,
     kProto,
+    kCbor,
   };
   ContentType GetContentType(
       const quiche::BinaryHttpRequest& deserialized_req) const;
 
-  absl::Status GetValuesHttp(
-      std::string_view request, std::string& json_response,
-      ContentType content_type = ContentType::kJson) const;
+  absl::Status GetValuesHttp(std::string_view request,
+                             std::string& json_response,
+                             const RequestDeadline& deadline) const;
+
+  // Parses `request`, serialized in `content_type`, and sets `response` to
+  // the response to it.
+  absl::Status ParseAndGetValues(
+      std::string_view request, ContentType content_type,
+      CompressionGroupConcatenator::CompressionType compression_type,
+      const RequestDeadline& deadline, v2::GetValuesResponse& response) const;
 
-  // On success, returns a BinaryHttpResponse with a successful response. The
-  // reason that this is a separate function is so that the error status
-  // returned from here can be encoded as a BinaryHTTP response code. So even if
-  // this function fails, the final grpc code may still be ok.
-  absl::StatusOr<quiche::BinaryHttpResponse>
-  BuildSuccessfulGetValuesBhttpResponse(
-      std::string_view bhttp_request_body) const;
+  // A request with more than one partition gets a response of compression
+  // groups, each compressed with `compression_type`, and encoded in CBOR for
+  // a `content_type` of CBOR, in JSON otherwise.
+  grpc::Status GetValues(
+      const v2::GetValuesRequest& request, v2::GetValuesResponse* response,
+      CompressionGroupConcatenator::CompressionType compression_type,
+      ContentType content_type, const RequestDeadline& deadline) const;
+
+  // On success, returns a serialized BinaryHttpResponse with a successful
+  // response. The reason that this is a separate function is so that the
+  // error status returned from here can be encoded as a BinaryHTTP response
+  // code. So even if this function fails, the final grpc code may still be ok.
+  // The response proto is serialized right into the Binary HTTP response.
+  // Sets `buffer_bytes` to the bytes of the buffers that held the response at
+  // the same time.
+  absl::StatusOr<std::string> SerializeSuccessfulGetValuesBhttpResponse(
+      std::string_view bhttp_request_body, const RequestDeadline& deadline,
+      size_t& buffer_bytes) const;
 
   // Returns error only if the response cannot be serialized into Binary HTTP
   // response. For all other failures, the error status will be inside the
   // Binary HTTP message.
   absl::Status BinaryHttpGetValues(std::string_view bhttp_request_body,
-                                   std::string& response) const;
+                                   std::string& response,
+                                   const RequestDeadline& deadline,
+                                   size_t& buffer_bytes) const;
 
   // Invokes UDF to process one partition.
   void ProcessOnePartition(RequestContext request_context,
@@ -121,11 +201,70 @@ class GetValuesV2Handler {
                            const v2::RequestPartition& req_partition,
                            v2::ResponsePartition& resp_partition) const;
 
+  // Returns the output of the UDF for `req_partition`, from
+  // `udf_output_cache_` or from the execution of a concurrent partition with
+  // the same input if possible.
+  absl::StatusOr<std::string> ExecuteUdf(
+      RequestContext request_context, UDFExecutionMetadata udf_metadata,
+      const v2::RequestPartition& req_partition) const;
+
+  // Invokes UDF once for partitions [`begin`, `end`) of `request`, see
+  // `UdfClient::ExecuteCodeBatch`.
+  void ProcessPartitionBatch(
+      RequestContext request_context, const v2::GetValuesRequest& request,
+      int begin, int end,
+      std::vector<v2::ResponsePartition>& resp_partitions) const;
+
+  // Returns how many of the `num_partitions` partitions of a request each UDF
+  // execution processes.
+  int GetPartitionsPerUdfExecution(int num_partitions) const;
+
+  // Invokes UDF to process the partitions of `request`, concurrently, and
+  // sets `response` to their outputs grouped by compression group, in the
+  // order of the first partition of each group.
+  grpc::Status ProcessMultiplePartitions(
+      RequestContext request_context, const v2::GetValuesRequest& request,
+      CompressionGroupConcatenator::CompressionType compression_type,
+      ContentType content_type, v2::GetValuesResponse& response) const;
+
+  // Appends the JSON array of `partitions`, the content of a compression
+  // group, to `json`.
+  absl::Status AppendJsonPartitions(
+      absl::Span<const v2::ResponsePartition* const> partitions,
+      std::string& json) const;
+
+  // Sets `response` to the outputs of the partitions of `request` grouped by
+  // compression group, in the order of the first partition of each group. The
+  // groups are compressed concurrently, up to `max_concurrent_partitions_` at
+  // once. The partitions of a group are written straight into its CBOR array
+  // for a `content_type` of CBOR.
+  grpc::Status BuildCompressionGroups(
+      const v2::GetValuesRequest& request,
+      CompressionGroupConcatenator::CompressionType compression_type,
+      ContentType content_type,
+      const std::vector<v2::ResponsePartition>& resp_partitions,
+      v2::GetValuesResponse& response) const;
+
+  // State of one `GetValuesAsync` call, shared by its UDF executions.
+  struct AsyncGetValuesCall;
+
+  // Invokes UDF to process partition `index` of `call` without waiting for
+  // it, then starts the next partition that is not started yet.
+  void ProcessPartitionAsync(std::shared_ptr<AsyncGetValuesCall> call,
+                             int index) const;
+  void OnPartitionDone(std::shared_ptr<AsyncGetValuesCall> call) const;
+
   const UdfClient& udf_client_;
   std::function<CompressionGroupConcatenator::FactoryFunctionType>
       create_compression_group_concatenator_;
   privacy_sandbox::server_common::KeyFetcherManagerInterface&
       key_fetcher_manager_;
+  const int max_concurrent_partitions_;
+  // Null unless UDF executions are coalesced.
+  std::unique_ptr<SingleFlight<absl::StatusOr<std::string>>> single_flight_;
+  UdfOutputCache* const udf_output_cache_;
+  const bool use_fast_json_codec_;
+  const int max_partitions_per_udf_execution_;
 };
 
 }  // namespace kv_server
@@ -14,17 +14,23 @@
 
 #include "components/data_server/request_handler/get_values_v2_handler.h"
 
+#include <cstdint>
 #include <memory>
+#include <optional>
 #include <string>
+#include <tuple>
 #include <utility>
 #include <vector>
 
 #include "absl/log/log.h"
 #include "components/data_server/cache/cache.h"
+#include "components/data_server/cache/data_version.h"
 #include "components/data_server/cache/mocks.h"
+#include "components/data_server/request_handler/udf_output_cache.h"
 #include "components/udf/mocks.h"
 #include "gmock/gmock.h"
 #include "google/protobuf/text_format.h"
+#include "google/protobuf/util/json_util.h"
 #include "grpcpp/grpcpp.h"
 #include "gtest/gtest.h"
 #include "nlohmann/json.hpp"
@@ -546,6 +552,42 @@ TEST_F(GetValuesHandlerTest, PureGRPCTest) {
   EXPECT_THAT(resp, EqualsProto(res));
 }
 
+TEST_F(GetValuesHandlerTest, CacheableUdfOutputIsReused) {
+  v2::GetValuesRequest req;
+  TextFormat::ParseFromString(
+      R"pb(partitions {
+             id: 9
+             arguments { data { string_value: "ECHO" } }
+           })pb",
+      &req);
+  DataVersion data_version;
+  UdfOutputCache udf_output_cache({.max_entries = 10}, data_version);
+  GetValuesV2Handler handler(
+      mock_udf_client_, fake_key_fetcher_manager_,
+      &CompressionGroupConcatenator::Create,
+      GetValuesV2Handler::kDefaultMaxConcurrentPartitions,
+      /*coalesce_udf_executions=*/false, &udf_output_cache);
+  EXPECT_CALL(mock_udf_client_, GetCacheableCodeObjectId())
+      .WillRepeatedly(Return(1));
+  EXPECT_CALL(mock_udf_client_, ExecuteCode(_, _, _))
+      .Times(2)
+      .WillRepeatedly(Return("ECHO"));
+  v2::GetValuesResponse res;
+  TextFormat::ParseFromString(
+      R"pb(single_partition { id: 9 string_output: "ECHO" })pb", &res);
+  for (int i = 0; i < 3; ++i) {
+    v2::GetValuesResponse resp;
+    ASSERT_TRUE(handler.GetValues(req, &resp).ok());
+    EXPECT_THAT(resp, EqualsProto(res));
+  }
+  // The data changes, so the UDF runs again.
+  data_version.Advance();
+  v2::GetValuesResponse resp;
+  ASSERT_TRUE(handler.GetValues(req, &resp).ok());
+  EXPECT_THAT(resp, EqualsProto(res));
+  EXPECT_EQ(udf_output_cache.num_hits(), 2);
+}
+
 TEST_F(GetValuesHandlerTest, PureGRPCTestFailure) {
   v2::GetValuesRequest req;
   TextFormat::ParseFromString(
@@ -575,5 +617,330 @@ TEST_F(GetValuesHandlerTest, PureGRPCTestFailure) {
   EXPECT_THAT(resp, EqualsProto(res));
 }
 
+TEST_F(GetValuesHandlerTest, PureGRPCTestAsync) {
+  v2::GetValuesRequest req;
+  TextFormat::ParseFromString(
+      R"pb(partitions {
+             id: 9
+             arguments { data { string_value: "ECHO" } }
+           })pb",
+      &req);
+  GetValuesV2Handler handler(mock_udf_client_, fake_key_fetcher_manager_);
+  EXPECT_CALL(mock_udf_client_,
+              ExecuteCodeAsync(_, _,
+                               testing::ElementsAre(EqualsProto(
+                                   req.partitions(0).arguments(0))),
+                               _))
+      .WillOnce([](auto&&, auto&&, auto&&, auto&& on_done) {
+        on_done("ECHO");
+        return absl::OkStatus();
+      });
+  v2::GetValuesResponse resp;
+  std::optional<grpc::Status> result;
+  handler.GetValuesAsync(req, &resp,
+                         [&result](grpc::Status status) { result = status; });
+  ASSERT_TRUE(result.has_value());
+  ASSERT_TRUE(result->ok()) << "code: " << result->error_code()
+                            << ", msg: " << result->error_message();
+
+  v2::GetValuesResponse res;
+  TextFormat::ParseFromString(
+      R"pb(single_partition { id: 9 string_output: "ECHO" })pb", &res);
+  EXPECT_THAT(resp, EqualsProto(res));
+}
+
+TEST_F(GetValuesHandlerTest, PureGRPCTestAsyncMultiplePartitions) {
+  v2::GetValuesRequest req;
+  TextFormat::ParseFromString(
+      R"pb(partitions {
+             id: 1
+             compression_group_id: 1
+             arguments { data { string_value: "A" } }
+           }
+           partitions {
+             id: 2
+             compression_group_id: 2
+             arguments { data { string_value: "B" } }
+           }
+           partitions {
+             id: 3
+             compression_group_id: 1
+             arguments { data { string_value: "C" } }
+           })pb",
+      &req);
+  GetValuesV2Handler handler(mock_udf_client_, fake_key_fetcher_manager_,
+                             &CompressionGroupConcatenator::Create,
+                             /*max_concurrent_partitions=*/2);
+  // The UDFs finish once all are started, in reverse order, except that
+  // partition 2 fails to start.
+  std::vector<UdfClient::ExecuteCodeCallback> pending;
+  for (const auto& partition : req.partitions()) {
+    auto& expectation = EXPECT_CALL(
+        mock_udf_client_,
+        ExecuteCodeAsync(
+            _, _, testing::ElementsAre(EqualsProto(partition.arguments(0))),
+            _));
+    if (partition.id() == 2) {
+      expectation.WillOnce(Return(absl::UnavailableError("Queue is full")));
+      continue;
+    }
+    expectation.WillOnce([&pending](auto&&, auto&&, auto&&, auto&& on_done) {
+      pending.push_back(std::move(on_done));
+      return absl::OkStatus();
+    });
+  }
+  v2::GetValuesResponse resp;
+  std::optional<grpc::Status> result;
+  handler.GetValuesAsync(req, &resp,
+                         [&result](grpc::Status status) { result = status; });
+  ASSERT_EQ(pending.size(), 2);
+  EXPECT_FALSE(result.has_value());
+  pending[1]("C");
+  EXPECT_FALSE(result.has_value());
+  pending[0]("A");
+  ASSERT_TRUE(result.has_value());
+  ASSERT_TRUE(result->ok()) << "code: " << result->error_code()
+                            << ", msg: " << result->error_message();
+
+  ASSERT_EQ(resp.compressed_partition_groups().compressed_partition_groups()
+                .size(),
+            2);
+  std::vector<nlohmann::json> compression_groups;
+  for (const auto& compressed_group :
+       resp.compressed_partition_groups().compressed_partition_groups()) {
+    auto blob_reader = CompressedBlobReader::Create(
+        CompressionGroupConcatenator::CompressionType::kUncompressed,
+        compressed_group);
+    auto compression_group = blob_reader->ExtractOneCompressionGroup();
+    ASSERT_TRUE(compression_group.ok()) << compression_group.status();
+    compression_groups.push_back(nlohmann::json::parse(*compression_group));
+  }
+  EXPECT_EQ(compression_groups[0], nlohmann::json::parse(R"(
+      [{"id": 1, "stringOutput": "A"}, {"id": 3, "stringOutput": "C"}])"));
+  EXPECT_EQ(compression_groups[1], nlohmann::json::parse(R"(
+      [{"id": 2, "status": {"code": 14, "message": "Queue is full"}}])"));
+}
+
+TEST_F(GetValuesHandlerTest, PureGRPCTestMultiplePartitions) {
+  v2::GetValuesRequest req;
+  TextFormat::ParseFromString(
+      R"pb(partitions {
+             id: 1
+             compression_group_id: 1
+             arguments { data { string_value: "A" } }
+           }
+           partitions {
+             id: 2
+             compression_group_id: 2
+             arguments { data { string_value: "B" } }
+           }
+           partitions {
+             id: 3
+             compression_group_id: 1
+             arguments { data { string_value: "C" } }
+           })pb",
+      &req);
+  GetValuesV2Handler handler(mock_udf_client_, fake_key_fetcher_manager_,
+                             &CompressionGroupConcatenator::Create,
+                             /*max_concurrent_partitions=*/2);
+  for (const auto& partition : req.partitions()) {
+    EXPECT_CALL(mock_udf_client_,
+                ExecuteCode(_, _,
+                            testing::ElementsAre(
+                                EqualsProto(partition.arguments(0)))))
+        .WillOnce(Return(partition.arguments(0).data().string_value()));
+  }
+  v2::GetValuesResponse resp;
+  const auto result = handler.GetValues(req, &resp);
+  ASSERT_TRUE(result.ok()) << "code: " << result.error_code()
+                           << ", msg: " << result.error_message();
+
+  ASSERT_EQ(resp.compressed_partition_groups().compressed_partition_groups()
+                .size(),
+            2);
+  std::vector<nlohmann::json> compression_groups;
+  for (const auto& compressed_group :
+       resp.compressed_partition_groups().compressed_partition_groups()) {
+    auto blob_reader = CompressedBlobReader::Create(
+        CompressionGroupConcatenator::CompressionType::kUncompressed,
+        compressed_group);
+    auto compression_group = blob_reader->ExtractOneCompressionGroup();
+    ASSERT_TRUE(compression_group.ok()) << compression_group.status();
+    compression_groups.push_back(nlohmann::json::parse(*compression_group));
+  }
+  EXPECT_EQ(compression_groups[0], nlohmann::json::parse(R"(
+      [{"id": 1, "stringOutput": "A"}, {"id": 3, "stringOutput": "C"}])"));
+  EXPECT_EQ(compression_groups[1],
+            nlohmann::json::parse(R"([{"id": 2, "stringOutput": "B"}])"));
+}
+
+TEST_F(GetValuesHandlerTest, PartitionsShareUdfExecution) {
+  v2::GetValuesRequest req;
+  TextFormat::ParseFromString(
+      R"pb(partitions {
+             id: 1
+             compression_group_id: 1
+             arguments { data { string_value: "A" } }
+           }
+           partitions {
+             id: 2
+             compression_group_id: 1
+             arguments { data { string_value: "B" } }
+           }
+           partitions {
+             id: 3
+             compression_group_id: 1
+             arguments { data { string_value: "C" } }
+           })pb",
+      &req);
+  GetValuesV2Handler handler(mock_udf_client_, fake_key_fetcher_manager_,
+                             &CompressionGroupConcatenator::Create,
+                             /*max_concurrent_partitions=*/1,
+                             /*coalesce_udf_executions=*/false,
+                             /*udf_output_cache=*/nullptr,
+                             /*use_fast_json_codec=*/false,
+                             /*max_partitions_per_udf_execution=*/4);
+  EXPECT_CALL(mock_udf_client_, ExecuteCode(_, _, _)).Times(0);
+  EXPECT_CALL(mock_udf_client_, ExecuteCodeBatch(_, testing::SizeIs(3)))
+      .WillOnce([](RequestContext,
+                   std::vector<UdfClient::Invocation> invocations) {
+        std::vector<absl::StatusOr<std::string>> outputs;
+        for (const auto& invocation : invocations) {
+          outputs.push_back(
+              invocation.arguments->Get(0).data().string_value());
+        }
+        return outputs;
+      });
+  v2::GetValuesResponse resp;
+  const auto result = handler.GetValues(req, &resp);
+  ASSERT_TRUE(result.ok()) << "code: " << result.error_code()
+                           << ", msg: " << result.error_message();
+
+  ASSERT_EQ(resp.compressed_partition_groups().compressed_partition_groups()
+                .size(),
+            1);
+  auto blob_reader = CompressedBlobReader::Create(
+      CompressionGroupConcatenator::CompressionType::kUncompressed,
+      resp.compressed_partition_groups().compressed_partition_groups(0));
+  auto compression_group = blob_reader->ExtractOneCompressionGroup();
+  ASSERT_TRUE(compression_group.ok()) << compression_group.status();
+  EXPECT_EQ(nlohmann::json::parse(*compression_group), nlohmann::json::parse(R"(
+      [{"id": 1, "stringOutput": "A"}, {"id": 2, "stringOutput": "B"},
+       {"id": 3, "stringOutput": "C"}])"));
+}
+
+TEST_F(GetValuesHandlerTest, BinaryHttpNegotiatesResponseCompression) {
+  constexpr std::string_view kRequest = R"({
+    "partitions": [
+      {"id": 1, "compressionGroupId": 1,
+       "arguments": [{"data": "A"}]},
+      {"id": 2, "compressionGroupId": 1,
+       "arguments": [{"data": "B"}]}
+    ]
+  })";
+  EXPECT_CALL(mock_udf_client_, ExecuteCode(_, _, _))
+      .WillRepeatedly(Return("output"));
+  GetValuesV2Handler handler(mock_udf_client_, fake_key_fetcher_manager_);
+  for (const auto& [accept_encoding, content_encoding, compression_type] :
+       std::vector<std::tuple<std::string, std::string,
+                              CompressionGroupConcatenator::CompressionType>>{
+           {"gzip", "gzip",
+            CompressionGroupConcatenator::CompressionType::kGzip},
+           {"gzip;q=0.5, br;q=0.9, zstd;q=0.9", "zstd",
+            CompressionGroupConcatenator::CompressionType::kZstd},
+           {"zstd;q=0, *;q=0.1, br;q=0.2", "br",
+            CompressionGroupConcatenator::CompressionType::kBrotli},
+           {"deflate", "",
+            CompressionGroupConcatenator::CompressionType::kUncompressed},
+       }) {
+    quiche::BinaryHttpRequest bhttp_request({});
+    bhttp_request.AddHeaderField(
+        {.name = "Accept-Encoding", .value = accept_encoding});
+    bhttp_request.set_body(std::string(kRequest));
+    BinaryHttpGetValuesRequest request;
+    request.mutable_raw_body()->set_data(*bhttp_request.Serialize());
+    google::api::HttpBody response;
+    ASSERT_TRUE(handler.BinaryHttpGetValues(request, &response).ok());
+
+    const auto bhttp_response =
+        quiche::BinaryHttpResponse::Create(response.data());
+    ASSERT_TRUE(bhttp_response.ok()) << bhttp_response.status();
+    std::string response_content_encoding;
+    for (const auto& header : bhttp_response->GetHeaderFields()) {
+      if (absl::AsciiStrToLower(header.name) == "content-encoding") {
+        response_content_encoding = header.value;
+      }
+    }
+    EXPECT_EQ(response_content_encoding, content_encoding) << accept_encoding;
+    v2::GetValuesResponse response_proto;
+    ASSERT_TRUE(google::protobuf::util::JsonStringToMessage(
+                    bhttp_response->body(), &response_proto)
+                    .ok());
+    ASSERT_EQ(response_proto.compressed_partition_groups()
+                  .compressed_partition_groups()
+                  .size(),
+              1);
+    auto blob_reader = CompressedBlobReader::Create(
+        compression_type, response_proto.compressed_partition_groups()
+                              .compressed_partition_groups(0));
+    auto compression_group = blob_reader->ExtractOneCompressionGroup();
+    ASSERT_TRUE(compression_group.ok()) << compression_group.status();
+    EXPECT_EQ(nlohmann::json::parse(*compression_group),
+              nlohmann::json::parse(R"(
+      [{"id": 1, "stringOutput": "output"},
+       {"id": 2, "stringOutput": "output"}])"));
+  }
+}
+
+TEST_F(GetValuesHandlerTest, BinaryHttpCborRequestGetsCborResponse) {
+  const std::vector<uint8_t> request_cbor = nlohmann::json::to_cbor(
+      nlohmann::json::parse(R"({
+    "partitions": [
+      {"id": 1, "compressionGroupId": 1, "arguments": [{"data": "A"}]},
+      {"id": 2, "compressionGroupId": 1, "arguments": [{"data": "B"}]}
+    ]
+  })"));
+  EXPECT_CALL(mock_udf_client_, ExecuteCode(_, _, _))
+      .WillRepeatedly(Return("output"));
+  GetValuesV2Handler handler(mock_udf_client_, fake_key_fetcher_manager_);
+  quiche::BinaryHttpRequest bhttp_request({});
+  bhttp_request.AddHeaderField(
+      {.name = std::string(kContentTypeHeader),
+       .value = std::string(kContentEncodingCborHeaderValue)});
+  bhttp_request.set_body(
+      std::string(request_cbor.begin(), request_cbor.end()));
+  BinaryHttpGetValuesRequest request;
+  request.mutable_raw_body()->set_data(*bhttp_request.Serialize());
+  google::api::HttpBody response;
+  ASSERT_TRUE(handler.BinaryHttpGetValues(request, &response).ok());
+
+  const auto bhttp_response =
+      quiche::BinaryHttpResponse::Create(response.data());
+  ASSERT_TRUE(bhttp_response.ok()) << bhttp_response.status();
+  ASSERT_EQ(bhttp_response->status_code(), 200);
+  std::string response_content_type;
+  for (const auto& header : bhttp_response->GetHeaderFields()) {
+    if (absl::AsciiStrToLower(header.name) == kContentTypeHeader) {
+      response_content_type = header.value;
+    }
+  }
+  EXPECT_EQ(response_content_type, kContentEncodingCborHeaderValue);
+  const nlohmann::json response_cbor =
+      nlohmann::json::from_cbor(bhttp_response->body());
+  const auto& groups = response_cbor["compressedPartitionGroups"]
+                                    ["compressedPartitionGroups"];
+  ASSERT_EQ(groups.size(), 1);
+  const std::string group(groups[0].get_binary().begin(),
+                          groups[0].get_binary().end());
+  auto blob_reader = CompressedBlobReader::Create(
+      CompressionGroupConcatenator::CompressionType::kUncompressed, group);
+  auto compression_group = blob_reader->ExtractOneCompressionGroup();
+  ASSERT_TRUE(compression_group.ok()) << compression_group.status();
+  EXPECT_EQ(nlohmann::json::from_cbor(*compression_group),
+            nlohmann::json::parse(R"(
+      [{"id": 1, "stringOutput": "output"},
+       {"id": 2, "stringOutput": "output"}])"));
+}
+
 }  // namespace
 }  // namespace kv_server
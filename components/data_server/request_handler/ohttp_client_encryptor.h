@@ -15,6 +15,8 @@
 #ifndef COMPONENTS_DATA_SERVER_REQUEST_HANDLER_OHTTP_CLIENT_ENCRYPTOR_H_
 #define COMPONENTS_DATA_SERVER_REQUEST_HANDLER_OHTTP_CLIENT_ENCRYPTOR_H_
 
+#include <memory>
+#include <optional>
 #include <string>
 #include <string_view>
 
@@ -49,7 +51,8 @@ class OhttpClientEncryptor {
  private:
   ::privacy_sandbox::server_common::CloudPlatform cloud_platform_ =
       ::privacy_sandbox::server_common::CloudPlatform::kLocal;
-  std::optional<quiche::ObliviousHttpClient> http_client_;
+  // Shared with the other requests encrypted with the same key.
+  std::shared_ptr<const quiche::ObliviousHttpClient> http_client_;
   std::optional<quiche::ObliviousHttpRequest::Context> http_request_context_;
   privacy_sandbox::server_common::KeyFetcherManagerInterface&
       key_fetcher_manager_;
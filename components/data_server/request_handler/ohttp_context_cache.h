@@ -0,0 +1,91 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_REQUEST_HANDLER_OHTTP_CONTEXT_CACHE_H_
+#define COMPONENTS_DATA_SERVER_REQUEST_HANDLER_OHTTP_CONTEXT_CACHE_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/functional/function_ref.h"
+#include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
+#include "quiche/oblivious_http/oblivious_http_client.h"
+#include "quiche/oblivious_http/oblivious_http_gateway.h"
+
+namespace kv_server {
+
+// Caches the OHTTP gateways or clients built from the keys of the key
+// fetcher, by key id, so that requests don't each parse their key and set up
+// its HPKE context. An entry is only reused while its key id comes with the
+// same key, so that rotated keys get new entries. Key ids are one byte, which
+// bounds the cache to 256 entries.
+//
+// The cached objects are only used through their const methods, which don't
+// change them.
+//
+// Thread safe.
+template <typename T>
+class OhttpContextCache {
+ public:
+  // Returns the entry of `key_id` if it was built from `key`, or else builds
+  // it with `create`, outside of the lock, and caches it.
+  absl::StatusOr<std::shared_ptr<const T>> Get(
+      uint8_t key_id, std::string_view key,
+      absl::FunctionRef<absl::StatusOr<T>()> create)
+      ABSL_LOCKS_EXCLUDED(mutex_) {
+    {
+      absl::ReaderMutexLock lock(&mutex_);
+      if (const auto it = entries_.find(key_id);
+          it != entries_.end() && it->second.key == key) {
+        return it->second.value;
+      }
+    }
+    absl::StatusOr<T> value = create();
+    if (!value.ok()) {
+      return value.status();
+    }
+    auto shared_value = std::make_shared<const T>(*std::move(value));
+    absl::MutexLock lock(&mutex_);
+    entries_.insert_or_assign(key_id, Entry{std::string(key), shared_value});
+    return shared_value;
+  }
+
+ private:
+  struct Entry {
+    std::string key;
+    std::shared_ptr<const T> value;
+  };
+
+  absl::Mutex mutex_;
+  absl::flat_hash_map<uint8_t, Entry> entries_ ABSL_GUARDED_BY(mutex_);
+};
+
+using OhttpGatewayCache = OhttpContextCache<quiche::ObliviousHttpGateway>;
+using OhttpClientCache = OhttpContextCache<quiche::ObliviousHttpClient>;
+
+// The caches shared by all the encryptors of the process.
+OhttpGatewayCache& SharedOhttpGatewayCache();
+OhttpClientCache& SharedOhttpClientCache();
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_REQUEST_HANDLER_OHTTP_CONTEXT_CACHE_H_
@@ -0,0 +1,78 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data_server/request_handler/ohttp_context_cache.h"
+
+#include <string>
+
+#include "absl/status/status.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+TEST(OhttpContextCacheTest, ReusesEntryOfSameKey) {
+  OhttpContextCache<std::string> cache;
+  int num_creates = 0;
+  auto create = [&num_creates]() -> absl::StatusOr<std::string> {
+    return std::to_string(++num_creates);
+  };
+  const auto first = cache.Get(/*key_id=*/1, "key", create);
+  ASSERT_TRUE(first.ok()) << first.status();
+  EXPECT_EQ(**first, "1");
+  const auto second = cache.Get(/*key_id=*/1, "key", create);
+  ASSERT_TRUE(second.ok()) << second.status();
+  EXPECT_EQ(*second, *first);
+  EXPECT_EQ(num_creates, 1);
+}
+
+TEST(OhttpContextCacheTest, RebuildsEntryOfRotatedKey) {
+  OhttpContextCache<std::string> cache;
+  int num_creates = 0;
+  auto create = [&num_creates]() -> absl::StatusOr<std::string> {
+    return std::to_string(++num_creates);
+  };
+  ASSERT_TRUE(cache.Get(/*key_id=*/1, "key", create).ok());
+  const auto rotated = cache.Get(/*key_id=*/1, "rotated key", create);
+  ASSERT_TRUE(rotated.ok()) << rotated.status();
+  EXPECT_EQ(**rotated, "2");
+  const auto other_id = cache.Get(/*key_id=*/2, "rotated key", create);
+  ASSERT_TRUE(other_id.ok()) << other_id.status();
+  EXPECT_EQ(**other_id, "3");
+  // Both entries stay cached.
+  EXPECT_EQ(**cache.Get(/*key_id=*/1, "rotated key", create), "2");
+  EXPECT_EQ(**cache.Get(/*key_id=*/2, "rotated key", create), "3");
+  EXPECT_EQ(num_creates, 3);
+}
+
+TEST(OhttpContextCacheTest, DoesNotCacheErrors) {
+  OhttpContextCache<std::string> cache;
+  EXPECT_FALSE(cache
+                   .Get(/*key_id=*/1, "key",
+                        []() -> absl::StatusOr<std::string> {
+                          return absl::InvalidArgumentError("bad key");
+                        })
+                   .ok());
+  const auto entry = cache.Get(/*key_id=*/1, "key",
+                               []() -> absl::StatusOr<std::string> {
+                                 return "built";
+                               });
+  ASSERT_TRUE(entry.ok()) << entry.status();
+  EXPECT_EQ(**entry, "built");
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -46,6 +46,45 @@ TEST(OhttpEncryptorTest, FullCircleSuccess) {
   EXPECT_EQ(kTestResponse, *response_decrypted_status);
 }
 
+TEST(OhttpEncryptorTest, RequestsShareEncryptionContexts) {
+  privacy_sandbox::server_common::FakeKeyFetcherManager
+      fake_key_fetcher_manager;
+  for (const std::string request : {"first request", "second request"}) {
+    OhttpClientEncryptor client_encryptor(fake_key_fetcher_manager);
+    OhttpServerEncryptor server_encryptor(fake_key_fetcher_manager);
+    auto request_encrypted_status = client_encryptor.EncryptRequest(request);
+    ASSERT_TRUE(request_encrypted_status.ok());
+    auto request_decrypted_status =
+        server_encryptor.DecryptRequest(*request_encrypted_status);
+    ASSERT_TRUE(request_decrypted_status.ok());
+    EXPECT_EQ(request, *request_decrypted_status);
+    auto response_encrypted_status = server_encryptor.EncryptResponse(request);
+    ASSERT_TRUE(response_encrypted_status.ok());
+    auto response_decrypted_status =
+        client_encryptor.DecryptResponse(*response_encrypted_status);
+    ASSERT_TRUE(response_decrypted_status.ok());
+    EXPECT_EQ(request, *response_decrypted_status);
+  }
+}
+
+TEST(OhttpEncryptorTest, ResponseChunksAreEncryptedSeparately) {
+  privacy_sandbox::server_common::FakeKeyFetcherManager
+      fake_key_fetcher_manager;
+  OhttpClientEncryptor client_encryptor(fake_key_fetcher_manager);
+  OhttpServerEncryptor server_encryptor(fake_key_fetcher_manager);
+  auto request_encrypted_status = client_encryptor.EncryptRequest("request");
+  ASSERT_TRUE(request_encrypted_status.ok());
+  ASSERT_TRUE(server_encryptor.DecryptRequest(*request_encrypted_status).ok());
+  for (const std::string chunk : {"first chunk", "second chunk"}) {
+    auto response_encrypted_status = server_encryptor.EncryptResponse(chunk);
+    ASSERT_TRUE(response_encrypted_status.ok());
+    auto response_decrypted_status =
+        client_encryptor.DecryptResponse(*response_encrypted_status);
+    ASSERT_TRUE(response_decrypted_status.ok());
+    EXPECT_EQ(chunk, *response_decrypted_status);
+  }
+}
+
 TEST(OhttpEncryptorTest, ServerDecryptRequestFails) {
   privacy_sandbox::server_common::FakeKeyFetcherManager
       fake_key_fetcher_manager;
@@ -17,6 +17,7 @@
 #include <utility>
 
 #include "absl/log/log.h"
+#include "components/data_server/request_handler/ohttp_context_cache.h"
 #include "quiche/oblivious_http/common/oblivious_http_header_key_config.h"
 
 namespace kv_server {
@@ -29,12 +30,6 @@ absl::StatusOr<absl::string_view> OhttpServerEncryptor::DecryptRequest(
     return absl::InternalError(absl::StrCat(
         "Unable to get OHTTP key id: ", maybe_req_key_id.status().message()));
   }
-  const auto maybe_config = quiche::ObliviousHttpHeaderKeyConfig::Create(
-      *maybe_req_key_id, kKEMParameter, kKDFParameter, kAEADParameter);
-  if (!maybe_config.ok()) {
-    return absl::InternalError(absl::StrCat(
-        "Unable to build OHTTP config: ", maybe_req_key_id.status().message()));
-  }
   auto private_key_id = std::to_string(*maybe_req_key_id);
 
   VLOG(9) << "Decrypting for the public key id: " << private_key_id;
@@ -46,12 +41,23 @@ absl::StatusOr<absl::string_view> OhttpServerEncryptor::DecryptRequest(
     return absl::InternalError(error);
   }
 
-  auto maybe_ohttp_gateway = quiche::ObliviousHttpGateway::Create(
-      private_key->private_key, *maybe_config);
+  auto maybe_ohttp_gateway = SharedOhttpGatewayCache().Get(
+      *maybe_req_key_id, private_key->private_key,
+      [&]() -> absl::StatusOr<quiche::ObliviousHttpGateway> {
+        const auto maybe_config = quiche::ObliviousHttpHeaderKeyConfig::Create(
+            *maybe_req_key_id, kKEMParameter, kKDFParameter, kAEADParameter);
+        if (!maybe_config.ok()) {
+          return absl::InternalError(
+              absl::StrCat("Unable to build OHTTP config: ",
+                           maybe_config.status().message()));
+        }
+        return quiche::ObliviousHttpGateway::Create(private_key->private_key,
+                                                    *maybe_config);
+      });
   if (!maybe_ohttp_gateway.ok()) {
     return maybe_ohttp_gateway.status();
   }
-  ohttp_gateway_ = std::move(*maybe_ohttp_gateway);
+  ohttp_gateway_ = *std::move(maybe_ohttp_gateway);
   auto decrypted_request_maybe =
       ohttp_gateway_->DecryptObliviousHttpRequest(encrypted_payload);
   if (!decrypted_request_maybe.ok()) {
@@ -63,14 +69,17 @@ absl::StatusOr<absl::string_view> OhttpServerEncryptor::DecryptRequest(
 
 absl::StatusOr<std::string> OhttpServerEncryptor::EncryptResponse(
     std::string payload) {
-  if (!ohttp_gateway_.has_value() || !decrypted_request_.has_value()) {
-    return absl::InternalError(
-        "Emtpy `ohttp_gateway_` or `decrypted_request_`. You should call "
-        "`ServerDecryptRequest` first");
+  if (!server_request_context_.has_value()) {
+    if (ohttp_gateway_ == nullptr || !decrypted_request_.has_value()) {
+      return absl::InternalError(
+          "Emtpy `ohttp_gateway_` or `decrypted_request_`. You should call "
+          "`ServerDecryptRequest` first");
+    }
+    server_request_context_.emplace(
+        std::move(*decrypted_request_).ReleaseContext());
   }
-  auto server_request_context = std::move(*decrypted_request_).ReleaseContext();
   const auto encapsulate_resp = ohttp_gateway_->CreateObliviousHttpResponse(
-      std::move(payload), server_request_context);
+      std::move(payload), *server_request_context_);
   if (!encapsulate_resp.ok()) {
     return absl::InternalError(
         std::string(encapsulate_resp.status().message()));
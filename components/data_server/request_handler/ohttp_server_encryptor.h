@@ -15,6 +15,8 @@
 #ifndef COMPONENTS_DATA_SERVER_REQUEST_HANDLER_OHTTP_SERVER_ENCRYPTOR_H_
 #define COMPONENTS_DATA_SERVER_REQUEST_HANDLER_OHTTP_SERVER_ENCRYPTOR_H_
 
+#include <memory>
+#include <optional>
 #include <string>
 #include <string_view>
 
@@ -41,12 +43,16 @@ class OhttpServerEncryptor {
   absl::StatusOr<absl::string_view> DecryptRequest(
       absl::string_view encrypted_payload);
   // Encrypts outgoing response. Since OHTTP is stateful, this method should be
-  // called after DecryptRequest.
+  // called after DecryptRequest. Can be called again for the next chunk of a
+  // streamed response, each response is encrypted with a nonce of its own.
   absl::StatusOr<std::string> EncryptResponse(std::string payload);
 
  private:
-  std::optional<quiche::ObliviousHttpGateway> ohttp_gateway_;
+  // Shared with the other requests encrypted with the same key.
+  std::shared_ptr<const quiche::ObliviousHttpGateway> ohttp_gateway_;
   std::optional<quiche::ObliviousHttpRequest> decrypted_request_;
+  // Released from `decrypted_request_` by the first response.
+  std::optional<quiche::ObliviousHttpRequest::Context> server_request_context_;
   privacy_sandbox::server_common::KeyFetcherManagerInterface&
       key_fetcher_manager_;
 };
@@ -0,0 +1,127 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data_server/request_handler/udf_output_cache.h"
+
+#include <iterator>
+#include <string>
+#include <utility>
+
+#include "absl/strings/str_cat.h"
+
+namespace kv_server {
+namespace {
+
+std::string GetKey(int64_t code_object_id, std::string_view input) {
+  return absl::StrCat(code_object_id, ":", input);
+}
+
+}  // namespace
+
+UdfOutputCache::UdfOutputCache(const DataVersion& data_version)
+    : data_version_(data_version) {}
+
+UdfOutputCache::UdfOutputCache(Options options,
+                               const DataVersion& data_version)
+    : data_version_(data_version) {
+  SetOptions(std::move(options));
+}
+
+void UdfOutputCache::SetOptions(Options options) {
+  absl::MutexLock lock(&mutex_);
+  Clear();
+  enabled_ = options.max_entries > 0;
+  options_ = std::move(options);
+}
+
+std::optional<std::string> UdfOutputCache::Lookup(int64_t code_object_id,
+                                                  std::string_view input) {
+  const uint64_t current_data_version = data_version_.current();
+  const std::string key = GetKey(code_object_id, input);
+  absl::MutexLock lock(&mutex_);
+  MaybeInvalidate(current_data_version);
+  const auto it = index_.find(key);
+  if (it == index_.end()) {
+    ++num_misses_;
+    return std::nullopt;
+  }
+  if (it->second->expiration < absl::Now()) {
+    Erase(it->second);
+    ++num_misses_;
+    return std::nullopt;
+  }
+  ++num_hits_;
+  entries_.splice(entries_.begin(), entries_, it->second);
+  return entries_.front().output;
+}
+
+void UdfOutputCache::Add(int64_t code_object_id, std::string_view input,
+                         uint64_t data_version, std::string output) {
+  std::string key = GetKey(code_object_id, input);
+  absl::MutexLock lock(&mutex_);
+  if (options_.max_entries == 0) {
+    return;
+  }
+  MaybeInvalidate(data_version_.current());
+  // The data changed while the output was computed.
+  if (data_version != entries_data_version_) {
+    return;
+  }
+  if (const auto it = index_.find(key); it != index_.end()) {
+    Erase(it->second);
+  }
+  num_bytes_ += key.size() + output.size();
+  entries_.push_front(Entry{.key = std::move(key),
+                            .output = std::move(output),
+                            .expiration = absl::Now() + options_.ttl});
+  index_.emplace(entries_.front().key, entries_.begin());
+  ++num_entries_;
+  if (static_cast<int>(entries_.size()) > options_.max_entries) {
+    Erase(std::prev(entries_.end()));
+    ++num_evictions_;
+  }
+}
+
+void UdfOutputCache::MaybeInvalidate(uint64_t current_data_version) {
+  if (current_data_version == entries_data_version_) {
+    return;
+  }
+  num_invalidations_ += entries_.size();
+  Clear();
+  entries_data_version_ = current_data_version;
+}
+
+void UdfOutputCache::Erase(std::list<Entry>::iterator it) {
+  num_bytes_ -= it->key.size() + it->output.size();
+  --num_entries_;
+  index_.erase(it->key);
+  entries_.erase(it);
+}
+
+void UdfOutputCache::Clear() {
+  index_.clear();
+  entries_.clear();
+  num_entries_ = 0;
+  num_bytes_ = 0;
+}
+
+UdfOutputCache& ServerUdfOutputCache() {
+  // Never destroyed, requests may be served at exit.
+  static UdfOutputCache* const cache = new UdfOutputCache();
+  return *cache;
+}
+
+}  // namespace kv_server
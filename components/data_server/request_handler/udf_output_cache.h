@@ -0,0 +1,130 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_REQUEST_HANDLER_UDF_OUTPUT_CACHE_H_
+#define COMPONENTS_DATA_SERVER_REQUEST_HANDLER_UDF_OUTPUT_CACHE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "components/data_server/cache/data_version.h"
+
+namespace kv_server {
+
+// Keeps the outputs of the most recent UDF executions of the code objects
+// that allow it, by code object and UDF input, so that the UDF runs once per
+// input and version of the data instead of once per partition.
+//
+// Which keys an execution read is not known, so every output is dropped
+// once the data changes. Outputs computed from the data of other shards,
+// which changes without this server knowing, are kept for at most `ttl`.
+//
+// Thread-safe.
+class UdfOutputCache {
+ public:
+  struct Options {
+    // Maximum number of outputs. 0 disables the cache.
+    int max_entries = 0;
+    absl::Duration ttl = absl::Seconds(10);
+  };
+
+  // The cache is disabled until `SetOptions` enables it.
+  explicit UdfOutputCache(
+      const DataVersion& data_version = ServedDataVersion());
+  UdfOutputCache(Options options,
+                 const DataVersion& data_version = ServedDataVersion());
+  UdfOutputCache(const UdfOutputCache&) = delete;
+  UdfOutputCache& operator=(const UdfOutputCache&) = delete;
+
+  // Drops every output.
+  void SetOptions(Options options) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  bool enabled() const { return enabled_; }
+
+  // Returns the version of the data to add the outputs of the executions
+  // that start after the call with.
+  uint64_t data_version() const { return data_version_.current(); }
+
+  // Returns the output that was added for `input` of the code object
+  // `code_object_id`, if the data didn't change since and it is not older
+  // than `ttl`.
+  std::optional<std::string> Lookup(int64_t code_object_id,
+                                    std::string_view input)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Keeps `output` as the output of `input` of the code object
+  // `code_object_id`, computed from the data at `data_version`.
+  void Add(int64_t code_object_id, std::string_view input,
+           uint64_t data_version, std::string output)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  int64_t num_entries() const { return num_entries_; }
+  // Bytes of the inputs and outputs kept.
+  int64_t num_bytes() const { return num_bytes_; }
+  int64_t num_hits() const { return num_hits_; }
+  int64_t num_misses() const { return num_misses_; }
+  // Outputs dropped to make room for others, and because the data changed.
+  int64_t num_evictions() const { return num_evictions_; }
+  int64_t num_invalidations() const { return num_invalidations_; }
+
+ private:
+  struct Entry {
+    std::string key;
+    std::string output;
+    absl::Time expiration;
+  };
+
+  // Drops every output if the data changed since they were added.
+  void MaybeInvalidate(uint64_t current_data_version)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void Erase(std::list<Entry>::iterator it)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void Clear() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  const DataVersion& data_version_;
+  absl::Mutex mutex_;
+  Options options_ ABSL_GUARDED_BY(mutex_);
+  // The version of the data that the outputs were computed from.
+  uint64_t entries_data_version_ ABSL_GUARDED_BY(mutex_) = 0;
+  // Most recently used first.
+  std::list<Entry> entries_ ABSL_GUARDED_BY(mutex_);
+  // Views of the keys of `entries_`.
+  absl::flat_hash_map<std::string_view, std::list<Entry>::iterator> index_
+      ABSL_GUARDED_BY(mutex_);
+  // Read without the lock to skip the cache when it is disabled.
+  std::atomic<bool> enabled_ = false;
+  std::atomic<int64_t> num_entries_ = 0;
+  std::atomic<int64_t> num_bytes_ = 0;
+  std::atomic<int64_t> num_hits_ = 0;
+  std::atomic<int64_t> num_misses_ = 0;
+  std::atomic<int64_t> num_evictions_ = 0;
+  std::atomic<int64_t> num_invalidations_ = 0;
+};
+
+// Returns the UDF output cache of the process.
+UdfOutputCache& ServerUdfOutputCache();
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_REQUEST_HANDLER_UDF_OUTPUT_CACHE_H_
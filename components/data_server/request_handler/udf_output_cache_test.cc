@@ -0,0 +1,98 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data_server/request_handler/udf_output_cache.h"
+
+#include <optional>
+#include <string>
+
+#include "absl/time/clock.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+TEST(UdfOutputCacheTest, ReturnsAddedOutput) {
+  DataVersion data_version;
+  UdfOutputCache cache({.max_entries = 10}, data_version);
+  EXPECT_EQ(cache.Lookup(1, "input"), std::nullopt);
+  cache.Add(1, "input", cache.data_version(), "output");
+  EXPECT_EQ(cache.Lookup(1, "input"), "output");
+  EXPECT_EQ(cache.num_hits(), 1);
+  EXPECT_EQ(cache.num_misses(), 1);
+  EXPECT_EQ(cache.num_entries(), 1);
+  EXPECT_EQ(cache.num_bytes(), std::string("1:input").size() + 6);
+}
+
+TEST(UdfOutputCacheTest, KeepsOutputsPerCodeObject) {
+  DataVersion data_version;
+  UdfOutputCache cache({.max_entries = 10}, data_version);
+  cache.Add(1, "input", cache.data_version(), "output");
+  EXPECT_EQ(cache.Lookup(2, "input"), std::nullopt);
+}
+
+TEST(UdfOutputCacheTest, DataChangeDropsOutputs) {
+  DataVersion data_version;
+  UdfOutputCache cache({.max_entries = 10}, data_version);
+  cache.Add(1, "input", cache.data_version(), "output");
+  data_version.Advance();
+  EXPECT_EQ(cache.Lookup(1, "input"), std::nullopt);
+  EXPECT_EQ(cache.num_invalidations(), 1);
+  EXPECT_EQ(cache.num_entries(), 0);
+}
+
+TEST(UdfOutputCacheTest, OutputOfChangedDataIsNotAdded) {
+  DataVersion data_version;
+  UdfOutputCache cache({.max_entries = 10}, data_version);
+  const uint64_t version = cache.data_version();
+  // The data changes while the UDF runs.
+  data_version.Advance();
+  cache.Add(1, "input", version, "output");
+  EXPECT_EQ(cache.Lookup(1, "input"), std::nullopt);
+}
+
+TEST(UdfOutputCacheTest, EvictsLeastRecentlyUsedOutput) {
+  DataVersion data_version;
+  UdfOutputCache cache({.max_entries = 2}, data_version);
+  cache.Add(1, "a", cache.data_version(), "output_a");
+  cache.Add(1, "b", cache.data_version(), "output_b");
+  EXPECT_EQ(cache.Lookup(1, "a"), "output_a");
+  cache.Add(1, "c", cache.data_version(), "output_c");
+  EXPECT_EQ(cache.Lookup(1, "a"), "output_a");
+  EXPECT_EQ(cache.Lookup(1, "b"), std::nullopt);
+  EXPECT_EQ(cache.Lookup(1, "c"), "output_c");
+  EXPECT_EQ(cache.num_evictions(), 1);
+}
+
+TEST(UdfOutputCacheTest, OutputsExpire) {
+  DataVersion data_version;
+  UdfOutputCache cache({.max_entries = 10, .ttl = absl::Milliseconds(10)},
+                       data_version);
+  cache.Add(1, "input", cache.data_version(), "output");
+  absl::SleepFor(absl::Milliseconds(20));
+  EXPECT_EQ(cache.Lookup(1, "input"), std::nullopt);
+}
+
+TEST(UdfOutputCacheTest, DisabledCacheKeepsNothing) {
+  DataVersion data_version;
+  UdfOutputCache cache(data_version);
+  EXPECT_FALSE(cache.enabled());
+  cache.Add(1, "input", cache.data_version(), "output");
+  EXPECT_EQ(cache.num_entries(), 0);
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -0,0 +1,74 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data_server/request_handler/v1_value_cache.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "google/protobuf/util/json_util.h"
+
+namespace kv_server {
+
+google::protobuf::Value ParseV1Value(std::string_view raw_value) {
+  google::protobuf::Value value;
+  if (!google::protobuf::util::JsonStringToMessage(raw_value, &value).ok()) {
+    // If string is not a Json string that can be parsed into Value
+    // proto, simply set it as pure string value to the response.
+    value.set_string_value(std::string(raw_value));
+  }
+  return value;
+}
+
+V1ValueCache::V1ValueCache(int max_keys) : max_keys_(max_keys) {}
+
+std::shared_ptr<const google::protobuf::Value> V1ValueCache::Parse(
+    std::string_view key, std::string_view raw_value) {
+  if (max_keys_ == 0) {
+    return std::make_shared<const google::protobuf::Value>(
+        ParseV1Value(raw_value));
+  }
+  {
+    absl::MutexLock lock(&mutex_);
+    if (const auto it = index_.find(key);
+        it != index_.end() && it->second->raw_value == raw_value) {
+      entries_.splice(entries_.begin(), entries_, it->second);
+      return it->second->value;
+    }
+  }
+  // Parsed without the lock.
+  Entry entry{.key = std::string(key),
+              .raw_value = std::string(raw_value),
+              .value = std::make_shared<const google::protobuf::Value>(
+                  ParseV1Value(raw_value))};
+  auto value = entry.value;
+  absl::MutexLock lock(&mutex_);
+  if (const auto it = index_.find(key); it != index_.end()) {
+    const auto entry_it = it->second;
+    index_.erase(it);
+    entries_.erase(entry_it);
+  }
+  entries_.push_front(std::move(entry));
+  index_.emplace(entries_.front().key, entries_.begin());
+  if (static_cast<int>(entries_.size()) > max_keys_) {
+    index_.erase(entries_.back().key);
+    entries_.pop_back();
+  }
+  return value;
+}
+
+}  // namespace kv_server
@@ -0,0 +1,76 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_REQUEST_HANDLER_V1_VALUE_CACHE_H_
+#define COMPONENTS_DATA_SERVER_REQUEST_HANDLER_V1_VALUE_CACHE_H_
+
+#include <list>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "src/google/protobuf/struct.pb.h"
+
+namespace kv_server {
+
+// Returns `raw_value` parsed as JSON into the `Value` that the v1 API returns,
+// or as a string value if it is not JSON.
+google::protobuf::Value ParseV1Value(std::string_view raw_value);
+
+// Keeps the parsed v1 values of the most recently looked up keys, with the
+// cached strings they were parsed from, so that a value is parsed from JSON
+// once per update of its key instead of once per lookup.
+//
+// A parsed value is only returned for the same string, so entries never go
+// stale: the next lookup of an updated key misses and replaces the entry.
+//
+// Thread-safe.
+class V1ValueCache {
+ public:
+  // Keeps at most `max_keys` parsed values. 0 disables the cache.
+  explicit V1ValueCache(int max_keys);
+  V1ValueCache(const V1ValueCache&) = delete;
+  V1ValueCache& operator=(const V1ValueCache&) = delete;
+
+  bool enabled() const { return max_keys_ > 0; }
+
+  // Returns `ParseV1Value(raw_value)`, parsing it only if it was not parsed
+  // for `key` before.
+  std::shared_ptr<const google::protobuf::Value> Parse(
+      std::string_view key, std::string_view raw_value)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  struct Entry {
+    std::string key;
+    std::string raw_value;
+    std::shared_ptr<const google::protobuf::Value> value;
+  };
+
+  const int max_keys_;
+  absl::Mutex mutex_;
+  // Most recently used first.
+  std::list<Entry> entries_ ABSL_GUARDED_BY(mutex_);
+  // Views of the keys of `entries_`.
+  absl::flat_hash_map<std::string_view, std::list<Entry>::iterator> index_
+      ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_REQUEST_HANDLER_V1_VALUE_CACHE_H_
@@ -0,0 +1,80 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data_server/request_handler/v1_value_cache.h"
+
+#include <string>
+
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+#include "public/test_util/proto_matcher.h"
+
+namespace kv_server {
+namespace {
+
+using google::protobuf::TextFormat;
+using google::protobuf::Value;
+
+Value ValueFromTextProto(std::string text_proto) {
+  Value value;
+  TextFormat::ParseFromString(text_proto, &value);
+  return value;
+}
+
+TEST(ParseV1ValueTest, ParsesJsonAndFallsBackToString) {
+  EXPECT_THAT(ParseV1Value(R"({"k": 1})"),
+              EqualsProto(ValueFromTextProto(R"pb(struct_value {
+                                                    fields {
+                                                      key: "k"
+                                                      value { number_value: 1 }
+                                                    }
+                                                  })pb")));
+  EXPECT_THAT(
+      ParseV1Value("not json"),
+      EqualsProto(ValueFromTextProto(R"pb(string_value: "not json")pb")));
+}
+
+TEST(V1ValueCacheTest, ReusesValueParsedFromSameString) {
+  V1ValueCache cache(/*max_keys=*/10);
+  const auto first = cache.Parse("key", "[1]");
+  EXPECT_EQ(cache.Parse("key", "[1]"), first);
+  // An updated value is parsed again.
+  const auto updated = cache.Parse("key", "[2]");
+  EXPECT_NE(updated, first);
+  EXPECT_THAT(*updated, EqualsProto(ParseV1Value("[2]")));
+  EXPECT_EQ(cache.Parse("key", "[2]"), updated);
+}
+
+TEST(V1ValueCacheTest, EvictsLeastRecentlyUsedKeys) {
+  V1ValueCache cache(/*max_keys=*/2);
+  const auto key1 = cache.Parse("key1", "1");
+  const auto key2 = cache.Parse("key2", "2");
+  EXPECT_EQ(cache.Parse("key1", "1"), key1);
+  cache.Parse("key3", "3");
+  EXPECT_EQ(cache.Parse("key1", "1"), key1);
+  EXPECT_NE(cache.Parse("key2", "2"), key2);
+}
+
+TEST(V1ValueCacheTest, DisabledParsesEveryTime) {
+  V1ValueCache cache(/*max_keys=*/0);
+  EXPECT_FALSE(cache.enabled());
+  const auto first = cache.Parse("key", "[1]");
+  EXPECT_NE(cache.Parse("key", "[1]"), first);
+  EXPECT_THAT(*first, EqualsProto(ParseV1Value("[1]")));
+}
+
+}  // namespace
+}  // namespace kv_server
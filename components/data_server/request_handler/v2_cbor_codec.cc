@@ -0,0 +1,179 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data_server/request_handler/v2_cbor_codec.h"
+
+#include <cstdint>
+#include <string>
+
+#include "components/data_server/request_handler/v2_json_codec.h"
+#include "google/protobuf/util/json_util.h"
+#include "nlohmann/json.hpp"
+
+namespace kv_server {
+namespace {
+
+using google::protobuf::util::MessageToJsonString;
+using Json = nlohmann::json;
+
+enum MajorType : uint8_t {
+  kUnsignedInteger = 0,
+  kNegativeInteger = 1,
+  kByteString = 2,
+  kTextString = 3,
+  kArray = 4,
+  kMap = 5,
+};
+
+// Appends the head of a data item of `major_type` with the argument `value`,
+// in its shortest form.
+void AppendHead(MajorType major_type, uint64_t value, std::string& cbor) {
+  const char initial_byte = static_cast<char>(major_type << 5);
+  int num_bytes;
+  if (value < 24) {
+    cbor.push_back(initial_byte | static_cast<char>(value));
+    return;
+  } else if (value <= 0xff) {
+    cbor.push_back(initial_byte | 24);
+    num_bytes = 1;
+  } else if (value <= 0xffff) {
+    cbor.push_back(initial_byte | 25);
+    num_bytes = 2;
+  } else if (value <= 0xffffffff) {
+    cbor.push_back(initial_byte | 26);
+    num_bytes = 4;
+  } else {
+    cbor.push_back(initial_byte | 27);
+    num_bytes = 8;
+  }
+  for (int i = num_bytes - 1; i >= 0; --i) {
+    cbor.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+  }
+}
+
+void AppendInt(int64_t value, std::string& cbor) {
+  if (value >= 0) {
+    AppendHead(kUnsignedInteger, value, cbor);
+  } else {
+    AppendHead(kNegativeInteger, -(value + 1), cbor);
+  }
+}
+
+void AppendString(MajorType major_type, std::string_view value,
+                  std::string& cbor) {
+  AppendHead(major_type, value.size(), cbor);
+  cbor.append(value);
+}
+
+// Appends `message` through its JSON, for the fields the writer doesn't
+// handle, such as status details.
+absl::Status AppendByReflection(const google::protobuf::Message& message,
+                                std::string& cbor) {
+  std::string json;
+  if (const auto status = MessageToJsonString(message, &json); !status.ok()) {
+    return status;
+  }
+  Json::to_cbor(Json::parse(json), cbor);
+  return absl::OkStatus();
+}
+
+// Appends the map of `partition`, without the fields that have their default
+// value, as its JSON does.
+absl::Status AppendPartition(const v2::ResponsePartition& partition,
+                             std::string& cbor) {
+  if (partition.has_status() && !partition.status().details().empty()) {
+    return AppendByReflection(partition, cbor);
+  }
+  const bool has_output = partition.has_string_output() ||
+                          partition.has_status();
+  AppendHead(kMap, (partition.id() != 0) + has_output, cbor);
+  if (partition.id() != 0) {
+    AppendString(kTextString, "id", cbor);
+    AppendInt(partition.id(), cbor);
+  }
+  if (partition.has_string_output()) {
+    AppendString(kTextString, "stringOutput", cbor);
+    AppendString(kTextString, partition.string_output(), cbor);
+  } else if (partition.has_status()) {
+    AppendString(kTextString, "status", cbor);
+    const google::rpc::Status& status = partition.status();
+    AppendHead(kMap, (status.code() != 0) + !status.message().empty(), cbor);
+    if (status.code() != 0) {
+      AppendString(kTextString, "code", cbor);
+      AppendInt(status.code(), cbor);
+    }
+    if (!status.message().empty()) {
+      AppendString(kTextString, "message", cbor);
+      AppendString(kTextString, status.message(), cbor);
+    }
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace
+
+absl::Status ParseGetValuesRequestCbor(std::string_view cbor,
+                                       v2::GetValuesRequest& request) {
+  const auto parsed = Json::from_cbor(cbor, /*strict=*/true,
+                                      /*allow_exceptions=*/false);
+  if (parsed.is_discarded()) {
+    return absl::InvalidArgumentError("Cannot parse request as CBOR.");
+  }
+  return ParseGetValuesRequest(parsed, request);
+}
+
+absl::Status AppendResponsePartitionsCbor(
+    absl::Span<const v2::ResponsePartition* const> partitions,
+    std::string& cbor) {
+  AppendHead(kArray, partitions.size(), cbor);
+  for (const v2::ResponsePartition* partition : partitions) {
+    if (const auto status = AppendPartition(*partition, cbor); !status.ok()) {
+      return status;
+    }
+  }
+  return absl::OkStatus();
+}
+
+absl::Status GetValuesResponseToCbor(const v2::GetValuesResponse& response,
+                                     std::string& cbor) {
+  cbor.clear();
+  if (response.has_single_partition()) {
+    AppendHead(kMap, 1, cbor);
+    AppendString(kTextString, "singlePartition", cbor);
+    return AppendPartition(response.single_partition(), cbor);
+  }
+  if (!response.has_compressed_partition_groups()) {
+    AppendHead(kMap, 0, cbor);
+    return absl::OkStatus();
+  }
+  AppendHead(kMap, 1, cbor);
+  AppendString(kTextString, "compressedPartitionGroups", cbor);
+  const auto& groups =
+      response.compressed_partition_groups().compressed_partition_groups();
+  if (groups.empty()) {
+    AppendHead(kMap, 0, cbor);
+    return absl::OkStatus();
+  }
+  AppendHead(kMap, 1, cbor);
+  AppendString(kTextString, "compressedPartitionGroups", cbor);
+  AppendHead(kArray, groups.size(), cbor);
+  for (const std::string& group : groups) {
+    AppendString(kByteString, group, cbor);
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace kv_server
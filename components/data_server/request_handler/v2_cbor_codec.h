@@ -0,0 +1,50 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_REQUEST_HANDLER_V2_CBOR_CODEC_H_
+#define COMPONENTS_DATA_SERVER_REQUEST_HANDLER_V2_CBOR_CODEC_H_
+
+#include <string>
+#include <string_view>
+
+#include "absl/status/status.h"
+#include "absl/types/span.h"
+#include "public/query/v2/get_values_v2.pb.h"
+
+namespace kv_server {
+
+// CBOR (RFC 8949) codec of the v2 GetValues messages. Their CBOR has the
+// structure of their JSON, with the same field names, except that bytes are
+// byte strings instead of base64 text. Responses are written straight from
+// their fields, without building a JSON document first.
+
+// Parses the CBOR `cbor` into `request`.
+absl::Status ParseGetValuesRequestCbor(std::string_view cbor,
+                                       v2::GetValuesRequest& request);
+
+// Appends the CBOR array of `partitions`, the content of a compression group,
+// to `cbor`.
+absl::Status AppendResponsePartitionsCbor(
+    absl::Span<const v2::ResponsePartition* const> partitions,
+    std::string& cbor);
+
+// Sets `cbor` to the CBOR of `response`.
+absl::Status GetValuesResponseToCbor(const v2::GetValuesResponse& response,
+                                     std::string& cbor);
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_REQUEST_HANDLER_V2_CBOR_CODEC_H_
@@ -0,0 +1,141 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data_server/request_handler/v2_cbor_codec.h"
+
+#include <string>
+#include <vector>
+
+#include "google/protobuf/util/json_util.h"
+#include "gtest/gtest.h"
+#include "nlohmann/json.hpp"
+#include "public/test_util/proto_matcher.h"
+
+namespace kv_server {
+namespace {
+
+using google::protobuf::util::JsonStringToMessage;
+using google::protobuf::util::MessageToJsonString;
+using Json = nlohmann::json;
+
+constexpr std::string_view kRequest = R"({
+  "metadata": {"hostname": "example.com"},
+  "partitions": [{
+    "id": 1,
+    "compressionGroupId": 2,
+    "arguments": [{
+      "tags": ["custom", "keys"],
+      "data": ["key1", "key2", {"nested": [-1, 2.5, true, null]}]
+    }]
+  }]
+})";
+
+std::string ToCbor(std::string_view json) {
+  std::string cbor;
+  Json::to_cbor(Json::parse(json), cbor);
+  return cbor;
+}
+
+Json ParseCbor(std::string_view cbor) { return Json::from_cbor(cbor); }
+
+TEST(V2CborCodecTest, ParsesRequestLikeJson) {
+  v2::GetValuesRequest expected;
+  ASSERT_TRUE(JsonStringToMessage(kRequest, &expected).ok());
+  v2::GetValuesRequest request;
+  ASSERT_TRUE(ParseGetValuesRequestCbor(ToCbor(kRequest), request).ok());
+  EXPECT_THAT(request, EqualsProto(expected));
+}
+
+TEST(V2CborCodecTest, InvalidRequestFails) {
+  v2::GetValuesRequest request;
+  EXPECT_FALSE(ParseGetValuesRequestCbor("\xff\xff", request).ok());
+  EXPECT_FALSE(
+      ParseGetValuesRequestCbor(ToCbor(R"({"unknown": 1})"), request).ok());
+}
+
+// Expects the CBOR of `partitions` to decode to the array of their JSON.
+void ExpectSameStructureAsJson(
+    const std::vector<v2::ResponsePartition>& partitions) {
+  std::vector<const v2::ResponsePartition*> pointers;
+  Json expected = Json::array();
+  for (const auto& partition : partitions) {
+    pointers.push_back(&partition);
+    std::string json;
+    ASSERT_TRUE(MessageToJsonString(partition, &json).ok());
+    expected.push_back(Json::parse(json));
+  }
+  std::string cbor;
+  ASSERT_TRUE(AppendResponsePartitionsCbor(pointers, cbor).ok());
+  EXPECT_EQ(ParseCbor(cbor), expected);
+}
+
+TEST(V2CborCodecTest, WritesPartitionsLikeJson) {
+  std::vector<v2::ResponsePartition> partitions(4);
+  partitions[1].set_id(1);
+  partitions[1].set_string_output(
+      R"({"keyGroupOutputs": [{"tags": ["custom", "keys"]}]})" +
+      std::string(300, 'v'));
+  partitions[2].set_id(-70000);
+  partitions[2].mutable_status()->set_code(5);
+  partitions[2].mutable_status()->set_message("Not found");
+  partitions[3].mutable_status();
+  ExpectSameStructureAsJson(partitions);
+}
+
+TEST(V2CborCodecTest, WritesStatusDetailsByReflection) {
+  std::vector<v2::ResponsePartition> partitions(1);
+  partitions[0].mutable_status()->add_details()->PackFrom(
+      v2::RequestPartition());
+  ExpectSameStructureAsJson(partitions);
+}
+
+TEST(V2CborCodecTest, WritesSinglePartitionResponse) {
+  v2::GetValuesResponse response;
+  std::string cbor;
+  ASSERT_TRUE(GetValuesResponseToCbor(response, cbor).ok());
+  EXPECT_EQ(ParseCbor(cbor), Json::object());
+  response.mutable_single_partition()->set_id(2);
+  response.mutable_single_partition()->set_string_output("output");
+  ASSERT_TRUE(GetValuesResponseToCbor(response, cbor).ok());
+  EXPECT_EQ(ParseCbor(cbor), Json::parse(R"({
+    "singlePartition": {"id": 2, "stringOutput": "output"}
+  })"));
+}
+
+TEST(V2CborCodecTest, WritesCompressionGroupsAsByteStrings) {
+  v2::GetValuesResponse response;
+  auto& groups = *response.mutable_compressed_partition_groups();
+  std::string cbor;
+  ASSERT_TRUE(GetValuesResponseToCbor(response, cbor).ok());
+  EXPECT_EQ(ParseCbor(cbor),
+            Json::parse(R"({"compressedPartitionGroups": {}})"));
+  const std::string group("\x00\x01\xff", 3);
+  groups.add_compressed_partition_groups(group);
+  groups.add_compressed_partition_groups(std::string(70000, 'g'));
+  ASSERT_TRUE(GetValuesResponseToCbor(response, cbor).ok());
+  const Json parsed = ParseCbor(cbor);
+  const Json& parsed_groups =
+      parsed["compressedPartitionGroups"]["compressedPartitionGroups"];
+  ASSERT_EQ(parsed_groups.size(), 2);
+  ASSERT_TRUE(parsed_groups[0].is_binary());
+  EXPECT_EQ(std::string(parsed_groups[0].get_binary().begin(),
+                        parsed_groups[0].get_binary().end()),
+            group);
+  EXPECT_EQ(parsed_groups[1].get_binary().size(), 70000);
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -0,0 +1,365 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data_server/request_handler/v2_json_codec.h"
+
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string>
+
+#include "absl/strings/escaping.h"
+#include "absl/strings/str_cat.h"
+#include "google/protobuf/util/json_util.h"
+
+namespace kv_server {
+namespace {
+
+using google::protobuf::util::JsonStringToMessage;
+using google::protobuf::util::MessageToJsonString;
+using Json = nlohmann::json;
+
+// Returns the field of `object` under its JSON or its proto name, or null.
+const Json* FindField(const Json& object, const char* json_name,
+                      const char* proto_name) {
+  for (const char* name : {json_name, proto_name}) {
+    if (const auto it = object.find(name); it != object.end()) {
+      return &*it;
+    }
+  }
+  return nullptr;
+}
+
+std::optional<int32_t> ToInt32(const Json& json) {
+  if (json.is_number_unsigned()) {
+    const uint64_t value = json.get<uint64_t>();
+    if (value > static_cast<uint64_t>(std::numeric_limits<int32_t>::max())) {
+      return std::nullopt;
+    }
+    return static_cast<int32_t>(value);
+  }
+  if (json.is_number_integer()) {
+    const int64_t value = json.get<int64_t>();
+    if (value < std::numeric_limits<int32_t>::min() ||
+        value > std::numeric_limits<int32_t>::max()) {
+      return std::nullopt;
+    }
+    return static_cast<int32_t>(value);
+  }
+  return std::nullopt;
+}
+
+// The parsers below return false for JSON they don't handle, which is then
+// parsed by `JsonStringToMessage`.
+
+bool ParseArgument(const Json& json, UDFArgument& argument) {
+  if (!json.is_object()) {
+    return false;
+  }
+  for (const auto& [name, field] : json.items()) {
+    if (name == "tags") {
+      if (!field.is_array()) {
+        return false;
+      }
+      auto& tags = *argument.mutable_tags();
+      for (const auto& tag : field) {
+        JsonToProtoValue(tag, *tags.add_values());
+      }
+    } else if (name == "data") {
+      JsonToProtoValue(field, *argument.mutable_data());
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ParsePartition(const Json& json, v2::RequestPartition& partition) {
+  if (!json.is_object()) {
+    return false;
+  }
+  for (const auto& [name, field] : json.items()) {
+    if (name == "id") {
+      const auto id = ToInt32(field);
+      if (!id.has_value()) {
+        return false;
+      }
+      partition.set_id(*id);
+    } else if (name == "compressionGroupId" ||
+               name == "compression_group_id") {
+      const auto id = ToInt32(field);
+      if (!id.has_value()) {
+        return false;
+      }
+      partition.set_compression_group_id(*id);
+    } else if (name == "arguments") {
+      if (!field.is_array()) {
+        return false;
+      }
+      for (const auto& argument : field) {
+        if (!ParseArgument(argument, *partition.add_arguments())) {
+          return false;
+        }
+      }
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ParseRequest(const Json& json, v2::GetValuesRequest& request) {
+  if (!json.is_object()) {
+    return false;
+  }
+  for (const auto& [name, field] : json.items()) {
+    if (name == "clientVersion" || name == "client_version") {
+      if (!field.is_string()) {
+        return false;
+      }
+      request.set_client_version(field.get<std::string>());
+    } else if (name == "metadata") {
+      if (!field.is_object()) {
+        return false;
+      }
+      auto& fields = *request.mutable_metadata()->mutable_fields();
+      for (const auto& [key, value] : field.items()) {
+        JsonToProtoValue(value, fields[key]);
+      }
+    } else if (name == "partitions") {
+      if (!field.is_array()) {
+        return false;
+      }
+      for (const auto& partition : field) {
+        if (!ParsePartition(partition, *request.add_partitions())) {
+          return false;
+        }
+      }
+    } else if (name == "logContext" || name == "log_context") {
+      // Small and rare, parsed by reflection.
+      if (!JsonStringToMessage(field.dump(), request.mutable_log_context())
+               .ok()) {
+        return false;
+      }
+    } else if (name == "consentedDebugConfig" ||
+               name == "consented_debug_config") {
+      if (!JsonStringToMessage(field.dump(),
+                               request.mutable_consented_debug_config())
+               .ok()) {
+        return false;
+      }
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool NeedsEscape(char c) {
+  return c == '"' || c == '\\' || static_cast<unsigned char>(c) < 0x20;
+}
+
+// Appends `value` as a JSON string. The runs of characters that need no
+// escaping, usually all of them, are appended at once.
+void AppendJsonString(std::string_view value, std::string& json) {
+  json.push_back('"');
+  size_t run_start = 0;
+  for (size_t i = 0; i < value.size(); ++i) {
+    const char c = value[i];
+    if (!NeedsEscape(c)) {
+      continue;
+    }
+    json.append(value.data() + run_start, i - run_start);
+    run_start = i + 1;
+    switch (c) {
+      case '"':
+        json.append("\\\"");
+        break;
+      case '\\':
+        json.append("\\\\");
+        break;
+      case '\b':
+        json.append("\\b");
+        break;
+      case '\f':
+        json.append("\\f");
+        break;
+      case '\n':
+        json.append("\\n");
+        break;
+      case '\r':
+        json.append("\\r");
+        break;
+      case '\t':
+        json.append("\\t");
+        break;
+      default: {
+        constexpr char kHexDigits[] = "0123456789abcdef";
+        json.append("\\u00");
+        json.push_back(kHexDigits[(c >> 4) & 0xf]);
+        json.push_back(kHexDigits[c & 0xf]);
+      }
+    }
+  }
+  json.append(value.data() + run_start, value.size() - run_start);
+  json.push_back('"');
+}
+
+// Appends the JSON of `partition`, unless it has fields the writer doesn't
+// handle.
+bool AppendPartition(const v2::ResponsePartition& partition,
+                     std::string& json) {
+  if (partition.has_status() && !partition.status().details().empty()) {
+    return false;
+  }
+  json.push_back('{');
+  bool first = true;
+  const auto append_name = [&json, &first](std::string_view name) {
+    if (!first) json.push_back(',');
+    first = false;
+    absl::StrAppend(&json, "\"", name, "\":");
+  };
+  if (partition.id() != 0) {
+    append_name("id");
+    absl::StrAppend(&json, partition.id());
+  }
+  if (partition.has_string_output()) {
+    append_name("stringOutput");
+    AppendJsonString(partition.string_output(), json);
+  } else if (partition.has_status()) {
+    append_name("status");
+    json.push_back('{');
+    const google::rpc::Status& status = partition.status();
+    if (status.code() != 0) {
+      absl::StrAppend(&json, "\"code\":", status.code());
+    }
+    if (!status.message().empty()) {
+      if (status.code() != 0) json.push_back(',');
+      json.append("\"message\":");
+      AppendJsonString(status.message(), json);
+    }
+    json.push_back('}');
+  }
+  json.push_back('}');
+  return true;
+}
+
+bool AppendResponse(const v2::GetValuesResponse& response, std::string& json) {
+  json.push_back('{');
+  if (response.has_single_partition()) {
+    json.append("\"singlePartition\":");
+    if (!AppendPartition(response.single_partition(), json)) {
+      return false;
+    }
+  } else if (response.has_compressed_partition_groups()) {
+    json.append("\"compressedPartitionGroups\":{");
+    const auto& groups =
+        response.compressed_partition_groups().compressed_partition_groups();
+    if (!groups.empty()) {
+      json.append("\"compressedPartitionGroups\":[");
+      for (int i = 0; i < groups.size(); ++i) {
+        if (i > 0) json.push_back(',');
+        absl::StrAppend(&json, "\"", absl::Base64Escape(groups[i]), "\"");
+      }
+      json.push_back(']');
+    }
+    json.push_back('}');
+  }
+  json.push_back('}');
+  return true;
+}
+
+}  // namespace
+
+void JsonToProtoValue(const Json& json, google::protobuf::Value& value) {
+  switch (json.type()) {
+    case Json::value_t::null:
+      value.set_null_value(google::protobuf::NULL_VALUE);
+      break;
+    case Json::value_t::boolean:
+      value.set_bool_value(json.get<bool>());
+      break;
+    case Json::value_t::number_integer:
+    case Json::value_t::number_unsigned:
+    case Json::value_t::number_float:
+      value.set_number_value(json.get<double>());
+      break;
+    case Json::value_t::string:
+      value.set_string_value(json.get_ref<const std::string&>());
+      break;
+    case Json::value_t::array: {
+      auto& list = *value.mutable_list_value();
+      for (const auto& element : json) {
+        JsonToProtoValue(element, *list.add_values());
+      }
+      break;
+    }
+    case Json::value_t::object: {
+      auto& fields = *value.mutable_struct_value()->mutable_fields();
+      for (const auto& [key, field] : json.items()) {
+        JsonToProtoValue(field, fields[key]);
+      }
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+absl::Status ParseGetValuesRequestJson(std::string_view json,
+                                       v2::GetValuesRequest& request) {
+  const auto parsed =
+      Json::parse(json, /*cb=*/nullptr, /*allow_exceptions=*/false);
+  if (!parsed.is_discarded() && ParseRequest(parsed, request)) {
+    return absl::OkStatus();
+  }
+  request.Clear();
+  return JsonStringToMessage(json, &request);
+}
+
+absl::Status ParseGetValuesRequest(const Json& json,
+                                   v2::GetValuesRequest& request) {
+  if (ParseRequest(json, request)) {
+    return absl::OkStatus();
+  }
+  request.Clear();
+  return JsonStringToMessage(
+      json.dump(/*indent=*/-1, /*indent_char=*/' ', /*ensure_ascii=*/false,
+                Json::error_handler_t::replace),
+      &request);
+}
+
+absl::Status GetValuesResponseToJson(const v2::GetValuesResponse& response,
+                                     std::string& json) {
+  json.clear();
+  if (AppendResponse(response, json)) {
+    return absl::OkStatus();
+  }
+  json.clear();
+  return MessageToJsonString(response, &json);
+}
+
+absl::Status ResponsePartitionToJson(const v2::ResponsePartition& partition,
+                                     std::string& json) {
+  json.clear();
+  if (AppendPartition(partition, json)) {
+    return absl::OkStatus();
+  }
+  json.clear();
+  return MessageToJsonString(partition, &json);
+}
+
+}  // namespace kv_server
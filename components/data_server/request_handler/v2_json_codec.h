@@ -0,0 +1,62 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_REQUEST_HANDLER_V2_JSON_CODEC_H_
+#define COMPONENTS_DATA_SERVER_REQUEST_HANDLER_V2_JSON_CODEC_H_
+
+#include <string>
+#include <string_view>
+
+#include "absl/status/status.h"
+#include "nlohmann/json.hpp"
+#include "public/query/v2/get_values_v2.pb.h"
+#include "src/google/protobuf/struct.pb.h"
+
+namespace kv_server {
+
+// JSON codec of the v2 GetValues messages that reads and writes their fields
+// directly, instead of through the reflection of protobuf's JSON utilities,
+// which are slow for the `Struct` and `ListValue` heavy requests.
+//
+// The results are the same as those of `JsonStringToMessage` and
+// `MessageToJsonString`. Messages with fields the codec doesn't handle, such
+// as unknown fields or status details, are converted by those instead, so
+// that errors and leniency are unchanged.
+
+// Parses the JSON `json` into `request`.
+absl::Status ParseGetValuesRequestJson(std::string_view json,
+                                       v2::GetValuesRequest& request);
+
+// Same as above, for a request that is already parsed into `json`, such as
+// one decoded from another format with the same structure.
+absl::Status ParseGetValuesRequest(const nlohmann::json& json,
+                                   v2::GetValuesRequest& request);
+
+// Sets `json` to the JSON of `response`.
+absl::Status GetValuesResponseToJson(const v2::GetValuesResponse& response,
+                                     std::string& json);
+
+// Sets `json` to the JSON of `partition`.
+absl::Status ResponsePartitionToJson(const v2::ResponsePartition& partition,
+                                     std::string& json);
+
+// Sets `value` to the JSON value `json`.
+void JsonToProtoValue(const nlohmann::json& json,
+                      google::protobuf::Value& value);
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_REQUEST_HANDLER_V2_JSON_CODEC_H_
@@ -0,0 +1,132 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data_server/request_handler/v2_json_codec.h"
+
+#include <string>
+
+#include "google/protobuf/util/json_util.h"
+#include "gtest/gtest.h"
+#include "nlohmann/json.hpp"
+#include "public/test_util/proto_matcher.h"
+
+namespace kv_server {
+namespace {
+
+using google::protobuf::util::JsonStringToMessage;
+using google::protobuf::util::MessageToJsonString;
+
+// The shape of the requests of Protected Audience.
+constexpr std::string_view kRequest = R"({
+  "metadata": {"hostname": "example.com", "experimentGroupId": 7},
+  "partitions": [{
+    "id": 0,
+    "compressionGroupId": 1,
+    "arguments": [{
+      "tags": ["structured", "groupNames"],
+      "data": ["group1", "group2"]
+    }, {
+      "tags": ["custom", "keys"],
+      "data": ["key1", "key2", {"nested": [1, 2.5, true, null]}]
+    }]
+  }, {
+    "id": 1,
+    "compression_group_id": 1,
+    "arguments": []
+  }],
+  "clientVersion": "v2",
+  "logContext": {"generationId": "generation"},
+  "consentedDebugConfig": {"isConsented": true, "token": "token"}
+})";
+
+v2::GetValuesRequest ParseByReflection(std::string_view json) {
+  v2::GetValuesRequest request;
+  EXPECT_TRUE(JsonStringToMessage(json, &request).ok());
+  return request;
+}
+
+TEST(V2JsonCodecTest, ParsesRequestLikeReflection) {
+  v2::GetValuesRequest request;
+  ASSERT_TRUE(ParseGetValuesRequestJson(kRequest, request).ok());
+  EXPECT_THAT(request, EqualsProto(ParseByReflection(kRequest)));
+}
+
+TEST(V2JsonCodecTest, RequestWithUnknownFieldFailsLikeReflection) {
+  constexpr std::string_view kUnknownField =
+      R"({"partitions": [{"id": 0, "unknown": 1}]})";
+  v2::GetValuesRequest request;
+  EXPECT_FALSE(ParseGetValuesRequestJson(kUnknownField, request).ok());
+  EXPECT_FALSE(ParseGetValuesRequestJson("not json", request).ok());
+}
+
+TEST(V2JsonCodecTest, RequestWithQuotedIdIsParsedByReflection) {
+  constexpr std::string_view kQuotedId = R"({"partitions": [{"id": "3"}]})";
+  v2::GetValuesRequest request;
+  ASSERT_TRUE(ParseGetValuesRequestJson(kQuotedId, request).ok());
+  EXPECT_EQ(request.partitions(0).id(), 3);
+}
+
+void ExpectSameJsonAsReflection(const v2::GetValuesResponse& response) {
+  std::string json;
+  ASSERT_TRUE(GetValuesResponseToJson(response, json).ok());
+  std::string expected;
+  ASSERT_TRUE(MessageToJsonString(response, &expected).ok());
+  EXPECT_EQ(nlohmann::json::parse(json), nlohmann::json::parse(expected))
+      << json;
+}
+
+TEST(V2JsonCodecTest, WritesResponsesLikeReflection) {
+  v2::GetValuesResponse response;
+  ExpectSameJsonAsReflection(response);
+  response.mutable_single_partition()->set_string_output(
+      R"({"keyGroupOutputs": [{"tags": ["custom", "keys"]}]})"
+      "\n\t\x01\\ unicode: \xc3\xa9");
+  ExpectSameJsonAsReflection(response);
+  response.mutable_single_partition()->set_id(3);
+  ExpectSameJsonAsReflection(response);
+  response.mutable_single_partition()->mutable_status()->set_code(5);
+  response.mutable_single_partition()->mutable_status()->set_message(
+      "Not \"found\"");
+  ExpectSameJsonAsReflection(response);
+  response.mutable_compressed_partition_groups();
+  ExpectSameJsonAsReflection(response);
+  response.mutable_compressed_partition_groups()
+      ->add_compressed_partition_groups(std::string("\x00\x01\xff", 3));
+  response.mutable_compressed_partition_groups()
+      ->add_compressed_partition_groups("group");
+  ExpectSameJsonAsReflection(response);
+}
+
+TEST(V2JsonCodecTest, WritesStatusDetailsByReflection) {
+  v2::GetValuesResponse response;
+  response.mutable_single_partition()
+      ->mutable_status()
+      ->add_details()
+      ->PackFrom(v2::RequestPartition());
+  ExpectSameJsonAsReflection(response);
+}
+
+TEST(V2JsonCodecTest, WritesPartitionsLikeReflection) {
+  v2::ResponsePartition partition;
+  partition.set_id(1);
+  partition.set_string_output("output");
+  std::string json;
+  ASSERT_TRUE(ResponsePartitionToJson(partition, json).ok());
+  EXPECT_EQ(json, R"({"id":1,"stringOutput":"output"})");
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -19,6 +19,7 @@
 #include <grpcpp/grpcpp.h>
 
 #include "components/data_server/request_handler/get_values_handler.h"
+#include "components/util/load_governor.h"
 #include "public/query/get_values.grpc.pb.h"
 
 namespace kv_server {
@@ -40,6 +41,8 @@ grpc::ServerUnaryReactor* KeyValueServiceImpl::GetValues(
   auto* reactor = context->DefaultReactor();
   reactor->Finish(status);
   LogRequestCommonSafeMetrics(request, response, status, request_received_time);
+  DataLoadingGovernor().RecordServingLatency(absl::Now() -
+                                             request_received_time);
   return reactor;
 }
 
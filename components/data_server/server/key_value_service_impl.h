@@ -22,6 +22,7 @@
 
 #include "components/data_server/cache/cache.h"
 #include "components/data_server/request_handler/get_values_handler.h"
+#include "components/util/arena_message_allocator.h"
 #include "grpcpp/grpcpp.h"
 #include "public/query/get_values.grpc.pb.h"
 
@@ -32,7 +33,9 @@ class KeyValueServiceImpl final
     : public kv_server::v1::KeyValueService::CallbackService {
  public:
   explicit KeyValueServiceImpl(GetValuesHandler handler)
-      : handler_(std::move(handler)) {}
+      : handler_(std::move(handler)) {
+    SetMessageAllocatorFor_GetValues(&get_values_allocator_);
+  }
 
   grpc::ServerUnaryReactor* GetValues(
       grpc::CallbackServerContext* context,
@@ -41,6 +44,9 @@ class KeyValueServiceImpl final
 
  private:
   GetValuesHandler handler_;
+  ArenaMessageAllocator<kv_server::v1::GetValuesRequest,
+                        kv_server::v1::GetValuesResponse>
+      get_values_allocator_;
 };
 
 }  // namespace kv_server
@@ -14,8 +14,14 @@
 
 #include "components/data_server/server/key_value_service_v2_impl.h"
 
+#include <chrono>
+#include <string>
+
 #include <grpcpp/grpcpp.h>
 
+#include "absl/time/time.h"
+#include "components/util/admission_controller.h"
+#include "components/util/load_governor.h"
 #include "public/query/v2/get_values_v2.grpc.pb.h"
 #include "src/telemetry/telemetry.h"
 
@@ -27,9 +33,30 @@ using privacy_sandbox::server_common::GetTracer;
 using v2::GetValuesHttpRequest;
 using v2::KeyValueService;
 
+// Returns the status that the request fails with if it is shed, OK if it is
+// admitted, in which case it must be released once served.
+grpc::Status Admit(const grpc::ServerContextBase& context) {
+  const absl::Status status = ServingAdmissionController().TryAdmit(
+      absl::FromChrono(context.deadline()) - absl::Now());
+  if (status.ok()) {
+    return grpc::Status::OK;
+  }
+  return grpc::Status(grpc::StatusCode::UNAVAILABLE,
+                      std::string(status.message()));
+}
+
+// Returns when the client of the call stops waiting for its response.
+RequestDeadline GetRequestDeadline(CallbackServerContext* context) {
+  const auto deadline = context->deadline();
+  return {.deadline = deadline == std::chrono::system_clock::time_point::max()
+                          ? absl::InfiniteFuture()
+                          : absl::FromChrono(deadline),
+          .is_cancelled = [context] { return context->IsCancelled(); }};
+}
+
 template <typename RequestT, typename ResponseT>
-using HandlerFunctionT = grpc::Status (GetValuesV2Handler::*)(const RequestT&,
-                                                              ResponseT*) const;
+using HandlerFunctionT = grpc::Status (GetValuesV2Handler::*)(
+    const RequestT&, ResponseT*, const RequestDeadline&) const;
 
 template <typename RequestT, typename ResponseT>
 grpc::ServerUnaryReactor* HandleRequest(
@@ -37,10 +64,20 @@ grpc::ServerUnaryReactor* HandleRequest(
     ResponseT* response, const GetValuesV2Handler& handler,
     HandlerFunctionT<RequestT, ResponseT> handler_function) {
   auto request_received_time = absl::Now();
-  grpc::Status status = (handler.*handler_function)(*request, response);
   auto* reactor = context->DefaultReactor();
+  if (grpc::Status status = Admit(*context); !status.ok()) {
+    reactor->Finish(status);
+    LogRequestCommonSafeMetrics(request, response, status,
+                                request_received_time);
+    return reactor;
+  }
+  grpc::Status status = (handler.*handler_function)(
+      *request, response, GetRequestDeadline(context));
   reactor->Finish(status);
   LogRequestCommonSafeMetrics(request, response, status, request_received_time);
+  const absl::Duration latency = absl::Now() - request_received_time;
+  ServingAdmissionController().Release(latency);
+  DataLoadingGovernor().RecordServingLatency(latency);
   return reactor;
 }
 
@@ -52,11 +89,31 @@ grpc::ServerUnaryReactor* KeyValueServiceV2Impl::GetValuesHttp(
   return HandleRequest(context, request, response, handler_,
                        &GetValuesV2Handler::GetValuesHttp);
 }
+// The reactor is finished from the thread of the UDF execution instead of
+// blocking the gRPC callback thread while the UDF runs.
 grpc::ServerUnaryReactor* KeyValueServiceV2Impl::GetValues(
     grpc::CallbackServerContext* context, const v2::GetValuesRequest* request,
     v2::GetValuesResponse* response) {
-  return HandleRequest(context, request, response, handler_,
-                       &GetValuesV2Handler::GetValues);
+  auto request_received_time = absl::Now();
+  auto* reactor = context->DefaultReactor();
+  if (grpc::Status status = Admit(*context); !status.ok()) {
+    reactor->Finish(status);
+    LogRequestCommonSafeMetrics(request, response, status,
+                                request_received_time);
+    return reactor;
+  }
+  handler_.GetValuesAsync(
+      *request, response,
+      [reactor, request, response, request_received_time](grpc::Status status) {
+        LogRequestCommonSafeMetrics(request, response, status,
+                                    request_received_time);
+        const absl::Duration latency = absl::Now() - request_received_time;
+        ServingAdmissionController().Release(latency);
+        DataLoadingGovernor().RecordServingLatency(latency);
+        reactor->Finish(status);
+      },
+      GetRequestDeadline(context));
+  return reactor;
 }
 
 grpc::ServerUnaryReactor* KeyValueServiceV2Impl::BinaryHttpGetValues(
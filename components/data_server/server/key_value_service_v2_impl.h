@@ -22,6 +22,7 @@
 
 #include "components/data_server/cache/cache.h"
 #include "components/data_server/request_handler/get_values_v2_handler.h"
+#include "components/util/arena_message_allocator.h"
 #include "grpcpp/grpcpp.h"
 #include "public/query/v2/get_values_v2.grpc.pb.h"
 
@@ -32,7 +33,14 @@ class KeyValueServiceV2Impl final
     : public v2::KeyValueService::CallbackService {
  public:
   explicit KeyValueServiceV2Impl(GetValuesV2Handler handler)
-      : handler_(std::move(handler)) {}
+      : handler_(std::move(handler)) {
+    SetMessageAllocatorFor_GetValuesHttp(&get_values_http_allocator_);
+    SetMessageAllocatorFor_GetValues(&get_values_allocator_);
+    SetMessageAllocatorFor_BinaryHttpGetValues(
+        &binary_http_get_values_allocator_);
+    SetMessageAllocatorFor_ObliviousGetValues(
+        &oblivious_get_values_allocator_);
+  }
 
   grpc::ServerUnaryReactor* GetValuesHttp(
       grpc::CallbackServerContext* context,
@@ -55,6 +63,14 @@ class KeyValueServiceV2Impl final
 
  private:
   const GetValuesV2Handler handler_;
+  ArenaMessageAllocator<v2::GetValuesHttpRequest, google::api::HttpBody>
+      get_values_http_allocator_;
+  ArenaMessageAllocator<v2::GetValuesRequest, v2::GetValuesResponse>
+      get_values_allocator_;
+  ArenaMessageAllocator<v2::BinaryHttpGetValuesRequest, google::api::HttpBody>
+      binary_http_get_values_allocator_;
+  ArenaMessageAllocator<v2::ObliviousGetValuesRequest, google::api::HttpBody>
+      oblivious_get_values_allocator_;
 };
 
 }  // namespace kv_server
@@ -23,6 +23,7 @@
 #include "absl/strings/str_cat.h"
 #include "components/data_server/server/server.h"
 #include "components/util/build_info.h"
+#include "components/util/startup_report.h"
 #include "src/util/rlimit_core_config.h"
 
 ABSL_FLAG(bool, buildinfo, false, "Print build info.");
@@ -37,6 +38,8 @@ int main(int argc, char** argv) {
   //    Server framework code, which is all Open Source.
   // 3. Production versions of the K/V Server run inside Trusted Execution
   //    Environments, which restrict where STDOUT and STDERR are visible to.
+  // The startup report times the startup from here.
+  kv_server::ServerStartupReport();
   absl::InitializeSymbolizer(argv[0]);
   privacysandbox::server_common::SetRLimits({
       .enable_core_dumps = true,
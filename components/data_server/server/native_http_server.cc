@@ -0,0 +1,509 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data_server/server/native_http_server.h"
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <initializer_list>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/log/log.h"
+#include "absl/status/status.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "components/telemetry/server_definition.h"
+#include "components/util/admission_controller.h"
+#include "components/util/load_governor.h"
+#include "nlohmann/json.hpp"
+
+namespace kv_server {
+namespace {
+
+using google::api::HttpBody;
+
+constexpr size_t kMaxHeaderBytes = 64 * 1024;
+constexpr std::string_view kGetValuesPath = "/v2/getvalues";
+constexpr std::string_view kBinaryHttpGetValuesPath = "/v2/bhttp_getvalues";
+constexpr std::string_view kObliviousGetValuesPath = "/v2/oblivious_getvalues";
+
+// The request line and headers of a request.
+struct RequestHead {
+  std::string method;
+  // Without the query.
+  std::string path;
+  std::string content_type;
+  int64_t content_length = 0;
+  bool chunked = false;
+  bool keep_alive = true;
+  bool expect_continue = false;
+};
+
+// Maps `code` to an HTTP status as the gRPC-JSON transcoder of Envoy does.
+int ToHttpStatus(grpc::StatusCode code) {
+  switch (code) {
+    case grpc::StatusCode::OK:
+      return 200;
+    case grpc::StatusCode::CANCELLED:
+      return 499;
+    case grpc::StatusCode::INVALID_ARGUMENT:
+    case grpc::StatusCode::FAILED_PRECONDITION:
+    case grpc::StatusCode::OUT_OF_RANGE:
+      return 400;
+    case grpc::StatusCode::DEADLINE_EXCEEDED:
+      return 504;
+    case grpc::StatusCode::NOT_FOUND:
+      return 404;
+    case grpc::StatusCode::ALREADY_EXISTS:
+    case grpc::StatusCode::ABORTED:
+      return 409;
+    case grpc::StatusCode::PERMISSION_DENIED:
+      return 403;
+    case grpc::StatusCode::RESOURCE_EXHAUSTED:
+      return 429;
+    case grpc::StatusCode::UNIMPLEMENTED:
+      return 501;
+    case grpc::StatusCode::UNAVAILABLE:
+      return 503;
+    case grpc::StatusCode::UNAUTHENTICATED:
+      return 401;
+    default:
+      return 500;
+  }
+}
+
+std::string_view ReasonPhrase(int http_status) {
+  switch (http_status) {
+    case 200:
+      return "OK";
+    case 400:
+      return "Bad Request";
+    case 401:
+      return "Unauthorized";
+    case 403:
+      return "Forbidden";
+    case 404:
+      return "Not Found";
+    case 405:
+      return "Method Not Allowed";
+    case 409:
+      return "Conflict";
+    case 411:
+      return "Length Required";
+    case 413:
+      return "Content Too Large";
+    case 429:
+      return "Too Many Requests";
+    case 431:
+      return "Request Header Fields Too Large";
+    case 499:
+      return "Client Closed Request";
+    case 501:
+      return "Not Implemented";
+    case 503:
+      return "Service Unavailable";
+    case 504:
+      return "Gateway Timeout";
+    case 505:
+      return "HTTP Version Not Supported";
+    default:
+      return "Internal Server Error";
+  }
+}
+
+// Sends `parts` in order, without copying them. Returns false if the
+// connection broke.
+bool SendAll(int fd, std::initializer_list<std::string_view> parts) {
+  std::vector<iovec> iov;
+  iov.reserve(parts.size());
+  for (const std::string_view part : parts) {
+    if (!part.empty()) {
+      iov.push_back({.iov_base = const_cast<char*>(part.data()),
+                     .iov_len = part.size()});
+    }
+  }
+  size_t next = 0;
+  while (next < iov.size()) {
+    msghdr message = {};
+    message.msg_iov = &iov[next];
+    message.msg_iovlen = iov.size() - next;
+    const ssize_t sent = sendmsg(fd, &message, MSG_NOSIGNAL);
+    if (sent < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    size_t remaining = sent;
+    while (next < iov.size() && remaining >= iov[next].iov_len) {
+      remaining -= iov[next].iov_len;
+      ++next;
+    }
+    if (next < iov.size()) {
+      iov[next].iov_base = static_cast<char*>(iov[next].iov_base) + remaining;
+      iov[next].iov_len -= remaining;
+    }
+  }
+  return true;
+}
+
+// Sends a response with `body`, and the headers that Envoy adds to every
+// response. Returns false if the connection broke.
+bool SendResponse(int fd, int http_status, std::string_view content_type,
+                  std::string_view body, bool keep_alive) {
+  std::string head = absl::StrCat(
+      "HTTP/1.1 ", http_status, " ", ReasonPhrase(http_status),
+      "\r\nContent-Length: ", body.size(),
+      "\r\nAd-Auction-Allowed: true"
+      "\r\nx-fledge-bidding-signals-format-version: 2\r\n");
+  if (!content_type.empty()) {
+    absl::StrAppend(&head, "Content-Type: ", content_type, "\r\n");
+  }
+  if (!keep_alive) {
+    head.append("Connection: close\r\n");
+  }
+  head.append("\r\n");
+  return SendAll(fd, {head, body});
+}
+
+// Answers a request that can't be served. The rest of the request isn't read,
+// so the connection must be closed after.
+void SendProtocolError(int fd, int http_status) {
+  SendResponse(fd, http_status, /*content_type=*/"", /*body=*/"",
+               /*keep_alive=*/false);
+}
+
+// Appends the next bytes received to `buffer`. Returns false once the
+// connection is closed, broke or was idle for too long.
+bool ReceiveMore(int fd, std::string& buffer) {
+  char chunk[16 * 1024];
+  while (true) {
+    const ssize_t received = recv(fd, chunk, sizeof(chunk), 0);
+    if (received > 0) {
+      buffer.append(chunk, received);
+      return true;
+    }
+    if (received < 0 && errno == EINTR) {
+      continue;
+    }
+    return false;
+  }
+}
+
+// Reads a body of `length` bytes into `body`, the bytes already received in
+// `pending` first, the rest straight from the socket.
+bool ReceiveBody(int fd, int64_t length, std::string& pending,
+                 std::string& body) {
+  body.resize(length);
+  const size_t buffered = std::min<size_t>(pending.size(), length);
+  std::memcpy(body.data(), pending.data(), buffered);
+  pending.erase(0, buffered);
+  size_t offset = buffered;
+  while (offset < body.size()) {
+    const ssize_t received =
+        recv(fd, body.data() + offset, body.size() - offset, 0);
+    if (received > 0) {
+      offset += received;
+    } else if (received < 0 && errno == EINTR) {
+      continue;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Parses the request line and headers, without the empty line that ends
+// them. Returns the HTTP status to reject the request with, if it's invalid.
+std::optional<int> ParseHead(std::string_view text, RequestHead& head) {
+  std::vector<std::string_view> lines = absl::StrSplit(text, "\r\n");
+  std::vector<std::string_view> request_line =
+      absl::StrSplit(lines.front(), ' ');
+  if (request_line.size() != 3) {
+    return 400;
+  }
+  // Including the preface of HTTP/2 with prior knowledge.
+  if (request_line[2] != "HTTP/1.1" && request_line[2] != "HTTP/1.0") {
+    return 505;
+  }
+  head.method = std::string(request_line[0]);
+  head.path = std::string(request_line[1].substr(0, request_line[1].find('?')));
+  head.keep_alive = request_line[2] == "HTTP/1.1";
+  for (size_t i = 1; i < lines.size(); ++i) {
+    const size_t colon = lines[i].find(':');
+    if (colon == std::string_view::npos) {
+      return 400;
+    }
+    const std::string name = absl::AsciiStrToLower(
+        absl::StripAsciiWhitespace(lines[i].substr(0, colon)));
+    const std::string_view value =
+        absl::StripAsciiWhitespace(lines[i].substr(colon + 1));
+    if (name == "content-length") {
+      if (!absl::SimpleAtoi(value, &head.content_length) ||
+          head.content_length < 0) {
+        return 400;
+      }
+    } else if (name == "content-type") {
+      head.content_type = std::string(value);
+    } else if (name == "transfer-encoding") {
+      head.chunked = !absl::EqualsIgnoreCase(value, "identity");
+    } else if (name == "connection") {
+      const std::string options = absl::AsciiStrToLower(value);
+      if (absl::StrContains(options, "close")) {
+        head.keep_alive = false;
+      } else if (absl::StrContains(options, "keep-alive")) {
+        head.keep_alive = true;
+      }
+    } else if (name == "expect") {
+      head.expect_continue = absl::EqualsIgnoreCase(value, "100-continue");
+    }
+  }
+  return std::nullopt;
+}
+
+template <typename RequestT>
+using HandlerFunction = grpc::Status (GetValuesV2Handler::*)(
+    const RequestT&, HttpBody*, const RequestDeadline&) const;
+
+// Reads the body of the request into its `raw_body`, and answers it with the
+// response of `handler_function`. Returns false if the connection broke.
+template <typename RequestT>
+bool HandleRequest(int fd, const RequestHead& head, std::string& pending,
+                   const GetValuesV2Handler& handler,
+                   HandlerFunction<RequestT> handler_function,
+                   const NativeHttpServer::Options& options) {
+  RequestT request;
+  HttpBody* raw_body = request.mutable_raw_body();
+  raw_body->set_content_type(head.content_type);
+  if (head.expect_continue &&
+      !SendAll(fd, {"HTTP/1.1 100 Continue\r\n\r\n"})) {
+    return false;
+  }
+  if (!ReceiveBody(fd, head.content_length, pending,
+                   *raw_body->mutable_data())) {
+    return false;
+  }
+  const absl::Time request_received_time = absl::Now();
+  HttpBody response;
+  grpc::Status status;
+  if (const absl::Status admitted =
+          ServingAdmissionController().TryAdmit(options.request_timeout);
+      !admitted.ok()) {
+    status = grpc::Status(grpc::StatusCode::UNAVAILABLE,
+                          std::string(admitted.message()));
+  } else {
+    status = (handler.*handler_function)(
+        request, &response,
+        {.deadline = request_received_time + options.request_timeout});
+    const absl::Duration latency = absl::Now() - request_received_time;
+    ServingAdmissionController().Release(latency);
+    DataLoadingGovernor().RecordServingLatency(latency);
+  }
+  LogRequestCommonSafeMetrics(&request, &response, status,
+                              request_received_time);
+  if (!status.ok()) {
+    const std::string error =
+        nlohmann::json{{"code", static_cast<int>(status.error_code())},
+                       {"message", status.error_message()}}
+            .dump();
+    return SendResponse(fd, ToHttpStatus(status.error_code()),
+                        "application/json", error, head.keep_alive);
+  }
+  return SendResponse(fd, 200, response.content_type(), response.data(),
+                      head.keep_alive);
+}
+
+}  // namespace
+
+absl::StatusOr<std::unique_ptr<NativeHttpServer>> NativeHttpServer::Start(
+    const GetValuesV2Handler& handler, Options options) {
+  const int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return absl::ErrnoToStatus(errno, "Failed creating HTTP socket");
+  }
+  const int enable = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  address.sin_port = htons(options.port);
+  socklen_t address_size = sizeof(address);
+  if (bind(fd, reinterpret_cast<sockaddr*>(&address), address_size) != 0 ||
+      listen(fd, SOMAXCONN) != 0 ||
+      getsockname(fd, reinterpret_cast<sockaddr*>(&address), &address_size) !=
+          0) {
+    const int error = errno;
+    close(fd);
+    return absl::ErrnoToStatus(
+        error,
+        absl::StrCat("Failed listening for HTTP on port ", options.port));
+  }
+  const int port = ntohs(address.sin_port);
+  LOG(INFO) << "Serving HTTP on port " << port;
+  std::unique_ptr<NativeHttpServer> server(
+      new NativeHttpServer(handler, std::move(options), fd, port));
+  NativeHttpServer* const started = server.get();
+  server->acceptor_ = std::thread([started] { started->Accept(); });
+  return server;
+}
+
+NativeHttpServer::NativeHttpServer(const GetValuesV2Handler& handler,
+                                   Options options, int listen_fd, int port)
+    : handler_(handler),
+      options_(std::move(options)),
+      listen_fd_(listen_fd),
+      port_(port) {}
+
+NativeHttpServer::~NativeHttpServer() {
+  Stop();
+  close(listen_fd_);
+}
+
+void NativeHttpServer::Stop() {
+  {
+    absl::MutexLock lock(&mutex_);
+    stopped_ = true;
+    // Wakes the connections up from waiting for their next request.
+    for (const int fd : connection_fds_) {
+      shutdown(fd, SHUT_RD);
+    }
+  }
+  // Wakes the acceptor up.
+  shutdown(listen_fd_, SHUT_RDWR);
+  if (acceptor_.joinable()) {
+    acceptor_.join();
+  }
+  absl::MutexLock lock(&mutex_);
+  mutex_.Await(absl::Condition(
+      +[](absl::flat_hash_set<int>* fds) { return fds->empty(); },
+      &connection_fds_));
+}
+
+void NativeHttpServer::Accept() {
+  while (true) {
+    const int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+    absl::MutexLock lock(&mutex_);
+    if (stopped_) {
+      if (fd >= 0) {
+        close(fd);
+      }
+      return;
+    }
+    if (fd < 0) {
+      if (errno == EMFILE || errno == ENFILE) {
+        // Gives connections time to close, instead of spinning.
+        mutex_.AwaitWithTimeout(
+            absl::Condition(+[](bool* stopped) { return *stopped; },
+                            &stopped_),
+            absl::Milliseconds(10));
+      }
+      continue;
+    }
+    if (static_cast<int>(connection_fds_.size()) >= options_.max_connections) {
+      LOG_EVERY_N_SEC(WARNING, 10) << "Too many HTTP connections, closing one";
+      close(fd);
+      continue;
+    }
+    connection_fds_.insert(fd);
+    const int enable = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+    const timeval idle_timeout = absl::ToTimeval(options_.idle_timeout);
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &idle_timeout,
+               sizeof(idle_timeout));
+    std::thread([this, fd] { Serve(fd); }).detach();
+  }
+}
+
+void NativeHttpServer::Serve(int fd) {
+  // Bytes received after the requests read so far.
+  std::string pending;
+  bool keep_alive = true;
+  while (keep_alive) {
+    size_t head_size;
+    while ((head_size = pending.find("\r\n\r\n")) == std::string::npos) {
+      if (pending.size() > kMaxHeaderBytes) {
+        SendProtocolError(fd, 431);
+        keep_alive = false;
+        break;
+      }
+      if (!ReceiveMore(fd, pending)) {
+        keep_alive = false;
+        break;
+      }
+    }
+    if (!keep_alive) {
+      break;
+    }
+    RequestHead head;
+    const std::optional<int> error =
+        ParseHead(std::string_view(pending).substr(0, head_size), head);
+    pending.erase(0, head_size + 4);
+    if (error.has_value()) {
+      SendProtocolError(fd, *error);
+      break;
+    }
+    if (head.chunked) {
+      SendProtocolError(fd, 411);
+      break;
+    }
+    if (head.content_length > options_.max_body_bytes) {
+      SendProtocolError(fd, 413);
+      break;
+    }
+    const bool is_get_values = absl::EndsWith(head.path, kGetValuesPath);
+    if (!is_get_values && head.path != kBinaryHttpGetValuesPath &&
+        head.path != kObliviousGetValuesPath) {
+      SendProtocolError(fd, 404);
+      break;
+    }
+    if (head.method != (is_get_values ? "PUT" : "POST")) {
+      SendProtocolError(fd, 405);
+      break;
+    }
+    bool served;
+    if (is_get_values) {
+      served = HandleRequest(fd, head, pending, handler_,
+                             &GetValuesV2Handler::GetValuesHttp, options_);
+    } else if (head.path == kBinaryHttpGetValuesPath) {
+      served = HandleRequest(fd, head, pending, handler_,
+                             &GetValuesV2Handler::BinaryHttpGetValues,
+                             options_);
+    } else {
+      served = HandleRequest(fd, head, pending, handler_,
+                             &GetValuesV2Handler::ObliviousGetValues, options_);
+    }
+    keep_alive = served && head.keep_alive;
+  }
+  absl::MutexLock lock(&mutex_);
+  connection_fds_.erase(fd);
+  close(fd);
+}
+
+}  // namespace kv_server
@@ -0,0 +1,99 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_SERVER_NATIVE_HTTP_SERVER_H_
+#define COMPONENTS_DATA_SERVER_SERVER_NATIVE_HTTP_SERVER_H_
+
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "components/data_server/request_handler/get_values_v2_handler.h"
+
+namespace kv_server {
+
+// Serves the HTTP routes of the v2 API, that Envoy otherwise transcodes into
+// gRPC calls, straight from a `GetValuesV2Handler`:
+//
+//   PUT  /v2/getvalues, or any path ending in it  GetValuesHttp
+//   POST /v2/bhttp_getvalues                      BinaryHttpGetValues
+//   POST /v2/oblivious_getvalues                  ObliviousGetValues
+//
+// The body of a request is read straight into the `raw_body` of its request
+// proto, and the body of its response is sent from the response proto, so
+// neither is copied on the way. Failed calls get the HTTP status and the JSON
+// error body that Envoy would answer with.
+//
+// Speaks HTTP/1.1, with persistent connections and one thread per connection.
+// Requests must have a Content-Length.
+class NativeHttpServer {
+ public:
+  struct Options {
+    // 0 listens on a free port, see `port`.
+    int port = 0;
+    // Connections beyond this many are closed right away.
+    int max_connections = 256;
+    // As the buffer limit of the Envoy listener.
+    int64_t max_body_bytes = 50 * 1024 * 1024;
+    // Time that a request gets to be served, as the route timeout of Envoy.
+    absl::Duration request_timeout = absl::Seconds(60);
+    // Connections without a request for this long are closed.
+    absl::Duration idle_timeout = absl::Seconds(60);
+  };
+
+  // Listens on `options.port` of every address. `handler` must outlive the
+  // server.
+  static absl::StatusOr<std::unique_ptr<NativeHttpServer>> Start(
+      const GetValuesV2Handler& handler, Options options);
+
+  NativeHttpServer(const NativeHttpServer&) = delete;
+  NativeHttpServer& operator=(const NativeHttpServer&) = delete;
+
+  ~NativeHttpServer();
+
+  // Port that the server listens on.
+  int port() const { return port_; }
+
+  // Stops accepting connections, and waits for the requests being served.
+  // Open connections are closed once their current request is answered.
+  void Stop() ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  NativeHttpServer(const GetValuesV2Handler& handler, Options options,
+                   int listen_fd, int port);
+
+  void Accept() ABSL_LOCKS_EXCLUDED(mutex_);
+  void Serve(int fd) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  const GetValuesV2Handler& handler_;
+  const Options options_;
+  const int listen_fd_;
+  const int port_;
+  std::thread acceptor_;
+  absl::Mutex mutex_;
+  bool stopped_ ABSL_GUARDED_BY(mutex_) = false;
+  // Sockets of the open connections, each served by its own thread.
+  absl::flat_hash_set<int> connection_fds_ ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_SERVER_NATIVE_HTTP_SERVER_H_
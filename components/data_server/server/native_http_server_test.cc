@@ -0,0 +1,138 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data_server/server/native_http_server.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+#include <string_view>
+
+#include "absl/strings/str_cat.h"
+#include "components/udf/mocks.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "src/encryption/key_fetcher/fake_key_fetcher_manager.h"
+
+namespace kv_server {
+namespace {
+
+using testing::_;
+using testing::HasSubstr;
+using testing::Return;
+using testing::StartsWith;
+
+// Sends `request` to the server on `port`, and returns everything it answers
+// until it closes the connection.
+std::string Exchange(int port, std::string_view request) {
+  const int fd = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  EXPECT_EQ(
+      connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)), 0);
+  EXPECT_EQ(send(fd, request.data(), request.size(), 0), request.size());
+  shutdown(fd, SHUT_WR);
+  std::string response;
+  char buffer[4096];
+  ssize_t received;
+  while ((received = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+    response.append(buffer, received);
+  }
+  close(fd);
+  return response;
+}
+
+class NativeHttpServerTest : public ::testing::Test {
+ protected:
+  void SetUp() override { InitMetricsContextMap(); }
+
+  MockUdfClient mock_udf_client_;
+  privacy_sandbox::server_common::FakeKeyFetcherManager
+      fake_key_fetcher_manager_;
+  GetValuesV2Handler handler_{mock_udf_client_, fake_key_fetcher_manager_};
+};
+
+TEST_F(NativeHttpServerTest, ServesGetValuesOverPersistentConnection) {
+  EXPECT_CALL(mock_udf_client_, ExecuteCode(_, _, _))
+      .Times(2)
+      .WillRepeatedly(Return("udf output"));
+  auto server = NativeHttpServer::Start(handler_, {});
+  ASSERT_TRUE(server.ok()) << server.status();
+
+  constexpr std::string_view kBody =
+      R"({"partitions": [{"id": 0, "arguments": [{"data": "key"}]}]})";
+  const std::string request = absl::StrCat(
+      "PUT /v2/getvalues HTTP/1.1\r\nContent-Length: ", kBody.size(),
+      "\r\n\r\n", kBody);
+  const std::string response = Exchange((*server)->port(), request + request);
+  EXPECT_THAT(response, StartsWith("HTTP/1.1 200 OK\r\n"));
+  EXPECT_THAT(response, HasSubstr("Ad-Auction-Allowed: true\r\n"));
+  // Both requests were answered on the same connection.
+  const size_t second = response.find("HTTP/1.1 200 OK", 1);
+  ASSERT_NE(second, std::string::npos);
+  EXPECT_THAT(response.substr(second), HasSubstr("udf output"));
+}
+
+TEST_F(NativeHttpServerTest, InvalidRequestGetsTranscoderError) {
+  auto server = NativeHttpServer::Start(handler_, {});
+  ASSERT_TRUE(server.ok()) << server.status();
+  const std::string response =
+      Exchange((*server)->port(),
+               "PUT /v2/getvalues HTTP/1.1\r\nContent-Length: 3\r\n\r\n{{{");
+  EXPECT_THAT(response, StartsWith("HTTP/1.1 400 Bad Request\r\n"));
+  EXPECT_THAT(response, HasSubstr(R"({"code":3,"message":)"));
+}
+
+TEST_F(NativeHttpServerTest, RejectsUnknownRoutesAndMethods) {
+  auto server = NativeHttpServer::Start(handler_, {});
+  ASSERT_TRUE(server.ok()) << server.status();
+  EXPECT_THAT(Exchange((*server)->port(), "PUT /v1/getvalues HTTP/1.1\r\n\r\n"),
+              StartsWith("HTTP/1.1 404 "));
+  EXPECT_THAT(Exchange((*server)->port(), "GET /v2/getvalues HTTP/1.1\r\n\r\n"),
+              StartsWith("HTTP/1.1 405 "));
+  EXPECT_THAT(Exchange((*server)->port(),
+                       "POST /v2/oblivious_getvalues HTTP/1.1\r\n"
+                       "Transfer-Encoding: chunked\r\n\r\n"),
+              StartsWith("HTTP/1.1 411 "));
+  EXPECT_THAT(Exchange((*server)->port(), "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n"),
+              StartsWith("HTTP/1.1 505 "));
+}
+
+TEST_F(NativeHttpServerTest, StopClosesIdleConnections) {
+  auto server = NativeHttpServer::Start(handler_, {});
+  ASSERT_TRUE(server.ok()) << server.status();
+  const int fd = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_port = htons((*server)->port());
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  ASSERT_EQ(
+      connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)), 0);
+  // Returns although the connection never sends a request.
+  (*server)->Stop();
+  // Closed, or reset if the server stopped before accepting it.
+  char byte;
+  EXPECT_LE(recv(fd, &byte, 1, 0), 0);
+  close(fd);
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -18,8 +18,12 @@
 #include <utility>
 #include <vector>
 
+#include "absl/log/log.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/str_join.h"
 #include "components/errors/retry.h"
+#include "components/util/startup_report.h"
 #include "public/constants.h"
 
 namespace kv_server {
@@ -35,6 +39,8 @@ ParameterFetcher::ParameterFetcher(
 std::string ParameterFetcher::GetParameter(
     std::string_view parameter_suffix,
     std::optional<std::string> default_value) const {
+  StartupReport::ScopedPhase startup_phase(ServerStartupReport(),
+                                           kStartupParameterFetchPhase);
   const std::string param_name = GetParamName(parameter_suffix);
   return TraceRetryUntilOk(
       [this, &param_name, &default_value] {
@@ -45,6 +51,8 @@ std::string ParameterFetcher::GetParameter(
 
 int32_t ParameterFetcher::GetInt32Parameter(
     std::string_view parameter_suffix) const {
+  StartupReport::ScopedPhase startup_phase(ServerStartupReport(),
+                                           kStartupParameterFetchPhase);
   const std::string param_name = GetParamName(parameter_suffix);
   return TraceRetryUntilOk(
       [this, &param_name] {
@@ -55,6 +63,8 @@ int32_t ParameterFetcher::GetInt32Parameter(
 
 bool ParameterFetcher::GetBoolParameter(
     std::string_view parameter_suffix) const {
+  StartupReport::ScopedPhase startup_phase(ServerStartupReport(),
+                                           kStartupParameterFetchPhase);
   const std::string param_name = GetParamName(parameter_suffix);
   return TraceRetryUntilOk(
       [this, &param_name] {
@@ -63,6 +73,32 @@ bool ParameterFetcher::GetBoolParameter(
       "GetParameter", metrics_callback_, {{"param", param_name}});
 }
 
+std::vector<std::string> ParameterFetcher::GetParamNames(
+    absl::Span<const std::string_view> parameter_suffixes) const {
+  std::vector<std::string> param_names;
+  param_names.reserve(parameter_suffixes.size());
+  for (const auto parameter_suffix : parameter_suffixes) {
+    param_names.push_back(GetParamName(parameter_suffix));
+  }
+  return param_names;
+}
+
+int64_t GetOptionalInt64Parameter(const ParameterFetcher& parameter_fetcher,
+                                  std::string_view parameter_suffix,
+                                  int64_t default_value) {
+  const std::string value = parameter_fetcher.GetParameter(
+      parameter_suffix, /*default_value=*/absl::StrCat(default_value));
+  int64_t result;
+  if (!absl::SimpleAtoi(value, &result)) {
+    LOG(ERROR) << "Failed converting " << parameter_suffix
+               << " parameter: " << value << " to int64. Using default value "
+               << default_value;
+    return default_value;
+  }
+  LOG(INFO) << "Retrieved " << parameter_suffix << " parameter: " << result;
+  return result;
+}
+
 std::string ParameterFetcher::GetParamName(
     std::string_view parameter_suffix) const {
   const std::vector<std::string_view> v = {kServiceName, environment_,
@@ -23,8 +23,10 @@
 #include <string>
 #include <string_view>
 #include <utility>
+#include <vector>
 
 #include "absl/status/statusor.h"
+#include "absl/types/span.h"
 #include "components/cloud_config/parameter_client.h"
 #include "components/data/blob_storage/blob_storage_change_notifier.h"
 #include "components/data/blob_storage/blob_storage_client.h"
@@ -53,6 +55,11 @@ class ParameterFetcher {
   // This function will retry any necessary requests until it succeeds.
   virtual bool GetBoolParameter(std::string_view parameter_suffix) const;
 
+  // Returns the full names of the parameters with `parameter_suffixes`, such
+  // as to prefetch them.
+  std::vector<std::string> GetParamNames(
+      absl::Span<const std::string_view> parameter_suffixes) const;
+
   virtual NotifierMetadata GetBlobStorageNotifierMetadata() const;
 
   virtual BlobStorageClient::ClientOptions GetBlobStorageClientOptions() const;
@@ -69,6 +76,12 @@ class ParameterFetcher {
       metrics_callback_;
 };
 
+// Returns the value of an optional int64 parameter, or `default_value` if the
+// parameter is not set or can't be parsed.
+int64_t GetOptionalInt64Parameter(const ParameterFetcher& parameter_fetcher,
+                                  std::string_view parameter_suffix,
+                                  int64_t default_value);
+
 }  // namespace kv_server
 
 #endif  // COMPONENTS_DATA_SERVER_SERVER_PARAMETER_FETCHER_H_
@@ -36,6 +36,11 @@ constexpr std::string_view kS3ClientMaxConnectionsParameterSuffix =
 constexpr std::string_view kS3ClientMaxRangeBytesParameterSuffix =
     "s3client-max-range-bytes";
 
+// Number of byte ranges of a blob that AWS's blob storage client downloads
+// concurrently ahead of the reader
+constexpr std::string_view kS3ClientReadAheadChunksParameterSuffix =
+    "s3client-read-ahead-chunks";
+
 NotifierMetadata ParameterFetcher::GetBlobStorageNotifierMetadata() const {
   std::string bucket_sns_arn =
       GetParameter(kDataLoadingFileChannelBucketSNSParameterSuffix);
@@ -55,6 +60,9 @@ BlobStorageClient::ClientOptions ParameterFetcher::GetBlobStorageClientOptions()
       GetInt32Parameter(kS3ClientMaxRangeBytesParameterSuffix);
   LOG(INFO) << "Retrieved " << kS3ClientMaxRangeBytesParameterSuffix
             << " parameter: " << client_options.max_range_bytes;
+  client_options.read_ahead_chunks = GetOptionalInt64Parameter(
+      *this, kS3ClientReadAheadChunksParameterSuffix,
+      /*default_value=*/client_options.read_ahead_chunks);
   return client_options;
 }
 
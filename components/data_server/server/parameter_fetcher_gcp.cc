@@ -26,6 +26,23 @@ constexpr std::string_view kEnvironment = "environment";
 constexpr std::string_view kProjectId = "project-id";
 constexpr std::string_view kRealtimeUpdaterThreadNumberParameterSuffix =
     "realtime-updater-num-threads";
+constexpr std::string_view kRealtimeUpdaterMaxOutstandingMessagesSuffix =
+    "realtime-updater-max-outstanding-messages";
+constexpr std::string_view kRealtimeUpdaterMaxOutstandingBytesSuffix =
+    "realtime-updater-max-outstanding-bytes";
+// Tuning of the connections and byte range downloads of GCP's blob storage
+// client.
+constexpr std::string_view kGcsClientMaxConnectionsParameterSuffix =
+    "gcsclient-max-connections";
+constexpr std::string_view kGcsClientMaxRangeBytesParameterSuffix =
+    "gcsclient-max-range-bytes";
+constexpr std::string_view kGcsClientReadAheadChunksParameterSuffix =
+    "gcsclient-read-ahead-chunks";
+constexpr std::string_view kGcsClientSocketReceiveBufferBytesParameterSuffix =
+    "gcsclient-socket-receive-buffer-bytes";
+constexpr std::string_view kGcsClientSocketSendBufferBytesParameterSuffix =
+    "gcsclient-socket-send-buffer-bytes";
+
 NotifierMetadata ParameterFetcher::GetBlobStorageNotifierMetadata() const {
   // TODO: set to proper values. Waiting on the change notifier implementation.
   return GcpNotifierMetadata{};
@@ -33,7 +50,23 @@ NotifierMetadata ParameterFetcher::GetBlobStorageNotifierMetadata() const {
 
 BlobStorageClient::ClientOptions ParameterFetcher::GetBlobStorageClientOptions()
     const {
-  return BlobStorageClient::ClientOptions();
+  BlobStorageClient::ClientOptions client_options;
+  client_options.max_connections = GetOptionalInt64Parameter(
+      *this, kGcsClientMaxConnectionsParameterSuffix,
+      /*default_value=*/client_options.max_connections);
+  client_options.max_range_bytes = GetOptionalInt64Parameter(
+      *this, kGcsClientMaxRangeBytesParameterSuffix,
+      /*default_value=*/client_options.max_range_bytes);
+  client_options.read_ahead_chunks = GetOptionalInt64Parameter(
+      *this, kGcsClientReadAheadChunksParameterSuffix,
+      /*default_value=*/client_options.read_ahead_chunks);
+  client_options.socket_receive_buffer_bytes = GetOptionalInt64Parameter(
+      *this, kGcsClientSocketReceiveBufferBytesParameterSuffix,
+      /*default_value=*/0);
+  client_options.socket_send_buffer_bytes = GetOptionalInt64Parameter(
+      *this, kGcsClientSocketSendBufferBytesParameterSuffix,
+      /*default_value=*/0);
+  return client_options;
 }
 
 NotifierMetadata ParameterFetcher::GetRealtimeNotifierMetadata(
@@ -55,6 +88,12 @@ NotifierMetadata ParameterFetcher::GetRealtimeNotifierMetadata(
       .num_threads = realtime_thread_numbers,
       .num_shards = num_shards,
       .shard_num = shard_num,
+      .max_outstanding_messages = GetOptionalInt64Parameter(
+          *this, kRealtimeUpdaterMaxOutstandingMessagesSuffix,
+          /*default_value=*/0),
+      .max_outstanding_bytes = GetOptionalInt64Parameter(
+          *this, kRealtimeUpdaterMaxOutstandingBytesSuffix,
+          /*default_value=*/0),
   };
 }
 
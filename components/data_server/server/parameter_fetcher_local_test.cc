@@ -39,6 +39,15 @@ TEST(ParameterFetcherTest, CreateChangeNotifierSmokeTest) {
   EXPECT_EQ(::testing::TempDir(), local_notifier_metadata.local_directory);
 }
 
+TEST(ParameterFetcherTest, GetParamNames) {
+  MockParameterClient client;
+  ParameterFetcher fetcher(
+      /*environment=*/"local", client);
+  EXPECT_THAT(fetcher.GetParamNames({"directory", "realtime-directory"}),
+              testing::ElementsAre("kv-server-local-directory",
+                                   "kv-server-local-realtime-directory"));
+}
+
 TEST(ParameterFetcherTest, CreateDeltaFileRecordChangeNotifierSmokeTest) {
   MockParameterClient client;
   EXPECT_CALL(client, GetParameter("kv-server-local-realtime-directory",
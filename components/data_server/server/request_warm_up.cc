@@ -0,0 +1,128 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data_server/server/request_warm_up.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
+#include "riegeli/bytes/istream_reader.h"
+#include "riegeli/records/record_reader.h"
+#include "tools/request_simulation/request/raw_request.pb.h"
+#include "tools/request_simulation/request_generation_util.h"
+
+namespace kv_server {
+namespace {
+
+// Returns the bodies of the first `max_requests` requests of the trace at
+// `path`.
+absl::StatusOr<std::vector<std::string>> ReadRequestBodies(
+    const std::string& path, int max_requests) {
+  std::ifstream stream(path, std::ios::binary);
+  if (!stream.is_open()) {
+    return absl::NotFoundError(
+        absl::StrCat("Cannot open warm-up requests file ", path));
+  }
+  riegeli::RecordReader record_reader(riegeli::IStreamReader(&stream));
+  std::vector<std::string> bodies;
+  RecordedRequest recorded_request;
+  while (static_cast<int>(bodies.size()) < max_requests &&
+         record_reader.ReadRecord(recorded_request)) {
+    bodies.push_back(std::move(*recorded_request.mutable_request()
+                                    ->mutable_raw_body()
+                                    ->mutable_data()));
+  }
+  if (!record_reader.Close()) {
+    return record_reader.status();
+  }
+  if (bodies.empty()) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("No requests in warm-up requests file ", path));
+  }
+  return bodies;
+}
+
+std::vector<std::string> RandomRequestBodies(
+    const RequestWarmUpOptions& options) {
+  std::vector<std::string> bodies;
+  bodies.reserve(options.num_requests);
+  for (int i = 0; i < options.num_requests; ++i) {
+    bodies.push_back(CreateKVDSPRequestBodyInJson(GenerateRandomKeys(
+        options.random_request_num_keys, options.random_request_key_size)));
+  }
+  return bodies;
+}
+
+}  // namespace
+
+absl::StatusOr<RequestWarmUpStats> WarmUpWithRequests(
+    v2::KeyValueService::StubInterface& stub,
+    const RequestWarmUpOptions& options) {
+  if (options.num_requests <= 0) {
+    return RequestWarmUpStats{};
+  }
+  std::vector<std::string> bodies;
+  if (options.requests_file.empty()) {
+    bodies = RandomRequestBodies(options);
+  } else {
+    auto maybe_bodies =
+        ReadRequestBodies(options.requests_file, options.num_requests);
+    if (!maybe_bodies.ok()) {
+      return maybe_bodies.status();
+    }
+    bodies = *std::move(maybe_bodies);
+  }
+  const absl::Time start = absl::Now();
+  const absl::Time deadline = start + options.timeout;
+  std::atomic<int64_t> next_request = 0;
+  std::atomic<int64_t> num_requests = 0;
+  std::atomic<int64_t> num_failed_requests = 0;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < std::max(options.concurrency, 1); ++i) {
+    threads.emplace_back([&] {
+      for (int64_t request_index = next_request++;
+           request_index < options.num_requests && absl::Now() < deadline;
+           request_index = next_request++) {
+        grpc::ClientContext context;
+        context.set_deadline(absl::ToChronoTime(deadline));
+        v2::GetValuesHttpRequest request;
+        request.mutable_raw_body()->set_data(
+            bodies[request_index % bodies.size()]);
+        google::api::HttpBody response;
+        if (!stub.GetValuesHttp(&context, request, &response).ok()) {
+          ++num_failed_requests;
+        }
+        ++num_requests;
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  return RequestWarmUpStats{
+      .num_requests = num_requests,
+      .num_failed_requests = num_failed_requests,
+      .duration = absl::Now() - start,
+  };
+}
+
+}  // namespace kv_server
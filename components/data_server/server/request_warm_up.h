@@ -0,0 +1,65 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_DATA_SERVER_SERVER_REQUEST_WARM_UP_H_
+#define COMPONENTS_DATA_SERVER_SERVER_REQUEST_WARM_UP_H_
+
+#include <cstdint>
+#include <string>
+
+#include "absl/status/statusor.h"
+#include "absl/time/time.h"
+#include "public/query/v2/get_values_v2.grpc.pb.h"
+
+namespace kv_server {
+
+struct RequestWarmUpOptions {
+  // Requests sent. 0 disables the warm-up.
+  int num_requests = 0;
+  // Requests in flight at once.
+  int concurrency = 1;
+  // The warm-up stops sending requests once it has run this long.
+  absl::Duration timeout = absl::Seconds(30);
+  // Local Riegeli file of `RecordedRequest`s, such as a trace replayed by the
+  // request simulation, whose requests are sent in order, looping over the
+  // file if it has fewer than `num_requests`. Empty sends requests for random
+  // keys instead.
+  std::string requests_file;
+  // Keys looked up by each random request, and their size.
+  int random_request_num_keys = 10;
+  int random_request_key_size = 32;
+};
+
+struct RequestWarmUpStats {
+  int64_t num_requests = 0;
+  int64_t num_failed_requests = 0;
+  absl::Duration duration;
+};
+
+// Sends sample `GetValuesHttp` requests to the server behind `stub` before it
+// reports healthy, so that the first requests it serves don't pay for the
+// cold CPU caches, gRPC threads, Roma workers, connections to other shards
+// and pages of data that the warm-up requests go through.
+//
+// Failed requests are counted, they don't fail the warm-up. Returns an error
+// if the requests file can't be read.
+absl::StatusOr<RequestWarmUpStats> WarmUpWithRequests(
+    v2::KeyValueService::StubInterface& stub,
+    const RequestWarmUpOptions& options);
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_DATA_SERVER_SERVER_REQUEST_WARM_UP_H_
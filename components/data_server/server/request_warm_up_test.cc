@@ -0,0 +1,152 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/data_server/server/request_warm_up.h"
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "gmock/gmock.h"
+#include "grpcpp/grpcpp.h"
+#include "gtest/gtest.h"
+#include "riegeli/bytes/ostream_writer.h"
+#include "riegeli/records/record_writer.h"
+#include "tools/request_simulation/request/raw_request.pb.h"
+
+namespace kv_server {
+namespace {
+
+using testing::ElementsAre;
+using testing::SizeIs;
+
+// Keeps the bodies of the requests it receives, and fails those whose body
+// is "fail".
+class RecordingService : public v2::KeyValueService::Service {
+ public:
+  grpc::Status GetValuesHttp(grpc::ServerContext* context,
+                             const v2::GetValuesHttpRequest* request,
+                             google::api::HttpBody* response) override {
+    absl::MutexLock lock(&mutex_);
+    bodies_.push_back(request->raw_body().data());
+    if (request->raw_body().data() == "fail") {
+      return grpc::Status(grpc::StatusCode::INTERNAL, "failed");
+    }
+    return grpc::Status::OK;
+  }
+
+  std::vector<std::string> bodies() {
+    absl::MutexLock lock(&mutex_);
+    return bodies_;
+  }
+
+ private:
+  absl::Mutex mutex_;
+  std::vector<std::string> bodies_ ABSL_GUARDED_BY(mutex_);
+};
+
+std::string WriteRequests(const std::vector<std::string>& bodies) {
+  const std::string requests_file =
+      absl::StrCat(::testing::TempDir(), "/warm_up_requests");
+  std::ofstream stream(requests_file, std::ios::binary);
+  riegeli::RecordWriter record_writer(riegeli::OStreamWriter(&stream));
+  for (const auto& body : bodies) {
+    RecordedRequest recorded_request;
+    recorded_request.mutable_request()->mutable_raw_body()->set_data(body);
+    EXPECT_TRUE(record_writer.WriteRecord(recorded_request));
+  }
+  EXPECT_TRUE(record_writer.Close());
+  return requests_file;
+}
+
+class RequestWarmUpTest : public ::testing::Test {
+ protected:
+  RequestWarmUpTest() {
+    grpc::ServerBuilder builder;
+    builder.RegisterService(&service_);
+    server_ = builder.BuildAndStart();
+    stub_ = v2::KeyValueService::NewStub(
+        server_->InProcessChannel(grpc::ChannelArguments()));
+  }
+
+  ~RequestWarmUpTest() {
+    server_->Shutdown();
+    server_->Wait();
+  }
+
+  RecordingService service_;
+  std::unique_ptr<grpc::Server> server_;
+  std::unique_ptr<v2::KeyValueService::Stub> stub_;
+};
+
+TEST_F(RequestWarmUpTest, SendsRandomRequests) {
+  const auto stats =
+      WarmUpWithRequests(*stub_, {.num_requests = 20, .concurrency = 4});
+  ASSERT_TRUE(stats.ok()) << stats.status();
+  EXPECT_EQ(stats->num_requests, 20);
+  EXPECT_EQ(stats->num_failed_requests, 0);
+  const std::vector<std::string> bodies = service_.bodies();
+  ASSERT_THAT(bodies, SizeIs(20));
+  EXPECT_NE(bodies[0], bodies[1]);
+}
+
+TEST_F(RequestWarmUpTest, ReplaysRequestsFileInLoop) {
+  const std::string requests_file = WriteRequests({"request0", "request1"});
+  const auto stats = WarmUpWithRequests(
+      *stub_, {.num_requests = 5, .requests_file = requests_file});
+  ASSERT_TRUE(stats.ok()) << stats.status();
+  EXPECT_EQ(stats->num_requests, 5);
+  EXPECT_THAT(service_.bodies(),
+              ElementsAre("request0", "request1", "request0", "request1",
+                          "request0"));
+}
+
+TEST_F(RequestWarmUpTest, CountsFailedRequests) {
+  const std::string requests_file = WriteRequests({"request0", "fail"});
+  const auto stats = WarmUpWithRequests(
+      *stub_, {.num_requests = 4, .requests_file = requests_file});
+  ASSERT_TRUE(stats.ok()) << stats.status();
+  EXPECT_EQ(stats->num_requests, 4);
+  EXPECT_EQ(stats->num_failed_requests, 2);
+}
+
+TEST_F(RequestWarmUpTest, MissingRequestsFileFails) {
+  const auto stats = WarmUpWithRequests(
+      *stub_, {.num_requests = 5,
+               .requests_file = absl::StrCat(::testing::TempDir(), "/none")});
+  EXPECT_FALSE(stats.ok());
+  EXPECT_THAT(service_.bodies(), SizeIs(0));
+}
+
+TEST_F(RequestWarmUpTest, DisabledWarmUpSendsNothing) {
+  const auto stats = WarmUpWithRequests(*stub_, {});
+  ASSERT_TRUE(stats.ok()) << stats.status();
+  EXPECT_EQ(stats->num_requests, 0);
+  EXPECT_THAT(service_.bodies(), SizeIs(0));
+}
+
+TEST_F(RequestWarmUpTest, StopsAtTimeout) {
+  const auto stats = WarmUpWithRequests(
+      *stub_, {.num_requests = 100, .timeout = absl::ZeroDuration()});
+  ASSERT_TRUE(stats.ok()) << stats.status();
+  EXPECT_EQ(stats->num_requests, 0);
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -14,36 +14,77 @@
 
 #include "components/data_server/server/server.h"
 
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iterator>
+#include <memory>
 #include <optional>
+#include <vector>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/flags/flag.h"
 #include "absl/flags/parse.h"
 #include "absl/flags/usage.h"
+#include "absl/functional/any_invocable.h"
 #include "absl/functional/bind_front.h"
 #include "absl/log/log.h"
 #include "absl/log/log_sink_registry.h"
 #include "absl/status/status.h"
 #include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "components/cloud_config/caching_parameter_client.h"
 #include "components/data/blob_storage/blob_prefix_allowlist.h"
+#include "components/data/blob_storage/caching_blob_storage_client.h"
+#include "components/data/realtime/adaptive_concurrency_limit.h"
+#include "components/data_server/cache/arena_key_value_cache.h"
+#include "components/data_server/cache/cache_mutex_lock.h"
+#include "components/data_server/cache/dictionary_key_value_cache.h"
+#include "components/data_server/cache/fixed_width_key_cache.h"
+#include "components/data_server/cache/huge_pages.h"
+#include "components/data_server/cache/interned_key_value_set_cache.h"
+#include "components/data_server/cache/key_value_cache.h"
+#include "components/data_server/cache/rcu_key_value_cache.h"
+#include "components/data_server/cache/numa_key_value_cache.h"
+#include "components/data_server/cache/numa_topology.h"
+#include "components/data_server/cache/prefix_indexed_cache.h"
+#include "components/data_server/cache/sharded_key_value_cache.h"
+#include "components/data_server/cache/tiered_key_value_cache.h"
+#include "components/data_server/cache/uint32_set_cache.h"
+#include "components/data_server/cache/value_codec.h"
+#include "components/data_server/data_loading/data_freshness.h"
+#include "components/data_server/request_handler/compression.h"
 #include "components/data_server/request_handler/get_values_adapter.h"
 #include "components/data_server/request_handler/get_values_handler.h"
 #include "components/data_server/request_handler/get_values_v2_handler.h"
+#include "components/data_server/request_handler/udf_output_cache.h"
 #include "components/data_server/server/key_fetcher_factory.h"
 #include "components/data_server/server/key_value_service_impl.h"
 #include "components/data_server/server/key_value_service_v2_impl.h"
+#include "components/data_server/server/request_warm_up.h"
 #include "components/errors/retry.h"
 #include "components/internal_server/constants.h"
+#include "components/internal_server/hot_key_cache.h"
 #include "components/internal_server/local_lookup.h"
+#include "components/internal_server/lookup_response_cache.h"
 #include "components/internal_server/lookup_server_impl.h"
+#include "components/internal_server/shard_circuit_breaker.h"
 #include "components/internal_server/sharded_lookup.h"
 #include "components/sharding/cluster_mappings_manager.h"
 #include "components/telemetry/kv_telemetry.h"
 #include "components/telemetry/server_definition.h"
 #include "components/udf/hooks/get_values_hook.h"
 #include "components/udf/hooks/run_query_hook.h"
+#include "components/udf/noop_udf_client.h"
 #include "components/udf/udf_config_builder.h"
+#include "components/util/admission_controller.h"
 #include "components/util/build_info.h"
+#include "components/util/load_governor.h"
+#include "components/util/memory_releaser.h"
+#include "components/util/request_tracing.h"
+#include "components/util/startup_report.h"
 #include "google/protobuf/text_format.h"
+#include "google/protobuf/util/json_util.h"
 #include "grpcpp/ext/proto_server_reflection_plugin.h"
 #include "grpcpp/health_check_service_interface.h"
 #include "public/constants.h"
@@ -74,6 +115,8 @@ using privacy_sandbox::server_common::telemetry::BuildDependentConfig;
 constexpr absl::string_view kDataBucketParameterSuffix = "data-bucket-id";
 constexpr absl::string_view kBackupPollFrequencySecsParameterSuffix =
     "backup-poll-frequency-secs";
+constexpr std::string_view kDeltaFileNotificationsTrustedParameterSuffix =
+    "delta-file-notifications-trusted";
 constexpr absl::string_view kUseExternalMetricsCollectorEndpointSuffix =
     "use-external-metrics-collector-endpoint";
 constexpr absl::string_view kMetricsCollectorEndpointSuffix =
@@ -84,6 +127,8 @@ constexpr absl::string_view kMetricsExportTimeoutMillisParameterSuffix =
     "metrics-export-timeout-millis";
 constexpr absl::string_view kRealtimeUpdaterThreadNumberParameterSuffix =
     "realtime-updater-num-threads";
+constexpr std::string_view kRealtimeUpdaterMinThreadsParameterSuffix =
+    "realtime-updater-min-threads";
 constexpr absl::string_view kDataLoadingNumThreadsParameterSuffix =
     "data-loading-num-threads";
 constexpr absl::string_view kDataLoadingFileFormatSuffix =
@@ -100,16 +145,340 @@ constexpr absl::string_view kUseShardingKeyRegexParameterSuffix =
     "use-sharding-key-regex";
 constexpr absl::string_view kShardingKeyRegexParameterSuffix =
     "sharding-key-regex";
+constexpr std::string_view kShardingHashVersionParameterSuffix =
+    "sharding-hash-version";
+constexpr std::string_view kNumLogicalShardsParameterSuffix =
+    "num-logical-shards";
 constexpr absl::string_view kRouteV1ToV2Suffix = "route-v1-to-v2";
 constexpr absl::string_view kAddMissingKeysV1Suffix = "add-missing-keys-v1";
 constexpr absl::string_view kAutoscalerHealthcheck = "autoscaler-healthcheck";
 constexpr absl::string_view kLoadbalancerHealthcheck =
     "loadbalancer-healthcheck";
+// Serving once the delta files found on start are loaded. Only differs from
+// the load balancer health check if the server serves before it catches up.
+constexpr absl::string_view kDeltaCatchUpHealthcheck =
+    "delta-catch-up-healthcheck";
+// How long the startup waits for the UDF code objects of the data files,
+// which are loaded in the background, before reporting ready anyway.
+constexpr absl::Duration kStartupUdfCodeObjectLoadTimeout = absl::Minutes(5);
 constexpr absl::string_view kEnableOtelLoggerParameterSuffix =
     "enable-otel-logger";
 constexpr std::string_view kDataLoadingBlobPrefixAllowlistSuffix =
     "data-loading-blob-prefix-allowlist";
 constexpr std::string_view kTelemetryConfigSuffix = "telemetry-config";
+constexpr std::string_view kCacheNumShardsParameterSuffix = "cache-num-shards";
+constexpr std::string_view kCacheTypeParameterSuffix = "cache-type";
+constexpr std::string_view kRcuCacheType = "rcu";
+constexpr std::string_view kArenaCacheType = "arena";
+constexpr std::string_view kTieredCacheType = "tiered";
+constexpr std::string_view kDictionaryCacheType = "dictionary";
+constexpr std::string_view kCacheHugePagesParameterSuffix = "cache-huge-pages";
+constexpr std::string_view kCacheColdTierDirectoryParameterSuffix =
+    "cache-cold-tier-directory";
+constexpr std::string_view kCacheHotTierMaxMbParameterSuffix =
+    "cache-hot-tier-max-mb";
+constexpr std::string_view kCacheImagePathParameterSuffix = "cache-image-path";
+constexpr std::string_view kCacheImageIntervalMinutesParameterSuffix =
+    "cache-image-interval-minutes";
+constexpr std::string_view kHotKeyCacheMaxKeysParameterSuffix =
+    "hot-key-cache-max-keys";
+constexpr std::string_view kHotKeyCacheTtlMillisParameterSuffix =
+    "hot-key-cache-ttl-millis";
+constexpr std::string_view kCacheNumaModeParameterSuffix = "cache-numa-mode";
+constexpr std::string_view kReplicatedNumaMode = "replicated";
+constexpr std::string_view kCacheSetStorageParameterSuffix =
+    "cache-set-storage";
+constexpr std::string_view kInternedSetStorage = "interned";
+constexpr std::string_view kCacheSetLockStripesParameterSuffix =
+    "cache-set-lock-stripes";
+constexpr std::string_view kCacheIndexedKeyPrefixesParameterSuffix =
+    "cache-indexed-key-prefixes";
+constexpr std::string_view kCacheMembershipIndexKeyPrefixesParameterSuffix =
+    "cache-membership-index-key-prefixes";
+constexpr std::string_view kCacheMembershipIndexMaxEntriesParameterSuffix =
+    "cache-membership-index-max-entries";
+constexpr std::string_view kCacheFixedWidthKeyPrefixesParameterSuffix =
+    "cache-fixed-width-key-prefixes";
+constexpr std::string_view kCacheCleanupSliceMillisParameterSuffix =
+    "cache-cleanup-slice-millis";
+constexpr std::string_view kCacheSnapshotReloadIntervalSecondsParameterSuffix =
+    "cache-snapshot-reload-interval-seconds";
+constexpr std::string_view kCacheValueCompressionMinBytesParameterSuffix =
+    "cache-value-compression-min-bytes";
+constexpr std::string_view kCacheLockMetricsEnabledParameterSuffix =
+    "cache-lock-metrics-enabled";
+constexpr std::string_view kCacheLockLongHoldThresholdMicrosParameterSuffix =
+    "cache-lock-long-hold-threshold-micros";
+constexpr std::string_view kQueryParallelNumThreadsParameterSuffix =
+    "query-parallel-num-threads";
+constexpr std::string_view kQueryParallelMinSetSizeParameterSuffix =
+    "query-parallel-min-set-size";
+constexpr std::string_view kQueryResultCacheMaxQueriesParameterSuffix =
+    "query-result-cache-max-queries";
+constexpr std::string_view kSetSketchCacheMaxSetsParameterSuffix =
+    "set-sketch-cache-max-sets";
+constexpr std::string_view kSharedThreadPoolNumThreadsParameterSuffix =
+    "shared-thread-pool-num-threads";
+constexpr std::string_view kDataLoadingMaxConcurrentFilesParameterSuffix =
+    "data-loading-max-concurrent-files";
+constexpr std::string_view kDataLoadingMaxQueuedFilesParameterSuffix =
+    "data-loading-max-queued-files";
+constexpr std::string_view kDataLoadingSnapshotCheckBacklogParameterSuffix =
+    "data-loading-snapshot-check-backlog";
+constexpr std::string_view kDataLoadingCatchUpMinFilesParameterSuffix =
+    "data-loading-catch-up-min-files";
+constexpr std::string_view
+    kDataLoadingTrustedFileVerificationIntervalParameterSuffix =
+        "data-loading-trusted-file-verification-interval";
+constexpr std::string_view kRealtimeUpdaterBatchWindowMillisParameterSuffix =
+    "realtime-updater-batch-window-millis";
+constexpr std::string_view kDataLoadingServingP99TargetMillisParameterSuffix =
+    "data-loading-serving-p99-target-millis";
+constexpr std::string_view kDataLoadingThrottleDelayMillisParameterSuffix =
+    "data-loading-throttle-delay-millis";
+constexpr std::string_view kAllocatorReleaseIntervalSecondsParameterSuffix =
+    "allocator-release-interval-seconds";
+constexpr std::string_view
+    kAllocatorBackgroundReleaseMbPerSecondParameterSuffix =
+        "allocator-background-release-mb-per-second";
+constexpr std::string_view kAllocatorMaxPerCpuCacheKbParameterSuffix =
+    "allocator-max-per-cpu-cache-kb";
+constexpr std::string_view kAdmissionMaxConcurrentRequestsParameterSuffix =
+    "admission-max-concurrent-requests";
+constexpr std::string_view kAdmissionLatencyTargetMillisParameterSuffix =
+    "admission-latency-target-millis";
+constexpr std::string_view
+    kAdmissionMinRemainingDeadlineMillisParameterSuffix =
+        "admission-min-remaining-deadline-millis";
+constexpr std::string_view kDataLoadingThreadNiceIncrementParameterSuffix =
+    "data-loading-thread-nice-increment";
+constexpr std::string_view kDataLoadingSnapshotPublishIntervalMinutesSuffix =
+    "data-loading-snapshot-publish-interval-minutes";
+constexpr std::string_view kDataLoadingSnapshotPublishDirectorySuffix =
+    "data-loading-snapshot-publish-directory";
+constexpr std::string_view kDataLoadingShardCopyDirectorySuffix =
+    "data-loading-shard-copy-directory";
+constexpr std::string_view kDataLoadingShardCopyWaitMillisSuffix =
+    "data-loading-shard-copy-wait-millis";
+constexpr std::string_view kLogicalCommitTimeIsEpochMicrosParameterSuffix =
+    "logical-commit-time-is-epoch-micros";
+constexpr std::string_view kDataLoadingServeBeforeDeltaCatchUpSuffix =
+    "data-loading-serve-before-delta-catch-up";
+constexpr std::string_view kMaxConcurrentPartitionsParameterSuffix =
+    "max-concurrent-partitions-per-request";
+constexpr std::string_view kBlobCacheDirectoryParameterSuffix =
+    "blob-cache-directory";
+constexpr std::string_view kBlobCacheMaxMbParameterSuffix = "blob-cache-max-mb";
+constexpr std::string_view kV1ValueCacheMaxKeysParameterSuffix =
+    "v1-value-cache-max-keys";
+constexpr std::string_view kCoalesceV1RequestsParameterSuffix =
+    "coalesce-v1-requests";
+constexpr std::string_view kCoalesceInternalLookupsParameterSuffix =
+    "coalesce-internal-lookups";
+constexpr std::string_view kRemoteLookupCallbackApiParameterSuffix =
+    "remote-lookup-callback-api";
+constexpr std::string_view kRemoteLookupNumCqsParameterSuffix =
+    "remote-lookup-num-cqs";
+constexpr std::string_view kRemoteLookupMinPollersParameterSuffix =
+    "remote-lookup-min-pollers";
+constexpr std::string_view kRemoteLookupMaxPollersParameterSuffix =
+    "remote-lookup-max-pollers";
+constexpr std::string_view
+    kRemoteLookupResponseCompressionMinBytesParameterSuffix =
+        "remote-lookup-response-compression-min-bytes";
+constexpr std::string_view kRemoteLookupStreamChunkMaxValuesParameterSuffix =
+    "remote-lookup-stream-chunk-max-values";
+constexpr std::string_view kRemoteLookupResponseCacheMaxEntriesParameterSuffix =
+    "remote-lookup-response-cache-max-entries";
+constexpr std::string_view kRemoteLookupStreamKeySetsParameterSuffix =
+    "remote-lookup-stream-key-sets";
+constexpr std::string_view kShardedLookupMaxBatchesInFlightParameterSuffix =
+    "sharded-lookup-max-batches-in-flight";
+constexpr std::string_view kShardedLookupBatchWindowMicrosParameterSuffix =
+    "sharded-lookup-batch-window-micros";
+constexpr std::string_view kShardedLookupBatchMaxKeysParameterSuffix =
+    "sharded-lookup-batch-max-keys";
+constexpr std::string_view
+    kShardedLookupPaddingMinSizeClassBytesParameterSuffix =
+        "sharded-lookup-padding-min-size-class-bytes";
+constexpr std::string_view kShardedLookupPartialKeySetsParameterSuffix =
+    "sharded-lookup-partial-key-sets";
+constexpr std::string_view kShardCircuitBreakerFailureThresholdParameterSuffix =
+    "shard-circuit-breaker-failure-threshold";
+constexpr std::string_view kShardCircuitBreakerOpenMillisParameterSuffix =
+    "shard-circuit-breaker-open-millis";
+constexpr std::string_view kRemoteLookupTimeoutMillisParameterSuffix =
+    "remote-lookup-timeout-millis";
+constexpr std::string_view kRemoteLookupHedgePercentileParameterSuffix =
+    "remote-lookup-hedge-percentile";
+constexpr std::string_view kRemoteLookupNumChannelsParameterSuffix =
+    "remote-lookup-num-channels";
+constexpr std::string_view kRemoteLookupKeepaliveTimeMillisParameterSuffix =
+    "remote-lookup-keepalive-time-millis";
+constexpr std::string_view kRemoteLookupKeepaliveTimeoutMillisParameterSuffix =
+    "remote-lookup-keepalive-timeout-millis";
+constexpr std::string_view kRemoteLookupInitialWindowSizeBytesParameterSuffix =
+    "remote-lookup-initial-window-size-bytes";
+constexpr std::string_view kCoalesceUdfExecutionsParameterSuffix =
+    "coalesce-deterministic-udf-executions";
+constexpr std::string_view kFastV2JsonCodecParameterSuffix =
+    "fast-v2-json-codec";
+constexpr std::string_view kNativeHttpPortParameterSuffix = "native-http-port";
+constexpr std::string_view kUdfMaxPartitionsPerExecutionParameterSuffix =
+    "udf-max-partitions-per-execution";
+constexpr std::string_view kUdfOutputCacheMaxEntriesParameterSuffix =
+    "udf-output-cache-max-entries";
+constexpr std::string_view kUdfOutputCacheTtlMillisParameterSuffix =
+    "udf-output-cache-ttl-millis";
+constexpr std::string_view kUdfWorkerCpusParameterSuffix = "udf-worker-cpus";
+constexpr std::string_view kGrpcServerCpusParameterSuffix = "grpc-server-cpus";
+constexpr std::string_view kUdfWarmUpRoundsParameterSuffix =
+    "udf-warm-up-rounds";
+constexpr std::string_view kUdfWarmUpArgumentParameterSuffix =
+    "udf-warm-up-argument";
+constexpr std::string_view kProfilingBucketParameterSuffix =
+    "profiling-bucket";
+constexpr std::string_view kProfilingIntervalMillisParameterSuffix =
+    "profiling-interval-millis";
+constexpr std::string_view kProfilingCpuDurationMillisParameterSuffix =
+    "profiling-cpu-duration-millis";
+constexpr std::string_view kProfilingContentionSampleIntervalParameterSuffix =
+    "profiling-contention-sample-interval";
+constexpr std::string_view kRequestTraceSampleIntervalParameterSuffix =
+    "request-trace-sample-interval";
+constexpr std::string_view kRequestWarmUpNumRequestsParameterSuffix =
+    "request-warm-up-num-requests";
+constexpr std::string_view kRequestWarmUpConcurrencyParameterSuffix =
+    "request-warm-up-concurrency";
+constexpr std::string_view kRequestWarmUpTimeoutMillisParameterSuffix =
+    "request-warm-up-timeout-millis";
+constexpr std::string_view kRequestWarmUpRequestsFileParameterSuffix =
+    "request-warm-up-requests-file";
+constexpr std::string_view kCompressionBrotliQualityParameterSuffix =
+    "compression-brotli-quality";
+constexpr std::string_view kCompressionGzipLevelParameterSuffix =
+    "compression-gzip-level";
+constexpr std::string_view kCompressionZstdLevelParameterSuffix =
+    "compression-zstd-level";
+constexpr std::string_view kCompressionZstdDictionaryPathParameterSuffix =
+    "compression-zstd-dictionary-path";
+// Suffixes of the parameters that startup reads, which are prefetched together
+// rather than one round trip each.
+constexpr std::string_view kStartupParameterSuffixes[] = {
+    kDataBucketParameterSuffix,
+    kBackupPollFrequencySecsParameterSuffix,
+    kDeltaFileNotificationsTrustedParameterSuffix,
+    kMetricsExportIntervalMillisParameterSuffix,
+    kMetricsExportTimeoutMillisParameterSuffix,
+    kRealtimeUpdaterThreadNumberParameterSuffix,
+    kRealtimeUpdaterMinThreadsParameterSuffix,
+    kDataLoadingNumThreadsParameterSuffix,
+    kNumShardsParameterSuffix,
+    kUdfNumWorkersParameterSuffix,
+    kLoggingVerbosityLevelParameterSuffix,
+    kUdfTimeoutMillisParameterSuffix,
+    kUdfMinLogLevelParameterSuffix,
+    kUseShardingKeyRegexParameterSuffix,
+    kShardingKeyRegexParameterSuffix,
+    kShardingHashVersionParameterSuffix,
+    kNumLogicalShardsParameterSuffix,
+    kEnableOtelLoggerParameterSuffix,
+    kCacheNumShardsParameterSuffix,
+    kCacheTypeParameterSuffix,
+    kCacheHugePagesParameterSuffix,
+    kCacheColdTierDirectoryParameterSuffix,
+    kCacheHotTierMaxMbParameterSuffix,
+    kCacheImagePathParameterSuffix,
+    kCacheImageIntervalMinutesParameterSuffix,
+    kHotKeyCacheMaxKeysParameterSuffix,
+    kHotKeyCacheTtlMillisParameterSuffix,
+    kCacheNumaModeParameterSuffix,
+    kCacheSetStorageParameterSuffix,
+    kCacheSetLockStripesParameterSuffix,
+    kCacheIndexedKeyPrefixesParameterSuffix,
+    kCacheMembershipIndexKeyPrefixesParameterSuffix,
+    kCacheMembershipIndexMaxEntriesParameterSuffix,
+    kCacheFixedWidthKeyPrefixesParameterSuffix,
+    kCacheCleanupSliceMillisParameterSuffix,
+    kCacheSnapshotReloadIntervalSecondsParameterSuffix,
+    kCacheValueCompressionMinBytesParameterSuffix,
+    kCacheLockMetricsEnabledParameterSuffix,
+    kCacheLockLongHoldThresholdMicrosParameterSuffix,
+    kQueryParallelNumThreadsParameterSuffix,
+    kQueryParallelMinSetSizeParameterSuffix,
+    kQueryResultCacheMaxQueriesParameterSuffix,
+    kSetSketchCacheMaxSetsParameterSuffix,
+    kSharedThreadPoolNumThreadsParameterSuffix,
+    kDataLoadingMaxConcurrentFilesParameterSuffix,
+    kDataLoadingMaxQueuedFilesParameterSuffix,
+    kDataLoadingSnapshotCheckBacklogParameterSuffix,
+    kDataLoadingCatchUpMinFilesParameterSuffix,
+    kDataLoadingTrustedFileVerificationIntervalParameterSuffix,
+    kRealtimeUpdaterBatchWindowMillisParameterSuffix,
+    kDataLoadingServingP99TargetMillisParameterSuffix,
+    kDataLoadingThrottleDelayMillisParameterSuffix,
+    kAllocatorReleaseIntervalSecondsParameterSuffix,
+    kAllocatorBackgroundReleaseMbPerSecondParameterSuffix,
+    kAllocatorMaxPerCpuCacheKbParameterSuffix,
+    kAdmissionMaxConcurrentRequestsParameterSuffix,
+    kAdmissionLatencyTargetMillisParameterSuffix,
+    kAdmissionMinRemainingDeadlineMillisParameterSuffix,
+    kDataLoadingThreadNiceIncrementParameterSuffix,
+    kLogicalCommitTimeIsEpochMicrosParameterSuffix,
+    kMaxConcurrentPartitionsParameterSuffix,
+    kBlobCacheDirectoryParameterSuffix,
+    kBlobCacheMaxMbParameterSuffix,
+    kV1ValueCacheMaxKeysParameterSuffix,
+    kCoalesceV1RequestsParameterSuffix,
+    kCoalesceInternalLookupsParameterSuffix,
+    kRemoteLookupCallbackApiParameterSuffix,
+    kRemoteLookupNumCqsParameterSuffix,
+    kRemoteLookupMinPollersParameterSuffix,
+    kRemoteLookupMaxPollersParameterSuffix,
+    kRemoteLookupResponseCompressionMinBytesParameterSuffix,
+    kRemoteLookupStreamChunkMaxValuesParameterSuffix,
+    kRemoteLookupResponseCacheMaxEntriesParameterSuffix,
+    kRemoteLookupStreamKeySetsParameterSuffix,
+    kShardedLookupMaxBatchesInFlightParameterSuffix,
+    kShardedLookupBatchWindowMicrosParameterSuffix,
+    kShardedLookupBatchMaxKeysParameterSuffix,
+    kShardedLookupPaddingMinSizeClassBytesParameterSuffix,
+    kShardedLookupPartialKeySetsParameterSuffix,
+    kShardCircuitBreakerFailureThresholdParameterSuffix,
+    kShardCircuitBreakerOpenMillisParameterSuffix,
+    kRemoteLookupTimeoutMillisParameterSuffix,
+    kRemoteLookupHedgePercentileParameterSuffix,
+    kRemoteLookupNumChannelsParameterSuffix,
+    kRemoteLookupKeepaliveTimeMillisParameterSuffix,
+    kRemoteLookupKeepaliveTimeoutMillisParameterSuffix,
+    kRemoteLookupInitialWindowSizeBytesParameterSuffix,
+    kCoalesceUdfExecutionsParameterSuffix,
+    kFastV2JsonCodecParameterSuffix,
+    kNativeHttpPortParameterSuffix,
+    kUdfMaxPartitionsPerExecutionParameterSuffix,
+    kUdfOutputCacheMaxEntriesParameterSuffix,
+    kUdfOutputCacheTtlMillisParameterSuffix,
+    kUdfWorkerCpusParameterSuffix,
+    kGrpcServerCpusParameterSuffix,
+    kUdfWarmUpRoundsParameterSuffix,
+    kUdfWarmUpArgumentParameterSuffix,
+    kProfilingBucketParameterSuffix,
+    kProfilingIntervalMillisParameterSuffix,
+    kProfilingCpuDurationMillisParameterSuffix,
+    kProfilingContentionSampleIntervalParameterSuffix,
+    kRequestTraceSampleIntervalParameterSuffix,
+    kRequestWarmUpNumRequestsParameterSuffix,
+    kRequestWarmUpConcurrencyParameterSuffix,
+    kRequestWarmUpTimeoutMillisParameterSuffix,
+    kRequestWarmUpRequestsFileParameterSuffix,
+    kCompressionBrotliQualityParameterSuffix,
+    kCompressionGzipLevelParameterSuffix,
+    kCompressionZstdLevelParameterSuffix,
+    kCompressionZstdDictionaryPathParameterSuffix,
+};
+// Size of the dictionary that the cache trains to compress values, zstd's
+// default.
+constexpr int64_t kCacheValueCompressionDictionarySize = 110 * 1024;
 
 opentelemetry::sdk::metrics::PeriodicExportingMetricReaderOptions
 GetMetricsOptions(const ParameterClient& parameter_client,
@@ -181,6 +550,306 @@ GetServerTelemetryConfig(const ParameterClient& parameter_client,
   return config;
 }
 
+// Returns the value of an optional int32 parameter, or `default_value` if the
+// parameter is not set or can't be parsed.
+int32_t GetOptionalInt32Parameter(const ParameterFetcher& parameter_fetcher,
+                                  std::string_view parameter_suffix,
+                                  int32_t default_value) {
+  const std::string value = parameter_fetcher.GetParameter(
+      parameter_suffix, /*default_value=*/absl::StrCat(default_value));
+  int32_t result;
+  if (!absl::SimpleAtoi(value, &result)) {
+    LOG(ERROR) << "Failed converting " << parameter_suffix
+               << " parameter: " << value << " to int32. Using default value "
+               << default_value;
+    return default_value;
+  }
+  LOG(INFO) << "Retrieved " << parameter_suffix << " parameter: " << result;
+  return result;
+}
+
+// Returns the value of an optional bool parameter, or `default_value` if the
+// parameter is not set or can't be parsed.
+bool GetOptionalBoolParameter(const ParameterFetcher& parameter_fetcher,
+                              std::string_view parameter_suffix,
+                              bool default_value) {
+  const std::string value = parameter_fetcher.GetParameter(
+      parameter_suffix, /*default_value=*/default_value ? "true" : "false");
+  bool result;
+  if (!absl::SimpleAtob(value, &result)) {
+    LOG(ERROR) << "Failed converting " << parameter_suffix
+               << " parameter: " << value << " to bool. Using default value "
+               << default_value;
+    return default_value;
+  }
+  LOG(INFO) << "Retrieved " << parameter_suffix << " parameter: " << result;
+  return result;
+}
+
+// What a server does. By default every server runs UDFs and holds a shard of
+// the data. With `separate-udf-servers` set, the servers of shards
+// [0, num_shards) only hold data, and don't start Roma, while the servers
+// tagged with shard `num_shards`, which no cluster mapping includes, only run
+// UDFs and look up every key from the data servers. The two can then be
+// scaled separately.
+enum class ServerRole { kUdfAndData, kUdfOnly, kDataOnly };
+
+ServerRole GetServerRole(bool separate_udf_servers, int32_t num_shards,
+                         int32_t shard_num) {
+  if (!separate_udf_servers) {
+    return ServerRole::kUdfAndData;
+  }
+  return shard_num == num_shards ? ServerRole::kUdfOnly
+                                 : ServerRole::kDataOnly;
+}
+
+absl::StatusOr<int32_t> GetShardNum(InstanceClient& instance_client) {
+  const auto shard_num_status = instance_client.GetShardNumTag();
+  if (!shard_num_status.ok()) {
+    return shard_num_status.status();
+  }
+  int32_t shard_num;
+  if (!absl::SimpleAtoi(*shard_num_status, &shard_num)) {
+    std::string error =
+        absl::StrFormat("Failed converting shard id parameter: %s to int32.",
+                        *shard_num_status);
+    LOG(ERROR) << error;
+    return absl::InvalidArgumentError(error);
+  }
+  return shard_num;
+}
+
+// Returns the CPUs of an optional CPU list parameter, such as "0-3,8", or no
+// CPUs if the parameter is not set or can't be parsed.
+std::vector<int> GetOptionalCpuListParameter(
+    const ParameterFetcher& parameter_fetcher,
+    std::string_view parameter_suffix) {
+  const std::string value =
+      parameter_fetcher.GetParameter(parameter_suffix, /*default_value=*/"");
+  if (value.empty()) {
+    return {};
+  }
+  auto cpus = ParseCpuList(value);
+  if (!cpus.ok()) {
+    LOG(ERROR) << "Failed parsing " << parameter_suffix
+               << " parameter: " << value << ": " << cpus.status()
+               << ". Not pinning to CPUs";
+    return {};
+  }
+  LOG(INFO) << "Retrieved " << parameter_suffix << " parameter: " << value;
+  return *std::move(cpus);
+}
+
+// Returns the requests that the server serves before it reports healthy.
+// 0 requests (default) disables the warm-up.
+RequestWarmUpOptions GetRequestWarmUpOptions(
+    const ParameterFetcher& parameter_fetcher) {
+  RequestWarmUpOptions warm_up{
+      .num_requests = GetOptionalInt32Parameter(
+          parameter_fetcher, kRequestWarmUpNumRequestsParameterSuffix,
+          /*default_value=*/0),
+  };
+  if (warm_up.num_requests <= 0) {
+    return warm_up;
+  }
+  warm_up.concurrency = GetOptionalInt32Parameter(
+      parameter_fetcher, kRequestWarmUpConcurrencyParameterSuffix,
+      /*default_value=*/4);
+  warm_up.timeout = absl::Milliseconds(GetOptionalInt32Parameter(
+      parameter_fetcher, kRequestWarmUpTimeoutMillisParameterSuffix,
+      /*default_value=*/30000));
+  warm_up.requests_file = parameter_fetcher.GetParameter(
+      kRequestWarmUpRequestsFileParameterSuffix, /*default_value=*/"");
+  LOG(INFO) << "Retrieved " << kRequestWarmUpRequestsFileParameterSuffix
+            << " parameter: " << warm_up.requests_file;
+  return warm_up;
+}
+
+// Returns the warm-up of new UDF code objects. The argument is the JSON of a
+// `UDFArgument`, and warm-up runs without one if it can't be parsed.
+UdfWarmUpOptions GetUdfWarmUpOptions(
+    const ParameterFetcher& parameter_fetcher) {
+  UdfWarmUpOptions warm_up{.rounds = GetOptionalInt32Parameter(
+                               parameter_fetcher,
+                               kUdfWarmUpRoundsParameterSuffix,
+                               /*default_value=*/0)};
+  const std::string argument = parameter_fetcher.GetParameter(
+      kUdfWarmUpArgumentParameterSuffix, /*default_value=*/"");
+  if (argument.empty()) {
+    return warm_up;
+  }
+  if (const auto status = google::protobuf::util::JsonStringToMessage(
+          argument, &warm_up.argument);
+      !status.ok()) {
+    LOG(ERROR) << "Failed parsing " << kUdfWarmUpArgumentParameterSuffix
+               << " parameter: " << argument << ": " << status;
+    warm_up.argument.Clear();
+    return warm_up;
+  }
+  LOG(INFO) << "Retrieved " << kUdfWarmUpArgumentParameterSuffix
+            << " parameter: " << argument;
+  return warm_up;
+}
+
+// Returns the options that the compression groups of v2 responses are
+// compressed with. Falls back to zstd without dictionary if the dictionary
+// can't be loaded.
+CompressionOptions GetCompressionOptions(
+    const ParameterFetcher& parameter_fetcher) {
+  CompressionOptions options;
+  options.brotli_quality = GetOptionalInt32Parameter(
+      parameter_fetcher, kCompressionBrotliQualityParameterSuffix,
+      /*default_value=*/options.brotli_quality);
+  options.gzip_level = GetOptionalInt32Parameter(
+      parameter_fetcher, kCompressionGzipLevelParameterSuffix,
+      /*default_value=*/options.gzip_level);
+  const int32_t zstd_level = GetOptionalInt32Parameter(
+      parameter_fetcher, kCompressionZstdLevelParameterSuffix,
+      /*default_value=*/3);
+  const std::string dictionary_path = parameter_fetcher.GetParameter(
+      kCompressionZstdDictionaryPathParameterSuffix, /*default_value=*/"");
+  std::string dictionary;
+  if (!dictionary_path.empty()) {
+    if (std::ifstream stream(dictionary_path, std::ios::binary); stream) {
+      dictionary.assign(std::istreambuf_iterator<char>(stream), {});
+    } else {
+      LOG(ERROR) << "Failed to open zstd dictionary " << dictionary_path;
+    }
+  }
+  auto codec = ValueCodec::Create(dictionary, zstd_level);
+  if (!codec.ok() && !dictionary.empty()) {
+    LOG(ERROR) << "Failed to load zstd dictionary " << dictionary_path << ": "
+               << codec.status() << ". Compressing without dictionary.";
+    codec = ValueCodec::Create(/*dictionary=*/"", zstd_level);
+  }
+  if (codec.ok()) {
+    options.zstd_codec = *std::move(codec);
+  }
+  return options;
+}
+
+absl::flat_hash_map<std::string, double> GetSharedThreadPoolStats() {
+  const ThreadPool& pool = SharedThreadPool();
+  const double busy_threads = pool.busy_threads();
+  return {
+      {std::string(kThreadPoolQueueDepth), pool.queue_depth()},
+      {std::string(kThreadPoolBusyThreads), busy_threads},
+      {std::string(kThreadPoolUtilizationPercent),
+       100 * busy_threads / std::max(pool.num_threads(), 1)},
+  };
+}
+
+absl::flat_hash_map<std::string, double> GetHugePageStatsForMetrics() {
+  const HugePageStats stats = GetHugePageStats();
+  const double huge_page_bytes = stats.explicit_bytes + stats.transparent_bytes;
+  const double requested_bytes = huge_page_bytes + stats.fallback_bytes;
+  return {
+      {std::string(kHugePageExplicitBytes),
+       static_cast<double>(stats.explicit_bytes)},
+      {std::string(kHugePageTransparentBytes),
+       static_cast<double>(stats.transparent_bytes)},
+      {std::string(kHugePageFallbackBytes),
+       static_cast<double>(stats.fallback_bytes)},
+      {std::string(kHugePageCoveragePercent),
+       requested_bytes == 0 ? 0 : 100 * huge_page_bytes / requested_bytes},
+  };
+}
+
+absl::flat_hash_map<std::string, double> GetAllocatorStatsForMetrics() {
+  const AllocatorStats stats = GetAllocatorStats();
+  return {
+      {std::string(kAllocatorInUseBytes),
+       static_cast<double>(stats.in_use_bytes)},
+      {std::string(kAllocatorResidentBytes),
+       static_cast<double>(stats.resident_bytes)},
+      {std::string(kAllocatorPageHeapFreeBytes),
+       static_cast<double>(stats.page_heap_free_bytes)},
+      {std::string(kAllocatorCacheFreeBytes),
+       static_cast<double>(stats.cache_free_bytes)},
+      {std::string(kAllocatorReleasedBytes),
+       static_cast<double>(stats.released_bytes)},
+  };
+}
+
+absl::flat_hash_map<std::string, double> GetDataLoadingGovernorStats() {
+  const LoadGovernor& governor = DataLoadingGovernor();
+  return {
+      {std::string(kDataLoadingGovernorThrottledBatches),
+       static_cast<double>(governor.num_throttled())},
+      {std::string(kDataLoadingGovernorServingP99Micros),
+       absl::ToDoubleMicroseconds(governor.serving_p99())},
+  };
+}
+
+absl::flat_hash_map<std::string, double> GetAdmissionControlStats() {
+  const AdmissionController& controller = ServingAdmissionController();
+  return {
+      {std::string(kAdmissionInFlightRequests),
+       static_cast<double>(controller.in_flight())},
+      {std::string(kAdmissionConcurrencyLimit),
+       static_cast<double>(controller.limit())},
+      {std::string(kAdmissionShedOverLimit),
+       static_cast<double>(controller.num_shed_over_limit())},
+      {std::string(kAdmissionShedDeadline),
+       static_cast<double>(controller.num_shed_deadline())},
+      {std::string(kAdmissionInternalLookupShedOverLimit),
+       static_cast<double>(
+           InternalLookupAdmissionController().num_shed_over_limit())},
+      {std::string(kAdmissionInternalLookupShedDeadline),
+       static_cast<double>(
+           InternalLookupAdmissionController().num_shed_deadline())},
+  };
+}
+
+absl::flat_hash_map<std::string, double> GetUdfOutputCacheStats() {
+  const UdfOutputCache& cache = ServerUdfOutputCache();
+  return {
+      {std::string(kUdfOutputCacheEntries),
+       static_cast<double>(cache.num_entries())},
+      {std::string(kUdfOutputCacheBytes),
+       static_cast<double>(cache.num_bytes())},
+      {std::string(kUdfOutputCacheHits), static_cast<double>(cache.num_hits())},
+      {std::string(kUdfOutputCacheMisses),
+       static_cast<double>(cache.num_misses())},
+      {std::string(kUdfOutputCacheEvictions),
+       static_cast<double>(cache.num_evictions())},
+      {std::string(kUdfOutputCacheInvalidations),
+       static_cast<double>(cache.num_invalidations())},
+  };
+}
+
+absl::flat_hash_map<std::string, double> GetLookupResponseCacheStats() {
+  const LookupResponseCache& cache = ServerLookupResponseCache();
+  return {
+      {std::string(kLookupResponseCacheEntries),
+       static_cast<double>(cache.num_entries())},
+      {std::string(kLookupResponseCacheBytes),
+       static_cast<double>(cache.num_bytes())},
+      {std::string(kLookupResponseCacheHits),
+       static_cast<double>(cache.num_hits())},
+      {std::string(kLookupResponseCacheMisses),
+       static_cast<double>(cache.num_misses())},
+      {std::string(kLookupResponseCacheEvictions),
+       static_cast<double>(cache.num_evictions())},
+      {std::string(kLookupResponseCacheInvalidations),
+       static_cast<double>(cache.num_invalidations())},
+  };
+}
+
+absl::flat_hash_map<std::string, double> GetUdfWorkerStats() {
+  const UdfExecutionStats stats = GetUdfExecutionStats();
+  return {
+      {std::string(kUdfExecutionsInFlight),
+       static_cast<double>(stats.in_flight)},
+      {std::string(kUdfExecutionWorkers),
+       static_cast<double>(stats.num_workers)},
+  };
+}
+
+absl::flat_hash_map<std::string, double> GetStartupPhaseDurationsInMillis() {
+  return ServerStartupReport().GetPhaseDurationsInMillis();
+}
+
 BlobPrefixAllowlist GetBlobPrefixAllowlist(
     const ParameterFetcher& parameter_fetcher) {
   const auto prefix_allowlist = parameter_fetcher.GetParameter(
@@ -203,12 +872,240 @@ Server::Server()
 // called right after telemetry has been initialized but before anything that
 // requires the cache has been initialized.
 void Server::InitializeKeyValueCache() {
-  cache_ = KeyValueCache::Create();
-  cache_->UpdateKeyValue(
-      "hi",
-      "Hello, world! If you are seeing this, it means you can "
-      "query me successfully",
-      /*logical_commit_time = */ 1);
+  ParameterFetcher parameter_fetcher(environment_, *parameter_client_);
+  // 1 keeps a single `KeyValueCache`, 0 uses one shard per hardware thread.
+  const int32_t cache_num_shards = GetOptionalInt32Parameter(
+      parameter_fetcher, kCacheNumShardsParameterSuffix, /*default_value=*/1);
+  // "lock_based" (default), "rcu", "arena", "tiered" or "dictionary". "rcu"
+  // serves key-value lookups without taking any lock, "arena" stores keys and
+  // values in slabs, "tiered" moves the values that aren't looked up to a
+  // file, "dictionary" front codes the keys in a sorted dictionary.
+  const std::string cache_type = parameter_fetcher.GetParameter(
+      kCacheTypeParameterSuffix, /*default_value=*/"lock_based");
+  LOG(INFO) << "Retrieved " << kCacheTypeParameterSuffix
+            << " parameter: " << cache_type;
+  // "none" (default), "transparent" or "explicit". Backs the slabs and the
+  // key-value map of the "arena" cache with huge pages: transparent huge pages
+  // advised on aligned regions, or pages of the hugetlbfs pool, which fall
+  // back to transparent ones once the pool is exhausted.
+  const std::string cache_huge_pages = parameter_fetcher.GetParameter(
+      kCacheHugePagesParameterSuffix, /*default_value=*/"none");
+  LOG(INFO) << "Retrieved " << kCacheHugePagesParameterSuffix
+            << " parameter: " << cache_huge_pages;
+  HugePageMode huge_pages = HugePageMode::kNone;
+  if (const auto mode = ParseHugePageMode(cache_huge_pages); mode.ok()) {
+    huge_pages = *mode;
+  } else {
+    LOG(ERROR) << mode.status() << ", the cache uses regular pages";
+  }
+  // "strings" (default) or "interned". The latter stores set members once in
+  // a dictionary shared by every key.
+  const std::string cache_set_storage = parameter_fetcher.GetParameter(
+      kCacheSetStorageParameterSuffix, /*default_value=*/"strings");
+  LOG(INFO) << "Retrieved " << kCacheSetStorageParameterSuffix
+            << " parameter: " << cache_set_storage;
+  // 0 (default) stores values as they are. Otherwise the "lock_based" cache
+  // compresses the values of at least this many bytes, with a dictionary
+  // trained on the first of them.
+  const int32_t cache_value_compression_min_bytes = GetOptionalInt32Parameter(
+      parameter_fetcher, kCacheValueCompressionMinBytesParameterSuffix,
+      /*default_value=*/0);
+  const KeyValueCache::CompressionOptions compression_options{
+      .min_value_size = cache_value_compression_min_bytes,
+      .trained_dictionary_size = kCacheValueCompressionDictionarySize};
+  // 0 (default) allocates every key-value set of the "lock_based" cache with
+  // a lock of its own. Otherwise the sets are stored in the key table, and
+  // guarded by this many locks shared by hash of the key.
+  const KeyValueCache::SetLockOptions set_lock_options{
+      .num_stripes = GetOptionalInt32Parameter(
+          parameter_fetcher, kCacheSetLockStripesParameterSuffix,
+          /*default_value=*/0)};
+  // Off by default. When on, the "lock_based" cache records how long its
+  // mutexes are waited for and held, and counts the exclusive sections held
+  // longer than the threshold (1ms by default).
+  SetCacheLockMetricsOptions({
+      .enabled = GetOptionalBoolParameter(
+          parameter_fetcher, kCacheLockMetricsEnabledParameterSuffix,
+          /*default_value=*/false),
+      .long_hold_threshold = absl::Microseconds(GetOptionalInt32Parameter(
+          parameter_fetcher, kCacheLockLongHoldThresholdMicrosParameterSuffix,
+          /*default_value=*/1000)),
+  });
+  // Where the "tiered" cache keeps the values that aren't looked up, on local
+  // disk, and how much it keeps in memory.
+  const std::string cache_cold_tier_directory = parameter_fetcher.GetParameter(
+      kCacheColdTierDirectoryParameterSuffix, /*default_value=*/"/tmp");
+  const int32_t cache_hot_tier_max_mb = GetOptionalInt32Parameter(
+      parameter_fetcher, kCacheHotTierMaxMbParameterSuffix,
+      /*default_value=*/1024);
+  // "off" (default) or "replicated". The latter keeps a replica of the cache
+  // on every NUMA node, written by threads of the node, and pins the threads
+  // that look it up to the nodes so that they read local memory.
+  const std::string cache_numa_mode = parameter_fetcher.GetParameter(
+      kCacheNumaModeParameterSuffix, /*default_value=*/"off");
+  LOG(INFO) << "Retrieved " << kCacheNumaModeParameterSuffix
+            << " parameter: " << cache_numa_mode;
+  std::vector<NumaNode> numa_nodes;
+  if (cache_numa_mode == kReplicatedNumaMode) {
+    numa_nodes = GetNumaNodes();
+    if (numa_nodes.size() < 2) {
+      LOG(WARNING) << "Found " << numa_nodes.size()
+                   << " NUMA nodes, the cache is not replicated";
+      numa_nodes.clear();
+    }
+  }
+  // Empty (default) or a comma separated list of key prefixes, such as
+  // "creative:,ad:". The keys under them are kept in an ordered index, so that
+  // UDFs can look them up by prefix with `getValuesByPrefix`.
+  const std::string cache_indexed_key_prefixes = parameter_fetcher.GetParameter(
+      kCacheIndexedKeyPrefixesParameterSuffix, /*default_value=*/"");
+  LOG(INFO) << "Retrieved " << kCacheIndexedKeyPrefixesParameterSuffix
+            << " parameter: " << cache_indexed_key_prefixes;
+  const std::vector<std::string> indexed_key_prefixes = absl::StrSplit(
+      cache_indexed_key_prefixes, ',', absl::SkipWhitespace());
+  // Empty (default) or a comma separated list of key prefixes of key-value
+  // sets, such as "audience:". With interned set storage, the sets under them
+  // are kept in a reverse membership index of up to
+  // `cache-membership-index-max-entries` (member, set key) pairs, so that UDFs
+  // can find the sets that contain a member with `getSetsContaining`.
+  const std::string cache_membership_index_key_prefixes =
+      parameter_fetcher.GetParameter(
+          kCacheMembershipIndexKeyPrefixesParameterSuffix,
+          /*default_value=*/"");
+  LOG(INFO) << "Retrieved " << kCacheMembershipIndexKeyPrefixesParameterSuffix
+            << " parameter: " << cache_membership_index_key_prefixes;
+  InternedKeyValueSetCache::Options interned_set_options;
+  interned_set_options.membership_index_key_prefixes = absl::StrSplit(
+      cache_membership_index_key_prefixes, ',', absl::SkipWhitespace());
+  interned_set_options.membership_index_max_entries = GetOptionalInt32Parameter(
+      parameter_fetcher, kCacheMembershipIndexMaxEntriesParameterSuffix,
+      /*default_value=*/10'000'000);
+  if (!interned_set_options.membership_index_key_prefixes.empty() &&
+      cache_set_storage != kInternedSetStorage) {
+    LOG(WARNING) << kCacheMembershipIndexKeyPrefixesParameterSuffix
+                 << " needs the interned " << kCacheSetStorageParameterSuffix
+                 << ", the sets are not indexed";
+  }
+  // Empty (default) or a comma separated list of key prefixes with the type of
+  // the keys under them, such as "uid:=uint64,h:=hash128". Those keys are
+  // stored as 64 bit integers or 128 bit hashes rather than as strings.
+  const std::string cache_fixed_width_key_prefixes =
+      parameter_fetcher.GetParameter(kCacheFixedWidthKeyPrefixesParameterSuffix,
+                                     /*default_value=*/"");
+  LOG(INFO) << "Retrieved " << kCacheFixedWidthKeyPrefixesParameterSuffix
+            << " parameter: " << cache_fixed_width_key_prefixes;
+  FixedWidthKeyCache::Options fixed_width_key_options;
+  if (auto namespaces =
+          ParseFixedWidthKeyNamespaces(cache_fixed_width_key_prefixes);
+      namespaces.ok()) {
+    fixed_width_key_options.namespaces = *std::move(namespaces);
+  } else {
+    LOG(ERROR) << namespaces.status() << ", every key is stored as a string";
+  }
+  // Numbers the cold tier files of the shards and generations.
+  auto num_cold_tier_files = std::make_shared<std::atomic<int>>(0);
+  auto generation_factory = [cache_num_shards, cache_type, huge_pages,
+                             cache_set_storage, compression_options,
+                             set_lock_options, cache_cold_tier_directory,
+                             cache_hot_tier_max_mb, num_cold_tier_files,
+                             numa_nodes, indexed_key_prefixes,
+                             interned_set_options, fixed_width_key_options]()
+                                -> std::unique_ptr<Cache> {
+    absl::AnyInvocable<std::unique_ptr<Cache>()> cache_factory =
+        [compression_options, set_lock_options] {
+          return KeyValueCache::Create(compression_options, set_lock_options);
+        };
+    if (cache_type == kRcuCacheType) {
+      cache_factory = [] { return RcuKeyValueCache::Create(); };
+    } else if (cache_type == kArenaCacheType) {
+      cache_factory = [huge_pages] {
+        return ArenaKeyValueCache::Create(SlabArena::kDefaultSlabSize,
+                                          huge_pages);
+      };
+    } else if (cache_type == kDictionaryCacheType) {
+      cache_factory = [] { return DictionaryKeyValueCache::Create(); };
+    } else if (cache_type == kTieredCacheType) {
+      // The budget is split between the shards.
+      const int64_t max_hot_tier_bytes =
+          int64_t{cache_hot_tier_max_mb} * 1024 * 1024 /
+          std::max<int64_t>(cache_num_shards, 1);
+      cache_factory = [cache_cold_tier_directory, max_hot_tier_bytes,
+                       num_cold_tier_files] {
+        return TieredKeyValueCache::Create({
+            .cold_tier_path =
+                absl::StrCat(cache_cold_tier_directory, "/kv_cold_tier_",
+                             num_cold_tier_files->fetch_add(1)),
+            .max_hot_tier_bytes = max_hot_tier_bytes,
+        });
+      };
+    }
+    auto replica_factory = [cache_num_shards, cache_set_storage,
+                            &interned_set_options, &fixed_width_key_options,
+                            &cache_factory]() -> std::unique_ptr<Cache> {
+      std::unique_ptr<Cache> cache;
+      if (cache_num_shards == 1) {
+        cache = cache_factory();
+      } else {
+        cache = ShardedKeyValueCache::Create(
+            cache_num_shards, [&cache_factory] { return cache_factory(); });
+      }
+      if (cache_set_storage == kInternedSetStorage) {
+        cache = InternedKeyValueSetCache::Create(std::move(cache),
+                                                 interned_set_options);
+      }
+      if (!fixed_width_key_options.namespaces.empty()) {
+        cache = FixedWidthKeyCache::Create(std::move(cache),
+                                           fixed_width_key_options);
+      }
+      return cache;
+    };
+    std::unique_ptr<Cache> cache;
+    if (numa_nodes.empty()) {
+      cache = replica_factory();
+    } else {
+      cache = NumaKeyValueCache::Create(numa_nodes, std::move(replica_factory),
+                                        {.pin_readers = true});
+    }
+    if (!indexed_key_prefixes.empty()) {
+      cache = PrefixIndexedCache::Create(
+          std::move(cache), {.key_prefixes = indexed_key_prefixes});
+    }
+    // Outermost, so that the integer sets are stored once per generation.
+    cache = UInt32SetCache::Create(std::move(cache));
+    cache->UpdateKeyValue(
+        "hi",
+        "Hello, world! If you are seeing this, it means you can "
+        "query me successfully",
+        /*logical_commit_time = */ 1);
+    return cache;
+  };
+  // 0 (default) loads snapshots at startup only. Otherwise the data loader
+  // checks for new snapshots this often, and rebuilds the cache from them in a
+  // second generation that is swapped in once it is up to date.
+  cache_snapshot_reload_interval_seconds_ = GetOptionalInt32Parameter(
+      parameter_fetcher, kCacheSnapshotReloadIntervalSecondsParameterSuffix,
+      /*default_value=*/0);
+  if (cache_snapshot_reload_interval_seconds_ > 0) {
+    auto generational_cache =
+        GenerationalCache::Create(std::move(generation_factory));
+    generational_cache_ = generational_cache.get();
+    cache_ = std::move(generational_cache);
+  } else {
+    cache_ = generation_factory();
+  }
+  // 0 (default) removes the deleted values of a file right after it is loaded.
+  // Otherwise they are removed on a background thread, in slices of this many
+  // milliseconds.
+  const int32_t cache_cleanup_slice_millis = GetOptionalInt32Parameter(
+      parameter_fetcher, kCacheCleanupSliceMillisParameterSuffix,
+      /*default_value=*/0);
+  if (cache_cleanup_slice_millis > 0) {
+    tombstone_cleaner_ = TombstoneCleaner::Create(
+        *cache_,
+        {.slice_duration = absl::Milliseconds(cache_cleanup_slice_millis),
+         .pause_between_slices =
+             absl::Milliseconds(cache_cleanup_slice_millis)});
+  }
 }
 
 void Server::InitOtelLogger(
@@ -252,6 +1149,34 @@ void Server::InitializeTelemetry(const ParameterClient& parameter_client,
                              environment_),
           metrics_options, metrics_collector_endpoint));
   AddSystemMetric(context_map);
+  context_map->AddObserverable(kCacheMemoryBytes,
+                               KeyValueCache::GetMemoryBytesOfAllCaches);
+  context_map->AddObserverable(
+      kSetMembershipIndexStats,
+      InternedKeyValueSetCache::GetMembershipIndexStatsOfAllCaches);
+  context_map->AddObserverable(kSharedThreadPoolStats,
+                               GetSharedThreadPoolStats);
+  context_map->AddObserverable(kCacheHugePageStats,
+                               GetHugePageStatsForMetrics);
+  context_map->AddObserverable(kAllocatorStats, GetAllocatorStatsForMetrics);
+  context_map->AddObserverable(kDataLoadingGovernorStats,
+                               GetDataLoadingGovernorStats);
+  context_map->AddObserverable(kAdmissionControlStats,
+                               GetAdmissionControlStats);
+  context_map->AddObserverable(kUdfOutputCacheStats, GetUdfOutputCacheStats);
+  context_map->AddObserverable(kLookupResponseCacheStats,
+                               GetLookupResponseCacheStats);
+  context_map->AddObserverable(kUdfExecutionStats, GetUdfWorkerStats);
+  context_map->AddObserverable(kStartupPhaseDurationMillis,
+                               GetStartupPhaseDurationsInMillis);
+  context_map->AddObserverable(kDeltaFileFreshnessLagInMicros,
+                               DataOrchestrator::GetFreshnessLagsInMicros);
+  context_map->AddObserverable(kDeltaCatchUpBacklogFiles,
+                               DataOrchestrator::GetDeltaCatchUpBacklogs);
+  context_map->AddObserverable(kMaxDataFreshnessLagInMicros,
+                               TakeMaxDataFreshnessLagsInMicros);
+  context_map->AddObserverable(kRemoteLookupLatencyByShardInMicros,
+                               GetRemoteLookupLatenciesByShardInMicros);
 
   auto* internal_lookup_context_map = InternalLookupServerContextMap(
       telemetry_config,
@@ -279,8 +1204,17 @@ absl::Status Server::CreateDefaultInstancesIfNecessaryAndGetEnvironment(
     std::unique_ptr<const ParameterClient> parameter_client,
     std::unique_ptr<InstanceClient> instance_client,
     std::unique_ptr<UdfClient> udf_client) {
-  parameter_client_ = parameter_client == nullptr ? ParameterClient::Create()
-                                                  : std::move(parameter_client);
+  // Every component reads its parameters through the default client, which
+  // serves them from a snapshot prefetched once the environment is known.
+  const CachingParameterClient* caching_parameter_client = nullptr;
+  if (parameter_client == nullptr) {
+    auto client =
+        std::make_unique<CachingParameterClient>(ParameterClient::Create());
+    caching_parameter_client = client.get();
+    parameter_client_ = std::move(client);
+  } else {
+    parameter_client_ = std::move(parameter_client);
+  }
   instance_client_ = instance_client == nullptr ? InstanceClient::Create()
                                                 : std::move(instance_client);
   environment_ = TraceRetryUntilOk(
@@ -288,6 +1222,12 @@ absl::Status Server::CreateDefaultInstancesIfNecessaryAndGetEnvironment(
       "GetEnvironment", LogMetricsNoOpCallback());
   LOG(INFO) << "Retrieved environment: " << environment_;
   ParameterFetcher parameter_fetcher(environment_, *parameter_client_);
+  if (caching_parameter_client != nullptr) {
+    StartupReport::ScopedPhase startup_phase(ServerStartupReport(),
+                                             kStartupParameterFetchPhase);
+    caching_parameter_client->Prefetch(
+        parameter_fetcher.GetParamNames(kStartupParameterSuffixes));
+  }
 
   int32_t number_of_workers =
       parameter_fetcher.GetInt32Parameter(kUdfNumWorkersParameterSuffix);
@@ -304,19 +1244,61 @@ absl::Status Server::CreateDefaultInstancesIfNecessaryAndGetEnvironment(
     udf_client_ = std::move(udf_client);
     return absl::OkStatus();
   }
+  if (GetOptionalBoolParameter(parameter_fetcher,
+                               kSeparateUdfServersParameterSuffix,
+                               /*default_value=*/false)) {
+    const auto shard_num = GetShardNum(*instance_client_);
+    if (!shard_num.ok()) {
+      return shard_num.status();
+    }
+    const int32_t num_shards =
+        parameter_fetcher.GetInt32Parameter(kNumShardsParameterSuffix);
+    if (GetServerRole(/*separate_udf_servers=*/true, num_shards,
+                      *shard_num) == ServerRole::kDataOnly) {
+      LOG(INFO) << "Data server, not starting Roma workers.";
+      udf_client_ = NewNoopUdfClient();
+      return absl::OkStatus();
+    }
+  }
   UdfConfigBuilder config_builder;
   // TODO(b/289244673): Once roma interface is updated, internal lookup client
   // can be removed and we can own the unique ptr to the hooks.
-  absl::StatusOr<std::unique_ptr<UdfClient>> udf_client_or_status =
-      UdfClient::Create(
-          std::move(config_builder
-                        .RegisterStringGetValuesHook(*string_get_values_hook_)
-                        .RegisterBinaryGetValuesHook(*binary_get_values_hook_)
-                        .RegisterRunQueryHook(*run_query_hook_)
-                        .RegisterLoggingFunction()
-                        .SetNumberOfWorkers(number_of_workers)
-                        .Config()),
-          absl::Milliseconds(udf_timeout_ms), udf_min_log_level);
+  absl::StatusOr<std::unique_ptr<UdfClient>> udf_client_or_status;
+  // Roma workers are started by `UdfClient::Create`, so they only run on the
+  // CPUs it is called on. Pinning them apart from the gRPC threads keeps the
+  // two from competing for CPUs.
+  const absl::Status pin_status = CallPinnedTo(
+      GetOptionalCpuListParameter(parameter_fetcher,
+                                  kUdfWorkerCpusParameterSuffix),
+      [&] {
+        StartupReport::ScopedPhase startup_phase(ServerStartupReport(),
+                                                 kStartupRomaInitPhase);
+        udf_client_or_status = UdfClient::Create(
+            std::move(
+                config_builder
+                    .RegisterStringGetValuesHook(*string_get_values_hook_)
+                    .RegisterStringGetValuesBatchHook(*string_get_values_hook_)
+                    .RegisterStringGetValuesAndSetsHook(
+                        *string_get_values_hook_)
+                    .RegisterStringGetValuesByPrefixHook(
+                        *string_get_values_hook_)
+                    .RegisterBinaryGetValuesHook(*binary_get_values_hook_)
+                    .RegisterFlatGetValuesHook(*binary_get_values_hook_)
+                    .RegisterRunQueryHook(*run_query_hook_)
+                    .RegisterApproxCardinalityHook(*run_query_hook_)
+                    .RegisterGetSetsContainingHook(*run_query_hook_)
+                    .RegisterLoggingFunction()
+                    .SetNumberOfWorkers(number_of_workers)
+                    .Config()),
+            absl::Milliseconds(udf_timeout_ms), udf_min_log_level,
+            GetUdfWarmUpOptions(parameter_fetcher),
+            /*batch_executions=*/GetOptionalInt32Parameter(
+                parameter_fetcher, kUdfMaxPartitionsPerExecutionParameterSuffix,
+                /*default_value=*/1) > 1);
+      });
+  if (!pin_status.ok()) {
+    LOG(ERROR) << "Failed pinning Roma workers to CPUs: " << pin_status;
+  }
   if (udf_client_or_status.ok()) {
     udf_client_ = std::move(*udf_client_or_status);
   }
@@ -346,38 +1328,43 @@ KeySharder GetKeySharder(const ParameterFetcher& parameter_fetcher) {
       parameter_fetcher.GetBoolParameter(kUseShardingKeyRegexParameterSuffix);
   LOG(INFO) << "Retrieved " << kUseShardingKeyRegexParameterSuffix
             << " parameter: " << use_sharding_key_regex;
-  ShardingFunction func(/*seed=*/"");
-  std::optional<std::regex> shard_key_regex;
-  if (use_sharding_key_regex) {
-    std::string sharding_key_regex_value =
-        parameter_fetcher.GetParameter(kShardingKeyRegexParameterSuffix);
-    LOG(INFO) << "Retrieved " << kShardingKeyRegexParameterSuffix
-              << " parameter: " << sharding_key_regex_value;
-    // https://en.cppreference.com/w/cpp/regex/syntax_option_type
-    // optimize -- "Instructs the regular expression engine to make matching
-    // faster, with the potential cost of making construction slower. For
-    // example, this might mean converting a non-deterministic FSA to a
-    // deterministic FSA." this matches our usecase.
-    shard_key_regex = std::regex(std::move(sharding_key_regex_value),
-                                 std::regex_constants::optimize);
-  }
-  return KeySharder(func, std::move(shard_key_regex));
+  auto hash_version = ToShardingHashVersion(GetOptionalInt32Parameter(
+      parameter_fetcher, kShardingHashVersionParameterSuffix,
+      /*default_value=*/0));
+  if (!hash_version.ok()) {
+    LOG(ERROR) << hash_version.status() << ". Sharding keys with SHA-256.";
+    hash_version = ShardingHashVersion::kSha256;
+  }
+  ShardingFunction func(/*seed=*/"", *hash_version);
+  const int32_t num_logical_shards = GetOptionalInt32Parameter(
+      parameter_fetcher, kNumLogicalShardsParameterSuffix,
+      /*default_value=*/0);
+  if (!use_sharding_key_regex) {
+    return KeySharder(func, /*shard_key_regex=*/std::nullopt,
+                      num_logical_shards);
+  }
+  const std::string sharding_key_regex_value =
+      parameter_fetcher.GetParameter(kShardingKeyRegexParameterSuffix);
+  LOG(INFO) << "Retrieved " << kShardingKeyRegexParameterSuffix
+            << " parameter: " << sharding_key_regex_value;
+  KeySharder key_sharder(func, sharding_key_regex_value, num_logical_shards);
+  LOG_IF(INFO, key_sharder.HasSimpleShardKeyRegex())
+      << "Extracting sharding keys without evaluating the regex.";
+  return key_sharder;
 }
 
 absl::Status Server::InitOnceInstancesAreCreated() {
-  const auto shard_num_status = instance_client_->GetShardNumTag();
-  if (!shard_num_status.ok()) {
-    return shard_num_status.status();
-  }
-  if (!absl::SimpleAtoi(*shard_num_status, &shard_num_)) {
-    std::string error =
-        absl::StrFormat("Failed converting shard id parameter: %s to int32.",
-                        *shard_num_status);
-    LOG(ERROR) << error;
-    return absl::InvalidArgumentError(error);
+  const auto shard_num = GetShardNum(*instance_client_);
+  if (!shard_num.ok()) {
+    return shard_num.status();
   }
+  shard_num_ = *shard_num;
   LOG(INFO) << "Retrieved shard num: " << shard_num_;
-  InitializeTelemetry(*parameter_client_, *instance_client_);
+  {
+    StartupReport::ScopedPhase startup_phase(ServerStartupReport(),
+                                             kStartupTelemetryInitPhase);
+    InitializeTelemetry(*parameter_client_, *instance_client_);
+  }
   InitializeKeyValueCache();
   auto span = GetTracer()->StartSpan("InitServer");
   auto scope = opentelemetry::trace::Scope(span);
@@ -392,7 +1379,13 @@ absl::Status Server::InitOnceInstancesAreCreated() {
     return status;
   }
 
-  if (absl::Status status = SetDefaultUdfCodeObject(); !status.ok()) {
+  absl::Status default_udf_status;
+  {
+    StartupReport::ScopedPhase startup_phase(ServerStartupReport(),
+                                             kStartupUdfCodeLoadPhase);
+    default_udf_status = SetDefaultUdfCodeObject();
+  }
+  if (!default_udf_status.ok()) {
     return absl::InternalError(
         "Error setting default UDF. Please contact Google to fix the default "
         "UDF or retry starting the server.");
@@ -401,8 +1394,90 @@ absl::Status Server::InitOnceInstancesAreCreated() {
   num_shards_ = parameter_fetcher.GetInt32Parameter(kNumShardsParameterSuffix);
   LOG(INFO) << "Retrieved " << kNumShardsParameterSuffix
             << " parameter: " << num_shards_;
+  const ServerRole server_role = GetServerRole(
+      GetOptionalBoolParameter(parameter_fetcher,
+                               kSeparateUdfServersParameterSuffix,
+                               /*default_value=*/false),
+      num_shards_, shard_num_);
+  // Data loading and the requests of sharded lookups to other shards run on
+  // one shared pool. 0 (default) uses one thread per hardware thread.
+  const int32_t shared_thread_pool_num_threads = GetOptionalInt32Parameter(
+      parameter_fetcher, kSharedThreadPoolNumThreadsParameterSuffix,
+      /*default_value=*/0);
+  if (!SetSharedThreadPoolSize(shared_thread_pool_num_threads)) {
+    LOG(WARNING) << "The shared thread pool was used before "
+                 << kSharedThreadPoolNumThreadsParameterSuffix
+                 << " was set, it keeps "
+                 << SharedThreadPool().num_threads() << " threads.";
+  }
+  // Files being loaded give way to request serving while its p99 latency is
+  // over the target. 0 (default) never throttles them.
+  const int32_t serving_p99_target_millis = GetOptionalInt32Parameter(
+      parameter_fetcher, kDataLoadingServingP99TargetMillisParameterSuffix,
+      /*default_value=*/0);
+  const int32_t throttle_delay_millis = GetOptionalInt32Parameter(
+      parameter_fetcher, kDataLoadingThrottleDelayMillisParameterSuffix,
+      /*default_value=*/5);
+  DataLoadingGovernor().SetOptions({
+      .serving_p99_target = absl::Milliseconds(serving_p99_target_millis),
+      .throttle_delay = absl::Milliseconds(throttle_delay_millis),
+  });
+  // 0 (default) leaves the memory freed by the process to the allocator, which
+  // keeps it for reuse. Otherwise it is returned to the OS after the initial
+  // data loading, and after cleanups of deleted values at most once per this
+  // many seconds, so that the resident memory follows the data.
+  const int32_t allocator_release_interval_seconds = GetOptionalInt32Parameter(
+      parameter_fetcher, kAllocatorReleaseIntervalSecondsParameterSuffix,
+      /*default_value=*/0);
+  // 0 (default) keeps the background release rate and the size of the
+  // per-CPU caches of tcmalloc.
+  const int32_t allocator_background_release_mb_per_second =
+      GetOptionalInt32Parameter(
+          parameter_fetcher,
+          kAllocatorBackgroundReleaseMbPerSecondParameterSuffix,
+          /*default_value=*/0);
+  const int32_t allocator_max_per_cpu_cache_kb = GetOptionalInt32Parameter(
+      parameter_fetcher, kAllocatorMaxPerCpuCacheKbParameterSuffix,
+      /*default_value=*/0);
+  ServerMemoryReleaser().SetOptions({
+      .background_release_bytes_per_second =
+          int64_t{allocator_background_release_mb_per_second} * 1024 * 1024,
+      .max_per_cpu_cache_bytes = allocator_max_per_cpu_cache_kb * 1024,
+      .min_release_interval =
+          allocator_release_interval_seconds > 0
+              ? absl::Seconds(allocator_release_interval_seconds)
+              : absl::InfiniteDuration(),
+  });
+  // Requests are rejected with UNAVAILABLE before being served when too many
+  // are in flight, or when too little time is left before their deadline.
+  // 0 (default) disables each check.
+  const int32_t admission_max_concurrent_requests = GetOptionalInt32Parameter(
+      parameter_fetcher, kAdmissionMaxConcurrentRequestsParameterSuffix,
+      /*default_value=*/0);
+  const int32_t admission_latency_target_millis = GetOptionalInt32Parameter(
+      parameter_fetcher, kAdmissionLatencyTargetMillisParameterSuffix,
+      /*default_value=*/0);
+  const int32_t admission_min_remaining_deadline_millis =
+      GetOptionalInt32Parameter(
+          parameter_fetcher,
+          kAdmissionMinRemainingDeadlineMillisParameterSuffix,
+          /*default_value=*/0);
+  const AdmissionController::Options admission_options = {
+      .max_concurrency = admission_max_concurrent_requests,
+      .latency_target = absl::Milliseconds(admission_latency_target_millis),
+      .min_remaining_deadline =
+          absl::Milliseconds(admission_min_remaining_deadline_millis),
+  };
+  ServingAdmissionController().SetOptions(admission_options);
+  InternalLookupAdmissionController().SetOptions(admission_options);
+  // One in every this many requests, picked at random, is traced stage by
+  // stage, with the lookups it sends other shards. 0 (default) traces none.
+  SetRequestTraceSampleInterval(GetOptionalInt32Parameter(
+      parameter_fetcher, kRequestTraceSampleIntervalParameterSuffix,
+      /*default_value=*/0));
 
   blob_client_ = CreateBlobClient(parameter_fetcher);
+  MaybeStartProfileDumper(parameter_fetcher);
   delta_stream_reader_factory_ =
       CreateStreamRecordReaderFactory(parameter_fetcher);
   notifier_ = CreateDeltaFileNotifier(parameter_fetcher);
@@ -418,12 +1493,215 @@ absl::Status Server::InitOnceInstancesAreCreated() {
   SetQueueManager(metadata, message_service_blob_.get());
 
   grpc_server_ = CreateAndStartGrpcServer();
-  local_lookup_ = CreateLocalLookup(*cache_);
+  if (native_http_handler_ != nullptr) {
+    auto native_http_server = NativeHttpServer::Start(
+        *native_http_handler_,
+        {.port = GetOptionalInt32Parameter(parameter_fetcher,
+                                           kNativeHttpPortParameterSuffix,
+                                           /*default_value=*/0)});
+    if (!native_http_server.ok()) {
+      return native_http_server.status();
+    }
+    native_http_server_ = *std::move(native_http_server);
+  }
+  // Operands of queries over large sets are run on a pool of
+  // `query_parallel_num_threads` threads. 0 (default) runs queries on the
+  // request thread.
+  const int32_t query_parallel_num_threads = GetOptionalInt32Parameter(
+      parameter_fetcher, kQueryParallelNumThreadsParameterSuffix,
+      /*default_value=*/0);
+  QueryProgram::ParallelOptions query_parallel_options;
+  if (query_parallel_num_threads > 0) {
+    query_thread_pool_ =
+        std::make_unique<ThreadPool>(query_parallel_num_threads);
+    query_parallel_options = {
+        .pool = query_thread_pool_.get(),
+        .min_parallel_size = GetOptionalInt32Parameter(
+            parameter_fetcher, kQueryParallelMinSetSizeParameterSuffix,
+            /*default_value=*/10000),
+    };
+  }
+  // The results of the most recent queries are kept until one of their sets
+  // changes. 0 disables the cache.
+  const int32_t query_result_cache_max_queries = GetOptionalInt32Parameter(
+      parameter_fetcher, kQueryResultCacheMaxQueriesParameterSuffix,
+      /*default_value=*/1000);
+  // The sketches of the sets of approximately counted queries are kept until
+  // their set changes. 0 disables the cache.
+  const int32_t set_sketch_cache_max_sets = GetOptionalInt32Parameter(
+      parameter_fetcher, kSetSketchCacheMaxSetsParameterSuffix,
+      /*default_value=*/1000);
+  local_lookup_ = CreateLocalLookup(*cache_, query_parallel_options,
+                                    query_result_cache_max_queries,
+                                    set_sketch_cache_max_sets);
   auto key_sharder = GetKeySharder(parameter_fetcher);
+  // Sharded servers keep copies of the most looked up keys of other shards.
+  const HotKeyCache::Options hot_key_cache_options = {
+      .max_keys = GetOptionalInt32Parameter(parameter_fetcher,
+                                            kHotKeyCacheMaxKeysParameterSuffix,
+                                            /*default_value=*/0),
+      .ttl = absl::Milliseconds(GetOptionalInt32Parameter(
+          parameter_fetcher, kHotKeyCacheTtlMillisParameterSuffix,
+          /*default_value=*/10000)),
+  };
+  // 0 disables the cache.
+  ServerLookupResponseCache().SetOptions({
+      .max_entries = GetOptionalInt32Parameter(
+          parameter_fetcher,
+          kRemoteLookupResponseCacheMaxEntriesParameterSuffix,
+          /*default_value=*/0),
+  });
+  const RemoteLookupServerOptions remote_lookup_server_options = {
+      .coalesce_lookups = GetOptionalBoolParameter(
+          parameter_fetcher, kCoalesceInternalLookupsParameterSuffix,
+          /*default_value=*/false),
+      .callback_api = GetOptionalBoolParameter(
+          parameter_fetcher, kRemoteLookupCallbackApiParameterSuffix,
+          /*default_value=*/false),
+      .num_cqs = GetOptionalInt32Parameter(parameter_fetcher,
+                                           kRemoteLookupNumCqsParameterSuffix,
+                                           /*default_value=*/0),
+      .min_pollers = GetOptionalInt32Parameter(
+          parameter_fetcher, kRemoteLookupMinPollersParameterSuffix,
+          /*default_value=*/0),
+      .max_pollers = GetOptionalInt32Parameter(
+          parameter_fetcher, kRemoteLookupMaxPollersParameterSuffix,
+          /*default_value=*/0),
+      .response_compression_min_bytes = GetOptionalInt32Parameter(
+          parameter_fetcher,
+          kRemoteLookupResponseCompressionMinBytesParameterSuffix,
+          /*default_value=*/0),
+      .stream_chunk_max_values = GetOptionalInt32Parameter(
+          parameter_fetcher, kRemoteLookupStreamChunkMaxValuesParameterSuffix,
+          /*default_value=*/kDefaultLookupStreamChunkMaxValues),
+      .response_cache = &ServerLookupResponseCache(),
+  };
+  const KeyLookupBatchingOptions key_lookup_batching_options = {
+      .max_batches_in_flight = GetOptionalInt32Parameter(
+          parameter_fetcher, kShardedLookupMaxBatchesInFlightParameterSuffix,
+          /*default_value=*/0),
+      .window = absl::Microseconds(GetOptionalInt32Parameter(
+          parameter_fetcher, kShardedLookupBatchWindowMicrosParameterSuffix,
+          /*default_value=*/0)),
+      .max_keys = GetOptionalInt32Parameter(
+          parameter_fetcher, kShardedLookupBatchMaxKeysParameterSuffix,
+          /*default_value=*/0),
+  };
+  const RequestPaddingOptions sharded_lookup_padding_options = {
+      .min_size_class_bytes = GetOptionalInt32Parameter(
+          parameter_fetcher,
+          kShardedLookupPaddingMinSizeClassBytesParameterSuffix,
+          /*default_value=*/0),
+  };
+  const HedgingOptions remote_lookup_hedging_options = {
+      .percentile = GetOptionalInt32Parameter(
+          parameter_fetcher, kRemoteLookupHedgePercentileParameterSuffix,
+          /*default_value=*/0),
+  };
+  const RemoteLookupClientOptions remote_lookup_client_options = {
+      .num_channels = GetOptionalInt32Parameter(
+          parameter_fetcher, kRemoteLookupNumChannelsParameterSuffix,
+          /*default_value=*/1),
+      .keepalive_time = absl::Milliseconds(GetOptionalInt32Parameter(
+          parameter_fetcher, kRemoteLookupKeepaliveTimeMillisParameterSuffix,
+          /*default_value=*/0)),
+      .keepalive_timeout = absl::Milliseconds(GetOptionalInt32Parameter(
+          parameter_fetcher, kRemoteLookupKeepaliveTimeoutMillisParameterSuffix,
+          /*default_value=*/0)),
+      .initial_window_size_bytes = GetOptionalInt32Parameter(
+          parameter_fetcher, kRemoteLookupInitialWindowSizeBytesParameterSuffix,
+          /*default_value=*/0),
+      .stream_responses = GetOptionalBoolParameter(
+          parameter_fetcher, kRemoteLookupStreamKeySetsParameterSuffix,
+          /*default_value=*/false),
+      .timeout = absl::Milliseconds(GetOptionalInt32Parameter(
+          parameter_fetcher, kRemoteLookupTimeoutMillisParameterSuffix,
+          /*default_value=*/0)),
+  };
+  // A threshold of 0 disables the circuit breakers.
+  const ShardCircuitBreaker::Options shard_circuit_breaker_options = {
+      .failure_threshold = GetOptionalInt32Parameter(
+          parameter_fetcher,
+          kShardCircuitBreakerFailureThresholdParameterSuffix,
+          /*default_value=*/0),
+      .open_duration = absl::Milliseconds(GetOptionalInt32Parameter(
+          parameter_fetcher, kShardCircuitBreakerOpenMillisParameterSuffix,
+          /*default_value=*/1000)),
+  };
+  const bool sharded_lookup_partial_key_sets = GetOptionalBoolParameter(
+      parameter_fetcher, kShardedLookupPartialKeySetsParameterSuffix,
+      /*default_value=*/false);
+  const RequestWarmUpOptions request_warm_up_options =
+      GetRequestWarmUpOptions(parameter_fetcher);
   auto server_initializer = GetServerInitializer(
       num_shards_, *key_fetcher_manager_, *local_lookup_, environment_,
-      shard_num_, *instance_client_, *cache_, parameter_fetcher, key_sharder);
+      server_role == ServerRole::kUdfOnly ? kNoLocalShard : shard_num_,
+      *instance_client_, *cache_, parameter_fetcher, key_sharder,
+      hot_key_cache_options, remote_lookup_server_options,
+      key_lookup_batching_options, remote_lookup_hedging_options,
+      remote_lookup_client_options, sharded_lookup_padding_options,
+      shard_circuit_breaker_options, sharded_lookup_partial_key_sets,
+      set_sketch_cache_max_sets);
   remote_lookup_ = server_initializer->CreateAndStartRemoteLookupServer();
+  // Servers that only run UDFs hold no data.
+  if (server_role != ServerRole::kUdfOnly) {
+    if (absl::Status status = StartDataLoading(parameter_fetcher, key_sharder,
+                                               std::move(metadata));
+        !status.ok()) {
+      return status;
+    }
+  } else {
+    grpc_server_->GetHealthCheckService()->SetServingStatus(
+        std::string(kDeltaCatchUpHealthcheck), true);
+  }
+  if (num_shards_ > 1) {
+    // At this point the server is healthy and the initialization is over.
+    // The only missing piece is having a shard map, which is dependent on
+    // other instances being `healthy`. Mark this instance as healthy so that
+    // other instances can pull it in for their mapping.
+    lifecycle_heartbeat->Finish();
+  }
+  absl::StatusOr<ShardManagerState> maybe_shard_state;
+  {
+    // Sharded servers fetch the cluster mapping of the other shards.
+    StartupReport::ScopedPhase startup_phase(ServerStartupReport(),
+                                             kStartupClusterMappingFetchPhase);
+    maybe_shard_state = server_initializer->InitializeUdfHooks(
+        *string_get_values_hook_, *binary_get_values_hook_, *run_query_hook_);
+  }
+  if (!maybe_shard_state.ok()) {
+    return maybe_shard_state.status();
+  }
+  shard_manager_state_ = *std::move(maybe_shard_state);
+
+  if (request_warm_up_options.num_requests > 0) {
+    // Sample requests go through the whole serving path before the load
+    // balancer sends traffic, so that the first requests don't hit a cold
+    // server. The server reports healthy even if the warm-up fails.
+    StartupReport::ScopedPhase startup_phase(ServerStartupReport(),
+                                             kStartupRequestWarmUpPhase);
+    auto stub = v2::KeyValueService::NewStub(
+        grpc_server_->InProcessChannel(grpc::ChannelArguments()));
+    if (const auto stats = WarmUpWithRequests(*stub, request_warm_up_options);
+        stats.ok()) {
+      LOG(INFO) << "Warmed up with " << stats->num_requests << " requests, "
+                << stats->num_failed_requests << " failed, in "
+                << stats->duration;
+    } else {
+      LOG(ERROR) << "Failed warming up with requests: " << stats.status();
+    }
+  }
+  grpc_server_->GetHealthCheckService()->SetServingStatus(
+      std::string(kLoadbalancerHealthcheck), true);
+  ServerStartupReport().MarkReady();
+  LOG(INFO) << "Server ready, startup report: "
+            << ServerStartupReport().ToJson();
+  return absl::OkStatus();
+}
+
+absl::Status Server::StartDataLoading(
+    const ParameterFetcher& parameter_fetcher, KeySharder key_sharder,
+    NotifierMetadata metadata) {
   {
     auto status_or_notifier =
         BlobStorageChangeNotifier::Create(std::move(metadata));
@@ -454,26 +1732,42 @@ absl::Status Server::InitOnceInstancesAreCreated() {
   }
   realtime_thread_pool_manager_ =
       std::move(*maybe_realtime_thread_pool_manager);
-  data_orchestrator_ = CreateDataOrchestrator(parameter_fetcher, key_sharder);
+  // The realtime threads are the budget of realtime updates, of which only as
+  // many as the backlog needs apply updates at once.
+  const int32_t realtime_min_threads = GetOptionalInt32Parameter(
+      parameter_fetcher, kRealtimeUpdaterMinThreadsParameterSuffix,
+      /*default_value=*/0);
+  if (realtime_min_threads > 0 &&
+      realtime_min_threads < static_cast<int32_t>(realtime_thread_numbers)) {
+    realtime_thread_pool_manager_ = WithAdaptiveConcurrencyLimit(
+        std::move(realtime_thread_pool_manager_),
+        {.min_concurrency = realtime_min_threads,
+         .max_concurrency = static_cast<int>(realtime_thread_numbers)});
+  }
+  data_orchestrator_ =
+      CreateDataOrchestrator(parameter_fetcher, std::move(key_sharder));
+  {
+    // The UDF code objects found in the data files are loaded in the
+    // background. Waiting for them keeps the server from reporting ready, and
+    // warming up, with the default UDF.
+    StartupReport::ScopedPhase startup_phase(ServerStartupReport(),
+                                             kStartupUdfCodeLoadPhase);
+    if (const absl::Status status = udf_client_->WaitForCodeObjectLoads(
+            kStartupUdfCodeObjectLoadTimeout);
+        !status.ok()) {
+      LOG(ERROR) << "Failed loading the UDF code object of the data files: "
+                 << status;
+    }
+  }
+  // The initial loading frees the memory of replaced values and of the
+  // buffers of the files.
+  ServerMemoryReleaser().Release();
+  // Scans the whole cache, so only with verbose logging.
+  VLOG(1) << "Cache memory after the initial data loading:\n"
+          << cache_->DebugMemoryReport(/*num_largest=*/20);
   TraceRetryUntilOk([this] { return data_orchestrator_->Start(); },
                     "StartDataOrchestrator",
                     LogStatusSafeMetricsFn<kStartDataOrchestratorStatus>());
-  if (num_shards_ > 1) {
-    // At this point the server is healthy and the initialization is over.
-    // The only missing piece is having a shard map, which is dependent on
-    // other instances being `healthy`. Mark this instance as healthy so that
-    // other instances can pull it in for their mapping.
-    lifecycle_heartbeat->Finish();
-  }
-  auto maybe_shard_state = server_initializer->InitializeUdfHooks(
-      *string_get_values_hook_, *binary_get_values_hook_, *run_query_hook_);
-  if (!maybe_shard_state.ok()) {
-    return maybe_shard_state.status();
-  }
-  shard_manager_state_ = *std::move(maybe_shard_state);
-
-  grpc_server_->GetHealthCheckService()->SetServingStatus(
-      std::string(kLoadbalancerHealthcheck), true);
   return absl::OkStatus();
 }
 
@@ -496,6 +1790,9 @@ absl::Status Server::MaybeShutdownNotifiers() {
 
 void Server::GracefulShutdown(absl::Duration timeout) {
   LOG(INFO) << "Graceful gRPC server shutdown requested, timeout: " << timeout;
+  if (native_http_server_) {
+    native_http_server_->Stop();
+  }
   if (internal_lookup_server_) {
     internal_lookup_server_->Shutdown();
   }
@@ -525,10 +1822,56 @@ void Server::GracefulShutdown(absl::Duration timeout) {
   if (!status.ok()) {
     LOG(ERROR) << "Failed to shutdown notifiers.  Got status " << status;
   }
+  if (profile_dumper_) {
+    profile_dumper_->Stop();
+  }
+}
+
+// Nonprod servers can write profiles to a bucket, under the ID of their
+// instance. An empty bucket (default) disables the profiles.
+void Server::MaybeStartProfileDumper(
+    const ParameterFetcher& parameter_fetcher) {
+  const std::string bucket = parameter_fetcher.GetParameter(
+      kProfilingBucketParameterSuffix, /*default_value=*/"");
+  if (bucket.empty()) {
+    return;
+  }
+  LOG(INFO) << "Retrieved " << kProfilingBucketParameterSuffix
+            << " parameter: " << bucket;
+  const absl::StatusOr<std::string> instance_id =
+      instance_client_->GetInstanceId();
+  auto profile_dumper = ProfileDumper::Create(
+      {
+          .location = {.bucket = bucket,
+                       .prefix = instance_id.value_or("unknown_instance")},
+          .interval = absl::Milliseconds(GetOptionalInt32Parameter(
+              parameter_fetcher, kProfilingIntervalMillisParameterSuffix,
+              /*default_value=*/600000)),
+          .cpu_profile_duration = absl::Milliseconds(GetOptionalInt32Parameter(
+              parameter_fetcher, kProfilingCpuDurationMillisParameterSuffix,
+              /*default_value=*/10000)),
+          .contention_sample_interval = GetOptionalInt32Parameter(
+              parameter_fetcher,
+              kProfilingContentionSampleIntervalParameterSuffix,
+              /*default_value=*/0),
+      },
+      *blob_client_);
+  absl::Status status = profile_dumper.status();
+  if (status.ok()) {
+    status = (*profile_dumper)->Start();
+  }
+  if (!status.ok()) {
+    LOG(ERROR) << "Failed to start dumping profiles: " << status;
+    return;
+  }
+  profile_dumper_ = *std::move(profile_dumper);
 }
 
 void Server::ForceShutdown() {
   LOG(WARNING) << "Immediate gRPC server shutdown requested";
+  if (native_http_server_) {
+    native_http_server_->Stop();
+  }
   if (internal_lookup_server_) {
     internal_lookup_server_->Shutdown();
   }
@@ -544,6 +1887,9 @@ void Server::ForceShutdown() {
   if (!status.ok()) {
     LOG(ERROR) << "Failed to shutdown notifiers.  Got status " << status;
   }
+  if (profile_dumper_) {
+    profile_dumper_->Stop();
+  }
   if (udf_client_) {
     const absl::Status status = udf_client_->Stop();
     if (!status.ok()) {
@@ -566,8 +1912,28 @@ std::unique_ptr<BlobStorageClient> Server::CreateBlobClient(
       parameter_fetcher.GetBlobStorageClientOptions();
   std::unique_ptr<BlobStorageClientFactory> blob_storage_client_factory =
       BlobStorageClientFactory::Create();
-  return blob_storage_client_factory->CreateBlobStorageClient(
-      std::move(client_options));
+  // If set, data files are kept in this local directory once downloaded, so
+  // that restarts don't download them again.
+  const std::string blob_cache_directory = parameter_fetcher.GetParameter(
+      kBlobCacheDirectoryParameterSuffix, /*default_value=*/"");
+  if (blob_cache_directory.empty()) {
+    return blob_storage_client_factory->CreateBlobStorageClient(
+        std::move(client_options));
+  }
+  const int32_t blob_cache_max_mb = GetOptionalInt32Parameter(
+      parameter_fetcher, kBlobCacheMaxMbParameterSuffix,
+      /*default_value=*/10240);
+  auto caching_client = CachingBlobStorageClient::Create(
+      blob_storage_client_factory->CreateBlobStorageClient(client_options),
+      {.directory = blob_cache_directory,
+       .max_bytes = int64_t{blob_cache_max_mb} * 1024 * 1024});
+  if (!caching_client.ok()) {
+    LOG(ERROR) << "Reading data files without local copies: "
+               << caching_client.status();
+    return blob_storage_client_factory->CreateBlobStorageClient(
+        std::move(client_options));
+  }
+  return *std::move(caching_client);
 }
 
 std::unique_ptr<StreamRecordReaderFactory>
@@ -597,6 +1963,71 @@ std::unique_ptr<DataOrchestrator> Server::CreateDataOrchestrator(
       parameter_fetcher.GetParameter(kDataBucketParameterSuffix);
   LOG(INFO) << "Retrieved " << kDataBucketParameterSuffix
             << " parameter: " << data_bucket;
+  // If set, the cache is written to this local file periodically, and loaded
+  // from it on start instead of from the snapshots.
+  const std::string cache_image_path = parameter_fetcher.GetParameter(
+      kCacheImagePathParameterSuffix, /*default_value=*/"");
+  const int32_t cache_image_interval_minutes = GetOptionalInt32Parameter(
+      parameter_fetcher, kCacheImageIntervalMinutesParameterSuffix,
+      /*default_value=*/30);
+  const int32_t max_concurrent_file_loads = GetOptionalInt32Parameter(
+      parameter_fetcher, kDataLoadingMaxConcurrentFilesParameterSuffix,
+      /*default_value=*/4);
+  const int32_t max_queued_files = GetOptionalInt32Parameter(
+      parameter_fetcher, kDataLoadingMaxQueuedFilesParameterSuffix,
+      /*default_value=*/1000);
+  const int32_t snapshot_check_backlog = GetOptionalInt32Parameter(
+      parameter_fetcher, kDataLoadingSnapshotCheckBacklogParameterSuffix,
+      /*default_value=*/10);
+  const int32_t catch_up_min_files = GetOptionalInt32Parameter(
+      parameter_fetcher, kDataLoadingCatchUpMinFilesParameterSuffix,
+      /*default_value=*/20);
+  const int32_t trusted_file_verification_interval = GetOptionalInt32Parameter(
+      parameter_fetcher,
+      kDataLoadingTrustedFileVerificationIntervalParameterSuffix,
+      /*default_value=*/1);
+  const int32_t loader_thread_nice_increment = GetOptionalInt32Parameter(
+      parameter_fetcher, kDataLoadingThreadNiceIncrementParameterSuffix,
+      /*default_value=*/0);
+  const int32_t realtime_batch_window_millis = GetOptionalInt32Parameter(
+      parameter_fetcher, kRealtimeUpdaterBatchWindowMillisParameterSuffix,
+      /*default_value=*/0);
+  // If the data is written with logical commit times in microseconds since
+  // the epoch, the time from the commit of the records to their mutations
+  // being applied is recorded. Off by default, the times may be anything.
+  SetLogicalCommitTimesAreEpochMicros(GetOptionalBoolParameter(
+      parameter_fetcher, kLogicalCommitTimeIsEpochMicrosParameterSuffix,
+      /*default_value=*/false));
+  // If set, this server publishes its cache as snapshots. Set on one server
+  // per shard.
+  const int32_t snapshot_publish_interval_minutes = GetOptionalInt32Parameter(
+      parameter_fetcher, kDataLoadingSnapshotPublishIntervalMinutesSuffix,
+      /*default_value=*/0);
+  const std::string snapshot_publish_directory = parameter_fetcher.GetParameter(
+      kDataLoadingSnapshotPublishDirectorySuffix, /*default_value=*/"/tmp");
+  // If set, the server serves the data of the snapshots while it loads the
+  // delta files after them, and reports the end of the catch-up through
+  // `kDeltaCatchUpHealthcheck`.
+  const bool serve_before_delta_catch_up = GetOptionalBoolParameter(
+      parameter_fetcher, kDataLoadingServeBeforeDeltaCatchUpSuffix,
+      /*default_value=*/false);
+  // If set, the replicas of each shard share the records of the shard in the
+  // data files through this directory, which they all mount.
+  const std::string shard_copy_directory = parameter_fetcher.GetParameter(
+      kDataLoadingShardCopyDirectorySuffix, /*default_value=*/"");
+  const int32_t shard_copy_wait_millis = GetOptionalInt32Parameter(
+      parameter_fetcher, kDataLoadingShardCopyWaitMillisSuffix,
+      /*default_value=*/300000);
+  if (!shard_copy_directory.empty() && num_shards_ > 1) {
+    shard_file_store_ =
+        std::make_unique<ShardFileStore>(ShardFileStore::Options{
+            .directory = shard_copy_directory,
+            .shard_num = shard_num_,
+            .num_shards = num_shards_,
+            .sharding_hash_version =
+                static_cast<int32_t>(key_sharder.hash_version()),
+            .wait_timeout = absl::Milliseconds(shard_copy_wait_millis)});
+  }
   auto metrics_callback =
       LogStatusSafeMetricsFn<kCreateDataOrchestratorStatus>();
   return TraceRetryUntilOk(
@@ -614,6 +2045,34 @@ std::unique_ptr<DataOrchestrator> Server::CreateDataOrchestrator(
             .num_shards = num_shards_,
             .key_sharder = std::move(key_sharder),
             .blob_prefix_allowlist = GetBlobPrefixAllowlist(parameter_fetcher),
+            .tombstone_cleaner = tombstone_cleaner_.get(),
+            .generational_cache = generational_cache_,
+            .snapshot_check_interval =
+                absl::Seconds(cache_snapshot_reload_interval_seconds_),
+            .cache_image_path = cache_image_path,
+            .cache_image_interval =
+                absl::Minutes(std::max(cache_image_interval_minutes, 1)),
+            .max_concurrent_file_loads = max_concurrent_file_loads,
+            .max_queued_files = max_queued_files,
+            .snapshot_check_backlog = snapshot_check_backlog,
+            .catch_up_min_files = catch_up_min_files,
+            .trusted_file_verification_interval =
+                trusted_file_verification_interval,
+            .realtime_batch_window =
+                absl::Milliseconds(realtime_batch_window_millis),
+            .loader_thread_nice_increment = loader_thread_nice_increment,
+            .snapshot_publish_interval =
+                absl::Minutes(snapshot_publish_interval_minutes),
+            .snapshot_publish_directory = snapshot_publish_directory,
+            .shard_file_store = shard_file_store_.get(),
+            .serve_before_delta_catch_up = serve_before_delta_catch_up,
+            .on_delta_catch_up_done =
+                [this] {
+                  if (grpc_server_) {
+                    grpc_server_->GetHealthCheckService()->SetServingStatus(
+                        std::string(kDeltaCatchUpHealthcheck), true);
+                  }
+                },
         });
       },
       "CreateDataOrchestrator", metrics_callback);
@@ -624,14 +2083,70 @@ void Server::CreateGrpcServices(const ParameterFetcher& parameter_fetcher) {
   const bool add_missing_keys_v1 =
       parameter_fetcher.GetBoolParameter(kAddMissingKeysV1Suffix);
   LOG(INFO) << "Retrieved " << kRouteV1ToV2Suffix << " parameter: " << use_v2;
+  grpc_server_cpus_ = GetOptionalCpuListParameter(
+      parameter_fetcher, kGrpcServerCpusParameterSuffix);
+  const int32_t max_concurrent_partitions = GetOptionalInt32Parameter(
+      parameter_fetcher, kMaxConcurrentPartitionsParameterSuffix,
+      /*default_value=*/GetValuesV2Handler::kDefaultMaxConcurrentPartitions);
+  // Only correct if the UDF returns the same output for the same input.
+  const bool coalesce_udf_executions = GetOptionalBoolParameter(
+      parameter_fetcher, kCoalesceUdfExecutionsParameterSuffix,
+      /*default_value=*/false);
+  const bool use_fast_json_codec = GetOptionalBoolParameter(
+      parameter_fetcher, kFastV2JsonCodecParameterSuffix,
+      /*default_value=*/false);
+  const int32_t max_partitions_per_udf_execution = GetOptionalInt32Parameter(
+      parameter_fetcher, kUdfMaxPartitionsPerExecutionParameterSuffix,
+      /*default_value=*/1);
+  // Only code objects that allow it have their outputs cached. 0 disables the
+  // cache.
+  ServerUdfOutputCache().SetOptions({
+      .max_entries = GetOptionalInt32Parameter(
+          parameter_fetcher, kUdfOutputCacheMaxEntriesParameterSuffix,
+          /*default_value=*/0),
+      .ttl = absl::Milliseconds(GetOptionalInt32Parameter(
+          parameter_fetcher, kUdfOutputCacheTtlMillisParameterSuffix,
+          /*default_value=*/10000)),
+  });
+  auto create_concatenator =
+      [options = GetCompressionOptions(parameter_fetcher)](
+          CompressionGroupConcatenator::CompressionType type) {
+        return CompressionGroupConcatenator::CreateWithOptions(type, options);
+      };
   get_values_adapter_ =
       GetValuesAdapter::Create(std::make_unique<GetValuesV2Handler>(
-          *udf_client_, *key_fetcher_manager_));
-  GetValuesHandler handler(*cache_, *get_values_adapter_, use_v2,
-                           add_missing_keys_v1);
+          *udf_client_, *key_fetcher_manager_, create_concatenator,
+          max_concurrent_partitions, coalesce_udf_executions,
+          &ServerUdfOutputCache(), use_fast_json_codec,
+          max_partitions_per_udf_execution));
+  v1_value_cache_ = std::make_unique<V1ValueCache>(GetOptionalInt32Parameter(
+      parameter_fetcher, kV1ValueCacheMaxKeysParameterSuffix,
+      /*default_value=*/0));
+  GetValuesHandler handler(
+      *cache_, *get_values_adapter_, use_v2, add_missing_keys_v1,
+      v1_value_cache_.get(),
+      GetOptionalBoolParameter(parameter_fetcher,
+                               kCoalesceV1RequestsParameterSuffix,
+                               /*default_value=*/false));
   grpc_services_.push_back(
       std::make_unique<KeyValueServiceImpl>(std::move(handler)));
-  GetValuesV2Handler v2handler(*udf_client_, *key_fetcher_manager_);
+  // HTTP requests are served in process, instead of through Envoy, on a port
+  // of their own. 0 (default) leaves them to Envoy.
+  if (GetOptionalInt32Parameter(parameter_fetcher,
+                                kNativeHttpPortParameterSuffix,
+                                /*default_value=*/0) > 0) {
+    native_http_handler_ = std::make_unique<GetValuesV2Handler>(
+        *udf_client_, *key_fetcher_manager_, create_concatenator,
+        max_concurrent_partitions, coalesce_udf_executions,
+        &ServerUdfOutputCache(), use_fast_json_codec,
+        max_partitions_per_udf_execution);
+  }
+  GetValuesV2Handler v2handler(*udf_client_, *key_fetcher_manager_,
+                               std::move(create_concatenator),
+                               max_concurrent_partitions,
+                               coalesce_udf_executions,
+                               &ServerUdfOutputCache(), use_fast_json_codec,
+                               max_partitions_per_udf_execution);
   grpc_services_.push_back(
       std::make_unique<KeyValueServiceV2Impl>(std::move(v2handler)));
 }
@@ -658,11 +2173,20 @@ std::unique_ptr<grpc::Server> Server::CreateAndStartGrpcServer() {
   }
   // Finally assemble the server.
   LOG(INFO) << "Server listening on " << server_address << std::endl;
-  auto server = builder.BuildAndStart();
+  std::unique_ptr<grpc::Server> server;
+  // The threads that serve requests are started with the server, and run on
+  // the CPUs it is started on.
+  if (const absl::Status status = CallPinnedTo(
+          grpc_server_cpus_, [&] { server = builder.BuildAndStart(); });
+      !status.ok()) {
+    LOG(ERROR) << "Failed pinning gRPC server threads to CPUs: " << status;
+  }
   server->GetHealthCheckService()->SetServingStatus(
       std::string(kAutoscalerHealthcheck), true);
   server->GetHealthCheckService()->SetServingStatus(
       std::string(kLoadbalancerHealthcheck), false);
+  server->GetHealthCheckService()->SetServingStatus(
+      std::string(kDeltaCatchUpHealthcheck), false);
   return std::move(server);
 }
 
@@ -681,10 +2205,16 @@ std::unique_ptr<DeltaFileNotifier> Server::CreateDeltaFileNotifier(
       kBackupPollFrequencySecsParameterSuffix);
   LOG(INFO) << "Retrieved " << kBackupPollFrequencySecsParameterSuffix
             << " parameter: " << backup_poll_frequency_secs;
+  // If set, the delta files named by change notifications are loaded without
+  // listing the bucket, which is then only listed every backup poll to find
+  // the files whose notification was lost or late.
+  const bool notifications_trusted = GetOptionalBoolParameter(
+      parameter_fetcher, kDeltaFileNotificationsTrustedParameterSuffix,
+      /*default_value=*/false);
 
-  return DeltaFileNotifier::Create(*blob_client_,
-                                   absl::Seconds(backup_poll_frequency_secs),
-                                   GetBlobPrefixAllowlist(parameter_fetcher));
+  return DeltaFileNotifier::Create(
+      *blob_client_, absl::Seconds(backup_poll_frequency_secs),
+      GetBlobPrefixAllowlist(parameter_fetcher), notifications_trusted);
 }
 
 }  // namespace kv_server
@@ -28,20 +28,27 @@
 #include "components/data/blob_storage/delta_file_notifier.h"
 #include "components/data/realtime/realtime_thread_pool_manager.h"
 #include "components/data_server/cache/cache.h"
+#include "components/data_server/cache/generational_cache.h"
 #include "components/data_server/cache/key_value_cache.h"
+#include "components/data_server/cache/tombstone_cleaner.h"
 #include "components/data_server/data_loading/data_orchestrator.h"
+#include "components/data_server/data_loading/shard_file_store.h"
 #include "components/data_server/request_handler/get_values_adapter.h"
+#include "components/data_server/request_handler/v1_value_cache.h"
 #include "components/data_server/server/lifecycle_heartbeat.h"
+#include "components/data_server/server/native_http_server.h"
 #include "components/data_server/server/parameter_fetcher.h"
 #include "components/data_server/server/server_initializer.h"
 #include "components/internal_server/lookup.h"
 #include "components/sharding/cluster_mappings_manager.h"
 #include "components/sharding/shard_manager.h"
 #include "components/telemetry/open_telemetry_sink.h"
+#include "components/telemetry/profile_dumper.h"
 #include "components/udf/hooks/get_values_hook.h"
 #include "components/udf/hooks/run_query_hook.h"
 #include "components/udf/udf_client.h"
 #include "components/util/platform_initializer.h"
+#include "components/util/thread_pool.h"
 #include "grpcpp/grpcpp.h"
 #include "public/base_types.pb.h"
 #include "public/query/get_values.grpc.pb.h"
@@ -86,6 +93,10 @@ class Server {
       const ParameterFetcher& parameter_fetcher);
   std::unique_ptr<DataOrchestrator> CreateDataOrchestrator(
       const ParameterFetcher& parameter_fetcher, KeySharder key_sharder);
+  // Starts loading the data of the shard and keeping it up to date.
+  absl::Status StartDataLoading(const ParameterFetcher& parameter_fetcher,
+                                KeySharder key_sharder,
+                                NotifierMetadata metadata);
 
   void CreateGrpcServices(const ParameterFetcher& parameter_fetcher);
   absl::Status MaybeShutdownNotifiers();
@@ -100,6 +111,8 @@ class Server {
 
   absl::Status SetDefaultUdfCodeObject();
 
+  void MaybeStartProfileDumper(const ParameterFetcher& parameter_fetcher);
+
   void InitializeTelemetry(const ParameterClient& parameter_client,
                            InstanceClient& instance_client);
   absl::Status CreateShardManager();
@@ -116,13 +129,24 @@ class Server {
   std::vector<std::unique_ptr<grpc::Service>> grpc_services_;
   std::unique_ptr<grpc::Server> grpc_server_;
   std::unique_ptr<Cache> cache_;
+  // Removes deleted values from `cache_` in the background, if enabled.
+  std::unique_ptr<TombstoneCleaner> tombstone_cleaner_;
+  // Owned by `cache_`, set if the cache is rebuilt from new snapshots.
+  GenerationalCache* generational_cache_ = nullptr;
+  int32_t cache_snapshot_reload_interval_seconds_ = 0;
+  // CPUs that the threads of the gRPC server run on. Any CPU if empty.
+  std::vector<int> grpc_server_cpus_;
   std::unique_ptr<GetValuesAdapter> get_values_adapter_;
+  // Parsed v1 values, shared by the v1 handlers created from this server.
+  std::unique_ptr<V1ValueCache> v1_value_cache_;
   std::unique_ptr<GetValuesHook> string_get_values_hook_;
   std::unique_ptr<GetValuesHook> binary_get_values_hook_;
   std::unique_ptr<RunQueryHook> run_query_hook_;
 
   // BlobStorageClient must outlive DeltaFileNotifier
   std::unique_ptr<BlobStorageClient> blob_client_;
+  // Writes profiles with `blob_client_`.
+  std::unique_ptr<ProfileDumper> profile_dumper_;
 
   std::unique_ptr<MessageService> message_service_blob_;
   std::unique_ptr<MessageService> message_service_realtime_;
@@ -132,9 +156,12 @@ class Server {
   std::unique_ptr<BlobStorageChangeNotifier> change_notifier_;
   std::unique_ptr<RealtimeThreadPoolManager> realtime_thread_pool_manager_;
   std::unique_ptr<StreamRecordReaderFactory> delta_stream_reader_factory_;
+  std::unique_ptr<ShardFileStore> shard_file_store_;
 
   std::unique_ptr<DataOrchestrator> data_orchestrator_;
 
+  // Runs the operands of queries of `local_lookup_` in parallel, if enabled.
+  std::unique_ptr<ThreadPool> query_thread_pool_;
   // Helper for lookup.proto calls that reads from local cache only
   std::unique_ptr<Lookup> local_lookup_;
   // Helper for lookup.proto calls that reads from shards
@@ -154,6 +181,10 @@ class Server {
 
   std::unique_ptr<privacy_sandbox::server_common::KeyFetcherManagerInterface>
       key_fetcher_manager_;
+  // Serves the HTTP routes of the v2 API without Envoy, if enabled. Declared
+  // after what its handler uses, so that it stops first.
+  std::unique_ptr<GetValuesV2Handler> native_http_handler_;
+  std::unique_ptr<NativeHttpServer> native_http_server_;
   std::unique_ptr<opentelemetry::logs::LoggerProvider> log_provider_;
   std::unique_ptr<OpenTelemetrySink> open_telemetry_sink_;
 };
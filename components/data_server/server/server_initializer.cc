@@ -16,12 +16,14 @@
 
 #include "components/data_server/server/server_initializer.h"
 
+#include <memory>
 #include <utility>
 
 #include "absl/log/log.h"
 #include "components/internal_server/constants.h"
 #include "components/internal_server/local_lookup.h"
 #include "components/internal_server/lookup_server_impl.h"
+#include "components/internal_server/memoized_lookup.h"
 #include "components/internal_server/sharded_lookup.h"
 #include "src/encryption/key_fetcher/key_fetcher_manager.h"
 
@@ -29,22 +31,35 @@ namespace kv_server {
 namespace {
 using privacy_sandbox::server_common::KeyFetcherManagerInterface;
 
+// With a `local_cache`, which holds all the keys, `getValues` reads them
+// straight from it.
 absl::Status InitializeUdfHooksInternal(
     std::function<std::unique_ptr<Lookup>()> get_lookup,
     GetValuesHook& string_get_values_hook,
-    GetValuesHook& binary_get_values_hook, RunQueryHook& run_query_hook) {
-  VLOG(9) << "Finishing getValues init";
-  string_get_values_hook.FinishInit(get_lookup());
-  VLOG(9) << "Finishing getValuesBinary init";
-  binary_get_values_hook.FinishInit(get_lookup());
+    GetValuesHook& binary_get_values_hook, RunQueryHook& run_query_hook,
+    const Cache* local_cache = nullptr) {
+  // Keys, sets and queries that UDFs look up again within a request are served
+  // from the memo of the request. Keys read from `local_cache` skip the memo,
+  // which would cost as much as the cache lookup.
+  VLOG(9) << "Finishing getValues and getValuesBinary init";
+  if (local_cache != nullptr) {
+    string_get_values_hook.FinishInitWithLocalCache(
+        CreateMemoizedLookup(get_lookup()), *local_cache);
+    binary_get_values_hook.FinishInitWithLocalCache(
+        CreateMemoizedLookup(get_lookup()), *local_cache);
+  } else {
+    string_get_values_hook.FinishInit(CreateMemoizedLookup(get_lookup()));
+    binary_get_values_hook.FinishInit(CreateMemoizedLookup(get_lookup()));
+  }
   VLOG(9) << "Finishing runQuery init";
-  run_query_hook.FinishInit(get_lookup());
+  run_query_hook.FinishInit(CreateMemoizedLookup(get_lookup()));
   return absl::OkStatus();
 }
 
 class NonshardedServerInitializer : public ServerInitializer {
  public:
-  explicit NonshardedServerInitializer(Cache& cache) : cache_(cache) {}
+  NonshardedServerInitializer(Cache& cache, int set_sketch_cache_max_sets)
+      : cache_(cache), set_sketch_cache_max_sets_(set_sketch_cache_max_sets) {}
 
   RemoteLookup CreateAndStartRemoteLookupServer() override {
     RemoteLookup remote_lookup;
@@ -56,17 +71,20 @@ class NonshardedServerInitializer : public ServerInitializer {
       GetValuesHook& binary_get_values_hook,
       RunQueryHook& run_query_hook) override {
     ShardManagerState shard_manager_state;
-    auto lookup_supplier = [&cache = cache_]() {
-      return CreateLocalLookup(cache);
+    auto lookup_supplier = [&cache = cache_,
+                            max_sets = set_sketch_cache_max_sets_]() {
+      return CreateLocalLookup(cache, /*query_parallel_options=*/{},
+                               /*max_cached_query_results=*/0, max_sets);
     };
     InitializeUdfHooksInternal(std::move(lookup_supplier),
                                string_get_values_hook, binary_get_values_hook,
-                               run_query_hook);
+                               run_query_hook, &cache_);
     return shard_manager_state;
   }
 
  private:
   Cache& cache_;
+  const int set_sketch_cache_max_sets_;
 };
 
 class ShardedServerInitializer : public ServerInitializer {
@@ -75,7 +93,14 @@ class ShardedServerInitializer : public ServerInitializer {
       KeyFetcherManagerInterface& key_fetcher_manager, Lookup& local_lookup,
       std::string environment, int32_t num_shards, int32_t current_shard_num,
       InstanceClient& instance_client, ParameterFetcher& parameter_fetcher,
-      KeySharder key_sharder)
+      KeySharder key_sharder, HotKeyCache::Options hot_key_cache_options,
+      RemoteLookupServerOptions remote_lookup_server_options,
+      KeyLookupBatchingOptions key_lookup_batching_options,
+      HedgingOptions remote_lookup_hedging_options,
+      RemoteLookupClientOptions remote_lookup_client_options,
+      RequestPaddingOptions sharded_lookup_padding_options,
+      ShardCircuitBreaker::Options shard_circuit_breaker_options,
+      bool sharded_lookup_partial_key_sets)
       : key_fetcher_manager_(key_fetcher_manager),
         local_lookup_(local_lookup),
         environment_(environment),
@@ -83,13 +108,54 @@ class ShardedServerInitializer : public ServerInitializer {
         current_shard_num_(current_shard_num),
         instance_client_(instance_client),
         parameter_fetcher_(parameter_fetcher),
-        key_sharder_(std::move(key_sharder)) {}
+        key_sharder_(std::move(key_sharder)),
+        hot_key_cache_(std::make_shared<HotKeyCache>(
+            std::move(hot_key_cache_options))),
+        remote_lookup_server_options_(remote_lookup_server_options),
+        key_lookup_batching_options_(key_lookup_batching_options),
+        remote_lookup_hedging_options_(remote_lookup_hedging_options),
+        remote_lookup_client_options_(remote_lookup_client_options),
+        sharded_lookup_padding_options_(sharded_lookup_padding_options),
+        shard_failure_options_{
+            .circuit_breaker = std::make_shared<ShardCircuitBreaker>(
+                num_shards, shard_circuit_breaker_options),
+            .partial_key_sets = sharded_lookup_partial_key_sets,
+        } {}
 
   RemoteLookup CreateAndStartRemoteLookupServer() override {
     RemoteLookup remote_lookup;
-    remote_lookup.remote_lookup_service = std::make_unique<LookupServiceImpl>(
-        local_lookup_, key_fetcher_manager_);
+    // Servers without data have no lookups to serve.
+    if (current_shard_num_ == kNoLocalShard) {
+      return remote_lookup;
+    }
+    const RemoteLookupServerOptions& options = remote_lookup_server_options_;
+    if (options.callback_api) {
+      remote_lookup.remote_lookup_service =
+          std::make_unique<CallbackLookupServiceImpl>(
+              local_lookup_, key_fetcher_manager_, options.coalesce_lookups,
+              options.response_compression_min_bytes,
+              options.stream_chunk_max_values, options.response_cache);
+    } else {
+      remote_lookup.remote_lookup_service = std::make_unique<LookupServiceImpl>(
+          local_lookup_, key_fetcher_manager_, options.coalesce_lookups,
+          options.response_compression_min_bytes,
+          options.stream_chunk_max_values, options.response_cache);
+    }
     grpc::ServerBuilder remote_lookup_server_builder;
+    if (options.num_cqs > 0) {
+      remote_lookup_server_builder.SetSyncServerOption(
+          grpc::ServerBuilder::SyncServerOption::NUM_CQS, options.num_cqs);
+    }
+    if (options.min_pollers > 0) {
+      remote_lookup_server_builder.SetSyncServerOption(
+          grpc::ServerBuilder::SyncServerOption::MIN_POLLERS,
+          options.min_pollers);
+    }
+    if (options.max_pollers > 0) {
+      remote_lookup_server_builder.SetSyncServerOption(
+          grpc::ServerBuilder::SyncServerOption::MAX_POLLERS,
+          options.max_pollers);
+    }
     auto remoteLookupServerAddress =
         absl::StrCat(kLocalIp, ":", kRemoteLookupServerPort);
     remote_lookup_server_builder.AddListeningPort(
@@ -115,9 +181,15 @@ class ShardedServerInitializer : public ServerInitializer {
                             num_shards = num_shards_,
                             current_shard_num = current_shard_num_,
                             &shard_manager = *maybe_shard_state->shard_manager,
-                            &key_sharder = key_sharder_]() {
+                            &key_sharder = key_sharder_,
+                            hot_key_cache = hot_key_cache_,
+                            batching_options = key_lookup_batching_options_,
+                            padding_options = sharded_lookup_padding_options_,
+                            failure_options = shard_failure_options_]() {
       return CreateShardedLookup(local_lookup, num_shards, current_shard_num,
-                                 shard_manager, key_sharder);
+                                 shard_manager, key_sharder, hot_key_cache,
+                                 batching_options, padding_options,
+                                 failure_options);
     };
     InitializeUdfHooksInternal(std::move(lookup_supplier),
                                string_get_values_hook, binary_get_values_hook,
@@ -136,7 +208,9 @@ class ShardedServerInitializer : public ServerInitializer {
         [&cluster_mappings_manager =
              *shard_manager_state.cluster_mappings_manager,
          &num_shards = num_shards_,
-         &key_fetcher_manager = key_fetcher_manager_] {
+         &key_fetcher_manager = key_fetcher_manager_,
+         &hedging_options = remote_lookup_hedging_options_,
+         &client_options = remote_lookup_client_options_] {
           // It might be that the cluster mappings that are passed don't pass
           // validation. E.g. a particular cluster might not have any
           // replicas
@@ -145,7 +219,8 @@ class ShardedServerInitializer : public ServerInitializer {
           // at that point in time might have new replicas spun up.
           return ShardManager::Create(
               num_shards, key_fetcher_manager,
-              cluster_mappings_manager.GetClusterMappings());
+              cluster_mappings_manager.GetClusterMappings(),
+              hedging_options, client_options);
         },
         "GetShardManager", LogStatusSafeMetricsFn<kGetShardManagerStatus>());
     auto start_status = shard_manager_state.cluster_mappings_manager->Start(
@@ -163,6 +238,15 @@ class ShardedServerInitializer : public ServerInitializer {
   InstanceClient& instance_client_;
   ParameterFetcher& parameter_fetcher_;
   KeySharder key_sharder_;
+  // Shared by the lookups of all UDF hooks.
+  std::shared_ptr<HotKeyCache> hot_key_cache_;
+  const RemoteLookupServerOptions remote_lookup_server_options_;
+  const KeyLookupBatchingOptions key_lookup_batching_options_;
+  const HedgingOptions remote_lookup_hedging_options_;
+  const RemoteLookupClientOptions remote_lookup_client_options_;
+  const RequestPaddingOptions sharded_lookup_padding_options_;
+  // The circuit breakers are shared by the lookups of all UDF hooks.
+  const ShardFailureOptions shard_failure_options_;
 };
 
 }  // namespace
@@ -171,15 +255,28 @@ std::unique_ptr<ServerInitializer> GetServerInitializer(
     int64_t num_shards, KeyFetcherManagerInterface& key_fetcher_manager,
     Lookup& local_lookup, std::string environment, int32_t current_shard_num,
     InstanceClient& instance_client, Cache& cache,
-    ParameterFetcher& parameter_fetcher, KeySharder key_sharder) {
+    ParameterFetcher& parameter_fetcher, KeySharder key_sharder,
+    HotKeyCache::Options hot_key_cache_options,
+    RemoteLookupServerOptions remote_lookup_server_options,
+    KeyLookupBatchingOptions key_lookup_batching_options,
+    HedgingOptions remote_lookup_hedging_options,
+    RemoteLookupClientOptions remote_lookup_client_options,
+    RequestPaddingOptions sharded_lookup_padding_options,
+    ShardCircuitBreaker::Options shard_circuit_breaker_options,
+    bool sharded_lookup_partial_key_sets, int set_sketch_cache_max_sets) {
   CHECK_GT(num_shards, 0) << "num_shards must be greater than 0";
-  if (num_shards == 1) {
-    return std::make_unique<NonshardedServerInitializer>(cache);
+  if (num_shards == 1 && current_shard_num != kNoLocalShard) {
+    return std::make_unique<NonshardedServerInitializer>(
+        cache, set_sketch_cache_max_sets);
   }
 
   return std::make_unique<ShardedServerInitializer>(
       key_fetcher_manager, local_lookup, environment, num_shards,
       current_shard_num, instance_client, parameter_fetcher,
-      std::move(key_sharder));
+      std::move(key_sharder), std::move(hot_key_cache_options),
+      remote_lookup_server_options, key_lookup_batching_options,
+      remote_lookup_hedging_options, remote_lookup_client_options,
+      sharded_lookup_padding_options, shard_circuit_breaker_options,
+      sharded_lookup_partial_key_sets);
 }
 }  // namespace kv_server
@@ -23,7 +23,12 @@
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "components/data_server/server/parameter_fetcher.h"
+#include "components/internal_server/hot_key_cache.h"
 #include "components/internal_server/lookup.h"
+#include "components/internal_server/lookup_response_cache.h"
+#include "components/internal_server/lookup_server_impl.h"
+#include "components/internal_server/shard_circuit_breaker.h"
+#include "components/internal_server/sharded_lookup.h"
 #include "components/sharding/cluster_mappings_manager.h"
 #include "components/udf/hooks/get_values_hook.h"
 #include "components/udf/hooks/run_query_hook.h"
@@ -43,6 +48,28 @@ struct RemoteLookup {
   std::unique_ptr<grpc::Server> remote_lookup_server;
 };
 
+// Options of the remote lookup server. It listens on its own port and polls
+// its own completion queues, so that lookups from the other shards don't queue
+// behind the external requests.
+struct RemoteLookupServerOptions {
+  // Concurrent secure lookups of the same keys and queries share a payload.
+  bool coalesce_lookups = false;
+  // Serves lookups with the callback API instead of the synchronous one.
+  bool callback_api = false;
+  // Completion queues and pollers of the synchronous server. gRPC's defaults
+  // are kept for the ones that are 0.
+  int num_cqs = 0;
+  int min_pollers = 0;
+  int max_pollers = 0;
+  // Responses of at least this many bytes are compressed before they're
+  // encrypted, for the clients that accept it. None are if it's not positive.
+  int response_compression_min_bytes = 0;
+  // Results and set members per chunk of a streamed secure lookup.
+  int stream_chunk_max_values = kDefaultLookupStreamChunkMaxValues;
+  // Keeps the payloads of secure lookups, if set. Must outlive the server.
+  LookupResponseCache* response_cache = nullptr;
+};
+
 struct ShardManagerState {
   std::unique_ptr<ClusterMappingsManager> cluster_mappings_manager;
   std::unique_ptr<ShardManager> shard_manager;
@@ -57,13 +84,25 @@ class ServerInitializer {
       GetValuesHook& binary_get_values_hook, RunQueryHook& run_query_hook) = 0;
 };
 
+// With `current_shard_num` set to `kNoLocalShard`, the server looks up every
+// key from the data servers, even if there is a single shard, and serves no
+// lookups to them.
 std::unique_ptr<ServerInitializer> GetServerInitializer(
     int64_t num_shards,
     privacy_sandbox::server_common::KeyFetcherManagerInterface&
         key_fetcher_manager,
     Lookup& local_lookup, std::string environment, int32_t current_shard_num,
     InstanceClient& instance_client, Cache& cache,
-    ParameterFetcher& parameter_fetcher, KeySharder key_sharder);
+    ParameterFetcher& parameter_fetcher, KeySharder key_sharder,
+    HotKeyCache::Options hot_key_cache_options = {},
+    RemoteLookupServerOptions remote_lookup_server_options = {},
+    KeyLookupBatchingOptions key_lookup_batching_options = {},
+    HedgingOptions remote_lookup_hedging_options = {},
+    RemoteLookupClientOptions remote_lookup_client_options = {},
+    RequestPaddingOptions sharded_lookup_padding_options = {},
+    ShardCircuitBreaker::Options shard_circuit_breaker_options = {},
+    bool sharded_lookup_partial_key_sets = false,
+    int set_sketch_cache_max_sets = 0);
 
 }  // namespace kv_server
 #endif  // COMPONENTS_DATA_SERVER_SERVER_INITIALIZER_H_
@@ -0,0 +1,112 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "components/internal_server/hot_key_cache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+#include "absl/hash/hash.h"
+#include "absl/log/log.h"
+#include "absl/time/clock.h"
+
+namespace kv_server {
+
+HotKeyCache::HotKeyCache(Options options)
+    : options_(std::move(options)),
+      min_lookups_(std::max<int64_t>(
+          2, std::ceil(options_.min_lookup_fraction *
+                       options_.window_lookups))),
+      sketch_(options_.max_keys > 0 ? kSketchDepth * kSketchWidth : 0) {}
+
+std::atomic<uint32_t>& HotKeyCache::Counter(int row, std::string_view key) {
+  return sketch_[row * kSketchWidth + absl::HashOf(row, key) % kSketchWidth];
+}
+
+const std::atomic<uint32_t>& HotKeyCache::Counter(int row,
+                                                  std::string_view key) const {
+  return sketch_[row * kSketchWidth + absl::HashOf(row, key) % kSketchWidth];
+}
+
+int64_t HotKeyCache::EstimateLookups(std::string_view key) const {
+  if (!enabled()) {
+    return 0;
+  }
+  uint32_t estimate = std::numeric_limits<uint32_t>::max();
+  for (int row = 0; row < kSketchDepth; ++row) {
+    estimate =
+        std::min(estimate, Counter(row, key).load(std::memory_order_relaxed));
+  }
+  return estimate;
+}
+
+bool HotKeyCache::IsHot(std::string_view key) const {
+  return EstimateLookups(key) >= min_lookups_;
+}
+
+void HotKeyCache::Decay() {
+  // Lookups counted meanwhile may be lost, the counts are estimates anyway.
+  for (auto& counter : sketch_) {
+    counter.store(counter.load(std::memory_order_relaxed) / 2,
+                  std::memory_order_relaxed);
+  }
+}
+
+std::optional<SingleLookupResult> HotKeyCache::Lookup(std::string_view key) {
+  if (!enabled()) {
+    return std::nullopt;
+  }
+  for (int row = 0; row < kSketchDepth; ++row) {
+    Counter(row, key).fetch_add(1, std::memory_order_relaxed);
+  }
+  // The lookup that completes a window decays the counts.
+  if ((num_lookups_.fetch_add(1, std::memory_order_relaxed) + 1) %
+          options_.window_lookups ==
+      0) {
+    Decay();
+  }
+  absl::ReaderMutexLock lock(&mutex_);
+  if (const auto it = copies_.find(key);
+      it != copies_.end() && it->second.expiration > absl::Now()) {
+    return it->second.result;
+  }
+  return std::nullopt;
+}
+
+void HotKeyCache::MaybeAdd(std::string_view key,
+                           const SingleLookupResult& result) {
+  if (!enabled() ||
+      result.single_lookup_result_case() != SingleLookupResult::kValue ||
+      !IsHot(key)) {
+    return;
+  }
+  const absl::Time now = absl::Now();
+  absl::MutexLock lock(&mutex_);
+  if (!copies_.contains(key)) {
+    if (static_cast<int>(copies_.size()) >= options_.max_keys) {
+      absl::erase_if(copies_, [now](const auto& copy) {
+        return copy.second.expiration <= now;
+      });
+    }
+    if (static_cast<int>(copies_.size()) >= options_.max_keys) {
+      return;
+    }
+    VLOG(2) << "Keeping a copy of hot key " << key;
+  }
+  copies_.insert_or_assign(
+      key, Copy{.result = result, .expiration = now + options_.ttl});
+}
+
+}  // namespace kv_server
@@ -0,0 +1,103 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_INTERNAL_SERVER_HOT_KEY_CACHE_H_
+#define COMPONENTS_INTERNAL_SERVER_HOT_KEY_CACHE_H_
+
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "components/internal_server/lookup.pb.h"
+
+namespace kv_server {
+
+// Finds the keys of other shards that are looked up the most, and keeps
+// read-only copies of their values, so that lookups of these keys don't all
+// go to the shard that has them.
+//
+// Lookups are counted by a count-min sketch, whose counts are halved every
+// `window_lookups` lookups, so that keys that stop being looked up cool down.
+// Copies are served until they are `ttl` old, so they lag the shard by at
+// most `ttl`.
+//
+// Thread-safe.
+class HotKeyCache {
+ public:
+  struct Options {
+    // Maximum number of copies. 0 disables the cache.
+    int max_keys = 0;
+    // How long a copy is served before the key is looked up in its shard
+    // again.
+    absl::Duration ttl = absl::Seconds(10);
+    // A key is hot once it is about this fraction of the lookups of a window.
+    double min_lookup_fraction = 0.001;
+    int64_t window_lookups = 100000;
+  };
+
+  explicit HotKeyCache(Options options);
+  HotKeyCache(const HotKeyCache&) = delete;
+  HotKeyCache& operator=(const HotKeyCache&) = delete;
+
+  bool enabled() const { return options_.max_keys > 0; }
+
+  // Counts a lookup of `key`, and returns its copy if there is one that is
+  // not older than `ttl`.
+  std::optional<SingleLookupResult> Lookup(std::string_view key)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Keeps a copy of `result` if `key` is hot and there is room for it. Only
+  // values are kept, not errors.
+  void MaybeAdd(std::string_view key, const SingleLookupResult& result)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Returns the estimated number of lookups of `key` in the last windows.
+  int64_t EstimateLookups(std::string_view key) const;
+
+ private:
+  static constexpr int kSketchDepth = 4;
+  static constexpr int kSketchWidth = 4096;
+
+  struct Copy {
+    SingleLookupResult result;
+    absl::Time expiration;
+  };
+
+  std::atomic<uint32_t>& Counter(int row, std::string_view key);
+  const std::atomic<uint32_t>& Counter(int row, std::string_view key) const;
+  // Halves every counter of the sketch.
+  void Decay();
+  bool IsHot(std::string_view key) const;
+
+  const Options options_;
+  // Lookups that a key needs in the sketch to be hot.
+  const int64_t min_lookups_;
+  std::vector<std::atomic<uint32_t>> sketch_;
+  std::atomic<int64_t> num_lookups_ = 0;
+
+  mutable absl::Mutex mutex_;
+  absl::flat_hash_map<std::string, Copy> copies_ ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_INTERNAL_SERVER_HOT_KEY_CACHE_H_
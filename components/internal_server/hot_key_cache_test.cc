@@ -0,0 +1,122 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/internal_server/hot_key_cache.h"
+
+#include <string>
+#include <utility>
+
+#include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+SingleLookupResult Value(std::string value) {
+  SingleLookupResult result;
+  result.set_value(std::move(value));
+  return result;
+}
+
+TEST(HotKeyCacheTest, DisabledByDefault) {
+  HotKeyCache cache({});
+  EXPECT_FALSE(cache.enabled());
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_FALSE(cache.Lookup("key").has_value());
+  }
+  cache.MaybeAdd("key", Value("value"));
+  EXPECT_FALSE(cache.Lookup("key").has_value());
+  EXPECT_EQ(cache.EstimateLookups("key"), 0);
+}
+
+TEST(HotKeyCacheTest, KeepsCopiesOfHotKeys) {
+  HotKeyCache cache({.max_keys = 10,
+                     .min_lookup_fraction = 0.01,
+                     .window_lookups = 1000});
+  // A key needs 10 lookups to be hot.
+  for (int i = 0; i < 9; ++i) {
+    EXPECT_FALSE(cache.Lookup("hot").has_value());
+  }
+  cache.MaybeAdd("hot", Value("value"));
+  EXPECT_FALSE(cache.Lookup("hot").has_value());
+  cache.MaybeAdd("hot", Value("value"));
+  const auto copy = cache.Lookup("hot");
+  ASSERT_TRUE(copy.has_value());
+  EXPECT_EQ(copy->value(), "value");
+  EXPECT_GE(cache.EstimateLookups("hot"), 11);
+
+  EXPECT_FALSE(cache.Lookup("cold").has_value());
+  cache.MaybeAdd("cold", Value("value"));
+  EXPECT_FALSE(cache.Lookup("cold").has_value());
+}
+
+TEST(HotKeyCacheTest, ErrorsAreNotKept) {
+  HotKeyCache cache({.max_keys = 10, .min_lookup_fraction = 0});
+  cache.Lookup("key");
+  cache.Lookup("key");
+  SingleLookupResult result;
+  result.mutable_status()->set_code(5);
+  cache.MaybeAdd("key", result);
+  EXPECT_FALSE(cache.Lookup("key").has_value());
+}
+
+TEST(HotKeyCacheTest, CopiesExpire) {
+  HotKeyCache cache({.max_keys = 10,
+                     .ttl = absl::Milliseconds(10),
+                     .min_lookup_fraction = 0});
+  cache.Lookup("key");
+  cache.Lookup("key");
+  cache.MaybeAdd("key", Value("value"));
+  EXPECT_TRUE(cache.Lookup("key").has_value());
+  absl::SleepFor(absl::Milliseconds(20));
+  EXPECT_FALSE(cache.Lookup("key").has_value());
+}
+
+TEST(HotKeyCacheTest, KeepsAtMostMaxKeys) {
+  HotKeyCache cache({.max_keys = 2,
+                     .ttl = absl::Milliseconds(100),
+                     .min_lookup_fraction = 0});
+  for (int i = 0; i < 3; ++i) {
+    const std::string key = absl::StrCat("key", i);
+    cache.Lookup(key);
+    cache.Lookup(key);
+    cache.MaybeAdd(key, Value("value"));
+  }
+  EXPECT_TRUE(cache.Lookup("key0").has_value());
+  EXPECT_TRUE(cache.Lookup("key1").has_value());
+  EXPECT_FALSE(cache.Lookup("key2").has_value());
+  // Expired copies make room for new ones.
+  absl::SleepFor(absl::Milliseconds(200));
+  cache.MaybeAdd("key2", Value("value"));
+  EXPECT_TRUE(cache.Lookup("key2").has_value());
+}
+
+TEST(HotKeyCacheTest, KeysCoolDown) {
+  HotKeyCache cache({.max_keys = 10,
+                     .min_lookup_fraction = 0.5,
+                     .window_lookups = 4});
+  cache.Lookup("key");
+  cache.Lookup("key");
+  EXPECT_EQ(cache.EstimateLookups("key"), 2);
+  // Completing the window halves the counts.
+  cache.Lookup("other");
+  cache.Lookup("other");
+  EXPECT_EQ(cache.EstimateLookups("key"), 1);
+  cache.MaybeAdd("key", Value("value"));
+  EXPECT_FALSE(cache.Lookup("key").has_value());
+}
+
+}  // namespace
+}  // namespace kv_server
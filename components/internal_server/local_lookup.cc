@@ -14,30 +14,65 @@
 
 #include "components/internal_server/local_lookup.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
 #include <memory>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <utility>
 #include <vector>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/log/log.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
 #include "components/data_server/cache/cache.h"
 #include "components/internal_server/lookup.h"
 #include "components/internal_server/lookup.pb.h"
+#include "components/internal_server/query_result_cache.h"
+#include "components/internal_server/set_sketch_cache.h"
 #include "components/query/driver.h"
-#include "components/query/scanner.h"
+#include "components/query/query_cache.h"
+#include "components/query/set_sketch.h"
+#include "components/util/hashed_key.h"
 
 namespace kv_server {
 namespace {
 
 class LocalLookup : public Lookup {
  public:
-  explicit LocalLookup(const Cache& cache) : cache_(cache) {}
+  LocalLookup(const Cache& cache,
+              QueryProgram::ParallelOptions query_parallel_options,
+              int max_cached_query_results, int max_cached_set_sketches)
+      : cache_(cache),
+        query_parallel_options_(query_parallel_options),
+        query_result_cache_(max_cached_query_results),
+        set_sketch_cache_(max_cached_set_sketches) {}
 
   absl::StatusOr<InternalLookupResponse> GetKeyValues(
       const RequestContext& request_context,
       const absl::flat_hash_set<std::string_view>& keys) const override {
-    return ProcessKeys(request_context, keys);
+    InternalLookupResponse response;
+    ProcessKeys(request_context, HashKeys(keys), response);
+    return response;
+  }
+
+  absl::Status AddKeyValues(const RequestContext& request_context,
+                            const absl::flat_hash_set<std::string_view>& keys,
+                            InternalLookupResponse& response) const override {
+    ProcessKeys(request_context, HashKeys(keys), response);
+    return absl::OkStatus();
+  }
+
+  absl::Status AddHashedKeyValues(
+      const RequestContext& request_context, absl::Span<const HashedKey> keys,
+      InternalLookupResponse& response) const override {
+    ProcessKeys(request_context, keys, response);
+    return absl::OkStatus();
   }
 
   absl::StatusOr<InternalLookupResponse> GetKeyValueSet(
@@ -46,37 +81,153 @@ class LocalLookup : public Lookup {
     return ProcessKeysetKeys(request_context, key_set);
   }
 
+  absl::StatusOr<InternalLookupResponse> GetKeyValuesByPrefix(
+      const RequestContext& request_context, std::string_view key_prefix,
+      int limit) const override {
+    const auto keys = cache_.GetKeysByPrefix(key_prefix, limit);
+    if (!keys.ok()) {
+      return keys.status();
+    }
+    InternalLookupResponse response;
+    if (keys->empty()) {
+      return response;
+    }
+    const absl::flat_hash_set<std::string_view> key_set(keys->begin(),
+                                                        keys->end());
+    const auto kv_pairs = cache_.GetKeyValuePairViews(request_context, key_set);
+    // Keys deleted since they were indexed are left out.
+    for (const auto& key : *keys) {
+      if (const auto value = kv_pairs.GetValue(key); value.has_value()) {
+        (*response.mutable_kv_pairs())[key].set_value(std::string(*value));
+      }
+    }
+    return response;
+  }
+
+  absl::StatusOr<std::vector<std::string>> GetSetsContaining(
+      const RequestContext& request_context,
+      std::string_view member) const override {
+    return cache_.GetSetsContaining(member);
+  }
+
   absl::StatusOr<InternalRunQueryResponse> RunQuery(
       const RequestContext& request_context, std::string query) const override {
     return ProcessQuery(request_context, query);
   }
 
+  absl::StatusOr<InternalRunQueryResponse> ProfileQuery(
+      const RequestContext& request_context, std::string query) const override {
+    if (query.empty()) return absl::OkStatus();
+    const auto driver = query_cache_.Parse(query);
+    if (!driver.ok()) {
+      return driver.status();
+    }
+    // The result cache is skipped, so that the query is run.
+    const absl::Time start = absl::Now();
+    const auto keys = (*driver)->GetRootNode()->Keys();
+    const auto get_key_value_set_result =
+        cache_.GetKeyValueSet(request_context, keys);
+    const absl::Duration lookup_latency = absl::Now() - start;
+    QueryProfile profile;
+    auto response = EvaluateQuery(request_context, **driver,
+                                  *get_key_value_set_result, &profile);
+    if (response.ok()) {
+      response->set_query_profile(absl::StrCat(
+          "Lookup of ", keys.size(), " sets",
+          get_key_value_set_result->HasValueBitmaps() ? " as bitmaps" : "",
+          ", ", absl::FormatDuration(lookup_latency), "\n",
+          profile.ToString()));
+    }
+    return response;
+  }
+
+  absl::StatusOr<int64_t> ApproxCardinality(
+      const RequestContext& request_context, std::string query) const override {
+    if (query.empty()) return 0;
+    const auto driver = query_cache_.Parse(query);
+    if (!driver.ok()) {
+      return driver.status();
+    }
+    const Node& root = *(*driver)->GetRootNode();
+    const auto keys = root.Keys();
+    if (keys.size() > kMaxSketchQueryKeys) {
+      // Too many sets to estimate, the query is counted instead.
+      return Lookup::ApproxCardinality(request_context, std::move(query));
+    }
+    const auto get_key_value_set_result =
+        cache_.GetKeyValueSet(request_context, keys);
+    absl::flat_hash_map<std::string_view, std::shared_ptr<const SetSketch>>
+        sketches;
+    for (std::string_view key : keys) {
+      sketches.emplace(key, GetSetSketch(request_context, key,
+                                         *get_key_value_set_result));
+    }
+    const auto estimate = EstimateCardinality(
+        root, [&sketches](std::string_view key) -> const SetSketch& {
+          return *sketches.at(key);
+        });
+    if (!estimate.ok()) {
+      return estimate.status();
+    }
+    InternalRunQueryResponse response;
+    const int64_t num_elements = SetQueryResultCount(
+        (*driver)->GetResultOptions(), std::llround(*estimate), response);
+    return response.has_count() ? response.count() : num_elements;
+  }
+
  private:
-  InternalLookupResponse ProcessKeys(
-      const RequestContext& request_context,
-      const absl::flat_hash_set<std::string_view>& keys) const {
+  // Returns the sketch of the set of `key`, built from its members unless the
+  // sketch of its version is cached.
+  std::shared_ptr<const SetSketch> GetSetSketch(
+      const RequestContext& request_context, std::string_view key,
+      const GetKeyValueSetResult& get_key_value_set_result) const {
+    const auto build_fn = [key, &get_key_value_set_result] {
+      SetSketch sketch;
+      for (std::string_view member :
+           *get_key_value_set_result.GetValueSetSnapshot(key)) {
+        sketch.Add(member);
+      }
+      return sketch;
+    };
+    const auto version = get_key_value_set_result.GetValueSetVersion(key);
+    if (!set_sketch_cache_.enabled() || !version.has_value()) {
+      return std::make_shared<const SetSketch>(build_fn());
+    }
+    bool is_hit = false;
+    auto sketch = set_sketch_cache_.Get(key, *version, build_fn, &is_hit);
+    LogIfError(request_context.GetInternalLookupMetricsContext()
+                   .AccumulateMetric<kCacheAccessEventCount>(
+                       1, is_hit ? kSetSketchCacheHit : kSetSketchCacheMiss));
+    return sketch;
+  }
+
+  // Adds the result of each of `keys` to `response`.
+  void ProcessKeys(const RequestContext& request_context,
+                   absl::Span<const HashedKey> keys,
+                   InternalLookupResponse& response) const {
     ScopeLatencyMetricsRecorder<InternalLookupMetricsContext,
                                 kInternalGetKeyValuesLatencyInMicros>
         latency_recorder(request_context.GetInternalLookupMetricsContext());
-    InternalLookupResponse response;
     if (keys.empty()) {
-      return response;
+      return;
     }
-    auto kv_pairs = cache_.GetKeyValuePairs(request_context, keys);
+    // Values are copied once, straight from the cache into the response.
+    // Each key is hashed once, for the cache lookup and the result.
+    const auto kv_pairs =
+        cache_.GetHashedKeyValuePairViews(request_context, keys);
 
-    for (const auto& key : keys) {
-      SingleLookupResult result;
-      const auto key_iter = kv_pairs.find(key);
-      if (key_iter == kv_pairs.end()) {
+    auto& results = *response.mutable_kv_pairs();
+    for (const HashedKey& key : keys) {
+      SingleLookupResult& result = results[key.key];
+      const auto value = kv_pairs.GetValue(key);
+      if (!value.has_value()) {
         auto status = result.mutable_status();
         status->set_code(static_cast<int>(absl::StatusCode::kNotFound));
-        status->set_message(absl::StrCat("Key not found: ", key));
+        status->set_message(absl::StrCat("Key not found: ", key.key));
       } else {
-        result.set_value(std::move(key_iter->second));
+        result.set_value(std::string(*value));
       }
-      (*response.mutable_kv_pairs())[key] = std::move(result);
     }
-    return response;
   }
 
   absl::StatusOr<InternalLookupResponse> ProcessKeysetKeys(
@@ -92,15 +243,15 @@ class LocalLookup : public Lookup {
     auto key_value_set_result = cache_.GetKeyValueSet(request_context, key_set);
     for (const auto& key : key_set) {
       SingleLookupResult result;
-      const auto value_set = key_value_set_result->GetValueSet(key);
-      if (value_set.empty()) {
+      const auto value_set = key_value_set_result->GetValueSetSnapshot(key);
+      if (value_set->empty()) {
         auto status = result.mutable_status();
         status->set_code(static_cast<int>(absl::StatusCode::kNotFound));
         status->set_message(absl::StrCat("Key not found: ", key));
       } else {
         auto keyset_values = result.mutable_keyset_values();
-        keyset_values->mutable_values()->Add(value_set.begin(),
-                                             value_set.end());
+        keyset_values->mutable_values()->Add(value_set->begin(),
+                                             value_set->end());
       }
       (*response.mutable_kv_pairs())[key] = std::move(result);
     }
@@ -113,25 +264,78 @@ class LocalLookup : public Lookup {
                                 kInternalRunQueryLatencyInMicros>
         latency_recorder(request_context.GetInternalLookupMetricsContext());
     if (query.empty()) return absl::OkStatus();
-    std::unique_ptr<GetKeyValueSetResult> get_key_value_set_result;
-    kv_server::Driver driver([&get_key_value_set_result](std::string_view key) {
-      return get_key_value_set_result->GetValueSet(key);
-    });
-
-    std::istringstream stream(query);
-    kv_server::Scanner scanner(stream);
-    kv_server::Parser parse(driver, scanner);
-    int parse_result = parse();
-    if (parse_result) {
+    bool is_hit = false;
+    const auto driver = query_cache_.Parse(query, &is_hit);
+    LogIfError(request_context.GetInternalLookupMetricsContext()
+                   .AccumulateMetric<kCacheAccessEventCount>(
+                       1, is_hit ? kQueryCacheHit : kQueryCacheMiss));
+    if (!driver.ok()) {
       LogInternalLookupRequestErrorMetric(
           request_context.GetInternalLookupMetricsContext(),
           kLocalRunQueryParsingFailure);
-      return absl::InvalidArgumentError("Parsing failure.");
+      return driver.status();
     }
-    get_key_value_set_result =
-        cache_.GetKeyValueSet(request_context, driver.GetRootNode()->Keys());
+    const auto keys = (*driver)->GetRootNode()->Keys();
+    const auto get_key_value_set_result =
+        cache_.GetKeyValueSet(request_context, keys);
+    const auto key_versions =
+        query_result_cache_.enabled()
+            ? GetKeyVersions(keys, *get_key_value_set_result)
+            : std::nullopt;
+    if (key_versions.has_value()) {
+      auto cached = query_result_cache_.Lookup((*driver)->GetNormalizedQuery(),
+                                               *key_versions);
+      LogIfError(request_context.GetInternalLookupMetricsContext()
+                     .AccumulateMetric<kCacheAccessEventCount>(
+                         1, cached.has_value() ? kQueryResultCacheHit
+                                               : kQueryResultCacheMiss));
+      if (cached.has_value()) {
+        return *std::move(cached);
+      }
+    }
+    auto response = EvaluateQuery(request_context, **driver,
+                                  *get_key_value_set_result);
+    if (response.ok() && key_versions.has_value()) {
+      query_result_cache_.Add((*driver)->GetNormalizedQuery(), *key_versions,
+                              *response);
+    }
+    return response;
+  }
+
+  // Returns the versions of the sets of `keys` in `get_key_value_set_result`,
+  // or nullopt if they are not versioned.
+  static std::optional<QueryResultCache::KeyVersions> GetKeyVersions(
+      const absl::flat_hash_set<std::string_view>& keys,
+      const GetKeyValueSetResult& get_key_value_set_result) {
+    QueryResultCache::KeyVersions key_versions;
+    key_versions.reserve(keys.size());
+    for (std::string_view key : keys) {
+      const auto version = get_key_value_set_result.GetValueSetVersion(key);
+      if (!version.has_value()) {
+        return std::nullopt;
+      }
+      key_versions.emplace_back(key, *version);
+    }
+    return key_versions;
+  }
 
-    auto result = driver.GetResult();
+  // Runs the parsed query over the sets of `get_key_value_set_result`. With a
+  // `profile`, the query is run sequentially and profiled.
+  absl::StatusOr<InternalRunQueryResponse> EvaluateQuery(
+      const RequestContext& request_context, const kv_server::Driver& driver,
+      const GetKeyValueSetResult& get_key_value_set_result,
+      QueryProfile* profile = nullptr) const {
+    if (get_key_value_set_result.HasValueBitmaps()) {
+      return ProcessBitmapQuery(request_context, driver,
+                                get_key_value_set_result, profile);
+    }
+
+    const auto lookup_fn = [&get_key_value_set_result](std::string_view key) {
+      return get_key_value_set_result.GetValueSet(key);
+    };
+    auto result = profile == nullptr
+                      ? driver.GetResult(lookup_fn, query_parallel_options_)
+                      : driver.GetProfiledResult(lookup_fn, *profile);
     if (!result.ok()) {
       LogInternalLookupRequestErrorMetric(
           request_context.GetInternalLookupMetricsContext(),
@@ -139,16 +343,85 @@ class LocalLookup : public Lookup {
       return result.status();
     }
     InternalRunQueryResponse response;
-    response.mutable_elements()->Assign(result->begin(), result->end());
+    const int64_t num_elements = SetQueryResultCount(
+        driver.GetResultOptions(), result->size(), response);
+    auto end = result->begin();
+    std::advance(end, num_elements);
+    response.mutable_elements()->Assign(result->begin(), end);
+    return response;
+  }
+
+  // Runs the parsed query over the member id bitmaps of the sets and only
+  // resolves the ids of the final result.
+  absl::StatusOr<InternalRunQueryResponse> ProcessBitmapQuery(
+      const RequestContext& request_context, const kv_server::Driver& driver,
+      const GetKeyValueSetResult& get_key_value_set_result,
+      QueryProfile* profile) const {
+    const auto lookup_fn = [&get_key_value_set_result](std::string_view key) {
+      return get_key_value_set_result.GetValueBitmap(key);
+    };
+    auto result =
+        profile == nullptr
+            ? driver.GetBitmapResult(lookup_fn, query_parallel_options_)
+            : driver.GetProfiledBitmapResult(lookup_fn, *profile);
+    if (!result.ok()) {
+      LogInternalLookupRequestErrorMetric(
+          request_context.GetInternalLookupMetricsContext(),
+          kLocalRunQueryFailure);
+      return result.status();
+    }
+    InternalRunQueryResponse response;
+    // Only the ids that are returned are resolved.
+    int64_t num_elements = SetQueryResultCount(
+        driver.GetResultOptions(), result->Cardinality(), response);
+    if (num_elements == 0) {
+      return response;
+    }
+    response.mutable_elements()->Reserve(num_elements);
+    result->ForEach(
+        [&get_key_value_set_result, &response, &num_elements](uint32_t id) {
+          if (num_elements == 0) return;
+          --num_elements;
+          response.add_elements(
+              std::string(get_key_value_set_result.GetValueForId(id)));
+        });
     return response;
   }
   const Cache& cache_;
+  const QueryProgram::ParallelOptions query_parallel_options_;
+  // Parsed queries, shared by the requests of this lookup.
+  mutable QueryCache query_cache_;
+  // Results of queries, shared by the requests of this lookup.
+  mutable QueryResultCache query_result_cache_;
+  // Sketches of the sets of approximately counted queries.
+  mutable SetSketchCache set_sketch_cache_;
 };
 
 }  // namespace
 
-std::unique_ptr<Lookup> CreateLocalLookup(const Cache& cache) {
-  return std::make_unique<LocalLookup>(cache);
+int64_t SetQueryResultCount(const QueryResultOptions& options,
+                            int64_t result_size,
+                            InternalRunQueryResponse& response) {
+  switch (options.mode) {
+    case QueryResultMode::kCount:
+      response.set_count(result_size);
+      return 0;
+    case QueryResultMode::kExists:
+      response.set_count(result_size > 0 ? 1 : 0);
+      return 0;
+    case QueryResultMode::kElements:
+      break;
+  }
+  return options.limit.has_value() ? std::min(*options.limit, result_size)
+                                   : result_size;
+}
+
+std::unique_ptr<Lookup> CreateLocalLookup(
+    const Cache& cache, QueryProgram::ParallelOptions query_parallel_options,
+    int max_cached_query_results, int max_cached_set_sketches) {
+  return std::make_unique<LocalLookup>(cache, query_parallel_options,
+                                       max_cached_query_results,
+                                       max_cached_set_sketches);
 }
 
 }  // namespace kv_server
@@ -17,14 +17,32 @@
 #ifndef COMPONENTS_INTERNAL_SERVER_LOCAL_LOOKUP_H_
 #define COMPONENTS_INTERNAL_SERVER_LOCAL_LOOKUP_H_
 
+#include <cstdint>
 #include <memory>
 
 #include "components/data_server/cache/cache.h"
 #include "components/internal_server/lookup.h"
+#include "components/query/driver.h"
+#include "components/query/query_program.h"
 
 namespace kv_server {
 
-std::unique_ptr<Lookup> CreateLocalLookup(const Cache& cache);
+// Queries are run in parallel as set by `query_parallel_options`, whose pool
+// must outlive the lookup. The results of up to `max_cached_query_results`
+// queries over versioned sets are cached, see `QueryResultCache`, and the
+// sketches of up to `max_cached_set_sketches` versioned sets that queries are
+// estimated from, see `SetSketchCache`.
+std::unique_ptr<Lookup> CreateLocalLookup(
+    const Cache& cache,
+    QueryProgram::ParallelOptions query_parallel_options = {},
+    int max_cached_query_results = 0, int max_cached_set_sketches = 0);
+
+// Sets the count of `COUNT` and `EXISTS` queries in `response`, and returns how
+// many of the `result_size` elements of the result of a query with `options`
+// are returned, none for these queries.
+int64_t SetQueryResultCount(const QueryResultOptions& options,
+                            int64_t result_size,
+                            InternalRunQueryResponse& response);
 
 }  // namespace kv_server
 
@@ -20,6 +20,7 @@
 #include <vector>
 
 #include "components/data_server/cache/mocks.h"
+#include "components/util/thread_pool.h"
 #include "gmock/gmock.h"
 #include "google/protobuf/text_format.h"
 #include "gtest/gtest.h"
@@ -116,6 +117,108 @@ TEST_F(LocalLookupTest, GetKeyValues_KeyMissing_ReturnsStatusForKey) {
   EXPECT_THAT(response.value(), EqualsProto(expected));
 }
 
+TEST_F(LocalLookupTest, GetKeyValuesByPrefix_ReturnsIndexedKeysWithValues) {
+  EXPECT_CALL(mock_cache_, GetKeysByPrefix("ad:", 10))
+      .WillOnce(Return(std::vector<std::string>{"ad:1", "ad:2"}));
+  // "ad:2" was deleted after it was indexed.
+  EXPECT_CALL(mock_cache_, GetKeyValuePairs(_, _))
+      .WillOnce(Return(
+          absl::flat_hash_map<std::string, std::string>{{"ad:1", "value1"}}));
+
+  auto local_lookup = CreateLocalLookup(mock_cache_);
+  auto response =
+      local_lookup->GetKeyValuesByPrefix(GetRequestContext(), "ad:", 10);
+  ASSERT_TRUE(response.ok());
+
+  InternalLookupResponse expected;
+  TextFormat::ParseFromString(R"pb(kv_pairs {
+                                     key: "ad:1"
+                                     value { value: "value1" }
+                                   }
+                              )pb",
+                              &expected);
+  EXPECT_THAT(response.value(), EqualsProto(expected));
+}
+
+TEST_F(LocalLookupTest, GetKeyValuesByPrefix_PrefixNotIndexed_Error) {
+  EXPECT_CALL(mock_cache_, GetKeysByPrefix("ad:", 10))
+      .WillOnce(Return(absl::UnimplementedError("not indexed")));
+
+  auto local_lookup = CreateLocalLookup(mock_cache_);
+  auto response =
+      local_lookup->GetKeyValuesByPrefix(GetRequestContext(), "ad:", 10);
+  EXPECT_EQ(response.status().code(), absl::StatusCode::kUnimplemented);
+}
+
+TEST_F(LocalLookupTest, GetSetsContaining_ReturnsIndexedSets) {
+  EXPECT_CALL(mock_cache_, GetSetsContaining("ad1"))
+      .WillOnce(Return(std::vector<std::string>{"audience:a", "audience:b"}));
+
+  auto local_lookup = CreateLocalLookup(mock_cache_);
+  auto response = local_lookup->GetSetsContaining(GetRequestContext(), "ad1");
+  ASSERT_TRUE(response.ok());
+  EXPECT_THAT(*response, testing::ElementsAre("audience:a", "audience:b"));
+}
+
+TEST_F(LocalLookupTest, AddKeyValues_AddsToResponse) {
+  EXPECT_CALL(mock_cache_, GetKeyValuePairs(_, _))
+      .WillOnce(Return(
+          absl::flat_hash_map<std::string, std::string>{{"key1", "value1"}}));
+
+  auto local_lookup = CreateLocalLookup(mock_cache_);
+  InternalLookupResponse response;
+  (*response.mutable_kv_pairs())["key3"].set_value("value3");
+  EXPECT_TRUE(local_lookup
+                  ->AddKeyValues(GetRequestContext(), {"key1", "key2"},
+                                 response)
+                  .ok());
+
+  InternalLookupResponse expected;
+  TextFormat::ParseFromString(
+      R"pb(kv_pairs {
+             key: "key1"
+             value { value: "value1" }
+           }
+           kv_pairs {
+             key: "key2"
+             value { status { code: 5 message: "Key not found: key2" } }
+           }
+           kv_pairs {
+             key: "key3"
+             value { value: "value3" }
+           }
+      )pb",
+      &expected);
+  EXPECT_THAT(response, EqualsProto(expected));
+}
+
+TEST_F(LocalLookupTest, AddHashedKeyValues_AddsToResponse) {
+  EXPECT_CALL(mock_cache_, GetKeyValuePairs(_, _))
+      .WillOnce(Return(
+          absl::flat_hash_map<std::string, std::string>{{"key1", "value1"}}));
+
+  auto local_lookup = CreateLocalLookup(mock_cache_);
+  InternalLookupResponse response;
+  const std::vector<HashedKey> keys = {HashedKey("key1"), HashedKey("key2")};
+  EXPECT_TRUE(
+      local_lookup->AddHashedKeyValues(GetRequestContext(), keys, response)
+          .ok());
+
+  InternalLookupResponse expected;
+  TextFormat::ParseFromString(
+      R"pb(kv_pairs {
+             key: "key1"
+             value { value: "value1" }
+           }
+           kv_pairs {
+             key: "key2"
+             value { status { code: 5 message: "Key not found: key2" } }
+           }
+      )pb",
+      &expected);
+  EXPECT_THAT(response, EqualsProto(expected));
+}
+
 TEST_F(LocalLookupTest, GetKeyValues_EmptyRequest_ReturnsEmptyResponse) {
   auto local_lookup = CreateLocalLookup(mock_cache_);
   auto response = local_lookup->GetKeyValues(GetRequestContext(), {});
@@ -197,6 +300,318 @@ TEST_F(LocalLookupTest, RunQuery_Success) {
               testing::UnorderedElementsAreArray({"value1", "value2"}));
 }
 
+TEST_F(LocalLookupTest, ProfileQuery_ReturnsTheProfile) {
+  std::string query = "someset";
+
+  auto mock_get_key_value_set_result =
+      std::make_unique<MockGetKeyValueSetResult>();
+  EXPECT_CALL(*mock_get_key_value_set_result, GetValueSet("someset"))
+      .WillOnce(
+          Return(absl::flat_hash_set<std::string_view>{"value1", "value2"}));
+  EXPECT_CALL(
+      mock_cache_,
+      GetKeyValueSet(_, absl::flat_hash_set<std::string_view>{"someset"}))
+      .WillOnce(Return(std::move(mock_get_key_value_set_result)));
+
+  auto local_lookup = CreateLocalLookup(mock_cache_);
+  auto response = local_lookup->ProfileQuery(GetRequestContext(), query);
+  ASSERT_TRUE(response.ok());
+  EXPECT_THAT(response.value().elements(),
+              testing::UnorderedElementsAreArray({"value1", "value2"}));
+  EXPECT_THAT(response.value().query_profile(),
+              testing::HasSubstr("Load someset -> 2"));
+}
+
+TEST_F(LocalLookupTest, RunQuery_RepeatedQuery_UsesTheSetsOfEachRequest) {
+  std::string query = "someset";
+
+  auto first_result = std::make_unique<MockGetKeyValueSetResult>();
+  EXPECT_CALL(*first_result, GetValueSet("someset"))
+      .WillOnce(Return(absl::flat_hash_set<std::string_view>{"value1"}));
+  auto second_result = std::make_unique<MockGetKeyValueSetResult>();
+  EXPECT_CALL(*second_result, GetValueSet("someset"))
+      .WillOnce(Return(absl::flat_hash_set<std::string_view>{"value2"}));
+  EXPECT_CALL(
+      mock_cache_,
+      GetKeyValueSet(_, absl::flat_hash_set<std::string_view>{"someset"}))
+      .WillOnce(Return(std::move(first_result)))
+      .WillOnce(Return(std::move(second_result)));
+
+  auto local_lookup = CreateLocalLookup(mock_cache_);
+  auto response = local_lookup->RunQuery(GetRequestContext(), query);
+  ASSERT_TRUE(response.ok());
+  EXPECT_THAT(response.value().elements(),
+              testing::UnorderedElementsAreArray({"value1"}));
+  response = local_lookup->RunQuery(GetRequestContext(), query);
+  ASSERT_TRUE(response.ok());
+  EXPECT_THAT(response.value().elements(),
+              testing::UnorderedElementsAreArray({"value2"}));
+}
+
+TEST_F(LocalLookupTest, RunQuery_ValueBitmaps_Success) {
+  std::string query = "someset & otherset";
+
+  auto mock_get_key_value_set_result =
+      std::make_unique<MockGetKeyValueSetResult>();
+  EXPECT_CALL(*mock_get_key_value_set_result, HasValueBitmaps())
+      .WillOnce(Return(true));
+  EXPECT_CALL(*mock_get_key_value_set_result, GetValueBitmap("someset"))
+      .WillOnce(Return(IdBitmap({1, 2, 3})));
+  EXPECT_CALL(*mock_get_key_value_set_result, GetValueBitmap("otherset"))
+      .WillOnce(Return(IdBitmap({2, 3, 4})));
+  EXPECT_CALL(*mock_get_key_value_set_result, GetValueForId(2))
+      .WillOnce(Return("value2"));
+  EXPECT_CALL(*mock_get_key_value_set_result, GetValueForId(3))
+      .WillOnce(Return("value3"));
+  EXPECT_CALL(*mock_get_key_value_set_result, GetValueSet(_)).Times(0);
+  EXPECT_CALL(mock_cache_,
+              GetKeyValueSet(_, absl::flat_hash_set<std::string_view>{
+                                    "someset", "otherset"}))
+      .WillOnce(Return(std::move(mock_get_key_value_set_result)));
+
+  auto local_lookup = CreateLocalLookup(mock_cache_);
+  auto response = local_lookup->RunQuery(GetRequestContext(), query);
+  ASSERT_TRUE(response.ok());
+  EXPECT_THAT(response.value().elements(),
+              testing::UnorderedElementsAreArray({"value2", "value3"}));
+}
+
+TEST_F(LocalLookupTest, RunQuery_InParallel_Success) {
+  std::string query = "(set1 | set2) & (set3 | set4)";
+
+  auto mock_get_key_value_set_result =
+      std::make_unique<MockGetKeyValueSetResult>();
+  EXPECT_CALL(*mock_get_key_value_set_result, GetValueSet("set1"))
+      .WillOnce(
+          Return(absl::flat_hash_set<std::string_view>{"value1", "value2"}));
+  EXPECT_CALL(*mock_get_key_value_set_result, GetValueSet("set2"))
+      .WillOnce(Return(absl::flat_hash_set<std::string_view>{"value3"}));
+  EXPECT_CALL(*mock_get_key_value_set_result, GetValueSet("set3"))
+      .WillOnce(Return(absl::flat_hash_set<std::string_view>{"value2"}));
+  EXPECT_CALL(*mock_get_key_value_set_result, GetValueSet("set4"))
+      .WillOnce(Return(absl::flat_hash_set<std::string_view>{"value3"}));
+  EXPECT_CALL(mock_cache_,
+              GetKeyValueSet(_, absl::flat_hash_set<std::string_view>{
+                                    "set1", "set2", "set3", "set4"}))
+      .WillOnce(Return(std::move(mock_get_key_value_set_result)));
+
+  ThreadPool pool(/*num_threads=*/2);
+  auto local_lookup = CreateLocalLookup(
+      mock_cache_, {.pool = &pool, .min_parallel_size = 0});
+  auto response = local_lookup->RunQuery(GetRequestContext(), query);
+  ASSERT_TRUE(response.ok());
+  EXPECT_THAT(response.value().elements(),
+              testing::UnorderedElementsAreArray({"value2", "value3"}));
+}
+
+TEST_F(LocalLookupTest, RunQuery_Limit_ReturnsAtMostLimitElements) {
+  std::string query = "someset LIMIT 2";
+
+  auto mock_get_key_value_set_result =
+      std::make_unique<MockGetKeyValueSetResult>();
+  EXPECT_CALL(*mock_get_key_value_set_result, GetValueSet("someset"))
+      .WillOnce(Return(absl::flat_hash_set<std::string_view>{
+          "value1", "value2", "value3"}));
+  EXPECT_CALL(
+      mock_cache_,
+      GetKeyValueSet(_, absl::flat_hash_set<std::string_view>{"someset"}))
+      .WillOnce(Return(std::move(mock_get_key_value_set_result)));
+
+  auto local_lookup = CreateLocalLookup(mock_cache_);
+  auto response = local_lookup->RunQuery(GetRequestContext(), query);
+  ASSERT_TRUE(response.ok());
+  EXPECT_EQ(response.value().elements_size(), 2);
+  EXPECT_THAT(response.value().elements(),
+              testing::Each(testing::AnyOf("value1", "value2", "value3")));
+  EXPECT_FALSE(response.value().has_count());
+}
+
+TEST_F(LocalLookupTest, RunQuery_Count_ReturnsOnlyCount) {
+  std::string query = "COUNT someset";
+
+  auto mock_get_key_value_set_result =
+      std::make_unique<MockGetKeyValueSetResult>();
+  EXPECT_CALL(*mock_get_key_value_set_result, GetValueSet("someset"))
+      .WillOnce(
+          Return(absl::flat_hash_set<std::string_view>{"value1", "value2"}));
+  EXPECT_CALL(
+      mock_cache_,
+      GetKeyValueSet(_, absl::flat_hash_set<std::string_view>{"someset"}))
+      .WillOnce(Return(std::move(mock_get_key_value_set_result)));
+
+  auto local_lookup = CreateLocalLookup(mock_cache_);
+  auto response = local_lookup->RunQuery(GetRequestContext(), query);
+  ASSERT_TRUE(response.ok());
+  EXPECT_TRUE(response.value().elements().empty());
+  EXPECT_EQ(response.value().count(), 2);
+}
+
+TEST_F(LocalLookupTest, RunQuery_ExistsOverValueBitmaps_ResolvesNoIds) {
+  std::string query = "EXISTS someset & otherset";
+
+  auto mock_get_key_value_set_result =
+      std::make_unique<MockGetKeyValueSetResult>();
+  EXPECT_CALL(*mock_get_key_value_set_result, HasValueBitmaps())
+      .WillOnce(Return(true));
+  EXPECT_CALL(*mock_get_key_value_set_result, GetValueBitmap("someset"))
+      .WillOnce(Return(IdBitmap({1, 2, 3})));
+  EXPECT_CALL(*mock_get_key_value_set_result, GetValueBitmap("otherset"))
+      .WillOnce(Return(IdBitmap({2, 3, 4})));
+  EXPECT_CALL(*mock_get_key_value_set_result, GetValueForId(_)).Times(0);
+  EXPECT_CALL(mock_cache_,
+              GetKeyValueSet(_, absl::flat_hash_set<std::string_view>{
+                                    "someset", "otherset"}))
+      .WillOnce(Return(std::move(mock_get_key_value_set_result)));
+
+  auto local_lookup = CreateLocalLookup(mock_cache_);
+  auto response = local_lookup->RunQuery(GetRequestContext(), query);
+  ASSERT_TRUE(response.ok());
+  EXPECT_TRUE(response.value().elements().empty());
+  EXPECT_EQ(response.value().count(), 1);
+}
+
+TEST_F(LocalLookupTest, RunQuery_SameSetVersions_ReturnsCachedResult) {
+  auto first_result = std::make_unique<MockGetKeyValueSetResult>();
+  EXPECT_CALL(*first_result, GetValueSetVersion("someset"))
+      .WillRepeatedly(Return(1));
+  EXPECT_CALL(*first_result, GetValueSet("someset"))
+      .WillOnce(Return(absl::flat_hash_set<std::string_view>{"value1"}));
+  // Same versions, the query isn't run again.
+  auto second_result = std::make_unique<MockGetKeyValueSetResult>();
+  EXPECT_CALL(*second_result, GetValueSetVersion("someset"))
+      .WillRepeatedly(Return(1));
+  EXPECT_CALL(*second_result, GetValueSet(_)).Times(0);
+  // The set changed.
+  auto third_result = std::make_unique<MockGetKeyValueSetResult>();
+  EXPECT_CALL(*third_result, GetValueSetVersion("someset"))
+      .WillRepeatedly(Return(2));
+  EXPECT_CALL(*third_result, GetValueSet("someset"))
+      .WillOnce(Return(absl::flat_hash_set<std::string_view>{"value2"}));
+  EXPECT_CALL(
+      mock_cache_,
+      GetKeyValueSet(_, absl::flat_hash_set<std::string_view>{"someset"}))
+      .WillOnce(Return(std::move(first_result)))
+      .WillOnce(Return(std::move(second_result)))
+      .WillOnce(Return(std::move(third_result)));
+
+  auto local_lookup =
+      CreateLocalLookup(mock_cache_, /*query_parallel_options=*/{},
+                        /*max_cached_query_results=*/10);
+  auto response = local_lookup->RunQuery(GetRequestContext(), "someset");
+  ASSERT_TRUE(response.ok());
+  EXPECT_THAT(response.value().elements(),
+              testing::UnorderedElementsAreArray({"value1"}));
+  // Normalized to the same query.
+  response = local_lookup->RunQuery(GetRequestContext(), "(someset)");
+  ASSERT_TRUE(response.ok());
+  EXPECT_THAT(response.value().elements(),
+              testing::UnorderedElementsAreArray({"value1"}));
+  response = local_lookup->RunQuery(GetRequestContext(), "someset");
+  ASSERT_TRUE(response.ok());
+  EXPECT_THAT(response.value().elements(),
+              testing::UnorderedElementsAreArray({"value2"}));
+}
+
+TEST_F(LocalLookupTest, RunQuery_UnversionedSets_AreNotCached) {
+  auto first_result = std::make_unique<MockGetKeyValueSetResult>();
+  EXPECT_CALL(*first_result, GetValueSetVersion("someset"))
+      .WillRepeatedly(Return(std::nullopt));
+  EXPECT_CALL(*first_result, GetValueSet("someset"))
+      .WillOnce(Return(absl::flat_hash_set<std::string_view>{"value1"}));
+  auto second_result = std::make_unique<MockGetKeyValueSetResult>();
+  EXPECT_CALL(*second_result, GetValueSetVersion("someset"))
+      .WillRepeatedly(Return(std::nullopt));
+  EXPECT_CALL(*second_result, GetValueSet("someset"))
+      .WillOnce(Return(absl::flat_hash_set<std::string_view>{"value2"}));
+  EXPECT_CALL(
+      mock_cache_,
+      GetKeyValueSet(_, absl::flat_hash_set<std::string_view>{"someset"}))
+      .WillOnce(Return(std::move(first_result)))
+      .WillOnce(Return(std::move(second_result)));
+
+  auto local_lookup =
+      CreateLocalLookup(mock_cache_, /*query_parallel_options=*/{},
+                        /*max_cached_query_results=*/10);
+  auto response = local_lookup->RunQuery(GetRequestContext(), "someset");
+  ASSERT_TRUE(response.ok());
+  response = local_lookup->RunQuery(GetRequestContext(), "someset");
+  ASSERT_TRUE(response.ok());
+  EXPECT_THAT(response.value().elements(),
+              testing::UnorderedElementsAreArray({"value2"}));
+}
+
+TEST_F(LocalLookupTest, ApproxCardinality_EstimatesQuery) {
+  auto mock_get_key_value_set_result =
+      std::make_unique<MockGetKeyValueSetResult>();
+  EXPECT_CALL(*mock_get_key_value_set_result, GetValueSet("someset"))
+      .WillOnce(Return(
+          absl::flat_hash_set<std::string_view>{"value1", "value2", "value3"}));
+  EXPECT_CALL(*mock_get_key_value_set_result, GetValueSet("otherset"))
+      .WillOnce(
+          Return(absl::flat_hash_set<std::string_view>{"value2", "value4"}));
+  EXPECT_CALL(mock_cache_,
+              GetKeyValueSet(_, absl::flat_hash_set<std::string_view>{
+                                    "someset", "otherset"}))
+      .WillOnce(Return(std::move(mock_get_key_value_set_result)));
+
+  auto local_lookup = CreateLocalLookup(mock_cache_);
+  auto estimate = local_lookup->ApproxCardinality(GetRequestContext(),
+                                                  "someset - otherset");
+  ASSERT_TRUE(estimate.ok()) << estimate.status();
+  // Sketches of small sets are close to exact.
+  EXPECT_EQ(*estimate, 2);
+}
+
+TEST_F(LocalLookupTest, ApproxCardinality_SameSetVersion_ReusesSketch) {
+  auto first_result = std::make_unique<MockGetKeyValueSetResult>();
+  EXPECT_CALL(*first_result, GetValueSetVersion("someset"))
+      .WillRepeatedly(Return(1));
+  EXPECT_CALL(*first_result, GetValueSet("someset"))
+      .WillOnce(Return(
+          absl::flat_hash_set<std::string_view>{"value1", "value2", "value3"}));
+  // Same version, the set isn't read again.
+  auto second_result = std::make_unique<MockGetKeyValueSetResult>();
+  EXPECT_CALL(*second_result, GetValueSetVersion("someset"))
+      .WillRepeatedly(Return(1));
+  EXPECT_CALL(*second_result, GetValueSet(_)).Times(0);
+  // A member was deleted.
+  auto third_result = std::make_unique<MockGetKeyValueSetResult>();
+  EXPECT_CALL(*third_result, GetValueSetVersion("someset"))
+      .WillRepeatedly(Return(2));
+  EXPECT_CALL(*third_result, GetValueSet("someset"))
+      .WillOnce(
+          Return(absl::flat_hash_set<std::string_view>{"value1", "value2"}));
+  EXPECT_CALL(
+      mock_cache_,
+      GetKeyValueSet(_, absl::flat_hash_set<std::string_view>{"someset"}))
+      .WillOnce(Return(std::move(first_result)))
+      .WillOnce(Return(std::move(second_result)))
+      .WillOnce(Return(std::move(third_result)));
+
+  auto local_lookup = CreateLocalLookup(
+      mock_cache_, /*query_parallel_options=*/{},
+      /*max_cached_query_results=*/0, /*max_cached_set_sketches=*/10);
+  auto estimate =
+      local_lookup->ApproxCardinality(GetRequestContext(), "someset");
+  ASSERT_TRUE(estimate.ok()) << estimate.status();
+  EXPECT_EQ(*estimate, 3);
+  estimate =
+      local_lookup->ApproxCardinality(GetRequestContext(), "COUNT someset");
+  ASSERT_TRUE(estimate.ok()) << estimate.status();
+  EXPECT_EQ(*estimate, 3);
+  estimate = local_lookup->ApproxCardinality(GetRequestContext(), "someset");
+  ASSERT_TRUE(estimate.ok()) << estimate.status();
+  EXPECT_EQ(*estimate, 2);
+}
+
+TEST_F(LocalLookupTest, ApproxCardinality_ParsingError_Error) {
+  auto local_lookup = CreateLocalLookup(mock_cache_);
+  auto estimate =
+      local_lookup->ApproxCardinality(GetRequestContext(), "someset|(");
+  EXPECT_FALSE(estimate.ok());
+  EXPECT_EQ(estimate.status().code(), absl::StatusCode::kInvalidArgument);
+}
+
 TEST_F(LocalLookupTest, RunQuery_ParsingError_Error) {
   std::string query = "someset|(";
 
@@ -17,13 +17,19 @@
 #ifndef COMPONENTS_INTERNAL_SERVER_LOOKUP_H_
 #define COMPONENTS_INTERNAL_SERVER_LOOKUP_H_
 
+#include <cstdint>
 #include <memory>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 #include "absl/container/flat_hash_set.h"
+#include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/types/span.h"
 #include "components/internal_server/lookup.pb.h"
+#include "components/util/hashed_key.h"
 #include "components/util/request_context.h"
 
 namespace kv_server {
@@ -37,12 +43,120 @@ class Lookup {
       const RequestContext& request_context,
       const absl::flat_hash_set<std::string_view>& keys) const = 0;
 
+  // Same as `GetKeyValues`, but adds the result of each of `keys` to
+  // `response` instead of returning a response of its own. Keys without a
+  // result are added as not found.
+  virtual absl::Status AddKeyValues(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& keys,
+      InternalLookupResponse& response) const {
+    auto key_values = GetKeyValues(request_context, keys);
+    if (!key_values.ok()) {
+      return key_values.status();
+    }
+    auto& kv_pairs = *key_values->mutable_kv_pairs();
+    for (const auto& key : keys) {
+      SingleLookupResult& result = (*response.mutable_kv_pairs())[key];
+      if (const auto key_iter = kv_pairs.find(key);
+          key_iter != kv_pairs.end()) {
+        result = std::move(key_iter->second);
+      } else {
+        result.mutable_status()->set_code(
+            static_cast<int>(absl::StatusCode::kNotFound));
+      }
+    }
+    return absl::OkStatus();
+  }
+
+  // Same as `AddKeyValues`, for keys that were hashed once for the request,
+  // so that local lookups reuse the hashes. `keys` must not repeat a key. By
+  // default, the keys are looked up as a set.
+  virtual absl::Status AddHashedKeyValues(
+      const RequestContext& request_context, absl::Span<const HashedKey> keys,
+      InternalLookupResponse& response) const {
+    absl::flat_hash_set<std::string_view> key_set;
+    key_set.reserve(keys.size());
+    for (const HashedKey& key : keys) {
+      key_set.insert(key.key);
+    }
+    return AddKeyValues(request_context, key_set, response);
+  }
+
   virtual absl::StatusOr<InternalLookupResponse> GetKeyValueSet(
       const RequestContext& request_context,
       const absl::flat_hash_set<std::string_view>& key_set) const = 0;
 
+  // Looks up the values of `keys` and the sets of `set_keys` together, and
+  // returns the results of both in one response. The two must not share a
+  // key. By default, the values and the sets are looked up one after the
+  // other.
+  virtual absl::StatusOr<InternalLookupResponse> GetKeyValuesAndSets(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& keys,
+      const absl::flat_hash_set<std::string_view>& set_keys) const {
+    if (set_keys.empty()) {
+      return GetKeyValues(request_context, keys);
+    }
+    if (keys.empty()) {
+      return GetKeyValueSet(request_context, set_keys);
+    }
+    auto response = GetKeyValues(request_context, keys);
+    if (!response.ok()) {
+      return response;
+    }
+    auto key_sets = GetKeyValueSet(request_context, set_keys);
+    if (!key_sets.ok()) {
+      return key_sets.status();
+    }
+    for (auto& [key, result] : *key_sets->mutable_kv_pairs()) {
+      (*response->mutable_kv_pairs())[key] = std::move(result);
+    }
+    return response;
+  }
+
+  // Looks up the values of up to `limit` keys that start with `key_prefix`,
+  // in key order, and returns those that have a value. Lookups whose data
+  // has no ordered index of the keys under `key_prefix` return an
+  // unimplemented error.
+  virtual absl::StatusOr<InternalLookupResponse> GetKeyValuesByPrefix(
+      const RequestContext& request_context, std::string_view key_prefix,
+      int limit) const {
+    return absl::UnimplementedError("The lookup can't look up key prefixes");
+  }
+
+  // Returns, in order, the keys of the key-value sets that `member` is a
+  // member of, from the reverse membership index of the sets. Lookups without
+  // one return an unimplemented error.
+  virtual absl::StatusOr<std::vector<std::string>> GetSetsContaining(
+      const RequestContext& request_context, std::string_view member) const {
+    return absl::UnimplementedError(
+        "The lookup can't look up the sets containing a member");
+  }
+
   virtual absl::StatusOr<InternalRunQueryResponse> RunQuery(
       const RequestContext& request_context, std::string query) const = 0;
+
+  // Same as `RunQuery`, with the profile of the query, its steps with their
+  // sizes and latencies, in the `query_profile` of the response. By default,
+  // the query is run without a profile.
+  virtual absl::StatusOr<InternalRunQueryResponse> ProfileQuery(
+      const RequestContext& request_context, std::string query) const {
+    return RunQuery(request_context, std::move(query));
+  }
+
+  // Returns the estimated number of elements that `RunQuery` returns for
+  // `query`, or its count for `COUNT` and `EXISTS` queries, in time
+  // independent of the sizes of the sets where the lookup keeps sketches of
+  // them. By default, the query is run and its result counted.
+  virtual absl::StatusOr<int64_t> ApproxCardinality(
+      const RequestContext& request_context, std::string query) const {
+    auto response = RunQuery(request_context, std::move(query));
+    if (!response.ok()) {
+      return response.status();
+    }
+    return response->has_count() ? response->count()
+                                 : response->elements_size();
+  }
 };
 
 }  // namespace kv_server
@@ -0,0 +1,98 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/internal_server/lookup_memo.h"
+
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "absl/status/status.h"
+
+namespace kv_server {
+namespace {
+
+bool ShouldMemoize(const SingleLookupResult& result) {
+  return !result.has_status() ||
+         static_cast<absl::StatusCode>(result.status().code()) ==
+             absl::StatusCode::kNotFound;
+}
+
+}  // namespace
+
+absl::flat_hash_set<std::string_view> LookupMemo::GetKeyValues(
+    const absl::flat_hash_set<std::string_view>& keys,
+    InternalLookupResponse& response) const {
+  absl::ReaderMutexLock lock(&mutex_);
+  return Get(values_, keys, response);
+}
+
+absl::flat_hash_set<std::string_view> LookupMemo::GetKeyValueSet(
+    const absl::flat_hash_set<std::string_view>& keys,
+    InternalLookupResponse& response) const {
+  absl::ReaderMutexLock lock(&mutex_);
+  return Get(sets_, keys, response);
+}
+
+std::optional<InternalRunQueryResponse> LookupMemo::GetQueryResult(
+    std::string_view query) const {
+  absl::ReaderMutexLock lock(&mutex_);
+  if (const auto it = query_results_.find(query); it != query_results_.end()) {
+    return it->second;
+  }
+  return std::nullopt;
+}
+
+void LookupMemo::AddKeyValues(const InternalLookupResponse& response) {
+  absl::MutexLock lock(&mutex_);
+  Add(response, values_);
+}
+
+void LookupMemo::AddKeyValueSet(const InternalLookupResponse& response) {
+  absl::MutexLock lock(&mutex_);
+  Add(response, sets_);
+}
+
+void LookupMemo::AddQueryResult(std::string_view query,
+                                const InternalRunQueryResponse& response) {
+  absl::MutexLock lock(&mutex_);
+  query_results_.try_emplace(query, response);
+}
+
+absl::flat_hash_set<std::string_view> LookupMemo::Get(
+    const ResultMap& results, const absl::flat_hash_set<std::string_view>& keys,
+    InternalLookupResponse& response) const {
+  absl::flat_hash_set<std::string_view> missing_keys;
+  for (const std::string_view key : keys) {
+    if (const auto it = results.find(key); it != results.end()) {
+      (*response.mutable_kv_pairs())[key] = it->second;
+    } else {
+      missing_keys.insert(key);
+    }
+  }
+  return missing_keys;
+}
+
+void LookupMemo::Add(const InternalLookupResponse& response,
+                     ResultMap& results) {
+  for (const auto& [key, result] : response.kv_pairs()) {
+    if (ShouldMemoize(result)) {
+      results.try_emplace(key, result);
+    }
+  }
+}
+
+}  // namespace kv_server
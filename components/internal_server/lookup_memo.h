@@ -0,0 +1,82 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_INTERNAL_SERVER_LOOKUP_MEMO_H_
+#define COMPONENTS_INTERNAL_SERVER_LOOKUP_MEMO_H_
+
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/synchronization/mutex.h"
+#include "components/internal_server/lookup.pb.h"
+
+namespace kv_server {
+
+// Results of the lookups made while serving one request, so that the keys,
+// sets and queries that UDFs look up several times within the request, across
+// partitions and hook calls, are only looked up once. Only values and
+// not-found results are kept, so that transient errors are retried.
+//
+// Thread-safe.
+class LookupMemo {
+ public:
+  LookupMemo() = default;
+  LookupMemo(const LookupMemo&) = delete;
+  LookupMemo& operator=(const LookupMemo&) = delete;
+
+  // Adds the memoized results of `keys` to `response`, and returns the keys
+  // that have none.
+  absl::flat_hash_set<std::string_view> GetKeyValues(
+      const absl::flat_hash_set<std::string_view>& keys,
+      InternalLookupResponse& response) const ABSL_LOCKS_EXCLUDED(mutex_);
+  absl::flat_hash_set<std::string_view> GetKeyValueSet(
+      const absl::flat_hash_set<std::string_view>& keys,
+      InternalLookupResponse& response) const ABSL_LOCKS_EXCLUDED(mutex_);
+  std::optional<InternalRunQueryResponse> GetQueryResult(
+      std::string_view query) const ABSL_LOCKS_EXCLUDED(mutex_);
+
+  void AddKeyValues(const InternalLookupResponse& response)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+  void AddKeyValueSet(const InternalLookupResponse& response)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+  void AddQueryResult(std::string_view query,
+                      const InternalRunQueryResponse& response)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  using ResultMap = absl::flat_hash_map<std::string, SingleLookupResult>;
+
+  absl::flat_hash_set<std::string_view> Get(
+      const ResultMap& results,
+      const absl::flat_hash_set<std::string_view>& keys,
+      InternalLookupResponse& response) const
+      ABSL_SHARED_LOCKS_REQUIRED(mutex_);
+  void Add(const InternalLookupResponse& response, ResultMap& results)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  mutable absl::Mutex mutex_;
+  ResultMap values_ ABSL_GUARDED_BY(mutex_);
+  ResultMap sets_ ABSL_GUARDED_BY(mutex_);
+  absl::flat_hash_map<std::string, InternalRunQueryResponse> query_results_
+      ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_INTERNAL_SERVER_LOOKUP_MEMO_H_
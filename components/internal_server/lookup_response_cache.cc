@@ -0,0 +1,111 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/internal_server/lookup_response_cache.h"
+
+#include <iterator>
+#include <string>
+#include <utility>
+
+namespace kv_server {
+
+LookupResponseCache::LookupResponseCache(const DataVersion& data_version)
+    : data_version_(data_version) {}
+
+LookupResponseCache::LookupResponseCache(Options options,
+                                         const DataVersion& data_version)
+    : data_version_(data_version) {
+  SetOptions(std::move(options));
+}
+
+void LookupResponseCache::SetOptions(Options options) {
+  absl::MutexLock lock(&mutex_);
+  Clear();
+  enabled_ = options.max_entries > 0;
+  options_ = std::move(options);
+}
+
+std::shared_ptr<const std::string> LookupResponseCache::Lookup(
+    std::string_view request) {
+  const uint64_t current_data_version = data_version_.current();
+  absl::MutexLock lock(&mutex_);
+  MaybeInvalidate(current_data_version);
+  const auto it = index_.find(request);
+  if (it == index_.end()) {
+    ++num_misses_;
+    return nullptr;
+  }
+  ++num_hits_;
+  entries_.splice(entries_.begin(), entries_, it->second);
+  return entries_.front().response;
+}
+
+void LookupResponseCache::Add(std::string_view request, uint64_t data_version,
+                              std::shared_ptr<const std::string> response) {
+  absl::MutexLock lock(&mutex_);
+  if (options_.max_entries == 0 ||
+      static_cast<int64_t>(response->size()) > options_.max_response_bytes) {
+    return;
+  }
+  MaybeInvalidate(data_version_.current());
+  // The data changed while the response was computed.
+  if (data_version != entries_data_version_) {
+    return;
+  }
+  if (const auto it = index_.find(request); it != index_.end()) {
+    Erase(it->second);
+  }
+  num_bytes_ += request.size() + response->size();
+  entries_.push_front(
+      Entry{.request = std::string(request), .response = std::move(response)});
+  index_.emplace(entries_.front().request, entries_.begin());
+  ++num_entries_;
+  if (static_cast<int>(entries_.size()) > options_.max_entries) {
+    Erase(std::prev(entries_.end()));
+    ++num_evictions_;
+  }
+}
+
+void LookupResponseCache::MaybeInvalidate(uint64_t current_data_version) {
+  if (current_data_version == entries_data_version_) {
+    return;
+  }
+  num_invalidations_ += entries_.size();
+  Clear();
+  entries_data_version_ = current_data_version;
+}
+
+void LookupResponseCache::Erase(std::list<Entry>::iterator it) {
+  num_bytes_ -= it->request.size() + it->response->size();
+  --num_entries_;
+  index_.erase(it->request);
+  entries_.erase(it);
+}
+
+void LookupResponseCache::Clear() {
+  index_.clear();
+  entries_.clear();
+  num_entries_ = 0;
+  num_bytes_ = 0;
+}
+
+LookupResponseCache& ServerLookupResponseCache() {
+  // Never destroyed, lookups may be served at exit.
+  static LookupResponseCache* const cache = new LookupResponseCache();
+  return *cache;
+}
+
+}  // namespace kv_server
@@ -0,0 +1,128 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_INTERNAL_SERVER_LOOKUP_RESPONSE_CACHE_H_
+#define COMPONENTS_INTERNAL_SERVER_LOOKUP_RESPONSE_CACHE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "components/data_server/cache/data_version.h"
+
+namespace kv_server {
+
+// Keeps the serialized responses of the most recent internal lookups that
+// other shards sent this shard, by normalized request, so that the same keys
+// looked up by different servers are looked up and serialized once per version
+// of the data.
+//
+// Responses are only computed from the data of this shard, so every response
+// is dropped once the data changes, and none expires otherwise.
+//
+// Thread-safe.
+class LookupResponseCache {
+ public:
+  struct Options {
+    // Maximum number of responses. 0 disables the cache.
+    int max_entries = 0;
+    // Larger responses, such as those of large sets, aren't kept.
+    int64_t max_response_bytes = 64 * 1024;
+  };
+
+  // The cache is disabled until `SetOptions` enables it.
+  explicit LookupResponseCache(
+      const DataVersion& data_version = ServedDataVersion());
+  LookupResponseCache(Options options,
+                      const DataVersion& data_version = ServedDataVersion());
+  LookupResponseCache(const LookupResponseCache&) = delete;
+  LookupResponseCache& operator=(const LookupResponseCache&) = delete;
+
+  // Drops every response.
+  void SetOptions(Options options) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  bool enabled() const { return enabled_; }
+
+  // Returns the version of the data to add the responses of the lookups that
+  // start after the call with.
+  uint64_t data_version() const { return data_version_.current(); }
+
+  // Returns the response that was added for `request`, if the data didn't
+  // change since, or null.
+  std::shared_ptr<const std::string> Lookup(std::string_view request)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Keeps `response` as the response to `request`, computed from the data at
+  // `data_version`.
+  void Add(std::string_view request, uint64_t data_version,
+           std::shared_ptr<const std::string> response)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  int64_t num_entries() const { return num_entries_; }
+  // Bytes of the requests and responses kept.
+  int64_t num_bytes() const { return num_bytes_; }
+  int64_t num_hits() const { return num_hits_; }
+  int64_t num_misses() const { return num_misses_; }
+  // Responses dropped to make room for others, and because the data changed.
+  int64_t num_evictions() const { return num_evictions_; }
+  int64_t num_invalidations() const { return num_invalidations_; }
+
+ private:
+  struct Entry {
+    std::string request;
+    // Shared, so that hits copy it without the lock.
+    std::shared_ptr<const std::string> response;
+  };
+
+  // Drops every response if the data changed since they were added.
+  void MaybeInvalidate(uint64_t current_data_version)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void Erase(std::list<Entry>::iterator it)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void Clear() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  const DataVersion& data_version_;
+  absl::Mutex mutex_;
+  Options options_ ABSL_GUARDED_BY(mutex_);
+  // The version of the data that the responses were computed from.
+  uint64_t entries_data_version_ ABSL_GUARDED_BY(mutex_) = 0;
+  // Most recently used first.
+  std::list<Entry> entries_ ABSL_GUARDED_BY(mutex_);
+  // Views of the requests of `entries_`.
+  absl::flat_hash_map<std::string_view, std::list<Entry>::iterator> index_
+      ABSL_GUARDED_BY(mutex_);
+  // Read without the lock to skip the cache when it is disabled.
+  std::atomic<bool> enabled_ = false;
+  std::atomic<int64_t> num_entries_ = 0;
+  std::atomic<int64_t> num_bytes_ = 0;
+  std::atomic<int64_t> num_hits_ = 0;
+  std::atomic<int64_t> num_misses_ = 0;
+  std::atomic<int64_t> num_evictions_ = 0;
+  std::atomic<int64_t> num_invalidations_ = 0;
+};
+
+// Returns the internal lookup response cache of the process.
+LookupResponseCache& ServerLookupResponseCache();
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_INTERNAL_SERVER_LOOKUP_RESPONSE_CACHE_H_
@@ -0,0 +1,96 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/internal_server/lookup_response_cache.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+std::shared_ptr<const std::string> Response(std::string response) {
+  return std::make_shared<const std::string>(std::move(response));
+}
+
+TEST(LookupResponseCacheTest, ReturnsAddedResponse) {
+  DataVersion data_version;
+  LookupResponseCache cache({.max_entries = 10}, data_version);
+  EXPECT_EQ(cache.Lookup("request"), nullptr);
+  cache.Add("request", cache.data_version(), Response("response"));
+  const auto response = cache.Lookup("request");
+  ASSERT_NE(response, nullptr);
+  EXPECT_EQ(*response, "response");
+  EXPECT_EQ(cache.num_hits(), 1);
+  EXPECT_EQ(cache.num_misses(), 1);
+  EXPECT_EQ(cache.num_entries(), 1);
+  EXPECT_EQ(cache.num_bytes(), 15);
+}
+
+TEST(LookupResponseCacheTest, DataChangeDropsResponses) {
+  DataVersion data_version;
+  LookupResponseCache cache({.max_entries = 10}, data_version);
+  cache.Add("request", cache.data_version(), Response("response"));
+  data_version.Advance();
+  EXPECT_EQ(cache.Lookup("request"), nullptr);
+  EXPECT_EQ(cache.num_invalidations(), 1);
+  EXPECT_EQ(cache.num_entries(), 0);
+}
+
+TEST(LookupResponseCacheTest, ResponseOfChangedDataIsNotAdded) {
+  DataVersion data_version;
+  LookupResponseCache cache({.max_entries = 10}, data_version);
+  const uint64_t version = cache.data_version();
+  // The data changes while the lookup runs.
+  data_version.Advance();
+  cache.Add("request", version, Response("response"));
+  EXPECT_EQ(cache.Lookup("request"), nullptr);
+}
+
+TEST(LookupResponseCacheTest, EvictsLeastRecentlyUsedResponse) {
+  DataVersion data_version;
+  LookupResponseCache cache({.max_entries = 2}, data_version);
+  cache.Add("a", cache.data_version(), Response("response_a"));
+  cache.Add("b", cache.data_version(), Response("response_b"));
+  EXPECT_NE(cache.Lookup("a"), nullptr);
+  cache.Add("c", cache.data_version(), Response("response_c"));
+  EXPECT_NE(cache.Lookup("a"), nullptr);
+  EXPECT_EQ(cache.Lookup("b"), nullptr);
+  EXPECT_NE(cache.Lookup("c"), nullptr);
+  EXPECT_EQ(cache.num_evictions(), 1);
+}
+
+TEST(LookupResponseCacheTest, LargeResponseIsNotAdded) {
+  DataVersion data_version;
+  LookupResponseCache cache({.max_entries = 10, .max_response_bytes = 4},
+                            data_version);
+  cache.Add("request", cache.data_version(), Response("response"));
+  EXPECT_EQ(cache.Lookup("request"), nullptr);
+}
+
+TEST(LookupResponseCacheTest, DisabledCacheKeepsNothing) {
+  DataVersion data_version;
+  LookupResponseCache cache(data_version);
+  EXPECT_FALSE(cache.enabled());
+  cache.Add("request", cache.data_version(), Response("response"));
+  EXPECT_EQ(cache.num_entries(), 0);
+}
+
+}  // namespace
+}  // namespace kv_server
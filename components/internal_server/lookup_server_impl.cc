@@ -14,8 +14,11 @@
 
 #include "components/internal_server/lookup_server_impl.h"
 
+#include <algorithm>
 #include <iostream>
+#include <limits>
 #include <memory>
+#include <optional>
 #include <sstream>
 #include <string>
 #include <utility>
@@ -23,10 +26,15 @@
 
 #include "absl/log/log.h"
 #include "absl/status/status.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "components/data_server/request_handler/ohttp_server_encryptor.h"
 #include "components/internal_server/lookup.grpc.pb.h"
 #include "components/internal_server/lookup.h"
 #include "components/internal_server/string_padder.h"
+#include "components/telemetry/server_definition.h"
+#include "components/util/admission_controller.h"
+#include "components/util/request_tracing.h"
 #include "google/protobuf/message.h"
 #include "grpcpp/grpcpp.h"
 
@@ -35,6 +43,245 @@ using google::protobuf::RepeatedPtrField;
 
 using grpc::StatusCode;
 
+namespace {
+// Cheap enough to compress responses on the lookup path, while still
+// shrinking the repetitive serialized responses a lot.
+constexpr int kResponseCompressionLevel = 1;
+
+// Admits an internal lookup for as long as it is in scope, or holds the status
+// that the lookup fails with if it is shed.
+class LookupAdmission {
+ public:
+  explicit LookupAdmission(const grpc::ServerContextBase& context)
+      : start_(absl::Now()),
+        status_(InternalLookupAdmissionController().TryAdmit(
+            absl::FromChrono(context.deadline()) - start_)) {}
+
+  ~LookupAdmission() {
+    if (status_.ok()) {
+      InternalLookupAdmissionController().Release(absl::Now() - start_);
+    }
+  }
+
+  LookupAdmission(const LookupAdmission&) = delete;
+  LookupAdmission& operator=(const LookupAdmission&) = delete;
+
+  bool admitted() const { return status_.ok(); }
+  grpc::Status status() const {
+    return grpc::Status(StatusCode::UNAVAILABLE,
+                        std::string(status_.message()));
+  }
+
+ private:
+  const absl::Time start_;
+  const absl::Status status_;
+};
+
+// Returns a key that is the same for the requests that get the same payload,
+// whatever the order of their keys and queries.
+std::string GetCoalescingKey(const InternalLookupRequest& request) {
+  InternalLookupRequest normalized = request;
+  normalized.clear_log_context();
+  normalized.clear_consented_debug_config();
+  normalized.clear_trace_parent();
+  std::sort(normalized.mutable_keys()->begin(),
+            normalized.mutable_keys()->end());
+  std::sort(normalized.mutable_queries()->begin(),
+            normalized.mutable_queries()->end());
+  std::sort(normalized.mutable_set_keys()->begin(),
+            normalized.mutable_set_keys()->end());
+  return normalized.SerializeAsString();
+}
+
+// Splits a response into chunks of at most `max_values` results and set
+// members. A set with more members than fit in a chunk is split over several.
+class ResponseChunker {
+ public:
+  ResponseChunker(InternalLookupResponse response, int max_values)
+      : response_(std::move(response)),
+        max_values_(max_values > 0 ? max_values
+                                   : std::numeric_limits<int>::max()),
+        next_(response_.mutable_kv_pairs()->begin()) {}
+
+  // Moves the next chunk into `chunk`. Returns false once all chunks were
+  // returned. An empty response is returned as a single empty chunk.
+  bool Next(InternalLookupResponse& chunk) {
+    auto& kv_pairs = *response_.mutable_kv_pairs();
+    if (next_ == kv_pairs.end() && returned_any_) {
+      return false;
+    }
+    chunk.Clear();
+    int num_values = 0;
+    while (next_ != kv_pairs.end() && num_values < max_values_) {
+      auto& [key, result] = *next_;
+      if (!result.has_keyset_values()) {
+        (*chunk.mutable_kv_pairs())[key] = std::move(result);
+        ++num_values;
+        ++next_;
+        continue;
+      }
+      auto& values = *result.mutable_keyset_values()->mutable_values();
+      auto& chunk_values = *(*chunk.mutable_kv_pairs())[key]
+                                .mutable_keyset_values()
+                                ->mutable_values();
+      const int num_taken =
+          std::min(values.size() - next_value_, max_values_ - num_values);
+      chunk_values.Reserve(num_taken);
+      for (int i = next_value_; i < next_value_ + num_taken; ++i) {
+        chunk_values.Add(std::move(values[i]));
+      }
+      next_value_ += num_taken;
+      num_values += num_taken;
+      if (next_value_ == values.size()) {
+        next_value_ = 0;
+        ++next_;
+      }
+    }
+    returned_any_ = true;
+    return true;
+  }
+
+ private:
+  InternalLookupResponse response_;
+  const int max_values_;
+  google::protobuf::Map<std::string, SingleLookupResult>::iterator next_;
+  // The first member of the set at `next_` that wasn't returned yet.
+  int next_value_ = 0;
+  bool returned_any_ = false;
+};
+}  // namespace
+
+// A streamed secure lookup, which encrypts the chunks of its response one at a
+// time, as they're written. The lookup is admitted while the stream is open.
+class LookupServiceImpl::LookupStream {
+ public:
+  LookupStream(const LookupServiceImpl& service,
+               const grpc::ServerContextBase& context,
+               const SecureLookupRequest& secure_lookup_request)
+      : service_(service),
+        secure_lookup_request_(secure_lookup_request),
+        request_context_(metrics_context_),
+        latency_recorder_(request_context_.GetInternalLookupMetricsContext()),
+        encryptor_(service.key_fetcher_manager_) {
+    const absl::Time start = absl::Now();
+    LogIfError(request_context_.GetInternalLookupMetricsContext()
+                   .AccumulateMetric<kSecureLookupRequestCount>(1));
+    if (context.IsCancelled()) {
+      status_ = grpc::Status(grpc::StatusCode::CANCELLED,
+                             "Deadline exceeded or client cancelled, "
+                             "abandoning.");
+      return;
+    }
+    admission_.emplace(context);
+    if (!admission_->admitted()) {
+      status_ = admission_->status();
+      return;
+    }
+    InternalLookupRequest request;
+    status_ = service_.DecryptSecureLookupRequest(
+        request_context_, secure_lookup_request_, encryptor_, request);
+    if (!status_.ok()) {
+      return;
+    }
+    span_ = RequestSpan::StartRemote("SecureLookupStream",
+                                     request.trace_parent(), start);
+    request_context_.SetTraceContext(span_.context());
+    RequestSpan lookup_span = request_context_.StartSpan("Lookup");
+    chunker_.emplace(service_.GetResponse(request_context_, request),
+                     service_.stream_chunk_max_values_);
+  }
+
+  // Encrypts the next chunk of the response into `chunk`. Returns false once
+  // all chunks were returned, or if the lookup failed, see `status`.
+  bool Next(SecureLookupResponse& chunk) {
+    InternalLookupResponse response_chunk;
+    if (!status_.ok() || !chunker_->Next(response_chunk)) {
+      return false;
+    }
+    RequestSpan encrypt_span = request_context_.StartSpan("EncryptResponse");
+    status_ = service_.EncryptSecureLookupResponse(
+        request_context_, secure_lookup_request_,
+        response_chunk.SerializeAsString(), encryptor_, chunk);
+    return status_.ok();
+  }
+
+  const grpc::Status& status() const { return status_; }
+
+ private:
+  const LookupServiceImpl& service_;
+  const SecureLookupRequest& secure_lookup_request_;
+  ScopeMetricsContext metrics_context_;
+  RequestContext request_context_;
+  ScopeLatencyMetricsRecorder<InternalLookupMetricsContext,
+                              kInternalSecureLookupLatencyInMicros>
+      latency_recorder_;
+  std::optional<LookupAdmission> admission_;
+  OhttpServerEncryptor encryptor_;
+  grpc::Status status_;
+  // Set once the lookup is done.
+  std::optional<ResponseChunker> chunker_;
+  // Ends once the stream is over.
+  RequestSpan span_;
+};
+
+namespace {
+// Writes the chunks of a streamed secure lookup one at a time, each once the
+// previous one was written.
+class LookupStreamReactor
+    : public grpc::ServerWriteReactor<SecureLookupResponse> {
+ public:
+  explicit LookupStreamReactor(
+      std::unique_ptr<LookupServiceImpl::LookupStream> stream)
+      : stream_(std::move(stream)) {
+    WriteNext();
+  }
+
+  void OnWriteDone(bool ok) override {
+    if (!ok) {
+      Finish(grpc::Status(grpc::StatusCode::CANCELLED,
+                          "Client cancelled the stream, abandoning."));
+      return;
+    }
+    WriteNext();
+  }
+
+  void OnDone() override { delete this; }
+
+ private:
+  void WriteNext() {
+    if (stream_->Next(chunk_)) {
+      StartWrite(&chunk_);
+    } else {
+      Finish(stream_->status());
+    }
+  }
+
+  std::unique_ptr<LookupServiceImpl::LookupStream> stream_;
+  SecureLookupResponse chunk_;
+};
+}  // namespace
+
+LookupServiceImpl::LookupServiceImpl(
+    const Lookup& lookup,
+    privacy_sandbox::server_common::KeyFetcherManagerInterface&
+        key_fetcher_manager,
+    bool coalesce_lookups, int64_t compression_min_bytes,
+    int stream_chunk_max_values, LookupResponseCache* response_cache)
+    : lookup_(lookup),
+      key_fetcher_manager_(key_fetcher_manager),
+      single_flight_(coalesce_lookups
+                         ? std::make_unique<SingleFlight<std::string>>()
+                         : nullptr),
+      compression_min_bytes_(compression_min_bytes),
+      stream_chunk_max_values_(stream_chunk_max_values),
+      response_cache_(response_cache) {
+  if (compression_min_bytes_ > 0) {
+    // Can't fail without a dictionary.
+    response_codec_ = *ValueCodec::Create(/*dictionary=*/"",
+                                          kResponseCompressionLevel);
+  }
+}
+
 grpc::Status LookupServiceImpl::ToInternalGrpcStatus(
     const RequestContext& request_context, const absl::Status& status,
     std::string_view error_code) const {
@@ -68,28 +315,93 @@ void LookupServiceImpl::ProcessKeysetKeys(
     key_list.insert(key);
   }
   auto key_value_set_result = lookup_.GetKeyValueSet(request_context, key_list);
-  if (key_value_set_result.ok()) {
+  if (!key_value_set_result.ok()) {
+    return;
+  }
+  if (response.kv_pairs().empty()) {
     response = *std::move(key_value_set_result);
+    return;
+  }
+  // The sets were looked up with the values of other keys.
+  for (auto& [key, result] : *key_value_set_result->mutable_kv_pairs()) {
+    (*response.mutable_kv_pairs())[key] = std::move(result);
+  }
+}
+
+void LookupServiceImpl::ProcessQueries(
+    const RequestContext& request_context,
+    const RepeatedPtrField<std::string>& queries,
+    InternalLookupResponse& response) const {
+  for (const auto& query : queries) {
+    SingleLookupResult result;
+    auto query_result = lookup_.RunQuery(request_context, query);
+    if (query_result.ok()) {
+      result.mutable_keyset_values()->mutable_values()->Swap(
+          query_result->mutable_elements());
+    } else {
+      auto status = result.mutable_status();
+      status->set_code(static_cast<int>(query_result.status().code()));
+      status->set_message(std::string(query_result.status().message()));
+    }
+    (*response.mutable_kv_pairs())[query] = std::move(result);
   }
 }
 
 grpc::Status LookupServiceImpl::InternalLookup(
     grpc::ServerContext* context, const InternalLookupRequest* request,
     InternalLookupResponse* response) {
+  return ServeInternalLookup(*context, *request, *response);
+}
+
+grpc::Status LookupServiceImpl::SecureLookup(
+    grpc::ServerContext* context, const SecureLookupRequest* request,
+    SecureLookupResponse* response) {
+  return ServeSecureLookup(*context, *request, *response);
+}
+
+grpc::Status LookupServiceImpl::SecureLookupStream(
+    grpc::ServerContext* context, const SecureLookupRequest* request,
+    grpc::ServerWriter<SecureLookupResponse>* writer) {
+  LookupStream stream(*this, *context, *request);
+  SecureLookupResponse chunk;
+  while (stream.Next(chunk)) {
+    if (!writer->Write(chunk)) {
+      return grpc::Status(grpc::StatusCode::CANCELLED,
+                          "Client cancelled the stream, abandoning.");
+    }
+  }
+  return stream.status();
+}
+
+grpc::Status LookupServiceImpl::InternalRunQuery(
+    grpc::ServerContext* context, const InternalRunQueryRequest* request,
+    InternalRunQueryResponse* response) {
+  return ServeInternalRunQuery(*context, *request, *response);
+}
+
+grpc::Status LookupServiceImpl::ServeInternalLookup(
+    const grpc::ServerContextBase& context,
+    const InternalLookupRequest& request,
+    InternalLookupResponse& response) const {
   auto scope_metrics_context = std::make_unique<ScopeMetricsContext>();
   RequestContext request_context(*scope_metrics_context);
-  if (context->IsCancelled()) {
+  if (context.IsCancelled()) {
     return grpc::Status(grpc::StatusCode::CANCELLED,
                         "Deadline exceeded or client cancelled, abandoning.");
   }
-  ProcessKeys(request_context, request->keys(), *response);
+  LookupAdmission admission(context);
+  if (!admission.admitted()) {
+    return admission.status();
+  }
+  ProcessKeys(request_context, request.keys(), response);
   return grpc::Status::OK;
 }
 
-grpc::Status LookupServiceImpl::SecureLookup(
-    grpc::ServerContext* context,
-    const SecureLookupRequest* secure_lookup_request,
-    SecureLookupResponse* secure_response) {
+grpc::Status LookupServiceImpl::ServeSecureLookup(
+    const grpc::ServerContextBase& context,
+    const SecureLookupRequest& secure_lookup_request,
+    SecureLookupResponse& secure_response) const {
+  const absl::Time start = absl::Now();
   auto scope_metrics_context = std::make_unique<ScopeMetricsContext>();
   RequestContext request_context(*scope_metrics_context);
   LogIfError(request_context.GetInternalLookupMetricsContext()
@@ -97,15 +409,46 @@ grpc::Status LookupServiceImpl::SecureLookup(
   ScopeLatencyMetricsRecorder<InternalLookupMetricsContext,
                               kInternalSecureLookupLatencyInMicros>
       latency_recorder(request_context.GetInternalLookupMetricsContext());
-  if (context->IsCancelled()) {
+  if (context.IsCancelled()) {
     return grpc::Status(grpc::StatusCode::CANCELLED,
                         "Deadline exceeded or client cancelled, abandoning.");
   }
+  LookupAdmission admission(context);
+  if (!admission.admitted()) {
+    return admission.status();
+  }
   VLOG(9) << "SecureLookup incoming";
 
   OhttpServerEncryptor encryptor(key_fetcher_manager_);
+  InternalLookupRequest request;
+  if (const auto status = DecryptSecureLookupRequest(
+          request_context, secure_lookup_request, encryptor, request);
+      !status.ok()) {
+    return status;
+  }
+  // The lookup is traced with the request it's part of, if that one is, from
+  // before it was decrypted.
+  const RequestSpan span =
+      RequestSpan::StartRemote("SecureLookup", request.trace_parent(), start);
+  request_context.SetTraceContext(span.context());
+  std::string payload;
+  {
+    const RequestSpan lookup_span = request_context.StartSpan("Lookup");
+    payload = GetCoalescedPayload(request_context, request);
+  }
+  const RequestSpan encrypt_span =
+      request_context.StartSpan("EncryptResponse");
+  return EncryptSecureLookupResponse(request_context, secure_lookup_request,
+                                     std::move(payload), encryptor,
+                                     secure_response);
+}
+
+grpc::Status LookupServiceImpl::DecryptSecureLookupRequest(
+    const RequestContext& request_context,
+    const SecureLookupRequest& secure_lookup_request,
+    OhttpServerEncryptor& encryptor, InternalLookupRequest& request) const {
   auto padded_serialized_request_maybe =
-      encryptor.DecryptRequest(secure_lookup_request->ohttp_request());
+      encryptor.DecryptRequest(secure_lookup_request.ohttp_request());
   if (!padded_serialized_request_maybe.ok()) {
     return ToInternalGrpcStatus(request_context,
                                 padded_serialized_request_maybe.status(),
@@ -122,59 +465,175 @@ grpc::Status LookupServiceImpl::SecureLookup(
   }
 
   VLOG(9) << "SecureLookup unpadded";
-  InternalLookupRequest request;
-  if (!request.ParseFromString(*serialized_request_maybe)) {
+  // Parsed from the decrypted buffer, without copying the request out of it.
+  if (!request.ParseFromArray(serialized_request_maybe->data(),
+                              serialized_request_maybe->size())) {
     return grpc::Status(grpc::StatusCode::INTERNAL,
                         "Failed parsing incoming request");
   }
+  return grpc::Status::OK;
+}
 
-  auto payload_to_encrypt =
-      GetPayload(request_context, request.lookup_sets(), request.keys());
+grpc::Status LookupServiceImpl::EncryptSecureLookupResponse(
+    const RequestContext& request_context,
+    const SecureLookupRequest& secure_lookup_request,
+    std::string payload_to_encrypt, OhttpServerEncryptor& encryptor,
+    SecureLookupResponse& secure_response) const {
+  secure_response.Clear();
   if (payload_to_encrypt.empty()) {
     // we cannot encrypt an empty payload. Note, that soon we will add logic
     // to pad responses, so this branch will never be hit.
     return grpc::Status::OK;
   }
-  auto encrypted_response_payload =
-      encryptor.EncryptResponse(payload_to_encrypt);
+  std::string compressed_payload;
+  const PayloadCompression compression = MaybeCompress(
+      secure_lookup_request, payload_to_encrypt, compressed_payload);
+  auto encrypted_response_payload = encryptor.EncryptResponse(
+      compression == PAYLOAD_COMPRESSION_NONE ? std::move(payload_to_encrypt)
+                                              : std::move(compressed_payload));
   if (!encrypted_response_payload.ok()) {
     return ToInternalGrpcStatus(request_context,
                                 encrypted_response_payload.status(),
                                 kResponseEncryptionFailure);
   }
-  secure_response->set_ohttp_response(*encrypted_response_payload);
+  secure_response.set_ohttp_response(*std::move(encrypted_response_payload));
+  secure_response.set_response_compression(compression);
   return grpc::Status::OK;
 }
 
-std::string LookupServiceImpl::GetPayload(
-    const RequestContext& request_context, const bool lookup_sets,
-    const RepeatedPtrField<std::string>& keys) const {
+PayloadCompression LookupServiceImpl::MaybeCompress(
+    const SecureLookupRequest& request, std::string_view payload,
+    std::string& compressed) const {
+  if (response_codec_ == nullptr ||
+      request.accepted_response_compression() != PAYLOAD_COMPRESSION_ZSTD ||
+      static_cast<int64_t>(payload.size()) < compression_min_bytes_) {
+    return PAYLOAD_COMPRESSION_NONE;
+  }
+  auto compressed_maybe = response_codec_->Compress(payload);
+  if (!compressed_maybe.ok() || compressed_maybe->size() >= payload.size()) {
+    return PAYLOAD_COMPRESSION_NONE;
+  }
+  compressed = *std::move(compressed_maybe);
+  return PAYLOAD_COMPRESSION_ZSTD;
+}
+
+InternalLookupResponse LookupServiceImpl::GetResponse(
+    const RequestContext& request_context,
+    const InternalLookupRequest& request) const {
   InternalLookupResponse response;
-  if (lookup_sets) {
-    ProcessKeysetKeys(request_context, keys, response);
+  if (request.lookup_sets()) {
+    ProcessKeysetKeys(request_context, request.keys(), response);
   } else {
-    ProcessKeys(request_context, keys, response);
+    ProcessKeys(request_context, request.keys(), response);
+    ProcessKeysetKeys(request_context, request.set_keys(), response);
   }
-  return response.SerializeAsString();
+  ProcessQueries(request_context, request.queries(), response);
+  return response;
 }
 
-grpc::Status LookupServiceImpl::InternalRunQuery(
-    grpc::ServerContext* context, const InternalRunQueryRequest* request,
-    InternalRunQueryResponse* response) {
+std::string LookupServiceImpl::GetPayload(
+    const RequestContext& request_context,
+    const InternalLookupRequest& request) const {
+  return GetResponse(request_context, request).SerializeAsString();
+}
+
+std::string LookupServiceImpl::GetCoalescedPayload(
+    const RequestContext& request_context,
+    const InternalLookupRequest& request) const {
+  const bool use_cache =
+      response_cache_ != nullptr && response_cache_->enabled();
+  if (single_flight_ == nullptr && !use_cache) {
+    return GetPayload(request_context, request);
+  }
+  // The same for requests of other servers that get the same payload.
+  const std::string coalescing_key = GetCoalescingKey(request);
+  uint64_t data_version = 0;
+  if (use_cache) {
+    if (auto cached = response_cache_->Lookup(coalescing_key);
+        cached != nullptr) {
+      return *cached;
+    }
+    data_version = response_cache_->data_version();
+  }
+  std::shared_ptr<const std::string> payload;
+  bool collapsed = false;
+  if (single_flight_ == nullptr) {
+    payload = std::make_shared<const std::string>(
+        GetPayload(request_context, request));
+  } else {
+    payload = single_flight_->Do(
+        coalescing_key,
+        [this, &request_context, &request] {
+          return GetPayload(request_context, request);
+        },
+        &collapsed);
+    LogSingleFlightEvent(collapsed ? kSingleFlightInternalLookupCollapsed
+                                   : kSingleFlightInternalLookupExecuted);
+  }
+  // A collapsed lookup may have started before `data_version`, so only the
+  // lookup that computed the payload adds it.
+  if (use_cache && !collapsed) {
+    response_cache_->Add(coalescing_key, data_version, payload);
+  }
+  return *payload;
+}
+
+grpc::Status LookupServiceImpl::ServeInternalRunQuery(
+    const grpc::ServerContextBase& context,
+    const InternalRunQueryRequest& request,
+    InternalRunQueryResponse& response) const {
   auto scope_metrics_context = std::make_unique<ScopeMetricsContext>();
   RequestContext request_context(*scope_metrics_context);
-  if (context->IsCancelled()) {
+  if (context.IsCancelled()) {
     return grpc::Status(grpc::StatusCode::CANCELLED,
                         "Deadline exceeded or client cancelled, abandoning.");
   }
+  LookupAdmission admission(context);
+  if (!admission.admitted()) {
+    return admission.status();
+  }
   const auto process_result =
-      lookup_.RunQuery(request_context, request->query());
+      request.profile() ? lookup_.ProfileQuery(request_context, request.query())
+                        : lookup_.RunQuery(request_context, request.query());
   if (!process_result.ok()) {
     return ToInternalGrpcStatus(request_context, process_result.status(),
                                 kInternalRunQueryRequestFailure);
   }
-  *response = *std::move(process_result);
+  response = *std::move(process_result);
   return grpc::Status::OK;
 }
 
+grpc::ServerUnaryReactor* CallbackLookupServiceImpl::InternalLookup(
+    grpc::CallbackServerContext* context, const InternalLookupRequest* request,
+    InternalLookupResponse* response) {
+  auto* reactor = context->DefaultReactor();
+  reactor->Finish(impl_.ServeInternalLookup(*context, *request, *response));
+  return reactor;
+}
+
+grpc::ServerUnaryReactor* CallbackLookupServiceImpl::SecureLookup(
+    grpc::CallbackServerContext* context, const SecureLookupRequest* request,
+    SecureLookupResponse* response) {
+  auto* reactor = context->DefaultReactor();
+  reactor->Finish(impl_.ServeSecureLookup(*context, *request, *response));
+  return reactor;
+}
+
+grpc::ServerWriteReactor<SecureLookupResponse>*
+CallbackLookupServiceImpl::SecureLookupStream(
+    grpc::CallbackServerContext* context, const SecureLookupRequest* request) {
+  return new LookupStreamReactor(
+      std::make_unique<LookupServiceImpl::LookupStream>(impl_, *context,
+                                                        *request));
+}
+
+grpc::ServerUnaryReactor* CallbackLookupServiceImpl::InternalRunQuery(
+    grpc::CallbackServerContext* context,
+    const InternalRunQueryRequest* request,
+    InternalRunQueryResponse* response) {
+  auto* reactor = context->DefaultReactor();
+  reactor->Finish(impl_.ServeInternalRunQuery(*context, *request, *response));
+  return reactor;
+}
+
 }  // namespace kv_server
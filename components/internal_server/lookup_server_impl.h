@@ -17,24 +17,44 @@
 #ifndef COMPONENTS_INTERNAL_SERVER_LOOKUP_SERVER_IMPL_H_
 #define COMPONENTS_INTERNAL_SERVER_LOOKUP_SERVER_IMPL_H_
 
+#include <cstdint>
+#include <memory>
 #include <string>
 
+#include "components/data_server/cache/value_codec.h"
+#include "components/data_server/request_handler/ohttp_server_encryptor.h"
 #include "components/internal_server/lookup.grpc.pb.h"
 #include "components/internal_server/lookup.h"
+#include "components/internal_server/lookup_response_cache.h"
 #include "components/util/request_context.h"
+#include "components/util/single_flight.h"
 #include "grpcpp/grpcpp.h"
 #include "src/encryption/key_fetcher/interface/key_fetcher_manager_interface.h"
 #include "src/telemetry/telemetry.h"
 
 namespace kv_server {
+
+// Set members and other results per chunk of a streamed secure lookup.
+inline constexpr int kDefaultLookupStreamChunkMaxValues = 10'000;
+
 // Implements the internal lookup service for the data store.
 class LookupServiceImpl final
     : public kv_server::InternalLookupService::Service {
  public:
-  LookupServiceImpl(const Lookup& lookup,
-                    privacy_sandbox::server_common::KeyFetcherManagerInterface&
-                        key_fetcher_manager)
-      : lookup_(lookup), key_fetcher_manager_(key_fetcher_manager) {}
+  // With `coalesce_lookups`, concurrent secure lookups of the same keys and
+  // queries share the payload of the first one. With a positive
+  // `compression_min_bytes`, secure lookup responses of at least that many
+  // bytes are compressed before they're encrypted, if their client accepts it.
+  // Streamed secure lookups send at most `stream_chunk_max_values` results and
+  // set members per chunk. The payloads of secure lookups are kept in
+  // `response_cache`, if any, which must outlive the service.
+  LookupServiceImpl(
+      const Lookup& lookup,
+      privacy_sandbox::server_common::KeyFetcherManagerInterface&
+          key_fetcher_manager,
+      bool coalesce_lookups = false, int64_t compression_min_bytes = 0,
+      int stream_chunk_max_values = kDefaultLookupStreamChunkMaxValues,
+      LookupResponseCache* response_cache = nullptr);
 
   ~LookupServiceImpl() override = default;
 
@@ -47,15 +67,57 @@ class LookupServiceImpl final
                             const kv_server::SecureLookupRequest* request,
                             kv_server::SecureLookupResponse* response) override;
 
+  // Streamed lookups aren't coalesced or cached, so that no response is held
+  // whole for longer than it takes to split it into chunks.
+  grpc::Status SecureLookupStream(
+      grpc::ServerContext* context,
+      const kv_server::SecureLookupRequest* request,
+      grpc::ServerWriter<kv_server::SecureLookupResponse>* writer) override;
+
   grpc::Status InternalRunQuery(
       grpc::ServerContext* context,
       const kv_server::InternalRunQueryRequest* request,
       kv_server::InternalRunQueryResponse* response) override;
 
+  // Serve the requests of both the synchronous and the callback services.
+  grpc::Status ServeInternalLookup(
+      const grpc::ServerContextBase& context,
+      const kv_server::InternalLookupRequest& request,
+      kv_server::InternalLookupResponse& response) const;
+  grpc::Status ServeSecureLookup(
+      const grpc::ServerContextBase& context,
+      const kv_server::SecureLookupRequest& request,
+      kv_server::SecureLookupResponse& response) const;
+  grpc::Status ServeInternalRunQuery(
+      const grpc::ServerContextBase& context,
+      const kv_server::InternalRunQueryRequest& request,
+      kv_server::InternalRunQueryResponse& response) const;
+
+  // Produces the chunks of a streamed secure lookup, for both services.
+  class LookupStream;
+
  private:
-  std::string GetPayload(
-      const RequestContext& request_context, const bool lookup_sets,
-      const google::protobuf::RepeatedPtrField<std::string>& keys) const;
+  grpc::Status DecryptSecureLookupRequest(
+      const RequestContext& request_context,
+      const SecureLookupRequest& secure_lookup_request,
+      OhttpServerEncryptor& encryptor, InternalLookupRequest& request) const;
+  grpc::Status EncryptSecureLookupResponse(
+      const RequestContext& request_context,
+      const SecureLookupRequest& secure_lookup_request,
+      std::string payload_to_encrypt, OhttpServerEncryptor& encryptor,
+      SecureLookupResponse& secure_response) const;
+  InternalLookupResponse GetResponse(
+      const RequestContext& request_context,
+      const InternalLookupRequest& request) const;
+  std::string GetPayload(const RequestContext& request_context,
+                         const InternalLookupRequest& request) const;
+  std::string GetCoalescedPayload(const RequestContext& request_context,
+                                  const InternalLookupRequest& request) const;
+  // Compresses `payload` into `compressed` if the client accepts it and it's
+  // large enough to be worth it. Returns the compression applied.
+  PayloadCompression MaybeCompress(const SecureLookupRequest& request,
+                                   std::string_view payload,
+                                   std::string& compressed) const;
   void ProcessKeys(const RequestContext& request_context,
                    const google::protobuf::RepeatedPtrField<std::string>& keys,
                    InternalLookupResponse& response) const;
@@ -63,12 +125,63 @@ class LookupServiceImpl final
       const RequestContext& request_context,
       const google::protobuf::RepeatedPtrField<std::string>& keys,
       InternalLookupResponse& response) const;
+  void ProcessQueries(
+      const RequestContext& request_context,
+      const google::protobuf::RepeatedPtrField<std::string>& queries,
+      InternalLookupResponse& response) const;
   grpc::Status ToInternalGrpcStatus(const RequestContext& request_context,
                                     const absl::Status& status,
                                     std::string_view error_code) const;
   const Lookup& lookup_;
   privacy_sandbox::server_common::KeyFetcherManagerInterface&
       key_fetcher_manager_;
+  // Null unless lookups are coalesced.
+  std::unique_ptr<SingleFlight<std::string>> single_flight_;
+  const int64_t compression_min_bytes_;
+  // Null unless responses are compressed.
+  std::unique_ptr<ValueCodec> response_codec_;
+  const int stream_chunk_max_values_;
+  // Null unless payloads are cached.
+  LookupResponseCache* const response_cache_;
+};
+
+// Implements the internal lookup service with the callback API. Lookups are
+// served on gRPC's callback threads instead of on threads that the server
+// polls its completion queues with.
+class CallbackLookupServiceImpl final
+    : public kv_server::InternalLookupService::CallbackService {
+ public:
+  CallbackLookupServiceImpl(
+      const Lookup& lookup,
+      privacy_sandbox::server_common::KeyFetcherManagerInterface&
+          key_fetcher_manager,
+      bool coalesce_lookups = false, int64_t compression_min_bytes = 0,
+      int stream_chunk_max_values = kDefaultLookupStreamChunkMaxValues,
+      LookupResponseCache* response_cache = nullptr)
+      : impl_(lookup, key_fetcher_manager, coalesce_lookups,
+              compression_min_bytes, stream_chunk_max_values, response_cache) {}
+
+  grpc::ServerUnaryReactor* InternalLookup(
+      grpc::CallbackServerContext* context,
+      const kv_server::InternalLookupRequest* request,
+      kv_server::InternalLookupResponse* response) override;
+
+  grpc::ServerUnaryReactor* SecureLookup(
+      grpc::CallbackServerContext* context,
+      const kv_server::SecureLookupRequest* request,
+      kv_server::SecureLookupResponse* response) override;
+
+  grpc::ServerWriteReactor<kv_server::SecureLookupResponse>*
+  SecureLookupStream(grpc::CallbackServerContext* context,
+                     const kv_server::SecureLookupRequest* request) override;
+
+  grpc::ServerUnaryReactor* InternalRunQuery(
+      grpc::CallbackServerContext* context,
+      const kv_server::InternalRunQueryRequest* request,
+      kv_server::InternalRunQueryResponse* response) override;
+
+ private:
+  LookupServiceImpl impl_;
 };
 
 }  // namespace kv_server
@@ -15,6 +15,7 @@
 
 #include "components/internal_server/lookup_server_impl.h"
 
+#include <chrono>
 #include <memory>
 #include <string>
 #include <utility>
@@ -24,6 +25,7 @@
 #include "components/data_server/cache/mocks.h"
 #include "components/internal_server/mocks.h"
 #include "components/internal_server/string_padder.h"
+#include "components/util/admission_controller.h"
 #include "gmock/gmock.h"
 #include "google/protobuf/text_format.h"
 #include "grpcpp/grpcpp.h"
@@ -104,6 +106,37 @@ TEST_F(LookupServiceImplTest,
   EXPECT_THAT(response, EqualsProto(expected));
 }
 
+TEST_F(LookupServiceImplTest, InternalLookup_ValuesAndSets) {
+  InternalLookupRequest request;
+  request.add_keys("key1");
+  request.add_set_keys("set1");
+  InternalLookupResponse values;
+  TextFormat::ParseFromString(R"pb(kv_pairs {
+                                     key: "key1"
+                                     value { value: "value1" }
+                                   }
+                              )pb",
+                              &values);
+  InternalLookupResponse sets;
+  TextFormat::ParseFromString(R"pb(kv_pairs {
+                                     key: "set1"
+                                     value { keyset_values { values: "a" } }
+                                   }
+                              )pb",
+                              &sets);
+  EXPECT_CALL(mock_lookup_, GetKeyValues(_, _)).WillOnce(Return(values));
+  EXPECT_CALL(mock_lookup_, GetKeyValueSet(_, _)).WillOnce(Return(sets));
+
+  InternalLookupResponse response;
+  grpc::ClientContext context;
+
+  grpc::Status status = stub_->InternalLookup(&context, request, &response);
+  InternalLookupResponse expected = values;
+  expected.mutable_kv_pairs()->insert(sets.kv_pairs().begin(),
+                                      sets.kv_pairs().end());
+  EXPECT_THAT(response, EqualsProto(expected));
+}
+
 TEST_F(LookupServiceImplTest, InternalRunQuery_Success) {
   InternalRunQueryRequest request;
   request.set_query("someset");
@@ -132,6 +165,23 @@ TEST_F(LookupServiceImplTest, InternalRunQuery_LookupError_Failure) {
   EXPECT_EQ(status.error_code(), grpc::StatusCode::INTERNAL);
 }
 
+TEST_F(LookupServiceImplTest, InternalLookup_ShedsCloseToDeadline) {
+  InternalLookupAdmissionController().SetOptions(
+      {.min_remaining_deadline = absl::Seconds(10)});
+  EXPECT_CALL(mock_lookup_, GetKeyValues(_, _)).Times(0);
+  InternalLookupRequest request;
+  request.add_keys("key1");
+  InternalLookupResponse response;
+  grpc::ClientContext context;
+  context.set_deadline(std::chrono::system_clock::now() +
+                       std::chrono::seconds(5));
+  grpc::Status status = stub_->InternalLookup(&context, request, &response);
+  InternalLookupAdmissionController().SetOptions({});
+
+  EXPECT_EQ(status.error_code(), grpc::StatusCode::UNAVAILABLE);
+  EXPECT_EQ(InternalLookupAdmissionController().num_shed_deadline(), 1);
+}
+
 TEST_F(LookupServiceImplTest, SecureLookupFailure) {
   SecureLookupRequest secure_lookup_request;
   secure_lookup_request.set_ohttp_request("garbage");
@@ -142,6 +192,73 @@ TEST_F(LookupServiceImplTest, SecureLookupFailure) {
   EXPECT_EQ(status.error_code(), grpc::StatusCode::INTERNAL);
 }
 
+class CallbackLookupServiceImplTest : public ::testing::Test {
+ protected:
+  CallbackLookupServiceImplTest() {
+    lookup_service_ = std::make_unique<CallbackLookupServiceImpl>(
+        mock_lookup_, fake_key_fetcher_manager_);
+    grpc::ServerBuilder builder;
+    builder.RegisterService(lookup_service_.get());
+    server_ = (builder.BuildAndStart());
+
+    stub_ = InternalLookupService::NewStub(
+        server_->InProcessChannel(grpc::ChannelArguments()));
+    InitMetricsContextMap();
+  }
+  ~CallbackLookupServiceImplTest() {
+    server_->Shutdown();
+    server_->Wait();
+  }
+  MockLookup mock_lookup_;
+  privacy_sandbox::server_common::FakeKeyFetcherManager
+      fake_key_fetcher_manager_;
+  std::unique_ptr<CallbackLookupServiceImpl> lookup_service_;
+  std::unique_ptr<grpc::Server> server_;
+  std::unique_ptr<InternalLookupService::Stub> stub_;
+};
+
+TEST_F(CallbackLookupServiceImplTest, InternalLookup_Success) {
+  InternalLookupRequest request;
+  request.add_keys("key1");
+  InternalLookupResponse expected;
+  TextFormat::ParseFromString(R"pb(kv_pairs {
+                                     key: "key1"
+                                     value { value: "value1" }
+                                   }
+                              )pb",
+                              &expected);
+  EXPECT_CALL(mock_lookup_, GetKeyValues(_, _)).WillOnce(Return(expected));
+
+  InternalLookupResponse response;
+  grpc::ClientContext context;
+  grpc::Status status = stub_->InternalLookup(&context, request, &response);
+
+  EXPECT_TRUE(status.ok());
+  EXPECT_THAT(response, EqualsProto(expected));
+}
+
+TEST_F(CallbackLookupServiceImplTest, InternalRunQuery_LookupError_Failure) {
+  InternalRunQueryRequest request;
+  request.set_query("fail|||||now");
+  EXPECT_CALL(mock_lookup_, RunQuery(_, _))
+      .WillOnce(Return(absl::UnknownError("Some error")));
+  InternalRunQueryResponse response;
+  grpc::ClientContext context;
+  grpc::Status status = stub_->InternalRunQuery(&context, request, &response);
+
+  EXPECT_EQ(status.error_code(), grpc::StatusCode::INTERNAL);
+}
+
+TEST_F(CallbackLookupServiceImplTest, SecureLookupFailure) {
+  SecureLookupRequest secure_lookup_request;
+  secure_lookup_request.set_ohttp_request("garbage");
+  SecureLookupResponse response;
+  grpc::ClientContext context;
+  grpc::Status status =
+      stub_->SecureLookup(&context, secure_lookup_request, &response);
+  EXPECT_EQ(status.error_code(), grpc::StatusCode::INTERNAL);
+}
+
 }  // namespace
 
 }  // namespace kv_server
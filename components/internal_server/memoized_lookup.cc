@@ -0,0 +1,193 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/internal_server/memoized_lookup.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/status/statusor.h"
+#include "components/internal_server/lookup.pb.h"
+#include "components/internal_server/lookup_memo.h"
+#include "components/telemetry/server_definition.h"
+
+namespace kv_server {
+namespace {
+
+void LogMemoEvents(const RequestContext& request_context, int num_hits,
+                   int num_misses) {
+  auto& metrics_context = request_context.GetUdfRequestMetricsContext();
+  if (num_hits > 0) {
+    LogIfError(metrics_context.AccumulateMetric<kLookupMemoEventCount>(
+        num_hits, kLookupMemoHit));
+  }
+  if (num_misses > 0) {
+    LogIfError(metrics_context.AccumulateMetric<kLookupMemoEventCount>(
+        num_misses, kLookupMemoMiss));
+  }
+}
+
+class MemoizedLookup : public Lookup {
+ public:
+  explicit MemoizedLookup(std::unique_ptr<Lookup> lookup)
+      : lookup_(std::move(lookup)) {}
+
+  absl::StatusOr<InternalLookupResponse> GetKeyValues(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& keys) const override {
+    LookupMemo& memo = request_context.GetLookupMemo();
+    InternalLookupResponse response;
+    const auto missing_keys = memo.GetKeyValues(keys, response);
+    LogMemoEvents(request_context, keys.size() - missing_keys.size(),
+                  missing_keys.size());
+    if (missing_keys.empty()) {
+      return response;
+    }
+    auto looked_up = lookup_->GetKeyValues(request_context, missing_keys);
+    if (!looked_up.ok()) {
+      return looked_up;
+    }
+    memo.AddKeyValues(*looked_up);
+    return Merge(std::move(response), *std::move(looked_up));
+  }
+
+  absl::StatusOr<InternalLookupResponse> GetKeyValueSet(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override {
+    LookupMemo& memo = request_context.GetLookupMemo();
+    InternalLookupResponse response;
+    const auto missing_keys = memo.GetKeyValueSet(key_set, response);
+    LogMemoEvents(request_context, key_set.size() - missing_keys.size(),
+                  missing_keys.size());
+    if (missing_keys.empty()) {
+      return response;
+    }
+    auto looked_up = lookup_->GetKeyValueSet(request_context, missing_keys);
+    if (!looked_up.ok()) {
+      return looked_up;
+    }
+    memo.AddKeyValueSet(*looked_up);
+    return Merge(std::move(response), *std::move(looked_up));
+  }
+
+  absl::StatusOr<InternalLookupResponse> GetKeyValuesAndSets(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& keys,
+      const absl::flat_hash_set<std::string_view>& set_keys) const override {
+    LookupMemo& memo = request_context.GetLookupMemo();
+    InternalLookupResponse response;
+    const auto missing_keys = memo.GetKeyValues(keys, response);
+    const auto missing_set_keys = memo.GetKeyValueSet(set_keys, response);
+    const int num_missing = missing_keys.size() + missing_set_keys.size();
+    LogMemoEvents(request_context, keys.size() + set_keys.size() - num_missing,
+                  num_missing);
+    if (num_missing == 0) {
+      return response;
+    }
+    auto looked_up = lookup_->GetKeyValuesAndSets(
+        request_context, missing_keys, missing_set_keys);
+    if (!looked_up.ok()) {
+      return looked_up;
+    }
+    // The values and the sets are memoized apart.
+    InternalLookupResponse looked_up_sets;
+    for (const std::string_view key : missing_set_keys) {
+      if (const auto it = looked_up->mutable_kv_pairs()->find(key);
+          it != looked_up->mutable_kv_pairs()->end()) {
+        (*looked_up_sets.mutable_kv_pairs())[key] = std::move(it->second);
+        looked_up->mutable_kv_pairs()->erase(it);
+      }
+    }
+    memo.AddKeyValues(*looked_up);
+    memo.AddKeyValueSet(looked_up_sets);
+    return Merge(Merge(std::move(response), *std::move(looked_up)),
+                 std::move(looked_up_sets));
+  }
+
+  // Prefix lookups aren't memoized, but the values they find are.
+  absl::StatusOr<InternalLookupResponse> GetKeyValuesByPrefix(
+      const RequestContext& request_context, std::string_view key_prefix,
+      int limit) const override {
+    auto looked_up =
+        lookup_->GetKeyValuesByPrefix(request_context, key_prefix, limit);
+    if (looked_up.ok()) {
+      request_context.GetLookupMemo().AddKeyValues(*looked_up);
+    }
+    return looked_up;
+  }
+
+  // Not memoized, unlike the sets that UDFs then look up.
+  absl::StatusOr<std::vector<std::string>> GetSetsContaining(
+      const RequestContext& request_context,
+      std::string_view member) const override {
+    return lookup_->GetSetsContaining(request_context, member);
+  }
+
+  absl::StatusOr<InternalRunQueryResponse> RunQuery(
+      const RequestContext& request_context, std::string query) const override {
+    LookupMemo& memo = request_context.GetLookupMemo();
+    if (auto result = memo.GetQueryResult(query); result.has_value()) {
+      LogMemoEvents(request_context, /*num_hits=*/1, /*num_misses=*/0);
+      return *std::move(result);
+    }
+    LogMemoEvents(request_context, /*num_hits=*/0, /*num_misses=*/1);
+    auto result = lookup_->RunQuery(request_context, query);
+    if (result.ok()) {
+      memo.AddQueryResult(query, *result);
+    }
+    return result;
+  }
+
+  // Profiled queries are run, rather than memoized.
+  absl::StatusOr<InternalRunQueryResponse> ProfileQuery(
+      const RequestContext& request_context, std::string query) const override {
+    return lookup_->ProfileQuery(request_context, std::move(query));
+  }
+
+  // Estimates are as cheap as memo lookups once the sketches are built.
+  absl::StatusOr<int64_t> ApproxCardinality(
+      const RequestContext& request_context, std::string query) const override {
+    return lookup_->ApproxCardinality(request_context, std::move(query));
+  }
+
+ private:
+  // Adds the results of `looked_up` to the memoized ones of `response`.
+  static InternalLookupResponse Merge(InternalLookupResponse response,
+                                      InternalLookupResponse looked_up) {
+    if (response.kv_pairs().empty()) {
+      return looked_up;
+    }
+    for (auto& [key, result] : *looked_up.mutable_kv_pairs()) {
+      (*response.mutable_kv_pairs())[key] = std::move(result);
+    }
+    return response;
+  }
+
+  std::unique_ptr<Lookup> lookup_;
+};
+
+}  // namespace
+
+std::unique_ptr<Lookup> CreateMemoizedLookup(std::unique_ptr<Lookup> lookup) {
+  return std::make_unique<MemoizedLookup>(std::move(lookup));
+}
+
+}  // namespace kv_server
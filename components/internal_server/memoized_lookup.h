@@ -0,0 +1,33 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_INTERNAL_SERVER_MEMOIZED_LOOKUP_H_
+#define COMPONENTS_INTERNAL_SERVER_MEMOIZED_LOOKUP_H_
+
+#include <memory>
+
+#include "components/internal_server/lookup.h"
+
+namespace kv_server {
+
+// Serves the keys, sets and queries that were already looked up within the
+// same request from the `LookupMemo` of the request context, and looks up the
+// rest with `lookup`, memoizing their results for the rest of the request.
+std::unique_ptr<Lookup> CreateMemoizedLookup(std::unique_ptr<Lookup> lookup);
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_INTERNAL_SERVER_MEMOIZED_LOOKUP_H_
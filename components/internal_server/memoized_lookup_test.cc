@@ -0,0 +1,221 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/internal_server/memoized_lookup.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "components/internal_server/mocks.h"
+#include "gmock/gmock.h"
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+#include "public/test_util/proto_matcher.h"
+
+namespace kv_server {
+namespace {
+
+using google::protobuf::TextFormat;
+using testing::_;
+using testing::Return;
+
+class MemoizedLookupTest : public ::testing::Test {
+ protected:
+  MemoizedLookupTest() {
+    InitMetricsContextMap();
+    scope_metrics_context_ = std::make_unique<ScopeMetricsContext>();
+    request_context_ =
+        std::make_unique<RequestContext>(*scope_metrics_context_);
+    auto mock_lookup = std::make_unique<MockLookup>();
+    mock_lookup_ = mock_lookup.get();
+    memoized_lookup_ = CreateMemoizedLookup(std::move(mock_lookup));
+  }
+  RequestContext& GetRequestContext() { return *request_context_; }
+  std::unique_ptr<ScopeMetricsContext> scope_metrics_context_;
+  std::unique_ptr<RequestContext> request_context_;
+  MockLookup* mock_lookup_;
+  std::unique_ptr<Lookup> memoized_lookup_;
+};
+
+TEST_F(MemoizedLookupTest, GetKeyValues_OnlyLooksUpKeysNotLookedUpYet) {
+  InternalLookupResponse first_response;
+  TextFormat::ParseFromString(
+      R"pb(kv_pairs {
+             key: "key1"
+             value { value: "value1" }
+           }
+           kv_pairs {
+             key: "key2"
+             value { status { code: 5 message: "Key not found" } }
+           })pb",
+      &first_response);
+  InternalLookupResponse second_response;
+  TextFormat::ParseFromString(R"pb(kv_pairs {
+                                     key: "key3"
+                                     value { value: "value3" }
+                                   })pb",
+                              &second_response);
+  EXPECT_CALL(*mock_lookup_,
+              GetKeyValues(_, absl::flat_hash_set<std::string_view>{"key1",
+                                                                    "key2"}))
+      .WillOnce(Return(first_response));
+  EXPECT_CALL(*mock_lookup_,
+              GetKeyValues(_, absl::flat_hash_set<std::string_view>{"key3"}))
+      .WillOnce(Return(second_response));
+
+  auto response =
+      memoized_lookup_->GetKeyValues(GetRequestContext(), {"key1", "key2"});
+  ASSERT_TRUE(response.ok()) << response.status();
+  EXPECT_THAT(*response, EqualsProto(first_response));
+
+  // A copy of the context shares the memo, as the partitions of a request do.
+  RequestContext request_context_copy = GetRequestContext();
+  response = memoized_lookup_->GetKeyValues(request_context_copy,
+                                            {"key1", "key2", "key3"});
+  ASSERT_TRUE(response.ok()) << response.status();
+  InternalLookupResponse expected;
+  TextFormat::ParseFromString(
+      R"pb(kv_pairs {
+             key: "key1"
+             value { value: "value1" }
+           }
+           kv_pairs {
+             key: "key2"
+             value { status { code: 5 message: "Key not found" } }
+           }
+           kv_pairs {
+             key: "key3"
+             value { value: "value3" }
+           })pb",
+      &expected);
+  EXPECT_THAT(*response, EqualsProto(expected));
+
+  response = memoized_lookup_->GetKeyValues(GetRequestContext(), {"key3"});
+  ASSERT_TRUE(response.ok()) << response.status();
+  EXPECT_THAT(*response, EqualsProto(second_response));
+}
+
+TEST_F(MemoizedLookupTest, GetKeyValues_DoesNotMemoizeErrors) {
+  InternalLookupResponse error_response;
+  TextFormat::ParseFromString(
+      R"pb(kv_pairs {
+             key: "key1"
+             value { status { code: 14 message: "Shard unavailable" } }
+           })pb",
+      &error_response);
+  EXPECT_CALL(*mock_lookup_, GetKeyValues(_, _))
+      .WillOnce(Return(absl::UnavailableError("Lookup failed")))
+      .WillOnce(Return(error_response))
+      .WillOnce(Return(error_response));
+
+  EXPECT_FALSE(
+      memoized_lookup_->GetKeyValues(GetRequestContext(), {"key1"}).ok());
+  for (int i = 0; i < 2; ++i) {
+    auto response =
+        memoized_lookup_->GetKeyValues(GetRequestContext(), {"key1"});
+    ASSERT_TRUE(response.ok()) << response.status();
+    EXPECT_THAT(*response, EqualsProto(error_response));
+  }
+}
+
+TEST_F(MemoizedLookupTest, GetKeyValueSet_IsMemoizedApartFromValues) {
+  InternalLookupResponse set_response;
+  TextFormat::ParseFromString(
+      R"pb(kv_pairs {
+             key: "key1"
+             value { keyset_values { values: "a" values: "b" } }
+           })pb",
+      &set_response);
+  InternalLookupResponse value_response;
+  TextFormat::ParseFromString(R"pb(kv_pairs {
+                                     key: "key1"
+                                     value { value: "value1" }
+                                   })pb",
+                              &value_response);
+  EXPECT_CALL(*mock_lookup_, GetKeyValueSet(_, _))
+      .WillOnce(Return(set_response));
+  EXPECT_CALL(*mock_lookup_, GetKeyValues(_, _))
+      .WillOnce(Return(value_response));
+
+  for (int i = 0; i < 2; ++i) {
+    auto response =
+        memoized_lookup_->GetKeyValueSet(GetRequestContext(), {"key1"});
+    ASSERT_TRUE(response.ok()) << response.status();
+    EXPECT_THAT(*response, EqualsProto(set_response));
+  }
+  auto response = memoized_lookup_->GetKeyValues(GetRequestContext(), {"key1"});
+  ASSERT_TRUE(response.ok()) << response.status();
+  EXPECT_THAT(*response, EqualsProto(value_response));
+}
+
+TEST_F(MemoizedLookupTest, GetKeyValuesAndSets_MemoizesValuesAndSetsApart) {
+  InternalLookupResponse value_response;
+  TextFormat::ParseFromString(R"pb(kv_pairs {
+                                     key: "key1"
+                                     value { value: "value1" }
+                                   })pb",
+                              &value_response);
+  InternalLookupResponse set_response;
+  TextFormat::ParseFromString(
+      R"pb(kv_pairs {
+             key: "set1"
+             value { keyset_values { values: "a" values: "b" } }
+           })pb",
+      &set_response);
+  EXPECT_CALL(*mock_lookup_, GetKeyValues(_, _))
+      .WillOnce(Return(value_response));
+  EXPECT_CALL(*mock_lookup_, GetKeyValueSet(_, _))
+      .WillOnce(Return(set_response));
+
+  auto response = memoized_lookup_->GetKeyValuesAndSets(GetRequestContext(),
+                                                        {"key1"}, {"set1"});
+  ASSERT_TRUE(response.ok()) << response.status();
+  InternalLookupResponse expected = value_response;
+  expected.mutable_kv_pairs()->insert(set_response.kv_pairs().begin(),
+                                      set_response.kv_pairs().end());
+  EXPECT_THAT(*response, EqualsProto(expected));
+  response = memoized_lookup_->GetKeyValues(GetRequestContext(), {"key1"});
+  ASSERT_TRUE(response.ok()) << response.status();
+  EXPECT_THAT(*response, EqualsProto(value_response));
+  response = memoized_lookup_->GetKeyValueSet(GetRequestContext(), {"set1"});
+  ASSERT_TRUE(response.ok()) << response.status();
+  EXPECT_THAT(*response, EqualsProto(set_response));
+}
+
+TEST_F(MemoizedLookupTest, RunQuery_IsMemoizedPerRequest) {
+  InternalRunQueryResponse query_response;
+  TextFormat::ParseFromString(R"pb(elements: "a" elements: "b")pb",
+                              &query_response);
+  EXPECT_CALL(*mock_lookup_, RunQuery(_, "A | B"))
+      .Times(2)
+      .WillRepeatedly(Return(query_response));
+
+  for (int i = 0; i < 2; ++i) {
+    auto response = memoized_lookup_->RunQuery(GetRequestContext(), "A | B");
+    ASSERT_TRUE(response.ok()) << response.status();
+    EXPECT_THAT(*response, EqualsProto(query_response));
+  }
+  // Another request does not see the results of the first one.
+  ScopeMetricsContext other_metrics_context;
+  auto response = memoized_lookup_->RunQuery(
+      RequestContext(other_metrics_context), "A | B");
+  ASSERT_TRUE(response.ok()) << response.status();
+  EXPECT_THAT(*response, EqualsProto(query_response));
+}
+
+}  // namespace
+}  // namespace kv_server
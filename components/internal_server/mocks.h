@@ -17,6 +17,7 @@
 #ifndef COMPONENTS_INTERNAL_SERVER_MOCKS_H_
 #define COMPONENTS_INTERNAL_SERVER_MOCKS_H_
 
+#include <cstdint>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -49,8 +50,16 @@ class MockLookup : public Lookup {
               (const RequestContext&,
                const absl::flat_hash_set<std::string_view>&),
               (const, override));
+  MOCK_METHOD(absl::StatusOr<InternalLookupResponse>, GetKeyValuesByPrefix,
+              (const RequestContext&, std::string_view key_prefix, int limit),
+              (const, override));
+  MOCK_METHOD(absl::StatusOr<std::vector<std::string>>, GetSetsContaining,
+              (const RequestContext&, std::string_view member),
+              (const, override));
   MOCK_METHOD(absl::StatusOr<InternalRunQueryResponse>, RunQuery,
               (const RequestContext&, std::string query), (const, override));
+  MOCK_METHOD(absl::StatusOr<int64_t>, ApproxCardinality,
+              (const RequestContext&, std::string query), (const, override));
 };
 
 }  // namespace kv_server
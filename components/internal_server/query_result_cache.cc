@@ -0,0 +1,85 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/internal_server/query_result_cache.h"
+
+#include <algorithm>
+#include <memory>
+#include <utility>
+
+namespace kv_server {
+
+QueryResultCache::QueryResultCache(int max_queries)
+    : max_queries_(max_queries) {}
+
+std::optional<InternalRunQueryResponse> QueryResultCache::Lookup(
+    std::string_view query, KeyVersions key_versions) {
+  if (max_queries_ == 0) {
+    return std::nullopt;
+  }
+  std::sort(key_versions.begin(), key_versions.end());
+  std::shared_ptr<const InternalRunQueryResponse> response;
+  {
+    absl::MutexLock lock(&mutex_);
+    const auto it = index_.find(query);
+    if (it == index_.end()) {
+      return std::nullopt;
+    }
+    const Entry& entry = *it->second;
+    if (!std::equal(entry.key_versions.begin(), entry.key_versions.end(),
+                    key_versions.begin(), key_versions.end(),
+                    [](const auto& cached, const auto& current) {
+                      return cached.first == current.first &&
+                             cached.second == current.second;
+                    })) {
+      // Stale, replaced once the query is run again.
+      return std::nullopt;
+    }
+    entries_.splice(entries_.begin(), entries_, it->second);
+    response = entry.response;
+  }
+  // Copied without the lock.
+  return *response;
+}
+
+void QueryResultCache::Add(std::string_view query, KeyVersions key_versions,
+                           const InternalRunQueryResponse& response) {
+  if (max_queries_ == 0) {
+    return;
+  }
+  std::sort(key_versions.begin(), key_versions.end());
+  Entry entry{
+      .query = std::string(query),
+      .response = std::make_shared<const InternalRunQueryResponse>(response)};
+  entry.key_versions.reserve(key_versions.size());
+  for (const auto& [key, version] : key_versions) {
+    entry.key_versions.emplace_back(key, version);
+  }
+  absl::MutexLock lock(&mutex_);
+  if (const auto it = index_.find(query); it != index_.end()) {
+    const auto entry_it = it->second;
+    index_.erase(it);
+    entries_.erase(entry_it);
+  }
+  entries_.push_front(std::move(entry));
+  index_.emplace(entries_.front().query, entries_.begin());
+  if (static_cast<int>(entries_.size()) > max_queries_) {
+    index_.erase(entries_.back().query);
+    entries_.pop_back();
+  }
+}
+
+}  // namespace kv_server
@@ -0,0 +1,86 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_INTERNAL_SERVER_QUERY_RESULT_CACHE_H_
+#define COMPONENTS_INTERNAL_SERVER_QUERY_RESULT_CACHE_H_
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "components/internal_server/lookup.pb.h"
+
+namespace kv_server {
+
+// Keeps the responses of the most recently run queries, by normalized query,
+// with the versions of the sets of the keys that they were computed from.
+//
+// A response is only returned for the same versions. Mutations of a set change
+// its version, so entries never go stale and don't expire: the next run of a
+// query over a mutated set misses and replaces the entry.
+//
+// Thread-safe.
+class QueryResultCache {
+ public:
+  // The version of the set of each key of a query, in any order.
+  using KeyVersions = std::vector<std::pair<std::string_view, uint64_t>>;
+
+  // Keeps at most `max_queries` responses. 0 disables the cache.
+  explicit QueryResultCache(int max_queries);
+  QueryResultCache(const QueryResultCache&) = delete;
+  QueryResultCache& operator=(const QueryResultCache&) = delete;
+
+  bool enabled() const { return max_queries_ > 0; }
+
+  // Returns the response that was added for `query` with the same
+  // `key_versions`, if any.
+  std::optional<InternalRunQueryResponse> Lookup(std::string_view query,
+                                                 KeyVersions key_versions)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Keeps `response` as the response of `query` for `key_versions`.
+  void Add(std::string_view query, KeyVersions key_versions,
+           const InternalRunQueryResponse& response)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  struct Entry {
+    std::string query;
+    // Sorted by key.
+    std::vector<std::pair<std::string, uint64_t>> key_versions;
+    // Shared, so that lookups copy it without the lock.
+    std::shared_ptr<const InternalRunQueryResponse> response;
+  };
+
+  const int max_queries_;
+  absl::Mutex mutex_;
+  // Most recently used first.
+  std::list<Entry> entries_ ABSL_GUARDED_BY(mutex_);
+  // Views of the queries of `entries_`.
+  absl::flat_hash_map<std::string_view, std::list<Entry>::iterator> index_
+      ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_INTERNAL_SERVER_QUERY_RESULT_CACHE_H_
@@ -0,0 +1,106 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/internal_server/query_result_cache.h"
+
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+using testing::ElementsAre;
+
+InternalRunQueryResponse Response(std::string element) {
+  InternalRunQueryResponse response;
+  response.add_elements(std::move(element));
+  return response;
+}
+
+TEST(QueryResultCacheTest, Disabled) {
+  QueryResultCache cache(/*max_queries=*/0);
+  EXPECT_FALSE(cache.enabled());
+  cache.Add("A", {{"A", 1}}, Response("a"));
+  EXPECT_FALSE(cache.Lookup("A", {{"A", 1}}).has_value());
+}
+
+TEST(QueryResultCacheTest, ReturnsResponseForSameVersions) {
+  QueryResultCache cache(/*max_queries=*/10);
+  EXPECT_TRUE(cache.enabled());
+  EXPECT_FALSE(cache.Lookup("A & B", {{"A", 1}, {"B", 2}}).has_value());
+  cache.Add("A & B", {{"A", 1}, {"B", 2}}, Response("a"));
+
+  // Versions are matched by key, in any order.
+  const auto response = cache.Lookup("A & B", {{"B", 2}, {"A", 1}});
+  ASSERT_TRUE(response.has_value());
+  EXPECT_THAT(response->elements(), ElementsAre("a"));
+  EXPECT_FALSE(cache.Lookup("A | B", {{"A", 1}, {"B", 2}}).has_value());
+}
+
+TEST(QueryResultCacheTest, MissesOnceASetChanges) {
+  QueryResultCache cache(/*max_queries=*/10);
+  cache.Add("A & B", {{"A", 1}, {"B", 2}}, Response("a"));
+  EXPECT_FALSE(cache.Lookup("A & B", {{"A", 1}, {"B", 3}}).has_value());
+  EXPECT_FALSE(cache.Lookup("A & B", {{"A", 1}}).has_value());
+
+  cache.Add("A & B", {{"A", 1}, {"B", 3}}, Response("b"));
+  EXPECT_FALSE(cache.Lookup("A & B", {{"A", 1}, {"B", 2}}).has_value());
+  const auto response = cache.Lookup("A & B", {{"A", 1}, {"B", 3}});
+  ASSERT_TRUE(response.has_value());
+  EXPECT_THAT(response->elements(), ElementsAre("b"));
+}
+
+TEST(QueryResultCacheTest, EvictsLeastRecentlyUsed) {
+  QueryResultCache cache(/*max_queries=*/2);
+  cache.Add("A", {{"A", 1}}, Response("a"));
+  cache.Add("B", {{"B", 1}}, Response("b"));
+  EXPECT_TRUE(cache.Lookup("A", {{"A", 1}}).has_value());
+  cache.Add("C", {{"C", 1}}, Response("c"));
+
+  EXPECT_TRUE(cache.Lookup("A", {{"A", 1}}).has_value());
+  EXPECT_FALSE(cache.Lookup("B", {{"B", 1}}).has_value());
+  EXPECT_TRUE(cache.Lookup("C", {{"C", 1}}).has_value());
+}
+
+TEST(QueryResultCacheTest, ConcurrentLookupsAndAdds) {
+  QueryResultCache cache(/*max_queries=*/4);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&cache, i] {
+      for (int j = 0; j < 100; ++j) {
+        const std::string query = absl::StrCat("Q", j % 8);
+        const auto response = cache.Lookup(query, {{"A", j % 3}});
+        if (response.has_value()) {
+          EXPECT_THAT(response->elements(), ElementsAre(query));
+        } else {
+          cache.Add(query, {{"A", j % 3}}, Response(query));
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -21,13 +21,39 @@
 #include <string>
 #include <vector>
 
+#include "absl/functional/any_invocable.h"
+#include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/time/time.h"
 #include "components/internal_server/lookup.grpc.pb.h"
 #include "components/util/request_context.h"
 #include "src/encryption/key_fetcher/interface/key_fetcher_manager_interface.h"
 
 namespace kv_server {
 
+// Connections of a client to its replica. A single HTTP/2 connection carries
+// all of the concurrent lookups of the client otherwise, so that they queue
+// behind each other's frames and are bound to the single thread that reads
+// the connection.
+struct RemoteLookupClientOptions {
+  // Channels, each with its own connection, that the lookups are spread over
+  // round-robin.
+  int num_channels = 1;
+  // Pings an idle connection after this long, and drops it if the ping isn't
+  // acknowledged within the timeout. gRPC's defaults are kept for zeros.
+  absl::Duration keepalive_time = absl::ZeroDuration();
+  absl::Duration keepalive_timeout = absl::ZeroDuration();
+  // The initial HTTP/2 flow control window of a call. gRPC's default, which
+  // grows the window with the measured bandwidth-delay product, is kept for 0.
+  int initial_window_size_bytes = 0;
+  // `GetValuesStreamAsync` streams the response in chunks. Requires servers
+  // that serve `SecureLookupStream`.
+  bool stream_responses = false;
+  // A lookup not answered within this long fails with `DEADLINE_EXCEEDED`,
+  // even if its request has more time left. No timeout if it's zero.
+  absl::Duration timeout = absl::ZeroDuration();
+};
+
 class RemoteLookupClient {
  public:
   virtual ~RemoteLookupClient() = default;
@@ -39,15 +65,67 @@ class RemoteLookupClient {
   virtual absl::StatusOr<InternalLookupResponse> GetValues(
       const RequestContext& request_context,
       std::string_view serialized_message, int32_t padding_length) const = 0;
+  // Calls the remote internal lookup server like `GetValues`, without
+  // blocking the calling thread while the call is in flight. `on_done` is
+  // called with the response, possibly on a thread of gRPC, and
+  // `request_context` must outlive that call.
+  // By default, calls `GetValues` and then `on_done` on the calling thread.
+  virtual void GetValuesAsync(
+      const RequestContext& request_context,
+      std::string_view serialized_message, int32_t padding_length,
+      absl::AnyInvocable<void(absl::StatusOr<InternalLookupResponse>) &&>
+          on_done) const {
+    std::move(on_done)(
+        GetValues(request_context, serialized_message, padding_length));
+  }
+  // Looks up like `GetValuesAsync`, but passes the response to `on_chunk` in
+  // chunks as they arrive, so that the caller can use the first chunks while
+  // the rest are on their way and doesn't have to hold the whole response. A
+  // key set may be split over several chunks, whose values add up to the set.
+  // `on_done` is called once, after the last chunk, with the status of the
+  // lookup. Chunks are passed one at a time, possibly on a thread of gRPC.
+  // By default, passes the response of `GetValuesAsync` as a single chunk.
+  virtual void GetValuesStreamAsync(
+      const RequestContext& request_context,
+      std::string_view serialized_message, int32_t padding_length,
+      absl::AnyInvocable<void(InternalLookupResponse)> on_chunk,
+      absl::AnyInvocable<void(absl::Status) &&> on_done) const {
+    GetValuesAsync(
+        request_context, serialized_message, padding_length,
+        [on_chunk = std::move(on_chunk), on_done = std::move(on_done)](
+            absl::StatusOr<InternalLookupResponse> response) mutable {
+          if (!response.ok()) {
+            std::move(on_done)(response.status());
+            return;
+          }
+          on_chunk(*std::move(response));
+          std::move(on_done)(absl::OkStatus());
+        });
+  }
   virtual std::string_view GetIpAddress() const = 0;
+  // Connects the client to its replica, so that its first lookups don't wait
+  // for the connection. Returns whether it is connected by `deadline`, a
+  // deadline in the past starts connecting without waiting. By default, the
+  // client is taken to be connected.
+  virtual bool WarmUp(absl::Time deadline) const { return true; }
   static std::unique_ptr<RemoteLookupClient> Create(
       std::string ip_address,
       privacy_sandbox::server_common::KeyFetcherManagerInterface&
-          key_fetcher_manager);
+          key_fetcher_manager,
+      RemoteLookupClientOptions options = {});
+  // Only `stream_responses` and `timeout` of `options` apply to the given
+  // stubs.
   static std::unique_ptr<RemoteLookupClient> Create(
       std::unique_ptr<InternalLookupService::Stub> stub,
       privacy_sandbox::server_common::KeyFetcherManagerInterface&
-          key_fetcher_manager);
+          key_fetcher_manager,
+      RemoteLookupClientOptions options = {});
+  // Spreads the lookups over `stubs` round-robin.
+  static std::unique_ptr<RemoteLookupClient> Create(
+      std::vector<std::unique_ptr<InternalLookupService::Stub>> stubs,
+      privacy_sandbox::server_common::KeyFetcherManagerInterface&
+          key_fetcher_manager,
+      RemoteLookupClientOptions options = {});
 };
 
 }  // namespace kv_server
@@ -11,13 +11,21 @@
 // WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 // See the License for the specific language governing permissions and
 // limitations under the License.
+#include <algorithm>
+#include <atomic>
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "absl/log/log.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/str_format.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "components/data_server/cache/value_codec.h"
 #include "components/data_server/request_handler/ohttp_client_encryptor.h"
 #include "components/internal_server/constants.h"
 #include "components/internal_server/lookup.grpc.pb.h"
@@ -36,27 +44,218 @@ class RemoteLookupClientImpl : public RemoteLookupClient {
   explicit RemoteLookupClientImpl(
       std::string ip_address,
       privacy_sandbox::server_common::KeyFetcherManagerInterface&
-          key_fetcher_manager)
+          key_fetcher_manager,
+      const RemoteLookupClientOptions& options)
       : ip_address_(
             absl::StrFormat("%s:%s", ip_address, kRemoteLookupServerPort)),
-        stub_(InternalLookupService::NewStub(grpc::CreateChannel(
-            ip_address_, grpc::InsecureChannelCredentials()))),
-        key_fetcher_manager_(key_fetcher_manager) {}
+        channels_(CreateChannels(ip_address_, options)),
+        stubs_(CreateStubs(channels_)),
+        key_fetcher_manager_(key_fetcher_manager),
+        stream_responses_(options.stream_responses),
+        timeout_(options.timeout) {}
 
   explicit RemoteLookupClientImpl(
-      std::unique_ptr<InternalLookupService::Stub> stub,
+      std::vector<std::unique_ptr<InternalLookupService::Stub>> stubs,
       privacy_sandbox::server_common::KeyFetcherManagerInterface&
-          key_fetcher_manager)
-      : stub_(std::move(stub)), key_fetcher_manager_(key_fetcher_manager) {}
+          key_fetcher_manager,
+      const RemoteLookupClientOptions& options)
+      : stubs_(std::move(stubs)),
+        key_fetcher_manager_(key_fetcher_manager),
+        stream_responses_(options.stream_responses),
+        timeout_(options.timeout) {}
 
   absl::StatusOr<InternalLookupResponse> GetValues(
       const RequestContext& request_context,
       std::string_view serialized_message,
       int32_t padding_length) const override {
+    absl::Notification done;
+    absl::StatusOr<InternalLookupResponse> response;
+    GetValuesAsync(request_context, serialized_message, padding_length,
+                   [&done, &response](
+                       absl::StatusOr<InternalLookupResponse> result) {
+                     response = std::move(result);
+                     done.Notify();
+                   });
+    done.WaitForNotification();
+    return response;
+  }
+
+  // The call is made with the callback API, so that no thread waits for the
+  // remote server, and the response is decrypted on the thread of gRPC that
+  // receives it.
+  void GetValuesAsync(
+      const RequestContext& request_context,
+      std::string_view serialized_message, int32_t padding_length,
+      absl::AnyInvocable<void(absl::StatusOr<InternalLookupResponse>) &&>
+          on_done) const override {
+    // Lookups still queued once their request is cancelled aren't sent.
+    if (request_context.IsCancelled()) {
+      std::move(on_done)(absl::CancelledError(
+          "Request was cancelled or is past its deadline."));
+      return;
+    }
+    auto call = std::make_unique<Call>(request_context, key_fetcher_manager_,
+                                       std::move(on_done));
+    if (const auto status =
+            PrepareCall(request_context, serialized_message, padding_length,
+                        call->encryptor, call->request, call->context);
+        !status.ok()) {
+      std::move(call->on_done)(status);
+      return;
+    }
+    Call* const started_call = call.release();
+    NextStub().async()->SecureLookup(
+        &started_call->context, &started_call->request,
+        &started_call->response, [started_call](grpc::Status status) {
+          std::unique_ptr<Call> call(started_call);
+          auto response = ToInternalLookupResponse(*call, status);
+          auto on_done = std::move(call->on_done);
+          // The request context may be gone once `on_done` returns.
+          call.reset();
+          std::move(on_done)(std::move(response));
+        });
+  }
+
+  // Streams the response with the callback API, each chunk is decrypted on
+  // the thread of gRPC that receives it.
+  void GetValuesStreamAsync(
+      const RequestContext& request_context,
+      std::string_view serialized_message, int32_t padding_length,
+      absl::AnyInvocable<void(InternalLookupResponse)> on_chunk,
+      absl::AnyInvocable<void(absl::Status) &&> on_done) const override {
+    if (!stream_responses_) {
+      RemoteLookupClient::GetValuesStreamAsync(
+          request_context, serialized_message, padding_length,
+          std::move(on_chunk), std::move(on_done));
+      return;
+    }
+    if (request_context.IsCancelled()) {
+      std::move(on_done)(absl::CancelledError(
+          "Request was cancelled or is past its deadline."));
+      return;
+    }
+    auto call = std::make_unique<StreamCall>(
+        request_context, key_fetcher_manager_, std::move(on_chunk),
+        std::move(on_done));
+    if (const auto status =
+            PrepareCall(request_context, serialized_message, padding_length,
+                        call->encryptor, call->request, call->context);
+        !status.ok()) {
+      std::move(call->on_done)(status);
+      return;
+    }
+    call.release()->Start(NextStub());
+  }
+
+  std::string_view GetIpAddress() const override { return ip_address_; }
+
+  bool WarmUp(absl::Time deadline) const override {
+    bool connected = true;
+    for (const auto& channel : channels_) {
+      connected &= channel->WaitForConnected(absl::ToChronoTime(deadline));
+    }
+    return connected;
+  }
+
+ private:
+  // The state of a call in flight. The latency of the call is recorded once
+  // it's destroyed.
+  struct Call {
+    Call(const RequestContext& request_context,
+         privacy_sandbox::server_common::KeyFetcherManagerInterface&
+             key_fetcher_manager,
+         absl::AnyInvocable<void(absl::StatusOr<InternalLookupResponse>) &&>
+             on_done)
+        : request_context(request_context),
+          latency_recorder(request_context.GetUdfRequestMetricsContext()),
+          encryptor(key_fetcher_manager),
+          on_done(std::move(on_done)) {}
+
+    const RequestContext& request_context;
     ScopeLatencyMetricsRecorder<UdfRequestMetricsContext,
                                 kRemoteLookupGetValuesLatencyInMicros>
-        latency_recorder(request_context.GetUdfRequestMetricsContext());
-    OhttpClientEncryptor encryptor(key_fetcher_manager_);
+        latency_recorder;
+    OhttpClientEncryptor encryptor;
+    grpc::ClientContext context;
+    SecureLookupRequest request;
+    SecureLookupResponse response;
+    absl::AnyInvocable<void(absl::StatusOr<InternalLookupResponse>) &&>
+        on_done;
+  };
+
+  // A streamed call in flight, which deletes itself once it's done. Its
+  // latency is recorded once it's destroyed.
+  class StreamCall : public grpc::ClientReadReactor<SecureLookupResponse> {
+   public:
+    StreamCall(const RequestContext& request_context,
+               privacy_sandbox::server_common::KeyFetcherManagerInterface&
+                   key_fetcher_manager,
+               absl::AnyInvocable<void(InternalLookupResponse)> on_chunk,
+               absl::AnyInvocable<void(absl::Status) &&> on_done)
+        : request_context(request_context),
+          latency_recorder(request_context.GetUdfRequestMetricsContext()),
+          encryptor(key_fetcher_manager),
+          on_chunk(std::move(on_chunk)),
+          on_done(std::move(on_done)) {}
+
+    void Start(InternalLookupService::Stub& stub) {
+      stub.async()->SecureLookupStream(&context, &request, this);
+      StartRead(&response);
+      StartCall();
+    }
+
+    void OnReadDone(bool ok) override {
+      if (!ok) {
+        // The stream is over, `OnDone` follows.
+        return;
+      }
+      auto chunk = DecryptResponse(request_context, encryptor, response);
+      if (!chunk.ok()) {
+        decryption_status = chunk.status();
+        context.TryCancel();
+        return;
+      }
+      on_chunk(*std::move(chunk));
+      StartRead(&response);
+    }
+
+    void OnDone(const grpc::Status& status) override {
+      absl::Status lookup_status = decryption_status;
+      if (lookup_status.ok() && !status.ok()) {
+        LogUdfRequestErrorMetric(request_context.GetUdfRequestMetricsContext(),
+                                 kRemoteSecureLookupFailure);
+        LOG(ERROR) << status.error_code() << ": " << status.error_message();
+        lookup_status = absl::Status((absl::StatusCode)status.error_code(),
+                                     status.error_message());
+      }
+      auto on_done = std::move(this->on_done);
+      // The request context may be gone once `on_done` returns.
+      delete this;
+      std::move(on_done)(std::move(lookup_status));
+    }
+
+    const RequestContext& request_context;
+    ScopeLatencyMetricsRecorder<UdfRequestMetricsContext,
+                                kRemoteLookupGetValuesLatencyInMicros>
+        latency_recorder;
+    OhttpClientEncryptor encryptor;
+    grpc::ClientContext context;
+    SecureLookupRequest request;
+    SecureLookupResponse response;
+    absl::AnyInvocable<void(InternalLookupResponse)> on_chunk;
+    absl::AnyInvocable<void(absl::Status) &&> on_done;
+    absl::Status decryption_status;
+  };
+
+  // Pads and encrypts `serialized_message` into `request`, and sets the
+  // deadline of the request context, or the end of the timeout if that's
+  // sooner, on `context`.
+  absl::Status PrepareCall(const RequestContext& request_context,
+                           std::string_view serialized_message,
+                           int32_t padding_length,
+                           OhttpClientEncryptor& encryptor,
+                           SecureLookupRequest& request,
+                           grpc::ClientContext& context) const {
     auto encrypted_padded_serialized_request_maybe =
         encryptor.EncryptRequest(Pad(serialized_message, padding_length));
     if (!encrypted_padded_serialized_request_maybe.ok()) {
@@ -64,13 +263,65 @@ class RemoteLookupClientImpl : public RemoteLookupClient {
                                kRemoteRequestEncryptionFailure);
       return encrypted_padded_serialized_request_maybe.status();
     }
-    SecureLookupRequest secure_lookup_request;
-    secure_lookup_request.set_ohttp_request(
-        *encrypted_padded_serialized_request_maybe);
-    SecureLookupResponse secure_response;
-    grpc::ClientContext context;
-    grpc::Status status =
-        stub_->SecureLookup(&context, secure_lookup_request, &secure_response);
+    request.set_ohttp_request(
+        *std::move(encrypted_padded_serialized_request_maybe));
+    // Servers that don't compress responses ignore it.
+    request.set_accepted_response_compression(PAYLOAD_COMPRESSION_ZSTD);
+    absl::Time deadline = request_context.deadline();
+    if (timeout_ > absl::ZeroDuration()) {
+      deadline = std::min(deadline, absl::Now() + timeout_);
+    }
+    if (deadline != absl::InfiniteFuture()) {
+      context.set_deadline(absl::ToChronoTime(deadline));
+    }
+    return absl::OkStatus();
+  }
+
+  // Each channel has its own connection, since channels with the same
+  // arguments share their connections otherwise.
+  static std::vector<std::shared_ptr<grpc::Channel>> CreateChannels(
+      const std::string& ip_address, const RemoteLookupClientOptions& options) {
+    grpc::ChannelArguments channel_args;
+    channel_args.SetInt(GRPC_ARG_USE_LOCAL_SUBCHANNEL_POOL, 1);
+    if (options.keepalive_time > absl::ZeroDuration()) {
+      channel_args.SetInt(GRPC_ARG_KEEPALIVE_TIME_MS,
+                          absl::ToInt64Milliseconds(options.keepalive_time));
+      channel_args.SetInt(GRPC_ARG_KEEPALIVE_PERMIT_WITHOUT_CALLS, 1);
+    }
+    if (options.keepalive_timeout > absl::ZeroDuration()) {
+      channel_args.SetInt(GRPC_ARG_KEEPALIVE_TIMEOUT_MS,
+                          absl::ToInt64Milliseconds(options.keepalive_timeout));
+    }
+    if (options.initial_window_size_bytes > 0) {
+      channel_args.SetInt(GRPC_ARG_HTTP2_BDP_PROBE, 0);
+      channel_args.SetInt(GRPC_ARG_HTTP2_STREAM_LOOKAHEAD_BYTES,
+                          options.initial_window_size_bytes);
+    }
+    std::vector<std::shared_ptr<grpc::Channel>> channels;
+    for (int i = 0; i < std::max(options.num_channels, 1); i++) {
+      channels.push_back(grpc::CreateCustomChannel(
+          ip_address, grpc::InsecureChannelCredentials(), channel_args));
+    }
+    return channels;
+  }
+
+  static std::vector<std::unique_ptr<InternalLookupService::Stub>> CreateStubs(
+      const std::vector<std::shared_ptr<grpc::Channel>>& channels) {
+    std::vector<std::unique_ptr<InternalLookupService::Stub>> stubs;
+    for (const auto& channel : channels) {
+      stubs.push_back(InternalLookupService::NewStub(channel));
+    }
+    return stubs;
+  }
+
+  InternalLookupService::Stub& NextStub() const {
+    return *stubs_[next_stub_.fetch_add(1, std::memory_order_relaxed) %
+                   stubs_.size()];
+  }
+
+  static absl::StatusOr<InternalLookupResponse> ToInternalLookupResponse(
+      Call& call, const grpc::Status& status) {
+    const RequestContext& request_context = call.request_context;
     if (!status.ok()) {
       LogUdfRequestErrorMetric(request_context.GetUdfRequestMetricsContext(),
                                kRemoteSecureLookupFailure);
@@ -78,32 +329,57 @@ class RemoteLookupClientImpl : public RemoteLookupClient {
       return absl::Status((absl::StatusCode)status.error_code(),
                           status.error_message());
     }
+    return DecryptResponse(request_context, call.encryptor, call.response);
+  }
+
+  // Decrypts a response, or a chunk of a streamed one.
+  static absl::StatusOr<InternalLookupResponse> DecryptResponse(
+      const RequestContext& request_context, OhttpClientEncryptor& encryptor,
+      SecureLookupResponse& secure_response) {
     InternalLookupResponse response;
     if (secure_response.ohttp_response().empty()) {
       // we cannot decrypt an empty response. Note, that soon we will add logic
       // to pad responses, so this branch will never be hit.
       return response;
     }
-    auto decrypted_response_maybe =
-        encryptor.DecryptResponse(std::move(secure_response.ohttp_response()));
+    auto decrypted_response_maybe = encryptor.DecryptResponse(
+        std::move(*secure_response.mutable_ohttp_response()));
     if (!decrypted_response_maybe.ok()) {
       LogUdfRequestErrorMetric(request_context.GetUdfRequestMetricsContext(),
                                kResponseEncryptionFailure);
       return decrypted_response_maybe.status();
     }
+    if (secure_response.response_compression() == PAYLOAD_COMPRESSION_ZSTD) {
+      auto decompressed_response_maybe =
+          ResponseCodec().Decompress(*decrypted_response_maybe);
+      if (!decompressed_response_maybe.ok()) {
+        return decompressed_response_maybe.status();
+      }
+      decrypted_response_maybe = *std::move(decompressed_response_maybe);
+    }
     if (!response.ParseFromString(*decrypted_response_maybe)) {
       return absl::InvalidArgumentError("Failed parsing the response.");
     }
     return response;
   }
 
-  std::string_view GetIpAddress() const override { return ip_address_; }
+  // Decompresses the responses of all clients. The compression level doesn't
+  // matter for decompression.
+  static const ValueCodec& ResponseCodec() {
+    static const ValueCodec* const codec =
+        ValueCodec::Create(/*dictionary=*/"", /*level=*/1)->release();
+    return *codec;
+  }
 
- private:
   const std::string ip_address_;
-  std::unique_ptr<InternalLookupService::Stub> stub_;
+  // Empty for the clients created with their stubs.
+  const std::vector<std::shared_ptr<grpc::Channel>> channels_;
+  const std::vector<std::unique_ptr<InternalLookupService::Stub>> stubs_;
+  mutable std::atomic<uint64_t> next_stub_ = 0;
   privacy_sandbox::server_common::KeyFetcherManagerInterface&
       key_fetcher_manager_;
+  const bool stream_responses_ = false;
+  const absl::Duration timeout_;
 };
 
 }  // namespace
@@ -111,16 +387,28 @@ class RemoteLookupClientImpl : public RemoteLookupClient {
 std::unique_ptr<RemoteLookupClient> RemoteLookupClient::Create(
     std::string ip_address,
     privacy_sandbox::server_common::KeyFetcherManagerInterface&
-        key_fetcher_manager) {
-  return std::make_unique<RemoteLookupClientImpl>(std::move(ip_address),
-                                                  key_fetcher_manager);
+        key_fetcher_manager,
+    RemoteLookupClientOptions options) {
+  return std::make_unique<RemoteLookupClientImpl>(
+      std::move(ip_address), key_fetcher_manager, options);
 }
 std::unique_ptr<RemoteLookupClient> RemoteLookupClient::Create(
     std::unique_ptr<InternalLookupService::Stub> stub,
     privacy_sandbox::server_common::KeyFetcherManagerInterface&
-        key_fetcher_manager) {
-  return std::make_unique<RemoteLookupClientImpl>(std::move(stub),
-                                                  key_fetcher_manager);
+        key_fetcher_manager,
+    RemoteLookupClientOptions options) {
+  std::vector<std::unique_ptr<InternalLookupService::Stub>> stubs;
+  stubs.push_back(std::move(stub));
+  return std::make_unique<RemoteLookupClientImpl>(
+      std::move(stubs), key_fetcher_manager, options);
+}
+std::unique_ptr<RemoteLookupClient> RemoteLookupClient::Create(
+    std::vector<std::unique_ptr<InternalLookupService::Stub>> stubs,
+    privacy_sandbox::server_common::KeyFetcherManagerInterface&
+        key_fetcher_manager,
+    RemoteLookupClientOptions options) {
+  return std::make_unique<RemoteLookupClientImpl>(
+      std::move(stubs), key_fetcher_manager, options);
 }
 
 }  // namespace kv_server
@@ -12,7 +12,14 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/synchronization/notification.h"
 #include "components/data_server/cache/cache.h"
+#include "components/data_server/cache/data_version.h"
+#include "components/internal_server/lookup_response_cache.h"
 #include "components/internal_server/lookup_server_impl.h"
 #include "components/internal_server/mocks.h"
 #include "components/internal_server/remote_lookup_client.h"
@@ -101,6 +108,211 @@ TEST_F(RemoteLookupClientImplTest, EncryptedPaddedSuccessfulCall) {
   EXPECT_THAT(response, EqualsProto(expected));
 }
 
+TEST_F(RemoteLookupClientImplTest, AsyncCallsAreInFlightTogether) {
+  InternalLookupResponse local_lookup_response;
+  TextFormat::ParseFromString(R"pb(kv_pairs {
+                                     key: "key1"
+                                     value { value: "value1" }
+                                   }
+                              )pb",
+                              &local_lookup_response);
+  EXPECT_CALL(mock_lookup_, GetKeyValues(_, _))
+      .Times(3)
+      .WillRepeatedly(Return(local_lookup_response));
+  InternalLookupRequest request;
+  request.add_keys("key1");
+  const std::string serialized_message = request.SerializeAsString();
+  constexpr int kNumCalls = 3;
+  std::vector<absl::Notification> done(kNumCalls);
+  std::vector<absl::StatusOr<InternalLookupResponse>> responses(kNumCalls);
+  for (int i = 0; i < kNumCalls; ++i) {
+    remote_lookup_client_->GetValuesAsync(
+        GetRequestContext(), serialized_message, /*padding_length=*/0,
+        [&done, &responses, i](absl::StatusOr<InternalLookupResponse> result) {
+          responses[i] = std::move(result);
+          done[i].Notify();
+        });
+  }
+  for (int i = 0; i < kNumCalls; ++i) {
+    done[i].WaitForNotification();
+    ASSERT_TRUE(responses[i].ok()) << responses[i].status();
+    EXPECT_THAT(*responses[i], EqualsProto(local_lookup_response));
+  }
+}
+
+TEST_F(RemoteLookupClientImplTest, CallsAreSpreadOverAllChannels) {
+  InternalLookupResponse local_lookup_response;
+  TextFormat::ParseFromString(R"pb(kv_pairs {
+                                     key: "key1"
+                                     value { value: "value1" }
+                                   }
+                              )pb",
+                              &local_lookup_response);
+  constexpr int kNumChannels = 3;
+  constexpr int kNumCalls = 2 * kNumChannels;
+  EXPECT_CALL(mock_lookup_, GetKeyValues(_, _))
+      .Times(kNumCalls)
+      .WillRepeatedly(Return(local_lookup_response));
+  std::vector<std::unique_ptr<InternalLookupService::Stub>> stubs;
+  for (int i = 0; i < kNumChannels; ++i) {
+    stubs.push_back(InternalLookupService::NewStub(
+        server_->InProcessChannel(grpc::ChannelArguments())));
+  }
+  auto pooled_client =
+      RemoteLookupClient::Create(std::move(stubs), fake_key_fetcher_manager_);
+  InternalLookupRequest request;
+  request.add_keys("key1");
+  const std::string serialized_message = request.SerializeAsString();
+  for (int i = 0; i < kNumCalls; ++i) {
+    auto response_status = pooled_client->GetValues(
+        GetRequestContext(), serialized_message, /*padding_length=*/0);
+    ASSERT_TRUE(response_status.ok()) << response_status.status();
+    EXPECT_THAT(*response_status, EqualsProto(local_lookup_response));
+  }
+}
+
+TEST_F(RemoteLookupClientImplTest, CompressedResponseIsDecompressed) {
+  LookupServiceImpl compressing_lookup_service(
+      mock_lookup_, fake_key_fetcher_manager_, /*coalesce_lookups=*/false,
+      /*compression_min_bytes=*/1);
+  grpc::ServerBuilder builder;
+  builder.RegisterService(&compressing_lookup_service);
+  auto compressing_server = builder.BuildAndStart();
+  auto client = RemoteLookupClient::Create(
+      InternalLookupService::NewStub(
+          compressing_server->InProcessChannel(grpc::ChannelArguments())),
+      fake_key_fetcher_manager_);
+  InternalLookupResponse local_lookup_response;
+  TextFormat::ParseFromString(R"pb(kv_pairs {
+                                     key: "key1"
+                                     value {
+                                       value: "valuevaluevaluevaluevaluevalue"
+                                     }
+                                   }
+                              )pb",
+                              &local_lookup_response);
+  EXPECT_CALL(mock_lookup_, GetKeyValues(_, _))
+      .WillOnce(Return(local_lookup_response));
+  InternalLookupRequest request;
+  request.add_keys("key1");
+  auto response_status = client->GetValues(
+      GetRequestContext(), request.SerializeAsString(), /*padding_length=*/0);
+  ASSERT_TRUE(response_status.ok()) << response_status.status();
+  EXPECT_THAT(*response_status, EqualsProto(local_lookup_response));
+  compressing_server->Shutdown();
+  compressing_server->Wait();
+}
+
+TEST_F(RemoteLookupClientImplTest, CachedResponseIsServedUntilDataChanges) {
+  DataVersion data_version;
+  LookupResponseCache response_cache({.max_entries = 10}, data_version);
+  LookupServiceImpl caching_lookup_service(
+      mock_lookup_, fake_key_fetcher_manager_, /*coalesce_lookups=*/false,
+      /*compression_min_bytes=*/0, kDefaultLookupStreamChunkMaxValues,
+      &response_cache);
+  grpc::ServerBuilder builder;
+  builder.RegisterService(&caching_lookup_service);
+  auto caching_server = builder.BuildAndStart();
+  auto client = RemoteLookupClient::Create(
+      InternalLookupService::NewStub(
+          caching_server->InProcessChannel(grpc::ChannelArguments())),
+      fake_key_fetcher_manager_);
+  InternalLookupResponse local_lookup_response;
+  (*local_lookup_response.mutable_kv_pairs())["key1"].set_value("value1");
+  EXPECT_CALL(mock_lookup_, GetKeyValues(_, _))
+      .Times(2)
+      .WillRepeatedly(Return(local_lookup_response));
+  InternalLookupRequest request;
+  request.add_keys("key1");
+  const std::string serialized_message = request.SerializeAsString();
+  // The second lookup is served from the cache, the third after the data
+  // changed is looked up again.
+  for (int i = 0; i < 3; ++i) {
+    if (i == 2) {
+      data_version.Advance();
+    }
+    auto response_status = client->GetValues(
+        GetRequestContext(), serialized_message, /*padding_length=*/i);
+    ASSERT_TRUE(response_status.ok()) << response_status.status();
+    EXPECT_THAT(*response_status, EqualsProto(local_lookup_response));
+  }
+  EXPECT_EQ(response_cache.num_hits(), 1);
+  caching_server->Shutdown();
+  caching_server->Wait();
+}
+
+TEST_F(RemoteLookupClientImplTest, StreamedKeySetIsSplitIntoChunks) {
+  LookupServiceImpl streaming_lookup_service(
+      mock_lookup_, fake_key_fetcher_manager_, /*coalesce_lookups=*/false,
+      /*compression_min_bytes=*/0, /*stream_chunk_max_values=*/2);
+  grpc::ServerBuilder builder;
+  builder.RegisterService(&streaming_lookup_service);
+  auto streaming_server = builder.BuildAndStart();
+  auto client = RemoteLookupClient::Create(
+      InternalLookupService::NewStub(
+          streaming_server->InProcessChannel(grpc::ChannelArguments())),
+      fake_key_fetcher_manager_, {.stream_responses = true});
+  InternalLookupResponse local_lookup_response;
+  TextFormat::ParseFromString(
+      R"pb(kv_pairs {
+             key: "key1"
+             value {
+               keyset_values {
+                 values: "value1"
+                 values: "value2"
+                 values: "value3"
+                 values: "value4"
+                 values: "value5"
+               }
+             }
+           }
+      )pb",
+      &local_lookup_response);
+  EXPECT_CALL(mock_lookup_, GetKeyValueSet(_, _))
+      .WillOnce(Return(local_lookup_response));
+  InternalLookupRequest request;
+  request.add_keys("key1");
+  request.set_lookup_sets(true);
+  std::vector<InternalLookupResponse> chunks;
+  absl::Status status;
+  absl::Notification done;
+  client->GetValuesStreamAsync(
+      GetRequestContext(), request.SerializeAsString(), /*padding_length=*/0,
+      [&chunks](InternalLookupResponse chunk) {
+        chunks.push_back(std::move(chunk));
+      },
+      [&status, &done](absl::Status result) {
+        status = std::move(result);
+        done.Notify();
+      });
+  done.WaitForNotification();
+  ASSERT_TRUE(status.ok()) << status;
+  EXPECT_GE(chunks.size(), 3);
+  std::vector<std::string> resulting_set;
+  for (auto& chunk : chunks) {
+    for (auto& value : *(*chunk.mutable_kv_pairs())["key1"]
+                            .mutable_keyset_values()
+                            ->mutable_values()) {
+      resulting_set.push_back(std::move(value));
+    }
+  }
+  EXPECT_THAT(resulting_set,
+              testing::UnorderedElementsAre("value1", "value2", "value3",
+                                            "value4", "value5"));
+  streaming_server->Shutdown();
+  streaming_server->Wait();
+}
+
+TEST_F(RemoteLookupClientImplTest, CancelledRequestIsNotSent) {
+  InternalLookupRequest request;
+  request.add_keys("key1");
+  EXPECT_CALL(mock_lookup_, GetKeyValues(_, _)).Times(0);
+  GetRequestContext().EndCall();
+  auto response_status = remote_lookup_client_->GetValues(
+      GetRequestContext(), request.SerializeAsString(), /*padding_length=*/0);
+  EXPECT_EQ(response_status.status().code(), absl::StatusCode::kCancelled);
+}
+
 TEST_F(RemoteLookupClientImplTest, EncryptedPaddedEmptySuccessfulCall) {
   std::vector<std::string> keys = {};
   InternalLookupRequest request;
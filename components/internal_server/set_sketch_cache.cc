@@ -0,0 +1,62 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/internal_server/set_sketch_cache.h"
+
+#include <memory>
+#include <utility>
+
+namespace kv_server {
+
+SetSketchCache::SetSketchCache(int max_sketches)
+    : max_sketches_(max_sketches) {}
+
+std::shared_ptr<const SetSketch> SetSketchCache::Get(
+    std::string_view key, uint64_t version,
+    absl::FunctionRef<SetSketch()> build_fn, bool* is_hit) {
+  if (max_sketches_ > 0) {
+    absl::MutexLock lock(&mutex_);
+    if (const auto it = index_.find(key);
+        it != index_.end() && it->second->version == version) {
+      entries_.splice(entries_.begin(), entries_, it->second);
+      if (is_hit != nullptr) *is_hit = true;
+      return entries_.front().sketch;
+    }
+  }
+  if (is_hit != nullptr) *is_hit = false;
+  // Built without the lock, sets can be large.
+  auto sketch = std::make_shared<const SetSketch>(build_fn());
+  if (max_sketches_ == 0) {
+    return sketch;
+  }
+  absl::MutexLock lock(&mutex_);
+  if (const auto it = index_.find(key); it != index_.end()) {
+    // Kept by a concurrent lookup of another version, or stale.
+    const auto entry_it = it->second;
+    index_.erase(it);
+    entries_.erase(entry_it);
+  }
+  entries_.push_front(
+      Entry{.key = std::string(key), .version = version, .sketch = sketch});
+  index_.emplace(entries_.front().key, entries_.begin());
+  if (static_cast<int>(entries_.size()) > max_sketches_) {
+    index_.erase(entries_.back().key);
+    entries_.pop_back();
+  }
+  return sketch;
+}
+
+}  // namespace kv_server
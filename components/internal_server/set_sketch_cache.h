@@ -0,0 +1,76 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_INTERNAL_SERVER_SET_SKETCH_CACHE_H_
+#define COMPONENTS_INTERNAL_SERVER_SET_SKETCH_CACHE_H_
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/functional/function_ref.h"
+#include "absl/synchronization/mutex.h"
+#include "components/query/set_sketch.h"
+
+namespace kv_server {
+
+// Keeps the sketches of the most recently estimated sets, by key, with the
+// versions of the sets that they were built from, so that sets are only
+// scanned to build their sketch once per version.
+//
+// Sketches can't forget deleted members, so a mutated set, whose version
+// changes, has its sketch built again the next time it is estimated.
+//
+// Thread-safe.
+class SetSketchCache {
+ public:
+  // Keeps at most `max_sketches` sketches, of about 4KB each. 0 disables the
+  // cache.
+  explicit SetSketchCache(int max_sketches);
+  SetSketchCache(const SetSketchCache&) = delete;
+  SetSketchCache& operator=(const SetSketchCache&) = delete;
+
+  bool enabled() const { return max_sketches_ > 0; }
+
+  // Returns the sketch of the set of `key` at `version`, built with
+  // `build_fn` unless it is kept. `is_hit` is set to whether it was kept.
+  std::shared_ptr<const SetSketch> Get(std::string_view key, uint64_t version,
+                                       absl::FunctionRef<SetSketch()> build_fn,
+                                       bool* is_hit = nullptr)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  struct Entry {
+    std::string key;
+    uint64_t version;
+    std::shared_ptr<const SetSketch> sketch;
+  };
+
+  const int max_sketches_;
+  absl::Mutex mutex_;
+  // Most recently used first.
+  std::list<Entry> entries_ ABSL_GUARDED_BY(mutex_);
+  // Views of the keys of `entries_`.
+  absl::flat_hash_map<std::string_view, std::list<Entry>::iterator> index_
+      ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_INTERNAL_SERVER_SET_SKETCH_CACHE_H_
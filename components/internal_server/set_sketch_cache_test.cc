@@ -0,0 +1,90 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/internal_server/set_sketch_cache.h"
+
+#include <memory>
+#include <string>
+
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+SetSketch Sketch(int num_members) {
+  SetSketch sketch;
+  for (int i = 0; i < num_members; ++i) {
+    sketch.Add(std::to_string(i));
+  }
+  return sketch;
+}
+
+TEST(SetSketchCacheTest, Disabled) {
+  SetSketchCache cache(/*max_sketches=*/0);
+  EXPECT_FALSE(cache.enabled());
+  int num_builds = 0;
+  const auto build = [&num_builds] {
+    ++num_builds;
+    return Sketch(10);
+  };
+  bool is_hit = true;
+  EXPECT_NEAR(cache.Get("A", 1, build, &is_hit)->Estimate(), 10, 1);
+  EXPECT_FALSE(is_hit);
+  cache.Get("A", 1, build);
+  EXPECT_EQ(num_builds, 2);
+}
+
+TEST(SetSketchCacheTest, BuildsOncePerVersion) {
+  SetSketchCache cache(/*max_sketches=*/10);
+  int num_builds = 0;
+  int num_members = 10;
+  const auto build = [&num_builds, &num_members] {
+    ++num_builds;
+    return Sketch(num_members);
+  };
+  bool is_hit = true;
+  cache.Get("A", 1, build, &is_hit);
+  EXPECT_FALSE(is_hit);
+  EXPECT_NEAR(cache.Get("A", 1, build, &is_hit)->Estimate(), 10, 1);
+  EXPECT_TRUE(is_hit);
+  EXPECT_EQ(num_builds, 1);
+
+  // The set changed.
+  num_members = 20;
+  EXPECT_NEAR(cache.Get("A", 2, build, &is_hit)->Estimate(), 20, 1);
+  EXPECT_FALSE(is_hit);
+  cache.Get("A", 2, build, &is_hit);
+  EXPECT_TRUE(is_hit);
+  EXPECT_EQ(num_builds, 2);
+}
+
+TEST(SetSketchCacheTest, EvictsLeastRecentlyUsed) {
+  SetSketchCache cache(/*max_sketches=*/2);
+  const auto build = [] { return Sketch(1); };
+  cache.Get("A", 1, build);
+  cache.Get("B", 1, build);
+  cache.Get("A", 1, build);
+  cache.Get("C", 1, build);
+
+  bool is_hit = false;
+  cache.Get("A", 1, build, &is_hit);
+  EXPECT_TRUE(is_hit);
+  cache.Get("B", 1, build, &is_hit);
+  EXPECT_FALSE(is_hit);
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -0,0 +1,79 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/internal_server/shard_circuit_breaker.h"
+
+namespace kv_server {
+
+ShardCircuitBreaker::ShardCircuitBreaker(int num_shards, Options options)
+    : options_(options),
+      shard_states_(std::make_unique<ShardState[]>(num_shards)) {}
+
+ShardCircuitBreaker::Admission ShardCircuitBreaker::Admit(int shard_num,
+                                                         absl::Time now) {
+  if (!enabled()) {
+    return Admission::kSent;
+  }
+  ShardState& state = shard_states_[shard_num];
+  absl::MutexLock lock(&state.mutex);
+  if (state.consecutive_failures < options_.failure_threshold) {
+    return Admission::kSent;
+  }
+  if (now < state.open_until || state.probing) {
+    return Admission::kRejected;
+  }
+  state.probing = true;
+  return Admission::kProbe;
+}
+
+bool ShardCircuitBreaker::Record(int shard_num, Admission admission,
+                                 const absl::Status& status, absl::Time now) {
+  if (!enabled()) {
+    return false;
+  }
+  ShardState& state = shard_states_[shard_num];
+  absl::MutexLock lock(&state.mutex);
+  const bool probe = admission == Admission::kProbe;
+  if (probe) {
+    state.probing = false;
+  }
+  if (absl::IsCancelled(status)) {
+    return false;
+  }
+  if (status.ok()) {
+    state.consecutive_failures = 0;
+    return false;
+  }
+  ++state.consecutive_failures;
+  // Lookups that were already in flight when the shard tripped don't keep it
+  // stopped for longer, only a failed probe does.
+  if (probe || state.consecutive_failures == options_.failure_threshold) {
+    state.open_until = now + options_.open_duration;
+    return true;
+  }
+  return false;
+}
+
+bool ShardCircuitBreaker::IsOpen(int shard_num) const {
+  if (!enabled()) {
+    return false;
+  }
+  const ShardState& state = shard_states_[shard_num];
+  absl::MutexLock lock(&state.mutex);
+  return state.consecutive_failures >= options_.failure_threshold;
+}
+
+}  // namespace kv_server
@@ -0,0 +1,90 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_INTERNAL_SERVER_SHARD_CIRCUIT_BREAKER_H_
+#define COMPONENTS_INTERNAL_SERVER_SHARD_CIRCUIT_BREAKER_H_
+
+#include <memory>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/status/status.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+
+namespace kv_server {
+
+// Fails the lookups of a shard right away, without sending them, once its
+// last `failure_threshold` lookups failed, so that a shard that is down or
+// overloaded doesn't hold up every request until its lookups time out. After
+// `open_duration`, a single lookup is sent to probe the shard, and the shard
+// is sent lookups again once one succeeds.
+//
+// Thread-safe.
+class ShardCircuitBreaker {
+ public:
+  struct Options {
+    // Consecutive failed lookups of a shard that stop its lookups. 0 disables
+    // the breaker.
+    int failure_threshold = 0;
+    // How long the lookups of a shard fail before it's probed.
+    absl::Duration open_duration = absl::Seconds(1);
+  };
+
+  ShardCircuitBreaker(int num_shards, Options options);
+  ShardCircuitBreaker(const ShardCircuitBreaker&) = delete;
+  ShardCircuitBreaker& operator=(const ShardCircuitBreaker&) = delete;
+
+  bool enabled() const { return options_.failure_threshold > 0; }
+
+  enum class Admission {
+    // The lookup fails without being sent.
+    kRejected,
+    kSent,
+    // The lookup is sent to find out whether the shard has recovered.
+    kProbe,
+  };
+
+  // Whether a lookup may be sent to `shard_num`. A lookup that is sent must
+  // be followed by `Record` with its status.
+  Admission Admit(int shard_num, absl::Time now = absl::Now());
+
+  // Counts the result of a lookup sent to `shard_num`, a probe if `Admit`
+  // said so. Cancelled lookups, which their requests gave up on, don't count.
+  // Returns whether the result stopped the lookups of the shard.
+  bool Record(int shard_num, Admission admission, const absl::Status& status,
+              absl::Time now = absl::Now());
+
+  // Whether the lookups of `shard_num` are being failed.
+  bool IsOpen(int shard_num) const;
+
+ private:
+  struct ShardState {
+    mutable absl::Mutex mutex;
+    int consecutive_failures ABSL_GUARDED_BY(mutex) = 0;
+    // Lookups fail until then once the shard tripped the breaker.
+    absl::Time open_until ABSL_GUARDED_BY(mutex) = absl::InfinitePast();
+    // A lookup was let through to probe the shard, and hasn't finished.
+    bool probing ABSL_GUARDED_BY(mutex) = false;
+  };
+
+  const Options options_;
+  std::unique_ptr<ShardState[]> shard_states_;
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_INTERNAL_SERVER_SHARD_CIRCUIT_BREAKER_H_
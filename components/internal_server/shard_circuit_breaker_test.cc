@@ -0,0 +1,90 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/internal_server/shard_circuit_breaker.h"
+
+#include "absl/status/status.h"
+#include "absl/time/time.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+using Admission = ShardCircuitBreaker::Admission;
+
+const absl::Time kStart = absl::FromUnixSeconds(1000);
+
+TEST(ShardCircuitBreakerTest, FailuresStopLookupsOfTheShard) {
+  ShardCircuitBreaker breaker(
+      2, {.failure_threshold = 2, .open_duration = absl::Seconds(1)});
+  EXPECT_FALSE(breaker.Record(1, Admission::kSent,
+                              absl::UnavailableError("down"), kStart));
+  EXPECT_EQ(breaker.Admit(1, kStart), Admission::kSent);
+  EXPECT_TRUE(breaker.Record(1, Admission::kSent,
+                             absl::DeadlineExceededError("slow"), kStart));
+  EXPECT_TRUE(breaker.IsOpen(1));
+  EXPECT_EQ(breaker.Admit(1, kStart), Admission::kRejected);
+  // Other shards are unaffected.
+  EXPECT_EQ(breaker.Admit(0, kStart), Admission::kSent);
+}
+
+TEST(ShardCircuitBreakerTest, SuccessResetsFailures) {
+  ShardCircuitBreaker breaker(1, {.failure_threshold = 2});
+  breaker.Record(0, Admission::kSent, absl::UnavailableError("down"), kStart);
+  breaker.Record(0, Admission::kSent, absl::OkStatus(), kStart);
+  breaker.Record(0, Admission::kSent, absl::UnavailableError("down"), kStart);
+  EXPECT_FALSE(breaker.IsOpen(0));
+}
+
+TEST(ShardCircuitBreakerTest, CancelledLookupsDontCount) {
+  ShardCircuitBreaker breaker(1, {.failure_threshold = 1});
+  EXPECT_FALSE(breaker.Record(0, Admission::kSent,
+                              absl::CancelledError("gave up"), kStart));
+  EXPECT_FALSE(breaker.IsOpen(0));
+}
+
+TEST(ShardCircuitBreakerTest, SingleProbeAfterOpenDuration) {
+  ShardCircuitBreaker breaker(
+      1, {.failure_threshold = 1, .open_duration = absl::Seconds(1)});
+  breaker.Record(0, Admission::kSent, absl::UnavailableError("down"), kStart);
+  const absl::Time later = kStart + absl::Seconds(2);
+  EXPECT_EQ(breaker.Admit(0, later), Admission::kProbe);
+  EXPECT_EQ(breaker.Admit(0, later), Admission::kRejected);
+  // A failed probe stops the lookups for another `open_duration`.
+  EXPECT_TRUE(breaker.Record(0, Admission::kProbe,
+                             absl::UnavailableError("down"), later));
+  EXPECT_EQ(breaker.Admit(0, later + absl::Milliseconds(500)),
+            Admission::kRejected);
+  const absl::Time even_later = later + absl::Seconds(2);
+  EXPECT_EQ(breaker.Admit(0, even_later), Admission::kProbe);
+  EXPECT_FALSE(breaker.Record(0, Admission::kProbe, absl::OkStatus(),
+                              even_later));
+  EXPECT_FALSE(breaker.IsOpen(0));
+  EXPECT_EQ(breaker.Admit(0, even_later), Admission::kSent);
+}
+
+TEST(ShardCircuitBreakerTest, DisabledBreakerSendsEverything) {
+  ShardCircuitBreaker breaker(1, {});
+  EXPECT_FALSE(breaker.enabled());
+  for (int i = 0; i < 10; ++i) {
+    breaker.Record(0, Admission::kSent, absl::UnavailableError("down"),
+                   kStart);
+  }
+  EXPECT_EQ(breaker.Admit(0, kStart), Admission::kSent);
+}
+
+}  // namespace
+}  // namespace kv_server
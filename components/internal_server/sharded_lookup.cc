@@ -14,22 +14,36 @@
 #include "components/internal_server/sharded_lookup.h"
 
 #include <algorithm>
-#include <future>
+#include <cstdint>
+#include <iterator>
 #include <memory>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <utility>
 #include <vector>
 
+#include "absl/functional/function_ref.h"
 #include "absl/log/check.h"
 #include "absl/log/log.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "components/internal_server/hot_key_cache.h"
+#include "components/internal_server/local_lookup.h"
 #include "components/internal_server/lookup.h"
 #include "components/internal_server/lookup.pb.h"
 #include "components/internal_server/remote_lookup_client.h"
+#include "components/query/ast.h"
 #include "components/query/driver.h"
-#include "components/query/scanner.h"
+#include "components/query/query_cache.h"
 #include "components/sharding/shard_manager.h"
+#include "components/util/hashed_key.h"
 #include "components/util/request_context.h"
+#include "components/util/request_tracing.h"
+#include "components/util/thread_pool.h"
 #include "pir/hashing/sha256_hash_family.h"
 
 namespace kv_server {
@@ -55,6 +69,26 @@ void UpdateResponse(
   }
 }
 
+// Same as above, for responses shared with other lookups, whose results are
+// copied rather than moved.
+void UpdateResponse(
+    const std::vector<std::string_view>& key_list,
+    const ::google::protobuf::Map<std::string, ::kv_server::SingleLookupResult>&
+        kv_pairs,
+    InternalLookupResponse& response) {
+  for (const auto& key : key_list) {
+    const auto key_iter = kv_pairs.find(key);
+    if (key_iter == kv_pairs.end()) {
+      SingleLookupResult result;
+      auto status = result.mutable_status();
+      status->set_code(static_cast<int>(absl::StatusCode::kNotFound));
+      (*response.mutable_kv_pairs())[key] = std::move(result);
+    } else {
+      (*response.mutable_kv_pairs())[key] = key_iter->second;
+    }
+  }
+}
+
 void SetRequestFailed(const std::vector<std::string_view>& key_list,
                       InternalLookupResponse& response) {
   SingleLookupResult result;
@@ -67,26 +101,89 @@ void SetRequestFailed(const std::vector<std::string_view>& key_list,
   LOG(ERROR) << "Sharded lookup failed:" << response.DebugString();
 }
 
+// Latencies of the remote lookups to each shard since they were last reported
+// by `GetRemoteLookupLatenciesByShardInMicros`.
+struct RemoteLookupLatencies {
+  struct Sum {
+    absl::Duration total;
+    int64_t count = 0;
+  };
+  absl::Mutex mutex;
+  absl::flat_hash_map<int32_t, Sum> by_shard ABSL_GUARDED_BY(mutex);
+};
+
+RemoteLookupLatencies& GetRemoteLookupLatencies() {
+  static auto* const latencies = new RemoteLookupLatencies();
+  return *latencies;
+}
+
+void RecordRemoteLookupLatency(int32_t shard_num, absl::Duration latency) {
+  RemoteLookupLatencies& latencies = GetRemoteLookupLatencies();
+  absl::MutexLock lock(&latencies.mutex);
+  RemoteLookupLatencies::Sum& sum = latencies.by_shard[shard_num];
+  sum.total += latency;
+  ++sum.count;
+}
+
+// Asks `circuit_breaker`, if there is one, whether a lookup of `shard_num` is
+// sent.
+ShardCircuitBreaker::Admission AdmitShardLookup(
+    ShardCircuitBreaker* circuit_breaker, int32_t shard_num) {
+  if (circuit_breaker == nullptr) {
+    return ShardCircuitBreaker::Admission::kSent;
+  }
+  const auto admission = circuit_breaker->Admit(shard_num);
+  if (admission == ShardCircuitBreaker::Admission::kRejected) {
+    LogShardCircuitBreakerEvent(kShardCircuitBreakerRejected);
+  } else if (admission == ShardCircuitBreaker::Admission::kProbe) {
+    LogShardCircuitBreakerEvent(kShardCircuitBreakerProbe);
+  }
+  return admission;
+}
+
+void RecordShardLookup(ShardCircuitBreaker* circuit_breaker, int32_t shard_num,
+                       ShardCircuitBreaker::Admission admission,
+                       const absl::Status& status) {
+  if (circuit_breaker != nullptr &&
+      circuit_breaker->Record(shard_num, admission, status)) {
+    LogShardCircuitBreakerEvent(kShardCircuitBreakerTripped);
+  }
+}
+
+absl::Status ShardCircuitOpenError() {
+  return absl::UnavailableError(
+      "Lookups of the shard are failing, it isn't sent any for now.");
+}
+
 class ShardedLookup : public Lookup {
  public:
   explicit ShardedLookup(const Lookup& local_lookup, const int32_t num_shards,
                          const int32_t current_shard_num,
                          const ShardManager& shard_manager,
-                         KeySharder key_sharder)
+                         KeySharder key_sharder,
+                         std::shared_ptr<HotKeyCache> hot_key_cache,
+                         KeyLookupBatchingOptions batching_options,
+                         RequestPaddingOptions padding_options,
+                         ShardFailureOptions failure_options)
       : local_lookup_(local_lookup),
         num_shards_(num_shards),
         current_shard_num_(current_shard_num),
         shard_manager_(shard_manager),
-        key_sharder_(std::move(key_sharder)) {
-    CHECK_GT(num_shards, 1) << "num_shards for ShardedLookup must be > 1";
+        key_sharder_(std::move(key_sharder)),
+        hot_key_cache_(std::move(hot_key_cache)),
+        batching_options_(batching_options),
+        padding_options_(padding_options),
+        failure_options_(std::move(failure_options)) {
+    CHECK(num_shards > 1 || current_shard_num == kNoLocalShard)
+        << "num_shards for ShardedLookup must be > 1";
   }
 
   // Iterates over all keys specified in the `request` and assigns them to shard
-  // buckets. Then for each bucket it queries the underlying data shard. At the
-  // moment, for the shard number matching the current server shard number, the
-  // logic will lookup data in its own cache. Eventually, this will change when
-  // we have two types of servers: UDF and data servers. Then the responses are
-  // combined and the result is returned. If any underlying request fails -- we
+  // buckets. Then for each bucket it queries the underlying data shard. For
+  // the shard number matching the current server shard number, the logic will
+  // lookup data in its own cache, unless the server only runs UDFs and has no
+  // shard of its own. Then the responses are combined and the result is
+  // returned. If any underlying request fails -- we
   // return an empty response and `Internal` error as the status for the gRPC
   // status code.
   absl::StatusOr<InternalLookupResponse> GetKeyValues(
@@ -109,8 +206,10 @@ class ShardedLookup : public Lookup {
       return response;
     }
     absl::flat_hash_map<std::string, absl::flat_hash_set<std::string>> key_sets;
-    auto get_key_value_set_result_maybe =
-        GetShardedKeyValueSet(request_context, keys);
+    std::vector<std::string_view> failed_keys;
+    auto get_key_value_set_result_maybe = GetShardedKeyValueSet(
+        request_context, keys,
+        failure_options_.partial_key_sets ? &failed_keys : nullptr);
     if (!get_key_value_set_result_maybe.ok()) {
       LogUdfRequestErrorMetric(request_context.GetUdfRequestMetricsContext(),
                                kShardedGetKeyValueSetKeySetRetrievalFailure);
@@ -133,6 +232,77 @@ class ShardedLookup : public Lookup {
       }
       (*response.mutable_kv_pairs())[key] = std::move(result);
     }
+    if (!failed_keys.empty()) {
+      SetRequestFailed(failed_keys, response);
+    }
+    return response;
+  }
+
+  // Sends each shard a single request for both its values and its sets,
+  // instead of fanning out once for the values and once for the sets. The
+  // lookup isn't batched with the lookups of other requests, and its sets
+  // aren't streamed. A shard that fails fails the values of its keys, and
+  // the whole lookup if it had sets to look up, unless partial key sets are
+  // returned.
+  absl::StatusOr<InternalLookupResponse> GetKeyValuesAndSets(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& keys,
+      const absl::flat_hash_set<std::string_view>& set_keys) const override {
+    if (set_keys.empty()) {
+      return GetKeyValues(request_context, keys);
+    }
+    if (keys.empty()) {
+      return GetKeyValueSet(request_context, set_keys);
+    }
+    // A key in both would have a single result in the response of its shard.
+    if (std::any_of(
+            set_keys.begin(), set_keys.end(),
+            [&keys](std::string_view key) { return keys.contains(key); })) {
+      return Lookup::GetKeyValuesAndSets(request_context, keys, set_keys);
+    }
+    InternalLookupResponse response;
+    const bool use_hot_key_cache =
+        hot_key_cache_ != nullptr && hot_key_cache_->enabled();
+    auto shard_lookup_inputs =
+        BucketKeys(keys, use_hot_key_cache ? &response : nullptr);
+    BucketSetKeys(set_keys, shard_lookup_inputs);
+    SerializeShardedRequests(shard_lookup_inputs, /*lookup_sets=*/false,
+                             request_context.TraceParent());
+    ComputePadding(shard_lookup_inputs);
+    auto responses = GetLookupFutures(
+        request_context, shard_lookup_inputs,
+        [this, &request_context](const ShardLookupInput& shard_lookup_input) {
+          return GetLocalKeyValuesAndSets(request_context, shard_lookup_input);
+        });
+    if (!responses.ok()) {
+      return responses.status();
+    }
+    for (int shard_num = 0; shard_num < num_shards_; shard_num++) {
+      const auto& shard_lookup_input = shard_lookup_inputs[shard_num];
+      auto result = (*responses)[shard_num].Get();
+      if (!result.ok()) {
+        LogUdfRequestErrorMetric(request_context.GetUdfRequestMetricsContext(),
+                                 kShardedKeyValueRequestFailure);
+        if (!shard_lookup_input.set_keys.empty() &&
+            !failure_options_.partial_key_sets) {
+          return result.status();
+        }
+        SetRequestFailed(shard_lookup_input.keys, response);
+        SetRequestFailed(shard_lookup_input.set_keys, response);
+        continue;
+      }
+      auto& kv_pairs = *result->mutable_kv_pairs();
+      if (use_hot_key_cache && shard_num != current_shard_num_) {
+        for (const auto& key : shard_lookup_input.keys) {
+          if (const auto key_iter = kv_pairs.find(key);
+              key_iter != kv_pairs.end()) {
+            hot_key_cache_->MaybeAdd(key, key_iter->second);
+          }
+        }
+      }
+      UpdateResponse(shard_lookup_input.keys, kv_pairs, response);
+      UpdateResponse(shard_lookup_input.set_keys, kv_pairs, response);
+    }
     return response;
   }
 
@@ -148,52 +318,71 @@ class ShardedLookup : public Lookup {
       return response;
     }
 
-    absl::flat_hash_map<std::string, absl::flat_hash_set<std::string>> keysets;
-    kv_server::Driver driver([&keysets, this,
-                              &request_context](std::string_view key) {
-      const auto key_iter = keysets.find(key);
-      if (key_iter == keysets.end()) {
-        VLOG(8) << "Driver can't find " << key << "key_set. Returning empty.";
-        LogUdfRequestErrorMetric(request_context.GetUdfRequestMetricsContext(),
-                                 kShardedRunQueryMissingKeySet);
-        absl::flat_hash_set<std::string_view> set;
-        return set;
-      } else {
-        absl::flat_hash_set<std::string_view> set(key_iter->second.begin(),
-                                                  key_iter->second.end());
-        return set;
-      }
-    });
-    std::istringstream stream(query);
-    kv_server::Scanner scanner(stream);
-    kv_server::Parser parse(driver, scanner);
-    int parse_result = parse();
-    if (parse_result) {
+    bool is_hit = false;
+    const auto driver = query_cache_.Parse(query, &is_hit);
+    LogIfError(request_context.GetInternalLookupMetricsContext()
+                   .AccumulateMetric<kCacheAccessEventCount>(
+                       1, is_hit ? kQueryCacheHit : kQueryCacheMiss));
+    if (!driver.ok()) {
       LogUdfRequestErrorMetric(request_context.GetUdfRequestMetricsContext(),
                                kShardedRunQueryParsingFailure);
-      return absl::InvalidArgumentError("Parsing failure.");
-    }
-    auto get_key_value_set_result_maybe =
-        GetShardedKeyValueSet(request_context, driver.GetRootNode()->Keys());
-    if (!get_key_value_set_result_maybe.ok()) {
-      LogUdfRequestErrorMetric(request_context.GetUdfRequestMetricsContext(),
-                               kShardedRunQueryKeySetRetrievalFailure);
-      return get_key_value_set_result_maybe.status();
+      return driver.status();
     }
-    keysets = std::move(*get_key_value_set_result_maybe);
-    auto result = driver.GetResult();
+    auto result = RunPushedDownQuery(request_context, *(*driver)->GetRootNode(),
+                                     (*driver)->GetResultOptions());
     if (!result.ok()) {
       LogUdfRequestErrorMetric(request_context.GetUdfRequestMetricsContext(),
                                kShardedRunQueryFailure);
       return result.status();
     }
-    VLOG(8) << "Driver results for query " << query;
-    for (const auto& value : *result) {
+    VLOG(8) << "Sharded results for query " << query;
+    for (const auto& value : result->elements()) {
       VLOG(8) << "Value: " << value << "\n";
     }
+    return result;
+  }
 
-    response.mutable_elements()->Assign(result->begin(), result->end());
-    return response;
+  // Queries whose sets are all on this shard are estimated from the sketches
+  // of the local lookup. The others are run and counted, since the sketches of
+  // remote sets aren't shared.
+  absl::StatusOr<int64_t> ApproxCardinality(
+      const RequestContext& request_context, std::string query) const override {
+    if (query.empty() || current_shard_num_ == kNoLocalShard) {
+      return Lookup::ApproxCardinality(request_context, std::move(query));
+    }
+    const auto driver = query_cache_.Parse(query);
+    if (!driver.ok()) {
+      return driver.status();
+    }
+    const auto keys = (*driver)->GetRootNode()->Keys();
+    const std::vector<std::string_view> key_list(keys.begin(), keys.end());
+    if (key_sharder_.GetSingleShardForKeys(key_list, num_shards_) ==
+        current_shard_num_) {
+      return local_lookup_.ApproxCardinality(request_context,
+                                             std::move(query));
+    }
+    return Lookup::ApproxCardinality(request_context, std::move(query));
+  }
+
+  // Profiles the lookups of the shards and the operations applied over their
+  // results here. The steps of the queries pushed down to the shards aren't
+  // profiled.
+  absl::StatusOr<InternalRunQueryResponse> ProfileQuery(
+      const RequestContext& request_context, std::string query) const override {
+    if (query.empty()) {
+      return InternalRunQueryResponse();
+    }
+    const auto driver = query_cache_.Parse(query);
+    if (!driver.ok()) {
+      return driver.status();
+    }
+    std::string profile;
+    auto result = RunPushedDownQuery(request_context, *(*driver)->GetRootNode(),
+                                     (*driver)->GetResultOptions(), &profile);
+    if (result.ok()) {
+      result->set_query_profile(std::move(profile));
+    }
+    return result;
   }
 
  private:
@@ -201,69 +390,188 @@ class ShardedLookup : public Lookup {
   struct ShardLookupInput {
     // Keys that are being looked up.
     std::vector<std::string_view> keys;
+    // Keys whose sets are looked up with the values of `keys`.
+    std::vector<std::string_view> set_keys;
+    // Queries over keys of the shard that are run on the shard.
+    std::vector<std::string_view> queries;
     // A serialized `InternalLookupRequest` with the corresponding keys
-    // from `keys`.
+    // from `keys` and `set_keys`, and queries from `queries`.
     std::string serialized_request;
     // Identifies by how many chars `keys` should be padded, so that
-    // all requests add up to the same length.
+    // all requests add up to the same length, or to their size class.
     int32_t padding;
   };
 
+  // Key lookups of concurrent requests that are sent to the shards together,
+  // as a single request per shard.
+  struct KeyLookupBatch {
+    // The keys of all the lookups, by shard.
+    std::vector<absl::flat_hash_set<std::string>> keys_by_shard;
+    // Number of keys in `keys_by_shard`.
+    int64_t num_keys = 0;
+    // The requests of the lookups, which wait for the batch.
+    std::vector<const RequestContext*> request_contexts;
+    // The response of each shard, set once `done` is notified.
+    absl::StatusOr<std::vector<absl::StatusOr<InternalLookupResponse>>>
+        responses;
+    absl::Notification done;
+  };
+
+  // If `hot_copies` is set, keys of other shards that have a copy in the hot
+  // key cache are not bucketed, their copies are added to `hot_copies`
+  // instead.
   std::vector<ShardLookupInput> BucketKeys(
-      const absl::flat_hash_set<std::string_view>& keys) const {
+      const absl::flat_hash_set<std::string_view>& keys,
+      InternalLookupResponse* hot_copies) const {
     ShardLookupInput sli;
     std::vector<ShardLookupInput> lookup_inputs(num_shards_, sli);
-    for (const auto key : keys) {
-      auto sharding_result = key_sharder_.GetShardNumForKey(key, num_shards_);
-      VLOG(9) << "key: " << key
-              << ", shard number: " << sharding_result.shard_num
-              << ", sharding_key (if regex is present): "
-              << sharding_result.sharding_key;
-      lookup_inputs[sharding_result.shard_num].keys.emplace_back(key);
+    const std::vector<std::string_view> key_list(keys.begin(), keys.end());
+    std::vector<int> shard_nums(key_list.size());
+    key_sharder_.GetShardNumsForKeys(key_list, num_shards_,
+                                     absl::MakeSpan(shard_nums));
+    RecordShardSpread(shard_nums);
+    for (size_t i = 0; i < key_list.size(); ++i) {
+      const std::string_view key = key_list[i];
+      const int shard_num = shard_nums[i];
+      VLOG(9) << "key: " << key << ", shard number: " << shard_num;
+      if (hot_copies != nullptr && shard_num != current_shard_num_) {
+        if (auto copy = hot_key_cache_->Lookup(key); copy.has_value()) {
+          (*hot_copies->mutable_kv_pairs())[key] = *std::move(copy);
+          continue;
+        }
+      }
+      lookup_inputs[shard_num].keys.emplace_back(key);
     }
     return lookup_inputs;
   }
 
+  // Adds each of `set_keys` to the `set_keys` of the input of its shard.
+  void BucketSetKeys(const absl::flat_hash_set<std::string_view>& set_keys,
+                     std::vector<ShardLookupInput>& lookup_inputs) const {
+    const std::vector<std::string_view> key_list(set_keys.begin(),
+                                                 set_keys.end());
+    std::vector<int> shard_nums(key_list.size());
+    key_sharder_.GetShardNumsForKeys(key_list, num_shards_,
+                                     absl::MakeSpan(shard_nums));
+    for (size_t i = 0; i < key_list.size(); ++i) {
+      lookup_inputs[shard_nums[i]].set_keys.emplace_back(key_list[i]);
+    }
+  }
+
+  // Counts whether the keys of a lookup, sharded to `shard_nums`, could have
+  // been looked up without other shards, had the request been sent to the
+  // shard of the keys.
+  void RecordShardSpread(const std::vector<int>& shard_nums) const {
+    if (shard_nums.empty()) {
+      return;
+    }
+    const bool single_shard =
+        std::all_of(shard_nums.begin(), shard_nums.end(),
+                    [&shard_nums](int shard_num) {
+                      return shard_num == shard_nums.front();
+                    });
+    if (!single_shard) {
+      LogShardSpread(kShardSpreadMultiShard);
+    } else if (shard_nums.front() == current_shard_num_) {
+      LogShardSpread(kShardSpreadSingleShardLocal);
+    } else {
+      LogShardSpread(kShardSpreadSingleShardRemote);
+    }
+  }
+
+  // The requests of a traced lookup carry its `trace_parent`, the same for
+  // all shards, so that the shards trace their part of it.
   void SerializeShardedRequests(std::vector<ShardLookupInput>& lookup_inputs,
-                                bool lookup_sets) const {
+                                bool lookup_sets,
+                                std::string_view trace_parent) const {
     for (auto& lookup_input : lookup_inputs) {
       InternalLookupRequest request;
+      request.set_trace_parent(std::string(trace_parent));
       request.mutable_keys()->Assign(lookup_input.keys.begin(),
                                      lookup_input.keys.end());
       request.set_lookup_sets(lookup_sets);
+      request.mutable_set_keys()->Assign(lookup_input.set_keys.begin(),
+                                         lookup_input.set_keys.end());
+      request.mutable_queries()->Assign(lookup_input.queries.begin(),
+                                        lookup_input.queries.end());
       lookup_input.serialized_request = request.SerializeAsString();
     }
   }
 
   void ComputePadding(std::vector<ShardLookupInput>& lookup_inputs) const {
-    int32_t max_length = 0;
-    for (const auto& lookup_input : lookup_inputs) {
-      max_length =
-          std::max(max_length, int32_t(lookup_input.serialized_request.size()));
+    if (padding_options_.min_size_class_bytes > 0) {
+      for (auto& lookup_input : lookup_inputs) {
+        const int64_t length = lookup_input.serialized_request.size();
+        lookup_input.padding = SizeClass(length) - length;
+      }
+    } else {
+      int32_t max_length = 0;
+      for (const auto& lookup_input : lookup_inputs) {
+        max_length = std::max(max_length,
+                              int32_t(lookup_input.serialized_request.size()));
+      }
+      for (auto& lookup_input : lookup_inputs) {
+        lookup_input.padding =
+            max_length - lookup_input.serialized_request.size();
+      }
     }
-    for (auto& lookup_input : lookup_inputs) {
-      lookup_input.padding =
-          max_length - lookup_input.serialized_request.size();
+    // Only the requests to other shards are padded and encrypted.
+    double padded_length = 0;
+    double padding = 0;
+    for (int shard_num = 0; shard_num < num_shards_; shard_num++) {
+      if (shard_num == current_shard_num_) continue;
+      padded_length += lookup_inputs[shard_num].serialized_request.size() +
+                       lookup_inputs[shard_num].padding;
+      padding += lookup_inputs[shard_num].padding;
     }
+    LogIfError(KVServerContextMap()
+                   ->SafeMetric()
+                   .LogHistogram<kShardedLookupPaddingPercent>(
+                       100 * padding / std::max(padded_length, 1.0)));
+  }
+
+  // The smallest size class that fits `length` bytes.
+  int64_t SizeClass(int64_t length) const {
+    int64_t size_class = padding_options_.min_size_class_bytes;
+    while (size_class < length) {
+      size_class *= 2;
+    }
+    return size_class;
   }
 
   std::vector<ShardLookupInput> ShardKeys(
-      const absl::flat_hash_set<std::string_view>& keys,
-      bool lookup_sets) const {
-    auto lookup_inputs = BucketKeys(keys);
-    SerializeShardedRequests(lookup_inputs, lookup_sets);
+      const absl::flat_hash_set<std::string_view>& keys, bool lookup_sets,
+      std::string_view trace_parent,
+      InternalLookupResponse* hot_copies = nullptr) const {
+    auto lookup_inputs = BucketKeys(keys, hot_copies);
+    SerializeShardedRequests(lookup_inputs, lookup_sets, trace_parent);
     ComputePadding(lookup_inputs);
     return lookup_inputs;
   }
 
+  // Sends the requests of `shard_lookup_inputs` to the remote shards, then
+  // runs `get_local_response` for the current shard on the calling thread
+  // while they are in flight. The future of the current shard is ready.
   absl::StatusOr<
-      std::vector<std::future<absl::StatusOr<InternalLookupResponse>>>>
-  GetLookupFutures(const RequestContext& request_context,
-                   const std::vector<ShardLookupInput>& shard_lookup_inputs,
-                   std::function<absl::StatusOr<InternalLookupResponse>(
-                       const std::vector<std::string_view>& key_list)>
-                       get_local_future) const {
-    std::vector<std::future<absl::StatusOr<InternalLookupResponse>>> responses;
+      std::vector<TaskFuture<absl::StatusOr<InternalLookupResponse>>>>
+  GetLookupFutures(
+      const RequestContext& request_context,
+      const std::vector<ShardLookupInput>& shard_lookup_inputs,
+      absl::FunctionRef<absl::StatusOr<InternalLookupResponse>(
+          const ShardLookupInput& shard_lookup_input)>
+          get_local_response) const {
+    // No shard is asked anything for a request that its client gave up on.
+    // The lookups already queued when it gives up check on their own.
+    if (request_context.IsCancelled()) {
+      return absl::CancelledError(
+          "Request was cancelled or is past its deadline.");
+    }
+    // The requests of all lookups share one bounded pool instead of starting
+    // threads of their own.
+    ThreadPool& pool = SharedThreadPool();
+    std::vector<std::optional<
+        TaskFuture<absl::StatusOr<InternalLookupResponse>>>>
+        remote_responses(num_shards_);
     for (int shard_num = 0; shard_num < num_shards_; shard_num++) {
       auto& shard_lookup_input = shard_lookup_inputs[shard_num];
       LogIfError(request_context.GetUdfRequestMetricsContext()
@@ -271,37 +579,82 @@ class ShardedLookup : public Lookup {
                          (int)shard_lookup_input.keys.size(),
                          std::to_string(shard_num)));
       if (shard_num == current_shard_num_) {
-        // Eventually this whole branch will go away.
-        responses.push_back(std::async(std::launch::async, get_local_future,
-                                       std::ref(shard_lookup_input.keys)));
-      } else {
-        const auto client = shard_manager_.Get(shard_num);
-        if (client == nullptr) {
-          LogUdfRequestErrorMetric(
-              request_context.GetUdfRequestMetricsContext(),
-              kLookupClientMissing);
-          return absl::InternalError("Internal lookup client is unavailable.");
-        }
-        responses.push_back(std::async(
-            std::launch::async,
-            [client, &request_context](std::string_view serialized_request,
-                                       int32_t padding) {
-              return client->GetValues(request_context, serialized_request,
-                                       padding);
-            },
-            shard_lookup_input.serialized_request, shard_lookup_input.padding));
+        continue;
+      }
+      const auto client = shard_manager_.Get(shard_num);
+      if (client == nullptr) {
+        LogUdfRequestErrorMetric(request_context.GetUdfRequestMetricsContext(),
+                                 kLookupClientMissing);
+        return absl::InternalError("Internal lookup client is unavailable.");
+      }
+      const auto admission =
+          AdmitShardLookup(failure_options_.circuit_breaker.get(), shard_num);
+      if (admission == ShardCircuitBreaker::Admission::kRejected) {
+        remote_responses[shard_num].emplace(
+            pool.FromCallback<absl::StatusOr<InternalLookupResponse>>(
+                [](auto on_done) {
+                  std::move(on_done)(ShardCircuitOpenError());
+                }));
+        continue;
+      }
+      // No thread of the pool waits for the remote call, so the number of
+      // shards doesn't bound the number of lookups in flight.
+      remote_responses[shard_num].emplace(
+          pool.FromCallback<absl::StatusOr<InternalLookupResponse>>(
+              [client, shard_num, admission,
+               circuit_breaker = failure_options_.circuit_breaker,
+               &request_context, &shard_lookup_input](auto on_done) {
+                // Attributes the tail latency of the fanout to its shards.
+                RequestSpan span = request_context.StartSpan("RemoteLookup");
+                span.SetAttribute("shard", shard_num);
+                client->GetValuesAsync(
+                    request_context, shard_lookup_input.serialized_request,
+                    shard_lookup_input.padding,
+                    [shard_num, admission,
+                     circuit_breaker = std::move(circuit_breaker),
+                     start = absl::Now(), span = std::move(span),
+                     on_done = std::move(on_done)](
+                        absl::StatusOr<InternalLookupResponse>
+                            response) mutable {
+                      span.SetStatus(response.status());
+                      span.End();
+                      RecordRemoteLookupLatency(shard_num, absl::Now() - start);
+                      RecordShardLookup(circuit_breaker.get(), shard_num,
+                                        admission, response.status());
+                      std::move(on_done)(std::move(response));
+                    });
+              }));
+    }
+    std::vector<TaskFuture<absl::StatusOr<InternalLookupResponse>>> responses;
+    responses.reserve(num_shards_);
+    for (int shard_num = 0; shard_num < num_shards_; shard_num++) {
+      if (shard_num != current_shard_num_) {
+        responses.push_back(*std::move(remote_responses[shard_num]));
+        continue;
       }
+      responses.push_back(
+          pool.FromCallback<absl::StatusOr<InternalLookupResponse>>(
+              [&get_local_response,
+               &shard_lookup_input =
+                   shard_lookup_inputs[shard_num]](auto on_done) {
+                std::move(on_done)(get_local_response(shard_lookup_input));
+              }));
     }
     return responses;
   }
 
-  absl::StatusOr<InternalLookupResponse> GetLocalValues(
-      const RequestContext& request_context,
-      const std::vector<std::string_view>& key_list) const {
-    InternalLookupResponse response;
-    absl::flat_hash_set<std::string_view> keys(key_list.begin(),
-                                               key_list.end());
-    return local_lookup_.GetKeyValues(request_context, keys);
+  // Adds the values of the local `key_list` to `response`, where they end up,
+  // without a response of their own.
+  absl::Status AddLocalValues(const RequestContext& request_context,
+                              const std::vector<std::string_view>& key_list,
+                              InternalLookupResponse& response) const {
+    if (key_list.empty()) {
+      return absl::OkStatus();
+    }
+    // The keys of a shard are unique, and are hashed once for the local
+    // lookup.
+    return local_lookup_.AddHashedKeyValues(request_context, HashKeys(key_list),
+                                            response);
   }
 
   absl::StatusOr<InternalLookupResponse> GetLocalKeyValuesSet(
@@ -315,13 +668,54 @@ class ShardedLookup : public Lookup {
     // We have this conversion, because of the inconsistency how we look up
     // keys in Cache -- GetKeyValuePairs vs GetKeyValueSet. GetKeyValuePairs
     // should be refactored to flat_hash_set, and then this can be fixed.
-    // Additionally, this whole local branch will go away once we have a
-    // a sepration between UDF and Data servers.
+    // Servers that only run UDFs never take this local branch.
     absl::flat_hash_set<std::string_view> key_list_set(key_list.begin(),
                                                        key_list.end());
     return local_lookup_.GetKeyValueSet(request_context, key_list_set);
   }
 
+  // Looks up the values and the sets of `shard_lookup_input` in the local
+  // data, the same way a remote shard does.
+  absl::StatusOr<InternalLookupResponse> GetLocalKeyValuesAndSets(
+      const RequestContext& request_context,
+      const ShardLookupInput& shard_lookup_input) const {
+    const absl::flat_hash_set<std::string_view> keys(
+        shard_lookup_input.keys.begin(), shard_lookup_input.keys.end());
+    const absl::flat_hash_set<std::string_view> set_keys(
+        shard_lookup_input.set_keys.begin(), shard_lookup_input.set_keys.end());
+    if (keys.empty() && set_keys.empty()) {
+      return InternalLookupResponse();
+    }
+    return local_lookup_.GetKeyValuesAndSets(request_context, keys, set_keys);
+  }
+
+  // Runs the `queries` of `shard_lookup_input` over the local data, in addition
+  // to looking up the sets of its `keys`, the same way a remote shard does.
+  absl::StatusOr<InternalLookupResponse> GetLocalKeyValuesSetAndQueries(
+      const RequestContext& request_context,
+      const ShardLookupInput& shard_lookup_input) const {
+    auto response =
+        GetLocalKeyValuesSet(request_context, shard_lookup_input.keys);
+    if (!response.ok()) {
+      return response;
+    }
+    for (const auto query : shard_lookup_input.queries) {
+      SingleLookupResult result;
+      auto query_result =
+          local_lookup_.RunQuery(request_context, std::string(query));
+      if (query_result.ok()) {
+        result.mutable_keyset_values()->mutable_values()->Swap(
+            query_result->mutable_elements());
+      } else {
+        auto status = result.mutable_status();
+        status->set_code(static_cast<int>(query_result.status().code()));
+        status->set_message(std::string(query_result.status().message()));
+      }
+      (*response->mutable_kv_pairs())[query] = std::move(result);
+    }
+    return response;
+  }
+
   absl::StatusOr<InternalLookupResponse> ProcessShardedKeys(
       const RequestContext& request_context,
       const absl::flat_hash_set<std::string_view>& keys) const {
@@ -329,20 +723,59 @@ class ShardedLookup : public Lookup {
     if (keys.empty()) {
       return response;
     }
-    const auto shard_lookup_inputs = ShardKeys(keys, false);
-    auto responses =
-        GetLookupFutures(request_context, shard_lookup_inputs,
-                         [this, &request_context](
-                             const std::vector<std::string_view>& key_list) {
-                           return GetLocalValues(request_context, key_list);
-                         });
+    // Every shard is still sent a request, even if all of its keys were
+    // served from the hot key cache, so that the traffic doesn't reveal which
+    // keys are hot.
+    const bool use_hot_key_cache =
+        hot_key_cache_ != nullptr && hot_key_cache_->enabled();
+    InternalLookupResponse* hot_copies =
+        use_hot_key_cache ? &response : nullptr;
+    // The requests of batched lookups are serialized for the whole batch.
+    const bool batched = batching_options_.enabled();
+    const auto shard_lookup_inputs =
+        batched ? BucketKeys(keys, hot_copies)
+                : ShardKeys(keys, false, request_context.TraceParent(),
+                            hot_copies);
+    // The local keys are looked up on the calling thread while the requests
+    // to the other shards are in flight, straight into `response`. They are
+    // left out of batches, whose local lookups all run on one thread.
+    absl::Status local_status;
+    auto look_up_local_keys = [this, &request_context, &shard_lookup_inputs,
+                               &response, &local_status]() {
+      if (current_shard_num_ == kNoLocalShard) {
+        return;
+      }
+      local_status = AddLocalValues(
+          request_context, shard_lookup_inputs[current_shard_num_].keys,
+          response);
+    };
+    std::shared_ptr<const KeyLookupBatch> batch;
+    absl::StatusOr<std::vector<absl::StatusOr<InternalLookupResponse>>>
+        own_responses;
+    if (batched) {
+      batch = LookUpKeysInBatch(request_context, shard_lookup_inputs,
+                                look_up_local_keys);
+    } else {
+      own_responses = GetShardKeyValues(request_context, shard_lookup_inputs,
+                                        look_up_local_keys);
+    }
+    const auto& responses = batched ? batch->responses : own_responses;
     if (!responses.ok()) {
       return responses.status();
     }
     // process responses
     for (int shard_num = 0; shard_num < num_shards_; shard_num++) {
       auto& shard_lookup_input = shard_lookup_inputs[shard_num];
-      auto result = (*responses)[shard_num].get();
+      if (shard_num == current_shard_num_) {
+        if (!local_status.ok()) {
+          LogUdfRequestErrorMetric(
+              request_context.GetUdfRequestMetricsContext(),
+              kShardedKeyValueRequestFailure);
+          SetRequestFailed(shard_lookup_input.keys, response);
+        }
+        continue;
+      }
+      const auto& result = (*responses)[shard_num];
       if (!result.ok()) {
         // mark all keys as internal failure
         LogUdfRequestErrorMetric(request_context.GetUdfRequestMetricsContext(),
@@ -350,54 +783,345 @@ class ShardedLookup : public Lookup {
         SetRequestFailed(shard_lookup_input.keys, response);
         continue;
       }
-      auto kv_pairs = result->mutable_kv_pairs();
-      UpdateResponse(shard_lookup_input.keys, *kv_pairs, response);
+      const auto& kv_pairs = result->kv_pairs();
+      if (use_hot_key_cache) {
+        for (const auto& key : shard_lookup_input.keys) {
+          if (const auto key_iter = kv_pairs.find(key);
+              key_iter != kv_pairs.end()) {
+            hot_key_cache_->MaybeAdd(key, key_iter->second);
+          }
+        }
+      }
+      if (batched) {
+        UpdateResponse(shard_lookup_input.keys, kv_pairs, response);
+      } else {
+        UpdateResponse(shard_lookup_input.keys,
+                       *(*own_responses)[shard_num]->mutable_kv_pairs(),
+                       response);
+      }
     }
     return response;
   }
 
-  void CollectKeySets(
+  // Returns the response of each remote shard to the key lookups of
+  // `shard_lookup_inputs`, and runs `look_up_local_keys` while they are in
+  // flight. The response of the current shard is empty.
+  absl::StatusOr<std::vector<absl::StatusOr<InternalLookupResponse>>>
+  GetShardKeyValues(const RequestContext& request_context,
+                    const std::vector<ShardLookupInput>& shard_lookup_inputs,
+                    absl::FunctionRef<void()> look_up_local_keys) const {
+    auto futures = GetLookupFutures(
+        request_context, shard_lookup_inputs,
+        [&look_up_local_keys](
+            const ShardLookupInput&) -> absl::StatusOr<InternalLookupResponse> {
+          look_up_local_keys();
+          return InternalLookupResponse();
+        });
+    if (!futures.ok()) {
+      return futures.status();
+    }
+    std::vector<absl::StatusOr<InternalLookupResponse>> responses;
+    responses.reserve(num_shards_);
+    for (auto& future : *futures) {
+      responses.push_back(future.Get());
+    }
+    return responses;
+  }
+
+  // Looks up the keys of `shard_lookup_inputs` in a batch with the key
+  // lookups of concurrent requests, and returns the batch once the shards
+  // responded. The first lookup of a batch sends it once its window is over,
+  // or it has enough keys, and fewer than the maximum number of batches are
+  // in flight. Until then, the lookups of other requests join the batch.
+  // Every shard is still sent a request per batch, padded like the requests
+  // of a single lookup, so the traffic reveals as little about the keys as
+  // before. The local keys aren't batched: each lookup runs
+  // `look_up_local_keys` itself while the batch is on its way.
+  std::shared_ptr<const KeyLookupBatch> LookUpKeysInBatch(
       const RequestContext& request_context,
+      const std::vector<ShardLookupInput>& shard_lookup_inputs,
+      absl::FunctionRef<void()> look_up_local_keys) const {
+    std::shared_ptr<KeyLookupBatch> batch;
+    bool sends_batch = false;
+    {
+      absl::MutexLock lock(&batch_mutex_);
+      if (open_batch_ == nullptr || IsFull(*open_batch_)) {
+        open_batch_ = std::make_shared<KeyLookupBatch>();
+        open_batch_->keys_by_shard.resize(num_shards_);
+        sends_batch = true;
+      }
+      batch = open_batch_;
+      for (int shard_num = 0; shard_num < num_shards_; shard_num++) {
+        if (shard_num == current_shard_num_) {
+          continue;
+        }
+        auto& keys = batch->keys_by_shard[shard_num];
+        batch->num_keys -= keys.size();
+        keys.insert(shard_lookup_inputs[shard_num].keys.begin(),
+                    shard_lookup_inputs[shard_num].keys.end());
+        batch->num_keys += keys.size();
+      }
+      batch->request_contexts.push_back(&request_context);
+      if (sends_batch) {
+        auto is_full = [this, &batch]() { return IsFull(*batch); };
+        if (batching_options_.window > absl::ZeroDuration()) {
+          batch_mutex_.AwaitWithTimeout(absl::Condition(&is_full),
+                                        batching_options_.window);
+        }
+        auto can_send = [this]() ABSL_EXCLUSIVE_LOCKS_REQUIRED(batch_mutex_) {
+          return batching_options_.max_batches_in_flight <= 0 ||
+                 batches_in_flight_ < batching_options_.max_batches_in_flight;
+        };
+        batch_mutex_.Await(absl::Condition(&can_send));
+        ++batches_in_flight_;
+        if (open_batch_ == batch) {
+          open_batch_ = nullptr;
+        }
+      }
+    }
+    if (!sends_batch) {
+      look_up_local_keys();
+      batch->done.WaitForNotification();
+      return batch;
+    }
+    SendKeyLookupBatch(*batch, look_up_local_keys);
+    {
+      absl::MutexLock lock(&batch_mutex_);
+      --batches_in_flight_;
+    }
+    batch->done.Notify();
+    return batch;
+  }
+
+  // Whether `batch` is sent without waiting for more lookups to join it. A
+  // full batch that waits for batches in flight is left to its lookups, and
+  // later lookups open a new one.
+  bool IsFull(const KeyLookupBatch& batch) const {
+    return batching_options_.max_keys > 0 &&
+           batch.num_keys >= batching_options_.max_keys;
+  }
+
+  // Sets the responses of the shards to the lookups of `batch`. The requests
+  // are sent until the latest deadline of the lookups, and are cancelled once
+  // all of them are. `look_up_local_keys` runs while the requests are in
+  // flight.
+  void SendKeyLookupBatch(KeyLookupBatch& batch,
+                          absl::FunctionRef<void()> look_up_local_keys) const {
+    ScopeMetricsContext metrics_context;
+    RequestContext batch_context(metrics_context);
+    absl::Time deadline = absl::InfinitePast();
+    for (const RequestContext* request_context : batch.request_contexts) {
+      deadline = std::max(deadline, request_context->deadline());
+    }
+    batch_context.SetDeadline(
+        {.deadline = deadline,
+         .is_cancelled = [&batch]() {
+           return std::all_of(batch.request_contexts.begin(),
+                              batch.request_contexts.end(),
+                              [](const RequestContext* request_context) {
+                                return request_context->IsCancelled();
+                              });
+         }});
+    std::vector<ShardLookupInput> shard_lookup_inputs(num_shards_);
+    for (int shard_num = 0; shard_num < num_shards_; shard_num++) {
+      const auto& keys = batch.keys_by_shard[shard_num];
+      shard_lookup_inputs[shard_num].keys.assign(keys.begin(), keys.end());
+    }
+    // The batch is shared by several requests, so it isn't traced with any.
+    SerializeShardedRequests(shard_lookup_inputs, /*lookup_sets=*/false,
+                             /*trace_parent=*/"");
+    ComputePadding(shard_lookup_inputs);
+    batch.responses = GetShardKeyValues(batch_context, shard_lookup_inputs,
+                                        look_up_local_keys);
+    batch_context.EndCall();
+  }
+
+  // Views of the sets in `responses`, by key set name; the members stay in
+  // `responses`, which must outlive the views.
+  absl::flat_hash_map<std::string_view, KVSetView> CollectKeySetViews(
+      const RequestContext& request_context,
+      const std::vector<InternalLookupResponse>& responses) const {
+    absl::flat_hash_map<std::string_view, KVSetView> key_sets;
+    for (const auto& response : responses) {
+      for (const auto& [key, keyset_lookup_result] : response.kv_pairs()) {
+        if (!keyset_lookup_result.has_keyset_values()) {
+          // this means it wasn't found, no need to insert an empty set.
+          continue;
+        }
+        const auto& values = keyset_lookup_result.keyset_values().values();
+        auto [_, inserted] =
+            key_sets.try_emplace(key, values.begin(), values.end());
+        if (!inserted) {
+          LogUdfRequestErrorMetric(
+              request_context.GetUdfRequestMetricsContext(),
+              kShardedKeyCollisionOnKeySetCollection);
+          LOG(ERROR) << "Key collision, when collecting results from shards: "
+                     << key;
+        }
+      }
+    }
+    return key_sets;
+  }
+
+  // Adds the members of the sets in `chunk`, a chunk of the response of a
+  // single shard, to `key_sets`.
+  void AddKeySetChunk(
       absl::flat_hash_map<std::string, absl::flat_hash_set<std::string>>&
           key_sets,
-      InternalLookupResponse& keysets_lookup_response) const {
-    for (auto& [key, keyset_lookup_result] :
-         (*(keysets_lookup_response.mutable_kv_pairs()))) {
-      switch (keyset_lookup_result.single_lookup_result_case()) {
-        case SingleLookupResult::kStatusFieldNumber:
-          // this means it wasn't found, no need to insert an empty set.
-          break;
-        case SingleLookupResult::kKeysetValuesFieldNumber:
-          absl::flat_hash_set<std::string> value_set;
-          for (auto& v : keyset_lookup_result.keyset_values().values()) {
-            VLOG(8) << "keyset name: " << key << " value: " << v;
-            value_set.emplace(std::move(v));
-          }
-          auto [_, inserted] =
-              key_sets.insert_or_assign(key, std::move(value_set));
-          if (!inserted) {
-            LogUdfRequestErrorMetric(
-                request_context.GetUdfRequestMetricsContext(),
-                kShardedKeyCollisionOnKeySetCollection);
-            LOG(ERROR) << "Key collision, when collecting results from shards: "
-                       << key;
-          }
-          break;
+      InternalLookupResponse& chunk) const {
+    for (auto& [key, keyset_lookup_result] : *chunk.mutable_kv_pairs()) {
+      if (!keyset_lookup_result.has_keyset_values()) {
+        // this means it wasn't found, no need to insert an empty set.
+        continue;
+      }
+      auto& value_set = key_sets[key];
+      auto& values =
+          *keyset_lookup_result.mutable_keyset_values()->mutable_values();
+      value_set.reserve(value_set.size() + values.size());
+      for (auto& v : values) {
+        value_set.emplace(std::move(v));
       }
     }
   }
 
+  // The responses of the shards are streamed, and each chunk is added to the
+  // sets of its shard as it arrives, so that the sets are built while the rest
+  // of the members are on their way and no shard's whole response is held.
+  // With `failed_keys`, the keys of the shards that failed are added to it
+  // instead of failing the lookup, and the sets of the other shards are
+  // returned.
   absl::StatusOr<
       absl::flat_hash_map<std::string, absl::flat_hash_set<std::string>>>
   GetShardedKeyValueSet(
       const RequestContext& request_context,
-      const absl::flat_hash_set<std::string_view>& key_set) const {
-    const auto shard_lookup_inputs = ShardKeys(key_set, true);
+      const absl::flat_hash_set<std::string_view>& key_set,
+      std::vector<std::string_view>* failed_keys = nullptr) const {
+    if (request_context.IsCancelled()) {
+      return absl::CancelledError(
+          "Request was cancelled or is past its deadline.");
+    }
+    const auto shard_lookup_inputs =
+        ShardKeys(key_set, true, request_context.TraceParent());
+    std::vector<RemoteLookupClient*> clients(num_shards_, nullptr);
+    for (int shard_num = 0; shard_num < num_shards_; shard_num++) {
+      if (shard_num == current_shard_num_) {
+        continue;
+      }
+      clients[shard_num] = shard_manager_.Get(shard_num);
+      if (clients[shard_num] == nullptr) {
+        LogUdfRequestErrorMetric(request_context.GetUdfRequestMetricsContext(),
+                                 kLookupClientMissing);
+        return absl::InternalError("Internal lookup client is unavailable.");
+      }
+    }
+    // Each shard's chunks only touch the sets of that shard.
+    std::vector<
+        absl::flat_hash_map<std::string, absl::flat_hash_set<std::string>>>
+        shard_key_sets(num_shards_);
+    ThreadPool& pool = SharedThreadPool();
+    std::vector<std::optional<TaskFuture<absl::Status>>> shard_statuses(
+        num_shards_);
+    for (int shard_num = 0; shard_num < num_shards_; shard_num++) {
+      const auto& shard_lookup_input = shard_lookup_inputs[shard_num];
+      auto& key_sets = shard_key_sets[shard_num];
+      LogIfError(request_context.GetUdfRequestMetricsContext()
+                     .AccumulateMetric<kShardedLookupKeyCountByShard>(
+                         (int)shard_lookup_input.keys.size(),
+                         std::to_string(shard_num)));
+      if (shard_num == current_shard_num_) {
+        continue;
+      }
+      const auto admission =
+          AdmitShardLookup(failure_options_.circuit_breaker.get(), shard_num);
+      if (admission == ShardCircuitBreaker::Admission::kRejected) {
+        shard_statuses[shard_num].emplace(pool.FromCallback<absl::Status>(
+            [](auto on_done) { std::move(on_done)(ShardCircuitOpenError()); }));
+        continue;
+      }
+      shard_statuses[shard_num].emplace(pool.FromCallback<absl::Status>(
+          [this, client = clients[shard_num], shard_num, admission,
+           circuit_breaker = failure_options_.circuit_breaker,
+           &request_context, &shard_lookup_input, &key_sets](auto on_done) {
+            client->GetValuesStreamAsync(
+                request_context, shard_lookup_input.serialized_request,
+                shard_lookup_input.padding,
+                [this, &key_sets](InternalLookupResponse chunk) {
+                  AddKeySetChunk(key_sets, chunk);
+                },
+                [shard_num, admission,
+                 circuit_breaker = std::move(circuit_breaker),
+                 start = absl::Now(),
+                 on_done = std::move(on_done)](absl::Status status) mutable {
+                  RecordRemoteLookupLatency(shard_num, absl::Now() - start);
+                  RecordShardLookup(circuit_breaker.get(), shard_num,
+                                    admission, status);
+                  std::move(on_done)(std::move(status));
+                });
+          }));
+    }
+    // The local sets are looked up on the calling thread while the remote
+    // chunks arrive.
+    absl::Status status;
+    auto add_shard_status = [&](int shard_num, absl::Status shard_status) {
+      if (shard_status.ok()) {
+        return;
+      }
+      if (failed_keys == nullptr) {
+        status.Update(std::move(shard_status));
+        return;
+      }
+      // The chunks that the shard sent before it failed are dropped.
+      shard_key_sets[shard_num].clear();
+      const auto& keys = shard_lookup_inputs[shard_num].keys;
+      failed_keys->insert(failed_keys->end(), keys.begin(), keys.end());
+    };
+    if (current_shard_num_ != kNoLocalShard) {
+      if (auto response = GetLocalKeyValuesSetAndQueries(
+              request_context, shard_lookup_inputs[current_shard_num_]);
+          response.ok()) {
+        AddKeySetChunk(shard_key_sets[current_shard_num_], *response);
+      } else {
+        add_shard_status(current_shard_num_, response.status());
+      }
+    }
+    for (int shard_num = 0; shard_num < num_shards_; shard_num++) {
+      if (shard_statuses[shard_num].has_value()) {
+        add_shard_status(shard_num, shard_statuses[shard_num]->Get());
+      }
+    }
+    if (!status.ok() || (failed_keys != nullptr && !failed_keys->empty())) {
+      LogUdfRequestErrorMetric(request_context.GetUdfRequestMetricsContext(),
+                               kShardedKeyValueSetRequestFailure);
+    }
+    if (!status.ok()) {
+      return status;
+    }
+    absl::flat_hash_map<std::string, absl::flat_hash_set<std::string>> key_sets;
+    for (auto& shard_sets : shard_key_sets) {
+      for (auto& [key, value_set] : shard_sets) {
+        auto [_, inserted] = key_sets.try_emplace(key, std::move(value_set));
+        if (!inserted) {
+          LogUdfRequestErrorMetric(
+              request_context.GetUdfRequestMetricsContext(),
+              kShardedKeyCollisionOnKeySetCollection);
+          LOG(ERROR) << "Key collision, when collecting results from shards: "
+                     << key;
+        }
+      }
+    }
+    return key_sets;
+  }
+
+  // Returns the responses of all shards to the set lookups and queries of
+  // `shard_lookup_inputs`.
+  absl::StatusOr<std::vector<InternalLookupResponse>> GetShardedResponses(
+      const RequestContext& request_context,
+      const std::vector<ShardLookupInput>& shard_lookup_inputs) const {
     auto responses = GetLookupFutures(
         request_context, shard_lookup_inputs,
-        [this,
-         &request_context](const std::vector<std::string_view>& key_list) {
-          return GetLocalKeyValuesSet(request_context, key_list);
+        [this, &request_context](const ShardLookupInput& shard_lookup_input) {
+          return GetLocalKeyValuesSetAndQueries(request_context,
+                                                shard_lookup_input);
         });
     if (!responses.ok()) {
       LogUdfRequestErrorMetric(request_context.GetUdfRequestMetricsContext(),
@@ -405,38 +1129,240 @@ class ShardedLookup : public Lookup {
       return responses.status();
     }
     // process responses
-    absl::flat_hash_map<std::string, absl::flat_hash_set<std::string>> key_sets;
+    std::vector<InternalLookupResponse> results;
+    results.reserve(num_shards_);
     for (int shard_num = 0; shard_num < num_shards_; shard_num++) {
-      auto& shard_lookup_input = shard_lookup_inputs[shard_num];
-      auto result = (*responses)[shard_num].get();
+      auto result = (*responses)[shard_num].Get();
       if (!result.ok()) {
         LogUdfRequestErrorMetric(request_context.GetUdfRequestMetricsContext(),
                                  kShardedKeyValueSetRequestFailure);
         return result.status();
       }
-      CollectKeySets(request_context, key_sets, *result);
+      results.push_back(*std::move(result));
     }
-    return key_sets;
+    return results;
+  }
+
+  // Returns the shard of the keys of every node of the tree at `root`, or
+  // `kMixedShards` for the operations over keys of different shards.
+  absl::flat_hash_map<const Node*, int32_t> GetNodeShards(
+      const Node& root) const {
+    absl::flat_hash_map<const Node*, int32_t> node_shards;
+    for (const Node* node : PostOrderTraversal(&root)) {
+      if (node->Left() == nullptr) {
+        const auto key = static_cast<const ValueNode*>(node)->Key();
+        node_shards[node] =
+            key_sharder_.GetShardNumForKey(key, num_shards_).shard_num;
+        continue;
+      }
+      const int32_t left_shard = node_shards[node->Left()];
+      const int32_t right_shard = node_shards[node->Right()];
+      node_shards[node] =
+          left_shard == right_shard ? left_shard : kMixedShards;
+    }
+    return node_shards;
+  }
+
+  // Runs the query at `root` with its largest subtrees over keys of a single
+  // shard pushed down to that shard, so that only their results, and not the
+  // sets of all of their keys, are sent back. The operations over the results
+  // of different shards are then applied here, over views of the members in
+  // the responses, so that no set is copied before it's operated on.
+  // The subtrees are sent without the options of the query, which are applied
+  // to its final result. With a `profile`, the sizes of the requests and
+  // responses of the shards and the latencies of the steps are added to it.
+  absl::StatusOr<InternalRunQueryResponse> RunPushedDownQuery(
+      const RequestContext& request_context, const Node& root,
+      const QueryResultOptions& result_options,
+      std::string* profile = nullptr) const {
+    const auto node_shards = GetNodeShards(root);
+    // Subtrees sent to a shard. Keys are looked up, operations are sent as
+    // queries.
+    std::vector<const Node*> pushed_down;
+    if (node_shards.at(&root) != kMixedShards) {
+      pushed_down.push_back(&root);
+    } else {
+      for (const auto& [node, shard_num] : node_shards) {
+        if (shard_num != kMixedShards) continue;
+        for (const Node* child : {node->Left(), node->Right()}) {
+          if (node_shards.at(child) != kMixedShards) {
+            pushed_down.push_back(child);
+          }
+        }
+      }
+    }
+    // The name the result of each pushed down subtree is returned under.
+    absl::flat_hash_map<const Node*, std::string> names;
+    for (const Node* node : pushed_down) {
+      if (node->Left() == nullptr) {
+        names[node] = static_cast<const ValueNode*>(node)->Key();
+      } else {
+        names[node] = ToQueryString(*node);
+      }
+    }
+    std::vector<absl::flat_hash_set<std::string_view>> shard_keys(num_shards_);
+    std::vector<absl::flat_hash_set<std::string_view>> shard_queries(
+        num_shards_);
+    for (const auto& [node, name] : names) {
+      auto& shard_names = node->Left() == nullptr ? shard_keys : shard_queries;
+      shard_names[node_shards.at(node)].insert(name);
+    }
+    std::vector<ShardLookupInput> shard_lookup_inputs(num_shards_);
+    for (int shard_num = 0; shard_num < num_shards_; shard_num++) {
+      shard_lookup_inputs[shard_num].keys.assign(
+          shard_keys[shard_num].begin(), shard_keys[shard_num].end());
+      shard_lookup_inputs[shard_num].queries.assign(
+          shard_queries[shard_num].begin(), shard_queries[shard_num].end());
+    }
+    SerializeShardedRequests(shard_lookup_inputs, true,
+                             request_context.TraceParent());
+    ComputePadding(shard_lookup_inputs);
+    const absl::Time start = absl::Now();
+    const auto responses =
+        GetShardedResponses(request_context, shard_lookup_inputs);
+    if (!responses.ok()) {
+      LogUdfRequestErrorMetric(request_context.GetUdfRequestMetricsContext(),
+                               kShardedRunQueryKeySetRetrievalFailure);
+      return responses.status();
+    }
+    const absl::Time merge_start = absl::Now();
+    if (profile != nullptr) {
+      absl::StrAppend(profile, "Shard lookups, ",
+                      absl::FormatDuration(merge_start - start), "\n");
+      for (int shard_num = 0; shard_num < num_shards_; shard_num++) {
+        const ShardLookupInput& input = shard_lookup_inputs[shard_num];
+        if (input.keys.empty() && input.queries.empty()) continue;
+        absl::StrAppend(profile, "  Shard ", shard_num, ": ",
+                        input.keys.size(), " keys, ", input.queries.size(),
+                        " queries in ", input.serialized_request.size(),
+                        " bytes -> ", (*responses)[shard_num].ByteSizeLong(),
+                        " bytes\n");
+      }
+    }
+    auto key_sets = CollectKeySetViews(request_context, *responses);
+    // Number of subtrees each set is still an operand of, the last one can
+    // take the view instead of a copy.
+    absl::flat_hash_map<std::string_view, int> remaining_uses;
+    for (const auto& [node, name] : names) {
+      if (node->Left() != nullptr && !key_sets.contains(name)) {
+        return absl::InternalError(
+            absl::StrCat("Pushed down query failed: ", name));
+      }
+      ++remaining_uses[name];
+    }
+    // Operations consume their operands, so the view of a set is only copied
+    // if other operations still need it.
+    auto take_result = [&](const Node* node) {
+      const auto& name = names.at(node);
+      const auto key_iter = key_sets.find(name);
+      if (key_iter == key_sets.end()) {
+        VLOG(8) << "Can't find " << name << " key_set. Returning empty.";
+        LogUdfRequestErrorMetric(request_context.GetUdfRequestMetricsContext(),
+                                 kShardedRunQueryMissingKeySet);
+        return KVSetView();
+      }
+      if (--remaining_uses[name] > 0) {
+        return key_iter->second;
+      }
+      return std::move(key_iter->second);
+    };
+    KVSetView result;
+    if (node_shards.at(&root) != kMixedShards) {
+      result = take_result(&root);
+    } else {
+      // Same as `Eval`, with the results of the pushed down subtrees as the
+      // operands of the operations over them.
+      std::vector<KVSetView> stack;
+      for (const Node* node : PostOrderTraversal(&root)) {
+        if (node_shards.at(node) != kMixedShards) continue;
+        auto get_operand = [&](const Node* child) {
+          if (node_shards.at(child) != kMixedShards) {
+            return take_result(child);
+          }
+          KVSetView operand = std::move(stack.back());
+          stack.pop_back();
+          return operand;
+        };
+        KVSetView right = get_operand(node->Right());
+        KVSetView left = get_operand(node->Left());
+        stack.push_back(static_cast<const OpNode*>(node)->Op(std::move(left),
+                                                             std::move(right)));
+      }
+      result = std::move(stack.back());
+    }
+    if (profile != nullptr) {
+      absl::StrAppend(profile, "Merge of ", names.size(),
+                      " shard results -> ", result.size(), ", ",
+                      absl::FormatDuration(absl::Now() - merge_start), "\n");
+    }
+    InternalRunQueryResponse response;
+    const int64_t num_elements =
+        SetQueryResultCount(result_options, result.size(), response);
+    auto end = result.begin();
+    std::advance(end, num_elements);
+    response.mutable_elements()->Assign(result.begin(), end);
+    return response;
   }
 
+  // Shard of an operation over keys of different shards.
+  static constexpr int32_t kMixedShards = -1;
+
   const Lookup& local_lookup_;
   const int32_t num_shards_;
   const int32_t current_shard_num_;
   const std::string hashing_seed_;
   const ShardManager& shard_manager_;
   KeySharder key_sharder_;
+  // Shared by the lookups of all requests, may be null.
+  const std::shared_ptr<HotKeyCache> hot_key_cache_;
+  // Parsed queries, shared by the requests of this lookup.
+  mutable QueryCache query_cache_;
+  // See `LookUpKeysInBatch`.
+  const KeyLookupBatchingOptions batching_options_;
+  const RequestPaddingOptions padding_options_;
+  const ShardFailureOptions failure_options_;
+  mutable absl::Mutex batch_mutex_;
+  // The batch that the next key lookups join, if its lookups aren't sent yet.
+  mutable std::shared_ptr<KeyLookupBatch> open_batch_
+      ABSL_GUARDED_BY(batch_mutex_);
+  mutable int batches_in_flight_ ABSL_GUARDED_BY(batch_mutex_) = 0;
 };
 
 }  // namespace
 
+absl::flat_hash_map<std::string, double>
+GetRemoteLookupLatenciesByShardInMicros() {
+  RemoteLookupLatencies& latencies = GetRemoteLookupLatencies();
+  absl::flat_hash_map<int32_t, RemoteLookupLatencies::Sum> by_shard;
+  {
+    absl::MutexLock lock(&latencies.mutex);
+    by_shard.swap(latencies.by_shard);
+  }
+  absl::flat_hash_map<std::string, double> means;
+  for (const auto& [shard_num, sum] : by_shard) {
+    means[absl::StrCat(shard_num)] =
+        absl::ToDoubleMicroseconds(sum.total) / sum.count;
+  }
+  return means;
+}
+
 std::unique_ptr<Lookup> CreateShardedLookup(const Lookup& local_lookup,
                                             const int32_t num_shards,
                                             const int32_t current_shard_num,
                                             const ShardManager& shard_manager,
-                                            KeySharder key_sharder) {
-  return std::make_unique<ShardedLookup>(local_lookup, num_shards,
-                                         current_shard_num, shard_manager,
-                                         std::move(key_sharder));
+                                            KeySharder key_sharder,
+                                            std::shared_ptr<HotKeyCache>
+                                                hot_key_cache,
+                                            KeyLookupBatchingOptions
+                                                batching_options,
+                                            RequestPaddingOptions
+                                                padding_options,
+                                            ShardFailureOptions
+                                                failure_options) {
+  return std::make_unique<ShardedLookup>(
+      local_lookup, num_shards, current_shard_num, shard_manager,
+      std::move(key_sharder), std::move(hot_key_cache), batching_options,
+      padding_options, std::move(failure_options));
 }
 
 }  // namespace kv_server
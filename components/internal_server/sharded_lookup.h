@@ -20,17 +20,74 @@
 #include <memory>
 #include <string>
 
+#include "absl/container/flat_hash_map.h"
+#include "absl/time/time.h"
+#include "components/internal_server/hot_key_cache.h"
 #include "components/internal_server/lookup.h"
+#include "components/internal_server/shard_circuit_breaker.h"
 #include "components/sharding/shard_manager.h"
 #include "public/sharding/key_sharder.h"
 
 namespace kv_server {
 
-std::unique_ptr<Lookup> CreateShardedLookup(const Lookup& local_lookup,
-                                            const int32_t num_shards,
-                                            const int32_t current_shard_num,
-                                            const ShardManager& shard_manager,
-                                            KeySharder key_sharder);
+// How the key lookups of concurrent requests are sent to the shards in
+// batches, which each send a single request to every shard.
+struct KeyLookupBatchingOptions {
+  // Maximum number of batches in flight, none if it's not positive.
+  int max_batches_in_flight = 0;
+  // How long a batch waits for lookups to join it before it's sent.
+  absl::Duration window = absl::ZeroDuration();
+  // A batch with this many keys of remote shards is sent without waiting for
+  // the rest of its window. No limit if it's not positive.
+  int max_keys = 0;
+
+  // Key lookups are batched if batches wait for lookups to join them.
+  bool enabled() const {
+    return max_batches_in_flight > 0 || window > absl::ZeroDuration();
+  }
+};
+
+// How the requests sent to the shards for a lookup are padded, so that their
+// sizes don't reveal which shards have more of the looked up keys.
+struct RequestPaddingOptions {
+  // Pads each request to the next size class instead of to the largest request
+  // of the lookup, if it's positive. The size classes are this many bytes times
+  // a power of two.
+  int min_size_class_bytes = 0;
+};
+
+// How the lookups of shards that fail are handled.
+struct ShardFailureOptions {
+  // Fails the lookups of shards whose lookups keep failing without sending
+  // them, if set and enabled. Shared by the lookups of all requests.
+  std::shared_ptr<ShardCircuitBreaker> circuit_breaker;
+  // Set lookups return the sets of the shards that answered, and an error
+  // status for each key of the shards that didn't, instead of failing
+  // altogether. Key lookups always do.
+  bool partial_key_sets = false;
+};
+
+// `current_shard_num` of a server that holds no shard of the data, such as a
+// server that only runs UDFs, which looks up every key from the data servers.
+inline constexpr int32_t kNoLocalShard = -1;
+
+// Looks up keys in the shards that have them. If `hot_key_cache` is set and
+// enabled, the keys of other shards that are looked up the most are served
+// from copies in it instead. With `current_shard_num` set to `kNoLocalShard`,
+// `local_lookup` is never used.
+std::unique_ptr<Lookup> CreateShardedLookup(
+    const Lookup& local_lookup, const int32_t num_shards,
+    const int32_t current_shard_num, const ShardManager& shard_manager,
+    KeySharder key_sharder,
+    std::shared_ptr<HotKeyCache> hot_key_cache = nullptr,
+    KeyLookupBatchingOptions batching_options = {},
+    RequestPaddingOptions padding_options = {},
+    ShardFailureOptions failure_options = {});
+
+// Returns the mean latency of the lookups sent to each other shard since the
+// last call, by shard number. Shards that weren't sent any are left out.
+absl::flat_hash_map<std::string, double>
+GetRemoteLookupLatenciesByShardInMicros();
 
 }  // namespace kv_server
 
@@ -14,11 +14,15 @@
 
 #include "components/internal_server/sharded_lookup.h"
 
+#include <atomic>
 #include <memory>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
 #include "components/data_server/cache/mocks.h"
 #include "components/internal_server/mocks.h"
 #include "components/sharding/mocks.h"
@@ -115,6 +119,345 @@ TEST_F(ShardedLookupTest, GetKeyValues_Success) {
   EXPECT_THAT(response.value(), EqualsProto(expected));
 }
 
+TEST_F(ShardedLookupTest, GetKeyValues_NoLocalShardLooksUpAllKeysRemotely) {
+  EXPECT_CALL(mock_local_lookup_, GetKeyValues(_, _)).Times(0);
+  std::vector<absl::flat_hash_set<std::string>> cluster_mappings;
+  for (int i = 0; i < 2; i++) {
+    cluster_mappings.push_back({std::to_string(i)});
+  }
+  auto shard_manager = ShardManager::Create(
+      num_shards_, std::move(cluster_mappings),
+      std::make_unique<MockRandomGenerator>(), [](const std::string& ip) {
+        // "key1" is sharded to shard 1 and "key4" to shard 0.
+        const std::string key = ip == "1" ? "key1" : "key4";
+        auto mock_remote_lookup_client =
+            std::make_unique<MockRemoteLookupClient>();
+        InternalLookupRequest request;
+        request.add_keys(key);
+        EXPECT_CALL(*mock_remote_lookup_client,
+                    GetValues(_, request.SerializeAsString(), _))
+            .WillOnce([key]() {
+              InternalLookupResponse resp;
+              (*resp.mutable_kv_pairs())[key].set_value("value_" + key);
+              return resp;
+            });
+        return mock_remote_lookup_client;
+      });
+  auto sharded_lookup =
+      CreateShardedLookup(mock_local_lookup_, num_shards_, kNoLocalShard,
+                          *(*shard_manager), key_sharder_);
+  auto response =
+      sharded_lookup->GetKeyValues(GetRequestContext(), {"key1", "key4"});
+  ASSERT_TRUE(response.ok());
+
+  InternalLookupResponse expected;
+  TextFormat::ParseFromString(R"pb(kv_pairs {
+                                     key: "key1"
+                                     value { value: "value_key1" }
+                                   }
+                                   kv_pairs {
+                                     key: "key4"
+                                     value { value: "value_key4" }
+                                   }
+                              )pb",
+                              &expected);
+  EXPECT_THAT(response.value(), EqualsProto(expected));
+}
+
+TEST_F(ShardedLookupTest, GetKeyValues_LocalKeysAreLookedUpOnCallingThread) {
+  absl::Notification remote_call_started;
+  const std::thread::id calling_thread = std::this_thread::get_id();
+  EXPECT_CALL(mock_local_lookup_, GetKeyValues(_, _))
+      .WillOnce([&remote_call_started, calling_thread]() {
+        // The remote shard is asked first, the local keys are looked up
+        // while it answers.
+        EXPECT_TRUE(remote_call_started.HasBeenNotified());
+        EXPECT_EQ(std::this_thread::get_id(), calling_thread);
+        InternalLookupResponse response;
+        (*response.mutable_kv_pairs())["key4"].set_value("value4");
+        return response;
+      });
+  std::vector<absl::flat_hash_set<std::string>> cluster_mappings;
+  for (int i = 0; i < 2; i++) {
+    cluster_mappings.push_back({std::to_string(i)});
+  }
+  auto shard_manager = ShardManager::Create(
+      num_shards_, std::move(cluster_mappings),
+      std::make_unique<MockRandomGenerator>(),
+      [&remote_call_started](const std::string& ip) {
+        auto mock_remote_lookup_client =
+            std::make_unique<MockRemoteLookupClient>();
+        EXPECT_CALL(*mock_remote_lookup_client, GetValues(_, _, _))
+            .WillRepeatedly([&remote_call_started]() {
+              remote_call_started.Notify();
+              InternalLookupResponse response;
+              (*response.mutable_kv_pairs())["key1"].set_value("value1");
+              return response;
+            });
+        return mock_remote_lookup_client;
+      });
+  auto sharded_lookup =
+      CreateShardedLookup(mock_local_lookup_, num_shards_, shard_num_,
+                          *(*shard_manager), key_sharder_);
+
+  auto response =
+      sharded_lookup->GetKeyValues(GetRequestContext(), {"key1", "key4"});
+  ASSERT_TRUE(response.ok());
+  InternalLookupResponse expected;
+  TextFormat::ParseFromString(R"pb(kv_pairs {
+                                     key: "key1"
+                                     value { value: "value1" }
+                                   }
+                                   kv_pairs {
+                                     key: "key4"
+                                     value { value: "value4" }
+                                   }
+                              )pb",
+                              &expected);
+  EXPECT_THAT(response.value(), EqualsProto(expected));
+}
+
+TEST_F(ShardedLookupTest, GetKeyValues_RecordsLatencyOfRemoteShards) {
+  EXPECT_CALL(mock_local_lookup_, GetKeyValues(_, _))
+      .WillOnce(Return(InternalLookupResponse()));
+  std::vector<absl::flat_hash_set<std::string>> cluster_mappings;
+  for (int i = 0; i < 2; i++) {
+    cluster_mappings.push_back({std::to_string(i)});
+  }
+  auto shard_manager = ShardManager::Create(
+      num_shards_, std::move(cluster_mappings),
+      std::make_unique<MockRandomGenerator>(), [](const std::string& ip) {
+        auto mock_remote_lookup_client =
+            std::make_unique<MockRemoteLookupClient>();
+        EXPECT_CALL(*mock_remote_lookup_client, GetValues(_, _, _))
+            .WillRepeatedly(Return(InternalLookupResponse()));
+        return mock_remote_lookup_client;
+      });
+  auto sharded_lookup =
+      CreateShardedLookup(mock_local_lookup_, num_shards_, shard_num_,
+                          *(*shard_manager), key_sharder_);
+  GetRemoteLookupLatenciesByShardInMicros();
+
+  EXPECT_TRUE(
+      sharded_lookup->GetKeyValues(GetRequestContext(), {"key1", "key4"}).ok());
+
+  const auto latencies = GetRemoteLookupLatenciesByShardInMicros();
+  EXPECT_EQ(latencies.size(), 1);
+  EXPECT_TRUE(latencies.contains("1"));
+  EXPECT_TRUE(GetRemoteLookupLatenciesByShardInMicros().empty());
+}
+
+TEST_F(ShardedLookupTest, GetKeyValues_ConcurrentLookupsShareBatches) {
+  EXPECT_CALL(mock_local_lookup_, GetKeyValues(_, _))
+      .WillRepeatedly(Return(InternalLookupResponse()));
+  std::vector<absl::flat_hash_set<std::string>> cluster_mappings;
+  for (int i = 0; i < 2; i++) {
+    cluster_mappings.push_back({std::to_string(i)});
+  }
+  std::atomic<int> num_remote_calls = 0;
+  absl::Notification first_call_started;
+  absl::Notification release_first_call;
+  auto shard_manager = ShardManager::Create(
+      num_shards_, std::move(cluster_mappings),
+      std::make_unique<MockRandomGenerator>(),
+      [&num_remote_calls, &first_call_started,
+       &release_first_call](const std::string& ip) {
+        auto mock_remote_lookup_client =
+            std::make_unique<MockRemoteLookupClient>();
+        EXPECT_CALL(*mock_remote_lookup_client, GetValues(_, _, _))
+            .WillRepeatedly([&num_remote_calls, &first_call_started,
+                             &release_first_call]() {
+              if (++num_remote_calls == 1) {
+                first_call_started.Notify();
+                release_first_call.WaitForNotification();
+              }
+              InternalLookupResponse response;
+              (*response.mutable_kv_pairs())["key1"].set_value("value1");
+              return response;
+            });
+        return mock_remote_lookup_client;
+      });
+  auto sharded_lookup = CreateShardedLookup(
+      mock_local_lookup_, num_shards_, shard_num_, *(*shard_manager),
+      key_sharder_, /*hot_key_cache=*/nullptr,
+      {.max_batches_in_flight = 1});
+  std::atomic<int> num_found = 0;
+  auto look_up = [&sharded_lookup, &num_found]() {
+    ScopeMetricsContext metrics_context;
+    RequestContext request_context(metrics_context);
+    const auto response =
+        sharded_lookup->GetKeyValues(request_context, {"key1", "key4"});
+    ASSERT_TRUE(response.ok()) << response.status();
+    if (response->kv_pairs().at("key1").value() == "value1" &&
+        response->kv_pairs().at("key4").has_status()) {
+      ++num_found;
+    }
+  };
+  std::thread first_lookup(look_up);
+  first_call_started.WaitForNotification();
+  std::vector<std::thread> batched_lookups;
+  for (int i = 0; i < 3; ++i) {
+    batched_lookups.emplace_back(look_up);
+  }
+  // Give the lookups time to join the batch that waits for the first one.
+  absl::SleepFor(absl::Milliseconds(50));
+  release_first_call.Notify();
+  first_lookup.join();
+  for (auto& lookup : batched_lookups) {
+    lookup.join();
+  }
+  EXPECT_EQ(num_found, 4);
+  EXPECT_EQ(num_remote_calls, 2);
+}
+
+TEST_F(ShardedLookupTest, GetKeyValues_LookupsWithinWindowShareBatch) {
+  EXPECT_CALL(mock_local_lookup_, GetKeyValues(_, _))
+      .WillRepeatedly(Return(InternalLookupResponse()));
+  std::vector<absl::flat_hash_set<std::string>> cluster_mappings;
+  for (int i = 0; i < 2; i++) {
+    cluster_mappings.push_back({std::to_string(i)});
+  }
+  std::atomic<int> num_remote_calls = 0;
+  auto shard_manager = ShardManager::Create(
+      num_shards_, std::move(cluster_mappings),
+      std::make_unique<MockRandomGenerator>(),
+      [&num_remote_calls](const std::string& ip) {
+        auto mock_remote_lookup_client =
+            std::make_unique<MockRemoteLookupClient>();
+        EXPECT_CALL(*mock_remote_lookup_client, GetValues(_, _, _))
+            .WillRepeatedly([&num_remote_calls]() {
+              ++num_remote_calls;
+              InternalLookupResponse response;
+              (*response.mutable_kv_pairs())["key1"].set_value("value1");
+              return response;
+            });
+        return mock_remote_lookup_client;
+      });
+  auto sharded_lookup = CreateShardedLookup(
+      mock_local_lookup_, num_shards_, shard_num_, *(*shard_manager),
+      key_sharder_, /*hot_key_cache=*/nullptr,
+      {.window = absl::Milliseconds(200)});
+  std::atomic<int> num_found = 0;
+  auto look_up = [&sharded_lookup, &num_found]() {
+    ScopeMetricsContext metrics_context;
+    RequestContext request_context(metrics_context);
+    const auto response =
+        sharded_lookup->GetKeyValues(request_context, {"key1"});
+    ASSERT_TRUE(response.ok()) << response.status();
+    if (response->kv_pairs().at("key1").value() == "value1") {
+      ++num_found;
+    }
+  };
+  std::vector<std::thread> lookups;
+  for (int i = 0; i < 3; ++i) {
+    lookups.emplace_back(look_up);
+  }
+  for (auto& lookup : lookups) {
+    lookup.join();
+  }
+  EXPECT_EQ(num_found, 3);
+  EXPECT_EQ(num_remote_calls, 1);
+}
+
+TEST_F(ShardedLookupTest, GetKeyValues_FullBatchDoesntWaitForItsWindow) {
+  EXPECT_CALL(mock_local_lookup_, GetKeyValues(_, _))
+      .WillOnce(Return(InternalLookupResponse()));
+  std::vector<absl::flat_hash_set<std::string>> cluster_mappings;
+  for (int i = 0; i < 2; i++) {
+    cluster_mappings.push_back({std::to_string(i)});
+  }
+  auto shard_manager = ShardManager::Create(
+      num_shards_, std::move(cluster_mappings),
+      std::make_unique<MockRandomGenerator>(), [](const std::string& ip) {
+        auto mock_remote_lookup_client =
+            std::make_unique<MockRemoteLookupClient>();
+        EXPECT_CALL(*mock_remote_lookup_client, GetValues(_, _, _))
+            .WillRepeatedly(Return(InternalLookupResponse()));
+        return mock_remote_lookup_client;
+      });
+  auto sharded_lookup = CreateShardedLookup(
+      mock_local_lookup_, num_shards_, shard_num_, *(*shard_manager),
+      key_sharder_, /*hot_key_cache=*/nullptr,
+      {.window = absl::Hours(1), .max_keys = 1});
+
+  EXPECT_TRUE(
+      sharded_lookup->GetKeyValues(GetRequestContext(), {"key1", "key4"}).ok());
+}
+
+TEST_F(ShardedLookupTest, GetKeyValues_HotKeyIsServedFromCopy) {
+  InternalLookupResponse local_lookup_response;
+  TextFormat::ParseFromString(R"pb(kv_pairs {
+                                     key: "key4"
+                                     value { value: "value4" }
+                                   }
+                              )pb",
+                              &local_lookup_response);
+  EXPECT_CALL(mock_local_lookup_, GetKeyValues(_, _))
+      .WillRepeatedly(Return(local_lookup_response));
+
+  std::vector<absl::flat_hash_set<std::string>> cluster_mappings;
+  for (int i = 0; i < 2; i++) {
+    cluster_mappings.push_back({std::to_string(i)});
+  }
+  auto remote_lookups =
+      std::make_shared<std::vector<std::vector<std::string>>>();
+  auto shard_manager = ShardManager::Create(
+      num_shards_, std::move(cluster_mappings),
+      std::make_unique<MockRandomGenerator>(),
+      [remote_lookups](const std::string& ip) {
+        auto mock_remote_lookup_client =
+            std::make_unique<MockRemoteLookupClient>();
+        if (ip != "1") {
+          return mock_remote_lookup_client;
+        }
+        EXPECT_CALL(*mock_remote_lookup_client, GetValues(_, _, _))
+            .WillRepeatedly([remote_lookups](
+                                const RequestContext& request_context,
+                                const std::string_view serialized_message,
+                                const int32_t padding_length) {
+              InternalLookupRequest request;
+              EXPECT_TRUE(request.ParseFromString(serialized_message));
+              remote_lookups->emplace_back(request.keys().begin(),
+                                           request.keys().end());
+              InternalLookupResponse resp;
+              for (const auto& key : request.keys()) {
+                (*resp.mutable_kv_pairs())[key].set_value("value1");
+              }
+              return resp;
+            });
+        return mock_remote_lookup_client;
+      });
+  auto hot_key_cache = std::make_shared<HotKeyCache>(HotKeyCache::Options{
+      .max_keys = 10, .min_lookup_fraction = 0, .window_lookups = 1000});
+  auto sharded_lookup =
+      CreateShardedLookup(mock_local_lookup_, num_shards_, shard_num_,
+                          *(*shard_manager), key_sharder_, hot_key_cache);
+
+  InternalLookupResponse expected;
+  TextFormat::ParseFromString(R"pb(kv_pairs {
+                                     key: "key1"
+                                     value { value: "value1" }
+                                   }
+                                   kv_pairs {
+                                     key: "key4"
+                                     value { value: "value4" }
+                                   }
+                              )pb",
+                              &expected);
+  // The second lookup makes "key1" hot, the third is served from its copy.
+  for (int i = 0; i < 3; ++i) {
+    auto response =
+        sharded_lookup->GetKeyValues(GetRequestContext(), {"key1", "key4"});
+    ASSERT_TRUE(response.ok());
+    EXPECT_THAT(response.value(), EqualsProto(expected));
+  }
+  // Its shard is still sent a request, without the key.
+  EXPECT_THAT(*remote_lookups,
+              testing::ElementsAre(testing::ElementsAre("key1"),
+                                   testing::ElementsAre("key1"),
+                                   testing::IsEmpty()));
+}
+
 TEST_F(ShardedLookupTest, GetKeyValues_KeyMissing_ReturnsStatus) {
   InternalLookupResponse local_lookup_response;
   TextFormat::ParseFromString(
@@ -215,6 +558,29 @@ TEST_F(ShardedLookupTest, GetKeyValues_EmptyRequest_ReturnsEmptyResponse) {
   EXPECT_THAT(response.value(), EqualsProto(expected));
 }
 
+TEST_F(ShardedLookupTest, GetKeyValues_CancelledRequestAsksNoShard) {
+  EXPECT_CALL(mock_local_lookup_, GetKeyValues(_, _)).Times(0);
+  std::vector<absl::flat_hash_set<std::string>> cluster_mappings;
+  for (int i = 0; i < 2; i++) {
+    cluster_mappings.push_back({std::to_string(i)});
+  }
+  auto shard_manager = ShardManager::Create(
+      num_shards_, std::move(cluster_mappings),
+      std::make_unique<MockRandomGenerator>(), [](const std::string& ip) {
+        auto mock_remote_lookup_client =
+            std::make_unique<MockRemoteLookupClient>();
+        EXPECT_CALL(*mock_remote_lookup_client, GetValues(_, _, _)).Times(0);
+        return mock_remote_lookup_client;
+      });
+  auto sharded_lookup =
+      CreateShardedLookup(mock_local_lookup_, num_shards_, shard_num_,
+                          *(*shard_manager), key_sharder_);
+  GetRequestContext().EndCall();
+  auto response =
+      sharded_lookup->GetKeyValues(GetRequestContext(), {"key1", "key4"});
+  EXPECT_EQ(response.status().code(), absl::StatusCode::kCancelled);
+}
+
 TEST_F(ShardedLookupTest, GetKeyValues_FailedDownstreamRequest) {
   InternalLookupResponse local_lookup_response;
   TextFormat::ParseFromString(
@@ -459,6 +825,58 @@ TEST_F(ShardedLookupTest, GetKeyValues_ReturnsKeysFromCachePadding) {
   EXPECT_THAT(response.value(), EqualsProto(expected));
 }
 
+TEST_F(ShardedLookupTest, GetKeyValues_PadsRequestsToTheirSizeClass) {
+  InternalLookupResponse local_lookup_response;
+  TextFormat::ParseFromString(R"pb(kv_pairs {
+                                     key: "key4"
+                                     value { value: "value4" }
+                                   }
+                              )pb",
+                              &local_lookup_response);
+  EXPECT_CALL(mock_local_lookup_, GetKeyValues(_, _))
+      .WillOnce(Return(local_lookup_response));
+
+  std::vector<absl::flat_hash_set<std::string>> cluster_mappings;
+  for (int i = 0; i < 2; i++) {
+    cluster_mappings.push_back({std::to_string(i)});
+  }
+  auto shard_manager = ShardManager::Create(
+      num_shards_, std::move(cluster_mappings),
+      std::make_unique<MockRandomGenerator>(), [](const std::string& ip) {
+        if (ip != "1") {
+          return std::make_unique<MockRemoteLookupClient>();
+        }
+
+        auto mock_remote_lookup_client_1 =
+            std::make_unique<MockRemoteLookupClient>();
+        InternalLookupRequest request;
+        request.add_keys("key1");
+        const std::string serialized_request = request.SerializeAsString();
+        // The 6 byte request is padded to the 8 byte size class, rather than
+        // to the 4 byte one.
+        EXPECT_EQ(serialized_request.size(), 6);
+        EXPECT_CALL(*mock_remote_lookup_client_1,
+                    GetValues(_, serialized_request, 2))
+            .WillOnce([&]() {
+              InternalLookupResponse resp;
+              SingleLookupResult result;
+              result.set_value("value1");
+              (*resp.mutable_kv_pairs())["key1"] = result;
+              return resp;
+            });
+
+        return mock_remote_lookup_client_1;
+      });
+  auto sharded_lookup = CreateShardedLookup(
+      mock_local_lookup_, num_shards_, shard_num_, *(*shard_manager),
+      key_sharder_, /*hot_key_cache=*/nullptr, /*batching_options=*/{},
+      {.min_size_class_bytes = 4});
+  auto response =
+      sharded_lookup->GetKeyValues(GetRequestContext(), {"key1", "key4"});
+  EXPECT_TRUE(response.ok());
+  EXPECT_EQ(response->kv_pairs().at("key1").value(), "value1");
+}
+
 TEST_F(ShardedLookupTest, GetKeyValueSets_KeysFound_Success) {
   InternalLookupResponse local_lookup_response;
   TextFormat::ParseFromString(
@@ -676,7 +1094,7 @@ TEST_F(ShardedLookupTest, GetKeyValueSet_FailedDownstreamRequest) {
   EXPECT_EQ(response.status().code(), absl::StatusCode::kDeadlineExceeded);
 }
 
-TEST_F(ShardedLookupTest, RunQuery_Success) {
+TEST_F(ShardedLookupTest, GetKeyValueSet_PartialKeySetsKeepOtherShards) {
   InternalLookupResponse local_lookup_response;
   TextFormat::ParseFromString(
       R"pb(kv_pairs {
@@ -695,37 +1113,182 @@ TEST_F(ShardedLookupTest, RunQuery_Success) {
   auto shard_manager = ShardManager::Create(
       num_shards_, std::move(cluster_mappings),
       std::make_unique<MockRandomGenerator>(), [](const std::string& ip) {
-        if (ip != "1") {
-          return std::make_unique<MockRemoteLookupClient>();
+        auto mock_remote_lookup_client =
+            std::make_unique<MockRemoteLookupClient>();
+        if (ip == "1") {
+          EXPECT_CALL(*mock_remote_lookup_client, GetValues(_, _, _))
+              .WillOnce(
+                  []() { return absl::DeadlineExceededError("too long"); });
         }
+        return mock_remote_lookup_client;
+      });
 
-        auto mock_remote_lookup_client_1 =
-            std::make_unique<MockRemoteLookupClient>();
-        const std::vector<std::string_view> key_list_remote = {"key1"};
-        InternalLookupRequest request;
-        request.mutable_keys()->Assign(key_list_remote.begin(),
-                                       key_list_remote.end());
-        request.set_lookup_sets(true);
-        const std::string serialized_request = request.SerializeAsString();
-        EXPECT_CALL(*mock_remote_lookup_client_1,
-                    GetValues(_, serialized_request, 0))
-            .WillOnce([&]() {
-              InternalLookupResponse resp;
-              TextFormat::ParseFromString(
-                  R"pb(kv_pairs {
-                         key: "key1"
-                         value { keyset_values { values: "value1" } }
-                       }
-                  )pb",
-                  &resp);
-              return resp;
-            });
+  auto sharded_lookup = CreateShardedLookup(
+      mock_local_lookup_, num_shards_, shard_num_, *(*shard_manager),
+      key_sharder_, /*hot_key_cache=*/nullptr, /*batching_options=*/{},
+      /*padding_options=*/{}, {.partial_key_sets = true});
+  auto response =
+      sharded_lookup->GetKeyValueSet(GetRequestContext(), {"key1", "key4"});
+  ASSERT_TRUE(response.ok());
+  EXPECT_EQ(response->kv_pairs().at("key4").keyset_values().values(0),
+            "value4");
+  EXPECT_EQ(response->kv_pairs().at("key1").status().code(),
+            static_cast<int>(absl::StatusCode::kInternal));
+}
 
-        return mock_remote_lookup_client_1;
-      });
+TEST_F(ShardedLookupTest, GetKeyValues_OpenCircuitFailsShardWithoutLookup) {
+  EXPECT_CALL(mock_local_lookup_, GetKeyValues(_, _))
+      .Times(2)
+      .WillRepeatedly(Return(InternalLookupResponse()));
 
-  auto sharded_lookup =
-      CreateShardedLookup(mock_local_lookup_, num_shards_, shard_num_,
+  std::vector<absl::flat_hash_set<std::string>> cluster_mappings;
+  for (int i = 0; i < 2; i++) {
+    cluster_mappings.push_back({std::to_string(i)});
+  }
+  auto shard_manager = ShardManager::Create(
+      num_shards_, std::move(cluster_mappings),
+      std::make_unique<MockRandomGenerator>(), [](const std::string& ip) {
+        auto mock_remote_lookup_client =
+            std::make_unique<MockRemoteLookupClient>();
+        if (ip == "1") {
+          // The failed lookup trips the breaker, so the second isn't sent.
+          EXPECT_CALL(*mock_remote_lookup_client, GetValues(_, _, _))
+              .WillOnce([]() { return absl::UnavailableError("down"); });
+        }
+        return mock_remote_lookup_client;
+      });
+
+  auto sharded_lookup = CreateShardedLookup(
+      mock_local_lookup_, num_shards_, shard_num_, *(*shard_manager),
+      key_sharder_, /*hot_key_cache=*/nullptr, /*batching_options=*/{},
+      /*padding_options=*/{},
+      {.circuit_breaker = std::make_shared<ShardCircuitBreaker>(
+           num_shards_, ShardCircuitBreaker::Options{
+                            .failure_threshold = 1,
+                            .open_duration = absl::Hours(1)})});
+  for (int i = 0; i < 2; i++) {
+    auto response =
+        sharded_lookup->GetKeyValues(GetRequestContext(), {"key1", "key4"});
+    ASSERT_TRUE(response.ok());
+    EXPECT_EQ(response->kv_pairs().at("key1").status().code(),
+              static_cast<int>(absl::StatusCode::kInternal));
+  }
+}
+
+TEST_F(ShardedLookupTest, GetKeyValuesAndSets_SendsOneRequestPerShard) {
+  InternalLookupResponse local_lookup_response;
+  TextFormat::ParseFromString(R"pb(kv_pairs {
+                                     key: "key4"
+                                     value { value: "value4" }
+                                   }
+                              )pb",
+                              &local_lookup_response);
+  EXPECT_CALL(mock_local_lookup_, GetKeyValues(_, _))
+      .WillOnce(Return(local_lookup_response));
+  EXPECT_CALL(mock_local_lookup_, GetKeyValueSet(_, _)).Times(0);
+
+  std::vector<absl::flat_hash_set<std::string>> cluster_mappings;
+  for (int i = 0; i < 2; i++) {
+    cluster_mappings.push_back({std::to_string(i)});
+  }
+  auto shard_manager = ShardManager::Create(
+      num_shards_, std::move(cluster_mappings),
+      std::make_unique<MockRandomGenerator>(), [](const std::string& ip) {
+        auto mock_remote_lookup_client =
+            std::make_unique<MockRemoteLookupClient>();
+        if (ip != "1") {
+          return mock_remote_lookup_client;
+        }
+        InternalLookupRequest request;
+        request.add_keys("key1");
+        request.add_set_keys("key5");
+        EXPECT_CALL(*mock_remote_lookup_client,
+                    GetValues(_, request.SerializeAsString(), 0))
+            .WillOnce([]() {
+              InternalLookupResponse resp;
+              (*resp.mutable_kv_pairs())["key1"].set_value("value1");
+              (*resp.mutable_kv_pairs())["key5"]
+                  .mutable_keyset_values()
+                  ->add_values("a");
+              return resp;
+            });
+        return mock_remote_lookup_client;
+      });
+  auto sharded_lookup =
+      CreateShardedLookup(mock_local_lookup_, num_shards_, shard_num_,
+                          *(*shard_manager), key_sharder_);
+  auto response = sharded_lookup->GetKeyValuesAndSets(
+      GetRequestContext(), {"key1", "key4"}, {"key5"});
+  ASSERT_TRUE(response.ok());
+
+  InternalLookupResponse expected;
+  TextFormat::ParseFromString(R"pb(kv_pairs {
+                                     key: "key1"
+                                     value { value: "value1" }
+                                   }
+                                   kv_pairs {
+                                     key: "key4"
+                                     value { value: "value4" }
+                                   }
+                                   kv_pairs {
+                                     key: "key5"
+                                     value { keyset_values { values: "a" } }
+                                   }
+                              )pb",
+                              &expected);
+  EXPECT_THAT(response.value(), EqualsProto(expected));
+}
+
+TEST_F(ShardedLookupTest, RunQuery_Success) {
+  InternalLookupResponse local_lookup_response;
+  TextFormat::ParseFromString(
+      R"pb(kv_pairs {
+             key: "key4"
+             value { keyset_values { values: "value4" } }
+           }
+      )pb",
+      &local_lookup_response);
+  EXPECT_CALL(mock_local_lookup_, GetKeyValueSet(_, _))
+      .WillOnce(Return(local_lookup_response));
+
+  std::vector<absl::flat_hash_set<std::string>> cluster_mappings;
+  for (int i = 0; i < 2; i++) {
+    cluster_mappings.push_back({std::to_string(i)});
+  }
+  auto shard_manager = ShardManager::Create(
+      num_shards_, std::move(cluster_mappings),
+      std::make_unique<MockRandomGenerator>(), [](const std::string& ip) {
+        if (ip != "1") {
+          return std::make_unique<MockRemoteLookupClient>();
+        }
+
+        auto mock_remote_lookup_client_1 =
+            std::make_unique<MockRemoteLookupClient>();
+        const std::vector<std::string_view> key_list_remote = {"key1"};
+        InternalLookupRequest request;
+        request.mutable_keys()->Assign(key_list_remote.begin(),
+                                       key_list_remote.end());
+        request.set_lookup_sets(true);
+        const std::string serialized_request = request.SerializeAsString();
+        EXPECT_CALL(*mock_remote_lookup_client_1,
+                    GetValues(_, serialized_request, 0))
+            .WillOnce([&]() {
+              InternalLookupResponse resp;
+              TextFormat::ParseFromString(
+                  R"pb(kv_pairs {
+                         key: "key1"
+                         value { keyset_values { values: "value1" } }
+                       }
+                  )pb",
+                  &resp);
+              return resp;
+            });
+
+        return mock_remote_lookup_client_1;
+      });
+
+  auto sharded_lookup =
+      CreateShardedLookup(mock_local_lookup_, num_shards_, shard_num_,
                           *(*shard_manager), key_sharder_);
   auto response = sharded_lookup->RunQuery(GetRequestContext(), "key1|key4");
   EXPECT_TRUE(response.ok());
@@ -734,6 +1297,65 @@ TEST_F(ShardedLookupTest, RunQuery_Success) {
               testing::UnorderedElementsAreArray({"value1", "value4"}));
 }
 
+TEST_F(ShardedLookupTest, RunQuery_Count_CountsTheCombinedResult) {
+  InternalLookupResponse local_lookup_response;
+  TextFormat::ParseFromString(
+      R"pb(kv_pairs {
+             key: "key4"
+             value { keyset_values { values: "value4" } }
+           }
+      )pb",
+      &local_lookup_response);
+  EXPECT_CALL(mock_local_lookup_, GetKeyValueSet(_, _))
+      .WillOnce(Return(local_lookup_response));
+
+  std::vector<absl::flat_hash_set<std::string>> cluster_mappings;
+  for (int i = 0; i < 2; i++) {
+    cluster_mappings.push_back({std::to_string(i)});
+  }
+  auto shard_manager = ShardManager::Create(
+      num_shards_, std::move(cluster_mappings),
+      std::make_unique<MockRandomGenerator>(), [](const std::string& ip) {
+        if (ip != "1") {
+          return std::make_unique<MockRemoteLookupClient>();
+        }
+
+        auto mock_remote_lookup_client_1 =
+            std::make_unique<MockRemoteLookupClient>();
+        const std::vector<std::string_view> key_list_remote = {"key1"};
+        InternalLookupRequest request;
+        request.mutable_keys()->Assign(key_list_remote.begin(),
+                                       key_list_remote.end());
+        request.set_lookup_sets(true);
+        const std::string serialized_request = request.SerializeAsString();
+        EXPECT_CALL(*mock_remote_lookup_client_1,
+                    GetValues(_, serialized_request, 0))
+            .WillOnce([&]() {
+              InternalLookupResponse resp;
+              TextFormat::ParseFromString(
+                  R"pb(kv_pairs {
+                         key: "key1"
+                         value { keyset_values { values: "value1" } }
+                       }
+                  )pb",
+                  &resp);
+              return resp;
+            });
+
+        return mock_remote_lookup_client_1;
+      });
+
+  auto sharded_lookup =
+      CreateShardedLookup(mock_local_lookup_, num_shards_, shard_num_,
+                          *(*shard_manager), key_sharder_);
+  auto response =
+      sharded_lookup->RunQuery(GetRequestContext(), "COUNT key1|key4");
+  ASSERT_TRUE(response.ok());
+
+  EXPECT_TRUE(response.value().elements().empty());
+  EXPECT_EQ(response.value().count(), 2);
+}
+
 TEST_F(ShardedLookupTest, RunQuery_MissingKeySet_IgnoresMissingSet_Success) {
   InternalLookupResponse local_lookup_response;
   TextFormat::ParseFromString(
@@ -792,6 +1414,214 @@ TEST_F(ShardedLookupTest, RunQuery_MissingKeySet_IgnoresMissingSet_Success) {
               testing::UnorderedElementsAreArray({"value1"}));
 }
 
+TEST_F(ShardedLookupTest, RunQuery_SingleShardSubtree_IsPushedDown) {
+  InternalLookupResponse local_lookup_response;
+  TextFormat::ParseFromString(
+      R"pb(kv_pairs {
+             key: "key4"
+             value { keyset_values { values: "value4" } }
+           }
+      )pb",
+      &local_lookup_response);
+  EXPECT_CALL(mock_local_lookup_, GetKeyValueSet(_, _))
+      .WillOnce(Return(local_lookup_response));
+
+  std::vector<absl::flat_hash_set<std::string>> cluster_mappings;
+  for (int i = 0; i < 2; i++) {
+    cluster_mappings.push_back({std::to_string(i)});
+  }
+  auto shard_manager = ShardManager::Create(
+      num_shards_, std::move(cluster_mappings),
+      std::make_unique<MockRandomGenerator>(), [](const std::string& ip) {
+        if (ip != "1") {
+          return std::make_unique<MockRemoteLookupClient>();
+        }
+
+        auto mock_remote_lookup_client_1 =
+            std::make_unique<MockRemoteLookupClient>();
+        EXPECT_CALL(*mock_remote_lookup_client_1, GetValues(_, _, _))
+            .WillOnce([](const RequestContext& request_context,
+                         const std::string_view serialized_message,
+                         const int32_t padding_length) {
+              InternalLookupRequest request;
+              EXPECT_TRUE(request.ParseFromString(serialized_message));
+              EXPECT_TRUE(request.keys().empty());
+              EXPECT_THAT(request.queries(),
+                          testing::ElementsAre(R"(("key1" & "key5"))"));
+              InternalLookupResponse resp;
+              TextFormat::ParseFromString(
+                  R"pb(kv_pairs {
+                         key: "(\"key1\" & \"key5\")"
+                         value { keyset_values { values: "value1" } }
+                       }
+                  )pb",
+                  &resp);
+              return resp;
+            });
+
+        return mock_remote_lookup_client_1;
+      });
+
+  auto sharded_lookup =
+      CreateShardedLookup(mock_local_lookup_, num_shards_, shard_num_,
+                          *(*shard_manager), key_sharder_);
+  auto response =
+      sharded_lookup->RunQuery(GetRequestContext(), "(key1 & key5) | key4");
+  ASSERT_TRUE(response.ok());
+
+  EXPECT_THAT(response.value().elements(),
+              testing::UnorderedElementsAreArray({"value1", "value4"}));
+}
+
+TEST_F(ShardedLookupTest, RunQuery_RepeatedSubtree_IsSentOnce) {
+  InternalLookupResponse local_lookup_response;
+  TextFormat::ParseFromString(
+      R"pb(kv_pairs {
+             key: "key4"
+             value { keyset_values { values: "value4" } }
+           }
+      )pb",
+      &local_lookup_response);
+  EXPECT_CALL(mock_local_lookup_, GetKeyValueSet(_, _))
+      .WillOnce(Return(local_lookup_response));
+
+  std::vector<absl::flat_hash_set<std::string>> cluster_mappings;
+  for (int i = 0; i < 2; i++) {
+    cluster_mappings.push_back({std::to_string(i)});
+  }
+  auto shard_manager = ShardManager::Create(
+      num_shards_, std::move(cluster_mappings),
+      std::make_unique<MockRandomGenerator>(), [](const std::string& ip) {
+        if (ip != "1") {
+          return std::make_unique<MockRemoteLookupClient>();
+        }
+
+        auto mock_remote_lookup_client_1 =
+            std::make_unique<MockRemoteLookupClient>();
+        EXPECT_CALL(*mock_remote_lookup_client_1, GetValues(_, _, _))
+            .WillOnce([](const RequestContext& request_context,
+                         const std::string_view serialized_message,
+                         const int32_t padding_length) {
+              InternalLookupRequest request;
+              EXPECT_TRUE(request.ParseFromString(serialized_message));
+              EXPECT_THAT(request.queries(),
+                          testing::ElementsAre(R"(("key1" & "key5"))"));
+              InternalLookupResponse resp;
+              TextFormat::ParseFromString(
+                  R"pb(kv_pairs {
+                         key: "(\"key1\" & \"key5\")"
+                         value { keyset_values { values: "value1" } }
+                       }
+                  )pb",
+                  &resp);
+              return resp;
+            });
+
+        return mock_remote_lookup_client_1;
+      });
+
+  auto sharded_lookup =
+      CreateShardedLookup(mock_local_lookup_, num_shards_, shard_num_,
+                          *(*shard_manager), key_sharder_);
+  auto response = sharded_lookup->RunQuery(
+      GetRequestContext(), "((key1 & key5) | key4) - (key1 & key5)");
+  ASSERT_TRUE(response.ok());
+
+  EXPECT_THAT(response.value().elements(),
+              testing::UnorderedElementsAreArray({"value4"}));
+}
+
+TEST_F(ShardedLookupTest, RunQuery_LocalSubtree_RunsLocalQuery) {
+  InternalRunQueryResponse local_query_response;
+  local_query_response.add_elements("value4");
+  EXPECT_CALL(mock_local_lookup_, RunQuery(_, R"(("key4" & "key4"))"))
+      .WillOnce(Return(local_query_response));
+
+  std::vector<absl::flat_hash_set<std::string>> cluster_mappings;
+  for (int i = 0; i < 2; i++) {
+    cluster_mappings.push_back({std::to_string(i)});
+  }
+  auto shard_manager = ShardManager::Create(
+      num_shards_, std::move(cluster_mappings),
+      std::make_unique<MockRandomGenerator>(), [](const std::string& ip) {
+        if (ip != "1") {
+          return std::make_unique<MockRemoteLookupClient>();
+        }
+
+        auto mock_remote_lookup_client_1 =
+            std::make_unique<MockRemoteLookupClient>();
+        EXPECT_CALL(*mock_remote_lookup_client_1, GetValues(_, _, _))
+            .WillOnce([](const RequestContext& request_context,
+                         const std::string_view serialized_message,
+                         const int32_t padding_length) {
+              InternalLookupRequest request;
+              EXPECT_TRUE(request.ParseFromString(serialized_message));
+              EXPECT_THAT(request.keys(), testing::ElementsAre("key1"));
+              EXPECT_TRUE(request.queries().empty());
+              InternalLookupResponse resp;
+              TextFormat::ParseFromString(
+                  R"pb(kv_pairs {
+                         key: "key1"
+                         value { keyset_values { values: "value1" } }
+                       }
+                  )pb",
+                  &resp);
+              return resp;
+            });
+
+        return mock_remote_lookup_client_1;
+      });
+
+  auto sharded_lookup =
+      CreateShardedLookup(mock_local_lookup_, num_shards_, shard_num_,
+                          *(*shard_manager), key_sharder_);
+  auto response =
+      sharded_lookup->RunQuery(GetRequestContext(), "key4 & key4 | key1");
+  ASSERT_TRUE(response.ok());
+
+  EXPECT_THAT(response.value().elements(),
+              testing::UnorderedElementsAreArray({"value1", "value4"}));
+}
+
+TEST_F(ShardedLookupTest, RunQuery_PushedDownQueryFails_Error) {
+  std::vector<absl::flat_hash_set<std::string>> cluster_mappings;
+  for (int i = 0; i < 2; i++) {
+    cluster_mappings.push_back({std::to_string(i)});
+  }
+  auto shard_manager = ShardManager::Create(
+      num_shards_, std::move(cluster_mappings),
+      std::make_unique<MockRandomGenerator>(), [](const std::string& ip) {
+        if (ip != "1") {
+          return std::make_unique<MockRemoteLookupClient>();
+        }
+
+        auto mock_remote_lookup_client_1 =
+            std::make_unique<MockRemoteLookupClient>();
+        EXPECT_CALL(*mock_remote_lookup_client_1, GetValues(_, _, _))
+            .WillOnce([]() {
+              InternalLookupResponse resp;
+              TextFormat::ParseFromString(
+                  R"pb(kv_pairs {
+                         key: "(\"key1\" - \"key5\")"
+                         value { status { code: 13 } }
+                       }
+                  )pb",
+                  &resp);
+              return resp;
+            });
+
+        return mock_remote_lookup_client_1;
+      });
+
+  auto sharded_lookup =
+      CreateShardedLookup(mock_local_lookup_, num_shards_, shard_num_,
+                          *(*shard_manager), key_sharder_);
+  auto response = sharded_lookup->RunQuery(GetRequestContext(), "key1 - key5");
+  EXPECT_FALSE(response.ok());
+
+  EXPECT_THAT(response.status().code(), absl::StatusCode::kInternal);
+}
+
 TEST_F(ShardedLookupTest, RunQuery_ShardedLookupFails_Error) {
   InternalLookupResponse local_lookup_response;
   TextFormat::ParseFromString(
@@ -13,6 +13,7 @@
 // limitations under the License.
 #include "components/internal_server/string_padder.h"
 
+#include <cstdint>
 #include <string>
 
 #include "absl/log/log.h"
@@ -22,16 +23,20 @@
 namespace kv_server {
 
 std::string Pad(std::string_view string_to_pad, int32_t extra_padding) {
-  int output_size = sizeof(u_int32_t) + string_to_pad.size() + extra_padding;
-  std::string output(output_size, '0');
-
-  quiche::QuicheDataWriter data_writer(output.size(), output.data());
-  data_writer.WriteUInt32(string_to_pad.size());
-  data_writer.WriteStringPiece(string_to_pad);
+  // The buffer is allocated once at its final size, and each byte is written
+  // once: the length, the string, then the filler.
+  std::string output;
+  output.reserve(sizeof(uint32_t) + string_to_pad.size() + extra_padding);
+  char length[sizeof(uint32_t)];
+  quiche::QuicheDataWriter length_writer(sizeof(length), length);
+  length_writer.WriteUInt32(string_to_pad.size());
+  output.append(length, sizeof(length));
+  output.append(string_to_pad);
+  output.append(extra_padding, '0');
   return output;
 }
 
-absl::StatusOr<std::string> Unpad(std::string_view padded_string) {
+absl::StatusOr<std::string_view> Unpad(std::string_view padded_string) {
   auto data_reader = quiche::QuicheDataReader(padded_string);
   uint32_t string_size = 0;
   if (!data_reader.ReadUInt32(&string_size)) {
@@ -43,7 +48,7 @@ absl::StatusOr<std::string> Unpad(std::string_view padded_string) {
     return absl::InvalidArgumentError("Failed to read a string");
   }
   VLOG(9) << "string: " << output;
-  return std::string(output);
+  return output;
 }
 
 }  // namespace kv_server
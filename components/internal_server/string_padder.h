@@ -17,7 +17,9 @@
 #ifndef COMPONENTS_INTERNAL_SERVER_STRING_PADDER_H_
 #define COMPONENTS_INTERNAL_SERVER_STRING_PADDER_H_
 
+#include <cstdint>
 #include <string>
+#include <string_view>
 
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
@@ -29,8 +31,8 @@ namespace kv_server {
 // filler.size() == extra_padding
 std::string Pad(std::string_view string_to_pad, int32_t extra_padding);
 // Takes the string padded with the method above OR in the same format
-// and returns the string.
-absl::StatusOr<std::string> Unpad(std::string_view padded_string);
+// and returns the string, as a view of `padded_string`.
+absl::StatusOr<std::string_view> Unpad(std::string_view padded_string);
 }  // namespace kv_server
 
 #endif  // COMPONENTS_INTERNAL_SERVER_STRING_PADDER_H_
@@ -14,6 +14,8 @@
 
 #include "components/internal_server/string_padder.h"
 
+#include <cstdint>
+#include <string>
 #include <string_view>
 
 #include "gtest/gtest.h"
@@ -57,6 +59,18 @@ TEST(PadUnpadEmtpyString, Success) {
   EXPECT_EQ(*original_string_status, kTestString);
 }
 
+TEST(UnpadReturnsViewOfPaddedString, Success) {
+  const std::string padded_string = kv_server::Pad("string to pad", 10);
+  auto original_string_status = Unpad(padded_string);
+  ASSERT_TRUE(original_string_status.ok());
+  EXPECT_EQ(original_string_status->data(),
+            padded_string.data() + sizeof(uint32_t));
+}
+
+TEST(PadFillsPadding, Success) {
+  EXPECT_EQ(kv_server::Pad("ab", 3), std::string("\0\0\0\2ab000", 9));
+}
+
 TEST(UnpadFailure, Success) {
   auto original_string_status = Unpad("garbage");
   ASSERT_FALSE(original_string_status.ok());
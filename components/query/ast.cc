@@ -20,11 +20,11 @@
 #include <vector>
 
 #include "absl/container/flat_hash_set.h"
+#include "absl/strings/str_cat.h"
 #include "components/query/sets.h"
 
 namespace kv_server {
 
-namespace {
 // Traverses the binary tree starting at root.
 // Returns a vector of `Node`s in post order.
 // This is represents the infix input as postfix.
@@ -48,8 +48,6 @@ std::vector<const Node*> PostOrderTraversal(const Node* root) {
   return result;
 }
 
-}  // namespace
-
 void ASTStackVisitor::Visit(const OpNode& node, std::vector<KVSetView>& stack) {
   KVSetView right = std::move(stack.back());
   stack.pop_back();
@@ -60,12 +58,27 @@ void ASTStackVisitor::Visit(const OpNode& node, std::vector<KVSetView>& stack) {
 
 void ASTStackVisitor::Visit(const ValueNode& node,
                             std::vector<KVSetView>& stack) {
-  stack.emplace_back(node.Lookup());
+  stack.emplace_back(lookup_fn_.has_value() ? (*lookup_fn_)(node.Key())
+                                            : node.Lookup());
+}
+
+void ASTBitmapStackVisitor::Visit(const OpNode& node,
+                                  std::vector<IdBitmap>& stack) {
+  IdBitmap right = std::move(stack.back());
+  stack.pop_back();
+  IdBitmap left = std::move(stack.back());
+  stack.pop_back();
+  stack.emplace_back(node.Op(std::move(left), std::move(right)));
+}
+
+void ASTBitmapStackVisitor::Visit(const ValueNode& node,
+                                  std::vector<IdBitmap>& stack) {
+  stack.emplace_back(lookup_fn_(node.Key()));
 }
 
-KVSetView Compute(const std::vector<const Node*>& postorder) {
+KVSetView Compute(const std::vector<const Node*>& postorder,
+                  ASTStackVisitor& visitor) {
   std::vector<KVSetView> stack;
-  ASTStackVisitor visitor;
   // Apply the operations on the postorder stack
   for (const auto* node : postorder) {
     node->Accept(visitor, stack);
@@ -75,7 +88,24 @@ KVSetView Compute(const std::vector<const Node*>& postorder) {
 
 KVSetView Eval(const Node& node) {
   std::vector<const Node*> postorder = PostOrderTraversal(&node);
-  return Compute(postorder);
+  ASTStackVisitor visitor;
+  return Compute(postorder, visitor);
+}
+
+KVSetView Eval(const Node& node,
+               absl::FunctionRef<KVSetView(std::string_view key)> lookup_fn) {
+  ASTStackVisitor visitor(lookup_fn);
+  return Compute(PostOrderTraversal(&node), visitor);
+}
+
+IdBitmap Eval(const Node& node,
+              absl::FunctionRef<IdBitmap(std::string_view key)> lookup_fn) {
+  std::vector<IdBitmap> stack;
+  ASTBitmapStackVisitor visitor(lookup_fn);
+  for (const auto* postorder_node : PostOrderTraversal(&node)) {
+    postorder_node->Accept(visitor, stack);
+  }
+  return std::move(stack.back());
 }
 
 void OpNode::Accept(ASTStackVisitor& visitor,
@@ -83,6 +113,43 @@ void OpNode::Accept(ASTStackVisitor& visitor,
   visitor.Visit(*this, stack);
 }
 
+void OpNode::Accept(ASTBitmapStackVisitor& visitor,
+                    std::vector<IdBitmap>& stack) const {
+  visitor.Visit(*this, stack);
+}
+
+namespace {
+
+// Prints the tree back as a query, see `ToQueryString`.
+class QueryStringVisitor : public ASTStringVisitor {
+ public:
+  std::string Visit(const UnionNode& node) override {
+    return ToString(node, "|");
+  }
+  std::string Visit(const DifferenceNode& node) override {
+    return ToString(node, "-");
+  }
+  std::string Visit(const IntersectionNode& node) override {
+    return ToString(node, "&");
+  }
+  std::string Visit(const ValueNode& node) override {
+    return absl::StrCat("\"", node.Key(), "\"");
+  }
+
+ private:
+  std::string ToString(const OpNode& node, std::string_view op) {
+    return absl::StrCat("(", node.Left()->Accept(*this), " ", op, " ",
+                        node.Right()->Accept(*this), ")");
+  }
+};
+
+}  // namespace
+
+std::string ToQueryString(const Node& root) {
+  QueryStringVisitor visitor;
+  return root.Accept(visitor);
+}
+
 std::string UnionNode::Accept(ASTStringVisitor& visitor) const {
   return visitor.Visit(*this);
 }
@@ -129,10 +196,25 @@ void ValueNode::Accept(ASTStackVisitor& visitor,
   visitor.Visit(*this, stack);
 }
 
+void ValueNode::Accept(ASTBitmapStackVisitor& visitor,
+                       std::vector<IdBitmap>& stack) const {
+  visitor.Visit(*this, stack);
+}
+
 std::string ValueNode::Accept(ASTStringVisitor& visitor) const {
   return visitor.Visit(*this);
 }
 
+bool ValueNode::Contains(
+    absl::FunctionRef<bool(std::string_view key)> is_member) const {
+  return is_member(key_);
+}
+
+bool OpNode::Contains(
+    absl::FunctionRef<bool(std::string_view key)> is_member) const {
+  return Op(left_->Contains(is_member), right_->Contains(is_member));
+}
+
 absl::flat_hash_set<std::string_view> ValueNode::Keys() const {
   // Return a set containing a view into this instances, `key_`.
   // Be sure that the reference is not to any temp string.
@@ -17,6 +17,7 @@
 #ifndef COMPONENTS_QUERY_AST_H_
 #define COMPONENTS_QUERY_AST_H_
 #include <memory>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <utility>
@@ -25,9 +26,12 @@
 #include "absl/container/flat_hash_set.h"
 #include "absl/functional/any_invocable.h"
 #include "absl/functional/bind_front.h"
+#include "absl/functional/function_ref.h"
+#include "components/query/id_bitmap.h"
 #include "components/query/sets.h"
 
 namespace kv_server {
+class ASTBitmapStackVisitor;
 class ASTStackVisitor;
 class ASTStringVisitor;
 
@@ -47,7 +51,13 @@ class Node {
   // to mutate the stack accordingly for `Eval` (ValueNode vs. OpNode)
   virtual void Accept(ASTStackVisitor& visitor,
                       std::vector<KVSetView>& stack) const = 0;
+  virtual void Accept(ASTBitmapStackVisitor& visitor,
+                      std::vector<IdBitmap>& stack) const = 0;
   virtual std::string Accept(ASTStringVisitor& visitor) const = 0;
+  // Returns whether the result of the tree has the elements that are members
+  // of the sets of exactly the keys for which `is_member` returns true.
+  virtual bool Contains(
+      absl::FunctionRef<bool(std::string_view key)> is_member) const = 0;
 };
 
 // The value associated with a `ValueNode` is the set with its associated `key`.
@@ -56,10 +66,15 @@ class ValueNode : public Node {
   ValueNode(absl::AnyInvocable<KVSetView(std::string_view key) const> lookup_fn,
             std::string key);
   absl::flat_hash_set<std::string_view> Keys() const override;
+  std::string_view Key() const { return key_; }
   KVSetView Lookup() const;
   void Accept(ASTStackVisitor& visitor,
               std::vector<KVSetView>& stack) const override;
+  void Accept(ASTBitmapStackVisitor& visitor,
+              std::vector<IdBitmap>& stack) const override;
   std::string Accept(ASTStringVisitor& visitor) const override;
+  bool Contains(absl::FunctionRef<bool(std::string_view key)> is_member)
+      const override;
 
  private:
   absl::AnyInvocable<KVSetView() const> lookup_fn_;
@@ -75,8 +90,16 @@ class OpNode : public Node {
   inline Node* Right() const override { return right_.get(); }
   // Computes the operation over the `left` and `right` nodes.
   virtual KVSetView Op(KVSetView left, KVSetView right) const = 0;
+  virtual IdBitmap Op(IdBitmap left, IdBitmap right) const = 0;
+  // Computes whether an element is in the result from whether it is in the
+  // results of the `left` and `right` nodes.
+  virtual bool Op(bool left, bool right) const = 0;
   void Accept(ASTStackVisitor& visitor,
               std::vector<KVSetView>& stack) const override;
+  void Accept(ASTBitmapStackVisitor& visitor,
+              std::vector<IdBitmap>& stack) const override;
+  bool Contains(absl::FunctionRef<bool(std::string_view key)> is_member)
+      const override;
 
  private:
   std::unique_ptr<Node> left_;
@@ -90,6 +113,12 @@ class UnionNode : public OpNode {
   inline KVSetView Op(KVSetView left, KVSetView right) const override {
     return Union(std::move(left), std::move(right));
   }
+  inline IdBitmap Op(IdBitmap left, IdBitmap right) const override {
+    return Union(std::move(left), std::move(right));
+  }
+  inline bool Op(bool left, bool right) const override {
+    return left || right;
+  }
   std::string Accept(ASTStringVisitor& visitor) const override;
 };
 
@@ -100,6 +129,12 @@ class IntersectionNode : public OpNode {
   inline KVSetView Op(KVSetView left, KVSetView right) const override {
     return Intersection(std::move(left), std::move(right));
   }
+  inline IdBitmap Op(IdBitmap left, IdBitmap right) const override {
+    return Intersection(std::move(left), std::move(right));
+  }
+  inline bool Op(bool left, bool right) const override {
+    return left && right;
+  }
   std::string Accept(ASTStringVisitor& visitor) const override;
 };
 
@@ -110,21 +145,71 @@ class DifferenceNode : public OpNode {
   inline KVSetView Op(KVSetView left, KVSetView right) const override {
     return Difference(std::move(left), std::move(right));
   }
+  inline IdBitmap Op(IdBitmap left, IdBitmap right) const override {
+    return Difference(std::move(left), std::move(right));
+  }
+  inline bool Op(bool left, bool right) const override {
+    return left && !right;
+  }
   std::string Accept(ASTStringVisitor& visitor) const override;
 };
 
+// Returns the nodes of the tree at `root` in post order, the operands of an
+// operation before it.
+std::vector<const Node*> PostOrderTraversal(const Node* root);
+
+// Returns a query that parses to the tree at `root`. Every operation is
+// parenthesized and every key quoted, so the query keeps the structure of the
+// tree whatever the keys are.
+std::string ToQueryString(const Node& root);
+
 // Creates execution plan and runs it.
 KVSetView Eval(const Node& node);
 
+// Same as above, with the sets of the `ValueNode`s given by `lookup_fn`
+// instead of their own lookup functions, so that one tree can be evaluated
+// over different data.
+KVSetView Eval(const Node& node,
+               absl::FunctionRef<KVSetView(std::string_view key)> lookup_fn);
+
+// Same as above, with the sets of the `ValueNode`s given by `lookup_fn` as
+// member id bitmaps. The result holds ids of the same members.
+IdBitmap Eval(const Node& node,
+              absl::FunctionRef<IdBitmap(std::string_view key)> lookup_fn);
+
 // Responsible for mutating the stack with the given `Node`.
 // Avoids downcasting for subclass specific behaviors.
 class ASTStackVisitor {
  public:
+  ASTStackVisitor() = default;
+  // Looks up the sets of the `ValueNode`s with `lookup_fn`.
+  explicit ASTStackVisitor(
+      absl::FunctionRef<KVSetView(std::string_view key)> lookup_fn)
+      : lookup_fn_(lookup_fn) {}
   // Applies the operation to the top two values on the stack.
   // Replaces the top two values with the result.
   void Visit(const OpNode& node, std::vector<KVSetView>& stack);
-  // Pushes the result of `Lookup` to the stack.
+  // Pushes the result of `Lookup`, or of `lookup_fn` if set, to the stack.
   void Visit(const ValueNode& node, std::vector<KVSetView>& stack);
+
+ private:
+  std::optional<absl::FunctionRef<KVSetView(std::string_view key)>> lookup_fn_;
+};
+
+// Same as `ASTStackVisitor`, over member id bitmaps.
+class ASTBitmapStackVisitor {
+ public:
+  explicit ASTBitmapStackVisitor(
+      absl::FunctionRef<IdBitmap(std::string_view key)> lookup_fn)
+      : lookup_fn_(lookup_fn) {}
+  // Applies the operation to the top two values on the stack.
+  // Replaces the top two values with the result.
+  void Visit(const OpNode& node, std::vector<IdBitmap>& stack);
+  // Pushes the bitmap of the node's key to the stack.
+  void Visit(const ValueNode& node, std::vector<IdBitmap>& stack);
+
+ private:
+  absl::FunctionRef<IdBitmap(std::string_view key)> lookup_fn_;
 };
 
 // General purpose Vistor capable of returning a string representation of a Node
@@ -122,6 +122,36 @@ TEST(AstTest, All) {
   EXPECT_EQ(Eval(center), expected);
 }
 
+TEST(AstTest, AllBitmaps) {
+  const absl::flat_hash_map<std::string_view, IdBitmap> bitmaps = {
+      {"A", {1, 2, 3}},
+      {"B", {2, 3, 4}},
+      {"C", {3, 4, 5}},
+      {"D", {4, 5, 6}},
+  };
+  auto lookup = [&bitmaps](std::string_view key) {
+    const auto it = bitmaps.find(key);
+    return it == bitmaps.end() ? IdBitmap() : it->second;
+  };
+  // (A-B) | (C&D) =
+  // {1} | {4,5} =
+  // {1, 4, 5}
+  std::unique_ptr<ValueNode> a = std::make_unique<ValueNode>(Lookup, "A");
+  std::unique_ptr<ValueNode> b = std::make_unique<ValueNode>(Lookup, "B");
+  std::unique_ptr<ValueNode> c = std::make_unique<ValueNode>(Lookup, "C");
+  std::unique_ptr<ValueNode> d = std::make_unique<ValueNode>(Lookup, "D");
+  std::unique_ptr<DifferenceNode> left =
+      std::make_unique<DifferenceNode>(std::move(a), std::move(b));
+  std::unique_ptr<IntersectionNode> right =
+      std::make_unique<IntersectionNode>(std::move(c), std::move(d));
+  UnionNode center(std::move(left), std::move(right));
+  EXPECT_THAT(Eval(center, lookup).ToVector(),
+              testing::ElementsAre(1, 4, 5));
+  // Missing keys are empty sets.
+  ValueNode missing(Lookup, "E");
+  EXPECT_TRUE(Eval(missing, lookup).IsEmpty());
+}
+
 TEST(AstTest, ValueNodeKeys) {
   ValueNode v(Lookup, "A");
   EXPECT_THAT(v.Keys(), testing::UnorderedElementsAre("A"));
@@ -147,5 +177,40 @@ TEST(AstTest, DupeNodeKeys) {
   EXPECT_THAT(center.Keys(), testing::UnorderedElementsAre("A", "B", "C"));
 }
 
+TEST(AstTest, ToQueryString) {
+  std::unique_ptr<ValueNode> a = std::make_unique<ValueNode>(Lookup, "A");
+  std::unique_ptr<ValueNode> b = std::make_unique<ValueNode>(Lookup, "B");
+  std::unique_ptr<ValueNode> c = std::make_unique<ValueNode>(Lookup, "C");
+  std::unique_ptr<ValueNode> d = std::make_unique<ValueNode>(Lookup, "D-1");
+  std::unique_ptr<DifferenceNode> left =
+      std::make_unique<DifferenceNode>(std::move(a), std::move(b));
+  std::unique_ptr<IntersectionNode> right =
+      std::make_unique<IntersectionNode>(std::move(c), std::move(d));
+  UnionNode center(std::move(left), std::move(right));
+  EXPECT_EQ(ToQueryString(center),
+            "((\"A\" - \"B\") | (\"C\" & \"D-1\"))");
+  ValueNode value(Lookup, "A");
+  EXPECT_EQ(ToQueryString(value), "\"A\"");
+}
+
+TEST(AstTest, Contains) {
+  std::unique_ptr<ValueNode> a = std::make_unique<ValueNode>(Lookup, "A");
+  std::unique_ptr<ValueNode> b = std::make_unique<ValueNode>(Lookup, "B");
+  std::unique_ptr<ValueNode> c = std::make_unique<ValueNode>(Lookup, "C");
+  std::unique_ptr<DifferenceNode> left =
+      std::make_unique<DifferenceNode>(std::move(a), std::move(b));
+  // (A - B) | C
+  UnionNode root(std::move(left), std::move(c));
+  const auto contains = [&root](absl::flat_hash_set<std::string_view> keys) {
+    return root.Contains(
+        [&keys](std::string_view key) { return keys.contains(key); });
+  };
+  EXPECT_TRUE(contains({"A"}));
+  EXPECT_FALSE(contains({"A", "B"}));
+  EXPECT_FALSE(contains({"B"}));
+  EXPECT_TRUE(contains({"B", "C"}));
+  EXPECT_FALSE(contains({}));
+}
+
 }  // namespace
 }  // namespace kv_server
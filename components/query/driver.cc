@@ -19,6 +19,7 @@
 
 #include "absl/container/flat_hash_set.h"
 #include "absl/functional/bind_front.h"
+#include "absl/strings/str_cat.h"
 #include "components/query/ast.h"
 
 namespace kv_server {
@@ -33,17 +34,104 @@ absl::flat_hash_set<std::string_view> Driver::Lookup(
   return lookup_fn_(key);
 }
 
-void Driver::SetAst(std::unique_ptr<Node> ast) { ast_ = std::move(ast); }
+void Driver::SetAst(std::unique_ptr<Node> ast,
+                    QueryResultOptions result_options) {
+  ast_ = std::move(ast);
+  result_options_ = result_options;
+  normalized_query_.clear();
+  if (ast_ != nullptr) {
+    switch (result_options_.mode) {
+      case QueryResultMode::kCount:
+        normalized_query_ = "COUNT ";
+        break;
+      case QueryResultMode::kExists:
+        normalized_query_ = "EXISTS ";
+        break;
+      case QueryResultMode::kElements:
+        break;
+    }
+    absl::StrAppend(&normalized_query_, ToQueryString(*ast_));
+    if (result_options_.limit.has_value()) {
+      absl::StrAppend(&normalized_query_, " LIMIT ", *result_options_.limit);
+    }
+  }
+  program_ = ast_ == nullptr ? QueryProgram() : QueryProgram::Compile(*ast_);
+}
 
 absl::StatusOr<absl::flat_hash_set<std::string_view>> Driver::GetResult()
     const {
   if (!status_.ok()) {
     return status_;
   }
-  if (ast_ == nullptr) {
-    return absl::flat_hash_set<std::string_view>();
+  return program_.Run(
+      [this](std::string_view key) { return lookup_fn_(key); });
+}
+
+absl::StatusOr<absl::flat_hash_set<std::string_view>> Driver::GetResult(
+    absl::FunctionRef<absl::flat_hash_set<std::string_view>(
+        std::string_view key)>
+        lookup_fn) const {
+  if (!status_.ok()) {
+    return status_;
+  }
+  return program_.Run(lookup_fn);
+}
+
+absl::StatusOr<IdBitmap> Driver::GetBitmapResult(
+    absl::FunctionRef<IdBitmap(std::string_view key)> lookup_fn) const {
+  if (!status_.ok()) {
+    return status_;
+  }
+  return program_.RunBitmap(lookup_fn);
+}
+
+absl::StatusOr<absl::flat_hash_set<std::string_view>> Driver::GetResult(
+    absl::FunctionRef<absl::flat_hash_set<std::string_view>(
+        std::string_view key)>
+        lookup_fn,
+    const QueryProgram::ParallelOptions& options) const {
+  if (!status_.ok()) {
+    return status_;
+  }
+  return program_.Run(lookup_fn, options);
+}
+
+absl::StatusOr<IdBitmap> Driver::GetBitmapResult(
+    absl::FunctionRef<IdBitmap(std::string_view key)> lookup_fn,
+    const QueryProgram::ParallelOptions& options) const {
+  if (!status_.ok()) {
+    return status_;
+  }
+  return program_.RunBitmap(lookup_fn, options);
+}
+
+absl::StatusOr<absl::flat_hash_set<std::string_view>>
+Driver::GetProfiledResult(
+    absl::FunctionRef<absl::flat_hash_set<std::string_view>(
+        std::string_view key)>
+        lookup_fn,
+    QueryProfile& profile) const {
+  if (!status_.ok()) {
+    return status_;
+  }
+  return program_.Profile(lookup_fn, profile);
+}
+
+absl::StatusOr<IdBitmap> Driver::GetProfiledBitmapResult(
+    absl::FunctionRef<IdBitmap(std::string_view key)> lookup_fn,
+    QueryProfile& profile) const {
+  if (!status_.ok()) {
+    return status_;
+  }
+  return program_.ProfileBitmap(lookup_fn, profile);
+}
+
+absl::StatusOr<QueryProfile> Driver::Explain(
+    absl::FunctionRef<int64_t(std::string_view key)> size_fn) const {
+  if (!status_.ok()) {
+    return status_;
   }
-  return Eval(*ast_);
+  return program_.Explain(size_fn);
 }
 
 void Driver::SetError(std::string error) {
@@ -17,21 +17,44 @@
 #ifndef COMPONENTS_QUERY_DRIVER_H_
 #define COMPONENTS_QUERY_DRIVER_H_
 
+#include <cstdint>
 #include <memory>
+#include <optional>
 #include <string>
 #include <string_view>
 
 #include "absl/container/flat_hash_set.h"
 #include "absl/functional/any_invocable.h"
+#include "absl/functional/function_ref.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "components/query/ast.h"
+#include "components/query/id_bitmap.h"
+#include "components/query/query_program.h"
 
 namespace kv_server {
 
+// How the result of a query is returned.
+enum class QueryResultMode {
+  // The members of the result, up to `QueryResultOptions::limit` of them.
+  kElements,
+  // Only the number of members of the result, for `COUNT` queries.
+  kCount,
+  // Only whether the result has any members, for `EXISTS` queries.
+  kExists,
+};
+
+// Set by the `LIMIT n`, `COUNT` and `EXISTS` clauses of a query. The results
+// of the driver are not limited, callers apply these when returning them.
+struct QueryResultOptions {
+  QueryResultMode mode = QueryResultMode::kElements;
+  // Set by `LIMIT n`, with no limit otherwise.
+  std::optional<int64_t> limit;
+};
+
 // Driver is responsible for:
 //   * Gathering the AST from the parser
-//   * Creating the exeuction plan
+//   * Creating the exeuction plan, a `QueryProgram` compiled from the AST
 //   * Executing the query
 //   * Storing the result
 // Typical usage:
@@ -53,12 +76,61 @@ class Driver {
   // The result contains views of the data within the DB.
   absl::StatusOr<absl::flat_hash_set<std::string_view>> GetResult() const;
 
+  // Same as `GetResult`, with the sets given by `lookup_fn` instead of the
+  // lookup function of the driver, so that a parsed query can be run over the
+  // sets of each request.
+  absl::StatusOr<absl::flat_hash_set<std::string_view>> GetResult(
+      absl::FunctionRef<absl::flat_hash_set<std::string_view>(
+          std::string_view key)>
+          lookup_fn) const;
+
+  // Same as `GetResult`, evaluated over member id bitmaps. `lookup_fn` returns
+  // the bitmap associated with the provided key, or an empty bitmap.
+  absl::StatusOr<IdBitmap> GetBitmapResult(
+      absl::FunctionRef<IdBitmap(std::string_view key)> lookup_fn) const;
+
+  // Same as the above, with the operands of the query run in parallel as set
+  // by `options`.
+  absl::StatusOr<absl::flat_hash_set<std::string_view>> GetResult(
+      absl::FunctionRef<absl::flat_hash_set<std::string_view>(
+          std::string_view key)>
+          lookup_fn,
+      const QueryProgram::ParallelOptions& options) const;
+  absl::StatusOr<IdBitmap> GetBitmapResult(
+      absl::FunctionRef<IdBitmap(std::string_view key)> lookup_fn,
+      const QueryProgram::ParallelOptions& options) const;
+
+  // Same as `GetResult` and `GetBitmapResult`, with the sizes and latencies of
+  // the steps of the query measured in `profile`.
+  absl::StatusOr<absl::flat_hash_set<std::string_view>> GetProfiledResult(
+      absl::FunctionRef<absl::flat_hash_set<std::string_view>(
+          std::string_view key)>
+          lookup_fn,
+      QueryProfile& profile) const;
+  absl::StatusOr<IdBitmap> GetProfiledBitmapResult(
+      absl::FunctionRef<IdBitmap(std::string_view key)> lookup_fn,
+      QueryProfile& profile) const;
+
+  // Returns the plan of the query, with the sizes of its steps estimated from
+  // the sizes of the sets of its keys, given by `size_fn`.
+  absl::StatusOr<QueryProfile> Explain(
+      absl::FunctionRef<int64_t(std::string_view key)> size_fn) const;
+
   // Returns the the `Node` associated with `SetAst`
   // or nullptr if unset.
   const kv_server::Node* GetRootNode() const;
 
+  // Returns the options of the query associated with `SetAst`.
+  const QueryResultOptions& GetResultOptions() const { return result_options_; }
+
+  // Returns the query associated with `SetAst` as printed by `ToQueryString`,
+  // with its result options, so that queries that only differ in spacing,
+  // keyword case or redundant parentheses have the same normalized query.
+  const std::string& GetNormalizedQuery() const { return normalized_query_; }
+
   // Clients should not call these functions, they are called by the parser.
-  void SetAst(std::unique_ptr<kv_server::Node>);
+  void SetAst(std::unique_ptr<kv_server::Node>,
+              QueryResultOptions result_options = {});
   void SetError(std::string error);
   void ClearError() { status_ = absl::OkStatus(); }
 
@@ -70,6 +142,9 @@ class Driver {
                          const>
       lookup_fn_;
   std::unique_ptr<kv_server::Node> ast_;
+  QueryProgram program_;
+  QueryResultOptions result_options_;
+  std::string normalized_query_;
   absl::Status status_ = absl::OkStatus();
 };
 
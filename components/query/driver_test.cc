@@ -100,6 +100,27 @@ TEST_F(DriverTest, InvalidOp) {
   EXPECT_EQ(result.status().code(), absl::StatusCode::kInvalidArgument);
 }
 
+TEST_F(DriverTest, ProfileAndExplain) {
+  Parse("A & B");
+  QueryProfile profile;
+  auto result = driver_->GetProfiledResult(
+      [this](std::string_view key) { return Lookup(key); }, profile);
+  ASSERT_TRUE(result.ok());
+  EXPECT_THAT(*result, testing::UnorderedElementsAre("b", "c"));
+  ASSERT_EQ(profile.steps.size(), 3);
+  EXPECT_EQ(profile.steps[2].output_size, 2);
+
+  auto plan = driver_->Explain([](std::string_view) { return 3; });
+  ASSERT_TRUE(plan.ok());
+  EXPECT_EQ(plan->steps[2].output_size, 3);
+
+  Parse("A UNION ");
+  EXPECT_EQ(driver_->Explain([](std::string_view) { return 3; })
+                .status()
+                .code(),
+            absl::StatusCode::kInvalidArgument);
+}
+
 TEST_F(DriverTest, KeyOnly) {
   Parse("A");
   auto result = driver_->GetResult();
@@ -170,6 +191,16 @@ TEST_F(DriverTest, OrderOfOperations) {
   EXPECT_THAT(*result, testing::UnorderedElementsAre("a", "c"));
 }
 
+TEST_F(DriverTest, ToQueryStringParsesToTheSameQuery) {
+  Parse("A - (B - C) | D & A");
+  const std::string query = ToQueryString(*driver_->GetRootNode());
+  Parse(query);
+  auto result = driver_->GetResult();
+  ASSERT_TRUE(result.ok());
+  EXPECT_THAT(*result, testing::UnorderedElementsAre("a", "c"));
+  EXPECT_EQ(ToQueryString(*driver_->GetRootNode()), query);
+}
+
 TEST_F(DriverTest, MultipleOperations) {
   Parse("(A-B) | (C&D)");
   auto result = driver_->GetResult();
@@ -215,6 +246,95 @@ TEST_F(DriverTest, EmptyResults) {
   EXPECT_EQ(result->size(), 0);
 }
 
+TEST_F(DriverTest, BitmapResult) {
+  const absl::flat_hash_map<std::string_view, IdBitmap> bitmaps = {
+      {"A", {1, 2, 3}},
+      {"B", {2, 3, 4}},
+      {"C", {3, 4, 5}},
+      {"D", {4, 5, 6}},
+  };
+  auto lookup = [&bitmaps](std::string_view key) {
+    const auto it = bitmaps.find(key);
+    return it == bitmaps.end() ? IdBitmap() : it->second;
+  };
+  Parse("(A-B) | (C&D) | E");
+  auto result = driver_->GetBitmapResult(lookup);
+  ASSERT_TRUE(result.ok());
+  EXPECT_THAT(result->ToVector(), testing::ElementsAre(1, 4, 5));
+
+  Parse("A &");
+  result = driver_->GetBitmapResult(lookup);
+  EXPECT_EQ(result.status().code(), absl::StatusCode::kInvalidArgument);
+}
+
+TEST_F(DriverTest, Limit) {
+  Parse("(A | B) LIMIT 2");
+  auto result = driver_->GetResult();
+  ASSERT_TRUE(result.ok());
+  EXPECT_THAT(*result, testing::UnorderedElementsAre("a", "b", "c", "d"));
+  EXPECT_EQ(driver_->GetResultOptions().mode, QueryResultMode::kElements);
+  EXPECT_EQ(driver_->GetResultOptions().limit, 2);
+}
+
+TEST_F(DriverTest, InvalidLimit) {
+  for (const auto* query : {"A LIMIT B", "A LIMIT -1", "A LIMIT", "LIMIT 1"}) {
+    Parse(query);
+    EXPECT_EQ(driver_->GetResult().status().code(),
+              absl::StatusCode::kInvalidArgument)
+        << query;
+  }
+}
+
+TEST_F(DriverTest, Count) {
+  Parse("count A & B");
+  auto result = driver_->GetResult();
+  ASSERT_TRUE(result.ok());
+  EXPECT_THAT(*result, testing::UnorderedElementsAre("b", "c"));
+  EXPECT_EQ(driver_->GetResultOptions().mode, QueryResultMode::kCount);
+  EXPECT_EQ(driver_->GetResultOptions().limit, std::nullopt);
+}
+
+TEST_F(DriverTest, Exists) {
+  Parse("EXISTS A - B");
+  auto result = driver_->GetResult();
+  ASSERT_TRUE(result.ok());
+  EXPECT_THAT(*result, testing::UnorderedElementsAre("a"));
+  EXPECT_EQ(driver_->GetResultOptions().mode, QueryResultMode::kExists);
+}
+
+TEST_F(DriverTest, ResultOptionsOnlyAtTopLevel) {
+  for (const auto* query : {"A | COUNT B", "(A LIMIT 1) | B", "COUNT EXISTS A",
+                            "COUNT A LIMIT 1"}) {
+    Parse(query);
+    EXPECT_EQ(driver_->GetResult().status().code(),
+              absl::StatusCode::kInvalidArgument)
+        << query;
+  }
+}
+
+TEST_F(DriverTest, ResultOptionsClearedOnParse) {
+  Parse("COUNT A");
+  Parse("A");
+  EXPECT_EQ(driver_->GetResultOptions().mode, QueryResultMode::kElements);
+  Parse("A LIMIT 1");
+  Parse("A");
+  EXPECT_EQ(driver_->GetResultOptions().limit, std::nullopt);
+}
+
+TEST_F(DriverTest, NormalizedQuery) {
+  Parse("A   union (B)");
+  const std::string normalized = driver_->GetNormalizedQuery();
+  Parse("((A) | B)");
+  EXPECT_EQ(driver_->GetNormalizedQuery(), normalized);
+  Parse("A & B");
+  EXPECT_NE(driver_->GetNormalizedQuery(), normalized);
+
+  Parse("count A | B");
+  EXPECT_EQ(driver_->GetNormalizedQuery(), "COUNT " + normalized);
+  Parse("A | B limit 3");
+  EXPECT_EQ(driver_->GetNormalizedQuery(), normalized + " LIMIT 3");
+}
+
 TEST_F(DriverTest, DriverErrorsClearedOnParse) {
   Parse("A &");
   auto result = driver_->GetResult();
@@ -0,0 +1,394 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/query/id_bitmap.h"
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+namespace kv_server {
+namespace {
+
+// Sorted arrays are intersected and subtracted by galloping through the larger
+// one when it is at least this many times larger than the other, and merged
+// otherwise.
+constexpr size_t kGallopingRatio = 32;
+
+uint64_t Bit(uint16_t low) { return uint64_t{1} << (low % 64); }
+
+// Returns the first position of [first, last) that is not less than `value`.
+// Probes positions at exponentially increasing distances from `first`
+// before the binary search, so that it takes O(log d) steps for a position at
+// distance d.
+std::vector<uint16_t>::const_iterator Gallop(
+    std::vector<uint16_t>::const_iterator first,
+    std::vector<uint16_t>::const_iterator last, uint16_t value) {
+  if (first == last || *first >= value) {
+    return first;
+  }
+  // `first[below]` is always less than `value`.
+  const size_t size = last - first;
+  size_t below = 0;
+  size_t step = 1;
+  while (below + step < size && first[below + step] < value) {
+    below += step;
+    step *= 2;
+  }
+  return std::lower_bound(first + below + 1,
+                          first + std::min(below + step + 1, size), value);
+}
+
+// Returns the lower bits of `small` that are also in `large`, or that are not
+// in `large` if `keep_missing`.
+std::vector<uint16_t> GallopingFilter(const std::vector<uint16_t>& small,
+                                      const std::vector<uint16_t>& large,
+                                      bool keep_missing) {
+  std::vector<uint16_t> array;
+  array.reserve(small.size());
+  auto it = large.begin();
+  for (const uint16_t low : small) {
+    it = Gallop(it, large.end(), low);
+    const bool found = it != large.end() && *it == low;
+    if (found != keep_missing) {
+      array.push_back(low);
+    }
+  }
+  return array;
+}
+
+}  // namespace
+
+bool IdBitmap::Container::Add(uint16_t low) {
+  if (IsBitmap()) {
+    uint64_t& word = words_[low / 64];
+    if (word & Bit(low)) {
+      return false;
+    }
+    word |= Bit(low);
+    ++cardinality_;
+    return true;
+  }
+  auto it = std::lower_bound(array_.begin(), array_.end(), low);
+  if (it != array_.end() && *it == low) {
+    return false;
+  }
+  array_.insert(it, low);
+  ++cardinality_;
+  Normalize();
+  return true;
+}
+
+bool IdBitmap::Container::Remove(uint16_t low) {
+  if (IsBitmap()) {
+    uint64_t& word = words_[low / 64];
+    if (!(word & Bit(low))) {
+      return false;
+    }
+    word &= ~Bit(low);
+    --cardinality_;
+    Normalize();
+    return true;
+  }
+  auto it = std::lower_bound(array_.begin(), array_.end(), low);
+  if (it == array_.end() || *it != low) {
+    return false;
+  }
+  array_.erase(it);
+  --cardinality_;
+  return true;
+}
+
+bool IdBitmap::Container::Contains(uint16_t low) const {
+  if (IsBitmap()) {
+    return words_[low / 64] & Bit(low);
+  }
+  return std::binary_search(array_.begin(), array_.end(), low);
+}
+
+void IdBitmap::Container::UnionWith(const Container& other) {
+  if (IsBitmap() && other.IsBitmap()) {
+    for (int i = 0; i < kNumWords; ++i) {
+      words_[i] |= other.words_[i];
+    }
+    CountWords();
+    return;
+  }
+  if (IsBitmap()) {
+    for (const uint16_t low : other.array_) {
+      words_[low / 64] |= Bit(low);
+    }
+    CountWords();
+    return;
+  }
+  if (other.IsBitmap()) {
+    std::vector<uint16_t> array = std::move(array_);
+    *this = other;
+    for (const uint16_t low : array) {
+      words_[low / 64] |= Bit(low);
+    }
+    CountWords();
+    return;
+  }
+  std::vector<uint16_t> merged;
+  merged.reserve(array_.size() + other.array_.size());
+  std::set_union(array_.begin(), array_.end(), other.array_.begin(),
+                 other.array_.end(), std::back_inserter(merged));
+  array_ = std::move(merged);
+  cardinality_ = array_.size();
+  Normalize();
+}
+
+void IdBitmap::Container::IntersectWith(const Container& other) {
+  if (IsBitmap() && other.IsBitmap()) {
+    for (int i = 0; i < kNumWords; ++i) {
+      words_[i] &= other.words_[i];
+    }
+    CountWords();
+    Normalize();
+    return;
+  }
+  if (IsBitmap()) {
+    std::vector<uint16_t> array;
+    array.reserve(other.array_.size());
+    for (const uint16_t low : other.array_) {
+      if (words_[low / 64] & Bit(low)) {
+        array.push_back(low);
+      }
+    }
+    words_.clear();
+    array_ = std::move(array);
+  } else if (other.IsBitmap()) {
+    array_.erase(std::remove_if(array_.begin(), array_.end(),
+                                [&other](uint16_t low) {
+                                  return !(other.words_[low / 64] & Bit(low));
+                                }),
+                 array_.end());
+  } else if (other.array_.size() >= kGallopingRatio * array_.size()) {
+    array_ = GallopingFilter(array_, other.array_, /*keep_missing=*/false);
+  } else if (array_.size() >= kGallopingRatio * other.array_.size()) {
+    array_ = GallopingFilter(other.array_, array_, /*keep_missing=*/false);
+  } else {
+    std::vector<uint16_t> array;
+    array.reserve(std::min(array_.size(), other.array_.size()));
+    std::set_intersection(array_.begin(), array_.end(), other.array_.begin(),
+                          other.array_.end(), std::back_inserter(array));
+    array_ = std::move(array);
+  }
+  cardinality_ = array_.size();
+}
+
+void IdBitmap::Container::Subtract(const Container& other) {
+  if (IsBitmap() && other.IsBitmap()) {
+    for (int i = 0; i < kNumWords; ++i) {
+      words_[i] &= ~other.words_[i];
+    }
+    CountWords();
+    Normalize();
+    return;
+  }
+  if (IsBitmap()) {
+    for (const uint16_t low : other.array_) {
+      words_[low / 64] &= ~Bit(low);
+    }
+    CountWords();
+    Normalize();
+    return;
+  }
+  if (other.IsBitmap()) {
+    array_.erase(std::remove_if(array_.begin(), array_.end(),
+                                [&other](uint16_t low) {
+                                  return other.words_[low / 64] & Bit(low);
+                                }),
+                 array_.end());
+  } else if (other.array_.size() >= kGallopingRatio * array_.size()) {
+    array_ = GallopingFilter(array_, other.array_, /*keep_missing=*/true);
+  } else {
+    std::vector<uint16_t> array;
+    array.reserve(array_.size());
+    std::set_difference(array_.begin(), array_.end(), other.array_.begin(),
+                        other.array_.end(), std::back_inserter(array));
+    array_ = std::move(array);
+  }
+  cardinality_ = array_.size();
+}
+
+void IdBitmap::Container::ToBitmap() {
+  words_.assign(kNumWords, 0);
+  for (const uint16_t low : array_) {
+    words_[low / 64] |= Bit(low);
+  }
+  array_.clear();
+  array_.shrink_to_fit();
+}
+
+void IdBitmap::Container::ToArray() {
+  std::vector<uint16_t> array;
+  array.reserve(cardinality_);
+  ForEach([&array](uint16_t low) { array.push_back(low); });
+  array_ = std::move(array);
+  words_.clear();
+  words_.shrink_to_fit();
+}
+
+void IdBitmap::Container::CountWords() {
+  int cardinality = 0;
+  for (const uint64_t word : words_) {
+    cardinality += absl::popcount(word);
+  }
+  cardinality_ = cardinality;
+}
+
+void IdBitmap::Container::Normalize() {
+  if (IsBitmap() && cardinality_ <= kMaxArraySize) {
+    ToArray();
+  } else if (!IsBitmap() && cardinality_ > kMaxArraySize) {
+    ToBitmap();
+  }
+}
+
+IdBitmap::IdBitmap(std::initializer_list<uint32_t> ids) {
+  for (const uint32_t id : ids) {
+    Add(id);
+  }
+}
+
+size_t IdBitmap::FindContainer(uint16_t key) const {
+  return std::lower_bound(keys_.begin(), keys_.end(), key) - keys_.begin();
+}
+
+bool IdBitmap::Add(uint32_t id) {
+  const uint16_t key = id >> 16;
+  const size_t index = FindContainer(key);
+  if (index == keys_.size() || keys_[index] != key) {
+    keys_.insert(keys_.begin() + index, key);
+    containers_.insert(containers_.begin() + index, Container());
+  }
+  return containers_[index].Add(static_cast<uint16_t>(id));
+}
+
+bool IdBitmap::Remove(uint32_t id) {
+  const uint16_t key = id >> 16;
+  const size_t index = FindContainer(key);
+  if (index == keys_.size() || keys_[index] != key ||
+      !containers_[index].Remove(static_cast<uint16_t>(id))) {
+    return false;
+  }
+  if (containers_[index].cardinality() == 0) {
+    keys_.erase(keys_.begin() + index);
+    containers_.erase(containers_.begin() + index);
+  }
+  return true;
+}
+
+bool IdBitmap::Contains(uint32_t id) const {
+  const uint16_t key = id >> 16;
+  const size_t index = FindContainer(key);
+  return index != keys_.size() && keys_[index] == key &&
+         containers_[index].Contains(static_cast<uint16_t>(id));
+}
+
+uint64_t IdBitmap::Cardinality() const {
+  uint64_t cardinality = 0;
+  for (const auto& container : containers_) {
+    cardinality += container.cardinality();
+  }
+  return cardinality;
+}
+
+std::vector<uint32_t> IdBitmap::ToVector() const {
+  std::vector<uint32_t> ids;
+  ids.reserve(Cardinality());
+  ForEach([&ids](uint32_t id) { ids.push_back(id); });
+  return ids;
+}
+
+IdBitmap& IdBitmap::operator|=(const IdBitmap& other) {
+  std::vector<uint16_t> keys;
+  std::vector<Container> containers;
+  keys.reserve(keys_.size() + other.keys_.size());
+  containers.reserve(keys_.size() + other.keys_.size());
+  size_t i = 0;
+  size_t j = 0;
+  while (i < keys_.size() || j < other.keys_.size()) {
+    if (j == other.keys_.size() ||
+        (i < keys_.size() && keys_[i] < other.keys_[j])) {
+      keys.push_back(keys_[i]);
+      containers.push_back(std::move(containers_[i++]));
+    } else if (i == keys_.size() || other.keys_[j] < keys_[i]) {
+      keys.push_back(other.keys_[j]);
+      containers.push_back(other.containers_[j++]);
+    } else {
+      keys.push_back(keys_[i]);
+      containers.push_back(std::move(containers_[i++]));
+      containers.back().UnionWith(other.containers_[j++]);
+    }
+  }
+  keys_ = std::move(keys);
+  containers_ = std::move(containers);
+  return *this;
+}
+
+IdBitmap& IdBitmap::operator&=(const IdBitmap& other) {
+  size_t out = 0;
+  size_t j = 0;
+  for (size_t i = 0; i < keys_.size(); ++i) {
+    while (j < other.keys_.size() && other.keys_[j] < keys_[i]) {
+      ++j;
+    }
+    if (j == other.keys_.size()) {
+      break;
+    }
+    if (other.keys_[j] != keys_[i]) {
+      continue;
+    }
+    containers_[i].IntersectWith(other.containers_[j]);
+    if (containers_[i].cardinality() > 0) {
+      if (out != i) {
+        keys_[out] = keys_[i];
+        containers_[out] = std::move(containers_[i]);
+      }
+      ++out;
+    }
+  }
+  keys_.resize(out);
+  containers_.resize(out);
+  return *this;
+}
+
+IdBitmap& IdBitmap::operator-=(const IdBitmap& other) {
+  size_t out = 0;
+  size_t j = 0;
+  for (size_t i = 0; i < keys_.size(); ++i) {
+    while (j < other.keys_.size() && other.keys_[j] < keys_[i]) {
+      ++j;
+    }
+    if (j < other.keys_.size() && other.keys_[j] == keys_[i]) {
+      containers_[i].Subtract(other.containers_[j]);
+    }
+    if (containers_[i].cardinality() > 0) {
+      if (out != i) {
+        keys_[out] = keys_[i];
+        containers_[out] = std::move(containers_[i]);
+      }
+      ++out;
+    }
+  }
+  keys_.resize(out);
+  containers_.resize(out);
+  return *this;
+}
+
+}  // namespace kv_server
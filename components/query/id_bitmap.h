@@ -0,0 +1,143 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_QUERY_ID_BITMAP_H_
+#define COMPONENTS_QUERY_ID_BITMAP_H_
+
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+#include "absl/numeric/bits.h"
+
+namespace kv_server {
+
+// Compressed set of 32 bit ids, laid out like a roaring bitmap.
+//
+// Ids are partitioned by their upper 16 bits. Each partition is stored in a
+// container that is a sorted array of the lower 16 bits while it holds at most
+// `kMaxArraySize` ids, and a bitmap of 2^16 bits otherwise. Operations between
+// two bitmap containers are loops over 64 bit words that the compiler
+// vectorizes, operations involving an array container only touch the ids in
+// the array.
+//
+// Not thread safe.
+class IdBitmap {
+ public:
+  // Containers with more ids than this are stored as bitmaps. At this size an
+  // array container takes as much memory as a bitmap container.
+  static constexpr int kMaxArraySize = 4096;
+
+  IdBitmap() = default;
+  IdBitmap(std::initializer_list<uint32_t> ids);
+
+  // Returns true if `id` was not in the set.
+  bool Add(uint32_t id);
+  // Returns true if `id` was in the set.
+  bool Remove(uint32_t id);
+  bool Contains(uint32_t id) const;
+  // Number of ids in the set.
+  uint64_t Cardinality() const;
+  bool IsEmpty() const { return containers_.empty(); }
+
+  // Calls `fn` with every id in the set, in increasing order.
+  template <typename Fn>
+  void ForEach(Fn&& fn) const {
+    for (size_t i = 0; i < containers_.size(); ++i) {
+      const uint32_t high = static_cast<uint32_t>(keys_[i]) << 16;
+      containers_[i].ForEach([high, &fn](uint16_t low) { fn(high | low); });
+    }
+  }
+  // Returns the ids in increasing order.
+  std::vector<uint32_t> ToVector() const;
+
+  // Set union, intersection and difference with `other`.
+  IdBitmap& operator|=(const IdBitmap& other);
+  IdBitmap& operator&=(const IdBitmap& other);
+  IdBitmap& operator-=(const IdBitmap& other);
+
+  friend bool operator==(const IdBitmap& left, const IdBitmap& right) {
+    return left.keys_ == right.keys_ && left.containers_ == right.containers_;
+  }
+  friend bool operator!=(const IdBitmap& left, const IdBitmap& right) {
+    return !(left == right);
+  }
+
+ private:
+  // Ids sharing the same upper 16 bits. The representation only depends on the
+  // content: a container is a bitmap if and only if it holds more than
+  // `kMaxArraySize` ids.
+  class Container {
+   public:
+    static constexpr int kNumWords = (1 << 16) / 64;
+
+    bool Add(uint16_t low);
+    bool Remove(uint16_t low);
+    bool Contains(uint16_t low) const;
+    int cardinality() const { return cardinality_; }
+
+    template <typename Fn>
+    void ForEach(Fn&& fn) const {
+      if (!IsBitmap()) {
+        for (const uint16_t low : array_) {
+          fn(low);
+        }
+        return;
+      }
+      for (int i = 0; i < kNumWords; ++i) {
+        for (uint64_t word = words_[i]; word != 0; word &= word - 1) {
+          fn(static_cast<uint16_t>(i * 64 + absl::countr_zero(word)));
+        }
+      }
+    }
+
+    void UnionWith(const Container& other);
+    void IntersectWith(const Container& other);
+    void Subtract(const Container& other);
+
+    friend bool operator==(const Container& left, const Container& right) {
+      return left.cardinality_ == right.cardinality_ &&
+             left.array_ == right.array_ && left.words_ == right.words_;
+    }
+
+   private:
+    bool IsBitmap() const { return !words_.empty(); }
+    // Converts between the two representations once the cardinality crosses
+    // `kMaxArraySize`.
+    void ToBitmap();
+    void ToArray();
+    void CountWords();
+    void Normalize();
+
+    // Sorted lower bits, if not a bitmap.
+    std::vector<uint16_t> array_;
+    // `kNumWords` words if a bitmap, empty otherwise.
+    std::vector<uint64_t> words_;
+    int cardinality_ = 0;
+  };
+
+  // Returns the index of the container for `key`, or the index where it would
+  // be inserted.
+  size_t FindContainer(uint16_t key) const;
+
+  // Sorted upper bits of the ids, one per non-empty container.
+  std::vector<uint16_t> keys_;
+  std::vector<Container> containers_;
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_QUERY_ID_BITMAP_H_
@@ -0,0 +1,178 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/query/id_bitmap.h"
+
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+using testing::ElementsAre;
+using testing::IsEmpty;
+
+IdBitmap ToBitmap(const std::set<uint32_t>& ids) {
+  IdBitmap bitmap;
+  for (const uint32_t id : ids) {
+    bitmap.Add(id);
+  }
+  return bitmap;
+}
+
+std::vector<uint32_t> ToVector(const std::set<uint32_t>& ids) {
+  return std::vector<uint32_t>(ids.begin(), ids.end());
+}
+
+// Ids in `num_partitions` partitions of the upper 16 bits, with roughly
+// `density` of the lower 16 bits set, so that both container kinds are used.
+std::set<uint32_t> RandomIds(std::mt19937& gen, int num_partitions,
+                             double density) {
+  std::set<uint32_t> ids;
+  std::bernoulli_distribution keep(density);
+  for (uint32_t high = 0; high < num_partitions; ++high) {
+    for (uint32_t low = 0; low < (1 << 16); low += 3) {
+      if (keep(gen)) {
+        ids.insert((high << 16) | low);
+      }
+    }
+  }
+  return ids;
+}
+
+TEST(IdBitmapTest, AddRemoveContains) {
+  IdBitmap bitmap;
+  EXPECT_TRUE(bitmap.IsEmpty());
+  EXPECT_TRUE(bitmap.Add(7));
+  EXPECT_FALSE(bitmap.Add(7));
+  EXPECT_TRUE(bitmap.Add(1 << 20));
+  EXPECT_TRUE(bitmap.Contains(7));
+  EXPECT_TRUE(bitmap.Contains(1 << 20));
+  EXPECT_FALSE(bitmap.Contains(8));
+  EXPECT_EQ(bitmap.Cardinality(), 2);
+  EXPECT_THAT(bitmap.ToVector(), ElementsAre(7, 1 << 20));
+  EXPECT_TRUE(bitmap.Remove(7));
+  EXPECT_FALSE(bitmap.Remove(7));
+  EXPECT_TRUE(bitmap.Remove(1 << 20));
+  EXPECT_TRUE(bitmap.IsEmpty());
+  EXPECT_EQ(bitmap, IdBitmap());
+}
+
+TEST(IdBitmapTest, ContainerConversionKeepsContent) {
+  IdBitmap bitmap;
+  for (uint32_t id = 0; id < 2 * IdBitmap::kMaxArraySize; ++id) {
+    bitmap.Add(id * 2);
+  }
+  EXPECT_EQ(bitmap.Cardinality(), 2 * IdBitmap::kMaxArraySize);
+  for (uint32_t id = 0; id < 2 * IdBitmap::kMaxArraySize; ++id) {
+    EXPECT_TRUE(bitmap.Contains(id * 2));
+    EXPECT_FALSE(bitmap.Contains(id * 2 + 1));
+  }
+  for (uint32_t id = 0; id < 2 * IdBitmap::kMaxArraySize - 1; ++id) {
+    bitmap.Remove(id * 2);
+  }
+  EXPECT_THAT(bitmap.ToVector(),
+              ElementsAre((2 * IdBitmap::kMaxArraySize - 1) * 2));
+  // The representation only depends on the content.
+  EXPECT_EQ(bitmap, IdBitmap({(2 * IdBitmap::kMaxArraySize - 1) * 2}));
+}
+
+TEST(IdBitmapTest, SetOperationsOnDisjointPartitions) {
+  IdBitmap left = {1, 2, 1 << 16};
+  IdBitmap right = {2, 3, 2 << 16};
+  IdBitmap union_result = left;
+  union_result |= right;
+  EXPECT_THAT(union_result.ToVector(), ElementsAre(1, 2, 3, 1 << 16, 2 << 16));
+  IdBitmap intersection_result = left;
+  intersection_result &= right;
+  EXPECT_THAT(intersection_result.ToVector(), ElementsAre(2));
+  IdBitmap difference_result = left;
+  difference_result -= right;
+  EXPECT_THAT(difference_result.ToVector(), ElementsAre(1, 1 << 16));
+  difference_result -= left;
+  EXPECT_THAT(difference_result.ToVector(), IsEmpty());
+}
+
+TEST(IdBitmapTest, SetOperationsMatchOrderedSets) {
+  std::mt19937 gen(42);
+  // Sparse and dense partitions, so that every pair of container kinds meets.
+  for (const auto& [left_density, right_density] :
+       std::vector<std::pair<double, double>>{
+           {0.01, 0.01},
+           {0.01, 0.9},
+           {0.9, 0.01},
+           {0.9, 0.9},
+           {0.3, 0.5},
+           // Arrays of very different sizes.
+           {0.001, 0.15},
+           {0.15, 0.001}}) {
+    const std::set<uint32_t> left = RandomIds(gen, 3, left_density);
+    const std::set<uint32_t> right = RandomIds(gen, 4, right_density);
+    std::set<uint32_t> expected_union;
+    std::set_union(left.begin(), left.end(), right.begin(), right.end(),
+                   std::inserter(expected_union, expected_union.end()));
+    std::set<uint32_t> expected_intersection;
+    std::set_intersection(
+        left.begin(), left.end(), right.begin(), right.end(),
+        std::inserter(expected_intersection, expected_intersection.end()));
+    std::set<uint32_t> expected_difference;
+    std::set_difference(
+        left.begin(), left.end(), right.begin(), right.end(),
+        std::inserter(expected_difference, expected_difference.end()));
+
+    IdBitmap union_result = ToBitmap(left);
+    union_result |= ToBitmap(right);
+    EXPECT_EQ(union_result.ToVector(), ToVector(expected_union));
+    EXPECT_EQ(union_result, ToBitmap(expected_union));
+    IdBitmap intersection_result = ToBitmap(left);
+    intersection_result &= ToBitmap(right);
+    EXPECT_EQ(intersection_result.ToVector(), ToVector(expected_intersection));
+    EXPECT_EQ(intersection_result, ToBitmap(expected_intersection));
+    IdBitmap difference_result = ToBitmap(left);
+    difference_result -= ToBitmap(right);
+    EXPECT_EQ(difference_result.ToVector(), ToVector(expected_difference));
+    EXPECT_EQ(difference_result, ToBitmap(expected_difference));
+  }
+}
+
+TEST(IdBitmapTest, SetOperationsOnArraysOfVeryDifferentSizes) {
+  IdBitmap large;
+  for (uint32_t id = 0; id < 4000; ++id) {
+    large.Add(id);
+  }
+  const IdBitmap small = {0, 5, 3999, 4000, 60000};
+  IdBitmap intersection_result = small;
+  intersection_result &= large;
+  EXPECT_THAT(intersection_result.ToVector(), ElementsAre(0, 5, 3999));
+  intersection_result = large;
+  intersection_result &= small;
+  EXPECT_THAT(intersection_result.ToVector(), ElementsAre(0, 5, 3999));
+  IdBitmap difference_result = small;
+  difference_result -= large;
+  EXPECT_THAT(difference_result.ToVector(), ElementsAre(4000, 60000));
+  difference_result = large;
+  difference_result -= small;
+  EXPECT_EQ(difference_result.Cardinality(), 3997);
+  EXPECT_FALSE(difference_result.Contains(5));
+  EXPECT_TRUE(difference_result.Contains(6));
+}
+
+}  // namespace
+}  // namespace kv_server
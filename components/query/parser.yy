@@ -42,13 +42,14 @@
   #include "components/query/driver.h"
   #include "components/query/scanner.h"
   #include "absl/functional/bind_front.h"
+  #include "absl/strings/numbers.h"
 
   #undef yylex
   #define yylex(x) scanner.yylex(x)
 }
 
 /* declare tokens */
-%token UNION INTERSECTION DIFFERENCE LPAREN RPAREN
+%token UNION INTERSECTION DIFFERENCE LPAREN RPAREN LIMIT COUNT EXISTS
 %token <std::string> VAR ERROR
 %token YYEOF 0
 
@@ -74,6 +75,21 @@
 query:
   %empty
  | query exp YYEOF { driver.SetAst(std::move($2)); }
+ /* A query can limit its result, or only ask for its size or whether it's empty. */
+ | query exp LIMIT VAR YYEOF {
+     int64_t limit;
+     if (!absl::SimpleAtoi($4, &limit) || limit < 0) {
+       driver.SetError("Invalid limit: " + $4);
+       YYERROR;
+     }
+     driver.SetAst(std::move($2), {.limit = limit});
+   }
+ | query COUNT exp YYEOF {
+     driver.SetAst(std::move($3), {.mode = QueryResultMode::kCount});
+   }
+ | query EXISTS exp YYEOF {
+     driver.SetAst(std::move($3), {.mode = QueryResultMode::kExists});
+   }
 
 exp: term {$$ = std::move($1);}
  | exp UNION exp { $$ = std::make_unique<UnionNode>(std::move($1), std::move($3)); }
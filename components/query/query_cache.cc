@@ -0,0 +1,71 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/query/query_cache.h"
+
+#include <sstream>
+#include <utility>
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/status/status.h"
+#include "components/query/scanner.h"
+
+namespace kv_server {
+
+QueryCache::QueryCache(int max_queries) : max_queries_(max_queries) {}
+
+absl::StatusOr<std::shared_ptr<const Driver>> QueryCache::Parse(
+    std::string_view query, bool* is_hit) {
+  if (is_hit != nullptr) {
+    *is_hit = false;
+  }
+  if (max_queries_ > 0) {
+    absl::MutexLock lock(&mutex_);
+    if (const auto it = index_.find(query); it != index_.end()) {
+      entries_.splice(entries_.begin(), entries_, it->second);
+      if (is_hit != nullptr) {
+        *is_hit = true;
+      }
+      return it->second->driver;
+    }
+  }
+  // Parsed without the lock, queries are run with the lookup function of
+  // each request.
+  auto driver = std::make_shared<Driver>([](std::string_view key) {
+    return absl::flat_hash_set<std::string_view>();
+  });
+  std::istringstream stream{std::string(query)};
+  Scanner scanner(stream);
+  Parser parse(*driver, scanner);
+  if (parse() != 0) {
+    return absl::InvalidArgumentError("Parsing failure.");
+  }
+  if (max_queries_ == 0) {
+    return driver;
+  }
+  absl::MutexLock lock(&mutex_);
+  if (const auto it = index_.find(query); it != index_.end()) {
+    // Another thread parsed the same query meanwhile.
+    return it->second->driver;
+  }
+  entries_.push_front(Entry{.query = std::string(query), .driver = driver});
+  index_.emplace(entries_.front().query, entries_.begin());
+  if (static_cast<int>(entries_.size()) > max_queries_) {
+    index_.erase(entries_.back().query);
+    entries_.pop_back();
+  }
+  return driver;
+}
+
+}  // namespace kv_server
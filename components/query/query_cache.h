@@ -0,0 +1,72 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_QUERY_QUERY_CACHE_H_
+#define COMPONENTS_QUERY_QUERY_CACHE_H_
+
+#include <list>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
+#include "components/query/driver.h"
+
+namespace kv_server {
+
+// Keeps the parsed trees of the most recently run queries, by query text, so
+// that repeated queries skip lexing and parsing.
+//
+// The drivers that it returns have no data of their own: they are run with
+// `Driver::GetResult(lookup_fn)` or `Driver::GetBitmapResult(lookup_fn)`.
+//
+// Thread-safe.
+class QueryCache {
+ public:
+  static constexpr int kDefaultMaxQueries = 1000;
+
+  // Keeps at most `max_queries` queries. 0 disables the cache.
+  explicit QueryCache(int max_queries = kDefaultMaxQueries);
+  QueryCache(const QueryCache&) = delete;
+  QueryCache& operator=(const QueryCache&) = delete;
+
+  // Returns the driver that parsed `query`, parsing it unless it is cached.
+  // `is_hit` is set to whether it was cached. Queries that fail to parse are
+  // not cached.
+  absl::StatusOr<std::shared_ptr<const Driver>> Parse(std::string_view query,
+                                                      bool* is_hit = nullptr)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  struct Entry {
+    std::string query;
+    std::shared_ptr<const Driver> driver;
+  };
+
+  const int max_queries_;
+  absl::Mutex mutex_;
+  // Most recently used first.
+  std::list<Entry> entries_ ABSL_GUARDED_BY(mutex_);
+  // Views of the queries of `entries_`.
+  absl::flat_hash_map<std::string_view, std::list<Entry>::iterator> index_
+      ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_QUERY_QUERY_CACHE_H_
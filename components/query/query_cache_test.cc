@@ -0,0 +1,102 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/query/query_cache.h"
+
+#include <string>
+#include <string_view>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+using testing::UnorderedElementsAre;
+
+const absl::flat_hash_map<std::string, absl::flat_hash_set<std::string_view>>&
+Sets() {
+  static const auto* sets = new absl::flat_hash_map<
+      std::string, absl::flat_hash_set<std::string_view>>({
+      {"A", {"a", "b", "c"}},
+      {"B", {"b", "c", "d"}},
+  });
+  return *sets;
+}
+
+absl::flat_hash_set<std::string_view> Lookup(std::string_view key) {
+  const auto it = Sets().find(key);
+  return it == Sets().end() ? absl::flat_hash_set<std::string_view>()
+                            : it->second;
+}
+
+TEST(QueryCacheTest, RepeatedQueryIsAHit) {
+  QueryCache query_cache;
+  bool is_hit = true;
+  auto first = query_cache.Parse("A & B", &is_hit);
+  ASSERT_TRUE(first.ok());
+  EXPECT_FALSE(is_hit);
+  auto second = query_cache.Parse("A & B", &is_hit);
+  ASSERT_TRUE(second.ok());
+  EXPECT_TRUE(is_hit);
+  EXPECT_EQ(first->get(), second->get());
+  EXPECT_THAT((*second)->GetRootNode()->Keys(), UnorderedElementsAre("A", "B"));
+}
+
+TEST(QueryCacheTest, CachedQueryRunsWithTheGivenLookup) {
+  QueryCache query_cache;
+  ASSERT_TRUE(query_cache.Parse("A - B").ok());
+  auto driver = query_cache.Parse("A - B");
+  ASSERT_TRUE(driver.ok());
+  auto result = (*driver)->GetResult(Lookup);
+  ASSERT_TRUE(result.ok());
+  EXPECT_THAT(*result, UnorderedElementsAre("a"));
+}
+
+TEST(QueryCacheTest, InvalidQueryIsNotCached) {
+  QueryCache query_cache;
+  bool is_hit = true;
+  EXPECT_EQ(query_cache.Parse("A &", &is_hit).status().code(),
+            absl::StatusCode::kInvalidArgument);
+  EXPECT_FALSE(is_hit);
+  EXPECT_FALSE(query_cache.Parse("A &", &is_hit).ok());
+  EXPECT_FALSE(is_hit);
+}
+
+TEST(QueryCacheTest, EvictsTheLeastRecentlyUsedQuery) {
+  QueryCache query_cache(/*max_queries=*/2);
+  bool is_hit = false;
+  ASSERT_TRUE(query_cache.Parse("A").ok());
+  ASSERT_TRUE(query_cache.Parse("B").ok());
+  // "A" is used again, so "B" is the least recently used.
+  ASSERT_TRUE(query_cache.Parse("A").ok());
+  ASSERT_TRUE(query_cache.Parse("A | B").ok());
+  ASSERT_TRUE(query_cache.Parse("A", &is_hit).ok());
+  EXPECT_TRUE(is_hit);
+  ASSERT_TRUE(query_cache.Parse("B", &is_hit).ok());
+  EXPECT_FALSE(is_hit);
+}
+
+TEST(QueryCacheTest, ZeroMaxQueriesDisablesTheCache) {
+  QueryCache query_cache(/*max_queries=*/0);
+  bool is_hit = true;
+  ASSERT_TRUE(query_cache.Parse("A").ok());
+  ASSERT_TRUE(query_cache.Parse("A", &is_hit).ok());
+  EXPECT_FALSE(is_hit);
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -0,0 +1,589 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/query/query_program.h"
+
+#include <algorithm>
+#include <deque>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/inlined_vector.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/synchronization/notification.h"
+#include "components/query/sets.h"
+
+namespace kv_server {
+
+namespace {
+
+// Returns the op code of the nodes that it visits.
+class OpCodeVisitor : public ASTStringVisitor {
+ public:
+  std::string Visit(const UnionNode&) override {
+    op_code_ = QueryProgram::OpCode::kUnion;
+    return "";
+  }
+  std::string Visit(const DifferenceNode&) override {
+    op_code_ = QueryProgram::OpCode::kDifference;
+    return "";
+  }
+  std::string Visit(const IntersectionNode&) override {
+    op_code_ = QueryProgram::OpCode::kIntersection;
+    return "";
+  }
+  std::string Visit(const ValueNode& node) override {
+    op_code_ = QueryProgram::OpCode::kLoad;
+    key_ = node.Key();
+    return "";
+  }
+
+  QueryProgram::OpCode GetOpCode(const Node& node) {
+    node.Accept(*this);
+    return op_code_;
+  }
+  // The key of the last visited `ValueNode`.
+  std::string_view key() const { return key_; }
+
+ private:
+  QueryProgram::OpCode op_code_ = QueryProgram::OpCode::kLoad;
+  std::string_view key_;
+};
+
+size_t SetSize(const KVSetView& set) { return set.size(); }
+size_t SetSize(const IdBitmap& set) { return set.Cardinality(); }
+
+// Replaces the first of the sets in [operands, end) with the result of
+// `op_code` over all of them. Returns the number of operands that were
+// applied before the result was known.
+template <typename Set, typename Iterator>
+int ApplyOperation(QueryProgram::OpCode op_code, Iterator operands,
+                   Iterator end) {
+  const auto by_size = [](const Set& left, const Set& right) {
+    return SetSize(left) < SetSize(right);
+  };
+  switch (op_code) {
+    case QueryProgram::OpCode::kUnion:
+      // The smaller sets are merged into the largest one.
+      std::iter_swap(operands, std::max_element(operands, end, by_size));
+      for (auto it = operands + 1; it != end; ++it) {
+        *operands = Union(std::move(*operands), std::move(*it));
+      }
+      return end - operands;
+    case QueryProgram::OpCode::kIntersection: {
+      // The result is at most as large as the smallest set, which is
+      // intersected with the others from the smallest to the largest.
+      std::sort(operands, end, by_size);
+      auto it = operands + 1;
+      for (; it != end && SetSize(*operands) > 0; ++it) {
+        *operands = Intersection(std::move(*operands), std::move(*it));
+      }
+      return it - operands;
+    }
+    case QueryProgram::OpCode::kDifference: {
+      auto it = operands + 1;
+      for (; it != end && SetSize(*operands) > 0; ++it) {
+        *operands = Difference(std::move(*operands), std::move(*it));
+      }
+      return it - operands;
+    }
+    case QueryProgram::OpCode::kLoad:
+      break;
+  }
+  return 1;
+}
+
+// How `ApplyOperation` combines the operands of `op_code`.
+std::string_view AlgorithmName(QueryProgram::OpCode op_code) {
+  switch (op_code) {
+    case QueryProgram::OpCode::kUnion:
+      return "merge into largest";
+    case QueryProgram::OpCode::kIntersection:
+      return "smallest first, stop when empty";
+    case QueryProgram::OpCode::kDifference:
+      return "in order, stop when empty";
+    case QueryProgram::OpCode::kLoad:
+      break;
+  }
+  return "";
+}
+
+std::string_view OpCodeName(QueryProgram::OpCode op_code) {
+  switch (op_code) {
+    case QueryProgram::OpCode::kUnion:
+      return "Union";
+    case QueryProgram::OpCode::kIntersection:
+      return "Intersection";
+    case QueryProgram::OpCode::kDifference:
+      return "Difference";
+    case QueryProgram::OpCode::kLoad:
+      break;
+  }
+  return "Load";
+}
+
+// The members that the operation of `step` reads or probes: unions insert
+// the members of their smaller operands, intersections and differences probe
+// the members of their result with each other operand.
+int64_t StepCost(const QueryProfile::Step& step) {
+  if (step.input_sizes.empty()) {
+    return 0;
+  }
+  const int64_t num_probes = step.num_applied_operands - 1;
+  switch (step.op_code) {
+    case QueryProgram::OpCode::kUnion: {
+      int64_t total = 0;
+      for (int64_t size : step.input_sizes) {
+        total += size;
+      }
+      return total - *std::max_element(step.input_sizes.begin(),
+                                       step.input_sizes.end());
+    }
+    case QueryProgram::OpCode::kIntersection:
+      return num_probes * *std::min_element(step.input_sizes.begin(),
+                                            step.input_sizes.end());
+    case QueryProgram::OpCode::kDifference:
+      return num_probes * step.input_sizes.front();
+    case QueryProgram::OpCode::kLoad:
+      break;
+  }
+  return 0;
+}
+
+}  // namespace
+
+// Appends the instructions of a tree, the operands of each operation before
+// it.
+class QueryProgramCompiler {
+ public:
+  explicit QueryProgramCompiler(QueryProgram& program) : program_(program) {}
+
+  void Compile(const Node& root) {
+    // Operations are pushed twice: first to push their operands, then, once
+    // these are compiled, to add the operation itself.
+    struct Item {
+      const Node* node;
+      QueryProgram::OpCode op_code;
+      uint32_t num_operands = 0;
+    };
+    std::vector<Item> items = {{&root, op_code_visitor_.GetOpCode(root)}};
+    while (!items.empty()) {
+      const Item item = items.back();
+      items.pop_back();
+      if (item.op_code == QueryProgram::OpCode::kLoad) {
+        op_code_visitor_.GetOpCode(*item.node);
+        AddLoad(op_code_visitor_.key());
+        continue;
+      }
+      if (item.num_operands > 0) {
+        AddOp(item.op_code, item.num_operands);
+        continue;
+      }
+      const std::vector<const Node*> operands =
+          GetOperands(*item.node, item.op_code);
+      items.push_back({item.node, item.op_code,
+                       static_cast<uint32_t>(operands.size())});
+      for (auto it = operands.rbegin(); it != operands.rend(); ++it) {
+        items.push_back({*it, op_code_visitor_.GetOpCode(**it)});
+      }
+    }
+  }
+
+ private:
+  // Returns the operands of the chain of `op_code` operations at `node`, in
+  // order. Unions and intersections are associative, so the operands of both
+  // sides of a node are flattened. Differences are left associative, so only
+  // their left side is.
+  std::vector<const Node*> GetOperands(const Node& node,
+                                       QueryProgram::OpCode op_code) {
+    std::vector<const Node*> operands;
+    if (op_code == QueryProgram::OpCode::kDifference) {
+      // `(A - B) - C` is `A - B - C`, `A - (B - C)` is not.
+      std::vector<const Node*> subtrahends;
+      const Node* next = &node;
+      while (op_code_visitor_.GetOpCode(*next) == op_code) {
+        subtrahends.push_back(next->Right());
+        next = next->Left();
+      }
+      operands.push_back(next);
+      operands.insert(operands.end(), subtrahends.rbegin(), subtrahends.rend());
+      return operands;
+    }
+    std::vector<const Node*> pending = {&node};
+    while (!pending.empty()) {
+      const Node* next = pending.back();
+      pending.pop_back();
+      if (op_code_visitor_.GetOpCode(*next) != op_code) {
+        operands.push_back(next);
+        continue;
+      }
+      pending.push_back(next->Right());
+      pending.push_back(next->Left());
+    }
+    return operands;
+  }
+
+  void AddLoad(std::string_view key) {
+    auto [it, inserted] = key_indexes_.try_emplace(key, program_.keys_.size());
+    if (inserted) {
+      program_.keys_.emplace_back(key);
+    }
+    program_.instructions_.push_back(
+        {.op_code = QueryProgram::OpCode::kLoad, .key_index = it->second});
+    ++stack_size_;
+    program_.max_stack_size_ =
+        std::max(program_.max_stack_size_, stack_size_);
+  }
+
+  void AddOp(QueryProgram::OpCode op_code, uint32_t num_operands) {
+    program_.instructions_.push_back(
+        {.op_code = op_code, .num_operands = num_operands});
+    stack_size_ -= static_cast<int>(num_operands) - 1;
+  }
+
+  QueryProgram& program_;
+  OpCodeVisitor op_code_visitor_;
+  // Views of the keys of the tree, which outlives the compiler.
+  absl::flat_hash_map<std::string_view, uint32_t> key_indexes_;
+  int stack_size_ = 0;
+};
+
+QueryProgram QueryProgram::Compile(const Node& root) {
+  QueryProgram program;
+  QueryProgramCompiler(program).Compile(root);
+  return program;
+}
+
+template <typename Set, typename LoadFn>
+Set QueryProgram::RunInstructions(size_t begin, size_t end,
+                                  LoadFn load_fn) const {
+  // Most queries don't need more than a few sets on the stack at once.
+  absl::InlinedVector<Set, 4> stack;
+  stack.reserve(max_stack_size_);
+  for (size_t i = begin; i < end; ++i) {
+    const Instruction& instruction = instructions_[i];
+    if (instruction.op_code == OpCode::kLoad) {
+      stack.push_back(load_fn(i));
+      continue;
+    }
+    const auto operands = stack.end() - instruction.num_operands;
+    ApplyOperation<Set>(instruction.op_code, operands, stack.end());
+    stack.erase(operands + 1, stack.end());
+  }
+  return std::move(stack.back());
+}
+
+template <typename Set>
+Set QueryProgram::ProfileOver(
+    absl::FunctionRef<Set(std::string_view key)> lookup_fn,
+    QueryProfile& profile) const {
+  profile.measured = true;
+  profile.steps.clear();
+  profile.steps.reserve(instructions_.size());
+  if (instructions_.empty()) {
+    return Set();
+  }
+  std::vector<Set> stack;
+  stack.reserve(max_stack_size_);
+  for (const Instruction& instruction : instructions_) {
+    QueryProfile::Step& step = profile.steps.emplace_back();
+    step.op_code = instruction.op_code;
+    const absl::Time start = absl::Now();
+    if (instruction.op_code == OpCode::kLoad) {
+      step.key = keys_[instruction.key_index];
+      stack.push_back(lookup_fn(step.key));
+    } else {
+      const auto operands = stack.end() - instruction.num_operands;
+      for (auto it = operands; it != stack.end(); ++it) {
+        step.input_sizes.push_back(SetSize(*it));
+      }
+      step.algorithm = AlgorithmName(instruction.op_code);
+      step.num_applied_operands =
+          ApplyOperation<Set>(instruction.op_code, operands, stack.end());
+      stack.erase(operands + 1, stack.end());
+    }
+    step.latency = absl::Now() - start;
+    step.output_size = SetSize(stack.back());
+  }
+  return std::move(stack.back());
+}
+
+QueryProfile QueryProgram::Explain(
+    absl::FunctionRef<int64_t(std::string_view key)> size_fn) const {
+  QueryProfile profile;
+  profile.steps.reserve(instructions_.size());
+  // The estimated sizes of the sets on the stack.
+  std::vector<int64_t> stack;
+  for (const Instruction& instruction : instructions_) {
+    QueryProfile::Step& step = profile.steps.emplace_back();
+    step.op_code = instruction.op_code;
+    if (instruction.op_code == OpCode::kLoad) {
+      step.key = keys_[instruction.key_index];
+      step.output_size = size_fn(step.key);
+      stack.push_back(step.output_size);
+      continue;
+    }
+    step.input_sizes.assign(stack.end() - instruction.num_operands,
+                            stack.end());
+    stack.resize(stack.size() - instruction.num_operands);
+    step.algorithm = AlgorithmName(instruction.op_code);
+    step.num_applied_operands = instruction.num_operands;
+    switch (instruction.op_code) {
+      case OpCode::kUnion:
+        for (int64_t size : step.input_sizes) {
+          step.output_size += size;
+        }
+        break;
+      case OpCode::kIntersection:
+        step.output_size = *std::min_element(step.input_sizes.begin(),
+                                             step.input_sizes.end());
+        break;
+      case OpCode::kDifference:
+        step.output_size = step.input_sizes.front();
+        break;
+      case OpCode::kLoad:
+        break;
+    }
+    stack.push_back(step.output_size);
+  }
+  return profile;
+}
+
+template <typename Set>
+Set QueryProgram::RunOver(
+    absl::FunctionRef<Set(std::string_view key)> lookup_fn) const {
+  if (instructions_.empty()) {
+    return Set();
+  }
+  return RunInstructions<Set>(0, instructions_.size(), [&](size_t i) {
+    return lookup_fn(keys_[instructions_[i].key_index]);
+  });
+}
+
+// Runs a program with the operands of its operations run in parallel, see
+// `QueryProgram::ParallelOptions`. The instructions of an operand are the
+// contiguous ones that end with its last instruction.
+template <typename Set>
+class ParallelRun {
+ public:
+  ParallelRun(const QueryProgram& program,
+              absl::FunctionRef<Set(std::string_view key)> lookup_fn,
+              const QueryProgram::ParallelOptions& options)
+      : program_(program),
+        options_(options),
+        loads_(program.instructions_.size()),
+        begins_(program.instructions_.size()),
+        sizes_(program.instructions_.size() + 1) {
+    const auto& instructions = program_.instructions_;
+    for (size_t i = 0; i < instructions.size(); ++i) {
+      size_t begin = i;
+      if (instructions[i].op_code == QueryProgram::OpCode::kLoad) {
+        loads_[i] = lookup_fn(program_.keys_[instructions[i].key_index]);
+      } else {
+        for (uint32_t j = 0; j < instructions[i].num_operands; ++j) {
+          begin = begins_[begin - 1];
+        }
+      }
+      begins_[i] = begin;
+      sizes_[i + 1] = sizes_[i] + SetSize(loads_[i]);
+    }
+  }
+
+  // Runs the instructions that end with the one at `last`.
+  Set Run(size_t last) {
+    const auto& instruction = program_.instructions_[last];
+    if (!IsParallel(last)) {
+      return program_.RunInstructions<Set>(
+          begins_[last], last + 1,
+          [this](size_t i) { return std::move(loads_[i]); });
+    }
+    absl::InlinedVector<size_t, 4> operand_lasts(instruction.num_operands);
+    size_t operand_last = last - 1;
+    for (auto it = operand_lasts.rbegin(); it != operand_lasts.rend(); ++it) {
+      *it = operand_last;
+      operand_last = begins_[operand_last] - 1;
+    }
+    absl::InlinedVector<Set, 4> operands(instruction.num_operands);
+    std::deque<absl::Notification> scheduled;
+    // The calling thread runs the first parallel operand, and the others that
+    // are not worth scheduling.
+    bool runs_parallel_operand = false;
+    for (size_t i = 0; i < operand_lasts.size(); ++i) {
+      if (!IsParallel(operand_lasts[i])) continue;
+      if (!runs_parallel_operand) {
+        runs_parallel_operand = true;
+        continue;
+      }
+      absl::Notification& done = scheduled.emplace_back();
+      options_.pool->Schedule(
+          [this, &operands, &done, i, operand_last = operand_lasts[i]]() {
+            operands[i] = Run(operand_last);
+            done.Notify();
+          });
+      operand_lasts[i] = kScheduled;
+    }
+    for (size_t i = 0; i < operand_lasts.size(); ++i) {
+      if (operand_lasts[i] != kScheduled) {
+        operands[i] = Run(operand_lasts[i]);
+      }
+    }
+    for (const auto& done : scheduled) {
+      options_.pool->Wait(done);
+    }
+    ApplyOperation<Set>(instruction.op_code, operands.begin(), operands.end());
+    return std::move(operands.front());
+  }
+
+ private:
+  static constexpr size_t kScheduled = std::numeric_limits<size_t>::max();
+
+  // Whether the operands of the instruction at `last` are worth running in
+  // parallel.
+  bool IsParallel(size_t last) const {
+    return program_.instructions_[last].op_code !=
+               QueryProgram::OpCode::kLoad &&
+           sizes_[last + 1] - sizes_[begins_[last]] >=
+               static_cast<size_t>(options_.min_parallel_size);
+  }
+
+  const QueryProgram& program_;
+  const QueryProgram::ParallelOptions& options_;
+  // The sets of the loads, by instruction, moved out once run.
+  std::vector<Set> loads_;
+  // The index of the first instruction of each operand.
+  std::vector<size_t> begins_;
+  // The number of members of the sets loaded before each instruction.
+  std::vector<size_t> sizes_;
+};
+
+template <typename Set>
+Set QueryProgram::RunOver(
+    absl::FunctionRef<Set(std::string_view key)> lookup_fn,
+    const ParallelOptions& options) const {
+  if (instructions_.empty() || options.pool == nullptr) {
+    return RunOver<Set>(lookup_fn);
+  }
+  return ParallelRun<Set>(*this, lookup_fn, options)
+      .Run(instructions_.size() - 1);
+}
+
+KVSetView QueryProgram::Run(
+    absl::FunctionRef<KVSetView(std::string_view key)> lookup_fn) const {
+  return RunOver<KVSetView>(lookup_fn);
+}
+
+IdBitmap QueryProgram::RunBitmap(
+    absl::FunctionRef<IdBitmap(std::string_view key)> lookup_fn) const {
+  return RunOver<IdBitmap>(lookup_fn);
+}
+
+KVSetView QueryProgram::Run(
+    absl::FunctionRef<KVSetView(std::string_view key)> lookup_fn,
+    const ParallelOptions& options) const {
+  return RunOver<KVSetView>(lookup_fn, options);
+}
+
+IdBitmap QueryProgram::RunBitmap(
+    absl::FunctionRef<IdBitmap(std::string_view key)> lookup_fn,
+    const ParallelOptions& options) const {
+  return RunOver<IdBitmap>(lookup_fn, options);
+}
+
+KVSetView QueryProgram::Profile(
+    absl::FunctionRef<KVSetView(std::string_view key)> lookup_fn,
+    QueryProfile& profile) const {
+  return ProfileOver<KVSetView>(lookup_fn, profile);
+}
+
+IdBitmap QueryProgram::ProfileBitmap(
+    absl::FunctionRef<IdBitmap(std::string_view key)> lookup_fn,
+    QueryProfile& profile) const {
+  return ProfileOver<IdBitmap>(lookup_fn, profile);
+}
+
+int64_t QueryProfile::Cost() const {
+  int64_t cost = 0;
+  for (const Step& step : steps) {
+    cost += StepCost(step);
+  }
+  return cost;
+}
+
+absl::Duration QueryProfile::TotalLatency() const {
+  absl::Duration total;
+  for (const Step& step : steps) {
+    total += step.latency;
+  }
+  return total;
+}
+
+std::string QueryProfile::ToString() const {
+  if (steps.empty()) {
+    return "Empty query\n";
+  }
+  // The operands of each step, found from the end of the program: the last
+  // step is the root, and the operands of a step end right before it.
+  std::vector<std::vector<size_t>> operands(steps.size());
+  std::vector<size_t> stack;
+  for (size_t i = 0; i < steps.size(); ++i) {
+    if (steps[i].op_code != QueryProgram::OpCode::kLoad) {
+      const size_t num_operands = steps[i].input_sizes.size();
+      operands[i].assign(stack.end() - num_operands, stack.end());
+      stack.resize(stack.size() - num_operands);
+    }
+    stack.push_back(i);
+  }
+  const std::string_view size_prefix = measured ? "" : "<=";
+  std::string result = absl::StrCat(
+      measured ? "Profile" : "Plan", ", cost ", Cost(), " members",
+      measured ? absl::StrCat(", ", absl::FormatDuration(TotalLatency()))
+               : "",
+      "\n");
+  // Steps to print, root first, with their depth.
+  std::vector<std::pair<size_t, int>> pending = {{steps.size() - 1, 0}};
+  while (!pending.empty()) {
+    const auto [i, depth] = pending.back();
+    pending.pop_back();
+    const Step& step = steps[i];
+    absl::StrAppend(&result, std::string(2 * depth + 2, ' '),
+                    OpCodeName(step.op_code));
+    if (step.op_code == QueryProgram::OpCode::kLoad) {
+      absl::StrAppend(&result, " ", step.key);
+    } else {
+      absl::StrAppend(&result, " (", step.algorithm, ") in [",
+                      absl::StrJoin(step.input_sizes, ", "), "]");
+      if (measured &&
+          step.num_applied_operands <
+              static_cast<int>(step.input_sizes.size())) {
+        absl::StrAppend(&result, ", stopped after ",
+                        step.num_applied_operands, " operands");
+      }
+    }
+    absl::StrAppend(&result, " -> ", size_prefix, step.output_size);
+    if (measured) {
+      absl::StrAppend(&result, ", ", absl::FormatDuration(step.latency));
+    }
+    absl::StrAppend(&result, "\n");
+    for (auto it = operands[i].rbegin(); it != operands[i].rend(); ++it) {
+      pending.push_back({*it, depth + 1});
+    }
+  }
+  return result;
+}
+
+}  // namespace kv_server
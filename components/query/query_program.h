@@ -0,0 +1,175 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_QUERY_QUERY_PROGRAM_H_
+#define COMPONENTS_QUERY_QUERY_PROGRAM_H_
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/functional/function_ref.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "components/query/ast.h"
+#include "components/query/id_bitmap.h"
+#include "components/util/thread_pool.h"
+
+namespace kv_server {
+
+struct QueryProfile;
+
+// A query tree lowered into a linear program over a stack of sets. Loads push
+// the set of a key, operations replace their operands, the top sets of the
+// stack, with their result. Running it is a loop over the instructions, with
+// no virtual calls and no traversal of the tree.
+//
+// Chains of the same operation are flattened into one operation with more
+// operands: `A & B & C` is one intersection of three sets. Intersections start
+// from their smallest operand, unions from their largest, and both
+// intersections and differences stop as soon as their result is empty.
+//
+// Operands that are operations over large sets can be run in parallel, see
+// `ParallelOptions`.
+//
+// The program owns its keys, so it doesn't depend on the tree once compiled.
+class QueryProgram {
+ public:
+  enum class OpCode : uint8_t { kLoad, kUnion, kIntersection, kDifference };
+  struct Instruction {
+    OpCode op_code;
+    // For `kLoad`, the index of the key in `keys()`.
+    uint32_t key_index = 0;
+    // For operations, the number of sets that they take from the stack. The
+    // first operand of a difference is the deepest one.
+    uint32_t num_operands = 0;
+  };
+
+  struct ParallelOptions {
+    // The pool that operands are run on. If null, programs run sequentially.
+    ThreadPool* pool = nullptr;
+    // Operands whose sets hold fewer members in total are run inline, they
+    // take less time to run than to schedule.
+    int64_t min_parallel_size = 10000;
+  };
+
+  // The empty program, its result is the empty set.
+  QueryProgram() = default;
+
+  static QueryProgram Compile(const Node& root);
+
+  // Runs the program with the sets given by `lookup_fn`.
+  KVSetView Run(
+      absl::FunctionRef<KVSetView(std::string_view key)> lookup_fn) const;
+  // Same as `Run`, over member id bitmaps.
+  IdBitmap RunBitmap(
+      absl::FunctionRef<IdBitmap(std::string_view key)> lookup_fn) const;
+
+  // Same as the above, with the operands of each operation that are
+  // operations over at least `options.min_parallel_size` members scheduled on
+  // `options.pool`, one of them and the smaller ones being run by the calling
+  // thread. All sets are looked up first, on the calling thread, so
+  // `lookup_fn` doesn't need to be thread safe.
+  KVSetView Run(absl::FunctionRef<KVSetView(std::string_view key)> lookup_fn,
+                const ParallelOptions& options) const;
+  IdBitmap RunBitmap(
+      absl::FunctionRef<IdBitmap(std::string_view key)> lookup_fn,
+      const ParallelOptions& options) const;
+
+  // Estimates the sizes and the cost of the steps of the program from the
+  // sizes of the sets of its keys, given by `size_fn`, without running it.
+  QueryProfile Explain(
+      absl::FunctionRef<int64_t(std::string_view key)> size_fn) const;
+  // Same as `Run`, sequentially, with the sizes and latencies of the steps
+  // measured in `profile`.
+  KVSetView Profile(
+      absl::FunctionRef<KVSetView(std::string_view key)> lookup_fn,
+      QueryProfile& profile) const;
+  IdBitmap ProfileBitmap(
+      absl::FunctionRef<IdBitmap(std::string_view key)> lookup_fn,
+      QueryProfile& profile) const;
+
+  absl::Span<const Instruction> instructions() const { return instructions_; }
+  // The distinct keys that the program loads.
+  absl::Span<const std::string> keys() const { return keys_; }
+  // The most sets that are on the stack at once.
+  int max_stack_size() const { return max_stack_size_; }
+
+ private:
+  friend class QueryProgramCompiler;
+
+  template <typename Set>
+  friend class ParallelRun;
+
+  template <typename Set>
+  Set RunOver(absl::FunctionRef<Set(std::string_view key)> lookup_fn) const;
+  template <typename Set>
+  Set RunOver(absl::FunctionRef<Set(std::string_view key)> lookup_fn,
+              const ParallelOptions& options) const;
+  // Runs the instructions in [begin, end), with the set of the load at index
+  // `i` given by `load_fn(i)`.
+  template <typename Set, typename LoadFn>
+  Set RunInstructions(size_t begin, size_t end, LoadFn load_fn) const;
+  template <typename Set>
+  Set ProfileOver(absl::FunctionRef<Set(std::string_view key)> lookup_fn,
+                  QueryProfile& profile) const;
+
+  std::vector<Instruction> instructions_;
+  std::vector<std::string> keys_;
+  int max_stack_size_ = 0;
+};
+
+// The steps of a `QueryProgram`, one per instruction, annotated with the sizes
+// of their sets, either estimated by `QueryProgram::Explain` or measured by
+// `QueryProgram::Profile`.
+struct QueryProfile {
+  struct Step {
+    QueryProgram::OpCode op_code = QueryProgram::OpCode::kLoad;
+    // For loads, the key of the set.
+    std::string key;
+    // For operations, the sizes of their operands, in order.
+    std::vector<int64_t> input_sizes;
+    // The size of the result. Estimates are upper bounds.
+    int64_t output_size = 0;
+    // For operations, how the operands are combined.
+    std::string_view algorithm;
+    // For operations, the operands that were applied before the result was
+    // known, intersections and differences stop once it's empty. Estimates
+    // assume all of them are.
+    int num_applied_operands = 0;
+    // Measured time of the step, without its operands.
+    absl::Duration latency;
+  };
+
+  // Whether the sizes and latencies are measured, rather than estimated.
+  bool measured = false;
+  // In program order, the operands of an operation before it.
+  std::vector<Step> steps;
+
+  // The members that the operations read or probe, an estimate of the cost of
+  // running the program.
+  int64_t Cost() const;
+  // The sum of the latencies of the steps.
+  absl::Duration TotalLatency() const;
+  // The plan as an indented tree, one step per line, each operation followed
+  // by its operands.
+  std::string ToString() const;
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_QUERY_QUERY_PROGRAM_H_
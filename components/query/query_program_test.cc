@@ -0,0 +1,263 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/query/query_program.h"
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+using testing::ElementsAre;
+using testing::UnorderedElementsAre;
+
+const absl::flat_hash_map<std::string, KVSetView>& Sets() {
+  static const auto* sets = new absl::flat_hash_map<std::string, KVSetView>({
+      {"A", {"a", "b", "c"}},
+      {"B", {"b", "c", "d"}},
+      {"C", {"c", "d", "e"}},
+  });
+  return *sets;
+}
+
+KVSetView Lookup(std::string_view key) {
+  const auto it = Sets().find(key);
+  return it == Sets().end() ? KVSetView() : it->second;
+}
+
+std::unique_ptr<Node> Value(std::string key) {
+  return std::make_unique<ValueNode>(Lookup, std::move(key));
+}
+
+TEST(QueryProgramTest, EmptyProgramReturnsEmptySet) {
+  QueryProgram program;
+  EXPECT_TRUE(program.Run(Lookup).empty());
+  EXPECT_EQ(program.RunBitmap([](std::string_view) { return IdBitmap({1}); })
+                .Cardinality(),
+            0);
+}
+
+TEST(QueryProgramTest, CompilesToPostOrderInstructions) {
+  // (A | B) - A
+  DifferenceNode root(
+      std::make_unique<UnionNode>(Value("A"), Value("B")), Value("A"));
+  const QueryProgram program = QueryProgram::Compile(root);
+  using OpCode = QueryProgram::OpCode;
+  std::vector<OpCode> op_codes;
+  std::vector<uint32_t> key_indexes;
+  std::vector<uint32_t> num_operands;
+  for (const auto& instruction : program.instructions()) {
+    op_codes.push_back(instruction.op_code);
+    key_indexes.push_back(instruction.key_index);
+    num_operands.push_back(instruction.num_operands);
+  }
+  EXPECT_THAT(op_codes, ElementsAre(OpCode::kLoad, OpCode::kLoad,
+                                    OpCode::kUnion, OpCode::kLoad,
+                                    OpCode::kDifference));
+  EXPECT_THAT(key_indexes, ElementsAre(0, 1, 0, 0, 0));
+  EXPECT_THAT(num_operands, ElementsAre(0, 0, 2, 0, 2));
+  EXPECT_THAT(program.keys(), ElementsAre("A", "B"));
+  EXPECT_EQ(program.max_stack_size(), 2);
+}
+
+TEST(QueryProgramTest, RunMatchesEval) {
+  // (A & B) | (C - (A - B))
+  UnionNode root(
+      std::make_unique<IntersectionNode>(Value("A"), Value("B")),
+      std::make_unique<DifferenceNode>(
+          Value("C"), std::make_unique<DifferenceNode>(Value("A"),
+                                                     Value("B"))));
+  const QueryProgram program = QueryProgram::Compile(root);
+  EXPECT_EQ(program.max_stack_size(), 4);
+  EXPECT_EQ(program.Run(Lookup), Eval(root));
+  EXPECT_THAT(program.Run(Lookup), UnorderedElementsAre("b", "c", "d", "e"));
+}
+
+TEST(QueryProgramTest, FlattensChainsOfTheSameOperation) {
+  using OpCode = QueryProgram::OpCode;
+  // ((A & B) & C) & (B & A)
+  IntersectionNode intersection(
+      std::make_unique<IntersectionNode>(
+          std::make_unique<IntersectionNode>(Value("A"), Value("B")),
+          Value("C")),
+      std::make_unique<IntersectionNode>(Value("B"), Value("A")));
+  QueryProgram program = QueryProgram::Compile(intersection);
+  ASSERT_EQ(program.instructions().size(), 6);
+  EXPECT_EQ(program.instructions().back().op_code, OpCode::kIntersection);
+  EXPECT_EQ(program.instructions().back().num_operands, 5);
+  EXPECT_EQ(program.max_stack_size(), 5);
+  EXPECT_EQ(program.Run(Lookup), Eval(intersection));
+
+  // (A - B) - C is flattened, A - (B - C) is not.
+  DifferenceNode left_chain(
+      std::make_unique<DifferenceNode>(Value("A"), Value("B")), Value("C"));
+  program = QueryProgram::Compile(left_chain);
+  ASSERT_EQ(program.instructions().size(), 4);
+  EXPECT_EQ(program.instructions().back().num_operands, 3);
+  EXPECT_EQ(program.Run(Lookup), Eval(left_chain));
+  DifferenceNode right_chain(
+      Value("A"), std::make_unique<DifferenceNode>(Value("B"), Value("C")));
+  program = QueryProgram::Compile(right_chain);
+  ASSERT_EQ(program.instructions().size(), 5);
+  EXPECT_EQ(program.instructions().back().num_operands, 2);
+  EXPECT_THAT(program.Run(Lookup), UnorderedElementsAre("a", "c"));
+  EXPECT_EQ(program.Run(Lookup), Eval(right_chain));
+}
+
+TEST(QueryProgramTest, IntersectionWithAnEmptySetIsEmpty) {
+  // A & Missing & B | C
+  UnionNode root(
+      std::make_unique<IntersectionNode>(
+          std::make_unique<IntersectionNode>(Value("A"), Value("Missing")),
+          Value("B")),
+      Value("C"));
+  const QueryProgram program = QueryProgram::Compile(root);
+  EXPECT_THAT(program.Run(Lookup), UnorderedElementsAre("c", "d", "e"));
+  IntersectionNode empty(Value("Missing"), Value("A"));
+  EXPECT_TRUE(QueryProgram::Compile(empty).Run(Lookup).empty());
+}
+
+TEST(QueryProgramTest, RunBitmap) {
+  IntersectionNode root(Value("A"), Value("B"));
+  const QueryProgram program = QueryProgram::Compile(root);
+  const IdBitmap result = program.RunBitmap([](std::string_view key) {
+    return key == "A" ? IdBitmap({1, 2, 3}) : IdBitmap({2, 3, 4});
+  });
+  EXPECT_EQ(result, IdBitmap({2, 3}));
+}
+
+TEST(QueryProgramTest, RunParallelMatchesRun) {
+  // ((A & B) | (C - (A - B))) - ((A | C) & (B & C))
+  DifferenceNode root(
+      std::make_unique<UnionNode>(
+          std::make_unique<IntersectionNode>(Value("A"), Value("B")),
+          std::make_unique<DifferenceNode>(
+              Value("C"), std::make_unique<DifferenceNode>(Value("A"),
+                                                         Value("B")))),
+      std::make_unique<IntersectionNode>(
+          std::make_unique<UnionNode>(Value("A"), Value("C")),
+          std::make_unique<IntersectionNode>(Value("B"), Value("C"))));
+  const QueryProgram program = QueryProgram::Compile(root);
+  for (int num_threads : {0, 1, 4}) {
+    ThreadPool pool(num_threads);
+    for (int min_parallel_size : {0, 6, 1000}) {
+      const QueryProgram::ParallelOptions options = {
+          .pool = &pool, .min_parallel_size = min_parallel_size};
+      EXPECT_EQ(program.Run(Lookup, options), program.Run(Lookup))
+          << num_threads << " threads, min size " << min_parallel_size;
+    }
+  }
+  EXPECT_THAT(program.Run(Lookup), UnorderedElementsAre("b", "e"));
+}
+
+TEST(QueryProgramTest, RunBitmapParallel) {
+  // (A & B) | (B - A)
+  UnionNode root(std::make_unique<IntersectionNode>(Value("A"), Value("B")),
+                 std::make_unique<DifferenceNode>(Value("B"), Value("A")));
+  const QueryProgram program = QueryProgram::Compile(root);
+  ThreadPool pool(/*num_threads=*/2);
+  const IdBitmap result = program.RunBitmap(
+      [](std::string_view key) {
+        return key == "A" ? IdBitmap({1, 2, 3}) : IdBitmap({2, 3, 4});
+      },
+      {.pool = &pool, .min_parallel_size = 0});
+  EXPECT_EQ(result, IdBitmap({2, 3, 4}));
+}
+
+TEST(QueryProgramTest, OutlivesTheTree) {
+  QueryProgram program;
+  {
+    UnionNode root(Value("A"), Value("C"));
+    program = QueryProgram::Compile(root);
+  }
+  EXPECT_THAT(program.Run(Lookup), UnorderedElementsAre("a", "b", "c", "d",
+                                                         "e"));
+}
+
+TEST(QueryProgramTest, ExplainEstimatesSizesAndCost) {
+  // (A | B) & C
+  IntersectionNode root(std::make_unique<UnionNode>(Value("A"), Value("B")),
+                        Value("C"));
+  const QueryProgram program = QueryProgram::Compile(root);
+  const QueryProfile plan =
+      program.Explain([](std::string_view key) { return Lookup(key).size(); });
+  EXPECT_FALSE(plan.measured);
+  ASSERT_EQ(plan.steps.size(), 5);
+  EXPECT_EQ(plan.steps[0].key, "A");
+  EXPECT_EQ(plan.steps[0].output_size, 3);
+  EXPECT_THAT(plan.steps[2].input_sizes, ElementsAre(3, 3));
+  EXPECT_EQ(plan.steps[2].output_size, 6);
+  EXPECT_THAT(plan.steps[4].input_sizes, ElementsAre(6, 3));
+  EXPECT_EQ(plan.steps[4].output_size, 3);
+  // The union inserts the 3 members of B, the intersection probes the 3 of C.
+  EXPECT_EQ(plan.Cost(), 6);
+  EXPECT_EQ(plan.ToString(),
+            "Plan, cost 6 members\n"
+            "  Intersection (smallest first, stop when empty) in [6, 3] -> "
+            "<=3\n"
+            "    Union (merge into largest) in [3, 3] -> <=6\n"
+            "      Load A -> <=3\n"
+            "      Load B -> <=3\n"
+            "    Load C -> <=3\n");
+}
+
+TEST(QueryProgramTest, ProfileMeasuresSizes) {
+  // (A | B) & C
+  IntersectionNode root(std::make_unique<UnionNode>(Value("A"), Value("B")),
+                        Value("C"));
+  const QueryProgram program = QueryProgram::Compile(root);
+  QueryProfile profile;
+  EXPECT_THAT(program.Profile(Lookup, profile),
+              UnorderedElementsAre("c", "d"));
+  EXPECT_TRUE(profile.measured);
+  ASSERT_EQ(profile.steps.size(), 5);
+  EXPECT_EQ(profile.steps[2].output_size, 4);
+  EXPECT_THAT(profile.steps[4].input_sizes, ElementsAre(4, 3));
+  EXPECT_EQ(profile.steps[4].output_size, 2);
+  EXPECT_EQ(profile.steps[4].num_applied_operands, 2);
+  EXPECT_EQ(profile.Cost(), 6);
+}
+
+TEST(QueryProgramTest, ProfileCountsOperandsAppliedBeforeEmptyResult) {
+  // A & D & B, D is empty.
+  IntersectionNode root(std::make_unique<IntersectionNode>(Value("A"),
+                                                           Value("D")),
+                        Value("B"));
+  const QueryProgram program = QueryProgram::Compile(root);
+  QueryProfile profile;
+  EXPECT_EQ(program.ProfileBitmap(
+                    [](std::string_view key) {
+                      return key == "D" ? IdBitmap() : IdBitmap({1, 2});
+                    },
+                    profile)
+                .Cardinality(),
+            0);
+  ASSERT_EQ(profile.steps.size(), 4);
+  EXPECT_THAT(profile.steps[3].input_sizes, ElementsAre(2, 0, 2));
+  EXPECT_EQ(profile.steps[3].num_applied_operands, 1);
+  EXPECT_EQ(profile.Cost(), 0);
+  EXPECT_THAT(profile.ToString(),
+              testing::HasSubstr("stopped after 1 operands"));
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -170,6 +170,19 @@ TEST(ScannerTest, Operators) {
   ASSERT_EQ(t7.token(), Parser::token::YYEOF);
 }
 
+TEST(ScannerTest, ResultClauses) {
+  std::istringstream stream("LIMIT limit COUNT count EXISTS exists");
+  Scanner scanner(stream);
+  Driver driver(NeverUsedLookup);
+
+  for (const auto token : {Parser::token::LIMIT, Parser::token::COUNT,
+                           Parser::token::EXISTS}) {
+    ASSERT_EQ(scanner.yylex(driver).token(), token);
+    ASSERT_EQ(scanner.yylex(driver).token(), token);
+  }
+  ASSERT_EQ(scanner.yylex(driver).token(), Parser::token::YYEOF);
+}
+
 TEST(ScannerTest, Error) {
   std::istringstream stream("!");
   Scanner scanner(stream);
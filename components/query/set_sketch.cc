@@ -0,0 +1,124 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/query/set_sketch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/hash/hash.h"
+#include "absl/numeric/bits.h"
+#include "absl/strings/str_cat.h"
+
+namespace kv_server {
+namespace {
+
+// Computes the estimates of the unions of the sketches of every subset of
+// `sketches` that adds the sketches from `next` on to the union `current`
+// of the subset `mask`, by subset mask.
+void EstimateUnions(const std::vector<const SetSketch*>& sketches, int next,
+                    uint32_t mask, const SetSketch& current,
+                    std::vector<double>& union_estimates) {
+  for (int i = next; i < static_cast<int>(sketches.size()); ++i) {
+    SetSketch union_sketch = current;
+    union_sketch.Merge(*sketches[i]);
+    const uint32_t union_mask = mask | (uint32_t{1} << i);
+    union_estimates[union_mask] = union_sketch.Estimate();
+    EstimateUnions(sketches, i + 1, union_mask, union_sketch,
+                   union_estimates);
+  }
+}
+
+}  // namespace
+
+void SetSketch::Add(std::string_view member) {
+  const uint64_t hash = absl::HashOf(member);
+  const uint64_t rest = hash << kPrecision;
+  const uint8_t rank =
+      rest == 0 ? 64 - kPrecision + 1 : absl::countl_zero(rest) + 1;
+  uint8_t& reg = registers_[hash >> (64 - kPrecision)];
+  reg = std::max(reg, rank);
+}
+
+void SetSketch::Merge(const SetSketch& other) {
+  for (int i = 0; i < kNumRegisters; ++i) {
+    registers_[i] = std::max(registers_[i], other.registers_[i]);
+  }
+}
+
+double SetSketch::Estimate() const {
+  double sum = 0;
+  int num_zeros = 0;
+  for (const uint8_t reg : registers_) {
+    sum += std::ldexp(1.0, -reg);
+    num_zeros += reg == 0;
+  }
+  constexpr double kM = kNumRegisters;
+  const double estimate = 0.7213 / (1 + 1.079 / kM) * kM * kM / sum;
+  // Small sets are counted more accurately from the empty registers.
+  if (estimate <= 2.5 * kM && num_zeros > 0) {
+    return kM * std::log(kM / num_zeros);
+  }
+  return estimate;
+}
+
+absl::StatusOr<double> EstimateCardinality(
+    const Node& root,
+    absl::FunctionRef<const SetSketch&(std::string_view key)> sketch_fn) {
+  const auto keys = root.Keys();
+  const int num_keys = keys.size();
+  if (num_keys > kMaxSketchQueryKeys) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Queries of more than ", kMaxSketchQueryKeys,
+                     " sets can't be estimated, got ", num_keys));
+  }
+  absl::flat_hash_map<std::string_view, int> key_indexes;
+  std::vector<const SetSketch*> sketches;
+  sketches.reserve(num_keys);
+  for (std::string_view key : keys) {
+    key_indexes.emplace(key, sketches.size());
+    sketches.push_back(&sketch_fn(key));
+  }
+  const uint32_t all_keys = (uint32_t{1} << num_keys) - 1;
+  std::vector<double> union_estimates(all_keys + 1, 0);
+  EstimateUnions(sketches, 0, 0, SetSketch(), union_estimates);
+  const double total = union_estimates[all_keys];
+
+  double estimate = 0;
+  for (uint32_t members_of = 1; members_of <= all_keys; ++members_of) {
+    if (!root.Contains([&](std::string_view key) {
+          return (members_of >> key_indexes.at(key)) & 1;
+        })) {
+      continue;
+    }
+    // Counts the elements in the sets of exactly the keys of `members_of`, by
+    // inclusion-exclusion over the elements in none of the sets of the keys
+    // outside of each of its subsets.
+    double region = 0;
+    for (uint32_t subset = members_of;; subset = (subset - 1) & members_of) {
+      const double outside = total - union_estimates[all_keys & ~subset];
+      region += absl::popcount(members_of & ~subset) % 2 == 0 ? outside
+                                                              : -outside;
+      if (subset == 0) break;
+    }
+    estimate += region;
+  }
+  return std::clamp(estimate, 0.0, total);
+}
+
+}  // namespace kv_server
@@ -0,0 +1,74 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_QUERY_SET_SKETCH_H_
+#define COMPONENTS_QUERY_SET_SKETCH_H_
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+#include "absl/functional/function_ref.h"
+#include "absl/status/statusor.h"
+#include "components/query/ast.h"
+
+namespace kv_server {
+
+// HyperLogLog sketch of the members of a set, which estimates the number of
+// members of the set, and of unions of sets, in time independent of their
+// sizes, with a standard error of about 1.6%.
+//
+// Members can be added, but not removed: the sketch of a set that members are
+// deleted from has to be built again.
+class SetSketch {
+ public:
+  // The sketch has 2^kPrecision registers.
+  static constexpr int kPrecision = 12;
+  static constexpr int kNumRegisters = 1 << kPrecision;
+
+  void Add(std::string_view member);
+
+  // Adds the members of `other` to this sketch.
+  void Merge(const SetSketch& other);
+
+  // Returns the estimated number of distinct members that were added.
+  double Estimate() const;
+
+ private:
+  // Each register keeps the longest run of leading zeros, plus one, of the
+  // hashes of the members that map to it.
+  std::array<uint8_t, kNumRegisters> registers_ = {};
+};
+
+// Queries with more keys than this aren't estimated, since the error of the
+// estimate grows with the number of keys, and its cost with 3^keys.
+inline constexpr int kMaxSketchQueryKeys = 10;
+
+// Returns the estimated number of members of the result of the tree at `root`,
+// with the sketches of the sets of its keys given by `sketch_fn`.
+//
+// The sketches of the unions of every subset of the keys give, by
+// inclusion-exclusion, the number of elements in the sets of exactly each
+// subset, which are then summed over the subsets whose elements are in the
+// result. The errors of the unions add up, so estimates of intersections and
+// differences much smaller than their sets are less accurate.
+absl::StatusOr<double> EstimateCardinality(
+    const Node& root,
+    absl::FunctionRef<const SetSketch&(std::string_view key)> sketch_fn);
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_QUERY_SET_SKETCH_H_
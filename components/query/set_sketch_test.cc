@@ -0,0 +1,141 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/query/set_sketch.h"
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/str_cat.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+absl::flat_hash_set<std::string_view> NoLookup(std::string_view key) {
+  return {};
+}
+
+std::unique_ptr<Node> Value(std::string key) {
+  return std::make_unique<ValueNode>(NoLookup, std::move(key));
+}
+
+// Adds the members from `begin` to `end`, exclusive, to `sketch`.
+void AddRange(int begin, int end, SetSketch& sketch) {
+  for (int i = begin; i < end; ++i) {
+    sketch.Add(absl::StrCat("member", i));
+  }
+}
+
+TEST(SetSketchTest, EmptySketchEstimatesZero) {
+  EXPECT_EQ(SetSketch().Estimate(), 0);
+}
+
+TEST(SetSketchTest, EstimatesSmallSetsClosely) {
+  SetSketch sketch;
+  AddRange(0, 100, sketch);
+  // Members added again aren't counted.
+  AddRange(0, 100, sketch);
+  EXPECT_NEAR(sketch.Estimate(), 100, 2);
+}
+
+TEST(SetSketchTest, EstimatesLargeSetsWithinError) {
+  SetSketch sketch;
+  AddRange(0, 1000000, sketch);
+  EXPECT_NEAR(sketch.Estimate(), 1000000, 1000000 * 0.05);
+}
+
+TEST(SetSketchTest, MergeEstimatesUnion) {
+  SetSketch left;
+  AddRange(0, 60000, left);
+  SetSketch right;
+  AddRange(40000, 100000, right);
+  left.Merge(right);
+  EXPECT_NEAR(left.Estimate(), 100000, 100000 * 0.05);
+}
+
+class EstimateCardinalityTest : public ::testing::Test {
+ protected:
+  EstimateCardinalityTest() {
+    // A has members [0, 60000), B [40000, 100000) and C [50000, 55000).
+    AddRange(0, 60000, sketches_["A"]);
+    AddRange(40000, 100000, sketches_["B"]);
+    AddRange(50000, 55000, sketches_["C"]);
+  }
+
+  double Estimate(const Node& root) {
+    const auto estimate =
+        EstimateCardinality(root, [this](std::string_view key) -> auto& {
+          return sketches_[key];
+        });
+    EXPECT_TRUE(estimate.ok()) << estimate.status();
+    return estimate.value_or(-1);
+  }
+
+  absl::flat_hash_map<std::string, SetSketch> sketches_;
+};
+
+TEST_F(EstimateCardinalityTest, Value) {
+  EXPECT_NEAR(Estimate(*Value("A")), 60000, 60000 * 0.05);
+}
+
+TEST_F(EstimateCardinalityTest, Union) {
+  EXPECT_NEAR(Estimate(UnionNode(Value("A"), Value("B"))), 100000,
+              100000 * 0.05);
+}
+
+TEST_F(EstimateCardinalityTest, Intersection) {
+  EXPECT_NEAR(Estimate(IntersectionNode(Value("A"), Value("B"))), 20000,
+              100000 * 0.05);
+}
+
+TEST_F(EstimateCardinalityTest, Difference) {
+  EXPECT_NEAR(Estimate(DifferenceNode(Value("A"), Value("B"))), 40000,
+              100000 * 0.05);
+}
+
+TEST_F(EstimateCardinalityTest, NestedOperations) {
+  // (A - C) & B has members [40000, 50000) and [55000, 60000).
+  EXPECT_NEAR(Estimate(IntersectionNode(
+                  std::make_unique<DifferenceNode>(Value("A"), Value("C")),
+                  Value("B"))),
+              15000, 100000 * 0.05);
+}
+
+TEST_F(EstimateCardinalityTest, DisjointIntersectionIsNotNegative) {
+  sketches_["D"];
+  EXPECT_EQ(Estimate(IntersectionNode(Value("A"), Value("D"))), 0);
+}
+
+TEST_F(EstimateCardinalityTest, TooManyKeysIsAnError) {
+  std::unique_ptr<Node> root = Value("key0");
+  for (int i = 1; i <= kMaxSketchQueryKeys; ++i) {
+    root = std::make_unique<UnionNode>(std::move(root),
+                                       Value(absl::StrCat("key", i)));
+  }
+  const auto estimate =
+      EstimateCardinality(*root, [this](std::string_view key) -> auto& {
+        return sketches_[key];
+      });
+  EXPECT_EQ(estimate.status().code(), absl::StatusCode::kInvalidArgument);
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -20,6 +20,7 @@
 #include <utility>
 
 #include "absl/container/flat_hash_set.h"
+#include "components/query/id_bitmap.h"
 
 namespace kv_server {
 template <typename T>
@@ -51,5 +52,28 @@ absl::flat_hash_set<T> Difference(absl::flat_hash_set<T>&& left,
   return std::move(left);
 }
 
+// Same operations over member id bitmaps. Containers on both sides are
+// combined word by word instead of element by element.
+inline IdBitmap Union(IdBitmap&& left, IdBitmap&& right) {
+  const bool left_is_small = left.Cardinality() <= right.Cardinality();
+  auto& small = left_is_small ? left : right;
+  auto& big = left_is_small ? right : left;
+  big |= small;
+  return std::move(big);
+}
+
+inline IdBitmap Intersection(IdBitmap&& left, IdBitmap&& right) {
+  const bool left_is_small = left.Cardinality() <= right.Cardinality();
+  auto& small = left_is_small ? left : right;
+  const auto& big = left_is_small ? right : left;
+  small &= big;
+  return std::move(small);
+}
+
+inline IdBitmap Difference(IdBitmap&& left, IdBitmap&& right) {
+  left -= right;
+  return std::move(left);
+}
+
 }  // namespace kv_server
 #endif  // COMPONENTS_QUERY_SETS_H_
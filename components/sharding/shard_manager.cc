@@ -13,6 +13,8 @@
 // limitations under the License.
 #include "components/sharding/shard_manager.h"
 
+#include <algorithm>
+#include <atomic>
 #include <iterator>
 #include <map>
 #include <memory>
@@ -24,8 +26,16 @@
 
 #include "absl/base/thread_annotations.h"
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/inlined_vector.h"
+#include "absl/log/log.h"
+#include "absl/status/status.h"
 #include "absl/strings/str_format.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "components/telemetry/server_definition.h"
+#include "grpcpp/alarm.h"
 
 namespace kv_server {
 namespace {
@@ -44,58 +54,335 @@ class RandomGeneratorImpl : public RandomGenerator {
   std::mt19937 generator_;
 };
 
+// Weight of the latest latency of a replica in its moving average.
+constexpr double kLatencyEwmaWeight = 0.2;
+// Latencies of a shard that its hedging delay is the percentile of.
+constexpr int kMaxHedgeDelaySamples = 1000;
+// Lookups aren't hedged before their shard has this many latency samples.
+constexpr int kMinHedgeDelaySamples = 100;
+// The hedging delay of a shard is recomputed after this many samples.
+constexpr int kHedgeDelayUpdateInterval = 100;
+// How long the new replicas of a cluster mapping update are given to connect
+// before they're added.
+constexpr absl::Duration kReplicaWarmUpTimeout = absl::Seconds(1);
+
+// Replicas added to, removed from, or moved between the shards of a cluster
+// mapping.
+struct ClusterMappingChurn {
+  int num_added = 0;
+  int num_removed = 0;
+  int num_moved = 0;
+};
+
+ClusterMappingChurn GetChurn(
+    const std::vector<std::vector<std::string>>& old_mappings,
+    const std::vector<std::vector<std::string>>& new_mappings) {
+  absl::flat_hash_map<std::string_view, int> old_shard_nums;
+  for (size_t shard_num = 0; shard_num < old_mappings.size(); ++shard_num) {
+    for (const auto& ip : old_mappings[shard_num]) {
+      old_shard_nums[ip] = shard_num;
+    }
+  }
+  ClusterMappingChurn churn;
+  for (size_t shard_num = 0; shard_num < new_mappings.size(); ++shard_num) {
+    for (const auto& ip : new_mappings[shard_num]) {
+      const auto iter = old_shard_nums.find(ip);
+      if (iter == old_shard_nums.end()) {
+        ++churn.num_added;
+        continue;
+      }
+      if (iter->second != static_cast<int>(shard_num)) {
+        ++churn.num_moved;
+      }
+      old_shard_nums.erase(iter);
+    }
+  }
+  churn.num_removed = old_shard_nums.size();
+  return churn;
+}
+
+// Recent latencies of the lookups sent to a shard, and their percentile
+// that the lookups of the shard are hedged after.
+class ShardLatencies {
+ public:
+  explicit ShardLatencies(int percentile) : percentile_(percentile) {}
+
+  void Record(absl::Duration latency) {
+    std::vector<absl::Duration> samples;
+    {
+      absl::MutexLock lock(&mutex_);
+      if (samples_.size() < kMaxHedgeDelaySamples) {
+        samples_.push_back(latency);
+      } else {
+        samples_[num_recorded_ % kMaxHedgeDelaySamples] = latency;
+      }
+      ++num_recorded_;
+      if (samples_.size() < kMinHedgeDelaySamples ||
+          num_recorded_ % kHedgeDelayUpdateInterval != 0) {
+        return;
+      }
+      samples = samples_;
+    }
+    // Sorted without the lock, so that recording doesn't wait for it.
+    const size_t index =
+        std::min(samples.size() * percentile_ / 100, samples.size() - 1);
+    std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+    absl::MutexLock lock(&mutex_);
+    hedge_delay_ = samples[index];
+  }
+
+  // Empty until the shard has enough samples.
+  std::optional<absl::Duration> GetHedgeDelay() const {
+    absl::MutexLock lock(&mutex_);
+    return hedge_delay_;
+  }
+
+ private:
+  const int percentile_;
+  mutable absl::Mutex mutex_;
+  std::vector<absl::Duration> samples_ ABSL_GUARDED_BY(mutex_);
+  int64_t num_recorded_ ABSL_GUARDED_BY(mutex_) = 0;
+  std::optional<absl::Duration> hedge_delay_ ABSL_GUARDED_BY(mutex_);
+};
+
+class ShardManagerImpl;
+
+// The client of a replica. Tracks the moving average of the latency of the
+// replica and its lookups in flight, and hedges its lookups when hedging is
+// enabled.
+class ReplicaClient : public RemoteLookupClient {
+ public:
+  ReplicaClient(std::unique_ptr<RemoteLookupClient> client,
+                const ShardManagerImpl& shard_manager)
+      : client_(std::move(client)), shard_manager_(shard_manager) {}
+
+  absl::StatusOr<InternalLookupResponse> GetValues(
+      const RequestContext& request_context,
+      std::string_view serialized_message,
+      int32_t padding_length) const override;
+
+  void GetValuesAsync(
+      const RequestContext& request_context,
+      std::string_view serialized_message, int32_t padding_length,
+      absl::AnyInvocable<void(absl::StatusOr<InternalLookupResponse>) &&>
+          on_done) const override;
+
+  // Streamed lookups aren't hedged, since chunks of two replicas can't be
+  // told apart once they're passed on.
+  void GetValuesStreamAsync(
+      const RequestContext& request_context,
+      std::string_view serialized_message, int32_t padding_length,
+      absl::AnyInvocable<void(InternalLookupResponse)> on_chunk,
+      absl::AnyInvocable<void(absl::Status) &&> on_done) const override;
+
+  std::string_view GetIpAddress() const override {
+    return client_->GetIpAddress();
+  }
+
+  bool WarmUp(absl::Time deadline) const override {
+    return client_->WarmUp(deadline);
+  }
+
+  // The expected wait for a new lookup. Lower is better.
+  double GetLoadScore() const {
+    return (ewma_latency_micros_.load() + 1.0) * (in_flight_.load() + 1);
+  }
+
+  void SetShardNum(int64_t shard_num) { shard_num_ = shard_num; }
+
+ private:
+  // A lookup sent to a second replica. It has its own request context, so
+  // that the call that loses can outlive the caller, and is cancelled once it
+  // has a response or its caller is cancelled.
+  struct HedgedLookup {
+    HedgedLookup(
+        const RequestContext& caller_context,
+        std::string_view serialized_message, int32_t padding_length,
+        absl::AnyInvocable<void(absl::StatusOr<InternalLookupResponse>) &&>
+            on_done)
+        : request_context(metrics_context),
+          serialized_message(serialized_message),
+          padding_length(padding_length),
+          caller_context(&caller_context),
+          on_done(std::move(on_done)) {}
+
+    ScopeMetricsContext metrics_context;
+    RequestContext request_context;
+    const std::string serialized_message;
+    const int32_t padding_length;
+    grpc::Alarm hedge_alarm;
+    absl::Mutex mutex;
+    // Null once the lookup has a response.
+    const RequestContext* caller_context ABSL_GUARDED_BY(mutex);
+    absl::AnyInvocable<void(absl::StatusOr<InternalLookupResponse>) &&>
+        on_done ABSL_GUARDED_BY(mutex);
+  };
+
+  void SendAndTrack(
+      const RequestContext& request_context,
+      std::string_view serialized_message, int32_t padding_length,
+      absl::AnyInvocable<void(absl::StatusOr<InternalLookupResponse>) &&>
+          on_done) const;
+  void Hedge(
+      const RequestContext& request_context,
+      std::string_view serialized_message, int32_t padding_length,
+      absl::AnyInvocable<void(absl::StatusOr<InternalLookupResponse>) &&>
+          on_done) const;
+  void SendHedgedLookup(std::shared_ptr<HedgedLookup> lookup,
+                        bool is_hedge) const;
+  void RecordLatency(absl::Duration latency) const;
+
+  std::unique_ptr<RemoteLookupClient> client_;
+  const ShardManagerImpl& shard_manager_;
+  std::atomic<int64_t> shard_num_ = 0;
+  mutable std::atomic<double> ewma_latency_micros_ = 0;
+  mutable std::atomic<int> in_flight_ = 0;
+};
+
 class ShardManagerImpl : public ShardManager {
  public:
   ShardManagerImpl(
       int32_t num_shards,
       std::function<std::unique_ptr<RemoteLookupClient>(const std::string& ip)>
           client_factory,
-      std::unique_ptr<RandomGenerator> random_generator)
+      std::unique_ptr<RandomGenerator> random_generator,
+      HedgingOptions hedging_options)
       : num_shards_{num_shards},
         client_factory_{client_factory},
-        random_generator_{std::move(random_generator)} {}
+        random_generator_{std::move(random_generator)},
+        hedging_options_{hedging_options} {
+    if (hedging_options_.enabled()) {
+      for (int i = 0; i < num_shards_; i++) {
+        shard_latencies_.push_back(
+            std::make_unique<ShardLatencies>(hedging_options_.percentile));
+      }
+    }
+  }
 
-  // taking in a set to exclude duplicates.
-  // set doesn't have an O(1) lookup --> converting to vector.
+  // Only the replicas that weren't in the mapping before get new clients,
+  // which are created and connected outside of the lock, so that lookups
+  // neither wait for them nor are sent to them before they're connected. An
+  // unchanged mapping is left as is.
   void InsertBatch(const std::vector<absl::flat_hash_set<std::string>>&
                        cluster_mappings) override {
     if (cluster_mappings.size() != num_shards_) {
       return;
     }
+    // Sorted, so that mappings can be compared.
     std::vector<std::vector<std::string>> cluster_mappings_vector;
-    absl::MutexLock lock(&mutex_);
+    cluster_mappings_vector.reserve(cluster_mappings.size());
     for (const auto& si : cluster_mappings) {
       std::vector<std::string> vc(si.begin(), si.end());
-      for (const auto& ip : vc) {
-        const auto key_iter = remote_lookup_clients_.find(ip);
-        if (key_iter != remote_lookup_clients_.end()) {
-          continue;
+      std::sort(vc.begin(), vc.end());
+      cluster_mappings_vector.push_back(std::move(vc));
+    }
+    std::vector<std::string> new_ips;
+    {
+      absl::ReaderMutexLock lock(&mutex_);
+      if (cluster_mappings_vector == cluster_mappings_) {
+        LogClusterMappingChurn(kClusterMappingUnchanged, 1);
+        return;
+      }
+      for (const auto& ips : cluster_mappings_vector) {
+        for (const auto& ip : ips) {
+          if (!remote_lookup_clients_.contains(ip)) {
+            new_ips.push_back(ip);
+          }
         }
-        remote_lookup_clients_.insert({ip, client_factory_(ip)});
       }
-      cluster_mappings_vector.emplace_back(std::move(vc));
     }
-    cluster_mappings_ = cluster_mappings_vector;
+    absl::flat_hash_map<std::string, std::unique_ptr<ReplicaClient>>
+        new_clients;
+    for (const auto& ip : new_ips) {
+      new_clients.emplace(
+          ip, std::make_unique<ReplicaClient>(client_factory_(ip), *this));
+    }
+    // All of the new replicas are connecting while the first is waited for.
+    for (const auto& [ip, client] : new_clients) {
+      client->WarmUp(/*deadline=*/absl::Now());
+    }
+    const absl::Time deadline = absl::Now() + kReplicaWarmUpTimeout;
+    int num_warm_up_failed = 0;
+    for (const auto& [ip, client] : new_clients) {
+      if (!client->WarmUp(deadline)) {
+        LOG(WARNING) << "Replica " << ip << " isn't connected after "
+                     << kReplicaWarmUpTimeout << ", adding it anyway";
+        ++num_warm_up_failed;
+      }
+    }
+    absl::MutexLock lock(&mutex_);
+    for (auto& [ip, client] : new_clients) {
+      // Another batch may have added the replica meanwhile.
+      remote_lookup_clients_.try_emplace(ip, std::move(client));
+    }
+    const ClusterMappingChurn churn =
+        GetChurn(cluster_mappings_, cluster_mappings_vector);
+    for (int shard_num = 0; shard_num < num_shards_; ++shard_num) {
+      for (const auto& ip : cluster_mappings_vector[shard_num]) {
+        remote_lookup_clients_.at(ip)->SetShardNum(shard_num);
+      }
+    }
+    cluster_mappings_ = std::move(cluster_mappings_vector);
+    VLOG(1) << "Cluster mapping changed, " << churn.num_added
+            << " replicas added, " << churn.num_removed << " removed and "
+            << churn.num_moved << " moved to another shard";
+    LogClusterMappingChurn(kClusterMappingChanged, 1);
+    LogClusterMappingChurn(kClusterMappingReplicaAdded, churn.num_added);
+    LogClusterMappingChurn(kClusterMappingReplicaRemoved, churn.num_removed);
+    LogClusterMappingChurn(kClusterMappingReplicaMoved, churn.num_moved);
+    LogClusterMappingChurn(kClusterMappingWarmUpFailed, num_warm_up_failed);
   }
 
   RemoteLookupClient* Get(int64_t shard_num) const override {
+    return GetReplica(shard_num, /*excluded_replica=*/nullptr);
+  }
+
+  // Picks the less loaded of two random replicas of the shard, other than
+  // `excluded_replica`. The pair is drawn with a single random number.
+  ReplicaClient* GetReplica(int64_t shard_num,
+                            const ReplicaClient* excluded_replica) const {
     absl::ReaderMutexLock lock(&mutex_);
     if (shard_num < 0 || shard_num >= num_shards_ ||
         cluster_mappings_.size() != num_shards_) {
       return nullptr;
     }
-    const auto& shard_replicas = cluster_mappings_[shard_num];
-    if (shard_replicas.size() == 0) {
-      return nullptr;
+    absl::InlinedVector<ReplicaClient*, 8> replicas;
+    for (const auto& ip_address : cluster_mappings_[shard_num]) {
+      const auto key_iter = remote_lookup_clients_.find(ip_address);
+      if (key_iter != remote_lookup_clients_.end() &&
+          key_iter->second.get() != excluded_replica) {
+        replicas.push_back(key_iter->second.get());
+      }
     }
-    const auto replica_idx = random_generator_->Get(shard_replicas.size());
-    const auto& ip_address = shard_replicas[replica_idx];
-    const auto key_iter = remote_lookup_clients_.find(ip_address);
-    if (key_iter == remote_lookup_clients_.end()) {
-      return nullptr;
-    } else {
-      return key_iter->second.get();
+    const int64_t num_replicas = replicas.size();
+    if (num_replicas < 2) {
+      return num_replicas == 0 ? nullptr : replicas[0];
+    }
+    const int64_t draw =
+        random_generator_->Get(num_replicas * (num_replicas - 1));
+    const int64_t first_idx = draw / (num_replicas - 1);
+    int64_t second_idx = draw % (num_replicas - 1);
+    if (second_idx >= first_idx) {
+      ++second_idx;
+    }
+    ReplicaClient* first = replicas[first_idx];
+    ReplicaClient* second = replicas[second_idx];
+    return second->GetLoadScore() < first->GetLoadScore() ? second : first;
+  }
+
+  bool IsHedgingEnabled() const { return hedging_options_.enabled(); }
+
+  void RecordLatency(int64_t shard_num, absl::Duration latency) const {
+    if (IsHedgingEnabled() && shard_num >= 0 && shard_num < num_shards_) {
+      shard_latencies_[shard_num]->Record(latency);
+    }
+  }
+
+  std::optional<absl::Duration> GetHedgeDelay(int64_t shard_num) const {
+    if (!IsHedgingEnabled() || shard_num < 0 || shard_num >= num_shards_) {
+      return std::nullopt;
     }
+    return shard_latencies_[shard_num]->GetHedgeDelay();
   }
 
  private:
@@ -103,14 +390,172 @@ class ShardManagerImpl : public ShardManager {
   // (idx) shard id -> set of ip_addresses
   std::vector<std::vector<std::string>> cluster_mappings_
       ABSL_GUARDED_BY(mutex_);
-  absl::flat_hash_map<std::string, std::unique_ptr<RemoteLookupClient>>
+  // Clients are never removed, so that the ones handed out stay valid.
+  absl::flat_hash_map<std::string, std::unique_ptr<ReplicaClient>>
       remote_lookup_clients_ ABSL_GUARDED_BY(mutex_);
   int32_t num_shards_;
   std::function<std::unique_ptr<RemoteLookupClient>(const std::string& ip)>
       client_factory_;
   std::unique_ptr<RandomGenerator> random_generator_;
+  const HedgingOptions hedging_options_;
+  // Empty without hedging.
+  std::vector<std::unique_ptr<ShardLatencies>> shard_latencies_;
 };
 
+absl::StatusOr<InternalLookupResponse> ReplicaClient::GetValues(
+    const RequestContext& request_context, std::string_view serialized_message,
+    int32_t padding_length) const {
+  if (shard_manager_.IsHedgingEnabled()) {
+    absl::Notification done;
+    absl::StatusOr<InternalLookupResponse> response;
+    Hedge(request_context, serialized_message, padding_length,
+          [&done, &response](absl::StatusOr<InternalLookupResponse> result) {
+            response = std::move(result);
+            done.Notify();
+          });
+    done.WaitForNotification();
+    return response;
+  }
+  ++in_flight_;
+  const absl::Time start = absl::Now();
+  auto response =
+      client_->GetValues(request_context, serialized_message, padding_length);
+  RecordLatency(absl::Now() - start);
+  return response;
+}
+
+void ReplicaClient::GetValuesAsync(
+    const RequestContext& request_context, std::string_view serialized_message,
+    int32_t padding_length,
+    absl::AnyInvocable<void(absl::StatusOr<InternalLookupResponse>) &&> on_done)
+    const {
+  if (shard_manager_.IsHedgingEnabled()) {
+    Hedge(request_context, serialized_message, padding_length,
+          std::move(on_done));
+  } else {
+    SendAndTrack(request_context, serialized_message, padding_length,
+                 std::move(on_done));
+  }
+}
+
+void ReplicaClient::GetValuesStreamAsync(
+    const RequestContext& request_context, std::string_view serialized_message,
+    int32_t padding_length,
+    absl::AnyInvocable<void(InternalLookupResponse)> on_chunk,
+    absl::AnyInvocable<void(absl::Status) &&> on_done) const {
+  ++in_flight_;
+  client_->GetValuesStreamAsync(
+      request_context, serialized_message, padding_length, std::move(on_chunk),
+      [this, on_done = std::move(on_done)](absl::Status status) mutable {
+        // The length of a stream grows with its response, so it says little
+        // about the latency of the replica.
+        --in_flight_;
+        std::move(on_done)(std::move(status));
+      });
+}
+
+void ReplicaClient::SendAndTrack(
+    const RequestContext& request_context, std::string_view serialized_message,
+    int32_t padding_length,
+    absl::AnyInvocable<void(absl::StatusOr<InternalLookupResponse>) &&> on_done)
+    const {
+  ++in_flight_;
+  client_->GetValuesAsync(
+      request_context, serialized_message, padding_length,
+      [this, start = absl::Now(), on_done = std::move(on_done)](
+          absl::StatusOr<InternalLookupResponse> response) mutable {
+        RecordLatency(absl::Now() - start);
+        std::move(on_done)(std::move(response));
+      });
+}
+
+// The hedge is sent by an alarm of gRPC, which only holds the lookup while it
+// fires, so that a lookup answered before its hedge is sent isn't kept alive
+// until then.
+void ReplicaClient::Hedge(
+    const RequestContext& request_context, std::string_view serialized_message,
+    int32_t padding_length,
+    absl::AnyInvocable<void(absl::StatusOr<InternalLookupResponse>) &&> on_done)
+    const {
+  if (request_context.IsCancelled()) {
+    std::move(on_done)(
+        absl::CancelledError("Request was cancelled or is past its deadline."));
+    return;
+  }
+  LogRemoteLookupHedgeEvent(kRemoteLookupHedgeLookup);
+  auto lookup = std::make_shared<HedgedLookup>(
+      request_context, serialized_message, padding_length, std::move(on_done));
+  HedgedLookup* const lookup_ptr = lookup.get();
+  lookup->request_context.SetDeadline(
+      {.deadline = request_context.deadline(), .is_cancelled = [lookup_ptr]() {
+         absl::MutexLock lock(&lookup_ptr->mutex);
+         return lookup_ptr->caller_context == nullptr ||
+                lookup_ptr->caller_context->IsCancelled();
+       }});
+  const int64_t shard_num = shard_num_;
+  // Set before the lookup is sent, since the response cancels the alarm.
+  if (const auto hedge_delay = shard_manager_.GetHedgeDelay(shard_num);
+      hedge_delay.has_value()) {
+    lookup->hedge_alarm.Set(
+        absl::ToChronoTime(absl::Now() + *hedge_delay),
+        [this, shard_num,
+         weak_lookup = std::weak_ptr<HedgedLookup>(lookup)](bool fired) {
+          auto lookup = weak_lookup.lock();
+          if (!fired || lookup == nullptr ||
+              lookup->request_context.IsCancelled()) {
+            return;
+          }
+          ReplicaClient* replica =
+              shard_manager_.GetReplica(shard_num, /*excluded_replica=*/this);
+          if (replica == nullptr) {
+            return;
+          }
+          LogRemoteLookupHedgeEvent(kRemoteLookupHedgeSent);
+          replica->SendHedgedLookup(std::move(lookup), /*is_hedge=*/true);
+        });
+  }
+  SendHedgedLookup(std::move(lookup), /*is_hedge=*/false);
+}
+
+void ReplicaClient::SendHedgedLookup(std::shared_ptr<HedgedLookup> lookup,
+                                     bool is_hedge) const {
+  const HedgedLookup& sent_lookup = *lookup;
+  SendAndTrack(
+      sent_lookup.request_context, sent_lookup.serialized_message,
+      sent_lookup.padding_length,
+      [lookup = std::move(lookup),
+       is_hedge](absl::StatusOr<InternalLookupResponse> response) {
+        absl::AnyInvocable<void(absl::StatusOr<InternalLookupResponse>) &&>
+            on_done;
+        {
+          absl::MutexLock lock(&lookup->mutex);
+          if (lookup->caller_context == nullptr) {
+            return;
+          }
+          lookup->caller_context = nullptr;
+          on_done = std::move(lookup->on_done);
+        }
+        // Outside of the lock, since the alarm may run its callback inline.
+        lookup->hedge_alarm.Cancel();
+        lookup->request_context.EndCall();
+        if (is_hedge) {
+          LogRemoteLookupHedgeEvent(kRemoteLookupHedgeWon);
+        }
+        std::move(on_done)(std::move(response));
+      });
+}
+
+void ReplicaClient::RecordLatency(absl::Duration latency) const {
+  --in_flight_;
+  const double latency_micros = absl::ToDoubleMicroseconds(latency);
+  double ewma = ewma_latency_micros_.load();
+  while (!ewma_latency_micros_.compare_exchange_weak(
+      ewma, ewma == 0 ? latency_micros
+                      : ewma + kLatencyEwmaWeight * (latency_micros - ewma))) {
+  }
+  shard_manager_.RecordLatency(shard_num_, latency);
+}
+
 absl::Status ValidateMapping(
     int32_t num_shards,
     const std::vector<absl::flat_hash_set<std::string>>& cluster_mappings) {
@@ -140,17 +585,20 @@ absl::StatusOr<std::unique_ptr<ShardManager>> ShardManager::Create(
     int32_t num_shards,
     privacy_sandbox::server_common::KeyFetcherManagerInterface&
         key_fetcher_manager,
-    const std::vector<absl::flat_hash_set<std::string>>& cluster_mappings) {
+    const std::vector<absl::flat_hash_set<std::string>>& cluster_mappings,
+    HedgingOptions hedging_options, RemoteLookupClientOptions client_options) {
   auto validationStatus = ValidateMapping(num_shards, cluster_mappings);
   if (!validationStatus.ok()) {
     return validationStatus;
   }
+  // The replicas inserted later get the same connections.
   auto shard_manager = std::make_unique<ShardManagerImpl>(
       cluster_mappings.size(),
-      [&key_fetcher_manager](const std::string& ip) {
-        return RemoteLookupClient::Create(ip, key_fetcher_manager);
+      [&key_fetcher_manager, client_options](const std::string& ip) {
+        return RemoteLookupClient::Create(ip, key_fetcher_manager,
+                                          client_options);
       },
-      std::make_unique<RandomGeneratorImpl>());
+      std::make_unique<RandomGeneratorImpl>(), hedging_options);
   shard_manager->InsertBatch(std::move(cluster_mappings));
   return shard_manager;
 }
@@ -160,13 +608,15 @@ absl::StatusOr<std::unique_ptr<ShardManager>> ShardManager::Create(
     const std::vector<absl::flat_hash_set<std::string>>& cluster_mappings,
     std::unique_ptr<RandomGenerator> random_generator,
     std::function<std::unique_ptr<RemoteLookupClient>(const std::string& ip)>
-        client_factory) {
+        client_factory,
+    HedgingOptions hedging_options) {
   auto validationStatus = ValidateMapping(num_shards, cluster_mappings);
   if (!validationStatus.ok()) {
     return validationStatus;
   }
   auto shard_manager = std::make_unique<ShardManagerImpl>(
-      cluster_mappings.size(), client_factory, std::move(random_generator));
+      cluster_mappings.size(), client_factory, std::move(random_generator),
+      hedging_options);
   shard_manager->InsertBatch(std::move(cluster_mappings));
   return shard_manager;
 }
@@ -35,10 +35,22 @@ class RandomGenerator {
   virtual int64_t Get(int64_t upper_bound) = 0;
 };
 
+// Hedging of the lookups sent to the replicas of a shard. A lookup that isn't
+// answered within the given percentile of the recent latencies of its shard is
+// sent to a second replica too, and whichever response comes first is used.
+struct HedgingOptions {
+  // The percentile, in (0, 100), of the latencies after which a lookup is
+  // hedged. 0 disables hedging.
+  int percentile = 0;
+  bool enabled() const { return percentile > 0; }
+};
+
 // This class allows communication between a UDF server and data servers.
 // A mapping from a shard number to a set of ip addresses should be inserted
-// periodically. The class allows to retreive a RemoteLookupClient assigned to a
-// random ip address from the provided pool. ShardManager is thread safe.
+// periodically. The class allows to retreive a RemoteLookupClient assigned to
+// one of the ip addresses from the provided pool: the less loaded of two random
+// replicas, by their recent latency and the lookups they have in flight.
+// ShardManager is thread safe.
 class ShardManager {
  public:
   virtual ~ShardManager() = default;
@@ -48,19 +60,23 @@ class ShardManager {
   virtual void InsertBatch(const std::vector<absl::flat_hash_set<std::string>>&
                                cluster_mappings) = 0;
   // Given the shard number, get a remote lookup client for one of the replicas
-  // in the pool.
+  // in the pool. With hedging, the lookups of the client are hedged to the
+  // other replicas of the shard.
   virtual RemoteLookupClient* Get(int64_t shard_num) const = 0;
   static absl::StatusOr<std::unique_ptr<ShardManager>> Create(
       int32_t num_shards,
       privacy_sandbox::server_common::KeyFetcherManagerInterface&
           key_fetcher_manager,
-      const std::vector<absl::flat_hash_set<std::string>>& cluster_mappings);
+      const std::vector<absl::flat_hash_set<std::string>>& cluster_mappings,
+      HedgingOptions hedging_options = {},
+      RemoteLookupClientOptions client_options = {});
   static absl::StatusOr<std::unique_ptr<ShardManager>> Create(
       int32_t num_shards,
       const std::vector<absl::flat_hash_set<std::string>>& cluster_mappings,
       std::unique_ptr<RandomGenerator> random_generator,
       std::function<std::unique_ptr<RemoteLookupClient>(const std::string& ip)>
-          client_factory);
+          client_factory,
+      HedgingOptions hedging_options = {});
 };
 }  // namespace kv_server
 #endif  // COMPONENTS_SHARDING_SHARD_MANAGER_H_
@@ -14,10 +14,13 @@
 
 #include "components/sharding/shard_manager.h"
 
+#include <atomic>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
 #include "components/internal_server/constants.h"
 #include "components/sharding/mocks.h"
 #include "gmock/gmock.h"
@@ -29,6 +32,79 @@ namespace {
 
 using privacy_sandbox::server_common::FakeKeyFetcherManager;
 
+// Answers with its ip address as the value of "key". Calls can be held until
+// they're released.
+class FakeRemoteLookupClient : public RemoteLookupClient {
+ public:
+  explicit FakeRemoteLookupClient(std::string ip_address)
+      : ip_address_(std::move(ip_address)) {}
+
+  absl::StatusOr<InternalLookupResponse> GetValues(
+      const RequestContext& request_context,
+      std::string_view serialized_message,
+      int32_t padding_length) const override {
+    return Response();
+  }
+
+  void GetValuesAsync(
+      const RequestContext& request_context,
+      std::string_view serialized_message, int32_t padding_length,
+      absl::AnyInvocable<void(absl::StatusOr<InternalLookupResponse>) &&>
+          on_done) const override {
+    {
+      absl::MutexLock lock(&mutex_);
+      if (hold_calls_) {
+        held_calls_.push_back(std::move(on_done));
+        return;
+      }
+    }
+    std::move(on_done)(Response());
+  }
+
+  std::string_view GetIpAddress() const override { return ip_address_; }
+
+  bool WarmUp(absl::Time deadline) const override {
+    ++num_warm_ups_;
+    return true;
+  }
+
+  int num_warm_ups() const { return num_warm_ups_; }
+
+  void HoldCalls() {
+    absl::MutexLock lock(&mutex_);
+    hold_calls_ = true;
+  }
+
+  void ReleaseCalls() {
+    std::vector<
+        absl::AnyInvocable<void(absl::StatusOr<InternalLookupResponse>) &&>>
+        held_calls;
+    {
+      absl::MutexLock lock(&mutex_);
+      hold_calls_ = false;
+      held_calls.swap(held_calls_);
+    }
+    for (auto& on_done : held_calls) {
+      std::move(on_done)(Response());
+    }
+  }
+
+ private:
+  InternalLookupResponse Response() const {
+    InternalLookupResponse response;
+    (*response.mutable_kv_pairs())["key"].set_value(ip_address_);
+    return response;
+  }
+
+  const std::string ip_address_;
+  mutable std::atomic<int> num_warm_ups_ = 0;
+  mutable absl::Mutex mutex_;
+  mutable bool hold_calls_ ABSL_GUARDED_BY(mutex_) = false;
+  mutable std::vector<
+      absl::AnyInvocable<void(absl::StatusOr<InternalLookupResponse>) &&>>
+      held_calls_ ABSL_GUARDED_BY(mutex_);
+};
+
 class ShardManagerTest : public ::testing::Test {
  protected:
   FakeKeyFetcherManager fake_key_fetcher_manager_;
@@ -134,5 +210,116 @@ TEST_F(ShardManagerTest, InsertRetrieveTwoVersions) {
   EXPECT_EQ(etalon, result);
 }
 
+class ShardManagerReplicaSelectionTest : public ::testing::Test {
+ protected:
+  ShardManagerReplicaSelectionTest() {
+    InitMetricsContextMap();
+    scope_metrics_context_ = std::make_unique<ScopeMetricsContext>();
+    request_context_ =
+        std::make_unique<RequestContext>(*scope_metrics_context_);
+  }
+
+  // Shard 0 has two replicas, and the random pair of them is always the same.
+  std::unique_ptr<ShardManager> CreateShardManager(
+      HedgingOptions hedging_options = {}) {
+    auto random_generator = std::make_unique<MockRandomGenerator>();
+    EXPECT_CALL(*random_generator, Get(testing::_))
+        .WillRepeatedly(testing::Return(0));
+    std::vector<absl::flat_hash_set<std::string>> cluster_mappings = {
+        {"some_ip_1", "some_ip_2"}, {"some_ip_3"}};
+    auto shard_manager = ShardManager::Create(
+        2, std::move(cluster_mappings), std::move(random_generator),
+        [this](const std::string& ip) {
+          auto client = std::make_unique<FakeRemoteLookupClient>(ip);
+          clients_[ip] = client.get();
+          ++num_clients_created_;
+          return client;
+        },
+        hedging_options);
+    EXPECT_TRUE(shard_manager.ok());
+    return *std::move(shard_manager);
+  }
+
+  absl::StatusOr<InternalLookupResponse> GetValues(
+      const ShardManager& shard_manager) {
+    return shard_manager.Get(0)->GetValues(*request_context_, "", 0);
+  }
+
+  absl::flat_hash_map<std::string, FakeRemoteLookupClient*> clients_;
+  int num_clients_created_ = 0;
+  std::unique_ptr<ScopeMetricsContext> scope_metrics_context_;
+  std::unique_ptr<RequestContext> request_context_;
+};
+
+TEST_F(ShardManagerReplicaSelectionTest, OnlyNewReplicasGetClients) {
+  auto shard_manager = CreateShardManager();
+  EXPECT_EQ(num_clients_created_, 3);
+  shard_manager->InsertBatch({{"some_ip_2", "some_ip_1"}, {"some_ip_3"}});
+  EXPECT_EQ(num_clients_created_, 3);
+
+  // "some_ip_2" is removed and "some_ip_3" moved to shard 0.
+  shard_manager->InsertBatch({{"some_ip_1", "some_ip_3"}, {"some_ip_4"}});
+  EXPECT_EQ(num_clients_created_, 4);
+  EXPECT_GT(clients_["some_ip_4"]->num_warm_ups(), 0);
+  EXPECT_EQ(shard_manager->Get(1)->GetIpAddress(), "some_ip_4");
+  EXPECT_THAT(shard_manager->Get(0)->GetIpAddress(),
+              testing::AnyOf("some_ip_1", "some_ip_3"));
+}
+
+TEST_F(ShardManagerReplicaSelectionTest, PicksReplicaWithFewerLookupsInFlight) {
+  auto shard_manager = CreateShardManager();
+  RemoteLookupClient* busy_replica = shard_manager->Get(0);
+  clients_[busy_replica->GetIpAddress()]->HoldCalls();
+  busy_replica->GetValuesAsync(
+      *request_context_, "", 0,
+      [](absl::StatusOr<InternalLookupResponse> response) {});
+  EXPECT_NE(busy_replica->GetIpAddress(),
+            shard_manager->Get(0)->GetIpAddress());
+  clients_[busy_replica->GetIpAddress()]->ReleaseCalls();
+}
+
+TEST_F(ShardManagerReplicaSelectionTest, DoesntHedgeWithoutLatencies) {
+  auto shard_manager = CreateShardManager({.percentile = 50});
+  RemoteLookupClient* replica = shard_manager->Get(0);
+  const std::string ip_address(replica->GetIpAddress());
+  clients_[ip_address]->HoldCalls();
+  absl::Notification done;
+  absl::StatusOr<InternalLookupResponse> response;
+  replica->GetValuesAsync(
+      *request_context_, "", 0,
+      [&done, &response](absl::StatusOr<InternalLookupResponse> result) {
+        response = std::move(result);
+        done.Notify();
+      });
+  EXPECT_FALSE(done.WaitForNotificationWithTimeout(absl::Milliseconds(100)));
+  clients_[ip_address]->ReleaseCalls();
+  ASSERT_TRUE(done.WaitForNotificationWithTimeout(absl::Seconds(10)));
+  ASSERT_TRUE(response.ok()) << response.status();
+  EXPECT_EQ(response->kv_pairs().at("key").value(), ip_address);
+}
+
+TEST_F(ShardManagerReplicaSelectionTest, SlowLookupIsHedgedToOtherReplica) {
+  auto shard_manager = CreateShardManager({.percentile = 50});
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_TRUE(GetValues(*shard_manager).ok());
+  }
+  RemoteLookupClient* replica = shard_manager->Get(0);
+  const std::string ip_address(replica->GetIpAddress());
+  clients_[ip_address]->HoldCalls();
+  absl::Notification done;
+  absl::StatusOr<InternalLookupResponse> response;
+  replica->GetValuesAsync(
+      *request_context_, "", 0,
+      [&done, &response](absl::StatusOr<InternalLookupResponse> result) {
+        response = std::move(result);
+        done.Notify();
+      });
+  ASSERT_TRUE(done.WaitForNotificationWithTimeout(absl::Seconds(10)));
+  ASSERT_TRUE(response.ok()) << response.status();
+  EXPECT_NE(response->kv_pairs().at("key").value(), ip_address);
+  // The response of the first replica comes too late and is dropped.
+  clients_[ip_address]->ReleaseCalls();
+}
+
 }  // namespace
 }  // namespace kv_server
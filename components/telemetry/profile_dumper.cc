@@ -0,0 +1,115 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/telemetry/profile_dumper.h"
+
+#include <sstream>
+#include <string>
+#include <utility>
+
+#include "absl/log/log.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
+#include "components/telemetry/server_definition.h"
+#include "components/util/periodic_closure.h"
+#include "components/util/profiler.h"
+
+namespace kv_server {
+namespace {
+
+class StringBlobReader : public BlobReader {
+ public:
+  explicit StringBlobReader(std::string contents)
+      : stream_(std::move(contents)) {}
+  std::istream& Stream() override { return stream_; }
+  bool CanSeek() const override { return true; }
+
+ private:
+  std::istringstream stream_;
+};
+
+class ProfileDumperImpl : public ProfileDumper {
+ public:
+  ProfileDumperImpl(Options options, BlobStorageClient& blob_client)
+      : options_(std::move(options)),
+        blob_client_(blob_client),
+        periodic_closure_(PeriodicClosure::Create()) {}
+
+  ~ProfileDumperImpl() override { Stop(); }
+
+  absl::Status Start() override {
+    SetContentionProfileSampleInterval(options_.contention_sample_interval);
+    return periodic_closure_->StartDelayed(options_.interval,
+                                           [this] { Dump(); });
+  }
+
+  void Stop() override {
+    if (periodic_closure_->IsRunning()) {
+      periodic_closure_->Stop();
+    }
+    SetContentionProfileSampleInterval(0);
+  }
+
+ private:
+  void Dump() {
+    const std::string time =
+        absl::FormatTime("%Y%m%dT%H%M%SZ", absl::Now(), absl::UTCTimeZone());
+    if (options_.cpu_profile_duration > absl::ZeroDuration()) {
+      Upload(absl::StrCat(time, ".cpu.prof"),
+             CollectCpuProfile(options_.cpu_profile_duration));
+    }
+    Upload(absl::StrCat(time, ".heap.pb.gz"), CollectHeapProfile());
+    if (options_.contention_sample_interval > 0) {
+      Upload(absl::StrCat(time, ".contention.prof"), TakeContentionProfile());
+    }
+  }
+
+  void Upload(std::string key, absl::StatusOr<std::string> profile) {
+    absl::Status status = profile.status();
+    if (status.ok()) {
+      StringBlobReader reader(*std::move(profile));
+      BlobStorageClient::DataLocation location = options_.location;
+      location.key = key;
+      status = blob_client_.PutBlob(reader, location);
+      if (status.ok()) {
+        LOG(INFO) << "Wrote profile " << location;
+      }
+    }
+    if (!status.ok()) {
+      LOG(ERROR) << "Failed writing profile " << key << ": " << status;
+    }
+    LogStatusSafeMetricsFn<kProfileDumpStatus>()(status, 1);
+  }
+
+  const Options options_;
+  BlobStorageClient& blob_client_;
+  std::unique_ptr<PeriodicClosure> periodic_closure_;
+};
+
+}  // namespace
+
+absl::StatusOr<std::unique_ptr<ProfileDumper>> ProfileDumper::Create(
+    Options options, BlobStorageClient& blob_client) {
+  if (options.interval <= options.cpu_profile_duration) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("The profiling interval ", options.interval,
+                     " must be longer than the CPU profiles ",
+                     options.cpu_profile_duration));
+  }
+  return std::make_unique<ProfileDumperImpl>(std::move(options), blob_client);
+}
+
+}  // namespace kv_server
@@ -0,0 +1,63 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_TELEMETRY_PROFILE_DUMPER_H_
+#define COMPONENTS_TELEMETRY_PROFILE_DUMPER_H_
+
+#include <memory>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/time/time.h"
+#include "components/data/blob_storage/blob_storage_client.h"
+
+namespace kv_server {
+
+// Writes profiles of the server to blob storage periodically, so that
+// deployed servers can be profiled without a custom image. Each dump writes
+// `<time>.cpu.prof`, `<time>.heap.pb.gz` and `<time>.contention.prof` under
+// the configured location, to be read with pprof and the server binary.
+//
+// Only available in nonprod builds, profiles show how the server handles the
+// requests it serves.
+class ProfileDumper {
+ public:
+  struct Options {
+    // Bucket and prefix of the profiles.
+    BlobStorageClient::DataLocation location;
+    // Time between the starts of two dumps.
+    absl::Duration interval = absl::Minutes(10);
+    // CPU time sampled by each dump. 0 skips CPU profiles.
+    absl::Duration cpu_profile_duration = absl::Seconds(10);
+    // One in this many waits for contended mutexes is recorded. 0 skips
+    // contention profiles.
+    int contention_sample_interval = 0;
+  };
+
+  virtual ~ProfileDumper() = default;
+
+  // Starts dumping, the first dump is one interval after the start.
+  virtual absl::Status Start() = 0;
+  virtual void Stop() = 0;
+
+  // Fails in prod builds.
+  static absl::StatusOr<std::unique_ptr<ProfileDumper>> Create(
+      Options options, BlobStorageClient& blob_client);
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_TELEMETRY_PROFILE_DUMPER_H_
@@ -0,0 +1,27 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/telemetry/profile_dumper.h"
+
+namespace kv_server {
+
+absl::StatusOr<std::unique_ptr<ProfileDumper>> ProfileDumper::Create(
+    Options options, BlobStorageClient& blob_client) {
+  return absl::FailedPreconditionError(
+      "Profiles are only dumped by nonprod builds");
+}
+
+}  // namespace kv_server
@@ -17,12 +17,15 @@
 #ifndef COMPONENTS_TELEMETRY_SERVER_DEFINITION_H_
 #define COMPONENTS_TELEMETRY_SERVER_DEFINITION_H_
 
+#include <cstdint>
 #include <memory>
+#include <optional>
 #include <string>
 #include <utility>
 
 #include "absl/time/time.h"
 #include "components/telemetry/error_code.h"
+#include "components/util/startup_report.h"
 #include "src/core/common/uuid/uuid.h"
 #include "src/metric/context_map.h"
 #include "src/util/duration.h"
@@ -56,6 +59,29 @@ inline constexpr double kLatencyInMicroSecondsBoundaries[] = {
     5'000,   10'000,    20'000,    40'000,    80'000,    160'000,       320'000,
     640'000, 1'000'000, 1'300'000, 2'600'000, 5'000'000, 10'000'000'000};
 
+// From realtime updates served within a second of their commit, to
+// snapshots of data committed days before.
+inline constexpr double kFreshnessLagInMicroSecondsBoundaries[] = {
+    10'000,      50'000,        100'000,        250'000,
+    500'000,     1'000'000,     2'500'000,      5'000'000,
+    10'000'000,  30'000'000,    60'000'000,     300'000'000,
+    900'000'000, 3'600'000'000, 21'600'000'000, 86'400'000'000};
+
+inline constexpr double kPercentageBoundaries[] = {5,  10, 20, 30, 40, 50,
+                                                    60, 70, 80, 90, 100};
+
+inline constexpr double kCountBoundaries[] = {
+    1, 10, 100, 1'000, 10'000, 100'000, 1'000'000, 10'000'000, 100'000'000};
+
+inline constexpr double kBytesBoundaries[] = {
+    1'000,      10'000,     100'000,     1'000'000,   5'000'000,
+    10'000'000, 50'000'000, 100'000'000, 500'000'000, 1'000'000'000};
+
+inline constexpr double kBytesPerSecondBoundaries[] = {
+    1'000'000,   5'000'000,   10'000'000,    25'000'000,    50'000'000,
+    100'000'000, 200'000'000, 500'000'000,   1'000'000'000, 2'000'000'000,
+    5'000'000'000};
+
 // String literals for absl status partition, the string list and literals match
 // those implemented in the absl::StatusCodeToString method
 // https://github.com/abseil/abseil-cpp/blob/1a03fb9dd1c533e42b6d7d1ebea85b448a07e793/absl/status/status.cc#L47
@@ -85,9 +111,234 @@ inline constexpr std::string_view kKeyValueCacheMiss = "KeyValueCacheMiss";
 inline constexpr std::string_view kKeyValueSetCacheHit = "KeyValueSetCacheHit";
 inline constexpr std::string_view kKeyValueSetCacheMiss =
     "KeyValueSetCacheMiss";
+// Looked up keys that the key filter of the cache ruled out, and keys that it
+// let through but were missing. Their ratio is the observed false positive
+// rate of the filter.
+inline constexpr std::string_view kKeyFilterNegative = "KeyFilterNegative";
+inline constexpr std::string_view kKeyFilterFalsePositive =
+    "KeyFilterFalsePositive";
+// Looked up keys that the tiered cache found in memory, and in its file on
+// disk.
+inline constexpr std::string_view kHotTierHit = "HotTierHit";
+inline constexpr std::string_view kColdTierHit = "ColdTierHit";
+// Queries that were run from their cached parsed tree, and queries that had to
+// be parsed.
+inline constexpr std::string_view kQueryCacheHit = "QueryCacheHit";
+inline constexpr std::string_view kQueryCacheMiss = "QueryCacheMiss";
+// Queries that were answered with their cached result, and queries over
+// versioned sets that had to be evaluated.
+inline constexpr std::string_view kQueryResultCacheHit = "QueryResultCacheHit";
+inline constexpr std::string_view kQueryResultCacheMiss =
+    "QueryResultCacheMiss";
+// Sets estimated from their cached sketch, and versioned sets whose sketch had
+// to be built.
+inline constexpr std::string_view kSetSketchCacheHit = "SetSketchCacheHit";
+inline constexpr std::string_view kSetSketchCacheMiss = "SetSketchCacheMiss";
 inline constexpr std::string_view kCacheAccessEvents[] = {
-    kKeyValueCacheHit, kKeyValueCacheMiss, kKeyValueSetCacheHit,
-    kKeyValueSetCacheMiss};
+    kKeyValueCacheHit,     kKeyValueCacheMiss,   kKeyValueSetCacheHit,
+    kKeyValueSetCacheMiss, kKeyFilterNegative,   kKeyFilterFalsePositive,
+    kHotTierHit,           kColdTierHit,         kQueryCacheHit,
+    kQueryCacheMiss,       kQueryResultCacheHit, kQueryResultCacheMiss,
+    kSetSketchCacheHit,    kSetSketchCacheMiss};
+
+// Keys, sets and queries that were served from the lookup memo of their
+// request, and ones that had to be looked up.
+inline constexpr std::string_view kLookupMemoHit = "LookupMemoHit";
+inline constexpr std::string_view kLookupMemoMiss = "LookupMemoMiss";
+inline constexpr std::string_view kLookupMemoEvents[] = {kLookupMemoHit,
+                                                         kLookupMemoMiss};
+
+// Structures of the in-memory caches that their memory is accounted to.
+inline constexpr std::string_view kCacheKeyBytes = "Keys";
+inline constexpr std::string_view kCacheValueBytes = "Values";
+inline constexpr std::string_view kCacheSetKeyBytes = "SetKeys";
+inline constexpr std::string_view kCacheSetValueBytes = "SetValues";
+inline constexpr std::string_view kCacheTombstoneBytes = "Tombstones";
+inline constexpr std::string_view kCacheHashTableBytes = "HashTables";
+inline constexpr std::string_view kCacheMemoryStructures[] = {
+    kCacheKeyBytes,      kCacheValueBytes,     kCacheSetKeyBytes,
+    kCacheSetValueBytes, kCacheTombstoneBytes, kCacheHashTableBytes};
+
+// Stats of the shared thread pool.
+inline constexpr std::string_view kThreadPoolQueueDepth = "QueueDepth";
+inline constexpr std::string_view kThreadPoolBusyThreads = "BusyThreads";
+inline constexpr std::string_view kThreadPoolUtilizationPercent =
+    "UtilizationPercent";
+inline constexpr std::string_view kThreadPoolStats[] = {
+    kThreadPoolQueueDepth, kThreadPoolBusyThreads,
+    kThreadPoolUtilizationPercent};
+
+// Memory of the cache storage allocated with huge pages requested, by the
+// pages it got, and the share of it that got huge pages.
+inline constexpr std::string_view kHugePageExplicitBytes = "ExplicitBytes";
+inline constexpr std::string_view kHugePageTransparentBytes =
+    "TransparentBytes";
+inline constexpr std::string_view kHugePageFallbackBytes = "FallbackBytes";
+inline constexpr std::string_view kHugePageCoveragePercent =
+    "CoveragePercent";
+inline constexpr std::string_view kHugePageStatNames[] = {
+    kHugePageExplicitBytes, kHugePageTransparentBytes, kHugePageFallbackBytes,
+    kHugePageCoveragePercent};
+
+// Memory of the process as tracked by tcmalloc, in use, resident, and free
+// in the allocator, by where it is kept.
+inline constexpr std::string_view kAllocatorInUseBytes = "InUseBytes";
+inline constexpr std::string_view kAllocatorResidentBytes = "ResidentBytes";
+inline constexpr std::string_view kAllocatorPageHeapFreeBytes =
+    "PageHeapFreeBytes";
+inline constexpr std::string_view kAllocatorCacheFreeBytes = "CacheFreeBytes";
+inline constexpr std::string_view kAllocatorReleasedBytes = "ReleasedBytes";
+inline constexpr std::string_view kAllocatorStatNames[] = {
+    kAllocatorInUseBytes, kAllocatorResidentBytes, kAllocatorPageHeapFreeBytes,
+    kAllocatorCacheFreeBytes, kAllocatorReleasedBytes};
+
+// Stats of the governor of data loading.
+inline constexpr std::string_view kDataLoadingGovernorThrottledBatches =
+    "ThrottledBatches";
+inline constexpr std::string_view kDataLoadingGovernorServingP99Micros =
+    "ServingP99Micros";
+inline constexpr std::string_view kDataLoadingGovernorStatNames[] = {
+    kDataLoadingGovernorThrottledBatches, kDataLoadingGovernorServingP99Micros};
+
+// Stats of the admission control of served requests.
+inline constexpr std::string_view kAdmissionInFlightRequests =
+    "InFlightRequests";
+inline constexpr std::string_view kAdmissionConcurrencyLimit =
+    "ConcurrencyLimit";
+inline constexpr std::string_view kAdmissionShedOverLimit = "ShedOverLimit";
+inline constexpr std::string_view kAdmissionShedDeadline = "ShedDeadline";
+inline constexpr std::string_view kAdmissionInternalLookupShedOverLimit =
+    "InternalLookupShedOverLimit";
+inline constexpr std::string_view kAdmissionInternalLookupShedDeadline =
+    "InternalLookupShedDeadline";
+inline constexpr std::string_view kAdmissionControlStatNames[] = {
+    kAdmissionInFlightRequests,
+    kAdmissionConcurrencyLimit,
+    kAdmissionShedOverLimit,
+    kAdmissionShedDeadline,
+    kAdmissionInternalLookupShedOverLimit,
+    kAdmissionInternalLookupShedDeadline};
+
+// The outputs kept by the UDF output cache and their bytes, and the lookups
+// that hit and missed, and the outputs evicted and invalidated since start.
+inline constexpr std::string_view kUdfOutputCacheEntries = "Entries";
+inline constexpr std::string_view kUdfOutputCacheBytes = "Bytes";
+inline constexpr std::string_view kUdfOutputCacheHits = "Hits";
+inline constexpr std::string_view kUdfOutputCacheMisses = "Misses";
+inline constexpr std::string_view kUdfOutputCacheEvictions = "Evictions";
+inline constexpr std::string_view kUdfOutputCacheInvalidations =
+    "Invalidations";
+inline constexpr std::string_view kUdfOutputCacheStatNames[] = {
+    kUdfOutputCacheEntries,   kUdfOutputCacheBytes,
+    kUdfOutputCacheHits,      kUdfOutputCacheMisses,
+    kUdfOutputCacheEvictions, kUdfOutputCacheInvalidations};
+
+// The responses kept by the internal lookup response cache and their bytes,
+// and the lookups that hit and missed, and the responses evicted and
+// invalidated since start.
+inline constexpr std::string_view kLookupResponseCacheEntries = "Entries";
+inline constexpr std::string_view kLookupResponseCacheBytes = "Bytes";
+inline constexpr std::string_view kLookupResponseCacheHits = "Hits";
+inline constexpr std::string_view kLookupResponseCacheMisses = "Misses";
+inline constexpr std::string_view kLookupResponseCacheEvictions = "Evictions";
+inline constexpr std::string_view kLookupResponseCacheInvalidations =
+    "Invalidations";
+inline constexpr std::string_view kLookupResponseCacheStatNames[] = {
+    kLookupResponseCacheEntries,   kLookupResponseCacheBytes,
+    kLookupResponseCacheHits,      kLookupResponseCacheMisses,
+    kLookupResponseCacheEvictions, kLookupResponseCacheInvalidations};
+
+// The (member, set key) pairs and distinct members kept by the reverse
+// membership indexes of the key-value sets and their estimated bytes, and the
+// indexes dropped for growing past their limit since start.
+inline constexpr std::string_view kSetMembershipIndexEntries = "Entries";
+inline constexpr std::string_view kSetMembershipIndexMembers = "Members";
+inline constexpr std::string_view kSetMembershipIndexBytes = "Bytes";
+inline constexpr std::string_view kSetMembershipIndexOverflows = "Overflows";
+inline constexpr std::string_view kSetMembershipIndexStatNames[] = {
+    kSetMembershipIndexEntries, kSetMembershipIndexMembers,
+    kSetMembershipIndexBytes, kSetMembershipIndexOverflows};
+
+// Blob storage clients that fetch byte ranges through the seeking input
+// streambuf.
+inline constexpr std::string_view kBlobStorageClientS3 = "s3";
+inline constexpr std::string_view kBlobStorageClientGcs = "gcs";
+inline constexpr std::string_view kBlobStorageClients[] = {
+    kBlobStorageClientS3, kBlobStorageClientGcs};
+
+// Calls that identical concurrent calls were coalesced into, and calls that
+// shared the result of such a call, by layer.
+inline constexpr std::string_view kSingleFlightV1Executed = "V1Executed";
+inline constexpr std::string_view kSingleFlightV1Collapsed = "V1Collapsed";
+inline constexpr std::string_view kSingleFlightInternalLookupExecuted =
+    "InternalLookupExecuted";
+inline constexpr std::string_view kSingleFlightInternalLookupCollapsed =
+    "InternalLookupCollapsed";
+inline constexpr std::string_view kSingleFlightUdfExecuted = "UdfExecuted";
+inline constexpr std::string_view kSingleFlightUdfCollapsed = "UdfCollapsed";
+inline constexpr std::string_view kSingleFlightEvents[] = {
+    kSingleFlightV1Executed,
+    kSingleFlightV1Collapsed,
+    kSingleFlightInternalLookupExecuted,
+    kSingleFlightInternalLookupCollapsed,
+    kSingleFlightUdfExecuted,
+    kSingleFlightUdfCollapsed};
+
+// Lookups sent to a shard while hedging is enabled, the ones of them that were
+// also sent to a second replica, and the ones the second replica answered
+// first.
+inline constexpr std::string_view kRemoteLookupHedgeLookup = "Lookup";
+inline constexpr std::string_view kRemoteLookupHedgeSent = "HedgeSent";
+inline constexpr std::string_view kRemoteLookupHedgeWon = "HedgeWon";
+inline constexpr std::string_view kRemoteLookupHedgeEvents[] = {
+    kRemoteLookupHedgeLookup, kRemoteLookupHedgeSent, kRemoteLookupHedgeWon};
+
+// Changes of the cluster mapping, from one update of the mapping to the next.
+inline constexpr std::string_view kClusterMappingUnchanged = "Unchanged";
+inline constexpr std::string_view kClusterMappingChanged = "Changed";
+inline constexpr std::string_view kClusterMappingReplicaAdded = "ReplicaAdded";
+inline constexpr std::string_view kClusterMappingReplicaRemoved =
+    "ReplicaRemoved";
+inline constexpr std::string_view kClusterMappingReplicaMoved = "ReplicaMoved";
+inline constexpr std::string_view kClusterMappingWarmUpFailed = "WarmUpFailed";
+inline constexpr std::string_view kClusterMappingEvents[] = {
+  kClusterMappingUnchanged, kClusterMappingChanged,
+  kClusterMappingReplicaAdded, kClusterMappingReplicaRemoved,
+  kClusterMappingReplicaMoved, kClusterMappingWarmUpFailed};
+
+// Sharded lookups whose keys are all sharded to the shard that runs them, all
+// to one other shard, or to more than one shard.
+inline constexpr std::string_view kShardSpreadSingleShardLocal =
+    "SingleShardLocal";
+inline constexpr std::string_view kShardSpreadSingleShardRemote =
+    "SingleShardRemote";
+inline constexpr std::string_view kShardSpreadMultiShard = "MultiShard";
+inline constexpr std::string_view kShardSpreadEvents[] = {
+    kShardSpreadSingleShardLocal, kShardSpreadSingleShardRemote,
+    kShardSpreadMultiShard};
+
+// Lookups of shards that the shard circuit breaker failed without sending
+// them, probes sent to shards that were failing, and shards whose lookups the
+// breaker started to fail.
+inline constexpr std::string_view kShardCircuitBreakerRejected = "Rejected";
+inline constexpr std::string_view kShardCircuitBreakerProbe = "Probe";
+inline constexpr std::string_view kShardCircuitBreakerTripped = "Tripped";
+inline constexpr std::string_view kShardCircuitBreakerEvents[] = {
+    kShardCircuitBreakerRejected, kShardCircuitBreakerProbe,
+    kShardCircuitBreakerTripped};
+
+// Content types that v2 responses are encoded in.
+inline constexpr std::string_view kV2ContentTypeJson = "Json";
+inline constexpr std::string_view kV2ContentTypeProto = "Proto";
+inline constexpr std::string_view kV2ContentTypeCbor = "Cbor";
+inline constexpr std::string_view kV2ContentTypes[] = {
+    kV2ContentTypeJson, kV2ContentTypeProto, kV2ContentTypeCbor};
+
+// Stats of the UDF executions sent to Roma.
+inline constexpr std::string_view kUdfExecutionsInFlight = "InFlight";
+inline constexpr std::string_view kUdfExecutionWorkers = "Workers";
+inline constexpr std::string_view kUdfExecutionStatNames[] = {
+    kUdfExecutionsInFlight, kUdfExecutionWorkers};
 
 inline constexpr privacy_sandbox::server_common::metrics::PrivacyBudget
     privacy_total_budget{/*epsilon*/ 5};
@@ -224,6 +475,16 @@ inline constexpr privacy_sandbox::server_common::metrics::Definition<
                            kCacheAccessEvents, kCounterDPUpperBound,
                            kCounterDPLowerBound);
 
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    int, privacy_sandbox::server_common::metrics::Privacy::kImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kPartitionedCounter>
+    kLookupMemoEventCount("LookupMemoEventCount",
+                          "Count of lookups of UDF hooks served from, or "
+                          "missing in, the lookup memo of the request",
+                          "memo_event", 2 /*max_partitions_contributed*/,
+                          kLookupMemoEvents, kCounterDPUpperBound,
+                          kCounterDPLowerBound);
+
 // Metric definitions for safe metrics that are not privacy impacting
 inline constexpr privacy_sandbox::server_common::metrics::Definition<
     int, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
@@ -246,6 +507,14 @@ inline constexpr privacy_sandbox::server_common::metrics::Definition<
                              "Server complete life cycle status", "status",
                              kAbslStatusStrings);
 
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    int, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kPartitionedCounter>
+    kProfileDumpStatus("ProfileDumpStatus",
+                       "Status of writing profiles of the server to blob "
+                       "storage",
+                       "status", kAbslStatusStrings);
+
 inline constexpr privacy_sandbox::server_common::metrics::Definition<
     int, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
     privacy_sandbox::server_common::metrics::Instrument::kPartitionedCounter>
@@ -314,6 +583,21 @@ inline constexpr privacy_sandbox::server_common::metrics::Definition<
         "notification messages",
         kLatencyInMicroSecondsBoundaries);
 
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    int, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kUpDownCounter>
+    kRealtimeOutstandingMessages(
+        "RealtimeOutstandingMessages",
+        "Number of realtime notification messages received by the notifier "
+        "and not acknowledged yet");
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    int, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kUpDownCounter>
+    kRealtimeUpdaterConcurrencyLimit(
+        "RealtimeUpdaterConcurrencyLimit",
+        "Number of realtime update batches that may be applied at once");
+
 inline constexpr privacy_sandbox::server_common::metrics::Definition<
     double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
     privacy_sandbox::server_common::metrics::Instrument::kHistogram>
@@ -321,6 +605,87 @@ inline constexpr privacy_sandbox::server_common::metrics::Definition<
                                  "AWS SQS receive message latency",
                                  kLatencyInMicroSecondsBoundaries);
 
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    int, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kPartitionedCounter>
+    kSingleFlightEventCount(
+        "SingleFlightEventCount",
+        "Count of calls executed for identical concurrent requests, and of "
+        "the calls that shared their result instead of being executed",
+        "event", kSingleFlightEvents);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    int, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kPartitionedCounter>
+    kRemoteLookupHedgeEventCount(
+        "RemoteLookupHedgeEventCount",
+        "Count of remote lookups sent while hedging is enabled, of the ones "
+        "hedged to a second replica, and of the hedges answered first",
+        "event", kRemoteLookupHedgeEvents);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    int, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kPartitionedCounter>
+    kClusterMappingChurnCount(
+        "ClusterMappingChurnCount",
+        "Count of cluster mapping updates that changed the mapping or not, "
+        "and of the replicas they added, removed or moved to another shard, "
+        "and of the new replicas that weren't connected in time",
+        "event", kClusterMappingEvents);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    int, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kPartitionedCounter>
+    kShardCircuitBreakerEventCount(
+        "ShardCircuitBreakerEventCount",
+        "Count of shard lookups failed by the circuit breaker without being "
+        "sent, of probes of failing shards, and of shards tripping the "
+        "breaker",
+        "event", kShardCircuitBreakerEvents);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    int, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kPartitionedCounter>
+    kV2ResponseEncodeCount("V2ResponseEncodeCount",
+                           "Count of Binary HTTP v2 responses encoded, by "
+                           "content type",
+                           "content_type", kV2ContentTypes);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    int, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kPartitionedCounter>
+    kV2ResponseEncodedBytes(
+        "V2ResponseEncodedBytes",
+        "Bytes of the bodies of Binary HTTP v2 responses, by content type",
+        "content_type", kV2ContentTypes);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    int, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kPartitionedCounter>
+    kV2ResponseEncodeMicros(
+        "V2ResponseEncodeMicros",
+        "Microseconds spent encoding the bodies of Binary HTTP v2 responses, "
+        "by content type",
+        "content_type", kV2ContentTypes);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    int, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kPartitionedCounter>
+    kShardedLookupShardSpreadCount(
+        "ShardedLookupShardSpreadCount",
+        "Count of sharded lookups whose keys are all sharded to the shard "
+        "that runs them, all to one other shard, or to more than one shard",
+        "spread", kShardSpreadEvents);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kHistogram>
+    kShardedLookupPaddingPercent(
+        "ShardedLookupPaddingPercent",
+        "Padding of the requests a sharded lookup sends to other shards, as a "
+        "percentage of their padded size",
+        kPercentageBoundaries);
+
 inline constexpr privacy_sandbox::server_common::metrics::Definition<
     int, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
     privacy_sandbox::server_common::metrics::Instrument::kPartitionedCounter>
@@ -380,6 +745,16 @@ inline constexpr privacy_sandbox::server_common::metrics::Definition<
         "data_source",
         privacy_sandbox::server_common::metrics::kEmptyPublicPartition);
 
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kPartitionedCounter>
+    kTotalRowsNotVerifiedInDataLoading(
+        "TotalRowsNotVerifiedInDataLoading",
+        "Total rows of trusted data files loaded without verifying their "
+        "flatbuffers",
+        "data_source",
+        privacy_sandbox::server_common::metrics::kEmptyPublicPartition);
+
 inline constexpr privacy_sandbox::server_common::metrics::Definition<
     double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
     privacy_sandbox::server_common::metrics::Instrument::kHistogram>
@@ -431,6 +806,22 @@ inline constexpr privacy_sandbox::server_common::metrics::Definition<
                               "Latency in deleting values in set",
                               kLatencyInMicroSecondsBoundaries);
 
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kHistogram>
+    kApplyMutationsLatency("ApplyMutationsLatency",
+                           "Latency in applying a batch of mutations",
+                           kLatencyInMicroSecondsBoundaries);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kHistogram>
+    kCacheGenerationSwapLatency(
+        "CacheGenerationSwapLatency",
+        "Time that cache mutations are paused to swap in a new cache "
+        "generation",
+        kLatencyInMicroSecondsBoundaries);
+
 inline constexpr privacy_sandbox::server_common::metrics::Definition<
     double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
     privacy_sandbox::server_common::metrics::Instrument::kHistogram>
@@ -453,6 +844,452 @@ inline constexpr privacy_sandbox::server_common::metrics::Definition<
                                   "Latency in cleaning up key value set map",
                                   kLatencyInMicroSecondsBoundaries);
 
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kHistogram>
+    kCacheSlabFragmentationPercent(
+        "CacheSlabFragmentationPercent",
+        "Percentage of freed bytes in each cache storage slab, logged after "
+        "the cache removes deleted keys",
+        kPercentageBoundaries);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kHistogram>
+    kCacheValueCompressionPercent(
+        "CacheValueCompressionPercent",
+        "Size of each value compressed by the cache, as a percentage of its "
+        "uncompressed size",
+        kPercentageBoundaries);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kHistogram>
+    kCacheValueDecompressionLatency(
+        "CacheValueDecompressionLatency",
+        "Latency in decompressing a value returned by a cache lookup",
+        kLatencyInMicroSecondsBoundaries);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kHistogram>
+    kResponseCompressionLatency(
+        "ResponseCompressionLatency",
+        "Latency in compressing one compression group of a v2 response",
+        kLatencyInMicroSecondsBoundaries);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kHistogram>
+    kResponseCompressionPercent(
+        "ResponseCompressionPercent",
+        "Size of each compressed compression group of a v2 response, as a "
+        "percentage of its uncompressed size",
+        kPercentageBoundaries);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kHistogram>
+    kV2ResponseBufferBytes(
+        "V2ResponseBufferBytes",
+        "Bytes of the buffers that held an HTTP, Binary HTTP or Oblivious HTTP "
+        "v2 response at the same time, the peak memory of its serialization",
+        kBytesBoundaries);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kHistogram>
+    kColdTierRebuildLatency(
+        "ColdTierRebuildLatency",
+        "Latency in moving the values that weren't looked up recently from "
+        "memory to the cold tier file of the tiered cache",
+        kLatencyInMicroSecondsBoundaries);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kHistogram>
+    kCacheCleanupBacklog(
+        "CacheCleanupBacklog",
+        "Number of deleted values kept by the cache, logged after each slice "
+        "of the background cleanup",
+        kCountBoundaries);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kHistogram>
+    kCacheCleanupLagInMicros(
+        "CacheCleanupLagInMicros",
+        "Time since the oldest pending cleanup of the cache was requested, "
+        "logged after each slice of the background cleanup",
+        kLatencyInMicroSecondsBoundaries);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kHistogram>
+    kDeltaFileQueueDepth("DeltaFileQueueDepth",
+                         "Number of new delta files waiting to be loaded, "
+                         "logged each time the waiting files are taken",
+                         kCountBoundaries);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kHistogram>
+    kDeltaFileQueueLagInMicros(
+        "DeltaFileQueueLagInMicros",
+        "Time the oldest waiting delta file waited to be loaded, logged each "
+        "time the waiting files are taken",
+        kLatencyInMicroSecondsBoundaries);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kHistogram>
+    kDeltaFileLoadLagInMicros(
+        "DeltaFileLoadLagInMicros",
+        "Time from a delta file being queued to being loaded, logged per file",
+        kLatencyInMicroSecondsBoundaries);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kHistogram>
+    kBlobFetchBytesPerSecond("BlobFetchBytesPerSecond",
+                             "Throughput of each byte range fetched by the "
+                             "seeking input streambuf, in bytes per second",
+                             kBytesPerSecondBoundaries);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    int, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kPartitionedCounter>
+    kBlobFetchBytes("BlobFetchBytes",
+                    "Bytes fetched by the seeking input streambuf, by blob "
+                    "storage client, so that its rate is the throughput of "
+                    "the client",
+                    "client", kBlobStorageClients);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    int, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kUpDownCounter>
+    kConcurrentStreamRecordReaderShardRetries(
+        "ConcurrentStreamRecordReaderShardRetries",
+        "Number of times ConcurrentStreamRecordReader read a shard of a file "
+        "again from its last record read after a read error");
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kHistogram>
+    kConcurrentStreamRecordReaderDecodeLatency(
+        "ConcurrentStreamRecordReaderDecodeLatency",
+        "Time ConcurrentStreamRecordReader spent reading and decoding the "
+        "Riegeli chunks of a shard, not counting the record callbacks",
+        kLatencyInMicroSecondsBoundaries);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kHistogram>
+    kDataLoadingDeserializeLatency(
+        "DataLoadingDeserializeLatency",
+        "Time spent deserializing the data records of a data load, summed "
+        "over the reader threads",
+        kLatencyInMicroSecondsBoundaries);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kHistogram>
+    kDataLoadingCacheApplyLatency(
+        "DataLoadingCacheApplyLatency",
+        "Time spent applying the mutations of a data load to the cache, "
+        "summed over the reader threads",
+        kLatencyInMicroSecondsBoundaries);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kHistogram>
+    kDataLoadingLockWaitLatency(
+        "DataLoadingLockWaitLatency",
+        "Time the reader threads of a data load waited for the mutation "
+        "batches of a partition to be applied, summed over the threads",
+        kLatencyInMicroSecondsBoundaries);
+
+// Contention of the mutexes of the key-value cache, only recorded when cache
+// lock metrics are enabled. The time to acquire each mutex, including shared
+// acquisitions by lookups, and the time each exclusive section held it.
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kHistogram>
+    kCachePartitionMapLockWaitLatency(
+        "CachePartitionMapLockWaitLatency",
+        "Time waited to lock the map of the partitions of the cache",
+        kLatencyInMicroSecondsBoundaries);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kHistogram>
+    kCachePartitionLockWaitLatency(
+        "CachePartitionLockWaitLatency",
+        "Time waited to lock a key-value partition of the cache",
+        kLatencyInMicroSecondsBoundaries);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kHistogram>
+    kCacheSetMapLockWaitLatency(
+        "CacheSetMapLockWaitLatency",
+        "Time waited to lock the key-value set map of the cache",
+        kLatencyInMicroSecondsBoundaries);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kHistogram>
+    kCacheValueSetLockWaitLatency(
+        "CacheValueSetLockWaitLatency",
+        "Time waited to lock one key-value set of the cache",
+        kLatencyInMicroSecondsBoundaries);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kHistogram>
+    kCachePartitionLockHoldLatency(
+        "CachePartitionLockHoldLatency",
+        "Time a key-value partition of the cache was locked by an update, "
+        "delete or cleanup",
+        kLatencyInMicroSecondsBoundaries);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kHistogram>
+    kCacheSetMapLockHoldLatency(
+        "CacheSetMapLockHoldLatency",
+        "Time the key-value set map of the cache was locked by an update, "
+        "delete or cleanup",
+        kLatencyInMicroSecondsBoundaries);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kHistogram>
+    kCacheValueSetLockHoldLatency(
+        "CacheValueSetLockHoldLatency",
+        "Time one key-value set of the cache was locked by an update, delete "
+        "or cleanup",
+        kLatencyInMicroSecondsBoundaries);
+
+// Exclusive sections of the cache mutexes held longer than the long hold
+// threshold, by mutex and by the operation that held it.
+inline constexpr std::string_view kCacheLongLockHolds[] = {
+    "PartitionMap:Update", "PartitionMap:Delete", "PartitionMap:Cleanup",
+    "Partition:Update",    "Partition:Delete",    "Partition:Cleanup",
+    "SetMap:Update",       "SetMap:Delete",       "SetMap:Cleanup",
+    "ValueSet:Update",     "ValueSet:Delete",     "ValueSet:Cleanup"};
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    int, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kPartitionedCounter>
+    kCacheLongLockHoldCount("CacheLongLockHoldCount",
+                            "Count of cache mutexes held longer than the long "
+                            "hold threshold, by mutex and operation",
+                            "lock_operation", kCacheLongLockHolds);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kGauge>
+    kCacheMemoryBytes("CacheMemoryBytes",
+                      "Estimated bytes used by the in-memory caches, by "
+                      "structure",
+                      "structure", kCacheMemoryStructures);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kGauge>
+    kCacheHugePageStats("CacheHugePageStats",
+                        "Bytes of the cache storage backed by hugetlbfs "
+                        "pages, advised for transparent huge pages, and "
+                        "falling back to regular pages, and the percentage "
+                        "of them backed by huge pages",
+                        "stat", kHugePageStatNames);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kGauge>
+    kAllocatorStats("AllocatorStats",
+                    "Bytes allocated by the process, resident in the "
+                    "allocator, free in its page heap and caches, and "
+                    "released to the OS",
+                    "stat", kAllocatorStatNames);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kGauge>
+    kSharedThreadPoolStats("SharedThreadPoolStats",
+                           "Tasks waiting for a thread, busy threads and the "
+                           "percentage of busy threads of the thread pool "
+                           "shared by data loading and sharded lookups",
+                           "stat", kThreadPoolStats);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kGauge>
+    kDataLoadingGovernorStats(
+        "DataLoadingGovernorStats",
+        "Number of batches of cache writes of data files delayed since start "
+        "because request serving was over its latency target, and the p99 "
+        "latency of the latest requests",
+        "stat", kDataLoadingGovernorStatNames);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kGauge>
+    kAdmissionControlStats(
+        "AdmissionControlStats",
+        "Requests in flight, the concurrency limit of served requests, and "
+        "the number of requests and of internal lookups rejected since start "
+        "because of the limit and because of their deadline",
+        "stat", kAdmissionControlStatNames);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kGauge>
+    kUdfOutputCacheStats(
+        "UdfOutputCacheStats",
+        "Outputs and bytes kept by the UDF output cache, and the number of "
+        "lookups that hit and missed it and of outputs evicted and "
+        "invalidated by data changes since start",
+        "stat", kUdfOutputCacheStatNames);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kGauge>
+    kLookupResponseCacheStats(
+        "LookupResponseCacheStats",
+        "Responses and bytes kept by the cache of responses to lookups from "
+        "other shards, and the number of lookups that hit and missed it and "
+        "of responses evicted and invalidated by data changes since start",
+        "stat", kLookupResponseCacheStatNames);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kGauge>
+    kSetMembershipIndexStats(
+        "SetMembershipIndexStats",
+        "Member and set key pairs and members kept by the reverse membership "
+        "indexes of the key-value sets, their estimated bytes, and the number "
+        "of indexes dropped for growing past their limit since start",
+        "stat", kSetMembershipIndexStatNames);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kGauge>
+    kUdfExecutionStats(
+        "UdfExecutionStats",
+        "UDF executions waiting for or running on a Roma worker, and the "
+        "number of Roma workers",
+        "stat", kUdfExecutionStatNames);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kHistogram>
+    kUdfExecutionLatencyInMicros(
+        "UdfExecutionLatencyInMicros",
+        "Time between sending a UDF execution to Roma and its end, including "
+        "the time it waits for a worker",
+        kLatencyInMicroSecondsBoundaries);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kHistogram>
+    kUdfColdExecutionPenaltyInMicros(
+        "UdfColdExecutionPenaltyInMicros",
+        "How much longer the first warm-up round of a new UDF code object "
+        "took than its last one",
+        kLatencyInMicroSecondsBoundaries);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kHistogram>
+    kUdfCodeObjectCompileLatencyInMicros(
+        "UdfCodeObjectCompileLatencyInMicros",
+        "Time between sending a new UDF code object to Roma and every worker "
+        "having compiled it, whether it compiled or not",
+        kLatencyInMicroSecondsBoundaries);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kGauge>
+    kStartupPhaseDurationMillis(
+        "StartupPhaseDurationMillis",
+        "Time the phases of the startup of the server took, and the total "
+        "time it took to become ready, by phase",
+        "phase", kStartupPhases);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kGauge>
+    kDeltaFileFreshnessLagInMicros(
+        "DeltaFileFreshnessLagInMicros",
+        "Time the oldest delta file waiting to be loaded has been queued, by "
+        "prefix. 0 once all the queued files of the prefix are loaded",
+        "prefix",
+        privacy_sandbox::server_common::metrics::kEmptyPublicPartition);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kGauge>
+    kDeltaCatchUpBacklogFiles(
+        "DeltaCatchUpBacklogFiles",
+        "Delta files found on start that are not loaded yet, by prefix, when "
+        "the server serves before it catches up with the delta files",
+        "prefix",
+        privacy_sandbox::server_common::metrics::kEmptyPublicPartition);
+
+// Time from the logical commit time of the records, read as microseconds
+// since the epoch, to their mutations being applied to the cache, by the kind
+// of data they were loaded from. Only recorded when the logical commit times
+// of the data are epoch microseconds.
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kHistogram>
+    kSnapshotFreshnessLagInMicros(
+        "SnapshotFreshnessLagInMicros",
+        "Time from the logical commit of the records of snapshot files to "
+        "their mutations being visible in the cache",
+        kFreshnessLagInMicroSecondsBoundaries);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kHistogram>
+    kDeltaFreshnessLagInMicros(
+        "DeltaFreshnessLagInMicros",
+        "Time from the logical commit of the records of delta files to their "
+        "mutations being visible in the cache",
+        kFreshnessLagInMicroSecondsBoundaries);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kHistogram>
+    kRealtimeFreshnessLagInMicros(
+        "RealtimeFreshnessLagInMicros",
+        "Time from the logical commit of the records of realtime updates to "
+        "their mutations being visible in the cache",
+        kFreshnessLagInMicroSecondsBoundaries);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kGauge>
+    kMaxDataFreshnessLagInMicros(
+        "MaxDataFreshnessLagInMicros",
+        "Largest freshness lag of the mutations applied to the cache since "
+        "the latest export, by kind of data and prefix, e.g. \"delta:\" for "
+        "the delta files of the main prefix",
+        "source_prefix",
+        privacy_sandbox::server_common::metrics::kEmptyPublicPartition);
+
+inline constexpr privacy_sandbox::server_common::metrics::Definition<
+    double, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
+    privacy_sandbox::server_common::metrics::Instrument::kGauge>
+    kRemoteLookupLatencyByShardInMicros(
+        "RemoteLookupLatencyByShardInMicros",
+        "Mean latency of the lookups sent to each other shard since the "
+        "latest export, by shard number",
+        "shard",
+        privacy_sandbox::server_common::metrics::kEmptyPublicPartition);
+
 inline constexpr privacy_sandbox::server_common::metrics::Definition<
     int, privacy_sandbox::server_common::metrics::Privacy::kNonImpacting,
     privacy_sandbox::server_common::metrics::Instrument::kUpDownCounter>
@@ -469,7 +1306,7 @@ inline constexpr const privacy_sandbox::server_common::metrics::DefinitionName*
         &kShardedLookupGetKeyValuesLatencyInMicros,
         &kShardedLookupGetKeyValueSetLatencyInMicros,
         &kShardedLookupRunQueryLatencyInMicros,
-        &kRemoteLookupGetValuesLatencyInMicros,
+        &kRemoteLookupGetValuesLatencyInMicros, &kLookupMemoEventCount,
         // Safe metrics
         &kKVServerError,
         &privacy_sandbox::server_common::metrics::kTotalRequestCount,
@@ -477,23 +1314,60 @@ inline constexpr const privacy_sandbox::server_common::metrics::DefinitionName*
         &privacy_sandbox::server_common::metrics::kRequestByte,
         &privacy_sandbox::server_common::metrics::kResponseByte,
         &kRequestFailedCountByStatus, &kGetParameterStatus,
-        &kCompleteLifecycleStatus, &kCreateDataOrchestratorStatus,
+        &kCompleteLifecycleStatus, &kProfileDumpStatus,
+        &kCreateDataOrchestratorStatus,
         &kStartDataOrchestratorStatus, &kLoadNewFilesStatus,
         &kGetShardManagerStatus, &kDescribeInstanceGroupInstancesStatus,
         &kDescribeInstancesStatus,
         &kReceivedLowLatencyNotificationsE2ECloudProvided,
         &kReceivedLowLatencyNotificationsE2E, &kReceivedLowLatencyNotifications,
-        &kAwsSqsReceiveMessageLatency, &kSeekingInputStreambufSeekoffLatency,
+        &kRealtimeOutstandingMessages, &kRealtimeUpdaterConcurrencyLimit,
+        &kAwsSqsReceiveMessageLatency,
+        &kSeekingInputStreambufSeekoffLatency,
         &kSeekingInputStreambufSizeLatency,
         &kSeekingInputStreambufUnderflowLatency,
         &kTotalRowsDroppedInDataLoading, &kTotalRowsUpdatedInDataLoading,
-        &kTotalRowsDeletedInDataLoading,
+        &kTotalRowsDeletedInDataLoading, &kTotalRowsNotVerifiedInDataLoading,
         &kConcurrentStreamRecordReaderReadShardRecordsLatency,
         &kConcurrentStreamRecordReaderReadStreamRecordsLatency,
         &kConcurrentStreamRecordReaderReadByteRangeLatency,
         &kUpdateKeyValueLatency, &kUpdateKeyValueSetLatency, &kDeleteKeyLatency,
-        &kDeleteValuesInSetLatency, &kRemoveDeletedKeyLatency,
-        &kCleanUpKeyValueMapLatency, &kCleanUpKeyValueSetMapLatency};
+        &kDeleteValuesInSetLatency, &kApplyMutationsLatency,
+        &kCacheGenerationSwapLatency, &kRemoveDeletedKeyLatency,
+        &kCleanUpKeyValueMapLatency, &kCleanUpKeyValueSetMapLatency,
+        &kCacheSlabFragmentationPercent, &kCacheValueCompressionPercent,
+        &kCacheValueDecompressionLatency, &kResponseCompressionLatency,
+        &kResponseCompressionPercent, &kV2ResponseBufferBytes,
+        &kColdTierRebuildLatency,
+        &kCacheCleanupBacklog, &kCacheCleanupLagInMicros,
+        &kDeltaFileQueueDepth, &kDeltaFileQueueLagInMicros,
+        &kDeltaFileLoadLagInMicros, &kBlobFetchBytesPerSecond,
+        &kBlobFetchBytes,
+        &kConcurrentStreamRecordReaderDecodeLatency,
+        &kConcurrentStreamRecordReaderShardRetries,
+        &kDataLoadingDeserializeLatency, &kDataLoadingCacheApplyLatency,
+        &kDataLoadingLockWaitLatency, &kCachePartitionMapLockWaitLatency,
+        &kCachePartitionLockWaitLatency, &kCacheSetMapLockWaitLatency,
+        &kCacheValueSetLockWaitLatency, &kCachePartitionLockHoldLatency,
+        &kCacheSetMapLockHoldLatency, &kCacheValueSetLockHoldLatency,
+        &kCacheLongLockHoldCount,
+        &kCacheMemoryBytes, &kCacheHugePageStats, &kAllocatorStats,
+        &kSharedThreadPoolStats,
+        &kDataLoadingGovernorStats, &kAdmissionControlStats,
+        &kSingleFlightEventCount, &kUdfOutputCacheStats,
+        &kLookupResponseCacheStats, &kSetMembershipIndexStats,
+        &kUdfExecutionStats, &kUdfExecutionLatencyInMicros,
+        &kUdfColdExecutionPenaltyInMicros,
+        &kUdfCodeObjectCompileLatencyInMicros,
+        &kStartupPhaseDurationMillis, &kDeltaFileFreshnessLagInMicros,
+        &kDeltaCatchUpBacklogFiles,
+        &kSnapshotFreshnessLagInMicros, &kDeltaFreshnessLagInMicros,
+        &kRealtimeFreshnessLagInMicros, &kMaxDataFreshnessLagInMicros,
+        &kRemoteLookupLatencyByShardInMicros,
+        &kRemoteLookupHedgeEventCount, &kShardedLookupPaddingPercent,
+        &kClusterMappingChurnCount, &kShardedLookupShardSpreadCount,
+        &kShardCircuitBreakerEventCount, &kV2ResponseEncodeCount,
+        &kV2ResponseEncodedBytes, &kV2ResponseEncodeMicros};
 
 // Internal lookup service metrics list contains metrics collected in the
 // internal lookup server. This separation from KV metrics list allows all
@@ -623,6 +1497,61 @@ inline void LogServerErrorMetric(std::string_view error_code) {
           {{std::string(error_code), 1}}));
 }
 
+// Logs whether a call of a single flight layer was executed or collapsed into
+// an identical call in flight.
+inline void LogSingleFlightEvent(std::string_view event) {
+  LogIfError(KVServerContextMap()
+                 ->SafeMetric()
+                 .LogUpDownCounter<kSingleFlightEventCount>(
+                     {{std::string(event), 1}}));
+}
+
+inline void LogRemoteLookupHedgeEvent(std::string_view event) {
+  LogIfError(KVServerContextMap()
+                 ->SafeMetric()
+                 .LogUpDownCounter<kRemoteLookupHedgeEventCount>(
+                     {{std::string(event), 1}}));
+}
+
+inline void LogShardCircuitBreakerEvent(std::string_view event) {
+  LogIfError(KVServerContextMap()
+                 ->SafeMetric()
+                 .LogUpDownCounter<kShardCircuitBreakerEventCount>(
+                     {{std::string(event), 1}}));
+}
+
+// Logs the encoding of the body of a v2 response in `content_type`, one of
+// `kV2ContentTypes`, into `bytes` in `latency`. The counts, bytes and
+// latencies of the content types can be compared by their averages.
+inline void LogV2ResponseEncoding(std::string_view content_type, size_t bytes,
+                                  absl::Duration latency) {
+  auto& metrics = KVServerContextMap()->SafeMetric();
+  LogIfError(metrics.LogUpDownCounter<kV2ResponseEncodeCount>(
+      {{std::string(content_type), 1}}));
+  LogIfError(metrics.LogUpDownCounter<kV2ResponseEncodedBytes>(
+      {{std::string(content_type), static_cast<int>(bytes)}}));
+  LogIfError(metrics.LogUpDownCounter<kV2ResponseEncodeMicros>(
+      {{std::string(content_type),
+        static_cast<int>(absl::ToInt64Microseconds(latency))}}));
+}
+
+inline void LogShardSpread(std::string_view spread) {
+  LogIfError(KVServerContextMap()
+                 ->SafeMetric()
+                 .LogUpDownCounter<kShardedLookupShardSpreadCount>(
+                     {{std::string(spread), 1}}));
+}
+
+inline void LogClusterMappingChurn(std::string_view event, int count) {
+  if (count == 0) {
+    return;
+  }
+  LogIfError(KVServerContextMap()
+                 ->SafeMetric()
+                 .LogUpDownCounter<kClusterMappingChurnCount>(
+                     {{std::string(event), static_cast<double>(count)}}));
+}
+
 // Logs common safe request metrics
 template <typename RequestT, typename ResponseT>
 inline void LogRequestCommonSafeMetrics(
@@ -737,6 +1666,77 @@ class ScopeLatencyMetricsRecorder {
   std::unique_ptr<privacy_sandbox::server_common::Stopwatch> stopwatch_;
 };
 
+// One in this many measurements of a safe metric that is measured per
+// mutation or per value, hundreds of millions of times while snapshots load,
+// is recorded, so that the metric doesn't cost a clock reading and a
+// histogram update each time. Sampled histograms keep the distribution of the
+// measurements, their counts are divided by the interval.
+template <const auto& definition>
+inline constexpr uint32_t kMetricSampleInterval = 1;
+template <>
+inline constexpr uint32_t kMetricSampleInterval<kUpdateKeyValueLatency> = 64;
+template <>
+inline constexpr uint32_t kMetricSampleInterval<kUpdateKeyValueSetLatency> =
+    64;
+template <>
+inline constexpr uint32_t kMetricSampleInterval<kDeleteKeyLatency> = 64;
+template <>
+inline constexpr uint32_t kMetricSampleInterval<kDeleteValuesInSetLatency> =
+    64;
+template <>
+inline constexpr uint32_t
+    kMetricSampleInterval<kCacheValueDecompressionLatency> = 64;
+template <>
+inline constexpr uint32_t kMetricSampleInterval<kCacheValueCompressionPercent> =
+    64;
+// Recorded per mutation. Realtime updates are few and each one counts.
+template <>
+inline constexpr uint32_t kMetricSampleInterval<kSnapshotFreshnessLagInMicros> =
+    1024;
+template <>
+inline constexpr uint32_t kMetricSampleInterval<kDeltaFreshnessLagInMicros> =
+    64;
+
+// Returns whether this measurement of `definition` is recorded. Each thread
+// counts its own measurements, so sampling takes no lock and shares no cache
+// line.
+template <const auto& definition>
+inline bool ShouldSampleMetric() {
+  if constexpr (kMetricSampleInterval<definition> == 1) {
+    return true;
+  } else {
+    static thread_local uint32_t num_measurements = 0;
+    return ++num_measurements % kMetricSampleInterval<definition> == 0;
+  }
+}
+
+// Like `ScopeLatencyMetricsRecorder` for the safe latency metrics of the
+// server, but only measures and records the sampled scopes, see
+// `kMetricSampleInterval`.
+template <const auto& definition>
+class SampledScopeLatencyMetricsRecorder {
+ public:
+  SampledScopeLatencyMetricsRecorder() {
+    if (ShouldSampleMetric<definition>()) {
+      stopwatch_.emplace();
+    }
+  }
+  SampledScopeLatencyMetricsRecorder(
+      const SampledScopeLatencyMetricsRecorder&) = delete;
+  SampledScopeLatencyMetricsRecorder& operator=(
+      const SampledScopeLatencyMetricsRecorder&) = delete;
+  ~SampledScopeLatencyMetricsRecorder() {
+    if (stopwatch_.has_value()) {
+      LogIfError(
+          KVServerContextMap()->SafeMetric().template LogHistogram<definition>(
+              absl::ToDoubleMicroseconds(stopwatch_->GetElapsedTime())));
+    }
+  }
+
+ private:
+  std::optional<privacy_sandbox::server_common::Stopwatch> stopwatch_;
+};
+
 }  // namespace kv_server
 
 #endif  // COMPONENTS_TELEMETRY_SERVER_DEFINITION_H_
@@ -16,12 +16,16 @@
 
 #include "components/tools/benchmarks/benchmark_util.h"
 
+#include <algorithm>
+#include <cmath>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "absl/random/distributions.h"
 #include "absl/strings/numbers.h"
 #include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
 #include "absl/time/time.h"
 #include "public/data_loading/records_utils.h"
 #include "public/data_loading/writers/delta_record_stream_writer.h"
@@ -62,9 +66,10 @@ std::string GenerateRandomString(const int64_t char_count) {
 }
 
 absl::Status WriteRecords(int64_t num_records, const int64_t record_size,
-                          std::iostream& output_stream) {
-  auto record_writer = DeltaRecordStreamWriter<>::Create(
-      output_stream, DeltaRecordWriter::Options{});
+                          std::iostream& output_stream,
+                          const DeltaRecordWriter::Options& writer_options) {
+  auto record_writer =
+      DeltaRecordStreamWriter<>::Create(output_stream, writer_options);
   if (!record_writer.ok()) {
     return record_writer.status();
   }
@@ -101,4 +106,43 @@ absl::StatusOr<std::vector<int64_t>> ParseInt64List(
   return result;
 }
 
+absl::StatusOr<std::vector<std::pair<std::string, int64_t>>> ParseWeightList(
+    const std::vector<std::string>& weight_list) {
+  std::vector<std::pair<std::string, int64_t>> result;
+  for (std::string_view weight_string : weight_list) {
+    std::pair<std::string, std::string> name_and_weight =
+        absl::StrSplit(weight_string, absl::MaxSplits(':', 1));
+    int64_t weight;
+    if (name_and_weight.first.empty() ||
+        !absl::SimpleAtoi(name_and_weight.second, &weight) || weight < 0) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Failed to parse weight: ", weight_string));
+    }
+    result.emplace_back(std::move(name_and_weight.first), weight);
+  }
+  return result;
+}
+
+ZipfianDistribution::ZipfianDistribution(int64_t num_ranks, double exponent) {
+  num_ranks = std::max<int64_t>(num_ranks, 1);
+  cumulative_probabilities_.reserve(num_ranks);
+  double sum = 0;
+  for (int64_t rank = 0; rank < num_ranks; ++rank) {
+    sum += 1.0 / std::pow(rank + 1, exponent);
+    cumulative_probabilities_.push_back(sum);
+  }
+  for (double& probability : cumulative_probabilities_) {
+    probability /= sum;
+  }
+}
+
+int64_t ZipfianDistribution::operator()(absl::BitGenRef bitgen) const {
+  const double probability = absl::Uniform<double>(bitgen, 0, 1);
+  const auto it =
+      std::lower_bound(cumulative_probabilities_.begin(),
+                       cumulative_probabilities_.end(), probability);
+  return std::min<int64_t>(it - cumulative_probabilities_.begin(),
+                           cumulative_probabilities_.size() - 1);
+}
+
 }  // namespace kv_server::benchmark
@@ -20,10 +20,13 @@
 #include <iostream>
 #include <string>
 #include <thread>
+#include <utility>
 #include <vector>
 
+#include "absl/random/bit_gen_ref.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "public/data_loading/writers/delta_record_writer.h"
 
 namespace kv_server::benchmark {
 
@@ -50,12 +53,35 @@ std::string GenerateRandomString(const int64_t char_count);
 
 // Write num_records, each with a size of record_size, to output_stream.
 absl::Status WriteRecords(int64_t num_records, int64_t record_size,
-                          std::iostream& output_stream);
+                          std::iostream& output_stream,
+                          const DeltaRecordWriter::Options& writer_options =
+                              DeltaRecordWriter::Options{});
 
 // Parses a numeric string list into a vector of int64 elements.
 absl::StatusOr<std::vector<int64_t>> ParseInt64List(
     const std::vector<std::string>& num_list);
 
+// Parses a list of `name:weight` strings, with non-negative integer weights,
+// into pairs of names and weights.
+absl::StatusOr<std::vector<std::pair<std::string, int64_t>>> ParseWeightList(
+    const std::vector<std::string>& weight_list);
+
+// Picks ranks in [0, num_ranks) with a Zipfian popularity: rank r, starting at
+// 0, is picked with a probability proportional to 1 / (r + 1)^exponent, so
+// that a few ranks are picked most of the time. Ranks are picked uniformly if
+// the exponent is 0. Thread-safe.
+class ZipfianDistribution {
+ public:
+  // Keeps the cumulative distribution of the ranks in memory.
+  ZipfianDistribution(int64_t num_ranks, double exponent);
+
+  int64_t operator()(absl::BitGenRef bitgen) const;
+
+ private:
+  // Probability that the rank is at most the index.
+  std::vector<double> cumulative_probabilities_;
+};
+
 }  // namespace kv_server::benchmark
 
 #endif  // COMPONENTS_TOOLS_BENCHMARKS_BENCHMARK_UTIL_H_
@@ -17,7 +17,9 @@
 #include "components/tools/benchmarks/benchmark_util.h"
 
 #include <sstream>
+#include <vector>
 
+#include "absl/random/random.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "public/data_loading/readers/delta_record_stream_reader.h"
@@ -45,6 +47,53 @@ TEST(BenchmarkUtilTest, VerifyParseInt64ListFailsWithInvalidList) {
   EXPECT_THAT(num_list.status().code(), absl::StatusCode::kInvalidArgument);
 }
 
+TEST(BenchmarkUtilTest, VerifyParseWeightListWorksWithValidList) {
+  auto weight_list = ParseWeightList({"get:80", "update:20", "delete:0"});
+  EXPECT_TRUE(weight_list.ok()) << weight_list.status();
+  EXPECT_THAT(*weight_list,
+              testing::ElementsAre(testing::Pair("get", 80),
+                                   testing::Pair("update", 20),
+                                   testing::Pair("delete", 0)));
+}
+
+TEST(BenchmarkUtilTest, VerifyParseWeightListFailsWithInvalidList) {
+  for (const auto& weight_string : {"get", "get:x", ":1", "get:-1"}) {
+    auto weight_list = ParseWeightList({weight_string});
+    EXPECT_FALSE(weight_list.ok()) << weight_string;
+    EXPECT_THAT(weight_list.status().code(),
+                absl::StatusCode::kInvalidArgument);
+  }
+}
+
+TEST(BenchmarkUtilTest, VerifyZipfianDistributionFavorsLowRanks) {
+  const ZipfianDistribution distribution(/*num_ranks=*/100, /*exponent=*/1.0);
+  absl::BitGen bitgen;
+  std::vector<int64_t> counts(100);
+  for (int i = 0; i < 100000; ++i) {
+    const int64_t rank = distribution(bitgen);
+    ASSERT_GE(rank, 0);
+    ASSERT_LT(rank, 100);
+    ++counts[rank];
+  }
+  // Rank 0 is picked about twice as often as rank 1, and 100 times as often as
+  // rank 99.
+  EXPECT_GT(counts[0], counts[1]);
+  EXPECT_GT(counts[1], counts[99]);
+  EXPECT_GT(counts[0], 10 * counts[99]);
+}
+
+TEST(BenchmarkUtilTest, VerifyZipfianDistributionIsUniformWithoutExponent) {
+  const ZipfianDistribution distribution(/*num_ranks=*/4, /*exponent=*/0);
+  absl::BitGen bitgen;
+  std::vector<int64_t> counts(4);
+  for (int i = 0; i < 40000; ++i) {
+    ++counts[distribution(bitgen)];
+  }
+  for (const int64_t count : counts) {
+    EXPECT_NEAR(count, 10000, 1000);
+  }
+}
+
 TEST(BenchmarkUtilTest, VerifyWriteRecords) {
   std::stringstream data_stream;
   int64_t num_records = 1000;
@@ -13,28 +13,41 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <chrono>
+#include <functional>
 #include <future>
 #include <memory>
 #include <sstream>
 #include <thread>
 
+#include "absl/base/call_once.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/flags/flag.h"
 #include "absl/flags/parse.h"
 #include "absl/log/flags.h"
 #include "absl/log/initialize.h"
 #include "absl/log/log.h"
+#include "absl/random/random.h"
 #include "absl/status/status.h"
+#include "absl/status/statusor.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
 #include "absl/time/time.h"
 #include "benchmark/benchmark.h"
 #include "components/data_server/cache/cache.h"
 #include "components/data_server/cache/key_value_cache.h"
 #include "components/data_server/cache/noop_key_value_cache.h"
+#include "components/data_server/cache/arena_key_value_cache.h"
+#include "components/data_server/cache/interned_key_value_set_cache.h"
+#include "components/data_server/cache/rcu_key_value_cache.h"
+#include "components/data_server/cache/sharded_key_value_cache.h"
 #include "components/tools/benchmarks/benchmark_util.h"
+#include "tcmalloc/malloc_extension.h"
 
 ABSL_FLAG(std::vector<std::string>, record_size,
           std::vector<std::string>({"1"}),
@@ -56,12 +69,43 @@ ABSL_FLAG(std::vector<std::string>, concurrent_readers,
           std::vector<std::string>({"1"}),
           "Number of threads concurrently reading keys from the cache when "
           "benchmarking writes.");
+ABSL_FLAG(std::vector<std::string>, lookup_keyspace_size,
+          std::vector<std::string>(),
+          "Numbers of keys written before benchmarking lookups of random "
+          "keys among them. Large keyspaces, whose tables don't fit in the "
+          "last level cache, show the cost of the cache misses of the "
+          "lookups. Empty skips these benchmarks.");
 ABSL_FLAG(int64_t, iterations, -1,
           "Number of iterations to run each benchmark.");
 ABSL_FLAG(int64_t, min_threads, 1,
           "Minimum number of threads for benchmarking reading keys.");
 ABSL_FLAG(int64_t, max_threads, 1,
           "Maximum number of threads for benchmarking reading keys.");
+ABSL_FLAG(int32_t, cache_num_shards, 0,
+          "Number of partitions of the sharded cache. 0 uses one partition "
+          "per hardware thread.");
+ABSL_FLAG(std::vector<std::string>, operation_mix,
+          std::vector<std::string>({"get:80", "get_set:10", "update:5",
+                                    "update_set:3", "delete:1",
+                                    "delete_set_values:1"}),
+          "Weights of the operations of the mixed workload benchmarks, as "
+          "operation:weight. The operations are get, get_set, update, "
+          "update_set, delete and delete_set_values.");
+ABSL_FLAG(double, zipfian_exponent, 0.99,
+          "Exponent of the Zipfian popularity of the keys of the mixed "
+          "workload benchmarks. 0 picks keys uniformly.");
+ABSL_FLAG(int64_t, mixed_query_size, 10,
+          "Number of keys read by each read of the mixed workload benchmarks.");
+ABSL_FLAG(int64_t, min_set_size, 1,
+          "Minimum number of values written to or deleted from a set by the "
+          "mixed workload benchmarks.");
+ABSL_FLAG(int64_t, max_set_size, 1000,
+          "Maximum number of values written to or deleted from a set by the "
+          "mixed workload benchmarks. Sizes are log-uniform in between, so "
+          "that most sets are small and a few are large.");
+ABSL_FLAG(absl::Duration, cleanup_interval, absl::Milliseconds(100),
+          "How often the mixed workload benchmarks remove deleted keys while "
+          "they run. 0 disables the cleanup.");
 
 namespace kv_server {
 namespace {
@@ -69,6 +113,8 @@ namespace {
 using kv_server::benchmark::AsyncTask;
 using kv_server::benchmark::GenerateRandomString;
 using kv_server::benchmark::ParseInt64List;
+using kv_server::benchmark::ParseWeightList;
+using kv_server::benchmark::ZipfianDistribution;
 
 // Format variables used to generate benchmark names.
 //
@@ -76,23 +122,21 @@ using kv_server::benchmark::ParseInt64List;
 // GetKeyValuePairs call.
 // => rz - record size, i.e., approximate byte size of each key/value pair
 // written into the cache. Actual record size is greater than this number.
-constexpr std::string_view kNoOpCacheGetKeyValuePairsFmt =
-    "BM_NoOpCache_GetKeyValuePairs/qz:%d/rz:%d/cw:%d";
-constexpr std::string_view kLockBasedCacheGetKeyValuePairsFmt =
-    "BM_LockBasedCache_GetKeyValuePairs/qz:%d/rz:%d/cw:%d";
-constexpr std::string_view kNoOpCacheGetKeyValueSetFmt =
-    "BM_NoOpCache_GetKeyValueSet/qz:%d/sqz:%d/rz:%d/cw:%d";
-constexpr std::string_view kLockBasedCacheGetKeyValueSetFmt =
-    "BM_LockBasedCache_GetKeyValueSet/qz:%d/sqz:%d/rz:%d/cw:%d";
-
-constexpr std::string_view kNoOpCacheUpdateKeyValueFmt =
-    "BM_NoOpCache_UpdateKeyValue/ksz:%d/rz:%d/cr:%d";
-constexpr std::string_view kLockBasedCacheUpdateKeyValueFmt =
-    "BM_LockBasedCache_UpdateKeyValue/ksz:%d/rz:%d/cr:%d";
-constexpr std::string_view kNoOpCacheUpdateKeyValueSetFmt =
-    "BM_NoOpCache_UpdateKeyValueSet/ksz:%d/sqz:%d/rz:%d/cr:%d";
-constexpr std::string_view kLockBasedCacheUpdateKeyValueSetFmt =
-    "BM_LockBasedCache_UpdateKeyValueSet/ksz:%d/sqz:%d/rz:%d/cr:%d";
+//
+// Each format takes the name of the benchmarked cache implementation first.
+constexpr std::string_view kGetKeyValuePairsFmt =
+    "BM_%s_GetKeyValuePairs/qz:%d/rz:%d/cw:%d";
+constexpr std::string_view kGetKeyValueSetFmt =
+    "BM_%s_GetKeyValueSet/qz:%d/sqz:%d/rz:%d/cw:%d";
+
+constexpr std::string_view kUpdateKeyValueFmt =
+    "BM_%s_UpdateKeyValue/ksz:%d/rz:%d/cr:%d";
+constexpr std::string_view kUpdateKeyValueSetFmt =
+    "BM_%s_UpdateKeyValueSet/ksz:%d/sqz:%d/rz:%d/cr:%d";
+constexpr std::string_view kMixedWorkloadFmt =
+    "BM_%s_MixedWorkload/ksz:%d/rz:%d";
+constexpr std::string_view kGetKeyValuePairsFromKeyspaceFmt =
+    "BM_%s_GetKeyValuePairsFromKeyspace/ksz:%d/qz:%d/rz:%d";
 
 constexpr std::string_view kReadsPerSec = "Reads/s";
 constexpr std::string_view kWritesPerSec = "Writes/s";
@@ -107,6 +151,68 @@ Cache* GetLockBasedCache() {
   return cache;
 }
 
+Cache* GetShardedCache() {
+  static auto* const cache =
+      ShardedKeyValueCache::Create(absl::GetFlag(FLAGS_cache_num_shards))
+          .release();
+  return cache;
+}
+
+Cache* GetArenaCache() {
+  static auto* const cache = ArenaKeyValueCache::Create().release();
+  return cache;
+}
+
+Cache* GetInternedSetCache() {
+  static auto* const cache =
+      InternedKeyValueSetCache::Create(KeyValueCache::Create()).release();
+  return cache;
+}
+
+Cache* GetRcuCache() {
+  static auto* const cache = RcuKeyValueCache::Create().release();
+  return cache;
+}
+
+struct NamedCache {
+  std::string_view name;
+  Cache* cache;
+  // Creates an empty cache of the same implementation, for the benchmarks
+  // that measure the memory of what they write.
+  std::function<std::unique_ptr<Cache>()> create;
+};
+
+// Cache implementations that are benchmarked against each other.
+std::vector<NamedCache> GetCaches() {
+  return {
+      {.name = "NoOpCache",
+       .cache = GetNoOpCache(),
+       .create = [] { return NoOpKeyValueCache::Create(); }},
+      {.name = "LockBasedCache",
+       .cache = GetLockBasedCache(),
+       .create = [] { return KeyValueCache::Create(); }},
+      {.name = "ShardedCache",
+       .cache = GetShardedCache(),
+       .create =
+           [] {
+             return ShardedKeyValueCache::Create(
+                 absl::GetFlag(FLAGS_cache_num_shards));
+           }},
+      {.name = "RcuCache",
+       .cache = GetRcuCache(),
+       .create = [] { return RcuKeyValueCache::Create(); }},
+      {.name = "ArenaCache",
+       .cache = GetArenaCache(),
+       .create = [] { return ArenaKeyValueCache::Create(); }},
+      {.name = "InternedSetCache",
+       .cache = GetInternedSetCache(),
+       .create =
+           [] {
+             return InternedKeyValueSetCache::Create(KeyValueCache::Create());
+           }},
+  };
+}
+
 std::atomic<int64_t>& GetLogicalTimestamp() {
   static auto* const timestamp = new std::atomic<int64_t>(0);
   return *timestamp;
@@ -261,12 +367,342 @@ void BM_UpdateKeyValueSet(::benchmark::State& state, BenchmarkArgs args) {
       ::benchmark::Counter(state.iterations(), ::benchmark::Counter::kIsRate);
 }
 
-// Registers a function to benchmark.
-void RegisterBenchmark(
-    std::string name, BenchmarkArgs args,
-    std::function<void(::benchmark::State&, BenchmarkArgs)> benchmark) {
-  auto b =
-      ::benchmark::RegisterBenchmark(name.c_str(), benchmark, std::move(args));
+enum class Operation {
+  kGet,
+  kGetSet,
+  kUpdate,
+  kUpdateSet,
+  kDelete,
+  kDeleteSetValues,
+  kNumOperations,
+};
+
+constexpr std::string_view kOperationNames[] = {
+    "get", "get_set", "update", "update_set", "delete", "delete_set_values",
+};
+
+absl::StatusOr<std::vector<int64_t>> ParseOperationMix(
+    const std::vector<std::string>& operation_mix) {
+  auto weights = ParseWeightList(operation_mix);
+  if (!weights.ok()) {
+    return weights.status();
+  }
+  std::vector<int64_t> result(static_cast<int>(Operation::kNumOperations));
+  for (const auto& [name, weight] : *weights) {
+    const auto it = std::find(std::begin(kOperationNames),
+                              std::end(kOperationNames), name);
+    if (it == std::end(kOperationNames)) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Unknown operation: ", name));
+    }
+    result[it - std::begin(kOperationNames)] = weight;
+  }
+  if (std::all_of(result.begin(), result.end(),
+                  [](int64_t weight) { return weight == 0; })) {
+    return absl::InvalidArgumentError("No operation has a weight.");
+  }
+  return result;
+}
+
+// Memory allocated by the process, as tracked by tcmalloc.
+int64_t GetAllocatedBytes() {
+  return tcmalloc::MallocExtension::GetNumericProperty(
+             "generic.current_allocated_bytes")
+      .value_or(0);
+}
+
+// A fresh cache of `keyspace_size` key-value pairs and as many key-value sets,
+// and the operations of the mixed workload over them, shared by the threads of
+// a benchmark. Keys are picked with a Zipfian popularity, and the number of
+// values of the sets that are written or deleted is log-uniform between
+// `--min_set_size` and `--max_set_size`.
+class MixedWorkload {
+ public:
+  MixedWorkload(std::unique_ptr<Cache> cache, int64_t keyspace_size,
+                int64_t record_size, const std::vector<int64_t>& weights)
+      : cache_(std::move(cache)),
+        value_(GenerateRandomString(record_size)),
+        keys_(keyspace_size),
+        min_set_size_(std::max<int64_t>(absl::GetFlag(FLAGS_min_set_size), 1)),
+        max_set_size_(std::max(absl::GetFlag(FLAGS_max_set_size),
+                               min_set_size_)) {
+    int64_t total_weight = 0;
+    for (const int64_t weight : weights) {
+      total_weight += weight;
+      cumulative_weights_.push_back(total_weight);
+    }
+    for (int64_t i = 0; i < keyspace_size; ++i) {
+      value_keys_.push_back(absl::StrCat("value", i));
+      set_keys_.push_back(absl::StrCat("set", i));
+    }
+    // Sets draw their values from a few times as many values as the largest
+    // set, so that sets overlap as sets of real data do.
+    for (int64_t i = 0; i < 4 * max_set_size_; ++i) {
+      set_values_.push_back(absl::StrCat("element", i));
+    }
+  }
+
+  // Writes every key once, and returns the bytes allocated meanwhile.
+  int64_t Populate() {
+    const int64_t allocated_bytes = GetAllocatedBytes();
+    absl::BitGen bitgen;
+    for (int64_t i = 0; i < static_cast<int64_t>(value_keys_.size()); ++i) {
+      cache_->UpdateKeyValue(value_keys_[i], value_, ++GetLogicalTimestamp());
+      auto set_values = PickSetValues(bitgen);
+      cache_->UpdateKeyValueSet(set_keys_[i], absl::MakeSpan(set_values),
+                                ++GetLogicalTimestamp());
+    }
+    return GetAllocatedBytes() - allocated_bytes;
+  }
+
+  // Memory of the cache by its own accounting, 0 if it doesn't keep track.
+  int64_t TrackedBytes() const {
+    int64_t bytes = 0;
+    for (const auto& [prefix, memory_usage] : cache_->GetMemoryUsage()) {
+      bytes += memory_usage.total_bytes();
+    }
+    return bytes;
+  }
+
+  int64_t num_entries() const { return 2 * value_keys_.size(); }
+
+  // Runs an operation picked by the weights of the mix, and returns it.
+  Operation RunOperation(absl::BitGen& bitgen,
+                         const RequestContext& request_context) {
+    const int64_t draw =
+        absl::Uniform<int64_t>(bitgen, 0, cumulative_weights_.back());
+    const auto operation = static_cast<Operation>(
+        std::upper_bound(cumulative_weights_.begin(),
+                         cumulative_weights_.end(), draw) -
+        cumulative_weights_.begin());
+    switch (operation) {
+      case Operation::kGet:
+        ::benchmark::DoNotOptimize(
+            cache_->GetKeyValuePairs(request_context, PickKeys(bitgen, false)));
+        break;
+      case Operation::kGetSet:
+        ::benchmark::DoNotOptimize(
+            cache_->GetKeyValueSet(request_context, PickKeys(bitgen, true)));
+        break;
+      case Operation::kUpdate:
+        cache_->UpdateKeyValue(value_keys_[keys_(bitgen)], value_,
+                               ++GetLogicalTimestamp());
+        break;
+      case Operation::kUpdateSet: {
+        auto set_values = PickSetValues(bitgen);
+        cache_->UpdateKeyValueSet(set_keys_[keys_(bitgen)],
+                                  absl::MakeSpan(set_values),
+                                  ++GetLogicalTimestamp());
+        break;
+      }
+      case Operation::kDelete:
+        cache_->DeleteKey(value_keys_[keys_(bitgen)], ++GetLogicalTimestamp());
+        break;
+      case Operation::kDeleteSetValues: {
+        auto set_values = PickSetValues(bitgen);
+        cache_->DeleteValuesInSet(set_keys_[keys_(bitgen)],
+                                  absl::MakeSpan(set_values),
+                                  ++GetLogicalTimestamp());
+        break;
+      }
+      case Operation::kNumOperations:
+        break;
+    }
+    return operation;
+  }
+
+  // Removes the keys deleted so far, as the server does periodically, and
+  // returns how long it took.
+  absl::Duration RemoveDeletedKeys() {
+    const absl::Time start = absl::Now();
+    cache_->RemoveDeletedKeys(GetLogicalTimestamp());
+    return absl::Now() - start;
+  }
+
+ private:
+  absl::flat_hash_set<std::string_view> PickKeys(absl::BitGen& bitgen,
+                                                 bool sets) const {
+    const auto& keys = sets ? set_keys_ : value_keys_;
+    absl::flat_hash_set<std::string_view> result;
+    for (int64_t i = 0; i < absl::GetFlag(FLAGS_mixed_query_size); ++i) {
+      result.insert(keys[keys_(bitgen)]);
+    }
+    return result;
+  }
+
+  std::vector<std::string_view> PickSetValues(absl::BitGen& bitgen) const {
+    const int64_t size =
+        absl::LogUniform<int64_t>(bitgen, min_set_size_, max_set_size_);
+    std::vector<std::string_view> result;
+    result.reserve(size);
+    for (int64_t i = 0; i < size; ++i) {
+      result.push_back(set_values_[absl::Uniform<size_t>(
+          bitgen, 0, set_values_.size())]);
+    }
+    return result;
+  }
+
+  std::unique_ptr<Cache> cache_;
+  const std::string value_;
+  const ZipfianDistribution keys_;
+  // Sum of the weights of the operations up to the index.
+  std::vector<int64_t> cumulative_weights_;
+  const int64_t min_set_size_;
+  const int64_t max_set_size_;
+  std::vector<std::string> value_keys_;
+  std::vector<std::string> set_keys_;
+  std::vector<std::string> set_values_;
+};
+
+// Removes deleted keys every `--cleanup_interval` on a thread of its own while
+// it lives, and keeps how long each cleanup paused the writers for.
+class Cleaner {
+ public:
+  explicit Cleaner(MixedWorkload& workload) {
+    const absl::Duration interval = absl::GetFlag(FLAGS_cleanup_interval);
+    if (interval <= absl::ZeroDuration()) {
+      return;
+    }
+    thread_ = std::thread([this, &workload, interval] {
+      while (!stop_.WaitForNotificationWithTimeout(interval)) {
+        pauses_.push_back(workload.RemoveDeletedKeys());
+      }
+    });
+  }
+
+  // Stops the cleanups, and returns the pauses of those that ran.
+  std::vector<absl::Duration> Stop() {
+    stop_.Notify();
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+    return std::move(pauses_);
+  }
+
+ private:
+  absl::Notification stop_;
+  std::vector<absl::Duration> pauses_;
+  std::thread thread_;
+};
+
+// Shared by the threads of the running mixed workload benchmark. Set by its
+// first thread before the threads start their loops.
+std::atomic<MixedWorkload*> running_workload = nullptr;
+
+// A cache written once with `keyspace_size` keys, the first time one of the
+// benchmarks that share it runs.
+struct KeyspaceCache {
+  absl::once_flag once;
+  std::unique_ptr<Cache> cache;
+};
+
+struct KeyspaceLookupArgs {
+  int64_t keyspace_size = 1;
+  int64_t query_size = 1;
+  int64_t record_size = 1;
+  std::function<std::unique_ptr<Cache>()> create_cache;
+  std::shared_ptr<KeyspaceCache> keyspace_cache;
+};
+
+// Looks up `query_size` random keys of a cache of `keyspace_size` keys at a
+// time. The key sets are drawn before the timing, so that the iterations
+// only time the lookups.
+void BM_GetKeyValuePairsFromKeyspace(::benchmark::State& state,
+                                     KeyspaceLookupArgs args) {
+  KeyspaceCache& keyspace_cache = *args.keyspace_cache;
+  absl::call_once(keyspace_cache.once, [&args, &keyspace_cache] {
+    keyspace_cache.cache = args.create_cache();
+    const std::string value = GenerateRandomString(args.record_size);
+    for (int64_t i = 0; i < args.keyspace_size; i++) {
+      keyspace_cache.cache->UpdateKeyValue(std::to_string(i), value, 1);
+    }
+  });
+  constexpr int kNumQueries = 64;
+  absl::BitGen bitgen;
+  std::vector<std::vector<std::string>> queries(kNumQueries);
+  std::vector<absl::flat_hash_set<std::string_view>> key_sets;
+  key_sets.reserve(kNumQueries);
+  for (auto& query : queries) {
+    for (int64_t i = 0; i < args.query_size; i++) {
+      query.push_back(std::to_string(
+          absl::Uniform<int64_t>(bitgen, 0, args.keyspace_size)));
+    }
+    key_sets.push_back(
+        ToContainerView<absl::flat_hash_set<std::string_view>>(query));
+  }
+  auto scope_metrics_context = std::make_unique<ScopeMetricsContext>();
+  RequestContext request_context(*scope_metrics_context);
+  size_t next_query = 0;
+  for (auto _ : state) {
+    ::benchmark::DoNotOptimize(keyspace_cache.cache->GetKeyValuePairs(
+        request_context, key_sets[next_query++ % kNumQueries]));
+  }
+  state.counters[std::string(kReadsPerSec)] =
+      ::benchmark::Counter(state.iterations(), ::benchmark::Counter::kIsRate);
+  state.counters["Keys/s"] = ::benchmark::Counter(
+      state.iterations() * args.query_size, ::benchmark::Counter::kIsRate);
+}
+
+struct MixedWorkloadArgs {
+  int64_t keyspace_size = 1;
+  int64_t record_size = 1;
+  std::vector<int64_t> weights;
+  std::function<std::unique_ptr<Cache>()> create_cache;
+};
+
+// Runs the operations of `--operation_mix` over a fresh cache, while the
+// deleted keys are removed every `--cleanup_interval`. Reports the rate of
+// each operation, the pauses of the cleanups and the memory per entry, both
+// allocated and by the cache's own accounting.
+void BM_MixedWorkload(::benchmark::State& state, MixedWorkloadArgs args) {
+  std::unique_ptr<MixedWorkload> workload;
+  std::unique_ptr<Cleaner> cleaner;
+  if (state.thread_index() == 0) {
+    workload = std::make_unique<MixedWorkload>(
+        args.create_cache(), args.keyspace_size, args.record_size,
+        args.weights);
+    const int64_t allocated_bytes = workload->Populate();
+    state.counters["AllocatedBytes/entry"] =
+        static_cast<double>(allocated_bytes) / workload->num_entries();
+    state.counters["TrackedBytes/entry"] =
+        static_cast<double>(workload->TrackedBytes()) /
+        workload->num_entries();
+    cleaner = std::make_unique<Cleaner>(*workload);
+    running_workload = workload.get();
+  }
+  absl::BitGen bitgen;
+  auto scope_metrics_context = std::make_unique<ScopeMetricsContext>();
+  RequestContext request_context(*scope_metrics_context);
+  std::array<int64_t, static_cast<int>(Operation::kNumOperations)> counts = {};
+  for (auto _ : state) {
+    ++counts[static_cast<int>(
+        running_workload.load()->RunOperation(bitgen, request_context))];
+  }
+  for (int i = 0; i < static_cast<int>(Operation::kNumOperations); ++i) {
+    state.counters[absl::StrCat(kOperationNames[i], "/s")] =
+        ::benchmark::Counter(counts[i], ::benchmark::Counter::kIsRate);
+  }
+  if (state.thread_index() == 0) {
+    const std::vector<absl::Duration> pauses = cleaner->Stop();
+    absl::Duration total_pause;
+    absl::Duration max_pause;
+    for (const absl::Duration pause : pauses) {
+      total_pause += pause;
+      max_pause = std::max(max_pause, pause);
+    }
+    state.counters["Cleanups"] = pauses.size();
+    state.counters["CleanupMaxPause_us"] =
+        absl::ToDoubleMicroseconds(max_pause);
+    state.counters["CleanupMeanPause_us"] =
+        pauses.empty() ? 0
+                       : absl::ToDoubleMicroseconds(total_pause) /
+                             pauses.size();
+    running_workload = nullptr;
+  }
+}
+
+// Sets the threads and iterations of a benchmark from the flags.
+void ConfigureBenchmark(::benchmark::internal::Benchmark* b) {
   auto min = std::max(absl::GetFlag(FLAGS_min_threads), 1L);
   auto max = absl::GetFlag(FLAGS_max_threads);
   b->ThreadRange(min, max < min ? min : max);
@@ -275,6 +711,14 @@ void RegisterBenchmark(
   }
 }
 
+// Registers a function to benchmark.
+void RegisterBenchmark(
+    std::string name, BenchmarkArgs args,
+    std::function<void(::benchmark::State&, BenchmarkArgs)> benchmark) {
+  ConfigureBenchmark(
+      ::benchmark::RegisterBenchmark(name.c_str(), benchmark, std::move(args)));
+}
+
 void RegisterReadBenchmarks() {
   auto query_sizes = ParseInt64List(absl::GetFlag(FLAGS_query_size));
   auto set_query_sizes = ParseInt64List(absl::GetFlag(FLAGS_set_query_size));
@@ -284,33 +728,25 @@ void RegisterReadBenchmarks() {
   for (auto query_size : query_sizes.value()) {
     for (auto record_size : record_sizes.value()) {
       for (auto num_writers : concurrent_writers.value()) {
-        auto args = BenchmarkArgs{
-            .record_size = record_size,
-            .query_size = query_size,
-            .concurrent_tasks = num_writers,
-            .cache = GetNoOpCache(),
-        };
-        ::kv_server::RegisterBenchmark(
-            absl::StrFormat(kNoOpCacheGetKeyValuePairsFmt, query_size,
-                            record_size, num_writers),
-            args, BM_GetKeyValuePairs);
-        args.cache = GetLockBasedCache();
-        ::kv_server::RegisterBenchmark(
-            absl::StrFormat(kLockBasedCacheGetKeyValuePairsFmt, query_size,
-                            record_size, num_writers),
-            args, BM_GetKeyValuePairs);
-        for (auto set_query_size : set_query_sizes.value()) {
-          args.set_query_size = set_query_size;
-          args.cache = GetNoOpCache();
-          ::kv_server::RegisterBenchmark(
-              absl::StrFormat(kNoOpCacheGetKeyValueSetFmt, query_size,
-                              set_query_size, record_size, num_writers),
-              args, BM_GetKeyValueSet);
-          args.cache = GetLockBasedCache();
+        for (const auto& named_cache : GetCaches()) {
+          auto args = BenchmarkArgs{
+              .record_size = record_size,
+              .query_size = query_size,
+              .concurrent_tasks = num_writers,
+              .cache = named_cache.cache,
+          };
           ::kv_server::RegisterBenchmark(
-              absl::StrFormat(kLockBasedCacheGetKeyValueSetFmt, query_size,
-                              set_query_size, record_size, num_writers),
-              args, BM_GetKeyValueSet);
+              absl::StrFormat(kGetKeyValuePairsFmt, named_cache.name,
+                              query_size, record_size, num_writers),
+              args, BM_GetKeyValuePairs);
+          for (auto set_query_size : set_query_sizes.value()) {
+            args.set_query_size = set_query_size;
+            ::kv_server::RegisterBenchmark(
+                absl::StrFormat(kGetKeyValueSetFmt, named_cache.name,
+                                query_size, set_query_size, record_size,
+                                num_writers),
+                args, BM_GetKeyValueSet);
+          }
         }
       }
     }
@@ -326,40 +762,102 @@ void RegisterWriteBenchmarks() {
   for (auto keyspace_size : keyspace_sizes.value()) {
     for (auto record_size : record_sizes.value()) {
       for (auto num_readers : concurrent_readers.value()) {
-        auto args = BenchmarkArgs{
-            .record_size = record_size,
-            .keyspace_size = keyspace_size,
-            .concurrent_tasks = num_readers,
-            .cache = GetNoOpCache(),
-        };
-        ::kv_server::RegisterBenchmark(
-            absl::StrFormat(kNoOpCacheUpdateKeyValueFmt, keyspace_size,
-                            record_size, num_readers),
-            args, BM_UpdateKeyValue);
-        args.cache = GetLockBasedCache();
-        ::kv_server::RegisterBenchmark(
-            absl::StrFormat(kLockBasedCacheUpdateKeyValueFmt, keyspace_size,
-                            record_size, num_readers),
-            args, BM_UpdateKeyValue);
-        for (auto set_query_size : set_query_sizes.value()) {
-          args.set_query_size = set_query_size;
-          args.cache = GetNoOpCache();
+        for (const auto& named_cache : GetCaches()) {
+          auto args = BenchmarkArgs{
+              .record_size = record_size,
+              .keyspace_size = keyspace_size,
+              .concurrent_tasks = num_readers,
+              .cache = named_cache.cache,
+          };
           ::kv_server::RegisterBenchmark(
-              absl::StrFormat(kNoOpCacheUpdateKeyValueSetFmt, keyspace_size,
-                              set_query_size, record_size, num_readers),
-              args, BM_UpdateKeyValueSet);
-          args.cache = GetLockBasedCache();
-          ::kv_server::RegisterBenchmark(
-              absl::StrFormat(kLockBasedCacheUpdateKeyValueSetFmt,
-                              keyspace_size, set_query_size, record_size,
-                              num_readers),
-              args, BM_UpdateKeyValueSet);
+              absl::StrFormat(kUpdateKeyValueFmt, named_cache.name,
+                              keyspace_size, record_size, num_readers),
+              args, BM_UpdateKeyValue);
+          for (auto set_query_size : set_query_sizes.value()) {
+            args.set_query_size = set_query_size;
+            ::kv_server::RegisterBenchmark(
+                absl::StrFormat(kUpdateKeyValueSetFmt, named_cache.name,
+                                keyspace_size, set_query_size, record_size,
+                                num_readers),
+                args, BM_UpdateKeyValueSet);
+          }
+        }
+      }
+    }
+  }
+}
+
+// Benchmarks the lookups of the lock-based cache with and without probing
+// the keys in prefetched batches.
+void RegisterKeyspaceLookupBenchmarks() {
+  auto keyspace_sizes =
+      ParseInt64List(absl::GetFlag(FLAGS_lookup_keyspace_size));
+  auto query_sizes = ParseInt64List(absl::GetFlag(FLAGS_query_size));
+  auto record_sizes = ParseInt64List(absl::GetFlag(FLAGS_record_size));
+  const std::vector<std::pair<std::string_view, int>> variants = {
+      {"LockBasedCache", KeyValueCache::LookupOptions().probe_batch_size},
+      {"LockBasedCacheUnbatched", 1},
+  };
+  for (auto keyspace_size : keyspace_sizes.value()) {
+    for (auto record_size : record_sizes.value()) {
+      for (const auto& [name, probe_batch_size] : variants) {
+        // The query sizes share the cache of the keyspace.
+        auto keyspace_cache = std::make_shared<KeyspaceCache>();
+        for (auto query_size : query_sizes.value()) {
+          ::benchmark::internal::Benchmark* b =
+              ::benchmark::RegisterBenchmark(
+                  absl::StrFormat(kGetKeyValuePairsFromKeyspaceFmt, name,
+                                  keyspace_size, query_size, record_size)
+                      .c_str(),
+                  BM_GetKeyValuePairsFromKeyspace,
+                  KeyspaceLookupArgs{
+                      .keyspace_size = keyspace_size,
+                      .query_size = query_size,
+                      .record_size = record_size,
+                      .create_cache =
+                          [probe_batch_size = probe_batch_size] {
+                            return KeyValueCache::Create(
+                                KeyValueCache::CompressionOptions(), {},
+                                {.probe_batch_size = probe_batch_size});
+                          },
+                      .keyspace_cache = keyspace_cache,
+                  });
+          ConfigureBenchmark(b);
         }
       }
     }
   }
 }
 
+void RegisterMixedWorkloadBenchmarks() {
+  auto weights = ParseOperationMix(absl::GetFlag(FLAGS_operation_mix));
+  if (!weights.ok()) {
+    LOG(ERROR) << "Invalid --operation_mix: " << weights.status();
+    return;
+  }
+  auto keyspace_sizes = ParseInt64List(absl::GetFlag(FLAGS_keyspace_size));
+  auto record_sizes = ParseInt64List(absl::GetFlag(FLAGS_record_size));
+  for (auto keyspace_size : keyspace_sizes.value()) {
+    for (auto record_size : record_sizes.value()) {
+      for (const auto& named_cache : GetCaches()) {
+        auto* b = ::benchmark::RegisterBenchmark(
+            absl::StrFormat(kMixedWorkloadFmt, named_cache.name, keyspace_size,
+                            record_size)
+                .c_str(),
+            BM_MixedWorkload,
+            MixedWorkloadArgs{
+                .keyspace_size = keyspace_size,
+                .record_size = record_size,
+                .weights = *weights,
+                .create_cache = named_cache.create,
+            });
+        ConfigureBenchmark(b);
+        b->UseRealTime();
+      }
+    }
+  }
+}
+
 }  // namespace
 }  // namespace kv_server
 
@@ -370,6 +868,29 @@ void RegisterWriteBenchmarks() {
 //    --//:instance=local \
 //    --//:platform=local -- \
 //    --benchmark_counters_tabular=true --stderrthreshold=0
+//
+// Mixed workloads of reads, writes and deletes over skewed keys, with the
+// cleanup of deleted keys running alongside:
+//
+//  bazel run -c opt \
+//    //components/tools/benchmarks:cache_benchmark \
+//    --//:instance=local \
+//    --//:platform=local -- \
+//    --benchmark_counters_tabular=true \
+//    --benchmark_filter=MixedWorkload \
+//    --keyspace_size=100000 --record_size=100 --max_threads=8 \
+//    --operation_mix=get:90,update:5,delete:5 --zipfian_exponent=1.1
+//
+// Lookups of random keys of a keyspace much larger than the last level
+// cache, with the keys probed in prefetched batches or one at a time:
+//
+//  bazel run -c opt \
+//    //components/tools/benchmarks:cache_benchmark \
+//    --//:instance=local \
+//    --//:platform=local -- \
+//    --benchmark_counters_tabular=true \
+//    --benchmark_filter=FromKeyspace \
+//    --lookup_keyspace_size=10000000 --query_size=50,500 --record_size=100
 int main(int argc, char** argv) {
   absl::InitializeLog();
   ::benchmark::Initialize(&argc, argv);
@@ -377,6 +898,8 @@ int main(int argc, char** argv) {
   kv_server::InitMetricsContextMap();
   ::kv_server::RegisterReadBenchmarks();
   ::kv_server::RegisterWriteBenchmarks();
+  ::kv_server::RegisterMixedWorkloadBenchmarks();
+  ::kv_server::RegisterKeyspaceLookupBenchmarks();
   ::benchmark::RunSpecifiedBenchmarks();
   ::benchmark::Shutdown();
   return 0;
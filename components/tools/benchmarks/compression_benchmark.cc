@@ -0,0 +1,115 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/log/initialize.h"
+#include "absl/strings/str_cat.h"
+#include "benchmark/benchmark.h"
+#include "components/data_server/request_handler/compression.h"
+#include "components/telemetry/server_definition.h"
+
+namespace kv_server {
+namespace {
+
+using CompressionType = CompressionGroupConcatenator::CompressionType;
+
+// Returns a JSON array of partition outputs of roughly `size` bytes, with
+// the repeated structure and varying values of real compression groups.
+std::string MakeCompressionGroup(int64_t size) {
+  std::string group = "[";
+  for (int64_t i = 0; static_cast<int64_t>(group.size()) < size; ++i) {
+    absl::StrAppend(&group, i == 0 ? "" : ",", R"({"id":)", i,
+                    R"(,"stringOutput":"{\"keyGroupOutputs\":[{\"tags\":)",
+                    R"([\"custom\",\"keys\"],\"keyValues\":{\"key)", i,
+                    R"(\":{\"value\":\"value)", i * 7919, R"(\"}}}]}"})");
+  }
+  absl::StrAppend(&group, "]");
+  return group;
+}
+
+// Args: number of compression groups, size of each group in bytes and the
+// number of groups compressed at once.
+void BM_CompressGroups(::benchmark::State& state, CompressionType type) {
+  const int64_t num_groups = state.range(0);
+  const std::vector<std::string> groups(num_groups,
+                                        MakeCompressionGroup(state.range(1)));
+  const int max_concurrency = state.range(2);
+  int64_t compressed_bytes = 0;
+  for (auto _ : state) {
+    auto blobs = CompressGroups(
+        groups, type, &CompressionGroupConcatenator::Create, max_concurrency);
+    if (!blobs.ok()) {
+      state.SkipWithError(blobs.status().ToString());
+      return;
+    }
+    for (const std::string& blob : *blobs) {
+      compressed_bytes += blob.size();
+    }
+    ::benchmark::DoNotOptimize(blobs);
+  }
+  state.SetBytesProcessed(state.iterations() * num_groups * groups[0].size());
+  state.counters["CompressionPercent"] =
+      100.0 * compressed_bytes /
+      (state.iterations() * num_groups * groups[0].size());
+}
+
+void RegisterBenchmarks() {
+  for (const auto& [name, type] :
+       std::vector<std::pair<std::string, CompressionType>>{
+           {"BM_CompressGroupsUncompressed", CompressionType::kUncompressed},
+           {"BM_CompressGroupsBrotli", CompressionType::kBrotli},
+           {"BM_CompressGroupsGzip", CompressionType::kGzip},
+           {"BM_CompressGroupsZstd", CompressionType::kZstd},
+       }) {
+    auto* benchmark =
+        ::benchmark::RegisterBenchmark(name.c_str(), BM_CompressGroups, type);
+    for (const int64_t num_groups : {1, 4, 16}) {
+      for (const int64_t group_size : {1 << 10, 64 << 10}) {
+        for (const int64_t max_concurrency : {1, 8}) {
+          benchmark->Args({num_groups, group_size, max_concurrency});
+        }
+      }
+    }
+    benchmark->UseRealTime();
+  }
+}
+
+}  // namespace
+}  // namespace kv_server
+
+// Microbenchmarks of compressing the compression groups of v2 responses, with
+// each algorithm, sequentially and concurrently on the shared thread pool.
+// Sample run:
+//
+//  bazel run -c opt \
+//    //components/tools/benchmarks:compression_benchmark \
+//    --//:instance=local \
+//    --//:platform=local -- \
+//    --benchmark_counters_tabular=true
+int main(int argc, char** argv) {
+  absl::InitializeLog();
+  ::benchmark::Initialize(&argc, argv);
+  kv_server::InitMetricsContextMap();
+  ::kv_server::RegisterBenchmarks();
+  ::benchmark::RunSpecifiedBenchmarks();
+  ::benchmark::Shutdown();
+  return 0;
+}
@@ -15,10 +15,14 @@
  */
 
 #include <array>
+#include <atomic>
 #include <chrono>
 #include <memory>
+#include <optional>
 #include <sstream>
+#include <string>
 #include <thread>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/flags/flag.h"
@@ -27,8 +31,12 @@
 #include "absl/log/initialize.h"
 #include "absl/log/log.h"
 #include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/numbers.h"
 #include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
 #include "absl/time/time.h"
+#include "absl/types/span.h"
 #include "benchmark/benchmark.h"
 #include "components/data/blob_storage/blob_storage_client.h"
 #include "components/data_server/cache/cache.h"
@@ -39,6 +47,8 @@
 #include "public/data_loading/data_loading_generated.h"
 #include "public/data_loading/readers/riegeli_stream_io.h"
 #include "public/data_loading/records_utils.h"
+#include "public/data_loading/writers/delta_record_writer.h"
+#include "public/data_loading/writers/record_writer_options.h"
 
 ABSL_FLAG(std::string, data_directory, "",
           "Data directory or bucket to store benchmark input data files in.");
@@ -64,8 +74,38 @@ ABSL_FLAG(
     std::vector<std::string>, args_client_max_range_mb,
     std::vector<std::string>({"8"}),
     "Chunk size to use when reading blobs in mbs. Ignored for local platform.");
+ABSL_FLAG(std::vector<std::string>, args_client_read_ahead_chunks,
+          std::vector<std::string>({"4"}),
+          "A list of numbers of chunks of a blob to download concurrently "
+          "ahead of the reader. Ignored for local platform.");
+ABSL_FLAG(std::vector<std::string>, args_client_socket_buffer_kb,
+          std::vector<std::string>({"0"}),
+          "A list of socket receive and send buffer sizes in kbs for the "
+          "blob client connections. 0 keeps the system defaults. Only used "
+          "on GCP.");
+ABSL_FLAG(std::vector<std::string>, args_copy_records,
+          std::vector<std::string>({"false"}),
+          "A list of whether the record callbacks copy each record into a "
+          "string before deserializing it, as they did before records were "
+          "read in place, to measure the copies that reading in place saves.");
 ABSL_FLAG(int64_t, args_benchmark_iterations, -1,
           "Number of iterations to run each benchmark.");
+ABSL_FLAG(std::vector<std::string>, args_compression,
+          std::vector<std::string>({"brotli"}),
+          "A list of compression types (brotli, zstd, snappy or none) to write "
+          "input files with when '--create_input_file' is true.");
+ABSL_FLAG(std::vector<std::string>, args_compression_level,
+          std::vector<std::string>({"-1"}),
+          "A list of compression levels to write input files with when "
+          "'--create_input_file' is true. -1 uses the default level.");
+ABSL_FLAG(std::vector<std::string>, args_chunk_size_kb,
+          std::vector<std::string>({"0"}),
+          "A list of chunk sizes in kbs to write input files with when "
+          "'--create_input_file' is true. 0 uses the default chunk size.");
+ABSL_FLAG(std::vector<std::string>, args_transpose,
+          std::vector<std::string>({"false"}),
+          "A list of whether to transpose records when writing input files "
+          "when '--create_input_file' is true.");
 
 using kv_server::BlobReader;
 using kv_server::BlobStorageClient;
@@ -73,29 +113,46 @@ using kv_server::BlobStorageClientFactory;
 using kv_server::Cache;
 using kv_server::ConcurrentStreamRecordReader;
 using kv_server::DataRecord;
+using kv_server::DeltaRecordWriter;
 using kv_server::DeserializeDataRecord;
 using kv_server::GetRecordValue;
+using kv_server::GetRecordWriterOptionsText;
 using kv_server::KeyValueCache;
 using kv_server::KeyValueMutationRecord;
 using kv_server::KeyValueMutationType;
 using kv_server::NoOpKeyValueCache;
 using kv_server::Record;
 using kv_server::RecordStream;
+using kv_server::StringSetView;
 using kv_server::Value;
+using kv_server::ValidateRecordWriterOptions;
 using kv_server::benchmark::ParseInt64List;
 using kv_server::benchmark::WriteRecords;
 
 constexpr std::string_view kNoOpCacheNameFormat =
-    "BM_DataLoading_NoOpCache/tds:%d/conns:%d/buf:%d";
+    "BM_DataLoading_NoOpCache/tds:%d/conns:%d/buf:%d/ra:%d/sockbuf:%d/file:%s";
 constexpr std::string_view kMutexCacheNameFormat =
-    "BM_DataLoading_MutexCache/tds:%d/conns:%d/buf:%d";
+    "BM_DataLoading_MutexCache/tds:%d/conns:%d/buf:%d/ra:%d/sockbuf:%d/file:%s";
+
+// Data file to benchmark, along with the writer options used to create it
+// when '--create_input_file' is true.
+struct InputFile {
+  std::string filename;
+  // Label for the file in benchmark names.
+  std::string label;
+  DeltaRecordWriter::Options writer_options;
+};
 
 // Args config for benchmarks.
 struct BenchmarkArgs {
   int64_t reader_worker_threads;
   int64_t client_max_connections;
   int64_t client_max_range_mb;
+  int64_t client_read_ahead_chunks;
+  int64_t client_socket_buffer_kb;
+  std::string filename;
   std::function<std::unique_ptr<Cache>()> create_cache_fn;
+  bool copy_records = false;
 };
 
 // Wraps an io stream so that it can used as a blob reader.
@@ -121,13 +178,103 @@ class BlobRecordStream : public RecordStream {
   std::unique_ptr<BlobReader> blob_reader_;
 };
 
-BlobStorageClient::DataLocation GetBlobLocation() {
+BlobStorageClient::DataLocation GetBlobLocation(std::string_view filename) {
   return BlobStorageClient::DataLocation{
       .bucket = absl::GetFlag(FLAGS_data_directory),
-      .key = absl::GetFlag(FLAGS_filename),
+      .key = std::string(filename),
   };
 }
 
+// Returns the chunk options for `compression` combined with each of the
+// compression level, chunk size and transpose flags. Levels are ignored when
+// `compression` is "none".
+absl::StatusOr<std::vector<DeltaRecordWriter::ChunkOptions>> ParseChunkOptions(
+    std::string_view compression) {
+  std::vector<DeltaRecordWriter::ChunkOptions> result;
+  DeltaRecordWriter::ChunkOptions chunk_options;
+  if (compression == "none") {
+    // Compression type is unused for uncompressed files.
+  } else if (compression == "brotli") {
+    chunk_options.compression = DeltaRecordWriter::Compression::kBrotli;
+  } else if (compression == "zstd") {
+    chunk_options.compression = DeltaRecordWriter::Compression::kZstd;
+  } else if (compression == "snappy") {
+    chunk_options.compression = DeltaRecordWriter::Compression::kSnappy;
+  } else {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Unsupported compression type: ", compression));
+  }
+  auto levels = ParseInt64List(absl::GetFlag(FLAGS_args_compression_level));
+  if (!levels.ok()) {
+    return levels.status();
+  }
+  if (compression == "none") {
+    levels = std::vector<int64_t>{-1};
+  }
+  auto chunk_sizes_kb = ParseInt64List(absl::GetFlag(FLAGS_args_chunk_size_kb));
+  if (!chunk_sizes_kb.ok()) {
+    return chunk_sizes_kb.status();
+  }
+  for (const int64_t level : *levels) {
+    chunk_options.compression_level = std::nullopt;
+    if (level >= 0) {
+      chunk_options.compression_level = level;
+    }
+    for (const int64_t chunk_size_kb : *chunk_sizes_kb) {
+      chunk_options.chunk_size = std::nullopt;
+      if (chunk_size_kb > 0) {
+        chunk_options.chunk_size = chunk_size_kb * 1024;
+      }
+      for (std::string_view transpose_flag :
+           absl::GetFlag(FLAGS_args_transpose)) {
+        if (!absl::SimpleAtob(transpose_flag, &chunk_options.transpose)) {
+          return absl::InvalidArgumentError(
+              absl::StrCat("Failed to parse transpose: ", transpose_flag));
+        }
+        result.push_back(chunk_options);
+      }
+    }
+  }
+  return result;
+}
+
+// Returns the data files to benchmark. When '--create_input_file' is true,
+// there is one file per combination of the writer options flags, otherwise
+// just the file given by '--filename'.
+absl::StatusOr<std::vector<InputFile>> GetInputFiles() {
+  if (!absl::GetFlag(FLAGS_create_input_file)) {
+    return std::vector<InputFile>{{
+        .filename = absl::GetFlag(FLAGS_filename),
+        .label = absl::GetFlag(FLAGS_filename),
+    }};
+  }
+  std::vector<InputFile> input_files;
+  for (std::string_view compression : absl::GetFlag(FLAGS_args_compression)) {
+    auto chunk_options_list = ParseChunkOptions(compression);
+    if (!chunk_options_list.ok()) {
+      return chunk_options_list.status();
+    }
+    for (const auto& chunk_options : *chunk_options_list) {
+      DeltaRecordWriter::Options writer_options{
+          .enable_compression = compression != "none",
+          .chunk_options = chunk_options,
+      };
+      if (auto status = ValidateRecordWriterOptions(writer_options);
+          !status.ok()) {
+        return status;
+      }
+      std::string label = GetRecordWriterOptionsText(writer_options);
+      input_files.push_back(InputFile{
+          .filename = absl::StrCat(absl::GetFlag(FLAGS_filename), ".",
+                                   input_files.size()),
+          .label = std::move(label),
+          .writer_options = std::move(writer_options),
+      });
+    }
+  }
+  return input_files;
+}
+
 int64_t GetBlobSize(BlobStorageClient& blob_client,
                     BlobStorageClient::DataLocation blob) {
   auto blob_reader = blob_client.GetBlobReader(blob);
@@ -149,34 +296,87 @@ void RegisterBenchmark(std::string_view benchmark_name, BenchmarkArgs args) {
 }
 
 // Registers benchmark
-void RegisterBenchmarks() {
+void RegisterBenchmarks(const std::vector<InputFile>& input_files) {
   auto num_worker_threads =
       ParseInt64List(absl::GetFlag(FLAGS_args_reader_worker_threads));
   auto client_max_conns =
       ParseInt64List(absl::GetFlag(FLAGS_args_client_max_connections));
   auto client_max_range_mb =
       ParseInt64List(absl::GetFlag(FLAGS_args_client_max_range_mb));
-  for (const int64_t byte_range_mb : client_max_range_mb.value()) {
-    for (const int64_t num_connections : client_max_conns.value()) {
-      for (const int64_t num_threads : num_worker_threads.value()) {
-        auto args = BenchmarkArgs{
-            .reader_worker_threads = num_threads,
-            .client_max_connections = num_connections,
-            .client_max_range_mb = byte_range_mb,
-            .create_cache_fn = []() { return NoOpKeyValueCache::Create(); },
-        };
-        RegisterBenchmark(absl::StrFormat(kNoOpCacheNameFormat, num_threads,
-                                          num_connections, byte_range_mb),
-                          args);
-        args.create_cache_fn = []() { return KeyValueCache::Create(); };
-        RegisterBenchmark(absl::StrFormat(kMutexCacheNameFormat, num_threads,
-                                          num_connections, byte_range_mb),
-                          args);
+  auto client_read_ahead_chunks =
+      ParseInt64List(absl::GetFlag(FLAGS_args_client_read_ahead_chunks));
+  auto client_socket_buffer_kb =
+      ParseInt64List(absl::GetFlag(FLAGS_args_client_socket_buffer_kb));
+  std::vector<bool> copy_records_list;
+  for (std::string_view copy_records_flag :
+       absl::GetFlag(FLAGS_args_copy_records)) {
+    bool copy_records = false;
+    if (!absl::SimpleAtob(copy_records_flag, &copy_records)) {
+      LOG(ERROR) << "Failed to parse copy_records: " << copy_records_flag;
+      continue;
+    }
+    copy_records_list.push_back(copy_records);
+  }
+  for (const auto& input_file : input_files) {
+    for (const int64_t socket_buffer_kb : client_socket_buffer_kb.value()) {
+      for (const int64_t read_ahead_chunks : client_read_ahead_chunks.value()) {
+        for (const int64_t byte_range_mb : client_max_range_mb.value()) {
+          for (const int64_t num_connections : client_max_conns.value()) {
+            for (const int64_t num_threads : num_worker_threads.value()) {
+              for (const bool copy_records : copy_records_list) {
+                auto args = BenchmarkArgs{
+                    .reader_worker_threads = num_threads,
+                    .client_max_connections = num_connections,
+                    .client_max_range_mb = byte_range_mb,
+                    .client_read_ahead_chunks = read_ahead_chunks,
+                    .client_socket_buffer_kb = socket_buffer_kb,
+                    .filename = input_file.filename,
+                    .create_cache_fn =
+                        []() { return NoOpKeyValueCache::Create(); },
+                    .copy_records = copy_records,
+                };
+                const std::string_view copy_suffix =
+                    copy_records ? "/copy" : "";
+                RegisterBenchmark(
+                    absl::StrCat(absl::StrFormat(kNoOpCacheNameFormat,
+                                                 num_threads, num_connections,
+                                                 byte_range_mb,
+                                                 read_ahead_chunks,
+                                                 socket_buffer_kb,
+                                                 input_file.label),
+                                 copy_suffix),
+                    args);
+                args.create_cache_fn = []() {
+                  return KeyValueCache::Create();
+                };
+                RegisterBenchmark(
+                    absl::StrCat(absl::StrFormat(kMutexCacheNameFormat,
+                                                 num_threads, num_connections,
+                                                 byte_range_mb,
+                                                 read_ahead_chunks,
+                                                 socket_buffer_kb,
+                                                 input_file.label),
+                                 copy_suffix),
+                    args);
+              }
+            }
+          }
+        }
       }
     }
   }
 }
 
+// Returns the values of a set record, in a vector that the reader thread
+// reuses, so that applying set records doesn't allocate per record.
+absl::Span<std::string_view> GetSetValues(
+    const KeyValueMutationRecord& record) {
+  thread_local std::vector<std::string_view> values;
+  const auto view = GetRecordValue<StringSetView>(record);
+  values.assign(view.begin(), view.end());
+  return absl::MakeSpan(values);
+}
+
 absl::Status ApplyUpdateMutation(const KeyValueMutationRecord& record,
                                  Cache& cache) {
   if (record.value_type() == Value::StringValue) {
@@ -186,8 +386,7 @@ absl::Status ApplyUpdateMutation(const KeyValueMutationRecord& record,
     return absl::OkStatus();
   }
   if (record.value_type() == Value::StringSet) {
-    auto values = GetRecordValue<std::vector<std::string_view>>(record);
-    cache.UpdateKeyValueSet(record.key()->string_view(), absl::MakeSpan(values),
+    cache.UpdateKeyValueSet(record.key()->string_view(), GetSetValues(record),
                             record.logical_commit_time());
     return absl::OkStatus();
   }
@@ -203,8 +402,7 @@ absl::Status ApplyDeleteMutation(const KeyValueMutationRecord& record,
     return absl::OkStatus();
   }
   if (record.value_type() == Value::StringSet) {
-    auto values = GetRecordValue<std::vector<std::string_view>>(record);
-    cache.DeleteValuesInSet(record.key()->string_view(), absl::MakeSpan(values),
+    cache.DeleteValuesInSet(record.key()->string_view(), GetSetValues(record),
                             record.logical_commit_time());
     return absl::OkStatus();
   }
@@ -217,6 +415,9 @@ void BM_LoadDataIntoCache(benchmark::State& state, BenchmarkArgs args) {
   BlobStorageClient::ClientOptions options;
   options.max_range_bytes = args.client_max_range_mb * 1024 * 1024;
   options.max_connections = args.client_max_connections;
+  options.read_ahead_chunks = args.client_read_ahead_chunks;
+  options.socket_receive_buffer_bytes = args.client_socket_buffer_kb * 1024;
+  options.socket_send_buffer_bytes = args.client_socket_buffer_kb * 1024;
 
   std::unique_ptr<BlobStorageClientFactory> blob_storage_client_factory =
       BlobStorageClientFactory::Create();
@@ -224,25 +425,44 @@ void BM_LoadDataIntoCache(benchmark::State& state, BenchmarkArgs args) {
       blob_storage_client_factory->CreateBlobStorageClient(options);
   ConcurrentStreamRecordReader<std::string_view> record_reader(
       /*stream_factory=*/
-      [blob_client = blob_client.get()]() {
+      [blob_client = blob_client.get(), filename = args.filename]() {
         return std::make_unique<BlobRecordStream>(
-            blob_client->GetBlobReader(GetBlobLocation()));
+            blob_client->GetBlobReader(GetBlobLocation(filename)));
       },
       /*options=*/
       {
           .num_worker_threads = args.reader_worker_threads,
       });
-  auto stream_size = GetBlobSize(*blob_client, GetBlobLocation());
+  auto stream_size = GetBlobSize(*blob_client, GetBlobLocation(args.filename));
   std::atomic<int64_t> num_records_read{0};
+  // Time spent in the record callbacks, and in deserializing and applying the
+  // records within them, summed over the reader threads. The reader threads
+  // spend the rest of their time fetching and decoding Riegeli chunks.
+  std::atomic<int64_t> callback_nanos{0};
+  std::atomic<int64_t> copy_nanos{0};
+  std::atomic<int64_t> deserialize_nanos{0};
+  std::atomic<int64_t> cache_apply_nanos{0};
   for (auto _ : state) {
     state.PauseTiming();
     auto cache = args.create_cache_fn();
     state.ResumeTiming();
-    auto status = record_reader.ReadStreamRecords([&num_records_read,
-                                                   cache = cache.get()](
-                                                      std::string_view raw) {
+    auto status = record_reader.ReadStreamRecords([&](std::string_view raw) {
       num_records_read++;
-      return DeserializeDataRecord(raw, [cache](const DataRecord& data_record) {
+      const absl::Time start = absl::Now();
+      // Records are views into the chunks of the reader, see
+      // `--args_copy_records`.
+      std::string copy;
+      absl::Time copied = start;
+      if (args.copy_records) {
+        copy.assign(raw);
+        raw = copy;
+        copied = absl::Now();
+        copy_nanos += absl::ToInt64Nanoseconds(copied - start);
+      }
+      absl::Time deserialized = absl::InfinitePast();
+      const auto apply_record_fn = [&deserialized, cache = cache.get()](
+                                       const DataRecord& data_record) {
+        deserialized = absl::Now();
         if (data_record.record_type() == Record::KeyValueMutationRecord) {
           const auto* record = data_record.record_as_KeyValueMutationRecord();
           switch (record->mutation_type()) {
@@ -267,11 +487,33 @@ void BM_LoadDataIntoCache(benchmark::State& state, BenchmarkArgs args) {
           }
         }
         return absl::OkStatus();
-      });
+      };
+      auto record_status = DeserializeDataRecord(raw, apply_record_fn);
+      const absl::Time end = absl::Now();
+      if (deserialized == absl::InfinitePast()) {
+        // The record failed to deserialize.
+        deserialized = end;
+      }
+      callback_nanos += absl::ToInt64Nanoseconds(end - start);
+      deserialize_nanos += absl::ToInt64Nanoseconds(deserialized - copied);
+      cache_apply_nanos += absl::ToInt64Nanoseconds(end - deserialized);
+      return record_status;
     });
     benchmark::DoNotOptimize(status);
   }
   state.SetItemsProcessed(num_records_read);
+  const auto add_stage_counter = [&state](std::string_view name,
+                                          int64_t nanos) {
+    state.counters[std::string(name)] = benchmark::Counter(
+        absl::ToDoubleMilliseconds(absl::Nanoseconds(nanos)),
+        benchmark::Counter::kAvgIterations);
+  };
+  add_stage_counter("callback_ms", callback_nanos);
+  add_stage_counter("copy_ms", copy_nanos);
+  add_stage_counter("deserialize_ms", deserialize_nanos);
+  add_stage_counter("cache_apply_ms", cache_apply_nanos);
+  state.counters["file_size_mb"] =
+      static_cast<double>(stream_size) / (1024 * 1024);
   state.SetBytesProcessed(stream_size *
                           static_cast<int64_t>(state.iterations()));
 }
@@ -290,7 +532,14 @@ void BM_LoadDataIntoCache(benchmark::State& state, BenchmarkArgs args) {
 //    --record_size=1000 \
 //    --args_client_max_range_mb=8 \
 //    --args_client_max_connections=64 \
-//    --args_reader_worker_threads=16,32,64 --stderrthreshold=0
+//    --args_client_read_ahead_chunks=0,4,8 \
+//    --args_client_socket_buffer_kb=0,4096 \
+//    --args_reader_worker_threads=16,32,64 \
+//    --args_compression=brotli,zstd,snappy,none \
+//    --args_compression_level=-1,1 \
+//    --args_chunk_size_kb=0,4096 \
+//    --args_transpose=false,true \
+//    --args_copy_records=false,true --stderrthreshold=0
 int main(int argc, char** argv) {
   ::kv_server::PlatformInitializer platform_initializer;
   absl::InitializeLog();
@@ -309,35 +558,46 @@ int main(int argc, char** argv) {
       BlobStorageClientFactory::Create();
   std::unique_ptr<BlobStorageClient> blob_client =
       blob_storage_client_factory->CreateBlobStorageClient();
+  auto input_files = GetInputFiles();
+  if (!input_files.ok()) {
+    LOG(ERROR) << "Failed to parse writer options. " << input_files.status();
+    return -1;
+  }
   if (absl::GetFlag(FLAGS_create_input_file)) {
-    LOG(INFO) << "Creating input file: " << GetBlobLocation();
-    std::stringstream data_stream;
-    if (auto status =
-            WriteRecords(absl::GetFlag(FLAGS_num_records),
-                         absl::GetFlag(FLAGS_record_size), data_stream);
-        !status.ok()) {
-      LOG(ERROR) << "Failed to write records for data file. " << status;
-      return -1;
-    }
-    StreamBlobReader blob_reader(data_stream);
-    if (auto status = blob_client->PutBlob(blob_reader, GetBlobLocation());
-        !status.ok()) {
-      LOG(ERROR) << "Failed to write data file. " << status;
-      return -1;
+    for (const auto& input_file : *input_files) {
+      const auto location = GetBlobLocation(input_file.filename);
+      LOG(INFO) << "Creating input file: " << location
+                << " with writer options: " << input_file.label;
+      std::stringstream data_stream;
+      if (auto status = WriteRecords(absl::GetFlag(FLAGS_num_records),
+                                     absl::GetFlag(FLAGS_record_size),
+                                     data_stream, input_file.writer_options);
+          !status.ok()) {
+        LOG(ERROR) << "Failed to write records for data file. " << status;
+        return -1;
+      }
+      StreamBlobReader blob_reader(data_stream);
+      if (auto status = blob_client->PutBlob(blob_reader, location);
+          !status.ok()) {
+        LOG(ERROR) << "Failed to write data file. " << status;
+        return -1;
+      }
+      LOG(INFO) << "Done creating input file: " << location;
     }
-    LOG(INFO) << "Done creating input file: " << GetBlobLocation();
   }
-  RegisterBenchmarks();
+  RegisterBenchmarks(*input_files);
   ::benchmark::RunSpecifiedBenchmarks();
   ::benchmark::Shutdown();
   if (absl::GetFlag(FLAGS_create_input_file)) {
-    LOG(INFO) << "Deleting input file: " << GetBlobLocation();
-    if (auto status = blob_client->DeleteBlob(GetBlobLocation());
-        !status.ok()) {
-      LOG(ERROR) << "Failed to write data file. " << status;
-      return -1;
+    for (const auto& input_file : *input_files) {
+      const auto location = GetBlobLocation(input_file.filename);
+      LOG(INFO) << "Deleting input file: " << location;
+      if (auto status = blob_client->DeleteBlob(location); !status.ok()) {
+        LOG(ERROR) << "Failed to delete data file. " << status;
+        return -1;
+      }
+      LOG(INFO) << "Done deleting input file: " << location;
     }
-    LOG(INFO) << "Done deleting input file: " << GetBlobLocation();
   }
   return 0;
 }
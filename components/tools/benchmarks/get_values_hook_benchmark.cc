@@ -0,0 +1,127 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/log/initialize.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "benchmark/benchmark.h"
+#include "components/internal_server/lookup.h"
+#include "components/internal_server/lookup.pb.h"
+#include "components/udf/hooks/get_values_hook.h"
+#include "components/util/request_context.h"
+
+namespace kv_server {
+namespace {
+
+using google::scp::roma::FunctionBindingPayload;
+using google::scp::roma::proto::FunctionBindingIoProto;
+
+// Returns the same canned response for every lookup, so that the benchmark
+// only measures the hook itself: reading the input and writing the output.
+class FakeLookup : public Lookup {
+ public:
+  explicit FakeLookup(InternalLookupResponse response)
+      : response_(std::move(response)) {}
+
+  absl::StatusOr<InternalLookupResponse> GetKeyValues(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& keys) const override {
+    return response_;
+  }
+
+  absl::StatusOr<InternalLookupResponse> GetKeyValueSet(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override {
+    return response_;
+  }
+
+  absl::StatusOr<InternalRunQueryResponse> RunQuery(
+      const RequestContext& request_context,
+      std::string query) const override {
+    return InternalRunQueryResponse();
+  }
+
+ private:
+  InternalLookupResponse response_;
+};
+
+// Args: number of keys and size of each value in bytes.
+void BM_GetValuesHook(::benchmark::State& state,
+                      GetValuesHook::OutputType output_type) {
+  const int64_t num_keys = state.range(0);
+  const std::string value(state.range(1), 'v');
+  FunctionBindingIoProto input;
+  InternalLookupResponse response;
+  for (int64_t i = 0; i < num_keys; ++i) {
+    std::string key = absl::StrCat("key", i);
+    (*response.mutable_kv_pairs())[key].set_value(value);
+    input.mutable_input_list_of_string()->add_data(std::move(key));
+  }
+  auto hook = GetValuesHook::Create(output_type);
+  hook->FinishInit(std::make_unique<FakeLookup>(std::move(response)));
+  auto scope_metrics_context = std::make_unique<ScopeMetricsContext>();
+  RequestContext request_context(*scope_metrics_context);
+  for (auto _ : state) {
+    FunctionBindingIoProto io = input;
+    FunctionBindingPayload<RequestContext> payload{io, request_context};
+    (*hook)(payload);
+    ::benchmark::DoNotOptimize(io);
+  }
+  state.SetItemsProcessed(state.iterations() * num_keys);
+}
+
+void RegisterBenchmarks() {
+  const auto add_sizes = [](::benchmark::internal::Benchmark* b) {
+    for (const int64_t num_keys : {1, 10, 100, 1000}) {
+      for (const int64_t value_size : {10, 1000}) {
+        b->Args({num_keys, value_size});
+      }
+    }
+  };
+  add_sizes(::benchmark::RegisterBenchmark("BM_GetValuesHookString",
+                                           BM_GetValuesHook,
+                                           GetValuesHook::OutputType::kString));
+  add_sizes(::benchmark::RegisterBenchmark("BM_GetValuesHookBinary",
+                                           BM_GetValuesHook,
+                                           GetValuesHook::OutputType::kBinary));
+}
+
+}  // namespace
+}  // namespace kv_server
+
+// Microbenchmarks of the `getValues` hook that UDFs call, for the string and
+// the binary output types, with the lookup itself faked out. Sample run:
+//
+//  bazel run -c opt \
+//    //components/tools/benchmarks:get_values_hook_benchmark \
+//    --//:instance=local \
+//    --//:platform=local -- \
+//    --benchmark_counters_tabular=true
+int main(int argc, char** argv) {
+  absl::InitializeLog();
+  ::benchmark::Initialize(&argc, argv);
+  kv_server::InitMetricsContextMap();
+  ::kv_server::RegisterBenchmarks();
+  ::benchmark::RunSpecifiedBenchmarks();
+  ::benchmark::Shutdown();
+  return 0;
+}
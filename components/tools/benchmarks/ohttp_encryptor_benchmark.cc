@@ -0,0 +1,92 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#include "absl/log/initialize.h"
+#include "benchmark/benchmark.h"
+#include "components/data_server/request_handler/ohttp_client_encryptor.h"
+#include "components/data_server/request_handler/ohttp_server_encryptor.h"
+#include "src/encryption/key_fetcher/fake_key_fetcher_manager.h"
+
+namespace kv_server {
+namespace {
+
+// Args: size of the request and of the response in bytes.
+void BM_OhttpRoundTrip(::benchmark::State& state) {
+  privacy_sandbox::server_common::FakeKeyFetcherManager key_fetcher_manager;
+  const std::string payload(state.range(0), 'p');
+  for (auto _ : state) {
+    OhttpClientEncryptor client_encryptor(key_fetcher_manager);
+    OhttpServerEncryptor server_encryptor(key_fetcher_manager);
+    auto encrypted_request = client_encryptor.EncryptRequest(payload);
+    auto decrypted_request =
+        server_encryptor.DecryptRequest(*encrypted_request);
+    auto encrypted_response = server_encryptor.EncryptResponse(payload);
+    auto decrypted_response =
+        client_encryptor.DecryptResponse(*std::move(encrypted_response));
+    if (!decrypted_request.ok() || !decrypted_response.ok()) {
+      state.SkipWithError("Round trip failed");
+      return;
+    }
+    ::benchmark::DoNotOptimize(decrypted_response);
+  }
+  state.SetBytesProcessed(state.iterations() * 2 * payload.size());
+}
+
+// Args: size of the request in bytes.
+void BM_OhttpServerDecryptRequest(::benchmark::State& state) {
+  privacy_sandbox::server_common::FakeKeyFetcherManager key_fetcher_manager;
+  OhttpClientEncryptor client_encryptor(key_fetcher_manager);
+  const auto encrypted_request =
+      client_encryptor.EncryptRequest(std::string(state.range(0), 'p'));
+  if (!encrypted_request.ok()) {
+    state.SkipWithError("Encryption failed");
+    return;
+  }
+  for (auto _ : state) {
+    OhttpServerEncryptor server_encryptor(key_fetcher_manager);
+    auto decrypted_request =
+        server_encryptor.DecryptRequest(*encrypted_request);
+    ::benchmark::DoNotOptimize(decrypted_request);
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_OhttpRoundTrip)->Arg(100)->Arg(10'000)->Arg(1'000'000);
+BENCHMARK(BM_OhttpServerDecryptRequest)->Arg(100)->Arg(10'000)->Arg(1'000'000);
+
+}  // namespace
+}  // namespace kv_server
+
+// Microbenchmarks of the OHTTP encryption of v2 requests and responses, as
+// done by clients and servers for each request, with the test HPKE keys.
+// Sample run:
+//
+//  bazel run -c opt \
+//    //components/tools/benchmarks:ohttp_encryptor_benchmark \
+//    --//:instance=local \
+//    --//:platform=local -- \
+//    --benchmark_counters_tabular=true
+int main(int argc, char** argv) {
+  absl::InitializeLog();
+  ::benchmark::Initialize(&argc, argv);
+  ::benchmark::RunSpecifiedBenchmarks();
+  ::benchmark::Shutdown();
+  return 0;
+}
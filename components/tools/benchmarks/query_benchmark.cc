@@ -0,0 +1,311 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/log/initialize.h"
+#include "absl/log/log.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "benchmark/benchmark.h"
+#include "components/data_server/cache/cache.h"
+#include "components/data_server/cache/key_value_cache.h"
+#include "components/internal_server/local_lookup.h"
+#include "components/internal_server/lookup.h"
+#include "components/internal_server/remote_lookup_client.h"
+#include "components/internal_server/sharded_lookup.h"
+#include "components/query/ast.h"
+#include "components/query/driver.h"
+#include "components/query/scanner.h"
+#include "components/sharding/shard_manager.h"
+#include "components/util/request_context.h"
+#include "public/sharding/key_sharder.h"
+
+namespace kv_server {
+namespace {
+
+// Number of members in each set, drawn from `kNumMembers` members.
+constexpr int kSetSize = 1000;
+constexpr int kNumMembers = 100000;
+
+enum class TreeShape : int64_t {
+  // `A | (B | C)`, evaluated one operation at a time.
+  kBalanced = 0,
+  // `A | B | C`, flattened into one operation with many operands.
+  kChain = 1,
+};
+
+std::string Key(int i) { return absl::StrCat("key", i); }
+
+// A query over `num_keys` keys, all combined with `op`.
+std::string Query(int64_t num_keys, TreeShape shape, std::string_view op) {
+  if (shape == TreeShape::kChain) {
+    std::string query = Key(0);
+    for (int i = 1; i < num_keys; ++i) {
+      absl::StrAppend(&query, " ", op, " ", Key(i));
+    }
+    return query;
+  }
+  std::vector<std::string> level;
+  for (int i = 0; i < num_keys; ++i) {
+    level.push_back(Key(i));
+  }
+  while (level.size() > 1) {
+    std::vector<std::string> next;
+    for (size_t i = 0; i + 1 < level.size(); i += 2) {
+      next.push_back(absl::StrCat("(", level[i], " ", op, " ", level[i + 1],
+                                  ")"));
+    }
+    if (level.size() % 2 == 1) {
+      next.push_back(std::move(level.back()));
+    }
+    level = std::move(next);
+  }
+  return level.front();
+}
+
+std::string_view OpName(int64_t op) { return op == 0 ? "|" : "&"; }
+
+std::unique_ptr<Driver> Parse(std::string_view query) {
+  auto driver = std::make_unique<Driver>([](std::string_view key) {
+    return absl::flat_hash_set<std::string_view>();
+  });
+  std::istringstream stream{std::string(query)};
+  Scanner scanner(stream);
+  Parser parse(*driver, scanner);
+  if (parse() != 0) {
+    LOG(FATAL) << "Failed to parse " << query;
+  }
+  return driver;
+}
+
+const std::vector<std::string>& Members() {
+  static const auto* members = [] {
+    auto* members = new std::vector<std::string>();
+    for (int i = 0; i < kNumMembers; ++i) {
+      members->push_back(absl::StrCat("member", i));
+    }
+    return members;
+  }();
+  return *members;
+}
+
+// Random sets of `kSetSize` members for the keys of `Query(num_keys, ...)`.
+absl::flat_hash_map<std::string, absl::flat_hash_set<std::string_view>> Sets(
+    int64_t num_keys) {
+  std::mt19937 gen(/*seed=*/1);
+  std::uniform_int_distribution<int> member(0, kNumMembers - 1);
+  absl::flat_hash_map<std::string, absl::flat_hash_set<std::string_view>> sets;
+  for (int i = 0; i < num_keys; ++i) {
+    auto& set = sets[Key(i)];
+    while (set.size() < kSetSize) {
+      set.insert(Members()[member(gen)]);
+    }
+  }
+  return sets;
+}
+
+// Args: number of keys, `TreeShape` and 0 for unions or 1 for intersections.
+void BM_Parse(::benchmark::State& state) {
+  const std::string query =
+      Query(state.range(0), static_cast<TreeShape>(state.range(1)),
+            OpName(state.range(2)));
+  for (auto _ : state) {
+    ::benchmark::DoNotOptimize(Parse(query));
+  }
+  state.SetBytesProcessed(state.iterations() * query.size());
+}
+
+// Evaluates the tree of the query by visiting its nodes, see `Eval`.
+void BM_EvalTree(::benchmark::State& state) {
+  const auto sets = Sets(state.range(0));
+  const auto driver =
+      Parse(Query(state.range(0), static_cast<TreeShape>(state.range(1)),
+                  OpName(state.range(2))));
+  for (auto _ : state) {
+    ::benchmark::DoNotOptimize(
+        Eval(*driver->GetRootNode(),
+             [&sets](std::string_view key) { return sets.at(key); }));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0) * kSetSize);
+}
+
+// Runs the `QueryProgram` that the driver compiled from the tree.
+void BM_RunProgram(::benchmark::State& state) {
+  const auto sets = Sets(state.range(0));
+  const auto driver =
+      Parse(Query(state.range(0), static_cast<TreeShape>(state.range(1)),
+                  OpName(state.range(2))));
+  for (auto _ : state) {
+    ::benchmark::DoNotOptimize(driver->GetResult(
+        [&sets](std::string_view key) { return sets.at(key); }));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0) * kSetSize);
+}
+
+// Serves the requests that `ShardedLookup` sends to a shard with the local
+// lookup of that shard, as the internal lookup server of the shard does.
+class FakeShardClient : public RemoteLookupClient {
+ public:
+  FakeShardClient(std::string ip_address, const Lookup& lookup)
+      : ip_address_(std::move(ip_address)), lookup_(lookup) {}
+
+  absl::StatusOr<InternalLookupResponse> GetValues(
+      const RequestContext& request_context,
+      std::string_view serialized_message,
+      int32_t padding_length) const override {
+    InternalLookupRequest request;
+    if (!request.ParseFromArray(serialized_message.data(),
+                                serialized_message.size())) {
+      return absl::InvalidArgumentError("Failed to parse the request.");
+    }
+    const absl::flat_hash_set<std::string_view> keys(request.keys().begin(),
+                                                     request.keys().end());
+    auto response = request.lookup_sets()
+                        ? lookup_.GetKeyValueSet(request_context, keys)
+                        : lookup_.GetKeyValues(request_context, keys);
+    if (!response.ok()) {
+      return response;
+    }
+    for (const auto& query : request.queries()) {
+      SingleLookupResult result;
+      auto query_result = lookup_.RunQuery(request_context, query);
+      if (query_result.ok()) {
+        result.mutable_keyset_values()->mutable_values()->Swap(
+            query_result->mutable_elements());
+      } else {
+        result.mutable_status()->set_code(
+            static_cast<int>(query_result.status().code()));
+      }
+      (*response->mutable_kv_pairs())[query] = std::move(result);
+    }
+    return response;
+  }
+
+  std::string_view GetIpAddress() const override { return ip_address_; }
+
+ private:
+  const std::string ip_address_;
+  const Lookup& lookup_;
+};
+
+class FirstReplica : public RandomGenerator {
+ public:
+  int64_t Get(int64_t upper_bound) override { return 0; }
+};
+
+// The sets of `Sets(num_keys)` spread over shards that each have their own
+// cache and local lookup. This server is shard 0.
+struct ShardedData {
+  ShardedData(int64_t num_shards, int64_t num_keys) {
+    const KeySharder key_sharder(ShardingFunction{/*seed=*/""});
+    std::vector<absl::flat_hash_set<std::string>> cluster_mappings;
+    for (int shard_num = 0; shard_num < num_shards; ++shard_num) {
+      caches.push_back(KeyValueCache::Create());
+      local_lookups.push_back(CreateLocalLookup(*caches.back()));
+      cluster_mappings.push_back({std::to_string(shard_num)});
+    }
+    for (auto& [key, set] : Sets(num_keys)) {
+      std::vector<std::string_view> values(set.begin(), set.end());
+      caches[key_sharder.GetShardNumForKey(key, num_shards).shard_num]
+          ->UpdateKeyValueSet(key, absl::MakeSpan(values),
+                              /*logical_commit_time=*/1);
+    }
+    shard_manager = *ShardManager::Create(
+        num_shards, cluster_mappings, std::make_unique<FirstReplica>(),
+        [this](const std::string& ip) {
+          return std::make_unique<FakeShardClient>(
+              ip, *local_lookups[std::stoi(ip)]);
+        });
+    sharded_lookup =
+        CreateShardedLookup(*local_lookups[0], num_shards, /*shard_num=*/0,
+                            *shard_manager, key_sharder);
+  }
+
+  std::vector<std::unique_ptr<Cache>> caches;
+  std::vector<std::unique_ptr<Lookup>> local_lookups;
+  std::unique_ptr<ShardManager> shard_manager;
+  std::unique_ptr<Lookup> sharded_lookup;
+};
+
+// Args: number of shards, number of keys and 0 for unions or 1 for
+// intersections. Runs the whole query of the sharded lookup, from fetching
+// the sets or pushing down subtrees to returning the elements.
+void BM_ShardedRunQuery(::benchmark::State& state) {
+  ShardedData data(state.range(0), state.range(1));
+  const std::string query =
+      Query(state.range(1), TreeShape::kChain, OpName(state.range(2)));
+  auto scope_metrics_context = std::make_unique<ScopeMetricsContext>();
+  RequestContext request_context(*scope_metrics_context);
+  for (auto _ : state) {
+    ::benchmark::DoNotOptimize(
+        data.sharded_lookup->RunQuery(request_context, query));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(1) * kSetSize);
+}
+
+void RegisterBenchmarks() {
+  const auto add_trees = [](::benchmark::internal::Benchmark* b) {
+    for (const int64_t num_keys : {2, 8, 64}) {
+      for (const TreeShape shape : {TreeShape::kBalanced, TreeShape::kChain}) {
+        for (const int64_t op : {0, 1}) {
+          b->Args({num_keys, static_cast<int64_t>(shape), op});
+        }
+      }
+    }
+  };
+  add_trees(::benchmark::RegisterBenchmark("BM_Parse", BM_Parse));
+  add_trees(::benchmark::RegisterBenchmark("BM_EvalTree", BM_EvalTree));
+  add_trees(::benchmark::RegisterBenchmark("BM_RunProgram", BM_RunProgram));
+  auto* sharded =
+      ::benchmark::RegisterBenchmark("BM_ShardedRunQuery", BM_ShardedRunQuery);
+  for (const int64_t num_shards : {1, 2, 4}) {
+    for (const int64_t op : {0, 1}) {
+      sharded->Args({num_shards, /*num_keys=*/16, op});
+    }
+  }
+}
+
+}  // namespace
+}  // namespace kv_server
+
+// Benchmarks of the query engine: parsing, evaluating trees and running their
+// compiled programs over trees of different shapes, and whole queries of the
+// sharded lookup against shards served in process. The set operations
+// themselves are benchmarked by `set_operations_benchmark`. Sample run:
+//
+//  bazel run -c opt \
+//    //components/tools/benchmarks:query_benchmark \
+//    --//:instance=local \
+//    --//:platform=local -- \
+//    --benchmark_counters_tabular=true
+int main(int argc, char** argv) {
+  absl::InitializeLog();
+  ::benchmark::Initialize(&argc, argv);
+  kv_server::InitMetricsContextMap();
+  ::kv_server::RegisterBenchmarks();
+  ::benchmark::RunSpecifiedBenchmarks();
+  ::benchmark::Shutdown();
+  return 0;
+}
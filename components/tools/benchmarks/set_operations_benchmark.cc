@@ -0,0 +1,213 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/log/initialize.h"
+#include "absl/strings/str_cat.h"
+#include "benchmark/benchmark.h"
+#include "components/query/id_bitmap.h"
+#include "components/query/sets.h"
+
+namespace kv_server {
+namespace {
+
+// Universe of members that the sets are drawn from.
+constexpr uint32_t kNumMembers = 1 << 20;
+
+const std::vector<std::string>& Members() {
+  static const auto* members = [] {
+    auto* members = new std::vector<std::string>();
+    members->reserve(kNumMembers);
+    for (uint32_t id = 0; id < kNumMembers; ++id) {
+      members->push_back(absl::StrCat("member", id));
+    }
+    return members;
+  }();
+  return *members;
+}
+
+// Random member ids, so that two sets of the benchmark overlap by chance.
+std::vector<uint32_t> RandomIds(int64_t size, uint32_t seed) {
+  std::mt19937 gen(seed);
+  std::uniform_int_distribution<uint32_t> id(0, kNumMembers - 1);
+  std::vector<uint32_t> ids;
+  ids.reserve(size);
+  for (int64_t i = 0; i < size; ++i) {
+    ids.push_back(id(gen));
+  }
+  return ids;
+}
+
+// Two sets of `size` distinct random member ids, `overlap_percent` of the
+// members of each are also in the other.
+std::pair<std::vector<uint32_t>, std::vector<uint32_t>> OverlappingIds(
+    int64_t size, int64_t overlap_percent) {
+  std::vector<uint32_t> ids(kNumMembers);
+  std::iota(ids.begin(), ids.end(), 0);
+  std::shuffle(ids.begin(), ids.end(), std::mt19937(/*seed=*/1));
+  const int64_t offset = size - size * overlap_percent / 100;
+  return {std::vector<uint32_t>(ids.begin(), ids.begin() + size),
+          std::vector<uint32_t>(ids.begin() + offset,
+                                ids.begin() + offset + size)};
+}
+
+absl::flat_hash_set<std::string_view> ToViewSet(
+    const std::vector<uint32_t>& ids) {
+  absl::flat_hash_set<std::string_view> set;
+  for (const uint32_t id : ids) {
+    set.insert(Members()[id]);
+  }
+  return set;
+}
+
+IdBitmap ToBitmap(const std::vector<uint32_t>& ids) {
+  IdBitmap bitmap;
+  for (const uint32_t id : ids) {
+    bitmap.Add(id);
+  }
+  return bitmap;
+}
+
+// The sets are copied in every iteration since the operations consume them,
+// as they do when a query runs.
+template <typename Set>
+void BM_SetOperation(::benchmark::State& state,
+                     Set (*to_set)(const std::vector<uint32_t>&),
+                     Set (*op)(Set, Set)) {
+  const Set left = to_set(RandomIds(state.range(0), /*seed=*/1));
+  const Set right = to_set(RandomIds(state.range(1), /*seed=*/2));
+  for (auto _ : state) {
+    Set left_copy = left;
+    Set right_copy = right;
+    ::benchmark::DoNotOptimize(op(std::move(left_copy), std::move(right_copy)));
+  }
+  state.SetItemsProcessed(state.iterations() *
+                          (state.range(0) + state.range(1)));
+}
+
+// Same as `BM_SetOperation`, over two sets of `state.range(0)` members that
+// overlap by `state.range(1)` percent.
+template <typename Set>
+void BM_OverlappingSetOperation(::benchmark::State& state,
+                                Set (*to_set)(const std::vector<uint32_t>&),
+                                Set (*op)(Set, Set)) {
+  const auto [left_ids, right_ids] =
+      OverlappingIds(state.range(0), state.range(1));
+  const Set left = to_set(left_ids);
+  const Set right = to_set(right_ids);
+  for (auto _ : state) {
+    Set left_copy = left;
+    Set right_copy = right;
+    ::benchmark::DoNotOptimize(op(std::move(left_copy), std::move(right_copy)));
+  }
+  state.SetItemsProcessed(state.iterations() * 2 * state.range(0));
+}
+
+template <typename Set>
+Set UnionOp(Set left, Set right) {
+  return Union(std::move(left), std::move(right));
+}
+template <typename Set>
+Set IntersectionOp(Set left, Set right) {
+  return Intersection(std::move(left), std::move(right));
+}
+template <typename Set>
+Set DifferenceOp(Set left, Set right) {
+  return Difference(std::move(left), std::move(right));
+}
+
+using ViewSet = absl::flat_hash_set<std::string_view>;
+
+void RegisterBenchmarks() {
+  // Sets of the same size, and sets of very different sizes.
+  const std::vector<std::pair<int64_t, int64_t>> sizes = {
+      {1000, 1000}, {100000, 100000}, {100, 100000}, {100000, 100}};
+  const auto add_sizes = [&sizes](::benchmark::internal::Benchmark* b) {
+    for (const auto& [left, right] : sizes) {
+      b->Args({left, right});
+    }
+  };
+  add_sizes(::benchmark::RegisterBenchmark("BM_HashSetUnion",
+                                           BM_SetOperation<ViewSet>, ToViewSet,
+                                           UnionOp<ViewSet>));
+  add_sizes(::benchmark::RegisterBenchmark("BM_IdBitmapUnion",
+                                           BM_SetOperation<IdBitmap>, ToBitmap,
+                                           UnionOp<IdBitmap>));
+  add_sizes(::benchmark::RegisterBenchmark("BM_HashSetIntersection",
+                                           BM_SetOperation<ViewSet>, ToViewSet,
+                                           IntersectionOp<ViewSet>));
+  add_sizes(::benchmark::RegisterBenchmark("BM_IdBitmapIntersection",
+                                           BM_SetOperation<IdBitmap>, ToBitmap,
+                                           IntersectionOp<IdBitmap>));
+  add_sizes(::benchmark::RegisterBenchmark("BM_HashSetDifference",
+                                           BM_SetOperation<ViewSet>, ToViewSet,
+                                           DifferenceOp<ViewSet>));
+  add_sizes(::benchmark::RegisterBenchmark("BM_IdBitmapDifference",
+                                           BM_SetOperation<IdBitmap>, ToBitmap,
+                                           DifferenceOp<IdBitmap>));
+  // Sets of the same size, from disjoint to equal.
+  const auto add_overlaps = [](::benchmark::internal::Benchmark* b) {
+    for (const int64_t overlap_percent : {0, 10, 50, 90, 100}) {
+      b->Args({100000, overlap_percent});
+    }
+  };
+  add_overlaps(::benchmark::RegisterBenchmark(
+      "BM_HashSetUnionOverlap", BM_OverlappingSetOperation<ViewSet>, ToViewSet,
+      UnionOp<ViewSet>));
+  add_overlaps(::benchmark::RegisterBenchmark(
+      "BM_IdBitmapUnionOverlap", BM_OverlappingSetOperation<IdBitmap>,
+      ToBitmap, UnionOp<IdBitmap>));
+  add_overlaps(::benchmark::RegisterBenchmark(
+      "BM_HashSetIntersectionOverlap", BM_OverlappingSetOperation<ViewSet>,
+      ToViewSet, IntersectionOp<ViewSet>));
+  add_overlaps(::benchmark::RegisterBenchmark(
+      "BM_IdBitmapIntersectionOverlap", BM_OverlappingSetOperation<IdBitmap>,
+      ToBitmap, IntersectionOp<IdBitmap>));
+  add_overlaps(::benchmark::RegisterBenchmark(
+      "BM_HashSetDifferenceOverlap", BM_OverlappingSetOperation<ViewSet>,
+      ToViewSet, DifferenceOp<ViewSet>));
+  add_overlaps(::benchmark::RegisterBenchmark(
+      "BM_IdBitmapDifferenceOverlap", BM_OverlappingSetOperation<IdBitmap>,
+      ToBitmap, DifferenceOp<IdBitmap>));
+}
+
+}  // namespace
+}  // namespace kv_server
+
+// Microbenchmarks of the set operations of queries, over hash sets of members
+// and over member id bitmaps. Sample run:
+//
+//  bazel run -c opt \
+//    //components/tools/benchmarks:set_operations_benchmark \
+//    --//:instance=local \
+//    --//:platform=local -- \
+//    --benchmark_counters_tabular=true
+int main(int argc, char** argv) {
+  absl::InitializeLog();
+  ::benchmark::Initialize(&argc, argv);
+  ::kv_server::RegisterBenchmarks();
+  ::benchmark::RunSpecifiedBenchmarks();
+  ::benchmark::Shutdown();
+  return 0;
+}
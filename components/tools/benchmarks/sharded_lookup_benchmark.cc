@@ -0,0 +1,475 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/functional/any_invocable.h"
+#include "absl/log/initialize.h"
+#include "absl/log/log.h"
+#include "absl/random/random.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "benchmark/benchmark.h"
+#include "components/data_server/cache/cache.h"
+#include "components/data_server/cache/key_value_cache.h"
+#include "components/data_server/request_handler/ohttp_client_encryptor.h"
+#include "components/data_server/request_handler/ohttp_server_encryptor.h"
+#include "components/internal_server/local_lookup.h"
+#include "components/internal_server/lookup.h"
+#include "components/internal_server/remote_lookup_client.h"
+#include "components/internal_server/sharded_lookup.h"
+#include "components/internal_server/string_padder.h"
+#include "components/sharding/shard_manager.h"
+#include "components/telemetry/server_definition.h"
+#include "components/util/request_context.h"
+#include "public/sharding/key_sharder.h"
+#include "src/encryption/key_fetcher/fake_key_fetcher_manager.h"
+#include "src/util/status_macro/status_macros.h"
+
+ABSL_FLAG(std::string, shard_latency_distribution, "lognormal",
+          "Distribution of the latencies of the simulated shards: constant, "
+          "exponential or lognormal");
+ABSL_FLAG(absl::Duration, shard_latency_median, absl::Milliseconds(2),
+          "Median latency of a lookup of a simulated shard");
+ABSL_FLAG(double, shard_latency_sigma, 0.5,
+          "Standard deviation of the log of the lognormal latencies");
+ABSL_FLAG(double, shard_straggler_probability, 0,
+          "Probability that a lookup of a simulated shard takes "
+          "--shard_straggler_latency on top of its latency, as when a "
+          "replica pauses");
+ABSL_FLAG(absl::Duration, shard_straggler_latency, absl::Milliseconds(50),
+          "Extra latency of the lookups that straggle");
+ABSL_FLAG(int64_t, value_size, 100,
+          "Size in bytes of the values that the simulated shards return");
+ABSL_FLAG(int32_t, num_replicas, 1, "Number of replicas of each shard");
+ABSL_FLAG(int32_t, hedging_percentile, 0,
+          "Percentile of the shard latencies after which lookups are hedged "
+          "to another replica. 0 disables hedging");
+
+namespace kv_server {
+namespace {
+
+using privacy_sandbox::server_common::FakeKeyFetcherManager;
+
+// Latencies of the lookups of the simulated shards, drawn independently for
+// each lookup.
+class LatencyModel {
+ public:
+  enum class Distribution { kNone, kConstant, kExponential, kLognormal };
+
+  static LatencyModel None() { return LatencyModel(); }
+
+  static absl::StatusOr<LatencyModel> FromFlags() {
+    LatencyModel model;
+    const std::string distribution =
+        absl::GetFlag(FLAGS_shard_latency_distribution);
+    if (distribution == "constant") {
+      model.distribution_ = Distribution::kConstant;
+    } else if (distribution == "exponential") {
+      model.distribution_ = Distribution::kExponential;
+    } else if (distribution == "lognormal") {
+      model.distribution_ = Distribution::kLognormal;
+    } else {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Unknown latency distribution: ", distribution));
+    }
+    model.median_ = absl::GetFlag(FLAGS_shard_latency_median);
+    model.sigma_ = absl::GetFlag(FLAGS_shard_latency_sigma);
+    model.straggler_probability_ =
+        absl::GetFlag(FLAGS_shard_straggler_probability);
+    model.straggler_latency_ = absl::GetFlag(FLAGS_shard_straggler_latency);
+    return model;
+  }
+
+  // Thread-safe.
+  absl::Duration Sample() const {
+    thread_local absl::BitGen bitgen;
+    absl::Duration latency;
+    switch (distribution_) {
+      case Distribution::kNone:
+        return absl::ZeroDuration();
+      case Distribution::kConstant:
+        latency = median_;
+        break;
+      case Distribution::kExponential:
+        // The median of an exponential distribution is its mean times ln 2.
+        latency = median_ / std::log(2.0) * absl::Exponential<double>(bitgen);
+        break;
+      case Distribution::kLognormal:
+        latency = median_ * std::exp(absl::Gaussian<double>(bitgen, 0, sigma_));
+        break;
+    }
+    if (straggler_probability_ > 0 &&
+        absl::Bernoulli(bitgen, straggler_probability_)) {
+      latency += straggler_latency_;
+    }
+    return latency;
+  }
+
+ private:
+  Distribution distribution_ = Distribution::kNone;
+  absl::Duration median_;
+  double sigma_ = 0;
+  double straggler_probability_ = 0;
+  absl::Duration straggler_latency_;
+};
+
+// Calls callbacks once their time comes, on a thread of its own, as gRPC calls
+// back when the responses of remote shards arrive.
+class Delayer {
+ public:
+  Delayer() : thread_([this] { Run(); }) {}
+
+  ~Delayer() {
+    {
+      absl::MutexLock lock(&mutex_);
+      stopping_ = true;
+      cond_var_.Signal();
+    }
+    thread_.join();
+  }
+
+  void RunAt(absl::Time time, absl::AnyInvocable<void() &&> callback)
+      ABSL_LOCKS_EXCLUDED(mutex_) {
+    absl::MutexLock lock(&mutex_);
+    callbacks_.emplace(time, std::move(callback));
+    cond_var_.Signal();
+  }
+
+ private:
+  void Run() ABSL_LOCKS_EXCLUDED(mutex_) {
+    absl::MutexLock lock(&mutex_);
+    while (!stopping_ || !callbacks_.empty()) {
+      if (callbacks_.empty()) {
+        cond_var_.Wait(&mutex_);
+        continue;
+      }
+      const auto next = callbacks_.begin();
+      if (absl::Now() < next->first) {
+        cond_var_.WaitWithDeadline(&mutex_, next->first);
+        continue;
+      }
+      auto callback = std::move(next->second);
+      callbacks_.erase(next);
+      mutex_.Unlock();
+      std::move(callback)();
+      mutex_.Lock();
+    }
+  }
+
+  absl::Mutex mutex_;
+  absl::CondVar cond_var_;
+  bool stopping_ ABSL_GUARDED_BY(mutex_) = false;
+  std::multimap<absl::Time, absl::AnyInvocable<void() &&>> callbacks_
+      ABSL_GUARDED_BY(mutex_);
+  std::thread thread_;
+};
+
+// A replica of a shard, served in process. Each lookup goes through the same
+// padding, serialization and OHTTP encryption of the request and response as
+// a lookup of a remote replica, and is answered after a latency drawn from
+// `latency_model`, with a value of `value` for every key. The OHTTP round trip
+// runs on the calling thread, so only the wait is simulated.
+class SimulatedShardClient : public RemoteLookupClient {
+ public:
+  SimulatedShardClient(std::string ip_address, const std::string& value,
+                       const LatencyModel& latency_model, Delayer& delayer,
+                       FakeKeyFetcherManager& key_fetcher_manager)
+      : ip_address_(std::move(ip_address)),
+        value_(value),
+        latency_model_(latency_model),
+        delayer_(delayer),
+        key_fetcher_manager_(key_fetcher_manager) {}
+
+  absl::StatusOr<InternalLookupResponse> GetValues(
+      const RequestContext& request_context,
+      std::string_view serialized_message,
+      int32_t padding_length) const override {
+    absl::StatusOr<InternalLookupResponse> result;
+    absl::Notification done;
+    GetValuesAsync(request_context, serialized_message, padding_length,
+                   [&result, &done](
+                       absl::StatusOr<InternalLookupResponse> response) {
+                     result = std::move(response);
+                     done.Notify();
+                   });
+    done.WaitForNotification();
+    return result;
+  }
+
+  void GetValuesAsync(
+      const RequestContext& request_context,
+      std::string_view serialized_message, int32_t padding_length,
+      absl::AnyInvocable<void(absl::StatusOr<InternalLookupResponse>) &&>
+          on_done) const override {
+    auto response = RoundTrip(serialized_message, padding_length);
+    const absl::Duration latency = latency_model_.Sample();
+    if (latency <= absl::ZeroDuration()) {
+      std::move(on_done)(std::move(response));
+      return;
+    }
+    delayer_.RunAt(absl::Now() + latency,
+                   [response = std::move(response),
+                    on_done = std::move(on_done)]() mutable {
+                     std::move(on_done)(std::move(response));
+                   });
+  }
+
+  std::string_view GetIpAddress() const override { return ip_address_; }
+
+ private:
+  absl::StatusOr<InternalLookupResponse> RoundTrip(
+      std::string_view serialized_message, int32_t padding_length) const {
+    OhttpClientEncryptor client_encryptor(key_fetcher_manager_);
+    PS_ASSIGN_OR_RETURN(
+        std::string encrypted_request,
+        client_encryptor.EncryptRequest(
+            Pad(serialized_message, padding_length)));
+
+    OhttpServerEncryptor server_encryptor(key_fetcher_manager_);
+    PS_ASSIGN_OR_RETURN(absl::string_view padded_request,
+                        server_encryptor.DecryptRequest(encrypted_request));
+    PS_ASSIGN_OR_RETURN(std::string_view request_string,
+                        Unpad(padded_request));
+    InternalLookupRequest request;
+    if (!request.ParseFromArray(request_string.data(), request_string.size())) {
+      return absl::InvalidArgumentError("Failed to parse the request.");
+    }
+    InternalLookupResponse server_response;
+    for (const auto& key : request.keys()) {
+      (*server_response.mutable_kv_pairs())[key].set_value(value_);
+    }
+    PS_ASSIGN_OR_RETURN(
+        std::string encrypted_response,
+        server_encryptor.EncryptResponse(
+            server_response.SerializeAsString()));
+
+    PS_ASSIGN_OR_RETURN(
+        std::string response_string,
+        client_encryptor.DecryptResponse(std::move(encrypted_response)));
+    InternalLookupResponse response;
+    if (!response.ParseFromString(response_string)) {
+      return absl::InvalidArgumentError("Failed to parse the response.");
+    }
+    return response;
+  }
+
+  const std::string ip_address_;
+  const std::string& value_;
+  const LatencyModel& latency_model_;
+  Delayer& delayer_;
+  FakeKeyFetcherManager& key_fetcher_manager_;
+};
+
+// Thread-safe, since hedges pick their replica on the thread of the delayer.
+class BitGenRandomGenerator : public RandomGenerator {
+ public:
+  int64_t Get(int64_t upper_bound) override {
+    absl::MutexLock lock(&mutex_);
+    return absl::Uniform<int64_t>(bitgen_, 0, upper_bound);
+  }
+
+ private:
+  absl::Mutex mutex_;
+  absl::BitGen bitgen_ ABSL_GUARDED_BY(mutex_);
+};
+
+// `--num_replicas` simulated replicas of each of `num_shards` shards, and the
+// sharded lookup of a server that holds none of them, so that every key is
+// looked up remotely and every lookup fans out to all of the shards.
+struct Cluster {
+  Cluster(int32_t num_shards, LatencyModel model)
+      : value(absl::GetFlag(FLAGS_value_size), 'v'),
+        latency_model(std::move(model)),
+        empty_cache(KeyValueCache::Create()),
+        local_lookup(CreateLocalLookup(*empty_cache)) {
+    std::vector<absl::flat_hash_set<std::string>> cluster_mappings(num_shards);
+    for (int32_t shard_num = 0; shard_num < num_shards; ++shard_num) {
+      for (int32_t replica = 0; replica < absl::GetFlag(FLAGS_num_replicas);
+           ++replica) {
+        cluster_mappings[shard_num].insert(
+            absl::StrCat(shard_num, ".", replica));
+      }
+    }
+    shard_manager = *ShardManager::Create(
+        num_shards, cluster_mappings,
+        std::make_unique<BitGenRandomGenerator>(),
+        [this](const std::string& ip) {
+          return std::make_unique<SimulatedShardClient>(
+              ip, value, latency_model, delayer, key_fetcher_manager);
+        },
+        HedgingOptions{.percentile = absl::GetFlag(FLAGS_hedging_percentile)});
+    sharded_lookup = CreateShardedLookup(
+        *local_lookup, num_shards, kNoLocalShard, *shard_manager,
+        KeySharder(ShardingFunction{/*seed=*/""}));
+  }
+
+  const std::string value;
+  const LatencyModel latency_model;
+  FakeKeyFetcherManager key_fetcher_manager;
+  // Destroyed after the shard manager, whose clients it calls back for.
+  Delayer delayer;
+  std::unique_ptr<Cache> empty_cache;
+  std::unique_ptr<Lookup> local_lookup;
+  std::unique_ptr<ShardManager> shard_manager;
+  std::unique_ptr<Lookup> sharded_lookup;
+};
+
+std::vector<std::string> Keys(int64_t num_keys) {
+  std::vector<std::string> keys;
+  keys.reserve(num_keys);
+  for (int64_t i = 0; i < num_keys; ++i) {
+    keys.push_back(absl::StrCat("key", i));
+  }
+  return keys;
+}
+
+double PercentileInMicros(std::vector<absl::Duration>& latencies,
+                          double percentile) {
+  if (latencies.empty()) {
+    return 0;
+  }
+  const size_t index = std::min(
+      latencies.size() - 1,
+      static_cast<size_t>(percentile / 100 * latencies.size()));
+  std::nth_element(latencies.begin(), latencies.begin() + index,
+                   latencies.end());
+  return absl::ToDoubleMicroseconds(latencies[index]);
+}
+
+// Args: number of shards and number of keys. Looks the keys up over shards
+// that answer at once, so that the time is the overhead of fanning out:
+// sharding the keys, padding and serializing the requests, the OHTTP round
+// trips, the futures and merging the responses.
+void BM_FanoutOverhead(::benchmark::State& state) {
+  Cluster cluster(state.range(0), LatencyModel::None());
+  const std::vector<std::string> key_strings = Keys(state.range(1));
+  const absl::flat_hash_set<std::string_view> keys(key_strings.begin(),
+                                                   key_strings.end());
+  auto scope_metrics_context = std::make_unique<ScopeMetricsContext>();
+  RequestContext request_context(*scope_metrics_context);
+  for (auto _ : state) {
+    auto response = cluster.sharded_lookup->GetKeyValues(request_context, keys);
+    if (!response.ok()) {
+      state.SkipWithError(response.status().ToString());
+      break;
+    }
+    ::benchmark::DoNotOptimize(response);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(1));
+}
+
+// Args: number of shards and number of keys. Looks the keys up over shards
+// whose latencies follow the `--shard_latency_*` flags, and reports the
+// percentiles of the lookup latencies next to the 99th percentile of a single
+// shard's, whose ratio is how much waiting for every shard amplifies the tail.
+void BM_TailLatency(::benchmark::State& state) {
+  auto latency_model = LatencyModel::FromFlags();
+  if (!latency_model.ok()) {
+    state.SkipWithError(latency_model.status().ToString());
+    return;
+  }
+  std::vector<absl::Duration> shard_latencies(100'000);
+  for (auto& latency : shard_latencies) {
+    latency = latency_model->Sample();
+  }
+  const double shard_p99_us = PercentileInMicros(shard_latencies, 99);
+
+  Cluster cluster(state.range(0), *std::move(latency_model));
+  const std::vector<std::string> key_strings = Keys(state.range(1));
+  const absl::flat_hash_set<std::string_view> keys(key_strings.begin(),
+                                                   key_strings.end());
+  auto scope_metrics_context = std::make_unique<ScopeMetricsContext>();
+  RequestContext request_context(*scope_metrics_context);
+  std::vector<absl::Duration> latencies;
+  for (auto _ : state) {
+    const absl::Time start = absl::Now();
+    auto response = cluster.sharded_lookup->GetKeyValues(request_context, keys);
+    latencies.push_back(absl::Now() - start);
+    if (!response.ok()) {
+      state.SkipWithError(response.status().ToString());
+      break;
+    }
+    ::benchmark::DoNotOptimize(response);
+  }
+  const double p99_us = PercentileInMicros(latencies, 99);
+  state.counters["p50_us"] = PercentileInMicros(latencies, 50);
+  state.counters["p99_us"] = p99_us;
+  state.counters["p999_us"] = PercentileInMicros(latencies, 99.9);
+  state.counters["shard_p99_us"] = shard_p99_us;
+  state.counters["p99_amplification"] =
+      shard_p99_us > 0 ? p99_us / shard_p99_us : 0;
+  state.SetItemsProcessed(state.iterations() * state.range(1));
+}
+
+void RegisterBenchmarks() {
+  const auto add_shards = [](::benchmark::internal::Benchmark* b) {
+    for (const int64_t num_shards : {2, 4, 8, 16, 32, 64}) {
+      for (const int64_t num_keys : {16, 256}) {
+        b->Args({num_shards, num_keys});
+      }
+    }
+    b->UseRealTime();
+  };
+  add_shards(
+      ::benchmark::RegisterBenchmark("BM_FanoutOverhead", BM_FanoutOverhead));
+  add_shards(::benchmark::RegisterBenchmark("BM_TailLatency", BM_TailLatency));
+}
+
+}  // namespace
+}  // namespace kv_server
+
+// Benchmarks of the sharded lookup over 2 to 64 shards simulated in process,
+// to judge changes to fanout, batching and hedging without a cluster: the CPU
+// overhead of a lookup that fans out to every shard, and how the tail latency
+// of the lookups grows with the number of shards. Sample run:
+//
+//  bazel run -c opt \
+//    //components/tools/benchmarks:sharded_lookup_benchmark \
+//    --//:instance=local \
+//    --//:platform=local -- \
+//    --benchmark_counters_tabular=true \
+//    --shard_latency_distribution=lognormal \
+//    --shard_latency_median=2ms \
+//    --shard_straggler_probability=0.001
+int main(int argc, char** argv) {
+  absl::InitializeLog();
+  ::benchmark::Initialize(&argc, argv);
+  absl::ParseCommandLine(argc, argv);
+  kv_server::InitMetricsContextMap();
+  ::kv_server::RegisterBenchmarks();
+  ::benchmark::RunSpecifiedBenchmarks();
+  ::benchmark::Shutdown();
+  return 0;
+}
@@ -0,0 +1,135 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/log/initialize.h"
+#include "absl/strings/str_cat.h"
+#include "benchmark/benchmark.h"
+#include "public/sharding/key_sharder.h"
+#include "public/sharding/sharding_function.h"
+
+namespace kv_server {
+namespace {
+
+constexpr int kNumShards = 16;
+constexpr int kNumKeys = 1000;
+
+std::vector<std::string> MakeKeys(int key_size) {
+  std::vector<std::string> keys;
+  keys.reserve(kNumKeys);
+  for (int i = 0; i < kNumKeys; ++i) {
+    std::string key = absl::StrCat("key", i);
+    key.resize(std::max<int>(key_size, key.size()), 'k');
+    keys.push_back(std::move(key));
+  }
+  return keys;
+}
+
+// Args: hash version and size of the keys in bytes.
+void BM_GetShardNumForKey(::benchmark::State& state) {
+  const ShardingFunction sharding_function(
+      /*seed=*/"", static_cast<ShardingHashVersion>(state.range(0)));
+  const std::vector<std::string> keys = MakeKeys(state.range(1));
+  for (auto _ : state) {
+    for (const auto& key : keys) {
+      ::benchmark::DoNotOptimize(
+          sharding_function.GetShardNumForKey(key, kNumShards));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+
+// Args: hash version and size of the keys in bytes.
+void BM_GetShardNumsForKeys(::benchmark::State& state) {
+  const ShardingFunction sharding_function(
+      /*seed=*/"", static_cast<ShardingHashVersion>(state.range(0)));
+  const std::vector<std::string> keys = MakeKeys(state.range(1));
+  const std::vector<std::string_view> key_views(keys.begin(), keys.end());
+  std::vector<int> shard_nums(keys.size());
+  for (auto _ : state) {
+    sharding_function.GetShardNumsForKeys(key_views, kNumShards,
+                                          absl::MakeSpan(shard_nums));
+    ::benchmark::DoNotOptimize(shard_nums.data());
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+
+// Regexes that sharding keys are extracted with, if any.
+constexpr std::string_view kShardKeyRegexes[] = {
+    "",
+    // Extracted without evaluating the regex.
+    "([^_]*)_.*",
+    // Evaluated.
+    "([a-z]*[0-9]*)_.*",
+};
+
+// Args: index of the regex in `kShardKeyRegexes`.
+void BM_KeySharderGetShardNumsForKeys(::benchmark::State& state) {
+  const std::string_view regex = kShardKeyRegexes[state.range(0)];
+  const KeySharder key_sharder(
+      ShardingFunction(/*seed=*/"", ShardingHashVersion::kHighwayHash),
+      regex.empty() ? std::nullopt : std::optional<std::string_view>(regex));
+  std::vector<std::string> keys;
+  keys.reserve(kNumKeys);
+  for (int i = 0; i < kNumKeys; ++i) {
+    keys.push_back(absl::StrCat("key", i, "_suffix", i));
+  }
+  const std::vector<std::string_view> key_views(keys.begin(), keys.end());
+  std::vector<int> shard_nums(keys.size());
+  for (auto _ : state) {
+    key_sharder.GetShardNumsForKeys(key_views, kNumShards,
+                                    absl::MakeSpan(shard_nums));
+    ::benchmark::DoNotOptimize(shard_nums.data());
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+
+BENCHMARK(BM_GetShardNumForKey)
+    ->ArgsProduct({{static_cast<int>(ShardingHashVersion::kSha256),
+                    static_cast<int>(ShardingHashVersion::kHighwayHash)},
+                   {16, 64, 256}});
+BENCHMARK(BM_GetShardNumsForKeys)
+    ->ArgsProduct({{static_cast<int>(ShardingHashVersion::kSha256),
+                    static_cast<int>(ShardingHashVersion::kHighwayHash)},
+                   {16, 64, 256}});
+BENCHMARK(BM_KeySharderGetShardNumsForKeys)->DenseRange(0, 2);
+
+}  // namespace
+}  // namespace kv_server
+
+// Microbenchmarks of the hashes that keys are sharded with, and of the
+// extraction of sharding keys with `sharding-key-regex`, as done for every
+// record while loading data and for every key of a sharded lookup. Sample
+// run:
+//
+//  bazel run -c opt \
+//    //components/tools/benchmarks:sharding_function_benchmark \
+//    --//:instance=local \
+//    --//:platform=local -- \
+//    --benchmark_counters_tabular=true
+int main(int argc, char** argv) {
+  absl::InitializeLog();
+  ::benchmark::Initialize(&argc, argv);
+  ::benchmark::RunSpecifiedBenchmarks();
+  ::benchmark::Shutdown();
+  return 0;
+}
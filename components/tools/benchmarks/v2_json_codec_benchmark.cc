@@ -0,0 +1,181 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/log/initialize.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "benchmark/benchmark.h"
+#include "components/data_server/request_handler/v2_json_codec.h"
+#include "google/protobuf/util/json_util.h"
+#include "public/query/v2/get_values_v2.pb.h"
+
+namespace kv_server {
+namespace {
+
+using google::protobuf::util::JsonStringToMessage;
+using google::protobuf::util::MessageToJsonString;
+
+enum class Codec { kReflection, kFast };
+
+// Returns the JSON of a Protected Audience request of `num_partitions`
+// partitions, one per interest group owner, with `num_keys` keys each, split
+// between interest group names and bidding signals keys.
+std::string CreateRequestJson(int64_t num_partitions, int64_t num_keys) {
+  v2::GetValuesRequest request;
+  (*request.mutable_metadata()->mutable_fields())["hostname"].set_string_value(
+      "publisher.example");
+  for (int64_t i = 0; i < num_partitions; ++i) {
+    v2::RequestPartition& partition = *request.add_partitions();
+    partition.set_id(i);
+    partition.set_compression_group_id(i);
+    for (const std::string_view tag : {"interestGroupNames", "keys"}) {
+      UDFArgument& argument = *partition.add_arguments();
+      argument.mutable_tags()->add_values()->set_string_value(
+          tag == "keys" ? "custom" : "structured");
+      argument.mutable_tags()->add_values()->set_string_value(
+          std::string(tag));
+      auto& keys = *argument.mutable_data()->mutable_list_value();
+      for (int64_t j = 0; j < num_keys / 2; ++j) {
+        keys.add_values()->set_string_value(
+            absl::StrCat("https://owner", i, ".example/", tag, j));
+      }
+    }
+  }
+  std::string json;
+  MessageToJsonString(request, &json).IgnoreError();
+  return json;
+}
+
+// Returns a response of `num_partitions` partitions, each with the
+// `KeyGroupOutputs` JSON a UDF returns for `num_keys` keys of `value_size`
+// byte values.
+v2::GetValuesResponse CreateResponse(int64_t num_partitions, int64_t num_keys,
+                                     int64_t value_size) {
+  std::vector<std::string> key_values;
+  for (int64_t j = 0; j < num_keys; ++j) {
+    key_values.push_back(absl::StrCat(R"("key)", j, R"(":{"value":")",
+                                      std::string(value_size, 'v'), R"("})"));
+  }
+  const std::string output = absl::StrCat(
+      R"({"keyGroupOutputs":[{"tags":["custom","keys"],"keyValues":{)",
+      absl::StrJoin(key_values, ","), "}}]}");
+  v2::GetValuesResponse response;
+  auto& partitions = *response.mutable_compressed_partition_groups();
+  for (int64_t i = 0; i < num_partitions; ++i) {
+    // Stands in for the compressed partition group, which is written as
+    // base64.
+    partitions.add_compressed_partition_groups(output);
+  }
+  return response;
+}
+
+// Args: number of partitions and number of keys per partition.
+void BM_ParseRequest(::benchmark::State& state, Codec codec) {
+  const std::string json = CreateRequestJson(state.range(0), state.range(1));
+  for (auto _ : state) {
+    v2::GetValuesRequest request;
+    const auto status = codec == Codec::kFast
+                            ? ParseGetValuesRequestJson(json, request)
+                            : JsonStringToMessage(json, &request);
+    if (!status.ok()) {
+      state.SkipWithError(status.ToString());
+      return;
+    }
+    ::benchmark::DoNotOptimize(request);
+  }
+  state.SetBytesProcessed(state.iterations() * json.size());
+}
+
+// Args: number of partitions, number of keys per partition, and value size.
+void BM_WriteResponse(::benchmark::State& state, Codec codec) {
+  const v2::GetValuesResponse response =
+      CreateResponse(state.range(0), state.range(1), state.range(2));
+  int64_t bytes = 0;
+  for (auto _ : state) {
+    std::string json;
+    const auto status = codec == Codec::kFast
+                            ? GetValuesResponseToJson(response, json)
+                            : MessageToJsonString(response, &json);
+    if (!status.ok()) {
+      state.SkipWithError(status.ToString());
+      return;
+    }
+    bytes += json.size();
+    ::benchmark::DoNotOptimize(json);
+  }
+  state.SetBytesProcessed(bytes);
+}
+
+// Args: number of keys and value size.
+void BM_WritePartition(::benchmark::State& state, Codec codec) {
+  v2::ResponsePartition partition;
+  partition.set_id(1);
+  partition.set_string_output(
+      CreateResponse(1, state.range(0), state.range(1))
+          .compressed_partition_groups()
+          .compressed_partition_groups(0));
+  int64_t bytes = 0;
+  for (auto _ : state) {
+    std::string json;
+    const auto status = codec == Codec::kFast
+                            ? ResponsePartitionToJson(partition, json)
+                            : MessageToJsonString(partition, &json);
+    if (!status.ok()) {
+      state.SkipWithError(status.ToString());
+      return;
+    }
+    bytes += json.size();
+    ::benchmark::DoNotOptimize(json);
+  }
+  state.SetBytesProcessed(bytes);
+}
+
+BENCHMARK_CAPTURE(BM_ParseRequest, Reflection, Codec::kReflection)
+    ->ArgsProduct({{1, 10}, {10, 100, 1000}});
+BENCHMARK_CAPTURE(BM_ParseRequest, Fast, Codec::kFast)
+    ->ArgsProduct({{1, 10}, {10, 100, 1000}});
+BENCHMARK_CAPTURE(BM_WriteResponse, Reflection, Codec::kReflection)
+    ->ArgsProduct({{1, 10}, {10, 100}, {100, 1000}});
+BENCHMARK_CAPTURE(BM_WriteResponse, Fast, Codec::kFast)
+    ->ArgsProduct({{1, 10}, {10, 100}, {100, 1000}});
+BENCHMARK_CAPTURE(BM_WritePartition, Reflection, Codec::kReflection)
+    ->ArgsProduct({{10, 100}, {100, 1000}});
+BENCHMARK_CAPTURE(BM_WritePartition, Fast, Codec::kFast)
+    ->ArgsProduct({{10, 100}, {100, 1000}});
+
+}  // namespace
+}  // namespace kv_server
+
+// Microbenchmarks of the JSON conversions of v2 requests and responses, by
+// protobuf's reflective JSON utilities and by v2_json_codec.h. The requests
+// have the shape of Protected Audience requests, and the responses carry the
+// `KeyGroupOutputs` JSON of UDFs. Sample run:
+//
+//  bazel run -c opt //components/tools/benchmarks:v2_json_codec_benchmark \
+//    --//:instance=local \
+//    --//:platform=local
+int main(int argc, char** argv) {
+  absl::InitializeLog();
+  ::benchmark::Initialize(&argc, argv);
+  ::benchmark::RunSpecifiedBenchmarks();
+  ::benchmark::Shutdown();
+  return 0;
+}
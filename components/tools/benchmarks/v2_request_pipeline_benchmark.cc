@@ -0,0 +1,457 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/log/initialize.h"
+#include "absl/log/log.h"
+#include "absl/random/random.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "benchmark/benchmark.h"
+#include "components/data_server/cache/cache.h"
+#include "components/data_server/cache/key_value_cache.h"
+#include "components/data_server/request_handler/binary_http_response.h"
+#include "components/data_server/request_handler/compression.h"
+#include "components/data_server/request_handler/get_values_v2_handler.h"
+#include "components/data_server/request_handler/ohttp_client_encryptor.h"
+#include "components/data_server/request_handler/ohttp_server_encryptor.h"
+#include "components/internal_server/local_lookup.h"
+#include "components/telemetry/server_definition.h"
+#include "components/udf/code_config.h"
+#include "components/udf/hooks/get_values_hook.h"
+#include "components/udf/udf_client.h"
+#include "components/udf/udf_config_builder.h"
+#include "components/util/request_context.h"
+#include "google/protobuf/util/json_util.h"
+#include "public/query/v2/get_values_v2.pb.h"
+#include "quiche/binary_http/binary_http_message.h"
+#include "src/encryption/key_fetcher/fake_key_fetcher_manager.h"
+#include "src/util/status_macro/status_macros.h"
+
+ABSL_FLAG(int64_t, num_cached_keys, 100'000,
+          "Number of keys in the cache, that requests pick their keys from");
+ABSL_FLAG(int64_t, value_size, 100, "Size of the cached values in bytes");
+ABSL_FLAG(int, udf_num_workers, 1, "Number of Roma workers");
+
+namespace kv_server {
+namespace {
+
+using google::protobuf::util::JsonStringToMessage;
+using google::protobuf::util::MessageToJsonString;
+using privacy_sandbox::server_common::FakeKeyFetcherManager;
+using CompressionType = CompressionGroupConcatenator::CompressionType;
+
+// Returns the number of its arguments, without looking anything up, so that
+// the UDF stage is mostly the cost of calling into Roma.
+constexpr std::string_view kTrivialUdf = R"(
+function HandleRequest(executionMetadata, ...udf_arguments) {
+  return udf_arguments.length;
+})";
+
+// Looks up all the keys of its arguments at once, as most UDFs do.
+constexpr std::string_view kLookupUdf = R"(
+function HandleRequest(executionMetadata, ...udf_arguments) {
+  const keys = [];
+  for (const argument of udf_arguments) {
+    keys.push(...argument.data);
+  }
+  return JSON.parse(getValues(keys)).kvPairs;
+})";
+
+enum class Udf { kTrivial, kLookup };
+
+enum class ContentType { kJson, kProto };
+
+// The stages of a v2 request through `GetValuesV2Handler::ObliviousGetValues`,
+// in order.
+enum Stage {
+  kOhttpDecrypt,
+  kBhttpParse,
+  kRequestParse,
+  kUdfExecution,
+  kResponseSerialization,
+  kCompression,
+  kBhttpSerialization,
+  kOhttpEncrypt,
+  kNumStages,
+};
+
+constexpr std::string_view kStageNames[kNumStages] = {
+    "ohttp_decrypt_us",   "bhttp_parse_us",   "request_parse_us",
+    "udf_us",             "response_json_us", "compression_us",
+    "bhttp_serialize_us", "ohttp_encrypt_us",
+};
+
+// The in-memory server that the requests are sent to: a cache of
+// `--num_cached_keys` keys, looked up by the UDFs through `getValues`.
+struct Server {
+  std::unique_ptr<Cache> cache;
+  std::unique_ptr<GetValuesHook> get_values_hook;
+  std::unique_ptr<UdfClient> udf_client;
+  FakeKeyFetcherManager key_fetcher_manager;
+  int64_t logical_commit_time = 0;
+  std::optional<Udf> udf;
+};
+
+Server* server = nullptr;
+
+absl::StatusOr<std::unique_ptr<Server>> CreateServer() {
+  auto result = std::make_unique<Server>();
+  result->cache = KeyValueCache::Create();
+  const std::string value(absl::GetFlag(FLAGS_value_size), 'v');
+  for (int64_t i = 0; i < absl::GetFlag(FLAGS_num_cached_keys); ++i) {
+    result->cache->UpdateKeyValue(absl::StrCat("key", i), value,
+                                  /*logical_commit_time=*/1);
+  }
+  result->get_values_hook =
+      GetValuesHook::Create(GetValuesHook::OutputType::kString);
+  result->get_values_hook->FinishInit(CreateLocalLookup(*result->cache));
+  UdfConfigBuilder config_builder;
+  auto udf_client = UdfClient::Create(std::move(
+      config_builder.RegisterStringGetValuesHook(*result->get_values_hook)
+          .SetNumberOfWorkers(absl::GetFlag(FLAGS_udf_num_workers))
+          .Config()));
+  if (!udf_client.ok()) {
+    return udf_client.status();
+  }
+  result->udf_client = *std::move(udf_client);
+  return result;
+}
+
+absl::Status SetUdf(Udf udf) {
+  if (server->udf == udf) {
+    return absl::OkStatus();
+  }
+  server->udf = udf;
+  return server->udf_client->SetCodeObject(CodeConfig{
+      .js = std::string(udf == Udf::kTrivial ? kTrivialUdf : kLookupUdf),
+      .udf_handler_name = "HandleRequest",
+      .logical_commit_time = ++server->logical_commit_time,
+      .version = 1,
+  });
+}
+
+// Each partition has one argument of `keys_per_partition` random keys of the
+// cache, and all of them are in one compression group.
+v2::GetValuesRequest CreateRequest(int64_t num_partitions,
+                                   int64_t keys_per_partition) {
+  absl::BitGen bitgen;
+  const int64_t num_cached_keys = absl::GetFlag(FLAGS_num_cached_keys);
+  v2::GetValuesRequest request;
+  for (int64_t i = 0; i < num_partitions; ++i) {
+    v2::RequestPartition& partition = *request.add_partitions();
+    partition.set_id(i);
+    partition.set_compression_group_id(0);
+    UDFArgument& argument = *partition.add_arguments();
+    argument.mutable_tags()->add_values()->set_string_value("custom");
+    argument.mutable_tags()->add_values()->set_string_value("keys");
+    auto& keys = *argument.mutable_data()->mutable_list_value();
+    for (int64_t j = 0; j < keys_per_partition; ++j) {
+      keys.add_values()->set_string_value(absl::StrCat(
+          "key", absl::Uniform<int64_t>(bitgen, 0, num_cached_keys)));
+    }
+  }
+  return request;
+}
+
+// Returns the OHTTP encapsulated Binary HTTP request, which accepts zstd
+// compressed responses.
+absl::StatusOr<std::string> CreateObliviousRequest(
+    const v2::GetValuesRequest& request, ContentType content_type) {
+  quiche::BinaryHttpRequest bhttp_request({});
+  bhttp_request.AddHeaderField({"accept-encoding", "zstd"});
+  if (content_type == ContentType::kProto) {
+    bhttp_request.AddHeaderField(
+        {std::string(kContentTypeHeader),
+         std::string(kContentEncodingProtoHeaderValue)});
+    bhttp_request.set_body(request.SerializeAsString());
+  } else {
+    std::string json_request;
+    if (const auto status = MessageToJsonString(request, &json_request);
+        !status.ok()) {
+      return status;
+    }
+    bhttp_request.set_body(std::move(json_request));
+  }
+  auto serialized_request = bhttp_request.Serialize();
+  if (!serialized_request.ok()) {
+    return serialized_request.status();
+  }
+  OhttpClientEncryptor client_encryptor(server->key_fetcher_manager);
+  return client_encryptor.EncryptRequest(*std::move(serialized_request));
+}
+
+struct PipelineArgs {
+  Udf udf;
+  ContentType content_type;
+};
+
+// Args: number of partitions and number of keys per partition.
+void BM_ObliviousGetValues(::benchmark::State& state, PipelineArgs args) {
+  if (const auto status = SetUdf(args.udf); !status.ok()) {
+    state.SkipWithError(status.ToString());
+    return;
+  }
+  const auto oblivious_request = CreateObliviousRequest(
+      CreateRequest(state.range(0), state.range(1)), args.content_type);
+  if (!oblivious_request.ok()) {
+    state.SkipWithError(oblivious_request.status().ToString());
+    return;
+  }
+  v2::ObliviousGetValuesRequest request;
+  request.mutable_raw_body()->set_data(*oblivious_request);
+  GetValuesV2Handler handler(*server->udf_client, server->key_fetcher_manager);
+  for (auto _ : state) {
+    google::api::HttpBody response;
+    if (const auto status = handler.ObliviousGetValues(request, &response);
+        !status.ok()) {
+      state.SkipWithError(status.error_message());
+      return;
+    }
+    ::benchmark::DoNotOptimize(response);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0) *
+                          state.range(1));
+}
+
+// Times the stages of a request to `stage_times`, measured around the calls
+// of the handler's dependencies that make up each stage.
+class StageTimer {
+ public:
+  explicit StageTimer(absl::Duration (&stage_times)[kNumStages])
+      : stage_times_(stage_times) {}
+
+  void Start() { stage_start_ = absl::Now(); }
+  void End(Stage stage) { stage_times_[stage] += absl::Now() - stage_start_; }
+
+ private:
+  absl::Duration (&stage_times_)[kNumStages];
+  absl::Time stage_start_;
+};
+
+// Processes `oblivious_request` the same way as `ObliviousGetValues`, except
+// that the partitions are executed one at a time, so that the UDF stage is the
+// sum of their execution times.
+absl::Status ProcessRequestByStage(std::string_view oblivious_request,
+                                   ContentType content_type,
+                                   StageTimer& timer) {
+  timer.Start();
+  OhttpServerEncryptor encryptor(server->key_fetcher_manager);
+  auto bhttp_request = encryptor.DecryptRequest(oblivious_request);
+  timer.End(kOhttpDecrypt);
+  if (!bhttp_request.ok()) {
+    return bhttp_request.status();
+  }
+
+  timer.Start();
+  auto deserialized_request = quiche::BinaryHttpRequest::Create(*bhttp_request);
+  timer.End(kBhttpParse);
+  if (!deserialized_request.ok()) {
+    return deserialized_request.status();
+  }
+
+  timer.Start();
+  v2::GetValuesRequest request;
+  absl::Status status;
+  if (content_type == ContentType::kProto) {
+    if (!request.ParseFromString(deserialized_request->body())) {
+      status = absl::InvalidArgumentError("Cannot parse request");
+    }
+  } else {
+    status = JsonStringToMessage(deserialized_request->body(), &request);
+  }
+  timer.End(kRequestParse);
+  PS_RETURN_IF_ERROR(status);
+
+  timer.Start();
+  auto scope_metrics_context = std::make_unique<ScopeMetricsContext>();
+  RequestContext request_context(*scope_metrics_context);
+  std::vector<v2::ResponsePartition> response_partitions;
+  for (const auto& partition : request.partitions()) {
+    UDFExecutionMetadata udf_metadata;
+    *udf_metadata.mutable_request_metadata() = request.metadata();
+    PS_ASSIGN_OR_RETURN(
+        std::string output,
+        server->udf_client->ExecuteCode(
+            request_context, std::move(udf_metadata), partition.arguments()));
+    response_partitions.emplace_back().set_id(partition.id());
+    response_partitions.back().set_string_output(std::move(output));
+  }
+  timer.End(kUdfExecution);
+
+  v2::GetValuesResponse response;
+  std::vector<quiche::BinaryHttpMessage::Field> header_fields;
+  if (response_partitions.size() == 1) {
+    *response.mutable_single_partition() = std::move(response_partitions[0]);
+  } else {
+    timer.Start();
+    std::vector<std::string> json_partitions;
+    for (const auto& response_partition : response_partitions) {
+      PS_RETURN_IF_ERROR(MessageToJsonString(response_partition,
+                                             &json_partitions.emplace_back()));
+    }
+    std::vector<std::string> compression_groups;
+    compression_groups.push_back(
+        absl::StrCat("[", absl::StrJoin(json_partitions, ","), "]"));
+    timer.End(kResponseSerialization);
+
+    timer.Start();
+    PS_ASSIGN_OR_RETURN(
+        std::vector<std::string> compressed_groups,
+        CompressGroups(std::move(compression_groups), CompressionType::kZstd,
+                       &CompressionGroupConcatenator::Create,
+                       GetValuesV2Handler::kDefaultMaxConcurrentPartitions));
+    timer.End(kCompression);
+    for (auto& compressed_group : compressed_groups) {
+      response.mutable_compressed_partition_groups()
+          ->add_compressed_partition_groups(std::move(compressed_group));
+    }
+    header_fields.push_back({"content-encoding", "zstd"});
+  }
+
+  timer.Start();
+  std::string body;
+  if (content_type == ContentType::kProto) {
+    header_fields.push_back({std::string(kContentTypeHeader),
+                             std::string(kContentEncodingProtoHeaderValue)});
+    body = response.SerializeAsString();
+  } else {
+    PS_RETURN_IF_ERROR(MessageToJsonString(response, &body));
+  }
+  PS_ASSIGN_OR_RETURN(std::string bhttp_response,
+                      SerializeBinaryHttpResponse(
+                          200, header_fields, body.size(), [&body](char* out) {
+                            body.copy(out, body.size());
+                            return true;
+                          }));
+  timer.End(kBhttpSerialization);
+
+  timer.Start();
+  PS_ASSIGN_OR_RETURN(std::string encrypted_response,
+                      encryptor.EncryptResponse(std::move(bhttp_response)));
+  timer.End(kOhttpEncrypt);
+  ::benchmark::DoNotOptimize(encrypted_response);
+  return absl::OkStatus();
+}
+
+// Reports the average time of each stage of the same requests as
+// `BM_ObliviousGetValues`, so that the time of a request can be broken down.
+//
+// Args: number of partitions and number of keys per partition.
+void BM_PipelineStages(::benchmark::State& state, PipelineArgs args) {
+  if (const auto status = SetUdf(args.udf); !status.ok()) {
+    state.SkipWithError(status.ToString());
+    return;
+  }
+  const auto oblivious_request = CreateObliviousRequest(
+      CreateRequest(state.range(0), state.range(1)), args.content_type);
+  if (!oblivious_request.ok()) {
+    state.SkipWithError(oblivious_request.status().ToString());
+    return;
+  }
+  absl::Duration stage_times[kNumStages] = {};
+  StageTimer timer(stage_times);
+  for (auto _ : state) {
+    if (const auto status =
+            ProcessRequestByStage(*oblivious_request, args.content_type, timer);
+        !status.ok()) {
+      state.SkipWithError(status.ToString());
+      break;
+    }
+  }
+  for (int stage = 0; stage < kNumStages; ++stage) {
+    state.counters[std::string(kStageNames[stage])] = ::benchmark::Counter(
+        absl::ToDoubleMicroseconds(stage_times[stage]),
+        ::benchmark::Counter::kAvgIterations);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0) *
+                          state.range(1));
+}
+
+void RegisterBenchmarks() {
+  const auto add_sizes = [](::benchmark::internal::Benchmark* b) {
+    for (const int64_t num_partitions : {1, 10}) {
+      for (const int64_t keys_per_partition : {1, 10, 100}) {
+        b->Args({num_partitions, keys_per_partition});
+      }
+    }
+    b->UseRealTime();
+  };
+  for (const auto& [udf_name, udf] : {std::pair{"Trivial", Udf::kTrivial},
+                                      std::pair{"Lookup", Udf::kLookup}}) {
+    for (const auto& [content_name, content_type] :
+         {std::pair{"Json", ContentType::kJson},
+          std::pair{"Proto", ContentType::kProto}}) {
+      const PipelineArgs args{.udf = udf, .content_type = content_type};
+      add_sizes(::benchmark::RegisterBenchmark(
+          absl::StrCat("BM_ObliviousGetValues", udf_name, content_name)
+              .c_str(),
+          BM_ObliviousGetValues, args));
+      add_sizes(::benchmark::RegisterBenchmark(
+          absl::StrCat("BM_PipelineStages", udf_name, content_name).c_str(),
+          BM_PipelineStages, args));
+    }
+  }
+}
+
+}  // namespace
+}  // namespace kv_server
+
+// Microbenchmarks of v2 requests through `GetValuesV2Handler`, in process:
+// OHTTP decryption, Binary HTTP and request parsing, UDF execution against an
+// in-memory cache, response serialization and compression, and OHTTP
+// encryption. `BM_ObliviousGetValues*` measure whole requests through the
+// handler, and `BM_PipelineStages*` break the time of the same requests down
+// by stage, as counters in microseconds per request. The UDF executions run on
+// Roma, forked before the benchmarks start. Sample run:
+//
+//  bazel run -c opt \
+//    //components/tools/benchmarks:v2_request_pipeline_benchmark \
+//    --//:instance=local \
+//    --//:platform=local -- \
+//    --benchmark_counters_tabular=true
+int main(int argc, char** argv) {
+  absl::InitializeLog();
+  ::benchmark::Initialize(&argc, argv);
+  absl::ParseCommandLine(argc, argv);
+  kv_server::InitMetricsContextMap();
+  auto created_server = kv_server::CreateServer();
+  if (!created_server.ok()) {
+    LOG(ERROR) << "Failed to create the server: " << created_server.status();
+    return 1;
+  }
+  kv_server::server = created_server->get();
+  ::kv_server::RegisterBenchmarks();
+  ::benchmark::RunSpecifiedBenchmarks();
+  ::benchmark::Shutdown();
+  if (const auto status = kv_server::server->udf_client->Stop();
+      !status.ok()) {
+    LOG(ERROR) << "Failed to stop the UDF client: " << status;
+  }
+  return 0;
+}
@@ -14,6 +14,10 @@
 
 #include "components/tools/concurrent_publishing_engine.h"
 
+#include "components/tools/concurrent_publishing_engine.h"
+
+#include <algorithm>
+#include <cmath>
 #include <utility>
 
 namespace kv_server {
@@ -21,10 +25,11 @@ namespace kv_server {
 ConcurrentPublishingEngine::ConcurrentPublishingEngine(
     int insertion_num_threads, NotifierMetadata notifier_metadata,
     int files_insertion_rate, absl::Mutex& queue_mutex,
-    std::queue<RealtimeMessage>& updates_queue)
+    std::queue<RealtimeMessage>& updates_queue, Options options)
     : insertion_num_threads_(insertion_num_threads),
       notifier_metadata_(std::move(notifier_metadata)),
       files_insertion_rate_(files_insertion_rate),
+      options_(std::move(options)),
       mutex_(queue_mutex),
       updates_queue_(updates_queue) {}
 
@@ -44,22 +49,52 @@ void ConcurrentPublishingEngine::Stop() {
   for (auto& publisher_thread : publishers_) {
     publisher_thread->join();
   }
+  const PublishStats stats = GetPublishStats();
+  LOG(INFO) << "Published " << stats.num_messages << " messages in "
+            << stats.num_batches << " batches, " << stats.num_failed_batches
+            << " failed. Publish latency p50 " << stats.p50_latency << " p99 "
+            << stats.p99_latency << " max " << stats.max_latency;
+}
+
+ConcurrentPublishingEngine::PublishStats
+ConcurrentPublishingEngine::GetPublishStats() const {
+  return PublishStats{
+      .num_messages = num_messages_,
+      .num_batches = num_batches_,
+      .num_failed_batches = num_failed_batches_,
+      .p50_latency = LatencyPercentile(0.5),
+      .p99_latency = LatencyPercentile(0.99),
+      .max_latency = absl::Microseconds(max_latency_us_),
+  };
 }
 
 bool ConcurrentPublishingEngine::HasNewMessageToProcess() const {
   return !updates_queue_.empty() || stop_;
 }
 
-std::optional<RealtimeMessage> ConcurrentPublishingEngine::Pop(
+std::vector<RealtimeMessage> ConcurrentPublishingEngine::PopBatch(
     absl::Condition& has_new_event) {
   absl::MutexLock lock(&mutex_, has_new_event);
+  std::vector<RealtimeMessage> batch;
   if (stop_) {
     LOG(INFO) << "Thread for new file processing stopped";
-    return std::nullopt;
+    return batch;
   }
-  auto file_encoded = updates_queue_.front();
-  updates_queue_.pop();
-  return file_encoded;
+  // Popping several messages per lock keeps the publishers from contending
+  // on the queue at high rates.
+  int64_t batch_bytes = 0;
+  while (!updates_queue_.empty() &&
+         static_cast<int>(batch.size()) < options_.max_batch_size) {
+    const int64_t message_bytes = updates_queue_.front().message.size();
+    if (!batch.empty() &&
+        batch_bytes + message_bytes > options_.max_batch_bytes) {
+      break;
+    }
+    batch_bytes += message_bytes;
+    batch.push_back(std::move(updates_queue_.front()));
+    updates_queue_.pop();
+  }
+  return batch;
 }
 
 bool ConcurrentPublishingEngine::ShouldStop() {
@@ -67,10 +102,45 @@ bool ConcurrentPublishingEngine::ShouldStop() {
   return stop_;
 }
 
+void ConcurrentPublishingEngine::RecordPublish(int64_t num_messages,
+                                               absl::Duration latency,
+                                               bool ok) {
+  num_messages_ += num_messages;
+  ++num_batches_;
+  if (!ok) {
+    ++num_failed_batches_;
+  }
+  const int64_t latency_us =
+      std::max<int64_t>(absl::ToInt64Microseconds(latency), 1);
+  const int bucket = std::min(static_cast<int>(std::log2(latency_us)),
+                              kNumLatencyBuckets - 1);
+  ++latency_buckets_[bucket];
+  int64_t max_latency_us = max_latency_us_;
+  while (latency_us > max_latency_us &&
+         !max_latency_us_.compare_exchange_weak(max_latency_us, latency_us)) {
+  }
+}
+
+absl::Duration ConcurrentPublishingEngine::LatencyPercentile(
+    double percentile) const {
+  int64_t count = 0;
+  for (const auto& bucket : latency_buckets_) {
+    count += bucket;
+  }
+  const int64_t rank = std::ceil(count * percentile);
+  int64_t seen = 0;
+  for (int i = 0; i < kNumLatencyBuckets; ++i) {
+    seen += latency_buckets_[i];
+    if (seen >= rank && seen > 0) {
+      return absl::Microseconds(int64_t{1} << (i + 1));
+    }
+  }
+  return absl::ZeroDuration();
+}
+
 void ConcurrentPublishingEngine::ConsumeAndPublish(int thread_idx) {
   const auto start = clock_.Now();
-  int delta_file_index = 1;
-  auto batch_end = clock_.Now() + absl::Seconds(1);
+  int64_t num_published = 0;
   auto maybe_msg_service = PublisherService::Create(notifier_metadata_);
   if (!maybe_msg_service.ok()) {
     LOG(ERROR) << "Failed creating a publisher service";
@@ -79,34 +149,43 @@ void ConcurrentPublishingEngine::ConsumeAndPublish(int thread_idx) {
   auto msg_service = std::move(*maybe_msg_service);
   absl::Condition has_new_event(
       this, &ConcurrentPublishingEngine::HasNewMessageToProcess);
+  const absl::Duration message_interval =
+      files_insertion_rate_ > 0 ? absl::Seconds(1) / files_insertion_rate_
+                                : absl::ZeroDuration();
+  auto next_publish = clock_.Now();
 
   while (!ShouldStop()) {
-    auto message = Pop(has_new_event);
-    if (!message.has_value()) {
-      return;
+    std::vector<RealtimeMessage> batch = PopBatch(has_new_event);
+    if (batch.empty()) {
+      break;
     }
-    VLOG(9) << ": Inserting to the SNS: " << delta_file_index << " Thread idx "
-            << thread_idx;
-    auto status = msg_service->Publish(message->message, message->shard_num);
+    // Paces the messages evenly. A thread that fell behind doesn't burst to
+    // catch up.
+    if (const auto now = clock_.Now(); next_publish > now) {
+      absl::SleepFor(next_publish - now);
+    } else {
+      next_publish = now;
+    }
+    next_publish += message_interval * batch.size();
+    VLOG(9) << ": Inserting to the SNS: " << num_published + 1 << " to "
+            << num_published + batch.size() << " Thread idx " << thread_idx;
+    const auto publish_start = clock_.Now();
+    const absl::Status status =
+        batch.size() == 1
+            ? msg_service->Publish(batch[0].message, batch[0].shard_num)
+            : msg_service->PublishBatch(batch);
+    RecordPublish(batch.size(), clock_.Now() - publish_start, status.ok());
     if (!status.ok()) {
       LOG(ERROR) << status;
     }
-    delta_file_index++;
-    // rate limit to N files per second
-    if (delta_file_index % files_insertion_rate_ == 0) {
-      if (batch_end > clock_.Now()) {
-        absl::SleepFor(batch_end - clock_.Now());
-        LOG(INFO) << ": sleeping " << delta_file_index;
-      }
-      batch_end += absl::Seconds(1);
-    }
+    num_published += batch.size();
   }
 
   int64_t elapsed_seconds = absl::ToInt64Seconds(clock_.Now() - start);
-  LOG(INFO) << "Total inserted: " << delta_file_index << " Seconds elapsed "
+  LOG(INFO) << "Total inserted: " << num_published << " Seconds elapsed "
             << elapsed_seconds << " Thread idx " << thread_idx;
   if (elapsed_seconds > 0) {
-    LOG(INFO) << "Actual rate " << (delta_file_index / elapsed_seconds);
+    LOG(INFO) << "Actual rate " << (num_published / elapsed_seconds);
   }
 }
 
@@ -15,6 +15,9 @@
 #ifndef COMPONENTS_TOOLS_CONCURRENT_PUBLISHING_ENGINE_H_
 #define COMPONENTS_TOOLS_CONCURRENT_PUBLISHING_ENGINE_H_
 
+#include <array>
+#include <atomic>
+#include <cstdint>
 #include <memory>
 #include <queue>
 #include <string>
@@ -22,47 +25,75 @@
 #include <vector>
 
 #include "absl/log/log.h"
+#include "absl/time/time.h"
 #include "components/tools/publisher_service.h"
 #include "src/util/duration.h"
 
 namespace kv_server {
 
-struct RealtimeMessage {
-  std::string message;
-  std::optional<int> shard_num;
-};
-
 // ConcurrentPublishingEngine concurrently reads message of the queue and
 // publishes them to the pubsub/sns specified by `notifier_metadata`.
 class ConcurrentPublishingEngine {
  public:
+  struct Options {
+    // Maximum number of messages popped together, and published with one
+    // batch publish call. 1 publishes the messages one by one.
+    int max_batch_size = 10;
+    // Maximum total size of the messages of a batch. SNS and Pub/Sub both
+    // limit publish requests to 256 KB.
+    int64_t max_batch_bytes = 256 * 1024;
+  };
+
+  struct PublishStats {
+    int64_t num_messages = 0;
+    int64_t num_batches = 0;
+    int64_t num_failed_batches = 0;
+    // Latencies of the publish calls, percentiles are rounded up to a power
+    // of 2 microseconds.
+    absl::Duration p50_latency;
+    absl::Duration p99_latency;
+    absl::Duration max_latency;
+  };
+
   // Create ConcurrentPublishingEngine.
   // `notifier_metadata` specifies the pubsub/sns where the engine will be
   // publishing to.
+  // Each thread publishes `files_insertion_rate` messages per second, paced
+  // evenly, or as fast as it can if it isn't positive.
   // `queue_mutex` and `updates_queue` are not owned by
   // ConcurrentPublishingEngine and must outlive it.
   ConcurrentPublishingEngine(int insertion_num_threads,
                              NotifierMetadata notifier_metadata,
                              int files_insertion_rate, absl::Mutex& queue_mutex,
-                             std::queue<RealtimeMessage>& updates_queue);
+                             std::queue<RealtimeMessage>& updates_queue,
+                             Options options = Options());
   // Starts the publishing engine.
   void Start();
   // Stops the publishing engine.
   void Stop();
 
+  PublishStats GetPublishStats() const;
+
   // ConcurrentPublishingEngine is neither copyable nor movable.
   ConcurrentPublishingEngine(const ConcurrentPublishingEngine&) = delete;
   ConcurrentPublishingEngine& operator=(const ConcurrentPublishingEngine&) =
       delete;
 
  private:
-  std::optional<RealtimeMessage> Pop(absl::Condition& has_new_event);
+  // Bucket `i` counts latencies under 2^(i+1) microseconds.
+  static constexpr int kNumLatencyBuckets = 32;
+
+  // Returns no messages once stopped.
+  std::vector<RealtimeMessage> PopBatch(absl::Condition& has_new_event);
   bool ShouldStop();
   void ConsumeAndPublish(int thread_idx);
+  void RecordPublish(int64_t num_messages, absl::Duration latency, bool ok);
+  absl::Duration LatencyPercentile(double percentile) const;
 
   const int insertion_num_threads_;
   const NotifierMetadata notifier_metadata_;
   const int files_insertion_rate_;
+  const Options options_;
   absl::Mutex& mutex_;
   bool stop_ ABSL_GUARDED_BY(mutex_) = false;
   bool HasNewMessageToProcess() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
@@ -70,6 +101,11 @@ class ConcurrentPublishingEngine {
   std::vector<std::unique_ptr<std::thread>> publishers_;
   privacy_sandbox::server_common::SteadyClock& clock_ =
       privacy_sandbox::server_common::SteadyClock::RealClock();
+  std::atomic<int64_t> num_messages_ = 0;
+  std::atomic<int64_t> num_batches_ = 0;
+  std::atomic<int64_t> num_failed_batches_ = 0;
+  std::atomic<int64_t> max_latency_us_ = 0;
+  std::array<std::atomic<int64_t>, kNumLatencyBuckets> latency_buckets_ = {};
 };
 
 }  // namespace kv_server
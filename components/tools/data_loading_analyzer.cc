@@ -16,6 +16,8 @@
 #include <iostream>
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "absl/flags/flag.h"
 #include "absl/flags/parse.h"
@@ -26,19 +28,36 @@
 #include "components/data_server/cache/cache.h"
 #include "components/data_server/cache/key_value_cache.h"
 #include "components/data_server/data_loading/data_orchestrator.h"
+#include "components/tools/data_loading_profiler.h"
 #include "components/udf/noop_udf_client.h"
 #include "components/util/platform_initializer.h"
 #include "public/base_types.pb.h"
 #include "public/data_loading/data_loading_generated.h"
+#include "public/data_loading/filename_utils.h"
 #include "public/data_loading/readers/riegeli_stream_io.h"
 #include "public/data_loading/readers/riegeli_stream_record_reader_factory.h"
 #include "public/sharding/key_sharder.h"
 
 ABSL_FLAG(std::vector<std::string>, operations,
           std::vector<std::string>({"PASS_THROUGH", "READ_ONLY", "CACHE"}),
-          "operations to test");
+          "operations to test, among PASS_THROUGH, READ_ONLY, CACHE and "
+          "PROFILE");
 ABSL_FLAG(std::string, bucket, "performance-test-data-bucket",
           "Bucket to read files from");
+ABSL_FLAG(std::vector<std::string>, profile_stages, std::vector<std::string>(),
+          "Stages that PROFILE measures, among download, decompress, verify, "
+          "deserialize, shard_filter and apply. The stages before them run "
+          "unmeasured, e.g. 'apply' applies mutations already in memory. "
+          "Empty measures every stage.");
+ABSL_FLAG(std::string, profile_report, "",
+          "File that PROFILE writes its JSON report to. Empty writes it to "
+          "stdout.");
+ABSL_FLAG(int32_t, profile_max_files, 0,
+          "Number of files of the bucket that PROFILE loads. 0 loads all.");
+ABSL_FLAG(int32_t, num_shards, 1,
+          "Number of shards that the shard_filter stage hashes keys into.");
+ABSL_FLAG(int32_t, shard_num, 0,
+          "Shard whose keys the shard_filter stage keeps.");
 
 namespace kv_server {
 namespace {
@@ -54,9 +73,7 @@ class NoopBlobStorageChangeNotifier : public BlobStorageChangeNotifier {
 
 class NoopRealtimeThreadPoolManager : public RealtimeThreadPoolManager {
  public:
-  absl::Status Start(
-      std::function<absl::StatusOr<DataLoadingStats>(const std::string& key)>
-          callback) override {
+  absl::Status Start(RealtimeUpdatesCallback callback) override {
     return absl::OkStatus();
   }
   absl::Status Stop() override { return absl::OkStatus(); }
@@ -119,6 +136,7 @@ enum class Operation {
   kPassThrough = 0,
   kReadOnly,
   kCache,
+  kProfile,
 };
 
 std::vector<Operation> OperationsFromFlag() {
@@ -134,6 +152,9 @@ std::vector<Operation> OperationsFromFlag() {
     if (op == "CACHE") {
       results.push_back(Operation::kCache);
     }
+    if (op == "PROFILE") {
+      results.push_back(Operation::kProfile);
+    }
   }
   return results;
 }
@@ -189,6 +210,71 @@ absl::Status InitOnce(Operation operation) {
   LOG(INFO) << "Init used " << (end_time - start_time);
   return maybe_data_orchestrator.status();
 }
+
+// Loads the files of the bucket stage by stage, and writes the throughput of
+// each stage as JSON.
+absl::Status ProfileOnce() {
+  std::vector<DataLoadingStage> stages;
+  for (const std::string& name : absl::GetFlag(FLAGS_profile_stages)) {
+    const absl::StatusOr<DataLoadingStage> stage = ParseDataLoadingStage(name);
+    if (!stage.ok()) {
+      return stage.status();
+    }
+    stages.push_back(*stage);
+  }
+  InitMetricsContextMap();
+  std::unique_ptr<Cache> cache = KeyValueCache::Create();
+  std::unique_ptr<BlobStorageClientFactory> blob_storage_client_factory =
+      BlobStorageClientFactory::Create();
+  std::unique_ptr<BlobStorageClient> blob_client =
+      blob_storage_client_factory->CreateBlobStorageClient();
+  const std::string bucket = absl::GetFlag(FLAGS_bucket);
+  const absl::StatusOr<std::vector<std::string>> keys =
+      blob_client->ListBlobs({.bucket = bucket}, {});
+  if (!keys.ok()) {
+    return keys.status();
+  }
+  const KeySharder key_sharder(ShardingFunction{/*seed=*/""});
+  DataLoadingProfiler profiler(
+      {
+          .stages = std::move(stages),
+          .num_shards = absl::GetFlag(FLAGS_num_shards),
+          .shard_num = absl::GetFlag(FLAGS_shard_num),
+      },
+      *cache, key_sharder);
+  const int32_t max_files = absl::GetFlag(FLAGS_profile_max_files);
+  int32_t num_files = 0;
+  for (const std::string& key : *keys) {
+    if (!IsDeltaFilename(key) && !IsSnapshotFilename(key)) {
+      continue;
+    }
+    if (max_files > 0 && num_files == max_files) {
+      break;
+    }
+    ++num_files;
+    LOG(INFO) << "Profiling " << key;
+    if (const auto s =
+            profiler.ProfileBlob(*blob_client, {.bucket = bucket, .key = key});
+        !s.ok()) {
+      return s;
+    }
+  }
+  const std::string report = profiler.ToJson();
+  const std::string report_path = absl::GetFlag(FLAGS_profile_report);
+  if (report_path.empty()) {
+    std::cout << report << std::endl;
+    return absl::OkStatus();
+  }
+  std::ofstream report_file(report_path);
+  report_file << report << std::endl;
+  if (!report_file) {
+    return absl::InternalError(
+        absl::StrCat("Failed to write the report to ", report_path));
+  }
+  LOG(INFO) << "Wrote the profile of " << num_files << " files to "
+            << report_path;
+  return absl::OkStatus();
+}
 }  // namespace
 absl::Status Run() {
   kv_server::PlatformInitializer initializer;
@@ -196,7 +282,9 @@ absl::Status Run() {
   const std::vector<Operation> operations = OperationsFromFlag();
   LOG(INFO) << "Performing " << operations.size() << " operations";
   for (const auto op : operations) {
-    if (const auto s = InitOnce(op); !s.ok()) {
+    if (const auto s =
+            op == Operation::kProfile ? ProfileOnce() : InitOnce(op);
+        !s.ok()) {
       return s;
     }
   }
@@ -0,0 +1,371 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/tools/data_loading_profiler.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/types/span.h"
+#include "flatbuffers/flatbuffers.h"
+#include "nlohmann/json.hpp"
+#include "public/data_loading/data_loading_generated.h"
+#include "public/data_loading/records_utils.h"
+#include "riegeli/bytes/string_reader.h"
+#include "riegeli/records/record_reader.h"
+
+namespace kv_server {
+namespace {
+
+constexpr std::array<std::string_view, kNumDataLoadingStages> kStageNames = {
+    "download", "decompress", "verify", "deserialize", "shard_filter", "apply",
+};
+
+constexpr size_t kDownloadChunkSize = 1024 * 1024;
+// Same as the data orchestrator.
+constexpr size_t kMutationBatchSize = 1000;
+// The records are copied into one buffer at offsets aligned like those of
+// `SerializeDataRecords`, for the flatbuffers that they hold.
+constexpr size_t kRecordAlignment = 8;
+
+int Index(DataLoadingStage stage) { return static_cast<int>(stage); }
+
+size_t AlignRecordOffset(size_t offset) {
+  return (offset + kRecordAlignment - 1) / kRecordAlignment * kRecordAlignment;
+}
+
+// The records of a file, copied out of its chunks.
+struct Records {
+  std::string_view Get(size_t i) const {
+    return std::string_view(buffer).substr(spans[i].first, spans[i].second);
+  }
+
+  std::string buffer;
+  // Offset and size of each record in `buffer`.
+  std::vector<std::pair<size_t, size_t>> spans;
+};
+
+int64_t ValueBytes(const KeyValueMutationRecordValueT& value) {
+  if (const auto* string_value = std::get_if<std::string_view>(&value)) {
+    return string_value->size();
+  }
+  if (const auto* set = std::get_if<std::vector<std::string_view>>(&value)) {
+    int64_t bytes = 0;
+    for (std::string_view element : *set) {
+      bytes += element.size();
+    }
+    return bytes;
+  }
+  if (const auto* set = std::get_if<std::vector<uint32_t>>(&value)) {
+    return set->size() * sizeof(uint32_t);
+  }
+  return 0;
+}
+
+// Returns the cache mutation of `record`, which views it, or nothing if its
+// mutation or value type isn't supported.
+std::optional<Cache::Mutation> ToCacheMutation(
+    KeyValueMutationRecordStruct& record) {
+  if (record.mutation_type != KeyValueMutationType::Update &&
+      record.mutation_type != KeyValueMutationType::Delete) {
+    return std::nullopt;
+  }
+  const bool update = record.mutation_type == KeyValueMutationType::Update;
+  Cache::Mutation mutation;
+  mutation.key = record.key;
+  mutation.logical_commit_time = record.logical_commit_time;
+  if (auto* value = std::get_if<std::string_view>(&record.value)) {
+    mutation.type = update ? Cache::Mutation::Type::kUpdateKeyValue
+                           : Cache::Mutation::Type::kDeleteKey;
+    mutation.value = *value;
+  } else if (auto* set =
+                 std::get_if<std::vector<std::string_view>>(&record.value)) {
+    mutation.type = update ? Cache::Mutation::Type::kUpdateKeyValueSet
+                           : Cache::Mutation::Type::kDeleteValuesInSet;
+    mutation.value_set = absl::MakeSpan(*set);
+  } else if (auto* set = std::get_if<std::vector<uint32_t>>(&record.value)) {
+    mutation.type = update ? Cache::Mutation::Type::kUpdateUInt32Set
+                           : Cache::Mutation::Type::kDeleteValuesInUInt32Set;
+    mutation.uint32_value_set = *set;
+  } else {
+    return std::nullopt;
+  }
+  return mutation;
+}
+
+}  // namespace
+
+std::string_view DataLoadingStageName(DataLoadingStage stage) {
+  return kStageNames[Index(stage)];
+}
+
+absl::StatusOr<DataLoadingStage> ParseDataLoadingStage(std::string_view name) {
+  for (int i = 0; i < kNumDataLoadingStages; ++i) {
+    if (kStageNames[i] == name) {
+      return static_cast<DataLoadingStage>(i);
+    }
+  }
+  return absl::InvalidArgumentError(
+      absl::StrCat("Unknown data loading stage: ", name));
+}
+
+DataLoadingProfiler::DataLoadingProfiler(Options options, Cache& cache,
+                                         const KeySharder& key_sharder)
+    : cache_(cache),
+      key_sharder_(key_sharder),
+      num_shards_(options.num_shards),
+      shard_num_(options.shard_num) {
+  if (options.stages.empty()) {
+    profiled_.fill(true);
+    last_stage_ = DataLoadingStage::kApply;
+    return;
+  }
+  for (DataLoadingStage stage : options.stages) {
+    profiled_[Index(stage)] = true;
+    last_stage_ = std::max(last_stage_, stage);
+  }
+}
+
+absl::Status DataLoadingProfiler::ProfileBlob(
+    BlobStorageClient& blob_client,
+    const BlobStorageClient::DataLocation& location) {
+  const absl::Time start = absl::Now();
+  std::unique_ptr<BlobReader> blob_reader = blob_client.GetBlobReader(location);
+  std::istream& stream = blob_reader->Stream();
+  std::string file;
+  while (stream) {
+    const size_t size = file.size();
+    file.resize(size + kDownloadChunkSize);
+    stream.read(file.data() + size, kDownloadChunkSize);
+    file.resize(size + stream.gcount());
+  }
+  if (stream.bad()) {
+    return absl::DataLossError(
+        absl::StrCat("Failed to download ", location.key));
+  }
+  StageProfile& profile = profiles_[Index(DataLoadingStage::kDownload)];
+  profile.duration += absl::Now() - start;
+  profile.bytes += file.size();
+  return Load(std::move(file), location.prefix, /*downloaded=*/true);
+}
+
+absl::Status DataLoadingProfiler::ProfileFile(std::string file,
+                                              std::string_view prefix) {
+  return Load(std::move(file), prefix, /*downloaded=*/false);
+}
+
+absl::Status DataLoadingProfiler::Load(std::string file,
+                                       std::string_view prefix,
+                                       bool downloaded) {
+  ++num_files_;
+  if (!runs(DataLoadingStage::kDecompress)) {
+    return absl::OkStatus();
+  }
+  Records records;
+  {
+    const absl::Time start = absl::Now();
+    riegeli::RecordReader reader{riegeli::StringReader<>(file)};
+    std::string_view raw;
+    while (reader.ReadRecord(raw)) {
+      records.buffer.resize(AlignRecordOffset(records.buffer.size()));
+      records.spans.emplace_back(records.buffer.size(), raw.size());
+      records.buffer.append(raw);
+    }
+    if (!reader.Close()) {
+      return reader.status();
+    }
+    StageProfile& profile = profiles_[Index(DataLoadingStage::kDecompress)];
+    profile.duration += absl::Now() - start;
+    profile.bytes += file.size();
+    profile.records += records.spans.size();
+    if (downloaded) {
+      profiles_[Index(DataLoadingStage::kDownload)].records +=
+          records.spans.size();
+    }
+  }
+  std::string().swap(file);
+  if (!runs(DataLoadingStage::kVerify)) {
+    return absl::OkStatus();
+  }
+  std::vector<bool> verified(records.spans.size());
+  {
+    const absl::Time start = absl::Now();
+    for (size_t i = 0; i < records.spans.size(); ++i) {
+      const std::string_view raw = records.Get(i);
+      flatbuffers::Verifier verifier(
+          reinterpret_cast<const uint8_t*>(raw.data()), raw.size());
+      verified[i] = raw.size() >= sizeof(flatbuffers::uoffset_t) &&
+                    flatbuffers::GetRoot<DataRecord>(raw.data())
+                        ->Verify(verifier);
+    }
+    StageProfile& profile = profiles_[Index(DataLoadingStage::kVerify)];
+    profile.duration += absl::Now() - start;
+    profile.bytes += records.buffer.size();
+    profile.records += records.spans.size();
+    num_invalid_records_ +=
+        std::count(verified.begin(), verified.end(), false);
+  }
+  if (!runs(DataLoadingStage::kDeserialize)) {
+    return absl::OkStatus();
+  }
+  std::vector<KeyValueMutationRecordStruct> mutations;
+  {
+    const absl::Time start = absl::Now();
+    const auto add_mutation = [&mutations](
+                                  const KeyValueMutationRecordStruct& record) {
+      mutations.push_back(record);
+      return absl::OkStatus();
+    };
+    int64_t bytes = 0;
+    int64_t num_records = 0;
+    for (size_t i = 0; i < records.spans.size(); ++i) {
+      if (!verified[i]) {
+        continue;
+      }
+      const std::string_view raw = records.Get(i);
+      bytes += raw.size();
+      ++num_records;
+      // Verified by the previous stage.
+      const absl::Status status = DeserializeDataRecord(
+          raw,
+          [&](const DataRecord& data_record) {
+            if (data_record.record_type() == Record::KeyValueMutationRecord) {
+              return add_mutation(
+                  GetTypedRecordStruct<KeyValueMutationRecordStruct>(
+                      data_record));
+            }
+            if (data_record.record_type() == Record::KeyValueMutationBatch) {
+              return ForEachKeyValueMutation(
+                  *data_record.record_as_KeyValueMutationBatch(),
+                  add_mutation);
+            }
+            return absl::OkStatus();
+          },
+          {.verify = false});
+      if (!status.ok()) {
+        ++num_invalid_records_;
+      }
+    }
+    StageProfile& profile = profiles_[Index(DataLoadingStage::kDeserialize)];
+    profile.duration += absl::Now() - start;
+    profile.bytes += bytes;
+    profile.records += num_records;
+  }
+  if (!runs(DataLoadingStage::kShardFilter)) {
+    return absl::OkStatus();
+  }
+  {
+    const absl::Time start = absl::Now();
+    int64_t bytes = 0;
+    size_t num_kept = 0;
+    for (size_t i = 0; i < mutations.size(); ++i) {
+      bytes += mutations[i].key.size();
+      if (!key_sharder_.IsKeyLoadedByShard(mutations[i].key, num_shards_,
+                                           shard_num_)) {
+        continue;
+      }
+      if (num_kept != i) {
+        mutations[num_kept] = std::move(mutations[i]);
+      }
+      ++num_kept;
+    }
+    StageProfile& profile = profiles_[Index(DataLoadingStage::kShardFilter)];
+    profile.duration += absl::Now() - start;
+    profile.bytes += bytes;
+    profile.records += mutations.size();
+    num_dropped_mutations_ += mutations.size() - num_kept;
+    mutations.resize(num_kept);
+  }
+  if (!runs(DataLoadingStage::kApply)) {
+    return absl::OkStatus();
+  }
+  {
+    const absl::Time start = absl::Now();
+    int64_t bytes = 0;
+    std::vector<Cache::Mutation> batch;
+    batch.reserve(kMutationBatchSize);
+    for (KeyValueMutationRecordStruct& record : mutations) {
+      std::optional<Cache::Mutation> mutation = ToCacheMutation(record);
+      if (!mutation.has_value()) {
+        ++num_invalid_records_;
+        continue;
+      }
+      bytes += record.key.size() + ValueBytes(record.value);
+      batch.push_back(*mutation);
+      if (batch.size() == kMutationBatchSize) {
+        cache_.ApplyMutations(batch, prefix);
+        batch.clear();
+      }
+    }
+    if (!batch.empty()) {
+      cache_.ApplyMutations(batch, prefix);
+    }
+    StageProfile& profile = profiles_[Index(DataLoadingStage::kApply)];
+    profile.duration += absl::Now() - start;
+    profile.bytes += bytes;
+    profile.records += mutations.size();
+  }
+  return absl::OkStatus();
+}
+
+bool DataLoadingProfiler::profiled(DataLoadingStage stage) const {
+  return profiled_[Index(stage)];
+}
+
+const DataLoadingProfiler::StageProfile& DataLoadingProfiler::profile(
+    DataLoadingStage stage) const {
+  return profiles_[Index(stage)];
+}
+
+bool DataLoadingProfiler::runs(DataLoadingStage stage) const {
+  return stage <= last_stage_;
+}
+
+std::string DataLoadingProfiler::ToJson() const {
+  nlohmann::json report;
+  report["num_files"] = num_files_;
+  report["num_invalid_records"] = num_invalid_records_;
+  report["num_dropped_mutations"] = num_dropped_mutations_;
+  report["stages"] = nlohmann::json::array();
+  for (int i = 0; i < kNumDataLoadingStages; ++i) {
+    if (!profiled_[i]) {
+      continue;
+    }
+    const StageProfile& profile = profiles_[i];
+    const double seconds = absl::ToDoubleSeconds(profile.duration);
+    report["stages"].push_back(
+        {{"stage", std::string(kStageNames[i])},
+         {"seconds", seconds},
+         {"bytes", profile.bytes},
+         {"records", profile.records},
+         {"bytes_per_second", seconds > 0 ? profile.bytes / seconds : 0.0},
+         {"records_per_second",
+          seconds > 0 ? profile.records / seconds : 0.0}});
+  }
+  return report.dump(/*indent=*/2);
+}
+
+}  // namespace kv_server
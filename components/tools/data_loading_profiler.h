@@ -0,0 +1,127 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_TOOLS_DATA_LOADING_PROFILER_H_
+#define COMPONENTS_TOOLS_DATA_LOADING_PROFILER_H_
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/time/time.h"
+#include "components/data/blob_storage/blob_storage_client.h"
+#include "components/data_server/cache/cache.h"
+#include "public/sharding/key_sharder.h"
+
+namespace kv_server {
+
+// Stages of loading a file into the cache, in order.
+enum class DataLoadingStage {
+  // Reading the file from blob storage into memory.
+  kDownload = 0,
+  // Reading the records out of the riegeli chunks.
+  kDecompress,
+  // Running the flatbuffers verifier on the records.
+  kVerify,
+  // Validating the records and reading their key-value mutations.
+  kDeserialize,
+  // Hashing the keys to drop those of other shards.
+  kShardFilter,
+  // Applying the mutations to the cache, in batches.
+  kApply,
+};
+
+inline constexpr int kNumDataLoadingStages = 6;
+
+// "download", "decompress", "verify", "deserialize", "shard_filter" or "apply".
+std::string_view DataLoadingStageName(DataLoadingStage stage);
+absl::StatusOr<DataLoadingStage> ParseDataLoadingStage(std::string_view name);
+
+// Replays the loading of files stage by stage, each stage over the output of
+// the previous stage kept in memory, so that the throughput of every stage is
+// measured in isolation. The stages before the profiled ones still run to
+// produce their input, but aren't reported, e.g. profiling only `kApply`
+// measures applying mutations that were already read into memory. The stages
+// after the last profiled one don't run.
+//
+// Not thread-safe.
+class DataLoadingProfiler {
+ public:
+  struct Options {
+    // Stages to measure and report. Empty measures every stage.
+    std::vector<DataLoadingStage> stages;
+    // Shard of the server whose keys `kShardFilter` keeps.
+    int32_t num_shards = 1;
+    int32_t shard_num = 0;
+  };
+
+  struct StageProfile {
+    absl::Duration duration;
+    // Bytes read by the stage: the file bytes for `kDownload` and
+    // `kDecompress`, the record bytes for `kVerify` and `kDeserialize`, the
+    // key bytes for `kShardFilter`, and the key and value bytes for `kApply`.
+    int64_t bytes = 0;
+    // Records read by the stage: the data records up to `kDeserialize`, and
+    // the key-value mutations, which batch records hold many of, after it.
+    int64_t records = 0;
+  };
+
+  DataLoadingProfiler(Options options, Cache& cache,
+                      const KeySharder& key_sharder);
+
+  // Loads the file at `location` into the cache, adding the time that each
+  // stage took to the profile.
+  absl::Status ProfileBlob(BlobStorageClient& blob_client,
+                           const BlobStorageClient::DataLocation& location);
+  // Same as `ProfileBlob`, for a file already in memory, whose mutations are
+  // applied with `prefix`. `kDownload` isn't measured.
+  absl::Status ProfileFile(std::string file, std::string_view prefix = "");
+
+  bool profiled(DataLoadingStage stage) const;
+  const StageProfile& profile(DataLoadingStage stage) const;
+
+  // Returns the profiled stages in order, with their bytes and records per
+  // second, and the counts of files and of invalid and dropped records. Keys
+  // are sorted, so that reports of different builds can be diffed.
+  std::string ToJson() const;
+
+ private:
+  // Runs the stages after `kDownload` over `file`. `downloaded` counts its
+  // records for `kDownload`.
+  absl::Status Load(std::string file, std::string_view prefix,
+                    bool downloaded);
+  // Whether `stage` runs, reported or not.
+  bool runs(DataLoadingStage stage) const;
+
+  Cache& cache_;
+  const KeySharder& key_sharder_;
+  const int32_t num_shards_;
+  const int32_t shard_num_;
+  std::array<bool, kNumDataLoadingStages> profiled_ = {};
+  DataLoadingStage last_stage_ = DataLoadingStage::kDownload;
+  std::array<StageProfile, kNumDataLoadingStages> profiles_;
+  int64_t num_files_ = 0;
+  int64_t num_invalid_records_ = 0;
+  int64_t num_dropped_mutations_ = 0;
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_TOOLS_DATA_LOADING_PROFILER_H_
@@ -74,6 +74,10 @@ void Print(std::string string_decoded) {
         return absl::StrJoin(
             GetRecordValue<std::vector<std::string_view>>(record), ",");
       }
+      if (record.value_type() == Value::UInt32Set) {
+        return absl::StrJoin(
+            GetRecordValue<absl::Span<const uint32_t>>(record), ",");
+      }
       return "";
     };
     std::cout << "key: " << record->key()->string_view() << std::endl;
@@ -18,19 +18,37 @@
 #define COMPONENTS_TOOLS_PUBLISHER_SERVICE_H_
 
 #include <memory>
+#include <optional>
 #include <string>
+#include <vector>
 
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "components/data/common/notifier_metadata.h"
 
 namespace kv_server {
+
+struct RealtimeMessage {
+  std::string message;
+  std::optional<int> shard_num;
+};
+
 class PublisherService {
  public:
   virtual ~PublisherService() = default;
   // Publish a message
   virtual absl::Status Publish(const std::string& message,
                                std::optional<int> shard_num = std::nullopt) = 0;
+  // Publishes `messages` with as few requests as the service allows. Returns
+  // the first error, after trying to publish every message.
+  virtual absl::Status PublishBatch(
+      const std::vector<RealtimeMessage>& messages) {
+    absl::Status result;
+    for (const RealtimeMessage& message : messages) {
+      result.Update(Publish(message.message, message.shard_num));
+    }
+    return result;
+  }
 
   // Calls GetNotifierMetadata and sets queue attributes.
   virtual absl::StatusOr<NotifierMetadata>
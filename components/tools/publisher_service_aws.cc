@@ -12,9 +12,16 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
 #include "absl/flags/flag.h"
 #include "absl/flags/parse.h"
+#include "absl/strings/str_cat.h"
 #include "aws/sns/SNSClient.h"
+#include "aws/sns/model/PublishBatchRequest.h"
 #include "aws/sns/model/PublishRequest.h"
 #include "components/data/common/msg_svc.h"
 #include "components/errors/error_util_aws.h"
@@ -26,6 +33,28 @@ namespace kv_server {
 namespace {
 const char kQueuePrefix[] = "QueueNotifier_";
 
+// Maximum number of messages of an SNS publish batch request.
+constexpr size_t kMaxBatchEntries = 10;
+
+Aws::Map<Aws::String, Aws::SNS::Model::MessageAttributeValue>
+GetMessageAttributes(std::optional<int> shard_num) {
+  Aws::Map<Aws::String, Aws::SNS::Model::MessageAttributeValue> attributes;
+  Aws::SNS::Model::MessageAttributeValue messageAttributeValue;
+  messageAttributeValue.SetDataType("String");
+  std::string nanos_since_epoch =
+      std::to_string(absl::ToUnixNanos(absl::Now()));
+  messageAttributeValue.SetStringValue(nanos_since_epoch);
+  attributes["time_sent"] = messageAttributeValue;
+  if (shard_num.has_value()) {
+    Aws::SNS::Model::MessageAttributeValue shardMessageAttributeValue;
+    shardMessageAttributeValue.SetDataType("String");
+    shardMessageAttributeValue.SetStringValue(
+        std::to_string(shard_num.value()));
+    attributes["shard_num"] = shardMessageAttributeValue;
+  }
+  return attributes;
+}
+
 class AwsPublisherService : public PublisherService {
  public:
   explicit AwsPublisherService(std::string sns_arn)
@@ -35,25 +64,42 @@ class AwsPublisherService : public PublisherService {
     Aws::SNS::Model::PublishRequest req;
     req.SetTopicArn(sns_arn_);
     req.SetMessage(body);
-    Aws::SNS::Model::MessageAttributeValue messageAttributeValue;
-    messageAttributeValue.SetDataType("String");
-    std::string nanos_since_epoch =
-        std::to_string(absl::ToUnixNanos(absl::Now()));
-    messageAttributeValue.SetStringValue(nanos_since_epoch);
-    req.AddMessageAttributes("time_sent", messageAttributeValue);
-    if (shard_num.has_value()) {
-      Aws::SNS::Model::MessageAttributeValue shardMessageAttributeValue;
-      shardMessageAttributeValue.SetDataType("String");
-      shardMessageAttributeValue.SetStringValue(
-          std::to_string(shard_num.value()));
-      req.AddMessageAttributes("shard_num", shardMessageAttributeValue);
-    }
+    req.SetMessageAttributes(GetMessageAttributes(shard_num));
     auto outcome = sns_client_.Publish(req);
     return outcome.IsSuccess()
                ? absl::OkStatus()
                : kv_server::AwsErrorToStatus(outcome.GetError());
   }
 
+  absl::Status PublishBatch(const std::vector<RealtimeMessage>& messages) {
+    absl::Status result;
+    for (size_t begin = 0; begin < messages.size();
+         begin += kMaxBatchEntries) {
+      const size_t end = std::min(messages.size(), begin + kMaxBatchEntries);
+      Aws::SNS::Model::PublishBatchRequest req;
+      req.SetTopicArn(sns_arn_);
+      for (size_t i = begin; i < end; ++i) {
+        Aws::SNS::Model::PublishBatchRequestEntry entry;
+        entry.SetId(std::to_string(i));
+        entry.SetMessage(messages[i].message);
+        entry.SetMessageAttributes(
+            GetMessageAttributes(messages[i].shard_num));
+        req.AddPublishBatchRequestEntries(std::move(entry));
+      }
+      auto outcome = sns_client_.PublishBatch(req);
+      if (!outcome.IsSuccess()) {
+        result.Update(kv_server::AwsErrorToStatus(outcome.GetError()));
+        continue;
+      }
+      for (const auto& failed : outcome.GetResult().GetFailed()) {
+        result.Update(absl::InternalError(
+            absl::StrCat("Failed to publish message ", failed.GetId(), ": ",
+                         failed.GetCode(), " ", failed.GetMessage())));
+      }
+    }
+    return result;
+  }
+
   absl::StatusOr<NotifierMetadata> BuildNotifierMetadataAndSetQueue() {
     auto maybe_notifier_metadata = PublisherService::GetNotifierMetadata();
     if (!maybe_notifier_metadata.ok()) {
@@ -12,6 +12,10 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <string>
+#include <utility>
+#include <vector>
+
 #include "absl/flags/flag.h"
 #include "absl/flags/parse.h"
 #include "components/errors/error_util_gcp.h"
@@ -52,6 +56,32 @@ class GcpPublisherService : public PublisherService {
     return absl::OkStatus();
   }
 
+  // The publisher batches the messages published before their results are
+  // waited for.
+  absl::Status PublishBatch(const std::vector<RealtimeMessage>& messages) {
+    std::vector<future<StatusOr<std::string>>> ids;
+    ids.reserve(messages.size());
+    const std::string nanos_since_epoch =
+        std::to_string(absl::ToUnixNanos(absl::Now()));
+    for (const RealtimeMessage& message : messages) {
+      auto message_builder =
+          pubsub::MessageBuilder{}.SetData(message.message).SetAttribute(
+              "time_sent", nanos_since_epoch);
+      if (message.shard_num.has_value()) {
+        message_builder.SetAttribute("shard_num",
+                                     std::to_string(*message.shard_num));
+      }
+      ids.push_back(publisher_.Publish(std::move(message_builder).Build()));
+    }
+    absl::Status result;
+    for (auto& id : ids) {
+      if (auto published_id = id.get(); !published_id.ok()) {
+        result.Update(GoogleErrorStatusToAbslStatus(published_id.status()));
+      }
+    }
+    return result;
+  }
+
   absl::StatusOr<NotifierMetadata> BuildNotifierMetadataAndSetQueue() {
     auto maybe_notifier_metadata = PublisherService::GetNotifierMetadata();
     if (!maybe_notifier_metadata.ok()) {
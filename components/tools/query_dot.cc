@@ -19,6 +19,7 @@
 #include <vector>
 
 #include "absl/strings/str_join.h"
+#include "absl/time/time.h"
 
 namespace kv_server::query_toy {
 
@@ -83,6 +84,23 @@ std::string ToDotGraphBody(const Node& node, uint32_t* namecnt) {
   return dot_str;
 }
 
+std::string ToDotLabel(const QueryProfile::Step& step, bool measured) {
+  const std::string_view size_prefix = measured ? "" : "<=";
+  std::string label;
+  if (step.op_code == QueryProgram::OpCode::kLoad) {
+    label = absl::StrCat("Value ", step.key, "\\n-> ", size_prefix,
+                         step.output_size);
+  } else {
+    label = absl::StrCat(step.algorithm, "\\n[",
+                         absl::StrJoin(step.input_sizes, ", "), "] -> ",
+                         size_prefix, step.output_size);
+  }
+  if (measured) {
+    absl::StrAppend(&label, "\\n", absl::FormatDuration(step.latency));
+  }
+  return label;
+}
+
 }  // namespace
 
 void QueryDotWriter::WriteAst(std::string_view query, const Node& node) {
@@ -93,5 +111,29 @@ void QueryDotWriter::WriteAst(std::string_view query, const Node& node) {
                         "\n}\n");
 }
 
+void QueryDotWriter::WriteProfile(std::string_view query,
+                                  const QueryProfile& profile) {
+  const std::string title = absl::StrCat(
+      "labelloc=\"t\"\nlabel=\"", profile.measured ? "Profile" : "Plan",
+      " for Query: ", query, ", cost ", profile.Cost(), " members\"\n");
+  std::string body;
+  // The steps whose results are the operands of the next operations.
+  std::vector<size_t> stack;
+  for (size_t i = 0; i < profile.steps.size(); ++i) {
+    const QueryProfile::Step& step = profile.steps[i];
+    absl::StrAppend(&body, "Step", i, " [label=\"",
+                    ToDotLabel(step, profile.measured), "\"]\n");
+    if (step.op_code != QueryProgram::OpCode::kLoad) {
+      const size_t first_operand = stack.size() - step.input_sizes.size();
+      for (size_t j = first_operand; j < stack.size(); ++j) {
+        absl::StrAppend(&body, "Step", i, " -- Step", stack[j], "\n");
+      }
+      stack.resize(first_operand);
+    }
+    stack.push_back(i);
+  }
+  file_ << absl::StrCat("graph {\n", title, body, "\n}\n");
+}
+
 void QueryDotWriter::Flush() { file_.flush(); }
 }  // namespace kv_server::query_toy
@@ -25,6 +25,7 @@
 
 #include "absl/strings/str_join.h"
 #include "components/query/ast.h"
+#include "components/query/query_program.h"
 
 namespace kv_server::query_toy {
 class QueryDotWriter {
@@ -33,6 +34,9 @@ class QueryDotWriter {
   ~QueryDotWriter() { file_.close(); }
   // Outputs the dot representation of the AST node to the output path.
   void WriteAst(const std::string_view query, const Node& node);
+  // Outputs the dot representation of the plan or the profile of the query,
+  // with the sizes, algorithms and latencies of its steps, to the output path.
+  void WriteProfile(std::string_view query, const QueryProfile& profile);
   void Flush();
 
  private:
@@ -17,19 +17,27 @@
 // results in: [a,b,c,d]
 // Alternatively you can run in interactive, allowing to query multiple times.
 // bazel run components/tools:query_toy
+// Queries prefixed with EXPLAIN print their plan, with the sizes of its steps
+// estimated from the sizes of the sets, and queries prefixed with PROFILE are
+// run with the sizes and latencies of their steps measured, ex:
+// >> PROFILE (A | B) & C
 
 #include <signal.h>
 
+#include <cstdint>
 #include <iostream>
+#include <optional>
 #include <sstream>
 #include <string>
 #include <string_view>
+#include <utility>
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/flags/flag.h"
 #include "absl/flags/parse.h"
 #include "absl/flags/usage.h"
+#include "absl/strings/match.h"
 #include "absl/strings/str_join.h"
 #include "components/query/driver.h"
 #include "components/query/scanner.h"
@@ -47,6 +55,16 @@ ABSL_FLAG(
     "Output is written to the provided, which can then be visualized.  See "
     "https://graphviz.org/ for details.");
 
+ABSL_FLAG(bool, explain, false,
+          "Prints the plan of --query, with the sizes of its steps estimated "
+          "from the sizes of the sets, instead of running it.");
+
+ABSL_FLAG(bool, profile, false,
+          "Prints the profile of --query, the sizes and latencies of its "
+          "steps, with its result.");
+
+enum class Mode { kRun, kExplain, kProfile };
+
 absl::flat_hash_map<std::string, absl::flat_hash_set<std::string>> kDb = {
     {"A", {"a", "b", "c"}},
     {"B", {"b", "c", "d"}},
@@ -107,13 +125,69 @@ absl::flat_hash_set<std::string_view> Lookup(std::string_view key) {
   return kEmptySet;
 }
 
-void ProcessQuery(kv_server::Driver& driver, std::string query) {
+// Returns the mode of an interactive query, removing its EXPLAIN or PROFILE
+// prefix.
+Mode StripMode(std::string& query) {
+  for (const auto& [prefix, mode] :
+       {std::pair<std::string_view, Mode>{"EXPLAIN ", Mode::kExplain},
+        std::pair<std::string_view, Mode>{"PROFILE ", Mode::kProfile}}) {
+    if (absl::StartsWithIgnoreCase(query, prefix)) {
+      query.erase(0, prefix.size());
+      return mode;
+    }
+  }
+  return Mode::kRun;
+}
+
+// Returns the plan or the profile of the query, for the other modes.
+std::optional<kv_server::QueryProfile> ProcessQuery(kv_server::Driver& driver,
+                                                    std::string query,
+                                                    Mode mode) {
   const auto result = Parse(driver, query);
   if (!result.ok()) {
     std::cout << result.status() << std::endl;
-    return;
+    return std::nullopt;
+  }
+  kv_server::QueryProfile profile;
+  switch (mode) {
+    case Mode::kRun:
+      std::cout << kv_server::query_toy::ToString(result.value()) << std::endl;
+      return std::nullopt;
+    case Mode::kExplain: {
+      auto plan = driver.Explain([](std::string_view key) -> int64_t {
+        const auto it = kDb.find(key);
+        return it == kDb.end() ? 0 : it->second.size();
+      });
+      if (!plan.ok()) {
+        std::cout << plan.status() << std::endl;
+        return std::nullopt;
+      }
+      profile = *std::move(plan);
+      break;
+    }
+    case Mode::kProfile: {
+      const auto profiled = driver.GetProfiledResult(Lookup, profile);
+      if (!profiled.ok()) {
+        std::cout << profiled.status() << std::endl;
+        return std::nullopt;
+      }
+      std::cout << kv_server::query_toy::ToString(*profiled) << std::endl;
+      break;
+    }
+  }
+  std::cout << profile.ToString();
+  return profile;
+}
+
+// Writes the profile of the query if there is one, or else its AST.
+void WriteDot(kv_server::query_toy::QueryDotWriter& dot_writer,
+              const kv_server::Driver& driver, std::string_view query,
+              const std::optional<kv_server::QueryProfile>& profile) {
+  if (profile.has_value()) {
+    dot_writer.WriteProfile(query, *profile);
+  } else if (driver.GetRootNode()) {
+    dot_writer.WriteAst(query, *driver.GetRootNode());
   }
-  std::cout << kv_server::query_toy::ToString(result.value()) << std::endl;
 }
 
 void PromptForQuery(
@@ -123,9 +197,10 @@ void PromptForQuery(
     std::cout << ">> ";
     std::string query;
     std::getline(std::cin, query);
-    ProcessQuery(driver, query);
-    if (dot_writer && driver.GetRootNode()) {
-      dot_writer->WriteAst(query, *driver.GetRootNode());
+    const Mode mode = StripMode(query);
+    const auto profile = ProcessQuery(driver, query, mode);
+    if (dot_writer) {
+      WriteDot(*dot_writer, driver, query, profile);
       dot_writer->Flush();
     }
   }
@@ -146,9 +221,12 @@ int main(int argc, char* argv[]) {
           ? std::make_optional<kv_server::query_toy::QueryDotWriter>(*dot_path)
           : std::nullopt;
   if (!query.empty()) {
-    ProcessQuery(driver, query);
-    if (dot_writer && driver.GetRootNode()) {
-      dot_writer->WriteAst(query, *driver.GetRootNode());
+    const Mode mode = absl::GetFlag(FLAGS_explain)   ? Mode::kExplain
+                      : absl::GetFlag(FLAGS_profile) ? Mode::kProfile
+                                                     : Mode::kRun;
+    const auto profile = ProcessQuery(driver, query, mode);
+    if (dot_writer) {
+      WriteDot(*dot_writer, driver, query, profile);
     }
     return 0;
   }
@@ -70,6 +70,10 @@ void Print(std::string string_decoded) {
             return absl::StrJoin(
                 GetRecordValue<std::vector<std::string_view>>(record), ",");
           }
+          if (record.value_type() == Value::UInt32Set) {
+            return absl::StrJoin(
+                GetRecordValue<absl::Span<const uint32_t>>(record), ",");
+          }
           return "";
         };
         LOG(INFO) << "key: " << record->key()->string_view();
@@ -109,8 +113,10 @@ absl::Status Run() {
     return realtime_notifier_maybe.status();
   }
   auto realtime_notifier = std::move(*realtime_notifier_maybe);
-  realtime_notifier->Start([](const std::string& message) {
-    Print(message);
+  realtime_notifier->Start([](absl::Span<const std::string> messages) {
+    for (const std::string& message : messages) {
+      Print(message);
+    }
     DataLoadingStats stats;
     return stats;
   });
@@ -32,6 +32,9 @@ ABSL_FLAG(std::string, deltas_folder_path, "",
           "Path to the folder with delta files");
 ABSL_FLAG(int, insertion_num_threads, 1,
           "The amount of threads writing to SNS in parallel");
+ABSL_FLAG(int, publish_batch_size, 1,
+          "The maximum number of delta files published in one batch publish "
+          "request, up to 256 KB.");
 
 namespace kv_server {
 namespace {
@@ -71,7 +74,8 @@ absl::Status Run() {
   int files_insertion_rate = 15;
   auto publishing_engine = ConcurrentPublishingEngine(
       insertion_num_threads, std::move(*maybe_notifier_metadata),
-      files_insertion_rate, mutex, updates_queue);
+      files_insertion_rate, mutex, updates_queue,
+      {.max_batch_size = absl::GetFlag(FLAGS_publish_batch_size)});
   publishing_engine.Start();
   while (!updates_queue.empty()) {
     LOG(INFO) << "Waiting on consumers";
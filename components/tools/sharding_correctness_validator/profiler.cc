@@ -0,0 +1,392 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <iostream>
+#include <optional>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/log/flags.h"
+#include "absl/log/initialize.h"
+#include "absl/log/log.h"
+#include "absl/random/random.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "public/applications/pa/response_utils.h"
+#include "public/query/cpp/grpc_client.h"
+#include "public/sharding/key_sharder.h"
+
+ABSL_FLAG(std::string, kv_endpoint, "<ip>:50051", "KV grpc endpoint");
+ABSL_FLAG(bool, use_tls, false, "Whether to use TLS for grpc calls.");
+ABSL_FLAG(std::string, key_prefix, "foo", "Key prefix");
+ABSL_FLAG(int, inclusive_upper_bound, 999999999, "Inclusive upper bound");
+ABSL_FLAG(int, batch_size, 10, "Keys per request");
+ABSL_FLAG(bool, random_keys, false,
+          "Whether the keys of a request are picked at random, rather than "
+          "being a run of consecutive keys.");
+ABSL_FLAG(int, qps, 5, "Requests per second, over all the threads");
+ABSL_FLAG(int, concurrency, 1, "Threads sending requests");
+ABSL_FLAG(int, number_of_requests_to_make, 100, "Number of requests to make");
+ABSL_FLAG(int, num_shards, 2, "Number of shards of the cluster");
+ABSL_FLAG(std::string, sharding_key_regex, "",
+          "The sharding-key-regex of the cluster. Empty if it isn't used.");
+ABSL_FLAG(int32_t, sharding_hash_version, 0,
+          "The sharding-hash-version of the cluster.");
+ABSL_FLAG(bool, dry_run, false,
+          "Only shards the keys of the requests, without sending them, to "
+          "compare sharding choices before a cluster exists.");
+ABSL_FLAG(double, hot_shard_factor, 1.5,
+          "Shards with more than this many times the mean keys, bytes or "
+          "lookups are flagged as hot.");
+
+namespace kv_server {
+namespace {
+
+struct ShardStats {
+  int64_t num_keys = 0;
+  // Bytes of the values returned for the keys of the shard.
+  int64_t value_bytes = 0;
+  // Requests with at least one key of the shard.
+  int64_t num_lookups = 0;
+  // Latencies of the requests with at least one key of the shard. A client
+  // only sees whole requests, so a slow shard shows up as slower requests
+  // among those that look it up.
+  std::vector<absl::Duration> latencies;
+};
+
+struct Profile {
+  absl::Mutex mutex;
+  std::vector<ShardStats> shards ABSL_GUARDED_BY(mutex);
+  std::vector<absl::Duration> latencies ABSL_GUARDED_BY(mutex);
+  int64_t num_requests ABSL_GUARDED_BY(mutex) = 0;
+  int64_t num_failures ABSL_GUARDED_BY(mutex) = 0;
+  // Sum over the requests of the number of shards their keys belong to.
+  int64_t num_request_shards ABSL_GUARDED_BY(mutex) = 0;
+  int64_t num_single_shard_requests ABSL_GUARDED_BY(mutex) = 0;
+};
+
+v2::GetValuesRequest GetRequest(const std::vector<std::string>& keys) {
+  v2::GetValuesRequest req;
+  v2::RequestPartition* partition = req.add_partitions();
+  auto* udf_argument = partition->add_arguments();
+  auto* values = udf_argument->mutable_data()->mutable_list_value();
+  for (const auto& key : keys) {
+    values->add_values()->set_string_value(key);
+  }
+  udf_argument->mutable_tags()->add_values()->set_string_value("keys");
+  udf_argument->mutable_tags()->add_values()->set_string_value("custom");
+  return req;
+}
+
+std::vector<std::string> GetKeys(absl::BitGen& bitgen) {
+  const std::string key_prefix = absl::GetFlag(FLAGS_key_prefix);
+  const int upper_bound = absl::GetFlag(FLAGS_inclusive_upper_bound);
+  const int batch_size = absl::GetFlag(FLAGS_batch_size);
+  std::vector<std::string> keys;
+  keys.reserve(batch_size);
+  if (absl::GetFlag(FLAGS_random_keys)) {
+    for (int i = 0; i < batch_size; ++i) {
+      keys.push_back(absl::StrCat(
+          key_prefix, absl::Uniform(absl::IntervalClosed, bitgen, 0,
+                                    upper_bound)));
+    }
+    return keys;
+  }
+  const int start = absl::Uniform(bitgen, 0, upper_bound / batch_size + 1) *
+                    batch_size;
+  for (int i = start; i < start + batch_size; ++i) {
+    keys.push_back(absl::StrCat(key_prefix, i));
+  }
+  return keys;
+}
+
+// Returns the bytes of the value of each key in `response`.
+absl::StatusOr<absl::flat_hash_map<std::string, int64_t>> GetValueBytes(
+    const v2::GetValuesResponse& response) {
+  auto outputs = application_pa::KeyGroupOutputsFromJson(
+      response.single_partition().string_output());
+  if (!outputs.ok()) {
+    return outputs.status();
+  }
+  absl::flat_hash_map<std::string, int64_t> value_bytes;
+  for (const auto& key_group_output : outputs->key_group_outputs()) {
+    for (const auto& [key, value] : key_group_output.key_values()) {
+      value_bytes[key] += value.value().ByteSizeLong();
+    }
+  }
+  return value_bytes;
+}
+
+void RecordRequest(const std::vector<std::string>& keys,
+                   const std::vector<int>& shard_nums,
+                   std::optional<absl::Duration> latency,
+                   const absl::flat_hash_map<std::string, int64_t>& value_bytes,
+                   Profile& profile) {
+  absl::MutexLock lock(&profile.mutex);
+  ++profile.num_requests;
+  std::vector<bool> looked_up(profile.shards.size());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    ShardStats& shard = profile.shards[shard_nums[i]];
+    ++shard.num_keys;
+    if (const auto it = value_bytes.find(keys[i]); it != value_bytes.end()) {
+      shard.value_bytes += it->second;
+    }
+    looked_up[shard_nums[i]] = true;
+  }
+  const int num_request_shards =
+      std::count(looked_up.begin(), looked_up.end(), true);
+  profile.num_request_shards += num_request_shards;
+  if (num_request_shards == 1) {
+    ++profile.num_single_shard_requests;
+  }
+  for (size_t shard_num = 0; shard_num < looked_up.size(); ++shard_num) {
+    if (!looked_up[shard_num]) {
+      continue;
+    }
+    ++profile.shards[shard_num].num_lookups;
+    if (latency.has_value()) {
+      profile.shards[shard_num].latencies.push_back(*latency);
+    }
+  }
+  if (latency.has_value()) {
+    profile.latencies.push_back(*latency);
+  }
+}
+
+void RecordFailure(const absl::Status& status, Profile& profile) {
+  LOG(ERROR) << status;
+  absl::MutexLock lock(&profile.mutex);
+  ++profile.num_failures;
+}
+
+// Sends `num_requests` requests at `qps`, or only shards their keys in a dry
+// run.
+void SendRequests(int num_requests, double qps, const KeySharder& key_sharder,
+                  Profile& profile) {
+  const bool dry_run = absl::GetFlag(FLAGS_dry_run);
+  const int num_shards = absl::GetFlag(FLAGS_num_shards);
+  std::unique_ptr<v2::KeyValueService::Stub> stub;
+  std::unique_ptr<GrpcClient> client;
+  if (!dry_run) {
+    const std::string kv_endpoint = absl::GetFlag(FLAGS_kv_endpoint);
+    stub = GrpcClient::CreateStub(
+        kv_endpoint,
+        absl::GetFlag(FLAGS_use_tls)
+            ? grpc::SslCredentials(grpc::SslCredentialsOptions())
+            : grpc::InsecureChannelCredentials());
+    client = std::make_unique<GrpcClient>(*stub);
+  }
+  absl::BitGen bitgen;
+  const absl::Duration interval = absl::Seconds(1) / qps;
+  absl::Time next_send = absl::Now();
+  for (int i = 0; i < num_requests; ++i) {
+    const std::vector<std::string> keys = GetKeys(bitgen);
+    const std::vector<std::string_view> key_views(keys.begin(), keys.end());
+    std::vector<int> shard_nums(keys.size());
+    key_sharder.GetShardNumsForKeys(key_views, num_shards,
+                                    absl::MakeSpan(shard_nums));
+    if (dry_run) {
+      RecordRequest(keys, shard_nums, std::nullopt, {}, profile);
+      continue;
+    }
+    if (const absl::Time now = absl::Now(); next_send > now) {
+      absl::SleepFor(next_send - now);
+    }
+    next_send += interval;
+    const absl::Time start = absl::Now();
+    const absl::StatusOr<v2::GetValuesResponse> response =
+        client->GetValues(GetRequest(keys));
+    const absl::Duration latency = absl::Now() - start;
+    if (!response.ok()) {
+      RecordFailure(response.status(), profile);
+      continue;
+    }
+    const auto value_bytes = GetValueBytes(*response);
+    if (!value_bytes.ok()) {
+      RecordFailure(value_bytes.status(), profile);
+      continue;
+    }
+    RecordRequest(keys, shard_nums, latency, *value_bytes, profile);
+  }
+}
+
+absl::Duration Percentile(std::vector<absl::Duration>& latencies,
+                          double percentile) {
+  if (latencies.empty()) {
+    return absl::ZeroDuration();
+  }
+  const size_t index = std::min(
+      latencies.size() - 1,
+      static_cast<size_t>(percentile / 100 * latencies.size()));
+  std::nth_element(latencies.begin(), latencies.begin() + index,
+                   latencies.end());
+  return latencies[index];
+}
+
+std::string LatencySummary(std::vector<absl::Duration>& latencies) {
+  return absl::StrFormat(
+      "p50 %.1fms p90 %.1fms p99 %.1fms",
+      absl::ToDoubleMilliseconds(Percentile(latencies, 50)),
+      absl::ToDoubleMilliseconds(Percentile(latencies, 90)),
+      absl::ToDoubleMilliseconds(Percentile(latencies, 99)));
+}
+
+// Prints the load of each shard, and flags the shards whose keys, value bytes
+// or lookups are over `hot_shard_factor` times the mean. Returns the number
+// of hot shards.
+int Report(Profile& profile, absl::Duration elapsed) {
+  absl::MutexLock lock(&profile.mutex);
+  const int num_shards = profile.shards.size();
+  const double seconds = std::max(absl::ToDoubleSeconds(elapsed), 1e-9);
+  const double hot_shard_factor = absl::GetFlag(FLAGS_hot_shard_factor);
+  int64_t total_keys = 0;
+  int64_t total_bytes = 0;
+  int64_t total_lookups = 0;
+  for (const ShardStats& shard : profile.shards) {
+    total_keys += shard.num_keys;
+    total_bytes += shard.value_bytes;
+    total_lookups += shard.num_lookups;
+  }
+  const double mean_shards_per_request =
+      profile.num_requests > 0
+          ? static_cast<double>(profile.num_request_shards) /
+                profile.num_requests
+          : 0;
+  std::cout << absl::StrFormat(
+      "Requests: %d, failed: %d, %.1f qps\n", profile.num_requests,
+      profile.num_failures, profile.num_requests / seconds);
+  if (!profile.latencies.empty()) {
+    std::cout << "Latency: " << LatencySummary(profile.latencies) << "\n";
+  }
+  // The server that receives a request looks up the keys of the other shards
+  // from them. Without shard routing, it belongs to any shard alike.
+  std::cout << absl::StrFormat(
+      "Shards per request: %.2f, single shard requests: %.1f%%, estimated "
+      "remote shard lookups per request: %.2f\n",
+      mean_shards_per_request,
+      profile.num_requests > 0
+          ? 100.0 * profile.num_single_shard_requests / profile.num_requests
+          : 0,
+      mean_shards_per_request * (1 - 1.0 / num_shards));
+  int num_hot_shards = 0;
+  for (int shard_num = 0; shard_num < num_shards; ++shard_num) {
+    ShardStats& shard = profile.shards[shard_num];
+    const auto is_hot = [num_shards, hot_shard_factor](int64_t value,
+                                                      int64_t total) {
+      return total > 0 && value > hot_shard_factor * total / num_shards;
+    };
+    const bool hot = is_hot(shard.num_keys, total_keys) ||
+                     is_hot(shard.value_bytes, total_bytes) ||
+                     is_hot(shard.num_lookups, total_lookups);
+    num_hot_shards += hot;
+    std::cout << absl::StrFormat(
+        "Shard %d: keys %d (%.1f%%), value bytes %d, %.1f lookups/s%s%s\n",
+        shard_num, shard.num_keys,
+        total_keys > 0 ? 100.0 * shard.num_keys / total_keys : 0,
+        shard.value_bytes, shard.num_lookups / seconds,
+        shard.latencies.empty()
+            ? ""
+            : absl::StrCat(", ", LatencySummary(shard.latencies)),
+        hot ? " HOT" : "");
+  }
+  return num_hot_shards;
+}
+
+absl::StatusOr<KeySharder> CreateKeySharder() {
+  auto hash_version =
+      ToShardingHashVersion(absl::GetFlag(FLAGS_sharding_hash_version));
+  if (!hash_version.ok()) {
+    return hash_version.status();
+  }
+  ShardingFunction func(/*seed=*/"", *hash_version);
+  const std::string sharding_key_regex =
+      absl::GetFlag(FLAGS_sharding_key_regex);
+  if (sharding_key_regex.empty()) {
+    return KeySharder(func);
+  }
+  try {
+    return KeySharder(func, sharding_key_regex);
+  } catch (const std::regex_error& e) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Invalid sharding key regex: ", e.what()));
+  }
+}
+
+}  // namespace
+}  // namespace kv_server
+
+// This tool sends requests like the validator's to the specified
+// _kv_endpoint_, and reports the keys, value bytes, lookup rate and latency of
+// each shard, computing the shard of each key like the servers do from
+// _num_shards_, _sharding_key_regex_ and _sharding_hash_version_. Shards with
+// more than _hot_shard_factor_ times the mean load are flagged as hot, and
+// the number of shards per request estimates the fanout cost of the
+// requests. With _dry_run_, only the keys are sharded, to compare sharding
+// key regexes and shard counts before a cluster runs them.
+// Sample command:
+// bazel run //components/tools/sharding_correctness_validator:profiler --
+// --qps=50 --concurrency=4 --number_of_requests_to_make=3000 --batch_size=20
+// --num_shards=4 --sharding_key_regex='(.{4}).*' --kv_endpoint=<your_ip>:50051
+
+int main(int argc, char** argv) {
+  const std::vector<char*> commands = absl::ParseCommandLine(argc, argv);
+  absl::InitializeLog();
+  const int num_shards = absl::GetFlag(FLAGS_num_shards);
+  const int concurrency = std::max(absl::GetFlag(FLAGS_concurrency), 1);
+  const int num_requests = absl::GetFlag(FLAGS_number_of_requests_to_make);
+  const double qps = std::max(absl::GetFlag(FLAGS_qps), 1);
+  if (num_shards < 1) {
+    LOG(ERROR) << "num_shards must be positive";
+    return 1;
+  }
+  const auto key_sharder = kv_server::CreateKeySharder();
+  if (!key_sharder.ok()) {
+    LOG(ERROR) << key_sharder.status();
+    return 1;
+  }
+  kv_server::Profile profile;
+  {
+    absl::MutexLock lock(&profile.mutex);
+    profile.shards.resize(num_shards);
+  }
+  const absl::Time start = absl::Now();
+  std::vector<std::thread> threads;
+  for (int i = 0; i < concurrency; ++i) {
+    // Spreads the requests, and the rate, over the threads.
+    const int thread_requests =
+        num_requests / concurrency + (i < num_requests % concurrency ? 1 : 0);
+    threads.emplace_back([thread_requests, qps, concurrency, &key_sharder,
+                          &profile] {
+      kv_server::SendRequests(thread_requests, qps / concurrency, *key_sharder,
+                              profile);
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  const int num_hot_shards = kv_server::Report(profile, absl::Now() - start);
+  LOG_IF(WARNING, num_hot_shards > 0) << num_hot_shards << " hot shards";
+  absl::MutexLock lock(&profile.mutex);
+  return profile.num_failures > 0 ? 1 : 0;
+}
@@ -20,7 +20,9 @@ bool operator==(const CodeConfig& lhs_config, const CodeConfig& rhs_config) {
   return lhs_config.logical_commit_time == rhs_config.logical_commit_time &&
          lhs_config.version == rhs_config.version &&
          lhs_config.udf_handler_name == rhs_config.udf_handler_name &&
-         lhs_config.js == rhs_config.js && lhs_config.wasm == rhs_config.wasm;
+         lhs_config.js == rhs_config.js && lhs_config.wasm == rhs_config.wasm &&
+         lhs_config.argument_format == rhs_config.argument_format &&
+         lhs_config.cache_outputs == rhs_config.cache_outputs;
 }
 
 bool operator!=(const CodeConfig& lhs_config, const CodeConfig& rhs_config) {
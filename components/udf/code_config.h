@@ -30,6 +30,15 @@ struct CodeConfig {
   std::string udf_handler_name;
   int64_t logical_commit_time;
   int64_t version;
+  // How the arguments of a request are passed to the handler: as the JSON of
+  // each `UDFArgument`, or as a base64 string of a serialized
+  // `BinaryUdfArgument` each, which skips the JSON conversion of their keys.
+  // The execution metadata is passed as JSON either way.
+  enum class ArgumentFormat { kJson = 0, kSerializedProto };
+  ArgumentFormat argument_format = ArgumentFormat::kJson;
+  // Whether the output of the handler only depends on its input and the data
+  // of the server, so that outputs can be cached until the data changes.
+  bool cache_outputs = false;
 };
 
 bool operator==(const CodeConfig& lhs_config, const CodeConfig& rhs_config);
@@ -14,32 +14,47 @@
 
 #include "components/udf/hooks/get_values_hook.h"
 
+#include <cstdint>
+#include <cstring>
 #include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <tuple>
 #include <utility>
 #include <vector>
 
+#include "absl/base/config.h"
 #include "absl/functional/any_invocable.h"
 #include "absl/log/log.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/str_join.h"
 #include "components/data_server/cache/cache.h"
 #include "components/internal_server/local_lookup.h"
 #include "components/internal_server/lookup.pb.h"
 #include "components/telemetry/server_definition.h"
+#include "components/util/request_tracing.h"
+#include "google/protobuf/io/coded_stream.h"
 #include "google/protobuf/util/json_util.h"
+#include "google/protobuf/wire_format_lite.h"
 #include "nlohmann/json.hpp"
 #include "public/udf/binary_get_values.pb.h"
+#include "public/udf/flat_get_values.h"
 
 namespace kv_server {
 namespace {
 
+using google::protobuf::internal::WireFormatLite;
+using google::protobuf::io::CodedOutputStream;
 using google::protobuf::json::MessageToJsonString;
 using google::scp::roma::FunctionBindingPayload;
 using google::scp::roma::proto::FunctionBindingIoProto;
 
 constexpr char kOkStatusMessage[] = "ok";
+// Largest number of keys that one `getValuesByPrefix` call can look up.
+constexpr int kMaxPrefixLookupLimit = 10000;
+constexpr char kOkStatusJson[] = R"("status":{"code":0,"message":"ok"})";
 
 void SetBinaryGetValuesAsBytes(const BinaryGetValuesResponse& binary_response,
                                FunctionBindingIoProto& io) {
@@ -90,31 +105,392 @@ void SetStatusAsString(absl::StatusCode code, std::string_view message,
   io.set_output_string(status.dump());
 }
 
+// Writes the JSON output of one `getValues` call to `output`.
+absl::Status WriteOutputJson(const InternalLookupResponse& response,
+                             std::string& output) {
+  if (const auto json_status = MessageToJsonString(response, &output);
+      !json_status.ok()) {
+    LOG(ERROR) << "MessageToJsonString failed with " << json_status;
+    return json_status;
+  }
+  // `MessageToJsonString` always writes a single JSON object, so the status is
+  // spliced in before its closing brace instead of parsing the object again.
+  if (output.empty() || output.back() != '}') {
+    LOG(ERROR) << "Unexpected JSON for internal lookup response: " << output;
+    return absl::InternalError("Error while serializing JSON string.");
+  }
+  output.pop_back();
+  if (output.size() > 1) {
+    output.push_back(',');
+  }
+  absl::StrAppend(&output, kOkStatusJson, "}");
+  return absl::OkStatus();
+}
+
 void SetOutputAsString(const InternalLookupResponse& response,
                        FunctionBindingIoProto& io) {
   VLOG(9) << "Processing internal lookup response";
-  std::string kv_pairs_json;
-  if (const auto json_status = MessageToJsonString(response, &kv_pairs_json);
-      !json_status.ok()) {
-    SetStatusAsString(json_status.code(), json_status.message(), io);
-    LOG(ERROR) << "MessageToJsonString failed with " << json_status;
+  if (const auto status =
+          WriteOutputJson(response, *io.mutable_output_string());
+      !status.ok()) {
+    SetStatusAsString(status.code(), status.message(), io);
     VLOG(1) << "getValues result: " << io.DebugString();
-    return;
   }
+}
+
+// Parses the input of `hook_name`, a JSON array of arrays of keys.
+absl::StatusOr<std::vector<std::vector<std::string>>> ParseKeyLists(
+    std::string_view input, std::string_view hook_name) {
+  const auto invalid_input = [hook_name]() {
+    return absl::InvalidArgumentError(absl::StrCat(
+        hook_name, " input must be a JSON array of lists of strings"));
+  };
+  auto key_lists_json = nlohmann::json::parse(input, nullptr,
+                                              /*allow_exceptions=*/false,
+                                              /*ignore_comments=*/true);
+  if (key_lists_json.is_discarded() || !key_lists_json.is_array()) {
+    return invalid_input();
+  }
+  std::vector<std::vector<std::string>> key_lists;
+  key_lists.reserve(key_lists_json.size());
+  for (const auto& keys_json : key_lists_json) {
+    if (!keys_json.is_array()) {
+      return invalid_input();
+    }
+    auto& keys = key_lists.emplace_back();
+    keys.reserve(keys_json.size());
+    for (const auto& key : keys_json) {
+      if (!key.is_string()) {
+        return invalid_input();
+      }
+      keys.push_back(key.get<std::string>());
+    }
+  }
+  return key_lists;
+}
+
+// Parses the input of `getValuesByPrefix`, a JSON array of a key prefix and a
+// limit.
+absl::StatusOr<std::pair<std::string, int>> ParsePrefixLookup(
+    std::string_view input) {
+  const auto prefix_lookup_json = nlohmann::json::parse(
+      input, nullptr, /*allow_exceptions=*/false, /*ignore_comments=*/true);
+  if (prefix_lookup_json.is_discarded() || !prefix_lookup_json.is_array() ||
+      prefix_lookup_json.size() != 2 || !prefix_lookup_json[0].is_string() ||
+      !prefix_lookup_json[1].is_number_integer()) {
+    return absl::InvalidArgumentError(
+        "getValuesByPrefix input must be a JSON array of a key prefix and a "
+        "limit");
+  }
+  const int64_t limit = prefix_lookup_json[1].get<int64_t>();
+  if (limit < 1 || limit > kMaxPrefixLookupLimit) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("getValuesByPrefix limit must be between 1 and ",
+                     kMaxPrefixLookupLimit));
+  }
+  return std::make_pair(prefix_lookup_json[0].get<std::string>(),
+                        static_cast<int>(limit));
+}
+
+// Writes, as a JSON array, the output that `getValues` would have for each
+// list of keys, taking the results from `response` for all of them.
+void SetBatchOutputAsString(
+    const std::vector<std::vector<std::string>>& key_lists,
+    const InternalLookupResponse& response, FunctionBindingIoProto& io) {
+  std::string output = "[";
+  std::string list_output;
+  for (const auto& keys : key_lists) {
+    InternalLookupResponse list_response;
+    for (const auto& key : keys) {
+      if (const auto it = response.kv_pairs().find(key);
+          it != response.kv_pairs().end()) {
+        (*list_response.mutable_kv_pairs())[key] = it->second;
+      }
+    }
+    list_output.clear();
+    if (const auto status = WriteOutputJson(list_response, list_output);
+        !status.ok()) {
+      SetStatusAsString(status.code(), status.message(), io);
+      return;
+    }
+    if (output.size() > 1) {
+      output.push_back(',');
+    }
+    output.append(list_output);
+  }
+  output.push_back(']');
+  io.set_output_string(std::move(output));
+}
+
+// Output of one key looked up from the local cache.
+struct CacheLookupResult {
+  std::string_view key;
+  std::optional<std::string_view> value;
+  // Set if the key isn't in the cache, as by `LocalLookup`.
+  std::string not_found_message;
+};
+
+std::vector<CacheLookupResult> GetCacheLookupResults(
+    const absl::flat_hash_set<std::string_view>& keys,
+    const GetKeyValuePairsResult& kv_pairs) {
+  std::vector<CacheLookupResult> results;
+  results.reserve(keys.size());
+  for (std::string_view key : keys) {
+    auto& result = results.emplace_back(
+        CacheLookupResult{.key = key, .value = kv_pairs.GetValue(key)});
+    if (!result.value.has_value()) {
+      result.not_found_message = absl::StrCat("Key not found: ", key);
+    }
+  }
+  return results;
+}
+
+// Appends `value` to `output` as a JSON string.
+void AppendJsonString(std::string_view value, std::string& output) {
+  static constexpr char kHexDigits[] = "0123456789abcdef";
+  output.push_back('"');
+  for (const char c : value) {
+    switch (c) {
+      case '"':
+        output.append("\\\"");
+        break;
+      case '\\':
+        output.append("\\\\");
+        break;
+      case '\n':
+        output.append("\\n");
+        break;
+      case '\r':
+        output.append("\\r");
+        break;
+      case '\t':
+        output.append("\\t");
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          output.append("\\u00");
+          output.push_back(kHexDigits[c >> 4]);
+          output.push_back(kHexDigits[c & 0xf]);
+        } else {
+          output.push_back(c);
+        }
+    }
+  }
+  output.push_back('"');
+}
+
+// Appends the JSON output of one `getValues` call, the same as
+// `WriteOutputJson` writes for the response of `LocalLookup`.
+void AppendOutputJson(const std::vector<CacheLookupResult>& results,
+                      std::string& output) {
+  output.push_back('{');
+  if (!results.empty()) {
+    output.append(R"("kvPairs":{)");
+    for (const auto& result : results) {
+      if (&result != &results.front()) {
+        output.push_back(',');
+      }
+      AppendJsonString(result.key, output);
+      if (result.value.has_value()) {
+        output.append(R"(:{"value":)");
+        AppendJsonString(*result.value, output);
+        output.push_back('}');
+      } else {
+        absl::StrAppend(&output, R"(:{"status":{"code":)",
+                        static_cast<int>(absl::StatusCode::kNotFound),
+                        R"(,"message":)");
+        AppendJsonString(result.not_found_message, output);
+        output.append("}}");
+      }
+    }
+    output.append("},");
+  }
+  absl::StrAppend(&output, kOkStatusJson, "}");
+}
+
+// Field numbers of the messages of `BinaryGetValuesResponse`, which is
+// serialized from the values in the cache without building the message.
+constexpr int kStatusCodeField = 1;
+constexpr int kStatusMessageField = 2;
+constexpr int kValueStatusField = 1;
+constexpr int kValueDataField = 2;
+constexpr int kResponseStatusField = 1;
+constexpr int kResponseKvPairsField = 2;
+constexpr int kMapEntryKeyField = 1;
+constexpr int kMapEntryValueField = 2;
+
+// Size of a length-delimited field with a single byte tag, which all the
+// fields above have.
+size_t LengthDelimitedFieldSize(size_t size) {
+  return 1 + WireFormatLite::LengthDelimitedSize(size);
+}
+
+size_t StatusSize(int code, std::string_view message) {
+  size_t size = 0;
+  if (code != 0) {
+    size += 1 + WireFormatLite::Int32Size(code);
+  }
+  if (!message.empty()) {
+    size += LengthDelimitedFieldSize(message.size());
+  }
+  return size;
+}
+
+size_t ValueSize(const CacheLookupResult& result) {
+  if (result.value.has_value()) {
+    return LengthDelimitedFieldSize(result.value->size());
+  }
+  return LengthDelimitedFieldSize(
+      StatusSize(static_cast<int>(absl::StatusCode::kNotFound),
+                 result.not_found_message));
+}
+
+size_t MapEntrySize(const CacheLookupResult& result) {
+  return LengthDelimitedFieldSize(result.key.size()) +
+         LengthDelimitedFieldSize(ValueSize(result));
+}
+
+uint8_t* WriteLengthDelimitedHeader(int field_number, size_t size,
+                                    uint8_t* target) {
+  target = WireFormatLite::WriteTagToArray(
+      field_number, WireFormatLite::WIRETYPE_LENGTH_DELIMITED, target);
+  return CodedOutputStream::WriteVarint32ToArray(static_cast<uint32_t>(size),
+                                                 target);
+}
+
+uint8_t* WriteBytes(int field_number, std::string_view bytes,
+                    uint8_t* target) {
+  target = WriteLengthDelimitedHeader(field_number, bytes.size(), target);
+  return CodedOutputStream::WriteRawToArray(bytes.data(), bytes.size(),
+                                            target);
+}
 
-  auto kv_pairs_json_object = nlohmann::json::parse(kv_pairs_json, nullptr,
-                                                    /*allow_exceptions=*/false,
-                                                    /*ignore_comments=*/true);
-  if (kv_pairs_json_object.is_discarded()) {
-    SetStatusAsString(absl::StatusCode::kInvalidArgument,
-                      "Error while parsing JSON string.", io);
-    LOG(ERROR) << "json parse failed for " << kv_pairs_json;
+uint8_t* WriteStatus(int field_number, int code, std::string_view message,
+                     uint8_t* target) {
+  target = WriteLengthDelimitedHeader(field_number, StatusSize(code, message),
+                                      target);
+  if (code != 0) {
+    target = WireFormatLite::WriteInt32ToArray(kStatusCodeField, code, target);
+  }
+  if (!message.empty()) {
+    target = WriteBytes(kStatusMessageField, message, target);
+  }
+  return target;
+}
 
-    return;
+// Sets the output to the serialized `BinaryGetValuesResponse` of `results`,
+// the same as `SetOutputAsBytes` sets for the response of `LocalLookup`.
+void SetCacheOutputAsBytes(const std::vector<CacheLookupResult>& results,
+                           FunctionBindingIoProto& io) {
+  size_t size = LengthDelimitedFieldSize(StatusSize(0, kOkStatusMessage));
+  for (const auto& result : results) {
+    size += LengthDelimitedFieldSize(MapEntrySize(result));
+  }
+  std::string& buffer = *io.mutable_output_bytes();
+  buffer.resize(size);
+  uint8_t* target = reinterpret_cast<uint8_t*>(buffer.data());
+  target = WriteStatus(kResponseStatusField, 0, kOkStatusMessage, target);
+  for (const auto& result : results) {
+    target = WriteLengthDelimitedHeader(kResponseKvPairsField,
+                                        MapEntrySize(result), target);
+    target = WriteBytes(kMapEntryKeyField, result.key, target);
+    target = WriteLengthDelimitedHeader(kMapEntryValueField,
+                                        ValueSize(result), target);
+    if (result.value.has_value()) {
+      target = WriteBytes(kValueDataField, *result.value, target);
+    } else {
+      target =
+          WriteStatus(kValueStatusField,
+                      static_cast<int>(absl::StatusCode::kNotFound),
+                      result.not_found_message, target);
+    }
   }
-  kv_pairs_json_object["status"]["code"] = 0;
-  kv_pairs_json_object["status"]["message"] = kOkStatusMessage;
-  io.set_output_string(kv_pairs_json_object.dump());
+}
+
+#ifndef ABSL_IS_LITTLE_ENDIAN
+#error "getValuesFlat writes integers in host order, must be little-endian"
+#endif
+
+// One key of the output of `getValuesFlat`.
+struct FlatEntry {
+  std::string_view key;
+  std::string_view value;
+  uint32_t status_code = 0;
+};
+
+// Sets the output to the status and `entries` in the layout of
+// `FlatGetValuesView`, written in one pass into a buffer of the exact size.
+void SetFlatOutput(absl::StatusCode code, std::string_view message,
+                   const std::vector<FlatEntry>& entries,
+                   FunctionBindingIoProto& io) {
+  const size_t bytes_offset =
+      kFlatGetValuesHeaderSize + entries.size() * kFlatGetValuesEntrySize;
+  size_t size = bytes_offset + message.size();
+  for (const auto& entry : entries) {
+    size += entry.key.size() + entry.value.size();
+  }
+  std::string& buffer = *io.mutable_output_bytes();
+  buffer.resize(size);
+  char* const data = buffer.data();
+  size_t next_integer = 0;
+  size_t next_byte = bytes_offset;
+  const auto store = [data, &next_integer](size_t value) {
+    const auto integer = static_cast<uint32_t>(value);
+    std::memcpy(data + next_integer, &integer, sizeof(integer));
+    next_integer += sizeof(integer);
+  };
+  // Stores the offset and size of `bytes`, then copies them.
+  const auto store_bytes = [data, &next_byte, &store](std::string_view bytes) {
+    store(next_byte);
+    store(bytes.size());
+    if (!bytes.empty()) {
+      std::memcpy(data + next_byte, bytes.data(), bytes.size());
+      next_byte += bytes.size();
+    }
+  };
+  store(kFlatGetValuesMagic);
+  store(static_cast<uint32_t>(code));
+  store_bytes(message);
+  store(entries.size());
+  for (const auto& entry : entries) {
+    store_bytes(entry.key);
+    store_bytes(entry.value);
+    store(entry.status_code);
+  }
+}
+
+// Sets the flat output of `results`. Keys that aren't found have no message,
+// as the UDF knows their key.
+void SetCacheOutputAsFlat(const std::vector<CacheLookupResult>& results,
+                          FunctionBindingIoProto& io) {
+  std::vector<FlatEntry> entries;
+  entries.reserve(results.size());
+  for (const auto& result : results) {
+    if (result.value.has_value()) {
+      entries.push_back({.key = result.key, .value = *result.value});
+    } else {
+      entries.push_back(
+          {.key = result.key,
+           .status_code = static_cast<uint32_t>(absl::StatusCode::kNotFound)});
+    }
+  }
+  SetFlatOutput(absl::StatusCode::kOk, kOkStatusMessage, entries, io);
+}
+
+void SetOutputAsFlat(const InternalLookupResponse& response,
+                     FunctionBindingIoProto& io) {
+  std::vector<FlatEntry> entries;
+  entries.reserve(response.kv_pairs_size());
+  for (const auto& [key, result] : response.kv_pairs()) {
+    if (result.has_status()) {
+      entries.push_back(
+          {.key = key,
+           .status_code = static_cast<uint32_t>(result.status().code())});
+    } else {
+      entries.push_back({.key = key, .value = result.value()});
+    }
+  }
+  SetFlatOutput(absl::StatusCode::kOk, kOkStatusMessage, entries, io);
 }
 
 class GetValuesHookImpl : public GetValuesHook {
@@ -128,21 +504,215 @@ class GetValuesHookImpl : public GetValuesHook {
     }
   }
 
+  void FinishInitWithLocalCache(std::unique_ptr<Lookup> lookup,
+                                const Cache& local_cache) {
+    if (lookup_ == nullptr) {
+      lookup_ = std::move(lookup);
+      local_cache_ = &local_cache;
+    }
+  }
+
   void operator()(FunctionBindingPayload<RequestContext>& payload) {
-    VLOG(9) << "Called getValues hook";
+    GetValues(payload, "getValues", output_type_);
+  }
+
+  void GetValuesFlat(FunctionBindingPayload<RequestContext>& payload) {
+    GetValues(payload, "getValuesFlat", OutputType::kFlat);
+  }
+
+  void GetValuesBatch(FunctionBindingPayload<RequestContext>& payload) {
+    VLOG(9) << "Called getValuesBatch hook";
+    RequestSpan span = payload.metadata.StartSpan("getValuesBatch");
+    if (lookup_ == nullptr) {
+      SetStatus(absl::StatusCode::kInternal,
+                "getValuesBatch has not been initialized yet",
+                payload.io_proto);
+      LOG(ERROR) << "getValuesBatch hook is not initialized properly: lookup "
+                    "is nullptr";
+      return;
+    }
+    if (output_type_ != OutputType::kString) {
+      SetStatus(absl::StatusCode::kUnimplemented,
+                "getValuesBatch only supports string output", payload.io_proto);
+      return;
+    }
+    if (!payload.io_proto.has_input_string()) {
+      SetStatus(absl::StatusCode::kInvalidArgument,
+                "getValuesBatch input must be a string", payload.io_proto);
+      VLOG(1) << "getValuesBatch result: " << payload.io_proto.DebugString();
+      return;
+    }
+    auto key_lists =
+        ParseKeyLists(payload.io_proto.input_string(), "getValuesBatch");
+    if (!key_lists.ok()) {
+      SetStatus(key_lists.status().code(), key_lists.status().message(),
+                payload.io_proto);
+      VLOG(1) << "getValuesBatch result: " << payload.io_proto.DebugString();
+      return;
+    }
+
+    // The keys of all the lists are looked up at once, so that a sharded
+    // lookup fans out to each shard once for the whole batch.
+    absl::flat_hash_set<std::string_view> keys;
+    for (const auto& list : *key_lists) {
+      keys.insert(list.begin(), list.end());
+    }
+    span.SetAttribute("keys", keys.size());
+    if (local_cache_ != nullptr) {
+      const auto kv_pairs = LookUpLocalCache(payload.metadata, keys);
+      std::string output = "[";
+      for (const auto& list : *key_lists) {
+        if (output.size() > 1) {
+          output.push_back(',');
+        }
+        AppendOutputJson(
+            GetCacheLookupResults(
+                absl::flat_hash_set<std::string_view>(list.begin(), list.end()),
+                kv_pairs),
+            output);
+      }
+      output.push_back(']');
+      payload.io_proto.set_output_string(std::move(output));
+      VLOG(9) << "getValuesBatch result: " << payload.io_proto.DebugString();
+      return;
+    }
+    absl::StatusOr<InternalLookupResponse> response_or_status =
+        lookup_->GetKeyValues(payload.metadata, keys);
+    if (!response_or_status.ok()) {
+      SetStatus(response_or_status.status().code(),
+                response_or_status.status().message(), payload.io_proto);
+      VLOG(1) << "getValuesBatch result: " << payload.io_proto.DebugString();
+      return;
+    }
+    SetBatchOutputAsString(*key_lists, *response_or_status, payload.io_proto);
+    VLOG(9) << "getValuesBatch result: " << payload.io_proto.DebugString();
+  }
+
+  void GetValuesAndSets(FunctionBindingPayload<RequestContext>& payload) {
+    VLOG(9) << "Called getValuesAndSets hook";
+    RequestSpan span = payload.metadata.StartSpan("getValuesAndSets");
+    if (lookup_ == nullptr) {
+      SetStatus(absl::StatusCode::kInternal,
+                "getValuesAndSets has not been initialized yet",
+                payload.io_proto);
+      LOG(ERROR) << "getValuesAndSets hook is not initialized properly: "
+                    "lookup is nullptr";
+      return;
+    }
+    if (output_type_ != OutputType::kString) {
+      SetStatus(absl::StatusCode::kUnimplemented,
+                "getValuesAndSets only supports string output",
+                payload.io_proto);
+      return;
+    }
+    if (!payload.io_proto.has_input_string()) {
+      SetStatus(absl::StatusCode::kInvalidArgument,
+                "getValuesAndSets input must be a string", payload.io_proto);
+      VLOG(1) << "getValuesAndSets result: " << payload.io_proto.DebugString();
+      return;
+    }
+    auto key_lists =
+        ParseKeyLists(payload.io_proto.input_string(), "getValuesAndSets");
+    if (key_lists.ok() && key_lists->size() != 2) {
+      key_lists = absl::InvalidArgumentError(
+          "getValuesAndSets input must be a list of keys and a list of set "
+          "keys");
+    }
+    if (!key_lists.ok()) {
+      SetStatus(key_lists.status().code(), key_lists.status().message(),
+                payload.io_proto);
+      VLOG(1) << "getValuesAndSets result: " << payload.io_proto.DebugString();
+      return;
+    }
+    const absl::flat_hash_set<std::string_view> keys((*key_lists)[0].begin(),
+                                                     (*key_lists)[0].end());
+    const absl::flat_hash_set<std::string_view> set_keys(
+        (*key_lists)[1].begin(), (*key_lists)[1].end());
+    span.SetAttribute("keys", keys.size() + set_keys.size());
+    // The values and the sets are looked up at once, so that a sharded lookup
+    // sends each shard a single request for both.
+    absl::StatusOr<InternalLookupResponse> response_or_status =
+        lookup_->GetKeyValuesAndSets(payload.metadata, keys, set_keys);
+    if (!response_or_status.ok()) {
+      SetStatus(response_or_status.status().code(),
+                response_or_status.status().message(), payload.io_proto);
+      VLOG(1) << "getValuesAndSets result: " << payload.io_proto.DebugString();
+      return;
+    }
+    SetOutputAsString(*response_or_status, payload.io_proto);
+    VLOG(9) << "getValuesAndSets result: " << payload.io_proto.DebugString();
+  }
+
+  void GetValuesByPrefix(FunctionBindingPayload<RequestContext>& payload) {
+    VLOG(9) << "Called getValuesByPrefix hook";
+    RequestSpan span = payload.metadata.StartSpan("getValuesByPrefix");
     if (lookup_ == nullptr) {
       SetStatus(absl::StatusCode::kInternal,
-                "getValues has not been initialized yet", payload.io_proto);
-      LOG(ERROR)
-          << "getValues hook is not initialized properly: lookup is nullptr";
+                "getValuesByPrefix has not been initialized yet",
+                payload.io_proto);
+      LOG(ERROR) << "getValuesByPrefix hook is not initialized properly: "
+                    "lookup is nullptr";
+      return;
+    }
+    if (output_type_ != OutputType::kString) {
+      SetStatus(absl::StatusCode::kUnimplemented,
+                "getValuesByPrefix only supports string output",
+                payload.io_proto);
+      return;
+    }
+    if (!payload.io_proto.has_input_string()) {
+      SetStatus(absl::StatusCode::kInvalidArgument,
+                "getValuesByPrefix input must be a string", payload.io_proto);
+      VLOG(1) << "getValuesByPrefix result: "
+              << payload.io_proto.DebugString();
+      return;
+    }
+    const auto prefix_lookup =
+        ParsePrefixLookup(payload.io_proto.input_string());
+    if (!prefix_lookup.ok()) {
+      SetStatus(prefix_lookup.status().code(),
+                prefix_lookup.status().message(), payload.io_proto);
+      VLOG(1) << "getValuesByPrefix result: "
+              << payload.io_proto.DebugString();
       return;
     }
+    const auto& [key_prefix, limit] = *prefix_lookup;
+    absl::StatusOr<InternalLookupResponse> response_or_status =
+        lookup_->GetKeyValuesByPrefix(payload.metadata, key_prefix, limit);
+    if (!response_or_status.ok()) {
+      SetStatus(response_or_status.status().code(),
+                response_or_status.status().message(), payload.io_proto);
+      VLOG(1) << "getValuesByPrefix result: "
+              << payload.io_proto.DebugString();
+      return;
+    }
+    span.SetAttribute("keys", response_or_status->kv_pairs_size());
+    SetOutputAsString(*response_or_status, payload.io_proto);
+    VLOG(9) << "getValuesByPrefix result: " << payload.io_proto.DebugString();
+  }
 
-    VLOG(9) << "getValues request: " << payload.io_proto.DebugString();
+ private:
+  // Looks up the keys of `payload` for the `hook_name` hook, and writes their
+  // values as `output_type`.
+  void GetValues(FunctionBindingPayload<RequestContext>& payload,
+                 std::string_view hook_name, OutputType output_type) {
+    VLOG(9) << "Called " << hook_name << " hook";
+    RequestSpan span = payload.metadata.StartSpan(hook_name);
+    if (lookup_ == nullptr) {
+      SetStatus(absl::StatusCode::kInternal,
+                absl::StrCat(hook_name, " has not been initialized yet"),
+                payload.io_proto, output_type);
+      LOG(ERROR) << hook_name
+                 << " hook is not initialized properly: lookup is nullptr";
+      return;
+    }
+
+    VLOG(9) << hook_name << " request: " << payload.io_proto.DebugString();
     if (!payload.io_proto.has_input_list_of_string()) {
       SetStatus(absl::StatusCode::kInvalidArgument,
-                "getValues input must be list of strings", payload.io_proto);
-      VLOG(1) << "getValues result: " << payload.io_proto.DebugString();
+                absl::StrCat(hook_name, " input must be list of strings"),
+                payload.io_proto, output_type);
+      VLOG(1) << hook_name << " result: " << payload.io_proto.DebugString();
       return;
     }
 
@@ -150,43 +720,93 @@ class GetValuesHookImpl : public GetValuesHook {
     for (const auto& key : payload.io_proto.input_list_of_string().data()) {
       keys.insert(key);
     }
+    span.SetAttribute("keys", keys.size());
+
+    if (local_cache_ != nullptr) {
+      const auto kv_pairs = LookUpLocalCache(payload.metadata, keys);
+      const auto results = GetCacheLookupResults(keys, kv_pairs);
+      switch (output_type) {
+        case OutputType::kString:
+          AppendOutputJson(results, *payload.io_proto.mutable_output_string());
+          break;
+        case OutputType::kBinary:
+          SetCacheOutputAsBytes(results, payload.io_proto);
+          break;
+        case OutputType::kFlat:
+          SetCacheOutputAsFlat(results, payload.io_proto);
+          break;
+      }
+      VLOG(9) << hook_name << " result: " << payload.io_proto.DebugString();
+      return;
+    }
 
     VLOG(9) << "Calling internal lookup client";
     absl::StatusOr<InternalLookupResponse> response_or_status =
         lookup_->GetKeyValues(payload.metadata, keys);
     if (!response_or_status.ok()) {
       SetStatus(response_or_status.status().code(),
-                response_or_status.status().message(), payload.io_proto);
-      VLOG(1) << "getValues result: " << payload.io_proto.DebugString();
+                response_or_status.status().message(), payload.io_proto,
+                output_type);
+      VLOG(1) << hook_name << " result: " << payload.io_proto.DebugString();
       return;
     }
 
-    SetOutput(response_or_status.value(), payload.io_proto);
-    VLOG(9) << "getValues result: " << payload.io_proto.DebugString();
+    SetOutput(response_or_status.value(), payload.io_proto, output_type);
+    VLOG(9) << hook_name << " result: " << payload.io_proto.DebugString();
+  }
+
+  GetKeyValuePairsResult LookUpLocalCache(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& keys) const {
+    ScopeLatencyMetricsRecorder<InternalLookupMetricsContext,
+                                kInternalGetKeyValuesLatencyInMicros>
+        latency_recorder(request_context.GetInternalLookupMetricsContext());
+    if (keys.empty()) {
+      return GetKeyValuePairsResult();
+    }
+    return local_cache_->GetKeyValuePairViews(request_context, keys);
   }
 
- private:
   void SetStatus(absl::StatusCode code, std::string_view message,
                  FunctionBindingIoProto& io) {
-    if (output_type_ == OutputType::kString) {
-      SetStatusAsString(code, message, io);
-    } else {
-      SetStatusAsBytes(code, message, io);
+    SetStatus(code, message, io, output_type_);
+  }
+
+  static void SetStatus(absl::StatusCode code, std::string_view message,
+                        FunctionBindingIoProto& io, OutputType output_type) {
+    switch (output_type) {
+      case OutputType::kString:
+        SetStatusAsString(code, message, io);
+        break;
+      case OutputType::kBinary:
+        SetStatusAsBytes(code, message, io);
+        break;
+      case OutputType::kFlat:
+        SetFlatOutput(code, message, {}, io);
+        break;
     }
   }
 
-  void SetOutput(const InternalLookupResponse& response,
-                 FunctionBindingIoProto& io) {
-    if (output_type_ == OutputType::kString) {
-      SetOutputAsString(response, io);
-    } else {
-      SetOutputAsBytes(response, io);
+  static void SetOutput(const InternalLookupResponse& response,
+                        FunctionBindingIoProto& io, OutputType output_type) {
+    switch (output_type) {
+      case OutputType::kString:
+        SetOutputAsString(response, io);
+        break;
+      case OutputType::kBinary:
+        SetOutputAsBytes(response, io);
+        break;
+      case OutputType::kFlat:
+        SetOutputAsFlat(response, io);
+        break;
     }
   }
 
   // `lookup_` is initialized separately, since its dependencies create threads.
   // Lazy load is used to ensure that it only happens after Roma forks.
   std::unique_ptr<Lookup> lookup_;
+  // Set if all the keys are in this cache, which then replaces `lookup_`.
+  const Cache* local_cache_ = nullptr;
   OutputType output_type_;
 };
 }  // namespace
@@ -20,6 +20,7 @@
 #include <memory>
 #include <string>
 #include <tuple>
+#include <utility>
 #include <vector>
 
 #include "absl/functional/any_invocable.h"
@@ -33,7 +34,8 @@ namespace kv_server {
 // Functor that acts as a wrapper for the internal lookup client call.
 class GetValuesHook {
  public:
-  enum class OutputType { kString = 0, kBinary };
+  // `kFlat` is the layout of `public/udf/flat_get_values.h`.
+  enum class OutputType { kString = 0, kBinary, kFlat };
 
   virtual ~GetValuesHook() = default;
 
@@ -43,11 +45,53 @@ class GetValuesHook {
   // init can only be completed after UdfClient and cache init.
   virtual void FinishInit(std::unique_ptr<Lookup> lookup) = 0;
 
+  // Same as `FinishInit`, for a server that isn't sharded, so that all the
+  // keys are in `local_cache`. `getValues` then looks its keys up straight
+  // from `local_cache`, and writes its output from the values in the cache
+  // without building an `InternalLookupResponse`. `local_cache` must outlive
+  // the hook.
+  virtual void FinishInitWithLocalCache(std::unique_ptr<Lookup> lookup,
+                                        const Cache& local_cache) {
+    FinishInit(std::move(lookup));
+  }
+
   // This is registered with v8 and is exposed to the UDF. Internally, it calls
   // the internal lookup client.
   virtual void operator()(
       google::scp::roma::FunctionBindingPayload<RequestContext>& payload) = 0;
 
+  // This is registered with v8 as `getValuesBatch`. Its input is a JSON array
+  // of lists of keys, such as `[["k1","k2"],["k3"]]`, that are all looked up
+  // with one internal lookup call. Its output is a JSON array of what the
+  // hook outputs for each list. Only the string output type supports it.
+  virtual void GetValuesBatch(
+      google::scp::roma::FunctionBindingPayload<RequestContext>& payload) = 0;
+
+  // This is registered with v8 as `getValuesAndSets`. Its input is a JSON
+  // array of two lists, the keys whose values and the keys whose sets are
+  // looked up, such as `[["k1"],["set1"]]`, which are all looked up with one
+  // internal lookup call. Its output is what `getValues` outputs for all the
+  // keys, with the members of each set as its `keysetValues`. Only the string
+  // output type supports it.
+  virtual void GetValuesAndSets(
+      google::scp::roma::FunctionBindingPayload<RequestContext>& payload) = 0;
+
+  // This is registered with v8 as `getValuesByPrefix`. Its input is a JSON
+  // array of a key prefix and a limit, such as `["creative:1:", 10]`. Its
+  // output is what `getValues` outputs for up to `limit` keys that start with
+  // the prefix and have a value, the first ones in key order. Only the key
+  // prefixes that the server indexes can be looked up, see
+  // `PrefixIndexedCache`. Only the string output type supports it.
+  virtual void GetValuesByPrefix(
+      google::scp::roma::FunctionBindingPayload<RequestContext>& payload) = 0;
+
+  // This is registered with v8 as `getValuesFlat`. Its input is the same as
+  // that of `getValues`. Its output is the same lookup in the flat layout of
+  // `public/udf/flat_get_values.h`, whatever the output type of the hook, which
+  // a WASM UDF copies into its memory and reads in place, without parsing it.
+  virtual void GetValuesFlat(
+      google::scp::roma::FunctionBindingPayload<RequestContext>& payload) = 0;
+
   static std::unique_ptr<GetValuesHook> Create(OutputType output_type);
 };
 
@@ -13,13 +13,18 @@
 // limitations under the License.
 #include "components/udf/hooks/get_values_hook.h"
 
+#include <algorithm>
+#include <cstdint>
 #include <string>
 #include <string_view>
+#include <tuple>
 #include <utility>
 #include <vector>
 
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "components/data_server/cache/key_value_cache.h"
+#include "components/internal_server/local_lookup.h"
 #include "components/internal_server/mocks.h"
 #include "gmock/gmock.h"
 #include "google/protobuf/message_lite.h"
@@ -28,6 +33,7 @@
 #include "nlohmann/json.hpp"
 #include "public/test_util/proto_matcher.h"
 #include "public/udf/binary_get_values.pb.h"
+#include "public/udf/flat_get_values.h"
 
 namespace kv_server {
 namespace {
@@ -36,6 +42,7 @@ using google::protobuf::TextFormat;
 using google::scp::roma::FunctionBindingPayload;
 using google::scp::roma::proto::FunctionBindingIoProto;
 using testing::_;
+using testing::ElementsAre;
 using testing::Return;
 
 class GetValuesHookTest : public ::testing::Test {
@@ -114,6 +121,199 @@ TEST_F(GetValuesHookTest, StringOutput_SuccessfullyProcessesResultsWithStatus) {
   EXPECT_EQ(io.output_string(), expected.dump());
 }
 
+TEST_F(GetValuesHookTest, StringOutput_EmptyLookupResponse) {
+  absl::flat_hash_set<std::string_view> keys = {"key1"};
+  auto mock_lookup = std::make_unique<MockLookup>();
+  EXPECT_CALL(*mock_lookup, GetKeyValues(_, keys))
+      .WillOnce(Return(InternalLookupResponse()));
+
+  FunctionBindingIoProto io;
+  TextFormat::ParseFromString(R"pb(input_list_of_string { data: "key1" })pb",
+                              &io);
+  auto get_values_hook =
+      GetValuesHook::Create(GetValuesHook::OutputType::kString);
+  get_values_hook->FinishInit(std::move(mock_lookup));
+  ScopeMetricsContext metrics_context;
+  FunctionBindingPayload<RequestContext> payload{
+      io, RequestContext(metrics_context)};
+  (*get_values_hook)(payload);
+
+  EXPECT_EQ(io.output_string(), R"({"status":{"code":0,"message":"ok"}})");
+}
+
+TEST_F(GetValuesHookTest, StringOutput_BatchLooksUpAllKeysAtOnce) {
+  absl::flat_hash_set<std::string_view> keys = {"key1", "key2", "key3"};
+  InternalLookupResponse lookup_response;
+  TextFormat::ParseFromString(
+      R"pb(kv_pairs {
+             key: "key1"
+             value { value: "value1" }
+           }
+           kv_pairs {
+             key: "key2"
+             value { value: "value2" }
+           }
+           kv_pairs {
+             key: "key3"
+             value { status { code: 5, message: "Key not found" } }
+           })pb",
+      &lookup_response);
+  auto mock_lookup = std::make_unique<MockLookup>();
+  EXPECT_CALL(*mock_lookup, GetKeyValues(_, keys))
+      .WillOnce(Return(lookup_response));
+
+  FunctionBindingIoProto io;
+  io.set_input_string(R"([["key1", "key2"], ["key3", "key1"], []])");
+  auto get_values_hook =
+      GetValuesHook::Create(GetValuesHook::OutputType::kString);
+  get_values_hook->FinishInit(std::move(mock_lookup));
+  ScopeMetricsContext metrics_context;
+  FunctionBindingPayload<RequestContext> payload{
+      io, RequestContext(metrics_context)};
+  get_values_hook->GetValuesBatch(payload);
+
+  nlohmann::json result_json =
+      nlohmann::json::parse(io.output_string(), nullptr,
+                            /*allow_exceptions=*/false,
+                            /*ignore_comments=*/true);
+  nlohmann::json expected = R"([
+      {"kvPairs": {"key1": {"value": "value1"}, "key2": {"value": "value2"}},
+       "status": {"code": 0, "message": "ok"}},
+      {"kvPairs": {"key1": {"value": "value1"},
+                   "key3": {"status": {"code": 5, "message": "Key not found"}}},
+       "status": {"code": 0, "message": "ok"}},
+      {"status": {"code": 0, "message": "ok"}}])"_json;
+  EXPECT_EQ(result_json, expected);
+}
+
+TEST_F(GetValuesHookTest, StringOutput_BatchInputIsNotListOfLists) {
+  auto mock_lookup = std::make_unique<MockLookup>();
+
+  FunctionBindingIoProto io;
+  io.set_input_string(R"(["key1", "key2"])");
+  auto get_values_hook =
+      GetValuesHook::Create(GetValuesHook::OutputType::kString);
+  get_values_hook->FinishInit(std::move(mock_lookup));
+  ScopeMetricsContext metrics_context;
+  FunctionBindingPayload<RequestContext> payload{
+      io, RequestContext(metrics_context)};
+  get_values_hook->GetValuesBatch(payload);
+
+  nlohmann::json expected =
+      R"({"code":3,"message":"getValuesBatch input must be a JSON array of lists of strings"})"_json;
+  EXPECT_EQ(io.output_string(), expected.dump());
+}
+
+TEST_F(GetValuesHookTest, StringOutput_ValuesAndSetsAreLookedUpTogether) {
+  InternalLookupResponse value_response;
+  TextFormat::ParseFromString(R"pb(kv_pairs {
+                                     key: "key1"
+                                     value { value: "value1" }
+                                   })pb",
+                              &value_response);
+  InternalLookupResponse set_response;
+  TextFormat::ParseFromString(
+      R"pb(kv_pairs {
+             key: "set1"
+             value { keyset_values { values: "a" } }
+           })pb",
+      &set_response);
+  auto mock_lookup = std::make_unique<MockLookup>();
+  EXPECT_CALL(*mock_lookup,
+              GetKeyValues(_, absl::flat_hash_set<std::string_view>{"key1"}))
+      .WillOnce(Return(value_response));
+  EXPECT_CALL(*mock_lookup,
+              GetKeyValueSet(_, absl::flat_hash_set<std::string_view>{"set1"}))
+      .WillOnce(Return(set_response));
+
+  FunctionBindingIoProto io;
+  io.set_input_string(R"([["key1"], ["set1"]])");
+  auto get_values_hook =
+      GetValuesHook::Create(GetValuesHook::OutputType::kString);
+  get_values_hook->FinishInit(std::move(mock_lookup));
+  ScopeMetricsContext metrics_context;
+  FunctionBindingPayload<RequestContext> payload{
+      io, RequestContext(metrics_context)};
+  get_values_hook->GetValuesAndSets(payload);
+
+  nlohmann::json result_json =
+      nlohmann::json::parse(io.output_string(), nullptr,
+                            /*allow_exceptions=*/false,
+                            /*ignore_comments=*/true);
+  nlohmann::json expected = R"({
+      "kvPairs": {"key1": {"value": "value1"},
+                  "set1": {"keysetValues": {"values": ["a"]}}},
+      "status": {"code": 0, "message": "ok"}})"_json;
+  EXPECT_EQ(result_json, expected);
+}
+
+TEST_F(GetValuesHookTest, StringOutput_ValuesAndSetsInputIsNotTwoLists) {
+  auto mock_lookup = std::make_unique<MockLookup>();
+
+  FunctionBindingIoProto io;
+  io.set_input_string(R"([["key1"]])");
+  auto get_values_hook =
+      GetValuesHook::Create(GetValuesHook::OutputType::kString);
+  get_values_hook->FinishInit(std::move(mock_lookup));
+  ScopeMetricsContext metrics_context;
+  FunctionBindingPayload<RequestContext> payload{
+      io, RequestContext(metrics_context)};
+  get_values_hook->GetValuesAndSets(payload);
+
+  nlohmann::json expected =
+      R"({"code":3,"message":"getValuesAndSets input must be a list of keys and a list of set keys"})"_json;
+  EXPECT_EQ(io.output_string(), expected.dump());
+}
+
+TEST_F(GetValuesHookTest, StringOutput_ValuesAreLookedUpByPrefix) {
+  InternalLookupResponse response;
+  TextFormat::ParseFromString(R"pb(kv_pairs {
+                                     key: "ad:1"
+                                     value { value: "value1" }
+                                   })pb",
+                              &response);
+  auto mock_lookup = std::make_unique<MockLookup>();
+  EXPECT_CALL(*mock_lookup, GetKeyValuesByPrefix(_, "ad:", 10))
+      .WillOnce(Return(response));
+
+  FunctionBindingIoProto io;
+  io.set_input_string(R"(["ad:", 10])");
+  auto get_values_hook =
+      GetValuesHook::Create(GetValuesHook::OutputType::kString);
+  get_values_hook->FinishInit(std::move(mock_lookup));
+  ScopeMetricsContext metrics_context;
+  FunctionBindingPayload<RequestContext> payload{
+      io, RequestContext(metrics_context)};
+  get_values_hook->GetValuesByPrefix(payload);
+
+  nlohmann::json result_json =
+      nlohmann::json::parse(io.output_string(), nullptr,
+                            /*allow_exceptions=*/false,
+                            /*ignore_comments=*/true);
+  nlohmann::json expected = R"({
+      "kvPairs": {"ad:1": {"value": "value1"}},
+      "status": {"code": 0, "message": "ok"}})"_json;
+  EXPECT_EQ(result_json, expected);
+}
+
+TEST_F(GetValuesHookTest, StringOutput_PrefixLookupLimitIsOutOfRange) {
+  auto mock_lookup = std::make_unique<MockLookup>();
+
+  FunctionBindingIoProto io;
+  io.set_input_string(R"(["ad:", 0])");
+  auto get_values_hook =
+      GetValuesHook::Create(GetValuesHook::OutputType::kString);
+  get_values_hook->FinishInit(std::move(mock_lookup));
+  ScopeMetricsContext metrics_context;
+  FunctionBindingPayload<RequestContext> payload{
+      io, RequestContext(metrics_context)};
+  get_values_hook->GetValuesByPrefix(payload);
+
+  nlohmann::json expected =
+      R"({"code":3,"message":"getValuesByPrefix limit must be between 1 and 10000"})"_json;
+  EXPECT_EQ(io.output_string(), expected.dump());
+}
+
 TEST_F(GetValuesHookTest, StringOutput_LookupReturnsError) {
   absl::flat_hash_set<std::string_view> keys = {"key1"};
   auto mock_lookup = std::make_unique<MockLookup>();
@@ -228,5 +428,191 @@ TEST_F(GetValuesHookTest, BinaryOutput_LookupReturnsError) {
   EXPECT_EQ(response.status().message(), "Some error");
 }
 
+// Returns the entries of the flat output `bytes`, as key, value and status
+// code, sorted by key.
+std::vector<std::tuple<std::string, std::string, uint32_t>> FlatEntries(
+    std::string_view bytes) {
+  const auto view = FlatGetValuesView::Create(bytes);
+  EXPECT_TRUE(view.has_value());
+  std::vector<std::tuple<std::string, std::string, uint32_t>> entries;
+  for (size_t i = 0; view.has_value() && i < view->size(); ++i) {
+    const auto entry = view->entry(i);
+    entries.emplace_back(entry.key, entry.value, entry.status_code);
+  }
+  std::sort(entries.begin(), entries.end());
+  return entries;
+}
+
+TEST_F(GetValuesHookTest, FlatOutput_SuccessfullyProcessesValue) {
+  absl::flat_hash_set<std::string_view> keys = {"key1", "key2"};
+  InternalLookupResponse lookup_response;
+  TextFormat::ParseFromString(
+      R"pb(kv_pairs {
+             key: "key1"
+             value { value: "value1" }
+           }
+           kv_pairs {
+             key: "key2"
+             value { status { code: 2, message: "Some error" } }
+           })pb",
+      &lookup_response);
+  auto mock_lookup = std::make_unique<MockLookup>();
+  EXPECT_CALL(*mock_lookup, GetKeyValues(_, keys))
+      .WillOnce(Return(lookup_response));
+
+  FunctionBindingIoProto io;
+  TextFormat::ParseFromString(
+      R"pb(input_list_of_string { data: "key1" data: "key2" })pb", &io);
+  // The flat output doesn't depend on the output type of the hook.
+  auto get_values_hook =
+      GetValuesHook::Create(GetValuesHook::OutputType::kBinary);
+  get_values_hook->FinishInit(std::move(mock_lookup));
+  ScopeMetricsContext metrics_context;
+  FunctionBindingPayload<RequestContext> payload{
+      io, RequestContext(metrics_context)};
+  get_values_hook->GetValuesFlat(payload);
+
+  const auto view = FlatGetValuesView::Create(io.output_bytes());
+  ASSERT_TRUE(view.has_value());
+  EXPECT_EQ(view->status_code(), 0);
+  EXPECT_EQ(view->status_message(), "ok");
+  EXPECT_THAT(
+      FlatEntries(io.output_bytes()),
+      ElementsAre(std::make_tuple("key1", "value1", 0),
+                  std::make_tuple("key2", "", 2)));
+}
+
+TEST_F(GetValuesHookTest, FlatOutput_LookupReturnsError) {
+  absl::flat_hash_set<std::string_view> keys = {"key1"};
+  auto mock_lookup = std::make_unique<MockLookup>();
+  EXPECT_CALL(*mock_lookup, GetKeyValues(_, keys))
+      .WillOnce(Return(absl::UnknownError("Some error")));
+
+  FunctionBindingIoProto io;
+  TextFormat::ParseFromString(R"pb(input_list_of_string { data: "key1" })pb",
+                              &io);
+  auto get_values_hook =
+      GetValuesHook::Create(GetValuesHook::OutputType::kString);
+  get_values_hook->FinishInit(std::move(mock_lookup));
+  ScopeMetricsContext metrics_context;
+  FunctionBindingPayload<RequestContext> payload{
+      io, RequestContext(metrics_context)};
+  get_values_hook->GetValuesFlat(payload);
+
+  const auto view = FlatGetValuesView::Create(io.output_bytes());
+  ASSERT_TRUE(view.has_value());
+  EXPECT_EQ(view->status_code(), 2);
+  EXPECT_EQ(view->status_message(), "Some error");
+  EXPECT_EQ(view->size(), 0);
+}
+
+// Returns the output of `hook` for `input`, a `FunctionBindingIoProto` in
+// text format.
+FunctionBindingIoProto CallHook(GetValuesHook& hook, std::string_view input,
+                                bool batch = false) {
+  FunctionBindingIoProto io;
+  TextFormat::ParseFromString(input, &io);
+  ScopeMetricsContext metrics_context;
+  FunctionBindingPayload<RequestContext> payload{
+      io, RequestContext(metrics_context)};
+  if (batch) {
+    hook.GetValuesBatch(payload);
+  } else {
+    hook(payload);
+  }
+  return io;
+}
+
+class LocalCacheGetValuesHookTest : public GetValuesHookTest {
+ protected:
+  LocalCacheGetValuesHookTest() {
+    cache_->UpdateKeyValue("key1", "value1", /*logical_commit_time=*/1);
+    cache_->UpdateKeyValue("key2", "quote \" and\nnewline",
+                           /*logical_commit_time=*/1);
+  }
+
+  // Returns a hook that reads from `cache_`, and one that looks up keys in it
+  // through `LocalLookup`.
+  std::pair<std::unique_ptr<GetValuesHook>, std::unique_ptr<GetValuesHook>>
+  CreateHooks(GetValuesHook::OutputType output_type) {
+    auto cache_hook = GetValuesHook::Create(output_type);
+    // Keys aren't looked up through the lookup.
+    cache_hook->FinishInitWithLocalCache(std::make_unique<MockLookup>(),
+                                         *cache_);
+    auto lookup_hook = GetValuesHook::Create(output_type);
+    lookup_hook->FinishInit(CreateLocalLookup(*cache_));
+    return {std::move(cache_hook), std::move(lookup_hook)};
+  }
+
+  std::unique_ptr<Cache> cache_ = KeyValueCache::Create();
+};
+
+TEST_F(LocalCacheGetValuesHookTest, StringOutputIsSameAsFromLookup) {
+  auto [cache_hook, lookup_hook] =
+      CreateHooks(GetValuesHook::OutputType::kString);
+  constexpr std::string_view kKeysInput =
+      R"pb(input_list_of_string { data: "key1" data: "key2" data: "key3" })pb";
+  constexpr std::string_view kNoKeysInput = R"pb(input_list_of_string {})pb";
+  for (const std::string_view input : {kKeysInput, kNoKeysInput}) {
+    const auto output = CallHook(*cache_hook, input).output_string();
+    const auto expected = CallHook(*lookup_hook, input).output_string();
+    EXPECT_EQ(nlohmann::json::parse(output), nlohmann::json::parse(expected))
+        << output;
+  }
+}
+
+TEST_F(LocalCacheGetValuesHookTest, BatchOutputIsSameAsFromLookup) {
+  auto [cache_hook, lookup_hook] =
+      CreateHooks(GetValuesHook::OutputType::kString);
+  constexpr std::string_view kInput =
+      R"pb(input_string: "[[\"key1\",\"key3\"],[],[\"key2\",\"key2\"]]")pb";
+  const auto output = CallHook(*cache_hook, kInput, /*batch=*/true);
+  EXPECT_EQ(
+      nlohmann::json::parse(output.output_string()),
+      nlohmann::json::parse(
+          CallHook(*lookup_hook, kInput, /*batch=*/true).output_string()))
+      << output.output_string();
+}
+
+TEST_F(LocalCacheGetValuesHookTest, BinaryOutputIsSameAsFromLookup) {
+  auto [cache_hook, lookup_hook] =
+      CreateHooks(GetValuesHook::OutputType::kBinary);
+  constexpr std::string_view kInput =
+      R"pb(input_list_of_string { data: "key1" data: "key2" data: "key3" })pb";
+  BinaryGetValuesResponse response;
+  ASSERT_TRUE(
+      response.ParseFromString(CallHook(*cache_hook, kInput).output_bytes()));
+  BinaryGetValuesResponse expected;
+  ASSERT_TRUE(
+      expected.ParseFromString(CallHook(*lookup_hook, kInput).output_bytes()));
+  EXPECT_THAT(response, EqualsProto(expected));
+  EXPECT_EQ(response.kv_pairs().at("key2").data(), "quote \" and\nnewline");
+}
+
+TEST_F(LocalCacheGetValuesHookTest, FlatOutputIsSameAsFromLookup) {
+  auto [cache_hook, lookup_hook] =
+      CreateHooks(GetValuesHook::OutputType::kString);
+  const auto call_flat = [](GetValuesHook& hook) {
+    FunctionBindingIoProto io;
+    TextFormat::ParseFromString(R"pb(input_list_of_string {
+                                       data: "key1"
+                                       data: "key2"
+                                       data: "key3"
+                                     })pb",
+                                &io);
+    ScopeMetricsContext metrics_context;
+    FunctionBindingPayload<RequestContext> payload{
+        io, RequestContext(metrics_context)};
+    hook.GetValuesFlat(payload);
+    return io.output_bytes();
+  };
+  const auto entries = FlatEntries(call_flat(*cache_hook));
+  EXPECT_EQ(entries, FlatEntries(call_flat(*lookup_hook)));
+  EXPECT_THAT(entries,
+              ElementsAre(std::make_tuple("key1", "value1", 0),
+                          std::make_tuple("key2", "quote \" and\nnewline", 0),
+                          std::make_tuple("key3", "", 5)));
+}
+
 }  // namespace
 }  // namespace kv_server
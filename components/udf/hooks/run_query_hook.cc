@@ -14,8 +14,10 @@
 
 #include "components/udf/hooks/run_query_hook.h"
 
+#include <cstdint>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <tuple>
 #include <utility>
 #include <vector>
@@ -23,7 +25,9 @@
 #include "absl/functional/any_invocable.h"
 #include "absl/log/log.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
 #include "components/internal_server/lookup.h"
+#include "components/util/request_tracing.h"
 #include "nlohmann/json.hpp"
 
 namespace kv_server {
@@ -40,6 +44,7 @@ class RunQueryHookImpl : public RunQueryHook {
   }
 
   void operator()(FunctionBindingPayload<RequestContext>& payload) {
+    const RequestSpan span = payload.metadata.StartSpan("runQuery");
     if (lookup_ == nullptr) {
       nlohmann::json status;
       status["code"] = absl::StatusCode::kInternal;
@@ -73,12 +78,83 @@ class RunQueryHookImpl : public RunQueryHook {
     }
 
     VLOG(9) << "Processing internal run query response";
+    if (response_or_status->has_count()) {
+      // `COUNT` and `EXISTS` queries only return a number.
+      payload.io_proto.set_output_string(
+          absl::StrCat(response_or_status->count()));
+      VLOG(9) << "runQuery result: " << payload.io_proto.DebugString();
+      return;
+    }
     *payload.io_proto.mutable_output_list_of_string()->mutable_data() =
         *std::move(response_or_status.value().mutable_elements());
     VLOG(9) << "runQuery result: " << payload.io_proto.DebugString();
   }
 
+  void ApproxCardinality(FunctionBindingPayload<RequestContext>& payload) {
+    const RequestSpan span = payload.metadata.StartSpan("approxCardinality");
+    if (lookup_ == nullptr) {
+      SetStatus(absl::StatusCode::kInternal,
+                "approxCardinality has not been initialized yet", payload);
+      LOG(ERROR) << "approxCardinality hook is not initialized properly: "
+                    "lookup is nullptr";
+      return;
+    }
+    if (!payload.io_proto.has_input_string()) {
+      SetStatus(absl::StatusCode::kInvalidArgument,
+                "approxCardinality input must be a string", payload);
+      return;
+    }
+    const absl::StatusOr<int64_t> estimate = lookup_->ApproxCardinality(
+        payload.metadata, payload.io_proto.input_string());
+    if (!estimate.ok()) {
+      VLOG(1) << "approxCardinality error: " << estimate.status();
+      SetStatus(estimate.status().code(), estimate.status().message(),
+                payload);
+      return;
+    }
+    payload.io_proto.set_output_string(absl::StrCat(*estimate));
+    VLOG(9) << "approxCardinality result: " << payload.io_proto.DebugString();
+  }
+
+  void GetSetsContaining(FunctionBindingPayload<RequestContext>& payload) {
+    const RequestSpan span = payload.metadata.StartSpan("getSetsContaining");
+    if (lookup_ == nullptr) {
+      SetStatus(absl::StatusCode::kInternal,
+                "getSetsContaining has not been initialized yet", payload);
+      LOG(ERROR) << "getSetsContaining hook is not initialized properly: "
+                    "lookup is nullptr";
+      return;
+    }
+    if (!payload.io_proto.has_input_string()) {
+      SetStatus(absl::StatusCode::kInvalidArgument,
+                "getSetsContaining input must be a string", payload);
+      return;
+    }
+    absl::StatusOr<std::vector<std::string>> keys = lookup_->GetSetsContaining(
+        payload.metadata, payload.io_proto.input_string());
+    if (!keys.ok()) {
+      VLOG(1) << "getSetsContaining error: " << keys.status();
+      SetStatus(keys.status().code(), keys.status().message(), payload);
+      return;
+    }
+    auto* data =
+        payload.io_proto.mutable_output_list_of_string()->mutable_data();
+    data->Reserve(keys->size());
+    for (std::string& key : *keys) {
+      data->Add(std::move(key));
+    }
+    VLOG(9) << "getSetsContaining result: " << payload.io_proto.DebugString();
+  }
+
  private:
+  static void SetStatus(absl::StatusCode code, std::string_view message,
+                        FunctionBindingPayload<RequestContext>& payload) {
+    nlohmann::json status;
+    status["code"] = code;
+    status["message"] = std::string(message);
+    payload.io_proto.set_output_string(status.dump());
+  }
+
   // `lookup_` is initialized separately, since its dependencies create threads.
   // Lazy load is used to ensure that it only happens after Roma forks.
   std::unique_ptr<Lookup> lookup_;
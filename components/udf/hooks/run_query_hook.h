@@ -41,10 +41,24 @@ class RunQueryHook {
   virtual void FinishInit(std::unique_ptr<Lookup> lookup) = 0;
 
   // This is registered with v8 and is exposed to the UDF. Internally, it calls
-  // the internal query client.
+  // the internal query client. Returns the elements of the result, or, for
+  // `COUNT` and `EXISTS` queries, a string of their count.
   virtual void operator()(
       google::scp::roma::FunctionBindingPayload<RequestContext>& payload) = 0;
 
+  // Registered as `approxCardinality`. Returns a string of the estimated
+  // number of elements of the result of the query, or of its count for
+  // `COUNT` and `EXISTS` queries, computed from sketches of its sets where
+  // the lookup keeps them, or a JSON status on errors.
+  virtual void ApproxCardinality(
+      google::scp::roma::FunctionBindingPayload<RequestContext>& payload) = 0;
+
+  // Registered as `getSetsContaining`. Takes a set member and returns the
+  // list of the keys of the sets that contain it, from the reverse membership
+  // index of the sets, or a JSON status on errors.
+  virtual void GetSetsContaining(
+      google::scp::roma::FunctionBindingPayload<RequestContext>& payload) = 0;
+
   static std::unique_ptr<RunQueryHook> Create();
 };
 
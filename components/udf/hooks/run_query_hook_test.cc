@@ -62,6 +62,26 @@ TEST_F(RunQueryHookTest, SuccessfullyProcessesValue) {
               UnorderedElementsAreArray({"a", "b"}));
 }
 
+TEST_F(RunQueryHookTest, CountQueryReturnsCount) {
+  std::string query = "COUNT Q";
+  InternalRunQueryResponse run_query_response;
+  TextFormat::ParseFromString(R"pb(count: 2)pb", &run_query_response);
+  auto mock_lookup = std::make_unique<MockLookup>();
+  EXPECT_CALL(*mock_lookup, RunQuery(_, query))
+      .WillOnce(Return(run_query_response));
+
+  FunctionBindingIoProto io;
+  TextFormat::ParseFromString(R"pb(input_string: "COUNT Q")pb", &io);
+  auto run_query_hook = RunQueryHook::Create();
+  run_query_hook->FinishInit(std::move(mock_lookup));
+  ScopeMetricsContext metrics_context;
+  RequestContext request_context(metrics_context);
+  FunctionBindingPayload<RequestContext> payload{io, request_context};
+  (*run_query_hook)(payload);
+  EXPECT_EQ(io.output_string(), "2");
+  EXPECT_FALSE(io.has_output_list_of_string());
+}
+
 TEST_F(RunQueryHookTest, RunQueryClientReturnsError) {
   std::string query = "Q";
   auto mock_lookup = std::make_unique<MockLookup>();
@@ -98,5 +118,70 @@ TEST_F(RunQueryHookTest, InputIsNotString) {
           {R"({"code":3,"message":"runQuery input must be a string"})"}));
 }
 
+TEST_F(RunQueryHookTest, ApproxCardinalityReturnsEstimate) {
+  auto mock_lookup = std::make_unique<MockLookup>();
+  EXPECT_CALL(*mock_lookup, ApproxCardinality(_, "A & B"))
+      .WillOnce(Return(1234));
+
+  FunctionBindingIoProto io;
+  TextFormat::ParseFromString(R"pb(input_string: "A & B")pb", &io);
+  auto run_query_hook = RunQueryHook::Create();
+  run_query_hook->FinishInit(std::move(mock_lookup));
+  ScopeMetricsContext metrics_context;
+  RequestContext request_context(metrics_context);
+  FunctionBindingPayload<RequestContext> payload{io, request_context};
+  run_query_hook->ApproxCardinality(payload);
+  EXPECT_EQ(io.output_string(), "1234");
+}
+
+TEST_F(RunQueryHookTest, ApproxCardinalityReturnsError) {
+  auto mock_lookup = std::make_unique<MockLookup>();
+  EXPECT_CALL(*mock_lookup, ApproxCardinality(_, "A &"))
+      .WillOnce(Return(absl::InvalidArgumentError("Parsing error")));
+
+  FunctionBindingIoProto io;
+  TextFormat::ParseFromString(R"pb(input_string: "A &")pb", &io);
+  auto run_query_hook = RunQueryHook::Create();
+  run_query_hook->FinishInit(std::move(mock_lookup));
+  ScopeMetricsContext metrics_context;
+  RequestContext request_context(metrics_context);
+  FunctionBindingPayload<RequestContext> payload{io, request_context};
+  run_query_hook->ApproxCardinality(payload);
+  EXPECT_EQ(io.output_string(), R"({"code":3,"message":"Parsing error"})");
+}
+
+TEST_F(RunQueryHookTest, GetSetsContainingReturnsKeys) {
+  auto mock_lookup = std::make_unique<MockLookup>();
+  EXPECT_CALL(*mock_lookup, GetSetsContaining(_, "ad1"))
+      .WillOnce(Return(std::vector<std::string>{"audience:a", "audience:b"}));
+
+  FunctionBindingIoProto io;
+  TextFormat::ParseFromString(R"pb(input_string: "ad1")pb", &io);
+  auto run_query_hook = RunQueryHook::Create();
+  run_query_hook->FinishInit(std::move(mock_lookup));
+  ScopeMetricsContext metrics_context;
+  RequestContext request_context(metrics_context);
+  FunctionBindingPayload<RequestContext> payload{io, request_context};
+  run_query_hook->GetSetsContaining(payload);
+  EXPECT_THAT(io.output_list_of_string().data(),
+              testing::ElementsAre("audience:a", "audience:b"));
+}
+
+TEST_F(RunQueryHookTest, GetSetsContainingReturnsError) {
+  auto mock_lookup = std::make_unique<MockLookup>();
+  EXPECT_CALL(*mock_lookup, GetSetsContaining(_, "ad1"))
+      .WillOnce(Return(absl::UnimplementedError("No index")));
+
+  FunctionBindingIoProto io;
+  TextFormat::ParseFromString(R"pb(input_string: "ad1")pb", &io);
+  auto run_query_hook = RunQueryHook::Create();
+  run_query_hook->FinishInit(std::move(mock_lookup));
+  ScopeMetricsContext metrics_context;
+  RequestContext request_context(metrics_context);
+  FunctionBindingPayload<RequestContext> payload{io, request_context};
+  run_query_hook->GetSetsContaining(payload);
+  EXPECT_EQ(io.output_string(), R"({"code":12,"message":"No index"})");
+}
+
 }  // namespace
 }  // namespace kv_server
@@ -17,6 +17,7 @@
 #ifndef COMPONENTS_UDF_MOCKS_H_
 #define COMPONENTS_UDF_MOCKS_H_
 
+#include <optional>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -37,9 +38,21 @@ class MockUdfClient : public UdfClient {
               (RequestContext, UDFExecutionMetadata&&,
                const google::protobuf::RepeatedPtrField<UDFArgument>&),
               (const, override));
+  MOCK_METHOD((absl::Status), ExecuteCodeAsync,
+              (RequestContext, UDFExecutionMetadata&&,
+               const google::protobuf::RepeatedPtrField<UDFArgument>&,
+               ExecuteCodeCallback),
+              (const, override));
+  MOCK_METHOD((std::vector<absl::StatusOr<std::string>>), ExecuteCodeBatch,
+              (RequestContext, std::vector<Invocation>), (const, override));
   MOCK_METHOD((absl::Status), Stop, (), (override));
   MOCK_METHOD((absl::Status), SetCodeObject, (CodeConfig), (override));
+  MOCK_METHOD((absl::Status), SetCodeObjectAsync, (CodeConfig), (override));
+  MOCK_METHOD((absl::Status), WaitForCodeObjectLoads, (absl::Duration),
+              (override));
   MOCK_METHOD((absl::Status), SetWasmCodeObject, (CodeConfig), (override));
+  MOCK_METHOD((std::optional<int64_t>), GetCacheableCodeObjectId, (),
+              (const, override));
 };
 
 }  // namespace kv_server
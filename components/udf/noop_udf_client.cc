@@ -41,6 +41,14 @@ class NoopUdfClientImpl : public UdfClient {
     return "";
   }
 
+  absl::Status ExecuteCodeAsync(
+      RequestContext request_context, UDFExecutionMetadata&&,
+      const google::protobuf::RepeatedPtrField<UDFArgument>& arguments,
+      ExecuteCodeCallback on_done) const {
+    on_done("");
+    return absl::OkStatus();
+  }
+
   absl::Status Stop() { return absl::OkStatus(); }
 
   absl::Status SetCodeObject(CodeConfig code_config) {
@@ -14,9 +14,13 @@
 
 #include "components/udf/udf_client.h"
 
+#include <algorithm>
+#include <atomic>
 #include <functional>
 #include <memory>
+#include <optional>
 #include <string>
+#include <thread>
 #include <tuple>
 #include <utility>
 #include <vector>
@@ -24,10 +28,19 @@
 #include "absl/flags/flag.h"
 #include "absl/log/log.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/escaping.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/synchronization/notification.h"
 #include "absl/time/time.h"
+#include "components/telemetry/server_definition.h"
+#include "components/util/request_tracing.h"
 #include "google/protobuf/util/json_util.h"
+#include "nlohmann/json.hpp"
+#include "public/udf/binary_udf_arguments.pb.h"
 #include "src/roma/config/config.h"
 #include "src/roma/interface/roma.h"
 #include "src/roma/roma_service/roma_service.h"
@@ -44,6 +57,13 @@ using google::scp::roma::ResponseObject;
 using google::scp::roma::sandbox::roma_service::RomaService;
 
 constexpr absl::Duration kCodeUpdateTimeout = absl::Seconds(1);
+// Code objects loaded in the background don't hold up anything, so large ones
+// get longer to compile.
+constexpr absl::Duration kBackgroundCodeUpdateTimeout = absl::Minutes(1);
+// A code object that fails to load in the background is loaded again after
+// the delay, doubled on each attempt, until it loaded or was tried as often.
+constexpr absl::Duration kCodeLoadRetryDelay = absl::Seconds(1);
+constexpr int kMaxCodeLoadAttempts = 4;
 
 // Roma IDs and version numbers are required for execution.
 // We do not currently make use of IDs or the code version number, set them to
@@ -52,96 +72,328 @@ constexpr char kCodeObjectId[] = "id";
 constexpr char kInvocationRequestId[] = "id";
 constexpr int kUdfInterfaceVersion = 1;
 
+// Handler that `ExecuteCodeBatch` calls, see `BatchHandlerJs`.
+constexpr char kBatchHandlerName[] = "__kvServerBatchHandler";
+
+// Shared by the UDF clients of the process, see `GetUdfExecutionStats`.
+std::atomic<int64_t> udf_executions_in_flight = 0;
+std::atomic<int> udf_num_workers = 0;
+
+absl::StatusOr<std::string> ToJsonInput(const UDFArgument& arg) {
+  const google::protobuf::Message* arg_data;
+  if (arg.tags().values().empty()) {
+    arg_data = &arg.data();
+  } else {
+    arg_data = &arg;
+  }
+  std::string json_arg;
+  if (const auto json_status = MessageToJsonString(*arg_data, &json_arg);
+      !json_status.ok()) {
+    return json_status;
+  }
+  return json_arg;
+}
+
+// Fills `binary_arg` with the tags and data of `arg`, returns false if they
+// aren't all strings.
+bool SetStringTagsAndData(const UDFArgument& arg,
+                          BinaryUdfArgument& binary_arg) {
+  for (const auto& tag : arg.tags().values()) {
+    if (!tag.has_string_value()) {
+      return false;
+    }
+    binary_arg.add_tags(tag.string_value());
+  }
+  if (!arg.data().has_list_value()) {
+    return false;
+  }
+  for (const auto& value : arg.data().list_value().values()) {
+    if (!value.has_string_value()) {
+      return false;
+    }
+    binary_arg.add_data(value.string_value());
+  }
+  return true;
+}
+
+// Returns a JSON string of the base64 of a serialized `BinaryUdfArgument`,
+// that Roma passes to the handler as a string.
+absl::StatusOr<std::string> ToSerializedProtoInput(const UDFArgument& arg) {
+  BinaryUdfArgument binary_arg;
+  if (!SetStringTagsAndData(arg, binary_arg)) {
+    binary_arg.Clear();
+    auto json_arg = ToJsonInput(arg);
+    if (!json_arg.ok()) {
+      return json_arg.status();
+    }
+    binary_arg.set_json(*std::move(json_arg));
+  }
+  return absl::StrCat(
+      "\"", absl::Base64Escape(binary_arg.SerializeAsString()), "\"");
+}
+
+bool IsJsIdentifier(std::string_view name) {
+  if (name.empty() || absl::ascii_isdigit(name.front())) {
+    return false;
+  }
+  return std::all_of(name.begin(), name.end(), [](char c) {
+    return absl::ascii_isalnum(c) || c == '_' || c == '$';
+  });
+}
+
+// Returns the JS of the batch handler, which is appended to the JS of code
+// objects. It calls `handler_name` with the arguments of each invocation of a
+// batch, in order, and returns the JSON output, or the error, of each.
+std::string BatchHandlerJs(std::string_view handler_name) {
+  return absl::StrCat("\nasync function ", kBatchHandlerName,
+                      "(invocations) {\n"
+                      "  const outputs = [];\n"
+                      "  for (const args of invocations) {\n"
+                      "    try {\n"
+                      "      outputs.push({output: JSON.stringify(await ",
+                      handler_name,
+                      "(...args))});\n"
+                      "    } catch (e) {\n"
+                      "      outputs.push({error: String(e)});\n"
+                      "    }\n"
+                      "  }\n"
+                      "  return outputs;\n"
+                      "}\n");
+}
+
+// Sets the outputs of the invocations at `indexes` to the ones that the batch
+// handler returned in `batch_output`, in order.
+absl::Status SplitBatchOutput(
+    std::string_view batch_output, const std::vector<size_t>& indexes,
+    std::vector<absl::StatusOr<std::string>>& outputs) {
+  const nlohmann::json json =
+      nlohmann::json::parse(batch_output, nullptr, /*allow_exceptions=*/false);
+  if (!json.is_array() || json.size() != indexes.size()) {
+    return absl::InternalError("Unexpected output of UDF batch handler.");
+  }
+  for (size_t i = 0; i < indexes.size(); ++i) {
+    const nlohmann::json& invocation_output = json[i];
+    if (const auto it = invocation_output.find("output");
+        it != invocation_output.end() && it->is_string()) {
+      outputs[indexes[i]] = it->get<std::string>();
+    } else if (const auto it = invocation_output.find("error");
+               it != invocation_output.end() && it->is_string()) {
+      outputs[indexes[i]] = absl::InternalError(
+          absl::StrCat("Error executing UDF: ", it->get<std::string>()));
+    } else {
+      outputs[indexes[i]] =
+          absl::InternalError("UDF returned a value without JSON output.");
+    }
+  }
+  return absl::OkStatus();
+}
+
 class UdfClientImpl : public UdfClient {
  public:
   explicit UdfClientImpl(
       Config<RequestContext>&& config = Config<RequestContext>(),
-      absl::Duration udf_timeout = absl::Seconds(5), int udf_min_log_level = 0)
+      absl::Duration udf_timeout = absl::Seconds(5), int udf_min_log_level = 0,
+      UdfWarmUpOptions warm_up = UdfWarmUpOptions(),
+      bool batch_executions = false)
       : udf_timeout_(udf_timeout),
-        roma_service_(std::move(config)),
-        udf_min_log_level_(udf_min_log_level) {}
+        udf_min_log_level_(udf_min_log_level),
+        warm_up_(std::move(warm_up)),
+        batch_executions_(batch_executions),
+        num_workers_(config.number_of_workers > 0
+                         ? config.number_of_workers
+                         : static_cast<int>(std::max(
+                               1u, std::thread::hardware_concurrency()))),
+        roma_service_(std::move(config)) {
+    udf_num_workers.store(num_workers_, std::memory_order_relaxed);
+  }
+
+  ~UdfClientImpl() { StopLoader(); }
 
-  // Converts the arguments into plain JSON strings to pass to Roma.
   absl::StatusOr<std::string> ExecuteCode(
       RequestContext request_context, UDFExecutionMetadata&& execution_metadata,
       const google::protobuf::RepeatedPtrField<UDFArgument>& arguments) const {
-    execution_metadata.set_udf_interface_version(kUdfInterfaceVersion);
-    std::vector<std::string> string_args;
-    string_args.reserve(arguments.size() + 1);
-    std::string json_metadata;
-    if (const auto json_status =
-            MessageToJsonString(execution_metadata, &json_metadata);
-        !json_status.ok()) {
-      return json_status;
-    }
-    string_args.push_back(json_metadata);
-
-    for (int i = 0; i < arguments.size(); ++i) {
-      const auto& arg = arguments[i];
-      const google::protobuf::Message* arg_data;
-      if (arg.tags().values().empty()) {
-        arg_data = &arg.data();
-      } else {
-        arg_data = &arg;
-      }
-      std::string json_arg;
-      if (const auto json_status = MessageToJsonString(*arg_data, &json_arg);
-          !json_status.ok()) {
-        return json_status;
-      }
-      string_args.push_back(json_arg);
+    const auto code_object = GetActiveCodeObject();
+    auto input = BuildInput(std::move(execution_metadata), arguments,
+                            code_object->argument_format);
+    if (!input.ok()) {
+      return input.status();
     }
-    return ExecuteCode(std::move(request_context), std::move(string_args));
+    return ExecuteAndWait(std::move(request_context), *std::move(input),
+                          *code_object);
   }
 
   absl::StatusOr<std::string> ExecuteCode(
       RequestContext request_context, std::vector<std::string> input) const {
-    std::shared_ptr<absl::Status> response_status =
-        std::make_shared<absl::Status>();
-    std::shared_ptr<std::string> result = std::make_shared<std::string>();
-    std::shared_ptr<absl::Notification> notification =
-        std::make_shared<absl::Notification>();
-    auto invocation_request =
-        BuildInvocationRequest(std::move(request_context), std::move(input));
-    VLOG(9) << "Executing UDF with input arg(s): "
-            << absl::StrJoin(invocation_request.input, ",");
-    const auto status = roma_service_.Execute(
-        std::make_unique<InvocationStrRequest<RequestContext>>(
-            std::move(invocation_request)),
-        [notification, response_status,
-         result](absl::StatusOr<ResponseObject> response) {
-          if (response.ok()) {
-            *result = std::move(response->resp);
-          } else {
-            response_status->Update(std::move(response.status()));
-          }
-          notification->Notify();
-        });
-    if (!status.ok()) {
-      LOG(ERROR) << "Error sending UDF for execution: " << status;
-      return status;
+    return ExecuteAndWait(std::move(request_context), std::move(input),
+                          *GetActiveCodeObject());
+  }
+
+  absl::Status ExecuteCodeAsync(
+      RequestContext request_context, UDFExecutionMetadata&& execution_metadata,
+      const google::protobuf::RepeatedPtrField<UDFArgument>& arguments,
+      ExecuteCodeCallback on_done) const {
+    const auto code_object = GetActiveCodeObject();
+    auto input = BuildInput(std::move(execution_metadata), arguments,
+                            code_object->argument_format);
+    if (!input.ok()) {
+      return input.status();
     }
+    const absl::Duration timeout = request_context.GetTimeout(udf_timeout_);
+    return Execute(std::move(request_context), *std::move(input), timeout,
+                   *code_object, std::move(on_done));
+  }
 
-    notification->WaitForNotificationWithTimeout(udf_timeout_);
-    if (!notification->HasBeenNotified()) {
-      return absl::InternalError("Timed out waiting for UDF result.");
+  // Runs the invocations as one execution of the batch handler, unless the
+  // handler of the code object can't be called from it.
+  std::vector<absl::StatusOr<std::string>> ExecuteCodeBatch(
+      RequestContext request_context,
+      std::vector<Invocation> invocations) const {
+    const auto code_object = GetActiveCodeObject();
+    if (!code_object->batchable || invocations.size() < 2) {
+      return UdfClient::ExecuteCodeBatch(std::move(request_context),
+                                         std::move(invocations));
     }
-    if (!response_status->ok()) {
-      LOG(ERROR) << "Error executing UDF: " << *response_status;
-      return *response_status;
+    std::vector<absl::StatusOr<std::string>> outputs(invocations.size());
+    // Indexes of the invocations in the batch, those with valid arguments.
+    std::vector<size_t> batched;
+    // A JSON array of the argument arrays of the invocations.
+    std::string batch_input = "[";
+    for (size_t i = 0; i < invocations.size(); ++i) {
+      auto input = BuildInput(std::move(invocations[i].execution_metadata),
+                              *invocations[i].arguments,
+                              code_object->argument_format);
+      if (!input.ok()) {
+        outputs[i] = input.status();
+        continue;
+      }
+      absl::StrAppend(&batch_input, batched.empty() ? "[" : ",[",
+                      absl::StrJoin(*input, ","), "]");
+      batched.push_back(i);
     }
-    return *result;
+    if (batched.empty()) {
+      return outputs;
+    }
+    batch_input.push_back(']');
+    ActiveCodeObject batch_code_object = *code_object;
+    batch_code_object.handler_name = kBatchHandlerName;
+    std::vector<std::string> input;
+    input.push_back(std::move(batch_input));
+    auto batch_output = ExecuteAndWait(std::move(request_context),
+                                       std::move(input), batch_code_object);
+    absl::Status status = batch_output.status();
+    if (batch_output.ok()) {
+      status = SplitBatchOutput(*batch_output, batched, outputs);
+    }
+    if (!status.ok()) {
+      for (const size_t i : batched) {
+        outputs[i] = status;
+      }
+    }
+    return outputs;
   }
+
   absl::Status Init() { return roma_service_.Init(); }
 
-  absl::Status Stop() { return roma_service_.Stop(); }
+  absl::Status Stop() {
+    StopLoader();
+    return roma_service_.Stop();
+  }
 
   absl::Status SetCodeObject(CodeConfig code_config) {
+    absl::MutexLock lock(&load_mutex_);
+    return LoadCodeObject(std::move(code_config), kCodeUpdateTimeout);
+  }
+
+  absl::Status SetCodeObjectAsync(CodeConfig code_config) {
+    absl::MutexLock lock(&pending_mutex_);
+    if (stopped_) {
+      return absl::FailedPreconditionError("UDF client is stopped.");
+    }
+    const int64_t newest_logical_commit_time =
+        pending_.has_value() ? pending_->code_config.logical_commit_time
+                             : GetActiveCodeObject()->logical_commit_time;
+    if (newest_logical_commit_time >= code_config.logical_commit_time) {
+      VLOG(1) << "Not updating code object. logical_commit_time "
+              << code_config.logical_commit_time
+              << " too small, should be greater than "
+              << newest_logical_commit_time;
+      return absl::OkStatus();
+    }
+    // Replaces a pending code object, including one that failed to load.
+    pending_ = PendingCodeObject{.code_config = std::move(code_config)};
+    if (!loader_.joinable()) {
+      loader_ = std::thread([this] { RunLoader(); });
+    }
+    return absl::OkStatus();
+  }
+
+  absl::Status WaitForCodeObjectLoads(absl::Duration timeout) {
+    absl::MutexLock lock(&pending_mutex_);
+    if (!pending_mutex_.AwaitWithTimeout(
+            absl::Condition(this, &UdfClientImpl::IsLoaderIdle), timeout)) {
+      return absl::DeadlineExceededError(
+          "Timed out waiting for UDF code object loads.");
+    }
+    return last_load_status_;
+  }
+
+  std::optional<int64_t> GetCacheableCodeObjectId() const {
+    const int64_t id = cacheable_code_object_id_;
+    if (id == kNotCacheable) {
+      return std::nullopt;
+    }
+    return id;
+  }
+
+  absl::Status SetWasmCodeObject(CodeConfig code_config) {
+    const auto code_object_status = SetCodeObject(std::move(code_config));
+    if (!code_object_status.ok()) {
+      return code_object_status;
+    }
+    return absl::OkStatus();
+  }
+
+ private:
+  // The code object that executions run. Replaced as a whole, so that an
+  // execution never mixes the handler of one version with another.
+  struct ActiveCodeObject {
+    std::string handler_name;
+    int64_t logical_commit_time = -1;
+    int64_t version = 1;
+    CodeConfig::ArgumentFormat argument_format =
+        CodeConfig::ArgumentFormat::kJson;
+    // Whether the code object has the batch handler.
+    bool batchable = false;
+  };
+
+  // A code object set with `SetCodeObjectAsync` that isn't loaded yet.
+  struct PendingCodeObject {
+    // Kept until the code object is loaded, to retry failed loads.
+    CodeConfig code_config;
+    // Failed loads so far.
+    int attempts = 0;
+    absl::Time retry_at = absl::InfinitePast();
+  };
+
+  std::shared_ptr<const ActiveCodeObject> GetActiveCodeObject() const
+      ABSL_LOCKS_EXCLUDED(code_mutex_) {
+    absl::ReaderMutexLock lock(&code_mutex_);
+    return active_code_object_;
+  }
+
+  // Loads `code_config` into Roma, waiting up to `compile_timeout` for every
+  // worker to compile it, warms it up, and makes it the active code object.
+  // Code objects that aren't newer than the active one are ignored.
+  absl::Status LoadCodeObject(CodeConfig code_config,
+                              absl::Duration compile_timeout)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(load_mutex_) {
     // Only update code if logical commit time is larger.
-    if (logical_commit_time_ >= code_config.logical_commit_time) {
+    const int64_t logical_commit_time =
+        GetActiveCodeObject()->logical_commit_time;
+    if (logical_commit_time >= code_config.logical_commit_time) {
       VLOG(1) << "Not updating code object. logical_commit_time "
               << code_config.logical_commit_time
-              << " too small, should be greater than " << logical_commit_time_;
+              << " too small, should be greater than " << logical_commit_time;
       return absl::OkStatus();
     }
     std::shared_ptr<absl::Status> response_status =
@@ -149,12 +401,24 @@ class UdfClientImpl : public UdfClient {
     std::shared_ptr<absl::Notification> notification =
         std::make_shared<absl::Notification>();
     VLOG(9) << "Setting UDF: " << code_config.js;
+    // Code objects of WASM alone have no JS to add the batch handler to.
+    const bool batchable = batch_executions_ && !code_config.js.empty() &&
+                           IsJsIdentifier(code_config.udf_handler_name);
+    if (batchable) {
+      absl::StrAppend(&code_config.js,
+                      BatchHandlerJs(code_config.udf_handler_name));
+    }
     CodeObject code_object =
         BuildCodeObject(std::move(code_config.js), std::move(code_config.wasm),
                         code_config.version);
     absl::Status load_status = roma_service_.LoadCodeObj(
         std::make_unique<CodeObject>(code_object),
-        [notification, response_status](absl::StatusOr<ResponseObject> resp) {
+        [notification, response_status,
+         start = absl::Now()](absl::StatusOr<ResponseObject> resp) {
+          LogIfError(KVServerContextMap()
+                         ->SafeMetric()
+                         .LogHistogram<kUdfCodeObjectCompileLatencyInMicros>(
+                             absl::ToDoubleMicroseconds(absl::Now() - start)));
           if (!resp.ok()) {
             response_status->Update(std::move(resp.status()));
           }
@@ -165,7 +429,7 @@ class UdfClientImpl : public UdfClient {
       return load_status;
     }
 
-    notification->WaitForNotificationWithTimeout(kCodeUpdateTimeout);
+    notification->WaitForNotificationWithTimeout(compile_timeout);
     if (!notification->HasBeenNotified()) {
       return absl::InternalError("Timed out setting UDF code object.");
     }
@@ -173,35 +437,322 @@ class UdfClientImpl : public UdfClient {
       LOG(ERROR) << "Error compiling UDF code object. " << *response_status;
       return *response_status;
     }
-    handler_name_ = std::move(code_config.udf_handler_name);
-    logical_commit_time_ = code_config.logical_commit_time;
-    version_ = code_config.version;
+    // Requests keep running the previous version until the new one is warm.
+    WarmUp(code_config.udf_handler_name, code_config.version,
+           code_config.argument_format);
     VLOG(5) << "Successfully set UDF code object with handler_name "
-            << handler_name_;
+            << code_config.udf_handler_name;
+    auto active_code_object =
+        std::make_shared<const ActiveCodeObject>(ActiveCodeObject{
+            .handler_name = std::move(code_config.udf_handler_name),
+            .logical_commit_time = code_config.logical_commit_time,
+            .version = code_config.version,
+            .argument_format = code_config.argument_format,
+            .batchable = batchable});
+    {
+      absl::MutexLock lock(&code_mutex_);
+      active_code_object_ = std::move(active_code_object);
+    }
+    cacheable_code_object_id_ = code_config.cache_outputs
+                                    ? code_config.logical_commit_time
+                                    : kNotCacheable;
     return absl::OkStatus();
   }
 
-  absl::Status SetWasmCodeObject(CodeConfig code_config) {
-    const auto code_object_status = SetCodeObject(std::move(code_config));
-    if (!code_object_status.ok()) {
-      return code_object_status;
+  // Loads the code objects set with `SetCodeObjectAsync` until the client
+  // stops.
+  void RunLoader() ABSL_LOCKS_EXCLUDED(pending_mutex_, load_mutex_) {
+    while (std::optional<CodeConfig> code_config = TakeCodeObjectToLoad()) {
+      const int64_t logical_commit_time = code_config->logical_commit_time;
+      absl::Status status;
+      {
+        absl::MutexLock lock(&load_mutex_);
+        status = LoadCodeObject(*std::move(code_config),
+                                kBackgroundCodeUpdateTimeout);
+      }
+      FinishLoad(logical_commit_time, std::move(status));
     }
-    return absl::OkStatus();
   }
 
- private:
+  // Waits for a pending code object to be due for loading and returns a copy
+  // of it, or nullopt once the client stops.
+  std::optional<CodeConfig> TakeCodeObjectToLoad()
+      ABSL_LOCKS_EXCLUDED(pending_mutex_) {
+    absl::MutexLock lock(&pending_mutex_);
+    while (true) {
+      // Wakes up early for a code object that replaces one backing off.
+      pending_mutex_.AwaitWithDeadline(
+          absl::Condition(this, &UdfClientImpl::HasNewCodeObjectOrStopped),
+          pending_.has_value() ? pending_->retry_at : absl::InfiniteFuture());
+      if (stopped_) {
+        return std::nullopt;
+      }
+      if (pending_.has_value() && absl::Now() >= pending_->retry_at) {
+        loading_ = true;
+        return pending_->code_config;
+      }
+    }
+  }
+
+  // Drops the pending code object with `logical_commit_time` once it loaded,
+  // or was tried too often, and schedules its retry otherwise.
+  void FinishLoad(int64_t logical_commit_time, absl::Status status)
+      ABSL_LOCKS_EXCLUDED(pending_mutex_) {
+    absl::MutexLock lock(&pending_mutex_);
+    loading_ = false;
+    last_load_status_ = status;
+    // Newer code objects replace the pending one while it loads.
+    if (!pending_.has_value() ||
+        pending_->code_config.logical_commit_time != logical_commit_time) {
+      return;
+    }
+    if (status.ok()) {
+      pending_.reset();
+      return;
+    }
+    if (++pending_->attempts >= kMaxCodeLoadAttempts) {
+      LOG(ERROR) << "Giving up loading UDF code object version "
+                 << pending_->code_config.version << " after "
+                 << pending_->attempts << " attempts: " << status;
+      pending_.reset();
+      return;
+    }
+    const absl::Duration delay =
+        kCodeLoadRetryDelay * (1 << (pending_->attempts - 1));
+    LOG(WARNING) << "Failed loading UDF code object version "
+                 << pending_->code_config.version << ", retrying in " << delay
+                 << ": " << status;
+    pending_->retry_at = absl::Now() + delay;
+  }
+
+  bool HasNewCodeObjectOrStopped() const
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(pending_mutex_) {
+    return stopped_ || (pending_.has_value() && pending_->attempts == 0);
+  }
+
+  bool IsLoaderIdle() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(pending_mutex_) {
+    return stopped_ || (!pending_.has_value() && !loading_);
+  }
+
+  // Stops the loader, after the load it is running, if any. Pending code
+  // objects are dropped.
+  void StopLoader() ABSL_LOCKS_EXCLUDED(pending_mutex_) {
+    {
+      absl::MutexLock lock(&pending_mutex_);
+      stopped_ = true;
+    }
+    // Only started before `stopped_` is set.
+    if (loader_.joinable()) {
+      loader_.join();
+    }
+  }
+
+  // Waits for the output of `Execute`, up to the timeout of the request.
+  absl::StatusOr<std::string> ExecuteAndWait(
+      RequestContext request_context, std::vector<std::string> input,
+      const ActiveCodeObject& code_object) const {
+    const absl::Duration timeout = request_context.GetTimeout(udf_timeout_);
+    std::shared_ptr<absl::StatusOr<std::string>> result =
+        std::make_shared<absl::StatusOr<std::string>>();
+    std::shared_ptr<absl::Notification> notification =
+        std::make_shared<absl::Notification>();
+    if (const auto status = Execute(
+            std::move(request_context), std::move(input), timeout, code_object,
+            [notification, result](absl::StatusOr<std::string> response) {
+              *result = std::move(response);
+              notification->Notify();
+            });
+        !status.ok()) {
+      return status;
+    }
+
+    notification->WaitForNotificationWithTimeout(timeout);
+    if (!notification->HasBeenNotified()) {
+      return absl::InternalError("Timed out waiting for UDF result.");
+    }
+    return *result;
+  }
+
+  // Converts the arguments into plain JSON strings, or serialized protos if
+  // `argument_format` says so, to pass to Roma.
+  absl::StatusOr<std::vector<std::string>> BuildInput(
+      UDFExecutionMetadata&& execution_metadata,
+      const google::protobuf::RepeatedPtrField<UDFArgument>& arguments,
+      CodeConfig::ArgumentFormat argument_format) const {
+    execution_metadata.set_udf_interface_version(kUdfInterfaceVersion);
+    std::vector<std::string> string_args;
+    string_args.reserve(arguments.size() + 1);
+    std::string json_metadata;
+    if (const auto json_status =
+            MessageToJsonString(execution_metadata, &json_metadata);
+        !json_status.ok()) {
+      return json_status;
+    }
+    string_args.push_back(json_metadata);
+
+    for (const auto& arg : arguments) {
+      auto input =
+          argument_format == CodeConfig::ArgumentFormat::kSerializedProto
+              ? ToSerializedProtoInput(arg)
+              : ToJsonInput(arg);
+      if (!input.ok()) {
+        return input.status();
+      }
+      string_args.push_back(*std::move(input));
+    }
+    return string_args;
+  }
+
+  // Sends the UDF for execution of `code_object`, with `timeout` to run.
+  // `on_done` is called from a Roma thread, with the output of the UDF, unless
+  // an error is returned. Requests that are cancelled or past their deadline,
+  // which get no time, aren't executed. The span of a traced execution, which
+  // includes its time in the queue of Roma, is the parent of the spans of its
+  // hooks.
+  absl::Status Execute(RequestContext request_context,
+                       std::vector<std::string> input, absl::Duration timeout,
+                       const ActiveCodeObject& code_object,
+                       ExecuteCodeCallback on_done) const {
+    if (timeout <= absl::ZeroDuration()) {
+      return absl::DeadlineExceededError(
+          "Request was cancelled or is past its deadline.");
+    }
+    RequestSpan span = request_context.StartSpan("UdfExecution");
+    if (span.recording()) {
+      request_context.SetTraceContext(span.context());
+      on_done = [span = std::move(span), on_done = std::move(on_done)](
+                    absl::StatusOr<std::string> output) mutable {
+        span.SetStatus(output.status());
+        span.End();
+        on_done(std::move(output));
+      };
+    }
+    return Send(BuildInvocationRequest(std::move(request_context),
+                                       std::move(input), timeout,
+                                       code_object.handler_name,
+                                       code_object.version),
+                std::move(on_done));
+  }
+
+  // Sends the invocation to Roma. `on_done` is called as by `Execute`.
+  absl::Status Send(InvocationStrRequest<RequestContext> invocation_request,
+                    ExecuteCodeCallback on_done) const {
+    VLOG(9) << "Executing UDF with input arg(s): "
+            << absl::StrJoin(invocation_request.input, ",");
+    udf_executions_in_flight.fetch_add(1, std::memory_order_relaxed);
+    const auto status = roma_service_.Execute(
+        std::make_unique<InvocationStrRequest<RequestContext>>(
+            std::move(invocation_request)),
+        [on_done = std::move(on_done), start = absl::Now()](
+            absl::StatusOr<ResponseObject> response) mutable {
+          udf_executions_in_flight.fetch_sub(1, std::memory_order_relaxed);
+          LogIfError(KVServerContextMap()
+                         ->SafeMetric()
+                         .LogHistogram<kUdfExecutionLatencyInMicros>(
+                             absl::ToDoubleMicroseconds(absl::Now() - start)));
+          if (!response.ok()) {
+            LOG(ERROR) << "Error executing UDF: " << response.status();
+            on_done(std::move(response).status());
+            return;
+          }
+          on_done(std::move(response->resp));
+        });
+    if (!status.ok()) {
+      udf_executions_in_flight.fetch_sub(1, std::memory_order_relaxed);
+      LOG(ERROR) << "Error sending UDF for execution: " << status;
+    }
+    return status;
+  }
+
   InvocationStrRequest<RequestContext> BuildInvocationRequest(
-      RequestContext request_context, std::vector<std::string> input) const {
+      RequestContext request_context, std::vector<std::string> input,
+      absl::Duration timeout, std::string handler_name,
+      int64_t version) const {
     return {.id = kInvocationRequestId,
-            .version_string = absl::StrCat("v", version_),
-            .handler_name = handler_name_,
+            .version_string = absl::StrCat("v", version),
+            .handler_name = std::move(handler_name),
             .tags = {{std::string(kTimeoutDurationTag),
-                      FormatDuration(udf_timeout_)}},
+                      FormatDuration(timeout)}},
             .input = std::move(input),
             .metadata = std::move(request_context),
             .min_log_level = absl::LogSeverity(udf_min_log_level_)};
   }
 
+  // Runs the warm-up rounds of the code object loaded with `version`, and logs
+  // how much longer its first round took than its last. Failed executions
+  // warm the code object up too, so they don't stop the warm-up.
+  void WarmUp(const std::string& handler_name, int64_t version,
+              CodeConfig::ArgumentFormat argument_format) {
+    if (warm_up_.rounds <= 0) {
+      return;
+    }
+    google::protobuf::RepeatedPtrField<UDFArgument> arguments;
+    *arguments.Add() = warm_up_.argument;
+    const auto input =
+        BuildInput(UDFExecutionMetadata(), arguments, argument_format);
+    if (!input.ok()) {
+      LOG(ERROR) << "Not warming up UDF code object: " << input.status();
+      return;
+    }
+    absl::Duration first_round;
+    absl::Duration last_round;
+    for (int round = 0; round < warm_up_.rounds; ++round) {
+      const absl::Time start = absl::Now();
+      struct RoundState {
+        absl::Mutex mutex;
+        int pending ABSL_GUARDED_BY(mutex) = 0;
+        absl::Status status ABSL_GUARDED_BY(mutex);
+      };
+      auto state = std::make_shared<RoundState>();
+      for (int i = 0; i < num_workers_; ++i) {
+        // Kept alive by the callback, as the execution may outlive the round.
+        auto metrics_context = std::make_shared<ScopeMetricsContext>();
+        {
+          absl::MutexLock lock(&state->mutex);
+          ++state->pending;
+        }
+        const auto status = Send(
+            BuildInvocationRequest(RequestContext(*metrics_context), *input,
+                                   udf_timeout_, handler_name, version),
+            [state, metrics_context](absl::StatusOr<std::string> output) {
+              absl::MutexLock lock(&state->mutex);
+              --state->pending;
+              state->status.Update(output.status());
+            });
+        if (!status.ok()) {
+          absl::MutexLock lock(&state->mutex);
+          --state->pending;
+          state->status.Update(status);
+        }
+      }
+      absl::MutexLock lock(&state->mutex);
+      if (!state->mutex.AwaitWithTimeout(
+              absl::Condition(
+                  +[](int* pending) { return *pending == 0; },
+                  &state->pending),
+              udf_timeout_)) {
+        LOG(WARNING) << "Timed out warming up UDF code object version "
+                     << version << " after " << round << " round(s)";
+        return;
+      }
+      if (!state->status.ok()) {
+        LOG_FIRST_N(WARNING, 10)
+            << "UDF warm-up execution failed: " << state->status;
+      }
+      (round == 0 ? first_round : last_round) = absl::Now() - start;
+    }
+    LOG(INFO) << "Warmed up UDF code object version " << version << " in "
+              << warm_up_.rounds << " round(s), first round took "
+              << first_round << ", last round took " << last_round;
+    if (warm_up_.rounds > 1) {
+      LogIfError(KVServerContextMap()
+                     ->SafeMetric()
+                     .LogHistogram<kUdfColdExecutionPenaltyInMicros>(
+                         absl::ToDoubleMicroseconds(std::max(
+                             first_round - last_round, absl::ZeroDuration()))));
+    }
+  }
+
   CodeObject BuildCodeObject(std::string js, std::string wasm,
                              int64_t version) {
     return {.id = kCodeObjectId,
@@ -210,11 +761,30 @@ class UdfClientImpl : public UdfClient {
             .wasm = std::move(wasm)};
   }
 
-  std::string handler_name_;
-  int64_t logical_commit_time_ = -1;
-  int64_t version_ = 1;
+  // Serializes the loads of code objects, synchronous or not.
+  absl::Mutex load_mutex_ ABSL_ACQUIRED_BEFORE(code_mutex_);
+  mutable absl::Mutex code_mutex_;
+  std::shared_ptr<const ActiveCodeObject> active_code_object_
+      ABSL_GUARDED_BY(code_mutex_) = std::make_shared<const ActiveCodeObject>();
+  absl::Mutex pending_mutex_ ABSL_ACQUIRED_BEFORE(code_mutex_);
+  std::optional<PendingCodeObject> pending_ ABSL_GUARDED_BY(pending_mutex_);
+  // Whether the loader is loading a copy of `pending_`.
+  bool loading_ ABSL_GUARDED_BY(pending_mutex_) = false;
+  absl::Status last_load_status_ ABSL_GUARDED_BY(pending_mutex_);
+  bool stopped_ ABSL_GUARDED_BY(pending_mutex_) = false;
+  // Started by the first `SetCodeObjectAsync`.
+  std::thread loader_;
+  // The logical commit time of the code object, which only increases, if its
+  // outputs can be cached. Read by executions without a lock.
+  static constexpr int64_t kNotCacheable = -1;
+  std::atomic<int64_t> cacheable_code_object_id_ = kNotCacheable;
   const absl::Duration udf_timeout_;
   int udf_min_log_level_;
+  const UdfWarmUpOptions warm_up_;
+  // Whether code objects get the batch handler that `ExecuteCodeBatch` runs.
+  const bool batch_executions_;
+  // Number of Roma workers. Roma starts one per CPU if it isn't configured.
+  const int num_workers_;
   // Per b/299667930, RomaService has been extended to support metadata storage
   // as a side effect of RomaService::Execute(), making it no longer const.
   // However, UDFClient::ExecuteCode() remains logically const, so RomaService
@@ -229,9 +799,10 @@ class UdfClientImpl : public UdfClient {
 
 absl::StatusOr<std::unique_ptr<UdfClient>> UdfClient::Create(
     Config<RequestContext>&& config, absl::Duration udf_timeout,
-    int udf_min_log_level) {
+    int udf_min_log_level, UdfWarmUpOptions warm_up, bool batch_executions) {
   auto udf_client = std::make_unique<UdfClientImpl>(
-      std::move(config), udf_timeout, udf_min_log_level);
+      std::move(config), udf_timeout, udf_min_log_level, std::move(warm_up),
+      batch_executions);
   const auto init_status = udf_client->Init();
   if (!init_status.ok()) {
     return init_status;
@@ -239,4 +810,10 @@ absl::StatusOr<std::unique_ptr<UdfClient>> UdfClient::Create(
   return udf_client;
 }
 
+UdfExecutionStats GetUdfExecutionStats() {
+  return {
+      .in_flight = udf_executions_in_flight.load(std::memory_order_relaxed),
+      .num_workers = udf_num_workers.load(std::memory_order_relaxed)};
+}
+
 }  // namespace kv_server
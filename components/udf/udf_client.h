@@ -17,12 +17,17 @@
 #ifndef COMPONENTS_UDF_UDF_CLIENT_H_
 #define COMPONENTS_UDF_UDF_CLIENT_H_
 
+#include <cstdint>
 #include <memory>
+#include <optional>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "absl/functional/any_invocable.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/time/time.h"
 #include "components/telemetry/server_definition.h"
 #include "components/udf/code_config.h"
 #include "components/util/request_context.h"
@@ -33,6 +38,18 @@
 
 namespace kv_server {
 
+// Synthetic executions that every new code object runs before it serves
+// requests. The first executions of a code object on a Roma worker compile it
+// and fill its inline caches, which makes them much slower than later ones.
+struct UdfWarmUpOptions {
+  // Rounds of warm-up executions, each of as many concurrent executions as
+  // there are Roma workers. 0 disables warm-up.
+  int rounds = 0;
+  // Argument that the handler is called with during warm-up, after execution
+  // metadata without any fields set.
+  UDFArgument argument;
+};
+
 // Client to execute UDF
 class UdfClient {
  public:
@@ -52,21 +69,95 @@ class UdfClient {
       const google::protobuf::RepeatedPtrField<UDFArgument>& arguments)
       const = 0;
 
+  // Called with the output of an asynchronous UDF execution, or its error.
+  using ExecuteCodeCallback =
+      absl::AnyInvocable<void(absl::StatusOr<std::string>)>;
+
+  // Same as `ExecuteCode`, but returns once the UDF is sent for execution,
+  // without waiting for it. Unless an error is returned, `on_done` is called
+  // exactly once, from a Roma thread, when the UDF finishes or times out.
+  virtual absl::Status ExecuteCodeAsync(
+      RequestContext request_context, UDFExecutionMetadata&& execution_metadata,
+      const google::protobuf::RepeatedPtrField<UDFArgument>& arguments,
+      ExecuteCodeCallback on_done) const = 0;
+
+  // One execution of `ExecuteCodeBatch`. `arguments` must outlive the call.
+  struct Invocation {
+    UDFExecutionMetadata execution_metadata;
+    const google::protobuf::RepeatedPtrField<UDFArgument>* arguments = nullptr;
+  };
+
+  // Executes the UDF once per invocation, all on behalf of the same request,
+  // and returns their outputs or errors in order. An implementation may run
+  // the invocations as one execution of the handler, to pay the cost of
+  // sending an execution to Roma once; the invocations then share the timeout
+  // of the request, and each waits for the ones before it.
+  virtual std::vector<absl::StatusOr<std::string>> ExecuteCodeBatch(
+      RequestContext request_context,
+      std::vector<Invocation> invocations) const {
+    std::vector<absl::StatusOr<std::string>> outputs;
+    outputs.reserve(invocations.size());
+    for (auto& invocation : invocations) {
+      outputs.push_back(ExecuteCode(request_context,
+                                    std::move(invocation.execution_metadata),
+                                    *invocation.arguments));
+    }
+    return outputs;
+  }
+
   virtual absl::Status Stop() = 0;
 
   // Sets the code object that will be used for UDF execution
   virtual absl::Status SetCodeObject(CodeConfig code_config) = 0;
 
+  // Same as `SetCodeObject`, but returns once the code object is queued for
+  // loading, without waiting for Roma to compile it. The code object is
+  // compiled and warmed up on a background thread, and replaces the current
+  // one once every worker has it, so executions keep running the current one
+  // until then. A load that fails is retried from memory with backoff a few
+  // times, unless a newer code object is set meanwhile.
+  virtual absl::Status SetCodeObjectAsync(CodeConfig code_config) {
+    return SetCodeObject(std::move(code_config));
+  }
+
+  // Blocks until the code objects set with `SetCodeObjectAsync` are loaded or
+  // given up on, or `timeout` passes. Returns the status of the last load.
+  virtual absl::Status WaitForCodeObjectLoads(absl::Duration timeout) {
+    return absl::OkStatus();
+  }
+
   // Sets the WASM code object that will be used for UDF execution
   virtual absl::Status SetWasmCodeObject(CodeConfig code_config) = 0;
 
+  // Returns an id of the code object that changes whenever the code object
+  // does, if the code object allows its outputs to be cached, see
+  // `CodeConfig::cache_outputs`.
+  virtual std::optional<int64_t> GetCacheableCodeObjectId() const {
+    return std::nullopt;
+  }
+
   // Creates a UDF executor. This calls Roma::Init, which forks.
+  // `ExecuteCodeBatch` only runs invocations as one execution if
+  // `batch_executions` is set, which adds a batch handler to every JS code
+  // object.
   static absl::StatusOr<std::unique_ptr<UdfClient>> Create(
       google::scp::roma::Config<RequestContext>&& config =
           google::scp::roma::Config<RequestContext>(),
-      absl::Duration udf_timeout = absl::Seconds(5), int udf_min_log_level = 0);
+      absl::Duration udf_timeout = absl::Seconds(5), int udf_min_log_level = 0,
+      UdfWarmUpOptions warm_up = UdfWarmUpOptions(),
+      bool batch_executions = false);
 };
 
+struct UdfExecutionStats {
+  // UDF executions sent to Roma that haven't finished yet.
+  int64_t in_flight = 0;
+  // Roma workers that run the executions.
+  int num_workers = 0;
+};
+
+// Returns the stats of the UDF executions of the UDF clients of the process.
+UdfExecutionStats GetUdfExecutionStats();
+
 }  // namespace kv_server
 
 #endif  // COMPONENTS_UDF_UDF_CLIENT_H_
@@ -15,13 +15,19 @@
 #include "components/udf/udf_client.h"
 
 #include <fstream>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <tuple>
 #include <utility>
 #include <vector>
 
 #include "absl/log/scoped_mock_log.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/escaping.h"
+#include "absl/strings/strip.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/time.h"
 #include "components/internal_server/mocks.h"
 #include "components/udf/code_config.h"
 #include "components/udf/hooks/get_values_hook.h"
@@ -32,6 +38,7 @@
 #include "google/protobuf/text_format.h"
 #include "gtest/gtest.h"
 #include "public/query/v2/get_values_v2.pb.h"
+#include "public/udf/binary_udf_arguments.pb.h"
 #include "public/udf/constants.h"
 #include "src/roma/config/config.h"
 #include "src/roma/interface/roma.h"
@@ -46,10 +53,13 @@ using testing::Return;
 namespace kv_server {
 namespace {
 
-absl::StatusOr<std::unique_ptr<UdfClient>> CreateUdfClient() {
+absl::StatusOr<std::unique_ptr<UdfClient>> CreateUdfClient(
+    bool batch_executions = false) {
   Config<RequestContext> config;
   config.number_of_workers = 1;
-  return UdfClient::Create(std::move(config));
+  return UdfClient::Create(std::move(config), absl::Seconds(5),
+                           /*udf_min_log_level=*/0, UdfWarmUpOptions(),
+                           batch_executions);
 }
 
 class UdfClientTest : public ::testing::Test {
@@ -85,6 +95,45 @@ TEST_F(UdfClientTest, JsCallSucceeds) {
   EXPECT_TRUE(stop.ok());
 }
 
+TEST_F(UdfClientTest, CacheableCodeObjectChangesItsId) {
+  auto udf_client = CreateUdfClient();
+  EXPECT_TRUE(udf_client.ok());
+  EXPECT_EQ(udf_client.value()->GetCacheableCodeObjectId(), std::nullopt);
+
+  ASSERT_TRUE(udf_client.value()
+                  ->SetCodeObject(CodeConfig{
+                      .js = "hello = () => 'Hello world!';",
+                      .udf_handler_name = "hello",
+                      .logical_commit_time = 1,
+                      .version = 1,
+                      .cache_outputs = true,
+                  })
+                  .ok());
+  EXPECT_EQ(udf_client.value()->GetCacheableCodeObjectId(), 1);
+  ASSERT_TRUE(udf_client.value()
+                  ->SetCodeObject(CodeConfig{
+                      .js = "hello = () => 'Hello again!';",
+                      .udf_handler_name = "hello",
+                      .logical_commit_time = 2,
+                      .version = 1,
+                      .cache_outputs = true,
+                  })
+                  .ok());
+  EXPECT_EQ(udf_client.value()->GetCacheableCodeObjectId(), 2);
+  ASSERT_TRUE(udf_client.value()
+                  ->SetCodeObject(CodeConfig{
+                      .js = "hello = () => Math.random();",
+                      .udf_handler_name = "hello",
+                      .logical_commit_time = 3,
+                      .version = 1,
+                  })
+                  .ok());
+  EXPECT_EQ(udf_client.value()->GetCacheableCodeObjectId(), std::nullopt);
+
+  absl::Status stop = udf_client.value()->Stop();
+  EXPECT_TRUE(stop.ok());
+}
+
 TEST_F(UdfClientTest, RepeatedJsCallsSucceed) {
   auto udf_client = CreateUdfClient();
   EXPECT_TRUE(udf_client.ok());
@@ -111,6 +160,28 @@ TEST_F(UdfClientTest, RepeatedJsCallsSucceed) {
   EXPECT_TRUE(stop.ok());
 }
 
+TEST_F(UdfClientTest, CancelledRequestIsNotExecuted) {
+  auto udf_client = CreateUdfClient();
+  EXPECT_TRUE(udf_client.ok());
+
+  absl::Status code_obj_status = udf_client.value()->SetCodeObject(CodeConfig{
+      .js = "hello = () => 'Hello world!';",
+      .udf_handler_name = "hello",
+      .logical_commit_time = 1,
+      .version = 1,
+  });
+  EXPECT_TRUE(code_obj_status.ok());
+  ScopeMetricsContext metrics_context;
+  RequestContext request_context(metrics_context);
+  request_context.SetDeadline({.is_cancelled = [] { return true; }});
+  absl::StatusOr<std::string> result =
+      udf_client.value()->ExecuteCode(std::move(request_context), {});
+  EXPECT_EQ(result.status().code(), absl::StatusCode::kDeadlineExceeded);
+
+  absl::Status stop = udf_client.value()->Stop();
+  EXPECT_TRUE(stop.ok());
+}
+
 TEST_F(UdfClientTest, JsEchoCallSucceeds) {
   auto udf_client = CreateUdfClient();
   EXPECT_TRUE(udf_client.ok());
@@ -161,6 +232,179 @@ TEST_F(UdfClientTest, JsEchoCallSucceeds_SimpleUDFArg_string) {
   EXPECT_TRUE(stop.ok());
 }
 
+google::protobuf::RepeatedPtrField<UDFArgument> StringArgs(
+    std::string_view value) {
+  google::protobuf::RepeatedPtrField<UDFArgument> args;
+  args.Add()->mutable_data()->set_string_value(value);
+  return args;
+}
+
+TEST_F(UdfClientTest, ExecutesBatchInOneExecution) {
+  auto udf_client = CreateUdfClient(/*batch_executions=*/true);
+  EXPECT_TRUE(udf_client.ok());
+
+  absl::Status code_obj_status = udf_client.value()->SetCodeObject(CodeConfig{
+      .js = R"(
+        var executions = 0;
+        hello = (metadata, input) => 'Hello ' + input + ' ' + (++executions);
+      )",
+      .udf_handler_name = "hello",
+      .logical_commit_time = 1,
+      .version = 1,
+  });
+  EXPECT_TRUE(code_obj_status.ok());
+
+  const auto args_a = StringArgs("a");
+  const auto args_b = StringArgs("b");
+  std::vector<UdfClient::Invocation> invocations(2);
+  invocations[0].arguments = &args_a;
+  invocations[1].arguments = &args_b;
+  ScopeMetricsContext metrics_context;
+  const auto outputs = udf_client.value()->ExecuteCodeBatch(
+      RequestContext(metrics_context), std::move(invocations));
+  ASSERT_EQ(outputs.size(), 2);
+  ASSERT_TRUE(outputs[0].ok()) << outputs[0].status();
+  ASSERT_TRUE(outputs[1].ok()) << outputs[1].status();
+  // Both invocations ran in the same context, one after the other.
+  EXPECT_EQ(*outputs[0], R"("Hello a 1")");
+  EXPECT_EQ(*outputs[1], R"("Hello b 2")");
+
+  absl::Status stop = udf_client.value()->Stop();
+  EXPECT_TRUE(stop.ok());
+}
+
+TEST_F(UdfClientTest, AddsBatchHandlerOnlyWithBatchExecutions) {
+  for (const bool batch_executions : {false, true}) {
+    auto udf_client = CreateUdfClient(batch_executions);
+    ASSERT_TRUE(udf_client.ok());
+    absl::Status code_obj_status =
+        udf_client.value()->SetCodeObject(CodeConfig{
+            .js = "hello = (metadata, input) => typeof __kvServerBatchHandler;",
+            .udf_handler_name = "hello",
+            .logical_commit_time = 1,
+            .version = 1,
+        });
+    EXPECT_TRUE(code_obj_status.ok());
+
+    ScopeMetricsContext metrics_context;
+    RequestContext request_context(metrics_context);
+    const auto output = udf_client.value()->ExecuteCode(
+        request_context, UDFExecutionMetadata(), StringArgs("a"));
+    ASSERT_TRUE(output.ok()) << output.status();
+    EXPECT_EQ(*output, batch_executions ? R"("function")" : R"("undefined")");
+
+    absl::Status stop = udf_client.value()->Stop();
+    EXPECT_TRUE(stop.ok());
+  }
+}
+
+TEST_F(UdfClientTest, BatchReturnsErrorOfFailedInvocationOnly) {
+  auto udf_client = CreateUdfClient(/*batch_executions=*/true);
+  EXPECT_TRUE(udf_client.ok());
+
+  absl::Status code_obj_status = udf_client.value()->SetCodeObject(CodeConfig{
+      .js = R"(
+        async function hello(metadata, input) {
+          if (input === 'fail') {
+            throw new Error('failed');
+          }
+          return {echo: input};
+        }
+      )",
+      .udf_handler_name = "hello",
+      .logical_commit_time = 1,
+      .version = 1,
+  });
+  EXPECT_TRUE(code_obj_status.ok());
+
+  const auto args_fail = StringArgs("fail");
+  const auto args_ok = StringArgs("ok");
+  std::vector<UdfClient::Invocation> invocations(2);
+  invocations[0].arguments = &args_fail;
+  invocations[1].arguments = &args_ok;
+  ScopeMetricsContext metrics_context;
+  const auto outputs = udf_client.value()->ExecuteCodeBatch(
+      RequestContext(metrics_context), std::move(invocations));
+  ASSERT_EQ(outputs.size(), 2);
+  EXPECT_EQ(outputs[0].status().code(), absl::StatusCode::kInternal);
+  EXPECT_THAT(outputs[0].status().message(), testing::HasSubstr("failed"));
+  ASSERT_TRUE(outputs[1].ok()) << outputs[1].status();
+  EXPECT_EQ(*outputs[1], R"({"echo":"ok"})");
+
+  absl::Status stop = udf_client.value()->Stop();
+  EXPECT_TRUE(stop.ok());
+}
+
+TEST_F(UdfClientTest, WarmsUpCodeObjectBeforeServingIt) {
+  Config<RequestContext> config;
+  config.number_of_workers = 2;
+  UdfWarmUpOptions warm_up{.rounds = 2};
+  warm_up.argument.mutable_data()->set_string_value("WARM");
+  auto udf_client = UdfClient::Create(std::move(config), absl::Seconds(5),
+                                      /*udf_min_log_level=*/0, warm_up);
+  ASSERT_TRUE(udf_client.ok());
+
+  // Failed warm-up executions don't fail the code update.
+  absl::Status code_obj_status = udf_client.value()->SetCodeObject(CodeConfig{
+      .js = "hello = (metadata, input) => { if (input == 'WARM') throw "
+            "'warm-up'; return 'Hello world! ' + JSON.stringify(input); };",
+      .udf_handler_name = "hello",
+      .logical_commit_time = 1,
+      .version = 1,
+  });
+  EXPECT_TRUE(code_obj_status.ok());
+  EXPECT_EQ(GetUdfExecutionStats().in_flight, 0);
+  EXPECT_EQ(GetUdfExecutionStats().num_workers, 2);
+
+  google::protobuf::RepeatedPtrField<UDFArgument> args;
+  args.Add()->mutable_data()->set_string_value("ECHO");
+  ScopeMetricsContext metrics_context;
+  absl::StatusOr<std::string> result = udf_client.value()->ExecuteCode(
+      RequestContext(metrics_context), {}, args);
+  ASSERT_TRUE(result.ok()) << result.status();
+  EXPECT_EQ(*result, R"("Hello world! \"ECHO\"")");
+
+  absl::Status stop = udf_client.value()->Stop();
+  EXPECT_TRUE(stop.ok());
+}
+
+TEST_F(UdfClientTest, JsEchoCallAsyncSucceeds_SimpleUDFArg_string) {
+  auto udf_client = CreateUdfClient();
+  EXPECT_TRUE(udf_client.ok());
+
+  absl::Status code_obj_status = udf_client.value()->SetCodeObject(CodeConfig{
+      .js = "hello = (metadata, input) => 'Hello world! ' + "
+            "JSON.stringify(input);",
+      .udf_handler_name = "hello",
+      .logical_commit_time = 1,
+      .version = 1,
+  });
+  EXPECT_TRUE(code_obj_status.ok());
+
+  google::protobuf::RepeatedPtrField<UDFArgument> args;
+  args.Add([] {
+    UDFArgument arg;
+    arg.mutable_data()->set_string_value("ECHO");
+    return arg;
+  }());
+  ScopeMetricsContext metrics_context;
+  absl::Notification notification;
+  absl::StatusOr<std::string> result;
+  absl::Status execute_status = udf_client.value()->ExecuteCodeAsync(
+      RequestContext(metrics_context), {}, args,
+      [&notification, &result](absl::StatusOr<std::string> output) {
+        result = std::move(output);
+        notification.Notify();
+      });
+  ASSERT_TRUE(execute_status.ok()) << execute_status;
+  notification.WaitForNotification();
+  EXPECT_TRUE(result.ok());
+  EXPECT_EQ(*result, R"("Hello world! \"ECHO\"")");
+
+  absl::Status stop = udf_client.value()->Stop();
+  EXPECT_TRUE(stop.ok());
+}
+
 TEST_F(UdfClientTest, JsEchoCallSucceeds_SimpleUDFArg_string_tagged) {
   auto udf_client = CreateUdfClient();
   EXPECT_TRUE(udf_client.ok());
@@ -225,6 +469,85 @@ TEST_F(UdfClientTest, JsEchoCallSucceeds_SimpleUDFArg_string_tagged_list) {
   EXPECT_TRUE(stop.ok());
 }
 
+// Returns the `BinaryUdfArgument` that an echo UDF got as its input.
+BinaryUdfArgument ParseEchoedBinaryArgument(std::string_view result) {
+  BinaryUdfArgument binary_arg;
+  std::string serialized;
+  EXPECT_TRUE(absl::ConsumePrefix(&result, "\"") &&
+              absl::ConsumeSuffix(&result, "\""));
+  EXPECT_TRUE(absl::Base64Unescape(result, &serialized));
+  EXPECT_TRUE(binary_arg.ParseFromString(serialized));
+  return binary_arg;
+}
+
+TEST_F(UdfClientTest, JsEchoCallSucceeds_SerializedProtoArg) {
+  auto udf_client = CreateUdfClient();
+  EXPECT_TRUE(udf_client.ok());
+
+  absl::Status code_obj_status = udf_client.value()->SetCodeObject(CodeConfig{
+      .js = "hello = (metadata, input) => input;",
+      .udf_handler_name = "hello",
+      .logical_commit_time = 1,
+      .version = 1,
+      .argument_format = CodeConfig::ArgumentFormat::kSerializedProto,
+  });
+  EXPECT_TRUE(code_obj_status.ok());
+
+  google::protobuf::RepeatedPtrField<UDFArgument> args;
+  args.Add([] {
+    UDFArgument arg;
+    arg.mutable_tags()->add_values()->set_string_value("tag1");
+    auto* list_value = arg.mutable_data()->mutable_list_value();
+    list_value->add_values()->set_string_value("key1");
+    list_value->add_values()->set_string_value("key2");
+    return arg;
+  }());
+  ScopeMetricsContext metrics_context;
+  absl::StatusOr<std::string> result = udf_client.value()->ExecuteCode(
+      RequestContext(metrics_context), {}, args);
+  ASSERT_TRUE(result.ok()) << result.status();
+  const BinaryUdfArgument binary_arg = ParseEchoedBinaryArgument(*result);
+  EXPECT_THAT(binary_arg.tags(), testing::ElementsAre("tag1"));
+  EXPECT_THAT(binary_arg.data(), testing::ElementsAre("key1", "key2"));
+  EXPECT_EQ(binary_arg.json(), "");
+
+  absl::Status stop = udf_client.value()->Stop();
+  EXPECT_TRUE(stop.ok());
+}
+
+TEST_F(UdfClientTest, JsEchoCallSucceeds_SerializedProtoArg_struct) {
+  auto udf_client = CreateUdfClient();
+  EXPECT_TRUE(udf_client.ok());
+
+  absl::Status code_obj_status = udf_client.value()->SetCodeObject(CodeConfig{
+      .js = "hello = (metadata, input) => input;",
+      .udf_handler_name = "hello",
+      .logical_commit_time = 1,
+      .version = 1,
+      .argument_format = CodeConfig::ArgumentFormat::kSerializedProto,
+  });
+  EXPECT_TRUE(code_obj_status.ok());
+
+  google::protobuf::RepeatedPtrField<UDFArgument> args;
+  args.Add([] {
+    UDFArgument arg;
+    (*arg.mutable_data()->mutable_struct_value()->mutable_fields())["key"]
+        .set_string_value("value");
+    return arg;
+  }());
+  ScopeMetricsContext metrics_context;
+  absl::StatusOr<std::string> result = udf_client.value()->ExecuteCode(
+      RequestContext(metrics_context), {}, args);
+  ASSERT_TRUE(result.ok()) << result.status();
+  const BinaryUdfArgument binary_arg = ParseEchoedBinaryArgument(*result);
+  EXPECT_TRUE(binary_arg.tags().empty());
+  EXPECT_TRUE(binary_arg.data().empty());
+  EXPECT_EQ(binary_arg.json(), R"({"key":"value"})");
+
+  absl::Status stop = udf_client.value()->Stop();
+  EXPECT_TRUE(stop.ok());
+}
+
 TEST_F(UdfClientTest, JsEchoCallSucceeds_SimpleUDFArg_struct) {
   auto udf_client = CreateUdfClient();
   EXPECT_TRUE(udf_client.ok());
@@ -558,6 +881,84 @@ TEST_F(UdfClientTest, IgnoresCodeObjectWithSmallerCommitTime) {
   EXPECT_TRUE(stop.ok());
 }
 
+TEST_F(UdfClientTest, SetsCodeObjectAsynchronously) {
+  auto udf_client = CreateUdfClient();
+  ASSERT_TRUE(udf_client.ok());
+
+  auto status = udf_client.value()->SetCodeObjectAsync(CodeConfig{
+      .js = "hello1 = () => '1';",
+      .udf_handler_name = "hello1",
+      .logical_commit_time = 1,
+      .version = 1,
+  });
+  EXPECT_TRUE(status.ok());
+  EXPECT_TRUE(
+      udf_client.value()->WaitForCodeObjectLoads(absl::Seconds(10)).ok());
+  ScopeMetricsContext metrics_context;
+  absl::StatusOr<std::string> result =
+      udf_client.value()->ExecuteCode(RequestContext(metrics_context), {});
+  ASSERT_TRUE(result.ok());
+  EXPECT_EQ(*result, R"("1")");
+
+  status = udf_client.value()->SetCodeObjectAsync(CodeConfig{
+      .js = "hello2 = () => '2';",
+      .udf_handler_name = "hello2",
+      .logical_commit_time = 2,
+      .version = 2,
+  });
+  EXPECT_TRUE(status.ok());
+  EXPECT_TRUE(
+      udf_client.value()->WaitForCodeObjectLoads(absl::Seconds(10)).ok());
+  result = udf_client.value()->ExecuteCode(RequestContext(metrics_context), {});
+  ASSERT_TRUE(result.ok());
+  EXPECT_EQ(*result, R"("2")");
+
+  absl::Status stop = udf_client.value()->Stop();
+  EXPECT_TRUE(stop.ok());
+}
+
+TEST_F(UdfClientTest, NewerCodeObjectReplacesOneThatFailedToLoad) {
+  auto udf_client = CreateUdfClient();
+  ASSERT_TRUE(udf_client.ok());
+  auto status = udf_client.value()->SetCodeObject(CodeConfig{
+      .js = "hello1 = () => '1';",
+      .udf_handler_name = "hello1",
+      .logical_commit_time = 1,
+      .version = 1,
+  });
+  EXPECT_TRUE(status.ok());
+
+  // Doesn't compile, so it's retried until the next code object replaces it.
+  status = udf_client.value()->SetCodeObjectAsync(CodeConfig{
+      .js = "hello2 = () => {",
+      .udf_handler_name = "hello2",
+      .logical_commit_time = 2,
+      .version = 2,
+  });
+  EXPECT_TRUE(status.ok());
+  ScopeMetricsContext metrics_context;
+  absl::StatusOr<std::string> result =
+      udf_client.value()->ExecuteCode(RequestContext(metrics_context), {});
+  ASSERT_TRUE(result.ok());
+  EXPECT_EQ(*result, R"("1")");
+
+  status = udf_client.value()->SetCodeObjectAsync(CodeConfig{
+      .js = "hello3 = () => '3';",
+      .udf_handler_name = "hello3",
+      .logical_commit_time = 3,
+      .version = 3,
+  });
+  EXPECT_TRUE(status.ok());
+  EXPECT_TRUE(
+      udf_client.value()->WaitForCodeObjectLoads(absl::Seconds(10)).ok());
+  result = udf_client.value()->ExecuteCode(RequestContext(metrics_context), {});
+  ASSERT_TRUE(result.ok());
+  EXPECT_EQ(*result, R"("3")");
+
+  absl::Status stop = udf_client.value()->Stop();
+  EXPECT_TRUE(stop.ok());
+}
+
 TEST_F(UdfClientTest, CodeObjectNotSetError) {
   auto udf_client = CreateUdfClient();
   EXPECT_TRUE(udf_client.ok());
@@ -37,7 +37,13 @@ using google::scp::roma::FunctionBindingPayload;
 
 constexpr char kStringGetValuesHookJsName[] = "getValues";
 constexpr char kBinaryGetValuesHookJsName[] = "getValuesBinary";
+constexpr char kFlatGetValuesHookJsName[] = "getValuesFlat";
+constexpr char kStringGetValuesBatchHookJsName[] = "getValuesBatch";
+constexpr char kStringGetValuesAndSetsHookJsName[] = "getValuesAndSets";
+constexpr char kStringGetValuesByPrefixHookJsName[] = "getValuesByPrefix";
 constexpr char kRunQueryHookJsName[] = "runQuery";
+constexpr char kApproxCardinalityHookJsName[] = "approxCardinality";
+constexpr char kGetSetsContainingHookJsName[] = "getSetsContaining";
 
 std::unique_ptr<FunctionBindingObjectV2<RequestContext>>
 GetValuesFunctionObject(GetValuesHook& get_values_hook,
@@ -68,6 +74,63 @@ UdfConfigBuilder& UdfConfigBuilder::RegisterBinaryGetValuesHook(
   return *this;
 }
 
+UdfConfigBuilder& UdfConfigBuilder::RegisterFlatGetValuesHook(
+    GetValuesHook& get_values_hook) {
+  auto get_values_flat_function_object =
+      std::make_unique<FunctionBindingObjectV2<RequestContext>>();
+  get_values_flat_function_object->function_name = kFlatGetValuesHookJsName;
+  get_values_flat_function_object->function =
+      [&get_values_hook](FunctionBindingPayload<RequestContext>& in) {
+        get_values_hook.GetValuesFlat(in);
+      };
+  config_.RegisterFunctionBinding(std::move(get_values_flat_function_object));
+  return *this;
+}
+
+UdfConfigBuilder& UdfConfigBuilder::RegisterStringGetValuesBatchHook(
+    GetValuesHook& get_values_hook) {
+  auto get_values_batch_function_object =
+      std::make_unique<FunctionBindingObjectV2<RequestContext>>();
+  get_values_batch_function_object->function_name =
+      kStringGetValuesBatchHookJsName;
+  get_values_batch_function_object->function =
+      [&get_values_hook](FunctionBindingPayload<RequestContext>& in) {
+        get_values_hook.GetValuesBatch(in);
+      };
+  config_.RegisterFunctionBinding(std::move(get_values_batch_function_object));
+  return *this;
+}
+
+UdfConfigBuilder& UdfConfigBuilder::RegisterStringGetValuesAndSetsHook(
+    GetValuesHook& get_values_hook) {
+  auto get_values_and_sets_function_object =
+      std::make_unique<FunctionBindingObjectV2<RequestContext>>();
+  get_values_and_sets_function_object->function_name =
+      kStringGetValuesAndSetsHookJsName;
+  get_values_and_sets_function_object->function =
+      [&get_values_hook](FunctionBindingPayload<RequestContext>& in) {
+        get_values_hook.GetValuesAndSets(in);
+      };
+  config_.RegisterFunctionBinding(
+      std::move(get_values_and_sets_function_object));
+  return *this;
+}
+
+UdfConfigBuilder& UdfConfigBuilder::RegisterStringGetValuesByPrefixHook(
+    GetValuesHook& get_values_hook) {
+  auto get_values_by_prefix_function_object =
+      std::make_unique<FunctionBindingObjectV2<RequestContext>>();
+  get_values_by_prefix_function_object->function_name =
+      kStringGetValuesByPrefixHookJsName;
+  get_values_by_prefix_function_object->function =
+      [&get_values_hook](FunctionBindingPayload<RequestContext>& in) {
+        get_values_hook.GetValuesByPrefix(in);
+      };
+  config_.RegisterFunctionBinding(
+      std::move(get_values_by_prefix_function_object));
+  return *this;
+}
+
 UdfConfigBuilder& UdfConfigBuilder::RegisterRunQueryHook(
     RunQueryHook& run_query_hook) {
   auto run_query_function_object =
@@ -81,6 +144,36 @@ UdfConfigBuilder& UdfConfigBuilder::RegisterRunQueryHook(
   return *this;
 }
 
+UdfConfigBuilder& UdfConfigBuilder::RegisterApproxCardinalityHook(
+    RunQueryHook& run_query_hook) {
+  auto approx_cardinality_function_object =
+      std::make_unique<FunctionBindingObjectV2<RequestContext>>();
+  approx_cardinality_function_object->function_name =
+      kApproxCardinalityHookJsName;
+  approx_cardinality_function_object->function =
+      [&run_query_hook](FunctionBindingPayload<RequestContext>& in) {
+        run_query_hook.ApproxCardinality(in);
+      };
+  config_.RegisterFunctionBinding(
+      std::move(approx_cardinality_function_object));
+  return *this;
+}
+
+UdfConfigBuilder& UdfConfigBuilder::RegisterGetSetsContainingHook(
+    RunQueryHook& run_query_hook) {
+  auto get_sets_containing_function_object =
+      std::make_unique<FunctionBindingObjectV2<RequestContext>>();
+  get_sets_containing_function_object->function_name =
+      kGetSetsContainingHookJsName;
+  get_sets_containing_function_object->function =
+      [&run_query_hook](FunctionBindingPayload<RequestContext>& in) {
+        run_query_hook.GetSetsContaining(in);
+      };
+  config_.RegisterFunctionBinding(
+      std::move(get_sets_containing_function_object));
+  return *this;
+}
+
 UdfConfigBuilder& UdfConfigBuilder::RegisterLoggingFunction() {
   config_.SetLoggingFunction(LoggingFunction);
   return *this;
@@ -27,8 +27,29 @@ class UdfConfigBuilder {
 
   UdfConfigBuilder& RegisterBinaryGetValuesHook(GetValuesHook& get_values_hook);
 
+  // Registers `getValuesFlat`, which takes any `get_values_hook`.
+  UdfConfigBuilder& RegisterFlatGetValuesHook(GetValuesHook& get_values_hook);
+
+  // Registers `getValuesBatch`, which must use a string `get_values_hook`.
+  UdfConfigBuilder& RegisterStringGetValuesBatchHook(
+      GetValuesHook& get_values_hook);
+
+  // Registers `getValuesAndSets`, which must use a string `get_values_hook`.
+  UdfConfigBuilder& RegisterStringGetValuesAndSetsHook(
+      GetValuesHook& get_values_hook);
+
+  // Registers `getValuesByPrefix`, which must use a string `get_values_hook`.
+  UdfConfigBuilder& RegisterStringGetValuesByPrefixHook(
+      GetValuesHook& get_values_hook);
+
   UdfConfigBuilder& RegisterRunQueryHook(RunQueryHook& run_query_hook);
 
+  // Registers `approxCardinality`, which takes the `run_query_hook`.
+  UdfConfigBuilder& RegisterApproxCardinalityHook(RunQueryHook& run_query_hook);
+
+  // Registers `getSetsContaining`, which takes the `run_query_hook`.
+  UdfConfigBuilder& RegisterGetSetsContainingHook(RunQueryHook& run_query_hook);
+
   UdfConfigBuilder& RegisterLoggingFunction();
 
   UdfConfigBuilder& SetNumberOfWorkers(int number_of_workers);
@@ -0,0 +1,104 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/util/admission_controller.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace kv_server {
+
+AdmissionController::AdmissionController()
+    : AdmissionController(Options()) {}
+
+AdmissionController::AdmissionController(Options options) {
+  SetOptions(std::move(options));
+}
+
+void AdmissionController::SetOptions(Options options) {
+  absl::MutexLock lock(&mutex_);
+  limit_ = std::max(options.max_concurrency, 0);
+  served_since_backoff_ = 0;
+  enabled_ = options.max_concurrency > 0 ||
+             options.min_remaining_deadline > absl::ZeroDuration();
+  options_ = std::move(options);
+}
+
+absl::Status AdmissionController::TryAdmit(absl::Duration remaining_deadline) {
+  if (!enabled_.load(std::memory_order_relaxed)) {
+    return absl::OkStatus();
+  }
+  absl::MutexLock lock(&mutex_);
+  if (remaining_deadline < options_.min_remaining_deadline) {
+    ++num_shed_deadline_;
+    return absl::UnavailableError(
+        "Not enough time left before the deadline to serve the request");
+  }
+  if (options_.max_concurrency > 0 && in_flight_ >= static_cast<int>(limit_)) {
+    ++num_shed_over_limit_;
+    return absl::UnavailableError("Server is over its concurrency limit");
+  }
+  ++in_flight_;
+  return absl::OkStatus();
+}
+
+void AdmissionController::Release(absl::Duration latency) {
+  if (!enabled_.load(std::memory_order_relaxed)) {
+    return;
+  }
+  absl::MutexLock lock(&mutex_);
+  // Requests admitted before admission control was enabled were not counted.
+  if (in_flight_ > 0) {
+    --in_flight_;
+  }
+  if (options_.max_concurrency <= 0 ||
+      options_.latency_target <= absl::ZeroDuration()) {
+    return;
+  }
+  ++served_since_backoff_;
+  const double min_limit =
+      std::clamp(options_.min_concurrency, 1, options_.max_concurrency);
+  if (latency <= options_.latency_target) {
+    limit_ = std::min(limit_ + 1 / limit_,
+                      static_cast<double>(options_.max_concurrency));
+  } else if (served_since_backoff_ >= limit_) {
+    limit_ = std::max(limit_ * options_.backoff_ratio, min_limit);
+    served_since_backoff_ = 0;
+  }
+}
+
+int AdmissionController::limit() const {
+  absl::MutexLock lock(&mutex_);
+  return static_cast<int>(limit_);
+}
+
+int AdmissionController::in_flight() const {
+  absl::MutexLock lock(&mutex_);
+  return in_flight_;
+}
+
+AdmissionController& ServingAdmissionController() {
+  // Never destroyed, requests may be in flight at exit.
+  static AdmissionController* const controller = new AdmissionController();
+  return *controller;
+}
+
+AdmissionController& InternalLookupAdmissionController() {
+  static AdmissionController* const controller = new AdmissionController();
+  return *controller;
+}
+
+}  // namespace kv_server
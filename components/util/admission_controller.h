@@ -0,0 +1,103 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_UTIL_ADMISSION_CONTROLLER_H_
+#define COMPONENTS_UTIL_ADMISSION_CONTROLLER_H_
+
+#include <atomic>
+#include <cstdint>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/status/status.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+
+namespace kv_server {
+
+// Sheds requests before any work is done for them, when the server is already
+// serving as many requests as it can keep within their latency target, or
+// when the client would give up on the request before it could be served.
+// Shed requests fail with `UNAVAILABLE`, which clients retry, preferably on
+// another replica.
+//
+// The concurrency limit starts at `max_concurrency`. With a latency target,
+// it is adjusted with AIMD: every request served within the target raises
+// it by 1/limit, so by one per limit's worth of requests, and a request over
+// the target lowers it by `backoff_ratio`, at most once per limit's worth of
+// requests so that one slow burst is only backed off from once.
+//
+// Thread safe.
+class AdmissionController {
+ public:
+  struct Options {
+    // Most requests served at once. Zero disables the concurrency limit.
+    int max_concurrency = 0;
+    // Lower bound of the adaptive limit.
+    int min_concurrency = 1;
+    // Zero keeps the limit at `max_concurrency`.
+    absl::Duration latency_target = absl::ZeroDuration();
+    double backoff_ratio = 0.9;
+    // Requests with less time left before their deadline are shed, they
+    // would most likely be abandoned by the client before being served.
+    absl::Duration min_remaining_deadline = absl::ZeroDuration();
+  };
+
+  // Admission control is disabled until `SetOptions` enables it.
+  AdmissionController();
+  explicit AdmissionController(Options options);
+
+  void SetOptions(Options options) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Admits a request with `remaining_deadline` left before its deadline, or
+  // returns the `UNAVAILABLE` error to fail it with. Admitted requests must
+  // be released with `Release`.
+  absl::Status TryAdmit(absl::Duration remaining_deadline)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+  // Releases a request admitted by `TryAdmit` that took `latency` to serve.
+  void Release(absl::Duration latency) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  int limit() const ABSL_LOCKS_EXCLUDED(mutex_);
+  int in_flight() const ABSL_LOCKS_EXCLUDED(mutex_);
+  // Number of requests shed because of the concurrency limit, and because of
+  // their deadline.
+  int64_t num_shed_over_limit() const { return num_shed_over_limit_; }
+  int64_t num_shed_deadline() const { return num_shed_deadline_; }
+
+ private:
+  mutable absl::Mutex mutex_;
+  Options options_ ABSL_GUARDED_BY(mutex_);
+  double limit_ ABSL_GUARDED_BY(mutex_) = 0;
+  int in_flight_ ABSL_GUARDED_BY(mutex_) = 0;
+  // Requests served since the limit was last lowered.
+  int served_since_backoff_ ABSL_GUARDED_BY(mutex_) = 0;
+  // Read without the lock to skip admission when it is disabled.
+  std::atomic<bool> enabled_ = false;
+  std::atomic<int64_t> num_shed_over_limit_ = 0;
+  std::atomic<int64_t> num_shed_deadline_ = 0;
+};
+
+// Returns the admission controller of the requests served by the process.
+AdmissionController& ServingAdmissionController();
+
+// Returns the admission controller of the internal lookups served by the
+// process. They have their own limit, so that the lookups other shards make
+// to serve their requests aren't shed because of requests of this shard that
+// are waiting for lookups of their own.
+AdmissionController& InternalLookupAdmissionController();
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_UTIL_ADMISSION_CONTROLLER_H_
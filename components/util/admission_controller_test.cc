@@ -0,0 +1,87 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/util/admission_controller.h"
+
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+TEST(AdmissionControllerTest, AdmitsEverythingByDefault) {
+  AdmissionController controller;
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_TRUE(controller.TryAdmit(absl::ZeroDuration()).ok());
+  }
+  EXPECT_EQ(controller.num_shed_over_limit(), 0);
+  EXPECT_EQ(controller.num_shed_deadline(), 0);
+}
+
+TEST(AdmissionControllerTest, ShedsOverConcurrencyLimit) {
+  AdmissionController controller({.max_concurrency = 2});
+  EXPECT_TRUE(controller.TryAdmit(absl::InfiniteDuration()).ok());
+  EXPECT_TRUE(controller.TryAdmit(absl::InfiniteDuration()).ok());
+  const absl::Status status = controller.TryAdmit(absl::InfiniteDuration());
+  EXPECT_EQ(status.code(), absl::StatusCode::kUnavailable);
+  EXPECT_EQ(controller.num_shed_over_limit(), 1);
+  EXPECT_EQ(controller.in_flight(), 2);
+
+  controller.Release(absl::Milliseconds(1));
+  EXPECT_TRUE(controller.TryAdmit(absl::InfiniteDuration()).ok());
+}
+
+TEST(AdmissionControllerTest, ShedsRequestsCloseToTheirDeadline) {
+  AdmissionController controller(
+      {.min_remaining_deadline = absl::Milliseconds(5)});
+  EXPECT_EQ(controller.TryAdmit(absl::Milliseconds(1)).code(),
+            absl::StatusCode::kUnavailable);
+  EXPECT_TRUE(controller.TryAdmit(absl::Milliseconds(10)).ok());
+  EXPECT_EQ(controller.num_shed_deadline(), 1);
+  EXPECT_EQ(controller.in_flight(), 1);
+}
+
+TEST(AdmissionControllerTest, AdaptsLimitToLatencyTarget) {
+  AdmissionController controller({.max_concurrency = 100,
+                                   .min_concurrency = 10,
+                                   .latency_target = absl::Milliseconds(10),
+                                   .backoff_ratio = 0.5});
+  auto serve = [&controller](int count, absl::Duration latency) {
+    for (int i = 0; i < count; ++i) {
+      ASSERT_TRUE(controller.TryAdmit(absl::InfiniteDuration()).ok());
+      controller.Release(latency);
+    }
+  };
+  // Only backs off once for a burst of slow requests.
+  serve(100, absl::Milliseconds(20));
+  EXPECT_EQ(controller.limit(), 50);
+  serve(49, absl::Milliseconds(20));
+  EXPECT_EQ(controller.limit(), 50);
+  serve(1, absl::Milliseconds(20));
+  EXPECT_EQ(controller.limit(), 25);
+  serve(1000, absl::Milliseconds(20));
+  EXPECT_EQ(controller.limit(), 10);
+
+  // Grows back by about one per limit's worth of fast requests.
+  serve(10, absl::Milliseconds(1));
+  EXPECT_EQ(controller.limit(), 10);
+  serve(1, absl::Milliseconds(1));
+  EXPECT_EQ(controller.limit(), 11);
+  serve(100000, absl::Milliseconds(1));
+  EXPECT_EQ(controller.limit(), 100);
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -0,0 +1,98 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_UTIL_ARENA_MESSAGE_ALLOCATOR_H_
+#define COMPONENTS_UTIL_ARENA_MESSAGE_ALLOCATOR_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "google/protobuf/arena.h"
+#include "grpcpp/support/message_allocator.h"
+
+namespace kv_server {
+
+// Allocates the request and response of each call of a gRPC callback method on
+// a protobuf arena of its own. The messages and all their fields are then
+// freed at once when the call is done, instead of field by field, and calls
+// on different threads don't contend on the allocator for each field.
+//
+// The first block of each arena is sized after the arenas of the recent
+// calls, so that most calls allocate a single block.
+//
+// Thread safe. Must outlive the service it is set on.
+template <typename Request, typename Response>
+class ArenaMessageAllocator
+    : public grpc::MessageAllocator<Request, Response> {
+ public:
+  static constexpr size_t kMinStartBlockSize = 256;
+  static constexpr size_t kMaxStartBlockSize = 1 << 20;
+
+  grpc::MessageHolder<Request, Response>* AllocateMessages() override {
+    return new Holder(*this);
+  }
+
+  // Size of the first block of the arena of the next call.
+  size_t start_block_size() const {
+    return start_block_size_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  class Holder : public grpc::MessageHolder<Request, Response> {
+   public:
+    explicit Holder(ArenaMessageAllocator& allocator)
+        : allocator_(allocator), arena_(Options(allocator)) {
+      this->set_request(google::protobuf::Arena::Create<Request>(&arena_));
+      this->set_response(google::protobuf::Arena::Create<Response>(&arena_));
+    }
+
+    void Release() override {
+      allocator_.RecordSpaceUsed(arena_.SpaceUsed());
+      delete this;
+    }
+
+   private:
+    static google::protobuf::ArenaOptions Options(
+        const ArenaMessageAllocator& allocator) {
+      google::protobuf::ArenaOptions options;
+      options.start_block_size = allocator.start_block_size();
+      options.max_block_size =
+          std::max(options.max_block_size, options.start_block_size);
+      return options;
+    }
+
+    ArenaMessageAllocator& allocator_;
+    google::protobuf::Arena arena_;
+  };
+
+  // Moves the start block size an eighth of the way to `space_used`. Racing
+  // calls may drop each other's update, which only slows the adjustment down.
+  void RecordSpaceUsed(uint64_t space_used) {
+    const int64_t current = start_block_size();
+    const int64_t target = std::clamp<uint64_t>(space_used, kMinStartBlockSize,
+                                                kMaxStartBlockSize);
+    start_block_size_.store(current + (target - current) / 8,
+                            std::memory_order_relaxed);
+  }
+
+  std::atomic<size_t> start_block_size_ = kMinStartBlockSize;
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_UTIL_ARENA_MESSAGE_ALLOCATOR_H_
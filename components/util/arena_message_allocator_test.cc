@@ -0,0 +1,64 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/util/arena_message_allocator.h"
+
+#include "gtest/gtest.h"
+#include "src/google/protobuf/struct.pb.h"
+
+namespace kv_server {
+namespace {
+
+using google::protobuf::Struct;
+using google::protobuf::Value;
+using Allocator = ArenaMessageAllocator<Struct, Value>;
+
+TEST(ArenaMessageAllocatorTest, AllocatesMessagesOnArena) {
+  Allocator allocator;
+  auto* holder = allocator.AllocateMessages();
+  ASSERT_NE(holder->request(), nullptr);
+  ASSERT_NE(holder->response(), nullptr);
+  EXPECT_NE(holder->request()->GetArena(), nullptr);
+  EXPECT_EQ(holder->request()->GetArena(), holder->response()->GetArena());
+  (*holder->request()->mutable_fields())["key"].set_string_value("value");
+  holder->response()->set_string_value("value");
+  holder->Release();
+}
+
+TEST(ArenaMessageAllocatorTest, SizesArenasAfterRecentCalls) {
+  Allocator allocator;
+  EXPECT_EQ(allocator.start_block_size(), Allocator::kMinStartBlockSize);
+  size_t previous_size = allocator.start_block_size();
+  for (int i = 0; i < 20; ++i) {
+    auto* holder = allocator.AllocateMessages();
+    for (int j = 0; j < 2000; ++j) {
+      holder->response()->mutable_list_value()->add_values()->set_number_value(
+          j);
+    }
+    holder->Release();
+    EXPECT_GT(allocator.start_block_size(), previous_size);
+    previous_size = allocator.start_block_size();
+  }
+  EXPECT_LE(allocator.start_block_size(), Allocator::kMaxStartBlockSize);
+  for (int i = 0; i < 100; ++i) {
+    allocator.AllocateMessages()->Release();
+  }
+  EXPECT_LT(allocator.start_block_size(), previous_size);
+  EXPECT_GE(allocator.start_block_size(), Allocator::kMinStartBlockSize);
+}
+
+}  // namespace
+}  // namespace kv_server
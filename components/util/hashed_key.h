@@ -0,0 +1,79 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_UTIL_HASHED_KEY_H_
+#define COMPONENTS_UTIL_HASHED_KEY_H_
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+#include "absl/hash/hash.h"
+
+namespace kv_server {
+
+// A view of a key along with its `absl::Hash<std::string_view>`, computed
+// once per request so that the key filters and the tables that a key is
+// looked up in don't each hash it again.
+struct HashedKey {
+  HashedKey() = default;
+  explicit HashedKey(std::string_view key)
+      : key(key), hash(absl::Hash<std::string_view>()(key)) {}
+
+  std::string_view key;
+  size_t hash = 0;
+};
+
+// Transparent hash and equality for tables of string keys, so that a
+// `HashedKey` finds its key without being hashed again. The hash of a
+// string matches the hash of its `HashedKey`.
+struct HashedKeyHash {
+  using is_transparent = void;
+  size_t operator()(std::string_view key) const {
+    return absl::Hash<std::string_view>()(key);
+  }
+  size_t operator()(const HashedKey& key) const { return key.hash; }
+};
+struct HashedKeyEq {
+  using is_transparent = void;
+  bool operator()(std::string_view a, std::string_view b) const {
+    return a == b;
+  }
+  bool operator()(std::string_view a, const HashedKey& b) const {
+    return a == b.key;
+  }
+  bool operator()(const HashedKey& a, std::string_view b) const {
+    return a.key == b;
+  }
+  bool operator()(const HashedKey& a, const HashedKey& b) const {
+    return a.key == b.key;
+  }
+};
+
+// Returns the keys of `keys`, in its iteration order, with their hashes.
+template <typename Keys>
+std::vector<HashedKey> HashKeys(const Keys& keys) {
+  std::vector<HashedKey> hashed_keys;
+  hashed_keys.reserve(keys.size());
+  for (std::string_view key : keys) {
+    hashed_keys.emplace_back(key);
+  }
+  return hashed_keys;
+}
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_UTIL_HASHED_KEY_H_
@@ -0,0 +1,64 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/util/hashed_key.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+TEST(HashedKeyTest, HashMatchesStringHash) {
+  const HashedKey key("key");
+  EXPECT_EQ(key.key, "key");
+  EXPECT_EQ(key.hash, HashedKeyHash()(std::string_view("key")));
+  EXPECT_EQ(HashedKeyHash()(key), key.hash);
+}
+
+TEST(HashedKeyTest, FindsStringKeys) {
+  absl::flat_hash_map<std::string, int, HashedKeyHash, HashedKeyEq> map = {
+      {"key1", 1}, {"key2", 2}};
+  const auto key_iter = map.find(HashedKey("key2"));
+  ASSERT_NE(key_iter, map.end());
+  EXPECT_EQ(key_iter->second, 2);
+  EXPECT_EQ(map.find(HashedKey("key3")), map.end());
+}
+
+TEST(HashedKeyTest, KeysWithTheSameHashAreCompared) {
+  absl::flat_hash_map<std::string, int, HashedKeyHash, HashedKeyEq> map = {
+      {"key1", 1}};
+  HashedKey key("key2");
+  key.hash = HashedKey("key1").hash;
+  EXPECT_EQ(map.find(key), map.end());
+}
+
+TEST(HashedKeyTest, HashKeysKeepsOrder) {
+  const std::vector<std::string> keys = {"b", "a", "c"};
+  const std::vector<HashedKey> hashed_keys = HashKeys(keys);
+  ASSERT_EQ(hashed_keys.size(), 3);
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(hashed_keys[i].key, keys[i]);
+    EXPECT_EQ(hashed_keys[i].hash, HashedKey(keys[i]).hash);
+  }
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -0,0 +1,123 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/util/load_governor.h"
+
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+#include "absl/log/log.h"
+#include "absl/time/clock.h"
+
+namespace kv_server {
+namespace {
+// Number of samples between two computations of the p99 latency.
+constexpr size_t kSamplesPerUpdate = 64;
+}  // namespace
+
+LoadGovernor::LoadGovernor() : LoadGovernor(Options()) {}
+
+LoadGovernor::LoadGovernor(Options options) { SetOptions(std::move(options)); }
+
+void LoadGovernor::SetOptions(Options options) {
+  absl::MutexLock lock(&mutex_);
+  latencies_.clear();
+  latencies_.reserve(std::max(options.window_size, 1));
+  next_latency_ = 0;
+  serving_p99_nanos_ = 0;
+  enabled_ = options.serving_p99_target > absl::ZeroDuration();
+  options_ = std::move(options);
+}
+
+void LoadGovernor::RecordServingLatency(absl::Duration latency) {
+  if (!enabled_.load(std::memory_order_relaxed)) {
+    return;
+  }
+  absl::MutexLock lock(&mutex_);
+  const int64_t latency_nanos = absl::ToInt64Nanoseconds(latency);
+  const size_t window_size = std::max(options_.window_size, 1);
+  if (latencies_.size() < window_size) {
+    latencies_.push_back(latency_nanos);
+  } else {
+    latencies_[next_latency_] = latency_nanos;
+  }
+  next_latency_ = (next_latency_ + 1) % window_size;
+  last_sample_ = absl::Now();
+  if (next_latency_ % kSamplesPerUpdate == 0) {
+    UpdateP99();
+  }
+}
+
+void LoadGovernor::UpdateP99() {
+  std::vector<int64_t> latencies = latencies_;
+  const size_t index = latencies.size() * 99 / 100;
+  std::nth_element(latencies.begin(), latencies.begin() + index,
+                   latencies.end());
+  serving_p99_nanos_ = latencies[index];
+}
+
+bool LoadGovernor::MaybeThrottle() {
+  if (!enabled_.load(std::memory_order_relaxed)) {
+    return false;
+  }
+  absl::Duration throttle_delay;
+  {
+    absl::MutexLock lock(&mutex_);
+    if (absl::Now() - last_sample_ > options_.max_sample_age ||
+        serving_p99() <= options_.serving_p99_target) {
+      return false;
+    }
+    throttle_delay = options_.throttle_delay;
+  }
+  ++num_throttled_;
+  absl::SleepFor(throttle_delay);
+  return true;
+}
+
+LoadGovernor& DataLoadingGovernor() {
+  // Never destroyed, data loading may be running at exit.
+  static LoadGovernor* const governor = new LoadGovernor();
+  return *governor;
+}
+
+bool LowerCurrentThreadPriority(int increment) {
+  if (increment <= 0) {
+    return true;
+  }
+  // On Linux each thread has its own nice value, set through its thread id.
+  const pid_t tid = static_cast<pid_t>(syscall(SYS_gettid));
+  errno = 0;
+  const int nice = getpriority(PRIO_PROCESS, tid);
+  if (nice == -1 && errno != 0) {
+    LOG(WARNING) << "Failed to get the priority of thread " << tid << ": "
+                 << std::strerror(errno);
+    return false;
+  }
+  if (setpriority(PRIO_PROCESS, tid, nice + increment) != 0) {
+    LOG(WARNING) << "Failed to lower the priority of thread " << tid << ": "
+                 << std::strerror(errno);
+    return false;
+  }
+  return true;
+}
+
+}  // namespace kv_server
@@ -0,0 +1,98 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_UTIL_LOAD_GOVERNOR_H_
+#define COMPONENTS_UTIL_LOAD_GOVERNOR_H_
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+
+namespace kv_server {
+
+// Throttles background data loading while request serving is slow. The
+// servers record the latency of the requests they serve, and while the p99
+// latency of the latest requests is over the target, data loading waits
+// before each batch of cache writes, which leaves the cores and the cache
+// locks to the requests.
+//
+// Thread safe.
+class LoadGovernor {
+ public:
+  struct Options {
+    // Zero disables throttling.
+    absl::Duration serving_p99_target = absl::ZeroDuration();
+    // How long data loading waits before a batch of cache writes while
+    // throttled.
+    absl::Duration throttle_delay = absl::Milliseconds(5);
+    // Number of latest requests the p99 latency is computed over.
+    int window_size = 1024;
+    // The p99 latency is only trusted while requests are being served, so
+    // that a slow burst followed by no traffic doesn't throttle for good.
+    absl::Duration max_sample_age = absl::Seconds(1);
+  };
+
+  // Throttling is disabled until `SetOptions` sets a target.
+  LoadGovernor();
+  explicit LoadGovernor(Options options);
+
+  void SetOptions(Options options) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  void RecordServingLatency(absl::Duration latency)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Waits for the throttle delay if serving is over its latency target.
+  // Returns whether it waited.
+  bool MaybeThrottle() ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // The p99 latency of the latest requests served.
+  absl::Duration serving_p99() const {
+    return absl::Nanoseconds(serving_p99_nanos_.load());
+  }
+  // Number of times data loading was throttled.
+  int64_t num_throttled() const { return num_throttled_; }
+
+ private:
+  void UpdateP99() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  absl::Mutex mutex_;
+  Options options_ ABSL_GUARDED_BY(mutex_);
+  // Ring buffer of the latest latencies, in nanoseconds.
+  std::vector<int64_t> latencies_ ABSL_GUARDED_BY(mutex_);
+  size_t next_latency_ ABSL_GUARDED_BY(mutex_) = 0;
+  absl::Time last_sample_ ABSL_GUARDED_BY(mutex_) = absl::InfinitePast();
+  // Read without the lock by `RecordServingLatency` to skip the samples when
+  // throttling is disabled.
+  std::atomic<bool> enabled_ = false;
+  std::atomic<int64_t> serving_p99_nanos_ = 0;
+  std::atomic<int64_t> num_throttled_ = 0;
+};
+
+// Returns the governor of the data loading of the process.
+LoadGovernor& DataLoadingGovernor();
+
+// Adds `increment` to the nice value of the calling thread, so that the
+// scheduler favors the other threads of the process over it. Returns false
+// if the priority couldn't be changed.
+bool LowerCurrentThreadPriority(int increment);
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_UTIL_LOAD_GOVERNOR_H_
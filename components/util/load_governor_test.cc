@@ -0,0 +1,76 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/util/load_governor.h"
+
+#include "absl/time/clock.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+void RecordLatencies(LoadGovernor& governor, int count,
+                     absl::Duration latency) {
+  for (int i = 0; i < count; ++i) {
+    governor.RecordServingLatency(latency);
+  }
+}
+
+TEST(LoadGovernorTest, DisabledByDefault) {
+  LoadGovernor governor;
+  RecordLatencies(governor, 1024, absl::Seconds(1));
+  EXPECT_FALSE(governor.MaybeThrottle());
+  EXPECT_EQ(governor.num_throttled(), 0);
+}
+
+TEST(LoadGovernorTest, ThrottlesWhileServingIsOverTarget) {
+  LoadGovernor governor({.serving_p99_target = absl::Milliseconds(10),
+                         .throttle_delay = absl::Milliseconds(1),
+                         .window_size = 128});
+  RecordLatencies(governor, 128, absl::Milliseconds(1));
+  EXPECT_EQ(governor.serving_p99(), absl::Milliseconds(1));
+  EXPECT_FALSE(governor.MaybeThrottle());
+
+  // More than 1% of the latest requests are slow.
+  RecordLatencies(governor, 64, absl::Milliseconds(20));
+  EXPECT_EQ(governor.serving_p99(), absl::Milliseconds(20));
+  EXPECT_TRUE(governor.MaybeThrottle());
+  EXPECT_TRUE(governor.MaybeThrottle());
+  EXPECT_EQ(governor.num_throttled(), 2);
+
+  // The slow requests leave the window.
+  RecordLatencies(governor, 128, absl::Milliseconds(1));
+  EXPECT_FALSE(governor.MaybeThrottle());
+  EXPECT_EQ(governor.num_throttled(), 2);
+}
+
+TEST(LoadGovernorTest, DoesNotThrottleWithoutRecentRequests) {
+  LoadGovernor governor({.serving_p99_target = absl::Milliseconds(10),
+                         .throttle_delay = absl::Milliseconds(1),
+                         .window_size = 64,
+                         .max_sample_age = absl::Milliseconds(10)});
+  RecordLatencies(governor, 64, absl::Milliseconds(20));
+  absl::SleepFor(absl::Milliseconds(20));
+  EXPECT_FALSE(governor.MaybeThrottle());
+}
+
+TEST(LoadGovernorTest, LowersCurrentThreadPriority) {
+  EXPECT_TRUE(LowerCurrentThreadPriority(0));
+  EXPECT_TRUE(LowerCurrentThreadPriority(1));
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -0,0 +1,129 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/util/memory_releaser.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+#include "absl/base/call_once.h"
+#include "absl/log/log.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "tcmalloc/malloc_extension.h"
+
+namespace kv_server {
+namespace {
+
+using tcmalloc::MallocExtension;
+
+int64_t GetProperty(std::string_view name) {
+  return static_cast<int64_t>(
+      MallocExtension::GetNumericProperty(name).value_or(0));
+}
+
+int64_t ReleaseTcmallocMemory() {
+  const int64_t released_before =
+      GetProperty("tcmalloc.pageheap_unmapped_bytes");
+  MallocExtension::ReleaseMemoryToSystem(std::numeric_limits<size_t>::max());
+  // Other threads may reuse released memory meanwhile.
+  return std::max<int64_t>(
+      GetProperty("tcmalloc.pageheap_unmapped_bytes") - released_before, 0);
+}
+
+}  // namespace
+
+MemoryReleaser::MemoryReleaser() : MemoryReleaser(ReleaseTcmallocMemory) {}
+
+MemoryReleaser::MemoryReleaser(absl::AnyInvocable<int64_t()> release)
+    : release_(std::move(release)) {}
+
+void MemoryReleaser::SetOptions(Options options) {
+  if (options.background_release_bytes_per_second > 0) {
+    MallocExtension::SetBackgroundReleaseRate(
+        static_cast<MallocExtension::BytesPerSecond>(
+            options.background_release_bytes_per_second));
+  }
+  if (options.max_per_cpu_cache_bytes > 0) {
+    MallocExtension::SetMaxPerCpuCacheSize(options.max_per_cpu_cache_bytes);
+  }
+  // The background release and the resizing of the per-CPU caches only run
+  // on a thread that the binary gives tcmalloc.
+  static absl::once_flag background_thread_started;
+  absl::call_once(background_thread_started, [] {
+    if (MallocExtension::NeedsProcessBackgroundActions()) {
+      std::thread(MallocExtension::ProcessBackgroundActions).detach();
+    }
+  });
+  absl::MutexLock lock(&mutex_);
+  min_release_interval_ = options.min_release_interval;
+  enabled_ = options.min_release_interval != absl::InfiniteDuration();
+}
+
+void MemoryReleaser::Release() {
+  if (!enabled_) {
+    return;
+  }
+  absl::MutexLock lock(&mutex_);
+  ReleaseLocked();
+}
+
+void MemoryReleaser::MaybeRelease() {
+  if (!enabled_) {
+    return;
+  }
+  absl::MutexLock lock(&mutex_);
+  if (absl::Now() - last_release_ < min_release_interval_) {
+    return;
+  }
+  ReleaseLocked();
+}
+
+void MemoryReleaser::ReleaseLocked() {
+  const absl::Time start = absl::Now();
+  const int64_t released_bytes = release_();
+  last_release_ = absl::Now();
+  ++num_releases_;
+  released_bytes_ += released_bytes;
+  VLOG(1) << "Released " << released_bytes << " bytes of free memory in "
+          << last_release_ - start;
+}
+
+MemoryReleaser& ServerMemoryReleaser() {
+  // Never destroyed, cleanups may run at exit.
+  static MemoryReleaser* const releaser = new MemoryReleaser();
+  return *releaser;
+}
+
+AllocatorStats GetAllocatorStats() {
+  return AllocatorStats{
+      .in_use_bytes = GetProperty("generic.current_allocated_bytes"),
+      .resident_bytes = GetProperty("generic.physical_memory_used"),
+      .page_heap_free_bytes = GetProperty("tcmalloc.pageheap_free_bytes"),
+      .cache_free_bytes = GetProperty("tcmalloc.cpu_free") +
+                          GetProperty("tcmalloc.thread_cache_free") +
+                          GetProperty("tcmalloc.transfer_cache_free") +
+                          GetProperty("tcmalloc.central_cache_free"),
+      .released_bytes = GetProperty("tcmalloc.pageheap_unmapped_bytes"),
+  };
+}
+
+}  // namespace kv_server
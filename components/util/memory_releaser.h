@@ -0,0 +1,112 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_UTIL_MEMORY_RELEASER_H_
+#define COMPONENTS_UTIL_MEMORY_RELEASER_H_
+
+#include <atomic>
+#include <cstdint>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/functional/any_invocable.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+
+namespace kv_server {
+
+// Returns the memory that tcmalloc keeps for reuse to the OS after large
+// loads and cleanups, and tunes how much tcmalloc keeps. Otherwise the
+// resident memory stays at its peak once a snapshot is loaded or deleted
+// values are removed, which misleads memory based autoscaling.
+//
+// Every call is a no-op in binaries that aren't linked with tcmalloc.
+//
+// Thread safe.
+class MemoryReleaser {
+ public:
+  struct Options {
+    // Rate at which tcmalloc returns free memory to the OS in the
+    // background. 0 keeps the default of tcmalloc.
+    int64_t background_release_bytes_per_second = 0;
+    // Bytes that the cache of each CPU holds at most. 0 keeps the default.
+    int32_t max_per_cpu_cache_bytes = 0;
+    // Minimum interval between the releases of `MaybeRelease`. Infinite
+    // disables the releases.
+    absl::Duration min_release_interval = absl::InfiniteDuration();
+  };
+
+  // Releases are disabled until `SetOptions` enables them. `release` returns
+  // the free memory of the allocator to the OS and the number of bytes it
+  // released, tcmalloc's by default.
+  MemoryReleaser();
+  explicit MemoryReleaser(absl::AnyInvocable<int64_t()> release);
+  MemoryReleaser(const MemoryReleaser&) = delete;
+  MemoryReleaser& operator=(const MemoryReleaser&) = delete;
+
+  // Also applies the allocator settings of `options` to tcmalloc, and starts
+  // the thread that runs its background release if it needs one.
+  void SetOptions(Options options) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  bool enabled() const { return enabled_; }
+
+  // Releases the free memory now, e.g. after the initial data loading, if
+  // releases are enabled.
+  void Release() ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Releases the free memory unless the latest release was less than the
+  // minimum interval ago, e.g. after every cleanup of deleted values.
+  void MaybeRelease() ABSL_LOCKS_EXCLUDED(mutex_);
+
+  int64_t num_releases() const { return num_releases_; }
+  // Total bytes returned to the OS by the releases.
+  int64_t released_bytes() const { return released_bytes_; }
+
+ private:
+  void ReleaseLocked() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  absl::Mutex mutex_;
+  absl::AnyInvocable<int64_t()> release_ ABSL_GUARDED_BY(mutex_);
+  absl::Duration min_release_interval_ ABSL_GUARDED_BY(mutex_) =
+      absl::InfiniteDuration();
+  absl::Time last_release_ ABSL_GUARDED_BY(mutex_) = absl::InfinitePast();
+  // Read without the lock to skip `MaybeRelease` when releases are disabled.
+  std::atomic<bool> enabled_ = false;
+  std::atomic<int64_t> num_releases_ = 0;
+  std::atomic<int64_t> released_bytes_ = 0;
+};
+
+// Returns the memory releaser of the process.
+MemoryReleaser& ServerMemoryReleaser();
+
+// Memory of the process as tracked by tcmalloc. All zeros without tcmalloc.
+struct AllocatorStats {
+  // Allocated by the process and not freed.
+  int64_t in_use_bytes = 0;
+  // Resident memory held by tcmalloc, in use, free or metadata.
+  int64_t resident_bytes = 0;
+  // Free in the page heap, kept for reuse.
+  int64_t page_heap_free_bytes = 0;
+  // Free in the per-CPU, per-thread, transfer and central caches.
+  int64_t cache_free_bytes = 0;
+  // Returned to the OS and still mapped.
+  int64_t released_bytes = 0;
+};
+
+AllocatorStats GetAllocatorStats();
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_UTIL_MEMORY_RELEASER_H_
@@ -0,0 +1,83 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/util/memory_releaser.h"
+
+#include <cstdint>
+
+#include "absl/time/time.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+TEST(MemoryReleaserTest, DisabledByDefault) {
+  int num_calls = 0;
+  MemoryReleaser releaser([&num_calls]() -> int64_t {
+    ++num_calls;
+    return 10;
+  });
+  EXPECT_FALSE(releaser.enabled());
+  releaser.Release();
+  releaser.MaybeRelease();
+  EXPECT_EQ(num_calls, 0);
+  EXPECT_EQ(releaser.num_releases(), 0);
+}
+
+TEST(MemoryReleaserTest, ReleaseIgnoresInterval) {
+  int num_calls = 0;
+  MemoryReleaser releaser([&num_calls]() -> int64_t {
+    ++num_calls;
+    return 10;
+  });
+  releaser.SetOptions({.min_release_interval = absl::Hours(1)});
+  releaser.Release();
+  releaser.Release();
+  EXPECT_EQ(num_calls, 2);
+  EXPECT_EQ(releaser.num_releases(), 2);
+  EXPECT_EQ(releaser.released_bytes(), 20);
+}
+
+TEST(MemoryReleaserTest, MaybeReleaseWaitsForInterval) {
+  int num_calls = 0;
+  MemoryReleaser releaser([&num_calls]() -> int64_t {
+    ++num_calls;
+    return 10;
+  });
+  releaser.SetOptions({.min_release_interval = absl::Hours(1)});
+  releaser.MaybeRelease();
+  releaser.MaybeRelease();
+  EXPECT_EQ(num_calls, 1);
+  releaser.SetOptions({.min_release_interval = absl::ZeroDuration()});
+  releaser.MaybeRelease();
+  releaser.MaybeRelease();
+  EXPECT_EQ(num_calls, 3);
+}
+
+TEST(MemoryReleaserTest, DefaultReleaserRunsWithoutTcmalloc) {
+  MemoryReleaser releaser;
+  releaser.SetOptions({.background_release_bytes_per_second = 1 << 20,
+                       .max_per_cpu_cache_bytes = 1 << 20,
+                       .min_release_interval = absl::ZeroDuration()});
+  releaser.Release();
+  EXPECT_EQ(releaser.num_releases(), 1);
+  EXPECT_GE(releaser.released_bytes(), 0);
+  const AllocatorStats stats = GetAllocatorStats();
+  EXPECT_GE(stats.resident_bytes, 0);
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -0,0 +1,265 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/util/profiler.h"
+
+#include <signal.h>
+#include <sys/time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/base/call_once.h"
+#include "absl/base/internal/cycleclock.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/debugging/stacktrace.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "tcmalloc/malloc_extension.h"
+#include "tcmalloc/profile_marshaler.h"
+
+namespace kv_server {
+namespace {
+
+constexpr int kMaxStackDepth = 32;
+// Samples kept per CPU profile, later ones are dropped.
+constexpr int kMaxCpuSamples = 1 << 15;
+
+using Stack = std::vector<uintptr_t>;
+
+struct CpuSample {
+  int depth;
+  void* pcs[kMaxStackDepth];
+};
+
+// The CPU profile being collected, written to by the SIGPROF handler.
+struct CpuProfileState {
+  std::atomic<bool> collecting = false;
+  std::atomic<bool> recording = false;
+  std::atomic<int> num_in_handler = 0;
+  std::atomic<int> num_samples = 0;
+  CpuSample* samples = nullptr;
+};
+
+CpuProfileState cpu_profile_state;
+
+void HandleProfSignal(int, siginfo_t*, void*) {
+  const int saved_errno = errno;
+  ++cpu_profile_state.num_in_handler;
+  if (cpu_profile_state.recording) {
+    const int index = cpu_profile_state.num_samples.fetch_add(1);
+    if (index < kMaxCpuSamples) {
+      CpuSample& sample = cpu_profile_state.samples[index];
+      sample.depth =
+          absl::GetStackTrace(sample.pcs, kMaxStackDepth, /*skip_count=*/1);
+    }
+  }
+  --cpu_profile_state.num_in_handler;
+  errno = saved_errno;
+}
+
+// The handler stays installed once installed: a SIGPROF still pending when a
+// profile stops would kill the process with the default action.
+absl::Status InstallProfSignalHandler() {
+  static absl::once_flag installed;
+  static int error = 0;
+  absl::call_once(installed, [] {
+    struct sigaction action = {};
+    action.sa_sigaction = HandleProfSignal;
+    action.sa_flags = SA_RESTART | SA_SIGINFO;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGPROF, &action, nullptr) != 0) {
+      error = errno;
+    }
+  });
+  if (error != 0) {
+    return absl::ErrnoToStatus(error, "Failed installing SIGPROF handler");
+  }
+  return absl::OkStatus();
+}
+
+absl::Status SetProfTimer(int64_t period_micros) {
+  itimerval timer = {};
+  timer.it_interval.tv_sec = period_micros / 1000000;
+  timer.it_interval.tv_usec = period_micros % 1000000;
+  timer.it_value = timer.it_interval;
+  if (setitimer(ITIMER_PROF, &timer, nullptr) != 0) {
+    return absl::ErrnoToStatus(errno, "Failed setting the profiling timer");
+  }
+  return absl::OkStatus();
+}
+
+// The mappings of the process, which pprof needs to symbolize the
+// addresses of legacy profiles.
+std::string ReadProcMaps() {
+  std::ifstream stream("/proc/self/maps");
+  return std::string(std::istreambuf_iterator<char>(stream), {});
+}
+
+void AppendWord(uintptr_t word, std::string& profile) {
+  profile.append(reinterpret_cast<const char*>(&word), sizeof(word));
+}
+
+// Waits for contended mutexes, by the stack that released the mutex.
+struct ContentionProfile {
+  // Not an `absl::Mutex`, whose contention would be recorded while it's held.
+  std::mutex mutex;
+  absl::flat_hash_map<Stack, std::pair<int64_t, int64_t>> waits;
+};
+
+ContentionProfile& GetContentionProfile() {
+  static ContentionProfile* const profile = new ContentionProfile();
+  return *profile;
+}
+
+std::atomic<int> contention_sample_interval = 0;
+
+void TraceMutexWait(const char*, const void*, int64_t wait_cycles) {
+  const int sample_interval = contention_sample_interval;
+  if (sample_interval <= 0) {
+    return;
+  }
+  static thread_local uint32_t num_waits = 0;
+  if (++num_waits % sample_interval != 0) {
+    return;
+  }
+  void* pcs[kMaxStackDepth];
+  const int depth =
+      absl::GetStackTrace(pcs, kMaxStackDepth, /*skip_count=*/1);
+  Stack stack(depth);
+  std::transform(pcs, pcs + depth, stack.begin(),
+                 [](void* pc) { return reinterpret_cast<uintptr_t>(pc); });
+  ContentionProfile& profile = GetContentionProfile();
+  std::lock_guard<std::mutex> lock(profile.mutex);
+  auto& [cycles, count] = profile.waits[std::move(stack)];
+  cycles += wait_cycles;
+  ++count;
+}
+
+}  // namespace
+
+absl::StatusOr<std::string> CollectCpuProfile(absl::Duration duration,
+                                              int frequency_hz) {
+  if (frequency_hz <= 0 || frequency_hz > 1000000) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Invalid CPU profile frequency: ", frequency_hz));
+  }
+  if (cpu_profile_state.collecting.exchange(true)) {
+    return absl::FailedPreconditionError(
+        "Another CPU profile is being collected");
+  }
+  auto samples = std::make_unique<CpuSample[]>(kMaxCpuSamples);
+  cpu_profile_state.samples = samples.get();
+  cpu_profile_state.num_samples = 0;
+  const int64_t period_micros = 1000000 / frequency_hz;
+  absl::Status status = InstallProfSignalHandler();
+  if (status.ok()) {
+    cpu_profile_state.recording = true;
+    status = SetProfTimer(period_micros);
+  }
+  if (status.ok()) {
+    absl::SleepFor(duration);
+    status = SetProfTimer(0);
+  }
+  cpu_profile_state.recording = false;
+  // Handlers that started before recording stopped may still write samples.
+  while (cpu_profile_state.num_in_handler > 0) {
+    std::this_thread::yield();
+  }
+  const int num_samples =
+      std::min<int>(cpu_profile_state.num_samples, kMaxCpuSamples);
+  cpu_profile_state.samples = nullptr;
+  cpu_profile_state.collecting = false;
+  if (!status.ok()) {
+    return status;
+  }
+  absl::flat_hash_map<Stack, int64_t> counts;
+  for (int i = 0; i < num_samples; ++i) {
+    const CpuSample& sample = samples[i];
+    Stack stack(sample.depth);
+    std::transform(sample.pcs, sample.pcs + sample.depth, stack.begin(),
+                   [](void* pc) { return reinterpret_cast<uintptr_t>(pc); });
+    ++counts[std::move(stack)];
+  }
+  // Header words: header size, version, sampling period and padding.
+  std::string profile;
+  for (uintptr_t word : {0, 3, 0}) {
+    AppendWord(word, profile);
+  }
+  AppendWord(period_micros, profile);
+  AppendWord(0, profile);
+  for (const auto& [stack, count] : counts) {
+    AppendWord(count, profile);
+    AppendWord(stack.size(), profile);
+    for (uintptr_t pc : stack) {
+      AppendWord(pc, profile);
+    }
+  }
+  // Trailer.
+  for (uintptr_t word : {0, 1, 0}) {
+    AppendWord(word, profile);
+  }
+  profile.append(ReadProcMaps());
+  return profile;
+}
+
+absl::StatusOr<std::string> CollectHeapProfile() {
+  return tcmalloc::Marshal(
+      tcmalloc::MallocExtension::SnapshotCurrent(tcmalloc::ProfileType::kHeap));
+}
+
+void SetContentionProfileSampleInterval(int sample_interval) {
+  static absl::once_flag registered;
+  absl::call_once(registered,
+                  [] { absl::RegisterMutexTracer(TraceMutexWait); });
+  contention_sample_interval = std::max(sample_interval, 0);
+}
+
+std::string TakeContentionProfile() {
+  absl::flat_hash_map<Stack, std::pair<int64_t, int64_t>> waits;
+  {
+    ContentionProfile& profile = GetContentionProfile();
+    std::lock_guard<std::mutex> lock(profile.mutex);
+    waits.swap(profile.waits);
+  }
+  std::string profile = absl::StrFormat(
+      "--- contention\ncycles/second = %d\nsampling period = %d\n",
+      static_cast<int64_t>(absl::base_internal::CycleClock::Frequency()),
+      std::max<int>(contention_sample_interval, 1));
+  for (const auto& [stack, wait] : waits) {
+    absl::StrAppendFormat(&profile, "%d %d @", wait.first, wait.second);
+    for (uintptr_t pc : stack) {
+      absl::StrAppendFormat(&profile, " %#x", pc);
+    }
+    profile.push_back('\n');
+  }
+  profile.append(ReadProcMaps());
+  return profile;
+}
+
+}  // namespace kv_server
@@ -0,0 +1,51 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_UTIL_PROFILER_H_
+#define COMPONENTS_UTIL_PROFILER_H_
+
+#include <string>
+
+#include "absl/status/statusor.h"
+#include "absl/time/time.h"
+
+namespace kv_server {
+
+// Profiles of the running process, in formats that pprof reads, so that a
+// deployed server can be profiled without a custom image.
+
+// Samples the stacks that use the CPU `frequency_hz` times per second of CPU
+// time for `duration`, and returns them in the legacy CPU profile format of
+// gperftools. Fails if another CPU profile is being collected.
+absl::StatusOr<std::string> CollectCpuProfile(absl::Duration duration,
+                                              int frequency_hz = 100);
+
+// Returns the sampled heap of tcmalloc as a gzipped pprof profile. Empty
+// profiles are returned if the binary isn't linked with tcmalloc.
+absl::StatusOr<std::string> CollectHeapProfile();
+
+// Starts recording one in `sample_interval` of the waits for contended
+// `absl::Mutex`es, with the stack of the thread that released the mutex. The
+// interval can be changed by later calls, 0 stops recording.
+void SetContentionProfileSampleInterval(int sample_interval);
+
+// Returns the waits recorded since the last call in the legacy contention
+// profile format of gperftools, and starts a new profile.
+std::string TakeContentionProfile();
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_UTIL_PROFILER_H_
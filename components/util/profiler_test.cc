@@ -0,0 +1,89 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/util/profiler.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+using testing::StartsWith;
+
+std::vector<uintptr_t> Words(const std::string& profile, int num_words) {
+  std::vector<uintptr_t> words(num_words);
+  std::memcpy(words.data(), profile.data(), num_words * sizeof(uintptr_t));
+  return words;
+}
+
+TEST(ProfilerTest, CpuProfileHasLegacyFormat) {
+  std::atomic<bool> done = false;
+  std::thread spinner([&done] {
+    volatile uint64_t x = 0;
+    while (!done) {
+      x = x + 1;
+    }
+  });
+  const auto profile =
+      CollectCpuProfile(absl::Milliseconds(200), /*frequency_hz=*/1000);
+  done = true;
+  spinner.join();
+  ASSERT_TRUE(profile.ok()) << profile.status();
+  ASSERT_GE(profile->size(), 8 * sizeof(uintptr_t));
+  // Header words: header size, version, period in microseconds.
+  const std::vector<uintptr_t> header = Words(*profile, 5);
+  EXPECT_EQ(header[0], 0);
+  EXPECT_EQ(header[1], 3);
+  EXPECT_EQ(header[3], 1000);
+  // Samples, then the mappings of the process.
+  EXPECT_NE(profile->find("r-xp"), std::string::npos);
+}
+
+TEST(ProfilerTest, CpuProfileRejectsInvalidFrequency) {
+  EXPECT_FALSE(
+      CollectCpuProfile(absl::Milliseconds(1), /*frequency_hz=*/0).ok());
+}
+
+TEST(ProfilerTest, ContentionProfileHasLegacyFormat) {
+  SetContentionProfileSampleInterval(1);
+  absl::Mutex mutex;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&mutex] {
+      for (int j = 0; j < 1000; ++j) {
+        absl::MutexLock lock(&mutex);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  SetContentionProfileSampleInterval(0);
+  EXPECT_THAT(TakeContentionProfile(),
+              StartsWith("--- contention\ncycles/second = "));
+}
+
+}  // namespace
+}  // namespace kv_server
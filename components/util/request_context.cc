@@ -14,12 +14,35 @@
 
 #include "components/util/request_context.h"
 
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
 #include <utility>
 
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "components/internal_server/lookup_memo.h"
 #include "components/telemetry/server_definition.h"
 
 namespace kv_server {
 
+struct RequestContext::CallState {
+  mutable absl::Mutex mutex;
+  absl::Time deadline ABSL_GUARDED_BY(mutex) = absl::InfiniteFuture();
+  std::function<bool()> is_cancelled ABSL_GUARDED_BY(mutex);
+  bool ended ABSL_GUARDED_BY(mutex) = false;
+};
+
+RequestContext::RequestContext(const ScopeMetricsContext& metrics_context)
+    : udf_request_metrics_context_(
+          metrics_context.GetUdfRequestMetricsContext()),
+      internal_lookup_metrics_context_(
+          metrics_context.GetInternalLookupMetricsContext()),
+      lookup_memo_(std::make_shared<LookupMemo>()),
+      call_state_(std::make_shared<CallState>()) {}
+
 UdfRequestMetricsContext& RequestContext::GetUdfRequestMetricsContext() const {
   return udf_request_metrics_context_;
 }
@@ -28,4 +51,56 @@ InternalLookupMetricsContext& RequestContext::GetInternalLookupMetricsContext()
   return internal_lookup_metrics_context_;
 }
 
+LookupMemo& RequestContext::GetLookupMemo() const { return *lookup_memo_; }
+
+void RequestContext::SetDeadline(RequestDeadline deadline) {
+  absl::MutexLock lock(&call_state_->mutex);
+  call_state_->deadline = deadline.deadline;
+  call_state_->is_cancelled = std::move(deadline.is_cancelled);
+}
+
+void RequestContext::EndCall() const {
+  absl::MutexLock lock(&call_state_->mutex);
+  call_state_->ended = true;
+  call_state_->is_cancelled = nullptr;
+}
+
+bool RequestContext::IsCancelled() const {
+  absl::MutexLock lock(&call_state_->mutex);
+  if (call_state_->ended || absl::Now() >= call_state_->deadline) {
+    return true;
+  }
+  // Called under the lock, so that the call can't end while checking it.
+  return call_state_->is_cancelled && call_state_->is_cancelled();
+}
+
+absl::Time RequestContext::deadline() const {
+  absl::MutexLock lock(&call_state_->mutex);
+  return call_state_->deadline;
+}
+
+absl::Duration RequestContext::GetTimeout(absl::Duration max_timeout) const {
+  if (IsCancelled()) {
+    return absl::ZeroDuration();
+  }
+  return std::max(std::min(max_timeout, deadline() - absl::Now()),
+                  absl::ZeroDuration());
+}
+
+void RequestContext::SetTraceContext(
+    opentelemetry::trace::SpanContext trace_context) {
+  trace_context_ = std::move(trace_context);
+}
+
+RequestSpan RequestContext::StartSpan(std::string_view name) const {
+  return RequestSpan::StartChild(name, trace_context_);
+}
+
+std::string RequestContext::TraceParent() const {
+  if (!trace_context_.IsSampled()) {
+    return "";
+  }
+  return FormatTraceParent(trace_context_);
+}
+
 }  // namespace kv_server
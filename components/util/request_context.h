@@ -17,34 +17,80 @@
 #ifndef COMPONENTS_UTIL_REQUEST_CONTEXT_H_
 #define COMPONENTS_UTIL_REQUEST_CONTEXT_H_
 
+#include <functional>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <utility>
 
+#include "absl/time/time.h"
 #include "components/telemetry/server_definition.h"
+#include "components/util/request_tracing.h"
+#include "opentelemetry/trace/span_context.h"
 
 namespace kv_server {
 
+class LookupMemo;
+
+// When the client of a request stops waiting for its response.
+struct RequestDeadline {
+  absl::Time deadline = absl::InfiniteFuture();
+  // Returns whether the client cancelled the request. Only called until the
+  // call of the request ends, so it may refer to the state of the call.
+  std::function<bool()> is_cancelled;
+};
+
 // RequestContext holds the reference of udf request metrics context and
 // internal lookup request context that ties to a single
-// request. The request_id can be either passed from upper stream or assigned
-// from uuid generated when RequestContext is constructed.
+// request, the memo of the lookups of the request, its deadline and the span
+// that its work is traced under. The request_id can be either passed from
+// upper stream or assigned from uuid generated when RequestContext is
+// constructed.
 
 class RequestContext {
  public:
-  explicit RequestContext(const ScopeMetricsContext& metrics_context)
-      : udf_request_metrics_context_(
-            metrics_context.GetUdfRequestMetricsContext()),
-        internal_lookup_metrics_context_(
-            metrics_context.GetInternalLookupMetricsContext()) {}
+  explicit RequestContext(const ScopeMetricsContext& metrics_context);
   UdfRequestMetricsContext& GetUdfRequestMetricsContext() const;
   InternalLookupMetricsContext& GetInternalLookupMetricsContext() const;
+  // Results of the lookups of the request, shared by the copies of the
+  // context.
+  LookupMemo& GetLookupMemo() const;
+
+  // Sets the deadline of the request, shared by the copies of the context.
+  void SetDeadline(RequestDeadline deadline);
+  // Ends the call of the request. Work still running for it, like a UDF
+  // execution that timed out, sees the request as cancelled from then on.
+  void EndCall() const;
+  // Whether the request is past its deadline, was cancelled by its client, or
+  // its call ended. Its results aren't wanted anymore then.
+  bool IsCancelled() const;
+  absl::Time deadline() const;
+  // Returns the time left before the deadline, at most `max_timeout`. Zero
+  // once the request is cancelled.
+  absl::Duration GetTimeout(absl::Duration max_timeout) const;
+
+  // Sets the span that the spans of the work done with the context are
+  // children of. Unlike the deadline, it isn't shared by the copies of the
+  // context, so that a copy can be traced under a span of its own.
+  void SetTraceContext(opentelemetry::trace::SpanContext trace_context);
+  // Starts a child of the trace context, only recorded if the request is
+  // traced.
+  RequestSpan StartSpan(std::string_view name) const;
+  // The W3C traceparent of the trace context that remote lookups are sent
+  // with, empty if the request isn't traced.
+  std::string TraceParent() const;
 
   ~RequestContext() = default;
 
  private:
+  struct CallState;
+
   UdfRequestMetricsContext& udf_request_metrics_context_;
   InternalLookupMetricsContext& internal_lookup_metrics_context_;
+  std::shared_ptr<LookupMemo> lookup_memo_;
+  std::shared_ptr<CallState> call_state_;
+  opentelemetry::trace::SpanContext trace_context_ =
+      opentelemetry::trace::SpanContext::GetInvalid();
 };
 
 }  // namespace kv_server
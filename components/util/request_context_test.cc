@@ -0,0 +1,99 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/util/request_context.h"
+
+#include <memory>
+#include <string_view>
+
+#include "absl/time/clock.h"
+#include "components/telemetry/server_definition.h"
+#include "components/util/request_tracing.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+class RequestContextTest : public ::testing::Test {
+ protected:
+  RequestContextTest() { InitMetricsContextMap(); }
+  std::unique_ptr<ScopeMetricsContext> scope_metrics_context_ =
+      std::make_unique<ScopeMetricsContext>();
+};
+
+TEST_F(RequestContextTest, NoDeadlineByDefault) {
+  RequestContext request_context(*scope_metrics_context_);
+  EXPECT_FALSE(request_context.IsCancelled());
+  EXPECT_EQ(request_context.deadline(), absl::InfiniteFuture());
+  EXPECT_EQ(request_context.GetTimeout(absl::Seconds(5)), absl::Seconds(5));
+}
+
+TEST_F(RequestContextTest, TimeoutIsCappedByDeadline) {
+  RequestContext request_context(*scope_metrics_context_);
+  request_context.SetDeadline(
+      {.deadline = absl::Now() + absl::Milliseconds(100)});
+  EXPECT_FALSE(request_context.IsCancelled());
+  EXPECT_LE(request_context.GetTimeout(absl::Seconds(5)),
+            absl::Milliseconds(100));
+  EXPECT_GT(request_context.GetTimeout(absl::Seconds(5)),
+            absl::ZeroDuration());
+
+  request_context.SetDeadline({.deadline = absl::Now() - absl::Seconds(1)});
+  EXPECT_TRUE(request_context.IsCancelled());
+  EXPECT_EQ(request_context.GetTimeout(absl::Seconds(5)),
+            absl::ZeroDuration());
+}
+
+TEST_F(RequestContextTest, CopiesShareCancellation) {
+  bool client_cancelled = false;
+  RequestContext request_context(*scope_metrics_context_);
+  request_context.SetDeadline(
+      {.is_cancelled = [&client_cancelled] { return client_cancelled; }});
+  const RequestContext copy = request_context;
+  EXPECT_FALSE(copy.IsCancelled());
+  client_cancelled = true;
+  EXPECT_TRUE(copy.IsCancelled());
+}
+
+TEST_F(RequestContextTest, CancelledOnceCallEnds) {
+  int checks = 0;
+  RequestContext request_context(*scope_metrics_context_);
+  request_context.SetDeadline({.is_cancelled = [&checks] {
+    ++checks;
+    return false;
+  }});
+  const RequestContext copy = request_context;
+  EXPECT_FALSE(copy.IsCancelled());
+  request_context.EndCall();
+  EXPECT_TRUE(copy.IsCancelled());
+  // The check of the client isn't called once the call ended.
+  EXPECT_EQ(checks, 1);
+}
+
+TEST_F(RequestContextTest, TraceContextIsNotSharedByCopies) {
+  constexpr std::string_view kTraceParent =
+      "00-0af7651916cd43dd8448eb211c80319c-b7ad6b7169203331-01";
+  RequestContext request_context(*scope_metrics_context_);
+  EXPECT_EQ(request_context.TraceParent(), "");
+  EXPECT_FALSE(request_context.StartSpan("Stage").recording());
+  RequestContext copy = request_context;
+  copy.SetTraceContext(ParseTraceParent(kTraceParent));
+  EXPECT_EQ(copy.TraceParent(), kTraceParent);
+  EXPECT_EQ(request_context.TraceParent(), "");
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -0,0 +1,236 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/util/request_tracing.h"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/algorithm/container.h"
+#include "absl/random/random.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/escaping.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "opentelemetry/common/timestamp.h"
+#include "opentelemetry/nostd/span.h"
+#include "opentelemetry/nostd/string_view.h"
+#include "opentelemetry/trace/span_id.h"
+#include "opentelemetry/trace/span_metadata.h"
+#include "opentelemetry/trace/span_startoptions.h"
+#include "opentelemetry/trace/trace_flags.h"
+#include "opentelemetry/trace/trace_id.h"
+#include "src/telemetry/tracing.h"
+
+namespace kv_server {
+namespace {
+
+using opentelemetry::trace::SpanContext;
+using opentelemetry::trace::SpanId;
+using opentelemetry::trace::StartSpanOptions;
+using opentelemetry::trace::TraceFlags;
+using opentelemetry::trace::TraceId;
+using privacy_sandbox::server_common::GetTracer;
+
+constexpr std::string_view kTraceParentVersion = "00";
+
+std::atomic<int32_t> trace_sample_interval = 0;
+// The span that `RequestSpan::StartChild(name)` starts children of.
+thread_local opentelemetry::trace::Span* active_span = nullptr;
+
+bool ShouldTraceRequest() {
+  const int32_t interval =
+      trace_sample_interval.load(std::memory_order_relaxed);
+  if (interval <= 1) {
+    return interval == 1;
+  }
+  thread_local absl::InsecureBitGen bitgen;
+  return absl::Uniform<int32_t>(bitgen, 0, interval) == 0;
+}
+
+opentelemetry::nostd::string_view ToNostd(std::string_view view) {
+  return opentelemetry::nostd::string_view(view.data(), view.size());
+}
+
+bool IsLowerHex(std::string_view hex) {
+  return absl::c_all_of(hex, [](char c) {
+    return absl::ascii_isdigit(c) || (c >= 'a' && c <= 'f');
+  });
+}
+
+template <size_t kSize>
+opentelemetry::nostd::span<const uint8_t, kSize> AsBytes(
+    const std::string& bytes) {
+  return opentelemetry::nostd::span<const uint8_t, kSize>(
+      reinterpret_cast<const uint8_t*>(bytes.data()), kSize);
+}
+
+}  // namespace
+
+void SetRequestTraceSampleInterval(int32_t interval) {
+  trace_sample_interval.store(interval, std::memory_order_relaxed);
+}
+
+RequestSpan::RequestSpan(RequestSpan&& other)
+    : span_(std::move(other.span_)),
+      active_(std::exchange(other.active_, false)),
+      previous_active_(other.previous_active_) {
+  other.span_ = {};
+}
+
+RequestSpan& RequestSpan::operator=(RequestSpan&& other) {
+  if (this != &other) {
+    End();
+    span_ = std::move(other.span_);
+    other.span_ = {};
+    active_ = std::exchange(other.active_, false);
+    previous_active_ = other.previous_active_;
+  }
+  return *this;
+}
+
+RequestSpan RequestSpan::StartRoot(std::string_view name) {
+  if (!ShouldTraceRequest()) {
+    return RequestSpan();
+  }
+  StartSpanOptions options;
+  // Not a child of whatever span the runtime context holds.
+  options.parent = SpanContext::GetInvalid();
+  options.kind = opentelemetry::trace::SpanKind::kServer;
+  return RequestSpan(GetTracer()->StartSpan(ToNostd(name), options));
+}
+
+RequestSpan RequestSpan::StartRemote(std::string_view name,
+                                     std::string_view trace_parent,
+                                     absl::Time start) {
+  if (trace_parent.empty()) {
+    return RequestSpan();
+  }
+  const SpanContext parent = ParseTraceParent(trace_parent);
+  if (!parent.IsValid() || !parent.IsSampled()) {
+    return RequestSpan();
+  }
+  StartSpanOptions options;
+  options.parent = parent;
+  options.kind = opentelemetry::trace::SpanKind::kServer;
+  options.start_system_time =
+      opentelemetry::common::SystemTimestamp(absl::ToChronoTime(start));
+  options.start_steady_time = opentelemetry::common::SteadyTimestamp(
+      std::chrono::steady_clock::now() -
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          absl::ToChronoNanoseconds(absl::Now() - start)));
+  return RequestSpan(GetTracer()->StartSpan(ToNostd(name), options));
+}
+
+RequestSpan RequestSpan::StartChild(std::string_view name,
+                                    const SpanContext& parent) {
+  if (!parent.IsValid() || !parent.IsSampled()) {
+    return RequestSpan();
+  }
+  StartSpanOptions options;
+  options.parent = parent;
+  return RequestSpan(GetTracer()->StartSpan(ToNostd(name), options));
+}
+
+RequestSpan RequestSpan::StartChild(std::string_view name) {
+  if (active_span == nullptr) {
+    return RequestSpan();
+  }
+  return StartChild(name, active_span->GetContext());
+}
+
+SpanContext RequestSpan::ActiveContext() {
+  return active_span == nullptr ? SpanContext::GetInvalid()
+                                : active_span->GetContext();
+}
+
+SpanContext RequestSpan::context() const {
+  return span_ == nullptr ? SpanContext::GetInvalid() : span_->GetContext();
+}
+
+void RequestSpan::Activate() {
+  if (span_ == nullptr || active_) {
+    return;
+  }
+  previous_active_ = active_span;
+  active_span = span_.get();
+  active_ = true;
+}
+
+void RequestSpan::SetAttribute(std::string_view key, int64_t value) {
+  if (span_ != nullptr) {
+    span_->SetAttribute(ToNostd(key), value);
+  }
+}
+
+void RequestSpan::SetStatus(const absl::Status& status) {
+  if (span_ != nullptr && !status.ok()) {
+    const std::string code = absl::StatusCodeToString(status.code());
+    span_->SetStatus(opentelemetry::trace::StatusCode::kError, ToNostd(code));
+  }
+}
+
+void RequestSpan::End() {
+  if (span_ == nullptr) {
+    return;
+  }
+  if (active_) {
+    active_span = previous_active_;
+    active_ = false;
+  }
+  span_->End();
+  span_ = {};
+}
+
+std::string FormatTraceParent(const SpanContext& context) {
+  if (!context.IsValid()) {
+    return "";
+  }
+  char trace_id[2 * TraceId::kSize];
+  char span_id[2 * SpanId::kSize];
+  char trace_flags[2];
+  context.trace_id().ToLowerBase16(trace_id);
+  context.span_id().ToLowerBase16(span_id);
+  context.trace_flags().ToLowerBase16(trace_flags);
+  return absl::StrCat(kTraceParentVersion, "-",
+                      std::string_view(trace_id, sizeof(trace_id)), "-",
+                      std::string_view(span_id, sizeof(span_id)), "-",
+                      std::string_view(trace_flags, sizeof(trace_flags)));
+}
+
+SpanContext ParseTraceParent(std::string_view trace_parent) {
+  const std::vector<std::string_view> fields =
+      absl::StrSplit(trace_parent, '-');
+  if (fields.size() != 4 || fields[0] != kTraceParentVersion ||
+      fields[1].size() != 2 * TraceId::kSize ||
+      fields[2].size() != 2 * SpanId::kSize || fields[3].size() != 2 ||
+      !IsLowerHex(fields[1]) || !IsLowerHex(fields[2]) ||
+      !IsLowerHex(fields[3])) {
+    return SpanContext::GetInvalid();
+  }
+  const std::string trace_id = absl::HexStringToBytes(fields[1]);
+  const std::string span_id = absl::HexStringToBytes(fields[2]);
+  const std::string trace_flags = absl::HexStringToBytes(fields[3]);
+  return SpanContext(TraceId(AsBytes<TraceId::kSize>(trace_id)),
+                     SpanId(AsBytes<SpanId::kSize>(span_id)),
+                     TraceFlags(static_cast<uint8_t>(trace_flags[0])),
+                     /*is_remote=*/true);
+}
+
+}  // namespace kv_server
@@ -0,0 +1,108 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_UTIL_REQUEST_TRACING_H_
+#define COMPONENTS_UTIL_REQUEST_TRACING_H_
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "absl/status/status.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "opentelemetry/nostd/shared_ptr.h"
+#include "opentelemetry/trace/span.h"
+#include "opentelemetry/trace/span_context.h"
+
+namespace kv_server {
+
+// Traces one in every `interval` requests, picked at random, from then on.
+// 0, the default, traces none. The decision is made once per request, when
+// its root span would start, and the remote lookups of a traced request are
+// traced by the shards they are sent to.
+void SetRequestTraceSampleInterval(int32_t interval);
+
+// A span of the trace of a request, through `GetTracer`, which ends when it's
+// destroyed. The spans of requests that aren't traced aren't recorded, and
+// cost next to nothing.
+//
+// Not thread-safe.
+class RequestSpan {
+ public:
+  // A span that isn't recorded.
+  RequestSpan() = default;
+  RequestSpan(RequestSpan&& other);
+  RequestSpan& operator=(RequestSpan&& other);
+  RequestSpan(const RequestSpan&) = delete;
+  RequestSpan& operator=(const RequestSpan&) = delete;
+  ~RequestSpan() { End(); }
+
+  // Starts the root span of a request, if the request is sampled.
+  static RequestSpan StartRoot(std::string_view name);
+  // Starts the span of a request received from another server, in the trace
+  // that `trace_parent` was formatted from, if that trace is sampled. The
+  // span starts at `start`, which may be before its parent was known.
+  static RequestSpan StartRemote(std::string_view name,
+                                 std::string_view trace_parent,
+                                 absl::Time start = absl::Now());
+  // Starts a child of `parent`, if it's a span of a sampled trace.
+  static RequestSpan StartChild(
+      std::string_view name, const opentelemetry::trace::SpanContext& parent);
+  // Starts a child of the span active on the calling thread, if any.
+  static RequestSpan StartChild(std::string_view name);
+
+  // Returns the context of the span active on the calling thread, invalid if
+  // there is none.
+  static opentelemetry::trace::SpanContext ActiveContext();
+
+  bool recording() const { return span_ != nullptr; }
+  // Invalid if the span isn't recorded.
+  opentelemetry::trace::SpanContext context() const;
+
+  // Makes the span the parent of the spans started with `StartChild(name)` on
+  // the calling thread until it ends, which must then be on the same thread.
+  void Activate();
+  void SetAttribute(std::string_view key, int64_t value);
+  // Marks the span as failed, unless `status` is ok.
+  void SetStatus(const absl::Status& status);
+  // Ends the span before it's destroyed.
+  void End();
+
+ private:
+  explicit RequestSpan(
+      opentelemetry::nostd::shared_ptr<opentelemetry::trace::Span> span)
+      : span_(std::move(span)) {}
+
+  opentelemetry::nostd::shared_ptr<opentelemetry::trace::Span> span_;
+  bool active_ = false;
+  // The span that was active before this one.
+  opentelemetry::trace::Span* previous_active_ = nullptr;
+};
+
+// Formats `context` as the value of a W3C traceparent header, or returns an
+// empty string if it's invalid.
+std::string FormatTraceParent(const opentelemetry::trace::SpanContext& context);
+
+// Parses the value of a W3C traceparent header into a remote span context.
+// Returns an invalid context if `trace_parent` is malformed.
+opentelemetry::trace::SpanContext ParseTraceParent(
+    std::string_view trace_parent);
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_UTIL_REQUEST_TRACING_H_
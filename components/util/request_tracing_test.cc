@@ -0,0 +1,130 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/util/request_tracing.h"
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "gtest/gtest.h"
+#include "opentelemetry/exporters/memory/in_memory_span_exporter.h"
+#include "opentelemetry/sdk/trace/simple_processor.h"
+#include "opentelemetry/sdk/trace/tracer_provider.h"
+#include "opentelemetry/trace/provider.h"
+
+namespace kv_server {
+namespace {
+
+using opentelemetry::exporter::memory::InMemorySpanData;
+using opentelemetry::exporter::memory::InMemorySpanExporter;
+using opentelemetry::nostd::string_view;
+using opentelemetry::sdk::trace::SimpleSpanProcessor;
+using opentelemetry::sdk::trace::TracerProvider;
+
+constexpr std::string_view kTraceParent =
+    "00-0af7651916cd43dd8448eb211c80319c-b7ad6b7169203331-01";
+
+class RequestTracingTest : public ::testing::Test {
+ protected:
+  RequestTracingTest() {
+    auto exporter = std::make_unique<InMemorySpanExporter>();
+    span_data_ = exporter->GetData();
+    opentelemetry::trace::Provider::SetTracerProvider(
+        opentelemetry::nostd::shared_ptr<opentelemetry::trace::TracerProvider>(
+            new TracerProvider(
+                std::make_unique<SimpleSpanProcessor>(std::move(exporter)))));
+  }
+  ~RequestTracingTest() override { SetRequestTraceSampleInterval(0); }
+
+  std::shared_ptr<InMemorySpanData> span_data_;
+};
+
+TEST_F(RequestTracingTest, FormatsParsedTraceParent) {
+  const auto context = ParseTraceParent(kTraceParent);
+  EXPECT_TRUE(context.IsValid());
+  EXPECT_TRUE(context.IsSampled());
+  EXPECT_TRUE(context.IsRemote());
+  EXPECT_EQ(FormatTraceParent(context), kTraceParent);
+}
+
+TEST_F(RequestTracingTest, MalformedTraceParentIsInvalid) {
+  for (std::string_view trace_parent : {
+           "",
+           "00-0af7651916cd43dd8448eb211c80319c-b7ad6b7169203331",
+           "01-0af7651916cd43dd8448eb211c80319c-b7ad6b7169203331-01",
+           "00-0AF7651916CD43DD8448EB211C80319C-b7ad6b7169203331-01",
+           "00-0af7651916cd43dd8448eb211c8031-b7ad6b7169203331-01",
+           "00-00000000000000000000000000000000-b7ad6b7169203331-01",
+           "00-0af7651916cd43dd8448eb211c80319c-b7ad6b716920333x-01",
+       }) {
+    EXPECT_FALSE(ParseTraceParent(trace_parent).IsValid()) << trace_parent;
+  }
+  EXPECT_EQ(FormatTraceParent(ParseTraceParent("")), "");
+}
+
+TEST_F(RequestTracingTest, RequestsAreNotTracedByDefault) {
+  RequestSpan root = RequestSpan::StartRoot("Request");
+  root.Activate();
+  EXPECT_FALSE(root.recording());
+  EXPECT_FALSE(root.context().IsValid());
+  EXPECT_FALSE(RequestSpan::StartChild("Stage").recording());
+  EXPECT_FALSE(RequestSpan::ActiveContext().IsValid());
+}
+
+TEST_F(RequestTracingTest, TracesSampledRequest) {
+  SetRequestTraceSampleInterval(1);
+  RequestSpan root = RequestSpan::StartRoot("Request");
+  ASSERT_TRUE(root.recording());
+  root.Activate();
+  EXPECT_EQ(RequestSpan::ActiveContext(), root.context());
+  {
+    RequestSpan stage = RequestSpan::StartChild("Stage");
+    EXPECT_TRUE(stage.recording());
+    stage.SetAttribute("keys", 2);
+  }
+  RequestSpan moved = std::move(root);
+  EXPECT_FALSE(root.recording());
+  const std::string trace_parent = FormatTraceParent(moved.context());
+  moved.End();
+  EXPECT_FALSE(RequestSpan::ActiveContext().IsValid());
+
+  const auto spans = span_data_->GetSpans();
+  ASSERT_EQ(spans.size(), 2);
+  EXPECT_EQ(spans[0]->GetName(), string_view("Stage"));
+  EXPECT_EQ(spans[1]->GetName(), string_view("Request"));
+  EXPECT_EQ(spans[0]->GetParentSpanId(), spans[1]->GetSpanId());
+  EXPECT_EQ(spans[0]->GetTraceId(), spans[1]->GetTraceId());
+
+  // The shard that the trace parent is sent to continues the trace.
+  SetRequestTraceSampleInterval(0);
+  RequestSpan remote = RequestSpan::StartRemote("Lookup", trace_parent);
+  ASSERT_TRUE(remote.recording());
+  EXPECT_EQ(remote.context().trace_id(), spans[1]->GetTraceId());
+}
+
+TEST_F(RequestTracingTest, UnsampledRemoteTraceIsNotContinued) {
+  SetRequestTraceSampleInterval(1);
+  EXPECT_FALSE(
+      RequestSpan::StartRemote(
+          "Lookup", "00-0af7651916cd43dd8448eb211c80319c-b7ad6b7169203331-00")
+          .recording());
+  EXPECT_FALSE(RequestSpan::StartRemote("Lookup", "").recording());
+}
+
+}  // namespace
+}  // namespace kv_server
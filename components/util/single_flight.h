@@ -0,0 +1,91 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_UTIL_SINGLE_FLIGHT_H_
+#define COMPONENTS_UTIL_SINGLE_FLIGHT_H_
+
+#include <memory>
+#include <string>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/functional/function_ref.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+
+namespace kv_server {
+
+// Coalesces identical concurrent calls: while a call for a key is in flight,
+// the calls made for the same key wait for it and share its result instead of
+// computing it again. Results are not kept once their call is done, so this
+// never serves stale results, it only collapses bursts of duplicates.
+//
+// Thread safe.
+template <typename Value>
+class SingleFlight {
+ public:
+  SingleFlight() = default;
+  SingleFlight(const SingleFlight&) = delete;
+  SingleFlight& operator=(const SingleFlight&) = delete;
+
+  // Returns the result of `fn`, or of the call already in flight for `key`,
+  // in which case `fn` isn't called and `*collapsed`, if set, is set to true.
+  std::shared_ptr<const Value> Do(const std::string& key,
+                                  absl::FunctionRef<Value()> fn,
+                                  bool* collapsed = nullptr)
+      ABSL_LOCKS_EXCLUDED(mutex_) {
+    std::shared_ptr<Call> call;
+    bool is_leader = false;
+    {
+      absl::MutexLock lock(&mutex_);
+      auto [iter, inserted] = calls_.try_emplace(key);
+      if (inserted) {
+        iter->second = std::make_shared<Call>();
+      }
+      call = iter->second;
+      is_leader = inserted;
+    }
+    if (collapsed != nullptr) {
+      *collapsed = !is_leader;
+    }
+    if (!is_leader) {
+      call->done.WaitForNotification();
+      return call->value;
+    }
+    call->value = std::make_shared<const Value>(fn());
+    {
+      absl::MutexLock lock(&mutex_);
+      calls_.erase(key);
+    }
+    call->done.Notify();
+    return call->value;
+  }
+
+ private:
+  struct Call {
+    absl::Notification done;
+    // Set before `done` is notified.
+    std::shared_ptr<const Value> value;
+  };
+
+  absl::Mutex mutex_;
+  absl::flat_hash_map<std::string, std::shared_ptr<Call>> calls_
+      ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_UTIL_SINGLE_FLIGHT_H_
@@ -0,0 +1,98 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/util/single_flight.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+TEST(SingleFlightTest, SequentialCallsAreNotCollapsed) {
+  SingleFlight<std::string> single_flight;
+  int num_calls = 0;
+  for (int i = 0; i < 3; ++i) {
+    bool collapsed = true;
+    const auto value = single_flight.Do(
+        "key",
+        [&num_calls] {
+          ++num_calls;
+          return std::to_string(num_calls);
+        },
+        &collapsed);
+    EXPECT_FALSE(collapsed);
+    EXPECT_EQ(*value, std::to_string(i + 1));
+  }
+  EXPECT_EQ(num_calls, 3);
+}
+
+TEST(SingleFlightTest, ConcurrentDuplicatesShareOneCall) {
+  SingleFlight<std::string> single_flight;
+  absl::Notification leader_started;
+  absl::Notification release_leader;
+  std::atomic<int> num_calls = 0;
+  std::atomic<int> num_collapsed = 0;
+  auto call = [&] {
+    bool collapsed = false;
+    const auto value = single_flight.Do(
+        "key",
+        [&] {
+          ++num_calls;
+          leader_started.Notify();
+          release_leader.WaitForNotification();
+          return std::string("value");
+        },
+        &collapsed);
+    EXPECT_EQ(*value, "value");
+    if (collapsed) {
+      ++num_collapsed;
+    }
+  };
+  std::thread leader(call);
+  leader_started.WaitForNotification();
+  std::vector<std::thread> followers;
+  for (int i = 0; i < 4; ++i) {
+    followers.emplace_back(call);
+  }
+  // Give the followers time to join the call in flight.
+  absl::SleepFor(absl::Milliseconds(50));
+  release_leader.Notify();
+  leader.join();
+  for (auto& follower : followers) {
+    follower.join();
+  }
+  EXPECT_EQ(num_calls, 1);
+  EXPECT_EQ(num_collapsed, 4);
+}
+
+TEST(SingleFlightTest, DifferentKeysAreNotCollapsed) {
+  SingleFlight<int> single_flight;
+  bool collapsed = true;
+  EXPECT_EQ(*single_flight.Do("a", [] { return 1; }, &collapsed), 1);
+  EXPECT_FALSE(collapsed);
+  EXPECT_EQ(*single_flight.Do("b", [] { return 2; }, &collapsed), 2);
+  EXPECT_FALSE(collapsed);
+}
+
+}  // namespace
+}  // namespace kv_server
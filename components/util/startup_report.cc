@@ -0,0 +1,116 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/util/startup_report.h"
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+
+namespace kv_server {
+
+void StartupReport::AddPhase(std::string_view phase, absl::Duration duration) {
+  absl::MutexLock lock(&mutex_);
+  if (time_to_ready_.has_value()) {
+    return;
+  }
+  const auto it =
+      std::find_if(phases_.begin(), phases_.end(),
+                   [phase](const auto& entry) { return entry.first == phase; });
+  if (it == phases_.end()) {
+    phases_.emplace_back(std::string(phase), duration);
+  } else {
+    it->second += duration;
+  }
+}
+
+void StartupReport::AddFileLoad(std::string_view file,
+                                absl::Duration duration) {
+  absl::MutexLock lock(&mutex_);
+  if (!time_to_ready_.has_value()) {
+    file_loads_.emplace_back(std::string(file), duration);
+  }
+}
+
+void StartupReport::MarkReady(absl::Time ready) {
+  absl::MutexLock lock(&mutex_);
+  if (!time_to_ready_.has_value()) {
+    time_to_ready_ = ready - start_;
+  }
+}
+
+std::optional<absl::Duration> StartupReport::time_to_ready() const {
+  absl::MutexLock lock(&mutex_);
+  return time_to_ready_;
+}
+
+absl::flat_hash_map<std::string, double>
+StartupReport::GetPhaseDurationsInMillis() const {
+  absl::MutexLock lock(&mutex_);
+  absl::flat_hash_map<std::string, double> durations;
+  for (const auto& [phase, duration] : phases_) {
+    durations[phase] = absl::ToDoubleMilliseconds(duration);
+  }
+  if (time_to_ready_.has_value()) {
+    durations[std::string(kStartupTotalPhase)] =
+        absl::ToDoubleMilliseconds(*time_to_ready_);
+  }
+  return durations;
+}
+
+std::string StartupReport::ToJson(int num_slowest_files) const {
+  absl::MutexLock lock(&mutex_);
+  nlohmann::json report;
+  report["ready"] = time_to_ready_.has_value();
+  if (time_to_ready_.has_value()) {
+    report["total_ms"] = absl::ToDoubleMilliseconds(*time_to_ready_);
+  }
+  report["phases"] = nlohmann::json::array();
+  for (const auto& [phase, duration] : phases_) {
+    report["phases"].push_back(
+        {{"phase", phase}, {"ms", absl::ToDoubleMilliseconds(duration)}});
+  }
+  std::vector<const std::pair<std::string, absl::Duration>*> slowest_files;
+  slowest_files.reserve(file_loads_.size());
+  for (const auto& file_load : file_loads_) {
+    slowest_files.push_back(&file_load);
+  }
+  const size_t num_files =
+      std::min<size_t>(std::max(num_slowest_files, 0), slowest_files.size());
+  std::partial_sort(
+      slowest_files.begin(), slowest_files.begin() + num_files,
+      slowest_files.end(),
+      [](const auto* a, const auto* b) { return a->second > b->second; });
+  report["num_files"] = file_loads_.size();
+  report["slowest_files"] = nlohmann::json::array();
+  for (size_t i = 0; i < num_files; ++i) {
+    report["slowest_files"].push_back(
+        {{"file", slowest_files[i]->first},
+         {"ms", absl::ToDoubleMilliseconds(slowest_files[i]->second)}});
+  }
+  return report.dump();
+}
+
+StartupReport& ServerStartupReport() {
+  // Never destroyed, files may still be loading at exit.
+  static StartupReport* const report = new StartupReport();
+  return *report;
+}
+
+}  // namespace kv_server
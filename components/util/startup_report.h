@@ -0,0 +1,135 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_UTIL_STARTUP_REPORT_H_
+#define COMPONENTS_UTIL_STARTUP_REPORT_H_
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+
+namespace kv_server {
+
+// Times the phases of the startup of the server, such as fetching parameters,
+// starting Roma or loading snapshots, so that the time it takes to become
+// ready can be broken down, and reports them once it is ready.
+//
+// A phase that is timed more than once, such as listing the files of several
+// prefixes, adds up. The files loaded at startup are timed one by one too.
+// Phases and files timed once the server is ready aren't part of its startup,
+// and are left out.
+//
+// Thread safe.
+class StartupReport {
+ public:
+  // Adds the time from its construction to its destruction to `phase`.
+  class ScopedPhase {
+   public:
+    ScopedPhase(StartupReport& report, std::string_view phase)
+        : report_(report), phase_(phase), start_(absl::Now()) {}
+    ScopedPhase(const ScopedPhase&) = delete;
+    ScopedPhase& operator=(const ScopedPhase&) = delete;
+    ~ScopedPhase() { report_.AddPhase(phase_, absl::Now() - start_); }
+
+   private:
+    StartupReport& report_;
+    const std::string_view phase_;
+    const absl::Time start_;
+  };
+
+  // The startup is timed from `start`.
+  explicit StartupReport(absl::Time start = absl::Now()) : start_(start) {}
+  StartupReport(const StartupReport&) = delete;
+  StartupReport& operator=(const StartupReport&) = delete;
+
+  void AddPhase(std::string_view phase, absl::Duration duration)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+  void AddFileLoad(std::string_view file, absl::Duration duration)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Ends the startup. Only the first call counts.
+  void MarkReady(absl::Time ready = absl::Now()) ABSL_LOCKS_EXCLUDED(mutex_);
+  // Time from the start to `MarkReady`, if it was called.
+  std::optional<absl::Duration> time_to_ready() const
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Returns the duration of each phase in milliseconds, by phase, and the time
+  // to ready as `kStartupTotalPhase` once the server is ready.
+  absl::flat_hash_map<std::string, double> GetPhaseDurationsInMillis() const
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Returns the report as a single line of JSON: the time to ready, the phases
+  // in the order they first ended, and the `num_slowest_files` slowest files.
+  std::string ToJson(int num_slowest_files = 10) const
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  const absl::Time start_;
+  mutable absl::Mutex mutex_;
+  std::optional<absl::Duration> time_to_ready_ ABSL_GUARDED_BY(mutex_);
+  std::vector<std::pair<std::string, absl::Duration>> phases_
+      ABSL_GUARDED_BY(mutex_);
+  std::vector<std::pair<std::string, absl::Duration>> file_loads_
+      ABSL_GUARDED_BY(mutex_);
+};
+
+// Phases of the startup of the server. Fetching parameters is timed across
+// the whole startup, so it overlaps the other phases.
+inline constexpr std::string_view kStartupParameterFetchPhase =
+    "ParameterFetch";
+inline constexpr std::string_view kStartupTelemetryInitPhase = "TelemetryInit";
+inline constexpr std::string_view kStartupRomaInitPhase = "RomaInit";
+inline constexpr std::string_view kStartupUdfCodeLoadPhase = "UdfCodeLoad";
+inline constexpr std::string_view kStartupCacheImageLoadPhase =
+    "CacheImageLoad";
+inline constexpr std::string_view kStartupSnapshotListingPhase =
+    "SnapshotListing";
+inline constexpr std::string_view kStartupSnapshotLoadPhase = "SnapshotLoad";
+inline constexpr std::string_view kStartupDeltaCatchUpPhase = "DeltaCatchUp";
+inline constexpr std::string_view kStartupClusterMappingFetchPhase =
+    "ClusterMappingFetch";
+inline constexpr std::string_view kStartupRequestWarmUpPhase = "RequestWarmUp";
+// Name of the time to ready among the phase durations.
+inline constexpr std::string_view kStartupTotalPhase = "Total";
+inline constexpr std::string_view kStartupPhases[] = {
+    kStartupParameterFetchPhase,
+    kStartupTelemetryInitPhase,
+    kStartupRomaInitPhase,
+    kStartupUdfCodeLoadPhase,
+    kStartupCacheImageLoadPhase,
+    kStartupSnapshotListingPhase,
+    kStartupSnapshotLoadPhase,
+    kStartupDeltaCatchUpPhase,
+    kStartupClusterMappingFetchPhase,
+    kStartupRequestWarmUpPhase,
+    kStartupTotalPhase,
+};
+
+// Returns the startup report of the process, which times the startup from
+// its first call.
+StartupReport& ServerStartupReport();
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_UTIL_STARTUP_REPORT_H_
@@ -0,0 +1,90 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "components/util/startup_report.h"
+
+#include <string>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "nlohmann/json.hpp"
+
+namespace kv_server {
+namespace {
+
+using testing::Pair;
+using testing::UnorderedElementsAre;
+
+TEST(StartupReportTest, AddsUpPhasesTimedMoreThanOnce) {
+  StartupReport report(absl::UnixEpoch());
+  report.AddPhase("SnapshotListing", absl::Milliseconds(10));
+  report.AddPhase("SnapshotLoad", absl::Milliseconds(100));
+  report.AddPhase("SnapshotListing", absl::Milliseconds(5));
+  EXPECT_THAT(report.GetPhaseDurationsInMillis(),
+              UnorderedElementsAre(Pair("SnapshotListing", 15),
+                                   Pair("SnapshotLoad", 100)));
+}
+
+TEST(StartupReportTest, ReportsTimeToReady) {
+  StartupReport report(absl::UnixEpoch());
+  EXPECT_FALSE(report.time_to_ready().has_value());
+  report.AddPhase("RomaInit", absl::Milliseconds(20));
+  report.MarkReady(absl::UnixEpoch() + absl::Seconds(2));
+  report.MarkReady(absl::UnixEpoch() + absl::Seconds(3));
+  EXPECT_EQ(report.time_to_ready(), absl::Seconds(2));
+  EXPECT_THAT(report.GetPhaseDurationsInMillis(),
+              UnorderedElementsAre(Pair("RomaInit", 20), Pair("Total", 2000)));
+}
+
+TEST(StartupReportTest, LeavesOutPhasesAfterReady) {
+  StartupReport report(absl::UnixEpoch());
+  report.MarkReady(absl::UnixEpoch() + absl::Seconds(1));
+  report.AddPhase("DeltaCatchUp", absl::Milliseconds(20));
+  report.AddFileLoad("DELTA_1", absl::Milliseconds(20));
+  EXPECT_THAT(report.GetPhaseDurationsInMillis(),
+              UnorderedElementsAre(Pair("Total", 1000)));
+  EXPECT_EQ(nlohmann::json::parse(report.ToJson())["num_files"], 0);
+}
+
+TEST(StartupReportTest, ScopedPhaseTimesItsScope) {
+  StartupReport report;
+  { StartupReport::ScopedPhase phase(report, "UdfCodeLoad"); }
+  EXPECT_TRUE(report.GetPhaseDurationsInMillis().contains("UdfCodeLoad"));
+}
+
+TEST(StartupReportTest, JsonHasPhasesInOrderAndSlowestFiles) {
+  StartupReport report(absl::UnixEpoch());
+  report.AddPhase("ParameterFetch", absl::Milliseconds(1));
+  report.AddPhase("SnapshotLoad", absl::Milliseconds(30));
+  report.AddFileLoad("SNAPSHOT_1", absl::Milliseconds(10));
+  report.AddFileLoad("SNAPSHOT_2", absl::Milliseconds(30));
+  report.AddFileLoad("SNAPSHOT_3", absl::Milliseconds(20));
+  report.MarkReady(absl::UnixEpoch() + absl::Milliseconds(50));
+  const auto json =
+      nlohmann::json::parse(report.ToJson(/*num_slowest_files=*/2));
+  EXPECT_EQ(json["ready"], true);
+  EXPECT_EQ(json["total_ms"], 50);
+  ASSERT_EQ(json["phases"].size(), 2);
+  EXPECT_EQ(json["phases"][0]["phase"], "ParameterFetch");
+  EXPECT_EQ(json["phases"][1]["phase"], "SnapshotLoad");
+  EXPECT_EQ(json["num_files"], 3);
+  ASSERT_EQ(json["slowest_files"].size(), 2);
+  EXPECT_EQ(json["slowest_files"][0]["file"], "SNAPSHOT_2");
+  EXPECT_EQ(json["slowest_files"][1]["file"], "SNAPSHOT_3");
+}
+
+}  // namespace
+}  // namespace kv_server
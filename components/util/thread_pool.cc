@@ -0,0 +1,172 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/util/thread_pool.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "absl/base/const_init.h"
+
+namespace kv_server {
+namespace {
+
+// The pool whose thread is running, and the index of the thread in the pool.
+thread_local const ThreadPool* current_pool = nullptr;
+thread_local int current_thread_index = -1;
+
+absl::Mutex shared_pool_mutex(absl::kConstInit);
+int shared_pool_size ABSL_GUARDED_BY(shared_pool_mutex) = 0;
+ThreadPool* shared_pool ABSL_GUARDED_BY(shared_pool_mutex) = nullptr;
+
+}  // namespace
+
+ThreadPool::ThreadPool(int num_threads) {
+  queues_.reserve(num_threads);
+  for (int i = 0; i < num_threads; ++i) {
+    queues_.push_back(std::make_unique<Queue>());
+  }
+  threads_.reserve(num_threads);
+  for (int i = 0; i < num_threads; ++i) {
+    threads_.emplace_back(&ThreadPool::Work, this, i);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    absl::MutexLock lock(&mutex_);
+    stopping_ = true;
+  }
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+  // Without threads, the tasks are run here.
+  while (RunPendingTask()) {
+  }
+}
+
+void ThreadPool::Schedule(absl::AnyInvocable<void() &&> task) {
+  Queue& queue = current_pool == this ? *queues_[current_thread_index]
+                                      : external_queue_;
+  {
+    absl::MutexLock lock(&queue.mutex);
+    queue.tasks.push_back(std::move(task));
+  }
+  absl::MutexLock lock(&mutex_);
+  ++num_pending_;
+}
+
+void ThreadPool::Wait(const absl::Notification& notification) {
+  while (!notification.HasBeenNotified()) {
+    if (!RunPendingTask()) {
+      // The awaited task was taken by another thread. It only waits for tasks
+      // of its own, so it finishes without this one.
+      notification.WaitForNotification();
+    }
+  }
+}
+
+int64_t ThreadPool::queue_depth() const {
+  absl::MutexLock lock(&mutex_);
+  return num_pending_;
+}
+
+void ThreadPool::Work(int thread_index) {
+  current_pool = this;
+  current_thread_index = thread_index;
+  while (true) {
+    {
+      absl::MutexLock lock(&mutex_);
+      mutex_.Await(absl::Condition(this, &ThreadPool::HasTaskOrIsStopping));
+      if (num_pending_ == 0) {
+        return;
+      }
+      --num_pending_;
+    }
+    Task task = TakeTask(thread_index);
+    ++busy_threads_;
+    std::move(task)();
+    --busy_threads_;
+  }
+}
+
+bool ThreadPool::RunPendingTask() {
+  {
+    absl::MutexLock lock(&mutex_);
+    if (num_pending_ == 0) {
+      return false;
+    }
+    --num_pending_;
+  }
+  TakeTask(current_pool == this ? current_thread_index : -1)();
+  return true;
+}
+
+ThreadPool::Task ThreadPool::TakeTask(int thread_index) {
+  // The claimed task may be taken from a queue after it was looked at, by a
+  // thread that claimed a task queued later, so the queues are looked at
+  // until one has a task.
+  while (true) {
+    if (thread_index >= 0) {
+      Queue& own_queue = *queues_[thread_index];
+      absl::MutexLock lock(&own_queue.mutex);
+      if (!own_queue.tasks.empty()) {
+        Task task = std::move(own_queue.tasks.back());
+        own_queue.tasks.pop_back();
+        return task;
+      }
+    }
+    {
+      absl::MutexLock lock(&external_queue_.mutex);
+      if (!external_queue_.tasks.empty()) {
+        Task task = std::move(external_queue_.tasks.front());
+        external_queue_.tasks.pop_front();
+        return task;
+      }
+    }
+    for (int i = 1; i <= queues_.size(); ++i) {
+      Queue& queue = *queues_[(thread_index + i) % queues_.size()];
+      absl::MutexLock lock(&queue.mutex);
+      if (!queue.tasks.empty()) {
+        Task task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        return task;
+      }
+    }
+  }
+}
+
+ThreadPool& SharedThreadPool() {
+  absl::MutexLock lock(&shared_pool_mutex);
+  if (shared_pool == nullptr) {
+    const int num_threads =
+        shared_pool_size > 0
+            ? shared_pool_size
+            : std::max<int>(std::thread::hardware_concurrency(), 1);
+    // Never destroyed, its threads may be running tasks at exit.
+    shared_pool = new ThreadPool(num_threads);
+  }
+  return *shared_pool;
+}
+
+bool SetSharedThreadPoolSize(int num_threads) {
+  absl::MutexLock lock(&shared_pool_mutex);
+  if (shared_pool != nullptr) {
+    return false;
+  }
+  shared_pool_size = num_threads;
+  return true;
+}
+
+}  // namespace kv_server
@@ -0,0 +1,187 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMPONENTS_UTIL_THREAD_POOL_H_
+#define COMPONENTS_UTIL_THREAD_POOL_H_
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/functional/any_invocable.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+
+namespace kv_server {
+
+class ThreadPool;
+
+// The result of a task scheduled with `ThreadPool::Async`. Like the futures of
+// `std::async`, destroying it waits for the task, so that tasks can refer to
+// the state of their caller.
+template <typename T>
+class TaskFuture {
+ public:
+  TaskFuture(TaskFuture&&) = default;
+  TaskFuture& operator=(TaskFuture&&) = delete;
+  ~TaskFuture() {
+    if (state_ != nullptr) {
+      Wait();
+    }
+  }
+
+  // Returns the result of the task, running pending tasks of the pool until
+  // it is done. Can only be called once.
+  T Get() {
+    Wait();
+    T result = std::move(*state_->result);
+    state_ = nullptr;
+    return result;
+  }
+
+ private:
+  friend class ThreadPool;
+  struct State {
+    absl::Notification done;
+    std::optional<T> result;
+  };
+
+  TaskFuture(ThreadPool& pool, std::shared_ptr<State> state)
+      : pool_(pool), state_(std::move(state)) {}
+  void Wait();
+
+  ThreadPool& pool_;
+  std::shared_ptr<State> state_;
+};
+
+// Runs scheduled tasks on a fixed number of threads. A thread that waits for
+// one of its tasks with `Wait` runs pending tasks in the meantime, so that
+// tasks can schedule and wait for other tasks without all threads of the pool
+// waiting on tasks that no thread is left to run.
+//
+// Each thread of the pool has its own queue. Tasks scheduled by a task go to
+// the queue of its thread, which runs the most recent of them first, and
+// threads with no tasks of their own take the oldest tasks scheduled from
+// outside the pool, or else steal the oldest tasks of other threads.
+class ThreadPool {
+ public:
+  explicit ThreadPool(int num_threads);
+  // Runs the pending tasks before returning.
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  void Schedule(absl::AnyInvocable<void() &&> task) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Schedules `fn` and returns its result once it has run.
+  template <typename F>
+  TaskFuture<std::invoke_result_t<F&>> Async(F fn) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Calls `start` with a callback that it, or whatever it hands the callback
+  // to, calls with the result once it's computed outside of the pool, such as
+  // by an asynchronous call to another server. Returns that result.
+  template <typename T, typename F>
+  TaskFuture<T> FromCallback(F start);
+
+  // Runs pending tasks until `notification` is notified.
+  void Wait(const absl::Notification& notification)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  int num_threads() const { return threads_.size(); }
+  // Number of scheduled tasks that no thread has started to run.
+  int64_t queue_depth() const ABSL_LOCKS_EXCLUDED(mutex_);
+  // Number of threads of the pool that are running a task, tasks run by
+  // threads in `Wait` aren't counted.
+  int busy_threads() const { return busy_threads_; }
+
+ private:
+  using Task = absl::AnyInvocable<void() &&>;
+  struct Queue {
+    absl::Mutex mutex;
+    std::deque<Task> tasks ABSL_GUARDED_BY(mutex);
+  };
+
+  void Work(int thread_index) ABSL_LOCKS_EXCLUDED(mutex_);
+  // Runs a pending task, returns false if there is none.
+  bool RunPendingTask() ABSL_LOCKS_EXCLUDED(mutex_);
+  // Returns a pending task. Only called after claiming one, see
+  // `num_pending_`.
+  Task TakeTask(int thread_index);
+  bool HasTaskOrIsStopping() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    return num_pending_ > 0 || stopping_;
+  }
+
+  mutable absl::Mutex mutex_;
+  // Number of tasks in the queues that no thread has claimed. A thread claims
+  // a task by decrementing it, and then takes one from the queues, where
+  // there is always one since tasks are queued before they are counted.
+  int64_t num_pending_ ABSL_GUARDED_BY(mutex_) = 0;
+  bool stopping_ ABSL_GUARDED_BY(mutex_) = false;
+  // The queue of each thread, and of tasks scheduled from outside the pool.
+  std::vector<std::unique_ptr<Queue>> queues_;
+  Queue external_queue_;
+  std::atomic<int> busy_threads_ = 0;
+  std::vector<std::thread> threads_;
+};
+
+// Returns the pool shared by the tasks of the process that mostly wait, on
+// files or on other servers, such as the readers of data files and the
+// requests of sharded lookups to other shards. Bounding their threads keeps
+// them from oversubscribing the cores that serve requests. The pool is created
+// on first use, with `SetSharedThreadPoolSize` threads.
+ThreadPool& SharedThreadPool();
+
+// Sets the number of threads of `SharedThreadPool`, one per hardware thread by
+// default. Returns false, leaving the pool as it is, if it was already used.
+bool SetSharedThreadPoolSize(int num_threads);
+
+template <typename T>
+void TaskFuture<T>::Wait() {
+  pool_.Wait(state_->done);
+}
+
+template <typename F>
+TaskFuture<std::invoke_result_t<F&>> ThreadPool::Async(F fn) {
+  using T = std::invoke_result_t<F&>;
+  auto state = std::make_shared<typename TaskFuture<T>::State>();
+  Schedule([state, fn = std::move(fn)]() mutable {
+    state->result.emplace(fn());
+    state->done.Notify();
+  });
+  return TaskFuture<T>(*this, std::move(state));
+}
+
+template <typename T, typename F>
+TaskFuture<T> ThreadPool::FromCallback(F start) {
+  auto state = std::make_shared<typename TaskFuture<T>::State>();
+  start(absl::AnyInvocable<void(T) &&>([state](T result) {
+    state->result.emplace(std::move(result));
+    state->done.Notify();
+  }));
+  return TaskFuture<T>(*this, std::move(state));
+}
+
+}  // namespace kv_server
+
+#endif  // COMPONENTS_UTIL_THREAD_POOL_H_
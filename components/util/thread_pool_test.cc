@@ -0,0 +1,175 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "components/util/thread_pool.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "absl/functional/any_invocable.h"
+#include "absl/synchronization/notification.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+TEST(ThreadPoolTest, RunsScheduledTasks) {
+  ThreadPool pool(/*num_threads=*/4);
+  std::atomic<int> count = 0;
+  std::vector<std::unique_ptr<absl::Notification>> notifications;
+  for (int i = 0; i < 100; ++i) {
+    notifications.push_back(std::make_unique<absl::Notification>());
+    pool.Schedule([&count, notification = notifications.back().get()]() {
+      ++count;
+      notification->Notify();
+    });
+  }
+  for (const auto& notification : notifications) {
+    pool.Wait(*notification);
+  }
+  EXPECT_EQ(count, 100);
+}
+
+TEST(ThreadPoolTest, WaitRunsTasksWithoutThreads) {
+  ThreadPool pool(/*num_threads=*/0);
+  absl::Notification notification;
+  pool.Schedule([&notification]() { notification.Notify(); });
+  pool.Wait(notification);
+  EXPECT_TRUE(notification.HasBeenNotified());
+}
+
+TEST(ThreadPoolTest, NestedTasksDontExhaustThePool) {
+  ThreadPool pool(/*num_threads=*/1);
+  std::atomic<int> count = 0;
+  // Each task waits for the tasks that it schedules, which the single
+  // thread of the pool could never run if waiting didn't run them.
+  std::function<void(int)> run = [&pool, &count, &run](int depth) {
+    ++count;
+    if (depth == 0) {
+      return;
+    }
+    absl::Notification left_done;
+    absl::Notification right_done;
+    pool.Schedule([&run, &left_done, depth]() {
+      run(depth - 1);
+      left_done.Notify();
+    });
+    pool.Schedule([&run, &right_done, depth]() {
+      run(depth - 1);
+      right_done.Notify();
+    });
+    pool.Wait(left_done);
+    pool.Wait(right_done);
+  };
+  absl::Notification done;
+  pool.Schedule([&run, &done]() {
+    run(/*depth=*/6);
+    done.Notify();
+  });
+  pool.Wait(done);
+  EXPECT_EQ(count, 127);
+}
+
+TEST(ThreadPoolTest, DestructorRunsPendingTasks) {
+  std::atomic<int> count = 0;
+  {
+    ThreadPool pool(/*num_threads=*/2);
+    for (int i = 0; i < 10; ++i) {
+      pool.Schedule([&count]() { ++count; });
+    }
+  }
+  EXPECT_EQ(count, 10);
+}
+
+TEST(ThreadPoolTest, AsyncReturnsTheResult) {
+  ThreadPool pool(/*num_threads=*/2);
+  std::vector<TaskFuture<std::string>> futures;
+  for (int i = 0; i < 10; ++i) {
+    futures.push_back(pool.Async([i]() { return std::to_string(i); }));
+  }
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_EQ(futures[i].Get(), std::to_string(i));
+  }
+}
+
+TEST(ThreadPoolTest, DestroyingAFutureWaitsForItsTask) {
+  ThreadPool pool(/*num_threads=*/1);
+  std::atomic<bool> done = false;
+  {
+    auto future = pool.Async([&done]() {
+      done = true;
+      return 0;
+    });
+  }
+  EXPECT_TRUE(done);
+}
+
+TEST(ThreadPoolTest, FromCallbackReturnsTheResultOfTheCallback) {
+  ThreadPool pool(/*num_threads=*/1);
+  absl::AnyInvocable<void(std::string) &&> callback;
+  auto future = pool.FromCallback<std::string>(
+      [&callback](absl::AnyInvocable<void(std::string) &&> on_done) {
+        callback = std::move(on_done);
+      });
+  std::thread other_thread(
+      [&callback]() { std::move(callback)("computed elsewhere"); });
+  EXPECT_EQ(future.Get(), "computed elsewhere");
+  other_thread.join();
+}
+
+TEST(ThreadPoolTest, IdleThreadsStealTasksOfBusyThreads) {
+  ThreadPool pool(/*num_threads=*/2);
+  absl::Notification release;
+  absl::Notification stolen;
+  // The task of the first thread waits for a task that it scheduled on its
+  // own queue, which only the other thread can run.
+  auto waiting = pool.Async([&]() {
+    pool.Schedule([&stolen]() { stolen.Notify(); });
+    release.WaitForNotification();
+    return stolen.HasBeenNotified();
+  });
+  stolen.WaitForNotification();
+  release.Notify();
+  EXPECT_TRUE(waiting.Get());
+}
+
+TEST(ThreadPoolTest, ReportsQueueDepthAndBusyThreads) {
+  ThreadPool pool(/*num_threads=*/1);
+  absl::Notification started;
+  absl::Notification release;
+  pool.Schedule([&]() {
+    started.Notify();
+    release.WaitForNotification();
+  });
+  started.WaitForNotification();
+  pool.Schedule([]() {});
+  pool.Schedule([]() {});
+  EXPECT_EQ(pool.busy_threads(), 1);
+  EXPECT_EQ(pool.queue_depth(), 2);
+  release.Notify();
+}
+
+TEST(ThreadPoolTest, SharedPoolSizeIsSetBeforeFirstUse) {
+  EXPECT_TRUE(SetSharedThreadPoolSize(3));
+  EXPECT_EQ(SharedThreadPool().num_threads(), 3);
+  EXPECT_FALSE(SetSharedThreadPoolSize(5));
+  EXPECT_EQ(&SharedThreadPool(), &SharedThreadPool());
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -262,7 +262,7 @@ variable "use_sharding_key_regex" {
 }
 
 variable "sharding_key_regex" {
-  description = "Sharding key regex."
+  description = "Sharding key regex, whose first group is the sharding key. Delimiter and prefix patterns such as ([^_]*)_.*, (.*)_.* or (.{4}).* are matched without evaluating the regex."
   default     = ""
   type        = string
 }
@@ -16,6 +16,7 @@
 
 #include "public/data_loading/aggregation/record_aggregator.h"
 
+#include <filesystem>
 #include <iostream>
 #include <sstream>
 #include <utility>
@@ -245,11 +246,29 @@ void RecordAggregator::DbDeleter::operator()(sqlite3* db) noexcept {
   sqlite3_close(db);
 }
 
+RecordAggregator::~RecordAggregator() = default;
+
 absl::StatusOr<std::unique_ptr<RecordAggregator>>
 RecordAggregator::CreateInMemoryAggregator() {
   return CreateFileBackedAggregator(kInMemoryPath);
 }
 
+absl::StatusOr<std::unique_ptr<RecordAggregator>>
+RecordAggregator::CreateSortMergeAggregator(SortMergeOptions options) {
+  if (options.memory_budget_bytes <= 0) {
+    return absl::InvalidArgumentError("Memory budget must be positive.");
+  }
+  if (options.spill_directory.empty()) {
+    options.spill_directory = std::filesystem::temp_directory_path().string();
+  }
+  if (!std::filesystem::is_directory(options.spill_directory)) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Spill directory: ", options.spill_directory, " does not exist."));
+  }
+  return absl::WrapUnique(new RecordAggregator(
+      std::make_unique<SortMergeRecordStore>(std::move(options))));
+}
+
 absl::StatusOr<std::unique_ptr<RecordAggregator>>
 RecordAggregator::CreateFileBackedAggregator(std::string_view data_file) {
   sqlite3* db;
@@ -297,11 +316,37 @@ RecordAggregator::MergeSetValueIfRecordExists(
   return merged_values_list;
 }
 
+absl::StatusOr<std::vector<uint32_t>>
+RecordAggregator::MergeUInt32SetValueIfRecordExists(
+    int64_t record_key, const KeyValueMutationRecordStruct& record) {
+  const auto& new_values_set = std::get<std::vector<uint32_t>>(record.value);
+  absl::flat_hash_set<uint32_t> merged_values_set(new_values_set.begin(),
+                                                  new_values_set.end());
+  auto status = ReadRecord(
+      record_key,
+      [&merged_values_set](KeyValueMutationRecordStruct existing_record) {
+        if (const auto* existing_values_set =
+                std::get_if<std::vector<uint32_t>>(&existing_record.value)) {
+          merged_values_set.insert(existing_values_set->begin(),
+                                   existing_values_set->end());
+        }
+        return absl::OkStatus();
+      });
+  if (!status.ok()) {
+    return status;
+  }
+  return std::vector<uint32_t>(merged_values_set.begin(),
+                               merged_values_set.end());
+}
+
 absl::Status RecordAggregator::InsertOrUpdateRecord(
     int64_t record_key, const KeyValueMutationRecordStruct& record) {
   if (absl::Status status = ValidateRecord(record); !status.ok()) {
     return status;
   }
+  if (store_ != nullptr) {
+    return store_->InsertOrUpdateRecord(record_key, record);
+  }
   KeyValueMutationRecordStruct mutable_record = record;
   std::vector<std::string> values;
   if (std::holds_alternative<std::vector<std::string_view>>(
@@ -313,6 +358,14 @@ absl::Status RecordAggregator::InsertOrUpdateRecord(
     values = std::move(*maybe_values);
     mutable_record.value =
         std::vector<std::string_view>(values.begin(), values.end());
+  } else if (std::holds_alternative<std::vector<uint32_t>>(
+                 mutable_record.value)) {
+    auto maybe_values =
+        MergeUInt32SetValueIfRecordExists(record_key, mutable_record);
+    if (!maybe_values.ok()) {
+      return maybe_values.status();
+    }
+    mutable_record.value = std::move(*maybe_values);
   }
   sqlite3_stmt* insert_stmt;
   if (absl::Status status =
@@ -334,7 +387,7 @@ absl::Status RecordAggregator::InsertOrUpdateRecord(
     return status;
   }
   if (absl::Status status =
-          BindBlob(ToStringView(ToFlatBufferBuilder(mutable_record)),
+          BindBlob(SerializeKeyValueMutationRecord(mutable_record),
                    kRecordBlobBindValueIdx, owned_stmt.get());
       !status.ok()) {
     return status;
@@ -350,6 +403,9 @@ absl::Status RecordAggregator::InsertOrUpdateRecord(
 absl::Status RecordAggregator::ReadRecord(
     int64_t record_key,
     std::function<absl::Status(KeyValueMutationRecordStruct)> record_callback) {
+  if (store_ != nullptr) {
+    return store_->ReadRecord(record_key, record_callback);
+  }
   sqlite3_stmt* select_stmt;
   if (absl::Status status =
           PrepareStatement(kSelectRecordSql, &select_stmt, db_.get());
@@ -378,6 +434,9 @@ absl::Status RecordAggregator::ReadRecord(
 
 absl::Status RecordAggregator::ReadRecords(
     std::function<absl::Status(KeyValueMutationRecordStruct)> record_callback) {
+  if (store_ != nullptr) {
+    return store_->ReadRecords(record_callback);
+  }
   sqlite3_stmt* batch_select_stmt;
   if (absl::Status status = PrepareStatement(kBatchSelectRecordsSql,
                                              &batch_select_stmt, db_.get());
@@ -434,6 +493,9 @@ absl::Status RecordAggregator::ReadRecords(
 }
 
 absl::Status RecordAggregator::DeleteRecord(int64_t record_key) {
+  if (store_ != nullptr) {
+    return store_->DeleteRecord(record_key);
+  }
   auto sql = absl::StrFormat(kDeleteRecordSql, record_key);
   if (sqlite3_exec(db_.get(), sql.c_str(), /*callback=*/nullptr,
                    /*callback_arg0=*/0, /*errmsg=*/nullptr) != SQLITE_OK) {
@@ -444,6 +506,9 @@ absl::Status RecordAggregator::DeleteRecord(int64_t record_key) {
 }
 
 absl::Status RecordAggregator::DeleteRecords() {
+  if (store_ != nullptr) {
+    return store_->DeleteRecords();
+  }
   if (sqlite3_exec(db_.get(), kDeleteAllRecordsSql.data(),
                    /*callback=*/nullptr,
                    /*callback_arg0=*/0, /*errmsg=*/nullptr) != SQLITE_OK) {
@@ -27,6 +27,7 @@
 
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "public/data_loading/aggregation/sort_merge_record_store.h"
 #include "public/data_loading/records_utils.h"
 
 #include "sqlite3.h"
@@ -56,7 +57,9 @@ namespace kv_server {
 //```
 class RecordAggregator {
  public:
-  ~RecordAggregator() = default;
+  using SortMergeOptions = SortMergeRecordStore::Options;
+
+  ~RecordAggregator();
   RecordAggregator(const RecordAggregator&) = delete;
   RecordAggregator& operator=(const RecordAggregator&) = delete;
 
@@ -72,6 +75,15 @@ class RecordAggregator {
   // Returns a `not ok()` status if creating the aggregator fails.
   static absl::StatusOr<std::unique_ptr<RecordAggregator>>
   CreateFileBackedAggregator(std::string_view data_file);
+  // Creates a `RecordAggregator` that aggregates records in a hash table by
+  // their keys, and spills them to sorted runs on disk when they take more
+  // memory than `options.memory_budget_bytes`, see `SortMergeRecordStore`.
+  // Much faster than SQLite for large numbers of records, but finding or
+  // deleting a single record merges all the runs.
+  //
+  // Returns a `not ok()` status if creating the aggregator fails.
+  static absl::StatusOr<std::unique_ptr<RecordAggregator>>
+  CreateSortMergeAggregator(SortMergeOptions options);
   // Inserts new record into aggregator or updates the existing record if the
   // record to be inserted is newer than the existing record, otherwise the
   // record is ignored. Newer records are defined as having a larger
@@ -130,11 +142,17 @@ class RecordAggregator {
   };
   explicit RecordAggregator(std::unique_ptr<sqlite3, DbDeleter> db)
       : db_(std::move(db)) {}
+  explicit RecordAggregator(std::unique_ptr<SortMergeRecordStore> store)
+      : store_(std::move(store)) {}
 
   absl::StatusOr<std::vector<std::string>> MergeSetValueIfRecordExists(
       int64_t record_key, const KeyValueMutationRecordStruct& record);
+  absl::StatusOr<std::vector<uint32_t>> MergeUInt32SetValueIfRecordExists(
+      int64_t record_key, const KeyValueMutationRecordStruct& record);
 
   std::unique_ptr<sqlite3, DbDeleter> db_;
+  // Set instead of `db_` by `CreateSortMergeAggregator`.
+  std::unique_ptr<SortMergeRecordStore> store_;
 };
 }  // namespace kv_server
 
@@ -14,6 +14,11 @@
  * limitations under the License.
  */
 
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "absl/functional/function_ref.h"
 #include "absl/hash/hash.h"
 #include "absl/strings/str_cat.h"
 #include "benchmark/benchmark.h"
@@ -28,8 +33,8 @@ static std::string GenerateRecordValue(int64_t char_count) {
   return std::string(char_count, 'A' + (std::rand() % 15));
 }
 
-static void BM_InMemoryRecordAggregator_InsertRecord(benchmark::State& state) {
-  auto record_aggregator = RecordAggregator::CreateInMemoryAggregator();
+static void InsertRecords(benchmark::State& state,
+                          RecordAggregator& record_aggregator) {
   std::string record_value = GenerateRecordValue(state.range(0));
   KeyValueMutationRecordStruct record{
       .mutation_type = KeyValueMutationType::Update,
@@ -41,12 +46,70 @@ static void BM_InMemoryRecordAggregator_InsertRecord(benchmark::State& state) {
     record.key = record_key;
     size_t record_hash = absl::HashOf(record.key);
     state.ResumeTiming();
-    auto ignored =
-        (*record_aggregator)->InsertOrUpdateRecord(record_hash, record);
+    auto ignored = record_aggregator.InsertOrUpdateRecord(record_hash, record);
   }
   state.SetBytesProcessed(state.range(0) * state.iterations());
 }
 
+// Inserts `state.range(1)` distinct records and reads them all back.
+static void AggregateRecords(
+    benchmark::State& state,
+    absl::FunctionRef<std::unique_ptr<RecordAggregator>()> create_aggregator) {
+  std::string record_value = GenerateRecordValue(state.range(0));
+  for (auto _ : state) {
+    auto record_aggregator = create_aggregator();
+    for (int64_t i = 0; i < state.range(1); i++) {
+      std::string record_key = absl::StrCat("key", i);
+      KeyValueMutationRecordStruct record{
+          .mutation_type = KeyValueMutationType::Update,
+          .logical_commit_time = 1234567890,
+          .key = record_key,
+          .value = record_value};
+      auto ignored = record_aggregator->InsertOrUpdateRecord(
+          absl::HashOf(record.key), record);
+    }
+    auto ignored = record_aggregator->ReadRecords(
+        [](const KeyValueMutationRecordStruct& record) {
+          benchmark::DoNotOptimize(record);
+          return absl::OkStatus();
+        });
+  }
+  state.SetItemsProcessed(state.range(1) * state.iterations());
+}
+
+static void BM_InMemoryRecordAggregator_InsertRecord(benchmark::State& state) {
+  auto record_aggregator = RecordAggregator::CreateInMemoryAggregator();
+  InsertRecords(state, **record_aggregator);
+}
+
+static void BM_SortMergeRecordAggregator_InsertRecord(
+    benchmark::State& state) {
+  auto record_aggregator = RecordAggregator::CreateSortMergeAggregator({});
+  InsertRecords(state, **record_aggregator);
+}
+
+static void BM_InMemoryRecordAggregator_AggregateRecords(
+    benchmark::State& state) {
+  AggregateRecords(state, [] {
+    return std::move(RecordAggregator::CreateInMemoryAggregator()).value();
+  });
+}
+
+// Spills a run to disk every 1MB of records.
+static void BM_SortMergeRecordAggregator_AggregateRecords(
+    benchmark::State& state) {
+  AggregateRecords(state, [] {
+    return std::move(RecordAggregator::CreateSortMergeAggregator(
+                         {.memory_budget_bytes = 1 << 20}))
+        .value();
+  });
+}
+
 BENCHMARK(BM_InMemoryRecordAggregator_InsertRecord)->Range(64, 8192);
+BENCHMARK(BM_SortMergeRecordAggregator_InsertRecord)->Range(64, 8192);
+BENCHMARK(BM_InMemoryRecordAggregator_AggregateRecords)
+    ->Ranges({{64, 1024}, {1'000, 100'000}});
+BENCHMARK(BM_SortMergeRecordAggregator_AggregateRecords)
+    ->Ranges({{64, 1024}, {1'000, 100'000}});
 
 BENCHMARK_MAIN();
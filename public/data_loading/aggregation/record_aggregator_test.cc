@@ -51,23 +51,34 @@ std::string GetTempDbFilepath() {
                          "RecordAggregatorTest", std::rand());
 }
 
-class RecordAggregatorTest : public ::testing::TestWithParam<bool> {
+enum class Backend { kInMemory, kFileBacked, kSortMerge };
+
+class RecordAggregatorTest : public ::testing::TestWithParam<Backend> {
  protected:
   absl::StatusOr<std::unique_ptr<RecordAggregator>> CreateAggregator() {
-    if ((bool)GetParam()) {
-      return RecordAggregator::CreateInMemoryAggregator();
-    } else {
-      auto db_file = GetTempDbFilepath();
-      if (std::filesystem::exists(db_file)) {
-        EXPECT_TRUE(std::filesystem::remove(db_file));
+    switch (GetParam()) {
+      case Backend::kInMemory:
+        return RecordAggregator::CreateInMemoryAggregator();
+      case Backend::kFileBacked: {
+        auto db_file = GetTempDbFilepath();
+        if (std::filesystem::exists(db_file)) {
+          EXPECT_TRUE(std::filesystem::remove(db_file));
+        }
+        return RecordAggregator::CreateFileBackedAggregator(db_file);
       }
-      return RecordAggregator::CreateFileBackedAggregator(db_file);
+      case Backend::kSortMerge:
+        // Spills every record, to aggregate them across the runs.
+        return RecordAggregator::CreateSortMergeAggregator(
+            {.memory_budget_bytes = 1});
     }
+    return absl::InvalidArgumentError("Unknown backend.");
   }
 };
 
-INSTANTIATE_TEST_SUITE_P(IsInMemoryBacked, RecordAggregatorTest,
-                         testing::Values(true, false));
+INSTANTIATE_TEST_SUITE_P(Backends, RecordAggregatorTest,
+                         testing::Values(Backend::kInMemory,
+                                         Backend::kFileBacked,
+                                         Backend::kSortMerge));
 
 TEST_P(RecordAggregatorTest, ValidateReadRecord) {
   auto record_aggregator = RecordAggregatorTest::CreateAggregator();
@@ -402,5 +413,58 @@ TEST_P(RecordAggregatorTest, ValidateAggregatingRecordsWithSetValues) {
       (*record_aggregator)->ReadRecords(record_callback.AsStdFunction()).ok());
 }
 
+TEST_P(RecordAggregatorTest, ValidateAggregatingRecordsWithUInt32SetValues) {
+  auto record_aggregator = RecordAggregatorTest::CreateAggregator();
+  auto status = (*record_aggregator)->DeleteRecords();
+  EXPECT_TRUE(status.ok()) << status;
+  testing::MockFunction<absl::Status(KeyValueMutationRecordStruct)>
+      record_callback;
+  auto record1 =
+      GetDeltaRecord("key1", std::vector<uint32_t>{1, 2, 3, 4000000000u});
+  status = (*record_aggregator)
+               ->InsertOrUpdateRecord(GetRecordKey(record1), record1);
+  EXPECT_TRUE(status.ok()) << status;
+  auto record2 = GetDeltaRecord("key1", std::vector<uint32_t>{3, 5});
+  record2.logical_commit_time = record1.logical_commit_time + 1;
+  status = (*record_aggregator)
+               ->InsertOrUpdateRecord(GetRecordKey(record2), record2);
+  EXPECT_TRUE(status.ok()) << status;
+  EXPECT_CALL(record_callback, Call)
+      .WillOnce([&record2](KeyValueMutationRecordStruct record) {
+        EXPECT_THAT(std::get<std::vector<uint32_t>>(record.value),
+                    testing::UnorderedElementsAre(1, 2, 3, 4000000000u, 5));
+        EXPECT_EQ(record.logical_commit_time, record2.logical_commit_time);
+        return absl::OkStatus();
+      });
+  EXPECT_TRUE(
+      (*record_aggregator)->ReadRecords(record_callback.AsStdFunction()).ok());
+}
+
+TEST_P(RecordAggregatorTest, ValidateSetOfAnotherTypeReplacesTheSet) {
+  auto record_aggregator = RecordAggregatorTest::CreateAggregator();
+  auto status = (*record_aggregator)->DeleteRecords();
+  EXPECT_TRUE(status.ok()) << status;
+  testing::MockFunction<absl::Status(KeyValueMutationRecordStruct)>
+      record_callback;
+  auto record1 =
+      GetDeltaRecord("key1", std::vector<std::string_view>{"1", "2"});
+  status = (*record_aggregator)
+               ->InsertOrUpdateRecord(GetRecordKey(record1), record1);
+  EXPECT_TRUE(status.ok()) << status;
+  auto record2 = GetDeltaRecord("key1", std::vector<uint32_t>{3});
+  record2.logical_commit_time = record1.logical_commit_time + 1;
+  status = (*record_aggregator)
+               ->InsertOrUpdateRecord(GetRecordKey(record2), record2);
+  EXPECT_TRUE(status.ok()) << status;
+  EXPECT_CALL(record_callback, Call)
+      .WillOnce([](KeyValueMutationRecordStruct record) {
+        EXPECT_THAT(std::get<std::vector<uint32_t>>(record.value),
+                    testing::ElementsAre(3));
+        return absl::OkStatus();
+      });
+  EXPECT_TRUE(
+      (*record_aggregator)->ReadRecords(record_callback.AsStdFunction()).ok());
+}
+
 }  // namespace
 }  // namespace kv_server
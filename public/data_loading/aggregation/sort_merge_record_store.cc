@@ -0,0 +1,421 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "public/data_loading/aggregation/sort_merge_record_store.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <queue>
+#include <utility>
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/str_cat.h"
+
+namespace kv_server {
+namespace {
+
+// Approximate bytes of memory taken by an entry besides its key and records.
+constexpr int64_t kEntryOverheadBytes = 64;
+
+template <typename T>
+void WriteInt(std::ofstream& stream, T value) {
+  stream.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void WriteBytes(std::ofstream& stream, std::string_view bytes) {
+  WriteInt<uint32_t>(stream, bytes.size());
+  stream.write(bytes.data(), bytes.size());
+}
+
+template <typename T>
+bool ReadInt(std::ifstream& stream, T& value) {
+  return static_cast<bool>(
+      stream.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+bool ReadBytes(std::ifstream& stream, std::string& bytes) {
+  uint32_t size;
+  if (!ReadInt(stream, size)) {
+    return false;
+  }
+  bytes.resize(size);
+  return static_cast<bool>(stream.read(bytes.data(), size));
+}
+
+std::string Serialize(const KeyValueMutationRecordStruct& record) {
+  return std::string(SerializeKeyValueMutationRecord(record));
+}
+
+}  // namespace
+
+// Reads the entries of a run in key order.
+class SortMergeRecordStore::RunReader {
+ public:
+  explicit RunReader(const std::string& path)
+      : path_(path), stream_(path, std::ios::binary) {
+    if (!stream_) {
+      status_ = absl::InternalError(absl::StrCat("Failed to open ", path));
+    }
+  }
+
+  // Reads the next entry. Returns false at the end of the run, or if it
+  // failed.
+  bool Next() {
+    if (!status_.ok() || stream_.peek() == std::ifstream::traits_type::eof()) {
+      return false;
+    }
+    uint32_t num_versions;
+    if (!ReadBytes(stream_, key) || !ReadInt(stream_, entry.record_key) ||
+        !ReadInt(stream_, num_versions)) {
+      return Fail();
+    }
+    entry.versions.resize(num_versions);
+    for (Version& version : entry.versions) {
+      uint8_t is_set;
+      if (!ReadInt(stream_, version.logical_commit_time) ||
+          !ReadInt(stream_, is_set) || !ReadBytes(stream_, version.record)) {
+        return Fail();
+      }
+      version.is_set = is_set != 0;
+    }
+    return true;
+  }
+
+  const absl::Status& status() const { return status_; }
+
+  std::string key;
+  Entry entry;
+
+ private:
+  bool Fail() {
+    status_ = absl::DataLossError(absl::StrCat("Failed to read ", path_));
+    return false;
+  }
+
+  const std::string path_;
+  std::ifstream stream_;
+  absl::Status status_;
+};
+
+// Replays the records accepted for a key the way `InsertOrUpdateRecord`
+// applies them.
+class SortMergeRecordStore::VersionFold {
+ public:
+  absl::Status Apply(std::string_view serialized_record) {
+    return DeserializeRecord(
+        serialized_record, [this](const KeyValueMutationRecordStruct& record) {
+          if (has_record_ &&
+              record.logical_commit_time < logical_commit_time_) {
+            return absl::OkStatus();
+          }
+          // Sets are merged into the set of the same type they replace.
+          const ValueType value_type = GetValueType(record);
+          if (value_type != value_type_) {
+            set_values_.clear();
+            uint32_set_values_.clear();
+          }
+          if (const auto* values =
+                  std::get_if<std::vector<std::string_view>>(&record.value)) {
+            set_values_.insert(values->begin(), values->end());
+          } else if (const auto* uint32_values =
+                         std::get_if<std::vector<uint32_t>>(&record.value)) {
+            uint32_set_values_.insert(uint32_values->begin(),
+                                      uint32_values->end());
+          } else {
+            value_ = std::string(std::get<std::string_view>(record.value));
+          }
+          has_record_ = true;
+          value_type_ = value_type;
+          logical_commit_time_ = record.logical_commit_time;
+          mutation_type_ = record.mutation_type;
+          return absl::OkStatus();
+        });
+  }
+
+  bool has_record() const { return has_record_; }
+  int64_t logical_commit_time() const { return logical_commit_time_; }
+
+  // Valid until the next call.
+  KeyValueMutationRecordStruct ToRecord(std::string_view key) {
+    KeyValueMutationRecordStruct record{
+        .mutation_type = mutation_type_,
+        .logical_commit_time = logical_commit_time_,
+        .key = key};
+    switch (value_type_) {
+      case ValueType::kStringSet:
+        set_value_views_.assign(set_values_.begin(), set_values_.end());
+        record.value = set_value_views_;
+        break;
+      case ValueType::kUInt32Set:
+        record.value = std::vector<uint32_t>(uint32_set_values_.begin(),
+                                             uint32_set_values_.end());
+        break;
+      case ValueType::kString:
+        record.value = std::string_view(value_);
+        break;
+    }
+    return record;
+  }
+
+ private:
+  enum class ValueType { kString, kStringSet, kUInt32Set };
+
+  static ValueType GetValueType(const KeyValueMutationRecordStruct& record) {
+    if (std::holds_alternative<std::vector<std::string_view>>(record.value)) {
+      return ValueType::kStringSet;
+    }
+    if (std::holds_alternative<std::vector<uint32_t>>(record.value)) {
+      return ValueType::kUInt32Set;
+    }
+    return ValueType::kString;
+  }
+
+  bool has_record_ = false;
+  ValueType value_type_ = ValueType::kString;
+  int64_t logical_commit_time_ = 0;
+  KeyValueMutationType mutation_type_ = KeyValueMutationType::Update;
+  std::string value_;
+  absl::flat_hash_set<std::string> set_values_;
+  std::vector<std::string_view> set_value_views_;
+  absl::flat_hash_set<uint32_t> uint32_set_values_;
+};
+
+SortMergeRecordStore::SortMergeRecordStore(Options options)
+    : options_(std::move(options)) {}
+
+SortMergeRecordStore::~SortMergeRecordStore() { DeleteRecords().IgnoreError(); }
+
+absl::Status SortMergeRecordStore::InsertOrUpdateRecord(
+    int64_t record_key, const KeyValueMutationRecordStruct& record) {
+  auto [it, inserted] = entries_.try_emplace(record.key);
+  Entry& entry = it->second;
+  if (inserted) {
+    num_bytes_ += record.key.size() + kEntryOverheadBytes;
+  } else if (record.logical_commit_time <
+             entry.versions.back().logical_commit_time) {
+    return absl::OkStatus();
+  }
+  entry.record_key = record_key;
+  const bool is_set =
+      std::holds_alternative<std::vector<std::string_view>>(record.value) ||
+      std::holds_alternative<std::vector<uint32_t>>(record.value);
+  Version version{.logical_commit_time = record.logical_commit_time,
+                  .is_set = is_set,
+                  .record = Serialize(record)};
+  // Without runs, no spilled record can reject the set, so it is merged
+  // right away.
+  if (is_set && runs_.empty() && !entry.versions.empty()) {
+    VersionFold fold;
+    for (std::string_view serialized_record :
+         {std::string_view(entry.versions.back().record),
+          std::string_view(version.record)}) {
+      if (absl::Status status = fold.Apply(serialized_record); !status.ok()) {
+        return status;
+      }
+    }
+    version.record = Serialize(fold.ToRecord(record.key));
+  }
+  // A record that isn't a set, or a merged set, replaces all the earlier
+  // ones.
+  if (!is_set || runs_.empty()) {
+    for (const Version& replaced : entry.versions) {
+      num_bytes_ -= replaced.record.size();
+    }
+    entry.versions.clear();
+  }
+  num_bytes_ += version.record.size();
+  entry.versions.push_back(std::move(version));
+  if (num_bytes_ > options_.memory_budget_bytes) {
+    return Spill();
+  }
+  return absl::OkStatus();
+}
+
+absl::Status SortMergeRecordStore::Spill() {
+  std::vector<std::pair<const std::string, Entry>*> sorted_entries;
+  sorted_entries.reserve(entries_.size());
+  for (auto& key_entry : entries_) {
+    sorted_entries.push_back(&key_entry);
+  }
+  std::sort(sorted_entries.begin(), sorted_entries.end(),
+            [](const auto* a, const auto* b) { return a->first < b->first; });
+  const std::string path =
+      (std::filesystem::path(options_.spill_directory) /
+       absl::StrCat("RecordAggregator.", getpid(), ".",
+                    reinterpret_cast<uintptr_t>(this), ".", runs_.size(),
+                    ".run"))
+          .string();
+  std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+  for (const auto* key_entry : sorted_entries) {
+    const Entry& entry = key_entry->second;
+    WriteBytes(stream, key_entry->first);
+    WriteInt(stream, entry.record_key);
+    WriteInt<uint32_t>(stream, entry.versions.size());
+    for (const Version& version : entry.versions) {
+      WriteInt(stream, version.logical_commit_time);
+      WriteInt<uint8_t>(stream, version.is_set ? 1 : 0);
+      WriteBytes(stream, version.record);
+    }
+  }
+  stream.close();
+  if (!stream) {
+    std::error_code error;
+    std::filesystem::remove(path, error);
+    return absl::InternalError(absl::StrCat("Failed to write ", path));
+  }
+  runs_.push_back(path);
+  entries_.clear();
+  num_bytes_ = 0;
+  return absl::OkStatus();
+}
+
+absl::Status SortMergeRecordStore::Merge(
+    const std::function<bool(int64_t record_key)>& filter,
+    const std::function<absl::Status(KeyValueMutationRecordStruct)>&
+        record_callback) {
+  // Sources are the runs, oldest first, then the table.
+  std::vector<std::unique_ptr<RunReader>> readers;
+  readers.reserve(runs_.size());
+  for (const std::string& run : runs_) {
+    readers.push_back(std::make_unique<RunReader>(run));
+  }
+  std::vector<const std::pair<const std::string, Entry>*> table;
+  table.reserve(entries_.size());
+  for (const auto& key_entry : entries_) {
+    table.push_back(&key_entry);
+  }
+  std::sort(table.begin(), table.end(),
+            [](const auto* a, const auto* b) { return a->first < b->first; });
+  size_t table_pos = 0;
+  const size_t table_source = readers.size();
+  // The current key of each source, smallest first.
+  using HeapItem = std::pair<std::string_view, size_t>;
+  std::priority_queue<HeapItem, std::vector<HeapItem>, std::greater<>> heap;
+  const auto advance = [&](size_t source) {
+    if (source == table_source) {
+      if (table_pos < table.size()) {
+        heap.push({table[table_pos]->first, source});
+      }
+    } else if (readers[source]->Next()) {
+      heap.push({readers[source]->key, source});
+    }
+  };
+  for (size_t source = 0; source < readers.size(); ++source) {
+    advance(source);
+  }
+  advance(table_source);
+  std::vector<size_t> sources;
+  while (!heap.empty()) {
+    const std::string key(heap.top().first);
+    sources.clear();
+    while (!heap.empty() && heap.top().first == key) {
+      sources.push_back(heap.top().second);
+      heap.pop();
+    }
+    std::sort(sources.begin(), sources.end());
+    VersionFold fold;
+    for (const size_t source : sources) {
+      const Entry& entry = source == table_source
+                               ? table[table_pos]->second
+                               : readers[source]->entry;
+      if (!filter(entry.record_key)) {
+        continue;
+      }
+      if (const auto it = deleted_before_run_.find(entry.record_key);
+          source != table_source && it != deleted_before_run_.end() &&
+          source < it->second) {
+        continue;
+      }
+      for (const Version& version : entry.versions) {
+        if (absl::Status status = fold.Apply(version.record); !status.ok()) {
+          return status;
+        }
+      }
+    }
+    if (fold.has_record()) {
+      if (absl::Status status = record_callback(fold.ToRecord(key));
+          !status.ok()) {
+        return status;
+      }
+    }
+    for (const size_t source : sources) {
+      if (source == table_source) {
+        ++table_pos;
+      }
+      advance(source);
+    }
+  }
+  for (const auto& reader : readers) {
+    if (!reader->status().ok()) {
+      return reader->status();
+    }
+  }
+  return absl::OkStatus();
+}
+
+absl::Status SortMergeRecordStore::ReadRecord(
+    int64_t record_key,
+    const std::function<absl::Status(KeyValueMutationRecordStruct)>&
+        record_callback) {
+  return Merge(
+      [record_key](int64_t entry_record_key) {
+        return entry_record_key == record_key;
+      },
+      record_callback);
+}
+
+absl::Status SortMergeRecordStore::ReadRecords(
+    const std::function<absl::Status(KeyValueMutationRecordStruct)>&
+        record_callback) {
+  return Merge([](int64_t) { return true; }, record_callback);
+}
+
+absl::Status SortMergeRecordStore::DeleteRecord(int64_t record_key) {
+  for (auto it = entries_.begin(); it != entries_.end();) {
+    if (it->second.record_key != record_key) {
+      ++it;
+      continue;
+    }
+    num_bytes_ -= it->first.size() + kEntryOverheadBytes;
+    for (const Version& version : it->second.versions) {
+      num_bytes_ -= version.record.size();
+    }
+    entries_.erase(it++);
+  }
+  if (!runs_.empty()) {
+    deleted_before_run_[record_key] = runs_.size();
+  }
+  return absl::OkStatus();
+}
+
+absl::Status SortMergeRecordStore::DeleteRecords() {
+  for (const std::string& run : runs_) {
+    std::error_code error;
+    std::filesystem::remove(run, error);
+  }
+  runs_.clear();
+  entries_.clear();
+  deleted_before_run_.clear();
+  num_bytes_ = 0;
+  return absl::OkStatus();
+}
+
+}  // namespace kv_server
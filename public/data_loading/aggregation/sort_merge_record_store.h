@@ -0,0 +1,112 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef PUBLIC_DATA_LOADING_AGGREGATION_SORT_MERGE_RECORD_STORE_H_
+#define PUBLIC_DATA_LOADING_AGGREGATION_SORT_MERGE_RECORD_STORE_H_
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "public/data_loading/records_utils.h"
+
+namespace kv_server {
+
+// Aggregates `KeyValueMutationRecordStruct` records by key, with the same
+// semantics as the SQLite tables of `RecordAggregator`, in a hash table keyed
+// by the record keys. Once the records held take more than
+// `memory_budget_bytes`, they are written sorted by key to a run file in
+// `spill_directory`, and `ReadRecords` merges the runs with the table.
+//
+// A record replaces the record of its key unless it is older, and set values
+// are merged into the set they replace. Whether a record is older than the
+// record it would replace depends on records that may have been spilled, so
+// the table keeps the records that it accepted for each key, from the last
+// one that isn't a set, and the merge replays them after the records of the
+// runs.
+//
+// Built for bulk aggregation: `ReadRecord` merges all the runs, and
+// `DeleteRecord` only marks the records of the runs as deleted.
+//
+// Not thread-safe.
+class SortMergeRecordStore {
+ public:
+  struct Options {
+    int64_t memory_budget_bytes = int64_t{1} << 30;
+    // Must exist. The runs are removed with the store.
+    std::string spill_directory;
+  };
+
+  explicit SortMergeRecordStore(Options options);
+  ~SortMergeRecordStore();
+  SortMergeRecordStore(const SortMergeRecordStore&) = delete;
+  SortMergeRecordStore& operator=(const SortMergeRecordStore&) = delete;
+
+  // `record_key` is the key that `ReadRecord` and `DeleteRecord` find the
+  // record by. Records are aggregated by `record.key`.
+  absl::Status InsertOrUpdateRecord(int64_t record_key,
+                                    const KeyValueMutationRecordStruct& record);
+  absl::Status ReadRecord(
+      int64_t record_key,
+      const std::function<absl::Status(KeyValueMutationRecordStruct)>&
+          record_callback);
+  // Reads the records sorted by key.
+  absl::Status ReadRecords(
+      const std::function<absl::Status(KeyValueMutationRecordStruct)>&
+          record_callback);
+  absl::Status DeleteRecord(int64_t record_key);
+  absl::Status DeleteRecords();
+
+  int64_t num_runs() const { return runs_.size(); }
+
+ private:
+  // A record accepted for a key, serialized.
+  struct Version {
+    int64_t logical_commit_time;
+    bool is_set;
+    std::string record;
+  };
+  struct Entry {
+    int64_t record_key;
+    // Sorted by logical commit time, the last one is the current record.
+    std::vector<Version> versions;
+  };
+
+  class RunReader;
+  class VersionFold;
+
+  absl::Status Spill();
+  absl::Status Merge(
+      const std::function<bool(int64_t record_key)>& filter,
+      const std::function<absl::Status(KeyValueMutationRecordStruct)>&
+          record_callback);
+
+  const Options options_;
+  absl::flat_hash_map<std::string, Entry> entries_;
+  int64_t num_bytes_ = 0;
+  std::vector<std::string> runs_;
+  // Records of the runs before the run at the index are deleted.
+  absl::flat_hash_map<int64_t, size_t> deleted_before_run_;
+};
+
+}  // namespace kv_server
+
+#endif  // PUBLIC_DATA_LOADING_AGGREGATION_SORT_MERGE_RECORD_STORE_H_
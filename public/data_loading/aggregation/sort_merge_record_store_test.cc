@@ -0,0 +1,172 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "public/data_loading/aggregation/sort_merge_record_store.h"
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/hash/hash.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+using testing::ElementsAre;
+using testing::Pair;
+
+KeyValueMutationRecordStruct Record(std::string_view key,
+                                    KeyValueMutationRecordValueT value,
+                                    int64_t logical_commit_time) {
+  return {.mutation_type = KeyValueMutationType::Update,
+          .logical_commit_time = logical_commit_time,
+          .key = key,
+          .value = value};
+}
+
+absl::Status Insert(SortMergeRecordStore& store,
+                    const KeyValueMutationRecordStruct& record) {
+  return store.InsertOrUpdateRecord(absl::HashOf(record.key), record);
+}
+
+// Returns the string value, or the sorted set values joined by commas, and
+// the logical commit time of each record, in the order they're read.
+std::vector<std::pair<std::string, std::string>> ReadAll(
+    SortMergeRecordStore& store) {
+  std::vector<std::pair<std::string, std::string>> records;
+  EXPECT_TRUE(store
+                  .ReadRecords([&records](KeyValueMutationRecordStruct record) {
+                    std::string value;
+                    if (const auto* values =
+                            std::get_if<std::vector<std::string_view>>(
+                                &record.value)) {
+                      std::vector<std::string_view> sorted = *values;
+                      std::sort(sorted.begin(), sorted.end());
+                      value = absl::StrJoin(sorted, ",");
+                    } else {
+                      value = std::get<std::string_view>(record.value);
+                    }
+                    records.emplace_back(
+                        record.key,
+                        absl::StrCat(value, "@", record.logical_commit_time));
+                    return absl::OkStatus();
+                  })
+                  .ok());
+  return records;
+}
+
+SortMergeRecordStore::Options SpillEveryRecord() {
+  return {.memory_budget_bytes = 1, .spill_directory = testing::TempDir()};
+}
+
+TEST(SortMergeRecordStoreTest, ReadsLatestRecordsSortedByKey) {
+  SortMergeRecordStore store({.spill_directory = testing::TempDir()});
+  ASSERT_TRUE(Insert(store, Record("b", "b1", 1)).ok());
+  ASSERT_TRUE(Insert(store, Record("a", "a2", 2)).ok());
+  ASSERT_TRUE(Insert(store, Record("a", "a1", 1)).ok());
+  ASSERT_TRUE(Insert(store, Record("b", "b2", 2)).ok());
+  EXPECT_EQ(store.num_runs(), 0);
+  EXPECT_THAT(ReadAll(store),
+              ElementsAre(Pair("a", "a2@2"), Pair("b", "b2@2")));
+}
+
+TEST(SortMergeRecordStoreTest, MergesSpilledRuns) {
+  SortMergeRecordStore store(SpillEveryRecord());
+  ASSERT_TRUE(Insert(store, Record("b", "b1", 1)).ok());
+  ASSERT_TRUE(Insert(store, Record("a", "a2", 2)).ok());
+  ASSERT_TRUE(Insert(store, Record("a", "a1", 1)).ok());
+  ASSERT_TRUE(Insert(store, Record("b", "b2", 2)).ok());
+  ASSERT_TRUE(Insert(store, Record("c", "c3", 3)).ok());
+  EXPECT_EQ(store.num_runs(), 5);
+  EXPECT_THAT(ReadAll(store),
+              ElementsAre(Pair("a", "a2@2"), Pair("b", "b2@2"),
+                          Pair("c", "c3@3")));
+}
+
+TEST(SortMergeRecordStoreTest, SetsRejectedBySpilledRecordsAreNotMerged) {
+  SortMergeRecordStore store(
+      {.memory_budget_bytes = 1000, .spill_directory = testing::TempDir()});
+  ASSERT_TRUE(
+      Insert(store, Record("a", std::vector<std::string_view>{"1"}, 4)).ok());
+  const std::string padding(1000, 'p');
+  ASSERT_TRUE(Insert(store, Record("z", padding, 1)).ok());
+  EXPECT_EQ(store.num_runs(), 1);
+  // Older than the spilled set, so dropped, even though it's older than the
+  // next set too.
+  ASSERT_TRUE(
+      Insert(store, Record("a", std::vector<std::string_view>{"2"}, 3)).ok());
+  ASSERT_TRUE(
+      Insert(store, Record("a", std::vector<std::string_view>{"3", "1"}, 5))
+          .ok());
+  EXPECT_EQ(store.num_runs(), 1);
+  EXPECT_THAT(ReadAll(store),
+              ElementsAre(Pair("a", "1,3@5"),
+                          Pair("z", absl::StrCat(padding, "@1"))));
+}
+
+TEST(SortMergeRecordStoreTest, StringValueReplacesSpilledSet) {
+  SortMergeRecordStore store(SpillEveryRecord());
+  ASSERT_TRUE(
+      Insert(store, Record("a", std::vector<std::string_view>{"1"}, 1)).ok());
+  ASSERT_TRUE(Insert(store, Record("a", "value", 2)).ok());
+  ASSERT_TRUE(
+      Insert(store, Record("a", std::vector<std::string_view>{"2"}, 3)).ok());
+  EXPECT_THAT(ReadAll(store), ElementsAre(Pair("a", "2@3")));
+}
+
+TEST(SortMergeRecordStoreTest, ReadsRecordByRecordKey) {
+  SortMergeRecordStore store(SpillEveryRecord());
+  ASSERT_TRUE(Insert(store, Record("a", "a1", 1)).ok());
+  ASSERT_TRUE(Insert(store, Record("b", "b1", 1)).ok());
+  std::vector<std::string> keys;
+  ASSERT_TRUE(store
+                  .ReadRecord(absl::HashOf(std::string_view("b")),
+                              [&keys](KeyValueMutationRecordStruct record) {
+                                keys.emplace_back(record.key);
+                                return absl::OkStatus();
+                              })
+                  .ok());
+  EXPECT_THAT(keys, ElementsAre("b"));
+}
+
+TEST(SortMergeRecordStoreTest, DeleteDropsSpilledRecordsOnly) {
+  SortMergeRecordStore store(SpillEveryRecord());
+  ASSERT_TRUE(Insert(store, Record("a", "a2", 2)).ok());
+  ASSERT_TRUE(Insert(store, Record("b", "b1", 1)).ok());
+  ASSERT_TRUE(store.DeleteRecord(absl::HashOf(std::string_view("a"))).ok());
+  EXPECT_THAT(ReadAll(store), ElementsAre(Pair("b", "b1@1")));
+  // Older than the deleted record, but inserted after it was deleted.
+  ASSERT_TRUE(Insert(store, Record("a", "a1", 1)).ok());
+  EXPECT_THAT(ReadAll(store),
+              ElementsAre(Pair("a", "a1@1"), Pair("b", "b1@1")));
+}
+
+TEST(SortMergeRecordStoreTest, DeleteRecordsRemovesRuns) {
+  SortMergeRecordStore store(SpillEveryRecord());
+  ASSERT_TRUE(Insert(store, Record("a", "a1", 1)).ok());
+  ASSERT_TRUE(store.DeleteRecords().ok());
+  EXPECT_EQ(store.num_runs(), 0);
+  EXPECT_THAT(ReadAll(store), ElementsAre());
+}
+
+}  // namespace
+}  // namespace kv_server
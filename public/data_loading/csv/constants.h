@@ -33,6 +33,8 @@ inline constexpr std::string_view kValueColumn = "value";
 inline constexpr std::string_view kValueTypeColumn = "value_type";
 inline constexpr std::string_view kValueTypeString = "string";
 inline constexpr std::string_view kValueTypeStringSet = "string_set";
+// Decimal numbers, which are never base64 encoded.
+inline constexpr std::string_view kValueTypeUInt32Set = "uint32_set";
 
 inline constexpr std::string_view kRecordTypeColumn = "record_type";
 inline constexpr std::string_view kRecordTypeKVMutation = "key_value_mutation";
@@ -47,6 +49,9 @@ inline constexpr std::string_view kVersionColumn = "version";
 
 inline constexpr std::string_view kLogicalShardColumn = "logical_shard";
 inline constexpr std::string_view kPhysicalShardColumn = "physical_shard";
+inline constexpr std::string_view kShardMappingStateColumn = "state";
+inline constexpr std::string_view kShardMappingStateActive = "active";
+inline constexpr std::string_view kShardMappingStateStaged = "staged";
 
 inline constexpr std::array<std::string_view, 5> kKeyValueMutationRecordHeader =
     {kKeyColumn, kLogicalCommitTimeColumn, kMutationTypeColumn, kValueColumn,
@@ -57,8 +62,8 @@ inline constexpr std::array<std::string_view, 5>
                                          kLogicalCommitTimeColumn,
                                          kLanguageColumn, kVersionColumn};
 
-inline constexpr std::array<std::string_view, 2> kShardMappingRecordHeader = {
-    kLogicalShardColumn, kPhysicalShardColumn};
+inline constexpr std::array<std::string_view, 3> kShardMappingRecordHeader = {
+    kLogicalShardColumn, kPhysicalShardColumn, kShardMappingStateColumn};
 
 }  //  namespace kv_server
 
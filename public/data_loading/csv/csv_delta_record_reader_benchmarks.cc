@@ -0,0 +1,113 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "benchmark/benchmark.h"
+#include "public/data_loading/csv/csv_delta_record_stream_reader.h"
+#include "public/data_loading/csv/csv_delta_record_stream_writer.h"
+#include "public/data_loading/csv/parallel_csv_delta_record_reader.h"
+
+using kv_server::CsvDeltaRecordStreamReader;
+using kv_server::CsvDeltaRecordStreamWriter;
+using kv_server::CsvEncoding;
+using kv_server::DataRecord;
+using kv_server::DataRecordStruct;
+using kv_server::DeltaRecordReader;
+using kv_server::KeyValueMutationRecordStruct;
+using kv_server::KeyValueMutationType;
+using kv_server::ParallelCsvDeltaRecordReader;
+
+// Returns CSV with 10'000 records, with values of `value_size` bytes, and sets
+// of 10 such values for every other record.
+static std::string GenerateCsv(int64_t value_size, CsvEncoding csv_encoding) {
+  std::stringstream csv_stream;
+  CsvDeltaRecordStreamWriter<std::stringstream>::Options options;
+  options.csv_encoding = csv_encoding;
+  CsvDeltaRecordStreamWriter record_writer(csv_stream, options);
+  const std::string value(value_size, 'v');
+  const std::vector<std::string_view> set_value(10, value);
+  for (int i = 0; i < 10'000; i++) {
+    const std::string key = absl::StrCat("key", i);
+    KeyValueMutationRecordStruct record{
+        .mutation_type = KeyValueMutationType::Update,
+        .logical_commit_time = 1234567890,
+        .key = key,
+        .value = value};
+    if (i % 2 == 0) {
+      record.value = set_value;
+    }
+    auto ignored =
+        record_writer.WriteRecord(DataRecordStruct{.record = record});
+  }
+  auto ignored = record_writer.Flush();
+  return csv_stream.str();
+}
+
+static void ReadRecords(benchmark::State& state,
+                        DeltaRecordReader& record_reader) {
+  auto status = record_reader.ReadRecords([](const DataRecord& record) {
+    benchmark::DoNotOptimize(record);
+    return absl::OkStatus();
+  });
+  if (!status.ok()) {
+    state.SkipWithError(status.ToString());
+  }
+}
+
+static CsvEncoding GetCsvEncoding(const benchmark::State& state) {
+  return state.range(1) == 0 ? CsvEncoding::kPlaintext : CsvEncoding::kBase64;
+}
+
+static void BM_CsvDeltaRecordStreamReader(benchmark::State& state) {
+  const std::string csv = GenerateCsv(state.range(0), GetCsvEncoding(state));
+  for (auto _ : state) {
+    state.PauseTiming();
+    std::stringstream csv_stream(csv);
+    state.ResumeTiming();
+    CsvDeltaRecordStreamReader record_reader(
+        csv_stream, {.csv_encoding = GetCsvEncoding(state)});
+    ReadRecords(state, record_reader);
+  }
+  state.SetBytesProcessed(csv.size() * state.iterations());
+}
+
+static void BM_ParallelCsvDeltaRecordReader(benchmark::State& state) {
+  const std::string csv = GenerateCsv(state.range(0), GetCsvEncoding(state));
+  for (auto _ : state) {
+    state.PauseTiming();
+    std::stringstream csv_stream(csv);
+    state.ResumeTiming();
+    ParallelCsvDeltaRecordReader record_reader(
+        csv_stream,
+        {.csv_options = {.csv_encoding = GetCsvEncoding(state)},
+         .num_worker_threads = static_cast<int>(state.range(2))});
+    ReadRecords(state, record_reader);
+  }
+  state.SetBytesProcessed(csv.size() * state.iterations());
+}
+
+// Value size, base64 encoding or not.
+BENCHMARK(BM_CsvDeltaRecordStreamReader)->ArgsProduct({{64, 1024}, {0, 1}});
+// Value size, base64 encoding or not, threads.
+BENCHMARK(BM_ParallelCsvDeltaRecordReader)
+    ->ArgsProduct({{64, 1024}, {0, 1}, {1, 4, 16}})
+    ->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -70,6 +70,21 @@ absl::StatusOr<std::vector<std::string>> GetSetValue(
   return absl::StrSplit(csv_record[kValueColumn], value_separator);
 }
 
+absl::StatusOr<std::vector<uint32_t>> GetUInt32SetValue(
+    const riegeli::CsvRecord& csv_record, char value_separator) {
+  std::vector<uint32_t> result;
+  for (auto&& set_value :
+       absl::StrSplit(csv_record[kValueColumn], value_separator)) {
+    if (uint32_t number; absl::SimpleAtoi(set_value, &number)) {
+      result.push_back(number);
+    } else {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Cannot convert ", set_value, " to a uint32 number."));
+    }
+  }
+  return result;
+}
+
 absl::StatusOr<KeyValueMutationType> GetDeltaMutationType(
     absl::string_view mutation_type) {
   if (absl::EqualsIgnoreCase(
@@ -115,6 +130,16 @@ absl::Status SetRecordValue(char value_separator,
     mutation_record.value.Set(std::move(set_value));
     return absl::OkStatus();
   }
+  if (absl::EqualsIgnoreCase(type, kValueTypeUInt32Set)) {
+    auto maybe_value = GetUInt32SetValue(csv_record, value_separator);
+    if (!maybe_value.ok()) {
+      return maybe_value.status();
+    }
+    UInt32SetT set_value;
+    set_value.value = std::move(*maybe_value);
+    mutation_record.value.Set(std::move(set_value));
+    return absl::OkStatus();
+  }
   return absl::InvalidArgumentError(
       absl::StrCat("Value type: ", type, " is not supported"));
 }
@@ -189,6 +214,19 @@ absl::StatusOr<DataRecordT> MakeDeltaFileRecordStructWithUdfConfig(
   return data_record;
 }
 
+absl::StatusOr<ShardMappingState> GetShardMappingState(
+    const riegeli::CsvRecord& csv_record) {
+  auto state = absl::AsciiStrToLower(csv_record[kShardMappingStateColumn]);
+  if (kShardMappingStateActive == state) {
+    return ShardMappingState::Active;
+  }
+  if (kShardMappingStateStaged == state) {
+    return ShardMappingState::Staged;
+  }
+  return absl::InvalidArgumentError(
+      absl::StrCat("Shard mapping state: ", state, " is not supported."));
+}
+
 absl::StatusOr<DataRecordT> MakeDeltaFileRecordStructWithShardMapping(
     const riegeli::CsvRecord& csv_record) {
   ShardMappingRecordT shard_mapping_struct;
@@ -204,6 +242,11 @@ absl::StatusOr<DataRecordT> MakeDeltaFileRecordStructWithShardMapping(
     return physical_shard.status();
   }
   shard_mapping_struct.physical_shard = *physical_shard;
+  absl::StatusOr<ShardMappingState> state = GetShardMappingState(csv_record);
+  if (!state.ok()) {
+    return state.status();
+  }
+  shard_mapping_struct.state = *state;
   DataRecordT data_record;
   data_record.record.Set(std::move(shard_mapping_struct));
   return data_record;
@@ -61,7 +61,7 @@ namespace kv_server {
 //
 //  (3) If Record::ShardMappingRecord, records are assumed to
 //   be shard mapping records with the following header:
-//   `["logical_shard", "physical_shard"]`.
+//   `["logical_shard", "physical_shard", "state"]`.
 //
 // - `field_separator`: CSV delimiter
 //   Default ','.
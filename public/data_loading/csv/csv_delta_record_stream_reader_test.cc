@@ -39,6 +39,12 @@ StringSetT GetStringSetValue(const std::vector<std::string_view>& values) {
   return string_set;
 }
 
+UInt32SetT GetUInt32SetValue(const std::vector<uint32_t>& values) {
+  UInt32SetT uint32_set;
+  uint32_set.value = values;
+  return uint32_set;
+}
+
 template <typename ValueT>
 std::pair<KeyValueMutationRecordStruct, KeyValueMutationRecordT>
 GetKVMutationRecord(ValueT&& value,
@@ -213,6 +219,45 @@ TEST(CsvDeltaRecordStreamReaderTest,
   EXPECT_TRUE(status.ok()) << status;
 }
 
+TEST(CsvDeltaRecordStreamReaderTest,
+     ValidateReadingAndWriting_KVMutation_UInt32SetValues_Success) {
+  const std::vector<uint32_t> values{1, 20, 4294967295};
+  std::stringstream string_stream;
+  CsvDeltaRecordStreamWriter record_writer(string_stream);
+  auto [legacy_mutation, mutation] =
+      GetKVMutationRecord(GetUInt32SetValue(values), values);
+  auto input = GetDataRecord(legacy_mutation);
+  auto expected = GetNativeDataRecord(mutation);
+  EXPECT_TRUE(record_writer.WriteRecord(input).ok());
+  EXPECT_TRUE(record_writer.Flush().ok());
+  EXPECT_THAT(string_stream.str(),
+              testing::HasSubstr("1|20|4294967295,uint32_set"));
+  CsvDeltaRecordStreamReader record_reader(string_stream);
+  auto status =
+      record_reader.ReadRecords([&expected](const DataRecord& record) {
+        std::unique_ptr<DataRecordT> native_type_record(record.UnPack());
+        EXPECT_EQ(*native_type_record, expected);
+        return absl::OkStatus();
+      });
+  EXPECT_TRUE(status.ok()) << status;
+}
+
+TEST(CsvDeltaRecordStreamReaderTest,
+     ValidateReadingCsvRecords_KVMutation_InvalidUInt32SetValue_Failure) {
+  const char invalid_data[] =
+      R"csv(key,value,value_type,mutation_type,logical_commit_time
+  key,1|4294967296,uint32_set,Update,1)csv";
+  std::stringstream csv_stream;
+  csv_stream.str(invalid_data);
+  CsvDeltaRecordStreamReader record_reader(csv_stream);
+  absl::Status status = record_reader.ReadRecords(
+      [](const DataRecord&) { return absl::OkStatus(); });
+  EXPECT_FALSE(status.ok()) << status;
+  EXPECT_EQ(status.message(), "Cannot convert 4294967296 to a uint32 number.")
+      << status;
+  EXPECT_EQ(status.code(), absl::StatusCode::kInvalidArgument) << status;
+}
+
 TEST(CsvDeltaRecordStreamReaderTest,
      ValidateReadingAndWriting_KVMutation_SetValues_Base64_Success) {
   const std::vector<std::string_view> values{
@@ -408,8 +453,8 @@ TEST(CsvDeltaRecordStreamReaderTest,
 TEST(CsvDeltaRecordStreamReaderTest,
      ValidateReadingCsvRecords_ShardMapping_InvalidNumericColumn_Failure) {
   const char invalid_data[] =
-      R"csv(logical_shard,physical_shard
-  not_a_number,1)csv";
+      R"csv(logical_shard,physical_shard,state
+  not_a_number,1,active)csv";
   std::stringstream csv_stream;
   csv_stream.str(invalid_data);
   CsvDeltaRecordStreamReader record_reader(
@@ -424,5 +469,21 @@ TEST(CsvDeltaRecordStreamReaderTest,
   EXPECT_EQ(status.code(), absl::StatusCode::kInvalidArgument) << status;
 }
 
+TEST(CsvDeltaRecordStreamReaderTest,
+     ValidateReadingCsvRecords_ShardMapping_InvalidState_Failure) {
+  const char invalid_data[] =
+      R"csv(logical_shard,physical_shard,state
+  1,1,moving)csv";
+  std::stringstream csv_stream;
+  csv_stream.str(invalid_data);
+  CsvDeltaRecordStreamReader record_reader(
+      csv_stream, CsvDeltaRecordStreamReader<std::stringstream>::Options{
+                      .record_type = Record::ShardMappingRecord});
+  absl::Status status = record_reader.ReadRecords(
+      [](const DataRecord&) { return absl::OkStatus(); });
+  EXPECT_FALSE(status.ok()) << status;
+  EXPECT_EQ(status.code(), absl::StatusCode::kInvalidArgument) << status;
+}
+
 }  // namespace
 }  // namespace kv_server
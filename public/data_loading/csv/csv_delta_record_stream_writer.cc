@@ -84,6 +84,12 @@ absl::StatusOr<ValueStruct> GetRecordValue(
                                      value_separator),
           };
         }
+        if constexpr (std::is_same_v<VariantT, std::vector<uint32_t>>) {
+          return ValueStruct{
+              .value_type = std::string(kValueTypeUInt32Set),
+              .value = absl::StrJoin(arg, value_separator),
+          };
+        }
         return absl::InvalidArgumentError("Value must be set.");
       },
       value);
@@ -156,6 +162,20 @@ absl::StatusOr<riegeli::CsvRecord> MakeCsvRecordWithUdfConfig(
   return csv_record;
 }
 
+absl::StatusOr<std::string_view> GetShardMappingState(
+    const ShardMappingRecordStruct& shard_mapping) {
+  switch (shard_mapping.state) {
+    case ShardMappingState::Active:
+      return kShardMappingStateActive;
+    case ShardMappingState::Staged:
+      return kShardMappingStateStaged;
+    default:
+      return absl::InvalidArgumentError(
+          absl::StrCat("Invalid shard mapping state: ",
+                       EnumNameShardMappingState(shard_mapping.state)));
+  }
+}
+
 absl::StatusOr<riegeli::CsvRecord> MakeCsvRecordWithShardMapping(
     const DataRecordStruct& data_record) {
   if (!std::holds_alternative<ShardMappingRecordStruct>(data_record.record)) {
@@ -169,6 +189,11 @@ absl::StatusOr<riegeli::CsvRecord> MakeCsvRecordWithShardMapping(
       absl::StrCat(shard_mapping_struct.logical_shard);
   csv_record[kPhysicalShardColumn] =
       absl::StrCat(shard_mapping_struct.physical_shard);
+  auto state = GetShardMappingState(shard_mapping_struct);
+  if (!state.ok()) {
+    return state.status();
+  }
+  csv_record[kShardMappingStateColumn] = *state;
   return csv_record;
 }
 
@@ -59,7 +59,7 @@ namespace kv_server {
 //
 //  (3) If DataRecordType::kShardMappingRecord, records are assumed to
 //   be shard mapping records with the following header:
-//   `["logical_shard", "physical_shard"]`.
+//   `["logical_shard", "physical_shard", "state"]`.
 //
 // - `field_separator`: CSV delimiter
 //   Default ','.
@@ -76,6 +76,9 @@ class CsvDeltaRecordStreamWriter : public DeltaRecordWriter {
     char value_separator = '|';
     DataRecordType record_type = DataRecordType::kKeyValueMutationRecord;
     CsvEncoding csv_encoding = CsvEncoding::kPlaintext;
+    // If false, the header isn't written, such as to write rows that are
+    // appended to a CSV file that has one.
+    bool write_header = true;
   };
 
   CsvDeltaRecordStreamWriter(DestStreamT& dest_stream,
@@ -124,7 +127,11 @@ riegeli::CsvWriterBase::Options GetRecordWriterOptions(
                                              kShardMappingRecordHeader.end());
       break;
   }
-  writer_options.set_header(std::move(header));
+  if (options.write_header) {
+    writer_options.set_header(std::move(header));
+  } else {
+    writer_options.set_assumed_header(std::move(header));
+  }
   return writer_options;
 }
 }  // namespace internal
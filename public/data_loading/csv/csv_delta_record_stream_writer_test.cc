@@ -17,6 +17,7 @@
 #include "public/data_loading/csv/csv_delta_record_stream_writer.h"
 
 #include <sstream>
+#include <string>
 
 #include "gtest/gtest.h"
 #include "public/data_loading/csv/csv_delta_record_stream_reader.h"
@@ -282,6 +283,25 @@ TEST(CsvDeltaRecordStreamWriterTest, ValidateClosingRecordWriterSucceeds) {
   EXPECT_FALSE(record_writer.IsOpen());
 }
 
+TEST(CsvDeltaRecordStreamWriterTest, WritingRowsWithoutHeader) {
+  const DataRecordStruct record = GetDataRecord(GetKVMutationRecord());
+  std::stringstream with_header;
+  CsvDeltaRecordStreamWriter header_writer(with_header);
+  EXPECT_TRUE(header_writer.WriteRecord(record).ok());
+  header_writer.Close();
+  std::stringstream without_header;
+  CsvDeltaRecordStreamWriter rows_writer(
+      without_header, CsvDeltaRecordStreamWriter<std::stringstream>::Options{
+                          .write_header = false});
+  EXPECT_TRUE(rows_writer.WriteRecord(record).ok());
+  rows_writer.Close();
+  const std::string rows = without_header.str();
+  ASSERT_FALSE(rows.empty());
+  ASSERT_GT(with_header.str().size(), rows.size());
+  EXPECT_EQ(with_header.str().substr(with_header.str().size() - rows.size()),
+            rows);
+}
+
 TEST(CsvDeltaRecordStreamWriterTest,
      ValidateWritingCsvRecord_ShardMapping_Success) {
   std::stringstream string_stream;
@@ -289,7 +309,9 @@ TEST(CsvDeltaRecordStreamWriterTest,
       string_stream, CsvDeltaRecordStreamWriter<std::stringstream>::Options{
                          .record_type = DataRecordType::kShardMappingRecord});
   DataRecordStruct expected = GetDataRecord(
-      ShardMappingRecordStruct{.logical_shard = 0, .physical_shard = 0});
+      ShardMappingRecordStruct{.logical_shard = 0,
+                               .physical_shard = 0,
+                               .state = ShardMappingState::Staged});
   auto status = record_writer.WriteRecord(expected);
   EXPECT_TRUE(status.ok()) << status;
   status = record_writer.Flush();
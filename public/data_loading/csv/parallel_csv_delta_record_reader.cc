@@ -0,0 +1,672 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "public/data_loading/csv/parallel_csv_delta_record_reader.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <optional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "absl/strings/escaping.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/types/span.h"
+#include "components/util/thread_pool.h"
+#include "public/data_loading/csv/constants.h"
+
+namespace kv_server {
+namespace {
+
+constexpr char kQuote = '"';
+
+// Returns the position of the first `c` in `data[pos, end)`, or `end`.
+size_t Find(const char* data, size_t pos, size_t end, char c) {
+  if (pos >= end) {
+    return end;
+  }
+  const void* found = std::memchr(data + pos, c, end - pos);
+  return found == nullptr ? end : static_cast<const char*>(found) - data;
+}
+
+std::string_view View(absl::Span<const char> field) {
+  return std::string_view(field.data(), field.size());
+}
+
+// Finds the line breaks that end rows, i.e. that aren't in quoted fields, by
+// keeping track of the parity of the quotes before them. Only the positions of
+// quotes and line breaks are looked at, so a block with few quoted fields is
+// scanned at the speed of `memchr`.
+class RowBoundaryScanner {
+ public:
+  explicit RowBoundaryScanner(std::string_view rows)
+      : rows_(rows), next_quote_(Find(rows.data(), 0, rows.size(), kQuote)) {}
+
+  // Returns the start of the first row that starts after `pos`, or npos.
+  // `pos` can't be smaller than in previous calls.
+  size_t NextRowStart(size_t pos) {
+    while (true) {
+      const size_t line_break = Find(rows_.data(), pos, rows_.size(), '\n');
+      if (line_break == rows_.size()) {
+        return std::string_view::npos;
+      }
+      SkipQuotesBefore(line_break);
+      pos = line_break + 1;
+      if (!in_quotes_) {
+        return pos;
+      }
+    }
+  }
+
+  // Returns true if `pos` is in a quoted field. `pos` can't be smaller than
+  // in previous calls.
+  bool IsQuoted(size_t pos) {
+    SkipQuotesBefore(pos);
+    return in_quotes_;
+  }
+
+ private:
+  void SkipQuotesBefore(size_t pos) {
+    while (next_quote_ < pos) {
+      in_quotes_ = !in_quotes_;
+      next_quote_ = Find(rows_.data(), next_quote_ + 1, rows_.size(), kQuote);
+    }
+  }
+
+  std::string_view rows_;
+  size_t next_quote_;
+  bool in_quotes_ = false;
+};
+
+// Returns the end of the last complete row of `rows`, which starts with a row.
+size_t CompleteRowsEnd(std::string_view rows) {
+  const size_t last_line_break = rows.rfind('\n');
+  if (last_line_break == std::string_view::npos) {
+    return 0;
+  }
+  if (!RowBoundaryScanner(rows).IsQuoted(last_line_break)) {
+    return last_line_break + 1;
+  }
+  // The last line break is in a field that continues in the next block.
+  RowBoundaryScanner scanner(rows);
+  size_t end = 0;
+  for (size_t next = scanner.NextRowStart(0); next != std::string_view::npos;
+       next = scanner.NextRowStart(next)) {
+    end = next;
+  }
+  return end;
+}
+
+struct Range {
+  size_t begin;
+  size_t end;
+};
+
+// Splits the complete rows `data[begin, end)` into up to `num_ranges` ranges
+// of about the same size.
+std::vector<Range> SplitRows(std::string_view data, size_t begin, size_t end,
+                             int num_ranges) {
+  std::vector<Range> ranges;
+  const std::string_view rows = data.substr(begin, end - begin);
+  RowBoundaryScanner scanner(rows);
+  size_t start = 0;
+  for (int i = 1; i < num_ranges; ++i) {
+    const size_t target = rows.size() * i / num_ranges;
+    if (target <= start) {
+      continue;
+    }
+    const size_t next = scanner.NextRowStart(target - 1);
+    if (next == std::string_view::npos || next == rows.size()) {
+      break;
+    }
+    ranges.push_back({.begin = begin + start, .end = begin + next});
+    start = next;
+  }
+  ranges.push_back({.begin = begin + start, .end = end});
+  return ranges;
+}
+
+// Parses the fields of the row at `data[pos]` into `fields`, in place, and
+// returns the start of the next row. Quotes are only allowed around fields,
+// escaped quotes in them are unescaped over the field. Leaves `fields` empty
+// for empty lines.
+size_t ParseRow(char* data, size_t pos, size_t end, char separator,
+                std::vector<absl::Span<char>>& fields, absl::Status& status) {
+  fields.clear();
+  if (data[pos] == '\n') {
+    return pos + 1;
+  }
+  if (data[pos] == '\r' && pos + 1 < end && data[pos + 1] == '\n') {
+    return pos + 2;
+  }
+  bool line_end_known = false;
+  size_t line_end = 0;
+  size_t line_quote = 0;
+  while (true) {
+    if (pos < end && data[pos] == kQuote) {
+      size_t out = pos;
+      size_t in = pos + 1;
+      while (true) {
+        const size_t quote = Find(data, in, end, kQuote);
+        if (quote == end) {
+          status.Update(
+              absl::InvalidArgumentError("Unterminated quoted field."));
+          return end;
+        }
+        std::memmove(data + out, data + in, quote - in);
+        out += quote - in;
+        if (quote + 1 < end && data[quote + 1] == kQuote) {
+          data[out++] = kQuote;
+          in = quote + 2;
+          continue;
+        }
+        in = quote + 1;
+        break;
+      }
+      fields.emplace_back(data + pos, out - pos);
+      pos = in;
+      if (pos == end) {
+        return end;
+      }
+      if (data[pos] == separator) {
+        ++pos;
+        continue;
+      }
+      if (data[pos] == '\n') {
+        return pos + 1;
+      }
+      if (data[pos] == '\r' && pos + 1 < end && data[pos + 1] == '\n') {
+        return pos + 2;
+      }
+      status.Update(absl::InvalidArgumentError(
+          "Quoted field is followed by other characters."));
+      const size_t line_break = Find(data, pos, end, '\n');
+      return line_break == end ? end : line_break + 1;
+    }
+    if (!line_end_known || line_end < pos) {
+      line_end = Find(data, pos, end, '\n');
+      line_quote = Find(data, pos, line_end, kQuote);
+      line_end_known = true;
+    } else if (line_quote < pos) {
+      line_quote = Find(data, pos, line_end, kQuote);
+    }
+    const size_t field_end = Find(data, pos, line_end, separator);
+    if (line_quote < field_end) {
+      status.Update(
+          absl::InvalidArgumentError("Unquoted field contains a quote."));
+      return line_end == end ? end : line_end + 1;
+    }
+    if (field_end < line_end) {
+      fields.emplace_back(data + pos, field_end - pos);
+      pos = field_end + 1;
+      continue;
+    }
+    size_t value_end = line_end;
+    if (value_end > pos && data[value_end - 1] == '\r') {
+      --value_end;
+    }
+    fields.emplace_back(data + pos, value_end - pos);
+    return line_end == end ? end : line_end + 1;
+  }
+}
+
+constexpr std::array<int8_t, 256> Base64Values() {
+  std::array<int8_t, 256> values{};
+  for (auto& value : values) {
+    value = -1;
+  }
+  constexpr std::string_view kAlphabet =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  for (size_t i = 0; i < kAlphabet.size(); ++i) {
+    values[static_cast<unsigned char>(kAlphabet[i])] = i;
+  }
+  return values;
+}
+
+// Decodes the unpadded base64 `data[0, size)` over itself, and returns the
+// size of the decoded data or -1.
+int64_t DecodeUnpaddedBase64InPlace(char* data, size_t size) {
+  static constexpr std::array<int8_t, 256> kValues = Base64Values();
+  if (size % 4 == 1) {
+    return -1;
+  }
+  size_t out = 0;
+  size_t in = 0;
+  for (; in < size; in += 4) {
+    uint32_t group = 0;
+    const size_t group_size = std::min<size_t>(4, size - in);
+    for (size_t i = 0; i < group_size; ++i) {
+      const int8_t value = kValues[static_cast<unsigned char>(data[in + i])];
+      if (value < 0) {
+        return -1;
+      }
+      group |= value << (18 - 6 * i);
+    }
+    for (size_t i = 0; i + 1 < group_size; ++i) {
+      data[out++] = static_cast<char>(group >> (16 - 8 * i));
+    }
+  }
+  return out;
+}
+
+// Decodes the base64 `field` over itself, and returns the decoded field.
+absl::StatusOr<absl::Span<char>> DecodeBase64InPlace(absl::Span<char> field) {
+  size_t size = field.size();
+  if (size % 4 == 0) {
+    for (int i = 0; i < 2 && size > 0 && field[size - 1] == '='; ++i) {
+      --size;
+    }
+  }
+  if (const int64_t decoded_size =
+          DecodeUnpaddedBase64InPlace(field.data(), size);
+      decoded_size >= 0) {
+    return field.subspan(0, decoded_size);
+  }
+  // Falls back to the base64 that the other CSV reader accepts, such as with
+  // whitespace. The decoded data is never larger than the encoded one.
+  std::string decoded;
+  if (!absl::Base64Unescape(View(field), &decoded)) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("base64 decode failed for value: ", View(field)));
+  }
+  std::memcpy(field.data(), decoded.data(), decoded.size());
+  return field.subspan(0, decoded.size());
+}
+
+// Indexes of the columns of the records in the rows, or -1.
+struct Columns {
+  int key = -1;
+  int logical_commit_time = -1;
+  int mutation_type = -1;
+  int value = -1;
+  int value_type = -1;
+  int code_snippet = -1;
+  int handler_name = -1;
+  int language = -1;
+  int version = -1;
+  int logical_shard = -1;
+  int physical_shard = -1;
+  int state = -1;
+  int num_columns = 0;
+};
+
+absl::StatusOr<Columns> FindColumns(
+    const std::vector<absl::Span<char>>& header, Record record_type) {
+  Columns columns{.num_columns = static_cast<int>(header.size())};
+  absl::Status status;
+  auto find = [&header, &status](std::string_view name) {
+    for (size_t i = 0; i < header.size(); ++i) {
+      if (View(header[i]) == name) {
+        return static_cast<int>(i);
+      }
+    }
+    status.Update(absl::InvalidArgumentError(
+        absl::StrCat("CSV header is missing column: ", name)));
+    return -1;
+  };
+  switch (record_type) {
+    case Record::KeyValueMutationRecord:
+      columns.key = find(kKeyColumn);
+      columns.logical_commit_time = find(kLogicalCommitTimeColumn);
+      columns.mutation_type = find(kMutationTypeColumn);
+      columns.value = find(kValueColumn);
+      columns.value_type = find(kValueTypeColumn);
+      break;
+    case Record::UserDefinedFunctionsConfig:
+      columns.code_snippet = find(kCodeSnippetColumn);
+      columns.handler_name = find(kHandlerNameColumn);
+      columns.language = find(kLanguageColumn);
+      columns.logical_commit_time = find(kLogicalCommitTimeColumn);
+      columns.version = find(kVersionColumn);
+      break;
+    case Record::ShardMappingRecord:
+      columns.logical_shard = find(kLogicalShardColumn);
+      columns.physical_shard = find(kPhysicalShardColumn);
+      columns.state = find(kShardMappingStateColumn);
+      break;
+    default:
+      return absl::InvalidArgumentError("Invalid record type.");
+  }
+  if (!status.ok()) {
+    return status;
+  }
+  return columns;
+}
+
+absl::StatusOr<int64_t> GetInt64Field(absl::Span<const char> field,
+                                      std::string_view column_name) {
+  if (int64_t result; absl::SimpleAtoi(View(field), &result)) {
+    return result;
+  }
+  return absl::InvalidArgumentError(absl::StrCat(
+      "Cannot convert ", column_name, ":", View(field), " to a number."));
+}
+
+absl::StatusOr<KeyValueMutationType> GetMutationType(
+    std::string_view mutation_type) {
+  for (const KeyValueMutationType type :
+       {KeyValueMutationType::Update, KeyValueMutationType::Delete}) {
+    if (absl::EqualsIgnoreCase(mutation_type,
+                               EnumNameKeyValueMutationType(type))) {
+      return type;
+    }
+  }
+  return absl::InvalidArgumentError(
+      absl::StrCat("Unknown mutation type:", mutation_type));
+}
+
+// Serializes the records of CSV rows into a `DataRecord` flatbuffer, straight
+// from their fields. Reuses its buffers from one record to the next.
+class RecordSerializer {
+ public:
+  RecordSerializer(const CsvDeltaRecordStreamReaderOptions& options,
+                   const Columns& columns)
+      : options_(options), columns_(columns) {}
+
+  // Serializes the record of the CSV row `fields`, which are decoded in place.
+  absl::Status Serialize(std::vector<absl::Span<char>>& fields) {
+    if (static_cast<int>(fields.size()) != columns_.num_columns) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("CSV row has ", fields.size(), " fields instead of ",
+                       columns_.num_columns, "."));
+    }
+    builder_.Clear();
+    switch (options_.record_type) {
+      case Record::KeyValueMutationRecord:
+        return SerializeKeyValueMutation(fields);
+      case Record::UserDefinedFunctionsConfig:
+        return SerializeUdfConfig(fields);
+      case Record::ShardMappingRecord:
+        return SerializeShardMapping(fields);
+      default:
+        return absl::InvalidArgumentError("Invalid record type.");
+    }
+  }
+
+  std::string_view record() const {
+    return std::string_view(
+        reinterpret_cast<const char*>(builder_.GetBufferPointer()),
+        builder_.GetSize());
+  }
+
+ private:
+  flatbuffers::Offset<flatbuffers::String> CreateString(
+      absl::Span<const char> field) {
+    return builder_.CreateString(field.data(), field.size());
+  }
+
+  absl::StatusOr<flatbuffers::Offset<flatbuffers::String>> CreateValueString(
+      absl::Span<char> field) {
+    if (options_.csv_encoding == CsvEncoding::kBase64) {
+      absl::StatusOr<absl::Span<char>> decoded = DecodeBase64InPlace(field);
+      if (!decoded.ok()) {
+        return decoded.status();
+      }
+      field = *decoded;
+    }
+    return CreateString(field);
+  }
+
+  absl::Status SerializeKeyValueMutation(
+      std::vector<absl::Span<char>>& fields) {
+    absl::StatusOr<int64_t> logical_commit_time = GetInt64Field(
+        fields[columns_.logical_commit_time], kLogicalCommitTimeColumn);
+    if (!logical_commit_time.ok()) {
+      return logical_commit_time.status();
+    }
+    absl::StatusOr<KeyValueMutationType> mutation_type =
+        GetMutationType(View(fields[columns_.mutation_type]));
+    if (!mutation_type.ok()) {
+      return mutation_type.status();
+    }
+    const auto key = CreateString(fields[columns_.key]);
+    const std::string_view value_type = View(fields[columns_.value_type]);
+    absl::Span<char> value = fields[columns_.value];
+    Value fbs_value_type;
+    flatbuffers::Offset<void> fbs_value;
+    if (absl::EqualsIgnoreCase(value_type, kValueTypeString)) {
+      auto string_value = CreateValueString(value);
+      if (!string_value.ok()) {
+        return string_value.status();
+      }
+      fbs_value_type = Value::StringValue;
+      fbs_value = CreateStringValue(builder_, *string_value).Union();
+    } else if (absl::EqualsIgnoreCase(value_type, kValueTypeStringSet)) {
+      set_values_.clear();
+      size_t begin = 0;
+      while (true) {
+        const size_t end =
+            Find(value.data(), begin, value.size(), options_.value_separator);
+        auto set_value = CreateValueString(value.subspan(begin, end - begin));
+        if (!set_value.ok()) {
+          return set_value.status();
+        }
+        set_values_.push_back(*set_value);
+        if (end == value.size()) {
+          break;
+        }
+        begin = end + 1;
+      }
+      fbs_value_type = Value::StringSet;
+      fbs_value =
+          CreateStringSet(builder_, builder_.CreateVector(set_values_)).Union();
+    } else if (absl::EqualsIgnoreCase(value_type, kValueTypeUInt32Set)) {
+      uint32_set_values_.clear();
+      size_t begin = 0;
+      while (true) {
+        const size_t end =
+            Find(value.data(), begin, value.size(), options_.value_separator);
+        const std::string_view set_value =
+            View(value.subspan(begin, end - begin));
+        uint32_t number;
+        if (!absl::SimpleAtoi(set_value, &number)) {
+          return absl::InvalidArgumentError(absl::StrCat(
+              "Cannot convert ", set_value, " to a uint32 number."));
+        }
+        uint32_set_values_.push_back(number);
+        if (end == value.size()) {
+          break;
+        }
+        begin = end + 1;
+      }
+      fbs_value_type = Value::UInt32Set;
+      fbs_value =
+          CreateUInt32Set(builder_, builder_.CreateVector(uint32_set_values_))
+              .Union();
+    } else {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Value type: ", value_type, " is not supported"));
+    }
+    const auto record = CreateKeyValueMutationRecord(
+        builder_, *mutation_type, *logical_commit_time, key, fbs_value_type,
+        fbs_value);
+    builder_.Finish(CreateDataRecord(builder_, Record::KeyValueMutationRecord,
+                                     record.Union()));
+    return absl::OkStatus();
+  }
+
+  absl::Status SerializeUdfConfig(const std::vector<absl::Span<char>>& fields) {
+    absl::StatusOr<int64_t> logical_commit_time = GetInt64Field(
+        fields[columns_.logical_commit_time], kLogicalCommitTimeColumn);
+    if (!logical_commit_time.ok()) {
+      return logical_commit_time.status();
+    }
+    absl::StatusOr<int64_t> version =
+        GetInt64Field(fields[columns_.version], kVersionColumn);
+    if (!version.ok()) {
+      return version.status();
+    }
+    const std::string_view language = View(fields[columns_.language]);
+    if (!absl::EqualsIgnoreCase(language, kLanguageJavascript)) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Language: ", language, " is not supported."));
+    }
+    const auto code_snippet = CreateString(fields[columns_.code_snippet]);
+    const auto handler_name = CreateString(fields[columns_.handler_name]);
+    const auto record = CreateUserDefinedFunctionsConfig(
+        builder_, UserDefinedFunctionsLanguage::Javascript, code_snippet,
+        handler_name, *logical_commit_time, *version);
+    builder_.Finish(CreateDataRecord(
+        builder_, Record::UserDefinedFunctionsConfig, record.Union()));
+    return absl::OkStatus();
+  }
+
+  absl::Status SerializeShardMapping(
+      const std::vector<absl::Span<char>>& fields) {
+    absl::StatusOr<int64_t> logical_shard =
+        GetInt64Field(fields[columns_.logical_shard], kLogicalShardColumn);
+    if (!logical_shard.ok()) {
+      return logical_shard.status();
+    }
+    absl::StatusOr<int64_t> physical_shard =
+        GetInt64Field(fields[columns_.physical_shard], kPhysicalShardColumn);
+    if (!physical_shard.ok()) {
+      return physical_shard.status();
+    }
+    const std::string_view state_name = View(fields[columns_.state]);
+    ShardMappingState state;
+    if (absl::EqualsIgnoreCase(state_name, kShardMappingStateActive)) {
+      state = ShardMappingState::Active;
+    } else if (absl::EqualsIgnoreCase(state_name, kShardMappingStateStaged)) {
+      state = ShardMappingState::Staged;
+    } else {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "Shard mapping state: ", state_name, " is not supported."));
+    }
+    const auto record = CreateShardMappingRecord(builder_, *logical_shard,
+                                                 *physical_shard, state);
+    builder_.Finish(CreateDataRecord(builder_, Record::ShardMappingRecord,
+                                     record.Union()));
+    return absl::OkStatus();
+  }
+
+  const CsvDeltaRecordStreamReaderOptions& options_;
+  const Columns& columns_;
+  flatbuffers::FlatBufferBuilder builder_;
+  std::vector<flatbuffers::Offset<flatbuffers::String>> set_values_;
+  std::vector<uint32_t> uint32_set_values_;
+};
+
+// The serialized records of a range of rows.
+struct ParsedRange {
+  // Flatbuffers are read in place, so each record starts at a multiple of 8.
+  std::string records;
+  std::vector<size_t> record_offsets;
+  absl::Status status;
+};
+
+ParsedRange ParseRange(char* data, Range range,
+                       const CsvDeltaRecordStreamReaderOptions& options,
+                       const Columns& columns) {
+  ParsedRange parsed;
+  RecordSerializer serializer(options, columns);
+  std::vector<absl::Span<char>> fields;
+  size_t pos = range.begin;
+  while (pos < range.end) {
+    pos = ParseRow(data, pos, range.end, options.field_separator, fields,
+                   parsed.status);
+    if (fields.empty()) {
+      continue;
+    }
+    if (absl::Status status = serializer.Serialize(fields); !status.ok()) {
+      parsed.status.Update(status);
+      continue;
+    }
+    const std::string_view record = serializer.record();
+    parsed.records.resize((parsed.records.size() + 7) / 8 * 8);
+    parsed.record_offsets.push_back(parsed.records.size());
+    parsed.records.append(record);
+  }
+  return parsed;
+}
+
+}  // namespace
+
+ParallelCsvDeltaRecordReader::ParallelCsvDeltaRecordReader(
+    std::istream& src_stream, Options options)
+    : src_stream_(src_stream), options_(std::move(options)) {}
+
+absl::Status ParallelCsvDeltaRecordReader::ReadRecords(
+    const std::function<absl::Status(const DataRecord&)>& record_callback) {
+  const int num_ranges = std::max(options_.num_worker_threads, 1);
+  const size_t block_size =
+      num_ranges * std::max<int64_t>(options_.range_size_bytes, 1);
+  const CsvDeltaRecordStreamReaderOptions& csv_options = options_.csv_options;
+  std::optional<Columns> columns;
+  absl::Status overall_status;
+  // Rows of the previous block that weren't complete are kept at its start.
+  std::string block;
+  bool at_eof = false;
+  while (!at_eof) {
+    const size_t carried_size = block.size();
+    block.resize(carried_size + block_size);
+    src_stream_.read(block.data() + carried_size, block_size);
+    block.resize(carried_size + src_stream_.gcount());
+    if (src_stream_.bad()) {
+      status_ = absl::InternalError("Failed to read the CSV stream.");
+      return status_;
+    }
+    at_eof = src_stream_.eof();
+    const size_t rows_end = at_eof ? block.size() : CompleteRowsEnd(block);
+    size_t rows_begin = 0;
+    while (!columns.has_value() && rows_begin < rows_end) {
+      std::vector<absl::Span<char>> header;
+      rows_begin = ParseRow(block.data(), rows_begin, rows_end,
+                            csv_options.field_separator, header, status_);
+      if (!status_.ok()) {
+        return status_;
+      }
+      if (header.empty()) {
+        continue;
+      }
+      absl::StatusOr<Columns> header_columns =
+          FindColumns(header, csv_options.record_type);
+      if (!header_columns.ok()) {
+        status_ = header_columns.status();
+        return status_;
+      }
+      columns = *std::move(header_columns);
+    }
+    if (columns.has_value() && rows_begin < rows_end) {
+      std::vector<TaskFuture<ParsedRange>> parse_tasks;
+      for (const Range& range :
+           SplitRows(block, rows_begin, rows_end, num_ranges)) {
+        parse_tasks.push_back(SharedThreadPool().Async(
+            [data = block.data(), range, &csv_options, &columns]() {
+              return ParseRange(data, range, csv_options, *columns);
+            }));
+      }
+      for (auto& parse_task : parse_tasks) {
+        const ParsedRange parsed = parse_task.Get();
+        overall_status.Update(parsed.status);
+        for (const size_t offset : parsed.record_offsets) {
+          const char* record = parsed.records.data() + offset;
+          overall_status.Update(
+              record_callback(*flatbuffers::GetRoot<DataRecord>(record)));
+        }
+      }
+    }
+    block.erase(0, rows_end);
+  }
+  return overall_status;
+}
+
+}  // namespace kv_server
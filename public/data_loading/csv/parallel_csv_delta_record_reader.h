@@ -0,0 +1,80 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PUBLIC_DATA_LOADING_CSV_PARALLEL_CSV_DELTA_RECORD_READER_H_
+#define PUBLIC_DATA_LOADING_CSV_PARALLEL_CSV_DELTA_RECORD_READER_H_
+
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <string>
+#include <thread>
+
+#include "absl/status/status.h"
+#include "public/data_loading/csv/csv_delta_record_stream_reader.h"
+#include "public/data_loading/readers/delta_record_reader.h"
+
+namespace kv_server {
+
+// A `ParallelCsvDeltaRecordReader` reads the same CSV records as
+// `CsvDeltaRecordStreamReader`, with the same options, much faster.
+//
+// The stream is read in blocks that are split at row boundaries into ranges,
+// which are parsed in parallel. Fields are parsed in place in the block:
+// delimiters are found with `memchr`, quoted and base64 encoded fields are
+// decoded over their encoded bytes, and the records are serialized straight
+// from the fields, so that no field or set element is copied into a string of
+// its own. `record_callback` is still called with the records in the order of
+// the stream, on the calling thread.
+//
+// Empty lines are skipped, and quotes are only allowed around fields.
+class ParallelCsvDeltaRecordReader : public DeltaRecordReader {
+ public:
+  struct Options {
+    CsvDeltaRecordStreamReaderOptions csv_options;
+    // Number of ranges of each block, parsed in parallel.
+    int num_worker_threads = std::thread::hardware_concurrency();
+    // Bytes of CSV in each range.
+    int64_t range_size_bytes = 4 * 1024 * 1024;
+  };
+
+  explicit ParallelCsvDeltaRecordReader(std::istream& src_stream,
+                                        Options options = Options());
+  ParallelCsvDeltaRecordReader(const ParallelCsvDeltaRecordReader&) = delete;
+  ParallelCsvDeltaRecordReader& operator=(const ParallelCsvDeltaRecordReader&) =
+      delete;
+
+  // Returns the first error of the rows that couldn't be read, the other rows
+  // are still passed to `record_callback`.
+  absl::Status ReadRecords(const std::function<absl::Status(const DataRecord&)>&
+                               record_callback) override;
+  absl::Status ReadRecords(const std::function<absl::Status(DataRecordStruct)>&
+                               record_callback) override {
+    return absl::UnimplementedError(
+        "CSV reader is updated to use newer data structures");
+  }
+  bool IsOpen() const override { return status_.ok(); }
+  absl::Status Status() const override { return status_; }
+
+ private:
+  std::istream& src_stream_;
+  Options options_;
+  absl::Status status_;
+};
+
+}  // namespace kv_server
+
+#endif  // PUBLIC_DATA_LOADING_CSV_PARALLEL_CSV_DELTA_RECORD_READER_H_
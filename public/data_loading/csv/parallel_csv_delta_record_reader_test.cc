@@ -0,0 +1,177 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "public/data_loading/csv/parallel_csv_delta_record_reader.h"
+
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "public/data_loading/csv/csv_delta_record_stream_reader.h"
+#include "public/data_loading/csv/csv_delta_record_stream_writer.h"
+
+namespace kv_server {
+namespace {
+
+using testing::ElementsAre;
+using testing::SizeIs;
+
+using CsvWriter = CsvDeltaRecordStreamWriter<std::stringstream>;
+
+// Small ranges, so that the rows are split into several ranges and blocks.
+ParallelCsvDeltaRecordReader::Options SmallRanges(
+    CsvDeltaRecordStreamReaderOptions csv_options = {}) {
+  return {.csv_options = std::move(csv_options),
+          .num_worker_threads = 3,
+          .range_size_bytes = 40};
+}
+
+absl::Status ReadAll(DeltaRecordReader& record_reader,
+                     std::vector<DataRecordT>& records) {
+  return record_reader.ReadRecords([&records](const DataRecord& record) {
+    std::unique_ptr<DataRecordT> native_record(record.UnPack());
+    records.push_back(std::move(*native_record));
+    return absl::OkStatus();
+  });
+}
+
+std::string WriteKeyValueMutations(CsvEncoding csv_encoding) {
+  std::stringstream csv_stream;
+  CsvWriter::Options options;
+  options.csv_encoding = csv_encoding;
+  CsvWriter record_writer(csv_stream, options);
+  const std::vector<std::string> values = {
+      "value", "", "with,separator", "with \"quotes\"", "multiple\nlines"};
+  for (int i = 0; i < 100; ++i) {
+    const std::string key = absl::StrCat("key", i);
+    const std::string& value = values[i % values.size()];
+    KeyValueMutationRecordStruct record{
+        .mutation_type = i % 7 == 0 ? KeyValueMutationType::Delete
+                                    : KeyValueMutationType::Update,
+        .logical_commit_time = 1000 + i,
+        .key = key,
+        .value = value};
+    if (i % 3 == 0) {
+      record.value = std::vector<std::string_view>{value, key, "element"};
+    }
+    EXPECT_TRUE(record_writer.WriteRecord(DataRecordStruct{.record = record})
+                    .ok());
+  }
+  EXPECT_TRUE(record_writer.Flush().ok());
+  return csv_stream.str();
+}
+
+TEST(ParallelCsvDeltaRecordReaderTest, ReadsRecordsOfStreamReader) {
+  const std::string csv = WriteKeyValueMutations(CsvEncoding::kPlaintext);
+  std::stringstream stream_reader_input(csv);
+  CsvDeltaRecordStreamReader stream_reader(stream_reader_input);
+  std::vector<DataRecordT> expected;
+  ASSERT_TRUE(ReadAll(stream_reader, expected).ok());
+  ASSERT_THAT(expected, SizeIs(100));
+  std::stringstream input(csv);
+  ParallelCsvDeltaRecordReader record_reader(input, SmallRanges());
+  std::vector<DataRecordT> records;
+  const absl::Status status = ReadAll(record_reader, records);
+  EXPECT_TRUE(status.ok()) << status;
+  EXPECT_EQ(records, expected);
+}
+
+TEST(ParallelCsvDeltaRecordReaderTest, ReadsBase64RecordsOfStreamReader) {
+  const std::string csv = WriteKeyValueMutations(CsvEncoding::kBase64);
+  const CsvDeltaRecordStreamReaderOptions csv_options{
+      .csv_encoding = CsvEncoding::kBase64};
+  std::stringstream stream_reader_input(csv);
+  CsvDeltaRecordStreamReader stream_reader(stream_reader_input, csv_options);
+  std::vector<DataRecordT> expected;
+  ASSERT_TRUE(ReadAll(stream_reader, expected).ok());
+  std::stringstream input(csv);
+  ParallelCsvDeltaRecordReader record_reader(input, SmallRanges(csv_options));
+  std::vector<DataRecordT> records;
+  const absl::Status status = ReadAll(record_reader, records);
+  EXPECT_TRUE(status.ok()) << status;
+  EXPECT_EQ(records, expected);
+}
+
+TEST(ParallelCsvDeltaRecordReaderTest, ReadsUdfConfigsAndShardMappings) {
+  std::stringstream udf_input(
+      "code_snippet,handler_name,language,logical_commit_time,version\r\n"
+      "\"function hello() {\n  return \"\"hello\"\";\n}\",hello,javascript,"
+      "1234567890,1\r\n");
+  ParallelCsvDeltaRecordReader udf_reader(
+      udf_input,
+      SmallRanges({.record_type = Record::UserDefinedFunctionsConfig}));
+  std::vector<DataRecordT> records;
+  ASSERT_TRUE(ReadAll(udf_reader, records).ok());
+  ASSERT_THAT(records, SizeIs(1));
+  const auto* udf_config = records[0].record.AsUserDefinedFunctionsConfig();
+  ASSERT_NE(udf_config, nullptr);
+  EXPECT_EQ(udf_config->code_snippet,
+            "function hello() {\n  return \"hello\";\n}");
+  EXPECT_EQ(udf_config->handler_name, "hello");
+  EXPECT_EQ(udf_config->logical_commit_time, 1234567890);
+  EXPECT_EQ(udf_config->version, 1);
+
+  std::stringstream shard_mapping_input(
+      "logical_shard,physical_shard,state\n0,1,staged\n\n1,0,active\n");
+  ParallelCsvDeltaRecordReader shard_mapping_reader(
+      shard_mapping_input,
+      SmallRanges({.record_type = Record::ShardMappingRecord}));
+  records.clear();
+  ASSERT_TRUE(ReadAll(shard_mapping_reader, records).ok());
+  ASSERT_THAT(records, SizeIs(2));
+  EXPECT_EQ(records[0].record.AsShardMappingRecord()->physical_shard, 1);
+  EXPECT_EQ(records[0].record.AsShardMappingRecord()->state,
+            ShardMappingState::Staged);
+  EXPECT_EQ(records[1].record.AsShardMappingRecord()->physical_shard, 0);
+  EXPECT_EQ(records[1].record.AsShardMappingRecord()->state,
+            ShardMappingState::Active);
+}
+
+TEST(ParallelCsvDeltaRecordReaderTest, ReadsOtherRowsOfInvalidRows) {
+  std::stringstream input(
+      "key,value,value_type,mutation_type,logical_commit_time\n"
+      "key1,value,string,Update,1\n"
+      "key2,value,string,Update,invalid_time\n"
+      "key3,value,string,Update,3\n");
+  ParallelCsvDeltaRecordReader record_reader(input, SmallRanges());
+  std::vector<std::string> keys;
+  const absl::Status status =
+      record_reader.ReadRecords([&keys](const DataRecord& record) {
+        keys.push_back(
+            record.record_as_KeyValueMutationRecord()->key()->str());
+        return absl::OkStatus();
+      });
+  EXPECT_EQ(status.code(), absl::StatusCode::kInvalidArgument);
+  EXPECT_EQ(status.message(),
+            "Cannot convert logical_commit_time:invalid_time to a number.");
+  EXPECT_THAT(keys, ElementsAre("key1", "key3"));
+}
+
+TEST(ParallelCsvDeltaRecordReaderTest, MissingColumnFails) {
+  std::stringstream input("key,value,value_type,logical_commit_time\n");
+  ParallelCsvDeltaRecordReader record_reader(input);
+  const absl::Status status = record_reader.ReadRecords(
+      [](const DataRecord&) { return absl::OkStatus(); });
+  EXPECT_EQ(status.code(), absl::StatusCode::kInvalidArgument);
+  EXPECT_FALSE(record_reader.IsOpen());
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -38,6 +38,10 @@ struct StringSet;
 struct StringSetBuilder;
 struct StringSetT;
 
+struct UInt32Set;
+struct UInt32SetBuilder;
+struct UInt32SetT;
+
 struct KeyValueMutationRecord;
 struct KeyValueMutationRecordBuilder;
 struct KeyValueMutationRecordT;
@@ -50,6 +54,10 @@ struct ShardMappingRecord;
 struct ShardMappingRecordBuilder;
 struct ShardMappingRecordT;
 
+struct KeyValueMutationBatch;
+struct KeyValueMutationBatchBuilder;
+struct KeyValueMutationBatchT;
+
 struct DataRecord;
 struct DataRecordBuilder;
 struct DataRecordT;
@@ -84,22 +92,25 @@ enum class Value : uint8_t {
   NONE = 0,
   String = 1,
   StringSet = 2,
+  UInt32Set = 3,
   MIN = NONE,
-  MAX = StringSet
+  MAX = UInt32Set
 };
 
-inline const Value (&EnumValuesValue())[3] {
-  static const Value values[] = {Value::NONE, Value::String, Value::StringSet};
+inline const Value (&EnumValuesValue())[4] {
+  static const Value values[] = {Value::NONE, Value::String, Value::StringSet,
+                                 Value::UInt32Set};
   return values;
 }
 
 inline const char* const* EnumNamesValue() {
-  static const char* const names[4] = {"NONE", "String", "StringSet", nullptr};
+  static const char* const names[5] = {"NONE", "String", "StringSet",
+                                       "UInt32Set", nullptr};
   return names;
 }
 
 inline const char* EnumNameValue(Value e) {
-  if (flatbuffers::IsOutRange(e, Value::NONE, Value::StringSet)) return "";
+  if (flatbuffers::IsOutRange(e, Value::NONE, Value::UInt32Set)) return "";
   const size_t index = static_cast<size_t>(e);
   return EnumNamesValue()[index];
 }
@@ -119,6 +130,11 @@ struct ValueTraits<kv_server::StringSet> {
   static const Value enum_value = Value::StringSet;
 };
 
+template <>
+struct ValueTraits<kv_server::UInt32Set> {
+  static const Value enum_value = Value::UInt32Set;
+};
+
 template <typename T>
 struct ValueUnionTraits {
   static const Value enum_value = Value::NONE;
@@ -134,6 +150,11 @@ struct ValueUnionTraits<kv_server::StringSetT> {
   static const Value enum_value = Value::StringSet;
 };
 
+template <>
+struct ValueUnionTraits<kv_server::UInt32SetT> {
+  static const Value enum_value = Value::UInt32Set;
+};
+
 struct ValueUnion {
   Value type;
   void* value;
@@ -195,6 +216,16 @@ struct ValueUnion {
                ? reinterpret_cast<const kv_server::StringSetT*>(value)
                : nullptr;
   }
+  kv_server::UInt32SetT* AsUInt32Set() {
+    return type == Value::UInt32Set
+               ? reinterpret_cast<kv_server::UInt32SetT*>(value)
+               : nullptr;
+  }
+  const kv_server::UInt32SetT* AsUInt32Set() const {
+    return type == Value::UInt32Set
+               ? reinterpret_cast<const kv_server::UInt32SetT*>(value)
+               : nullptr;
+  }
 };
 
 bool VerifyValue(flatbuffers::Verifier& verifier, const void* obj, Value type);
@@ -230,31 +261,66 @@ inline const char* EnumNameUserDefinedFunctionsLanguage(
   return EnumNamesUserDefinedFunctionsLanguage()[index];
 }
 
+enum class UserDefinedFunctionsArgumentFormat : int8_t {
+  Json = 0,
+  SerializedProto = 1,
+  MIN = Json,
+  MAX = SerializedProto
+};
+
+inline const UserDefinedFunctionsArgumentFormat (
+    &EnumValuesUserDefinedFunctionsArgumentFormat())[2] {
+  static const UserDefinedFunctionsArgumentFormat values[] = {
+      UserDefinedFunctionsArgumentFormat::Json,
+      UserDefinedFunctionsArgumentFormat::SerializedProto};
+  return values;
+}
+
+inline const char* const* EnumNamesUserDefinedFunctionsArgumentFormat() {
+  static const char* const names[3] = {"Json", "SerializedProto", nullptr};
+  return names;
+}
+
+inline const char* EnumNameUserDefinedFunctionsArgumentFormat(
+    UserDefinedFunctionsArgumentFormat e) {
+  if (flatbuffers::IsOutRange(
+          e, UserDefinedFunctionsArgumentFormat::Json,
+          UserDefinedFunctionsArgumentFormat::SerializedProto))
+    return "";
+  const size_t index = static_cast<size_t>(e);
+  return EnumNamesUserDefinedFunctionsArgumentFormat()[index];
+}
+
 enum class Record : uint8_t {
   NONE = 0,
   KeyValueMutationRecord = 1,
   UserDefinedFunctionsConfig = 2,
   ShardMappingRecord = 3,
+  KeyValueMutationBatch = 4,
   MIN = NONE,
-  MAX = ShardMappingRecord
+  MAX = KeyValueMutationBatch
 };
 
-inline const Record (&EnumValuesRecord())[4] {
-  static const Record values[] = {Record::NONE, Record::KeyValueMutationRecord,
-                                  Record::UserDefinedFunctionsConfig,
-                                  Record::ShardMappingRecord};
+inline const Record (&EnumValuesRecord())[5] {
+  static const Record values[] = {
+      Record::NONE, Record::KeyValueMutationRecord,
+      Record::UserDefinedFunctionsConfig, Record::ShardMappingRecord,
+      Record::KeyValueMutationBatch};
   return values;
 }
 
 inline const char* const* EnumNamesRecord() {
-  static const char* const names[5] = {"NONE", "KeyValueMutationRecord",
+  static const char* const names[6] = {"NONE",
+                                       "KeyValueMutationRecord",
                                        "UserDefinedFunctionsConfig",
-                                       "ShardMappingRecord", nullptr};
+                                       "ShardMappingRecord",
+                                       "KeyValueMutationBatch",
+                                       nullptr};
   return names;
 }
 
 inline const char* EnumNameRecord(Record e) {
-  if (flatbuffers::IsOutRange(e, Record::NONE, Record::ShardMappingRecord))
+  if (flatbuffers::IsOutRange(e, Record::NONE, Record::KeyValueMutationBatch))
     return "";
   const size_t index = static_cast<size_t>(e);
   return EnumNamesRecord()[index];
@@ -280,6 +346,11 @@ struct RecordTraits<kv_server::ShardMappingRecord> {
   static const Record enum_value = Record::ShardMappingRecord;
 };
 
+template <>
+struct RecordTraits<kv_server::KeyValueMutationBatch> {
+  static const Record enum_value = Record::KeyValueMutationBatch;
+};
+
 template <typename T>
 struct RecordUnionTraits {
   static const Record enum_value = Record::NONE;
@@ -300,6 +371,11 @@ struct RecordUnionTraits<kv_server::ShardMappingRecordT> {
   static const Record enum_value = Record::ShardMappingRecord;
 };
 
+template <>
+struct RecordUnionTraits<kv_server::KeyValueMutationBatchT> {
+  static const Record enum_value = Record::KeyValueMutationBatch;
+};
+
 struct RecordUnion {
   Record type;
   void* value;
@@ -376,6 +452,17 @@ struct RecordUnion {
                ? reinterpret_cast<const kv_server::ShardMappingRecordT*>(value)
                : nullptr;
   }
+  kv_server::KeyValueMutationBatchT* AsKeyValueMutationBatch() {
+    return type == Record::KeyValueMutationBatch
+               ? reinterpret_cast<kv_server::KeyValueMutationBatchT*>(value)
+               : nullptr;
+  }
+  const kv_server::KeyValueMutationBatchT* AsKeyValueMutationBatch() const {
+    return type == Record::KeyValueMutationBatch
+               ? reinterpret_cast<const kv_server::KeyValueMutationBatchT*>(
+                     value)
+               : nullptr;
+  }
 };
 
 bool VerifyRecord(flatbuffers::Verifier& verifier, const void* obj,
@@ -535,6 +622,76 @@ flatbuffers::Offset<StringSet> CreateStringSet(
     flatbuffers::FlatBufferBuilder& _fbb, const StringSetT* _o,
     const flatbuffers::rehasher_function_t* _rehasher = nullptr);
 
+struct UInt32SetT : public flatbuffers::NativeTable {
+  typedef UInt32Set TableType;
+  std::vector<uint32_t> value{};
+};
+
+struct UInt32Set FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
+  typedef UInt32SetT NativeTableType;
+  typedef UInt32SetBuilder Builder;
+  struct Traits;
+  enum FlatBuffersVTableOffset FLATBUFFERS_VTABLE_UNDERLYING_TYPE {
+    VT_VALUE = 4
+  };
+  const flatbuffers::Vector<uint32_t>* value() const {
+    return GetPointer<const flatbuffers::Vector<uint32_t>*>(VT_VALUE);
+  }
+  bool Verify(flatbuffers::Verifier& verifier) const {
+    return VerifyTableStart(verifier) && VerifyOffset(verifier, VT_VALUE) &&
+           verifier.VerifyVector(value()) && verifier.EndTable();
+  }
+  UInt32SetT* UnPack(
+      const flatbuffers::resolver_function_t* _resolver = nullptr) const;
+  void UnPackTo(
+      UInt32SetT* _o,
+      const flatbuffers::resolver_function_t* _resolver = nullptr) const;
+  static flatbuffers::Offset<UInt32Set> Pack(
+      flatbuffers::FlatBufferBuilder& _fbb, const UInt32SetT* _o,
+      const flatbuffers::rehasher_function_t* _rehasher = nullptr);
+};
+
+struct UInt32SetBuilder {
+  typedef UInt32Set Table;
+  flatbuffers::FlatBufferBuilder& fbb_;
+  flatbuffers::uoffset_t start_;
+  void add_value(flatbuffers::Offset<flatbuffers::Vector<uint32_t>> value) {
+    fbb_.AddOffset(UInt32Set::VT_VALUE, value);
+  }
+  explicit UInt32SetBuilder(flatbuffers::FlatBufferBuilder& _fbb) : fbb_(_fbb) {
+    start_ = fbb_.StartTable();
+  }
+  flatbuffers::Offset<UInt32Set> Finish() {
+    const auto end = fbb_.EndTable(start_);
+    auto o = flatbuffers::Offset<UInt32Set>(end);
+    return o;
+  }
+};
+
+inline flatbuffers::Offset<UInt32Set> CreateUInt32Set(
+    flatbuffers::FlatBufferBuilder& _fbb,
+    flatbuffers::Offset<flatbuffers::Vector<uint32_t>> value = 0) {
+  UInt32SetBuilder builder_(_fbb);
+  builder_.add_value(value);
+  return builder_.Finish();
+}
+
+struct UInt32Set::Traits {
+  using type = UInt32Set;
+  static auto constexpr Create = CreateUInt32Set;
+};
+
+inline flatbuffers::Offset<UInt32Set> CreateUInt32SetDirect(
+    flatbuffers::FlatBufferBuilder& _fbb,
+    const std::vector<uint32_t>* value = nullptr) {
+  auto value__ = value ? _fbb.CreateVector<uint32_t>(*value) : 0;
+  return kv_server::CreateUInt32Set(_fbb, value__);
+}
+
+flatbuffers::Offset<UInt32Set> CreateUInt32Set(
+    flatbuffers::FlatBufferBuilder& _fbb, const UInt32SetT* _o,
+    const flatbuffers::rehasher_function_t* _rehasher = nullptr);
+
 struct KeyValueMutationRecordT : public flatbuffers::NativeTable {
   typedef KeyValueMutationRecord TableType;
   kv_server::KeyValueMutationType mutation_type =
@@ -582,6 +739,11 @@ struct KeyValueMutationRecord FLATBUFFERS_FINAL_CLASS
                ? static_cast<const kv_server::StringSet*>(value())
                : nullptr;
   }
+  const kv_server::UInt32Set* value_as_UInt32Set() const {
+    return value_type() == kv_server::Value::UInt32Set
+               ? static_cast<const kv_server::UInt32Set*>(value())
+               : nullptr;
+  }
   bool Verify(flatbuffers::Verifier& verifier) const {
     return VerifyTableStart(verifier) &&
            VerifyField<int8_t>(verifier, VT_MUTATION_TYPE, 1) &&
@@ -613,6 +775,12 @@ KeyValueMutationRecord::value_as<kv_server::StringSet>() const {
   return value_as_StringSet();
 }
 
+template <>
+inline const kv_server::UInt32Set*
+KeyValueMutationRecord::value_as<kv_server::UInt32Set>() const {
+  return value_as_UInt32Set();
+}
+
 struct KeyValueMutationRecordBuilder {
   typedef KeyValueMutationRecord Table;
   flatbuffers::FlatBufferBuilder& fbb_;
@@ -693,6 +861,9 @@ struct UserDefinedFunctionsConfigT : public flatbuffers::NativeTable {
   std::string handler_name{};
   int64_t logical_commit_time = 0;
   int64_t version = 0;
+  kv_server::UserDefinedFunctionsArgumentFormat argument_format =
+      kv_server::UserDefinedFunctionsArgumentFormat::Json;
+  bool cache_outputs = false;
 };
 
 struct UserDefinedFunctionsConfig FLATBUFFERS_FINAL_CLASS
@@ -705,7 +876,9 @@ struct UserDefinedFunctionsConfig FLATBUFFERS_FINAL_CLASS
     VT_CODE_SNIPPET = 6,
     VT_HANDLER_NAME = 8,
     VT_LOGICAL_COMMIT_TIME = 10,
-    VT_VERSION = 12
+    VT_VERSION = 12,
+    VT_ARGUMENT_FORMAT = 14,
+    VT_CACHE_OUTPUTS = 16
   };
   kv_server::UserDefinedFunctionsLanguage language() const {
     return static_cast<kv_server::UserDefinedFunctionsLanguage>(
@@ -721,6 +894,13 @@ struct UserDefinedFunctionsConfig FLATBUFFERS_FINAL_CLASS
     return GetField<int64_t>(VT_LOGICAL_COMMIT_TIME, 0);
   }
   int64_t version() const { return GetField<int64_t>(VT_VERSION, 0); }
+  kv_server::UserDefinedFunctionsArgumentFormat argument_format() const {
+    return static_cast<kv_server::UserDefinedFunctionsArgumentFormat>(
+        GetField<int8_t>(VT_ARGUMENT_FORMAT, 0));
+  }
+  bool cache_outputs() const {
+    return GetField<uint8_t>(VT_CACHE_OUTPUTS, 0) != 0;
+  }
   bool Verify(flatbuffers::Verifier& verifier) const {
     return VerifyTableStart(verifier) &&
            VerifyField<int8_t>(verifier, VT_LANGUAGE, 1) &&
@@ -729,7 +909,10 @@ struct UserDefinedFunctionsConfig FLATBUFFERS_FINAL_CLASS
            VerifyOffset(verifier, VT_HANDLER_NAME) &&
            verifier.VerifyString(handler_name()) &&
            VerifyField<int64_t>(verifier, VT_LOGICAL_COMMIT_TIME, 8) &&
-           VerifyField<int64_t>(verifier, VT_VERSION, 8) && verifier.EndTable();
+           VerifyField<int64_t>(verifier, VT_VERSION, 8) &&
+           VerifyField<int8_t>(verifier, VT_ARGUMENT_FORMAT, 1) &&
+           VerifyField<uint8_t>(verifier, VT_CACHE_OUTPUTS, 1) &&
+           verifier.EndTable();
   }
   UserDefinedFunctionsConfigT* UnPack(
       const flatbuffers::resolver_function_t* _resolver = nullptr) const;
@@ -764,6 +947,15 @@ struct UserDefinedFunctionsConfigBuilder {
     fbb_.AddElement<int64_t>(UserDefinedFunctionsConfig::VT_VERSION, version,
                              0);
   }
+  void add_argument_format(
+      kv_server::UserDefinedFunctionsArgumentFormat argument_format) {
+    fbb_.AddElement<int8_t>(UserDefinedFunctionsConfig::VT_ARGUMENT_FORMAT,
+                            static_cast<int8_t>(argument_format), 0);
+  }
+  void add_cache_outputs(bool cache_outputs) {
+    fbb_.AddElement<uint8_t>(UserDefinedFunctionsConfig::VT_CACHE_OUTPUTS,
+                             static_cast<uint8_t>(cache_outputs), 0);
+  }
   explicit UserDefinedFunctionsConfigBuilder(
       flatbuffers::FlatBufferBuilder& _fbb)
       : fbb_(_fbb) {
@@ -783,12 +975,17 @@ CreateUserDefinedFunctionsConfig(
         kv_server::UserDefinedFunctionsLanguage::Javascript,
     flatbuffers::Offset<flatbuffers::String> code_snippet = 0,
     flatbuffers::Offset<flatbuffers::String> handler_name = 0,
-    int64_t logical_commit_time = 0, int64_t version = 0) {
+    int64_t logical_commit_time = 0, int64_t version = 0,
+    kv_server::UserDefinedFunctionsArgumentFormat argument_format =
+        kv_server::UserDefinedFunctionsArgumentFormat::Json,
+    bool cache_outputs = false) {
   UserDefinedFunctionsConfigBuilder builder_(_fbb);
   builder_.add_version(version);
   builder_.add_logical_commit_time(logical_commit_time);
   builder_.add_handler_name(handler_name);
   builder_.add_code_snippet(code_snippet);
+  builder_.add_cache_outputs(cache_outputs);
+  builder_.add_argument_format(argument_format);
   builder_.add_language(language);
   return builder_.Finish();
 }
@@ -804,12 +1001,15 @@ CreateUserDefinedFunctionsConfigDirect(
     kv_server::UserDefinedFunctionsLanguage language =
         kv_server::UserDefinedFunctionsLanguage::Javascript,
     const char* code_snippet = nullptr, const char* handler_name = nullptr,
-    int64_t logical_commit_time = 0, int64_t version = 0) {
+    int64_t logical_commit_time = 0, int64_t version = 0,
+    kv_server::UserDefinedFunctionsArgumentFormat argument_format =
+        kv_server::UserDefinedFunctionsArgumentFormat::Json,
+    bool cache_outputs = false) {
   auto code_snippet__ = code_snippet ? _fbb.CreateString(code_snippet) : 0;
   auto handler_name__ = handler_name ? _fbb.CreateString(handler_name) : 0;
   return kv_server::CreateUserDefinedFunctionsConfig(
       _fbb, language, code_snippet__, handler_name__, logical_commit_time,
-      version);
+      version, argument_format, cache_outputs);
 }
 
 flatbuffers::Offset<UserDefinedFunctionsConfig>
@@ -894,6 +1094,152 @@ flatbuffers::Offset<ShardMappingRecord> CreateShardMappingRecord(
     flatbuffers::FlatBufferBuilder& _fbb, const ShardMappingRecordT* _o,
     const flatbuffers::rehasher_function_t* _rehasher = nullptr);
 
+struct KeyValueMutationBatchT : public flatbuffers::NativeTable {
+  typedef KeyValueMutationBatch TableType;
+  std::vector<kv_server::KeyValueMutationType> mutation_types{};
+  std::vector<int64_t> logical_commit_times{};
+  std::vector<std::string> keys{};
+  std::vector<std::string> values{};
+};
+
+struct KeyValueMutationBatch FLATBUFFERS_FINAL_CLASS
+    : private flatbuffers::Table {
+  typedef KeyValueMutationBatchT NativeTableType;
+  typedef KeyValueMutationBatchBuilder Builder;
+  struct Traits;
+  enum FlatBuffersVTableOffset FLATBUFFERS_VTABLE_UNDERLYING_TYPE {
+    VT_MUTATION_TYPES = 4,
+    VT_LOGICAL_COMMIT_TIMES = 6,
+    VT_KEYS = 8,
+    VT_VALUES = 10
+  };
+  const flatbuffers::Vector<int8_t>* mutation_types() const {
+    return GetPointer<const flatbuffers::Vector<int8_t>*>(VT_MUTATION_TYPES);
+  }
+  const flatbuffers::Vector<int64_t>* logical_commit_times() const {
+    return GetPointer<const flatbuffers::Vector<int64_t>*>(
+        VT_LOGICAL_COMMIT_TIMES);
+  }
+  const flatbuffers::Vector<flatbuffers::Offset<flatbuffers::String>>* keys()
+      const {
+    return GetPointer<
+        const flatbuffers::Vector<flatbuffers::Offset<flatbuffers::String>>*>(
+        VT_KEYS);
+  }
+  const flatbuffers::Vector<flatbuffers::Offset<flatbuffers::String>>* values()
+      const {
+    return GetPointer<
+        const flatbuffers::Vector<flatbuffers::Offset<flatbuffers::String>>*>(
+        VT_VALUES);
+  }
+  bool Verify(flatbuffers::Verifier& verifier) const {
+    return VerifyTableStart(verifier) &&
+           VerifyOffset(verifier, VT_MUTATION_TYPES) &&
+           verifier.VerifyVector(mutation_types()) &&
+           VerifyOffset(verifier, VT_LOGICAL_COMMIT_TIMES) &&
+           verifier.VerifyVector(logical_commit_times()) &&
+           VerifyOffset(verifier, VT_KEYS) && verifier.VerifyVector(keys()) &&
+           verifier.VerifyVectorOfStrings(keys()) &&
+           VerifyOffset(verifier, VT_VALUES) &&
+           verifier.VerifyVector(values()) &&
+           verifier.VerifyVectorOfStrings(values()) && verifier.EndTable();
+  }
+  KeyValueMutationBatchT* UnPack(
+      const flatbuffers::resolver_function_t* _resolver = nullptr) const;
+  void UnPackTo(
+      KeyValueMutationBatchT* _o,
+      const flatbuffers::resolver_function_t* _resolver = nullptr) const;
+  static flatbuffers::Offset<KeyValueMutationBatch> Pack(
+      flatbuffers::FlatBufferBuilder& _fbb, const KeyValueMutationBatchT* _o,
+      const flatbuffers::rehasher_function_t* _rehasher = nullptr);
+};
+
+struct KeyValueMutationBatchBuilder {
+  typedef KeyValueMutationBatch Table;
+  flatbuffers::FlatBufferBuilder& fbb_;
+  flatbuffers::uoffset_t start_;
+  void add_mutation_types(
+      flatbuffers::Offset<flatbuffers::Vector<int8_t>> mutation_types) {
+    fbb_.AddOffset(KeyValueMutationBatch::VT_MUTATION_TYPES, mutation_types);
+  }
+  void add_logical_commit_times(
+      flatbuffers::Offset<flatbuffers::Vector<int64_t>> logical_commit_times) {
+    fbb_.AddOffset(KeyValueMutationBatch::VT_LOGICAL_COMMIT_TIMES,
+                   logical_commit_times);
+  }
+  void add_keys(flatbuffers::Offset<
+                flatbuffers::Vector<flatbuffers::Offset<flatbuffers::String>>>
+                    keys) {
+    fbb_.AddOffset(KeyValueMutationBatch::VT_KEYS, keys);
+  }
+  void add_values(flatbuffers::Offset<
+                  flatbuffers::Vector<flatbuffers::Offset<flatbuffers::String>>>
+                      values) {
+    fbb_.AddOffset(KeyValueMutationBatch::VT_VALUES, values);
+  }
+  explicit KeyValueMutationBatchBuilder(flatbuffers::FlatBufferBuilder& _fbb)
+      : fbb_(_fbb) {
+    start_ = fbb_.StartTable();
+  }
+  flatbuffers::Offset<KeyValueMutationBatch> Finish() {
+    const auto end = fbb_.EndTable(start_);
+    auto o = flatbuffers::Offset<KeyValueMutationBatch>(end);
+    return o;
+  }
+};
+
+inline flatbuffers::Offset<KeyValueMutationBatch> CreateKeyValueMutationBatch(
+    flatbuffers::FlatBufferBuilder& _fbb,
+    flatbuffers::Offset<flatbuffers::Vector<int8_t>> mutation_types = 0,
+    flatbuffers::Offset<flatbuffers::Vector<int64_t>> logical_commit_times = 0,
+    flatbuffers::Offset<
+        flatbuffers::Vector<flatbuffers::Offset<flatbuffers::String>>>
+        keys = 0,
+    flatbuffers::Offset<
+        flatbuffers::Vector<flatbuffers::Offset<flatbuffers::String>>>
+        values = 0) {
+  KeyValueMutationBatchBuilder builder_(_fbb);
+  builder_.add_values(values);
+  builder_.add_keys(keys);
+  builder_.add_logical_commit_times(logical_commit_times);
+  builder_.add_mutation_types(mutation_types);
+  return builder_.Finish();
+}
+
+struct KeyValueMutationBatch::Traits {
+  using type = KeyValueMutationBatch;
+  static auto constexpr Create = CreateKeyValueMutationBatch;
+};
+
+inline flatbuffers::Offset<KeyValueMutationBatch>
+CreateKeyValueMutationBatchDirect(
+    flatbuffers::FlatBufferBuilder& _fbb,
+    const std::vector<int8_t>* mutation_types = nullptr,
+    const std::vector<int64_t>* logical_commit_times = nullptr,
+    const std::vector<flatbuffers::Offset<flatbuffers::String>>* keys =
+        nullptr,
+    const std::vector<flatbuffers::Offset<flatbuffers::String>>* values =
+        nullptr) {
+  auto mutation_types__ =
+      mutation_types ? _fbb.CreateVector<int8_t>(*mutation_types) : 0;
+  auto logical_commit_times__ =
+      logical_commit_times ? _fbb.CreateVector<int64_t>(*logical_commit_times)
+                           : 0;
+  auto keys__ =
+      keys ? _fbb.CreateVector<flatbuffers::Offset<flatbuffers::String>>(*keys)
+           : 0;
+  auto values__ =
+      values
+          ? _fbb.CreateVector<flatbuffers::Offset<flatbuffers::String>>(*values)
+          : 0;
+  return kv_server::CreateKeyValueMutationBatch(
+      _fbb, mutation_types__, logical_commit_times__, keys__, values__);
+}
+
+flatbuffers::Offset<KeyValueMutationBatch> CreateKeyValueMutationBatch(
+    flatbuffers::FlatBufferBuilder& _fbb, const KeyValueMutationBatchT* _o,
+    const flatbuffers::rehasher_function_t* _rehasher = nullptr);
+
 struct DataRecordT : public flatbuffers::NativeTable {
   typedef DataRecord TableType;
   kv_server::RecordUnion record{};
@@ -931,6 +1277,12 @@ struct DataRecord FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
                ? static_cast<const kv_server::ShardMappingRecord*>(record())
                : nullptr;
   }
+  const kv_server::KeyValueMutationBatch* record_as_KeyValueMutationBatch()
+      const {
+    return record_type() == kv_server::Record::KeyValueMutationBatch
+               ? static_cast<const kv_server::KeyValueMutationBatch*>(record())
+               : nullptr;
+  }
   bool Verify(flatbuffers::Verifier& verifier) const {
     return VerifyTableStart(verifier) &&
            VerifyField<uint8_t>(verifier, VT_RECORD_TYPE, 1) &&
@@ -966,6 +1318,12 @@ DataRecord::record_as<kv_server::ShardMappingRecord>() const {
   return record_as_ShardMappingRecord();
 }
 
+template <>
+inline const kv_server::KeyValueMutationBatch*
+DataRecord::record_as<kv_server::KeyValueMutationBatch>() const {
+  return record_as_KeyValueMutationBatch();
+}
+
 struct DataRecordBuilder {
   typedef DataRecord Table;
   flatbuffers::FlatBufferBuilder& fbb_;
@@ -1088,6 +1446,49 @@ inline flatbuffers::Offset<StringSet> CreateStringSet(
   return kv_server::CreateStringSet(_fbb, _value);
 }
 
+inline UInt32SetT* UInt32Set::UnPack(
+    const flatbuffers::resolver_function_t* _resolver) const {
+  auto _o = std::make_unique<UInt32SetT>();
+  UnPackTo(_o.get(), _resolver);
+  return _o.release();
+}
+
+inline void UInt32Set::UnPackTo(
+    UInt32SetT* _o, const flatbuffers::resolver_function_t* _resolver) const {
+  (void)_o;
+  (void)_resolver;
+  {
+    auto _e = value();
+    if (_e) {
+      _o->value.resize(_e->size());
+      for (flatbuffers::uoffset_t _i = 0; _i < _e->size(); _i++) {
+        _o->value[_i] = _e->Get(_i);
+      }
+    }
+  }
+}
+
+inline flatbuffers::Offset<UInt32Set> UInt32Set::Pack(
+    flatbuffers::FlatBufferBuilder& _fbb, const UInt32SetT* _o,
+    const flatbuffers::rehasher_function_t* _rehasher) {
+  return CreateUInt32Set(_fbb, _o, _rehasher);
+}
+
+inline flatbuffers::Offset<UInt32Set> CreateUInt32Set(
+    flatbuffers::FlatBufferBuilder& _fbb, const UInt32SetT* _o,
+    const flatbuffers::rehasher_function_t* _rehasher) {
+  (void)_rehasher;
+  (void)_o;
+  struct _VectorArgs {
+    flatbuffers::FlatBufferBuilder* __fbb;
+    const UInt32SetT* __o;
+    const flatbuffers::rehasher_function_t* __rehasher;
+  } _va = {&_fbb, _o, _rehasher};
+  (void)_va;
+  auto _value = _o->value.size() ? _fbb.CreateVector(_o->value) : 0;
+  return kv_server::CreateUInt32Set(_fbb, _value);
+}
+
 inline KeyValueMutationRecordT* KeyValueMutationRecord::UnPack(
     const flatbuffers::resolver_function_t* _resolver) const {
   auto _o = std::make_unique<KeyValueMutationRecordT>();
@@ -1182,6 +1583,14 @@ inline void UserDefinedFunctionsConfig::UnPackTo(
     auto _e = version();
     _o->version = _e;
   }
+  {
+    auto _e = argument_format();
+    _o->argument_format = _e;
+  }
+  {
+    auto _e = cache_outputs();
+    _o->cache_outputs = _e;
+  }
 }
 
 inline flatbuffers::Offset<UserDefinedFunctionsConfig>
@@ -1210,9 +1619,11 @@ CreateUserDefinedFunctionsConfig(
       _o->handler_name.empty() ? 0 : _fbb.CreateString(_o->handler_name);
   auto _logical_commit_time = _o->logical_commit_time;
   auto _version = _o->version;
+  auto _argument_format = _o->argument_format;
+  auto _cache_outputs = _o->cache_outputs;
   return kv_server::CreateUserDefinedFunctionsConfig(
       _fbb, _language, _code_snippet, _handler_name, _logical_commit_time,
-      _version);
+      _version, _argument_format, _cache_outputs);
 }
 
 inline ShardMappingRecordT* ShardMappingRecord::UnPack(
@@ -1260,6 +1671,90 @@ inline flatbuffers::Offset<ShardMappingRecord> CreateShardMappingRecord(
                                              _physical_shard);
 }
 
+inline KeyValueMutationBatchT* KeyValueMutationBatch::UnPack(
+    const flatbuffers::resolver_function_t* _resolver) const {
+  auto _o = std::make_unique<KeyValueMutationBatchT>();
+  UnPackTo(_o.get(), _resolver);
+  return _o.release();
+}
+
+inline void KeyValueMutationBatch::UnPackTo(
+    KeyValueMutationBatchT* _o,
+    const flatbuffers::resolver_function_t* _resolver) const {
+  (void)_o;
+  (void)_resolver;
+  {
+    auto _e = mutation_types();
+    if (_e) {
+      _o->mutation_types.resize(_e->size());
+      for (flatbuffers::uoffset_t _i = 0; _i < _e->size(); _i++) {
+        _o->mutation_types[_i] =
+            static_cast<kv_server::KeyValueMutationType>(_e->Get(_i));
+      }
+    }
+  }
+  {
+    auto _e = logical_commit_times();
+    if (_e) {
+      _o->logical_commit_times.resize(_e->size());
+      for (flatbuffers::uoffset_t _i = 0; _i < _e->size(); _i++) {
+        _o->logical_commit_times[_i] = _e->Get(_i);
+      }
+    }
+  }
+  {
+    auto _e = keys();
+    if (_e) {
+      _o->keys.resize(_e->size());
+      for (flatbuffers::uoffset_t _i = 0; _i < _e->size(); _i++) {
+        _o->keys[_i] = _e->Get(_i)->str();
+      }
+    }
+  }
+  {
+    auto _e = values();
+    if (_e) {
+      _o->values.resize(_e->size());
+      for (flatbuffers::uoffset_t _i = 0; _i < _e->size(); _i++) {
+        _o->values[_i] = _e->Get(_i)->str();
+      }
+    }
+  }
+}
+
+inline flatbuffers::Offset<KeyValueMutationBatch> KeyValueMutationBatch::Pack(
+    flatbuffers::FlatBufferBuilder& _fbb, const KeyValueMutationBatchT* _o,
+    const flatbuffers::rehasher_function_t* _rehasher) {
+  return CreateKeyValueMutationBatch(_fbb, _o, _rehasher);
+}
+
+inline flatbuffers::Offset<KeyValueMutationBatch> CreateKeyValueMutationBatch(
+    flatbuffers::FlatBufferBuilder& _fbb, const KeyValueMutationBatchT* _o,
+    const flatbuffers::rehasher_function_t* _rehasher) {
+  (void)_rehasher;
+  (void)_o;
+  struct _VectorArgs {
+    flatbuffers::FlatBufferBuilder* __fbb;
+    const KeyValueMutationBatchT* __o;
+    const flatbuffers::rehasher_function_t* __rehasher;
+  } _va = {&_fbb, _o, _rehasher};
+  (void)_va;
+  auto _mutation_types = _o->mutation_types.size()
+                             ? _fbb.CreateVectorScalarCast<int8_t>(
+                                   flatbuffers::data(_o->mutation_types),
+                                   _o->mutation_types.size())
+                             : 0;
+  auto _logical_commit_times =
+      _o->logical_commit_times.size()
+          ? _fbb.CreateVector(_o->logical_commit_times)
+          : 0;
+  auto _keys = _o->keys.size() ? _fbb.CreateVectorOfStrings(_o->keys) : 0;
+  auto _values =
+      _o->values.size() ? _fbb.CreateVectorOfStrings(_o->values) : 0;
+  return kv_server::CreateKeyValueMutationBatch(
+      _fbb, _mutation_types, _logical_commit_times, _keys, _values);
+}
+
 inline DataRecordT* DataRecord::UnPack(
     const flatbuffers::resolver_function_t* _resolver) const {
   auto _o = std::make_unique<DataRecordT>();
@@ -1319,6 +1814,10 @@ inline bool VerifyValue(flatbuffers::Verifier& verifier, const void* obj,
       auto ptr = reinterpret_cast<const kv_server::StringSet*>(obj);
       return verifier.VerifyTable(ptr);
     }
+    case Value::UInt32Set: {
+      auto ptr = reinterpret_cast<const kv_server::UInt32Set*>(obj);
+      return verifier.VerifyTable(ptr);
+    }
     default:
       return true;
   }
@@ -1351,6 +1850,10 @@ inline void* ValueUnion::UnPack(
       auto ptr = reinterpret_cast<const kv_server::StringSet*>(obj);
       return ptr->UnPack(resolver);
     }
+    case Value::UInt32Set: {
+      auto ptr = reinterpret_cast<const kv_server::UInt32Set*>(obj);
+      return ptr->UnPack(resolver);
+    }
     default:
       return nullptr;
   }
@@ -1369,6 +1872,10 @@ inline flatbuffers::Offset<void> ValueUnion::Pack(
       auto ptr = reinterpret_cast<const kv_server::StringSetT*>(value);
       return CreateStringSet(_fbb, ptr, _rehasher).Union();
     }
+    case Value::UInt32Set: {
+      auto ptr = reinterpret_cast<const kv_server::UInt32SetT*>(value);
+      return CreateUInt32Set(_fbb, ptr, _rehasher).Union();
+    }
     default:
       return 0;
   }
@@ -1387,6 +1894,11 @@ inline ValueUnion::ValueUnion(const ValueUnion& u)
           *reinterpret_cast<kv_server::StringSetT*>(u.value));
       break;
     }
+    case Value::UInt32Set: {
+      value = new kv_server::UInt32SetT(
+          *reinterpret_cast<kv_server::UInt32SetT*>(u.value));
+      break;
+    }
     default:
       break;
   }
@@ -1404,6 +1916,11 @@ inline void ValueUnion::Reset() {
       delete ptr;
       break;
     }
+    case Value::UInt32Set: {
+      auto ptr = reinterpret_cast<kv_server::UInt32SetT*>(value);
+      delete ptr;
+      break;
+    }
     default:
       break;
   }
@@ -1431,6 +1948,10 @@ inline bool VerifyRecord(flatbuffers::Verifier& verifier, const void* obj,
       auto ptr = reinterpret_cast<const kv_server::ShardMappingRecord*>(obj);
       return verifier.VerifyTable(ptr);
     }
+    case Record::KeyValueMutationBatch: {
+      auto ptr = reinterpret_cast<const kv_server::KeyValueMutationBatch*>(obj);
+      return verifier.VerifyTable(ptr);
+    }
     default:
       return true;
   }
@@ -1469,6 +1990,10 @@ inline void* RecordUnion::UnPack(
       auto ptr = reinterpret_cast<const kv_server::ShardMappingRecord*>(obj);
       return ptr->UnPack(resolver);
     }
+    case Record::KeyValueMutationBatch: {
+      auto ptr = reinterpret_cast<const kv_server::KeyValueMutationBatch*>(obj);
+      return ptr->UnPack(resolver);
+    }
     default:
       return nullptr;
   }
@@ -1494,6 +2019,11 @@ inline flatbuffers::Offset<void> RecordUnion::Pack(
       auto ptr = reinterpret_cast<const kv_server::ShardMappingRecordT*>(value);
       return CreateShardMappingRecord(_fbb, ptr, _rehasher).Union();
     }
+    case Record::KeyValueMutationBatch: {
+      auto ptr =
+          reinterpret_cast<const kv_server::KeyValueMutationBatchT*>(value);
+      return CreateKeyValueMutationBatch(_fbb, ptr, _rehasher).Union();
+    }
     default:
       return 0;
   }
@@ -1517,6 +2047,11 @@ inline RecordUnion::RecordUnion(const RecordUnion& u)
           *reinterpret_cast<kv_server::ShardMappingRecordT*>(u.value));
       break;
     }
+    case Record::KeyValueMutationBatch: {
+      value = new kv_server::KeyValueMutationBatchT(
+          *reinterpret_cast<kv_server::KeyValueMutationBatchT*>(u.value));
+      break;
+    }
     default:
       break;
   }
@@ -1540,6 +2075,11 @@ inline void RecordUnion::Reset() {
       delete ptr;
       break;
     }
+    case Record::KeyValueMutationBatch: {
+      auto ptr = reinterpret_cast<kv_server::KeyValueMutationBatchT*>(value);
+      delete ptr;
+      break;
+    }
     default:
       break;
   }
@@ -14,12 +14,60 @@
 
 #include "public/data_loading/readers/avro_stream_io.h"
 
+#include <string_view>
+
 #include "absl/log/check.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "components/util/thread_pool.h"
 #include "third_party/avro/api/DataFile.hh"
 #include "third_party/avro/api/Schema.hh"
 #include "third_party/avro/api/Stream.hh"
 
 namespace kv_server {
+namespace {
+
+// Reads, and seeks in, an Avro container file that is in memory, e.g. a
+// memory-mapped file, in place, without copying it into stream buffers.
+class MemoryInputStream : public avro::SeekableInputStream {
+ public:
+  explicit MemoryInputStream(std::string_view contents)
+      : contents_(contents) {}
+
+  bool next(const uint8_t** data, size_t* len) override {
+    if (pos_ >= contents_.size()) {
+      return false;
+    }
+    *data = reinterpret_cast<const uint8_t*>(contents_.data() + pos_);
+    *len = contents_.size() - pos_;
+    pos_ = contents_.size();
+    return true;
+  }
+  void backup(size_t len) override { pos_ -= len; }
+  void skip(size_t len) override {
+    pos_ = std::min(contents_.size(), pos_ + len);
+  }
+  size_t byteCount() const override { return pos_; }
+  void seek(int64_t position) override {
+    pos_ = std::min(contents_.size(), static_cast<size_t>(position));
+  }
+
+ private:
+  std::string_view contents_;
+  size_t pos_ = 0;
+};
+
+// Returns an Avro input stream of `record_stream`. Streams that are in memory
+// are read in place.
+avro::InputStreamPtr CreateAvroInputStream(RecordStream& record_stream) {
+  if (const auto contents = record_stream.Contents(); contents.has_value()) {
+    return std::make_unique<MemoryInputStream>(*contents);
+  }
+  record_stream.Stream().clear();
+  return avro::istreamInputStream(record_stream.Stream());
+}
+
+}  // namespace
 
 AvroStreamReader::AvroStreamReader(std::istream& data_input)
     : data_input_(data_input) {}
@@ -57,6 +105,9 @@ AvroConcurrentStreamRecordReader::GetKVFileMetadata() {
 
 absl::StatusOr<int64_t> AvroConcurrentStreamRecordReader::RecordStreamSize() {
   auto record_stream = stream_factory_();
+  if (const auto contents = record_stream->Contents(); contents.has_value()) {
+    return contents->size();
+  }
   auto& stream = record_stream->Stream();
   stream.seekg(0, std::ios_base::end);
   int64_t size = stream.tellg();
@@ -68,6 +119,11 @@ absl::StatusOr<int64_t> AvroConcurrentStreamRecordReader::RecordStreamSize() {
 
 absl::StatusOr<std::vector<AvroConcurrentStreamRecordReader::ByteRange>>
 AvroConcurrentStreamRecordReader::BuildByteRanges() {
+  if (options_.num_worker_threads < 1) {
+    return absl::InvalidArgumentError(
+        absl::StrFormat("Num worker threads %d must be at least 1.",
+                        options_.num_worker_threads));
+  }
   absl::StatusOr<int64_t> stream_size = RecordStreamSize();
   if (!stream_size.ok()) {
     return stream_size.status();
@@ -108,20 +164,19 @@ absl::Status AvroConcurrentStreamRecordReader::ReadStreamRecords(
   if (!byte_ranges.ok() || byte_ranges->empty()) {
     return byte_ranges.status();
   }
-  std::vector<std::future<absl::StatusOr<ByteRangeResult>>>
+  // Byte ranges are read on the shared pool, so that files that arrive back
+  // to back don't each start their own threads.
+  std::vector<TaskFuture<absl::StatusOr<ByteRangeResult>>>
       byte_range_reader_tasks;
   for (const auto& byte_range : *byte_ranges) {
-    // TODO: b/268339067 - Investigate using an executor because
-    // std::async is generally not preferred, but works fine as an
-    // initial implementation.
-    byte_range_reader_tasks.push_back(std::async(
-        std::launch::async,
-        &AvroConcurrentStreamRecordReader::ReadByteRangeExceptionless, this,
-        std::ref(byte_range), std::ref(callback)));
+    byte_range_reader_tasks.push_back(
+        SharedThreadPool().Async([this, &byte_range, &callback]() {
+          return ReadByteRangeExceptionless(byte_range, callback);
+        }));
   }
   int64_t total_records_read = 0;
   for (auto& task : byte_range_reader_tasks) {
-    absl::StatusOr<ByteRangeResult> curr_byte_range_result = task.get();
+    absl::StatusOr<ByteRangeResult> curr_byte_range_result = task.Get();
     // TODO: The stuff below should be handled more gracefully,
     // e.g., only retry the byte_range that failed or skipped some
     // records.
@@ -160,26 +215,33 @@ AvroConcurrentStreamRecordReader::ReadByteRange(
                               kConcurrentStreamRecordReaderReadByteRangeLatency>
       latency_recorder(KVServerContextMap()->SafeMetric());
   auto record_stream = stream_factory_();
-  VLOG(9) << "creating input stream";
-  avro::InputStreamPtr input_stream =
-      avro::istreamInputStream(record_stream->Stream());
-  VLOG(9) << "creating reader";
-  auto record_reader = std::make_unique<avro::DataFileReader<std::string>>(
-      std::move(input_stream));
-  VLOG(9) << "syncing to block";
   if (record_stream->Stream().bad()) {
     return absl::InternalError("Avro stream is bad");
   }
+  VLOG(9) << "creating reader";
+  auto record_reader = std::make_unique<avro::DataFileReader<std::string>>(
+      CreateAvroInputStream(*record_stream));
+  VLOG(9) << "syncing to block";
   record_stream->Stream().clear();
   record_reader->sync(byte_range.begin_offset);
   int64_t num_records_read = 0;
   std::string record;
   absl::Status overall_status;
+  // Time spent outside of the record callbacks, reading and decoding blocks.
+  absl::Duration decode_latency;
+  absl::Time decode_start = absl::Now();
   while (!record_reader->pastSync(byte_range.end_offset) &&
          record_reader->read(record)) {
+    decode_latency += absl::Now() - decode_start;
     overall_status.Update(record_callback(record));
     num_records_read++;
+    decode_start = absl::Now();
   }
+  decode_latency += absl::Now() - decode_start;
+  LogIfError(KVServerContextMap()
+                 ->SafeMetric()
+                 .LogHistogram<kConcurrentStreamRecordReaderDecodeLatency>(
+                     absl::ToDoubleMicroseconds(decode_latency)));
   // TODO: b/269119466 - Figure out how to handle this better. Maybe add
   // metrics to track callback failures (??).
   if (!overall_status.ok()) {
@@ -19,7 +19,6 @@
 
 #include <algorithm>
 #include <cmath>
-#include <future>
 #include <memory>
 #include <string>
 #include <utility>
@@ -62,9 +61,11 @@ class AvroStreamReader : public StreamRecordReader {
 // An `AvroConcurrentStreamRecordReader` reads a Avro data stream containing
 // string records concurrently. The reader splits the data stream
 // into byte ranges with an approximately equal number of bytes and reads the
-// chunks in parallel. Each record in the underlying data stream is guaranteed
-// to be read exactly once. The concurrency level can be configured using
-// `AvroConcurrentStreamRecordReader::Options`.
+// chunks in parallel. Each byte range syncs to the first block marker after
+// its beginning and decodes the blocks that start before its end, so each
+// record in the underlying data stream is guaranteed to be read exactly once.
+// Streams with `Contents` in memory are decoded in place. The concurrency level
+// can be configured using `AvroConcurrentStreamRecordReader::Options`.
 //
 // Sample usage:
 //
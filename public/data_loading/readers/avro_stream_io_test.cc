@@ -14,8 +14,12 @@
 
 #include "public/data_loading/readers/avro_stream_io.h"
 
+#include <atomic>
 #include <filesystem>
 #include <fstream>
+#include <optional>
+#include <sstream>
+#include <string>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -103,6 +107,43 @@ TEST(AvroStreamIO, ConcurrentReading) {
   EXPECT_TRUE(status.ok()) << status;
 }
 
+class InMemoryRecordStream : public RecordStream {
+ public:
+  explicit InMemoryRecordStream(std::string_view contents)
+      : contents_(contents) {}
+  // Only used to report the state of the stream.
+  std::istream& Stream() override { return stream_; }
+  std::optional<std::string_view> Contents() override { return contents_; }
+
+ private:
+  std::string_view contents_;
+  std::stringstream stream_;
+};
+
+TEST(AvroStreamIO, ConcurrentReadingInMemory) {
+  kv_server::InitMetricsContextMap();
+  std::stringstream output_stream;
+  WriteAvroToFile({kTestRecord}, output_stream);
+  const std::string contents = output_stream.str();
+
+  AvroConcurrentStreamRecordReader::Options options;
+  options.num_worker_threads = 4;
+  options.min_byte_range_size_bytes = 1024;
+  AvroConcurrentStreamRecordReader record_reader(
+      [&contents] { return std::make_unique<InMemoryRecordStream>(contents); },
+      options);
+
+  std::atomic<int64_t> num_records = 0;
+  auto status = record_reader.ReadStreamRecords(
+      [&num_records](std::string_view raw) {
+        EXPECT_EQ(raw, kTestRecord);
+        ++num_records;
+        return absl::OkStatus();
+      });
+  EXPECT_TRUE(status.ok()) << status;
+  EXPECT_EQ(num_records, kIterations);
+}
+
 TEST(AvroStreamIO, SequentialReading) {
   kv_server::InitMetricsContextMap();
   constexpr std::string_view kFileName = "SequentialReading.avro";
@@ -0,0 +1,95 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "public/data_loading/readers/realtime_envelope.h"
+
+#include <cstdint>
+
+#include "absl/log/log.h"
+#include "absl/strings/str_cat.h"
+
+namespace kv_server {
+namespace {
+
+void AppendVarint(uint64_t value, std::string& output) {
+  while (value >= 0x80) {
+    output.push_back(static_cast<char>(value | 0x80));
+    value >>= 7;
+  }
+  output.push_back(static_cast<char>(value));
+}
+
+// Reads a varint from the start of `input` and consumes it.
+bool ReadVarint(std::string_view& input, uint64_t& value) {
+  value = 0;
+  for (int shift = 0; shift < 64 && !input.empty(); shift += 7) {
+    const auto byte = static_cast<uint8_t>(input.front());
+    input.remove_prefix(1);
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+std::string EncodeRealtimeEnvelope(
+    absl::Span<const std::string_view> records) {
+  size_t size = kRealtimeEnvelopeMagic.size();
+  for (const std::string_view record : records) {
+    // At most 10 bytes per length.
+    size += record.size() + 10;
+  }
+  std::string envelope;
+  envelope.reserve(size);
+  envelope.append(kRealtimeEnvelopeMagic);
+  for (const std::string_view record : records) {
+    AppendVarint(record.size(), envelope);
+    envelope.append(record);
+  }
+  return envelope;
+}
+
+absl::Status RealtimeEnvelopeRecordReader::ReadStreamRecords(
+    const std::function<absl::Status(const std::string_view&)>& callback) {
+  if (!IsRealtimeEnvelope(envelope_)) {
+    return absl::InvalidArgumentError("Not a realtime envelope.");
+  }
+  std::string_view input = envelope_.substr(kRealtimeEnvelopeMagic.size());
+  absl::Status overall_status;
+  int64_t num_records = 0;
+  while (!input.empty()) {
+    uint64_t size;
+    if (!ReadVarint(input, size) || size > input.size()) {
+      return absl::DataLossError(absl::StrCat(
+          "Realtime envelope is truncated after ", num_records, " records."));
+    }
+    const std::string_view record = input.substr(0, size);
+    input.remove_prefix(size);
+    ++num_records;
+    overall_status.Update(callback(record));
+  }
+  // Like the delta file readers, callback failures are only logged.
+  if (!overall_status.ok()) {
+    LOG(ERROR) << "Record callback failed to process some records with: "
+               << overall_status;
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace kv_server
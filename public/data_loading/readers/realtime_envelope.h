@@ -0,0 +1,78 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PUBLIC_DATA_LOADING_READERS_REALTIME_ENVELOPE_H_
+#define PUBLIC_DATA_LOADING_READERS_REALTIME_ENVELOPE_H_
+
+#include <functional>
+#include <string>
+#include <string_view>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/types/span.h"
+#include "public/data_loading/readers/stream_record_reader.h"
+
+namespace kv_server {
+
+// A realtime envelope carries a few serialized records in one realtime
+// message, without the overhead of a Riegeli delta file:
+//
+//   envelope := magic record*
+//   record   := length (unsigned LEB128 varint) bytes
+//
+// The magic starts with a NUL byte, which neither base64 text nor a Riegeli
+// file starts with, so envelopes are told apart from the other messages, and
+// can be published as raw bytes where the transport allows it, e.g. Pub/Sub.
+inline constexpr std::string_view kRealtimeEnvelopeMagic =
+    std::string_view("\0KVRT", 5);
+
+// Returns whether `message` is a realtime envelope.
+inline bool IsRealtimeEnvelope(std::string_view message) {
+  return message.substr(0, kRealtimeEnvelopeMagic.size()) ==
+         kRealtimeEnvelopeMagic;
+}
+
+// Returns the envelope of `records`, each a serialized record as written to
+// delta files.
+std::string EncodeRealtimeEnvelope(absl::Span<const std::string_view> records);
+
+// Reads the records of an envelope in place, from the buffer of the message.
+// The reader doesn't own the buffer, which has to outlive it.
+//
+// Envelopes have no file metadata, `GetKVFileMetadata` returns empty metadata.
+class RealtimeEnvelopeRecordReader : public StreamRecordReader {
+ public:
+  explicit RealtimeEnvelopeRecordReader(std::string_view envelope)
+      : envelope_(envelope) {}
+
+  absl::StatusOr<KVFileMetadata> GetKVFileMetadata() override {
+    return KVFileMetadata();
+  }
+
+  // Stops at the first malformed record, after the records before it were
+  // passed to `callback`.
+  absl::Status ReadStreamRecords(
+      const std::function<absl::Status(const std::string_view&)>& callback)
+      override;
+
+ private:
+  std::string_view envelope_;
+};
+
+}  // namespace kv_server
+
+#endif  // PUBLIC_DATA_LOADING_READERS_REALTIME_ENVELOPE_H_
@@ -0,0 +1,92 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "public/data_loading/readers/realtime_envelope.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+using testing::ElementsAre;
+
+std::vector<std::string> ReadRecords(std::string_view envelope,
+                                     absl::Status& status) {
+  std::vector<std::string> records;
+  RealtimeEnvelopeRecordReader reader(envelope);
+  status = reader.ReadStreamRecords([&records](std::string_view record) {
+    records.emplace_back(record);
+    return absl::OkStatus();
+  });
+  return records;
+}
+
+TEST(RealtimeEnvelopeTest, ReadsEncodedRecords) {
+  const std::string large_record(300, 'x');
+  const std::vector<std::string_view> records = {"record1", "", large_record};
+  const std::string envelope = EncodeRealtimeEnvelope(records);
+  EXPECT_TRUE(IsRealtimeEnvelope(envelope));
+  absl::Status status;
+  EXPECT_THAT(ReadRecords(envelope, status),
+              ElementsAre("record1", "", large_record));
+  EXPECT_TRUE(status.ok());
+}
+
+TEST(RealtimeEnvelopeTest, EmptyEnvelopeHasNoRecords) {
+  const std::string envelope = EncodeRealtimeEnvelope({});
+  absl::Status status;
+  EXPECT_TRUE(ReadRecords(envelope, status).empty());
+  EXPECT_TRUE(status.ok());
+}
+
+TEST(RealtimeEnvelopeTest, OtherMessagesAreNotEnvelopes) {
+  EXPECT_FALSE(IsRealtimeEnvelope("S1ZSVA=="));
+  EXPECT_FALSE(IsRealtimeEnvelope(""));
+  absl::Status status;
+  ReadRecords("KVRT", status);
+  EXPECT_EQ(status.code(), absl::StatusCode::kInvalidArgument);
+}
+
+TEST(RealtimeEnvelopeTest, TruncatedEnvelopeIsAnError) {
+  const std::vector<std::string_view> records = {"record1", "record2"};
+  std::string envelope = EncodeRealtimeEnvelope(records);
+  envelope.pop_back();
+  absl::Status status;
+  EXPECT_THAT(ReadRecords(envelope, status), ElementsAre("record1"));
+  EXPECT_EQ(status.code(), absl::StatusCode::kDataLoss);
+}
+
+TEST(RealtimeEnvelopeTest, CallbackFailureDoesNotStopReading) {
+  const std::vector<std::string_view> records = {"record1", "record2"};
+  const std::string envelope = EncodeRealtimeEnvelope(records);
+  RealtimeEnvelopeRecordReader reader(envelope);
+  int num_records = 0;
+  EXPECT_TRUE(reader
+                  .ReadStreamRecords([&num_records](std::string_view) {
+                    ++num_records;
+                    return absl::InvalidArgumentError("bad record");
+                  })
+                  .ok());
+  EXPECT_EQ(num_records, 2);
+}
+
+}  // namespace
+}  // namespace kv_server
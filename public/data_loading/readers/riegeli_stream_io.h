@@ -19,9 +19,13 @@
 
 #include <algorithm>
 #include <cmath>
-#include <future>
+#include <cstdint>
+#include <limits>
 #include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
@@ -32,27 +36,88 @@
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/str_format.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "components/telemetry/server_definition.h"
+#include "components/util/thread_pool.h"
 #include "public/data_loading/readers/stream_record_reader.h"
 #include "public/data_loading/riegeli_metadata.pb.h"
 #include "riegeli/bytes/istream_reader.h"
+#include "riegeli/bytes/reader.h"
+#include "riegeli/bytes/string_reader.h"
 #include "riegeli/records/record_reader.h"
 #include "src/telemetry/telemetry_provider.h"
 
 namespace kv_server {
 
-// Reader that can read streams in Riegeli format.
+// Returns a reader of `record_stream`. Streams that are in memory are read in
+// place, without copying them into the buffers of a stream.
+inline std::unique_ptr<riegeli::Reader> CreateRiegeliReader(
+    RecordStream& record_stream) {
+  if (const auto contents = record_stream.Contents(); contents.has_value()) {
+    return std::make_unique<riegeli::StringReader<>>(*contents);
+  }
+  return std::make_unique<riegeli::IStreamReader<>>(&record_stream.Stream());
+}
+
+// Returns the record positions of `shard_num` in a file written with a shard
+// index for `num_shards` shards sharded with `sharding_hash_version`, if it
+// was.
+inline std::optional<ShardIndex::Section> FindShardSection(
+    const KVFileMetadata& metadata, int64_t shard_num, int64_t num_shards,
+    int32_t sharding_hash_version) {
+  if (!metadata.has_shard_index() ||
+      metadata.shard_index().num_shards() != num_shards ||
+      metadata.shard_index().sharding_hash_version() !=
+          sharding_hash_version) {
+    return std::nullopt;
+  }
+  for (const auto& section : metadata.shard_index().sections()) {
+    if (section.shard_num() == shard_num) {
+      return section;
+    }
+  }
+  return std::nullopt;
+}
+
+// Returns the position in a file written with `key_index` that the records of
+// `key`, and of the keys after it, are at or after.
+inline uint64_t FindKeyPosition(const KeyIndex& key_index,
+                                std::string_view key) {
+  const auto section = std::partition_point(
+      key_index.sections().begin(), key_index.sections().end(),
+      [key](const KeyIndex::Section& section) {
+        return section.last_key() < key;
+      });
+  if (section != key_index.sections().end()) {
+    return section->begin();
+  }
+  return key_index.sections().empty()
+             ? 0
+             : key_index.sections(key_index.sections_size() - 1).end();
+}
+
+// Reader that can read streams in Riegeli format. `RecordT` is
+// `std::string_view`, so that records are read in place.
 template <typename RecordT>
 class RiegeliStreamReader : public StreamRecordReader {
+  static_assert(std::is_same_v<RecordT, std::string_view>,
+                "Records are passed to callbacks as views");
+
  public:
   // `data_input` must be at the file beginning when passed in.
   explicit RiegeliStreamReader(
       std::istream& data_input,
       std::function<bool(const riegeli::SkippedRegion&)> recover)
-      : reader_(riegeli::RecordReader(
-            riegeli::IStreamReader(&data_input),
-            riegeli::RecordReaderBase::Options().set_recovery(
-                std::move(recover)))) {}
+      : RiegeliStreamReader(
+            std::make_unique<riegeli::IStreamReader<>>(&data_input),
+            std::move(recover)) {}
+  RiegeliStreamReader(
+      std::unique_ptr<riegeli::Reader> data_input,
+      std::function<bool(const riegeli::SkippedRegion&)> recover)
+      : reader_(std::move(data_input),
+                riegeli::RecordReaderBase::Options().set_recovery(
+                    std::move(recover))) {}
 
   absl::StatusOr<KVFileMetadata> GetKVFileMetadata() override {
     riegeli::RecordsMetadata metadata;
@@ -66,6 +131,7 @@ class RiegeliStreamReader : public StreamRecordReader {
 
     auto file_metadata = metadata.GetExtension(kv_file_metadata);
     VLOG(2) << "File metadata: " << file_metadata.DebugString();
+    metadata_ = file_metadata;
     return file_metadata;
   }
 
@@ -73,9 +139,38 @@ class RiegeliStreamReader : public StreamRecordReader {
 
   absl::Status ReadStreamRecords(
       const std::function<absl::Status(const RecordT&)>& callback) override {
+    return ReadRecordsBefore(std::numeric_limits<uint64_t>::max(), callback);
+  }
+
+  // Uses the shard index of the metadata read by `GetKVFileMetadata`.
+  absl::Status ReadShardStreamRecords(
+      int64_t shard_num, int64_t num_shards, int32_t sharding_hash_version,
+      const std::function<absl::Status(const RecordT&)>& callback) override {
+    const std::optional<ShardIndex::Section> section =
+        metadata_.has_value()
+            ? FindShardSection(*metadata_, shard_num, num_shards,
+                               sharding_hash_version)
+            : std::nullopt;
+    if (!section.has_value()) {
+      return ReadStreamRecords(callback);
+    }
+    if (!reader_.Seek(section->begin())) {
+      return reader_.status();
+    }
+    return ReadRecordsBefore(section->end(), callback);
+  }
+
+  bool IsOpen() const { return reader_.is_open(); }
+  absl::Status Status() const { return reader_.status(); }
+
+ private:
+  absl::Status ReadRecordsBefore(
+      uint64_t end_pos,
+      const std::function<absl::Status(const RecordT&)>& callback) {
+    // A view of the record in the decoded chunk, valid until the next read.
     RecordT record;
     absl::Status overall_status;
-    while (reader_.ReadRecord(record)) {
+    while (reader_.pos().numeric() < end_pos && reader_.ReadRecord(record)) {
       const auto callback_status = callback(record);
       LOG_IF(WARNING, !callback_status.ok());
       overall_status.Update(callback_status);
@@ -86,11 +181,8 @@ class RiegeliStreamReader : public StreamRecordReader {
     return reader_.status();
   }
 
-  bool IsOpen() const { return reader_.is_open(); }
-  absl::Status Status() const { return reader_.status(); }
-
- private:
-  riegeli::RecordReader<riegeli::IStreamReader<>> reader_;
+  riegeli::RecordReader<std::unique_ptr<riegeli::Reader>> reader_;
+  std::optional<KVFileMetadata> metadata_;
 };
 
 const int64_t kDefaultNumWorkerThreads = std::thread::hardware_concurrency();
@@ -139,6 +231,12 @@ class ConcurrentStreamRecordReader : public StreamRecordReader {
           LOG(WARNING) << "Skipping over corrupted region: " << region;
           return true;
         };
+    // A shard that fails to read is read again from the record after the
+    // last one it read, up to this many times in all, waiting
+    // `shard_retry_backoff` times the number of failed attempts in between,
+    // so that a transient error doesn't restart the read of the file.
+    int max_shard_read_attempts = 3;
+    absl::Duration shard_retry_backoff = absl::Seconds(1);
   };
   ConcurrentStreamRecordReader(
       std::function<std::unique_ptr<RecordStream>()> stream_factory,
@@ -150,6 +248,9 @@ class ConcurrentStreamRecordReader : public StreamRecordReader {
   absl::StatusOr<KVFileMetadata> GetKVFileMetadata() override;
   absl::Status ReadStreamRecords(
       const std::function<absl::Status(const RecordT&)>& callback) override;
+  absl::Status ReadShardStreamRecords(
+      int64_t shard_num, int64_t num_shards, int32_t sharding_hash_version,
+      const std::function<absl::Status(const RecordT&)>& callback) override;
 
  private:
   // Defines a byte range in the underlying record stream that will be read
@@ -168,7 +269,12 @@ class ConcurrentStreamRecordReader : public StreamRecordReader {
   absl::StatusOr<ShardResult> ReadShardRecords(
       const ShardRange& shard,
       const std::function<absl::Status(const RecordT&)>& record_callback);
-  absl::StatusOr<std::vector<ShardRange>> BuildShards();
+  // Reads the records at positions [`start_pos`, `end_pos`].
+  absl::Status ReadRecordRange(
+      int64_t start_pos, int64_t end_pos,
+      const std::function<absl::Status(const RecordT&)>& callback);
+  absl::StatusOr<std::vector<ShardRange>> BuildShards(int64_t start_pos,
+                                                      int64_t end_pos);
   absl::StatusOr<int64_t> RecordStreamSize();
   std::function<std::unique_ptr<RecordStream>()> stream_factory_;
   Options options_;
@@ -188,7 +294,8 @@ absl::StatusOr<KVFileMetadata>
 ConcurrentStreamRecordReader<RecordT>::GetKVFileMetadata() {
   auto record_stream = stream_factory_();
   RiegeliStreamReader<RecordT> metadata_reader(
-      record_stream->Stream(), [](const riegeli::SkippedRegion& region) {
+      CreateRiegeliReader(*record_stream),
+      [](const riegeli::SkippedRegion& region) {
         LOG(WARNING) << "Skipping over corrupted region: " << region;
         return true;
       });
@@ -198,6 +305,9 @@ template <typename RecordT>
 absl::StatusOr<int64_t>
 ConcurrentStreamRecordReader<RecordT>::RecordStreamSize() {
   auto record_stream = stream_factory_();
+  if (const auto contents = record_stream->Contents(); contents.has_value()) {
+    return contents->size();
+  }
   auto& stream = record_stream->Stream();
   stream.seekg(0, std::ios_base::end);
   int64_t size = stream.tellg();
@@ -210,37 +320,35 @@ ConcurrentStreamRecordReader<RecordT>::RecordStreamSize() {
 template <typename RecordT>
 absl::StatusOr<
     std::vector<typename ConcurrentStreamRecordReader<RecordT>::ShardRange>>
-ConcurrentStreamRecordReader<RecordT>::BuildShards() {
+ConcurrentStreamRecordReader<RecordT>::BuildShards(int64_t start_pos,
+                                                   int64_t end_pos) {
   using ShardRangeT =
       typename ConcurrentStreamRecordReader<RecordT>::ShardRange;
-  absl::StatusOr<int64_t> stream_size = RecordStreamSize();
-  if (!stream_size.ok()) {
-    return stream_size.status();
-  }
   if (options_.num_worker_threads < 1) {
     return absl::InvalidArgumentError(
         absl::StrFormat("Num worker threads %d must be at least 1.",
                         options_.num_worker_threads));
   }
   // The shard size must be at least `options_.min_shard_size_bytes` and
-  // at most `*stream_size`.
+  // at most the size of the range.
+  const int64_t range_size = end_pos - start_pos;
   int64_t shard_size = std::min(
-      *stream_size, std::max(int64_t(std::ceil((double)*stream_size /
-                                               options_.num_worker_threads)),
-                             options_.min_shard_size_bytes));
-  int64_t shard_start_pos = 0;
+      range_size, std::max(int64_t(std::ceil((double)range_size /
+                                             options_.num_worker_threads)),
+                           options_.min_shard_size_bytes));
+  int64_t shard_start_pos = start_pos;
   std::vector<ShardRangeT> shards;
   shards.reserve(options_.num_worker_threads);
-  while (shard_start_pos < *stream_size) {
+  while (shard_start_pos < end_pos) {
     int64_t shard_end_pos = shard_start_pos + shard_size;
-    shard_end_pos = std::min(shard_end_pos, *stream_size);
+    shard_end_pos = std::min(shard_end_pos, end_pos);
     shards.push_back(ShardRangeT{
         .start_pos = shard_start_pos,
         .end_pos = shard_end_pos,
     });
     shard_start_pos = shard_end_pos + 1;
   }
-  if (shards.empty() || shards.back().end_pos != *stream_size) {
+  if (shards.empty() || shards.back().end_pos != end_pos) {
     return absl::InternalError("Failed to generate shards.");
   }
   return shards;
@@ -251,34 +359,64 @@ ConcurrentStreamRecordReader<RecordT>::BuildShards() {
 template <typename RecordT>
 absl::Status ConcurrentStreamRecordReader<RecordT>::ReadStreamRecords(
     const std::function<absl::Status(const RecordT&)>& callback) {
+  absl::StatusOr<int64_t> stream_size = RecordStreamSize();
+  if (!stream_size.ok()) {
+    return stream_size.status();
+  }
+  return ReadRecordRange(/*start_pos=*/0, /*end_pos=*/*stream_size, callback);
+}
+
+template <typename RecordT>
+absl::Status ConcurrentStreamRecordReader<RecordT>::ReadShardStreamRecords(
+    int64_t shard_num, int64_t num_shards, int32_t sharding_hash_version,
+    const std::function<absl::Status(const RecordT&)>& callback) {
+  absl::StatusOr<KVFileMetadata> metadata = GetKVFileMetadata();
+  const std::optional<ShardIndex::Section> section =
+      metadata.ok() ? FindShardSection(*metadata, shard_num, num_shards,
+                                       sharding_hash_version)
+                    : std::nullopt;
+  if (!section.has_value()) {
+    return ReadStreamRecords(callback);
+  }
+  if (section->begin() >= section->end()) {
+    return absl::OkStatus();
+  }
+  VLOG(2) << "Reading records of shard " << shard_num << " at ["
+          << section->begin() << "," << section->end() << ")";
+  return ReadRecordRange(section->begin(), section->end() - 1, callback);
+}
+
+template <typename RecordT>
+absl::Status ConcurrentStreamRecordReader<RecordT>::ReadRecordRange(
+    int64_t start_pos, int64_t end_pos,
+    const std::function<absl::Status(const RecordT&)>& callback) {
   ScopeLatencyMetricsRecorder<
       ServerSafeMetricsContext,
       kConcurrentStreamRecordReaderReadStreamRecordsLatency>
       latency_recorder(KVServerContextMap()->SafeMetric());
-  auto shards = BuildShards();
+  auto shards = BuildShards(start_pos, end_pos);
   if (!shards.ok() || shards->empty()) {
     return shards.status();
   }
-  std::vector<std::future<absl::StatusOr<ShardResult>>> shard_reader_tasks;
+  // Shards are read on the shared pool, so that files that arrive back to
+  // back don't each start their own threads.
+  std::vector<TaskFuture<absl::StatusOr<ShardResult>>> shard_reader_tasks;
   for (const auto& shard : *shards) {
-    // TODO: b/268339067 - Investigate using an executor because
-    // std::async is generally not preffered, but works fine as an
-    // initial implementation.
     shard_reader_tasks.push_back(
-        std::async(std::launch::async,
-                   &ConcurrentStreamRecordReader<RecordT>::ReadShardRecords,
-                   this, std::ref(shard), std::ref(callback)));
+        SharedThreadPool().Async([this, &shard, &callback]() {
+          return ReadShardRecords(shard, callback);
+        }));
   }
-  absl::StatusOr<ShardResult> prev_shard_result = shard_reader_tasks[0].get();
+  absl::StatusOr<ShardResult> prev_shard_result = shard_reader_tasks[0].Get();
   if (!prev_shard_result.ok()) {
     return prev_shard_result.status();
   }
   int64_t total_records_read = prev_shard_result->num_records_read;
   for (int i = 1; i < shard_reader_tasks.size(); i++) {
-    absl::StatusOr<ShardResult> curr_shard_result = shard_reader_tasks[i].get();
-    // TODO: The stuff below should be handled more gracefully,
-    // e.g., only retry the shard that failed or skipped some
-    // records.
+    absl::StatusOr<ShardResult> curr_shard_result = shard_reader_tasks[i].Get();
+    // Shards retry read errors themselves, see `max_shard_read_attempts`.
+    // TODO: Skipped records should be handled more gracefully, e.g., by
+    // reading the skipped range again.
     if (!curr_shard_result.ok()) {
       return curr_shard_result.status();
     }
@@ -309,34 +447,69 @@ ConcurrentStreamRecordReader<RecordT>::ReadShardRecords(
       ServerSafeMetricsContext,
       kConcurrentStreamRecordReaderReadShardRecordsLatency>
       latency_recorder(KVServerContextMap()->SafeMetric());
-  auto record_stream = stream_factory_();
-  riegeli::RecordReader<riegeli::IStreamReader<>> record_reader(
-      riegeli::IStreamReader(&record_stream->Stream()),
-      riegeli::RecordReaderBase::Options().set_recovery(
-          options_.recovery_callback));
-  if (auto result = record_reader.Seek(shard.start_pos); !result) {
-    return record_reader.status();
-  }
-  auto next_record_pos = record_reader.pos().numeric();
   ShardResult shard_result;
-  shard_result.first_record_pos = next_record_pos;
+  bool has_first_record_pos = false;
+  // Position of the next record to pass to `record_callback`. A failed
+  // attempt resumes from it, so that no record is passed twice.
+  int64_t resume_pos = shard.start_pos;
+  int64_t next_record_pos = resume_pos;
   int64_t num_records_read = 0;
+  // A view of the record in the decoded chunk, valid until the next read, so
+  // that records aren't copied before `record_callback` reads them.
   RecordT record;
   absl::Status overall_status;
-  while (next_record_pos <= shard.end_pos && record_reader.ReadRecord(record)) {
-    overall_status.Update(record_callback(record));
-    num_records_read++;
-    next_record_pos = record_reader.pos().numeric();
+  // Time spent outside of the record callbacks, reading and decoding chunks.
+  absl::Duration decode_latency;
+  for (int attempt = 1;; ++attempt) {
+    auto record_stream = stream_factory_();
+    riegeli::RecordReader<std::unique_ptr<riegeli::Reader>> record_reader(
+        CreateRiegeliReader(*record_stream),
+        riegeli::RecordReaderBase::Options().set_recovery(
+            options_.recovery_callback));
+    if (record_reader.Seek(resume_pos)) {
+      next_record_pos = record_reader.pos().numeric();
+      if (!has_first_record_pos) {
+        shard_result.first_record_pos = next_record_pos;
+        has_first_record_pos = true;
+      }
+      absl::Time decode_start = absl::Now();
+      while (next_record_pos <= shard.end_pos &&
+             record_reader.ReadRecord(record)) {
+        const absl::Time decoded = absl::Now();
+        decode_latency += decoded - decode_start;
+        overall_status.Update(record_callback(record));
+        num_records_read++;
+        next_record_pos = record_reader.pos().numeric();
+        resume_pos = next_record_pos;
+        decode_start = absl::Now();
+      }
+      decode_latency += absl::Now() - decode_start;
+    }
+    if (record_reader.ok()) {
+      break;
+    }
+    if (attempt >= options_.max_shard_read_attempts) {
+      return record_reader.status();
+    }
+    LOG(WARNING) << "Reading shard [" << shard.start_pos << ","
+                 << shard.end_pos << "] again from byte " << resume_pos
+                 << " after: " << record_reader.status();
+    LogIfError(KVServerContextMap()
+                   ->SafeMetric()
+                   .LogUpDownCounter<kConcurrentStreamRecordReaderShardRetries>(
+                       1));
+    absl::SleepFor(options_.shard_retry_backoff * attempt);
   }
+  LogIfError(KVServerContextMap()
+                 ->SafeMetric()
+                 .LogHistogram<kConcurrentStreamRecordReaderDecodeLatency>(
+                     absl::ToDoubleMicroseconds(decode_latency)));
   // TODO: b/269119466 - Figure out how to handle this better. Maybe add
   // metrics to track callback failures (??).
   if (!overall_status.ok()) {
     LOG(ERROR) << "Record callback failed to process some records with: "
                << overall_status;
   }
-  if (!record_reader.ok()) {
-    return record_reader.status();
-  }
   shard_result.next_shard_first_record_pos = next_record_pos;
   shard_result.num_records_read = num_records_read;
   VLOG(2) << "Done reading " << num_records_read << " records in shard: ["
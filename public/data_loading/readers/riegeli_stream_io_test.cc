@@ -14,18 +14,27 @@
 
 #include "public/data_loading/readers/riegeli_stream_io.h"
 
+#include <atomic>
+#include <deque>
 #include <filesystem>
 #include <fstream>
+#include <optional>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <utility>
+#include <vector>
 
 #include "absl/log/check.h"
 #include "absl/status/status.h"
+#include "absl/strings/numbers.h"
+#include "absl/synchronization/mutex.h"
 #include "gmock/gmock.h"
 #include "google/protobuf/text_format.h"
 #include "gtest/gtest.h"
 #include "public/data_loading/readers/riegeli_stream_record_reader_factory.h"
+#include "public/data_loading/writers/sharded_record_buffer.h"
+#include "public/sharding/sharding_function.h"
 #include "public/test_util/mocks.h"
 #include "public/test_util/proto_matcher.h"
 #include "riegeli/bytes/ostream_writer.h"
@@ -287,6 +296,209 @@ TEST(ConcurrentStreamRecordReaderTest, FailsToReadNonSeekingStream) {
   EXPECT_EQ(status.message(), "Input streams do not support seeking.");
 }
 
+// Holds a blob in memory, with a stream that fails to read.
+class InMemoryBlobStream : public RecordStream {
+ public:
+  explicit InMemoryBlobStream(std::string_view blob) : blob_(blob) {
+    stream_.setstate(std::ios_base::badbit);
+  }
+  std::istream& Stream() { return stream_; }
+  std::optional<std::string_view> Contents() override { return blob_; }
+
+ private:
+  std::string_view blob_;
+  std::stringstream stream_;
+};
+
+TEST(ConcurrentStreamRecordReaderTest, ReadsInMemoryStreamsInPlace) {
+  kv_server::InitMetricsContextMap();
+  std::string content;
+  auto writer = riegeli::RecordWriter(riegeli::StringWriter(&content),
+                                      riegeli::RecordWriterBase::Options());
+  testing::MockFunction<absl::Status(std::string_view)> callback;
+  for (int i = 0; i < 2500; i++) {
+    auto record = absl::StrCat(i);
+    writer.WriteRecord(record);
+    EXPECT_CALL(callback, Call(record))
+        .WillOnce(
+            [](std::string_view record_read) { return absl::OkStatus(); });
+  }
+  ASSERT_TRUE(writer.Close());
+  ConcurrentStreamRecordReader<std::string_view> record_reader(
+      [&content]() { return std::make_unique<InMemoryBlobStream>(content); },
+      ConcurrentReaderOptions{
+          .num_worker_threads = 3,
+          .min_shard_size_bytes = 1024,
+      });
+  EXPECT_TRUE(record_reader.ReadStreamRecords(callback.AsStdFunction()).ok());
+}
+
+// Fails the first read past `fail_at` bytes of the blob, over all the
+// streambufs that share `failed`, as a reset connection would.
+class FlakyStringBuf : public std::stringbuf {
+ public:
+  FlakyStringBuf(const std::string& blob, int64_t fail_at,
+                 std::atomic<bool>& failed)
+      : std::stringbuf(blob), fail_at_(fail_at), failed_(failed) {}
+  void set_stream(std::istream* stream) { stream_ = stream; }
+
+ protected:
+  std::streamsize xsgetn(char* s, std::streamsize count) override {
+    if (gptr() - eback() + count > fail_at_ && !failed_.exchange(true)) {
+      stream_->setstate(std::ios_base::badbit);
+      return 0;
+    }
+    return std::stringbuf::xsgetn(s, count);
+  }
+
+ private:
+  const int64_t fail_at_;
+  std::atomic<bool>& failed_;
+  std::istream* stream_ = nullptr;
+};
+
+class FlakyStringBlobStream : public RecordStream {
+ public:
+  FlakyStringBlobStream(const std::string& blob, int64_t fail_at,
+                        std::atomic<bool>& failed)
+      : stringbuf_(blob, fail_at, failed), stream_(&stringbuf_) {
+    stringbuf_.set_stream(&stream_);
+  }
+  std::istream& Stream() { return stream_; }
+
+ private:
+  FlakyStringBuf stringbuf_;
+  std::istream stream_;
+};
+
+TEST(ConcurrentStreamRecordReaderTest, ResumesShardAfterReadError) {
+  kv_server::InitMetricsContextMap();
+  constexpr int kNumRecords = 100000;
+  std::string content;
+  auto writer = riegeli::RecordWriter(
+      riegeli::StringWriter(&content),
+      riegeli::RecordWriterBase::Options().set_uncompressed());
+  for (int i = 0; i < kNumRecords; i++) {
+    writer.WriteRecord(absl::StrCat(i));
+  }
+  ASSERT_TRUE(writer.Close());
+  std::atomic<bool> failed = false;
+  ConcurrentStreamRecordReader<std::string_view> record_reader(
+      [&content, &failed]() {
+        return std::make_unique<FlakyStringBlobStream>(
+            content, /*fail_at=*/content.size() / 2, failed);
+      },
+      ConcurrentReaderOptions{
+          .num_worker_threads = 1,
+          .shard_retry_backoff = absl::ZeroDuration(),
+      });
+  // The records read before the error aren't read again.
+  std::vector<int> num_reads(kNumRecords);
+  const auto status =
+      record_reader.ReadStreamRecords([&num_reads](std::string_view record) {
+        int i;
+        EXPECT_TRUE(absl::SimpleAtoi(record, &i));
+        num_reads[i]++;
+        return absl::OkStatus();
+      });
+  EXPECT_TRUE(status.ok()) << status;
+  EXPECT_TRUE(failed);
+  EXPECT_THAT(num_reads, testing::Each(1));
+}
+
+TEST(ConcurrentStreamRecordReaderTest, FailsAfterShardReadAttempts) {
+  kv_server::InitMetricsContextMap();
+  std::string content;
+  auto writer = riegeli::RecordWriter(
+      riegeli::StringWriter(&content),
+      riegeli::RecordWriterBase::Options().set_uncompressed());
+  for (int i = 0; i < 100000; i++) {
+    writer.WriteRecord(absl::StrCat(i));
+  }
+  ASSERT_TRUE(writer.Close());
+  // Every stream fails, so every attempt fails.
+  std::deque<std::atomic<bool>> failed;
+  ConcurrentStreamRecordReader<std::string_view> record_reader(
+      [&content, &failed]() {
+        std::atomic<bool>& stream_failed = failed.emplace_back(false);
+        return std::make_unique<FlakyStringBlobStream>(
+            content, /*fail_at=*/content.size() / 2, stream_failed);
+      },
+      ConcurrentReaderOptions{
+          .num_worker_threads = 1,
+          .max_shard_read_attempts = 2,
+          .shard_retry_backoff = absl::ZeroDuration(),
+      });
+  const auto status = record_reader.ReadStreamRecords(
+      [](std::string_view) { return absl::OkStatus(); });
+  EXPECT_FALSE(status.ok());
+  EXPECT_EQ(failed.size(), 3);  // The size and the two attempts.
+}
+
+TEST(ConcurrentStreamRecordReaderTest, ReadsOnlyRecordsOfShard) {
+  kv_server::InitMetricsContextMap();
+  constexpr int kNumShards = 4;
+  constexpr int kShardNum = 3;
+  ShardingFunction sharding_func(/*seed=*/"");
+  auto record_buffer = ShardedRecordBuffer::Create(kNumShards, sharding_func);
+  ASSERT_TRUE(record_buffer.ok()) << record_buffer.status();
+  std::vector<std::string> keys;
+  int num_shard_keys = 0;
+  for (int i = 0; i < 2500; i++) {
+    keys.push_back(absl::StrCat("key", i));
+    if (sharding_func.GetShardNumForKey(keys.back(), kNumShards) ==
+        kShardNum) {
+      num_shard_keys++;
+    }
+  }
+  for (const auto& key : keys) {
+    DataRecordStruct data_record;
+    data_record.record = KeyValueMutationRecordStruct{
+        .mutation_type = KeyValueMutationType::Update,
+        .logical_commit_time = 1,
+        .key = key,
+        .value = "value",
+    };
+    ASSERT_TRUE((*record_buffer)->AddRecord(data_record).ok());
+  }
+  std::stringstream content;
+  auto status = (*record_buffer)
+                    ->WriteShardIndexedRecordStream(
+                        content, DeltaRecordWriter::Options{
+                                     .enable_compression = true,
+                                 });
+  ASSERT_TRUE(status.ok()) << status;
+  const std::string blob = content.str();
+  ConcurrentStreamRecordReader<std::string_view> record_reader(
+      [&blob]() { return std::make_unique<StringBlobStream>(blob); },
+      ConcurrentReaderOptions{
+          .num_worker_threads = 3,
+          .min_shard_size_bytes = 1024,
+      });
+  absl::Mutex mutex;
+  int num_records_read = 0;
+  status = record_reader.ReadShardStreamRecords(
+      kShardNum, kNumShards, /*sharding_hash_version=*/0,
+      [&](std::string_view raw) {
+        return DeserializeDataRecord(
+            raw, std::function<absl::Status(const DataRecordStruct&)>(
+                     [&](const DataRecordStruct& data_record) {
+                       const auto& key =
+                           std::get<KeyValueMutationRecordStruct>(
+                               data_record.record)
+                               .key;
+                       EXPECT_EQ(
+                           sharding_func.GetShardNumForKey(key, kNumShards),
+                           kShardNum);
+                       absl::MutexLock lock(&mutex);
+                       num_records_read++;
+                       return absl::OkStatus();
+                     }));
+      });
+  EXPECT_TRUE(status.ok()) << status;
+  EXPECT_EQ(num_records_read, num_shard_keys);
+}
+
 void WriteRiegeliToFile(const std::vector<std::string_view>& records,
                         std::ostream& dest_stream) {
   riegeli::RecordWriter record_writer(
@@ -17,6 +17,11 @@
 #ifndef PUBLIC_DATA_LOADING_READERS_STREAM_RECORD_READER_H_
 #define PUBLIC_DATA_LOADING_READERS_STREAM_RECORD_READER_H_
 
+#include <cstdint>
+#include <istream>
+#include <optional>
+#include <string_view>
+
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "public/data_loading/riegeli_metadata.pb.h"
@@ -40,8 +45,22 @@ class StreamRecordReader {
   // records, parses the records and calls `callback` once per record.
   // If the callback returns a non-OK status, the function continues
   // reading and logs the error at the end.
+  //
+  // Records are passed as views of the buffers of the reader, without being
+  // copied out of them, so a view is only valid until `callback` returns.
+  // Callbacks that keep a record have to copy it.
   virtual absl::Status ReadStreamRecords(
       const std::function<absl::Status(const std::string_view&)>& callback) = 0;
+
+  // Same as `ReadStreamRecords`, but files with a `shard_index` for
+  // `num_shards` shards sharded with `sharding_hash_version` are only read
+  // where the records of `shard_num` are. Callers still have to check the
+  // shard of each record, as files without such an index are read entirely.
+  virtual absl::Status ReadShardStreamRecords(
+      int64_t shard_num, int64_t num_shards, int32_t sharding_hash_version,
+      const std::function<absl::Status(const std::string_view&)>& callback) {
+    return ReadStreamRecords(callback);
+  }
 };
 
 // Holds a stream of data.
@@ -49,6 +68,9 @@ class RecordStream {
  public:
   virtual ~RecordStream() = default;
   virtual std::istream& Stream() = 0;
+  // The whole stream, if it is in memory, e.g. a memory-mapped file, so that
+  // readers can read it in place instead of through `Stream`.
+  virtual std::optional<std::string_view> Contents() { return std::nullopt; }
 };
 
 }  // namespace kv_server
@@ -49,6 +49,11 @@ absl::Status ValidateValue(const KeyValueMutationRecord& kv_mutation_record) {
        kv_mutation_record.value_as_StringSet()->value() == nullptr)) {
     return absl::InvalidArgumentError("StringSet value not set.");
   }
+  if (kv_mutation_record.value_type() == Value::UInt32Set &&
+      (kv_mutation_record.value_as_UInt32Set() == nullptr ||
+       kv_mutation_record.value_as_UInt32Set()->value() == nullptr)) {
+    return absl::InvalidArgumentError("UInt32Set value not set.");
+  }
   return absl::OkStatus();
 }
 
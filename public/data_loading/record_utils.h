@@ -45,6 +45,14 @@ inline std::ostream& operator<<(std::ostream& os,
   return os;
 }
 
+inline std::ostream& operator<<(std::ostream& os,
+                                const UInt32SetT& uint32_set_value) {
+  for (const uint32_t value : uint32_set_value.value) {
+    os << value << ", ";
+  }
+  return os;
+}
+
 inline std::ostream& operator<<(std::ostream& os,
                                 const ValueUnion& value_union) {
   switch (value_union.type) {
@@ -56,6 +64,10 @@ inline std::ostream& operator<<(std::ostream& os,
       os << *(reinterpret_cast<const StringSetT*>(value_union.value));
       break;
     }
+    case Value::UInt32Set: {
+      os << *(reinterpret_cast<const UInt32SetT*>(value_union.value));
+      break;
+    }
     case Value::NONE: {
       break;
     }
@@ -15,6 +15,9 @@
 #include "public/data_loading/records_utils.h"
 
 #include <numeric>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include "absl/log/log.h"
 #include "absl/status/statusor.h"
@@ -32,6 +35,19 @@ struct RecordUnion {
   flatbuffers::Offset<void> record;
 };
 
+// Records serialized into one buffer start at multiples of the largest
+// alignment of their fields.
+constexpr size_t kRecordAlignment = 8;
+
+size_t AlignRecordOffset(size_t offset) {
+  return (offset + kRecordAlignment - 1) / kRecordAlignment * kRecordAlignment;
+}
+
+flatbuffers::FlatBufferBuilder& ThreadBuilder() {
+  thread_local flatbuffers::FlatBufferBuilder builder;
+  return builder;
+}
+
 ValueUnion BuildValueUnion(const KeyValueMutationRecordValueT& value,
                            flatbuffers::FlatBufferBuilder& builder) {
   return std::visit(
@@ -50,6 +66,13 @@ ValueUnion BuildValueUnion(const KeyValueMutationRecordValueT& value,
               .value = CreateStringSet(builder, values_offset).Union(),
           };
         }
+        if constexpr (std::is_same_v<VariantT, std::vector<uint32_t>>) {
+          auto values_offset = builder.CreateVector(arg);
+          return ValueUnion{
+              .value_type = Value::UInt32Set,
+              .value = CreateUInt32Set(builder, values_offset).Union(),
+          };
+        }
         if constexpr (std::is_same_v<VariantT, std::monostate>) {
           return ValueUnion{
               .value_type = Value::NONE,
@@ -76,14 +99,16 @@ flatbuffers::Offset<UserDefinedFunctionsConfig> UdfConfigFromStruct(
       builder, udf_config_struct.language,
       udf_config_struct.code_snippet.data(),
       udf_config_struct.handler_name.data(),
-      udf_config_struct.logical_commit_time, udf_config_struct.version);
+      udf_config_struct.logical_commit_time, udf_config_struct.version,
+      udf_config_struct.argument_format, udf_config_struct.cache_outputs);
 }
 
 flatbuffers::Offset<ShardMappingRecord> ShardMappingFromStruct(
     flatbuffers::FlatBufferBuilder& builder,
     const ShardMappingRecordStruct& shard_mapping_struct) {
   return CreateShardMappingRecord(builder, shard_mapping_struct.logical_shard,
-                                  shard_mapping_struct.physical_shard);
+                                  shard_mapping_struct.physical_shard,
+                                  shard_mapping_struct.state);
 }
 
 RecordUnion BuildRecordUnion(const RecordT& record,
@@ -122,7 +147,13 @@ RecordUnion BuildRecordUnion(const RecordT& record,
 
 template <typename FbsRecordT>
 absl::StatusOr<const FbsRecordT*> DeserializeAndVerifyRecord(
-    std::string_view record_bytes) {
+    std::string_view record_bytes, bool verify) {
+  if (!verify) {
+    if (record_bytes.size() < sizeof(flatbuffers::uoffset_t)) {
+      return absl::InvalidArgumentError("Invalid flatbuffer bytes.");
+    }
+    return flatbuffers::GetRoot<FbsRecordT>(record_bytes.data());
+  }
   auto fbs_record = flatbuffers::GetRoot<FbsRecordT>(record_bytes.data());
   auto record_verifier = flatbuffers::Verifier(
       reinterpret_cast<const uint8_t*>(record_bytes.data()),
@@ -148,6 +179,11 @@ absl::Status ValidateValue(const KeyValueMutationRecord& kv_mutation_record) {
        kv_mutation_record.value_as_StringSet()->value() == nullptr)) {
     return absl::InvalidArgumentError("StringSet value not set.");
   }
+  if (kv_mutation_record.value_type() == Value::UInt32Set &&
+      (kv_mutation_record.value_as_UInt32Set() == nullptr ||
+       kv_mutation_record.value_as_UInt32Set()->value() == nullptr)) {
+    return absl::InvalidArgumentError("UInt32Set value not set.");
+  }
   return absl::OkStatus();
 }
 
@@ -159,6 +195,23 @@ absl::Status ValidateKeyValueMutationRecord(
   return ValidateValue(kv_mutation_record);
 }
 
+absl::Status ValidateKeyValueMutationBatch(
+    const KeyValueMutationBatch& batch) {
+  if (batch.mutation_types() == nullptr ||
+      batch.logical_commit_times() == nullptr || batch.keys() == nullptr ||
+      batch.values() == nullptr) {
+    return absl::InvalidArgumentError("KeyValueMutationBatch vector not set.");
+  }
+  const auto size = batch.keys()->size();
+  if (batch.mutation_types()->size() != size ||
+      batch.logical_commit_times()->size() != size ||
+      batch.values()->size() != size) {
+    return absl::InvalidArgumentError(
+        "KeyValueMutationBatch vectors have different sizes.");
+  }
+  return absl::OkStatus();
+}
+
 absl::Status ValidateUserDefinedFunctionsConfig(
     const UserDefinedFunctionsConfig& udf_config) {
   if (udf_config.code_snippet() == nullptr) {
@@ -190,6 +243,14 @@ absl::Status ValidateData(const DataRecord& data_record) {
       return status;
     }
   }
+
+  if (data_record.record_type() == Record::KeyValueMutationBatch) {
+    if (const auto status = ValidateKeyValueMutationBatch(
+            *data_record.record_as_KeyValueMutationBatch());
+        !status.ok()) {
+      return status;
+    }
+  }
   return absl::OkStatus();
 }
 
@@ -202,6 +263,9 @@ KeyValueMutationRecordValueT GetRecordStructValue(
   if (fbs_record.value_type() == Value::StringSet) {
     value = GetRecordValue<std::vector<std::string_view>>(fbs_record);
   }
+  if (fbs_record.value_type() == Value::UInt32Set) {
+    value = GetRecordValue<std::vector<uint32_t>>(fbs_record);
+  }
   return value;
 }
 
@@ -241,7 +305,9 @@ bool operator==(const UserDefinedFunctionsConfigStruct& lhs_record,
          lhs_record.version == rhs_record.version &&
          lhs_record.handler_name == rhs_record.handler_name &&
          lhs_record.language == rhs_record.language &&
-         lhs_record.code_snippet == rhs_record.code_snippet;
+         lhs_record.code_snippet == rhs_record.code_snippet &&
+         lhs_record.argument_format == rhs_record.argument_format &&
+         lhs_record.cache_outputs == rhs_record.cache_outputs;
 }
 
 bool operator!=(const UserDefinedFunctionsConfigStruct& lhs_record,
@@ -252,7 +318,8 @@ bool operator!=(const UserDefinedFunctionsConfigStruct& lhs_record,
 bool operator==(const ShardMappingRecordStruct& lhs_record,
                 const ShardMappingRecordStruct& rhs_record) {
   return lhs_record.logical_shard == rhs_record.logical_shard &&
-         lhs_record.physical_shard == rhs_record.physical_shard;
+         lhs_record.physical_shard == rhs_record.physical_shard &&
+         lhs_record.state == rhs_record.state;
 }
 
 bool operator!=(const ShardMappingRecordStruct& lhs_record,
@@ -277,19 +344,63 @@ bool IsEmptyValue(const KeyValueMutationRecordValueT& value) {
 flatbuffers::FlatBufferBuilder ToFlatBufferBuilder(
     const KeyValueMutationRecordStruct& record) {
   flatbuffers::FlatBufferBuilder builder;
-  const auto fbs_record = KeyValueMutationFromStruct(builder, record);
-  builder.Finish(fbs_record);
+  SerializeKeyValueMutationRecord(record, builder);
   return builder;
 }
 
 flatbuffers::FlatBufferBuilder ToFlatBufferBuilder(
     const DataRecordStruct& data_record) {
   flatbuffers::FlatBufferBuilder builder;
+  SerializeDataRecord(data_record, builder);
+  return builder;
+}
+
+std::string_view SerializeKeyValueMutationRecord(
+    const KeyValueMutationRecordStruct& record,
+    flatbuffers::FlatBufferBuilder& builder) {
+  builder.Clear();
+  const auto fbs_record = KeyValueMutationFromStruct(builder, record);
+  builder.Finish(fbs_record);
+  return ToStringView(builder);
+}
+
+std::string_view SerializeDataRecord(const DataRecordStruct& data_record,
+                                     flatbuffers::FlatBufferBuilder& builder) {
+  builder.Clear();
   auto kv_fbs_record = BuildRecordUnion(data_record.record, builder);
   const auto fbs_record = CreateDataRecord(builder, kv_fbs_record.record_type,
                                            kv_fbs_record.record);
   builder.Finish(fbs_record);
-  return builder;
+  return ToStringView(builder);
+}
+
+std::string_view SerializeKeyValueMutationRecord(
+    const KeyValueMutationRecordStruct& record) {
+  return SerializeKeyValueMutationRecord(record, ThreadBuilder());
+}
+
+std::string_view SerializeDataRecord(const DataRecordStruct& data_record) {
+  return SerializeDataRecord(data_record, ThreadBuilder());
+}
+
+void SerializeDataRecords(absl::Span<const DataRecordStruct> data_records,
+                          std::string& buffer,
+                          std::vector<std::string_view>& records) {
+  buffer.clear();
+  records.clear();
+  // Offsets and sizes of the records first, `buffer` moves as it grows.
+  std::vector<std::pair<size_t, size_t>> spans;
+  spans.reserve(data_records.size());
+  for (const DataRecordStruct& data_record : data_records) {
+    const std::string_view record = SerializeDataRecord(data_record);
+    buffer.resize(AlignRecordOffset(buffer.size()));
+    spans.emplace_back(buffer.size(), record.size());
+    buffer.append(record);
+  }
+  records.reserve(spans.size());
+  for (const auto& [offset, size] : spans) {
+    records.push_back(std::string_view(buffer).substr(offset, size));
+  }
 }
 
 absl::Status DeserializeRecord(
@@ -310,8 +421,10 @@ absl::Status DeserializeRecord(
 
 absl::Status DeserializeDataRecord(
     std::string_view record_bytes,
-    const std::function<absl::Status(const DataRecord&)>& record_callback) {
-  auto fbs_record = DeserializeAndVerifyRecord<DataRecord>(record_bytes);
+    const std::function<absl::Status(const DataRecord&)>& record_callback,
+    DeserializeOptions options) {
+  auto fbs_record =
+      DeserializeAndVerifyRecord<DataRecord>(record_bytes, options.verify);
   if (!fbs_record.ok()) {
     LOG_FIRST_N(ERROR, 3) << "Record deserialization failed: "
                           << fbs_record.status();
@@ -331,24 +444,127 @@ absl::Status DeserializeDataRecord(
   return DeserializeDataRecord(
       record_bytes, [&record_callback](const DataRecord& fbs_record) {
         DataRecordStruct data_struct;
+        if (fbs_record.record_type() == Record::KeyValueMutationBatch) {
+          return ForEachKeyValueMutation(
+              *fbs_record.record_as_KeyValueMutationBatch(),
+              [&record_callback,
+               &data_struct](const KeyValueMutationRecordStruct& record) {
+                data_struct.record = record;
+                return record_callback(data_struct);
+              });
+        }
         data_struct.record = GetRecordStruct(fbs_record);
         return record_callback(data_struct);
       });
 }
 
+absl::Status ForEachKeyValueMutation(
+    const KeyValueMutationBatch& batch,
+    const std::function<absl::Status(const KeyValueMutationRecordStruct&)>&
+        fn) {
+  const auto* mutation_types = batch.mutation_types();
+  const auto* logical_commit_times = batch.logical_commit_times();
+  const auto* keys = batch.keys();
+  const auto* values = batch.values();
+  for (flatbuffers::uoffset_t i = 0; i < keys->size(); ++i) {
+    const KeyValueMutationRecordStruct record{
+        .mutation_type =
+            static_cast<KeyValueMutationType>(mutation_types->Get(i)),
+        .logical_commit_time = logical_commit_times->Get(i),
+        .key = keys->Get(i)->string_view(),
+        .value = values->Get(i)->string_view(),
+    };
+    if (absl::Status status = fn(record); !status.ok()) {
+      return status;
+    }
+  }
+  return absl::OkStatus();
+}
+
+bool KeyValueMutationBatchBuilder::CanBatch(
+    const DataRecordStruct& data_record) {
+  const auto* record =
+      std::get_if<KeyValueMutationRecordStruct>(&data_record.record);
+  return record != nullptr &&
+         std::holds_alternative<std::string_view>(record->value);
+}
+
+void KeyValueMutationBatchBuilder::Add(
+    const KeyValueMutationRecordStruct& record) {
+  mutation_types_.push_back(static_cast<int8_t>(record.mutation_type));
+  logical_commit_times_.push_back(record.logical_commit_time);
+  keys_.emplace_back(record.key);
+  values_.emplace_back(std::get<std::string_view>(record.value));
+}
+
+void KeyValueMutationBatchBuilder::ForEachRecord(
+    const std::function<void(const DataRecordStruct&)>& fn) const {
+  for (size_t i = 0; i < keys_.size(); ++i) {
+    fn(DataRecordStruct{
+        .record = KeyValueMutationRecordStruct{
+            .mutation_type =
+                static_cast<KeyValueMutationType>(mutation_types_[i]),
+            .logical_commit_time = logical_commit_times_[i],
+            .key = keys_[i],
+            .value = std::string_view(values_[i]),
+        }});
+  }
+}
+
+std::string_view KeyValueMutationBatchBuilder::Serialize(
+    flatbuffers::FlatBufferBuilder& builder) const {
+  builder.Clear();
+  const auto mutation_types = builder.CreateVector(mutation_types_);
+  const auto logical_commit_times = builder.CreateVector(logical_commit_times_);
+  const auto keys = builder.CreateVectorOfStrings(keys_);
+  const auto values = builder.CreateVectorOfStrings(values_);
+  const auto batch = CreateKeyValueMutationBatch(
+      builder, mutation_types, logical_commit_times, keys, values);
+  builder.Finish(
+      CreateDataRecord(builder, Record::KeyValueMutationBatch, batch.Union()));
+  return ToStringView(builder);
+}
+
+void KeyValueMutationBatchBuilder::Clear() {
+  mutation_types_.clear();
+  logical_commit_times_.clear();
+  keys_.clear();
+  values_.clear();
+}
+
 template <>
 std::string_view GetRecordValue(const KeyValueMutationRecord& record) {
   return record.value_as_StringValue()->value()->string_view();
 }
 
+template <>
+StringSetView GetRecordValue(const KeyValueMutationRecord& record) {
+  return StringSetView(record.value_as_StringSet()->value());
+}
+
 template <>
 std::vector<std::string_view> GetRecordValue(
     const KeyValueMutationRecord& record) {
-  std::vector<std::string_view> values;
-  for (const auto val : *record.value_as_StringSet()->value()) {
-    values.push_back(val->string_view());
-  }
-  return values;
+  const auto values = GetRecordValue<StringSetView>(record);
+  return std::vector<std::string_view>(values.begin(), values.end());
+}
+
+template <>
+absl::Span<const uint32_t> GetRecordValue(
+    const KeyValueMutationRecord& record) {
+  // Flatbuffers store scalars little-endian, and align vectors to the size of
+  // their elements.
+  static_assert(FLATBUFFERS_LITTLEENDIAN,
+                "UInt32Set values are only read in place on little-endian "
+                "hosts");
+  const auto* values = record.value_as_UInt32Set()->value();
+  return absl::MakeConstSpan(values->data(), values->size());
+}
+
+template <>
+std::vector<uint32_t> GetRecordValue(const KeyValueMutationRecord& record) {
+  const auto values = GetRecordValue<absl::Span<const uint32_t>>(record);
+  return std::vector<uint32_t>(values.begin(), values.end());
 }
 
 template <>
@@ -375,6 +591,8 @@ UserDefinedFunctionsConfigStruct GetTypedRecordStruct(
   udf_config_struct.code_snippet = udf_config->code_snippet()->string_view();
   udf_config_struct.handler_name = udf_config->handler_name()->string_view();
   udf_config_struct.version = udf_config->version();
+  udf_config_struct.argument_format = udf_config->argument_format();
+  udf_config_struct.cache_outputs = udf_config->cache_outputs();
   return udf_config_struct;
 }
 
@@ -384,6 +602,7 @@ ShardMappingRecordStruct GetTypedRecordStruct(const DataRecord& data_record) {
   return ShardMappingRecordStruct{
       .logical_shard = shard_mapping_record->logical_shard(),
       .physical_shard = shard_mapping_record->physical_shard(),
+      .state = shard_mapping_record->state(),
   };
 }
 
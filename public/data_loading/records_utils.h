@@ -17,6 +17,9 @@
 #ifndef PUBLIC_DATA_LOADING_RECORDS_UTILS_H_
 #define PUBLIC_DATA_LOADING_RECORDS_UTILS_H_
 
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
 #include <string>
 #include <string_view>
 #include <utility>
@@ -25,6 +28,7 @@
 
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/types/span.h"
 #include "public/data_loading/data_loading_generated.h"
 #include "public/data_loading/record_utils.h"
 
@@ -38,7 +42,7 @@ enum class DataRecordType : int {
 
 using KeyValueMutationRecordValueT =
     std::variant<std::monostate, std::string_view,
-                 std::vector<std::string_view>>;
+                 std::vector<std::string_view>, std::vector<uint32_t>>;
 
 struct KeyValueMutationRecordStruct {
   KeyValueMutationType mutation_type;
@@ -53,11 +57,15 @@ struct UserDefinedFunctionsConfigStruct {
   std::string_view handler_name;
   int64_t logical_commit_time;
   int64_t version;
+  UserDefinedFunctionsArgumentFormat argument_format =
+      UserDefinedFunctionsArgumentFormat::Json;
+  bool cache_outputs = false;
 };
 
 struct ShardMappingRecordStruct {
   int32_t logical_shard;
   int32_t physical_shard;
+  ShardMappingState state = ShardMappingState::Active;
 };
 
 using RecordT =
@@ -102,6 +110,29 @@ flatbuffers::FlatBufferBuilder ToFlatBufferBuilder(
 flatbuffers::FlatBufferBuilder ToFlatBufferBuilder(
     const DataRecordStruct& data_record);
 
+// Same as `ToFlatBufferBuilder`, with `builder` cleared first, so that a
+// builder reused for many records reuses its buffer instead of allocating one
+// per record. Returns the serialized record, valid until `builder` is cleared
+// or destroyed.
+std::string_view SerializeKeyValueMutationRecord(
+    const KeyValueMutationRecordStruct& record,
+    flatbuffers::FlatBufferBuilder& builder);
+std::string_view SerializeDataRecord(const DataRecordStruct& data_record,
+                                     flatbuffers::FlatBufferBuilder& builder);
+
+// Same as above with a builder of the calling thread. The returned record is
+// valid until the next serialization on the thread.
+std::string_view SerializeKeyValueMutationRecord(
+    const KeyValueMutationRecordStruct& record);
+std::string_view SerializeDataRecord(const DataRecordStruct& data_record);
+
+// Serializes `data_records` one after the other into `buffer`, replacing its
+// contents, and sets `records` to the serialized records in `buffer`. Each
+// record starts at a multiple of 8 bytes, so that its fields stay aligned.
+void SerializeDataRecords(absl::Span<const DataRecordStruct> data_records,
+                          std::string& buffer,
+                          std::vector<std::string_view>& records);
+
 // Deserializes "data_loading.fbs:KeyValueMutationRecord" raw flatbuffer record
 // bytes and calls `record_callback` with the resulting
 // `KeyValueMutationRecordStruct` object.
@@ -112,6 +143,14 @@ absl::Status DeserializeRecord(
     const std::function<absl::Status(const KeyValueMutationRecordStruct&)>&
         record_callback);
 
+struct DeserializeOptions {
+  // Whether to run the flatbuffers verifier on the record bytes. The record
+  // fields are validated either way, but reading records that aren't well
+  // formed flatbuffers is undefined behavior, so only records of trusted,
+  // checksummed files may skip verification.
+  bool verify = true;
+};
+
 // Deserializes "data_loading.fbs:DataRecord" raw flatbuffer record
 // bytes and calls `record_callback` with the resulting `DataRecord`
 // object.
@@ -119,11 +158,13 @@ absl::Status DeserializeRecord(
 // returns the result of calling `record_callback`.
 absl::Status DeserializeDataRecord(
     std::string_view record_bytes,
-    const std::function<absl::Status(const DataRecord&)>& record_callback);
+    const std::function<absl::Status(const DataRecord&)>& record_callback,
+    DeserializeOptions options = {});
 
 // Deserializes "data_loading.fbs:DataRecord" raw flatbuffer record
 // bytes and calls `record_callback` with the resulting
-// `DataRecordStruct` object.
+// `DataRecordStruct` object. A `KeyValueMutationBatch` record results in one
+// call per entry, see `ForEachKeyValueMutation`.
 // Returns `absl::InvalidArgumentError` if deserilization fails, otherwise
 // returns the result of calling `record_callback`.
 absl::Status DeserializeDataRecord(
@@ -131,16 +172,129 @@ absl::Status DeserializeDataRecord(
     const std::function<absl::Status(const DataRecordStruct&)>&
         record_callback);
 
+// Calls `fn` with the entries of `batch` in order, as records with string
+// values that point into `batch`, until `fn` returns an error. `batch` must
+// have been validated, e.g. by `DeserializeDataRecord`.
+absl::Status ForEachKeyValueMutation(
+    const KeyValueMutationBatch& batch,
+    const std::function<absl::Status(const KeyValueMutationRecordStruct&)>&
+        fn);
+
+// Accumulates key-value mutation records with string values, copying them, to
+// serialize them as one `data_loading.fbs:KeyValueMutationBatch` record.
+class KeyValueMutationBatchBuilder {
+ public:
+  // Whether `data_record` is a key-value mutation with a string value, the
+  // only records that batches hold.
+  static bool CanBatch(const DataRecordStruct& data_record);
+
+  // `record` must have a string value.
+  void Add(const KeyValueMutationRecordStruct& record);
+  int size() const { return static_cast<int>(keys_.size()); }
+  bool empty() const { return keys_.empty(); }
+
+  // Calls `fn` with the records added since the last `Clear`, in order.
+  void ForEachRecord(
+      const std::function<void(const DataRecordStruct&)>& fn) const;
+
+  // Serializes the records added since the last `Clear` as a `DataRecord`
+  // holding a `KeyValueMutationBatch`, with `builder` cleared first. Returns
+  // the serialized record, valid until `builder` is cleared or destroyed.
+  std::string_view Serialize(flatbuffers::FlatBufferBuilder& builder) const;
+
+  // Keeps the memory of the batch for the next records.
+  void Clear();
+
+ private:
+  std::vector<int8_t> mutation_types_;
+  std::vector<int64_t> logical_commit_times_;
+  std::vector<std::string> keys_;
+  std::vector<std::string> values_;
+};
+
+// Read-only view of the values of a `StringSet` record value. The values are
+// read in place from the flatbuffer, without copying them into a vector, so
+// the view is only valid as long as the record bytes are.
+class StringSetView {
+ public:
+  using Strings =
+      flatbuffers::Vector<flatbuffers::Offset<flatbuffers::String>>;
+
+  class Iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = std::string_view;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const std::string_view*;
+    using reference = std::string_view;
+
+    Iterator() = default;
+
+    std::string_view operator*() const {
+      return strings_->Get(index_)->string_view();
+    }
+    Iterator& operator++() {
+      ++index_;
+      return *this;
+    }
+    Iterator operator++(int) {
+      Iterator iterator = *this;
+      ++index_;
+      return iterator;
+    }
+    friend bool operator==(const Iterator& lhs, const Iterator& rhs) {
+      return lhs.strings_ == rhs.strings_ && lhs.index_ == rhs.index_;
+    }
+    friend bool operator!=(const Iterator& lhs, const Iterator& rhs) {
+      return !(lhs == rhs);
+    }
+
+   private:
+    friend class StringSetView;
+    Iterator(const Strings* strings, flatbuffers::uoffset_t index)
+        : strings_(strings), index_(index) {}
+
+    const Strings* strings_ = nullptr;
+    flatbuffers::uoffset_t index_ = 0;
+  };
+
+  StringSetView() = default;
+  explicit StringSetView(const Strings* strings) : strings_(strings) {}
+
+  Iterator begin() const { return Iterator(strings_, 0); }
+  Iterator end() const { return Iterator(strings_, size()); }
+  flatbuffers::uoffset_t size() const {
+    return strings_ == nullptr ? 0 : strings_->size();
+  }
+  bool empty() const { return size() == 0; }
+  std::string_view operator[](flatbuffers::uoffset_t index) const {
+    return strings_->Get(index)->string_view();
+  }
+
+ private:
+  const Strings* strings_ = nullptr;
+};
+
 // Utility function to get the union value set on the `record`. Must
 // be called after checking the type of the union value using
 // `record.value_type()` function.
+//
+// Prefer `StringSetView` over `std::vector<std::string_view>` for set values
+// that are only iterated, so that reading them doesn't allocate. Likewise,
+// `absl::Span<const uint32_t>` reads the values of a `UInt32Set` in place.
 template <typename ValueT>
 ValueT GetRecordValue(const KeyValueMutationRecord& record);
 template <>
 std::string_view GetRecordValue(const KeyValueMutationRecord& record);
 template <>
+StringSetView GetRecordValue(const KeyValueMutationRecord& record);
+template <>
 std::vector<std::string_view> GetRecordValue(
     const KeyValueMutationRecord& record);
+template <>
+absl::Span<const uint32_t> GetRecordValue(const KeyValueMutationRecord& record);
+template <>
+std::vector<uint32_t> GetRecordValue(const KeyValueMutationRecord& record);
 
 // Utility function to get the union record set on the `data_record`. Must
 // be called after checking the type of the union record using
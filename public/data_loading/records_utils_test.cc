@@ -14,6 +14,10 @@
 
 #include "public/data_loading/records_utils.h"
 
+#include <cstdint>
+#include <string>
+#include <vector>
+
 #include "absl/hash/hash_testing.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -39,11 +43,16 @@ UserDefinedFunctionsConfigStruct GetUdfConfigStruct(
   udf_config_struct.handler_name = "my_handler";
   udf_config_struct.logical_commit_time = 1234567890;
   udf_config_struct.version = 1;
+  udf_config_struct.argument_format =
+      UserDefinedFunctionsArgumentFormat::SerializedProto;
+  udf_config_struct.cache_outputs = true;
   return udf_config_struct;
 }
 
 ShardMappingRecordStruct GetShardMappingRecordStruct() {
-  return ShardMappingRecordStruct{.logical_shard = 0, .physical_shard = 0};
+  return ShardMappingRecordStruct{.logical_shard = 0,
+                                  .physical_shard = 0,
+                                  .state = ShardMappingState::Staged};
 }
 
 DataRecordStruct GetDataRecord(RecordT record) {
@@ -71,6 +80,8 @@ TEST(KeyValueMutationRecordStructTest, VerifyRecordStructValueIsEmpty) {
   EXPECT_FALSE(IsEmptyValue(value));
   value = std::vector<std::string_view>{"test1", "test2"};
   EXPECT_FALSE(IsEmptyValue(value));
+  value = std::vector<uint32_t>{1, 2};
+  EXPECT_FALSE(IsEmptyValue(value));
 }
 
 TEST(UdfConfigStructTest, ValidateEqualsOperator) {
@@ -107,6 +118,12 @@ TEST(DataRecordStructTest, ValidateEqualsOperator) {
                                                    .physical_shard = 0}),
             GetDataRecord(ShardMappingRecordStruct{.logical_shard = 0,
                                                    .physical_shard = 1}));
+  EXPECT_NE(GetDataRecord(ShardMappingRecordStruct{.logical_shard = 0,
+                                                   .physical_shard = 0}),
+            GetDataRecord(
+                ShardMappingRecordStruct{.logical_shard = 0,
+                                         .physical_shard = 0,
+                                         .state = ShardMappingState::Staged}));
 }
 
 class RecordValueTest
@@ -129,6 +146,11 @@ void ExpectEqual(const KeyValueMutationRecordStruct& record,
                 testing::ContainerEq(
                     GetRecordValue<std::vector<std::string_view>>(fbs_record)));
   }
+  if (fbs_record.value_type() == Value::UInt32Set) {
+    EXPECT_THAT(std::get<std::vector<uint32_t>>(record.value),
+                testing::ContainerEq(
+                    GetRecordValue<std::vector<uint32_t>>(fbs_record)));
+  }
 }
 
 void ExpectEqual(const UserDefinedFunctionsConfigStruct& record,
@@ -138,12 +160,15 @@ void ExpectEqual(const UserDefinedFunctionsConfigStruct& record,
   EXPECT_EQ(record.version, fbs_record.version());
   EXPECT_EQ(record.handler_name, fbs_record.handler_name()->string_view());
   EXPECT_EQ(record.code_snippet, fbs_record.code_snippet()->string_view());
+  EXPECT_EQ(record.argument_format, fbs_record.argument_format());
+  EXPECT_EQ(record.cache_outputs, fbs_record.cache_outputs());
 }
 
 void ExpectEqual(const ShardMappingRecordStruct& record,
                  const ShardMappingRecord& fbs_record) {
   EXPECT_EQ(record.logical_shard, fbs_record.logical_shard());
   EXPECT_EQ(record.physical_shard, fbs_record.physical_shard());
+  EXPECT_EQ(record.state, fbs_record.state());
 }
 
 void ExpectEqual(const DataRecordStruct& record, const DataRecord& fbs_record) {
@@ -164,7 +189,8 @@ void ExpectEqual(const DataRecordStruct& record, const DataRecord& fbs_record) {
 INSTANTIATE_TEST_SUITE_P(RecordValueType, RecordValueTest,
                          testing::Values("value1",
                                          std::vector<std::string_view>{
-                                             "value1", "value2"}));
+                                             "value1", "value2"},
+                                         std::vector<uint32_t>{7, 42}));
 TEST_P(RecordValueTest, DeserializeRecord_ToFbsRecord_Success) {
   auto record = GetKeyValueMutationRecord(GetValue());
   testing::MockFunction<absl::Status(const KeyValueMutationRecord&)>
@@ -221,6 +247,38 @@ TEST(DataRecordTest,
   EXPECT_TRUE(status.ok()) << status;
 }
 
+TEST(DataRecordTest,
+     DeserializeDataRecord_ToFbsRecord_KVMutation_Unverified_Success) {
+  auto data_record_struct = GetDataRecord(GetKeyValueMutationRecord("value"));
+  testing::MockFunction<absl::Status(const DataRecord&)> record_callback;
+  EXPECT_CALL(record_callback, Call)
+      .WillOnce([&data_record_struct](const DataRecord& data_record_fbs) {
+        ExpectEqual(data_record_struct, data_record_fbs);
+        return absl::OkStatus();
+      });
+  auto status = DeserializeDataRecord(
+      ToStringView(ToFlatBufferBuilder(data_record_struct)),
+      record_callback.AsStdFunction(), {.verify = false});
+  EXPECT_TRUE(status.ok()) << status;
+}
+
+TEST(DataRecordTest, DeserializeDataRecord_Unverified_StillValidatesFields) {
+  flatbuffers::FlatBufferBuilder builder;
+  const auto data_record_fbs = CreateDataRecord(builder);
+  builder.Finish(data_record_fbs);
+
+  testing::MockFunction<absl::Status(const DataRecord&)> record_callback;
+  EXPECT_CALL(record_callback, Call).Times(0);
+  auto status =
+      DeserializeDataRecord(ToStringView(builder),
+                            record_callback.AsStdFunction(), {.verify = false});
+  EXPECT_FALSE(status.ok()) << status;
+  EXPECT_EQ(status.message(), "Record not set.");
+  status = DeserializeDataRecord("ab", record_callback.AsStdFunction(),
+                                 {.verify = false});
+  EXPECT_FALSE(status.ok()) << status;
+}
+
 TEST(DataRecordTest,
      DeserializeDataRecord_ToFbsRecord_KVMutation_StringVectorValue_Success) {
   std::vector<std::string_view> values({"value1", "value2"});
@@ -465,5 +523,151 @@ TEST(DataRecordTest, DeserializeDataRecord_ToStruct_ShardMapping_Success) {
   EXPECT_TRUE(status.ok()) << status;
 }
 
+TEST(DataRecordTest, SerializeDataRecord_ReusedBuilder_Success) {
+  const std::vector<DataRecordStruct> data_records = {
+      GetDataRecord(GetKeyValueMutationRecord()),
+      GetDataRecord(GetUdfConfigStruct()),
+      GetDataRecord(GetShardMappingRecordStruct()),
+  };
+  flatbuffers::FlatBufferBuilder builder;
+  for (const DataRecordStruct& data_record : data_records) {
+    const std::string_view record = SerializeDataRecord(data_record, builder);
+    EXPECT_EQ(record, ToStringView(ToFlatBufferBuilder(data_record)));
+    // Same with the builder of the thread.
+    EXPECT_EQ(SerializeDataRecord(data_record), record);
+  }
+  const KeyValueMutationRecordStruct kv_record = GetKeyValueMutationRecord();
+  EXPECT_EQ(SerializeKeyValueMutationRecord(kv_record, builder),
+            ToStringView(ToFlatBufferBuilder(kv_record)));
+  EXPECT_EQ(SerializeKeyValueMutationRecord(kv_record),
+            ToStringView(ToFlatBufferBuilder(kv_record)));
+}
+
+TEST(DataRecordTest, SerializeDataRecords_Success) {
+  const std::vector<DataRecordStruct> data_records = {
+      GetDataRecord(GetKeyValueMutationRecord()),
+      GetDataRecord(GetKeyValueMutationRecord(
+          std::vector<std::string_view>{"value1", "value2"})),
+      GetDataRecord(GetUdfConfigStruct()),
+      GetDataRecord(GetShardMappingRecordStruct()),
+  };
+  std::string buffer;
+  std::vector<std::string_view> records;
+  SerializeDataRecords(data_records, buffer, records);
+  ASSERT_EQ(records.size(), data_records.size());
+  for (int i = 0; i < static_cast<int>(records.size()); i++) {
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(records[i].data()) % 8, 0);
+    testing::MockFunction<absl::Status(const DataRecordStruct&)>
+        record_callback;
+    EXPECT_CALL(record_callback, Call)
+        .WillOnce([&data_records, i](const DataRecordStruct& actual_record) {
+          EXPECT_EQ(data_records[i], actual_record);
+          return absl::OkStatus();
+        });
+    const auto status =
+        DeserializeDataRecord(records[i], record_callback.AsStdFunction());
+    EXPECT_TRUE(status.ok()) << status;
+  }
+  // Replaces the records serialized before.
+  SerializeDataRecords(absl::MakeConstSpan(data_records).subspan(3), buffer,
+                       records);
+  ASSERT_EQ(records.size(), 1u);
+  EXPECT_EQ(records[0], ToStringView(ToFlatBufferBuilder(data_records[3])));
+}
+
+TEST(DataRecordTest, KeyValueMutationBatch_ToStruct_Success) {
+  KeyValueMutationRecordStruct deleted = GetKeyValueMutationRecord("");
+  deleted.key = "deleted";
+  deleted.mutation_type = KeyValueMutationType::Delete;
+  const std::vector<DataRecordStruct> data_records = {
+      GetDataRecord(GetKeyValueMutationRecord("value1")),
+      GetDataRecord(deleted),
+  };
+  KeyValueMutationBatchBuilder batch;
+  for (const DataRecordStruct& data_record : data_records) {
+    ASSERT_TRUE(KeyValueMutationBatchBuilder::CanBatch(data_record));
+    batch.Add(std::get<KeyValueMutationRecordStruct>(data_record.record));
+  }
+  EXPECT_EQ(batch.size(), 2);
+  flatbuffers::FlatBufferBuilder builder;
+  std::vector<DataRecordStruct> actual_records;
+  const auto status = DeserializeDataRecord(
+      batch.Serialize(builder),
+      [&actual_records](const DataRecordStruct& actual_record) {
+        actual_records.push_back(actual_record);
+        return absl::OkStatus();
+      });
+  EXPECT_TRUE(status.ok()) << status;
+  EXPECT_EQ(actual_records, data_records);
+  batch.Clear();
+  EXPECT_TRUE(batch.empty());
+}
+
+TEST(DataRecordTest, KeyValueMutationBatch_OnlyHoldsStringValues) {
+  EXPECT_FALSE(KeyValueMutationBatchBuilder::CanBatch(GetDataRecord(
+      GetKeyValueMutationRecord(std::vector<std::string_view>{"value1"}))));
+  EXPECT_FALSE(KeyValueMutationBatchBuilder::CanBatch(
+      GetDataRecord(GetUdfConfigStruct())));
+}
+
+TEST(DataRecordTest, KeyValueMutationBatch_VectorsNotSet_Failure) {
+  flatbuffers::FlatBufferBuilder builder;
+  const auto batch = CreateKeyValueMutationBatchDirect(
+      builder, /*mutation_types=*/nullptr, /*logical_commit_times=*/nullptr,
+      /*keys=*/nullptr, /*values=*/nullptr);
+  builder.Finish(
+      CreateDataRecord(builder, Record::KeyValueMutationBatch, batch.Union()));
+  testing::MockFunction<absl::Status(const DataRecordStruct&)> record_callback;
+  EXPECT_CALL(record_callback, Call).Times(0);
+  EXPECT_FALSE(DeserializeDataRecord(ToStringView(builder),
+                                     record_callback.AsStdFunction())
+                   .ok());
+}
+
+TEST(RecordValueTest, StringSetViewReadsValuesInPlace) {
+  std::vector<std::string_view> values{"value1", "value2", "value3"};
+  auto builder = ToFlatBufferBuilder(
+      GetDataRecord(GetKeyValueMutationRecord(values)));
+  testing::MockFunction<absl::Status(const DataRecord&)> record_callback;
+  EXPECT_CALL(record_callback, Call)
+      .WillOnce([&values](const DataRecord& data_record) {
+        const auto* record = data_record.record_as_KeyValueMutationRecord();
+        const auto view = GetRecordValue<StringSetView>(*record);
+        EXPECT_EQ(view.size(), values.size());
+        EXPECT_FALSE(view.empty());
+        EXPECT_EQ(view[1], "value2");
+        EXPECT_THAT(std::vector<std::string_view>(view.begin(), view.end()),
+                    testing::ElementsAreArray(values));
+        return absl::OkStatus();
+      });
+  auto status = DeserializeDataRecord(ToStringView(builder),
+                                      record_callback.AsStdFunction());
+  EXPECT_TRUE(status.ok()) << status;
+}
+
+TEST(RecordValueTest, UInt32SetValuesAreReadInPlace) {
+  std::vector<uint32_t> values{3, 1, 4294967295};
+  auto builder = ToFlatBufferBuilder(
+      GetDataRecord(GetKeyValueMutationRecord(values)));
+  testing::MockFunction<absl::Status(const DataRecord&)> record_callback;
+  EXPECT_CALL(record_callback, Call)
+      .WillOnce([&values](const DataRecord& data_record) {
+        const auto* record = data_record.record_as_KeyValueMutationRecord();
+        EXPECT_EQ(record->value_type(), Value::UInt32Set);
+        EXPECT_THAT(GetRecordValue<absl::Span<const uint32_t>>(*record),
+                    testing::ElementsAreArray(values));
+        return absl::OkStatus();
+      });
+  auto status = DeserializeDataRecord(ToStringView(builder),
+                                      record_callback.AsStdFunction());
+  EXPECT_TRUE(status.ok()) << status;
+}
+
+TEST(RecordValueTest, StringSetViewOfEmptySet) {
+  const StringSetView view;
+  EXPECT_TRUE(view.empty());
+  EXPECT_EQ(view.begin(), view.end());
+}
+
 }  // namespace
 }  // namespace kv_server
@@ -56,6 +56,8 @@ class AvroDeltaRecordStreamWriter : public DeltaRecordWriter {
 
   Options options_;
   std::unique_ptr<avro::DataFileWriter<std::string>> record_writer_;
+  // Reused to serialize the records.
+  flatbuffers::FlatBufferBuilder builder_;
 };
 
 AvroDeltaRecordStreamWriter::AvroDeltaRecordStreamWriter(
@@ -75,9 +77,8 @@ AvroDeltaRecordStreamWriter::Create(DestStreamT& dest_stream, Options options) {
 
 absl::Status AvroDeltaRecordStreamWriter::WriteRecord(
     const DataRecordStruct& data_record) {
-  auto fbs_builder = ToFlatBufferBuilder(data_record);
-  std::string_view bytes_to_write = ToStringView(fbs_builder);
-  record_writer_->write(std::string(bytes_to_write));
+  record_writer_->write(
+      std::string(SerializeDataRecord(data_record, builder_)));
   return absl::OkStatus();
 }
 
@@ -0,0 +1,188 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "public/data_loading/writers/concurrent_sharded_record_buffer.h"
+
+#include <utility>
+#include <variant>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_format.h"
+
+namespace kv_server {
+
+ConcurrentShardedRecordBuffer::ConcurrentShardedRecordBuffer(
+    std::unique_ptr<ShardedRecordBuffer> buffer, ShardingFunction sharding_func,
+    const Options& options)
+    : buffer_(std::move(buffer)),
+      sharding_func_(std::move(sharding_func)),
+      writers_(options.num_writer_threads) {
+  shards_.reserve(buffer_->num_shards());
+  for (int shard_id = 0; shard_id < buffer_->num_shards(); shard_id++) {
+    shards_.push_back(absl::WrapUnique(
+        new Shard{.max_queued_bytes = options.max_queued_bytes_per_shard}));
+  }
+}
+
+absl::StatusOr<std::unique_ptr<ConcurrentShardedRecordBuffer>>
+ConcurrentShardedRecordBuffer::Create(int num_shards,
+                                      ShardingFunction sharding_func,
+                                      Options options) {
+  if (options.num_writer_threads <= 0) {
+    return absl::InvalidArgumentError(
+        absl::StrFormat("Number of writer threads: %d must be greater than 0",
+                        options.num_writer_threads));
+  }
+  auto buffer = ShardedRecordBuffer::Create(num_shards, sharding_func);
+  if (!buffer.ok()) {
+    return buffer.status();
+  }
+  return absl::WrapUnique(new ConcurrentShardedRecordBuffer(
+      *std::move(buffer), std::move(sharding_func), options));
+}
+
+absl::Status ConcurrentShardedRecordBuffer::AddRecord(
+    const DataRecordStruct& data_record) {
+  const auto* kv_record =
+      std::get_if<KeyValueMutationRecordStruct>(&data_record.record);
+  if (kv_record == nullptr) {
+    return absl::OkStatus();
+  }
+  const int shard_id =
+      sharding_func_.GetShardNumForKey(kv_record->key, shards_.size());
+  std::string record_bytes(SerializeDataRecord(data_record));
+  Shard& shard = *shards_[shard_id];
+  absl::MutexLock lock(&shard.mutex);
+  if (!shard.HasRoomOrFailed()) {
+    shard.stats.num_full_queue_waits++;
+    shard.mutex.Await(absl::Condition(&shard, &Shard::HasRoomOrFailed));
+  }
+  if (!shard.status.ok()) {
+    return shard.status;
+  }
+  shard.queued_bytes += record_bytes.size();
+  shard.queued.push_back(std::move(record_bytes));
+  if (!shard.draining) {
+    shard.draining = true;
+    writers_.Schedule([this, shard_id] { Drain(shard_id); });
+  }
+  return absl::OkStatus();
+}
+
+void ConcurrentShardedRecordBuffer::Drain(int shard_id) {
+  Shard& shard = *shards_[shard_id];
+  std::vector<std::string> records;
+  while (true) {
+    {
+      absl::MutexLock lock(&shard.mutex);
+      if (shard.queued.empty()) {
+        shard.draining = false;
+        return;
+      }
+      // Frees the queue for the threads adding records while the records
+      // are written.
+      records.swap(shard.queued);
+      shard.queued_bytes = 0;
+    }
+    absl::Status status;
+    int64_t num_records = 0;
+    int64_t num_bytes = 0;
+    for (const std::string& record : records) {
+      status = buffer_->AddSerializedRecord(shard_id, record);
+      if (!status.ok()) {
+        break;
+      }
+      num_records++;
+      num_bytes += record.size();
+    }
+    records.clear();
+    absl::MutexLock lock(&shard.mutex);
+    shard.stats.num_records += num_records;
+    shard.stats.num_bytes += num_bytes;
+    if (!status.ok()) {
+      shard.status = std::move(status);
+      shard.queued.clear();
+      shard.queued_bytes = 0;
+      shard.draining = false;
+      return;
+    }
+  }
+}
+
+absl::Status ConcurrentShardedRecordBuffer::WaitForShard(int shard_id) {
+  Shard& shard = *shards_[shard_id];
+  absl::MutexLock lock(&shard.mutex);
+  shard.mutex.Await(absl::Condition(&shard, &Shard::IsDrained));
+  return shard.status;
+}
+
+absl::Status ConcurrentShardedRecordBuffer::Flush(int shard_id) {
+  if (shard_id >= 0) {
+    if (shard_id >= static_cast<int>(shards_.size())) {
+      // Fails with the same error as `ShardedRecordBuffer`.
+      return buffer_->Flush(shard_id);
+    }
+    if (auto status = WaitForShard(shard_id); !status.ok()) {
+      return status;
+    }
+    return buffer_->Flush(shard_id);
+  }
+  // Waits for all writers before flushing, so that no flush holds a writer
+  // thread while waiting for another writer to run.
+  for (int id = 0; id < static_cast<int>(shards_.size()); id++) {
+    if (auto status = WaitForShard(id); !status.ok()) {
+      return status;
+    }
+  }
+  std::vector<TaskFuture<absl::Status>> flushes;
+  flushes.reserve(shards_.size());
+  for (int id = 0; id < static_cast<int>(shards_.size()); id++) {
+    flushes.push_back(
+        writers_.Async([this, id] { return buffer_->Flush(id); }));
+  }
+  absl::Status status;
+  for (auto& flush : flushes) {
+    status.Update(flush.Get());
+  }
+  return status;
+}
+
+absl::StatusOr<std::istream*>
+ConcurrentShardedRecordBuffer::GetShardRecordStream(int shard_id) {
+  return buffer_->GetShardRecordStream(shard_id);
+}
+
+absl::Status ConcurrentShardedRecordBuffer::WriteShardIndexedRecordStream(
+    std::ostream& dest_stream, const DeltaRecordWriter::Options& options) {
+  if (auto status = Flush(); !status.ok()) {
+    return status;
+  }
+  return buffer_->WriteShardIndexedRecordStream(dest_stream, options);
+}
+
+absl::StatusOr<ConcurrentShardedRecordBuffer::ShardStats>
+ConcurrentShardedRecordBuffer::GetShardStats(int shard_id) {
+  if (shard_id < 0 || shard_id >= static_cast<int>(shards_.size())) {
+    return absl::InvalidArgumentError(
+        absl::StrFormat("Shard id: %d is out of range: [%d, %d)", shard_id, 0,
+                        shards_.size()));
+  }
+  Shard& shard = *shards_[shard_id];
+  absl::MutexLock lock(&shard.mutex);
+  return shard.stats;
+}
+
+}  // namespace kv_server
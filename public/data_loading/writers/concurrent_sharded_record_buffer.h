@@ -0,0 +1,119 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PUBLIC_DATA_LOADING_WRITERS_CONCURRENT_SHARDED_RECORD_BUFFER_H_
+#define PUBLIC_DATA_LOADING_WRITERS_CONCURRENT_SHARDED_RECORD_BUFFER_H_
+
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
+#include "components/util/thread_pool.h"
+#include "public/data_loading/records_utils.h"
+#include "public/data_loading/writers/delta_record_writer.h"
+#include "public/data_loading/writers/sharded_record_buffer.h"
+#include "public/sharding/sharding_function.h"
+
+namespace kv_server {
+
+// A `ShardedRecordBuffer` that records can be added to by many threads.
+//
+// Records are serialized by the threads that add them, and queued per shard.
+// Writer threads drain the queues into the Riegeli streams of the shards in
+// parallel, one writer at a time per shard, so that the records of a shard
+// added by a thread stay in the order they were added.
+class ConcurrentShardedRecordBuffer {
+ public:
+  struct Options {
+    int num_writer_threads = 4;
+    // Threads adding records to a shard wait while this many bytes of its
+    // records are queued.
+    int64_t max_queued_bytes_per_shard = 16 * 1024 * 1024;
+  };
+
+  struct ShardStats {
+    // Records written to the stream of the shard.
+    int64_t num_records = 0;
+    int64_t num_bytes = 0;
+    // Times that a thread adding a record waited for the queue of the shard.
+    int64_t num_full_queue_waits = 0;
+  };
+
+  // Waits for the queued records.
+  ~ConcurrentShardedRecordBuffer() = default;
+  ConcurrentShardedRecordBuffer(const ConcurrentShardedRecordBuffer&) = delete;
+  ConcurrentShardedRecordBuffer& operator=(
+      const ConcurrentShardedRecordBuffer&) = delete;
+
+  static absl::StatusOr<std::unique_ptr<ConcurrentShardedRecordBuffer>> Create(
+      int num_shards, ShardingFunction sharding_func, Options options);
+
+  // Thread-safe. Fails once writing a record of the same shard failed.
+  absl::Status AddRecord(const DataRecordStruct& record);
+  // Waits for the queued records of `shard_id`, or of all shards if -1, and
+  // flushes them so that they are visible for reading via
+  // `GetShardRecordStream()`. Shards are flushed in parallel.
+  absl::Status Flush(int shard_id = -1);
+  absl::StatusOr<std::istream*> GetShardRecordStream(int shard_id);
+  // Same as `ShardedRecordBuffer::WriteShardIndexedRecordStream`, after
+  // waiting for the queued records.
+  absl::Status WriteShardIndexedRecordStream(
+      std::ostream& dest_stream, const DeltaRecordWriter::Options& options);
+  absl::StatusOr<ShardStats> GetShardStats(int shard_id);
+
+ private:
+  struct Shard {
+    bool HasRoomOrFailed() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex) {
+      return queued_bytes < max_queued_bytes || !status.ok();
+    }
+    bool IsDrained() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex) {
+      return !draining;
+    }
+
+    const int64_t max_queued_bytes;
+    absl::Mutex mutex;
+    std::vector<std::string> queued ABSL_GUARDED_BY(mutex);
+    int64_t queued_bytes ABSL_GUARDED_BY(mutex) = 0;
+    // Whether a writer drains the queue, true until it's empty.
+    bool draining ABSL_GUARDED_BY(mutex) = false;
+    absl::Status status ABSL_GUARDED_BY(mutex);
+    ShardStats stats ABSL_GUARDED_BY(mutex);
+  };
+
+  ConcurrentShardedRecordBuffer(std::unique_ptr<ShardedRecordBuffer> buffer,
+                                ShardingFunction sharding_func,
+                                const Options& options);
+  // Writes the queued records of `shard_id` until there are none.
+  void Drain(int shard_id);
+  // Waits for the writer of `shard_id`, returns its status.
+  absl::Status WaitForShard(int shard_id);
+
+  const std::unique_ptr<ShardedRecordBuffer> buffer_;
+  const ShardingFunction sharding_func_;
+  std::vector<std::unique_ptr<Shard>> shards_;
+  // Destroyed first, its destructor runs the writers left.
+  ThreadPool writers_;
+};
+
+}  // namespace kv_server
+
+#endif  // PUBLIC_DATA_LOADING_WRITERS_CONCURRENT_SHARDED_RECORD_BUFFER_H_
@@ -0,0 +1,142 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "public/data_loading/writers/concurrent_sharded_record_buffer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "gtest/gtest.h"
+#include "public/data_loading/readers/delta_record_stream_reader.h"
+
+namespace kv_server {
+namespace {
+
+constexpr int kNumShards = 16;
+constexpr int kNumThreads = 8;
+constexpr int kNumRecordsPerThread = 500;
+
+DataRecordStruct GetDataRecord(std::string_view key) {
+  DataRecordStruct data_record;
+  data_record.record = KeyValueMutationRecordStruct{
+      .mutation_type = KeyValueMutationType::Update,
+      .logical_commit_time = 1234567890,
+      .key = key,
+      .value = "value",
+  };
+  return data_record;
+}
+
+// Returns the keys of the records of `record_stream`, in order.
+std::vector<std::string> ReadKeys(std::istream& record_stream) {
+  std::vector<std::string> keys;
+  DeltaRecordStreamReader record_reader(record_stream);
+  const absl::Status status =
+      record_reader.ReadRecords([&keys](const DataRecord& data_record) {
+        keys.push_back(
+            data_record.record_as_KeyValueMutationRecord()->key()->str());
+        return absl::OkStatus();
+      });
+  EXPECT_TRUE(status.ok()) << status;
+  return keys;
+}
+
+TEST(ConcurrentShardedRecordBufferTest, CreateFailsWithoutWriterThreads) {
+  auto buffer = ConcurrentShardedRecordBuffer::Create(
+      kNumShards, ShardingFunction(/*seed=*/""), {.num_writer_threads = 0});
+  EXPECT_EQ(buffer.status().code(), absl::StatusCode::kInvalidArgument);
+  buffer = ConcurrentShardedRecordBuffer::Create(
+      /*num_shards=*/0, ShardingFunction(/*seed=*/""), {});
+  EXPECT_EQ(buffer.status().code(), absl::StatusCode::kInvalidArgument);
+}
+
+TEST(ConcurrentShardedRecordBufferTest, AddsRecordsOfManyThreads) {
+  const ShardingFunction sharding_func(/*seed=*/"");
+  // Small queues, so that threads wait for the writers.
+  auto buffer = ConcurrentShardedRecordBuffer::Create(
+      kNumShards, sharding_func,
+      {.num_writer_threads = 3, .max_queued_bytes_per_shard = 1024});
+  ASSERT_TRUE(buffer.ok()) << buffer.status();
+  std::vector<std::thread> threads;
+  for (int thread = 0; thread < kNumThreads; thread++) {
+    threads.emplace_back([&buffer, thread] {
+      for (int i = 0; i < kNumRecordsPerThread; i++) {
+        const std::string key = absl::StrCat(thread, "-", i);
+        const absl::Status status = (*buffer)->AddRecord(GetDataRecord(key));
+        ASSERT_TRUE(status.ok()) << status;
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  const absl::Status status = (*buffer)->Flush();
+  ASSERT_TRUE(status.ok()) << status;
+
+  int64_t num_records = 0;
+  for (int shard_id = 0; shard_id < kNumShards; shard_id++) {
+    auto shard_stream = (*buffer)->GetShardRecordStream(shard_id);
+    ASSERT_TRUE(shard_stream.ok()) << shard_stream.status();
+    const std::vector<std::string> keys = ReadKeys(**shard_stream);
+    // The records of each thread are in the order they were added.
+    std::vector<int> last_index(kNumThreads, -1);
+    for (const std::string& key : keys) {
+      EXPECT_EQ(sharding_func.GetShardNumForKey(key, kNumShards), shard_id);
+      int thread;
+      int index;
+      ASSERT_EQ(std::sscanf(key.c_str(), "%d-%d", &thread, &index), 2);
+      EXPECT_GT(index, last_index[thread]);
+      last_index[thread] = index;
+    }
+    auto stats = (*buffer)->GetShardStats(shard_id);
+    ASSERT_TRUE(stats.ok()) << stats.status();
+    EXPECT_EQ(stats->num_records, static_cast<int64_t>(keys.size()));
+    num_records += keys.size();
+  }
+  EXPECT_EQ(num_records, kNumThreads * kNumRecordsPerThread);
+  EXPECT_FALSE((*buffer)->GetShardStats(kNumShards).ok());
+}
+
+TEST(ConcurrentShardedRecordBufferTest, WritesShardIndexedRecordStream) {
+  auto buffer = ConcurrentShardedRecordBuffer::Create(
+      kNumShards, ShardingFunction(/*seed=*/""), {.num_writer_threads = 2});
+  ASSERT_TRUE(buffer.ok()) << buffer.status();
+  std::vector<std::string> keys;
+  for (int i = 0; i < 100; i++) {
+    keys.push_back(absl::StrCat("key", i));
+    const absl::Status status = (*buffer)->AddRecord(GetDataRecord(keys[i]));
+    ASSERT_TRUE(status.ok()) << status;
+  }
+  DeltaRecordWriter::Options options{.enable_compression = false};
+  options.metadata.mutable_delta();
+  std::stringstream indexed_stream;
+  const absl::Status status =
+      (*buffer)->WriteShardIndexedRecordStream(indexed_stream, options);
+  ASSERT_TRUE(status.ok()) << status;
+  std::vector<std::string> written_keys = ReadKeys(indexed_stream);
+  std::sort(written_keys.begin(), written_keys.end());
+  std::sort(keys.begin(), keys.end());
+  EXPECT_EQ(written_keys, keys);
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -14,22 +14,13 @@
 
 #include "public/data_loading/writers/delta_record_limiting_file_writer.h"
 
+#include <variant>
+
 #include "absl/log/log.h"
+#include "public/data_loading/writers/record_writer_options.h"
 
 namespace kv_server {
 
-riegeli::RecordWriterBase::Options GetRecordWriterOptions(
-    const DeltaRecordWriter::Options& options) {
-  riegeli::RecordWriterBase::Options writer_options;
-  if (!options.enable_compression) {
-    writer_options.set_uncompressed();
-  }
-  riegeli::RecordsMetadata metadata;
-  *metadata.MutableExtension(kv_server::kv_file_metadata) = options.metadata;
-  writer_options.set_metadata(std::move(metadata));
-  return writer_options;
-}
-
 riegeli::LimitingWriterBase::Options GetLimitingWriterOptions(
     int max_file_size_bytes) {
   riegeli::LimitingWriterBase::Options limiting_options;
@@ -50,11 +41,15 @@ DeltaRecordLimitingFileWriter::DeltaRecordLimitingFileWriter(
                       &(*file_writer_),
                       GetLimitingWriterOptions(max_file_size_bytes)),
                   GetRecordWriterOptions(options_)))),
-      file_writer_pos_(file_writer_->pos()) {}
+      file_writer_pos_(file_writer_->pos()),
+      compactor_(options_.compaction_window_records) {}
 
 absl::StatusOr<std::unique_ptr<DeltaRecordLimitingFileWriter>>
 DeltaRecordLimitingFileWriter::Create(std::string file_name, Options options,
                                       int64_t max_file_size_bytes) {
+  if (auto status = ValidateRecordWriterOptions(options); !status.ok()) {
+    return status;
+  }
   return absl::WrapUnique(new DeltaRecordLimitingFileWriter(
       file_name, options, max_file_size_bytes));
 }
@@ -78,9 +73,34 @@ absl::Status DeltaRecordLimitingFileWriter::ProcessWritingFailure() {
 
 absl::Status DeltaRecordLimitingFileWriter::WriteRecord(
     const DataRecordStruct& data_record) {
+  if (options_.compaction_window_records > 0) {
+    if (KeyValueMutationCompactor::CanCompact(data_record)) {
+      compactor_.Add(
+          std::get<KeyValueMutationRecordStruct>(data_record.record));
+      return compactor_.full() ? WriteCompactedRecords()
+                               : record_writer_->status();
+    }
+    // Keeps the records in the order they were written.
+    if (absl::Status status = WriteCompactedRecords(); !status.ok()) {
+      return status;
+    }
+  }
+  return WriteSerializedRecord(SerializeDataRecord(data_record, builder_));
+}
+
+absl::Status DeltaRecordLimitingFileWriter::WriteCompactedRecords() {
+  if (compactor_.empty()) {
+    return record_writer_->status();
+  }
+  return compactor_.Drain([this](const DataRecordStruct& data_record) {
+    return WriteSerializedRecord(SerializeDataRecord(data_record, builder_));
+  });
+}
+
+absl::Status DeltaRecordLimitingFileWriter::WriteSerializedRecord(
+    std::string_view record) {
   file_writer_pos_ = file_writer_->pos();
-  if (!record_writer_->WriteRecord(
-          ToStringView(ToFlatBufferBuilder(data_record)))) {
+  if (!record_writer_->WriteRecord(record)) {
     return ProcessWritingFailure();
   }
 
@@ -88,6 +108,9 @@ absl::Status DeltaRecordLimitingFileWriter::WriteRecord(
 }
 
 absl::Status DeltaRecordLimitingFileWriter::Flush() {
+  if (absl::Status status = WriteCompactedRecords(); !status.ok()) {
+    return status;
+  }
   if (!record_writer_->Flush()) {
     return ProcessWritingFailure();
   }
@@ -95,6 +118,18 @@ absl::Status DeltaRecordLimitingFileWriter::Flush() {
 }
 
 void DeltaRecordLimitingFileWriter::Close() {
+  if (record_writer_->is_open()) {
+    if (absl::Status status = WriteCompactedRecords(); !status.ok()) {
+      // The file was closed if it is full.
+      LOG(ERROR) << "Failed to write the compacted records: " << status;
+    }
+    if (compactor_.stats().num_input_records > 0) {
+      LOG(INFO) << "Compacted " << compactor_.stats().num_input_records
+                << " key-value records into "
+                << compactor_.stats().num_output_records
+                << ", dedup ratio: " << compactor_.stats().dedup_ratio();
+    }
+  }
   if (!record_writer_->Close()) {
     if (!absl::IsResourceExhausted(record_writer_->status())) {
       // still attempting to close the file writer.
@@ -20,10 +20,12 @@
 #include <limits>
 #include <memory>
 #include <string>
+#include <string_view>
 
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "public/data_loading/writers/delta_record_writer.h"
+#include "public/data_loading/writers/key_value_mutation_compactor.h"
 #include "riegeli/bytes/fd_dependency.h"
 #include "riegeli/bytes/fd_writer.h"
 #include "riegeli/bytes/limiting_writer.h"
@@ -55,6 +57,9 @@ class DeltaRecordLimitingFileWriter : public DeltaRecordWriter {
   // `DeltaRecordLimitingFileWriter` writing to a new file. Note that multiple
   // records might be dropped, and not just the latest one.
   absl::Status WriteRecord(const DataRecordStruct& data_record) override;
+  // Same as `WriteRecord`, for a record already serialized with
+  // `SerializeDataRecord`.
+  absl::Status WriteSerializedRecord(std::string_view record);
   const Options& GetOptions() const override;
   // If ResourceExhaustedStatus is returned, it means that the underlying file
   // has reached it's hard size limit. Please create a new
@@ -64,6 +69,10 @@ class DeltaRecordLimitingFileWriter : public DeltaRecordWriter {
   void Close() override;
   bool IsOpen() override;
   absl::Status Status() override;
+  // The records compacted so far, if compaction is enabled.
+  const KeyValueMutationCompactor::Stats& compaction_stats() const {
+    return compactor_.stats();
+  }
 
  private:
   DeltaRecordLimitingFileWriter(
@@ -71,11 +80,17 @@ class DeltaRecordLimitingFileWriter : public DeltaRecordWriter {
       int64_t max_file_size_bytes = std::numeric_limits<int64_t>::max());
   Options options_;
   absl::Status ProcessWritingFailure();
+  // Writes the compacted records of the window, if any.
+  absl::Status WriteCompactedRecords();
   std::unique_ptr<riegeli::FdWriter<riegeli::OwnedFd>> file_writer_;
   std::unique_ptr<riegeli::RecordWriter<
       riegeli::LimitingWriter<riegeli::FdWriter<riegeli::OwnedFd>*>>>
       record_writer_;
   int file_writer_pos_;
+  // Reused to serialize the records.
+  flatbuffers::FlatBufferBuilder builder_;
+  // Key-value mutations not compacted yet, if compaction is enabled.
+  KeyValueMutationCompactor compactor_;
 };
 }  // namespace kv_server
 
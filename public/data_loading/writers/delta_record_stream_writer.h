@@ -19,6 +19,7 @@
 
 #include <memory>
 #include <utility>
+#include <variant>
 #include <vector>
 
 #include "absl/log/log.h"
@@ -26,6 +27,8 @@
 #include "absl/status/statusor.h"
 #include "public/data_loading/records_utils.h"
 #include "public/data_loading/writers/delta_record_writer.h"
+#include "public/data_loading/writers/key_value_mutation_compactor.h"
+#include "public/data_loading/writers/record_writer_options.h"
 #include "riegeli/bytes/ostream_writer.h"
 #include "riegeli/records/record_writer.h"
 
@@ -44,21 +47,34 @@ class DeltaRecordStreamWriter : public DeltaRecordWriter {
   absl::Status WriteRecord(const DataRecordStruct& data_record) override;
   const Options& GetOptions() const override { return options_; }
   absl::Status Flush() override;
-  void Close() override { record_writer_->Close(); }
+  void Close() override;
   bool IsOpen() override { return record_writer_->is_open(); }
   absl::Status Status() override { return record_writer_->status(); }
+  // The records compacted so far, if compaction is enabled.
+  const KeyValueMutationCompactor::Stats& compaction_stats() const {
+    return compactor_.stats();
+  }
 
  private:
   DeltaRecordStreamWriter(DestStreamT& dest_stream, Options options);
 
+  // Writes the compacted records of the window, if any.
+  absl::Status WriteCompactedRecords();
+  absl::Status WriteUncompactedRecord(const DataRecordStruct& data_record);
+  // Writes the pending batch of key-value mutations, if any.
+  void WriteBatch();
+
   Options options_;
   std::unique_ptr<riegeli::RecordWriter<riegeli::OStreamWriter<DestStreamT*>>>
       record_writer_;
+  // Reused to serialize the records.
+  flatbuffers::FlatBufferBuilder builder_;
+  // Key-value mutations not written yet, if batching is enabled.
+  KeyValueMutationBatchBuilder batch_;
+  // Key-value mutations not compacted yet, if compaction is enabled.
+  KeyValueMutationCompactor compactor_;
 };
 
-riegeli::RecordWriterBase::Options GetRecordWriterOptions(
-    const DeltaRecordWriter::Options& options);
-
 template <typename DestStreamT>
 DeltaRecordStreamWriter<DestStreamT>::DeltaRecordStreamWriter(
     DestStreamT& dest_stream, Options options)
@@ -67,20 +83,62 @@ DeltaRecordStreamWriter<DestStreamT>::DeltaRecordStreamWriter(
           std::make_unique<
               riegeli::RecordWriter<riegeli::OStreamWriter<DestStreamT*>>>(
               riegeli::OStreamWriter(&dest_stream),
-              GetRecordWriterOptions(options_))) {}
+              GetRecordWriterOptions(options_))),
+      compactor_(options_.compaction_window_records) {}
 
 template <typename DestStreamT>
 absl::StatusOr<std::unique_ptr<DeltaRecordStreamWriter<DestStreamT>>>
 DeltaRecordStreamWriter<DestStreamT>::Create(DestStreamT& dest_stream,
                                              Options options) {
+  if (auto status = ValidateRecordWriterOptions(options); !status.ok()) {
+    return status;
+  }
   return absl::WrapUnique(new DeltaRecordStreamWriter(dest_stream, options));
 }
 
 template <typename DestStreamT>
 absl::Status DeltaRecordStreamWriter<DestStreamT>::WriteRecord(
     const DataRecordStruct& data_record) {
+  if (options_.compaction_window_records > 0) {
+    if (KeyValueMutationCompactor::CanCompact(data_record)) {
+      compactor_.Add(
+          std::get<KeyValueMutationRecordStruct>(data_record.record));
+      return compactor_.full() ? WriteCompactedRecords()
+                               : record_writer_->status();
+    }
+    // Keeps the records in the order they were written.
+    if (absl::Status status = WriteCompactedRecords(); !status.ok()) {
+      return status;
+    }
+  }
+  return WriteUncompactedRecord(data_record);
+}
+
+template <typename DestStreamT>
+absl::Status DeltaRecordStreamWriter<DestStreamT>::WriteCompactedRecords() {
+  if (compactor_.empty()) {
+    return record_writer_->status();
+  }
+  return compactor_.Drain([this](const DataRecordStruct& data_record) {
+    return WriteUncompactedRecord(data_record);
+  });
+}
+
+template <typename DestStreamT>
+absl::Status DeltaRecordStreamWriter<DestStreamT>::WriteUncompactedRecord(
+    const DataRecordStruct& data_record) {
+  if (options_.key_value_batch_size > 1 &&
+      KeyValueMutationBatchBuilder::CanBatch(data_record)) {
+    batch_.Add(std::get<KeyValueMutationRecordStruct>(data_record.record));
+    if (batch_.size() >= options_.key_value_batch_size) {
+      WriteBatch();
+    }
+    return record_writer_->status();
+  }
+  // Keeps the records in the order they were written.
+  WriteBatch();
   if (!record_writer_->WriteRecord(
-          ToStringView(ToFlatBufferBuilder(data_record))) &&
+          SerializeDataRecord(data_record, builder_)) &&
       options_.recovery_function) {
     options_.recovery_function(data_record);
   }
@@ -89,12 +147,45 @@ absl::Status DeltaRecordStreamWriter<DestStreamT>::WriteRecord(
 
 template <typename DestStreamT>
 absl::Status DeltaRecordStreamWriter<DestStreamT>::Flush() {
+  if (absl::Status status = WriteCompactedRecords(); !status.ok()) {
+    return status;
+  }
+  WriteBatch();
   if (!record_writer_->Flush()) {
     return record_writer_->status();
   }
   return absl::OkStatus();
 }
 
+template <typename DestStreamT>
+void DeltaRecordStreamWriter<DestStreamT>::Close() {
+  if (record_writer_->is_open()) {
+    if (absl::Status status = WriteCompactedRecords(); !status.ok()) {
+      LOG(ERROR) << "Failed to write the compacted records: " << status;
+    }
+    WriteBatch();
+    if (compactor_.stats().num_input_records > 0) {
+      LOG(INFO) << "Compacted " << compactor_.stats().num_input_records
+                << " key-value records into "
+                << compactor_.stats().num_output_records
+                << ", dedup ratio: " << compactor_.stats().dedup_ratio();
+    }
+  }
+  record_writer_->Close();
+}
+
+template <typename DestStreamT>
+void DeltaRecordStreamWriter<DestStreamT>::WriteBatch() {
+  if (batch_.empty()) {
+    return;
+  }
+  if (!record_writer_->WriteRecord(batch_.Serialize(builder_)) &&
+      options_.recovery_function) {
+    batch_.ForEachRecord(options_.recovery_function);
+  }
+  batch_.Clear();
+}
+
 }  // namespace kv_server
 
 #endif  // PUBLIC_DATA_LOADING_WRITERS_DELTA_RECORD_STREAM_WRITER_H_
@@ -18,6 +18,8 @@
 
 #include <memory>
 #include <sstream>
+#include <string_view>
+#include <vector>
 
 #include "gtest/gtest.h"
 #include "public/data_loading/data_loading_generated.h"
@@ -84,7 +86,50 @@ INSTANTIATE_TEST_SUITE_P(
     testing::Values(DeltaRecordWriter::Options{.enable_compression = false,
                                                .metadata = GetMetadata()},
                     DeltaRecordWriter::Options{.enable_compression = true,
-                                               .metadata = GetMetadata()}));
+                                               .metadata = GetMetadata()},
+                    DeltaRecordWriter::Options{
+                        .enable_compression = true,
+                        .metadata = GetMetadata(),
+                        .chunk_options = {
+                            .compression =
+                                DeltaRecordWriter::Compression::kZstd,
+                            .compression_level = 5,
+                            .chunk_size = 4096,
+                            .transpose = true,
+                        }}));
+
+TEST(DeltaRecordStreamWriterOptionsTest, RecordsChunkOptionsInMetadata) {
+  kv_server::InitMetricsContextMap();
+  std::stringstream string_stream;
+  auto record_writer = DeltaRecordStreamWriter<std::stringstream>::Create(
+      string_stream,
+      DeltaRecordWriter::Options{
+          .enable_compression = true,
+          .metadata = GetMetadata(),
+          .chunk_options = {.compression =
+                                DeltaRecordWriter::Compression::kSnappy,
+                            .transpose = true}});
+  ASSERT_TRUE(record_writer.ok()) << record_writer.status();
+  EXPECT_TRUE(
+      (*record_writer)->WriteRecord(GetDataRecord(GetKeyValueMutationRecord()))
+          .ok());
+  (*record_writer)->Close();
+  auto stream_reader =
+      RiegeliStreamRecordReaderFactory().CreateReader(string_stream);
+  absl::StatusOr<KVFileMetadata> metadata = stream_reader->GetKVFileMetadata();
+  ASSERT_TRUE(metadata.ok()) << metadata.status();
+  EXPECT_EQ(metadata->record_writer_options(), "snappy,transpose");
+}
+
+TEST(DeltaRecordStreamWriterOptionsTest, RejectsInvalidChunkOptions) {
+  std::stringstream string_stream;
+  auto record_writer = DeltaRecordStreamWriter<std::stringstream>::Create(
+      string_stream, DeltaRecordWriter::Options{
+                         .enable_compression = true,
+                         .metadata = GetMetadata(),
+                         .chunk_options = {.compression_level = 100}});
+  EXPECT_FALSE(record_writer.ok());
+}
 
 TEST_P(DeltaRecordStreamWriterTest,
        ValidateWritingAndReadingWithKVMutationDeltaStream) {
@@ -197,5 +242,106 @@ TEST(DeltaRecordStreamWriterTest, ValidateWritingFailsAfterClose) {
   EXPECT_FALSE(status.ok());
 }
 
+
+TEST(DeltaRecordStreamWriterBatchTest, BatchesKeyValueMutationsInOrder) {
+  kv_server::InitMetricsContextMap();
+  std::stringstream string_stream;
+  auto record_writer = DeltaRecordStreamWriter<std::stringstream>::Create(
+      string_stream,
+      DeltaRecordWriter::Options{.enable_compression = false,
+                                 .metadata = GetMetadata(),
+                                 .key_value_batch_size = 2});
+  ASSERT_TRUE(record_writer.ok()) << record_writer.status();
+  KeyValueMutationRecordStruct second = GetKeyValueMutationRecord();
+  second.key = "key2";
+  KeyValueMutationRecordStruct third = GetKeyValueMutationRecord();
+  third.key = "key3";
+  // The set record ends the batch of the first record.
+  const std::vector<DataRecordStruct> data_records = {
+      GetDataRecord(GetKeyValueMutationRecord()),
+      GetDataRecord(GetDeltaSetRecord()),
+      GetDataRecord(second),
+      GetDataRecord(third),
+      GetDataRecord(GetUserDefinedFunctionsConfig()),
+  };
+  for (const DataRecordStruct& data_record : data_records) {
+    EXPECT_TRUE((*record_writer)->WriteRecord(data_record).ok());
+  }
+  (*record_writer)->Close();
+  auto stream_reader =
+      RiegeliStreamRecordReaderFactory().CreateReader(string_stream);
+  std::vector<Record> record_types;
+  // The records point into the bytes that are read.
+  int num_records = 0;
+  EXPECT_TRUE(
+      stream_reader
+          ->ReadStreamRecords([&](std::string_view record_string) {
+            record_types.push_back(
+                flatbuffers::GetRoot<DataRecord>(record_string.data())
+                    ->record_type());
+            return DeserializeDataRecord(
+                record_string, [&](const DataRecordStruct& data_record) {
+                  EXPECT_EQ(data_record, data_records[num_records++]);
+                  return absl::OkStatus();
+                });
+          })
+          .ok());
+  EXPECT_EQ(record_types,
+            (std::vector<Record>{Record::KeyValueMutationBatch,
+                                 Record::KeyValueMutationRecord,
+                                 Record::KeyValueMutationBatch,
+                                 Record::UserDefinedFunctionsConfig}));
+  EXPECT_EQ(num_records, static_cast<int>(data_records.size()));
+}
+
+TEST(DeltaRecordStreamWriterCompactionTest, WritesLatestRecordOfEachKey) {
+  kv_server::InitMetricsContextMap();
+  std::stringstream string_stream;
+  auto record_writer = DeltaRecordStreamWriter<std::stringstream>::Create(
+      string_stream,
+      DeltaRecordWriter::Options{.enable_compression = false,
+                                 .metadata = GetMetadata(),
+                                 .compaction_window_records = 10});
+  ASSERT_TRUE(record_writer.ok()) << record_writer.status();
+  KeyValueMutationRecordStruct older = GetKeyValueMutationRecord();
+  older.value = "older";
+  older.logical_commit_time -= 1;
+  KeyValueMutationRecordStruct other = GetKeyValueMutationRecord();
+  other.key = "key2";
+  // The UDF config ends the window of the first two records.
+  const std::vector<DataRecordStruct> written_records = {
+      GetDataRecord(older),
+      GetDataRecord(GetKeyValueMutationRecord()),
+      GetDataRecord(GetUserDefinedFunctionsConfig()),
+      GetDataRecord(other),
+      GetDataRecord(other),
+  };
+  for (const DataRecordStruct& data_record : written_records) {
+    EXPECT_TRUE((*record_writer)->WriteRecord(data_record).ok());
+  }
+  (*record_writer)->Close();
+  EXPECT_EQ((*record_writer)->compaction_stats().num_input_records, 4);
+  EXPECT_EQ((*record_writer)->compaction_stats().num_output_records, 2);
+  const std::vector<DataRecordStruct> expected_records = {
+      GetDataRecord(GetKeyValueMutationRecord()),
+      GetDataRecord(GetUserDefinedFunctionsConfig()),
+      GetDataRecord(other),
+  };
+  auto stream_reader =
+      RiegeliStreamRecordReaderFactory().CreateReader(string_stream);
+  int num_records = 0;
+  EXPECT_TRUE(
+      stream_reader
+          ->ReadStreamRecords([&](std::string_view record_string) {
+            return DeserializeDataRecord(
+                record_string, [&](const DataRecordStruct& data_record) {
+                  EXPECT_EQ(data_record, expected_records[num_records++]);
+                  return absl::OkStatus();
+                });
+          })
+          .ok());
+  EXPECT_EQ(num_records, static_cast<int>(expected_records.size()));
+}
+
 }  // namespace
 }  // namespace kv_server
@@ -17,7 +17,9 @@
 #ifndef PUBLIC_DATA_LOADING_WRITERS_DELTA_RECORD_WRITER_H_
 #define PUBLIC_DATA_LOADING_WRITERS_DELTA_RECORD_WRITER_H_
 
+#include <cstdint>
 #include <functional>
+#include <optional>
 #include <vector>
 
 #include "absl/status/status.h"
@@ -46,6 +48,24 @@ namespace kv_server {
 // ```
 class DeltaRecordWriter {
  public:
+  // Compression of the Riegeli chunks of compressed files.
+  enum class Compression { kBrotli, kZstd, kSnappy };
+
+  // Riegeli chunk settings. Unset values are Riegeli's defaults.
+  struct ChunkOptions {
+    // Ignored unless compression is enabled.
+    Compression compression = Compression::kBrotli;
+    // Level of `compression`, its default if unset. Snappy has no levels.
+    std::optional<int> compression_level;
+    // Bytes of records per chunk before compression. Larger chunks compress
+    // better, smaller ones let concurrent readers split files more finely.
+    std::optional<uint64_t> chunk_size;
+    // Whether to transpose the records of each chunk, which usually makes
+    // flatbuffer records compress better, at a CPU cost when writing and
+    // reading them.
+    bool transpose = false;
+  };
+
   // Options for writing delta files.
   struct Options {
     // If true, record compression will be enabled.
@@ -56,6 +76,21 @@ class DeltaRecordWriter {
 
     // Metadata required for delta files.
     KVFileMetadata metadata;
+
+    // The settings are recorded in the written `KVFileMetadata`.
+    ChunkOptions chunk_options;
+
+    // Number of consecutive key-value mutations with string values to write
+    // as one `KeyValueMutationBatch` record, which saves the framing of the
+    // individual records. 0 or 1 writes one record per mutation. Only readers
+    // that know the batch record type can read batched files.
+    int key_value_batch_size = 0;
+
+    // If positive, key-value mutations are compacted in windows of this many
+    // records before they're written, see `KeyValueMutationCompactor`, and
+    // only the latest mutation of each key of a window is written. Other
+    // records end the window, to keep their order.
+    int compaction_window_records = 0;
   };
   virtual ~DeltaRecordWriter() = default;
 
@@ -0,0 +1,158 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "public/data_loading/writers/key_indexed_record_writer.h"
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "public/data_loading/riegeli_metadata.pb.h"
+#include "public/data_loading/writers/record_writer_options.h"
+#include "riegeli/bytes/null_writer.h"
+#include "riegeli/bytes/ostream_writer.h"
+#include "riegeli/bytes/writer.h"
+#include "riegeli/records/record_writer.h"
+
+namespace kv_server {
+namespace {
+
+// The positions are written in the metadata at the start of the file, see
+// `kMaxShardIndexPasses`.
+constexpr int kMaxKeyIndexPasses = 5;
+
+// Writes the records to `dest` with `key_index` in the file metadata, and
+// returns the positions the sections were actually written at.
+absl::StatusOr<KeyIndex> WriteKeySections(riegeli::Writer& dest,
+                                          const RecordSource& read_records,
+                                          DeltaRecordWriter::Options options,
+                                          int64_t section_size_bytes,
+                                          KeyIndex key_index) {
+  *options.metadata.mutable_key_index() = std::move(key_index);
+  riegeli::RecordWriter<riegeli::Writer*> record_writer(
+      &dest, GetRecordWriterOptions(options));
+  flatbuffers::FlatBufferBuilder builder;
+  KeyIndex written_index;
+  KeyIndex::Section* section = nullptr;
+  int64_t num_section_bytes = 0;
+  std::string last_key;
+  // Ends the current section, at a chunk boundary.
+  auto end_section = [&]() -> absl::Status {
+    if (!record_writer.Flush()) {
+      return record_writer.status();
+    }
+    if (section != nullptr) {
+      section->set_last_key(last_key);
+      section->set_end(record_writer.Pos().numeric());
+    }
+    return absl::OkStatus();
+  };
+  if (absl::Status status = read_records(
+          [&](const DataRecordStruct& data_record) -> absl::Status {
+            const auto* record =
+                std::get_if<KeyValueMutationRecordStruct>(&data_record.record);
+            if (record != nullptr) {
+              if (section != nullptr && record->key < last_key) {
+                return absl::FailedPreconditionError(
+                    absl::StrCat("Records are not sorted by key: ",
+                                 record->key, " follows ", last_key, "."));
+              }
+              if (section == nullptr ||
+                  (num_section_bytes >= section_size_bytes &&
+                   record->key != last_key)) {
+                if (absl::Status status = end_section(); !status.ok()) {
+                  return status;
+                }
+                section = written_index.add_sections();
+                section->set_first_key(record->key);
+                section->set_begin(record_writer.Pos().numeric());
+                num_section_bytes = 0;
+              }
+              if (record->key != last_key) {
+                last_key = record->key;
+              }
+            }
+            const std::string_view record_bytes =
+                SerializeDataRecord(data_record, builder);
+            if (!record_writer.WriteRecord(record_bytes)) {
+              return record_writer.status();
+            }
+            if (record != nullptr) {
+              num_section_bytes += record_bytes.size();
+            }
+            return absl::OkStatus();
+          });
+      !status.ok()) {
+    return status;
+  }
+  if (section != nullptr) {
+    if (absl::Status status = end_section(); !status.ok()) {
+      return status;
+    }
+  }
+  if (!record_writer.Close()) {
+    return record_writer.status();
+  }
+  return written_index;
+}
+
+}  // namespace
+
+absl::Status WriteKeyIndexedRecordStream(
+    const RecordSource& read_records, std::ostream& dest_stream,
+    const DeltaRecordWriter::Options& options, int64_t section_size_bytes) {
+  if (auto status = ValidateRecordWriterOptions(options); !status.ok()) {
+    return status;
+  }
+  if (section_size_bytes <= 0) {
+    return absl::InvalidArgumentError("Section size must be positive.");
+  }
+  KeyIndex key_index;
+  bool measured = false;
+  for (int pass = 0; pass < kMaxKeyIndexPasses && !measured; pass++) {
+    riegeli::NullWriter null_writer;
+    auto written_index = WriteKeySections(null_writer, read_records, options,
+                                          section_size_bytes, key_index);
+    if (!written_index.ok()) {
+      return written_index.status();
+    }
+    measured =
+        written_index->SerializeAsString() == key_index.SerializeAsString();
+    key_index = *std::move(written_index);
+  }
+  if (!measured) {
+    return absl::InternalError("Failed to measure the key positions.");
+  }
+  riegeli::OStreamWriter<std::ostream*> dest_writer(&dest_stream);
+  auto written_index = WriteKeySections(dest_writer, read_records, options,
+                                        section_size_bytes, key_index);
+  if (!written_index.ok()) {
+    return written_index.status();
+  }
+  if (!dest_writer.Close()) {
+    return dest_writer.status();
+  }
+  if (written_index->SerializeAsString() != key_index.SerializeAsString()) {
+    return absl::InternalError(
+        "Records were not written at the measured key positions.");
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace kv_server
@@ -0,0 +1,50 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PUBLIC_DATA_LOADING_WRITERS_KEY_INDEXED_RECORD_WRITER_H_
+#define PUBLIC_DATA_LOADING_WRITERS_KEY_INDEXED_RECORD_WRITER_H_
+
+#include <cstdint>
+#include <functional>
+#include <iostream>
+
+#include "absl/status/status.h"
+#include "public/data_loading/records_utils.h"
+#include "public/data_loading/writers/delta_record_writer.h"
+
+namespace kv_server {
+
+// Calls its argument with every record to write, in order.
+using RecordSource = std::function<absl::Status(
+    const std::function<absl::Status(const DataRecordStruct&)>&)>;
+
+// Writes the records of `read_records`, whose key-value records must be
+// sorted by key, to `dest_stream` as one file with the key-value records in
+// sections of their own chunks, of about `section_size_bytes` of records each.
+// The sections are listed with their key ranges in the `key_index` of the file
+// metadata, so that readers seek to the records of a key without scanning the
+// file. The records of a key are never split across sections.
+//
+// Like shard indexes, the positions of the sections are measured before
+// they're written, so `read_records` is called once per pass over the records,
+// usually three or four times, and must read the same records every time.
+absl::Status WriteKeyIndexedRecordStream(
+    const RecordSource& read_records, std::ostream& dest_stream,
+    const DeltaRecordWriter::Options& options, int64_t section_size_bytes);
+
+}  // namespace kv_server
+
+#endif  // PUBLIC_DATA_LOADING_WRITERS_KEY_INDEXED_RECORD_WRITER_H_
@@ -0,0 +1,137 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "public/data_loading/writers/key_indexed_record_writer.h"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_format.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "public/data_loading/readers/riegeli_stream_io.h"
+#include "riegeli/bytes/string_reader.h"
+#include "riegeli/records/record_reader.h"
+
+namespace kv_server {
+namespace {
+
+DataRecordStruct GetDataRecord(std::string_view key) {
+  DataRecordStruct data_record;
+  data_record.record = KeyValueMutationRecordStruct{
+      .mutation_type = KeyValueMutationType::Update,
+      .logical_commit_time = 1234567890,
+      .key = key,
+      .value = std::string(100, 'v'),
+  };
+  return data_record;
+}
+
+RecordSource GetRecordSource(const std::vector<std::string>& keys) {
+  return [&keys](const std::function<absl::Status(const DataRecordStruct&)>&
+                     callback) {
+    for (const auto& key : keys) {
+      if (absl::Status status = callback(GetDataRecord(key)); !status.ok()) {
+        return status;
+      }
+    }
+    return absl::OkStatus();
+  };
+}
+
+DeltaRecordWriter::Options GetOptions() {
+  DeltaRecordWriter::Options options{.enable_compression = false};
+  options.metadata.mutable_snapshot();
+  return options;
+}
+
+std::vector<std::string> GetKeys(int num_keys) {
+  std::vector<std::string> keys;
+  for (int i = 0; i < num_keys; ++i) {
+    keys.push_back(absl::StrFormat("key%03d", i));
+  }
+  return keys;
+}
+
+// Returns the keys of the records at and after `pos`.
+std::vector<std::string> ReadKeysFrom(const std::string& file, uint64_t pos) {
+  riegeli::RecordReader record_reader(riegeli::StringReader<>(file));
+  EXPECT_TRUE(record_reader.Seek(pos)) << record_reader.status();
+  std::vector<std::string> keys;
+  std::string_view raw;
+  while (record_reader.ReadRecord(raw)) {
+    auto status = DeserializeDataRecord(
+        raw, std::function<absl::Status(const DataRecordStruct&)>(
+                 [&keys](const DataRecordStruct& data_record) {
+                   keys.push_back(std::string(
+                       std::get<KeyValueMutationRecordStruct>(
+                           data_record.record)
+                           .key));
+                   return absl::OkStatus();
+                 }));
+    EXPECT_TRUE(status.ok()) << status;
+  }
+  return keys;
+}
+
+TEST(KeyIndexedRecordWriterTest, IndexesSortedRecords) {
+  const std::vector<std::string> keys = GetKeys(100);
+  std::stringstream dest_stream;
+  auto status = WriteKeyIndexedRecordStream(GetRecordSource(keys), dest_stream,
+                                            GetOptions(),
+                                            /*section_size_bytes=*/1024);
+  ASSERT_TRUE(status.ok()) << status;
+  const std::string file = dest_stream.str();
+
+  std::stringstream metadata_stream(file);
+  RiegeliStreamReader<std::string_view> record_reader(
+      metadata_stream, [](const riegeli::SkippedRegion&) { return false; });
+  auto metadata = record_reader.GetKVFileMetadata();
+  ASSERT_TRUE(metadata.ok()) << metadata.status();
+  EXPECT_TRUE(metadata->has_snapshot());
+  const KeyIndex& key_index = metadata->key_index();
+  ASSERT_GT(key_index.sections_size(), 1);
+  EXPECT_EQ(key_index.sections(0).first_key(), keys.front());
+  EXPECT_EQ(key_index.sections(key_index.sections_size() - 1).last_key(),
+            keys.back());
+
+  // Readers that don't use the index read all records.
+  EXPECT_THAT(ReadKeysFrom(file, 0), testing::ElementsAreArray(keys));
+  EXPECT_EQ(FindKeyPosition(key_index, "key000"),
+            key_index.sections(0).begin());
+  for (const auto& key : {"key042", "key099"}) {
+    const std::vector<std::string> section_keys =
+        ReadKeysFrom(file, FindKeyPosition(key_index, key));
+    ASSERT_FALSE(section_keys.empty());
+    EXPECT_GT(section_keys.front(), keys.front());
+    EXPECT_LE(section_keys.front(), key);
+    EXPECT_THAT(section_keys, testing::Contains(key));
+  }
+  EXPECT_TRUE(ReadKeysFrom(file, FindKeyPosition(key_index, "key100")).empty());
+}
+
+TEST(KeyIndexedRecordWriterTest, UnsortedRecordsFail) {
+  const std::vector<std::string> keys = {"b", "a"};
+  std::stringstream dest_stream;
+  auto status = WriteKeyIndexedRecordStream(GetRecordSource(keys), dest_stream,
+                                            GetOptions(),
+                                            /*section_size_bytes=*/1024);
+  EXPECT_EQ(status.code(), absl::StatusCode::kFailedPrecondition) << status;
+}
+
+}  // namespace
+}  // namespace kv_server
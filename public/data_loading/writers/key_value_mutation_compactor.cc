@@ -0,0 +1,155 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "public/data_loading/writers/key_value_mutation_compactor.h"
+
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace kv_server {
+
+bool KeyValueMutationCompactor::CanCompact(
+    const DataRecordStruct& data_record) {
+  const auto* record =
+      std::get_if<KeyValueMutationRecordStruct>(&data_record.record);
+  if (record == nullptr) {
+    return false;
+  }
+  if (const auto* values =
+          std::get_if<std::vector<std::string_view>>(&record->value)) {
+    return !values->empty();
+  }
+  if (const auto* values = std::get_if<std::vector<uint32_t>>(&record->value)) {
+    return !values->empty();
+  }
+  return std::holds_alternative<std::string_view>(record->value);
+}
+
+void KeyValueMutationCompactor::Merge(const Latest& mutation, Latest& latest) {
+  if (mutation.logical_commit_time > latest.logical_commit_time) {
+    latest = mutation;
+  }
+}
+
+KeyValueMutationCompactor::KeyMutations&
+KeyValueMutationCompactor::GetKeyMutations(std::string_view key) {
+  if (const auto it = index_.find(key); it != index_.end()) {
+    return *it->second;
+  }
+  KeyMutations& key_mutations = keys_.emplace_back();
+  key_mutations.key = key;
+  index_.emplace(key_mutations.key, &key_mutations);
+  return key_mutations;
+}
+
+void KeyValueMutationCompactor::Add(
+    const KeyValueMutationRecordStruct& record) {
+  ++num_window_records_;
+  ++stats_.num_input_records;
+  KeyMutations& key_mutations = GetKeyMutations(record.key);
+  const Latest mutation{.mutation_type = record.mutation_type,
+                        .logical_commit_time = record.logical_commit_time};
+  if (const auto* value = std::get_if<std::string_view>(&record.value)) {
+    if (!key_mutations.value_mutation.has_value() ||
+        mutation.logical_commit_time >
+            key_mutations.value_mutation->logical_commit_time) {
+      key_mutations.value_mutation = mutation;
+      key_mutations.value = *value;
+    }
+    return;
+  }
+  if (const auto* values =
+          std::get_if<std::vector<std::string_view>>(&record.value)) {
+    for (std::string_view value : *values) {
+      auto [it, inserted] =
+          key_mutations.string_set_values.try_emplace(value, mutation);
+      if (!inserted) {
+        Merge(mutation, it->second);
+      }
+    }
+    return;
+  }
+  for (uint32_t value : std::get<std::vector<uint32_t>>(record.value)) {
+    auto [it, inserted] =
+        key_mutations.uint32_set_values.try_emplace(value, mutation);
+    if (!inserted) {
+      Merge(mutation, it->second);
+    }
+  }
+}
+
+absl::Status KeyValueMutationCompactor::Drain(
+    const std::function<absl::Status(const DataRecordStruct&)>& fn) {
+  absl::Status status;
+  const auto write = [this, &fn, &status](
+                         const KeyMutations& key_mutations,
+                         const Latest& mutation,
+                         KeyValueMutationRecordValueT value) {
+    if (!status.ok()) {
+      return;
+    }
+    ++stats_.num_output_records;
+    status = fn(DataRecordStruct{
+        .record = KeyValueMutationRecordStruct{
+            .mutation_type = mutation.mutation_type,
+            .logical_commit_time = mutation.logical_commit_time,
+            .key = key_mutations.key,
+            .value = std::move(value),
+        }});
+  };
+  // Groups the values of a set by commit time and mutation type, ordered by
+  // commit time, and writes a record per group.
+  const auto write_set = [&write](const KeyMutations& key_mutations,
+                                  const auto& set_values, auto group_type) {
+    absl::btree_map<std::pair<int64_t, KeyValueMutationType>,
+                    decltype(group_type)>
+        groups;
+    for (const auto& [value, latest] : set_values) {
+      groups[{latest.logical_commit_time, latest.mutation_type}].push_back(
+          value);
+    }
+    for (auto& [group, values] : groups) {
+      write(key_mutations,
+            Latest{.mutation_type = group.second,
+                   .logical_commit_time = group.first},
+            std::move(values));
+    }
+  };
+  for (const KeyMutations& key_mutations : keys_) {
+    if (key_mutations.value_mutation.has_value()) {
+      write(key_mutations, *key_mutations.value_mutation,
+            std::string_view(key_mutations.value));
+    }
+    write_set(key_mutations, key_mutations.string_set_values,
+              std::vector<std::string_view>());
+    write_set(key_mutations, key_mutations.uint32_set_values,
+              std::vector<uint32_t>());
+    if (!status.ok()) {
+      break;
+    }
+  }
+  Clear();
+  return status;
+}
+
+void KeyValueMutationCompactor::Clear() {
+  index_.clear();
+  keys_.clear();
+  num_window_records_ = 0;
+}
+
+}  // namespace kv_server
@@ -0,0 +1,116 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PUBLIC_DATA_LOADING_WRITERS_KEY_VALUE_MUTATION_COMPACTOR_H_
+#define PUBLIC_DATA_LOADING_WRITERS_KEY_VALUE_MUTATION_COMPACTOR_H_
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "absl/container/btree_map.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "public/data_loading/records_utils.h"
+
+namespace kv_server {
+
+// Compacts a window of key-value mutation records, keeping only the latest
+// mutation of each key, so that keys that are written many times are written,
+// downloaded and applied once.
+//
+// Like the cache, the latest of the mutations of a key with string values
+// wins, and the first of those with the same logical commit time. The values
+// of sets are compacted value by value, since the cache keeps a commit time
+// per set value: the latest update or delete of each value is kept, and the
+// values are written in one record per mutation type and commit time.
+//
+// Not thread safe.
+class KeyValueMutationCompactor {
+ public:
+  struct Stats {
+    int64_t num_input_records = 0;
+    int64_t num_output_records = 0;
+
+    // Fraction of the input records that compaction removed.
+    double dedup_ratio() const {
+      return num_input_records == 0
+                 ? 0
+                 : 1.0 - static_cast<double>(num_output_records) /
+                             num_input_records;
+    }
+  };
+
+  // Records are compacted in windows of `window_records` records.
+  explicit KeyValueMutationCompactor(int window_records)
+      : window_records_(window_records) {}
+  KeyValueMutationCompactor(const KeyValueMutationCompactor&) = delete;
+  KeyValueMutationCompactor& operator=(const KeyValueMutationCompactor&) =
+      delete;
+
+  // Whether `data_record` is a key-value mutation with a value that can be
+  // compacted. Other records, including updates of empty sets, are written
+  // as they are.
+  static bool CanCompact(const DataRecordStruct& data_record);
+
+  // Copies `record` into the window. `record` must be one that `CanCompact`.
+  void Add(const KeyValueMutationRecordStruct& record);
+  // Whether the window holds `window_records` records, and should be drained.
+  bool full() const { return num_window_records_ >= window_records_; }
+  bool empty() const { return num_window_records_ == 0; }
+
+  // Calls `fn` with the compacted records of the window, the keys in the
+  // order they were first added, and clears the window. The records point
+  // into the window, so they're only valid during the call. Stops at the
+  // first error of `fn`, the window is cleared regardless.
+  absl::Status Drain(
+      const std::function<absl::Status(const DataRecordStruct&)>& fn);
+
+  const Stats& stats() const { return stats_; }
+
+ private:
+  struct Latest {
+    KeyValueMutationType mutation_type = KeyValueMutationType::Update;
+    int64_t logical_commit_time = 0;
+  };
+  struct KeyMutations {
+    std::string key;
+    // The latest mutation of the key with a string value, if any.
+    std::optional<Latest> value_mutation;
+    std::string value;
+    absl::btree_map<std::string, Latest> string_set_values;
+    absl::btree_map<uint32_t, Latest> uint32_set_values;
+  };
+
+  // Replaces `latest` if `mutation` is later.
+  static void Merge(const Latest& mutation, Latest& latest);
+  KeyMutations& GetKeyMutations(std::string_view key);
+  void Clear();
+
+  const int window_records_;
+  int num_window_records_ = 0;
+  // A deque, so that the keys of `index_` don't move.
+  std::deque<KeyMutations> keys_;
+  absl::flat_hash_map<std::string_view, KeyMutations*> index_;
+  Stats stats_;
+};
+
+}  // namespace kv_server
+
+#endif  // PUBLIC_DATA_LOADING_WRITERS_KEY_VALUE_MUTATION_COMPACTOR_H_
@@ -0,0 +1,144 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "public/data_loading/writers/key_value_mutation_compactor.h"
+
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+KeyValueMutationRecordStruct GetRecord(KeyValueMutationType mutation_type,
+                                       int64_t logical_commit_time,
+                                       std::string_view key,
+                                       KeyValueMutationRecordValueT value) {
+  return KeyValueMutationRecordStruct{
+      .mutation_type = mutation_type,
+      .logical_commit_time = logical_commit_time,
+      .key = key,
+      .value = std::move(value),
+  };
+}
+
+// Drains `compactor` and expects it to write `expected_records`, compared
+// while they're valid.
+void ExpectDrainedRecords(
+    KeyValueMutationCompactor& compactor,
+    const std::vector<KeyValueMutationRecordStruct>& expected_records) {
+  int num_records = 0;
+  const auto status =
+      compactor.Drain([&](const DataRecordStruct& data_record) {
+        EXPECT_LT(num_records, static_cast<int>(expected_records.size()));
+        if (num_records < static_cast<int>(expected_records.size())) {
+          EXPECT_EQ(data_record,
+                    DataRecordStruct{.record = expected_records[num_records]});
+        }
+        ++num_records;
+        return absl::OkStatus();
+      });
+  EXPECT_TRUE(status.ok()) << status;
+  EXPECT_EQ(num_records, static_cast<int>(expected_records.size()));
+  EXPECT_TRUE(compactor.empty());
+}
+
+TEST(KeyValueMutationCompactorTest, KeepsLatestValueOfEachKey) {
+  KeyValueMutationCompactor compactor(/*window_records=*/10);
+  compactor.Add(GetRecord(KeyValueMutationType::Update, 2, "key1", "v2"));
+  compactor.Add(GetRecord(KeyValueMutationType::Update, 1, "key2", "v1"));
+  compactor.Add(GetRecord(KeyValueMutationType::Update, 1, "key1", "v1"));
+  compactor.Add(GetRecord(KeyValueMutationType::Delete, 3, "key2", ""));
+  // Like the cache, the first of the mutations with the same time wins.
+  compactor.Add(GetRecord(KeyValueMutationType::Update, 2, "key1", "v3"));
+  ExpectDrainedRecords(
+      compactor, {
+                     GetRecord(KeyValueMutationType::Update, 2, "key1", "v2"),
+                     GetRecord(KeyValueMutationType::Delete, 3, "key2", ""),
+                 });
+  EXPECT_EQ(compactor.stats().num_input_records, 5);
+  EXPECT_EQ(compactor.stats().num_output_records, 2);
+  EXPECT_DOUBLE_EQ(compactor.stats().dedup_ratio(), 0.6);
+}
+
+TEST(KeyValueMutationCompactorTest, MergesSetValuesOneByOne) {
+  KeyValueMutationCompactor compactor(/*window_records=*/10);
+  compactor.Add(GetRecord(KeyValueMutationType::Update, 1, "set",
+                          std::vector<std::string_view>{"a", "b", "c"}));
+  compactor.Add(GetRecord(KeyValueMutationType::Delete, 2, "set",
+                          std::vector<std::string_view>{"a"}));
+  // Older than the update of "b".
+  compactor.Add(GetRecord(KeyValueMutationType::Delete, 0, "set",
+                          std::vector<std::string_view>{"b"}));
+  compactor.Add(GetRecord(KeyValueMutationType::Update, 3, "ints",
+                          std::vector<uint32_t>{1, 2}));
+  compactor.Add(GetRecord(KeyValueMutationType::Update, 4, "ints",
+                          std::vector<uint32_t>{2}));
+  ExpectDrainedRecords(
+      compactor,
+      {
+          GetRecord(KeyValueMutationType::Update, 1, "set",
+                    std::vector<std::string_view>{"b", "c"}),
+          GetRecord(KeyValueMutationType::Delete, 2, "set",
+                    std::vector<std::string_view>{"a"}),
+          GetRecord(KeyValueMutationType::Update, 3, "ints",
+                    std::vector<uint32_t>{1}),
+          GetRecord(KeyValueMutationType::Update, 4, "ints",
+                    std::vector<uint32_t>{2}),
+      });
+}
+
+TEST(KeyValueMutationCompactorTest, WindowIsFullAfterWindowRecords) {
+  KeyValueMutationCompactor compactor(/*window_records=*/2);
+  EXPECT_TRUE(compactor.empty());
+  compactor.Add(GetRecord(KeyValueMutationType::Update, 1, "key", "v1"));
+  EXPECT_FALSE(compactor.full());
+  compactor.Add(GetRecord(KeyValueMutationType::Update, 2, "key", "v2"));
+  EXPECT_TRUE(compactor.full());
+  ExpectDrainedRecords(
+      compactor, {GetRecord(KeyValueMutationType::Update, 2, "key", "v2")});
+  EXPECT_FALSE(compactor.full());
+}
+
+TEST(KeyValueMutationCompactorTest, OnlyCompactsKeyValueMutations) {
+  EXPECT_TRUE(KeyValueMutationCompactor::CanCompact(DataRecordStruct{
+      .record = GetRecord(KeyValueMutationType::Update, 1, "key", "v")}));
+  EXPECT_FALSE(KeyValueMutationCompactor::CanCompact(
+      DataRecordStruct{.record = GetRecord(KeyValueMutationType::Update, 1,
+                                           "set", std::vector<uint32_t>{})}));
+  EXPECT_FALSE(KeyValueMutationCompactor::CanCompact(DataRecordStruct{
+      .record =
+          ShardMappingRecordStruct{.logical_shard = 0, .physical_shard = 0}}));
+}
+
+TEST(KeyValueMutationCompactorTest, DrainStopsAtError) {
+  KeyValueMutationCompactor compactor(/*window_records=*/10);
+  compactor.Add(GetRecord(KeyValueMutationType::Update, 1, "key1", "v"));
+  compactor.Add(GetRecord(KeyValueMutationType::Update, 1, "key2", "v"));
+  int num_records = 0;
+  const auto status = compactor.Drain([&](const DataRecordStruct&) {
+    ++num_records;
+    return absl::InternalError("Failed");
+  });
+  EXPECT_FALSE(status.ok());
+  EXPECT_EQ(num_records, 1);
+  EXPECT_TRUE(compactor.empty());
+}
+
+}  // namespace
+}  // namespace kv_server
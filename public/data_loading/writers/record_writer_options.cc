@@ -0,0 +1,80 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "public/data_loading/writers/record_writer_options.h"
+
+#include <utility>
+#include <vector>
+
+#include "absl/log/check.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+
+namespace kv_server {
+
+std::string GetRecordWriterOptionsText(
+    const DeltaRecordWriter::Options& options) {
+  const DeltaRecordWriter::ChunkOptions& chunk_options = options.chunk_options;
+  std::vector<std::string> parts;
+  if (!options.enable_compression) {
+    parts.push_back("uncompressed");
+  } else {
+    switch (chunk_options.compression) {
+      case DeltaRecordWriter::Compression::kBrotli:
+        parts.push_back("brotli");
+        break;
+      case DeltaRecordWriter::Compression::kZstd:
+        parts.push_back("zstd");
+        break;
+      case DeltaRecordWriter::Compression::kSnappy:
+        parts.push_back("snappy");
+        break;
+    }
+    if (chunk_options.compression_level.has_value() &&
+        chunk_options.compression != DeltaRecordWriter::Compression::kSnappy) {
+      absl::StrAppend(&parts.back(), ":", *chunk_options.compression_level);
+    }
+  }
+  if (chunk_options.chunk_size.has_value()) {
+    parts.push_back(absl::StrCat("chunk_size:", *chunk_options.chunk_size));
+  }
+  if (chunk_options.transpose) {
+    parts.push_back("transpose");
+  }
+  return absl::StrJoin(parts, ",");
+}
+
+absl::Status ValidateRecordWriterOptions(
+    const DeltaRecordWriter::Options& options) {
+  riegeli::RecordWriterBase::Options writer_options;
+  return writer_options.FromString(GetRecordWriterOptionsText(options));
+}
+
+riegeli::RecordWriterBase::Options GetRecordWriterOptions(
+    const DeltaRecordWriter::Options& options) {
+  const std::string options_text = GetRecordWriterOptionsText(options);
+  riegeli::RecordWriterBase::Options writer_options;
+  const absl::Status status = writer_options.FromString(options_text);
+  CHECK(status.ok()) << "Invalid record writer options: " << status;
+  riegeli::RecordsMetadata metadata;
+  KVFileMetadata& kv_file_metadata =
+      *metadata.MutableExtension(kv_server::kv_file_metadata);
+  kv_file_metadata = options.metadata;
+  kv_file_metadata.set_record_writer_options(options_text);
+  writer_options.set_metadata(std::move(metadata));
+  return writer_options;
+}
+
+}  // namespace kv_server
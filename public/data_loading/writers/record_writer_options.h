@@ -0,0 +1,45 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef PUBLIC_DATA_LOADING_WRITERS_RECORD_WRITER_OPTIONS_H_
+#define PUBLIC_DATA_LOADING_WRITERS_RECORD_WRITER_OPTIONS_H_
+
+#include <string>
+
+#include "absl/status/status.h"
+#include "public/data_loading/writers/delta_record_writer.h"
+#include "riegeli/records/record_writer.h"
+
+namespace kv_server {
+
+// Returns the Riegeli options text of the compression and chunk settings of
+// `options`, e.g. "brotli:6,chunk_size:1048576,transpose".
+std::string GetRecordWriterOptionsText(
+    const DeltaRecordWriter::Options& options);
+
+// Returns an error if Riegeli rejects the settings of `options`, e.g. a
+// compression level out of range.
+absl::Status ValidateRecordWriterOptions(
+    const DeltaRecordWriter::Options& options);
+
+// Returns the Riegeli writer options of `options`, with `options.metadata` as
+// the file metadata and the settings recorded in it. The settings must be
+// valid.
+riegeli::RecordWriterBase::Options GetRecordWriterOptions(
+    const DeltaRecordWriter::Options& options);
+
+}  // namespace kv_server
+
+#endif  // PUBLIC_DATA_LOADING_WRITERS_RECORD_WRITER_OPTIONS_H_
@@ -0,0 +1,66 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "public/data_loading/writers/record_writer_options.h"
+
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+DeltaRecordWriter::Options GetOptions(
+    bool enable_compression, DeltaRecordWriter::ChunkOptions chunk_options) {
+  return DeltaRecordWriter::Options{.enable_compression = enable_compression,
+                                    .chunk_options = chunk_options};
+}
+
+TEST(RecordWriterOptionsTest, DefaultsToRiegeliDefaults) {
+  EXPECT_EQ(GetRecordWriterOptionsText(GetOptions(true, {})), "brotli");
+  EXPECT_EQ(GetRecordWriterOptionsText(GetOptions(false, {})),
+            "uncompressed");
+}
+
+TEST(RecordWriterOptionsTest, CombinesChunkSettings) {
+  EXPECT_EQ(GetRecordWriterOptionsText(GetOptions(
+                true, {.compression = DeltaRecordWriter::Compression::kZstd,
+                       .compression_level = 5,
+                       .chunk_size = 1 << 20,
+                       .transpose = true})),
+            "zstd:5,chunk_size:1048576,transpose");
+  // Snappy has no levels, and uncompressed files ignore the compression.
+  EXPECT_EQ(GetRecordWriterOptionsText(GetOptions(
+                true, {.compression = DeltaRecordWriter::Compression::kSnappy,
+                       .compression_level = 5})),
+            "snappy");
+  EXPECT_EQ(GetRecordWriterOptionsText(GetOptions(
+                false, {.compression = DeltaRecordWriter::Compression::kZstd,
+                        .compression_level = 5,
+                        .transpose = true})),
+            "uncompressed,transpose");
+}
+
+TEST(RecordWriterOptionsTest, ValidatesCompressionLevels) {
+  EXPECT_TRUE(ValidateRecordWriterOptions(
+                  GetOptions(true, {.compression_level = 11}))
+                  .ok());
+  EXPECT_FALSE(ValidateRecordWriterOptions(
+                   GetOptions(true, {.compression_level = 12}))
+                   .ok());
+  EXPECT_FALSE(ValidateRecordWriterOptions(GetOptions(true, {.chunk_size = 0}))
+                   .ok());
+}
+
+}  // namespace
+}  // namespace kv_server
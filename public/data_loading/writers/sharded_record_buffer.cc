@@ -21,19 +21,32 @@
 
 #include "absl/memory/memory.h"
 #include "absl/strings/str_format.h"
+#include "public/data_loading/writers/delta_record_stream_writer.h"
+#include "public/data_loading/writers/record_writer_options.h"
+#include "riegeli/bytes/istream_reader.h"
+#include "riegeli/bytes/null_writer.h"
 #include "riegeli/bytes/ostream_writer.h"
+#include "riegeli/records/record_reader.h"
 #include "riegeli/records/record_writer.h"
 
 namespace kv_server {
 namespace {
 
+// The shard positions are written in the metadata at the start of the file,
+// so they move the records by the size of the metadata. Measuring is repeated
+// until the positions no longer move, which usually takes two or three passes.
+constexpr int kMaxShardIndexPasses = 5;
+
 class RecordBufferImpl : public RecordBuffer {
  public:
   ~RecordBufferImpl() { record_writer_.Close(); }
 
   absl::Status AddRecord(const DataRecordStruct& record) override {
-    if (!record_writer_.WriteRecord(
-            ToStringView(ToFlatBufferBuilder(record)))) {
+    return AddSerializedRecord(SerializeDataRecord(record, builder_));
+  }
+
+  absl::Status AddSerializedRecord(std::string_view record_bytes) override {
+    if (!record_writer_.WriteRecord(record_bytes)) {
       return record_writer_.status();
     }
     return absl::OkStatus();
@@ -70,6 +83,7 @@ class RecordBufferImpl : public RecordBuffer {
   std::unique_ptr<std::stringstream> record_stream_;
   riegeli::RecordWriter<riegeli::OStreamWriter<std::stringstream*>>
       record_writer_;
+  flatbuffers::FlatBufferBuilder builder_;
 };
 
 absl::Status IsWithinBounds(int shard_id, int num_shards) {
@@ -124,6 +138,15 @@ absl::Status ShardedRecordBuffer::AddRecord(
   return absl::OkStatus();
 }
 
+absl::Status ShardedRecordBuffer::AddSerializedRecord(
+    int shard_id, std::string_view record_bytes) {
+  if (auto status = IsWithinBounds(shard_id, shard_buffers_.size());
+      !status.ok()) {
+    return status;
+  }
+  return shard_buffers_[shard_id]->AddSerializedRecord(record_bytes);
+}
+
 absl::Status ShardedRecordBuffer::Flush(int shard_id) {
   if (shard_id < 0) {
     for (const auto& buffer : shard_buffers_) {
@@ -140,4 +163,82 @@ absl::Status ShardedRecordBuffer::Flush(int shard_id) {
   return shard_buffers_[shard_id]->Flush();
 }
 
+absl::Status ShardedRecordBuffer::WriteShardIndexedRecordStream(
+    std::ostream& dest_stream, const DeltaRecordWriter::Options& options) {
+  if (auto status = ValidateRecordWriterOptions(options); !status.ok()) {
+    return status;
+  }
+  if (auto status = Flush(); !status.ok()) {
+    return status;
+  }
+  ShardIndex shard_index;
+  bool measured = false;
+  for (int pass = 0; pass < kMaxShardIndexPasses && !measured; pass++) {
+    riegeli::NullWriter null_writer;
+    auto written_index = WriteShardSections(null_writer, options, shard_index);
+    if (!written_index.ok()) {
+      return written_index.status();
+    }
+    measured =
+        written_index->SerializeAsString() == shard_index.SerializeAsString();
+    shard_index = *std::move(written_index);
+  }
+  if (!measured) {
+    return absl::InternalError("Failed to measure the shard positions.");
+  }
+  riegeli::OStreamWriter<std::ostream*> dest_writer(&dest_stream);
+  auto written_index = WriteShardSections(dest_writer, options, shard_index);
+  if (!written_index.ok()) {
+    return written_index.status();
+  }
+  if (!dest_writer.Close()) {
+    return dest_writer.status();
+  }
+  if (written_index->SerializeAsString() != shard_index.SerializeAsString()) {
+    return absl::InternalError(
+        "Records were not written at the measured shard positions.");
+  }
+  return absl::OkStatus();
+}
+
+absl::StatusOr<ShardIndex> ShardedRecordBuffer::WriteShardSections(
+    riegeli::Writer& dest, DeltaRecordWriter::Options options,
+    ShardIndex shard_index) {
+  *options.metadata.mutable_shard_index() = std::move(shard_index);
+  riegeli::RecordWriter<riegeli::Writer*> record_writer(
+      &dest, GetRecordWriterOptions(options));
+  ShardIndex written_index;
+  written_index.set_num_shards(shard_buffers_.size());
+  written_index.set_sharding_hash_version(
+      static_cast<int32_t>(sharding_func_.hash_version()));
+  for (int shard_id = 0; shard_id < written_index.num_shards(); shard_id++) {
+    auto* section = written_index.add_sections();
+    section->set_shard_num(shard_id);
+    section->set_begin(record_writer.Pos().numeric());
+    std::istream* shard_stream = shard_buffers_[shard_id]->RecordStream();
+    shard_stream->clear();
+    shard_stream->seekg(0);
+    riegeli::RecordReader<riegeli::IStreamReader<std::istream*>> shard_reader(
+        riegeli::IStreamReader(shard_stream));
+    std::string_view record;
+    while (shard_reader.ReadRecord(record)) {
+      if (!record_writer.WriteRecord(record)) {
+        return record_writer.status();
+      }
+    }
+    if (!shard_reader.Close()) {
+      return shard_reader.status();
+    }
+    // Ends the chunk, so that the next shard starts in a chunk of its own.
+    if (!record_writer.Flush()) {
+      return record_writer.status();
+    }
+    section->set_end(record_writer.Pos().numeric());
+  }
+  if (!record_writer.Close()) {
+    return record_writer.status();
+  }
+  return written_index;
+}
+
 }  // namespace kv_server
@@ -19,12 +19,16 @@
 
 #include <iostream>
 #include <memory>
+#include <string_view>
 #include <vector>
 
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "public/data_loading/records_utils.h"
+#include "public/data_loading/riegeli_metadata.pb.h"
+#include "public/data_loading/writers/delta_record_writer.h"
 #include "public/sharding/sharding_function.h"
+#include "riegeli/bytes/writer.h"
 
 namespace kv_server {
 
@@ -38,6 +42,8 @@ class RecordBuffer {
   // Returns an error status if adding a record to the buffer fails for some
   // reason.
   virtual absl::Status AddRecord(const DataRecordStruct& record) = 0;
+  // Same as `AddRecord` for a record that is already serialized.
+  virtual absl::Status AddSerializedRecord(std::string_view record_bytes) = 0;
   // Flushes buffered records so that they are visible for reading via
   // `RecordStream()`.
   virtual absl::Status Flush() = 0;
@@ -59,14 +65,30 @@ class ShardedRecordBuffer {
       int num_shards, ShardingFunction sharding_func = ShardingFunction(""));
   absl::StatusOr<std::istream*> GetShardRecordStream(int shard_id);
   absl::Status AddRecord(const DataRecordStruct& record);
+  // Adds a record of `shard_id` serialized as a `data_loading.fbs:DataRecord`
+  // flatbuffer. Records of different shards can be added, and flushed,
+  // concurrently.
+  absl::Status AddSerializedRecord(int shard_id, std::string_view record_bytes);
+  int num_shards() const { return shard_buffers_.size(); }
   // Flushes buffered records so that they are visible for reading via
   // `RecordStream()`. Specify a `shard_id` to flush records buffered for a
   // specific shard or -1 to flush all buffered records.
   absl::Status Flush(int shard_id = -1);
+  // Writes the buffered records of all shards to `dest_stream` as one file,
+  // with the records of each shard in their own chunks. The chunks of each
+  // shard are listed in the `shard_index` of the file metadata, so that data
+  // servers skip the records of other shards without decompressing them.
+  absl::Status WriteShardIndexedRecordStream(
+      std::ostream& dest_stream, const DeltaRecordWriter::Options& options);
 
  private:
   ShardedRecordBuffer(ShardingFunction sharding_func,
                       std::vector<std::unique_ptr<RecordBuffer>> shard_buffers);
+  // Writes the records of all shards to `dest` with `shard_index` in the file
+  // metadata, and returns the positions the shards were actually written at.
+  absl::StatusOr<ShardIndex> WriteShardSections(
+      riegeli::Writer& dest, DeltaRecordWriter::Options options,
+      ShardIndex shard_index);
   ShardingFunction sharding_func_;
   std::vector<std::unique_ptr<RecordBuffer>> shard_buffers_;
 };
@@ -16,9 +16,14 @@
 
 #include "public/data_loading/writers/sharded_record_buffer.h"
 
+#include <sstream>
+#include <string>
+#include <vector>
+
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "public/data_loading/readers/delta_record_stream_reader.h"
+#include "public/data_loading/readers/riegeli_stream_io.h"
 #include "public/sharding/sharding_function.h"
 
 namespace kv_server {
@@ -133,5 +138,58 @@ TEST(ShardedRecordBufferTest, ValidateAddingAndReadingRecords) {
   ValidateRecordStream({"key6"}, **shard_stream);
 }
 
+TEST(ShardedRecordBufferTest, WritesShardIndexedRecordStream) {
+  int num_shards = 7;
+  auto keys = std::vector<std::string_view>{
+      "key1", "key2", "key3", "key4", "key5", "key6", "key7",
+  };
+  auto record_buffer = ShardedRecordBuffer::Create(num_shards);
+  ASSERT_TRUE(record_buffer.ok()) << record_buffer.status();
+  for (const auto& key : keys) {
+    auto status =
+        (*record_buffer)->AddRecord(GetDataRecord(GetKVMutationRecord(key)));
+    EXPECT_TRUE(status.ok()) << status;
+  }
+  DeltaRecordWriter::Options options{.enable_compression = true};
+  options.metadata.mutable_delta();
+  std::stringstream indexed_stream;
+  auto status =
+      (*record_buffer)->WriteShardIndexedRecordStream(indexed_stream, options);
+  ASSERT_TRUE(status.ok()) << status;
+
+  // Readers that don't use the index read all records.
+  std::stringstream all_records(indexed_stream.str());
+  ValidateRecordStream(keys, all_records);
+
+  std::stringstream shard_records(indexed_stream.str());
+  RiegeliStreamReader<std::string_view> record_reader(
+      shard_records, [](const riegeli::SkippedRegion&) { return false; });
+  auto metadata = record_reader.GetKVFileMetadata();
+  ASSERT_TRUE(metadata.ok()) << metadata.status();
+  EXPECT_TRUE(metadata->has_delta());
+  EXPECT_EQ(metadata->shard_index().num_shards(), num_shards);
+  ASSERT_EQ(metadata->shard_index().sections_size(), num_shards);
+  // shard 2 has no records.
+  EXPECT_EQ(metadata->shard_index().sections(2).begin(),
+            metadata->shard_index().sections(2).end());
+  std::vector<std::string> shard_keys;
+  status = record_reader.ReadShardStreamRecords(
+      /*shard_num=*/5, num_shards, /*sharding_hash_version=*/0,
+      [&shard_keys](std::string_view raw) {
+        return DeserializeDataRecord(
+            raw, std::function<absl::Status(const DataRecordStruct&)>(
+                     [&shard_keys](const DataRecordStruct& data_record) {
+                       shard_keys.push_back(std::string(
+                           std::get<KeyValueMutationRecordStruct>(
+                               data_record.record)
+                               .key));
+                       return absl::OkStatus();
+                     }));
+      });
+  EXPECT_TRUE(status.ok()) << status;
+  // {key1,key5}=5
+  EXPECT_THAT(shard_keys, testing::ElementsAre("key1", "key5"));
+}
+
 }  // namespace
 }  // namespace kv_server
@@ -18,8 +18,11 @@
 #define PUBLIC_DATA_LOADING_WRITERS_SNAPSHOT_STREAM_WRITER_
 
 #include <filesystem>
+#include <functional>
 #include <iostream>
+#include <map>
 #include <memory>
+#include <optional>
 #include <string>
 #include <utility>
 
@@ -34,6 +37,7 @@
 #include "public/data_loading/riegeli_metadata.pb.h"
 #include "public/data_loading/writers/delta_record_stream_writer.h"
 #include "public/data_loading/writers/delta_record_writer.h"
+#include "public/data_loading/writers/key_indexed_record_writer.h"
 
 namespace kv_server {
 
@@ -77,6 +81,24 @@ class SnapshotStreamWriter {
     std::string temp_data_file;
     // Whether to compress the snapshot stream or not.
     bool compress_snapshot;
+    // Riegeli chunk settings of the snapshot stream.
+    DeltaRecordWriter::ChunkOptions chunk_options;
+    // If positive, records are aggregated by a sort-merge aggregator that
+    // spills sorted runs of records to `spill_directory` whenever they take
+    // more memory than this, instead of SQLite, and `temp_data_file` is
+    // ignored.
+    int64_t sort_merge_memory_budget_bytes = 0;
+    // Defaults to the system's temporary directory.
+    std::string spill_directory;
+    // If positive, the key-value records are written sorted by key in
+    // sections of about this many bytes, listed in the `key_index` of the
+    // snapshot metadata, see `WriteKeyIndexedRecordStream`. Requires
+    // `sort_merge_memory_budget_bytes`, whose aggregator reads the records
+    // sorted.
+    int64_t key_index_section_bytes = 0;
+    // See `DeltaRecordWriter::Options::key_value_batch_size`. Ignored by
+    // key-indexed snapshots, whose sections index individual records.
+    int key_value_batch_size = 0;
   };
 
   ~SnapshotStreamWriter();
@@ -106,31 +128,46 @@ class SnapshotStreamWriter {
 
  private:
   SnapshotStreamWriter(
+      DestStreamT& dest_snapshot_stream,
       std::unique_ptr<DeltaRecordStreamWriter<DestStreamT>> record_writer,
       std::unique_ptr<RecordAggregator> record_aggregator, Options options);
 
+  // Reads the records of the snapshot, in the order they are written.
+  absl::Status ReadSnapshotRecords(
+      const std::function<absl::Status(const DataRecordStruct&)>& callback);
   absl::Status InsertOrUpdateRecord(const DataRecordStruct& record);
   template <typename SrcStreamT>
   absl::Status InsertOrUpdateRecords(SrcStreamT& src_stream);
   static absl::StatusOr<std::unique_ptr<RecordAggregator>>
-  CreateRecordAggregator(std::string_view temp_data_file);
+  CreateRecordAggregator(const Options& options);
   static DeltaRecordWriter::Options CreateDeltaRecordWriterOptions(
       const Options& options);
   static absl::Status ValidateRequiredSnapshotMetadata(
       const KVFileMetadata& metadata);
 
+  DestStreamT& dest_snapshot_stream_;
+  // Null if the snapshot is key indexed, it is then written on `Finalize`.
   std::unique_ptr<DeltaRecordStreamWriter<DestStreamT>> record_writer_;
   std::unique_ptr<RecordAggregator> record_aggregator_;
   Options options_;
   bool is_finalized_ = false;
   std::unique_ptr<UserDefinedFunctionsConfigStruct> udf_config_;
+  // Assignments of logical shards to physical shards, merged like servers
+  // apply `ShardMappingRecord`s, see `LogicalShardMapping::Apply`.
+  struct ShardMapping {
+    std::optional<int32_t> physical_shard;
+    std::optional<int32_t> staged_physical_shard;
+  };
+  std::map<int32_t, ShardMapping> shard_mappings_;
 };
 
 template <typename DestStreamT>
 SnapshotStreamWriter<DestStreamT>::SnapshotStreamWriter(
+    DestStreamT& dest_snapshot_stream,
     std::unique_ptr<DeltaRecordStreamWriter<DestStreamT>> record_writer,
     std::unique_ptr<RecordAggregator> record_aggregator, Options options)
-    : record_writer_(std::move(record_writer)),
+    : dest_snapshot_stream_(dest_snapshot_stream),
+      record_writer_(std::move(record_writer)),
       record_aggregator_(std::move(record_aggregator)),
       options_(std::move(options)) {}
 
@@ -147,18 +184,27 @@ SnapshotStreamWriter<DestStreamT>::Create(Options options,
       !status.ok()) {
     return status;
   }
-  auto record_aggregator = CreateRecordAggregator(options.temp_data_file);
+  if (options.key_index_section_bytes > 0 &&
+      options.sort_merge_memory_budget_bytes <= 0) {
+    return absl::InvalidArgumentError(
+        "Key indexed snapshots require sort-merge aggregation.");
+  }
+  auto record_aggregator = CreateRecordAggregator(options);
   if (!record_aggregator.ok()) {
     return record_aggregator.status();
   }
-  auto record_writer = DeltaRecordStreamWriter<DestStreamT>::Create(
-      dest_snapshot_stream, CreateDeltaRecordWriterOptions(options));
-  if (!record_writer.ok()) {
-    return record_writer.status();
+  std::unique_ptr<DeltaRecordStreamWriter<DestStreamT>> record_writer;
+  if (options.key_index_section_bytes <= 0) {
+    auto delta_record_writer = DeltaRecordStreamWriter<DestStreamT>::Create(
+        dest_snapshot_stream, CreateDeltaRecordWriterOptions(options));
+    if (!delta_record_writer.ok()) {
+      return delta_record_writer.status();
+    }
+    record_writer = *std::move(delta_record_writer);
   }
   return absl::WrapUnique(new SnapshotStreamWriter<DestStreamT>(
-      std::move(*record_writer), std::move(*record_aggregator),
-      std::move(options)));
+      dest_snapshot_stream, std::move(record_writer),
+      std::move(*record_aggregator), std::move(options)));
 }
 
 template <typename DestStreamT>
@@ -190,20 +236,38 @@ SnapshotStreamWriter<DestStreamT>::CreateDeltaRecordWriterOptions(
                          << ")";
               return;
             }
+            if (std::holds_alternative<ShardMappingRecordStruct>(
+                    data_record.record)) {
+              LOG(ERROR) << "Failed to write record to snapshot stream. "
+                            "(logical_shard: "
+                         << std::get<ShardMappingRecordStruct>(
+                                data_record.record)
+                                .logical_shard
+                         << ")";
+              return;
+            }
             LOG(ERROR) << "Failed to write record to snapshot stream. "
                           "No KeyValueMutation or UdfConfig specified. ";
           },
       .metadata = options.metadata,
+      .chunk_options = options.chunk_options,
+      .key_value_batch_size = options.key_value_batch_size,
   };
 }
 
 template <typename DestStreamT>
 absl::StatusOr<std::unique_ptr<RecordAggregator>>
 SnapshotStreamWriter<DestStreamT>::CreateRecordAggregator(
-    std::string_view temp_data_file) {
-  return temp_data_file.empty()
+    const Options& options) {
+  if (options.sort_merge_memory_budget_bytes > 0) {
+    return RecordAggregator::CreateSortMergeAggregator(
+        {.memory_budget_bytes = options.sort_merge_memory_budget_bytes,
+         .spill_directory = options.spill_directory});
+  }
+  return options.temp_data_file.empty()
              ? RecordAggregator::CreateInMemoryAggregator()
-             : RecordAggregator::CreateFileBackedAggregator(temp_data_file);
+             : RecordAggregator::CreateFileBackedAggregator(
+                   options.temp_data_file);
 }
 
 template <typename DestStreamT>
@@ -226,6 +290,23 @@ absl::Status SnapshotStreamWriter<DestStreamT>::InsertOrUpdateRecord(
     }
     return absl::OkStatus();
   }
+  if (std::holds_alternative<ShardMappingRecordStruct>(data_record.record)) {
+    const auto& shard_mapping =
+        std::get<ShardMappingRecordStruct>(data_record.record);
+    ShardMapping& mapping = shard_mappings_[shard_mapping.logical_shard];
+    if (mapping.physical_shard == shard_mapping.physical_shard) {
+      return absl::OkStatus();
+    }
+    if (shard_mapping.state == ShardMappingState::Staged) {
+      mapping.staged_physical_shard = shard_mapping.physical_shard;
+      return absl::OkStatus();
+    }
+    mapping.physical_shard = shard_mapping.physical_shard;
+    if (mapping.staged_physical_shard == shard_mapping.physical_shard) {
+      mapping.staged_physical_shard.reset();
+    }
+    return absl::OkStatus();
+  }
   return absl::OkStatus();
 }
 
@@ -270,9 +351,56 @@ absl::Status SnapshotStreamWriter<DestStreamT>::Finalize() {
   if (is_finalized_) {
     return absl::OkStatus();
   }
-  if (absl::Status status = record_aggregator_->ReadRecords(
+  if (record_writer_ == nullptr) {
+    if (absl::Status status = WriteKeyIndexedRecordStream(
+            [this](const std::function<absl::Status(const DataRecordStruct&)>&
+                       callback) { return ReadSnapshotRecords(callback); },
+            dest_snapshot_stream_, CreateDeltaRecordWriterOptions(options_),
+            options_.key_index_section_bytes);
+        !status.ok()) {
+      return status;
+    }
+    is_finalized_ = true;
+    return absl::OkStatus();
+  }
+  if (absl::Status status = ReadSnapshotRecords(
           [record_writer = record_writer_.get()](
-              KeyValueMutationRecordStruct kv_mutation_record) {
+              const DataRecordStruct& data_record) {
+            return record_writer->WriteRecord(data_record);
+          });
+      !status.ok()) {
+    return status;
+  }
+  if (absl::Status status = record_writer_->Flush(); !status.ok()) {
+    return status;
+  }
+  is_finalized_ = true;
+  return absl::OkStatus();
+}
+
+template <typename DestStreamT>
+absl::Status SnapshotStreamWriter<DestStreamT>::ReadSnapshotRecords(
+    const std::function<absl::Status(const DataRecordStruct&)>& callback) {
+  for (const auto& [logical_shard, mapping] : shard_mappings_) {
+    for (const auto& [physical_shard, state] :
+         {std::pair(mapping.physical_shard, ShardMappingState::Active),
+          std::pair(mapping.staged_physical_shard,
+                    ShardMappingState::Staged)}) {
+      if (!physical_shard.has_value()) {
+        continue;
+      }
+      if (absl::Status status = callback(DataRecordStruct{
+              .record = ShardMappingRecordStruct{
+                  .logical_shard = logical_shard,
+                  .physical_shard = *physical_shard,
+                  .state = state}});
+          !status.ok()) {
+        return status;
+      }
+    }
+  }
+  if (absl::Status status = record_aggregator_->ReadRecords(
+          [&callback](KeyValueMutationRecordStruct kv_mutation_record) {
             // By definition, snapshots do NOT contain DELETE mutations.
             if (kv_mutation_record.mutation_type ==
                 KeyValueMutationType::Delete) {
@@ -280,22 +408,14 @@ absl::Status SnapshotStreamWriter<DestStreamT>::Finalize() {
             }
             DataRecordStruct data_record;
             data_record.record = std::move(kv_mutation_record);
-            return record_writer->WriteRecord(data_record);
+            return callback(data_record);
           });
       !status.ok()) {
     return status;
   }
   if (udf_config_ != nullptr) {
-    if (absl::Status status = record_writer_->WriteRecord(
-            DataRecordStruct{.record = *udf_config_});
-        !status.ok()) {
-      return status;
-    }
+    return callback(DataRecordStruct{.record = *udf_config_});
   }
-  if (absl::Status status = record_writer_->Flush(); !status.ok()) {
-    return status;
-  }
-  is_finalized_ = true;
   return absl::OkStatus();
 }
 
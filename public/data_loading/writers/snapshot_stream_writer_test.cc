@@ -104,7 +104,12 @@ INSTANTIATE_TEST_SUITE_P(
                               .compress_snapshot = false},
         SnapshotWriterOptions{.metadata = GetSnapshotMetadata(),
                               .temp_data_file = GetRecordAggregatorDbFile(),
-                              .compress_snapshot = true}));
+                              .compress_snapshot = true},
+        SnapshotWriterOptions{.metadata = GetSnapshotMetadata(),
+                              .temp_data_file = "",
+                              .compress_snapshot = true,
+                              .sort_merge_memory_budget_bytes = 1024,
+                              .key_index_section_bytes = 64}));
 
 TEST_P(SnapshotStreamWriterTest, ValidateThatRecordsAreDedupedInSnapshot) {
   std::stringstream dest_stream;
@@ -254,7 +259,9 @@ TEST_P(SnapshotStreamWriterTest,
   EXPECT_TRUE(status.ok()) << status;
   DeltaRecordStreamReader record_reader(dest_stream);
   auto metadata = record_reader.ReadMetadata();
-  EXPECT_TRUE(metadata.ok()) << metadata.status();
+  ASSERT_TRUE(metadata.ok()) << metadata.status();
+  // Added by key indexed snapshots.
+  metadata->clear_key_index();
   EXPECT_TRUE(google::protobuf::util::MessageDifferencer::Equals(
       GetSnapshotMetadata(), *metadata));
 }
@@ -285,6 +292,77 @@ TEST_P(SnapshotStreamWriterTest, UdfConfig_DedupedInSnapshot) {
   EXPECT_TRUE(status.ok()) << status;
 }
 
+TEST_P(SnapshotStreamWriterTest, UInt32Set_MergedInSnapshot) {
+  std::stringstream dest_stream;
+  auto snapshot_writer =
+      SnapshotStreamWriterTest::CreateSnapshotWriter(dest_stream);
+  EXPECT_TRUE(snapshot_writer.ok()) << snapshot_writer.status();
+  KeyValueMutationRecordStruct record1 = GetKVMutationRecord();
+  record1.value = std::vector<uint32_t>{1, 2, 4000000000u};
+  KeyValueMutationRecordStruct record2 = GetKVMutationRecord();
+  record2.value = std::vector<uint32_t>{2, 3};
+  record2.logical_commit_time = record1.logical_commit_time + 1;
+  for (const auto& record : {record1, record2}) {
+    auto status = (*snapshot_writer)->WriteRecord(GetDataRecord(record));
+    EXPECT_TRUE(status.ok()) << status;
+  }
+  auto status = (*snapshot_writer)->Finalize();
+  EXPECT_TRUE(status.ok()) << status;
+
+  DeltaRecordStreamReader record_reader(dest_stream);
+  testing::MockFunction<absl::Status(DataRecordStruct)> record_callback;
+  EXPECT_CALL(record_callback, Call)
+      .WillOnce([&record2](DataRecordStruct data_record) {
+        const auto& record =
+            std::get<KeyValueMutationRecordStruct>(data_record.record);
+        EXPECT_EQ(record.key, record2.key);
+        EXPECT_EQ(record.logical_commit_time, record2.logical_commit_time);
+        EXPECT_THAT(std::get<std::vector<uint32_t>>(record.value),
+                    testing::UnorderedElementsAre(1, 2, 3, 4000000000u));
+        return absl::OkStatus();
+      });
+  status = record_reader.ReadRecords(record_callback.AsStdFunction());
+  EXPECT_TRUE(status.ok()) << status;
+}
+
+TEST_P(SnapshotStreamWriterTest, ShardMapping_KeepsStagedAndCutOverShards) {
+  std::stringstream dest_stream;
+  auto snapshot_writer =
+      SnapshotStreamWriterTest::CreateSnapshotWriter(dest_stream);
+  EXPECT_TRUE(snapshot_writer.ok()) << snapshot_writer.status();
+  auto staged_0 = GetDataRecord(
+      ShardMappingRecordStruct{.logical_shard = 0,
+                               .physical_shard = 2,
+                               .state = ShardMappingState::Staged});
+  auto cut_over_0 = GetDataRecord(
+      ShardMappingRecordStruct{.logical_shard = 0, .physical_shard = 2});
+  auto staged_1 = GetDataRecord(
+      ShardMappingRecordStruct{.logical_shard = 1,
+                               .physical_shard = 3,
+                               .state = ShardMappingState::Staged});
+  // Logical shard 0 is staged and cut over, logical shard 1 is only staged.
+  // Repeated records change nothing.
+  std::vector data_records{staged_0,   staged_1, staged_0,
+                           cut_over_0, staged_0, staged_1};
+  for (const auto& recd : data_records) {
+    auto status = (*snapshot_writer)->WriteRecord(recd);
+    EXPECT_TRUE(status.ok()) << status;
+  }
+  auto status = (*snapshot_writer)->Finalize();
+  EXPECT_TRUE(status.ok()) << status;
+
+  DeltaRecordStreamReader record_reader(dest_stream);
+  testing::MockFunction<absl::Status(DataRecordStruct)> record_callback;
+  EXPECT_CALL(record_callback, Call(cut_over_0))
+      .Times(1)
+      .WillOnce([](DataRecordStruct) { return absl::OkStatus(); });
+  EXPECT_CALL(record_callback, Call(staged_1))
+      .Times(1)
+      .WillOnce([](DataRecordStruct) { return absl::OkStatus(); });
+  status = record_reader.ReadRecords(record_callback.AsStdFunction());
+  EXPECT_TRUE(status.ok()) << status;
+}
+
 TEST_P(SnapshotStreamWriterTest,
        UdfConfig_UpdatesWithLargestCommitTimestampInSnapshot) {
   std::stringstream dest_stream;
@@ -342,6 +420,15 @@ TEST_P(SnapshotStreamWriterTest,
   EXPECT_TRUE(status.ok()) << status;
 }
 
+TEST(SnapshotStreamWriterTest, KeyIndexRequiresSortMergeAggregation) {
+  std::stringstream dest_stream;
+  auto snapshot_writer = SnapshotStreamWriter<>::Create(
+      {.metadata = GetSnapshotMetadata(), .key_index_section_bytes = 64},
+      dest_stream);
+  EXPECT_EQ(snapshot_writer.status().code(),
+            absl::StatusCode::kInvalidArgument);
+}
+
 TEST(SnapshotStreamWriterTest,
      ValidateCreatingSnapshotWriterWithValidMetadata) {
   std::stringstream dest_stream;
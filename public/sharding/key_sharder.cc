@@ -16,30 +16,254 @@
 
 #include "public/sharding/key_sharder.h"
 
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/ascii.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/strip.h"
+
 namespace kv_server {
+namespace {
+
+constexpr std::string_view kRegexSpecialChars = R"(\^$.|?*+()[]{})";
+
+// Consumes the literal string at the start of `regex` up to `end`, or up to
+// its end if `end` is empty, e.g. `_` or `\|`, into `literal`. Returns false if
+// anything else is there.
+bool ConsumeLiteral(std::string_view& regex, std::string_view end,
+                    std::string& literal) {
+  literal.clear();
+  while (!regex.empty() && (end.empty() || !absl::StartsWith(regex, end))) {
+    if (regex[0] == '\\') {
+      // Only escaped punctuation is literal, `\d` and the like are classes.
+      if (regex.size() < 2 || !absl::ascii_ispunct(regex[1])) {
+        return false;
+      }
+      literal.push_back(regex[1]);
+      regex.remove_prefix(2);
+      continue;
+    }
+    if (kRegexSpecialChars.find(regex[0]) != std::string_view::npos) {
+      return false;
+    }
+    literal.push_back(regex[0]);
+    regex.remove_prefix(1);
+  }
+  return !literal.empty() &&
+         (end.empty() ? regex.empty() : absl::StartsWith(regex, end));
+}
+
+// `.` doesn't match line terminators, so the simple patterns don't apply to
+// keys with them.
+bool HasLineTerminator(std::string_view key) {
+  return key.find_first_of("\n\r") != std::string_view::npos;
+}
+
+}  // namespace
 
 KeySharder::KeySharder(ShardingFunction sharding_function,
-                       std::optional<std::regex> shard_key_regex)
-    : sharding_function_(std::move(sharding_function)),
-      shard_key_regex_(std::move(shard_key_regex)) {}
+                       std::optional<std::string_view> shard_key_regex,
+                       int num_logical_shards)
+    : sharding_function_(std::move(sharding_function)) {
+  if (num_logical_shards > 0) {
+    logical_shard_mapping_ =
+        std::make_shared<LogicalShardMapping>(num_logical_shards);
+  }
+  if (shard_key_regex.has_value()) {
+    // https://en.cppreference.com/w/cpp/regex/syntax_option_type
+    // optimize -- "Instructs the regular expression engine to make matching
+    // faster, with the potential cost of making construction slower. For
+    // example, this might mean converting a non-deterministic FSA to a
+    // deterministic FSA." this matches our usecase.
+    shard_key_regex_ = std::make_shared<const std::regex>(
+        shard_key_regex->begin(), shard_key_regex->end(),
+        std::regex_constants::ECMAScript | std::regex_constants::optimize);
+    simple_pattern_ = ParseSimplePattern(*shard_key_regex);
+  }
+}
+
+std::optional<KeySharder::SimplePattern> KeySharder::ParseSimplePattern(
+    std::string_view regex) {
+  if (!absl::ConsumeSuffix(&regex, ".*")) {
+    return std::nullopt;
+  }
+  SimplePattern pattern;
+  if (absl::ConsumePrefix(&regex, "(.{")) {
+    // `(.{n}).*`
+    std::string_view length = regex.substr(0, regex.find('}'));
+    if (!absl::SimpleAtoi(length, &pattern.prefix_length) ||
+        pattern.prefix_length < 0 || regex.substr(length.size()) != "})") {
+      return std::nullopt;
+    }
+    pattern.kind = SimplePattern::Kind::kPrefix;
+    return pattern;
+  }
+  if (absl::ConsumePrefix(&regex, "([^")) {
+    // `([^d]*)d.*` and `([^d]+)d.*`, with a single character `d`.
+    std::string excluded;
+    if (!ConsumeLiteral(regex, "]", excluded) || excluded.size() != 1) {
+      return std::nullopt;
+    }
+    regex.remove_prefix(1);
+    if (absl::ConsumePrefix(&regex, "+)")) {
+      pattern.allow_empty = false;
+    } else if (!absl::ConsumePrefix(&regex, "*)")) {
+      return std::nullopt;
+    }
+    if (!ConsumeLiteral(regex, "", pattern.delimiter) ||
+        pattern.delimiter != excluded) {
+      return std::nullopt;
+    }
+    pattern.kind = SimplePattern::Kind::kBeforeFirstDelimiter;
+    pattern.excludes_delimiter = true;
+    return pattern;
+  }
+  if (absl::ConsumePrefix(&regex, "(.*?)")) {
+    pattern.kind = SimplePattern::Kind::kBeforeFirstDelimiter;
+  } else if (absl::ConsumePrefix(&regex, "(.+?)")) {
+    pattern.kind = SimplePattern::Kind::kBeforeFirstDelimiter;
+    pattern.allow_empty = false;
+  } else if (absl::ConsumePrefix(&regex, "(.*)")) {
+    pattern.kind = SimplePattern::Kind::kBeforeLastDelimiter;
+  } else if (absl::ConsumePrefix(&regex, "(.+)")) {
+    pattern.kind = SimplePattern::Kind::kBeforeLastDelimiter;
+    pattern.allow_empty = false;
+  } else {
+    return std::nullopt;
+  }
+  if (!ConsumeLiteral(regex, "", pattern.delimiter)) {
+    return std::nullopt;
+  }
+  return pattern;
+}
+
+std::optional<std::string_view> KeySharder::MatchShardingKey(
+    std::string_view key) const {
+  if (simple_pattern_.has_value() && !HasLineTerminator(key)) {
+    const SimplePattern& pattern = *simple_pattern_;
+    size_t end = std::string_view::npos;
+    switch (pattern.kind) {
+      case SimplePattern::Kind::kPrefix:
+        if (key.size() >= static_cast<size_t>(pattern.prefix_length)) {
+          end = pattern.prefix_length;
+        }
+        break;
+      case SimplePattern::Kind::kBeforeFirstDelimiter:
+        // `(.+?)d.*` skips a leading `d`, `([^d]+)d.*` can't.
+        end = key.find(pattern.delimiter,
+                       pattern.allow_empty || pattern.excludes_delimiter ? 0
+                                                                         : 1);
+        break;
+      case SimplePattern::Kind::kBeforeLastDelimiter:
+        end = key.rfind(pattern.delimiter);
+        break;
+    }
+    if (end == 0 && !pattern.allow_empty) {
+      end = std::string_view::npos;
+    }
+    if (end == std::string_view::npos) {
+      return std::nullopt;
+    }
+    return key.substr(0, end);
+  }
+  std::match_results<std::string_view::const_iterator> match_result;
+  if (!std::regex_match(key.begin(), key.end(), match_result,
+                        *shard_key_regex_)) {
+    return std::nullopt;
+  }
+  if (match_result.size() < 2 || !match_result[1].matched) {
+    return std::string_view();
+  }
+  return key.substr(match_result[1].first - key.begin(),
+                    match_result[1].length());
+}
+
+std::string_view KeySharder::GetShardingKey(std::string_view key) const {
+  if (shard_key_regex_ == nullptr) {
+    return key;
+  }
+  return MatchShardingKey(key).value_or(key);
+}
+
+int KeySharder::NumHashedShards(int num_shards) const {
+  return logical_shard_mapping_ != nullptr
+             ? logical_shard_mapping_->num_logical_shards()
+             : num_shards;
+}
 
 Shard KeySharder::GetShardNumForKey(std::string_view key,
                                     int num_shards) const {
-  if (shard_key_regex_.has_value()) {
-    std::smatch match_result;
-    // regex doesn't support string_view yet, though there is a proposal
-    auto key_string = std::string(key);
-    if (std::regex_match(key_string, match_result, shard_key_regex_.value())) {
-      // match result doesn't implicitly convert to std::string_view, and we
-      // also need to return it, so that the caller can log it.
-      std::string sharding_key = std::move(match_result[1]);
-      return Shard{.shard_num = sharding_function_.GetShardNumForKey(
-                       sharding_key, num_shards),
-                   .sharding_key = std::move(sharding_key)};
-    }
-  }
-  return Shard{.shard_num =
-                   sharding_function_.GetShardNumForKey(key, num_shards)};
+  std::optional<std::string_view> sharding_key;
+  if (shard_key_regex_ != nullptr) {
+    sharding_key = MatchShardingKey(key);
+  }
+  Shard shard{.shard_num = sharding_function_.GetShardNumForKey(
+                  sharding_key.value_or(key), NumHashedShards(num_shards))};
+  if (sharding_key.has_value()) {
+    shard.sharding_key = std::string(*sharding_key);
+  }
+  if (logical_shard_mapping_ != nullptr) {
+    shard.shard_num =
+        logical_shard_mapping_->GetPhysicalShard(shard.shard_num, num_shards);
+  }
+  return shard;
+}
+
+void KeySharder::GetShardNumsForKeys(absl::Span<const std::string_view> keys,
+                                     int num_shards,
+                                     absl::Span<int> shard_nums) const {
+  const int num_hashed_shards = NumHashedShards(num_shards);
+  if (shard_key_regex_ == nullptr) {
+    sharding_function_.GetShardNumsForKeys(keys, num_hashed_shards,
+                                           shard_nums);
+  } else {
+    // The sharding keys are parts of the keys, so they don't need copies.
+    std::vector<std::string_view> sharding_keys;
+    sharding_keys.reserve(keys.size());
+    for (const std::string_view key : keys) {
+      sharding_keys.push_back(MatchShardingKey(key).value_or(key));
+    }
+    sharding_function_.GetShardNumsForKeys(sharding_keys, num_hashed_shards,
+                                           shard_nums);
+  }
+  if (logical_shard_mapping_ != nullptr) {
+    for (int& shard_num : shard_nums) {
+      shard_num = logical_shard_mapping_->GetPhysicalShard(shard_num,
+                                                           num_shards);
+    }
+  }
+}
+
+std::optional<int> KeySharder::GetSingleShardForKeys(
+    absl::Span<const std::string_view> keys, int num_shards) const {
+  if (keys.empty()) {
+    return std::nullopt;
+  }
+  std::vector<int> shard_nums(keys.size());
+  GetShardNumsForKeys(keys, num_shards, absl::MakeSpan(shard_nums));
+  for (const int shard_num : shard_nums) {
+    if (shard_num != shard_nums.front()) {
+      return std::nullopt;
+    }
+  }
+  return shard_nums.front();
+}
+
+bool KeySharder::IsKeyLoadedByShard(std::string_view key, int num_shards,
+                                    int shard_num) const {
+  const int hashed_shard_num = sharding_function_.GetShardNumForKey(
+      GetShardingKey(key), NumHashedShards(num_shards));
+  if (logical_shard_mapping_ == nullptr) {
+    return hashed_shard_num == shard_num;
+  }
+  return logical_shard_mapping_->IsLoadedBy(hashed_shard_num, shard_num,
+                                            num_shards);
 }
 
 }  // namespace kv_server
@@ -17,11 +17,14 @@
 #ifndef PUBLIC_SHARDING_KEY_SHARDER_H_
 #define PUBLIC_SHARDING_KEY_SHARDER_H_
 
+#include <memory>
 #include <optional>
 #include <regex>
 #include <string>
 #include <string_view>
 
+#include "absl/types/span.h"
+#include "public/sharding/logical_shard_mapping.h"
 #include "public/sharding/sharding_function.h"
 
 namespace kv_server {
@@ -42,20 +45,94 @@ class KeySharder {
  public:
   // Constructs a key sharder that would calculate a shard number.
   // If `shard_key_regex` is set, data locality logic is applied during the
-  // calculation.
-  explicit KeySharder(ShardingFunction sharding_function,
-                      std::optional<std::regex> shard_key_regex = std::nullopt);
+  // calculation. The regex is compiled once and shared by the copies of the
+  // sharder. Throws `std::regex_error` if it's not a valid ECMAScript regex.
+  // If `num_logical_shards` is positive, keys are hashed into that many
+  // logical shards, which are mapped onto the physical shards by a
+  // `LogicalShardMapping` shared by the copies of the sharder.
+  explicit KeySharder(
+      ShardingFunction sharding_function,
+      std::optional<std::string_view> shard_key_regex = std::nullopt,
+      int num_logical_shards = 0);
   // Get a shard number for the given key.
   // If `shard_key_regex` is set, data locality logic is applied during the
   // calculation. Specifically, it would apply the regex to the key specified in
   // `GetShardNumForKey`. If there is a match, that would be treated as the
   // sharding key. Otherwise, the key itself is treated as the sharding
-  // key.
+  // key. With logical shards, the shard number is the physical shard serving
+  // the logical shard of the key.
   Shard GetShardNumForKey(std::string_view key, int num_shards) const;
+  // Same as `GetShardNumForKey` for each of `keys`, with the shard number of
+  // `keys[i]` written to `shard_nums[i]`. The sharding keys are hashed as one
+  // batch.
+  void GetShardNumsForKeys(absl::Span<const std::string_view> keys,
+                           int num_shards, absl::Span<int> shard_nums) const;
+  // Returns the shard that all of `keys` are sharded to, or nothing if they
+  // are sharded to more than one shard or there are none. A request for such
+  // keys needs no lookups from other shards if it's sent to that shard.
+  std::optional<int> GetSingleShardForKeys(
+      absl::Span<const std::string_view> keys, int num_shards) const;
+  // Whether shard `shard_num` loads the records of `key`. Same as whether
+  // `key` is sharded to it, unless the logical shard of `key` is being moved
+  // to it.
+  bool IsKeyLoadedByShard(std::string_view key, int num_shards,
+                          int shard_num) const;
+  // Whether keys are sharded by the part matched by `shard_key_regex` rather
+  // than by the whole key.
+  bool HasShardKeyRegex() const { return shard_key_regex_ != nullptr; }
+  // Whether `shard_key_regex` is simple enough for the sharding keys to be
+  // extracted without evaluating it.
+  bool HasSimpleShardKeyRegex() const { return simple_pattern_.has_value(); }
+  // Whether keys are hashed into logical shards, which are mapped onto the
+  // physical shards.
+  bool HasLogicalShards() const { return logical_shard_mapping_ != nullptr; }
+  // The mapping of the logical shards, null without logical shards. Shared by
+  // the copies of the sharder, so changes apply to all of them.
+  LogicalShardMapping* logical_shard_mapping() const {
+    return logical_shard_mapping_.get();
+  }
+  ShardingHashVersion hash_version() const {
+    return sharding_function_.hash_version();
+  }
 
  private:
+  // A `shard_key_regex` whose match can be found with string searches. The
+  // sharding key is the part of the key before a `delimiter` followed by
+  // `.*`, e.g. `([^_]*)_.*` or `(.*)::.*`, or the first `prefix_length`
+  // characters of the key, `(.{4}).*`.
+  struct SimplePattern {
+    enum class Kind {
+      // `([^d]*)d.*`, `([^d]+)d.*`, `(.*?)d.*` and `(.+?)d.*`.
+      kBeforeFirstDelimiter,
+      // `(.*)d.*` and `(.+)d.*`.
+      kBeforeLastDelimiter,
+      // `(.{n}).*`.
+      kPrefix,
+    };
+    Kind kind;
+    std::string delimiter;
+    // Whether the sharding key may be empty, `*` rather than `+`.
+    bool allow_empty = true;
+    // Whether the sharding key can't hold the delimiter, `[^d]`.
+    bool excludes_delimiter = false;
+    int prefix_length = 0;
+  };
+
+  // Returns the pattern of `regex` if it's simple.
+  static std::optional<SimplePattern> ParseSimplePattern(
+      std::string_view regex);
+  // Returns the part of `key` captured by `shard_key_regex`, if it matches.
+  std::optional<std::string_view> MatchShardingKey(std::string_view key) const;
+  // Returns the key that `key` is sharded by.
+  std::string_view GetShardingKey(std::string_view key) const;
+  // Returns the number of shards that keys are hashed into, the number of
+  // logical shards if there are any.
+  int NumHashedShards(int num_shards) const;
+
   ShardingFunction sharding_function_;
-  std::optional<std::regex> shard_key_regex_;
+  std::shared_ptr<const std::regex> shard_key_regex_;
+  std::optional<SimplePattern> simple_pattern_;
+  std::shared_ptr<LogicalShardMapping> logical_shard_mapping_;
 };
 
 }  // namespace kv_server
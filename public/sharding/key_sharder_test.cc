@@ -16,6 +16,11 @@
 
 #include "public/sharding/key_sharder.h"
 
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+
 #include "gtest/gtest.h"
 
 namespace kv_server {
@@ -27,11 +32,13 @@ TEST(KeySharderTest, VerifyAssigningKeysToShards) {
   EXPECT_EQ(5, key_sharder.GetShardNumForKey("key1", 7).shard_num);
   EXPECT_EQ(6, key_sharder.GetShardNumForKey("key2", 7).shard_num);
   EXPECT_EQ(1, key_sharder.GetShardNumForKey("key3", 7).shard_num);
+  EXPECT_FALSE(key_sharder.HasShardKeyRegex());
 }
 
 TEST(KeySharderTest, VerifyAssigningKeysToShardsWithRegex) {
   ShardingFunction func("");
-  KeySharder key_sharder(func, std::regex("(.*)_.*"));
+  KeySharder key_sharder(func, "(.*)_.*");
+  EXPECT_TRUE(key_sharder.HasShardKeyRegex());
   auto result = key_sharder.GetShardNumForKey("key1_blah", 7);
   EXPECT_EQ(5, result.shard_num);
   EXPECT_EQ("key1", result.sharding_key);
@@ -47,7 +54,93 @@ TEST(KeySharderTest, VerifyAssigningKeysToShardsWithRegex) {
   EXPECT_EQ(1, key_sharder.GetShardNumForKey("key3", 7).shard_num);
 }
 
+TEST(KeySharderTest, BatchMatchesSingleKeysWithRegex) {
+  KeySharder key_sharder(ShardingFunction(""), "(.*)_.*");
+  const std::vector<std::string_view> keys = {"key1_blah", "key2", "key3"};
+  std::vector<int> shard_nums(keys.size());
+  key_sharder.GetShardNumsForKeys(keys, 7, absl::MakeSpan(shard_nums));
+  EXPECT_EQ(shard_nums, std::vector<int>({5, 6, 1}));
+}
+
+TEST(KeySharderTest, SingleShardOfKeys) {
+  KeySharder key_sharder(ShardingFunction(""), "(.*)_.*");
+  EXPECT_EQ(key_sharder.GetSingleShardForKeys({"key1_a", "key1_b", "key1"}, 7),
+            5);
+  EXPECT_FALSE(
+      key_sharder.GetSingleShardForKeys({"key1_a", "key2"}, 7).has_value());
+  EXPECT_FALSE(key_sharder.GetSingleShardForKeys({}, 7).has_value());
+}
+
+TEST(KeySharderTest, SimplePatternsMatchLikeTheRegex) {
+  const std::vector<std::string> keys = {
+      "", "_", "__", "key1", "key1_", "_key1", "k_1_", "k__1", "k_1_2_3",
+      "key1_blah", "key1::a", "::a::b", "a::", "ab", "abcd", "abcde",
+      "key1|blah", "k\\n1_", "ab\ncd", "key\n1_2", "key1_\nb", "key1_blah\r"};
+  for (const std::string pattern :
+       {"(.*)_.*", "(.+)_.*", "(.*?)_.*", "(.+?)_.*", "([^_]*)_.*",
+        "([^_]+)_.*", "(.*)::.*", "(.+?)::.*", "([^\\|]*)\\|.*",
+        "(.{4}).*", "(.{0}).*"}) {
+    KeySharder key_sharder(ShardingFunction(""), pattern);
+    EXPECT_TRUE(key_sharder.HasSimpleShardKeyRegex()) << pattern;
+    const std::regex regex(pattern);
+    for (const auto& key : keys) {
+      std::smatch match_result;
+      const std::string expected_sharding_key =
+          std::regex_match(key, match_result, regex) ? match_result[1].str()
+                                                     : "";
+      EXPECT_EQ(key_sharder.GetShardNumForKey(key, 7).sharding_key,
+                expected_sharding_key)
+          << "pattern: " << pattern << ", key: " << key;
+    }
+  }
+}
+
+TEST(KeySharderTest, OtherPatternsAreEvaluated) {
+  for (const std::string pattern :
+       {"(.*)_", "(.*)_.+", "([a-z]*)_.*", "(.*)\\d.*", "([^_]*)-.*",
+        "([^_-]*)_.*", "(.*).*"}) {
+    EXPECT_FALSE(KeySharder(ShardingFunction(""), pattern)
+                     .HasSimpleShardKeyRegex())
+        << pattern;
+  }
+  KeySharder key_sharder(ShardingFunction(""), "([a-z]*)[0-9]_.*");
+  EXPECT_EQ(key_sharder.GetShardNumForKey("key1_blah", 7).sharding_key,
+            "key");
+}
+
 // try with regex which doesn't match
 
+TEST(KeySharderTest, LogicalShardsAreMappedOntoPhysicalShards) {
+  // "key1", "key2" and "key3" hash into logical shards 5, 6 and 1.
+  KeySharder key_sharder(ShardingFunction(""), /*shard_key_regex=*/std::nullopt,
+                         /*num_logical_shards=*/7);
+  const KeySharder copy = key_sharder;
+  ASSERT_TRUE(key_sharder.HasLogicalShards());
+  EXPECT_EQ(2, key_sharder.GetShardNumForKey("key1", 3).shard_num);
+  EXPECT_EQ(0, key_sharder.GetShardNumForKey("key2", 3).shard_num);
+  EXPECT_EQ(1, key_sharder.GetShardNumForKey("key3", 3).shard_num);
+
+  // Staged, physical shard 0 loads logical shard 5 but lookups still go to
+  // physical shard 2.
+  ASSERT_TRUE(
+      key_sharder.logical_shard_mapping()->Apply(5, 0, /*staged=*/true).ok());
+  EXPECT_EQ(2, copy.GetShardNumForKey("key1", 3).shard_num);
+  EXPECT_TRUE(copy.IsKeyLoadedByShard("key1", 3, 0));
+  EXPECT_FALSE(copy.IsKeyLoadedByShard("key1", 3, 1));
+  EXPECT_TRUE(copy.IsKeyLoadedByShard("key1", 3, 2));
+
+  // Cut over.
+  ASSERT_TRUE(
+      key_sharder.logical_shard_mapping()->Apply(5, 0, /*staged=*/false).ok());
+  EXPECT_EQ(0, copy.GetShardNumForKey("key1", 3).shard_num);
+  EXPECT_TRUE(copy.IsKeyLoadedByShard("key1", 3, 0));
+  EXPECT_FALSE(copy.IsKeyLoadedByShard("key1", 3, 2));
+
+  const std::vector<std::string_view> keys = {"key1", "key2", "key3"};
+  std::vector<int> shard_nums(keys.size());
+  copy.GetShardNumsForKeys(keys, 3, absl::MakeSpan(shard_nums));
+  EXPECT_EQ(shard_nums, (std::vector<int>{0, 0, 1}));
+}
+
 }  // namespace
 }  // namespace kv_server
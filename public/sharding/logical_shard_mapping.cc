@@ -0,0 +1,95 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "public/sharding/logical_shard_mapping.h"
+
+#include "absl/log/log.h"
+#include "absl/strings/str_cat.h"
+
+namespace kv_server {
+
+LogicalShardMapping::LogicalShardMapping(int num_logical_shards)
+    : num_logical_shards_(num_logical_shards),
+      physical_shards_(
+          std::make_unique<std::atomic<int32_t>[]>(num_logical_shards)),
+      staged_physical_shards_(
+          std::make_unique<std::atomic<int32_t>[]>(num_logical_shards)) {
+  for (int i = 0; i < num_logical_shards_; ++i) {
+    physical_shards_[i].store(kUnassigned, std::memory_order_relaxed);
+    staged_physical_shards_[i].store(kUnassigned, std::memory_order_relaxed);
+  }
+}
+
+int LogicalShardMapping::GetPhysicalShard(int logical_shard,
+                                          int num_shards) const {
+  const int32_t physical_shard =
+      physical_shards_[logical_shard].load(std::memory_order_acquire);
+  if (physical_shard == kUnassigned || physical_shard >= num_shards) {
+    return logical_shard % num_shards;
+  }
+  return physical_shard;
+}
+
+bool LogicalShardMapping::IsLoadedBy(int logical_shard, int physical_shard,
+                                     int num_shards) const {
+  return GetPhysicalShard(logical_shard, num_shards) == physical_shard ||
+         staged_physical_shards_[logical_shard].load(
+             std::memory_order_acquire) == physical_shard;
+}
+
+absl::Status LogicalShardMapping::Apply(int logical_shard, int physical_shard,
+                                        bool staged) {
+  if (logical_shard < 0 || logical_shard >= num_logical_shards_) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Logical shard ", logical_shard, " is not in [0, ",
+                     num_logical_shards_, ")"));
+  }
+  if (physical_shard < 0) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Invalid physical shard ", physical_shard,
+                     " for logical shard ", logical_shard));
+  }
+  absl::MutexLock lock(&mu_);
+  if (physical_shards_[logical_shard].load(std::memory_order_relaxed) ==
+      physical_shard) {
+    return absl::OkStatus();
+  }
+  const bool is_staged =
+      staged_physical_shards_[logical_shard].load(std::memory_order_relaxed) ==
+      physical_shard;
+  if (staged) {
+    if (!is_staged) {
+      staged_physical_shards_[logical_shard].store(physical_shard,
+                                                   std::memory_order_release);
+      LOG(INFO) << "Staged logical shard " << logical_shard
+                << " for physical shard " << physical_shard;
+    }
+    return absl::OkStatus();
+  }
+  // The old physical shard stops loading the logical shard when lookups stop
+  // being routed to it. A move to another physical shard stays staged.
+  physical_shards_[logical_shard].store(physical_shard,
+                                        std::memory_order_release);
+  if (is_staged) {
+    staged_physical_shards_[logical_shard].store(kUnassigned,
+                                                 std::memory_order_release);
+  }
+  LOG(INFO) << "Cut over logical shard " << logical_shard
+            << " to physical shard " << physical_shard;
+  return absl::OkStatus();
+}
+
+}  // namespace kv_server
@@ -0,0 +1,82 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PUBLIC_SHARDING_LOGICAL_SHARD_MAPPING_H_
+#define PUBLIC_SHARDING_LOGICAL_SHARD_MAPPING_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/status/status.h"
+#include "absl/synchronization/mutex.h"
+
+namespace kv_server {
+
+// Maps the logical shards that keys are hashed into onto the physical shards
+// that serve them, so that the number of physical shards can change without
+// rehashing the keys. A logical shard without an assignment is served by
+// physical shard `logical_shard % num_shards`.
+//
+// Assignments are changed by `ShardMappingRecord`s, in two steps:
+// - A staged assignment of a logical shard to a new physical shard makes the
+//   new physical shard load the records of the logical shard in addition to
+//   its own, while lookups are still routed to the old one.
+// - An active assignment cuts it over, lookups are routed to the new physical
+//   shard from then on.
+// The data of the logical shard is migrated by loading it between the two.
+// Applying a record again changes nothing, so records may be read more than
+// once, e.g. from both a delta file and a realtime update.
+//
+// Thread-safe. Lookups don't take locks.
+class LogicalShardMapping {
+ public:
+  explicit LogicalShardMapping(int num_logical_shards);
+
+  LogicalShardMapping(const LogicalShardMapping&) = delete;
+  LogicalShardMapping& operator=(const LogicalShardMapping&) = delete;
+
+  int num_logical_shards() const { return num_logical_shards_; }
+
+  // Returns the physical shard that serves `logical_shard`, out of
+  // `num_shards` physical shards. Assignments to physical shards beyond
+  // `num_shards` are ignored.
+  int GetPhysicalShard(int logical_shard, int num_shards) const;
+
+  // Whether `physical_shard` loads the records of `logical_shard`, either
+  // because it serves it or because the logical shard is being moved to it.
+  bool IsLoadedBy(int logical_shard, int physical_shard, int num_shards) const;
+
+  // Applies a `ShardMappingRecord`, which either stages the assignment of
+  // `logical_shard` to `physical_shard` or makes it active. Staging the
+  // physical shard that already serves the logical shard changes nothing.
+  absl::Status Apply(int logical_shard, int physical_shard, bool staged)
+      ABSL_LOCKS_EXCLUDED(mu_);
+
+ private:
+  static constexpr int32_t kUnassigned = -1;
+
+  const int num_logical_shards_;
+  absl::Mutex mu_;
+  // Written under `mu_`, read without it.
+  std::unique_ptr<std::atomic<int32_t>[]> physical_shards_;
+  std::unique_ptr<std::atomic<int32_t>[]> staged_physical_shards_;
+};
+
+}  // namespace kv_server
+
+#endif  // PUBLIC_SHARDING_LOGICAL_SHARD_MAPPING_H_
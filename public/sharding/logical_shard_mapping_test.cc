@@ -0,0 +1,103 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "public/sharding/logical_shard_mapping.h"
+
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+TEST(LogicalShardMappingTest, UnassignedLogicalShardsAreSpreadOverShards) {
+  LogicalShardMapping mapping(/*num_logical_shards=*/8);
+  EXPECT_EQ(8, mapping.num_logical_shards());
+  for (int logical_shard = 0; logical_shard < 8; ++logical_shard) {
+    EXPECT_EQ(logical_shard % 3, mapping.GetPhysicalShard(logical_shard, 3));
+    EXPECT_TRUE(mapping.IsLoadedBy(logical_shard, logical_shard % 3, 3));
+    EXPECT_FALSE(mapping.IsLoadedBy(logical_shard, (logical_shard + 1) % 3, 3));
+  }
+}
+
+TEST(LogicalShardMappingTest, AssignmentIsStagedThenCutOver) {
+  LogicalShardMapping mapping(/*num_logical_shards=*/8);
+  ASSERT_TRUE(mapping.Apply(4, 2, /*staged=*/true).ok());
+  EXPECT_EQ(1, mapping.GetPhysicalShard(4, 3));
+  EXPECT_TRUE(mapping.IsLoadedBy(4, 1, 3));
+  EXPECT_TRUE(mapping.IsLoadedBy(4, 2, 3));
+
+  ASSERT_TRUE(mapping.Apply(4, 2, /*staged=*/false).ok());
+  EXPECT_EQ(2, mapping.GetPhysicalShard(4, 3));
+  EXPECT_FALSE(mapping.IsLoadedBy(4, 1, 3));
+  EXPECT_TRUE(mapping.IsLoadedBy(4, 2, 3));
+}
+
+TEST(LogicalShardMappingTest, RepeatedRecordsChangeNothing) {
+  LogicalShardMapping mapping(/*num_logical_shards=*/8);
+  // A staged record read twice, e.g. from a delta file and a realtime update,
+  // doesn't cut the assignment over.
+  ASSERT_TRUE(mapping.Apply(4, 2, /*staged=*/true).ok());
+  ASSERT_TRUE(mapping.Apply(4, 2, /*staged=*/true).ok());
+  EXPECT_EQ(1, mapping.GetPhysicalShard(4, 3));
+  EXPECT_TRUE(mapping.IsLoadedBy(4, 2, 3));
+
+  ASSERT_TRUE(mapping.Apply(4, 2, /*staged=*/false).ok());
+  ASSERT_TRUE(mapping.Apply(4, 2, /*staged=*/false).ok());
+  // Staging the active physical shard again doesn't undo the cutover.
+  ASSERT_TRUE(mapping.Apply(4, 2, /*staged=*/true).ok());
+  EXPECT_EQ(2, mapping.GetPhysicalShard(4, 3));
+  EXPECT_FALSE(mapping.IsLoadedBy(4, 1, 3));
+}
+
+TEST(LogicalShardMappingTest, ActiveAssignmentNeedsNoStaging) {
+  LogicalShardMapping mapping(/*num_logical_shards=*/8);
+  ASSERT_TRUE(mapping.Apply(4, 2, /*staged=*/false).ok());
+  EXPECT_EQ(2, mapping.GetPhysicalShard(4, 3));
+  EXPECT_FALSE(mapping.IsLoadedBy(4, 1, 3));
+}
+
+TEST(LogicalShardMappingTest, StagingAnotherShardReplacesTheStagedOne) {
+  LogicalShardMapping mapping(/*num_logical_shards=*/8);
+  ASSERT_TRUE(mapping.Apply(4, 2, /*staged=*/true).ok());
+  ASSERT_TRUE(mapping.Apply(4, 0, /*staged=*/true).ok());
+  EXPECT_FALSE(mapping.IsLoadedBy(4, 2, 3));
+  EXPECT_TRUE(mapping.IsLoadedBy(4, 0, 3));
+  EXPECT_EQ(1, mapping.GetPhysicalShard(4, 3));
+}
+
+TEST(LogicalShardMappingTest, CutOverKeepsAnotherStagedShard) {
+  LogicalShardMapping mapping(/*num_logical_shards=*/8);
+  ASSERT_TRUE(mapping.Apply(4, 0, /*staged=*/true).ok());
+  ASSERT_TRUE(mapping.Apply(4, 2, /*staged=*/false).ok());
+  EXPECT_EQ(2, mapping.GetPhysicalShard(4, 3));
+  EXPECT_TRUE(mapping.IsLoadedBy(4, 0, 3));
+}
+
+TEST(LogicalShardMappingTest, AssignmentsBeyondTheShardsAreIgnored) {
+  LogicalShardMapping mapping(/*num_logical_shards=*/8);
+  ASSERT_TRUE(mapping.Apply(4, 5, /*staged=*/false).ok());
+  EXPECT_EQ(5, mapping.GetPhysicalShard(4, 6));
+  EXPECT_EQ(1, mapping.GetPhysicalShard(4, 3));
+}
+
+TEST(LogicalShardMappingTest, InvalidShardsAreRejected) {
+  LogicalShardMapping mapping(/*num_logical_shards=*/8);
+  EXPECT_FALSE(mapping.Apply(-1, 0, /*staged=*/false).ok());
+  EXPECT_FALSE(mapping.Apply(8, 0, /*staged=*/false).ok());
+  EXPECT_FALSE(mapping.Apply(0, -1, /*staged=*/false).ok());
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -16,14 +16,88 @@
 
 #include "public/sharding/sharding_function.h"
 
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+#include "absl/log/check.h"
+#include "absl/numeric/int128.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "highwayhash/highwayhash_target.h"
+#include "highwayhash/instruction_sets.h"
+
 namespace kv_server {
+namespace {
+
+using highwayhash::HHKey;
+using highwayhash::HHResult256;
+using highwayhash::HHResult64;
+using highwayhash::HighwayHash;
+using highwayhash::InstructionSets;
+
+// Fixed key that seeds are hashed with to derive the key of the hash.
+alignas(32) constexpr HHKey kSeedHashKey = {
+    0x6b76736861726431ULL, 0x9e3779b97f4a7c15ULL, 0xbf58476d1ce4e5b9ULL,
+    0x94d049bb133111ebULL};
+
+void DeriveHighwayHashKey(std::string_view seed, HHKey& key) {
+  HHResult256 result;
+  InstructionSets::Run<HighwayHash>(kSeedHashKey, seed.data(), seed.size(),
+                                    &result);
+  std::copy(std::begin(result), std::end(result), std::begin(key));
+}
+
+int HighwayHashShardNum(const HHKey& hash_key, std::string_view key,
+                        int num_shards) {
+  HHResult64 hash;
+  InstructionSets::Run<HighwayHash>(hash_key, key.data(), key.size(), &hash);
+  // Maps the hash onto [0, num_shards) with a multiplication instead of the
+  // slower modulo.
+  return static_cast<int>(absl::Uint128High64(
+      absl::uint128(hash) * static_cast<uint64_t>(num_shards)));
+}
+
+}  // namespace
 
-ShardingFunction::ShardingFunction(std::string seed)
-    : hash_function_(std::move(seed)) {}
+absl::StatusOr<ShardingHashVersion> ToShardingHashVersion(int32_t version) {
+  switch (static_cast<ShardingHashVersion>(version)) {
+    case ShardingHashVersion::kSha256:
+    case ShardingHashVersion::kHighwayHash:
+      return static_cast<ShardingHashVersion>(version);
+  }
+  return absl::InvalidArgumentError(
+      absl::StrCat("Unknown sharding hash version: ", version));
+}
+
+ShardingFunction::ShardingFunction(std::string seed,
+                                   ShardingHashVersion hash_version)
+    : hash_version_(hash_version), hash_function_(seed) {
+  DeriveHighwayHashKey(seed, highway_hash_key_);
+}
 
 int ShardingFunction::GetShardNumForKey(std::string_view key,
                                         int num_shards) const {
+  if (hash_version_ == ShardingHashVersion::kHighwayHash) {
+    return HighwayHashShardNum(highway_hash_key_, key, num_shards);
+  }
   return hash_function_(key, num_shards);
 }
 
+void ShardingFunction::GetShardNumsForKeys(
+    absl::Span<const std::string_view> keys, int num_shards,
+    absl::Span<int> shard_nums) const {
+  CHECK_EQ(keys.size(), shard_nums.size());
+  if (hash_version_ == ShardingHashVersion::kHighwayHash) {
+    for (size_t i = 0; i < keys.size(); ++i) {
+      shard_nums[i] =
+          HighwayHashShardNum(highway_hash_key_, keys[i], num_shards);
+    }
+    return;
+  }
+  for (size_t i = 0; i < keys.size(); ++i) {
+    shard_nums[i] = hash_function_(keys[i], num_shards);
+  }
+}
+
 }  // namespace kv_server
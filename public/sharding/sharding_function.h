@@ -20,19 +20,47 @@
 #include <string>
 #include <string_view>
 
+#include "absl/status/statusor.h"
+#include "absl/types/span.h"
+#include "highwayhash/hh_types.h"
 #include "pir/hashing/sha256_hash_family.h"
 
 namespace kv_server {
 
+// Version of the hash that keys are sharded with. Recorded in the metadata of
+// the files sharded with it, so values must never be reused.
+enum class ShardingHashVersion : int32_t {
+  // SHA-256 of the seed and the key.
+  kSha256 = 0,
+  // HighwayHash of the key, keyed by the seed. Several times cheaper than
+  // SHA-256, but assigns keys to different shards.
+  kHighwayHash = 1,
+};
+
+// Returns the hash version of a `sharding-hash-version` parameter value.
+absl::StatusOr<ShardingHashVersion> ToShardingHashVersion(int32_t version);
+
 // Sharding function to assign different keys to shard numbers within the range
 // [0, `num_shards`).
 class ShardingFunction {
  public:
-  explicit ShardingFunction(std::string seed);
+  explicit ShardingFunction(
+      std::string seed,
+      ShardingHashVersion hash_version = ShardingHashVersion::kSha256);
   int GetShardNumForKey(std::string_view key, int num_shards) const;
+  // Same as `GetShardNumForKey` for each of `keys`, with the shard of
+  // `keys[i]` written to `shard_nums[i]`. `shard_nums` must be as long as
+  // `keys`. Cheaper per key than single calls, since the hash version is
+  // dispatched on once for the whole batch.
+  void GetShardNumsForKeys(absl::Span<const std::string_view> keys,
+                           int num_shards, absl::Span<int> shard_nums) const;
+  ShardingHashVersion hash_version() const { return hash_version_; }
 
  private:
+  ShardingHashVersion hash_version_;
   distributed_point_functions::SHA256HashFunction hash_function_;
+  // The HighwayHash key derived from the seed.
+  alignas(32) highwayhash::HHKey highway_hash_key_;
 };
 
 }  // namespace kv_server
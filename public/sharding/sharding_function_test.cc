@@ -16,6 +16,11 @@
 
 #include "public/sharding/sharding_function.h"
 
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
 #include "gtest/gtest.h"
 
 namespace kv_server {
@@ -28,5 +33,60 @@ TEST(ShardingFunctionTest, VerifyAssigningKeysToShards) {
   EXPECT_EQ(1, func.GetShardNumForKey("key3", 7));
 }
 
+TEST(ShardingFunctionTest, HighwayHashAssignsKeysToAllShards) {
+  ShardingFunction func("", ShardingHashVersion::kHighwayHash);
+  constexpr int kNumShards = 7;
+  std::vector<int> num_keys(kNumShards);
+  for (int i = 0; i < 7000; ++i) {
+    const int shard_num =
+        func.GetShardNumForKey(absl::StrCat("key", i), kNumShards);
+    ASSERT_GE(shard_num, 0);
+    ASSERT_LT(shard_num, kNumShards);
+    ++num_keys[shard_num];
+  }
+  for (int shard_num = 0; shard_num < kNumShards; ++shard_num) {
+    EXPECT_GT(num_keys[shard_num], 800) << "shard " << shard_num;
+  }
+}
+
+TEST(ShardingFunctionTest, HighwayHashIsKeyedBySeed) {
+  ShardingFunction func("seed1", ShardingHashVersion::kHighwayHash);
+  ShardingFunction same_seed_func("seed1", ShardingHashVersion::kHighwayHash);
+  ShardingFunction other_seed_func("seed2", ShardingHashVersion::kHighwayHash);
+  int num_moved_keys = 0;
+  for (int i = 0; i < 100; ++i) {
+    const std::string key = absl::StrCat("key", i);
+    EXPECT_EQ(func.GetShardNumForKey(key, 1000),
+              same_seed_func.GetShardNumForKey(key, 1000));
+    if (func.GetShardNumForKey(key, 1000) !=
+        other_seed_func.GetShardNumForKey(key, 1000)) {
+      ++num_moved_keys;
+    }
+  }
+  EXPECT_GT(num_moved_keys, 90);
+}
+
+TEST(ShardingFunctionTest, BatchMatchesSingleKeys) {
+  for (const auto hash_version :
+       {ShardingHashVersion::kSha256, ShardingHashVersion::kHighwayHash}) {
+    ShardingFunction func("", hash_version);
+    std::vector<std::string> keys;
+    for (int i = 0; i < 100; ++i) {
+      keys.push_back(absl::StrCat("key", i));
+    }
+    const std::vector<std::string_view> key_views(keys.begin(), keys.end());
+    std::vector<int> shard_nums(keys.size());
+    func.GetShardNumsForKeys(key_views, 7, absl::MakeSpan(shard_nums));
+    for (size_t i = 0; i < keys.size(); ++i) {
+      EXPECT_EQ(shard_nums[i], func.GetShardNumForKey(keys[i], 7));
+    }
+  }
+}
+
+TEST(ShardingFunctionTest, UnknownHashVersionIsRejected) {
+  EXPECT_EQ(*ToShardingHashVersion(1), ShardingHashVersion::kHighwayHash);
+  EXPECT_FALSE(ToShardingHashVersion(2).ok());
+}
+
 }  // namespace
 }  // namespace kv_server
@@ -0,0 +1,129 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PUBLIC_UDF_FLAT_GET_VALUES_H_
+#define PUBLIC_UDF_FLAT_GET_VALUES_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string_view>
+
+namespace kv_server {
+
+// Layout of the output of the `getValuesFlat` UDF hook, the results of a
+// lookup in one buffer that a UDF reads in place, without parsing it, once it
+// is in its memory. A WASM UDF copies the output of the hook straight into a
+// buffer of its linear memory, which it can reuse across calls, and reads it
+// through `FlatGetValuesView`.
+//
+// All integers are little-endian uint32, and all offsets are from the start of
+// the buffer:
+//
+//   header:  magic, status code, status message offset, status message size,
+//            number of entries
+//   entries: for each key, key offset, key size, value offset, value size and
+//            status code, which is 0 if the key has a value, and the code of
+//            the error otherwise, such as 5 (not found)
+//   bytes:   the keys, values and status message the offsets point into
+//
+// A lookup that fails as a whole has a nonzero status code and no entries.
+inline constexpr uint32_t kFlatGetValuesMagic = 0x3146564b;  // "KVF1"
+inline constexpr size_t kFlatGetValuesHeaderSize = 5 * sizeof(uint32_t);
+inline constexpr size_t kFlatGetValuesEntrySize = 5 * sizeof(uint32_t);
+
+// Read-only view of the output of `getValuesFlat`.
+class FlatGetValuesView {
+ public:
+  struct Entry {
+    std::string_view key;
+    // Empty unless `status_code` is 0.
+    std::string_view value;
+    uint32_t status_code = 0;
+  };
+
+  // Returns a view of `bytes`, or nullopt if they aren't in the flat layout.
+  // The bounds of every entry are checked here, once, so that reading an
+  // entry is a few loads. `bytes` must outlive the view.
+  static std::optional<FlatGetValuesView> Create(std::string_view bytes) {
+    if (bytes.size() < kFlatGetValuesHeaderSize) {
+      return std::nullopt;
+    }
+    FlatGetValuesView view(bytes);
+    if (view.Load(0) != kFlatGetValuesMagic ||
+        !view.InBounds(view.Load(2), view.Load(3))) {
+      return std::nullopt;
+    }
+    const size_t size = view.size();
+    if (size > (bytes.size() - kFlatGetValuesHeaderSize) /
+                   kFlatGetValuesEntrySize) {
+      return std::nullopt;
+    }
+    for (size_t i = 0; i < size; ++i) {
+      const size_t entry = EntryIndex(i);
+      if (!view.InBounds(view.Load(entry), view.Load(entry + 1)) ||
+          !view.InBounds(view.Load(entry + 2), view.Load(entry + 3))) {
+        return std::nullopt;
+      }
+    }
+    return view;
+  }
+
+  // Status of the lookup as a whole.
+  uint32_t status_code() const { return Load(1); }
+  std::string_view status_message() const { return Bytes(Load(2), Load(3)); }
+
+  // Number of entries, one for each key looked up.
+  size_t size() const { return Load(4); }
+
+  // Requires `i < size()`.
+  Entry entry(size_t i) const {
+    const size_t entry = EntryIndex(i);
+    return {.key = Bytes(Load(entry), Load(entry + 1)),
+            .value = Bytes(Load(entry + 2), Load(entry + 3)),
+            .status_code = Load(entry + 4)};
+  }
+
+ private:
+  explicit FlatGetValuesView(std::string_view bytes) : bytes_(bytes) {}
+
+  // Index of the first integer of the `i`th entry.
+  static size_t EntryIndex(size_t i) {
+    return (kFlatGetValuesHeaderSize + i * kFlatGetValuesEntrySize) /
+           sizeof(uint32_t);
+  }
+
+  // Loads the `index`th integer of the buffer.
+  uint32_t Load(size_t index) const {
+    uint32_t value;
+    std::memcpy(&value, bytes_.data() + index * sizeof(uint32_t),
+                sizeof(value));
+    return value;
+  }
+
+  bool InBounds(uint32_t offset, uint32_t size) const {
+    return offset <= bytes_.size() && size <= bytes_.size() - offset;
+  }
+
+  std::string_view Bytes(uint32_t offset, uint32_t size) const {
+    return bytes_.substr(offset, size);
+  }
+
+  std::string_view bytes_;
+};
+
+}  // namespace kv_server
+
+#endif  // PUBLIC_UDF_FLAT_GET_VALUES_H_
@@ -0,0 +1,83 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "public/udf/flat_get_values.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+// Builds the flat layout of an ok lookup of `key` with `value`.
+std::string OneEntryBuffer(std::string_view key, std::string_view value) {
+  const uint32_t bytes_offset =
+      kFlatGetValuesHeaderSize + kFlatGetValuesEntrySize;
+  const std::vector<uint32_t> integers = {
+      kFlatGetValuesMagic,
+      0,
+      bytes_offset,
+      0,
+      1,
+      bytes_offset,
+      static_cast<uint32_t>(key.size()),
+      static_cast<uint32_t>(bytes_offset + key.size()),
+      static_cast<uint32_t>(value.size()),
+      0};
+  std::string buffer(integers.size() * sizeof(uint32_t), '\0');
+  std::memcpy(buffer.data(), integers.data(), buffer.size());
+  buffer.append(key);
+  buffer.append(value);
+  return buffer;
+}
+
+TEST(FlatGetValuesViewTest, ReadsEntries) {
+  const std::string buffer = OneEntryBuffer("key1", "value1");
+  const auto view = FlatGetValuesView::Create(buffer);
+  ASSERT_TRUE(view.has_value());
+  EXPECT_EQ(view->status_code(), 0);
+  EXPECT_EQ(view->status_message(), "");
+  ASSERT_EQ(view->size(), 1);
+  EXPECT_EQ(view->entry(0).key, "key1");
+  EXPECT_EQ(view->entry(0).value, "value1");
+  EXPECT_EQ(view->entry(0).status_code, 0);
+}
+
+TEST(FlatGetValuesViewTest, RejectsBytesInAnotherLayout) {
+  EXPECT_FALSE(FlatGetValuesView::Create("").has_value());
+  std::string buffer = OneEntryBuffer("key1", "value1");
+  buffer[0] = 'X';
+  EXPECT_FALSE(FlatGetValuesView::Create(buffer).has_value());
+}
+
+TEST(FlatGetValuesViewTest, RejectsEntriesOutOfBounds) {
+  const std::string buffer = OneEntryBuffer("key1", "value1");
+  // The value is cut short.
+  EXPECT_FALSE(FlatGetValuesView::Create(
+                   std::string_view(buffer).substr(0, buffer.size() - 1))
+                   .has_value());
+  // More entries than fit in the buffer.
+  std::string too_many_entries = buffer;
+  const uint32_t num_entries = 1000;
+  std::memcpy(too_many_entries.data() + 4 * sizeof(uint32_t), &num_entries,
+              sizeof(num_entries));
+  EXPECT_FALSE(FlatGetValuesView::Create(too_many_entries).has_value());
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -15,12 +15,15 @@
  */
 
 #include <fstream>
+#include <functional>
 #include <string>
+#include <utility>
 
 #include "absl/flags/flag.h"
 #include "absl/flags/parse.h"
 #include "absl/flags/usage.h"
 #include "absl/log/log.h"
+#include "absl/status/status.h"
 #include "public/data_loading/filename_utils.h"
 
 #include "custom_audience_data_parser.h"
@@ -49,14 +52,54 @@ ABSL_FLAG(int64_t, logical_commit_time, absl::ToUnixMicros(absl::Now()),
 ABSL_FLAG(int, num_keys_per_batch, 50,
           "The number of keys in one batch of http request");
 
+ABSL_FLAG(int, max_concurrent_requests, 64,
+          "The maximum number of batch requests in flight");
+
+ABSL_FLAG(int, max_fetch_attempts, 3,
+          "The maximum number of attempts of a batch request whose transfer "
+          "fails or that gets a 429 or 5xx response");
+
 constexpr kv_server::KeyValueMutationType kMutationType =
     kv_server::KeyValueMutationType::Update;
 
 using kv_server::HttpValueRetriever;
-using Output = std::vector<absl::flat_hash_map<std::string, std::string>>;
 using SideLoadData =
     kv_server::tools::bidding_auction_data_generator::SideLoadData;
 
+// Retrieves the values of `keys` and writes them to a delta file as they
+// arrive.
+absl::Status WriteValues(
+    HttpValueRetriever& http_value_retriever,
+    const absl::flat_hash_set<std::string>& keys, const std::string& base_url,
+    const std::string& key_namespace,
+    std::function<void(kv_server::v1::GetValuesResponse&,
+                       absl::flat_hash_map<std::string, std::string>&)>
+        extractor,
+    bool need_encode, const std::string& delta_file_path,
+    int64_t logical_commit_time) {
+  std::ofstream o_fstream(delta_file_path);
+  auto writer = kv_server::DeltaKeyValueWriter::Create(o_fstream);
+  if (!writer.ok()) {
+    return writer.status();
+  }
+  if (absl::Status status = http_value_retriever.StreamValues(
+          keys, base_url, key_namespace, std::move(extractor), need_encode,
+          absl::GetFlag(FLAGS_num_keys_per_batch),
+          {.max_concurrent_requests =
+               absl::GetFlag(FLAGS_max_concurrent_requests),
+           .max_attempts = absl::GetFlag(FLAGS_max_fetch_attempts)},
+          [&writer, logical_commit_time](
+              const absl::flat_hash_map<std::string, std::string>&
+                  key_value_map) {
+            return (*writer)->WriteWithoutFlush(
+                key_value_map, logical_commit_time, kMutationType);
+          });
+      !status.ok()) {
+    return status;
+  }
+  return (*writer)->Flush();
+}
+
 int main(int argc, char** argv) {
   absl::SetProgramUsageMessage(absl::StrCat("Usage of the tool:\n", argv[0]));
   absl::ParseCommandLine(argc, argv);
@@ -100,74 +143,32 @@ int main(int argc, char** argv) {
   std::unique_ptr<HttpValueRetriever> http_value_retriever =
       HttpValueRetriever::Create(http_url_fetch_client);
 
-  const int num_keys_per_batch = absl::GetFlag(FLAGS_num_keys_per_batch);
-
   // retrieve buyer values from buyer keys
   LOG(INFO) << "Retrieving values for buyer keys of size "
             << custom_audience_names.size();
-  const absl::StatusOr<Output>& buyer_output =
-      http_value_retriever->RetrieveValues(
-          custom_audience_names, buyer_kv_base_url, "keys",
-          kv_server::GetDataExtractorForKeys(), false, num_keys_per_batch);
-  if (!buyer_output.ok()) {
-    LOG(ERROR) << "Unable to retrieve values for buyer keys. "
-               << buyer_output.status();
-
+  if (absl::Status status = WriteValues(
+          *http_value_retriever, custom_audience_names, buyer_kv_base_url,
+          "keys", kv_server::GetDataExtractorForKeys(), false,
+          absl::StrCat(absl::GetFlag(FLAGS_buyer_output_file_dir), "/",
+                       delta_file_name.value()),
+          logical_commit_time);
+      !status.ok()) {
+    LOG(ERROR) << "Unable to write values for buyer keys. " << status;
   } else {
-    // write buyer key value to the delta file
-    const std::string buyer_delta_file_path =
-        absl::StrCat(absl::GetFlag(FLAGS_buyer_output_file_dir), "/",
-                     delta_file_name.value());
-
-    std::ofstream o_fstream(buyer_delta_file_path);
-    std::ostream* o_stream = &o_fstream;
-    auto buyer_writer = kv_server::DeltaKeyValueWriter::Create(*o_stream);
-    if (!buyer_writer.ok()) {
-      LOG(ERROR) << "Unable to initialize delta writer for buyer. "
-                 << buyer_writer.status();
-    } else {
-      for (const auto& key_value_map : buyer_output.value()) {
-        if (absl::Status status = buyer_writer.value()->Write(
-                key_value_map, logical_commit_time, kMutationType);
-            !status.ok()) {
-          LOG(ERROR) << "Error in writing buyer delta file " << status;
-        }
-      }
-      LOG(INFO) << "Done writing buyer delta file with "
-                << buyer_output.value().size() << " key value maps";
-    }
+    LOG(INFO) << "Done writing buyer delta file";
   }
   LOG(INFO) << "Retrieving values for seller keys of size "
             << render_urls.size();
-  const absl::StatusOr<Output>& seller_output =
-      http_value_retriever->RetrieveValues(
-          render_urls, seller_kv_base_url, "renderUrls",
-          kv_server::GetDataExtractorForRenderUrls(), true, num_keys_per_batch);
-  if (!seller_output.ok()) {
-    LOG(ERROR) << "Unable to retrieve values for seller keys. "
-               << seller_output.status();
+  if (absl::Status status = WriteValues(
+          *http_value_retriever, render_urls, seller_kv_base_url,
+          "renderUrls", kv_server::GetDataExtractorForRenderUrls(), true,
+          absl::StrCat(absl::GetFlag(FLAGS_seller_output_file_dir), "/",
+                       delta_file_name.value()),
+          logical_commit_time);
+      !status.ok()) {
+    LOG(ERROR) << "Unable to write values for seller keys. " << status;
   } else {
-    // write seller key value to the delta file
-    const std::string seller_delta_file_path =
-        absl::StrCat(absl::GetFlag(FLAGS_seller_output_file_dir), "/",
-                     delta_file_name.value());
-    std::ofstream o_fstream(seller_delta_file_path);
-    std::ostream* o_stream = &o_fstream;
-    auto seller_writer = kv_server::DeltaKeyValueWriter::Create(*o_stream);
-    if (!seller_writer.ok()) {
-      LOG(ERROR) << "Unable to initialize delta writer for seller. "
-                 << seller_writer.status();
-    } else {
-      for (const auto& key_value_map : seller_output.value()) {
-        if (absl::Status status = seller_writer.value()->Write(
-                key_value_map, logical_commit_time, kMutationType);
-            !status.ok()) {
-          LOG(ERROR) << "Error in writing seller delta file " << status;
-        }
-      }
-      LOG(INFO) << "Done writing seller delta file with "
-                << seller_output.value().size() << " key value maps";
-    }
+    LOG(INFO) << "Done writing seller delta file";
   }
   return 0;
 }
@@ -35,6 +35,17 @@ DeltaKeyValueWriter::Create(std::ostream& output_stream) {
 absl::Status DeltaKeyValueWriter::Write(
     const absl::flat_hash_map<std::string, std::string>& key_value_map,
     int64_t logical_commit_time, KeyValueMutationType mutation_type) {
+  if (const auto status =
+          WriteWithoutFlush(key_value_map, logical_commit_time, mutation_type);
+      !status.ok()) {
+    return status;
+  }
+  return Flush();
+}
+
+absl::Status DeltaKeyValueWriter::WriteWithoutFlush(
+    const absl::flat_hash_map<std::string, std::string>& key_value_map,
+    int64_t logical_commit_time, KeyValueMutationType mutation_type) {
   for (const auto& [k, v] : key_value_map) {
     KeyValueMutationRecordStruct kv_mutation_struct;
     kv_mutation_struct.key = k;
@@ -53,6 +64,10 @@ absl::Status DeltaKeyValueWriter::Write(
       return status;
     }
   }
+  return absl::OkStatus();
+}
+
+absl::Status DeltaKeyValueWriter::Flush() {
   if (const auto status = delta_record_writer_->Flush(); !status.ok()) {
     LOG(ERROR) << "Failed to flush delta record writer";
     return status;
@@ -33,9 +33,15 @@ class DeltaKeyValueWriter {
  public:
   static absl::StatusOr<std::unique_ptr<DeltaKeyValueWriter>> Create(
       std::ostream& output_stream);
+  // Writes and flushes the key value pairs.
   absl::Status Write(
       const absl::flat_hash_map<std::string, std::string>& key_value_map,
       int64_t logical_commit_time, KeyValueMutationType mutation_type);
+  // Writes the key value pairs, which are flushed by a later `Flush`.
+  absl::Status WriteWithoutFlush(
+      const absl::flat_hash_map<std::string, std::string>& key_value_map,
+      int64_t logical_commit_time, KeyValueMutationType mutation_type);
+  absl::Status Flush();
 
  private:
   explicit DeltaKeyValueWriter(
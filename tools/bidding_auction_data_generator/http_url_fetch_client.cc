@@ -16,15 +16,24 @@
 
 #include "tools/bidding_auction_data_generator/http_url_fetch_client.h"
 
+#include <algorithm>
+#include <map>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "absl/cleanup/cleanup.h"
 #include "absl/log/log.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
 #include "curl/multi.h"
 
 namespace kv_server {
 namespace {
+// Longest wait for the transfers in flight, so that due retries are started.
+constexpr int kMaxWaitMs = 100;
+
 // callback function to write the received data to the output
 // https://curl.se/libcurl/c/CURLOPT_WRITEFUNCTION.html
 static size_t WriteCallback(void* data, size_t size, size_t number_of_elements,
@@ -33,46 +42,158 @@ static size_t WriteCallback(void* data, size_t size, size_t number_of_elements,
                                                  size * number_of_elements);
   return size * number_of_elements;
 }
+
+// A reusable easy handle, and the request it is sending.
+struct Transfer {
+  CURL* handle = nullptr;
+  int64_t url_index = 0;
+  int attempt = 0;
+  std::string response;
+};
+
+struct PendingRequest {
+  int64_t url_index;
+  int attempt;
+};
 }  // namespace
 
 absl::StatusOr<std::vector<std::string>> HttpUrlFetchClient::FetchUrls(
     const std::vector<std::string>& urls, int64_t timeout_ms) {
   std::vector<std::string> responses(urls.size());
+  const absl::StatusOr<FetchStats> stats = StreamUrls(
+      urls,
+      {.timeout_ms = timeout_ms,
+       .max_concurrent_requests =
+           std::max(1, static_cast<int>(urls.size())),
+       .max_attempts = 1},
+      [&responses](int64_t url_index, std::string response) {
+        responses[url_index] = std::move(response);
+        return absl::OkStatus();
+      });
+  if (!stats.ok()) {
+    return stats.status();
+  }
+  return responses;
+}
+
+absl::StatusOr<HttpUrlFetchClient::FetchStats> HttpUrlFetchClient::StreamUrls(
+    const std::vector<std::string>& urls, const FetchOptions& options,
+    const ResponseCallback& callback) {
+  if (options.max_concurrent_requests < 1 || options.max_attempts < 1) {
+    return absl::InvalidArgumentError(
+        "At least one concurrent request and one attempt are required.");
+  }
+  const absl::Time start = absl::Now();
+  FetchStats stats;
   CURLM* multi_handle = curl_multi_init();
-  for (int i = 0; i < urls.size(); i++) {
-    VLOG(5) << "Request url: " << urls[i];
-    CURL* eh = curl_easy_init();
-    curl_easy_setopt(eh, CURLOPT_WRITEFUNCTION, WriteCallback);
-    curl_easy_setopt(eh, CURLOPT_WRITEDATA, &responses[i]);
-    curl_easy_setopt(eh, CURLOPT_URL, urls[i].c_str());
-    curl_easy_setopt(eh, CURLOPT_PRIVATE, urls[i].c_str());
-    curl_easy_setopt(eh, CURLOPT_TIMEOUT_MS, timeout_ms);
-    curl_multi_add_handle(multi_handle, eh);
+  curl_multi_setopt(multi_handle, CURLMOPT_MAX_HOST_CONNECTIONS,
+                    static_cast<long>(options.max_concurrent_requests));
+  std::vector<Transfer> transfers(
+      std::min<int64_t>(options.max_concurrent_requests, urls.size()));
+  std::vector<Transfer*> idle_transfers;
+  for (Transfer& transfer : transfers) {
+    transfer.handle = curl_easy_init();
+    curl_easy_setopt(transfer.handle, CURLOPT_WRITEFUNCTION, WriteCallback);
+    curl_easy_setopt(transfer.handle, CURLOPT_WRITEDATA, &transfer.response);
+    curl_easy_setopt(transfer.handle, CURLOPT_PRIVATE, &transfer);
+    curl_easy_setopt(transfer.handle, CURLOPT_TIMEOUT_MS, options.timeout_ms);
+    // Lets servers compress the responses.
+    curl_easy_setopt(transfer.handle, CURLOPT_ACCEPT_ENCODING, "");
+    idle_transfers.push_back(&transfer);
   }
-  // keep track of number of running handles
-  int still_running = 1;
-  while (still_running) {
+  absl::Cleanup cleanup = [multi_handle, &transfers] {
+    for (Transfer& transfer : transfers) {
+      curl_multi_remove_handle(multi_handle, transfer.handle);
+      curl_easy_cleanup(transfer.handle);
+    }
+    curl_multi_cleanup(multi_handle);
+  };
+  // Failed requests, by when they are retried.
+  std::multimap<absl::Time, PendingRequest> retries;
+  int64_t next_url_index = 0;
+  int still_running = 0;
+  while (true) {
+    const absl::Time now = absl::Now();
+    while (!idle_transfers.empty()) {
+      PendingRequest request;
+      if (!retries.empty() && retries.begin()->first <= now) {
+        request = retries.begin()->second;
+        retries.erase(retries.begin());
+      } else if (next_url_index < static_cast<int64_t>(urls.size())) {
+        request = {.url_index = next_url_index++, .attempt = 0};
+      } else {
+        break;
+      }
+      Transfer* transfer = idle_transfers.back();
+      idle_transfers.pop_back();
+      transfer->url_index = request.url_index;
+      transfer->attempt = request.attempt;
+      transfer->response.clear();
+      VLOG(5) << "Request url: " << urls[request.url_index];
+      curl_easy_setopt(transfer->handle, CURLOPT_URL,
+                       urls[request.url_index].c_str());
+      curl_multi_add_handle(multi_handle, transfer->handle);
+      ++stats.num_requests;
+    }
+    if (idle_transfers.size() == transfers.size() && retries.empty() &&
+        next_url_index == static_cast<int64_t>(urls.size())) {
+      break;
+    }
+    curl_multi_perform(multi_handle, &still_running);
     CURLMsg* msg;
     int msg_in_queue;
-    curl_multi_perform(multi_handle, &still_running);
     while ((msg = curl_multi_info_read(multi_handle, &msg_in_queue))) {
-      if (msg->msg == CURLMSG_DONE) {
-        if (msg->data.result != CURLE_OK) {
-          const auto error_msg = curl_easy_strerror(msg->data.result);
-          LOG(ERROR) << "Error in the curl handle: " << error_msg;
-          return absl::InternalError(error_msg);
-        }
-        CURL* eh = msg->easy_handle;
-        curl_multi_remove_handle(multi_handle, eh);
-        curl_easy_cleanup(eh);
-      } else {
+      if (msg->msg != CURLMSG_DONE) {
         return absl::InternalError(
             "Unable to read message from curl multi handle.");
       }
+      Transfer* transfer;
+      curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &transfer);
+      const CURLcode result = msg->data.result;
+      curl_multi_remove_handle(multi_handle, transfer->handle);
+      idle_transfers.push_back(transfer);
+      long response_code = 0;
+      curl_easy_getinfo(transfer->handle, CURLINFO_RESPONSE_CODE,
+                        &response_code);
+      if (result == CURLE_OK && response_code != 429 && response_code < 500) {
+        stats.num_response_bytes += transfer->response.size();
+        if (absl::Status status =
+                callback(transfer->url_index, std::move(transfer->response));
+            !status.ok()) {
+          return status;
+        }
+        continue;
+      }
+      const std::string error =
+          result != CURLE_OK
+              ? curl_easy_strerror(result)
+              : absl::StrCat("HTTP response code ", response_code);
+      if (transfer->attempt + 1 >= options.max_attempts) {
+        LOG(ERROR) << "Error in the curl handle: " << error;
+        return absl::InternalError(error);
+      }
+      VLOG(2) << "Retrying url " << urls[transfer->url_index] << ": " << error;
+      retries.emplace(
+          absl::Now() + options.initial_backoff * (1 << transfer->attempt),
+          PendingRequest{.url_index = transfer->url_index,
+                         .attempt = transfer->attempt + 1});
+      ++stats.num_retries;
+    }
+    int wait_ms = kMaxWaitMs;
+    if (!retries.empty()) {
+      wait_ms = std::clamp<int64_t>(
+          absl::ToInt64Milliseconds(retries.begin()->first - absl::Now()), 0,
+          kMaxWaitMs);
+    }
+    if (idle_transfers.size() < transfers.size()) {
+      curl_multi_wait(multi_handle, nullptr, 0, wait_ms, nullptr);
+    } else if (next_url_index == static_cast<int64_t>(urls.size())) {
+      // Only retries are left, which `curl_multi_wait` doesn't wait for.
+      absl::SleepFor(absl::Milliseconds(wait_ms));
     }
   }
-  curl_multi_cleanup(multi_handle);
-  return responses;
+  stats.elapsed = absl::Now() - start;
+  return stats;
 }
 
 }  // namespace kv_server
@@ -17,22 +17,56 @@
 #ifndef TOOLS_BIDDING_AUCTION_DATA_GENERATOR_HTTP_URL_FETCH_CLIENT_H_
 #define TOOLS_BIDDING_AUCTION_DATA_GENERATOR_HTTP_URL_FETCH_CLIENT_H_
 
+#include <cstdint>
+#include <functional>
 #include <string>
 #include <vector>
 
+#include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/time/time.h"
 #include "curl/curl.h"
 
 namespace kv_server {
 // Defines a class that sends http requests and fetches the responses
 class HttpUrlFetchClient {
  public:
+  struct FetchOptions {
+    int64_t timeout_ms = 5000;
+    // Maximum number of requests in flight. Connections to the same host are
+    // reused by the following requests.
+    int max_concurrent_requests = 64;
+    // Failed transfers and 429 and 5xx responses are retried, up to this
+    // many attempts per url in total.
+    int max_attempts = 3;
+    // Doubled after every failed attempt of a url.
+    absl::Duration initial_backoff = absl::Milliseconds(100);
+  };
+
+  struct FetchStats {
+    int64_t num_requests = 0;
+    int64_t num_retries = 0;
+    int64_t num_response_bytes = 0;
+    absl::Duration elapsed;
+  };
+
+  // Called with the index of a url and its response.
+  using ResponseCallback =
+      std::function<absl::Status(int64_t url_index, std::string response)>;
+
   HttpUrlFetchClient() { curl_global_init(CURL_GLOBAL_ALL); }
   virtual ~HttpUrlFetchClient() { curl_global_cleanup(); }
   // Sends http requests for the given urls and saves the response to the
   // response vector
   virtual absl::StatusOr<std::vector<std::string>> FetchUrls(
       const std::vector<std::string>& urls, int64_t timeout_ms);
+  // Sends http requests for the given urls, at most
+  // `options.max_concurrent_requests` at a time, and calls `callback` with
+  // each response as it arrives, in any order, on the calling thread. Fails
+  // once a url fails after all its attempts or `callback` fails.
+  virtual absl::StatusOr<FetchStats> StreamUrls(
+      const std::vector<std::string>& urls, const FetchOptions& options,
+      const ResponseCallback& callback);
 };
 
 }  // namespace kv_server
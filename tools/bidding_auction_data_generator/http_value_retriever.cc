@@ -27,6 +27,8 @@
 #include "absl/log/log.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "google/protobuf/util/json_util.h"
 #include "public/query/get_values.pb.h"
 #include "tools/bidding_auction_data_generator/value_fetch_util.h"
@@ -34,6 +36,7 @@
 namespace kv_server {
 namespace {
 constexpr int64_t kTimeoutInMs = 5000;
+constexpr absl::Duration kProgressLogInterval = absl::Seconds(10);
 using v1::GetValuesResponse;
 }  // namespace
 
@@ -121,6 +124,68 @@ HttpValueRetriever::RetrieveValues(
   return output;
 }
 
+absl::Status HttpValueRetriever::StreamValues(
+    const absl::flat_hash_set<std::string>& keys, const std::string& base_url,
+    const std::string& key_namespace,
+    std::function<
+        void(GetValuesResponse& response,
+             absl::flat_hash_map<std::string, std::string>& key_value_map)>
+        callback,
+    bool need_encode, int num_keys_per_batch,
+    const HttpUrlFetchClient::FetchOptions& fetch_options,
+    const std::function<absl::Status(
+        const absl::flat_hash_map<std::string, std::string>&)>&
+        output_callback) {
+  const std::vector<std::string> urls = GetBatchedUrls(
+      keys, key_namespace, base_url, need_encode, num_keys_per_batch);
+  google::protobuf::util::JsonParseOptions json_parse_options;
+  json_parse_options.ignore_unknown_fields = true;
+  const absl::Time start = absl::Now();
+  absl::Time last_progress_log = start;
+  int64_t num_responses = 0;
+  int64_t num_key_values = 0;
+  const absl::StatusOr<HttpUrlFetchClient::FetchStats> stats =
+      http_url_fetch_client_.StreamUrls(
+          urls, fetch_options,
+          [&](int64_t /*url_index*/, std::string json_res) -> absl::Status {
+            ++num_responses;
+            if (const absl::Time now = absl::Now();
+                now - last_progress_log >= kProgressLogInterval) {
+              last_progress_log = now;
+              LOG(INFO) << "Fetched " << num_responses << " of "
+                        << urls.size() << " urls, "
+                        << num_responses / absl::ToDoubleSeconds(now - start)
+                        << " urls/s";
+            }
+            GetValuesResponse response;
+            absl::flat_hash_map<std::string, std::string> key_value_map;
+            if (absl::Status status =
+                    google::protobuf::util::JsonStringToMessage(
+                        json_res, &response, json_parse_options);
+                !status.ok()) {
+              LOG(ERROR) << "Unable to convert json response to "
+                            "GetValueResponse "
+                         << status.ToString();
+              return absl::OkStatus();
+            }
+            callback(response, key_value_map);
+            num_key_values += key_value_map.size();
+            return output_callback(key_value_map);
+          });
+  if (!stats.ok()) {
+    return stats.status();
+  }
+  const double seconds =
+      std::max(absl::ToDoubleSeconds(stats->elapsed), 1e-6);
+  LOG(INFO) << "Retrieved " << num_key_values << " key values from "
+            << stats->num_requests - stats->num_retries << " urls in "
+            << stats->elapsed << ": " << urls.size() / seconds << " urls/s, "
+            << num_key_values / seconds << " keys/s, "
+            << stats->num_response_bytes / seconds / (1 << 20)
+            << " MB/s, with " << stats->num_retries << " retries";
+  return absl::OkStatus();
+}
+
 std::unique_ptr<HttpValueRetriever> HttpValueRetriever::Create(
     HttpUrlFetchClient& http_url_fetch_client) {
   return std::make_unique<HttpValueRetriever>(http_url_fetch_client);
@@ -17,6 +17,7 @@
 #ifndef TOOLS_BIDDING_AUCTION_DATA_GENERATOR_HTTP_VALUE_RETRIEVER_H_
 #define TOOLS_BIDDING_AUCTION_DATA_GENERATOR_HTTP_VALUE_RETRIEVER_H_
 
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
@@ -56,6 +57,21 @@ class HttpValueRetriever {
                          absl::flat_hash_map<std::string, std::string>&)>
           callback,
       bool need_encode, int num_keys_per_batch);
+  // Like `RetrieveValues`, but sends the batch requests concurrently, as
+  // configured by `fetch_options`, and calls `output_callback` with the key
+  // values of each response as it arrives, on the calling thread, instead of
+  // keeping every response. Logs the fetch throughput.
+  absl::Status StreamValues(
+      const absl::flat_hash_set<std::string>& keys, const std::string& base_url,
+      const std::string& key_namespace,
+      std::function<void(v1::GetValuesResponse&,
+                         absl::flat_hash_map<std::string, std::string>&)>
+          callback,
+      bool need_encode, int num_keys_per_batch,
+      const HttpUrlFetchClient::FetchOptions& fetch_options,
+      const std::function<absl::Status(
+          const absl::flat_hash_map<std::string, std::string>&)>&
+          output_callback);
 
  private:
   HttpUrlFetchClient& http_url_fetch_client_;
@@ -168,5 +168,75 @@ TEST(HttpUrlFetchClientTest, SellerSkipEmptyValueTest) {
   EXPECT_THAT(seller_output.value()[0].find("url3")->second, R"(["v3"])");
 }
 
+TEST(HttpUrlFetchClientTest, BuyerStreamValuesTest) {
+  kv_server::MockHttpUrlFetchClient mock_http_url_fetch_client;
+  const std::string json_response(R"(
+  {
+    "keys":{
+      "key1": { "value": ["v1"] },
+      "key2": { "value": ["v2"] },
+    }
+  })");
+  EXPECT_CALL(mock_http_url_fetch_client, StreamUrls)
+      .WillOnce(
+          [&json_response](
+              const std::vector<std::string>& urls,
+              const HttpUrlFetchClient::FetchOptions& options,
+              const HttpUrlFetchClient::ResponseCallback& callback)
+              -> absl::StatusOr<HttpUrlFetchClient::FetchStats> {
+            EXPECT_EQ(urls.size(), 2);
+            EXPECT_EQ(options.max_concurrent_requests, 2);
+            for (int i = 0; i < urls.size(); i++) {
+              if (absl::Status status = callback(i, json_response);
+                  !status.ok()) {
+                return status;
+              }
+            }
+            return HttpUrlFetchClient::FetchStats{.num_requests = 2};
+          });
+
+  std::unique_ptr<kv_server::HttpValueRetriever> test_value_retriever =
+      HttpValueRetriever::Create(mock_http_url_fetch_client);
+  absl::flat_hash_set<std::string> keys = {"key1", "key2"};
+  Output buyer_output;
+  absl::Status status = test_value_retriever->StreamValues(
+      keys, "https:://test_domain?", "keys",
+      kv_server::GetDataExtractorForKeys(), false, 1,
+      {.max_concurrent_requests = 2},
+      [&buyer_output](
+          const absl::flat_hash_map<std::string, std::string>& key_values) {
+        buyer_output.push_back(key_values);
+        return absl::OkStatus();
+      });
+  EXPECT_TRUE(status.ok()) << status;
+  ASSERT_THAT(buyer_output.size(), 2);
+  EXPECT_THAT(buyer_output[1].find("key2")->second, R"(["v2"])");
+}
+
+TEST(HttpUrlFetchClientTest, StreamValuesStopsOnOutputError) {
+  kv_server::MockHttpUrlFetchClient mock_http_url_fetch_client;
+  EXPECT_CALL(mock_http_url_fetch_client, StreamUrls)
+      .WillOnce([](const std::vector<std::string>& urls,
+                   const HttpUrlFetchClient::FetchOptions& options,
+                   const HttpUrlFetchClient::ResponseCallback& callback)
+                    -> absl::StatusOr<HttpUrlFetchClient::FetchStats> {
+        if (absl::Status status = callback(0, R"({"keys":{}})");
+            !status.ok()) {
+          return status;
+        }
+        return HttpUrlFetchClient::FetchStats{};
+      });
+
+  std::unique_ptr<kv_server::HttpValueRetriever> test_value_retriever =
+      HttpValueRetriever::Create(mock_http_url_fetch_client);
+  absl::Status status = test_value_retriever->StreamValues(
+      {"key1"}, "https:://test_domain?", "keys",
+      kv_server::GetDataExtractorForKeys(), false, 50, {},
+      [](const absl::flat_hash_map<std::string, std::string>&) {
+        return absl::DataLossError("write failed");
+      });
+  EXPECT_EQ(status.code(), absl::StatusCode::kDataLoss);
+}
+
 }  // namespace
 }  // namespace kv_server
@@ -0,0 +1,597 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tools/data_cli/commands/diff_snapshots_command.h"
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "absl/container/btree_set.h"
+#include "absl/log/log.h"
+#include "absl/memory/memory.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "components/util/thread_pool.h"
+#include "public/data_loading/readers/riegeli_stream_io.h"
+#include "public/data_loading/records_utils.h"
+#include "public/data_loading/riegeli_metadata.pb.h"
+#include "public/data_loading/writers/delta_record_stream_writer.h"
+#include "riegeli/bytes/istream_reader.h"
+#include "riegeli/records/record_reader.h"
+
+namespace kv_server {
+namespace {
+
+// A key-value record with its own copy of its key and value.
+struct KeyValueRecord {
+  KeyValueMutationType mutation_type;
+  int64_t logical_commit_time;
+  std::string key;
+  bool is_set;
+  // The one value of scalars, if any.
+  std::vector<std::string> values;
+};
+
+KeyValueRecord CopyRecord(const KeyValueMutationRecordStruct& record) {
+  KeyValueRecord copy{
+      .mutation_type = record.mutation_type,
+      .logical_commit_time = record.logical_commit_time,
+      .key = std::string(record.key),
+      .is_set = false,
+  };
+  if (const auto* value = std::get_if<std::string_view>(&record.value)) {
+    copy.values.emplace_back(*value);
+  } else if (const auto* values =
+                 std::get_if<std::vector<std::string_view>>(&record.value)) {
+    copy.is_set = true;
+    copy.values.assign(values->begin(), values->end());
+  }
+  return copy;
+}
+
+// The value of a key in a snapshot, once its records are applied in logical
+// commit time order.
+struct KeyState {
+  bool present() const {
+    return is_set ? !elements.empty() : value.has_value();
+  }
+
+  std::string key;
+  bool is_set = false;
+  // Set if the key has a scalar value.
+  std::optional<std::string> value;
+  // The elements of a set value.
+  absl::btree_set<std::string> elements;
+  int64_t max_logical_commit_time = 0;
+};
+
+KeyState ApplyRecords(std::vector<KeyValueRecord>& records) {
+  std::stable_sort(records.begin(), records.end(),
+                   [](const KeyValueRecord& a, const KeyValueRecord& b) {
+                     return a.logical_commit_time < b.logical_commit_time;
+                   });
+  KeyState state{.key = records.front().key};
+  for (KeyValueRecord& record : records) {
+    state.max_logical_commit_time =
+        std::max(state.max_logical_commit_time, record.logical_commit_time);
+    if (record.mutation_type == KeyValueMutationType::Update) {
+      if (record.is_set) {
+        if (!state.is_set) {
+          state.is_set = true;
+          state.value.reset();
+        }
+        for (std::string& element : record.values) {
+          state.elements.insert(std::move(element));
+        }
+      } else {
+        state.is_set = false;
+        state.elements.clear();
+        state.value = record.values.empty() ? std::string()
+                                            : std::move(record.values.front());
+      }
+    } else if (record.is_set) {
+      if (state.is_set) {
+        for (const std::string& element : record.values) {
+          state.elements.erase(element);
+        }
+      }
+    } else {
+      state.is_set = false;
+      state.value.reset();
+      state.elements.clear();
+    }
+  }
+  return state;
+}
+
+// Reads the key-value records of a snapshot sorted by key, grouped by key,
+// from the first key at or after `begin_key` to the last key before `end_key`.
+// Records that aren't key-value records are passed to `other_record_callback`
+// if they are after the first key of the range and before its end, or before
+// the end if the range has no beginning, so that each is passed to the reader
+// of one range.
+class KeyStateReader {
+ public:
+  KeyStateReader(const std::string& path, std::optional<std::string> begin_key,
+                 std::optional<std::string> end_key,
+                 std::function<absl::Status(const DataRecordStruct&)>
+                     other_record_callback = nullptr)
+      : path_(path),
+        stream_(path, std::ios::binary),
+        reader_(std::make_unique<riegeli::IStreamReader<>>(&stream_)),
+        begin_key_(std::move(begin_key)),
+        end_key_(std::move(end_key)),
+        other_record_callback_(std::move(other_record_callback)),
+        in_range_(!begin_key_.has_value()) {}
+
+  // Skips to the first record at or after `pos`.
+  absl::Status Seek(int64_t pos) {
+    if (pos > 0 && !reader_.Seek(pos)) {
+      return reader_.status();
+    }
+    return absl::OkStatus();
+  }
+
+  // Returns the key of the next record in the range, if any.
+  absl::StatusOr<std::optional<std::string_view>> PeekKey() {
+    if (!pending_.has_value()) {
+      absl::StatusOr<bool> read = ReadRecord();
+      if (!read.ok()) {
+        return read.status();
+      }
+      if (!*read) {
+        return std::nullopt;
+      }
+    }
+    return std::optional<std::string_view>(pending_->key);
+  }
+
+  // Returns the state of the next key in the range, if any.
+  absl::StatusOr<std::optional<KeyState>> Next() {
+    absl::StatusOr<std::optional<std::string_view>> key = PeekKey();
+    if (!key.ok()) {
+      return key.status();
+    }
+    if (!key->has_value()) {
+      return std::nullopt;
+    }
+    std::vector<KeyValueRecord> records;
+    records.push_back(*std::move(pending_));
+    pending_.reset();
+    while (true) {
+      absl::StatusOr<bool> read = ReadRecord();
+      if (!read.ok()) {
+        return read.status();
+      }
+      if (!*read || pending_->key != records.front().key) {
+        break;
+      }
+      records.push_back(*std::move(pending_));
+      pending_.reset();
+    }
+    return ApplyRecords(records);
+  }
+
+ private:
+  // Reads the next key-value record in the range into `pending_`. Returns
+  // false at the end of the range.
+  absl::StatusOr<bool> ReadRecord() {
+    std::string_view bytes;
+    while (!done_) {
+      if (!reader_.ReadRecord(bytes)) {
+        if (!reader_.ok()) {
+          return reader_.status();
+        }
+        done_ = true;
+        break;
+      }
+      if (absl::Status status = DeserializeDataRecord(
+              bytes,
+              [this](const DataRecordStruct& data_record) {
+                return ProcessRecord(data_record);
+              });
+          !status.ok()) {
+        return status;
+      }
+      if (pending_.has_value()) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  absl::Status ProcessRecord(const DataRecordStruct& data_record) {
+    const auto* record =
+        std::get_if<KeyValueMutationRecordStruct>(&data_record.record);
+    if (record == nullptr) {
+      return in_range_ && other_record_callback_ != nullptr
+                 ? other_record_callback_(data_record)
+                 : absl::OkStatus();
+    }
+    if (in_range_ && record->key < last_key_) {
+      return absl::FailedPreconditionError(
+          absl::StrCat(path_, " isn't sorted by key: ", record->key,
+                       " follows ", last_key_, "."));
+    }
+    if (begin_key_.has_value() && record->key < *begin_key_) {
+      return absl::OkStatus();
+    }
+    if (end_key_.has_value() && record->key >= *end_key_) {
+      done_ = true;
+      return absl::OkStatus();
+    }
+    in_range_ = true;
+    last_key_ = record->key;
+    pending_ = CopyRecord(*record);
+    return absl::OkStatus();
+  }
+
+  const std::string path_;
+  std::ifstream stream_;
+  riegeli::RecordReader<std::unique_ptr<riegeli::Reader>> reader_;
+  const std::optional<std::string> begin_key_;
+  const std::optional<std::string> end_key_;
+  std::function<absl::Status(const DataRecordStruct&)> other_record_callback_;
+  bool in_range_;
+  bool done_ = false;
+  std::string last_key_;
+  std::optional<KeyValueRecord> pending_;
+};
+
+// Returns the key of the first record at or after `pos`, if any.
+absl::StatusOr<std::optional<std::string>> KeyAt(const std::string& path,
+                                                 int64_t pos) {
+  KeyStateReader reader(path, std::nullopt, std::nullopt);
+  if (absl::Status status = reader.Seek(pos); !status.ok()) {
+    return status;
+  }
+  absl::StatusOr<std::optional<std::string_view>> key = reader.PeekKey();
+  if (!key.ok()) {
+    return key.status();
+  }
+  if (!key->has_value()) {
+    return std::nullopt;
+  }
+  return std::string(**key);
+}
+
+// Returns the key index of the snapshot at `path`, if it was written with one.
+std::optional<KeyIndex> ReadKeyIndex(const std::string& path) {
+  std::ifstream stream(path, std::ios::binary);
+  RiegeliStreamReader<std::string_view> reader(
+      stream, [](const riegeli::SkippedRegion&) { return false; });
+  absl::StatusOr<KVFileMetadata> metadata = reader.GetKVFileMetadata();
+  if (!metadata.ok() || metadata->key_index().sections().empty()) {
+    return std::nullopt;
+  }
+  return metadata->key_index();
+}
+
+// Returns a position in the file at `path`, of size `size`, that every record
+// of `key` and the keys after it are after, from the key index of the file or
+// else found by binary search.
+absl::StatusOr<int64_t> FindKeyPosition(const std::string& path, int64_t size,
+                                        const std::string& key) {
+  if (const std::optional<KeyIndex> key_index = ReadKeyIndex(path);
+      key_index.has_value()) {
+    return kv_server::FindKeyPosition(*key_index, key);
+  }
+  // The first record after `low` is before `key`, if `low` is positive.
+  int64_t low = 0;
+  int64_t high = size;
+  while (high - low > 1) {
+    const int64_t mid = low + (high - low) / 2;
+    absl::StatusOr<std::optional<std::string>> mid_key = KeyAt(path, mid);
+    if (!mid_key.ok()) {
+      return mid_key.status();
+    }
+    if (mid_key->has_value() && **mid_key < key) {
+      low = mid;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+// Writes the records that change a key from its state in the base snapshot
+// to its state in the new one, from any thread.
+class DiffWriter {
+ public:
+  explicit DiffWriter(DeltaRecordWriter& writer) : writer_(writer) {}
+
+  absl::Status WriteRecord(const DataRecordStruct& data_record) {
+    absl::MutexLock lock(&mutex_);
+    return writer_.WriteRecord(data_record);
+  }
+
+  // Either state may be null if the key isn't in its snapshot.
+  absl::Status WriteDiff(const KeyState* base, const KeyState* next) {
+    const bool base_present = base != nullptr && base->present();
+    const bool next_present = next != nullptr && next->present();
+    const std::string_view key = next != nullptr ? next->key : base->key;
+    int64_t logical_commit_time =
+        std::max(base != nullptr ? base->max_logical_commit_time : 0,
+                 next != nullptr ? next->max_logical_commit_time : 0) +
+        1;
+    if (!next_present) {
+      return base_present
+                 ? WriteDeletion(key, *base, logical_commit_time)
+                 : absl::OkStatus();
+    }
+    if (base_present && base->is_set && next->is_set) {
+      std::vector<std::string_view> added;
+      std::set_difference(next->elements.begin(), next->elements.end(),
+                          base->elements.begin(), base->elements.end(),
+                          std::back_inserter(added));
+      std::vector<std::string_view> removed;
+      std::set_difference(base->elements.begin(), base->elements.end(),
+                          next->elements.begin(), next->elements.end(),
+                          std::back_inserter(removed));
+      if (!added.empty()) {
+        if (absl::Status status =
+                Write(KeyValueMutationType::Update, key, std::move(added),
+                      logical_commit_time);
+            !status.ok()) {
+          return status;
+        }
+      }
+      return removed.empty()
+                 ? absl::OkStatus()
+                 : Write(KeyValueMutationType::Delete, key,
+                         std::move(removed), logical_commit_time);
+    }
+    if (base_present && !base->is_set && !next->is_set &&
+        *base->value == *next->value) {
+      return absl::OkStatus();
+    }
+    // The value changed type, the old one is deleted first.
+    if (base_present && base->is_set != next->is_set) {
+      if (absl::Status status =
+              WriteDeletion(key, *base, logical_commit_time++);
+          !status.ok()) {
+        return status;
+      }
+    }
+    if (next->is_set) {
+      return Write(KeyValueMutationType::Update, key,
+                   std::vector<std::string_view>(next->elements.begin(),
+                                                 next->elements.end()),
+                   logical_commit_time);
+    }
+    return Write(KeyValueMutationType::Update, key,
+                 std::string_view(*next->value), logical_commit_time);
+  }
+
+  int64_t num_updates() const { return num_updates_; }
+  int64_t num_deletions() const { return num_deletions_; }
+
+ private:
+  absl::Status WriteDeletion(std::string_view key, const KeyState& base,
+                             int64_t logical_commit_time) {
+    if (base.is_set) {
+      return Write(KeyValueMutationType::Delete, key,
+                   std::vector<std::string_view>(base.elements.begin(),
+                                                 base.elements.end()),
+                   logical_commit_time);
+    }
+    return Write(KeyValueMutationType::Delete, key, std::string_view(),
+                 logical_commit_time);
+  }
+
+  absl::Status Write(KeyValueMutationType mutation_type, std::string_view key,
+                     KeyValueMutationRecordValueT value,
+                     int64_t logical_commit_time) {
+    ++(mutation_type == KeyValueMutationType::Update ? num_updates_
+                                                      : num_deletions_);
+    return WriteRecord(DataRecordStruct{
+        .record = KeyValueMutationRecordStruct{
+            .mutation_type = mutation_type,
+            .logical_commit_time = logical_commit_time,
+            .key = key,
+            .value = std::move(value),
+        }});
+  }
+
+  absl::Mutex mutex_;
+  DeltaRecordWriter& writer_ ABSL_GUARDED_BY(mutex_);
+  std::atomic<int64_t> num_updates_ = 0;
+  std::atomic<int64_t> num_deletions_ = 0;
+};
+
+// Diffs the keys at or after `begin_key` and before `end_key`.
+absl::Status DiffKeyRange(const DiffSnapshotsCommand::Params& params,
+                          const std::optional<std::string>& begin_key,
+                          const std::optional<std::string>& end_key,
+                          DiffWriter& diff_writer) {
+  KeyStateReader base_reader(params.base_snapshot_file, begin_key, end_key);
+  KeyStateReader next_reader(
+      params.new_snapshot_file, begin_key, end_key,
+      [&diff_writer](const DataRecordStruct& data_record) {
+        return diff_writer.WriteRecord(data_record);
+      });
+  if (begin_key.has_value()) {
+    for (auto [reader, path] :
+         {std::pair(&base_reader, &params.base_snapshot_file),
+          std::pair(&next_reader, &params.new_snapshot_file)}) {
+      absl::StatusOr<int64_t> pos = FindKeyPosition(
+          *path, std::filesystem::file_size(*path), *begin_key);
+      if (!pos.ok()) {
+        return pos.status();
+      }
+      if (absl::Status status = reader->Seek(*pos); !status.ok()) {
+        return status;
+      }
+    }
+  }
+  absl::StatusOr<std::optional<KeyState>> base = base_reader.Next();
+  absl::StatusOr<std::optional<KeyState>> next = next_reader.Next();
+  while (true) {
+    if (!base.ok()) {
+      return base.status();
+    }
+    if (!next.ok()) {
+      return next.status();
+    }
+    if (!base->has_value() && !next->has_value()) {
+      return absl::OkStatus();
+    }
+    const bool advance_base =
+        base->has_value() &&
+        (!next->has_value() || (*base)->key <= (*next)->key);
+    const bool advance_next =
+        next->has_value() &&
+        (!base->has_value() || (*next)->key <= (*base)->key);
+    if (absl::Status status = diff_writer.WriteDiff(
+            advance_base ? &**base : nullptr,
+            advance_next ? &**next : nullptr);
+        !status.ok()) {
+      return status;
+    }
+    if (advance_base) {
+      base = base_reader.Next();
+    }
+    if (advance_next) {
+      next = next_reader.Next();
+    }
+  }
+}
+
+// Returns the keys that split the new snapshot into `num_partitions` ranges
+// of about the same size, in order.
+absl::StatusOr<std::vector<std::string>> GetPartitionKeys(
+    const DiffSnapshotsCommand::Params& params) {
+  const int64_t size = std::filesystem::file_size(params.new_snapshot_file);
+  std::vector<std::string> keys;
+  for (int i = 1; i < params.num_partitions; ++i) {
+    absl::StatusOr<std::optional<std::string>> key =
+        KeyAt(params.new_snapshot_file, size * i / params.num_partitions);
+    if (!key.ok()) {
+      return key.status();
+    }
+    if (key->has_value() && (keys.empty() || **key > keys.back())) {
+      keys.push_back(**std::move(key));
+    }
+  }
+  return keys;
+}
+
+absl::StatusOr<KVFileMetadata> CreateDeltaMetadata(
+    const DiffSnapshotsCommand::Params& params) {
+  std::ifstream stream(params.new_snapshot_file, std::ios::binary);
+  RiegeliStreamReader<std::string_view> reader(
+      stream, [](const riegeli::SkippedRegion&) { return false; });
+  absl::StatusOr<KVFileMetadata> snapshot_metadata =
+      reader.GetKVFileMetadata();
+  KVFileMetadata metadata;
+  metadata.mutable_delta();
+  if (!snapshot_metadata.ok()) {
+    return metadata;
+  }
+  if (snapshot_metadata->has_shard_index()) {
+    return absl::FailedPreconditionError(
+        absl::StrCat(params.new_snapshot_file,
+                     " has a shard index, so it isn't sorted by key."));
+  }
+  if (snapshot_metadata->has_sharding_metadata()) {
+    *metadata.mutable_sharding_metadata() =
+        snapshot_metadata->sharding_metadata();
+  }
+  return metadata;
+}
+
+}  // namespace
+
+DiffSnapshotsCommand::DiffSnapshotsCommand(Params params,
+                                           std::ostream& output_stream)
+    : params_(std::move(params)), output_stream_(output_stream) {}
+
+absl::StatusOr<std::unique_ptr<DiffSnapshotsCommand>>
+DiffSnapshotsCommand::Create(Params params, std::ostream& output_stream) {
+  for (const std::string& file :
+       {params.base_snapshot_file, params.new_snapshot_file}) {
+    if (!std::filesystem::is_regular_file(file)) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Snapshot file: ", file, " does not exist."));
+    }
+  }
+  if (params.num_partitions < 1) {
+    return absl::InvalidArgumentError(
+        "Number of partitions must be at least 1.");
+  }
+  return absl::WrapUnique(
+      new DiffSnapshotsCommand(std::move(params), output_stream));
+}
+
+absl::Status DiffSnapshotsCommand::Execute() {
+  absl::StatusOr<KVFileMetadata> metadata = CreateDeltaMetadata(params_);
+  if (!metadata.ok()) {
+    return metadata.status();
+  }
+  absl::StatusOr<std::vector<std::string>> partition_keys =
+      GetPartitionKeys(params_);
+  if (!partition_keys.ok()) {
+    return partition_keys.status();
+  }
+  auto record_writer = DeltaRecordStreamWriter<std::ostream>::Create(
+      output_stream_, DeltaRecordWriter::Options{.metadata = *metadata});
+  if (!record_writer.ok()) {
+    return record_writer.status();
+  }
+  DiffWriter diff_writer(**record_writer);
+  absl::Status status;
+  {
+    ThreadPool pool(partition_keys->size() + 1);
+    std::vector<TaskFuture<absl::Status>> tasks;
+    for (size_t i = 0; i <= partition_keys->size(); ++i) {
+      tasks.push_back(pool.Async([this, &partition_keys, &diff_writer, i] {
+        return DiffKeyRange(
+            params_,
+            i == 0 ? std::nullopt
+                   : std::optional<std::string>((*partition_keys)[i - 1]),
+            i == partition_keys->size()
+                ? std::nullopt
+                : std::optional<std::string>((*partition_keys)[i]),
+            diff_writer);
+      }));
+    }
+    for (auto& task : tasks) {
+      status.Update(task.Get());
+    }
+  }
+  if (!status.ok()) {
+    return status;
+  }
+  (*record_writer)->Close();
+  LOG(INFO) << "Diffed " << partition_keys->size() + 1 << " key ranges into "
+            << diff_writer.num_updates() << " updates and "
+            << diff_writer.num_deletions() << " deletions.";
+  return (*record_writer)->Status();
+}
+
+}  // namespace kv_server
@@ -0,0 +1,71 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TOOLS_DATA_CLI_COMMANDS_DIFF_SNAPSHOTS_COMMAND_H_
+#define TOOLS_DATA_CLI_COMMANDS_DIFF_SNAPSHOTS_COMMAND_H_
+
+#include <memory>
+#include <ostream>
+#include <string>
+
+#include "absl/status/statusor.h"
+#include "tools/data_cli/commands/command.h"
+
+namespace kv_server {
+
+// Writes a delta file with the changes from a base snapshot to a new one, so
+// that servers that loaded the base snapshot load the new data from the
+// delta, instead of reloading every record of the new snapshot.
+//
+// Both snapshots must be sorted by key, as `generate_snapshot` writes them
+// with sort-merge compaction, without a shard index. They are streamed and
+// merged by key. The delta has:
+// - the records of the keys added or whose value changed,
+// - deletions of the keys removed,
+// - the elements added to, and deletions of the elements removed from, sets,
+// - the records of the new snapshot that aren't key-value records, such as
+//   UDF configs.
+// Each change is one logical commit time after the last record of its key in
+// either snapshot.
+//
+// The key space is split into ranges at keys found in the new snapshot, and
+// the ranges are diffed in parallel.
+class DiffSnapshotsCommand : public Command {
+ public:
+  struct Params {
+    std::string base_snapshot_file;
+    std::string new_snapshot_file;
+    // Number of key ranges diffed in parallel.
+    int32_t num_partitions = 1;
+  };
+
+  DiffSnapshotsCommand(const DiffSnapshotsCommand&) = delete;
+  DiffSnapshotsCommand& operator=(const DiffSnapshotsCommand&) = delete;
+
+  static absl::StatusOr<std::unique_ptr<DiffSnapshotsCommand>> Create(
+      Params params, std::ostream& output_stream);
+  absl::Status Execute() override;
+
+ private:
+  DiffSnapshotsCommand(Params params, std::ostream& output_stream);
+
+  Params params_;
+  std::ostream& output_stream_;
+};
+
+}  // namespace kv_server
+
+#endif  // TOOLS_DATA_CLI_COMMANDS_DIFF_SNAPSHOTS_COMMAND_H_
@@ -0,0 +1,215 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tools/data_cli/commands/diff_snapshots_command.h"
+
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "public/data_loading/readers/delta_record_stream_reader.h"
+#include "public/data_loading/writers/delta_record_stream_writer.h"
+
+namespace kv_server {
+namespace {
+
+using testing::ElementsAre;
+using testing::Pair;
+using testing::UnorderedElementsAre;
+
+DataRecordStruct Record(std::string_view key,
+                        KeyValueMutationRecordValueT value,
+                        int64_t logical_commit_time = 1) {
+  return DataRecordStruct{.record = KeyValueMutationRecordStruct{
+                              .mutation_type = KeyValueMutationType::Update,
+                              .logical_commit_time = logical_commit_time,
+                              .key = key,
+                              .value = std::move(value),
+                          }};
+}
+
+std::string WriteSnapshot(std::string_view name,
+                          const std::vector<DataRecordStruct>& records) {
+  const std::string path =
+      (std::filesystem::path(::testing::TempDir()) / name).string();
+  std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+  // Small chunks, so that the snapshots are split into several key ranges.
+  auto writer = DeltaRecordStreamWriter<std::ofstream>::Create(
+      stream, DeltaRecordWriter::Options{.chunk_options = {.chunk_size = 64}});
+  EXPECT_TRUE(writer.ok()) << writer.status();
+  for (const DataRecordStruct& record : records) {
+    EXPECT_TRUE((*writer)->WriteRecord(record).ok());
+  }
+  (*writer)->Close();
+  return path;
+}
+
+// Returns the written changes by key, as "Update:value" or "Delete:value",
+// with set elements separated by "|".
+std::multimap<std::string, std::string> Diff(std::string base_path,
+                                             std::string new_path,
+                                             int32_t num_partitions) {
+  std::stringstream output;
+  auto command = DiffSnapshotsCommand::Create(
+      {.base_snapshot_file = std::move(base_path),
+       .new_snapshot_file = std::move(new_path),
+       .num_partitions = num_partitions},
+      output);
+  EXPECT_TRUE(command.ok()) << command.status();
+  const absl::Status status = (*command)->Execute();
+  EXPECT_TRUE(status.ok()) << status;
+  std::multimap<std::string, std::string> changes;
+  DeltaRecordStreamReader reader(output);
+  EXPECT_TRUE(
+      reader
+          .ReadRecords(std::function<absl::Status(DataRecordStruct)>(
+              [&changes](DataRecordStruct data_record) {
+                const auto& record =
+                    std::get<KeyValueMutationRecordStruct>(data_record.record);
+                std::string value;
+                if (const auto* values =
+                        std::get_if<std::vector<std::string_view>>(
+                            &record.value)) {
+                  value = absl::StrJoin(*values, "|");
+                } else {
+                  value = std::get<std::string_view>(record.value);
+                }
+                changes.emplace(
+                    record.key,
+                    absl::StrCat(record.mutation_type ==
+                                         KeyValueMutationType::Update
+                                     ? "Update:"
+                                     : "Delete:",
+                                 value));
+                return absl::OkStatus();
+              }))
+          .ok());
+  return changes;
+}
+
+class DiffSnapshotsPartitionsTest : public ::testing::TestWithParam<int32_t> {};
+
+INSTANTIATE_TEST_SUITE_P(NumPartitions, DiffSnapshotsPartitionsTest,
+                         testing::Values(1, 3, 16));
+
+TEST_P(DiffSnapshotsPartitionsTest, WritesChangedKeys) {
+  const std::string base_path = WriteSnapshot(
+      "WritesChangedKeys.base",
+      {Record("a", "1"), Record("b", "2"),
+       Record("c", std::vector<std::string_view>{"x", "y"}), Record("d", "3"),
+       Record("f", "4")});
+  const std::string new_path = WriteSnapshot(
+      "WritesChangedKeys.new",
+      {Record("a", "1", /*logical_commit_time=*/5), Record("b", "20"),
+       Record("c", std::vector<std::string_view>{"y", "z"}), Record("e", "5"),
+       Record("f", std::vector<std::string_view>{"w"})});
+  EXPECT_THAT(Diff(base_path, new_path, GetParam()),
+              UnorderedElementsAre(
+                  Pair("b", "Update:20"), Pair("c", "Update:z"),
+                  Pair("c", "Delete:x"), Pair("d", "Delete:"),
+                  Pair("e", "Update:5"), Pair("f", "Delete:"),
+                  Pair("f", "Update:w")));
+}
+
+TEST_P(DiffSnapshotsPartitionsTest, DiffsEveryKeyRange) {
+  std::vector<std::string> keys;
+  for (int i = 0; i < 1000; ++i) {
+    keys.push_back(absl::StrCat("key", 1000 + i));
+  }
+  std::vector<DataRecordStruct> base_records;
+  std::vector<DataRecordStruct> new_records;
+  for (int i = 0; i < keys.size(); ++i) {
+    if (i % 7 != 0) {
+      base_records.push_back(Record(keys[i], "value"));
+    }
+    if (i % 5 != 0) {
+      new_records.push_back(Record(keys[i], i % 3 == 0 ? "changed" : "value"));
+    }
+  }
+  const std::multimap<std::string, std::string> changes =
+      Diff(WriteSnapshot("DiffsEveryKeyRange.base", base_records),
+           WriteSnapshot("DiffsEveryKeyRange.new", new_records), GetParam());
+  std::multimap<std::string, std::string> expected;
+  for (int i = 0; i < keys.size(); ++i) {
+    const bool in_base = i % 7 != 0;
+    const bool in_new = i % 5 != 0;
+    if (in_new && (!in_base || i % 3 == 0)) {
+      expected.emplace(keys[i], i % 3 == 0 ? "Update:changed" : "Update:value");
+    } else if (in_base && !in_new) {
+      expected.emplace(keys[i], "Delete:");
+    }
+  }
+  EXPECT_EQ(changes, expected);
+}
+
+TEST(DiffSnapshotsCommandTest, ChangesAreNewerThanBothSnapshots) {
+  const std::string base_path = WriteSnapshot(
+      "ChangesAreNewer.base", {Record("a", "1", /*logical_commit_time=*/7)});
+  const std::string new_path = WriteSnapshot(
+      "ChangesAreNewer.new", {Record("a", "2", /*logical_commit_time=*/3)});
+  std::stringstream output;
+  auto command = DiffSnapshotsCommand::Create(
+      {.base_snapshot_file = base_path, .new_snapshot_file = new_path},
+      output);
+  ASSERT_TRUE(command.ok());
+  ASSERT_TRUE((*command)->Execute().ok());
+  std::vector<int64_t> logical_commit_times;
+  DeltaRecordStreamReader reader(output);
+  ASSERT_TRUE(reader
+                  .ReadRecords(std::function<absl::Status(DataRecordStruct)>(
+                      [&](DataRecordStruct data_record) {
+                        logical_commit_times.push_back(
+                            std::get<KeyValueMutationRecordStruct>(
+                                data_record.record)
+                                .logical_commit_time);
+                        return absl::OkStatus();
+                      }))
+                  .ok());
+  EXPECT_THAT(logical_commit_times, ElementsAre(8));
+}
+
+TEST(DiffSnapshotsCommandTest, UnsortedSnapshotFails) {
+  const std::string base_path =
+      WriteSnapshot("UnsortedSnapshotFails.base", {Record("a", "1")});
+  const std::string new_path = WriteSnapshot(
+      "UnsortedSnapshotFails.new", {Record("b", "1"), Record("a", "1")});
+  std::stringstream output;
+  auto command = DiffSnapshotsCommand::Create(
+      {.base_snapshot_file = base_path, .new_snapshot_file = new_path},
+      output);
+  ASSERT_TRUE(command.ok());
+  EXPECT_TRUE(absl::IsFailedPrecondition((*command)->Execute()));
+}
+
+TEST(DiffSnapshotsCommandTest, MissingSnapshotFails) {
+  std::stringstream output;
+  EXPECT_FALSE(DiffSnapshotsCommand::Create(
+                   {.base_snapshot_file = "missing",
+                    .new_snapshot_file = "missing"},
+                   output)
+                   .ok());
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -16,16 +16,26 @@
 
 #include "tools/data_cli/commands/format_data_command.h"
 
+#include <deque>
 #include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
 #include <utility>
+#include <vector>
 
+#include "absl/base/thread_annotations.h"
 #include "absl/memory/memory.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/ascii.h"
 #include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "components/util/thread_pool.h"
 #include "public/data_loading/csv/csv_delta_record_stream_reader.h"
 #include "public/data_loading/csv/csv_delta_record_stream_writer.h"
+#include "public/data_loading/csv/parallel_csv_delta_record_reader.h"
 #include "public/data_loading/readers/avro_delta_record_stream_reader.h"
 #include "public/data_loading/readers/delta_record_stream_reader.h"
 #include "public/data_loading/writers/avro_delta_record_stream_writer.h"
@@ -72,6 +82,15 @@ absl::Status ValidateParams(const FormatDataCommand::Params& params) {
         ". Valid inputs must satisfy the requirement: 0 <= shard_number < "
         "number_of_shards"));
   }
+  if (auto hash_version = ToShardingHashVersion(params.sharding_hash_version);
+      !hash_version.ok()) {
+    return hash_version.status();
+  }
+  if (params.conversion_threads > 0 && params.conversion_chunk_size <= 0) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("conversion_chunk_size must be positive, got ",
+                     params.conversion_chunk_size));
+  }
   return absl::OkStatus();
 }
 
@@ -123,13 +142,21 @@ absl::StatusOr<std::unique_ptr<DeltaRecordReader>> CreateRecordReader(
   if (lw_input_format == kCsvFormat) {
     PS_ASSIGN_OR_RETURN(auto record_type, GetRecordKind(params.record_type));
     PS_ASSIGN_OR_RETURN(auto csv_encoding, GetCsvEncoding(params.csv_encoding));
+    CsvDeltaRecordStreamReaderOptions csv_options{
+        .field_separator = params.csv_column_delimiter,
+        .value_separator = params.csv_value_delimiter,
+        .record_type = std::move(record_type),
+        .csv_encoding = std::move(csv_encoding),
+    };
+    if (params.csv_parser_threads > 0) {
+      return std::make_unique<ParallelCsvDeltaRecordReader>(
+          input_stream, ParallelCsvDeltaRecordReader::Options{
+                            .csv_options = std::move(csv_options),
+                            .num_worker_threads = params.csv_parser_threads,
+                        });
+    }
     return std::make_unique<CsvDeltaRecordStreamReader<std::istream>>(
-        input_stream, CsvDeltaRecordStreamReader<std::istream>::Options{
-                          .field_separator = params.csv_column_delimiter,
-                          .value_separator = params.csv_value_delimiter,
-                          .record_type = std::move(record_type),
-                          .csv_encoding = std::move(csv_encoding),
-                      });
+        input_stream, std::move(csv_options));
   }
   if (lw_input_format == kDeltaFormat) {
     return std::make_unique<DeltaRecordStreamReader<std::istream>>(
@@ -145,25 +172,32 @@ absl::StatusOr<std::unique_ptr<DeltaRecordReader>> CreateRecordReader(
       "Input format: ", params.input_format, " is not supported."));
 }
 
+absl::StatusOr<CsvDeltaRecordStreamWriter<std::ostream>::Options>
+GetCsvWriterOptions(const FormatDataCommand::Params& params) {
+  PS_ASSIGN_OR_RETURN(auto record_type, GetRecordType(params.record_type));
+  PS_ASSIGN_OR_RETURN(auto csv_encoding, GetCsvEncoding(params.csv_encoding));
+  return CsvDeltaRecordStreamWriter<std::ostream>::Options{
+      .field_separator = params.csv_column_delimiter,
+      .value_separator = params.csv_value_delimiter,
+      .record_type = std::move(record_type),
+      .csv_encoding = std::move(csv_encoding),
+  };
+}
+
 absl::StatusOr<std::unique_ptr<DeltaRecordWriter>> CreateRecordWriter(
     const FormatDataCommand::Params& params, std::ostream& output_stream) {
   std::string lw_output_format = absl::AsciiStrToLower(params.output_format);
   if (lw_output_format == kCsvFormat) {
-    PS_ASSIGN_OR_RETURN(auto record_type, GetRecordType(params.record_type));
-    PS_ASSIGN_OR_RETURN(auto csv_encoding, GetCsvEncoding(params.csv_encoding));
+    PS_ASSIGN_OR_RETURN(auto csv_options, GetCsvWriterOptions(params));
     return std::make_unique<CsvDeltaRecordStreamWriter<std::ostream>>(
-        output_stream, CsvDeltaRecordStreamWriter<std::ostream>::Options{
-                           .field_separator = params.csv_column_delimiter,
-                           .value_separator = params.csv_value_delimiter,
-                           .record_type = std::move(record_type),
-                           .csv_encoding = std::move(csv_encoding),
-                       });
+        output_stream, std::move(csv_options));
   }
   if (lw_output_format == kDeltaFormat) {
     KVFileMetadata metadata;
     if (params.shard_number >= 0) {
       auto* shard_metadata = metadata.mutable_sharding_metadata();
       shard_metadata->set_shard_num(params.shard_number);
+      shard_metadata->set_sharding_hash_version(params.sharding_hash_version);
     }
     return DeltaRecordStreamWriter<std::ostream>::Create(
         output_stream, DeltaRecordWriter::Options{.metadata = metadata});
@@ -181,6 +215,146 @@ absl::StatusOr<std::unique_ptr<DeltaRecordWriter>> CreateRecordWriter(
       "Output format: ", params.output_format, " is not supported."));
 }
 
+// Returns whether `data_record` is a key-value mutation whose key belongs to
+// another shard than `params.shard_number`, if the output is for a shard.
+// Entries of `KeyValueMutationBatch` records are checked one by one, as
+// `DeserializeDataRecord` calls back with each of them.
+bool IsOtherShardRecord(const FormatDataCommand::Params& params,
+                        const ShardingFunction& sharding_function,
+                        const DataRecordStruct& data_record) {
+  if (params.shard_number < 0) {
+    return false;
+  }
+  const auto* record =
+      std::get_if<KeyValueMutationRecordStruct>(&data_record.record);
+  if (record == nullptr) {
+    return false;
+  }
+  const int record_shard_num =
+      sharding_function.GetShardNumForKey(record->key, params.number_of_shards);
+  if (params.shard_number == record_shard_num) {
+    return false;
+  }
+  LOG(INFO) << "Skipping record with key: " << record->key
+            << " . The record belongs to shard: " << record_shard_num
+            << ", but shard_number is " << params.shard_number;
+  return true;
+}
+
+// The records of a chunk of read records, converted for the writer.
+struct ConvertedChunk {
+  // Serialized records that `records` refer to.
+  std::vector<flatbuffers::FlatBufferBuilder> buffers;
+  std::vector<DataRecordStruct> records;
+  // If the output is CSV, the records as CSV rows instead, so that they are
+  // formatted by the converters too.
+  std::string csv_rows;
+  int64_t num_records = 0;
+};
+
+absl::StatusOr<ConvertedChunk> ConvertChunk(
+    const FormatDataCommand::Params& params,
+    const ShardingFunction& sharding_function,
+    std::vector<std::unique_ptr<DataRecordT>> chunk) {
+  ConvertedChunk converted;
+  converted.buffers.reserve(chunk.size());
+  converted.records.reserve(chunk.size());
+  for (const auto& data_record : chunk) {
+    auto [fbs_buffer, serialized_string_view] = Serialize(*data_record);
+    PS_RETURN_IF_ERROR(DeserializeDataRecord(
+        serialized_string_view,
+        [&params, &sharding_function,
+         &converted](const DataRecordStruct& record) {
+          if (!IsOtherShardRecord(params, sharding_function, record)) {
+            converted.records.push_back(record);
+          }
+          return absl::OkStatus();
+        }));
+    // Moving the builder doesn't move the record bytes.
+    converted.buffers.push_back(std::move(fbs_buffer));
+  }
+  converted.num_records = converted.records.size();
+  if (absl::AsciiStrToLower(params.output_format) != kCsvFormat) {
+    return converted;
+  }
+  PS_ASSIGN_OR_RETURN(auto csv_options, GetCsvWriterOptions(params));
+  // The rows are appended after the header of the output.
+  csv_options.write_header = false;
+  std::ostringstream csv_stream;
+  CsvDeltaRecordStreamWriter<std::ostream> csv_writer(csv_stream,
+                                                      std::move(csv_options));
+  for (const DataRecordStruct& record : converted.records) {
+    PS_RETURN_IF_ERROR(csv_writer.WriteRecord(record));
+  }
+  csv_writer.Close();
+  PS_RETURN_IF_ERROR(csv_writer.Status());
+  converted.csv_rows = csv_stream.str();
+  converted.records.clear();
+  converted.buffers.clear();
+  return converted;
+}
+
+// The chunks being converted, in the order they were read, from the thread
+// that reads them to the one that writes them. Bounded, so that reading
+// waits for the converters and the writer.
+class ConvertedChunkQueue {
+ public:
+  using Chunk = TaskFuture<absl::StatusOr<ConvertedChunk>>;
+
+  explicit ConvertedChunkQueue(int max_chunks) : max_chunks_(max_chunks) {}
+
+  // Waits for room for `chunk`, returns false if writing stopped.
+  bool Push(Chunk chunk) ABSL_LOCKS_EXCLUDED(mutex_) {
+    absl::MutexLock lock(&mutex_);
+    mutex_.Await(
+        absl::Condition(this, &ConvertedChunkQueue::HasRoomOrIsCancelled));
+    if (cancelled_) {
+      return false;
+    }
+    chunks_.push_back(std::move(chunk));
+    return true;
+  }
+
+  // Returns the next chunk, or nothing once every chunk was read and popped.
+  std::optional<Chunk> Pop() ABSL_LOCKS_EXCLUDED(mutex_) {
+    absl::MutexLock lock(&mutex_);
+    mutex_.Await(
+        absl::Condition(this, &ConvertedChunkQueue::HasChunkOrIsFinished));
+    if (chunks_.empty()) {
+      return std::nullopt;
+    }
+    std::optional<Chunk> chunk(std::move(chunks_.front()));
+    chunks_.pop_front();
+    return chunk;
+  }
+
+  // Called once every chunk was pushed.
+  void Finish() ABSL_LOCKS_EXCLUDED(mutex_) {
+    absl::MutexLock lock(&mutex_);
+    finished_ = true;
+  }
+
+  // Called when writing stops, later pushes fail.
+  void Cancel() ABSL_LOCKS_EXCLUDED(mutex_) {
+    absl::MutexLock lock(&mutex_);
+    cancelled_ = true;
+  }
+
+ private:
+  bool HasRoomOrIsCancelled() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    return static_cast<int>(chunks_.size()) < max_chunks_ || cancelled_;
+  }
+  bool HasChunkOrIsFinished() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    return !chunks_.empty() || finished_;
+  }
+
+  const int max_chunks_;
+  absl::Mutex mutex_;
+  std::deque<Chunk> chunks_ ABSL_GUARDED_BY(mutex_);
+  bool finished_ ABSL_GUARDED_BY(mutex_) = false;
+  bool cancelled_ ABSL_GUARDED_BY(mutex_) = false;
+};
+
 }  // namespace
 
 absl::StatusOr<std::unique_ptr<FormatDataCommand>> FormatDataCommand::Create(
@@ -197,32 +371,31 @@ absl::StatusOr<std::unique_ptr<FormatDataCommand>> FormatDataCommand::Create(
     return record_writer.status();
   }
   return absl::WrapUnique(new FormatDataCommand(
-      std::move(*record_reader), std::move(*record_writer), params));
+      std::move(*record_reader), std::move(*record_writer), output_stream,
+      params));
 }
 
 absl::Status FormatDataCommand::Execute() {
   LOG(INFO) << "Formatting records ...";
+  absl::Status status = params_.conversion_threads > 0
+                            ? ConvertRecordsInParallel()
+                            : ConvertRecords();
+  record_writer_->Close();
+  if (status.ok()) {
+    LOG(INFO) << "Sucessfully formated records.";
+  } else {
+    LOG(ERROR) << "Failed to format records: " << status;
+  }
+  return status;
+}
+
+absl::Status FormatDataCommand::ConvertRecords() {
   int64_t records_count = 0;
-  ShardingFunction sharding_function(/*seed=*/"");
-  absl::Status status = record_reader_->ReadRecords([&records_count,
-                                                     &sharding_function,
-                                                     this](const DataRecord&
-                                                               data_record) {
-    if (params_.shard_number >= 0 &&
-        data_record.record_type() == Record::KeyValueMutationRecord) {
-      auto record_shard_num = sharding_function.GetShardNumForKey(
-          data_record.record_as_KeyValueMutationRecord()->key()->string_view(),
-          params_.number_of_shards);
-      if (params_.shard_number != record_shard_num) {
-        LOG(INFO) << "Skipping record with key: "
-                  << data_record.record_as_KeyValueMutationRecord()
-                         ->key()
-                         ->string_view()
-                  << " . The record belongs to shard: " << record_shard_num
-                  << ", but shard_number is " << params_.shard_number;
-        return absl::OkStatus();
-      }
-    }
+  ShardingFunction sharding_function(
+      /*seed=*/"",
+      static_cast<ShardingHashVersion>(params_.sharding_hash_version));
+  return record_reader_->ReadRecords([&records_count, &sharding_function,
+                                      this](const DataRecord& data_record) {
     records_count++;
     if ((double)std::rand() / RAND_MAX <= kSamplingThreshold) {
       LOG(INFO) << "Formatting record: " << records_count;
@@ -230,7 +403,11 @@ absl::Status FormatDataCommand::Execute() {
     std::unique_ptr<DataRecordT> data_record_native(data_record.UnPack());
     auto [fbs_buffer, serialized_string_view] = Serialize(*data_record_native);
     return DeserializeDataRecord(
-        serialized_string_view, [this](const DataRecordStruct& data_record) {
+        serialized_string_view,
+        [&sharding_function, this](const DataRecordStruct& data_record) {
+          if (IsOtherShardRecord(params_, sharding_function, data_record)) {
+            return absl::OkStatus();
+          }
           auto status = record_writer_->WriteRecord(data_record);
           if (!status.ok()) {
             LOG(ERROR) << "Failed to write record: " << status;
@@ -238,13 +415,85 @@ absl::Status FormatDataCommand::Execute() {
           return status;
         });
   });
-  record_writer_->Close();
-  if (status.ok()) {
-    LOG(INFO) << "Sucessfully formated records.";
-  } else {
-    LOG(ERROR) << "Failed to format records: " << status;
+}
+
+absl::Status FormatDataCommand::ConvertRecordsInParallel() {
+  const bool csv_output =
+      absl::AsciiStrToLower(params_.output_format) == kCsvFormat;
+  if (csv_output) {
+    // Writes the header, the converters format the rows that follow it.
+    record_writer_->Close();
+    PS_RETURN_IF_ERROR(record_writer_->Status());
   }
-  return status;
+  const ShardingFunction sharding_function(
+      /*seed=*/"",
+      static_cast<ShardingHashVersion>(params_.sharding_hash_version));
+  ThreadPool converters(params_.conversion_threads);
+  // Declared after `converters`, the chunks left on failure wait for them.
+  ConvertedChunkQueue queue(/*max_chunks=*/2 * params_.conversion_threads);
+  absl::Status write_status;
+  std::thread writer([&queue, &write_status, csv_output, this] {
+    int64_t records_count = 0;
+    while (std::optional<ConvertedChunkQueue::Chunk> chunk = queue.Pop()) {
+      absl::StatusOr<ConvertedChunk> converted = chunk->Get();
+      if (!converted.ok()) {
+        write_status = converted.status();
+        break;
+      }
+      if (csv_output) {
+        output_stream_.write(converted->csv_rows.data(),
+                             converted->csv_rows.size());
+        if (!output_stream_.good()) {
+          write_status = absl::InternalError("Failed to write CSV rows.");
+          break;
+        }
+      }
+      for (const DataRecordStruct& record : converted->records) {
+        write_status = record_writer_->WriteRecord(record);
+        if (!write_status.ok()) {
+          LOG(ERROR) << "Failed to write record: " << write_status;
+          break;
+        }
+      }
+      if (!write_status.ok()) {
+        break;
+      }
+      records_count += converted->num_records;
+      if ((double)std::rand() / RAND_MAX <= kSamplingThreshold) {
+        LOG(INFO) << "Formatted records: " << records_count;
+      }
+    }
+    queue.Cancel();
+  });
+  std::vector<std::unique_ptr<DataRecordT>> chunk;
+  const auto convert_chunk = [&chunk, &converters, &queue, &sharding_function,
+                              this] {
+    const bool pushed = queue.Push(converters.Async(
+        [&sharding_function, this, chunk = std::move(chunk)]() mutable {
+          return ConvertChunk(params_, sharding_function, std::move(chunk));
+        }));
+    chunk.clear();
+    chunk.reserve(params_.conversion_chunk_size);
+    return pushed;
+  };
+  chunk.reserve(params_.conversion_chunk_size);
+  absl::Status read_status =
+      record_reader_->ReadRecords([&chunk, &convert_chunk,
+                                   this](const DataRecord& data_record) {
+        chunk.emplace_back(data_record.UnPack());
+        if (static_cast<int>(chunk.size()) < params_.conversion_chunk_size ||
+            convert_chunk()) {
+          return absl::OkStatus();
+        }
+        return absl::CancelledError("Writing records stopped.");
+      });
+  if (read_status.ok() && !chunk.empty()) {
+    convert_chunk();
+  }
+  queue.Finish();
+  writer.join();
+  PS_RETURN_IF_ERROR(write_status);
+  return read_status;
 }
 
 }  //  namespace kv_server
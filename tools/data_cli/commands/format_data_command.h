@@ -61,8 +61,18 @@ class FormatDataCommand : public Command {
     char csv_value_delimiter = '|';
     std::string record_type = "KEY_VALUE_MUTATION_RECORD";
     std::string csv_encoding = "PLAINTEXT";
+    // If positive, CSV input is parsed in parallel by this many threads, see
+    // `ParallelCsvDeltaRecordReader`.
+    int32_t csv_parser_threads = 0;
+    // If positive, records are converted by this many threads, in chunks of
+    // `conversion_chunk_size` records, between the thread that reads them and
+    // one that writes them, in the order they were read.
+    int32_t conversion_threads = 0;
+    int32_t conversion_chunk_size = 1024;
     int64_t shard_number = -1;
     int64_t number_of_shards = -1;
+    // A `ShardingHashVersion` that keys are sharded with.
+    int32_t sharding_hash_version = 0;
   };
 
   static absl::StatusOr<std::unique_ptr<FormatDataCommand>> Create(
@@ -72,13 +82,20 @@ class FormatDataCommand : public Command {
  private:
   FormatDataCommand(std::unique_ptr<DeltaRecordReader> record_reader,
                     std::unique_ptr<DeltaRecordWriter> record_writer,
-                    Params params)
+                    std::ostream& output_stream, Params params)
       : record_reader_(std::move(record_reader)),
         record_writer_(std::move(record_writer)),
+        output_stream_(output_stream),
         params_(std::move(params)) {}
 
+  absl::Status ConvertRecords();
+  // Converts records with `Params.conversion_threads` threads.
+  absl::Status ConvertRecordsInParallel();
+
   std::unique_ptr<DeltaRecordReader> record_reader_;
   std::unique_ptr<DeltaRecordWriter> record_writer_;
+  // Where CSV rows converted in parallel are appended.
+  std::ostream& output_stream_;
   Params params_;
 };
 
@@ -16,15 +16,18 @@
 
 #include "tools/data_cli/commands/format_data_command.h"
 
+#include <string>
 #include <vector>
 
 #include "absl/strings/escaping.h"
+#include "absl/strings/str_cat.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "public/data_loading/csv/csv_delta_record_stream_reader.h"
 #include "public/data_loading/csv/csv_delta_record_stream_writer.h"
 #include "public/data_loading/readers/delta_record_stream_reader.h"
 #include "public/data_loading/writers/delta_record_stream_writer.h"
+#include "public/sharding/sharding_function.h"
 
 namespace kv_server {
 namespace {
@@ -499,5 +502,150 @@ TEST(FormatDataCommandTest, ValidateIncorrectShardingMetadataParams) {
       << status;
 }
 
+std::vector<std::string> GetKeys(int num_keys) {
+  std::vector<std::string> keys;
+  for (int i = 0; i < num_keys; ++i) {
+    keys.push_back(absl::StrCat("key", i));
+  }
+  return keys;
+}
+
+DataRecordStruct GetKVMutationRecordWithKey(std::string_view key) {
+  KeyValueMutationRecordStruct record = GetKVMutationRecord();
+  record.key = key;
+  return GetDataRecord(record);
+}
+
+absl::Status AppendKey(const DataRecord& record,
+                       std::vector<std::string>& keys) {
+  keys.push_back(record.record_as_KeyValueMutationRecord()->key()->str());
+  return absl::OkStatus();
+}
+
+TEST(FormatDataCommandTest, ConvertsCsvToDeltaInParallelInOrder) {
+  const std::vector<std::string> keys = GetKeys(25);
+  std::stringstream csv_stream;
+  std::stringstream delta_stream;
+  CsvDeltaRecordStreamWriter csv_writer(csv_stream);
+  for (const std::string& key : keys) {
+    EXPECT_TRUE(csv_writer.WriteRecord(GetKVMutationRecordWithKey(key)).ok());
+  }
+  csv_writer.Close();
+  auto params = GetParams();
+  params.conversion_threads = 3;
+  params.conversion_chunk_size = 2;
+  auto command = FormatDataCommand::Create(params, csv_stream, delta_stream);
+  ASSERT_TRUE(command.ok()) << command.status();
+  const absl::Status status = (*command)->Execute();
+  EXPECT_TRUE(status.ok()) << status;
+  DeltaRecordStreamReader delta_reader(delta_stream);
+  std::vector<std::string> actual_keys;
+  EXPECT_TRUE(delta_reader
+                  .ReadRecords([&actual_keys](const DataRecord& record) {
+                    return AppendKey(record, actual_keys);
+                  })
+                  .ok());
+  EXPECT_EQ(actual_keys, keys);
+}
+
+TEST(FormatDataCommandTest, ConvertsDeltaToCsvInParallelInOrder) {
+  const std::vector<std::string> keys = GetKeys(25);
+  std::stringstream delta_stream;
+  std::stringstream csv_stream;
+  auto delta_writer = DeltaRecordStreamWriter<std::stringstream>::Create(
+      delta_stream, DeltaRecordWriter::Options{.metadata = GetMetadata()});
+  ASSERT_TRUE(delta_writer.ok()) << delta_writer.status();
+  for (const std::string& key : keys) {
+    EXPECT_TRUE(
+        (*delta_writer)->WriteRecord(GetKVMutationRecordWithKey(key)).ok());
+  }
+  (*delta_writer)->Close();
+  auto command = FormatDataCommand::Create(
+      FormatDataCommand::Params{
+          .input_format = "DELTA",
+          .output_format = "CSV",
+          .record_type = "KEY_VALUE_MUTATION_RECORD",
+          .conversion_threads = 3,
+          .conversion_chunk_size = 2,
+      },
+      delta_stream, csv_stream);
+  ASSERT_TRUE(command.ok()) << command.status();
+  const absl::Status status = (*command)->Execute();
+  EXPECT_TRUE(status.ok()) << status;
+  // The reader fails on rows that aren't records, such as extra headers.
+  CsvDeltaRecordStreamReader csv_reader(csv_stream);
+  std::vector<std::string> actual_keys;
+  EXPECT_TRUE(csv_reader
+                  .ReadRecords([&actual_keys](const DataRecord& record) {
+                    return AppendKey(record, actual_keys);
+                  })
+                  .ok());
+  EXPECT_EQ(actual_keys, keys);
+}
+
+class FormatDataCommandBatchTest : public testing::TestWithParam<int> {
+ protected:
+  int GetConversionThreads() { return GetParam(); }
+};
+
+INSTANTIATE_TEST_SUITE_P(ConversionThreads, FormatDataCommandBatchTest,
+                         testing::Values(0, 3));
+
+TEST_P(FormatDataCommandBatchTest, FiltersBatchedRecordsOfOtherShards) {
+  const std::vector<std::string> keys = GetKeys(25);
+  std::stringstream delta_stream;
+  std::stringstream output_stream;
+  auto delta_writer = DeltaRecordStreamWriter<std::stringstream>::Create(
+      delta_stream, DeltaRecordWriter::Options{.metadata = GetMetadata(),
+                                               .key_value_batch_size = 10});
+  ASSERT_TRUE(delta_writer.ok()) << delta_writer.status();
+  for (const std::string& key : keys) {
+    EXPECT_TRUE(
+        (*delta_writer)->WriteRecord(GetKVMutationRecordWithKey(key)).ok());
+  }
+  (*delta_writer)->Close();
+  auto command = FormatDataCommand::Create(
+      FormatDataCommand::Params{
+          .input_format = "DELTA",
+          .output_format = "DELTA",
+          .record_type = "KEY_VALUE_MUTATION_RECORD",
+          .conversion_threads = GetConversionThreads(),
+          .conversion_chunk_size = 2,
+          .shard_number = 1,
+          .number_of_shards = 3,
+      },
+      delta_stream, output_stream);
+  ASSERT_TRUE(command.ok()) << command.status();
+  const absl::Status status = (*command)->Execute();
+  EXPECT_TRUE(status.ok()) << status;
+  const ShardingFunction sharding_function(/*seed=*/"");
+  std::vector<std::string> expected_keys;
+  for (const std::string& key : keys) {
+    if (sharding_function.GetShardNumForKey(key, 3) == 1) {
+      expected_keys.push_back(key);
+    }
+  }
+  ASSERT_FALSE(expected_keys.empty());
+  ASSERT_LT(expected_keys.size(), keys.size());
+  DeltaRecordStreamReader delta_reader(output_stream);
+  std::vector<std::string> actual_keys;
+  EXPECT_TRUE(delta_reader
+                  .ReadRecords([&actual_keys](const DataRecord& record) {
+                    return AppendKey(record, actual_keys);
+                  })
+                  .ok());
+  EXPECT_EQ(actual_keys, expected_keys);
+}
+
+TEST(FormatDataCommandTest, NonPositiveConversionChunkSizeFails) {
+  std::stringstream csv_stream;
+  std::stringstream delta_stream;
+  auto params = GetParams();
+  params.conversion_threads = 2;
+  params.conversion_chunk_size = 0;
+  auto command = FormatDataCommand::Create(params, csv_stream, delta_stream);
+  EXPECT_FALSE(command.ok());
+}
+
 }  // namespace
 }  // namespace kv_server
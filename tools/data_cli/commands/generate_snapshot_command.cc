@@ -17,23 +17,32 @@
 #include "tools/data_cli/commands/generate_snapshot_command.h"
 
 #include <algorithm>
+#include <atomic>
 #include <filesystem>
 #include <fstream>
 #include <functional>
 #include <memory>
+#include <optional>
+#include <string>
 #include <utility>
+#include <variant>
 #include <vector>
 
+#include "absl/hash/hash.h"
 #include "absl/memory/memory.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
+#include "absl/synchronization/mutex.h"
 #include "components/data/blob_storage/blob_storage_client.h"
+#include "components/util/thread_pool.h"
 #include "public/constants.h"
 #include "public/data_loading/filename_utils.h"
 #include "public/data_loading/readers/delta_record_stream_reader.h"
+#include "public/data_loading/readers/riegeli_stream_io.h"
 #include "public/data_loading/riegeli_metadata.pb.h"
 #include "public/sharding/sharding_function.h"
 #include "src/telemetry/telemetry_provider.h"
@@ -58,6 +67,39 @@ class FileBlobReader : public BlobReader {
   std::ifstream file_stream_;
 };
 
+// Holds an input stream pointing to a blob of Riegeli records.
+class BlobRecordStream : public RecordStream {
+ public:
+  explicit BlobRecordStream(std::unique_ptr<BlobReader> blob_reader)
+      : blob_reader_(std::move(blob_reader)) {}
+  std::istream& Stream() override { return blob_reader_->Stream(); }
+  std::optional<std::string_view> Contents() override {
+    return blob_reader_->Contents();
+  }
+
+ private:
+  std::unique_ptr<BlobReader> blob_reader_;
+};
+
+// One file of a partitioned snapshot, with the records of the keys that hash
+// to it.
+struct SnapshotPartition {
+  ~SnapshotPartition() {
+    writer.reset();
+    stream.close();
+    std::filesystem::remove(temp_file);
+    std::filesystem::remove(temp_data_file);
+  }
+
+  std::string filename;
+  std::filesystem::path temp_file;
+  std::filesystem::path temp_data_file;
+  std::ofstream stream;
+  // Guards `writer` against the concurrent reader threads.
+  absl::Mutex mutex;
+  std::unique_ptr<SnapshotStreamWriter<std::ostream>> writer;
+};
+
 constexpr std::string_view kStdioSymbol = "-";
 
 absl::Status ValidateRequiredParams(GenerateSnapshotCommand::Params& params) {
@@ -89,6 +131,18 @@ absl::Status ValidateRequiredParams(GenerateSnapshotCommand::Params& params) {
         ". Valid inputs must satisfy the requirement: 0 <= shard_number < "
         "number_of_shards"));
   }
+  if (auto hash_version = ToShardingHashVersion(params.sharding_hash_version);
+      !hash_version.ok()) {
+    return hash_version.status();
+  }
+  if (params.num_partitions < 1) {
+    return absl::InvalidArgumentError(
+        "Number of partitions must be at least 1.");
+  }
+  if (params.num_partitions > 1 && !IsSnapshotFilename(params.snapshot_file)) {
+    return absl::InvalidArgumentError(
+        "Snapshot file must be a valid snapshot filename to be partitioned.");
+  }
   return absl::OkStatus();
 }
 
@@ -121,6 +175,7 @@ absl::StatusOr<KVFileMetadata> CreateSnapshotMetadata(
   if (params.shard_number >= 0) {
     auto* sharding_metadata = metadata.mutable_sharding_metadata();
     sharding_metadata->set_shard_num(params.shard_number);
+    sharding_metadata->set_sharding_hash_version(params.sharding_hash_version);
   }
   return metadata;
 }
@@ -130,27 +185,46 @@ void ResetInputStream(std::istream& istream) {
   istream.seekg(0, std::ios::beg);
 }
 
+ShardingFunction CreateShardingFunction(
+    const GenerateSnapshotCommand::Params& params) {
+  return ShardingFunction(
+      /*seed=*/"",
+      static_cast<ShardingHashVersion>(params.sharding_hash_version));
+}
+
+// Returns true if `data_record` is a key-value record of another shard than
+// the one the snapshot is generated for.
+bool IsOtherShardRecord(const GenerateSnapshotCommand::Params& params,
+                        const ShardingFunction& sharding_function,
+                        const DataRecordStruct& data_record) {
+  if (params.shard_number < 0 ||
+      !std::holds_alternative<KeyValueMutationRecordStruct>(
+          data_record.record)) {
+    return false;
+  }
+  const auto& record_struct =
+      std::get<KeyValueMutationRecordStruct>(data_record.record);
+  auto record_shard_num = sharding_function.GetShardNumForKey(
+      record_struct.key, params.number_of_shards);
+  if (params.shard_number == record_shard_num) {
+    return false;
+  }
+  VLOG(2) << "Skipping record with key: " << record_struct.key
+          << " . The record belongs to shard: " << record_shard_num
+          << ", but shard_number is " << params.shard_number;
+  return true;
+}
+
 absl::Status WriteRecordsToSnapshotStream(
     const GenerateSnapshotCommand::Params& params,
     DeltaRecordStreamReader<std::istream>& record_reader,
     SnapshotStreamWriter<std::ostream>& snapshot_writer) {
-  ShardingFunction sharding_function(/*seed=*/"");
+  ShardingFunction sharding_function = CreateShardingFunction(params);
   return record_reader.ReadRecords(
       [&params, &snapshot_writer,
        &sharding_function](DataRecordStruct data_record) {
-        if (params.shard_number >= 0 &&
-            std::holds_alternative<KeyValueMutationRecordStruct>(
-                data_record.record)) {
-          KeyValueMutationRecordStruct record_struct =
-              std::get<KeyValueMutationRecordStruct>(data_record.record);
-          auto record_shard_num = sharding_function.GetShardNumForKey(
-              record_struct.key, params.number_of_shards);
-          if (params.shard_number != record_shard_num) {
-            LOG(INFO) << "Skipping record with key: " << record_struct.key
-                      << " . The record belongs to shard: " << record_shard_num
-                      << ", but shard_number is " << params.shard_number;
-            return absl::OkStatus();
-          }
+        if (IsOtherShardRecord(params, sharding_function, data_record)) {
+          return absl::OkStatus();
         }
         return snapshot_writer.WriteRecord(data_record);
       });
@@ -178,11 +252,12 @@ absl::StatusOr<std::string> WriteBaseSnapshotData(
   return metadata->snapshot().ending_delta_file();
 }
 
-absl::Status WriteDeltaFilesToSnapshot(
+// Calls `compact_file` with each of `delta_files` in order, up to the ending
+// delta file.
+absl::Status CompactDeltaFiles(
     const std::vector<std::string>& delta_files,
     const GenerateSnapshotCommand::Params& params,
-    BlobStorageClient& blob_client,
-    SnapshotStreamWriter<std::ostream>& snapshot_writer) {
+    const std::function<absl::Status(const std::string&)>& compact_file) {
   for (const auto& delta_file : delta_files) {
     LOG(INFO) << "Compacting delta file: " << delta_file;
     if (!IsDeltaFilename(delta_file)) {
@@ -194,16 +269,235 @@ absl::Status WriteDeltaFilesToSnapshot(
                 << "is out of range. So we are done processing, skippping it.";
       break;
     }
+    if (auto status = compact_file(delta_file); !status.ok()) {
+      return status;
+    }
+    LOG(INFO) << "Successfully compacted delta file: " << delta_file;
+  }
+  return absl::OkStatus();
+}
+
+absl::Status WriteDeltaFilesToSnapshot(
+    const std::vector<std::string>& delta_files,
+    const GenerateSnapshotCommand::Params& params,
+    BlobStorageClient& blob_client,
+    SnapshotStreamWriter<std::ostream>& snapshot_writer) {
+  return CompactDeltaFiles(
+      delta_files, params,
+      [&params, &blob_client, &snapshot_writer](const std::string& delta_file) {
+        auto blob_reader = blob_client.GetBlobReader(
+            {.bucket = params.data_dir.data(), .key = delta_file});
+        DeltaRecordStreamReader record_reader(blob_reader->Stream());
+        return WriteRecordsToSnapshotStream(params, record_reader,
+                                            snapshot_writer);
+      });
+}
+
+// Returns the delta files after `start_after_delta_file`, including it if it
+// is the starting file.
+absl::StatusOr<std::vector<std::string>> ListDeltaFiles(
+    const GenerateSnapshotCommand::Params& params,
+    BlobStorageClient& blob_client, std::string_view start_after_delta_file) {
+  auto delta_files =
+      blob_client.ListBlobs({.bucket = params.data_dir},
+                            {.prefix = FilePrefix<FileType::DELTA>().data(),
+                             .start_after = start_after_delta_file.data()});
+  if (!delta_files.ok()) {
+    return delta_files.status();
+  }
+  if (IsDeltaFilename(params.starting_file)) {
+    delta_files->insert(delta_files->begin(), start_after_delta_file.data());
+  }
+  return delta_files;
+}
+
+// Writes the records of `filename` to the partitions of their keys, reading
+// the file concurrently, and returns the metadata of the file.
+absl::StatusOr<KVFileMetadata> WriteFileToPartitions(
+    const GenerateSnapshotCommand::Params& params,
+    BlobStorageClient& blob_client, const std::string& filename,
+    const std::vector<std::unique_ptr<SnapshotPartition>>& partitions) {
+  ConcurrentStreamRecordReader<std::string_view> record_reader(
+      [&params, &blob_client, &filename]() {
+        return std::make_unique<BlobRecordStream>(blob_client.GetBlobReader(
+            {.bucket = params.data_dir, .key = filename}));
+      });
+  auto metadata = record_reader.GetKVFileMetadata();
+  if (!metadata.ok()) {
+    return metadata.status();
+  }
+  const ShardingFunction sharding_function = CreateShardingFunction(params);
+  std::atomic<bool> has_shard_mappings = false;
+  const std::function<absl::Status(const DataRecordStruct&)> write_record =
+      [&params, &partitions, &sharding_function,
+       &has_shard_mappings](const DataRecordStruct& data_record) {
+        if (std::holds_alternative<ShardMappingRecordStruct>(
+                data_record.record)) {
+          has_shard_mappings = true;
+          return absl::OkStatus();
+        }
+        if (IsOtherShardRecord(params, sharding_function, data_record)) {
+          return absl::OkStatus();
+        }
+        // Records without a key, such as UDF configs, go to the first
+        // partition.
+        size_t partition_index = 0;
+        if (const auto* record = std::get_if<KeyValueMutationRecordStruct>(
+                &data_record.record)) {
+          partition_index = absl::HashOf(record->key) % partitions.size();
+        }
+        SnapshotPartition& partition = *partitions[partition_index];
+        absl::MutexLock lock(&partition.mutex);
+        return partition.writer->WriteRecord(data_record);
+      };
+  const auto read_record = [&write_record](std::string_view record_bytes) {
+    return DeserializeDataRecord(record_bytes, write_record);
+  };
+  absl::Status status =
+      params.shard_number >= 0
+          ? record_reader.ReadShardStreamRecords(
+                params.shard_number, params.number_of_shards,
+                params.sharding_hash_version, read_record)
+          : record_reader.ReadStreamRecords(read_record);
+  if (!status.ok()) {
+    return status;
+  }
+  if (has_shard_mappings) {
+    // Shard mappings are merged in the order of the file, which the
+    // concurrent reader doesn't keep, so they are read again in order.
     auto blob_reader = blob_client.GetBlobReader(
-        {.bucket = params.data_dir.data(), .key = delta_file});
-    DeltaRecordStreamReader record_reader(blob_reader->Stream());
-    if (auto status = WriteRecordsToSnapshotStream(params, record_reader,
-                                                   snapshot_writer);
+        {.bucket = params.data_dir, .key = filename});
+    DeltaRecordStreamReader shard_mapping_reader(blob_reader->Stream());
+    status = shard_mapping_reader.ReadRecords(
+        [&partitions](DataRecordStruct data_record) {
+          if (!std::holds_alternative<ShardMappingRecordStruct>(
+                  data_record.record)) {
+            return absl::OkStatus();
+          }
+          return partitions[0]->writer->WriteRecord(data_record);
+        });
+    if (!status.ok()) {
+      return status;
+    }
+  }
+  return metadata;
+}
+
+// Compacts the records into `params.num_partitions` snapshot files in
+// parallel, and writes them as one file group.
+absl::Status WritePartitionedSnapshot(
+    const GenerateSnapshotCommand::Params& params,
+    const KVFileMetadata& snapshot_metadata, BlobStorageClient& blob_client) {
+  uint64_t logical_commit_time = 0;
+  if (!absl::SimpleAtoi(
+          std::string_view(params.snapshot_file)
+              .substr(FilePrefix<FileType::SNAPSHOT>().size() +
+                      kFileComponentDelimiter.size()),
+          &logical_commit_time)) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Invalid snapshot filename: ", params.snapshot_file));
+  }
+  // The memory budget is shared by the partitions.
+  const int64_t memory_budget_bytes =
+      params.sort_merge_memory_budget_mb > 0
+          ? std::max<int64_t>(params.sort_merge_memory_budget_mb * 1024 *
+                                  1024 / params.num_partitions,
+                              1)
+          : 0;
+  std::vector<std::unique_ptr<SnapshotPartition>> partitions;
+  for (int32_t i = 0; i < params.num_partitions; i++) {
+    auto partition = std::make_unique<SnapshotPartition>();
+    auto filename = ToFileGroupFileName(FileType::SNAPSHOT, logical_commit_time,
+                                        i, params.num_partitions);
+    if (!filename.ok()) {
+      return filename.status();
+    }
+    partition->filename = *std::move(filename);
+    partition->temp_file =
+        std::filesystem::path(params.working_dir) / partition->filename;
+    if (!params.in_memory_compaction) {
+      partition->temp_data_file =
+          absl::StrCat(partition->temp_file.string(), ".db");
+    }
+    std::filesystem::remove(partition->temp_file);
+    std::filesystem::remove(partition->temp_data_file);
+    partition->stream.open(partition->temp_file);
+    auto writer = SnapshotStreamWriter<std::ostream>::Create(
+        {.metadata = snapshot_metadata,
+         .temp_data_file = partition->temp_data_file.string(),
+         .sort_merge_memory_budget_bytes = memory_budget_bytes,
+         .spill_directory = params.working_dir,
+         .key_index_section_bytes = params.key_index_section_kb * 1024},
+        partition->stream);
+    if (!writer.ok()) {
+      return writer.status();
+    }
+    partition->writer = *std::move(writer);
+    partitions.push_back(std::move(partition));
+  }
+  std::string start_after_delta_file = params.starting_file;
+  if (IsSnapshotFilename(params.starting_file)) {
+    LOG(INFO) << "Compacting base snapshot file: " << params.starting_file;
+    auto metadata = WriteFileToPartitions(params, blob_client,
+                                          params.starting_file, partitions);
+    if (!metadata.ok()) {
+      return metadata.status();
+    }
+    start_after_delta_file = metadata->snapshot().ending_delta_file();
+  }
+  auto delta_files =
+      ListDeltaFiles(params, blob_client, start_after_delta_file);
+  if (!delta_files.ok()) {
+    return delta_files.status();
+  }
+  if (auto status = CompactDeltaFiles(
+          *delta_files, params,
+          [&params, &blob_client, &partitions](const std::string& delta_file) {
+            return WriteFileToPartitions(params, blob_client, delta_file,
+                                         partitions)
+                .status();
+          });
+      !status.ok()) {
+    return status;
+  }
+  std::vector<TaskFuture<absl::Status>> finalize_tasks;
+  for (const auto& partition : partitions) {
+    finalize_tasks.push_back(
+        SharedThreadPool().Async([partition = partition.get()]() {
+          if (auto status = partition->writer->Finalize(); !status.ok()) {
+            return status;
+          }
+          partition->stream.close();
+          if (!partition->stream) {
+            return absl::InternalError(absl::StrCat(
+                "Failed to write ", partition->temp_file.string()));
+          }
+          return absl::OkStatus();
+        }));
+  }
+  absl::Status status;
+  for (auto& finalize_task : finalize_tasks) {
+    if (absl::Status finalize_status = finalize_task.Get(); status.ok()) {
+      status = std::move(finalize_status);
+    }
+  }
+  if (!status.ok()) {
+    return status;
+  }
+  for (const auto& partition : partitions) {
+    FileBlobReader file_blob_reader(partition->temp_file);
+    LOG(INFO) << "Writing snapshot file: " << params.data_dir << "/"
+              << partition->filename;
+    if (auto status = blob_client.PutBlob(
+            file_blob_reader,
+            {.bucket = params.data_dir, .key = partition->filename});
         !status.ok()) {
       return status;
     }
-    LOG(INFO) << "Successfully compacted delta file: " << delta_file;
   }
+  LOG(INFO) << "Successfully wrote " << partitions.size()
+            << " snapshot files: " << params.data_dir << "/"
+            << params.snapshot_file;
   return absl::OkStatus();
 }
 }  // namespace
@@ -238,6 +532,10 @@ absl::Status GenerateSnapshotCommand::Execute() {
   if (!snapshot_metadata.ok()) {
     return snapshot_metadata.status();
   }
+  if (params_.num_partitions > 1) {
+    return WritePartitionedSnapshot(params_, *snapshot_metadata,
+                                    *blob_client_);
+  }
   const std::filesystem::path temp_snapshot(GetTempSnapshotFile(params_));
   std::ofstream snapshot_ofstream(temp_snapshot);
   std::ostream* snapshot_ostream =
@@ -246,7 +544,11 @@ absl::Status GenerateSnapshotCommand::Execute() {
       {.metadata = *snapshot_metadata,
        .temp_data_file = params_.in_memory_compaction
                              ? ""
-                             : GetTempAggregatorDbFile(params_)},
+                             : GetTempAggregatorDbFile(params_),
+       .sort_merge_memory_budget_bytes =
+           params_.sort_merge_memory_budget_mb * 1024 * 1024,
+       .spill_directory = params_.working_dir,
+       .key_index_section_bytes = params_.key_index_section_kb * 1024},
       *snapshot_ostream);
   if (!snapshot_writer.ok()) {
     return snapshot_writer.status();
@@ -261,15 +563,10 @@ absl::Status GenerateSnapshotCommand::Execute() {
     start_after_delta_file = *snapshot_end_file;
   }
   auto delta_files =
-      blob_client_->ListBlobs({.bucket = params_.data_dir},
-                              {.prefix = FilePrefix<FileType::DELTA>().data(),
-                               .start_after = start_after_delta_file.data()});
+      ListDeltaFiles(params_, *blob_client_, start_after_delta_file);
   if (!delta_files.ok()) {
     return delta_files.status();
   }
-  if (IsDeltaFilename(params_.starting_file)) {
-    delta_files->insert(delta_files->begin(), start_after_delta_file.data());
-  }
   if (auto status = WriteDeltaFilesToSnapshot(*delta_files, params_,
                                               *blob_client_, **snapshot_writer);
       !status.ok()) {
@@ -37,8 +37,22 @@ class GenerateSnapshotCommand : public Command {
     std::string ending_delta_file;
     std::string snapshot_file;
     bool in_memory_compaction;
+    // If positive, records are compacted by sort-merge, spilling sorted runs
+    // to `working_dir` above this many MB of records, instead of SQLite.
+    int64_t sort_merge_memory_budget_mb = 0;
+    // If positive, the records of the snapshot are sorted by key in sections
+    // of about this many KB, indexed in the snapshot metadata. Requires
+    // `sort_merge_memory_budget_mb`.
+    int64_t key_index_section_kb = 0;
+    // If greater than 1, the records are hash partitioned by key into this
+    // many snapshot files, which are compacted in parallel, and written as one
+    // file group named after `snapshot_file`. The input files are read
+    // concurrently.
+    int32_t num_partitions = 1;
     int64_t shard_number = -1;
     int64_t number_of_shards = -1;
+    // A `ShardingHashVersion` that keys are sharded with.
+    int32_t sharding_hash_version = 0;
   };
 
   ~GenerateSnapshotCommand();
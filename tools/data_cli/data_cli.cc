@@ -24,9 +24,11 @@
 #include "absl/log/log.h"
 #include "components/util/platform_initializer.h"
 #include "tools/data_cli/commands/command.h"
+#include "tools/data_cli/commands/diff_snapshots_command.h"
 #include "tools/data_cli/commands/format_data_command.h"
 #include "tools/data_cli/commands/generate_snapshot_command.h"
 
+using kv_server::DiffSnapshotsCommand;
 using kv_server::FormatDataCommand;
 using kv_server::GenerateSnapshotCommand;
 
@@ -53,6 +55,25 @@ ABSL_FLAG(
 ABSL_FLAG(
     bool, in_memory_compaction, true,
     "If true, delta file compaction to generate snapshots is done in memory.");
+ABSL_FLAG(int64_t, sort_merge_memory_budget_mb, 0,
+          "If positive, delta file compaction is done by sort-merge, spilling "
+          "sorted runs of records to working_dir above this many MB of "
+          "records. Takes precedence over in_memory_compaction.");
+ABSL_FLAG(int64_t, snapshot_key_index_section_kb, 0,
+          "If positive, the records of snapshots are sorted by key in sections "
+          "of about this many KB, indexed in the snapshot metadata so that "
+          "readers seek to the records of a key. Requires "
+          "sort_merge_memory_budget_mb.");
+ABSL_FLAG(int32_t, snapshot_partitions, 1,
+          "If greater than 1, the snapshot is compacted in parallel into this "
+          "many files, hash partitioned by key, written as one file group. "
+          "snapshot_file must then be a snapshot filename.");
+ABSL_FLAG(std::string, base_snapshot_file, "",
+          "Snapshot file that servers loaded, to diff the new one against.");
+ABSL_FLAG(std::string, new_snapshot_file, "",
+          "Snapshot file to write the changes from the base snapshot of.");
+ABSL_FLAG(int32_t, diff_partitions, 1,
+          "Number of key ranges that snapshots are diffed in parallel.");
 ABSL_FLAG(std::string, csv_column_delimiter, ",",
           "Column delimiter for csv files");
 ABSL_FLAG(std::string, csv_value_delimiter, "|",
@@ -65,11 +86,21 @@ ABSL_FLAG(std::string, csv_encoding, "plaintext",
           "Encoding for KEY_VALUE_MUTATION_RECORD values for "
           "CSVs. options=(PLAINTEXT|BASE64)."
           "If the values are binary, BASE64 is recommended.");
+ABSL_FLAG(int32_t, csv_parser_threads, 0,
+          "If positive, CSV input is parsed in parallel by this many threads.");
+ABSL_FLAG(int32_t, conversion_threads, 0,
+          "If positive, format_data converts records in parallel with this "
+          "many threads, keeping their order.");
+ABSL_FLAG(int32_t, conversion_chunk_size, 1024,
+          "Number of records that each conversion thread converts at a time.");
 ABSL_FLAG(int64_t, shard_number, -1,
           "The shard number for output DELTA or SNAPSHOT files.");
 ABSL_FLAG(
     int64_t, number_of_shards, -1,
     "Total number of shards. Must be > --shard_number if shard_number >= 0.");
+ABSL_FLAG(int32_t, sharding_hash_version, 0,
+          "Version of the hash that keys are sharded with. 0 for SHA-256, 1 "
+          "for HighwayHash. Must match the servers' sharding-hash-version.");
 
 constexpr std::string_view kUsageMessage = R"(
 Usage: data_cli <command> <flags>
@@ -87,8 +118,12 @@ Commands:
     [--csv_encoding]     (Optional) Defaults to "PLAINTEXT". Encoding for KEY_VALUE_MUTATION_RECORD values for CSVs.
                                   Possible options=(PLAINTEXT|BASE64).
                                   If the values are binary, BASE64 is recommended.
+    [--csv_parser_threads] (Optional) Defaults to 0. If positive, CSV input is parsed in parallel by this many threads.
+    [--conversion_threads] (Optional) Defaults to 0. If positive, records are converted in parallel by this many threads, in order.
+    [--conversion_chunk_size] (Optional) Defaults to 1024. Records converted at a time by each conversion thread.
     [--shard_number]     (Optional) Defaults to -1 (i.e., not specified).
     [--number_of_shards] (Optional) Defaults to -1 (i.e., not specified). Must be > --shard_number if shard_number >= 0.
+    [--sharding_hash_version] (Optional) Defaults to 0, SHA-256. Possible options=(0|1). 1 is HighwayHash.
   Examples:
     (1) Generate a csv file to a delta file and write output records to std::cout.
     - data_cli format_data --input_file="$PWD/data.csv"
@@ -110,22 +145,40 @@ Commands:
     [--data_dir]                (Required) Directory with input delta files.
     [--working_dir]             (Optional) Defaults to "/tmp". Directory used to write temporary data.
     [--in_memory_compaction]    (Optional) Defaults to true. If false, file backed compaction is used.
+    [--sort_merge_memory_budget_mb] (Optional) Defaults to 0. If positive, sort-merge compaction is used, spilling to --working_dir above this many MB.
+    [--snapshot_key_index_section_kb] (Optional) Defaults to 0. If positive, the snapshot is indexed by key in sections of this many KB. Requires --sort_merge_memory_budget_mb.
+    [--snapshot_partitions]     (Optional) Defaults to 1. If greater, --snapshot_file is written as a file group of this many files, compacted in parallel.
     [--shard_number]            (Optional) Defaults to -1 (i.e., not specified).
     [--number_of_shards]        (Optional) Defaults to -1 (i.e., not specified). Must be > --shard_number if shard_number >= 0.
+    [--sharding_hash_version]   (Optional) Defaults to 0, SHA-256. Possible options=(0|1). 1 is HighwayHash.
   Examples:
     (1) Generate snapshot using delta files from local disk.
     - data_cli generate_snapshot --data_dir="$DATA_DIR" --starting_file="DELTA_1670532228628680" \
         --ending_delta_file="DELTA_1670532717393878" --snapshot_file="SNAPSHOT_0000000000000003"
 
+- diff_snapshots                Writes a delta file with the changes from a base snapshot to a new one.
+                                Both snapshots must be sorted by key, as written with --sort_merge_memory_budget_mb.
+    [--base_snapshot_file]      (Required) Local snapshot file that servers loaded.
+    [--new_snapshot_file]       (Required) Local snapshot file with the new data.
+    [--output_file]             (Optional) Defaults to stdout. Output delta file.
+    [--diff_partitions]         (Optional) Defaults to 1. Number of key ranges diffed in parallel.
+  Examples:
+    (1) Publish the changes of a new daily dataset.
+    - data_cli diff_snapshots --base_snapshot_file="$PWD/SNAPSHOT_0000000000000003" \
+        --new_snapshot_file="$PWD/SNAPSHOT_0000000000000004" --output_file="$PWD/DELTA_1670619117393878" \
+        --diff_partitions=16
+
 Try --help to see detailed flag descriptions and associated default values.
 )";
 
 constexpr std::string_view kStdioSymbol = "-";
 constexpr std::string_view kFormatDataCommand = "format_data";
 constexpr std::string_view kGenerateSnapshotCommand = "generate_snapshot";
+constexpr std::string_view kDiffSnapshotsCommand = "diff_snapshots";
 constexpr std::array kSupportedCommands = {
     kFormatDataCommand,
     kGenerateSnapshotCommand,
+    kDiffSnapshotsCommand,
 };
 
 bool IsSupportedCommand(std::string_view command) {
@@ -180,8 +233,14 @@ int main(int argc, char** argv) {
             .csv_value_delimiter = absl::GetFlag(FLAGS_csv_value_delimiter)[0],
             .record_type = absl::GetFlag(FLAGS_record_type),
             .csv_encoding = absl::GetFlag(FLAGS_csv_encoding),
+            .csv_parser_threads = absl::GetFlag(FLAGS_csv_parser_threads),
+            .conversion_threads = absl::GetFlag(FLAGS_conversion_threads),
+            .conversion_chunk_size =
+                absl::GetFlag(FLAGS_conversion_chunk_size),
             .shard_number = absl::GetFlag(FLAGS_shard_number),
             .number_of_shards = absl::GetFlag(FLAGS_number_of_shards),
+            .sharding_hash_version =
+                absl::GetFlag(FLAGS_sharding_hash_version),
         },
         *i_stream, *o_stream);
     if (!format_data_command.ok()) {
@@ -203,8 +262,15 @@ int main(int argc, char** argv) {
             .ending_delta_file = absl::GetFlag(FLAGS_ending_delta_file),
             .snapshot_file = absl::GetFlag(FLAGS_snapshot_file),
             .in_memory_compaction = absl::GetFlag(FLAGS_in_memory_compaction),
+            .sort_merge_memory_budget_mb =
+                absl::GetFlag(FLAGS_sort_merge_memory_budget_mb),
+            .key_index_section_kb =
+                absl::GetFlag(FLAGS_snapshot_key_index_section_kb),
+            .num_partitions = absl::GetFlag(FLAGS_snapshot_partitions),
             .shard_number = absl::GetFlag(FLAGS_shard_number),
             .number_of_shards = absl::GetFlag(FLAGS_number_of_shards),
+            .sharding_hash_version =
+                absl::GetFlag(FLAGS_sharding_hash_version),
         });
     if (!generate_snapshot_command.ok()) {
       LOG(ERROR) << "Failed to create command to generate snapshot. "
@@ -217,5 +283,29 @@ int main(int argc, char** argv) {
       return -1;
     }
   }
+  if (command_name == kDiffSnapshotsCommand) {
+    std::ofstream o_fstream(absl::GetFlag(FLAGS_output_file),
+                            std::ios::binary);
+    std::ostream* o_stream = kStdioSymbol == absl::GetFlag(FLAGS_output_file)
+                                 ? &std::cout
+                                 : &o_fstream;
+    auto diff_snapshots_command = DiffSnapshotsCommand::Create(
+        DiffSnapshotsCommand::Params{
+            .base_snapshot_file = absl::GetFlag(FLAGS_base_snapshot_file),
+            .new_snapshot_file = absl::GetFlag(FLAGS_new_snapshot_file),
+            .num_partitions = absl::GetFlag(FLAGS_diff_partitions),
+        },
+        *o_stream);
+    if (!diff_snapshots_command.ok()) {
+      LOG(ERROR) << "Failed to create command to diff snapshots. "
+                 << diff_snapshots_command.status();
+      return -1;
+    }
+    if (absl::Status status = (*diff_snapshots_command)->Execute();
+        !status.ok()) {
+      LOG(ERROR) << "Failed to execute diff snapshots command. " << status;
+      return -1;
+    }
+  }
   return 0;
 }
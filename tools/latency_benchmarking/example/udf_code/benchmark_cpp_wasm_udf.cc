@@ -13,6 +13,7 @@
 // limitations under the License.
 
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
@@ -20,6 +21,7 @@
 #include "emscripten/bind.h"
 #include "nlohmann/json.hpp"
 #include "public/udf/binary_get_values.pb.h"
+#include "public/udf/flat_get_values.h"
 
 namespace {
 
@@ -152,6 +154,79 @@ absl::StatusOr<std::map<std::string, std::string>> GetKvPairsBinaryAsMap(
   return kv_map;
 }
 
+// Calls getValuesFlat for a list of keys and calls `fn` with each key that
+// has a value and its value. The output of each call is copied into `buffer`,
+// which is reused across calls, and its values are read in place, without
+// parsing it.
+template <typename Fn>
+absl::Status ForEachKvPairFlat(const emscripten::val& get_values_flat_cb,
+                               const std::vector<emscripten::val>& lookup_data,
+                               std::string& buffer, Fn fn) {
+  for (const auto& keys : lookup_data) {
+    // `get_values_flat_cb` returns an emscripten::val of type Uint8Array,
+    // which is copied into `buffer` at once, instead of element by element.
+    const emscripten::val output = get_values_flat_cb(keys);
+    const size_t size = output["length"].as<size_t>();
+    buffer.resize(size);
+    emscripten::val(emscripten::typed_memory_view(size, buffer.data()))
+        .call<void>("set", output);
+    const auto view = kv_server::FlatGetValuesView::Create(buffer);
+    if (!view.has_value()) {
+      return absl::InternalError("getValuesFlat output is not flat");
+    }
+    if (view->status_code() != 0) {
+      return absl::InternalError(std::string(view->status_message()));
+    }
+    for (size_t i = 0; i < view->size(); ++i) {
+      const auto entry = view->entry(i);
+      if (entry.status_code == 0) {
+        fn(entry.key, entry.value);
+      }
+    }
+  }
+  return absl::OkStatus();
+}
+
+absl::StatusOr<emscripten::val> GetKvPairsFlatAsEmVal(
+    const emscripten::val& get_values_flat_cb,
+    const std::vector<emscripten::val>& lookup_data) {
+  emscripten::val kv_pairs = emscripten::val::object();
+  kv_pairs.set("udfApi", "getValuesFlat");
+  std::string buffer;
+  if (const auto status = ForEachKvPairFlat(
+          get_values_flat_cb, lookup_data, buffer,
+          [&kv_pairs](std::string_view key, std::string_view value) {
+            kv_pairs.set(std::string(key), std::string(value));
+          });
+      !status.ok()) {
+    return status;
+  }
+  return kv_pairs;
+}
+
+absl::StatusOr<std::map<std::string, std::string>> GetKvPairsFlatAsMap(
+    const emscripten::val& get_values_flat_cb,
+    const std::vector<emscripten::val>& lookup_data) {
+  std::map<std::string, std::string> kv_map;
+  kv_map["udfApi"] = "getValuesFlat";
+  std::string buffer;
+  if (const auto status = ForEachKvPairFlat(
+          get_values_flat_cb, lookup_data, buffer,
+          [&kv_map](std::string_view key, std::string_view value) {
+            kv_map[std::string(key)] = std::string(value);
+          });
+      !status.ok()) {
+    return status;
+  }
+  return kv_map;
+}
+
+// Returns whether `request_metadata` sets the boolean `field`.
+bool IsSet(const emscripten::val& request_metadata, const char* field) {
+  return request_metadata.hasOwnProperty(field) &&
+         request_metadata[field].as<bool>();
+}
+
 std::vector<emscripten::val> MaybeSplitDataByBatchSize(
     const emscripten::val& request_metadata, const emscripten::val& data) {
   if (!request_metadata.hasOwnProperty("lookup_batch_size")) {
@@ -174,6 +249,7 @@ std::vector<emscripten::val> MaybeSplitDataByBatchSize(
 // tools/latency_benchmarking/example/udf_code/benchmark_udf.js
 emscripten::val GetKeyGroupOutputs(const emscripten::val& get_values_cb,
                                    const emscripten::val& get_values_binary_cb,
+                                   const emscripten::val& get_values_flat_cb,
                                    const emscripten::val& request_metadata,
                                    const emscripten::val& udf_arguments) {
   emscripten::val key_group_outputs = emscripten::val::array();
@@ -188,10 +264,13 @@ emscripten::val GetKeyGroupOutputs(const emscripten::val& get_values_cb,
     std::vector<emscripten::val> lookup_data =
         MaybeSplitDataByBatchSize(request_metadata, data);
     absl::StatusOr<emscripten::val> kv_pairs;
-    kv_pairs = request_metadata.hasOwnProperty("useGetValuesBinary") &&
-                       request_metadata["useGetValuesBinary"].as<bool>()
-                   ? GetKvPairsBinaryAsEmVal(get_values_binary_cb, lookup_data)
-                   : GetKvPairsAsEmVal(get_values_cb, lookup_data);
+    if (IsSet(request_metadata, "useGetValuesFlat")) {
+      kv_pairs = GetKvPairsFlatAsEmVal(get_values_flat_cb, lookup_data);
+    } else if (IsSet(request_metadata, "useGetValuesBinary")) {
+      kv_pairs = GetKvPairsBinaryAsEmVal(get_values_binary_cb, lookup_data);
+    } else {
+      kv_pairs = GetKvPairsAsEmVal(get_values_cb, lookup_data);
+    }
     if (kv_pairs.ok()) {
       key_group_output.set("keyValues", *kv_pairs);
       key_group_outputs.call<void>("push", key_group_output);
@@ -202,11 +281,13 @@ emscripten::val GetKeyGroupOutputs(const emscripten::val& get_values_cb,
 
 emscripten::val HandleGetValuesFlow(const emscripten::val& get_values_cb,
                                     const emscripten::val& get_values_binary_cb,
+                                    const emscripten::val& get_values_flat_cb,
                                     const emscripten::val& request_metadata,
                                     const emscripten::val& udf_arguments) {
   emscripten::val result = emscripten::val::object();
-  emscripten::val key_group_outputs = GetKeyGroupOutputs(
-      get_values_cb, get_values_binary_cb, request_metadata, udf_arguments);
+  emscripten::val key_group_outputs =
+      GetKeyGroupOutputs(get_values_cb, get_values_binary_cb,
+                         get_values_flat_cb, request_metadata, udf_arguments);
   result.set("keyGroupOutputs", key_group_outputs);
   result.set("udfOutputApiVersion", emscripten::val(1));
   return result;
@@ -214,12 +295,13 @@ emscripten::val HandleGetValuesFlow(const emscripten::val& get_values_cb,
 
 // The run query flow performs the following steps:
 // 1. Compute the set union of given arguments using `runQuery` API
-// 2. Call `getValues`/`getValuesBinary` with first
+// 2. Call `getValues`/`getValuesBinary`/`getValuesFlat` with first
 // `lookup_n_keys_from_runquery` keys
 // 3. Sort returned KVs
 // 4. Return top 5 KV pairs
 emscripten::val HandleRunQueryFlow(const emscripten::val& get_values_cb,
                                    const emscripten::val& get_values_binary_cb,
+                                   const emscripten::val& get_values_flat_cb,
                                    const emscripten::val& run_query_cb,
                                    const emscripten::val& request_metadata,
                                    const emscripten::val& udf_arguments) {
@@ -242,11 +324,14 @@ emscripten::val HandleRunQueryFlow(const emscripten::val& get_values_cb,
   emscripten::val lookup_keys = keys.call<emscripten::val>("slice", 0, n);
   std::vector<emscripten::val> lookup_data =
       MaybeSplitDataByBatchSize(request_metadata, lookup_keys);
-  absl::StatusOr<std::map<std::string, std::string>> kv_map =
-      request_metadata.hasOwnProperty("useGetValuesBinary") &&
-              request_metadata["useGetValuesBinary"].as<bool>()
-          ? GetKvPairsBinaryAsMap(get_values_binary_cb, lookup_data)
-          : GetKvPairsAsMap(get_values_cb, lookup_data);
+  absl::StatusOr<std::map<std::string, std::string>> kv_map;
+  if (IsSet(request_metadata, "useGetValuesFlat")) {
+    kv_map = GetKvPairsFlatAsMap(get_values_flat_cb, lookup_data);
+  } else if (IsSet(request_metadata, "useGetValuesBinary")) {
+    kv_map = GetKvPairsBinaryAsMap(get_values_binary_cb, lookup_data);
+  } else {
+    kv_map = GetKvPairsAsMap(get_values_cb, lookup_data);
+  }
   if (!kv_map.ok()) {
     return result;
   }
@@ -273,16 +358,18 @@ emscripten::val HandleRunQueryFlow(const emscripten::val& get_values_cb,
 
 emscripten::val HandleRequestCc(const emscripten::val& get_values_cb,
                                 const emscripten::val& get_values_binary_cb,
+                                const emscripten::val& get_values_flat_cb,
                                 const emscripten::val& run_query_cb,
                                 const emscripten::val& request_metadata,
                                 const emscripten::val& udf_arguments) {
-  if (request_metadata.hasOwnProperty("runQuery") &&
-      request_metadata["runQuery"].as<bool>()) {
-    return HandleRunQueryFlow(get_values_cb, get_values_binary_cb, run_query_cb,
+  if (IsSet(request_metadata, "runQuery")) {
+    return HandleRunQueryFlow(get_values_cb, get_values_binary_cb,
+                              get_values_flat_cb, run_query_cb,
                               request_metadata, udf_arguments);
   }
   return HandleGetValuesFlow(get_values_cb, get_values_binary_cb,
-                             request_metadata, udf_arguments);
+                             get_values_flat_cb, request_metadata,
+                             udf_arguments);
 }
 
 EMSCRIPTEN_BINDINGS(HandleRequestExample) {
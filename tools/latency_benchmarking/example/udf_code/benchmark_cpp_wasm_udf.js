@@ -19,6 +19,7 @@ async function HandleRequest(executionMetadata, ...udf_arguments) {
   const result = module.handleRequestCc(
     getValues,
     getValuesBinary,
+    getValuesFlat,
     runQuery,
     executionMetadata.requestMetadata,
     udf_arguments
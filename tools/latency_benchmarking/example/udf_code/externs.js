@@ -32,3 +32,14 @@ function runQuery(query) {} // Note the empty body.
  * @externs
  */
 function getValuesBinary(keyList) {} // Note the empty body.
+
+/**
+ * Returns the lookup of the keyList in the flat layout of
+ * public/udf/flat_get_values.h.
+ *
+ * This function is provided by the K/V server as a part of the
+ * UDF API and needs to be marked as @externs for the Closure Compiler.
+ *
+ * @externs
+ */
+function getValuesFlat(keyList) {} // Note the empty body.
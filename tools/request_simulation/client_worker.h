@@ -18,11 +18,15 @@
 #define TOOLS_REQUEST_SIMULATION_CLIENT_WORKER_H_
 
 #include <memory>
+#include <optional>
 #include <string>
 #include <utility>
 
 #include "absl/functional/any_invocable.h"
 #include "absl/log/log.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "components/data/common/thread_manager.h"
 #include "grpcpp/grpcpp.h"
 #include "tools/request_simulation/grpc_client.h"
@@ -32,6 +36,18 @@
 
 namespace kv_server {
 
+// Options of workers that send requests open-loop, on a fixed schedule,
+// whether or not the previous requests completed. The latency of a request is
+// measured from when it was scheduled, so that a slow server doesn't lower the
+// load it gets and hide the latency of the requests it delays.
+struct OpenLoopOptions {
+  // Requests per second sent by the worker.
+  double requests_per_second = 0;
+  // Requests in flight above which the worker waits. Requests sent late count
+  // the wait in their latency.
+  int max_outstanding_requests = 10000;
+};
+
 template <typename RequestT, typename ResponseT>
 class ClientWorker {
  public:
@@ -55,16 +71,21 @@ class ClientWorker {
   // Message queue to read and send requests from
   //
   // Rate limiter to control the rate of the requests sent.
+  //
+  // Open-loop options to send the requests on a schedule instead, without the
+  // rate limiter.
   ClientWorker(int id, std::shared_ptr<grpc::Channel> channel,
                std::string_view service_method, absl::Duration request_timeout,
                absl::AnyInvocable<RequestT(std::string)> request_converter,
                MessageQueue& message_queue, RateLimiter& rate_limiter,
                MetricsCollector& metrics_collector,
-               bool is_client_channel = true)
+               bool is_client_channel = true,
+               std::optional<OpenLoopOptions> open_loop_options = std::nullopt)
       : service_method_(service_method),
         message_queue_(message_queue),
         rate_limiter_(rate_limiter),
         metrics_collector_(metrics_collector),
+        open_loop_options_(std::move(open_loop_options)),
         request_converter_(std::move(request_converter)),
         thread_manager_(
             ThreadManager::Create(absl::StrCat("Client worker ", id))) {
@@ -85,10 +106,16 @@ class ClientWorker {
  private:
   // The actual function that sends requests.
   void SendRequests();
+  // Sends requests on the schedule of `open_loop_options_`.
+  void SendRequestsOpenLoop();
+  void RecordResponse(const absl::Status& status, absl::Duration latency);
   std::string service_method_;
   MessageQueue& message_queue_;
   RateLimiter& rate_limiter_;
   MetricsCollector& metrics_collector_;
+  const std::optional<OpenLoopOptions> open_loop_options_;
+  absl::Mutex outstanding_requests_mutex_;
+  int outstanding_requests_ ABSL_GUARDED_BY(outstanding_requests_mutex_) = 0;
   // Grpc client used to send requests.
   std::unique_ptr<GrpcClient<RequestT, ResponseT>> grpc_client_;
   absl::AnyInvocable<RequestT(std::string)> request_converter_;
@@ -98,7 +125,13 @@ class ClientWorker {
 
 template <typename RequestT, typename ResponseT>
 absl::Status ClientWorker<RequestT, ResponseT>::Start() {
-  return thread_manager_->Start([this]() { SendRequests(); });
+  return thread_manager_->Start([this]() {
+    if (open_loop_options_.has_value()) {
+      SendRequestsOpenLoop();
+    } else {
+      SendRequests();
+    }
+  });
 }
 
 template <typename RequestT, typename ResponseT>
@@ -126,15 +159,7 @@ void ClientWorker<RequestT, ResponseT>::SendRequests() {
         auto status =
             grpc_client_->SendMessage(request_converter_(request_body.value()),
                                       service_method_, response);
-        metrics_collector_.IncrementServerResponseStatusEvent(status);
-        if (!status.ok()) {
-          VLOG(8) << "Received error in response " << status;
-          metrics_collector_.IncrementRequestsWithErrorResponsePerInterval();
-        } else {
-          metrics_collector_.IncrementRequestsWithOkResponsePerInterval();
-          metrics_collector_.AddLatencyToHistogram(absl::Now() - start);
-          VLOG(9) << "Received ok response";
-        }
+        RecordResponse(status, absl::Now() - start);
       }
     } else {
       VLOG(8) << "Acquire timeout";
@@ -142,6 +167,70 @@ void ClientWorker<RequestT, ResponseT>::SendRequests() {
   }
 }
 
+template <typename RequestT, typename ResponseT>
+void ClientWorker<RequestT, ResponseT>::SendRequestsOpenLoop() {
+  const absl::Duration interval =
+      absl::Seconds(1) / open_loop_options_->requests_per_second;
+  absl::Time scheduled_time = absl::Now();
+  auto has_capacity = [this]() ABSL_EXCLUSIVE_LOCKS_REQUIRED(
+                          outstanding_requests_mutex_) {
+    return outstanding_requests_ < open_loop_options_->max_outstanding_requests;
+  };
+  while (!thread_manager_->ShouldStop()) {
+    if (const absl::Time now = absl::Now(); scheduled_time > now) {
+      absl::SleepFor(scheduled_time - now);
+      continue;
+    }
+    {
+      absl::MutexLock lock(&outstanding_requests_mutex_);
+      if (!outstanding_requests_mutex_.AwaitWithTimeout(
+              absl::Condition(&has_capacity), absl::Milliseconds(10))) {
+        continue;
+      }
+    }
+    const absl::Time request_scheduled_time = scheduled_time;
+    scheduled_time += interval;
+    const auto request_body = message_queue_.Pop();
+    if (!request_body.ok()) {
+      VLOG(8) << "No message to send at its scheduled time";
+      continue;
+    }
+    VLOG(8) << "Sending message " << request_body.value();
+    metrics_collector_.IncrementRequestSentPerInterval();
+    {
+      absl::MutexLock lock(&outstanding_requests_mutex_);
+      ++outstanding_requests_;
+    }
+    grpc_client_->SendMessageAsync(
+        request_converter_(request_body.value()), service_method_,
+        std::make_shared<ResponseT>(),
+        [this, request_scheduled_time](absl::Status status) {
+          RecordResponse(status, absl::Now() - request_scheduled_time);
+          absl::MutexLock lock(&outstanding_requests_mutex_);
+          --outstanding_requests_;
+        });
+  }
+  // The callbacks of the requests in flight use the worker.
+  absl::MutexLock lock(&outstanding_requests_mutex_);
+  outstanding_requests_mutex_.Await(absl::Condition(
+      +[](int* outstanding_requests) { return *outstanding_requests == 0; },
+      &outstanding_requests_));
+}
+
+template <typename RequestT, typename ResponseT>
+void ClientWorker<RequestT, ResponseT>::RecordResponse(
+    const absl::Status& status, absl::Duration latency) {
+  metrics_collector_.IncrementServerResponseStatusEvent(status);
+  if (!status.ok()) {
+    VLOG(8) << "Received error in response " << status;
+    metrics_collector_.IncrementRequestsWithErrorResponsePerInterval();
+  } else {
+    metrics_collector_.IncrementRequestsWithOkResponsePerInterval();
+    metrics_collector_.AddLatencyToHistogram(latency);
+    VLOG(9) << "Received ok response";
+  }
+}
+
 }  // namespace kv_server
 
 #endif  // TOOLS_REQUEST_SIMULATION_CLIENT_WORKER_H_
@@ -15,6 +15,7 @@
 #include "tools/request_simulation/client_worker.h"
 
 #include <algorithm>
+#include <atomic>
 #include <memory>
 #include <string>
 #include <utility>
@@ -92,7 +93,7 @@ TEST_F(ClientWorkerTest, SingleClientWorkerTest) {
                            std::move(sleep_for_), absl::Seconds(0));
   EXPECT_CALL(*sleep_for_metrics_collector_, Duration(_))
       .WillRepeatedly(Return(true));
-  EXPECT_CALL(metrics_recorder_, RegisterHistogram(_, _, _, _)).Times(5);
+  EXPECT_CALL(metrics_recorder_, RegisterHistogram(_, _, _, _)).Times(7);
   std::unique_ptr<MockMetricsCollector> metrics_collector =
       std::make_unique<MockMetricsCollector>(
           metrics_recorder_, std::move(sleep_for_metrics_collector_));
@@ -136,7 +137,7 @@ TEST_F(ClientWorkerTest, MultipleClientWorkersTest) {
                            std::move(sleep_for_), absl::Seconds(0));
   EXPECT_CALL(*sleep_for_metrics_collector_, Duration(_))
       .WillRepeatedly(Return(true));
-  EXPECT_CALL(metrics_recorder_, RegisterHistogram(_, _, _, _)).Times(5);
+  EXPECT_CALL(metrics_recorder_, RegisterHistogram(_, _, _, _)).Times(7);
   std::unique_ptr<MockMetricsCollector> metrics_collector =
       std::make_unique<MockMetricsCollector>(
           metrics_recorder_, std::move(sleep_for_metrics_collector_));
@@ -169,6 +170,58 @@ TEST_F(ClientWorkerTest, MultipleClientWorkersTest) {
   }
   EXPECT_EQ(message_queue.Size(), 500);
 }
+
+TEST_F(ClientWorkerTest, OpenLoopClientWorkerSendsOnSchedule) {
+  std::string key("key");
+  std::string method("/kv_server.v2.KeyValueService/GetValuesHttp");
+  auto request_converter = [](const std::string& request_body) {
+    RawRequest request;
+    request.mutable_raw_body()->set_data(request_body);
+    return request;
+  };
+
+  MessageQueue message_queue(10000);
+  int num_of_messages_prefill = 1500;
+  PrefillMessageQueue(message_queue, num_of_messages_prefill, key);
+
+  // Not used by open loop workers.
+  RateLimiter rate_limiter(0, 1, sim_clock_, std::move(sleep_for_),
+                           absl::Seconds(0));
+  EXPECT_CALL(*sleep_for_metrics_collector_, Duration(_))
+      .WillRepeatedly(Return(true));
+  EXPECT_CALL(metrics_recorder_, RegisterHistogram(_, _, _, _)).Times(7);
+  std::unique_ptr<MockMetricsCollector> metrics_collector =
+      std::make_unique<MockMetricsCollector>(
+          metrics_recorder_, std::move(sleep_for_metrics_collector_));
+  std::atomic<int> requests_sent = 0;
+  std::atomic<int> ok_responses = 0;
+  EXPECT_CALL(*metrics_collector, IncrementServerResponseStatusEvent(_))
+      .Times(testing::AnyNumber());
+  EXPECT_CALL(*metrics_collector, IncrementRequestSentPerInterval())
+      .WillRepeatedly([&requests_sent]() { ++requests_sent; });
+  EXPECT_CALL(*metrics_collector, IncrementRequestsWithOkResponsePerInterval())
+      .WillRepeatedly([&ok_responses]() { ++ok_responses; });
+  EXPECT_CALL(*metrics_collector, AddLatencyToHistogram(_))
+      .WillRepeatedly([](absl::Duration latency) {
+        EXPECT_GE(latency, absl::ZeroDuration());
+      });
+  auto worker =
+      std::make_unique<ClientWorker<RawRequest, google::api::HttpBody>>(
+          0, server_->InProcessChannel(grpc::ChannelArguments()), method,
+          absl::Seconds(1), request_converter, message_queue, rate_limiter,
+          *metrics_collector, false,
+          OpenLoopOptions{.requests_per_second = 100});
+  EXPECT_TRUE(worker->Start().ok());
+  EXPECT_TRUE(worker->IsRunning());
+  absl::SleepFor(absl::Seconds(1));
+  EXPECT_TRUE(worker->Stop().ok());
+  // Every request sent completed before the worker stopped.
+  EXPECT_EQ(ok_responses, requests_sent);
+  EXPECT_GT(requests_sent, 50);
+  EXPECT_LT(requests_sent, 150);
+  EXPECT_EQ(message_queue.Size(), num_of_messages_prefill - requests_sent);
+}
+
 }  // namespace
 
 }  // namespace kv_server
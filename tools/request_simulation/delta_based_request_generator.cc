@@ -121,22 +121,36 @@ DeltaBasedRequestGenerator::CreateRequestsAndAddToMessageQueue(
     return metadata.status();
   }
   DataLoadingStats data_loading_stats;
-  const auto process_data_record_fn = [this, &data_loading_stats](
-                                          const DataRecord& data_record) {
-    if (data_record.record_type() == Record::KeyValueMutationRecord) {
-      const auto* record = data_record.record_as_KeyValueMutationRecord();
-      if (record->value_type() == Value::StringValue) {
-        options_.message_queue.Push(
-            request_generation_fn_(record->key()->string_view()));
-        if (record->mutation_type() == KeyValueMutationType::Update) {
-          data_loading_stats.total_updated_records++;
-        } else if (record->mutation_type() == KeyValueMutationType::Delete) {
-          data_loading_stats.total_deleted_records++;
-        }
-        return absl::OkStatus();
-      }
+  const auto add_request = [this, &data_loading_stats](
+                               std::string_view key,
+                               KeyValueMutationType mutation_type) {
+    options_.message_queue.Push(request_generation_fn_(key));
+    if (mutation_type == KeyValueMutationType::Update) {
+      data_loading_stats.total_updated_records++;
+    } else if (mutation_type == KeyValueMutationType::Delete) {
+      data_loading_stats.total_deleted_records++;
     }
+    return absl::OkStatus();
   };
+  const auto process_data_record_fn =
+      [&add_request](const DataRecord& data_record) {
+        if (data_record.record_type() == Record::KeyValueMutationRecord) {
+          const auto* record = data_record.record_as_KeyValueMutationRecord();
+          if (record->value_type() == Value::StringValue) {
+            return add_request(record->key()->string_view(),
+                               record->mutation_type());
+          }
+        }
+        // The entries of batches all have string values.
+        if (data_record.record_type() == Record::KeyValueMutationBatch) {
+          return ForEachKeyValueMutation(
+              *data_record.record_as_KeyValueMutationBatch(),
+              [&add_request](const KeyValueMutationRecordStruct& record) {
+                return add_request(record.key, record.mutation_type);
+              });
+        }
+        return absl::OkStatus();
+      };
   auto status = record_reader->ReadStreamRecords(
       [&process_data_record_fn](std::string_view raw) {
         return DeserializeDataRecord(raw, process_data_record_fn);
@@ -35,6 +35,7 @@ using kv_server::DataRecordStruct;
 using kv_server::DeltaBasedRequestGenerator;
 using kv_server::FilePrefix;
 using kv_server::FileType;
+using kv_server::KeyValueMutationBatchBuilder;
 using kv_server::KeyValueMutationRecordStruct;
 using kv_server::KeyValueMutationType;
 using kv_server::KVFileMetadata;
@@ -150,4 +151,62 @@ TEST_F(GenerateRequestsFromDeltaFilesTest, LoadingDataFromDeltaFiles) {
             kv_server::CreateKVDSPRequestBodyInJson({std::string("key")}));
 }
 
+TEST_F(GenerateRequestsFromDeltaFilesTest, LoadingBatchedDataFromDeltaFiles) {
+  ON_CALL(blob_client_, ListBlobs)
+      .WillByDefault(Return(std::vector<std::string>({})));
+  DeltaBasedRequestGenerator request_generator(
+      std::move(options_), std::move(GetRequestGenFn()), metrics_recorder_);
+  EXPECT_CALL(notifier_, Start)
+      .WillOnce([](BlobStorageChangeNotifier&, BlobStorageClient::DataLocation,
+                   absl::flat_hash_map<std::string, std::string>,
+                   std::function<void(const std::string& key)> callback) {
+        callback(ToDeltaFileName(1).value());
+        return absl::OkStatus();
+      });
+  EXPECT_CALL(notifier_, IsRunning).Times(1).WillOnce(Return(true));
+  EXPECT_CALL(notifier_, Stop()).Times(1).WillOnce(Return(absl::OkStatus()));
+
+  absl::Notification all_records_loaded;
+  auto update_reader = std::make_unique<MockStreamRecordReader>();
+  EXPECT_CALL(*update_reader, GetKVFileMetadata)
+      .Times(1)
+      .WillOnce(Return(KVFileMetadata()));
+  EXPECT_CALL(*update_reader, ReadStreamRecords)
+      .Times(1)
+      .WillOnce([&all_records_loaded](
+                    const std::function<absl::Status(std::string_view)>&
+                        callback) {
+        KeyValueMutationBatchBuilder batch;
+        batch.Add({KeyValueMutationType::Update, 3, "key1", "value"});
+        batch.Add({KeyValueMutationType::Delete, 3, "key2", "value"});
+        flatbuffers::FlatBufferBuilder builder;
+        callback(batch.Serialize(builder)).IgnoreError();
+        // Records without requests to generate are skipped.
+        callback(ToStringView(ToFlatBufferBuilder(DataRecordStruct{
+                     .record = UserDefinedFunctionsConfigStruct{
+                         .language = UserDefinedFunctionsLanguage::Javascript,
+                         .code_snippet = "function hello(){}",
+                         .handler_name = "hello",
+                         .logical_commit_time = 1,
+                         .version = 1}})))
+            .IgnoreError();
+        all_records_loaded.Notify();
+        return absl::OkStatus();
+      });
+  EXPECT_CALL(delta_stream_reader_factory_, CreateConcurrentReader)
+      .Times(1)
+      .WillOnce(Return(ByMove(std::move(update_reader))));
+  EXPECT_TRUE(request_generator.Start().ok());
+  ASSERT_TRUE(all_records_loaded.WaitForNotificationWithTimeout(
+      absl::Seconds(2)));
+  EXPECT_TRUE(request_generator.Stop().ok());
+  ASSERT_EQ(message_queue_.Size(), 2);
+  for (const std::string key : {"key1", "key2"}) {
+    auto message_in_the_queue = message_queue_.Pop();
+    ASSERT_TRUE(message_in_the_queue.ok());
+    EXPECT_EQ(message_in_the_queue.value(),
+              kv_server::CreateKVDSPRequestBodyInJson({key}));
+  }
+}
+
 }  // namespace
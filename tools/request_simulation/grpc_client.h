@@ -23,6 +23,8 @@
 
 #include "absl/functional/any_invocable.h"
 #include "absl/status/statusor.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "absl/synchronization/notification.h"
 #include "grpcpp/generic/generic_stub.h"
 #include "grpcpp/grpcpp.h"
@@ -82,24 +84,28 @@ inline std::string AbslUnparseFlag(GrpcAuthenticationMode mode) {
   }
 }
 
-// Creates a grpc channel from server address and authentication mode.
+// Creates a grpc channel from server address and authentication mode, with
+// `args` such as the compression of the channel.
 inline std::shared_ptr<grpc::Channel> CreateGrpcChannel(
-    const std::string& server_address,
-    const GrpcAuthenticationMode& auth_mode) {
+    const std::string& server_address, const GrpcAuthenticationMode& auth_mode,
+    const grpc::ChannelArguments& args = grpc::ChannelArguments()) {
   switch (auth_mode) {
     case GrpcAuthenticationMode::kGoogleDefaultCredential:
-      return grpc::CreateChannel(server_address,
-                                 grpc::GoogleDefaultCredentials());
+      return grpc::CreateCustomChannel(
+          server_address, grpc::GoogleDefaultCredentials(), args);
     case GrpcAuthenticationMode::kALTS:
-      return grpc::CreateChannel(
-          server_address, grpc::experimental::AltsCredentials(
-                              grpc::experimental::AltsCredentialsOptions()));
+      return grpc::CreateCustomChannel(
+          server_address,
+          grpc::experimental::AltsCredentials(
+              grpc::experimental::AltsCredentialsOptions()),
+          args);
     case GrpcAuthenticationMode::kSsl:
-      return grpc::CreateChannel(
-          server_address, grpc::SslCredentials(grpc::SslCredentialsOptions()));
+      return grpc::CreateCustomChannel(
+          server_address, grpc::SslCredentials(grpc::SslCredentialsOptions()),
+          args);
     default:
-      return grpc::CreateChannel(server_address,
-                                 grpc::InsecureChannelCredentials());
+      return grpc::CreateCustomChannel(
+          server_address, grpc::InsecureChannelCredentials(), args);
   }
 }
 
@@ -156,6 +162,33 @@ class GrpcClient {
     }
     return *grpc_status;
   }
+  // Sends message via grpc unary call without waiting for the response, and
+  // calls `on_done` with the status of the call once it completes, on a grpc
+  // thread.
+  void SendMessageAsync(RequestT request, const std::string& request_method,
+                        std::shared_ptr<ResponseT> response,
+                        absl::AnyInvocable<void(absl::Status)> on_done) {
+    if (is_client_channel_ &&
+        grpc_channel_->GetState(true) != GRPC_CHANNEL_READY) {
+      on_done(absl::UnavailableError("GRPC channel is disconnected"));
+      return;
+    }
+    // Kept alive by the callback until the call completes.
+    auto call_request = std::make_shared<RequestT>(std::move(request));
+    auto client_context = std::make_shared<grpc::ClientContext>();
+    client_context->set_deadline(absl::ToChronoTime(absl::Now() + timeout_));
+    auto call_on_done =
+        std::make_shared<absl::AnyInvocable<void(absl::Status)>>(
+            std::move(on_done));
+    generic_stub_->UnaryCall(
+        client_context.get(), request_method, grpc::StubOptions(),
+        call_request.get(), response.get(),
+        [client_context, call_request, response,
+         call_on_done](grpc::Status status) {
+          (*call_on_done)(absl::Status(absl::StatusCode(status.error_code()),
+                                       status.error_message()));
+        });
+  }
 
  private:
   absl::Duration timeout_;
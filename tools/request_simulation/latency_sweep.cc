@@ -0,0 +1,353 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tools/request_simulation/latency_sweep.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <type_traits>
+
+#include "absl/status/status.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "nlohmann/json.hpp"
+
+namespace kv_server {
+namespace {
+
+using Json = nlohmann::json;
+
+constexpr std::string_view kCompressions[] = {"none", "deflate", "gzip"};
+
+// Reads the list of `field` into `values`, keeping the default when `config`
+// doesn't have the field.
+template <typename T>
+absl::Status ReadDimension(const Json& config, std::string_view field,
+                           std::vector<T>& values) {
+  const auto it = config.find(field);
+  if (it == config.end()) {
+    return absl::OkStatus();
+  }
+  if (!it->is_array() || it->empty()) {
+    return absl::InvalidArgumentError(
+        absl::StrCat(field, " must be a non empty list"));
+  }
+  values.clear();
+  for (const Json& value : *it) {
+    if constexpr (std::is_same_v<T, std::string>) {
+      if (!value.is_string()) {
+        return absl::InvalidArgumentError(
+            absl::StrCat(field, " must be a list of strings"));
+      }
+    } else if (!value.is_number_integer() || value.get<int64_t>() < 0) {
+      return absl::InvalidArgumentError(
+          absl::StrCat(field, " must be a list of non negative integers"));
+    }
+    values.push_back(value.get<T>());
+  }
+  return absl::OkStatus();
+}
+
+template <typename T>
+absl::Status ReadNumber(const Json& config, std::string_view field,
+                        T& value) {
+  const auto it = config.find(field);
+  if (it == config.end()) {
+    return absl::OkStatus();
+  }
+  if (!it->is_number() || it->get<double>() < 0) {
+    return absl::InvalidArgumentError(
+        absl::StrCat(field, " must be a non negative number"));
+  }
+  value = it->get<T>();
+  return absl::OkStatus();
+}
+
+absl::Status ReadSeconds(const Json& config, std::string_view field,
+                         absl::Duration& value) {
+  double seconds = absl::ToDoubleSeconds(value);
+  if (auto status = ReadNumber(config, field, seconds); !status.ok()) {
+    return status;
+  }
+  value = absl::Seconds(seconds);
+  return absl::OkStatus();
+}
+
+// Returns the increase of `current` over `baseline` in percent.
+double IncreasePercent(double baseline, double current) {
+  if (baseline <= 0) {
+    return current > 0 ? 100 : 0;
+  }
+  return (current - baseline) / baseline * 100;
+}
+
+}  // namespace
+
+std::string SweepCell::Name() const {
+  return absl::StrCat("keys_per_request=", keys_per_request,
+                      "/value_size=", value_size, "/udf=", udf,
+                      "/num_shards=", num_shards,
+                      "/compression=", compression);
+}
+
+std::vector<std::pair<std::string, std::string>> SweepCell::Environment()
+    const {
+  return {
+      {"SWEEP_CELL", Name()},
+      {"SWEEP_KEYS_PER_REQUEST", absl::StrCat(keys_per_request)},
+      {"SWEEP_VALUE_SIZE", absl::StrCat(value_size)},
+      {"SWEEP_UDF", udf},
+      {"SWEEP_NUM_SHARDS", absl::StrCat(num_shards)},
+      {"SWEEP_COMPRESSION", compression},
+  };
+}
+
+absl::StatusOr<SweepConfig> ParseSweepConfig(std::string_view json) {
+  const Json parsed = Json::parse(json, /*cb=*/nullptr,
+                                  /*allow_exceptions=*/false);
+  if (parsed.is_discarded() || !parsed.is_object()) {
+    return absl::InvalidArgumentError("Sweep config must be a JSON object");
+  }
+  SweepConfig config;
+  for (absl::Status status : {
+           ReadDimension(parsed, "keys_per_request", config.keys_per_request),
+           ReadDimension(parsed, "value_size", config.value_size),
+           ReadDimension(parsed, "udf", config.udf),
+           ReadDimension(parsed, "num_shards", config.num_shards),
+           ReadDimension(parsed, "compression", config.compression),
+           ReadNumber(parsed, "requests_per_second",
+                      config.requests_per_second),
+           ReadNumber(parsed, "concurrency", config.concurrency),
+           ReadSeconds(parsed, "warm_up_seconds", config.warm_up),
+           ReadSeconds(parsed, "duration_seconds", config.duration),
+           ReadNumber(parsed, "num_keys", config.num_keys),
+           ReadNumber(parsed, "key_size", config.key_size),
+           ReadNumber(parsed, "zipfian_exponent", config.zipfian_exponent),
+           ReadDimension(parsed, "server_metrics", config.server_metrics),
+       }) {
+    if (!status.ok()) {
+      return status;
+    }
+  }
+  for (const std::string& compression : config.compression) {
+    if (std::find(std::begin(kCompressions), std::end(kCompressions),
+                  compression) == std::end(kCompressions)) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Unknown compression: ", compression));
+    }
+  }
+  if (config.requests_per_second == 0 || config.concurrency == 0 ||
+      config.num_keys == 0 || config.duration == absl::ZeroDuration()) {
+    return absl::InvalidArgumentError(
+        "requests_per_second, concurrency, num_keys and duration_seconds "
+        "must be positive");
+  }
+  return config;
+}
+
+std::vector<SweepCell> ExpandSweepMatrix(const SweepConfig& config) {
+  std::vector<SweepCell> cells;
+  for (int keys_per_request : config.keys_per_request) {
+    for (int64_t value_size : config.value_size) {
+      for (const std::string& udf : config.udf) {
+        for (int num_shards : config.num_shards) {
+          for (const std::string& compression : config.compression) {
+            cells.push_back({.keys_per_request = keys_per_request,
+                             .value_size = value_size,
+                             .udf = udf,
+                             .num_shards = num_shards,
+                             .compression = compression});
+          }
+        }
+      }
+    }
+  }
+  return cells;
+}
+
+double SweepCellResult::ErrorRate() const {
+  return num_requests == 0 ? 0
+                           : static_cast<double>(num_errors) / num_requests;
+}
+
+std::string SweepResultsToJson(const std::vector<SweepCellResult>& results) {
+  Json json;
+  json["cells"] = Json::array();
+  for (const SweepCellResult& result : results) {
+    Json cell;
+    cell["cell"] = result.cell;
+    cell["num_requests"] = result.num_requests;
+    cell["num_errors"] = result.num_errors;
+    cell["requests_per_second"] = result.requests_per_second;
+    cell["latency_ms"] = Json::object();
+    for (const auto& [percentile, latency] : result.latencies) {
+      cell["latency_ms"][percentile] =
+          absl::ToDoubleMilliseconds(latency);
+    }
+    cell["server_metrics"] = Json::object();
+    for (const auto& [metric, value] : result.server_metrics) {
+      cell["server_metrics"][metric] = value;
+    }
+    json["cells"].push_back(std::move(cell));
+  }
+  return json.dump(2);
+}
+
+absl::StatusOr<std::vector<SweepCellResult>> ParseSweepResults(
+    std::string_view json) {
+  const Json parsed = Json::parse(json, /*cb=*/nullptr,
+                                  /*allow_exceptions=*/false);
+  if (parsed.is_discarded() || !parsed.is_object() ||
+      !parsed.contains("cells") || !parsed["cells"].is_array()) {
+    return absl::InvalidArgumentError(
+        "Sweep results must be a JSON object with a list of cells");
+  }
+  std::vector<SweepCellResult> results;
+  for (const Json& cell : parsed["cells"]) {
+    if (!cell.is_object() || !cell.contains("cell") ||
+        !cell["cell"].is_string()) {
+      return absl::InvalidArgumentError("Sweep result cell without name");
+    }
+    SweepCellResult result{.cell = cell["cell"].get<std::string>()};
+    if (auto status = ReadNumber(cell, "num_requests", result.num_requests);
+        !status.ok()) {
+      return status;
+    }
+    if (auto status = ReadNumber(cell, "num_errors", result.num_errors);
+        !status.ok()) {
+      return status;
+    }
+    if (auto status = ReadNumber(cell, "requests_per_second",
+                                 result.requests_per_second);
+        !status.ok()) {
+      return status;
+    }
+    for (std::string_view field : {"latency_ms", "server_metrics"}) {
+      const auto it = cell.find(field);
+      if (it == cell.end()) {
+        continue;
+      }
+      if (!it->is_object()) {
+        return absl::InvalidArgumentError(
+            absl::StrCat(field, " must be an object"));
+      }
+      for (const auto& [name, value] : it->items()) {
+        if (!value.is_number()) {
+          return absl::InvalidArgumentError(
+              absl::StrCat(field, " must map names to numbers"));
+        }
+        if (field == "latency_ms") {
+          result.latencies[name] = absl::Milliseconds(value.get<double>());
+        } else {
+          result.server_metrics[name] = value.get<double>();
+        }
+      }
+    }
+    results.push_back(std::move(result));
+  }
+  return results;
+}
+
+std::vector<SweepRegression> CompareToBaseline(
+    const std::vector<SweepCellResult>& results,
+    const std::vector<SweepCellResult>& baseline,
+    const RegressionThresholds& thresholds) {
+  std::map<std::string_view, const SweepCellResult*> baseline_cells;
+  for (const SweepCellResult& cell : baseline) {
+    baseline_cells[cell.cell] = &cell;
+  }
+  std::vector<SweepRegression> regressions;
+  for (const SweepCellResult& result : results) {
+    const auto it = baseline_cells.find(result.cell);
+    if (it == baseline_cells.end()) {
+      continue;
+    }
+    const SweepCellResult& base = *it->second;
+    for (const auto& [percentile, latency] : result.latencies) {
+      const auto base_latency = base.latencies.find(percentile);
+      if (base_latency == base.latencies.end()) {
+        continue;
+      }
+      const double base_ms = absl::ToDoubleMilliseconds(base_latency->second);
+      const double current_ms = absl::ToDoubleMilliseconds(latency);
+      if (latency - base_latency->second > thresholds.min_latency_increase &&
+          IncreasePercent(base_ms, current_ms) >
+              thresholds.max_latency_increase_percent) {
+        regressions.push_back({.cell = result.cell,
+                               .metric = absl::StrCat("latency_", percentile),
+                               .baseline = base_ms,
+                               .current = current_ms});
+      }
+    }
+    if (result.ErrorRate() - base.ErrorRate() >
+        thresholds.max_error_rate_increase) {
+      regressions.push_back({.cell = result.cell,
+                             .metric = "error_rate",
+                             .baseline = base.ErrorRate(),
+                             .current = result.ErrorRate()});
+    }
+    if (thresholds.max_server_metric_increase_percent < 0) {
+      continue;
+    }
+    for (const auto& [metric, value] : result.server_metrics) {
+      const auto base_value = base.server_metrics.find(metric);
+      if (base_value != base.server_metrics.end() &&
+          IncreasePercent(base_value->second, value) >
+              thresholds.max_server_metric_increase_percent) {
+        regressions.push_back({.cell = result.cell,
+                               .metric = absl::StrCat("server_metric_", metric),
+                               .baseline = base_value->second,
+                               .current = value});
+      }
+    }
+  }
+  return regressions;
+}
+
+std::map<std::string, double> ParsePrometheusMetrics(std::string_view text) {
+  std::map<std::string, double> metrics;
+  for (std::string_view line : absl::StrSplit(text, '\n')) {
+    line = absl::StripAsciiWhitespace(line);
+    if (line.empty() || line.front() == '#') {
+      continue;
+    }
+    // name{label="value",...} value [timestamp]
+    const size_t name_end = line.find_first_of("{ \t");
+    if (name_end == std::string_view::npos) {
+      continue;
+    }
+    std::string_view rest = line.substr(name_end);
+    if (rest.front() == '{') {
+      const size_t labels_end = rest.rfind('}');
+      if (labels_end == std::string_view::npos) {
+        continue;
+      }
+      rest = rest.substr(labels_end + 1);
+    }
+    const std::vector<std::string_view> fields =
+        absl::StrSplit(rest, absl::ByAnyChar(" \t"), absl::SkipEmpty());
+    double value;
+    if (fields.empty() || !absl::SimpleAtod(fields[0], &value)) {
+      continue;
+    }
+    metrics[std::string(line.substr(0, name_end))] += value;
+  }
+  return metrics;
+}
+
+}  // namespace kv_server
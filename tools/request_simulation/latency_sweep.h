@@ -0,0 +1,147 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TOOLS_REQUEST_SIMULATION_LATENCY_SWEEP_H_
+#define TOOLS_REQUEST_SIMULATION_LATENCY_SWEEP_H_
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "absl/time/time.h"
+
+namespace kv_server {
+
+// One combination of the swept dimensions.
+struct SweepCell {
+  int keys_per_request = 1;
+  // The dimensions below are set up on the server side for each cell, by the
+  // cell setup command of the sweep, e.g. by loading values of the size or
+  // deploying the UDF.
+  int64_t value_size = 0;
+  std::string udf;
+  int num_shards = 1;
+  // gRPC channel compression: "none", "deflate" or "gzip".
+  std::string compression = "none";
+
+  // Identifies the cell in results and baselines, e.g.
+  // "keys_per_request=10/value_size=100/udf=default/num_shards=1/
+  // compression=none".
+  std::string Name() const;
+  // The dimensions as the environment of the cell setup command.
+  std::vector<std::pair<std::string, std::string>> Environment() const;
+};
+
+// A declarative sweep, read from JSON. Every dimension is a list of values
+// and the sweep runs each combination of them:
+//
+// {
+//   "keys_per_request": [1, 10, 100],
+//   "value_size": [100, 10000],
+//   "udf": ["default"],
+//   "num_shards": [1],
+//   "compression": ["none", "gzip"],
+//   "requests_per_second": 500,
+//   "duration_seconds": 60,
+//   "server_metrics": ["KVUdfRequestCount"]
+// }
+struct SweepConfig {
+  std::vector<int> keys_per_request = {1};
+  std::vector<int64_t> value_size = {0};
+  std::vector<std::string> udf = {""};
+  std::vector<int> num_shards = {1};
+  std::vector<std::string> compression = {"none"};
+
+  // Load of each cell, sent open loop so that slow responses don't slow the
+  // requests down.
+  int64_t requests_per_second = 100;
+  int concurrency = 4;
+  absl::Duration warm_up = absl::Seconds(10);
+  absl::Duration duration = absl::Seconds(60);
+  // Keys are drawn from `num_keys` keys of `key_size` bytes with a zipfian
+  // distribution, uniform for exponent 0.
+  int64_t num_keys = 100000;
+  int key_size = 20;
+  double zipfian_exponent = 0;
+  // Server metrics recorded for each cell, as their change over the cell.
+  std::vector<std::string> server_metrics;
+};
+
+absl::StatusOr<SweepConfig> ParseSweepConfig(std::string_view json);
+
+// Returns the cells of the cartesian product of the dimensions of `config`,
+// varying the last dimension fastest.
+std::vector<SweepCell> ExpandSweepMatrix(const SweepConfig& config);
+
+// Latency percentiles reported for each cell, by name.
+inline constexpr std::pair<std::string_view, double> kSweepPercentiles[] = {
+    {"p50", 0.5}, {"p90", 0.9}, {"p99", 0.99}, {"p999", 0.999}};
+
+struct SweepCellResult {
+  std::string cell;
+  int64_t num_requests = 0;
+  int64_t num_errors = 0;
+  double requests_per_second = 0;
+  // Latencies of the ok responses, by percentile name.
+  std::map<std::string, absl::Duration> latencies;
+  std::map<std::string, double> server_metrics;
+
+  double ErrorRate() const;
+};
+
+std::string SweepResultsToJson(const std::vector<SweepCellResult>& results);
+absl::StatusOr<std::vector<SweepCellResult>> ParseSweepResults(
+    std::string_view json);
+
+struct RegressionThresholds {
+  // Largest increase of a latency percentile over its baseline, in percent.
+  double max_latency_increase_percent = 10;
+  // Smaller increases are noise, whatever their percent.
+  absl::Duration min_latency_increase = absl::Milliseconds(1);
+  // Largest increase of the error rate, as a fraction of the requests.
+  double max_error_rate_increase = 0.001;
+  // Largest increase of a server metric over its baseline, in percent.
+  // Negative values don't gate on server metrics.
+  double max_server_metric_increase_percent = -1;
+};
+
+struct SweepRegression {
+  std::string cell;
+  // "latency_p99", "error_rate" or "server_metric_<name>".
+  std::string metric;
+  double baseline = 0;
+  double current = 0;
+};
+
+// Returns the metrics of `results` that regressed past `thresholds` from the
+// cell of the same name in `baseline`. Cells without baseline aren't gated.
+std::vector<SweepRegression> CompareToBaseline(
+    const std::vector<SweepCellResult>& results,
+    const std::vector<SweepCellResult>& baseline,
+    const RegressionThresholds& thresholds);
+
+// Returns the value of each metric of the Prometheus text exposition, summed
+// over the label sets of the metric. Comments and malformed lines are
+// skipped.
+std::map<std::string, double> ParsePrometheusMetrics(std::string_view text);
+
+}  // namespace kv_server
+
+#endif  // TOOLS_REQUEST_SIMULATION_LATENCY_SWEEP_H_
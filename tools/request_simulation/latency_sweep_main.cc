@@ -0,0 +1,378 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Runs a latency sweep against a server: each cell of the matrix of the sweep
+// config is loaded open loop at a fixed rate, its client side latency
+// percentiles and server metrics are written to --results_file, and compared
+// to --baseline_file. Exits with 1 if any cell regressed.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/debugging/failure_signal_handler.h"
+#include "absl/debugging/symbolize.h"
+#include "absl/flags/declare.h"
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/flags/usage.h"
+#include "absl/log/initialize.h"
+#include "absl/log/log.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "components/util/sleepfor.h"
+#include "grpcpp/grpcpp.h"
+#include "public/query/get_values.grpc.pb.h"
+#include "src/telemetry/metrics_recorder.h"
+#include "src/telemetry/telemetry_provider.h"
+#include "tools/request_simulation/client_worker.h"
+#include "tools/request_simulation/grpc_client.h"
+#include "tools/request_simulation/latency_sweep.h"
+#include "tools/request_simulation/message_queue.h"
+#include "tools/request_simulation/metrics_collector.h"
+#include "tools/request_simulation/rate_limiter.h"
+#include "tools/request_simulation/request/raw_request.pb.h"
+#include "tools/request_simulation/request_generation_util.h"
+#include "tools/request_simulation/request_simulation_system.h"
+#include "tools/request_simulation/synthetic_request_generator.h"
+
+// Flags of the request simulation system that the sweep shares.
+ABSL_DECLARE_FLAG(std::string, server_address);
+ABSL_DECLARE_FLAG(std::string, server_method);
+ABSL_DECLARE_FLAG(absl::Duration, request_timeout);
+ABSL_DECLARE_FLAG(int, open_loop_max_outstanding_requests);
+ABSL_DECLARE_FLAG(kv_server::GrpcAuthenticationMode, server_auth_mode);
+ABSL_DECLARE_FLAG(bool, is_client_channel);
+
+ABSL_FLAG(std::string, sweep_config, "",
+          "Path of the JSON sweep config, see latency_sweep.h");
+ABSL_FLAG(std::string, cell_setup_command, "",
+          "Shell command run before each cell to set the server up for it, "
+          "e.g. to load values of $SWEEP_VALUE_SIZE bytes or deploy "
+          "$SWEEP_UDF. The cell is passed in SWEEP_* environment variables");
+ABSL_FLAG(std::string, server_metrics_command, "",
+          "Shell command printing the metrics of the server in the "
+          "Prometheus text format, e.g. curl of its metrics endpoint");
+ABSL_FLAG(std::string, results_file, "latency_sweep_results.json",
+          "Path to write the results of the sweep to");
+ABSL_FLAG(std::string, baseline_file, "",
+          "Results of an earlier sweep to compare the results to");
+ABSL_FLAG(double, max_latency_increase_percent, 10,
+          "Largest increase of a latency percentile over the baseline");
+ABSL_FLAG(absl::Duration, min_latency_increase, absl::Milliseconds(1),
+          "Latency increases below this aren't regressions");
+ABSL_FLAG(double, max_error_rate_increase, 0.001,
+          "Largest increase of the error rate over the baseline");
+ABSL_FLAG(double, max_server_metric_increase_percent, -1,
+          "Largest increase of a server metric over the baseline, negative "
+          "to not gate on server metrics");
+
+using privacy_sandbox::server_common::TelemetryProvider;
+
+namespace kv_server {
+namespace {
+
+using privacy_sandbox::server_common::MetricsRecorder;
+using privacy_sandbox::server_common::SteadyClock;
+
+// Counts the responses of a cell, and keeps the latencies of the whole cell
+// instead of reporting them per interval. The latencies are kept in the log
+// bucketed grpc histogram of the collector, accurate to its resolution.
+class CellMetricsCollector : public MetricsCollector {
+ public:
+  explicit CellMetricsCollector(MetricsRecorder& metrics_recorder)
+      : MetricsCollector(metrics_recorder, std::make_unique<SleepFor>()) {}
+
+  void IncrementRequestsWithOkResponsePerInterval() override { ++num_ok_; }
+  void IncrementRequestsWithErrorResponsePerInterval() override {
+    ++num_errors_;
+  }
+
+  int64_t num_ok() const { return num_ok_; }
+  int64_t num_errors() const { return num_errors_; }
+
+ private:
+  std::atomic<int64_t> num_ok_ = 0;
+  std::atomic<int64_t> num_errors_ = 0;
+};
+
+absl::StatusOr<std::string> ReadFile(const std::string& path) {
+  std::ifstream stream(path);
+  if (!stream) {
+    return absl::NotFoundError(absl::StrCat("Cannot read ", path));
+  }
+  std::stringstream contents;
+  contents << stream.rdbuf();
+  return contents.str();
+}
+
+absl::Status RunSetupCommand(const SweepCell& cell) {
+  const std::string command = absl::GetFlag(FLAGS_cell_setup_command);
+  if (command.empty()) {
+    return absl::OkStatus();
+  }
+  for (const auto& [name, value] : cell.Environment()) {
+    setenv(name.c_str(), value.c_str(), /*overwrite=*/1);
+  }
+  if (const int exit_code = std::system(command.c_str()); exit_code != 0) {
+    return absl::InternalError(absl::StrCat(
+        "Cell setup command failed with ", exit_code, " for ", cell.Name()));
+  }
+  return absl::OkStatus();
+}
+
+absl::StatusOr<std::map<std::string, double>> ReadServerMetrics() {
+  const std::string command = absl::GetFlag(FLAGS_server_metrics_command);
+  if (command.empty()) {
+    return std::map<std::string, double>();
+  }
+  FILE* pipe = popen(command.c_str(), "r");
+  if (pipe == nullptr) {
+    return absl::InternalError("Cannot run the server metrics command");
+  }
+  std::string output;
+  char buffer[4096];
+  while (const size_t size = fread(buffer, 1, sizeof(buffer), pipe)) {
+    output.append(buffer, size);
+  }
+  if (const int exit_code = pclose(pipe); exit_code != 0) {
+    return absl::InternalError(absl::StrCat(
+        "Server metrics command failed with ", exit_code));
+  }
+  return ParsePrometheusMetrics(output);
+}
+
+std::shared_ptr<grpc::Channel> CreateCellChannel(const SweepCell& cell) {
+  grpc::ChannelArguments args;
+  if (cell.compression == "gzip") {
+    args.SetCompressionAlgorithm(GRPC_COMPRESS_GZIP);
+  } else if (cell.compression == "deflate") {
+    args.SetCompressionAlgorithm(GRPC_COMPRESS_DEFLATE);
+  }
+  return CreateGrpcChannel(absl::GetFlag(FLAGS_server_address),
+                           absl::GetFlag(FLAGS_server_auth_mode), args);
+}
+
+// Sends the requests of `cell` open loop for `duration`.
+absl::Status RunLoad(const SweepConfig& config, const SweepCell& cell,
+                     std::shared_ptr<grpc::Channel> channel,
+                     ZipfianKeyGenerator& keys, absl::Duration duration,
+                     CellMetricsCollector& collector) {
+  const int64_t fill_qps = 2 * config.requests_per_second;
+  auto request_body = [&cell, &keys]() {
+    return CreateKVDSPRequestBodyInJson(
+        keys.GenerateKeys(cell.keys_per_request));
+  };
+  MessageQueue message_queue(2 * fill_qps);
+  for (int64_t i = 0; i < config.requests_per_second; ++i) {
+    message_queue.Push(request_body());
+  }
+  auto sleep_for = std::make_shared<SleepFor>();
+  RateLimiter generator_rate_limiter(fill_qps, fill_qps,
+                                     SteadyClock::RealClock(), sleep_for,
+                                     absl::Seconds(1));
+  SyntheticRequestGenerator generator(
+      message_queue, generator_rate_limiter, std::make_unique<SleepFor>(),
+      fill_qps, std::move(request_body));
+  // Open loop workers send on their own schedule and don't take permits.
+  RateLimiter unused_rate_limiter(0, 0, SteadyClock::RealClock(), sleep_for,
+                                  absl::Seconds(1));
+  const OpenLoopOptions open_loop_options{
+      .requests_per_second =
+          static_cast<double>(config.requests_per_second) /
+          config.concurrency,
+      .max_outstanding_requests = std::max(
+          1, absl::GetFlag(FLAGS_open_loop_max_outstanding_requests) /
+                 config.concurrency),
+  };
+  std::vector<std::unique_ptr<ClientWorker<RawRequest, google::api::HttpBody>>>
+      workers;
+  for (int i = 0; i < config.concurrency; ++i) {
+    workers.push_back(
+        std::make_unique<ClientWorker<RawRequest, google::api::HttpBody>>(
+            i, channel, absl::GetFlag(FLAGS_server_method),
+            absl::GetFlag(FLAGS_request_timeout),
+            [](const std::string& request_body) {
+              RawRequest request;
+              request.mutable_raw_body()->set_data(request_body);
+              return request;
+            },
+            message_queue, unused_rate_limiter, collector,
+            absl::GetFlag(FLAGS_is_client_channel), open_loop_options));
+  }
+  if (auto status = generator.Start(); !status.ok()) {
+    return status;
+  }
+  for (auto& worker : workers) {
+    if (auto status = worker->Start(); !status.ok()) {
+      return status;
+    }
+  }
+  absl::SleepFor(duration);
+  // Stopping the workers waits for the responses in flight.
+  for (auto& worker : workers) {
+    if (auto status = worker->Stop(); !status.ok()) {
+      return status;
+    }
+  }
+  return generator.Stop();
+}
+
+absl::StatusOr<SweepCellResult> RunCell(const SweepConfig& config,
+                                        const SweepCell& cell,
+                                        MetricsRecorder& metrics_recorder) {
+  LOG(INFO) << "Running cell " << cell.Name();
+  if (auto status = RunSetupCommand(cell); !status.ok()) {
+    return status;
+  }
+  auto channel = CreateCellChannel(cell);
+  ZipfianKeyGenerator keys(config.num_keys, config.zipfian_exponent,
+                           config.key_size);
+  if (config.warm_up > absl::ZeroDuration()) {
+    CellMetricsCollector warm_up_collector(metrics_recorder);
+    if (auto status = RunLoad(config, cell, channel, keys, config.warm_up,
+                              warm_up_collector);
+        !status.ok()) {
+      return status;
+    }
+  }
+  auto metrics_before = ReadServerMetrics();
+  if (!metrics_before.ok()) {
+    return metrics_before.status();
+  }
+  CellMetricsCollector collector(metrics_recorder);
+  const absl::Time start = absl::Now();
+  if (auto status =
+          RunLoad(config, cell, channel, keys, config.duration, collector);
+      !status.ok()) {
+    return status;
+  }
+  const absl::Duration elapsed = absl::Now() - start;
+  auto metrics_after = ReadServerMetrics();
+  if (!metrics_after.ok()) {
+    return metrics_after.status();
+  }
+  SweepCellResult result{
+      .cell = cell.Name(),
+      .num_requests = collector.num_ok() + collector.num_errors(),
+      .num_errors = collector.num_errors(),
+  };
+  result.requests_per_second =
+      result.num_requests / absl::ToDoubleSeconds(elapsed);
+  if (collector.num_ok() > 0) {
+    for (const auto& [name, percentile] : kSweepPercentiles) {
+      result.latencies[std::string(name)] =
+          collector.GetPercentileLatency(percentile);
+    }
+  }
+  for (const std::string& metric : config.server_metrics) {
+    result.server_metrics[metric] =
+        (*metrics_after)[metric] - (*metrics_before)[metric];
+  }
+  LOG(INFO) << "Cell " << cell.Name() << ": " << result.num_requests
+            << " requests, " << result.num_errors << " errors";
+  return result;
+}
+
+absl::Status RunSweep(MetricsRecorder& metrics_recorder, bool& regressed) {
+  auto config_json = ReadFile(absl::GetFlag(FLAGS_sweep_config));
+  if (!config_json.ok()) {
+    return config_json.status();
+  }
+  auto config = ParseSweepConfig(*config_json);
+  if (!config.ok()) {
+    return config.status();
+  }
+  std::optional<std::vector<SweepCellResult>> baseline;
+  if (const std::string path = absl::GetFlag(FLAGS_baseline_file);
+      !path.empty()) {
+    auto baseline_json = ReadFile(path);
+    if (!baseline_json.ok()) {
+      return baseline_json.status();
+    }
+    auto parsed = ParseSweepResults(*baseline_json);
+    if (!parsed.ok()) {
+      return parsed.status();
+    }
+    baseline = *std::move(parsed);
+  }
+  std::vector<SweepCellResult> results;
+  for (const SweepCell& cell : ExpandSweepMatrix(*config)) {
+    auto result = RunCell(*config, cell, metrics_recorder);
+    if (!result.ok()) {
+      return result.status();
+    }
+    results.push_back(*std::move(result));
+  }
+  std::ofstream(absl::GetFlag(FLAGS_results_file))
+      << SweepResultsToJson(results);
+  if (!baseline.has_value()) {
+    return absl::OkStatus();
+  }
+  const std::vector<SweepRegression> regressions = CompareToBaseline(
+      results, *baseline,
+      {.max_latency_increase_percent =
+           absl::GetFlag(FLAGS_max_latency_increase_percent),
+       .min_latency_increase = absl::GetFlag(FLAGS_min_latency_increase),
+       .max_error_rate_increase = absl::GetFlag(FLAGS_max_error_rate_increase),
+       .max_server_metric_increase_percent =
+           absl::GetFlag(FLAGS_max_server_metric_increase_percent)});
+  for (const SweepRegression& regression : regressions) {
+    LOG(ERROR) << "Regression of " << regression.metric << " in "
+               << regression.cell << ": " << regression.baseline << " -> "
+               << regression.current;
+  }
+  regressed = !regressions.empty();
+  return absl::OkStatus();
+}
+
+}  // namespace
+}  // namespace kv_server
+
+int main(int argc, char** argv) {
+  absl::ParseCommandLine(argc, argv);
+  absl::InitializeSymbolizer(argv[0]);
+  {
+    absl::FailureSignalHandlerOptions options;
+    absl::InstallFailureSignalHandler(options);
+  }
+  absl::InitializeLog();
+  absl::SetProgramUsageMessage(absl::StrCat(
+      "Key Value Server latency sweep.  Sample usage:\n", argv[0],
+      " --server_address=localhost:50051 --sweep_config=sweep.json "
+      "--baseline_file=baseline.json"));
+  kv_server::RequestSimulationSystem::InitializeTelemetry();
+  auto metrics_recorder =
+      TelemetryProvider::GetInstance().CreateMetricsRecorder();
+  bool regressed = false;
+  if (const absl::Status status =
+          kv_server::RunSweep(*metrics_recorder, regressed);
+      !status.ok()) {
+    LOG(ERROR) << "Latency sweep failed: " << status;
+    return 2;
+  }
+  return regressed ? 1 : 0;
+}
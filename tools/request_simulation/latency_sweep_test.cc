@@ -0,0 +1,159 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tools/request_simulation/latency_sweep.h"
+
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace kv_server {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Field;
+using ::testing::IsEmpty;
+using ::testing::Pair;
+
+TEST(LatencySweepTest, ParsesConfig) {
+  const auto config = ParseSweepConfig(R"({
+    "keys_per_request": [1, 10],
+    "value_size": [100],
+    "udf": ["default", "filter"],
+    "compression": ["none", "gzip"],
+    "requests_per_second": 500,
+    "duration_seconds": 30,
+    "server_metrics": ["KVUdfRequestCount"]
+  })");
+  ASSERT_TRUE(config.ok()) << config.status();
+  EXPECT_THAT(config->keys_per_request, ElementsAre(1, 10));
+  EXPECT_THAT(config->value_size, ElementsAre(100));
+  EXPECT_THAT(config->udf, ElementsAre("default", "filter"));
+  EXPECT_THAT(config->num_shards, ElementsAre(1));
+  EXPECT_THAT(config->compression, ElementsAre("none", "gzip"));
+  EXPECT_EQ(config->requests_per_second, 500);
+  EXPECT_EQ(config->duration, absl::Seconds(30));
+  EXPECT_EQ(config->warm_up, absl::Seconds(10));
+  EXPECT_THAT(config->server_metrics, ElementsAre("KVUdfRequestCount"));
+}
+
+TEST(LatencySweepTest, RejectsInvalidConfig) {
+  EXPECT_FALSE(ParseSweepConfig("[1]").ok());
+  EXPECT_FALSE(ParseSweepConfig("{").ok());
+  EXPECT_FALSE(ParseSweepConfig(R"({"keys_per_request": []})").ok());
+  EXPECT_FALSE(ParseSweepConfig(R"({"keys_per_request": ["a"]})").ok());
+  EXPECT_FALSE(ParseSweepConfig(R"({"value_size": [-1]})").ok());
+  EXPECT_FALSE(ParseSweepConfig(R"({"compression": ["zstd"]})").ok());
+  EXPECT_FALSE(ParseSweepConfig(R"({"requests_per_second": 0})").ok());
+}
+
+TEST(LatencySweepTest, ExpandsMatrix) {
+  SweepConfig config;
+  config.keys_per_request = {1, 10};
+  config.udf = {"a"};
+  config.compression = {"none", "gzip"};
+  const std::vector<SweepCell> cells = ExpandSweepMatrix(config);
+  ASSERT_EQ(cells.size(), 4);
+  EXPECT_EQ(cells[0].Name(),
+            "keys_per_request=1/value_size=0/udf=a/num_shards=1/"
+            "compression=none");
+  EXPECT_EQ(cells[1].Name(),
+            "keys_per_request=1/value_size=0/udf=a/num_shards=1/"
+            "compression=gzip");
+  EXPECT_EQ(cells[3].keys_per_request, 10);
+  EXPECT_THAT(cells[3].Environment(),
+              testing::Contains(Pair("SWEEP_COMPRESSION", "gzip")));
+}
+
+SweepCellResult Result(std::string cell, double p99_ms, int64_t num_errors) {
+  return {.cell = std::move(cell),
+          .num_requests = 1000,
+          .num_errors = num_errors,
+          .requests_per_second = 100,
+          .latencies = {{"p50", absl::Milliseconds(p99_ms / 2)},
+                        {"p99", absl::Milliseconds(p99_ms)}},
+          .server_metrics = {{"cpu", 10}}};
+}
+
+TEST(LatencySweepTest, ResultsRoundTripThroughJson) {
+  const std::vector<SweepCellResult> results = {Result("a", 20, 1)};
+  const auto parsed = ParseSweepResults(SweepResultsToJson(results));
+  ASSERT_TRUE(parsed.ok()) << parsed.status();
+  ASSERT_EQ(parsed->size(), 1);
+  EXPECT_EQ((*parsed)[0].cell, "a");
+  EXPECT_EQ((*parsed)[0].num_requests, 1000);
+  EXPECT_EQ((*parsed)[0].num_errors, 1);
+  EXPECT_EQ((*parsed)[0].latencies, results[0].latencies);
+  EXPECT_EQ((*parsed)[0].server_metrics, results[0].server_metrics);
+  EXPECT_FALSE(ParseSweepResults(R"({"cells": [{}]})").ok());
+}
+
+TEST(LatencySweepTest, FlagsLatencyRegressions) {
+  const RegressionThresholds thresholds;
+  EXPECT_THAT(CompareToBaseline({Result("a", 10.5, 0)}, {Result("a", 10, 0)},
+                                thresholds),
+              IsEmpty());
+  // Slower by more than 10%, but by less than the 1ms floor.
+  EXPECT_THAT(CompareToBaseline({Result("a", 1.5, 0)}, {Result("a", 1, 0)},
+                                thresholds),
+              IsEmpty());
+  EXPECT_THAT(
+      CompareToBaseline({Result("a", 20, 0)}, {Result("a", 10, 0)},
+                        thresholds),
+      ElementsAre(Field(&SweepRegression::metric, "latency_p50"),
+                  Field(&SweepRegression::metric, "latency_p99")));
+  // Cells without baseline aren't gated.
+  EXPECT_THAT(CompareToBaseline({Result("b", 20, 0)}, {Result("a", 10, 0)},
+                                thresholds),
+              IsEmpty());
+}
+
+TEST(LatencySweepTest, FlagsErrorRateRegressions) {
+  EXPECT_THAT(CompareToBaseline({Result("a", 10, 10)}, {Result("a", 10, 0)},
+                                RegressionThresholds()),
+              ElementsAre(Field(&SweepRegression::metric, "error_rate")));
+}
+
+TEST(LatencySweepTest, FlagsServerMetricRegressionsWhenGated) {
+  SweepCellResult result = Result("a", 10, 0);
+  result.server_metrics["cpu"] = 20;
+  EXPECT_THAT(
+      CompareToBaseline({result}, {Result("a", 10, 0)},
+                        RegressionThresholds()),
+      IsEmpty());
+  EXPECT_THAT(
+      CompareToBaseline({result}, {Result("a", 10, 0)},
+                        {.max_server_metric_increase_percent = 50}),
+      ElementsAre(Field(&SweepRegression::metric, "server_metric_cpu")));
+}
+
+TEST(LatencySweepTest, ParsesPrometheusMetrics) {
+  const auto metrics = ParsePrometheusMetrics(R"(
+# HELP requests Requests served.
+# TYPE requests counter
+requests{method="a"} 3
+requests{method="b",path="{}"} 4 1700000000
+latency_sum 1.5e2
+malformed
+)");
+  EXPECT_THAT(metrics, ElementsAre(Pair("latency_sum", 150),
+                                   Pair("requests", 7)));
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -14,50 +14,87 @@
 
 #include "tools/request_simulation/message_queue.h"
 
+#include "tools/request_simulation/message_queue.h"
+
+#include <algorithm>
 #include <utility>
 #include <vector>
 
 namespace kv_server {
 
+MessageQueue::MessageQueue(int64_t capacity)
+    : capacity_(std::max<int64_t>(capacity, 0)),
+      slots_(std::make_unique<Slot[]>(capacity_)) {
+  for (uint64_t i = 0; i < capacity_; ++i) {
+    slots_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+}
+
 void MessageQueue::Push(std::string message) {
-  absl::MutexLock lock(&mutex_);
-  if (queue_.size() < capacity_) {
-    queue_.push_back(std::move(message));
+  if (capacity_ == 0) {
+    return;
+  }
+  uint64_t position = push_position_.load(std::memory_order_relaxed);
+  while (true) {
+    Slot& slot = slots_[position % capacity_];
+    const uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+    if (sequence == position) {
+      if (push_position_.compare_exchange_weak(position, position + 1,
+                                               std::memory_order_relaxed)) {
+        slot.message = std::move(message);
+        slot.sequence.store(position + 1, std::memory_order_release);
+        return;
+      }
+    } else if (sequence < position) {
+      // The message pushed a lap ago wasn't popped yet, the queue is full.
+      return;
+    } else {
+      position = push_position_.load(std::memory_order_relaxed);
+    }
   }
 }
 
 void MessageQueue::Push(std::vector<std::string> messages) {
-  absl::MutexLock lock(&mutex_);
   for (auto& m : messages) {
-    if (queue_.size() < capacity_) {
-      queue_.push_back(std::move(m));
-    }
+    Push(std::move(m));
   }
 }
 
 absl::StatusOr<std::string> MessageQueue::Pop() {
-  absl::MutexLock lock(&mutex_);
-  if (queue_.empty()) {
+  if (capacity_ == 0) {
     return absl::FailedPreconditionError("Queue is empty");
   }
-  auto front = queue_.front();
-  queue_.pop_front();
-  return front;
+  uint64_t position = pop_position_.load(std::memory_order_relaxed);
+  while (true) {
+    Slot& slot = slots_[position % capacity_];
+    const uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+    if (sequence == position + 1) {
+      if (pop_position_.compare_exchange_weak(position, position + 1,
+                                              std::memory_order_relaxed)) {
+        std::string message = std::move(slot.message);
+        // Frees the slot for the push a lap later.
+        slot.sequence.store(position + capacity_, std::memory_order_release);
+        return message;
+      }
+    } else if (sequence < position + 1) {
+      return absl::FailedPreconditionError("Queue is empty");
+    } else {
+      position = pop_position_.load(std::memory_order_relaxed);
+    }
+  }
 }
 
-bool MessageQueue::Empty() const {
-  absl::MutexLock lock(&mutex_);
-  return queue_.empty();
-}
+bool MessageQueue::Empty() const { return Size() == 0; }
 
 size_t MessageQueue::Size() const {
-  absl::MutexLock lock(&mutex_);
-  return queue_.size();
+  const uint64_t pop_position = pop_position_.load(std::memory_order_relaxed);
+  const uint64_t push_position = push_position_.load(std::memory_order_relaxed);
+  return push_position > pop_position ? push_position - pop_position : 0;
 }
 
 void MessageQueue::Clear() {
-  absl::MutexLock lock(&mutex_);
-  queue_.clear();
+  while (Pop().ok()) {
+  }
 }
 
 }  // namespace kv_server
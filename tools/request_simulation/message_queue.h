@@ -17,20 +17,26 @@
 #ifndef TOOLS_REQUEST_SIMULATION_MESSAGE_QUEUE_H_
 #define TOOLS_REQUEST_SIMULATION_MESSAGE_QUEUE_H_
 
-#include <deque>
+#include <atomic>
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <vector>
 
 #include "absl/status/statusor.h"
-#include "absl/synchronization/mutex.h"
 
 namespace kv_server {
 
-// Synchronized message queue to stage the request body
+// Bounded multi-producer multi-consumer queue to stage the request body.
+// Messages pushed while the queue is full are dropped.
+//
+// The queue is a lock-free ring buffer: each slot carries a sequence number
+// that tells producers and consumers whose turn it is, so the generators
+// and client workers only contend on the positions they claim. The slots are
+// allocated up front, so the capacity shouldn't be larger than needed.
 class MessageQueue {
  public:
-  explicit MessageQueue(int64_t capacity) : capacity_(capacity) {}
+  explicit MessageQueue(int64_t capacity);
   // Pushes new message to the queue
   void Push(std::string message);
   // Pushes new messages to the queue
@@ -39,7 +45,8 @@ class MessageQueue {
   absl::StatusOr<std::string> Pop();
   // Checks if the queue is empty
   bool Empty() const;
-  // Returns the size of the queue
+  // Returns the size of the queue. The size is approximate while messages
+  // are pushed or popped concurrently.
   size_t Size() const;
   // Clears the queue
   void Clear();
@@ -50,9 +57,19 @@ class MessageQueue {
   MessageQueue& operator=(const MessageQueue&) = delete;
 
  private:
-  mutable absl::Mutex mutex_;
-  int64_t capacity_ ABSL_GUARDED_BY(mutex_);
-  std::deque<std::string> queue_ ABSL_GUARDED_BY(mutex_);
+  struct Slot {
+    // Equal to the position of the next push into the slot while the slot is
+    // free, and to that position + 1 once the message is written.
+    std::atomic<uint64_t> sequence;
+    std::string message;
+  };
+
+  const uint64_t capacity_;
+  std::unique_ptr<Slot[]> slots_;
+  // On separate cache lines, so that producers and consumers don't invalidate
+  // each other's position.
+  alignas(64) std::atomic<uint64_t> push_position_ = 0;
+  alignas(64) std::atomic<uint64_t> pop_position_ = 0;
 };
 }  // namespace kv_server
 
@@ -14,6 +14,11 @@
 
 #include "tools/request_simulation/message_queue.h"
 
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
 #include "gtest/gtest.h"
 
 namespace kv_server {
@@ -49,5 +54,43 @@ TEST(TestMessageQueue, TestCapacityConstraint) {
   EXPECT_EQ(pop.value(), "first");
 }
 
+TEST(TestMessageQueue, TestQueueWrapsAround) {
+  MessageQueue queue(2);
+  for (int i = 0; i < 10; ++i) {
+    queue.Push(absl::StrCat("message", i));
+    auto pop = queue.Pop();
+    ASSERT_TRUE(pop.ok());
+    EXPECT_EQ(pop.value(), absl::StrCat("message", i));
+  }
+  EXPECT_TRUE(queue.Empty());
+}
+
+TEST(TestMessageQueue, TestConcurrentProducersAndConsumers) {
+  constexpr int kNumThreads = 4;
+  constexpr int kMessagesPerProducer = 10000;
+  MessageQueue queue(kNumThreads * kMessagesPerProducer);
+  std::atomic<int> num_popped = 0;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.emplace_back([&queue, i]() {
+      for (int j = 0; j < kMessagesPerProducer; ++j) {
+        queue.Push(absl::StrCat(i, "_", j));
+      }
+    });
+    threads.emplace_back([&queue, &num_popped]() {
+      while (num_popped.load() < kNumThreads * kMessagesPerProducer) {
+        if (queue.Pop().ok()) {
+          num_popped.fetch_add(1);
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(num_popped.load(), kNumThreads * kMessagesPerProducer);
+  EXPECT_TRUE(queue.Empty());
+}
+
 }  // namespace
 }  // namespace kv_server
@@ -26,13 +26,31 @@ namespace kv_server {
 constexpr char* kP50GrpcLatency = "P50GrpcLatency";
 constexpr char* kP90GrpcLatency = "P90GrpcLatency";
 constexpr char* kP99GrpcLatency = "P99GrpcLatency";
+constexpr char* kP999GrpcLatency = "P999GrpcLatency";
+constexpr char* kP9999GrpcLatency = "P9999GrpcLatency";
 constexpr char* kEstimatedQPS = "EstimatedQPS";
 constexpr char* kRequestsSent = "RequestsSent";
 constexpr char* KServerResponseStatus = "ServerResponseStatus";
 
-constexpr double kDefaultHistogramResolution = 0.1;
+// Buckets grow by 1%, so that percentiles are within 1% of the actual
+// latencies, like HDR histograms with 2 significant digits.
+constexpr double kDefaultHistogramResolution = 0.01;
 constexpr double kDefaultHistogramMaxBucket = 60e9;
 
+struct ReportedPercentile {
+  double percentile;
+  const char* metric;
+  const char* description;
+};
+
+constexpr ReportedPercentile kReportedPercentiles[] = {
+    {0.5, kP50GrpcLatency, "P50 Latency"},
+    {0.9, kP90GrpcLatency, "P90 Latency"},
+    {0.99, kP99GrpcLatency, "P99 Latency"},
+    {0.999, kP999GrpcLatency, "P99.9 Latency"},
+    {0.9999, kP9999GrpcLatency, "P99.99 Latency"},
+};
+
 MetricsCollector::MetricsCollector(
     privacy_sandbox::server_common::MetricsRecorder& metrics_recorder,
     std::unique_ptr<SleepFor> sleep_for)
@@ -48,12 +66,9 @@ MetricsCollector::MetricsCollector(
                                                   kDefaultHistogramMaxBucket);
   metrics_recorder_.RegisterHistogram(kRequestsSent, "Requests sent", "");
   metrics_recorder_.RegisterHistogram(kEstimatedQPS, "Estimated QPS", "");
-  metrics_recorder_.RegisterHistogram(kP50GrpcLatency, "P50 Latency",
-                                      "microsecond");
-  metrics_recorder_.RegisterHistogram(kP90GrpcLatency, "P90 Latency",
-                                      "microsecond");
-  metrics_recorder_.RegisterHistogram(kP99GrpcLatency, "P99 Latency",
-                                      "microsecond");
+  for (const auto& [percentile, metric, description] : kReportedPercentiles) {
+    metrics_recorder_.RegisterHistogram(metric, description, "microsecond");
+  }
 }
 
 void MetricsCollector::AddLatencyToHistogram(absl::Duration latency) {
@@ -63,8 +78,9 @@ void MetricsCollector::AddLatencyToHistogram(absl::Duration latency) {
 }
 absl::Duration MetricsCollector::GetPercentileLatency(double percentile) {
   absl::MutexLock lock(&mutex_);
+  // The grpc histogram takes percentiles from 0 to 100.
   return absl::Microseconds(
-      grpc_histogram_percentile(histogram_per_interval_, percentile));
+      grpc_histogram_percentile(histogram_per_interval_, percentile * 100));
 }
 
 void MetricsCollector::IncrementRequestsWithOkResponsePerInterval() {
@@ -88,24 +104,15 @@ void MetricsCollector::PublishMetrics() {
   while (!report_thread_manager_->ShouldStop()) {
     sleep_for_->Duration(report_interval_);
     auto requests_sent =
-        requests_with_ok_response_per_interval_.load(std::memory_order_relaxed);
+        requests_sent_per_interval_.load(std::memory_order_relaxed);
     auto requests_with_ok_responses =
         requests_with_ok_response_per_interval_.load(std::memory_order_relaxed);
     auto requests_with_error_responses =
         requests_with_error_response_per_interval_.load(
             std::memory_order_relaxed);
     auto estimated_qps = GetQPS();
-    auto p50_latency = GetPercentileLatency(0.5);
-    auto p90_latency = GetPercentileLatency(0.9);
-    auto p99_latency = GetPercentileLatency(0.99);
     metrics_recorder_.RecordHistogramEvent(kRequestsSent, requests_sent);
     metrics_recorder_.RecordHistogramEvent(kEstimatedQPS, estimated_qps);
-    metrics_recorder_.RecordHistogramEvent(
-        kP50GrpcLatency, absl::ToInt64Microseconds(p50_latency));
-    metrics_recorder_.RecordHistogramEvent(
-        kP90GrpcLatency, absl::ToInt64Microseconds(p90_latency));
-    metrics_recorder_.RecordHistogramEvent(
-        kP99GrpcLatency, absl::ToInt64Microseconds(p99_latency));
     LOG(INFO) << "Metrics Summary: ";
     LOG(INFO) << "Number of requests sent:" << requests_sent;
     LOG(INFO) << "Number of requests with ok responses:"
@@ -113,9 +120,13 @@ void MetricsCollector::PublishMetrics() {
     LOG(INFO) << "Number of requests with error responses:"
               << requests_with_error_responses;
     LOG(INFO) << "Estimated QPS " << estimated_qps;
-    LOG(INFO) << "P50 latency " << p50_latency;
-    LOG(INFO) << "P90 latency " << p90_latency;
-    LOG(INFO) << "P99 latency " << p99_latency;
+    for (const auto& [percentile, metric, description] :
+         kReportedPercentiles) {
+      const absl::Duration latency = GetPercentileLatency(percentile);
+      metrics_recorder_.RecordHistogramEvent(
+          metric, absl::ToInt64Microseconds(latency));
+      LOG(INFO) << description << " " << latency;
+    }
     ResetHistogram();
     ResetRequestsPerInterval();
   }
@@ -14,44 +14,71 @@
 
 #include "tools/request_simulation/rate_limiter.h"
 
-#include <iostream>
+#include <algorithm>
 
 namespace kv_server {
 
 absl::StatusOr<absl::Duration> RateLimiter::Acquire() { return Acquire(1); }
 
 absl::StatusOr<absl::Duration> RateLimiter::Acquire(int permits) {
-  absl::MutexLock lock(&mu_);
   const auto start_time = clock_.Now();
   auto deadline = start_time + timeout_;
-  while (permits_.load(std::memory_order_relaxed) - permits < 0) {
-    sleep_for_->Duration(
-        absl::Microseconds(1000000 * permits / permits_fill_rate_));
+  while (!TryAcquire(permits)) {
     RefillPermits();
+    if (TryAcquire(permits)) {
+      break;
+    }
     if (clock_.Now() >= deadline) {
       return absl::DeadlineExceededError("Acquire deadline exceeds");
     }
+    sleep_for_->Duration(absl::Microseconds(
+        1000000 * permits /
+        std::max<int64_t>(permits_fill_rate_.load(std::memory_order_relaxed),
+                          1)));
   }
-  permits_.fetch_sub(permits, std::memory_order_relaxed) - permits;
   return clock_.Now() - start_time;
 }
 
+bool RateLimiter::TryAcquire(int permits) {
+  int64_t available = permits_.load(std::memory_order_relaxed);
+  while (available >= permits) {
+    if (permits_.compare_exchange_weak(available, available - permits,
+                                       std::memory_order_relaxed)) {
+      return true;
+    }
+  }
+  return false;
+}
+
 void RateLimiter::RefillPermits() {
-  const auto elapsed_time_ns =
-      ToChronoNanoseconds(last_refill_time_.GetElapsedTime());
-  if (elapsed_time_ns <= std::chrono::nanoseconds::zero()) {
+  const int64_t fill_rate = permits_fill_rate_.load(std::memory_order_relaxed);
+  int64_t last_refill_time_ns =
+      last_refill_time_ns_.load(std::memory_order_relaxed);
+  const int64_t now_ns = absl::ToInt64Nanoseconds(clock_.Now() - start_time_);
+  const int64_t elapsed_time_ns = now_ns - last_refill_time_ns;
+  if (elapsed_time_ns <= 0) {
     return;
   }
   const int64_t permits_to_fill =
-      (permits_fill_rate_ / 1e9) * elapsed_time_ns.count();
-  permits_.fetch_add(permits_to_fill, std::memory_order_relaxed) +
-      permits_to_fill;
-  last_refill_time_.Reset();
+      static_cast<int64_t>((fill_rate / 1e9) * elapsed_time_ns);
+  int64_t refill_time_ns = now_ns;
+  if (fill_rate > 0) {
+    if (permits_to_fill == 0) {
+      return;
+    }
+    refill_time_ns = last_refill_time_ns +
+                     static_cast<int64_t>(permits_to_fill * 1e9 / fill_rate);
+  }
+  // Only the caller that advances the refill time adds the permits, others
+  // found them refilled.
+  if (last_refill_time_ns_.compare_exchange_strong(
+          last_refill_time_ns, refill_time_ns, std::memory_order_relaxed)) {
+    permits_.fetch_add(permits_to_fill, std::memory_order_relaxed);
+  }
 }
 
 void RateLimiter::SetFillRate(int64_t permits_per_second) {
-  absl::MutexLock lock(&mu_);
-  permits_fill_rate_ = permits_per_second;
+  permits_fill_rate_.store(permits_per_second, std::memory_order_relaxed);
 }
 
 }  // namespace kv_server
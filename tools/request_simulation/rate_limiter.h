@@ -23,50 +23,57 @@
 #include <utility>
 
 #include "absl/status/statusor.h"
-#include "absl/synchronization/mutex.h"
 #include "components/util/sleepfor.h"
 #include "src/util/duration.h"
 namespace kv_server {
 
 // A simple permit-based rate limiter. The permits are refilled at given rate
 // passed in the constructor. The fill rate can also be updated during runtime
+//
+// Acquiring and refilling permits is lock-free, callers only contend on the
+// permit count. Each client worker still gets its own rate limiter with its
+// share of the rate, so that workers don't contend at all at high rates.
 class RateLimiter {
  public:
   RateLimiter(int64_t initial_permits, int64_t permits_per_second,
               privacy_sandbox::server_common::SteadyClock& clock,
-              std::unique_ptr<SleepFor> sleep_for,
+              std::shared_ptr<SleepFor> sleep_for,
               const absl::Duration& timeout)
       : permits_fill_rate_(permits_per_second),
-        last_refill_time_(clock),
         clock_(clock),
+        start_time_(clock.Now()),
         sleep_for_(std::move(sleep_for)),
         timeout_(timeout) {
     permits_.store(initial_permits, std::memory_order_relaxed);
   }
   ~RateLimiter() = default;
   // Acquires a single permit, returns waiting duration or error message
-  absl::StatusOr<absl::Duration> Acquire() ABSL_LOCKS_EXCLUDED(mu_);
+  absl::StatusOr<absl::Duration> Acquire();
   // Acquires a number of permits, returns waiting duration or error message
-  absl::StatusOr<absl::Duration> Acquire(int permits) ABSL_LOCKS_EXCLUDED(mu_);
+  absl::StatusOr<absl::Duration> Acquire(int permits);
   // Sets the fill rate
-  void SetFillRate(int64_t permits_per_second) ABSL_LOCKS_EXCLUDED(mu_);
+  void SetFillRate(int64_t permits_per_second);
 
   // RateLimiter is neither copyable nor movable.
   RateLimiter(const RateLimiter&) = delete;
   RateLimiter& operator=(const RateLimiter&) = delete;
 
  private:
-  void RefillPermits() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
-  mutable absl::Mutex mu_;
+  // Takes `permits` if they are available.
+  bool TryAcquire(int permits);
+  void RefillPermits();
   // Permits fill rate in permits per second
-  mutable int64_t permits_fill_rate_ ABSL_GUARDED_BY(mu_);
-  // Last refill time in nanoseconds
-  mutable privacy_sandbox::server_common::Stopwatch last_refill_time_
-      ABSL_GUARDED_BY(mu_);
+  std::atomic<int64_t> permits_fill_rate_;
   // Number of permits available
-  mutable std::atomic<int64_t> permits_;
+  std::atomic<int64_t> permits_;
   privacy_sandbox::server_common::SteadyClock& clock_;
-  std::unique_ptr<SleepFor> sleep_for_;
+  const privacy_sandbox::server_common::SteadyTime start_time_;
+  // Time up to which permits were refilled, in nanoseconds since
+  // `start_time_`. Only advanced by the time the refilled permits took to
+  // accrue, so that frequent refills don't drop fractions of permits.
+  std::atomic<int64_t> last_refill_time_ns_ = 0;
+  // Shared, so that the rate limiters of the client workers can share one.
+  std::shared_ptr<SleepFor> sleep_for_;
   // Timeout period for acquiring permits
   absl::Duration timeout_;
   friend class RateLimiterTestPeer;
@@ -33,16 +33,14 @@ class RateLimiterTestPeer {
  public:
   RateLimiterTestPeer() = delete;
   static int64_t ReadCurrentPermits(const RateLimiter& r) {
-    absl::MutexLock lock(&r.mu_);
     return r.permits_.load(std::memory_order_relaxed);
   }
   static int64_t ReadRefillRate(const RateLimiter& r) {
-    absl::MutexLock lock(&r.mu_);
-    return r.permits_fill_rate_;
+    return r.permits_fill_rate_.load(std::memory_order_relaxed);
   }
   static SteadyTime ReadLastRefillTime(const RateLimiter& r) {
-    absl::MutexLock lock(&r.mu_);
-    return r.last_refill_time_.GetStartTime();
+    return r.start_time_ + absl::Nanoseconds(r.last_refill_time_ns_.load(
+                               std::memory_order_relaxed));
   }
 };
 namespace {
@@ -165,6 +163,19 @@ TEST_F(RateLimiterTest,
   EXPECT_EQ(acquire_success_count, 1);
 }
 
+TEST_F(RateLimiterTest, TestRefillKeepsFractionsOfPermits) {
+  EXPECT_CALL(*sleep_for_, Duration(_)).WillRepeatedly(Return(true));
+  RateLimiter rate_limiter(0, 2, sim_clock_, std::move(sleep_for_),
+                           absl::Seconds(0));
+  sim_clock_.AdvanceTime(absl::Milliseconds(750));
+  EXPECT_TRUE(rate_limiter.Acquire().ok());
+  // Half a permit accrued during the first refill, so another one is
+  // available 250 ms later.
+  sim_clock_.AdvanceTime(absl::Milliseconds(250));
+  EXPECT_TRUE(rate_limiter.Acquire().ok());
+  EXPECT_FALSE(rate_limiter.Acquire().ok());
+}
+
 TEST_F(RateLimiterTest, TestAcquireTimeout) {
   EXPECT_CALL(*sleep_for_, Duration(_)).WillRepeatedly(Return(true));
   RateLimiter rate_limiter(0, 1, sim_clock_, std::move(sleep_for_),
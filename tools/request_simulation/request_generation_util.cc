@@ -14,6 +14,9 @@
 
 #include "tools/request_simulation/request_generation_util.h"
 
+#include <algorithm>
+#include <cmath>
+
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_join.h"
 #include "tools/request_simulation/request/raw_request.pb.h"
@@ -34,6 +37,43 @@ std::vector<std::string> GenerateRandomKeys(int number_of_keys, int key_size) {
   return result;
 }
 
+ZipfianKeyGenerator::ZipfianKeyGenerator(int64_t num_keys, double exponent,
+                                         int key_size)
+    : key_size_(key_size) {
+  cumulative_probabilities_.reserve(std::max<int64_t>(num_keys, 1));
+  double sum = 0;
+  for (int64_t rank = 0; rank < std::max<int64_t>(num_keys, 1); ++rank) {
+    sum += 1.0 / std::pow(rank + 1, exponent);
+    cumulative_probabilities_.push_back(sum);
+  }
+  for (double& probability : cumulative_probabilities_) {
+    probability /= sum;
+  }
+}
+
+std::vector<std::string> ZipfianKeyGenerator::GenerateKeys(
+    int number_of_keys) {
+  std::vector<std::string> result;
+  result.reserve(number_of_keys);
+  for (int i = 0; i < number_of_keys; ++i) {
+    result.push_back(KeyOfRank(GenerateRank()));
+  }
+  return result;
+}
+
+int64_t ZipfianKeyGenerator::GenerateRank() {
+  const double probability = absl::Uniform<double>(bitgen_, 0, 1);
+  const auto it =
+      std::lower_bound(cumulative_probabilities_.begin(),
+                       cumulative_probabilities_.end(), probability);
+  return std::min<int64_t>(it - cumulative_probabilities_.begin(),
+                           cumulative_probabilities_.size() - 1);
+}
+
+std::string ZipfianKeyGenerator::KeyOfRank(int64_t rank) const {
+  return absl::StrFormat("%0*d", key_size_, rank);
+}
+
 std::string CreateKVDSPRequestBodyInJson(const std::vector<std::string>& keys) {
   const std::string comma_seperated_keys =
       absl::StrJoin(keys, ",", [](std::string* out, const std::string& key) {
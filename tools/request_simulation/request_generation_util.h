@@ -17,9 +17,11 @@
 #ifndef TOOLS_REQUEST_SIMULATION_REQUEST_GENERATION_UTIL_H_
 #define TOOLS_REQUEST_SIMULATION_REQUEST_GENERATION_UTIL_H_
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
+#include "absl/random/random.h"
 #include "tools/request_simulation/request/raw_request.pb.h"
 
 namespace kv_server {
@@ -27,6 +29,27 @@ namespace kv_server {
 // Generates random keys based on the number of keys and size of each key
 std::vector<std::string> GenerateRandomKeys(int number_of_keys, int key_size);
 
+// Generates keys with a Zipfian popularity: the key of rank r, starting at 0,
+// is picked with a probability proportional to 1 / (r + 1)^exponent, so that a
+// few keys get most of the lookups as in real traffic. The key of rank r is r,
+// zero-padded to the key size. Not thread-safe.
+class ZipfianKeyGenerator {
+ public:
+  // Keeps the cumulative distribution of the `num_keys` ranks in memory.
+  ZipfianKeyGenerator(int64_t num_keys, double exponent, int key_size);
+
+  std::vector<std::string> GenerateKeys(int number_of_keys);
+  // Returns the rank of a key picked at random.
+  int64_t GenerateRank();
+  std::string KeyOfRank(int64_t rank) const;
+
+ private:
+  // Probability that the rank of a key is at most the index.
+  std::vector<double> cumulative_probabilities_;
+  int key_size_;
+  absl::BitGen bitgen_;
+};
+
 // Creates KV DSP request body in json
 std::string CreateKVDSPRequestBodyInJson(const std::vector<std::string>& keys);
 
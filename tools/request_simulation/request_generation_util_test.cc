@@ -14,6 +14,8 @@
 
 #include "tools/request_simulation/request_generation_util.h"
 
+#include <vector>
+
 #include "absl/strings/escaping.h"
 #include "absl/strings/str_format.h"
 #include "google/protobuf/util/json_util.h"
@@ -35,5 +37,27 @@ TEST(TestCreateMessage, ProtoMessageMatchJson) {
       "{\"data\":", "\"", absl::Base64Escape(request_in_json), "\"", "}");
   EXPECT_EQ(encoded_request_body, expect_encoded_request_body);
 }
+
+TEST(ZipfianKeyGeneratorTest, GeneratesPopularKeysMoreOften) {
+  ZipfianKeyGenerator key_generator(/*num_keys=*/1000, /*exponent=*/1.0,
+                                    /*key_size=*/6);
+  EXPECT_EQ(key_generator.KeyOfRank(42), "000042");
+  std::vector<int> rank_counts(1000);
+  for (int i = 0; i < 100000; ++i) {
+    const int64_t rank = key_generator.GenerateRank();
+    ASSERT_GE(rank, 0);
+    ASSERT_LT(rank, 1000);
+    ++rank_counts[rank];
+  }
+  // With an exponent of 1, the most popular key is picked about twice as
+  // often as the second one, and about 13% of the time over 1000 keys.
+  EXPECT_GT(rank_counts[0], rank_counts[1]);
+  EXPECT_GT(rank_counts[1], rank_counts[9]);
+  EXPECT_NEAR(rank_counts[0] / 100000.0, 0.134, 0.02);
+  for (const auto& key : key_generator.GenerateKeys(10)) {
+    EXPECT_EQ(key.size(), 6);
+  }
+}
+
 }  // namespace
 }  // namespace kv_server
@@ -15,6 +15,7 @@
 #include "tools/request_simulation/request_simulation_system.h"
 
 #include <algorithm>
+#include <optional>
 #include <queue>
 #include <string>
 #include <utility>
@@ -44,6 +45,13 @@ ABSL_FLAG(int, concurrency, 10,
           "Number of concurrent requests sent to the server,"
           "this number will be limited by the maximum concurrent threads"
           "supported by state of the machine");
+ABSL_FLAG(bool, open_loop, false,
+          "If true, requests are sent at --rps on a fixed schedule, whether "
+          "or not the previous requests completed, and their latency is "
+          "measured from when they were scheduled");
+ABSL_FLAG(int, open_loop_max_outstanding_requests, 100000,
+          "In open loop, the maximum number of requests in flight, above "
+          "which sending waits");
 ABSL_FLAG(absl::Duration, request_timeout, absl::Seconds(300),
           "The timeout duration for getting response for the request");
 ABSL_FLAG(int64_t, synthetic_requests_fill_qps, 1000,
@@ -52,6 +60,23 @@ ABSL_FLAG(int64_t, synthetic_requests_fill_qps, 1000,
 ABSL_FLAG(int, number_of_keys_per_request, 1,
           "The number of keys in one synthetic request");
 ABSL_FLAG(int, key_size, 20, "The size of the key in bytes");
+ABSL_FLAG(bool, zipfian_keys, false,
+          "If true, the keys of synthetic requests follow a Zipfian "
+          "popularity over --zipfian_num_keys keys, named by their rank "
+          "zero-padded to --key_size, instead of being random");
+ABSL_FLAG(int64_t, zipfian_num_keys, 1000000,
+          "The number of distinct keys of synthetic requests with "
+          "--zipfian_keys");
+ABSL_FLAG(double, zipfian_exponent, 0.99,
+          "The skew of the key popularity with --zipfian_keys, 0 is uniform");
+ABSL_FLAG(std::string, request_trace_file, "",
+          "Local Riegeli file of kv_server.RecordedRequest records to replay. "
+          "If set, the requests of the trace are sent instead of synthetic "
+          "requests");
+ABSL_FLAG(double, request_trace_speedup, 1.0,
+          "How many times faster than recorded the request trace is replayed");
+ABSL_FLAG(bool, request_trace_loop, false,
+          "If true, the request trace is replayed again once replayed");
 ABSL_FLAG(absl::Duration, client_worker_rate_limiter_acquire_timeout,
           absl::Milliseconds(10),
           "The client worker's timeout duration for acquiring permits from "
@@ -67,8 +92,9 @@ ABSL_FLAG(int, client_worker_rate_limiter_initial_permits, 0,
 ABSL_FLAG(int, synthetic_requests_generator_rate_limiter_initial_permits, 1500,
           "The initial number of permits available for synthetic requests "
           "generator when the rate limiter is created");
-ABSL_FLAG(int64_t, message_queue_max_capacity, 10000000,
-          "The maximum number of messages held by the message queue");
+ABSL_FLAG(int64_t, message_queue_max_capacity, 1000000,
+          "The maximum number of messages held by the message queue. The "
+          "queue allocates a slot per message up front.");
 ABSL_FLAG(kv_server::GrpcAuthenticationMode, server_auth_mode,
           kv_server::GrpcAuthenticationMode::kSsl,
           "The server authentication mode");
@@ -92,6 +118,9 @@ ABSL_FLAG(int32_t, realtime_publisher_insertion_num_threads, 1,
           "Number of threads used to write to pubsub in parallel.");
 ABSL_FLAG(int32_t, realtime_publisher_files_insertion_rate, 15,
           "Number of messages sent per insertion thread to pubsub per second");
+ABSL_FLAG(int32_t, realtime_publisher_batch_size, 10,
+          "Maximum number of messages sent to pubsub in one batch publish "
+          "request, up to 256 KB.");
 
 namespace kv_server {
 
@@ -110,7 +139,7 @@ namespace semantic_conventions =
 
 std::unique_ptr<RateLimiter> RequestSimulationSystem::CreateRateLimiter(
     int64_t per_second_rate, int64_t initial_permits, absl::Duration timeout,
-    std::unique_ptr<SleepFor> sleep_for) {
+    std::shared_ptr<SleepFor> sleep_for) {
   return std::make_unique<RateLimiter>(initial_permits, per_second_rate,
                                        steady_clock_, std::move(sleep_for),
                                        timeout);
@@ -140,13 +169,12 @@ absl::Status RequestSimulationSystem::Init(
       absl::GetFlag(FLAGS_key_size);
   synthetic_requests_fill_qps_ =
       absl::GetFlag(FLAGS_synthetic_requests_fill_qps);
-  grpc_request_rate_limiter_ = CreateRateLimiter(
-      absl::GetFlag(FLAGS_rps),
-      absl::GetFlag(FLAGS_client_worker_rate_limiter_initial_permits),
-      absl::GetFlag(FLAGS_client_worker_rate_limiter_acquire_timeout),
-      sleep_for_client_worker_rate_limiter == nullptr
-          ? std::move(std::make_unique<SleepFor>())
-          : std::move(sleep_for_client_worker_rate_limiter));
+  if (absl::GetFlag(FLAGS_zipfian_keys)) {
+    zipfian_key_generator_ = std::make_unique<ZipfianKeyGenerator>(
+        absl::GetFlag(FLAGS_zipfian_num_keys),
+        absl::GetFlag(FLAGS_zipfian_exponent),
+        synthetic_request_gen_option_.key_size_in_bytes);
+  }
   synthetic_request_generator_rate_limiter_ = CreateRateLimiter(
       synthetic_requests_fill_qps_,
       absl::GetFlag(
@@ -164,11 +192,26 @@ absl::Status RequestSimulationSystem::Init(
           ? std::move(std::make_unique<SleepFor>())
           : std::move(sleep_for_request_generator),
       synthetic_requests_fill_qps_, [this]() {
-        const auto keys = kv_server::GenerateRandomKeys(
-            synthetic_request_gen_option_.number_of_keys_per_request,
-            synthetic_request_gen_option_.key_size_in_bytes);
+        const auto keys =
+            zipfian_key_generator_ != nullptr
+                ? zipfian_key_generator_->GenerateKeys(
+                      synthetic_request_gen_option_.number_of_keys_per_request)
+                : kv_server::GenerateRandomKeys(
+                      synthetic_request_gen_option_.number_of_keys_per_request,
+                      synthetic_request_gen_option_.key_size_in_bytes);
         return kv_server::CreateKVDSPRequestBodyInJson(keys);
       });
+  if (const std::string trace_file = absl::GetFlag(FLAGS_request_trace_file);
+      !trace_file.empty()) {
+    trace_replay_request_generator_ =
+        std::make_unique<TraceReplayRequestGenerator>(
+            TraceReplayRequestGenerator::Options{
+                .trace_file = trace_file,
+                .speedup = absl::GetFlag(FLAGS_request_trace_speedup),
+                .loop = absl::GetFlag(FLAGS_request_trace_loop),
+            },
+            *message_queue_, steady_clock_, std::make_unique<SleepFor>());
+  }
 
   // Telemetry must be initialized before initializing metrics collector
   metrics_collector_ =
@@ -186,7 +229,11 @@ absl::Status RequestSimulationSystem::Init(
       privacy_sandbox::server_common::telemetry::BuildDependentConfig(
           config_proto));
 
-  if (auto status = InitializeGrpcClientWorkers(); !status.ok()) {
+  if (auto status = InitializeGrpcClientWorkers(
+          sleep_for_client_worker_rate_limiter == nullptr
+              ? std::make_unique<SleepFor>()
+              : std::move(sleep_for_client_worker_rate_limiter));
+      !status.ok()) {
     return status;
   }
   blob_storage_client_ = CreateBlobClient();
@@ -239,7 +286,10 @@ absl::Status RequestSimulationSystem::Init(
   concurrent_publishing_engine_ = std::make_unique<ConcurrentPublishingEngine>(
       realtime_publisher_insertion_num_threads, std::move(notifier_metadata),
       realtime_publisher_files_insertion_rate, realtime_messages_mutex_,
-      realtime_messages_);
+      realtime_messages_,
+      ConcurrentPublishingEngine::Options{
+          .max_batch_size = absl::GetFlag(FLAGS_realtime_publisher_batch_size),
+      });
   delta_based_realtime_updates_publisher_ =
       std::make_unique<DeltaBasedRealtimeUpdatesPublisher>(
           std::move(realtime_message_batcher_),
@@ -259,7 +309,8 @@ absl::Status RequestSimulationSystem::Init(
             << server_address_ << " and server method is " << server_method_;
   return absl::OkStatus();
 }
-absl::Status RequestSimulationSystem::InitializeGrpcClientWorkers() {
+absl::Status RequestSimulationSystem::InitializeGrpcClientWorkers(
+    std::shared_ptr<SleepFor> sleep_for_rate_limiter) {
   if (server_address_.empty()) {
     return absl::FailedPreconditionError("Server address cannot be empty");
   }
@@ -286,7 +337,31 @@ absl::Status RequestSimulationSystem::InitializeGrpcClientWorkers() {
         "check grpc connection in start up", LogMetricsNoOpCallback());
   }
   auto request_timeout = absl::GetFlag(FLAGS_request_timeout);
+  std::optional<OpenLoopOptions> open_loop_options;
+  if (absl::GetFlag(FLAGS_open_loop)) {
+    open_loop_options = OpenLoopOptions{
+        .requests_per_second =
+            static_cast<double>(absl::GetFlag(FLAGS_rps)) / num_of_workers,
+        .max_outstanding_requests = std::max(
+            1, absl::GetFlag(FLAGS_open_loop_max_outstanding_requests) /
+                   num_of_workers),
+    };
+    if (open_loop_options->requests_per_second <= 0) {
+      return absl::InvalidArgumentError("Open loop requires a positive rps");
+    }
+  }
+  // Each worker gets its own rate limiter with its share of the rate and of
+  // the initial permits, so that the workers don't contend on the permits.
+  const int64_t rps = absl::GetFlag(FLAGS_rps);
+  const int64_t initial_permits =
+      absl::GetFlag(FLAGS_client_worker_rate_limiter_initial_permits);
   for (int i = 0; i < num_of_workers; ++i) {
+    grpc_request_rate_limiters_.push_back(CreateRateLimiter(
+        rps / num_of_workers + (i < rps % num_of_workers ? 1 : 0),
+        initial_permits / num_of_workers +
+            (i < initial_permits % num_of_workers ? 1 : 0),
+        absl::GetFlag(FLAGS_client_worker_rate_limiter_acquire_timeout),
+        sleep_for_rate_limiter));
     auto request_converter = [](const std::string& request_body) {
       RawRequest request;
       request.mutable_raw_body()->set_data(request_body);
@@ -295,8 +370,8 @@ absl::Status RequestSimulationSystem::InitializeGrpcClientWorkers() {
     auto worker =
         std::make_unique<ClientWorker<RawRequest, google::api::HttpBody>>(
             i, channel, server_method_, request_timeout, request_converter,
-            *message_queue_, *grpc_request_rate_limiter_, *metrics_collector_,
-            is_client_channel);
+            *message_queue_, *grpc_request_rate_limiters_.back(),
+            *metrics_collector_, is_client_channel, open_loop_options);
     grpc_client_workers_.push_back(std::move(worker));
   }
   return absl::OkStatus();
@@ -309,7 +384,10 @@ absl::Status RequestSimulationSystem::Start() {
   }
   LOG(INFO) << "Starting delta based realtime updates publisher";
   PS_RETURN_IF_ERROR(delta_based_realtime_updates_publisher_->Start());
-  if (synthetic_requests_fill_qps_ > 0) {
+  if (trace_replay_request_generator_ != nullptr) {
+    LOG(INFO) << "Starting trace replay request generator";
+    PS_RETURN_IF_ERROR(trace_replay_request_generator_->Start());
+  } else if (synthetic_requests_fill_qps_ > 0) {
     LOG(INFO) << "Starting synthetic request generator";
     if (auto status = synthetic_request_generator_->Start(); !status.ok()) {
       return status;
@@ -341,6 +419,10 @@ absl::Status RequestSimulationSystem::Stop() {
   if (auto status = synthetic_request_generator_->Stop(); !status.ok()) {
     return status;
   }
+  if (trace_replay_request_generator_ != nullptr) {
+    LOG(INFO) << "Stopping trace replay request generator";
+    PS_RETURN_IF_ERROR(trace_replay_request_generator_->Stop());
+  }
   LOG(INFO) << "Stopping metrics collector";
   if (auto status = metrics_collector_->Stop(); !status.ok()) {
     return status;
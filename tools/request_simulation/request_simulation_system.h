@@ -42,8 +42,10 @@
 #include "tools/request_simulation/message_queue.h"
 #include "tools/request_simulation/rate_limiter.h"
 #include "tools/request_simulation/request/raw_request.pb.h"
+#include "tools/request_simulation/request_generation_util.h"
 #include "tools/request_simulation/request_simulation_parameter_fetcher.h"
 #include "tools/request_simulation/synthetic_request_generator.h"
+#include "tools/request_simulation/trace_replay_request_generator.h"
 
 ABSL_DECLARE_FLAG(std::string, server_address);
 ABSL_DECLARE_FLAG(std::string, server_method);
@@ -54,6 +56,12 @@ ABSL_DECLARE_FLAG(absl::Duration, request_timeout);
 ABSL_DECLARE_FLAG(int64_t, synthetic_requests_fill_qps);
 ABSL_DECLARE_FLAG(int, number_of_keys_per_request);
 ABSL_DECLARE_FLAG(int, key_size);
+ABSL_DECLARE_FLAG(bool, zipfian_keys);
+ABSL_DECLARE_FLAG(int64_t, zipfian_num_keys);
+ABSL_DECLARE_FLAG(double, zipfian_exponent);
+ABSL_DECLARE_FLAG(std::string, request_trace_file);
+ABSL_DECLARE_FLAG(double, request_trace_speedup);
+ABSL_DECLARE_FLAG(bool, request_trace_loop);
 ABSL_DECLARE_FLAG(absl::Duration, client_worker_rate_limiter_acquire_timeout);
 ABSL_DECLARE_FLAG(absl::Duration,
                   synthetic_requests_generator_rate_limiter_acquire_timeout);
@@ -77,6 +85,9 @@ namespace kv_server {
 // parameter.
 // 5. A delta based request generator that reads keys from delta file and
 // publishes realtime updates to the specified SNS/pubsub endpoint.
+// 6. A trace replay request generator that replays requests recorded from
+// production traffic at their recorded times, instead of the synthetic
+// request generator.
 //
 // Once the system successfully starts, the system will continuously generates
 // requests and send requests to the target server.
@@ -131,8 +142,9 @@ class RequestSimulationSystem {
   std::unique_ptr<StreamRecordReaderFactory> CreateStreamRecordReaderFactory();
   std::unique_ptr<RateLimiter> CreateRateLimiter(
       int64_t per_second_rate, int64_t initial_permits, absl::Duration timeout,
-      std::unique_ptr<SleepFor> sleep_for);
-  absl::Status InitializeGrpcClientWorkers();
+      std::shared_ptr<SleepFor> sleep_for);
+  absl::Status InitializeGrpcClientWorkers(
+      std::shared_ptr<SleepFor> sleep_for_rate_limiter);
   absl::AnyInvocable<std::string(std::string_view)> CreateRequestFromKeyFn();
   // This must be first, otherwise the AWS SDK will crash when it's called:
   PlatformInitializer platform_initializer_;
@@ -157,8 +169,11 @@ class RequestSimulationSystem {
   std::unique_ptr<StreamRecordReaderFactory> delta_stream_reader_factory_;
   std::unique_ptr<MessageQueue> message_queue_;
   std::unique_ptr<RateLimiter> synthetic_request_generator_rate_limiter_;
-  std::unique_ptr<RateLimiter> grpc_request_rate_limiter_;
+  // One per client worker.
+  std::vector<std::unique_ptr<RateLimiter>> grpc_request_rate_limiters_;
+  std::unique_ptr<ZipfianKeyGenerator> zipfian_key_generator_;
   std::unique_ptr<SyntheticRequestGenerator> synthetic_request_generator_;
+  std::unique_ptr<TraceReplayRequestGenerator> trace_replay_request_generator_;
   std::unique_ptr<DeltaBasedRequestGenerator> delta_based_request_generator_;
   std::unique_ptr<DeltaBasedRealtimeUpdatesPublisher>
       delta_based_realtime_updates_publisher_;
@@ -0,0 +1,110 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "tools/request_simulation/trace_replay_request_generator.h"
+
+#include <algorithm>
+#include <fstream>
+#include <optional>
+#include <utility>
+
+#include "absl/log/log.h"
+#include "absl/strings/str_cat.h"
+#include "riegeli/bytes/istream_reader.h"
+#include "riegeli/records/record_reader.h"
+#include "tools/request_simulation/request/raw_request.pb.h"
+
+namespace kv_server {
+namespace {
+
+using privacy_sandbox::server_common::SteadyTime;
+
+// Longest sleep between checks of whether the generator is stopped.
+constexpr absl::Duration kMaxSleep = absl::Milliseconds(100);
+
+}  // namespace
+
+absl::Status TraceReplayRequestGenerator::Start() {
+  if (options_.speedup <= 0) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Trace speedup must be positive: ", options_.speedup));
+  }
+  return thread_manager_->Start([this]() { ReplayRequests(); });
+}
+
+absl::Status TraceReplayRequestGenerator::Stop() {
+  return thread_manager_->Stop();
+}
+
+bool TraceReplayRequestGenerator::IsRunning() const {
+  return thread_manager_->IsRunning();
+}
+
+void TraceReplayRequestGenerator::ReplayRequests() {
+  do {
+    if (const auto status = ReplayTrace(); !status.ok()) {
+      LOG(ERROR) << "Failed to replay trace " << options_.trace_file << ": "
+                 << status;
+      return;
+    }
+    LOG(INFO) << "Replayed trace " << options_.trace_file << ", "
+              << num_replayed_requests_ << " requests queued so far";
+  } while (options_.loop && !thread_manager_->ShouldStop());
+}
+
+absl::Status TraceReplayRequestGenerator::ReplayTrace() {
+  std::ifstream trace_stream(options_.trace_file, std::ios::binary);
+  if (!trace_stream.is_open()) {
+    return absl::NotFoundError(
+        absl::StrCat("Cannot open trace file ", options_.trace_file));
+  }
+  riegeli::RecordReader record_reader(riegeli::IStreamReader(&trace_stream));
+  const SteadyTime replay_start = clock_.Now();
+  std::optional<int64_t> first_received_time_micros;
+  RecordedRequest recorded_request;
+  while (record_reader.ReadRecord(recorded_request)) {
+    if (!first_received_time_micros.has_value()) {
+      first_received_time_micros = recorded_request.received_time_micros();
+    }
+    const int64_t offset_micros = std::max<int64_t>(
+        recorded_request.received_time_micros() - *first_received_time_micros,
+        0);
+    if (!WaitUntil(replay_start +
+                   absl::Microseconds(offset_micros) / options_.speedup)) {
+      return absl::OkStatus();
+    }
+    message_queue_.Push(
+        std::move(*recorded_request.mutable_request()->mutable_raw_body()
+                       ->mutable_data()));
+    ++num_replayed_requests_;
+  }
+  if (!record_reader.Close()) {
+    return record_reader.status();
+  }
+  return absl::OkStatus();
+}
+
+bool TraceReplayRequestGenerator::WaitUntil(SteadyTime time) {
+  while (!thread_manager_->ShouldStop()) {
+    const absl::Duration remaining = time - clock_.Now();
+    if (remaining <= absl::ZeroDuration()) {
+      return true;
+    }
+    sleep_for_->Duration(std::min(remaining, kMaxSleep));
+  }
+  return false;
+}
+
+}  // namespace kv_server
@@ -0,0 +1,95 @@
+/*
+ * Copyright 2024 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TOOLS_REQUEST_SIMULATION_TRACE_REPLAY_REQUEST_GENERATOR_H_
+#define TOOLS_REQUEST_SIMULATION_TRACE_REPLAY_REQUEST_GENERATOR_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "absl/status/status.h"
+#include "components/data/common/thread_manager.h"
+#include "components/util/sleepfor.h"
+#include "src/util/duration.h"
+#include "tools/request_simulation/message_queue.h"
+
+namespace kv_server {
+
+// Replays a trace of `RecordedRequest`s recorded from the traffic of a
+// server: puts the body of each request in the message queue when it is due,
+// keeping the time between requests of the trace, so that the server is
+// measured with the keys, key popularity and request shapes of its traffic.
+//
+// The client workers send the requests as they are queued, so their rate
+// limit should be above the peak rate of the trace.
+class TraceReplayRequestGenerator {
+ public:
+  struct Options {
+    // Local Riegeli file of `RecordedRequest`s.
+    std::string trace_file;
+    // The trace is replayed this many times faster than it was recorded.
+    double speedup = 1.0;
+    // If true, the trace is replayed again once replayed, until stopped.
+    bool loop = false;
+  };
+
+  TraceReplayRequestGenerator(
+      Options options, MessageQueue& message_queue,
+      privacy_sandbox::server_common::SteadyClock& clock,
+      std::unique_ptr<SleepFor> sleep_for)
+      : options_(std::move(options)),
+        thread_manager_(
+            ThreadManager::Create("Trace replay request generator")),
+        message_queue_(message_queue),
+        clock_(clock),
+        sleep_for_(std::move(sleep_for)) {}
+  // Starts the thread of replaying the trace
+  absl::Status Start();
+  // Stops the thread of replaying the trace
+  absl::Status Stop();
+  // Check if the thread of replaying the trace is running
+  bool IsRunning() const;
+  // Number of requests replayed so far, including those dropped because the
+  // message queue was full.
+  int64_t num_replayed_requests() const { return num_replayed_requests_; }
+  ~TraceReplayRequestGenerator() = default;
+
+  // TraceReplayRequestGenerator is neither copyable nor movable.
+  TraceReplayRequestGenerator(const TraceReplayRequestGenerator&) = delete;
+  TraceReplayRequestGenerator& operator=(const TraceReplayRequestGenerator&) =
+      delete;
+
+ private:
+  void ReplayRequests();
+  // Replays the trace once, returns early if the generator is stopped.
+  absl::Status ReplayTrace();
+  // Waits until `time`, returns false if the generator is stopped first.
+  bool WaitUntil(privacy_sandbox::server_common::SteadyTime time);
+
+  Options options_;
+  std::unique_ptr<ThreadManager> thread_manager_;
+  MessageQueue& message_queue_;
+  privacy_sandbox::server_common::SteadyClock& clock_;
+  std::unique_ptr<SleepFor> sleep_for_;
+  std::atomic<int64_t> num_replayed_requests_ = 0;
+};
+
+}  // namespace kv_server
+
+#endif  // TOOLS_REQUEST_SIMULATION_TRACE_REPLAY_REQUEST_GENERATOR_H_
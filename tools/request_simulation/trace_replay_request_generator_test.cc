@@ -0,0 +1,117 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "tools/request_simulation/trace_replay_request_generator.h"
+
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "components/util/sleepfor_mock.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "riegeli/bytes/ostream_writer.h"
+#include "riegeli/records/record_writer.h"
+#include "tools/request_simulation/request/raw_request.pb.h"
+
+namespace kv_server {
+namespace {
+
+using privacy_sandbox::server_common::SimulatedSteadyClock;
+using privacy_sandbox::server_common::SteadyTime;
+using testing::_;
+
+std::string WriteTrace(
+    const std::vector<std::pair<int64_t, std::string>>& requests) {
+  const std::string trace_file =
+      absl::StrCat(::testing::TempDir(), "/request_trace");
+  std::ofstream trace_stream(trace_file, std::ios::binary);
+  riegeli::RecordWriter record_writer(riegeli::OStreamWriter(&trace_stream));
+  for (const auto& [received_time_micros, body] : requests) {
+    RecordedRequest recorded_request;
+    recorded_request.set_received_time_micros(received_time_micros);
+    recorded_request.mutable_request()->mutable_raw_body()->set_data(body);
+    EXPECT_TRUE(record_writer.WriteRecord(recorded_request));
+  }
+  EXPECT_TRUE(record_writer.Close());
+  return trace_file;
+}
+
+class TraceReplayRequestGeneratorTest : public ::testing::Test {
+ protected:
+  TraceReplayRequestGeneratorTest() {
+    // Sleeping advances the simulated time, so the requests are replayed
+    // right away.
+    ON_CALL(*sleep_for_, Duration(_)).WillByDefault([this](absl::Duration d) {
+      sim_clock_.AdvanceTime(d);
+      return true;
+    });
+    EXPECT_CALL(*sleep_for_, Duration(_)).Times(testing::AnyNumber());
+  }
+
+  SimulatedSteadyClock sim_clock_;
+  std::unique_ptr<MockSleepFor> sleep_for_ = std::make_unique<MockSleepFor>();
+};
+
+TEST_F(TraceReplayRequestGeneratorTest, ReplaysRequestsAtRecordedTimes) {
+  const std::string trace_file = WriteTrace(
+      {{1000000, "request0"}, {1500000, "request1"}, {3000000, "request2"}});
+  MessageQueue message_queue(10);
+  TraceReplayRequestGenerator request_generator(
+      {.trace_file = trace_file, .speedup = 2}, message_queue, sim_clock_,
+      std::move(sleep_for_));
+  const SteadyTime start = sim_clock_.Now();
+  EXPECT_TRUE(request_generator.Start().ok());
+  while (request_generator.num_replayed_requests() < 3) {
+    absl::SleepFor(absl::Milliseconds(1));
+  }
+  EXPECT_TRUE(request_generator.Stop().ok());
+  // The last request was received 2 seconds after the first one.
+  EXPECT_EQ(sim_clock_.Now() - start, absl::Seconds(1));
+  for (const std::string expected : {"request0", "request1", "request2"}) {
+    const auto request = message_queue.Pop();
+    ASSERT_TRUE(request.ok());
+    EXPECT_EQ(*request, expected);
+  }
+  EXPECT_TRUE(message_queue.Empty());
+}
+
+TEST_F(TraceReplayRequestGeneratorTest, LoopsOverTrace) {
+  const std::string trace_file =
+      WriteTrace({{0, "request0"}, {1000, "request1"}});
+  MessageQueue message_queue(10);
+  TraceReplayRequestGenerator request_generator(
+      {.trace_file = trace_file, .loop = true}, message_queue, sim_clock_,
+      std::move(sleep_for_));
+  EXPECT_TRUE(request_generator.Start().ok());
+  while (request_generator.num_replayed_requests() < 6) {
+    absl::SleepFor(absl::Milliseconds(1));
+  }
+  EXPECT_TRUE(request_generator.Stop().ok());
+  EXPECT_GE(message_queue.Size(), 6);
+}
+
+TEST_F(TraceReplayRequestGeneratorTest, RejectsNonPositiveSpeedup) {
+  MessageQueue message_queue(10);
+  TraceReplayRequestGenerator request_generator(
+      {.trace_file = "trace", .speedup = 0}, message_queue, sim_clock_,
+      std::move(sleep_for_));
+  EXPECT_FALSE(request_generator.Start().ok());
+}
+
+}  // namespace
+}  // namespace kv_server
@@ -21,6 +21,7 @@ def closure_to_delta(
         custom_udf_js_handler = "HandleRequest",
         output_file_name = "DELTA_0000000000000009",
         logical_commit_time = None,  # Not passing a logical_commit_time will default to now.
+        udf_argument_format = "json",
         udf_tool = "//tools/udf/udf_generator:udf_delta_file_generator",
         tags = ["manual"]):
     """Generate a JS UDF delta file from a given closure_js_library target and put it under dist/
@@ -42,6 +43,8 @@ def closure_to_delta(
         udf_tool: BUILD target for the udf_delta_file_generator.
             Defaults to `//tools/udf/udf_generator:udf_delta_file_generator`
         logical_commit_time: Logical commit timestamp for UDF config. Optional, defaults to now.
+        udf_argument_format: Format of the arguments passed to the handler, `json` or
+            `serialized_proto`. Defaults to `json`.
         tags: tags to propagate to rules
     """
     closure_js_binary(
@@ -70,6 +73,8 @@ def closure_to_delta(
             "$(location {})".format(output_file_name),
             "--udf_handler_name",
             custom_udf_js_handler,
+            "--udf_argument_format",
+            udf_argument_format,
         ] + logical_commit_time_args,
         tool = udf_tool,
         visibility = ["//visibility:private"],
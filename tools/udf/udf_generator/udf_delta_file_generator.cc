@@ -43,6 +43,12 @@ ABSL_FLAG(std::string, output_path, "",
 ABSL_FLAG(int64_t, logical_commit_time, absl::ToUnixMicros(absl::Now()),
           "Record logical_commit_time. Default is current timestamp.");
 ABSL_FLAG(int64_t, code_snippet_version, 2, "UDF version. Default is 2.");
+ABSL_FLAG(std::string, udf_argument_format, "json",
+          "Format of the arguments passed to the UDF handler, json or "
+          "serialized_proto.");
+ABSL_FLAG(bool, udf_cache_outputs, false,
+          "Whether the output of the UDF handler only depends on its input and "
+          "the data of the server, so that outputs can be cached.");
 ABSL_FLAG(std::string, data_loading_file_format,
           std::string(kv_server::kFileFormats[static_cast<int>(
               kv_server::FileFormat::kRiegeli)]),
@@ -57,6 +63,7 @@ using kv_server::KVFileMetadata;
 using kv_server::ToDeltaFileName;
 using kv_server::ToFlatBufferBuilder;
 using kv_server::ToStringView;
+using kv_server::UserDefinedFunctionsArgumentFormat;
 using kv_server::UserDefinedFunctionsConfigStruct;
 using kv_server::UserDefinedFunctionsLanguage;
 
@@ -78,6 +85,11 @@ absl::Status WriteUdfConfig(std::ostream* output_stream) {
   const std::string udf_handler_name = absl::GetFlag(FLAGS_udf_handler_name);
   int64_t logical_commit_time = absl::GetFlag(FLAGS_logical_commit_time);
   int64_t version = absl::GetFlag(FLAGS_code_snippet_version);
+  const std::string argument_format = absl::GetFlag(FLAGS_udf_argument_format);
+  if (argument_format != "json" && argument_format != "serialized_proto") {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Unknown UDF argument format: ", argument_format));
+  }
   absl::StatusOr<std::string> code_snippet =
       ReadCodeSnippetAsString(std::move(udf_file_path));
   if (!code_snippet.ok()) {
@@ -106,7 +118,12 @@ absl::Status WriteUdfConfig(std::ostream* output_stream) {
       .handler_name = std::move(udf_handler_name),
       .logical_commit_time = logical_commit_time,
       .version = version,
-      .language = UserDefinedFunctionsLanguage::Javascript};
+      .language = UserDefinedFunctionsLanguage::Javascript,
+      .argument_format =
+          argument_format == "serialized_proto"
+              ? UserDefinedFunctionsArgumentFormat::SerializedProto
+              : UserDefinedFunctionsArgumentFormat::Json,
+      .cache_outputs = absl::GetFlag(FLAGS_udf_cache_outputs)};
   if (absl::Status status = delta_record_writer.value()->WriteRecord(
           DataRecordStruct{.record = std::move(udf_config)});
       !status.ok()) {
@@ -12,15 +12,28 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <atomic>
 #include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
+#include "absl/container/btree_map.h"
 #include "absl/flags/flag.h"
 #include "absl/flags/parse.h"
 #include "absl/log/log.h"
+#include "absl/random/random.h"
+#include "absl/strings/str_format.h"
 #include "absl/strings/substitute.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
 #include "components/data_server/cache/cache.h"
 #include "components/data_server/cache/key_value_cache.h"
 #include "components/internal_server/local_lookup.h"
+#include "components/internal_server/lookup.h"
 #include "components/udf/hooks/get_values_hook.h"
 #include "components/udf/udf_client.h"
 #include "components/udf/udf_config_builder.h"
@@ -38,6 +51,17 @@ ABSL_FLAG(std::string, udf_delta_file_path, "", "Path to UDF delta file.");
 ABSL_FLAG(std::string, input_arguments, "",
           "List of input arguments in JSON format. Each input argument should "
           "be equivalent to a UDFArgument.");
+ABSL_FLAG(int, benchmark_calls, 0,
+          "If positive, calls the UDF this many times and reports the "
+          "throughput and latencies of the calls and of their hook lookups, "
+          "instead of printing the result of one call.");
+ABSL_FLAG(int, benchmark_concurrency, 1,
+          "Number of concurrent callers, and of UDF workers, of the "
+          "benchmark.");
+ABSL_FLAG(std::string, benchmark_input_arguments_file, "",
+          "File with one list of input arguments in JSON format per line, such "
+          "as those of sampled requests. Each benchmark call uses a random "
+          "line. Defaults to --input_arguments.");
 
 namespace kv_server {
 
@@ -50,8 +74,8 @@ absl::Status LoadCacheFromKVMutationRecord(KeyValueMutationRecordStruct record,
                                            Cache& cache) {
   switch (record.mutation_type) {
     case KeyValueMutationType::Update: {
-      LOG(INFO) << "Updating cache with key " << record.key
-                << ", logical commit time " << record.logical_commit_time;
+      VLOG(1) << "Updating cache with key " << record.key
+              << ", logical commit time " << record.logical_commit_time;
       std::visit(
           [&cache, &record](auto& value) {
             using VariantT = std::decay_t<decltype(value)>;
@@ -107,6 +131,12 @@ void ReadCodeConfigFromUdfConfig(
   code_config.logical_commit_time = udf_config.logical_commit_time;
   code_config.udf_handler_name = udf_config.handler_name;
   code_config.version = udf_config.version;
+  code_config.argument_format =
+      udf_config.argument_format ==
+              UserDefinedFunctionsArgumentFormat::SerializedProto
+          ? CodeConfig::ArgumentFormat::kSerializedProto
+          : CodeConfig::ArgumentFormat::kJson;
+  code_config.cache_outputs = udf_config.cache_outputs;
 }
 
 absl::Status ReadCodeConfigFromFile(std::string file_path,
@@ -126,6 +156,218 @@ absl::Status ReadCodeConfigFromFile(std::string file_path,
       });
 }
 
+// Latencies of named calls, such as the UDF calls or the lookups of the
+// hooks. Thread safe.
+class LatencyRecorder {
+ public:
+  void Record(std::string_view name, absl::Duration latency) {
+    absl::MutexLock lock(&mutex_);
+    latencies_[std::string(name)].push_back(latency);
+  }
+
+  // Prints the count, throughput over `elapsed` and latency percentiles of
+  // each name.
+  void Report(absl::Duration elapsed) {
+    absl::MutexLock lock(&mutex_);
+    for (auto& [name, latencies] : latencies_) {
+      std::cout << absl::StrFormat(
+                       "%s: %d calls, %.1f/s, p50 %.3fms p90 %.3fms p99 "
+                       "%.3fms max %.3fms",
+                       name, latencies.size(),
+                       latencies.size() / absl::ToDoubleSeconds(elapsed),
+                       absl::ToDoubleMilliseconds(Percentile(latencies, 50)),
+                       absl::ToDoubleMilliseconds(Percentile(latencies, 90)),
+                       absl::ToDoubleMilliseconds(Percentile(latencies, 99)),
+                       absl::ToDoubleMilliseconds(Percentile(latencies, 100)))
+                << std::endl;
+    }
+  }
+
+ private:
+  static absl::Duration Percentile(std::vector<absl::Duration>& latencies,
+                                   double percentile) {
+    if (latencies.empty()) {
+      return absl::ZeroDuration();
+    }
+    const size_t index = std::min(
+        latencies.size() - 1,
+        static_cast<size_t>(percentile / 100 * latencies.size()));
+    std::nth_element(latencies.begin(), latencies.begin() + index,
+                     latencies.end());
+    return latencies[index];
+  }
+
+  absl::Mutex mutex_;
+  absl::btree_map<std::string, std::vector<absl::Duration>> latencies_
+      ABSL_GUARDED_BY(mutex_);
+};
+
+// Records the latencies of the lookups of the hooks, by lookup method.
+class TimedLookup : public Lookup {
+ public:
+  TimedLookup(std::unique_ptr<Lookup> lookup, LatencyRecorder& recorder)
+      : lookup_(std::move(lookup)), recorder_(recorder) {}
+
+  absl::StatusOr<InternalLookupResponse> GetKeyValues(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& keys) const override {
+    return Time("lookup GetKeyValues", [&]() {
+      return lookup_->GetKeyValues(request_context, keys);
+    });
+  }
+  absl::Status AddKeyValues(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& keys,
+      InternalLookupResponse& response) const override {
+    return Time("lookup AddKeyValues", [&]() {
+      return lookup_->AddKeyValues(request_context, keys, response);
+    });
+  }
+  absl::StatusOr<InternalLookupResponse> GetKeyValueSet(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& key_set) const override {
+    return Time("lookup GetKeyValueSet", [&]() {
+      return lookup_->GetKeyValueSet(request_context, key_set);
+    });
+  }
+  absl::StatusOr<InternalLookupResponse> GetKeyValuesAndSets(
+      const RequestContext& request_context,
+      const absl::flat_hash_set<std::string_view>& keys,
+      const absl::flat_hash_set<std::string_view>& set_keys) const override {
+    return Time("lookup GetKeyValuesAndSets", [&]() {
+      return lookup_->GetKeyValuesAndSets(request_context, keys, set_keys);
+    });
+  }
+  absl::StatusOr<InternalLookupResponse> GetKeyValuesByPrefix(
+      const RequestContext& request_context, std::string_view key_prefix,
+      int limit) const override {
+    return Time("lookup GetKeyValuesByPrefix", [&]() {
+      return lookup_->GetKeyValuesByPrefix(request_context, key_prefix, limit);
+    });
+  }
+  absl::StatusOr<std::vector<std::string>> GetSetsContaining(
+      const RequestContext& request_context,
+      std::string_view member) const override {
+    return Time("lookup GetSetsContaining", [&]() {
+      return lookup_->GetSetsContaining(request_context, member);
+    });
+  }
+  absl::StatusOr<InternalRunQueryResponse> RunQuery(
+      const RequestContext& request_context, std::string query) const override {
+    return Time("lookup RunQuery", [&]() {
+      return lookup_->RunQuery(request_context, std::move(query));
+    });
+  }
+  absl::StatusOr<int64_t> ApproxCardinality(
+      const RequestContext& request_context, std::string query) const override {
+    return Time("lookup ApproxCardinality", [&]() {
+      return lookup_->ApproxCardinality(request_context, std::move(query));
+    });
+  }
+
+ private:
+  template <typename Fn>
+  auto Time(std::string_view name, Fn fn) const {
+    const absl::Time start = absl::Now();
+    auto result = fn();
+    recorder_.Record(name, absl::Now() - start);
+    return result;
+  }
+
+  std::unique_ptr<Lookup> lookup_;
+  LatencyRecorder& recorder_;
+};
+
+// Parses a list of input arguments in JSON format.
+absl::StatusOr<v2::RequestPartition> ParseInputArguments(
+    std::string_view input_arguments) {
+  v2::RequestPartition req_partition;
+  const std::string req_partition_json =
+      absl::StrCat("{arguments: ", input_arguments, "}");
+  if (const auto status =
+          JsonStringToMessage(req_partition_json, &req_partition);
+      !status.ok()) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Invalid input arguments: ", input_arguments, ": ", status.ToString()));
+  }
+  return req_partition;
+}
+
+absl::StatusOr<std::vector<v2::RequestPartition>> ReadBenchmarkInputs(
+    const std::string& input_arguments_file,
+    const std::string& input_arguments) {
+  std::vector<v2::RequestPartition> inputs;
+  if (input_arguments_file.empty()) {
+    PS_ASSIGN_OR_RETURN(v2::RequestPartition input,
+                        ParseInputArguments(input_arguments));
+    inputs.push_back(std::move(input));
+    return inputs;
+  }
+  std::ifstream file(input_arguments_file);
+  if (!file) {
+    return absl::NotFoundError(
+        absl::StrCat("Failed to open ", input_arguments_file));
+  }
+  for (std::string line; std::getline(file, line);) {
+    if (line.empty()) {
+      continue;
+    }
+    PS_ASSIGN_OR_RETURN(v2::RequestPartition input, ParseInputArguments(line));
+    inputs.push_back(std::move(input));
+  }
+  if (inputs.empty()) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("No input arguments in ", input_arguments_file));
+  }
+  return inputs;
+}
+
+// Calls the UDF `num_calls` times from `concurrency` threads, with random
+// inputs of `inputs`, and prints the latencies of the calls and of the
+// lookups recorded by `recorder`.
+absl::Status RunBenchmark(const UdfClient& udf_client,
+                          const std::vector<v2::RequestPartition>& inputs,
+                          int num_calls, int concurrency,
+                          LatencyRecorder& recorder) {
+  LOG(INFO) << "Calling UDF " << num_calls << " times from " << concurrency
+            << " callers with " << inputs.size() << " inputs";
+  std::atomic<int> next_call = 0;
+  std::atomic<int> num_failures = 0;
+  const absl::Time start = absl::Now();
+  std::vector<std::thread> callers;
+  callers.reserve(concurrency);
+  for (int i = 0; i < concurrency; ++i) {
+    callers.emplace_back([&]() {
+      absl::BitGen bitgen;
+      while (next_call.fetch_add(1) < num_calls) {
+        const v2::RequestPartition& input =
+            inputs[absl::Uniform<size_t>(bitgen, 0, inputs.size())];
+        auto metrics_context = std::make_unique<ScopeMetricsContext>();
+        const absl::Time call_start = absl::Now();
+        const auto udf_result = udf_client.ExecuteCode(
+            RequestContext(*metrics_context), {}, input.arguments());
+        recorder.Record("UDF", absl::Now() - call_start);
+        if (!udf_result.ok()) {
+          LOG_EVERY_N(ERROR, 1000)
+              << "UDF execution failed: " << udf_result.status();
+          num_failures.fetch_add(1);
+        }
+      }
+    });
+  }
+  for (std::thread& caller : callers) {
+    caller.join();
+  }
+  const absl::Duration elapsed = absl::Now() - start;
+  std::cout << "Benchmark of " << num_calls << " calls took " << elapsed
+            << ", " << num_failures << " failed" << std::endl;
+  recorder.Report(elapsed);
+  return num_failures == 0
+             ? absl::OkStatus()
+             : absl::InternalError(
+                   absl::StrCat(num_failures.load(), " UDF calls failed"));
+}
+
 void ShutdownUdf(UdfClient& udf_client) {
   auto udf_client_stop = udf_client.Stop();
   if (!udf_client_stop.ok()) {
@@ -134,10 +376,19 @@ void ShutdownUdf(UdfClient& udf_client) {
   }
 }
 
+struct BenchmarkOptions {
+  // 0 calls the UDF once and prints its result.
+  int num_calls = 0;
+  int concurrency = 1;
+  std::string input_arguments_file;
+};
+
 absl::Status TestUdf(const std::string& kv_delta_file_path,
                      const std::string& udf_delta_file_path,
-                     const std::string& input_arguments) {
+                     const std::string& input_arguments,
+                     const BenchmarkOptions& benchmark_options) {
   InitMetricsContextMap();
+  const bool benchmark = benchmark_options.num_calls > 0;
   LOG(INFO) << "Loading cache from delta file: " << kv_delta_file_path;
   std::unique_ptr<Cache> cache = KeyValueCache::Create();
   PS_RETURN_IF_ERROR(LoadCacheFromFile(kv_delta_file_path, *cache))
@@ -149,23 +400,42 @@ absl::Status TestUdf(const std::string& kv_delta_file_path,
   PS_RETURN_IF_ERROR(ReadCodeConfigFromFile(udf_delta_file_path, code_config))
       << "Error loading UDF code from file";
 
+  std::vector<v2::RequestPartition> benchmark_inputs;
+  if (benchmark) {
+    PS_ASSIGN_OR_RETURN(
+        benchmark_inputs,
+        ReadBenchmarkInputs(benchmark_options.input_arguments_file,
+                            input_arguments));
+  }
+
   LOG(INFO) << "Starting UDF client";
+  LatencyRecorder recorder;
   UdfConfigBuilder config_builder;
   auto string_get_values_hook =
       GetValuesHook::Create(GetValuesHook::OutputType::kString);
-  string_get_values_hook->FinishInit(CreateLocalLookup(*cache));
+  string_get_values_hook->FinishInit(
+      std::make_unique<TimedLookup>(CreateLocalLookup(*cache), recorder));
   auto binary_get_values_hook =
       GetValuesHook::Create(GetValuesHook::OutputType::kBinary);
-  binary_get_values_hook->FinishInit(CreateLocalLookup(*cache));
+  binary_get_values_hook->FinishInit(
+      std::make_unique<TimedLookup>(CreateLocalLookup(*cache), recorder));
   auto run_query_hook = RunQueryHook::Create();
-  run_query_hook->FinishInit(CreateLocalLookup(*cache));
+  run_query_hook->FinishInit(
+      std::make_unique<TimedLookup>(CreateLocalLookup(*cache), recorder));
   absl::StatusOr<std::unique_ptr<UdfClient>> udf_client =
       UdfClient::Create(std::move(
           config_builder.RegisterStringGetValuesHook(*string_get_values_hook)
+              .RegisterStringGetValuesBatchHook(*string_get_values_hook)
+              .RegisterStringGetValuesAndSetsHook(*string_get_values_hook)
+              .RegisterStringGetValuesByPrefixHook(*string_get_values_hook)
               .RegisterBinaryGetValuesHook(*binary_get_values_hook)
+              .RegisterFlatGetValuesHook(*binary_get_values_hook)
               .RegisterRunQueryHook(*run_query_hook)
+              .RegisterApproxCardinalityHook(*run_query_hook)
+              .RegisterGetSetsContainingHook(*run_query_hook)
               .RegisterLoggingFunction()
-              .SetNumberOfWorkers(1)
+              .SetNumberOfWorkers(benchmark ? benchmark_options.concurrency
+                                            : 1)
               .Config()));
   PS_RETURN_IF_ERROR(udf_client.status())
       << "Error starting UDF execution engine";
@@ -177,6 +447,15 @@ absl::Status TestUdf(const std::string& kv_delta_file_path,
     return code_object_status;
   }
 
+  if (benchmark) {
+    const absl::Status status =
+        RunBenchmark(*udf_client.value(), benchmark_inputs,
+                     benchmark_options.num_calls,
+                     benchmark_options.concurrency, recorder);
+    ShutdownUdf(*udf_client.value());
+    return status;
+  }
+
   v2::RequestPartition req_partition;
   std::string req_partition_json =
       absl::StrCat("{arguments: ", input_arguments, "}");
@@ -212,8 +491,14 @@ int main(int argc, char** argv) {
       absl::GetFlag(FLAGS_udf_delta_file_path);
   const std::string input_arguments = absl::GetFlag(FLAGS_input_arguments);
 
+  const kv_server::BenchmarkOptions benchmark_options{
+      .num_calls = absl::GetFlag(FLAGS_benchmark_calls),
+      .concurrency = std::max(1, absl::GetFlag(FLAGS_benchmark_concurrency)),
+      .input_arguments_file =
+          absl::GetFlag(FLAGS_benchmark_input_arguments_file),
+  };
   auto status = kv_server::TestUdf(kv_delta_file_path, udf_delta_file_path,
-                                   input_arguments);
+                                   input_arguments, benchmark_options);
   if (!status.ok()) {
     return -1;
   }